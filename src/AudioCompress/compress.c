@@ -89,104 +89,312 @@ struct CompressorConfig *Compressor_getConfig(struct Compressor *obj)
         return &obj->prefs;
 }
 
-void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
-                              unsigned int count)
+/*! Find the largest absolute sample value.  This loop has no
+ *  loop-carried dependency except for the maximum, so the compiler
+ *  can vectorize it.
+ */
+static int peak_int16(const int16_t *audio, unsigned int count)
 {
-        struct CompressorConfig *prefs = Compressor_getConfig(obj);
-	int16_t *ap;
-	unsigned int i;
-        int *peaks = obj->peaks;
-        int curGain = obj->gain[obj->pos];
-        int newGain;
-        int peakVal = 1;
-        int peakPos = 0;
-        int slot = (obj->pos + 1) % obj->bufsz;
-        int *clipped = obj->clipped + slot;
-        unsigned int ramp = count;
-        int delta;
-
-	ap = audio;
-	for (i = 0; i < count; i++)
-	{
-		int val = *ap++;
-                if (val < 0)
-                        val = -val;
-		if (val > peakVal)
-                {
-			peakVal = val;
-                        peakPos = i;
-                }
+	int peak = 1;
+	for (unsigned int i = 0; i < count; i++) {
+		int val = audio[i];
+		val = val < 0 ? -val : val;
+		peak = val > peak ? val : peak;
+	}
+
+	return peak;
+}
+
+static int64_t peak_int32(const int32_t *audio, unsigned int count)
+{
+	/* the absolute value of INT32_MIN does not fit into int32_t,
+	   but it's only one LSB more than INT32_MAX */
+	int32_t peak = 1;
+	for (unsigned int i = 0; i < count; i++) {
+		int32_t val = audio[i];
+		val = val < 0 ? ~val : val;
+		peak = val > peak ? val : peak;
 	}
-	peaks[slot] = peakVal;
 
+	return peak;
+}
+
+static float peak_float(const float *audio, unsigned int count)
+{
+	/* compare the bit patterns with the sign bit cleared, which
+	   are ordered just like the (non-negative) float values; NaN
+	   compares bigger than everything, and will be clamped by
+	   the caller */
+	int32_t peak = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		uint32_t bits;
+		memcpy(&bits, &audio[i], sizeof(bits));
+		int32_t val = (int32_t)(bits & 0x7fffffff);
+		peak = val > peak ? val : peak;
+	}
+
+	union {
+		uint32_t i;
+		float f;
+	} u = { (uint32_t)peak };
+	return u.f;
+}
+
+/*! Find the position of the first sample whose absolute value is
+ *  at least the given peak; only needed in the (rare) case that
+ *  the ramp has to be truncated.
+ */
+#define DEFINE_PEAK_POS(name, type, ptype) \
+static unsigned int name(const type *audio, unsigned int count, ptype peak) \
+{ \
+	for (unsigned int i = 0; i < count; i++) \
+		if (audio[i] >= peak || audio[i] <= -peak) \
+			return i; \
+	return 0; \
+}
+
+DEFINE_PEAK_POS(peak_pos_int16, int16_t, int)
+DEFINE_PEAK_POS(peak_pos_int32, int32_t, int64_t)
+DEFINE_PEAK_POS(peak_pos_float, float, float)
+
+/*! State of one Compressor_Process_*() call, independent of the
+ *  sample format.  Peaks and gains are on the 16 bit scale.
+ */
+struct CompressorPass {
+	int curGain;
+	int newGain;
+	int delta;
+	unsigned int ramp;
+	int slot;
+};
+
+static void Compressor_finishRamp(struct CompressorPass *pass)
+{
+	if (!pass->ramp)
+		pass->ramp = 1;
+	if (!pass->curGain)
+		pass->curGain = 1 << 10;
+	pass->delta = (pass->newGain - pass->curGain) / (int)pass->ramp;
+}
+
+/*! Calculate the new gain from the peak of this block and the
+ *  history.
+ *
+ *  @param peak16 the peak of this block, on the 16 bit scale
+ *  @return true if the ramp needs to be truncated to the position
+ *  of this block's peak (the caller shall then call
+ *  Compressor_truncateRamp())
+ */
+static int Compressor_beginPass(struct Compressor *obj,
+				struct CompressorPass *pass,
+				int peak16, unsigned int count)
+{
+	struct CompressorConfig *prefs = Compressor_getConfig(obj);
+	int *peaks = obj->peaks;
+	int peakVal = peak16 > 0 ? peak16 : 1;
+	int fromHistory = 0;
+	unsigned int i;
+	int newGain;
+
+	pass->curGain = obj->gain[obj->pos];
+	pass->slot = (obj->pos + 1) % obj->bufsz;
+	pass->ramp = count;
+
+	peaks[pass->slot] = peakVal;
 
 	for (i = 0; i < obj->bufsz; i++)
 	{
 		if (peaks[i] > peakVal)
 		{
 			peakVal = peaks[i];
-			peakPos = 0;
+			fromHistory = 1;
 		}
 	}
 
 	//! Determine target gain
 	newGain = (1 << 10)*prefs->target/peakVal;
 
-        //! Adjust the gain with inertia from the previous gain value
-        newGain = (curGain*((1 << prefs->smooth) - 1) + newGain)
-                >> prefs->smooth;
+	//! Adjust the gain with inertia from the previous gain value
+	newGain = (pass->curGain*((1 << prefs->smooth) - 1) + newGain)
+		>> prefs->smooth;
 
-        //! Make sure it's no more than the maximum gain value
-        if (newGain > (prefs->maxgain << 10))
-                newGain = prefs->maxgain << 10;
+	//! Make sure it's no more than the maximum gain value
+	if (newGain > (prefs->maxgain << 10))
+		newGain = prefs->maxgain << 10;
 
-        //! Make sure it's no less than 1:1
+	//! Make sure it's no less than 1:1
 	if (newGain < (1 << 10))
 		newGain = 1 << 10;
 
-        //! Make sure the adjusted gain won't cause clipping
-        if ((peakVal*newGain >> 10) > 32767)
-        {
-                newGain = (32767 << 10)/peakVal;
-                //! Truncate the ramp time
-                ramp = peakPos;
-        }
-
-        //! Record the new gain
-        obj->gain[slot] = newGain;
-
-        if (!ramp)
-                ramp = 1;
-        if (!curGain)
-                curGain = 1 << 10;
-	delta = (newGain - curGain) / (int)ramp;
-
-	ap = audio;
-        *clipped = 0;
-	for (i = 0; i < count; i++)
+	int needTruncate = 0;
+
+	//! Make sure the adjusted gain won't cause clipping
+	if ((peakVal*newGain >> 10) > 32767)
 	{
-		int sample;
+		newGain = (32767 << 10)/peakVal;
+		//! Truncate the ramp time
+		if (fromHistory)
+			pass->ramp = 0;
+		else
+			needTruncate = 1;
+	}
 
-		//! Amplify the sample
-		sample = *ap*curGain >> 10;
-		if (sample < -32768)
-		{
-			*clipped += -32768 - sample;
-			sample = -32768;
-		} else if (sample > 32767)
-		{
-			*clipped += sample - 32767;
-			sample = 32767;
+	pass->newGain = newGain;
+
+	//! Record the new gain
+	obj->gain[pass->slot] = newGain;
+
+	if (!needTruncate)
+		Compressor_finishRamp(pass);
+
+	return needTruncate;
+}
+
+static void Compressor_truncateRamp(struct CompressorPass *pass,
+				    unsigned int peakPos)
+{
+	pass->ramp = peakPos;
+	Compressor_finishRamp(pass);
+}
+
+/*! Apply the gain ramp; after the ramp, the gain is constant and
+ *  the loop can be vectorized.
+ */
+#define DEFINE_APPLY(name, type, wide, min, max, clip_shift) \
+static int name(type *audio, unsigned int count, \
+		const struct CompressorPass *pass) \
+{ \
+	int curGain = pass->curGain; \
+	unsigned int ramp = pass->ramp < count ? pass->ramp : count; \
+	int64_t clipped = 0; \
+	size_t i; \
+ \
+	for (i = 0; i < ramp; i++) { \
+		wide sample = (wide)audio[i] * curGain >> 10; \
+		if (sample < (min)) { \
+			clipped += ((min) - sample) >> (clip_shift); \
+			sample = (min); \
+		} else if (sample > (max)) { \
+			clipped += (sample - (max)) >> (clip_shift); \
+			sample = (max); \
+		} \
+		audio[i] = (type)sample; \
+		curGain += pass->delta; \
+	} \
+ \
+	if (i < count) \
+		curGain = pass->newGain; \
+ \
+	wide excess = 0; \
+	for (; i < count; i++) { \
+		wide sample = (wide)audio[i] * curGain >> 10; \
+		wide clamped = sample < (min) ? (min) : sample; \
+		clamped = clamped > (max) ? (max) : clamped; \
+		excess += sample > clamped ? sample - clamped : clamped - sample; \
+		audio[i] = (type)clamped; \
+	} \
+ \
+	clipped += excess >> (clip_shift); \
+ \
+	return clipped > INT32_MAX ? INT32_MAX : (int)clipped; \
+}
+
+DEFINE_APPLY(apply_int16, int16_t, int, -32768, 32767, 0)
+DEFINE_APPLY(apply_int24, int32_t, int64_t, -0x800000, 0x7fffff, 8)
+DEFINE_APPLY(apply_int32, int32_t, int64_t, (int64_t)INT32_MIN, INT32_MAX, 16)
+
+static int apply_float(float *audio, unsigned int count,
+		       const struct CompressorPass *pass)
+{
+	float curGain = pass->curGain / 1024.f;
+	const float delta = pass->delta / 1024.f;
+	unsigned int ramp = pass->ramp < count ? pass->ramp : count;
+	float clipped = 0;
+	size_t i;
+
+	for (i = 0; i < ramp; i++) {
+		float sample = audio[i] * curGain;
+		if (sample < -1.f) {
+			clipped += -1.f - sample;
+			sample = -1.f;
+		} else if (sample > 1.f) {
+			clipped += sample - 1.f;
+			sample = 1.f;
 		}
-		*ap++ = sample;
+		audio[i] = sample;
+		curGain += delta;
+	}
+
+	curGain = pass->newGain / 1024.f;
 
-                //! Adjust the gain
-                if (i < ramp)
-                        curGain += delta;
-                else
-                        curGain = newGain;
+	for (; i < count; i++) {
+		float sample = audio[i] * curGain;
+		float clamped = sample < -1.f ? -1.f : sample;
+		clamped = clamped > 1.f ? 1.f : clamped;
+		float excess = sample - clamped;
+		clipped += excess < 0 ? -excess : excess;
+		audio[i] = clamped;
 	}
 
-        obj->pos = slot;
+	clipped *= 32768.f;
+	return clipped > (float)INT32_MAX ? INT32_MAX : (int)clipped;
 }
 
+void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
+                              unsigned int count)
+{
+	struct CompressorPass pass;
+
+	const int peak = peak_int16(audio, count);
+	if (Compressor_beginPass(obj, &pass, peak, count))
+		Compressor_truncateRamp(&pass,
+					peak_pos_int16(audio, count, peak));
+
+	obj->clipped[pass.slot] = apply_int16(audio, count, &pass);
+	obj->pos = pass.slot;
+}
+
+void Compressor_Process_int24(struct Compressor *obj, int32_t *audio,
+			      unsigned int count)
+{
+	struct CompressorPass pass;
+
+	const int64_t peak = peak_int32(audio, count);
+	if (Compressor_beginPass(obj, &pass, (int)(peak >> 8), count))
+		Compressor_truncateRamp(&pass,
+					peak_pos_int32(audio, count, peak));
+
+	obj->clipped[pass.slot] = apply_int24(audio, count, &pass);
+	obj->pos = pass.slot;
+}
+
+void Compressor_Process_int32(struct Compressor *obj, int32_t *audio,
+			      unsigned int count)
+{
+	struct CompressorPass pass;
+
+	const int64_t peak = peak_int32(audio, count);
+	if (Compressor_beginPass(obj, &pass, (int)(peak >> 16), count))
+		Compressor_truncateRamp(&pass,
+					peak_pos_int32(audio, count, peak));
+
+	obj->clipped[pass.slot] = apply_int32(audio, count, &pass);
+	obj->pos = pass.slot;
+}
+
+void Compressor_Process_float(struct Compressor *obj, float *audio,
+			      unsigned int count)
+{
+	struct CompressorPass pass;
+
+	float peak = peak_float(audio, count);
+	if (peak > 1.f)
+		peak = 1.f;
+
+	if (Compressor_beginPass(obj, &pass, (int)(peak * 32767.f), count))
+		Compressor_truncateRamp(&pass,
+					peak_pos_float(audio, count, peak));
+
+	obj->clipped[pass.slot] = apply_float(audio, count, &pass);
+	obj->pos = pass.slot;
+}
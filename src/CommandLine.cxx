@@ -241,6 +241,9 @@ static void version(void)
 #ifdef ENABLE_INOTIFY
 	       " inotify"
 #endif
+#ifdef USE_IO_URING
+	       " io_uring"
+#endif
 #ifdef HAVE_IPV6
 	       " ipv6"
 #endif
@@ -35,33 +35,11 @@ IcyMetaDataParser::Reset() noexcept
 	if (!IsDefined())
 		return;
 
-	if (data_rest == 0 && meta_size > 0)
-		delete[] meta_data;
-
 	tag.reset();
 
 	data_rest = data_size;
 	meta_size = 0;
-}
-
-size_t
-IcyMetaDataParser::Data(size_t length) noexcept
-{
-	assert(length > 0);
-
-	if (!IsDefined())
-		return length;
-
-	if (data_rest == 0)
-		return 0;
-
-	if (length >= data_rest) {
-		length = data_rest;
-		data_rest = 0;
-	} else
-		data_rest -= length;
-
-	return length;
+	previous_meta_size = 0;
 }
 
 static void
@@ -133,7 +111,7 @@ icy_parse_tag(char *p, char *const end) noexcept
 		*eq = 0;
 		p = eq + 1;
 
-		if (*p != '\'') {
+		if (p == end || *p != '\'') {
 			/* syntax error; skip to the next semicolon,
 			   try to recover */
 			char *semicolon = std::find(p, end, ';');
@@ -187,10 +165,8 @@ IcyMetaDataParser::Meta(const void *data, size_t length) noexcept
 		   return value */
 		--length;
 
-		/* initialize metadata reader, allocate enough
-		   memory (+1 for the null terminator) */
+		/* initialize metadata reader */
 		meta_position = 0;
-		meta_data = new char[meta_size + 1];
 	}
 
 	assert(meta_position < meta_size);
@@ -206,10 +182,16 @@ IcyMetaDataParser::Meta(const void *data, size_t length) noexcept
 		++length;
 
 	if (meta_position == meta_size) {
-		/* parse */
-
-		tag = icy_parse_tag(meta_data, meta_data + meta_size);
-		delete[] meta_data;
+		if (meta_size != previous_meta_size ||
+		    memcmp(meta_data, previous_meta_data, meta_size) != 0) {
+			/* the metadata has changed; save a copy
+			   before parsing, because the parser
+			   modifies the buffer */
+			memcpy(previous_meta_data, meta_data, meta_size);
+			previous_meta_size = meta_size;
+
+			tag = icy_parse_tag(meta_data, meta_data + meta_size);
+		}
 
 		/* change back to normal data mode */
 
@@ -230,7 +212,8 @@ IcyMetaDataParser::ParseInPlace(void *data, size_t length) noexcept
 	while (length > 0) {
 		size_t chunk = Data(length);
 		if (chunk > 0) {
-			memmove(dest, src, chunk);
+			if (dest != src)
+				memmove(dest, src, chunk);
 			dest += chunk;
 			src += chunk;
 			length -= chunk;
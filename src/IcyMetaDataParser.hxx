@@ -24,21 +24,40 @@
 
 #include <memory>
 
+#include <assert.h>
 #include <stddef.h>
 
 class IcyMetaDataParser {
+	/**
+	 * The largest possible metadata block: its length byte is
+	 * multiplied by 16.
+	 */
+	static constexpr size_t MAX_META_SIZE = 255 * 16;
+
 	size_t data_size = 0, data_rest;
 
 	size_t meta_size, meta_position;
-	char *meta_data;
+
+	/**
+	 * The metadata block which is currently being received.
+	 */
+	char meta_data[MAX_META_SIZE];
+
+	/**
+	 * A copy of the most recent metadata block which was parsed.
+	 * Most stations repeat the same block at every interval;
+	 * those are not parsed again.
+	 */
+	char previous_meta_data[MAX_META_SIZE];
+
+	/**
+	 * The size of #previous_meta_data; 0 if there is none.
+	 */
+	size_t previous_meta_size = 0;
 
 	std::unique_ptr<Tag> tag;
 
 public:
-	~IcyMetaDataParser() noexcept {
-		Reset();
-	}
-
 	/**
 	 * Initialize an enabled icy_metadata object with the specified
 	 * data_size (from the icy-metaint HTTP response header).
@@ -46,6 +65,7 @@ public:
 	void Start(size_t _data_size) noexcept {
 		data_size = data_rest = _data_size;
 		meta_size = 0;
+		previous_meta_size = 0;
 		tag = nullptr;
 	}
 
@@ -67,7 +87,23 @@ public:
 	 * return value is smaller than "length", the caller should invoke
 	 * icy_meta().
 	 */
-	size_t Data(size_t length) noexcept;
+	size_t Data(size_t length) noexcept {
+		assert(length > 0);
+
+		if (!IsDefined())
+			return length;
+
+		if (data_rest == 0)
+			return 0;
+
+		if (length >= data_rest) {
+			length = data_rest;
+			data_rest = 0;
+		} else
+			data_rest -= length;
+
+		return length;
+	}
 
 	/**
 	 * Reads metadata from the stream.  Returns the number of bytes
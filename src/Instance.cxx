@@ -22,6 +22,8 @@
 #include "Partition.hxx"
 #include "Idle.hxx"
 #include "Stats.hxx"
+#include "metrics/Server.hxx"
+#include "MemoryBudget.hxx"
 
 #ifdef ENABLE_CURL
 #include "RemoteTagCache.hxx"
@@ -31,6 +33,7 @@
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseError.hxx"
 #include "db/Interface.hxx"
+#include "db/QueryCache.hxx"
 #include "db/update/Service.hxx"
 #include "storage/StorageInterface.hxx"
 
@@ -96,6 +99,9 @@ Instance::OnDatabaseModified()
 
 	stats_invalidate();
 
+	if (query_cache != nullptr)
+		query_cache->Clear();
+
 	for (auto &partition : partitions)
 		partition.DatabaseModified(*database);
 }
@@ -144,16 +150,21 @@ Instance::LostNeighbor(gcc_unused const NeighborInfo &info) noexcept
 void
 Instance::LookupRemoteTag(const char *uri) noexcept
 {
-	if (!uri_has_scheme(uri))
+	if (!uri_has_scheme(uri) || !remote_tag_cache)
 		return;
 
-	if (!remote_tag_cache)
-		remote_tag_cache = std::make_unique<RemoteTagCache>(event_loop,
-								    *this);
-
 	remote_tag_cache->Lookup(uri);
 }
 
+void
+Instance::PrioritizeRemoteTag(const char *uri) noexcept
+{
+	if (!uri_has_scheme(uri) || !remote_tag_cache)
+		return;
+
+	remote_tag_cache->Prioritize(uri);
+}
+
 void
 Instance::OnRemoteTag(const char *uri, const Tag &tag) noexcept
 {
@@ -44,8 +44,10 @@ class NeighborGlue;
 class Database;
 class Storage;
 class UpdateService;
+class DatabaseQueryCache;
 #endif
 
+#include <atomic>
 #include <memory>
 #include <list>
 
@@ -53,6 +55,8 @@ class ClientList;
 struct Partition;
 class StateFile;
 class RemoteTagCache;
+class MetricsServer;
+class MemoryBudget;
 
 /**
  * A utility class which, when used as the first base class, ensures
@@ -99,6 +103,15 @@ struct Instance final
 
 	MaskMonitor idle_monitor;
 
+	/**
+	 * Incremented by each EmitIdle() call.  Cached responses
+	 * (see #StatusCache) compare it to find out whether they are
+	 * still up to date.  EmitIdle() is called synchronously by
+	 * every state change, unlike the deferred #idle_monitor
+	 * callback.
+	 */
+	std::atomic<unsigned> idle_generation{0};
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	NeighborGlue *neighbors;
 #endif
@@ -113,6 +126,12 @@ struct Instance final
 	Storage *storage = nullptr;
 
 	UpdateService *update = nullptr;
+
+	/**
+	 * Caches the responses of database queries; nullptr if
+	 * disabled.  It is cleared by OnDatabaseModified().
+	 */
+	std::unique_ptr<DatabaseQueryCache> query_cache;
 #endif
 
 #ifdef ENABLE_CURL
@@ -125,6 +144,18 @@ struct Instance final
 
 	StateFile *state_file = nullptr;
 
+	/**
+	 * The HTTP server for the "metrics_port" setting; nullptr if
+	 * disabled.
+	 */
+	std::unique_ptr<MetricsServer> metrics_server;
+
+	/**
+	 * Watches the "memory_budget" setting; nullptr if no budget
+	 * is configured.
+	 */
+	std::unique_ptr<MemoryBudget> memory_budget;
+
 	Instance();
 	~Instance() noexcept;
 
@@ -136,6 +167,7 @@ struct Instance final
 	}
 
 	void EmitIdle(unsigned mask) {
+		++idle_generation;
 		idle_monitor.OrMask(mask);
 	}
 
@@ -170,10 +202,21 @@ struct Instance final
 
 #ifdef ENABLE_CURL
 	void LookupRemoteTag(const char *uri) noexcept;
+
+	/**
+	 * Scan the tags of this URI before other queued ones (if it
+	 * was passed to LookupRemoteTag() and is not being scanned
+	 * yet).
+	 */
+	void PrioritizeRemoteTag(const char *uri) noexcept;
 #else
 	void LookupRemoteTag(const char *) noexcept {
 		/* no-op */
 	}
+
+	void PrioritizeRemoteTag(const char *) noexcept {
+		/* no-op */
+	}
 #endif
 
 private:
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_LATENCY_HISTOGRAM_HXX
+#define MPD_LATENCY_HISTOGRAM_HXX
+
+#include "util/Compiler.h"
+
+#include <array>
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * A histogram of durations with logarithmic buckets: bucket i counts
+ * durations of 2^i up to 2^(i+1) microseconds.  The first bucket also
+ * counts shorter durations, and the last one longer durations.
+ *
+ * This class is not thread-safe.
+ */
+class LatencyHistogram {
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The number of buckets; the last one begins at 2^23
+	 * microseconds (about 8 seconds).
+	 */
+	static constexpr unsigned N_BUCKETS = 24;
+
+private:
+	std::array<uint64_t, N_BUCKETS> buckets{};
+
+	uint64_t count = 0;
+
+	Duration sum = Duration::zero(), max = Duration::zero();
+
+public:
+	void Add(Duration d) noexcept {
+		if (d < Duration::zero())
+			d = Duration::zero();
+
+		const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+
+		unsigned i = 0;
+		while (i < N_BUCKETS - 1 && (us >> (i + 1)) > 0)
+			++i;
+
+		++buckets[i];
+		++count;
+		sum += d;
+		if (d > max)
+			max = d;
+	}
+
+	/**
+	 * Add all durations recorded by another instance.
+	 */
+	void Merge(const LatencyHistogram &other) noexcept {
+		for (unsigned i = 0; i < N_BUCKETS; ++i)
+			buckets[i] += other.buckets[i];
+		count += other.count;
+		sum += other.sum;
+		if (other.max > max)
+			max = other.max;
+	}
+
+	uint64_t GetCount() const noexcept {
+		return count;
+	}
+
+	/**
+	 * Returns the number of durations in the given bucket.
+	 */
+	uint64_t GetBucket(unsigned i) const noexcept {
+		return buckets[i];
+	}
+
+	/**
+	 * Returns the (exclusive) upper bound of the given bucket;
+	 * the last bucket has no upper bound.
+	 */
+	static constexpr Duration GetBucketUpperBound(unsigned i) noexcept {
+		return std::chrono::microseconds(uint64_t(2) << i);
+	}
+
+	Duration GetSum() const noexcept {
+		return sum;
+	}
+
+	Duration GetAverage() const noexcept {
+		return count > 0
+			? Duration(sum.count() / Duration::rep(count))
+			: Duration::zero();
+	}
+
+	Duration GetMax() const noexcept {
+		return max;
+	}
+
+	/**
+	 * Estimate the given quantile (0..1).  The result is the
+	 * upper bound of the bucket containing the quantile, but not
+	 * more than the maximum.
+	 */
+	gcc_pure
+	Duration GetQuantile(double q) const noexcept {
+		if (count == 0)
+			return Duration::zero();
+
+		const uint64_t target = q * count;
+		uint64_t n = 0;
+		for (unsigned i = 0; i < N_BUCKETS - 1; ++i) {
+			n += buckets[i];
+			if (n > target) {
+				const Duration upper =
+					std::chrono::microseconds(uint64_t(2) << i);
+				return upper < max ? upper : max;
+			}
+		}
+
+		return max;
+	}
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "LatencyPrint.hxx"
+#include "LatencyHistogram.hxx"
+#include "client/Response.hxx"
+
+static double
+ToMS(LatencyHistogram::Duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(d).count();
+}
+
+void
+latency_print(Response &r, const char *prefix, const LatencyHistogram &h)
+{
+	r.Format("%s_count: %llu\n"
+		 "%s_avg: %1.3f\n"
+		 "%s_p50: %1.3f\n"
+		 "%s_p99: %1.3f\n"
+		 "%s_max: %1.3f\n",
+		 prefix, (unsigned long long)h.GetCount(),
+		 prefix, ToMS(h.GetAverage()),
+		 prefix, ToMS(h.GetQuantile(0.5)),
+		 prefix, ToMS(h.GetQuantile(0.99)),
+		 prefix, ToMS(h.GetMax()));
+}
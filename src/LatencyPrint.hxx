@@ -0,0 +1,36 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_LATENCY_PRINT_HXX
+#define MPD_LATENCY_PRINT_HXX
+
+class Response;
+class LatencyHistogram;
+
+/**
+ * Write the summary of a #LatencyHistogram to the client: the
+ * number of samples, average, median, 99th percentile and maximum,
+ * each in a line starting with the given prefix.  Durations are in
+ * milliseconds.
+ */
+void
+latency_print(Response &r, const char *prefix, const LatencyHistogram &h);
+
+#endif
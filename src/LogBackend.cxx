@@ -23,6 +23,18 @@
 #include "util/StringStrip.hxx"
 #include "config.h"
 
+#ifndef ANDROID
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
+#include "util/TruncateString.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#endif
+
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -86,12 +98,12 @@ EnableLogTimestamp() noexcept
 	enable_timestamp = true;
 }
 
+static constexpr size_t LOG_DATE_BUF_SIZE = 16;
+
 static const char *
-log_date() noexcept
+log_date(char *buf, std::chrono::system_clock::time_point time) noexcept
 {
-	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
-	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
+	time_t t = std::chrono::system_clock::to_time_t(time);
 	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
 	return buf;
 }
@@ -135,10 +147,10 @@ ToSysLogLevel(LogLevel log_level) noexcept
 }
 
 static void
-SysLog(const Domain &domain, LogLevel log_level, const char *message) noexcept
+SysLog(const char *domain, LogLevel log_level, const char *message) noexcept
 {
 	syslog(ToSysLogLevel(log_level), "%s: %.*s",
-	       domain.GetName(),
+	       domain,
 	       chomp_length(message), message);
 }
 
@@ -159,11 +171,14 @@ LogFinishSysLog() noexcept
 #endif
 
 static void
-FileLog(const Domain &domain, const char *message) noexcept
+FileLog(const char *domain, const char *message,
+	std::chrono::system_clock::time_point time) noexcept
 {
+	char date_buffer[LOG_DATE_BUF_SIZE];
+
 	fprintf(stderr, "%s%s: %.*s\n",
-		enable_timestamp ? log_date() : "",
-		domain.GetName(),
+		enable_timestamp ? log_date(date_buffer, time) : "",
+		domain,
 		chomp_length(message), message);
 
 #ifdef _WIN32
@@ -173,6 +188,350 @@ FileLog(const Domain &domain, const char *message) noexcept
 #endif
 }
 
+static void
+WriteLog(const char *domain, LogLevel level, const char *message,
+	 std::chrono::system_clock::time_point time) noexcept
+{
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		/* syslog adds its own timestamp */
+		(void)time;
+		SysLog(domain, level, message);
+		return;
+	}
+#endif
+
+	FileLog(domain, message, time);
+}
+
+/**
+ * Writes log messages in a dedicated thread, so threads which log
+ * (e.g. the decoder and output threads) never block on a slow log
+ * file, terminal or journal.
+ *
+ * Messages are passed through a fixed-size lock-free ring buffer
+ * (Dmitry Vyukov's bounded queue with per-slot sequence numbers).
+ * Producers only take a lock to wake up the thread when it is
+ * idle.  If the ring is full, the message is dropped and counted.
+ */
+class LogThread {
+	/**
+	 * The number of slots in the ring; must be a power of two.
+	 */
+	static constexpr size_t N_SLOTS = 512;
+
+	/**
+	 * Identical messages within this duration are collapsed
+	 * into "last message repeated N times".
+	 */
+	static constexpr std::chrono::seconds REPEAT_INTERVAL{10};
+
+	struct Record {
+		/**
+		 * The time this message was submitted, not when it
+		 * was written.
+		 */
+		std::chrono::system_clock::time_point time;
+
+		LogLevel level;
+
+		/**
+		 * A copy of Domain::GetName(); some domains are
+		 * constructed on the fly and do not outlive the
+		 * Log() call.
+		 */
+		char domain[64];
+
+		/**
+		 * The message, truncated if it does not fit.
+		 */
+		char message[1024];
+
+		bool operator==(const Record &other) const noexcept {
+			return level == other.level &&
+				strcmp(domain, other.domain) == 0 &&
+				strcmp(message, other.message) == 0;
+		}
+	};
+
+	struct Slot {
+		/**
+		 * Equals the enqueue position when the slot is free,
+		 * and the position plus one once #record is filled.
+		 */
+		std::atomic_size_t sequence;
+
+		Record record;
+	};
+
+	const std::unique_ptr<Slot[]> slots{new Slot[N_SLOTS]};
+
+	std::atomic_size_t enqueue_position{0};
+
+	/**
+	 * Only accessed by the thread.
+	 */
+	size_t dequeue_position = 0;
+
+	/**
+	 * The number of messages dropped because the ring was full.
+	 */
+	std::atomic_uint dropped{0};
+
+	/**
+	 * Is the thread waiting for #cond?  Producers take the
+	 * #mutex only if this is set.
+	 */
+	std::atomic_bool idle{false};
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	bool quit = false;
+
+	/**
+	 * The last message which was written, for suppressing
+	 * repeated messages.  Only accessed by the thread.
+	 */
+	Record last;
+	bool have_last = false;
+	unsigned repeated = 0;
+	std::chrono::steady_clock::time_point last_written;
+
+	Thread thread;
+
+public:
+	LogThread() noexcept
+		:thread(BIND_THIS_METHOD(Run))
+	{
+		for (size_t i = 0; i < N_SLOTS; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~LogThread() noexcept {
+		if (thread.IsDefined())
+			Stop();
+	}
+
+	LogThread(const LogThread &) = delete;
+	LogThread &operator=(const LogThread &) = delete;
+
+	void Start() {
+		thread.Start();
+	}
+
+	/**
+	 * Write all pending messages and join the thread.
+	 */
+	void Stop() noexcept {
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			quit = true;
+			cond.signal();
+		}
+
+		thread.Join();
+	}
+
+	/**
+	 * Submit a message.  This method is thread-safe and
+	 * lock-free (unless the log thread is idle and needs to be
+	 * woken up).
+	 */
+	void Push(const Domain &domain, LogLevel level,
+		  const char *message) noexcept;
+
+private:
+	bool Pop(Record &dest) noexcept;
+
+	void Write(const Record &record) noexcept;
+	void FlushRepeated() noexcept;
+
+	void Run() noexcept;
+};
+
+constexpr size_t LogThread::N_SLOTS;
+constexpr std::chrono::seconds LogThread::REPEAT_INTERVAL;
+
+void
+LogThread::Push(const Domain &domain, LogLevel level,
+		const char *message) noexcept
+{
+	const auto now = std::chrono::system_clock::now();
+
+	size_t position = enqueue_position.load(std::memory_order_relaxed);
+	Slot *slot;
+
+	while (true) {
+		slot = &slots[position & (N_SLOTS - 1)];
+		const size_t sequence =
+			slot->sequence.load(std::memory_order_acquire);
+		const auto delta = ptrdiff_t(sequence) - ptrdiff_t(position);
+
+		if (delta == 0) {
+			if (enqueue_position.compare_exchange_weak(position,
+								   position + 1,
+								   std::memory_order_relaxed))
+				break;
+		} else if (delta < 0) {
+			/* the ring is full; don't block the caller */
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else
+			position = enqueue_position.load(std::memory_order_relaxed);
+	}
+
+	auto &r = slot->record;
+	r.time = now;
+	r.level = level;
+	CopyTruncateString(r.domain, domain.GetName(), sizeof(r.domain));
+	CopyTruncateString(r.message, message, sizeof(r.message));
+
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	if (idle.exchange(false)) {
+		const std::lock_guard<Mutex> lock(mutex);
+		cond.signal();
+	}
+}
+
+inline bool
+LogThread::Pop(Record &dest) noexcept
+{
+	auto &slot = slots[dequeue_position & (N_SLOTS - 1)];
+	if (slot.sequence.load(std::memory_order_acquire) !=
+	    dequeue_position + 1)
+		return false;
+
+	dest = slot.record;
+
+	slot.sequence.store(dequeue_position + N_SLOTS,
+			    std::memory_order_release);
+	++dequeue_position;
+	return true;
+}
+
+void
+LogThread::FlushRepeated() noexcept
+{
+	if (repeated == 0)
+		return;
+
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "last message repeated %u times",
+		 repeated);
+	WriteLog(last.domain, last.level, buffer,
+		 std::chrono::system_clock::now());
+	repeated = 0;
+}
+
+void
+LogThread::Write(const Record &record) noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	if (have_last && record == last &&
+	    now < last_written + REPEAT_INTERVAL) {
+		++repeated;
+		return;
+	}
+
+	FlushRepeated();
+
+	WriteLog(record.domain, record.level, record.message, record.time);
+
+	last = record;
+	have_last = true;
+	last_written = now;
+}
+
+void
+LogThread::Run() noexcept
+{
+	SetThreadName("log");
+
+	Record record;
+
+	while (true) {
+		while (Pop(record))
+			Write(record);
+
+		const unsigned n_dropped =
+			dropped.exchange(0, std::memory_order_relaxed);
+		if (n_dropped > 0) {
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer),
+				 "%u log messages dropped", n_dropped);
+			FlushRepeated();
+			WriteLog("log", LogLevel::WARNING, buffer,
+				 std::chrono::system_clock::now());
+		}
+
+		idle.store(true);
+
+		/* check again after announcing that we're idle, or a
+		   wakeup may get lost */
+		if (Pop(record)) {
+			idle.store(false);
+			Write(record);
+			continue;
+		}
+
+		const std::lock_guard<Mutex> lock(mutex);
+		if (quit) {
+			idle.store(false);
+			break;
+		}
+
+		if (!idle.load())
+			continue;
+
+		if (repeated > 0) {
+			/* wake up to report the repeated messages */
+			if (!cond.timed_wait(mutex, REPEAT_INTERVAL) &&
+			    idle.load()) {
+				const ScopeUnlock unlock(mutex);
+				FlushRepeated();
+			}
+		} else
+			cond.wait(mutex);
+
+		idle.store(false);
+	}
+
+	/* drain the messages submitted until Stop() */
+	while (Pop(record))
+		Write(record);
+
+	FlushRepeated();
+	fflush(stderr);
+}
+
+static std::unique_ptr<LogThread> log_thread;
+
+void
+StartLogThread()
+{
+	assert(!log_thread);
+
+	auto t = std::make_unique<LogThread>();
+	t->Start();
+	log_thread = std::move(t);
+}
+
+void
+StopLogThread() noexcept
+{
+	if (!log_thread)
+		return;
+
+	log_thread->Stop();
+	log_thread.reset();
+}
+
 #endif /* !ANDROID */
 
 void
@@ -189,13 +548,12 @@ Log(const Domain &domain, LogLevel level, const char *msg) noexcept
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
+	if (log_thread) {
+		log_thread->Push(domain, level, msg);
 		return;
 	}
-#endif
 
-	FileLog(domain, msg);
+	WriteLog(domain.GetName(), level, msg,
+		 std::chrono::system_clock::now());
 #endif /* !ANDROID */
 }
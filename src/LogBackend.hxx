@@ -34,4 +34,21 @@ LogInitSysLog() noexcept;
 void
 LogFinishSysLog() noexcept;
 
+/**
+ * From now on, write log messages in a separate thread; Log() only
+ * queues them.  Must be called after the process has been
+ * daemonized.
+ *
+ * Throws on error.
+ */
+void
+StartLogThread();
+
+/**
+ * Write all queued log messages and stop the log thread; Log()
+ * writes synchronously again.
+ */
+void
+StopLogThread() noexcept;
+
 #endif /* LOG_H */
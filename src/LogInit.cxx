@@ -184,14 +184,17 @@ void
 log_deinit() noexcept
 {
 #ifndef ANDROID
+	StopLogThread();
 	close_log_files();
 	out_path = nullptr;
 #endif
 }
 
-void setup_log_output()
-{
 #ifndef ANDROID
+
+static void
+redirect_log_output()
+{
 	if (out_fd == STDOUT_FILENO)
 		return;
 
@@ -210,6 +213,18 @@ void setup_log_output()
 	redirect_logs(out_fd);
 	close(out_fd);
 	out_fd = -1;
+}
+
+#endif
+
+void setup_log_output()
+{
+#ifndef ANDROID
+	redirect_log_output();
+
+	/* from now on, no thread shall block on writing log
+	   messages */
+	StartLogThread();
 #endif
 }
 
@@ -22,8 +22,11 @@
 #include "Instance.hxx"
 #include "CommandLine.hxx"
 #include "PlaylistFile.hxx"
+#include "ThreadConfig.hxx"
 #include "MusicChunk.hxx"
 #include "StateFile.hxx"
+#include "PictureCache.hxx"
+#include "TraceFile.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
@@ -35,6 +38,8 @@
 #include "tag/Config.hxx"
 #include "ReplayGainGlobal.hxx"
 #include "Idle.hxx"
+#include "metrics/Server.hxx"
+#include "MemoryBudget.hxx"
 #include "Log.hxx"
 #include "LogInit.hxx"
 #include "input/Init.hxx"
@@ -48,6 +53,7 @@
 #include "pcm/PcmConvert.hxx"
 #include "unix/SignalHandlers.hxx"
 #include "thread/Slack.hxx"
+#include "thread/BackgroundTask.hxx"
 #include "net/Init.hxx"
 #include "lib/icu/Init.hxx"
 #include "config/File.hxx"
@@ -67,6 +73,7 @@
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
+#include "db/QueryCache.hxx"
 #include "db/Configured.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
@@ -83,12 +90,18 @@
 
 #ifdef ENABLE_SQLITE
 #include "sticker/StickerDatabase.hxx"
+#include "sticker/SongSticker.hxx"
+#include "song/StickerSongFilter.hxx"
 #endif
 
 #ifdef ENABLE_ARCHIVE
 #include "archive/ArchiveList.hxx"
 #endif
 
+#ifdef ENABLE_CURL
+#include "RemoteTagCache.hxx"
+#endif
+
 #ifdef ANDROID
 #include "java/Global.hxx"
 #include "java/File.hxx"
@@ -108,6 +121,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
@@ -120,6 +134,8 @@ static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
 
 static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * MEGABYTE;
 
+static constexpr size_t MAX_CHUNK_SIZE = MEGABYTE;
+
 static constexpr
 size_t MIN_BUFFER_SIZE = std::max(CHUNK_SIZE * 32,
 				  64 * KILOBYTE);
@@ -216,10 +232,20 @@ glue_db_init_and_load(const ConfigData &config)
 		std::throw_with_nested(std::runtime_error("Failed to open database plugin"));
 	}
 
+	const size_t query_cache_size =
+		config.GetUnsigned(ConfigOption::QUERY_CACHE_SIZE, 0);
+	if (query_cache_size > 0)
+		instance->query_cache.reset(new DatabaseQueryCache(query_cache_size * 1024));
+
 	auto *db = dynamic_cast<SimpleDatabase *>(instance->database);
 	if (db == nullptr)
 		return true;
 
+	if (db->IsReplica())
+		/* a replica loads the snapshots written by another
+		   instance; it never runs an update itself */
+		return true;
+
 	instance->update = new UpdateService(config,
 					     instance->event_loop, *db,
 					     static_cast<CompositeStorage &>(*instance->storage),
@@ -249,12 +275,37 @@ glue_sticker_init(const ConfigData &config)
 	if (sticker_file.IsNull())
 		return;
 
-	sticker_global_init(std::move(sticker_file));
+	sticker_global_init(std::move(sticker_file),
+			    config.GetString(ConfigOption::STICKER_SYNCHRONOUS,
+					     "normal"));
+	StickerSongFilter::finder = sticker_song_find_uris;
 #else
 	(void)config;
 #endif
 }
 
+/**
+ * Configure the cache of embedded pictures.
+ */
+static void
+glue_picture_cache_init(const ConfigData &config)
+{
+	auto directory = config.GetPath(ConfigOption::PICTURE_CACHE_DIRECTORY);
+	if (directory.IsNull())
+		return;
+
+	picture_cache = new PictureCache(std::move(directory));
+}
+
+/**
+ * Configure the destination of the "trace save" command.
+ */
+static void
+glue_trace_init(const ConfigData &config)
+{
+	trace_file = config.GetPath(ConfigOption::TRACE_FILE);
+}
+
 static void
 glue_state_file_init(const ConfigData &raw_config)
 {
@@ -268,6 +319,19 @@ glue_state_file_init(const ConfigData &raw_config)
 	instance->state_file->Read();
 }
 
+static HugePageMode
+ParseHugePageMode(const char *s)
+{
+	if (strcmp(s, "no") == 0)
+		return HugePageMode::NONE;
+	else if (strcmp(s, "transparent") == 0)
+		return HugePageMode::TRANSPARENT;
+	else if (strcmp(s, "explicit") == 0)
+		return HugePageMode::EXPLICIT;
+	else
+		throw FormatRuntimeError("Invalid huge page mode: %s", s);
+}
+
 /**
  * Initialize the decoder and player core, including the music pipe.
  */
@@ -297,12 +361,54 @@ initialize_decoder_and_player(const ConfigData &config,
 	} else
 		buffer_size = DEFAULT_BUFFER_SIZE;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	size_t chunk_size = CHUNK_SIZE;
+	param = config.GetParam(ConfigOption::AUDIO_CHUNK_SIZE);
+	if (param != nullptr) {
+		char *test;
+		long tmp = strtol(param->value.c_str(), &test, 10);
+		if (*test != '\0' || tmp <= 0 || tmp == LONG_MAX)
+			throw FormatRuntimeError("chunk size \"%s\" is not a "
+						 "positive integer, line %i",
+						 param->value.c_str(), param->line);
+
+		chunk_size = tmp * KILOBYTE;
+		if (chunk_size % CHUNK_SIZE != 0 || chunk_size > MAX_CHUNK_SIZE)
+			throw FormatRuntimeError("chunk size must be a multiple of %lu KiB up to %lu KiB, line %i",
+						 (unsigned long)(CHUNK_SIZE / KILOBYTE),
+						 (unsigned long)(MAX_CHUNK_SIZE / KILOBYTE),
+						 param->line);
+
+		if (buffer_size < chunk_size * 32) {
+			FormatWarning(config_domain, "buffer size %lu is too small for the chunk size, using %lu bytes instead",
+				      (unsigned long)buffer_size,
+				      (unsigned long)(chunk_size * 32));
+			buffer_size = chunk_size * 32;
+		}
+	}
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
 
 	if (buffered_chunks >= 1 << 15)
 		throw FormatRuntimeError("buffer size \"%lu\" is too big",
 					 (unsigned long)buffer_size);
 
+	MusicBufferConfig buffer_config;
+	param = config.GetParam(ConfigOption::AUDIO_BUFFER_HUGE_PAGES);
+	if (param != nullptr) {
+		try {
+			buffer_config.huge_pages =
+				ParseHugePageMode(param->value.c_str());
+		} catch (...) {
+			std::throw_with_nested(FormatRuntimeError("error parsing line %i",
+								  param->line));
+		}
+	}
+
+	buffer_config.lock =
+		config.GetBool(ConfigOption::AUDIO_BUFFER_LOCK, false);
+	buffer_config.prefault =
+		config.GetBool(ConfigOption::AUDIO_BUFFER_PREFAULT, false);
+
 	const unsigned max_length =
 		config.GetPositive(ConfigOption::MAX_PLAYLIST_LENGTH,
 				   DEFAULT_PLAYLIST_MAX_LENGTH);
@@ -319,10 +425,24 @@ initialize_decoder_and_player(const ConfigData &config,
 		}
 	}
 
+	const bool warm_decoder =
+		config.GetBool(ConfigOption::WARM_DECODER, false);
+	const bool low_latency =
+		config.GetBool(ConfigOption::LOW_LATENCY, false);
+	const bool gapless_convert =
+		config.GetBool(ConfigOption::GAPLESS_CONVERT, false);
+	const std::chrono::steady_clock::duration stream_tag_interval =
+		std::chrono::seconds(config.GetUnsigned(ConfigOption::STREAM_TAG_INTERVAL,
+							0));
+
 	instance->partitions.emplace_back(*instance,
 					  "default",
 					  max_length,
-					  buffered_chunks,
+					  buffered_chunks, chunk_size,
+					  buffer_config,
+					  warm_decoder, low_latency,
+					  gapless_convert,
+					  stream_tag_interval,
 					  configured_audio_format,
 					  replay_gain_config);
 	auto &partition = instance->partitions.back();
@@ -446,6 +566,11 @@ MainOrThrow(int argc, char *argv[])
 	AtScopeExit() {
 		delete instance;
 		instance = nullptr;
+
+		/* delete the picture cache after the update thread
+		   (which may use it) has been joined */
+		delete picture_cache;
+		picture_cache = nullptr;
 	};
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -468,6 +593,10 @@ MainOrThrow(int argc, char *argv[])
 
 	listen_global_init(raw_config, *instance->partitions.front().listener);
 
+	instance->metrics_server =
+		metrics_server_init(raw_config, instance->event_loop,
+				    *instance);
+
 #ifdef ENABLE_DAEMON
 	daemonize_set_user();
 	daemonize_begin(options.daemon);
@@ -502,21 +631,34 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 
 	initPermissions(raw_config);
 	spl_global_init(raw_config);
+	thread_config_global_init(raw_config);
 #ifdef ENABLE_ARCHIVE
 	const ScopeArchivePluginsInit archive_plugins_init;
 #endif
 
 	pcm_convert_global_init(raw_config);
 
-	const ScopeDecoderPluginsInit decoder_plugins_init(raw_config);
+	/* some decoder plugins take a while to initialize (e.g. by
+	   loading sound fonts); do this in a separate thread, while
+	   this thread loads the database and configures the audio
+	   outputs */
+	BackgroundTask decoder_plugins_init("decoder_init", [&raw_config](){
+			decoder_plugin_init_all(raw_config);
+		});
+	AtScopeExit(&decoder_plugins_init) {
+		decoder_plugins_init.Join();
+		decoder_plugin_deinit_all();
+	};
 
 #ifdef ENABLE_DATABASE
 	const bool create_db = InitDatabaseAndStorage(raw_config);
 #endif
 
 	glue_sticker_init(raw_config);
+	glue_picture_cache_init(raw_config);
+	glue_trace_init(raw_config);
 
-	command_init();
+	command_init(raw_config);
 
 	for (auto &partition : instance->partitions) {
 		partition.outputs.Configure(instance->rtio_thread.GetEventLoop(),
@@ -527,10 +669,36 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 	}
 
 	client_manager_init(raw_config);
+
+	/* the input plugins share libraries with the decoder plugins
+	   (e.g. FFmpeg), whose global initialization is not
+	   thread-safe; and everything from here on may use decoder
+	   plugins */
+	decoder_plugins_init.Wait();
+
 	const ScopeInputPluginsInit input_plugins_init(raw_config,
 						       instance->io_thread.GetEventLoop());
 	const ScopePlaylistPluginsInit playlist_plugins_init(raw_config);
 
+#ifdef ENABLE_CURL
+	instance->remote_tag_cache =
+		std::make_unique<RemoteTagCache>(instance->event_loop,
+						 *instance,
+						 raw_config.GetPositive(ConfigOption::REMOTE_TAG_SCANNERS,
+									4),
+						 raw_config.GetPath(ConfigOption::REMOTE_TAG_CACHE_FILE));
+	instance->remote_tag_cache->Load();
+#endif
+
+	const unsigned memory_budget =
+		raw_config.GetUnsigned(ConfigOption::MEMORY_BUDGET, 0);
+	if (memory_budget > 0) {
+		instance->memory_budget =
+			std::make_unique<MemoryBudget>(*instance,
+						       size_t(memory_budget) * 1024);
+		instance->memory_budget->Start();
+	}
+
 #ifdef ENABLE_DAEMON
 	daemonize_commit();
 #endif
@@ -551,6 +719,8 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 
 	ZeroconfInit(raw_config, instance->event_loop);
 
+	spl_watch_init(instance->event_loop);
+
 #ifdef ENABLE_DATABASE
 	if (create_db) {
 		/* the database failed to load: recreate the
@@ -581,7 +751,7 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 	Check(raw_config);
 
 	/* enable all audio outputs (if not already done by
-	   playlist_state_restore() */
+	   playlist_state_finish() */
 	for (auto &partition : instance->partitions)
 		partition.pc.LockUpdateAudio();
 
@@ -608,6 +778,13 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 
 	instance->BeginShutdownUpdate();
 
+#ifdef ENABLE_CURL
+	/* destroy the cache (and its scanners) before the input
+	   plugins are deinitialized */
+	instance->remote_tag_cache->Save();
+	instance->remote_tag_cache.reset();
+#endif
+
 	if (instance->state_file != nullptr) {
 		instance->state_file->Write();
 		delete instance->state_file;
@@ -615,8 +792,13 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 
 	ZeroconfDeinit();
 
+	spl_watch_finish();
+
 	instance->BeginShutdownPartitions();
 
+	instance->metrics_server.reset();
+	instance->memory_budget.reset();
+
 	delete instance->client_list;
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -627,6 +809,14 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 #endif
 
 #ifdef ENABLE_SQLITE
+#ifdef ENABLE_DATABASE
+	/* join the update thread (which may store fingerprints)
+	   before closing the sticker database */
+	delete instance->update;
+	instance->update = nullptr;
+#endif
+
+	StickerSongFilter::finder = nullptr;
 	sticker_global_finish();
 #endif
 
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MemoryBudget.hxx"
+#include "Instance.hxx"
+#include "client/Client.hxx"
+#include "input/AsyncInputStream.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/QueryCache.hxx"
+#endif
+
+#ifdef ENABLE_CURL
+#include "RemoteTagCache.hxx"
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+
+static constexpr Domain memory_budget_domain("memory_budget");
+
+/**
+ * How often is the resident memory checked?
+ */
+static constexpr std::chrono::steady_clock::duration CHECK_INTERVAL =
+	std::chrono::seconds(5);
+
+/**
+ * While the budget is exceeded, the #RemoteTagCache keeps at most
+ * this number of resolved items.
+ */
+static constexpr size_t SHRINK_REMOTE_TAG_CACHE = 256;
+
+/**
+ * While the budget is exceeded, input stream buffers are limited to
+ * this size.
+ */
+static constexpr size_t SHRINK_INPUT_BUFFER = 256 * 1024;
+
+size_t
+GetProcessResidentSize() noexcept
+{
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/statm", "re");
+	if (file == nullptr)
+		return 0;
+
+	unsigned long size, resident;
+	const bool success = fscanf(file, "%lu %lu", &size, &resident) == 2;
+	fclose(file);
+	if (!success)
+		return 0;
+
+	return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif
+}
+
+MemoryBudget::MemoryBudget(Instance &_instance, size_t _budget) noexcept
+	:instance(_instance), budget(_budget),
+	 timer(_instance.event_loop, BIND_THIS_METHOD(OnTimer)),
+	 saved_client_output_limit(client_output_pool.GetLimit())
+{
+}
+
+void
+MemoryBudget::Start() noexcept
+{
+	if (GetProcessResidentSize() == 0) {
+		LogWarning(memory_budget_domain,
+			   "Cannot determine the memory usage on this platform");
+		return;
+	}
+
+	timer.Schedule(CHECK_INTERVAL);
+}
+
+void
+MemoryBudget::Shrink(size_t resident) noexcept
+{
+	if (!under_pressure) {
+		FormatWarning(memory_budget_domain,
+			      "Memory usage (%zu kB) exceeds the budget (%zu kB), shrinking caches",
+			      resident / 1024, budget / 1024);
+		under_pressure = true;
+
+		/* throttle clients which generate large
+		   responses */
+		const size_t client_limit = budget / 8;
+		if (saved_client_output_limit == 0 ||
+		    saved_client_output_limit > client_limit)
+			client_output_pool.SetLimit(client_limit);
+
+		AsyncInputStream::SetCapacityLimit(SHRINK_INPUT_BUFFER);
+	}
+
+	/* these caches may have grown again since the last check */
+
+#ifdef ENABLE_DATABASE
+	if (instance.query_cache != nullptr)
+		instance.query_cache->Clear();
+#endif
+
+#ifdef ENABLE_CURL
+	if (instance.remote_tag_cache != nullptr)
+		instance.remote_tag_cache->Shrink(SHRINK_REMOTE_TAG_CACHE);
+#endif
+
+	client_output_pool.DiscardIdle();
+
+#ifdef __GLIBC__
+	/* return the freed memory to the kernel */
+	malloc_trim(0);
+#endif
+}
+
+void
+MemoryBudget::Relax() noexcept
+{
+	LogInfo(memory_budget_domain,
+		"Memory usage is below the budget again");
+	under_pressure = false;
+
+	client_output_pool.SetLimit(saved_client_output_limit);
+	AsyncInputStream::SetCapacityLimit(0);
+}
+
+void
+MemoryBudget::OnTimer() noexcept
+{
+	const size_t resident = GetProcessResidentSize();
+
+	if (resident > budget)
+		Shrink(resident);
+	else if (under_pressure && resident < budget / 8 * 7)
+		/* with some hysteresis, to avoid flapping */
+		Relax();
+
+	timer.Schedule(CHECK_INTERVAL);
+}
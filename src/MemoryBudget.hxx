@@ -0,0 +1,82 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MEMORY_BUDGET_HXX
+#define MPD_MEMORY_BUDGET_HXX
+
+#include "event/TimerEvent.hxx"
+
+#include <stddef.h>
+
+struct Instance;
+
+/**
+ * Returns the resident memory of this process in bytes, or 0 if
+ * that is not known on this platform.
+ */
+size_t
+GetProcessResidentSize() noexcept;
+
+/**
+ * Periodically compares the resident memory of the MPD process with
+ * the "memory_budget" setting.  While it is exceeded, caches are
+ * shrunk and buffers for new data are made smaller; once memory use
+ * has dropped well below the budget, the normal limits are
+ * restored.
+ *
+ * This class is not thread-safe; it lives in the main thread.
+ */
+class MemoryBudget final {
+	Instance &instance;
+
+	/**
+	 * The budget in bytes.
+	 */
+	const size_t budget;
+
+	TimerEvent timer;
+
+	/**
+	 * The #client_output_pool limit before it was reduced.
+	 */
+	size_t saved_client_output_limit;
+
+	bool under_pressure = false;
+
+public:
+	MemoryBudget(Instance &_instance, size_t _budget) noexcept;
+
+	void Start() noexcept;
+
+	size_t GetBudget() const noexcept {
+		return budget;
+	}
+
+	bool IsUnderPressure() const noexcept {
+		return under_pressure;
+	}
+
+private:
+	void Shrink(size_t resident) noexcept;
+	void Relax() noexcept;
+
+	void OnTimer() noexcept;
+};
+
+#endif
@@ -20,33 +20,154 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 
+#include <new>
+
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+/**
+ * A free chunk in the #MusicBuffer.
+ */
+struct MusicBuffer::Slice {
+	Slice *next;
+};
+
+/**
+ * Allocate with the given #HugePageMode, and fall back to
+ * #HugePageMode::TRANSPARENT if the huge page pool is too small.
+ */
+static HugeArray<uint8_t>
+AllocateBuffer(size_t size, HugePageMode &mode)
+{
+	if (mode == HugePageMode::EXPLICIT) {
+		try {
+			return HugeArray<uint8_t>(size, mode);
+		} catch (const std::bad_alloc &) {
+			mode = HugePageMode::TRANSPARENT;
+		}
+	}
+
+	return HugeArray<uint8_t>(size, mode);
+}
+
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size,
+			 const MusicBufferConfig &config)
+	:chunk_size(_chunk_size), n_chunks(num_chunks),
+	 huge_pages(config.huge_pages),
+	 buffer(AllocateBuffer(num_chunks * _chunk_size, huge_pages)),
+	 keep_memory(config.lock || config.prefault) {
+	assert(chunk_size >= sizeof(MusicChunk));
+	assert(chunk_size % alignof(MusicChunk) == 0);
+
+	buffer.ForkCow(false);
+
+	if (config.prefault) {
+		const auto start = std::chrono::steady_clock::now();
+		buffer.Prefault();
+		prefault_duration = std::chrono::steady_clock::now() - start;
+	}
+
+	/* note that mlock() faults in all pages, too */
+	if (config.lock)
+		locked = buffer.Lock();
+}
+
+MusicBuffer::~MusicBuffer() noexcept
+{
+	/* all chunks must be returned explicitly, and this assertion
+	   checks for leaks */
+	assert(n_allocated.load() == 0);
+}
+
+size_t
+MusicBuffer::GetChunkLength(AudioFormat af) const noexcept
+{
+	return MusicChunk::GetMaxLength(af,
+					chunk_size - sizeof(MusicChunkInfo));
+}
+
+MusicBufferStats
+MusicBuffer::GetStats() const noexcept
+{
+	MusicBufferStats stats;
+	stats.size = buffer.size();
+	stats.huge_pages = huge_pages;
+	stats.locked = locked;
+	stats.prefault_duration = prefault_duration;
+	stats.usage = buffer.GetUsage();
+	return stats;
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-	return MusicChunkPtr(buffer.Allocate(), MusicChunkDeleter(*this));
+	assert(n_initialized <= n_chunks);
+
+	if (available == nullptr) {
+		/* take over all chunks which were returned since the
+		   last call */
+		available = returned.exchange(nullptr,
+					      std::memory_order_acquire);
+
+		if (available == nullptr) {
+			if (n_initialized == n_chunks)
+				/* out of (internal) memory, buffer is
+				   full */
+				return nullptr;
+
+			available = ::new((void *)&buffer[chunk_size * n_initialized++])
+				Slice{nullptr};
+		}
+	}
+
+	Slice *slice = available;
+	available = slice->next;
+
+	n_allocated.fetch_add(1, std::memory_order_relaxed);
+
+	auto *chunk = ::new((void *)slice) MusicChunk();
+	chunk->capacity = chunk_size - sizeof(MusicChunkInfo);
+	return MusicChunkPtr(chunk, MusicChunkDeleter(*this));
 }
 
 void
 MusicBuffer::Return(MusicChunk *chunk) noexcept
 {
 	assert(chunk != nullptr);
+	assert(chunk->next.load(std::memory_order_relaxed) == nullptr);
 
-	/* these attributes need to be cleared before locking the
-	   mutex, because they might recursively call this method,
-	   causing a deadlock */
-	chunk->next.reset();
+	/* this attribute needs to be cleared before destructing the
+	   chunk, because it might recursively call this method */
 	chunk->other.reset();
 
-	const std::lock_guard<Mutex> protect(mutex);
+	assert((uint8_t *)chunk >= &buffer.front() &&
+	       (uint8_t *)chunk <= &buffer.back());
+	assert(((uint8_t *)chunk - &buffer.front()) % chunk_size == 0);
+
+	chunk->~MusicChunk();
+
+	Slice *slice = ::new((void *)chunk) Slice{nullptr};
+
+	/* push the slice to the "returned" stack; Allocate() only
+	   ever takes the whole stack, so there is no ABA problem */
+	Slice *old_head = returned.load(std::memory_order_relaxed);
+	do {
+		slice->next = old_head;
+	} while (!returned.compare_exchange_weak(old_head, slice,
+						 std::memory_order_release,
+						 std::memory_order_relaxed));
 
-	assert(!chunk->other || !chunk->other->other);
+	n_allocated.fetch_sub(1, std::memory_order_release);
+}
+
+void
+MusicBuffer::DiscardMemory() noexcept
+{
+	if (keep_memory ||
+	    n_allocated.load(std::memory_order_acquire) != 0)
+		return;
 
-	buffer.Free(chunk);
+	n_initialized = 0;
+	available = nullptr;
+	returned.store(nullptr, std::memory_order_relaxed);
+	buffer.Discard();
 }
@@ -21,17 +21,125 @@
 #define MPD_MUSIC_BUFFER_HXX
 
 #include "MusicChunkPtr.hxx"
-#include "util/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <chrono>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct AudioFormat;
+
+/**
+ * How the memory of a #MusicBuffer is allocated; see the
+ * "audio_buffer_huge_pages", "audio_buffer_lock" and
+ * "audio_buffer_prefault" settings.
+ */
+struct MusicBufferConfig {
+	HugePageMode huge_pages = HugePageMode::TRANSPARENT;
+
+	/**
+	 * Lock the buffer into physical memory?
+	 */
+	bool lock = false;
+
+	/**
+	 * Fault in the whole buffer in the constructor?
+	 */
+	bool prefault = false;
+};
+
+/**
+ * Describes how well the #MusicBufferConfig was applied.
+ */
+struct MusicBufferStats {
+	/**
+	 * The size of the allocation in bytes.
+	 */
+	size_t size = 0;
+
+	/**
+	 * The effective #HugePageMode; if
+	 * #HugePageMode::EXPLICIT failed, this is
+	 * #HugePageMode::TRANSPARENT.
+	 */
+	HugePageMode huge_pages = HugePageMode::NONE;
+
+	/**
+	 * Was the buffer locked into memory successfully?
+	 */
+	bool locked = false;
+
+	/**
+	 * How long did prefaulting the buffer take?
+	 */
+	std::chrono::steady_clock::duration prefault_duration =
+		std::chrono::steady_clock::duration::zero();
+
+	HugeUsage usage;
+};
 
 /**
  * An allocator for #MusicChunk objects.
+ *
+ * This class does not use a lock: Allocate() may only be called by
+ * one thread at a time (the decoder thread), but Return() may be
+ * called by any thread.  Returned chunks are pushed to a lock-free
+ * stack, which is taken over as a whole by Allocate() when its own
+ * list of free chunks runs empty.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	mutable Mutex mutex;
+	struct Slice;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The size of each chunk in bytes, including its header.
+	 */
+	const size_t chunk_size;
+
+	const unsigned n_chunks;
+
+	/**
+	 * The effective #HugePageMode of #buffer.
+	 */
+	HugePageMode huge_pages;
+
+	HugeArray<uint8_t> buffer;
+
+	/**
+	 * Don't give memory back to the kernel in DiscardMemory(),
+	 * because it was locked or prefaulted on purpose.
+	 */
+	bool keep_memory;
+
+	bool locked = false;
+
+	std::chrono::steady_clock::duration prefault_duration =
+		std::chrono::steady_clock::duration::zero();
+
+	/**
+	 * The number of slices that are initialized.  This is used to
+	 * avoid page faulting on the new allocation, so the kernel
+	 * does not need to reserve physical memory pages.  Only
+	 * accessed by Allocate().
+	 */
+	unsigned n_initialized = 0;
+
+	/**
+	 * The number of chunks currently allocated.
+	 */
+	std::atomic_uint n_allocated{0};
+
+	/**
+	 * A linked list of free slices owned by Allocate().
+	 */
+	Slice *available = nullptr;
+
+	/**
+	 * A lock-free stack of slices freed by Return().
+	 */
+	std::atomic<Slice *> returned{nullptr};
 
 public:
 	/**
@@ -39,8 +147,16 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the size of each #MusicChunk in bytes
+	 * (including its header); must be a multiple of #CHUNK_SIZE
 	 */
-	explicit MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size,
+		    const MusicBufferConfig &config=MusicBufferConfig());
+
+	~MusicBuffer() noexcept;
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
@@ -49,13 +165,13 @@ public:
 	 * object is inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
-		return buffer.empty();
+		return n_allocated.load(std::memory_order_relaxed) == 0;
 	}
 #endif
 
 	bool IsFull() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
-		return buffer.IsFull();
+		return n_allocated.load(std::memory_order_relaxed) ==
+			n_chunks;
 	}
 
 	/**
@@ -65,9 +181,32 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
-		return buffer.GetCapacity();
+		return n_chunks;
 	}
 
+	/**
+	 * Returns the number of data bytes which a chunk of the given
+	 * audio format will hold; see MusicChunk::GetMaxLength().
+	 */
+	gcc_pure
+	size_t GetChunkLength(AudioFormat af) const noexcept;
+
+	HugePageMode GetHugePageMode() const noexcept {
+		return huge_pages;
+	}
+
+	bool IsLocked() const noexcept {
+		return locked;
+	}
+
+	/**
+	 * Determine how the memory of this buffer is backed.  This
+	 * is slow (it reads /proc/self/smaps on Linux), but may be
+	 * called from any thread.
+	 */
+	gcc_pure
+	MusicBufferStats GetStats() const noexcept;
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -82,6 +221,14 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk) noexcept;
+
+	/**
+	 * Give the memory back to the kernel if no chunk is
+	 * allocated (unless it was locked or prefaulted).  This must
+	 * not be called while another thread may call Allocate() or
+	 * Return().
+	 */
+	void DiscardMemory() noexcept;
 };
 
 #endif
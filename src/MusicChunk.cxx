@@ -36,6 +36,19 @@ MusicChunkInfo::CheckFormat(const AudioFormat other_format) const noexcept
 }
 #endif
 
+size_t
+MusicChunk::GetMaxLength(const AudioFormat af, size_t _capacity) noexcept
+{
+	size_t max_length = af.TimeToSize(MAX_CHUNK_DURATION);
+	if (max_length < sizeof(MusicChunk::data))
+		max_length = sizeof(MusicChunk::data);
+	if (max_length > _capacity)
+		max_length = _capacity;
+
+	const size_t frame_size = af.GetFrameSize();
+	return max_length - max_length % frame_size;
+}
+
 WritableBuffer<void>
 MusicChunk::Write(const AudioFormat af,
 		  SongTime data_time, uint16_t _bit_rate) noexcept
@@ -55,20 +68,21 @@ MusicChunk::Write(const AudioFormat af,
 #endif
 	}
 
-	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
-	return { data + length, num_frames * frame_size };
+	const size_t max_length = GetMaxLength(af);
+	assert(length <= max_length);
+	return { data + length, max_length - length };
 }
 
 bool
 MusicChunk::Expand(const AudioFormat af, size_t _length) noexcept
 {
 	const size_t frame_size = af.GetFrameSize();
+	const size_t max_length = GetMaxLength(af);
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= max_length);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > max_length;
 }
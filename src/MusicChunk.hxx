@@ -23,20 +23,31 @@
 #include "MusicChunkPtr.hxx"
 #include "Chrono.hxx"
 #include "ReplayGainInfo.hxx"
-#include "util/WritableBuffer.hxx"
-
-#ifndef NDEBUG
 #include "AudioFormat.hxx"
-#endif
+#include "util/WritableBuffer.hxx"
 
 #include <memory>
+#include <atomic>
+#include <chrono>
 
 #include <stdint.h>
 #include <stddef.h>
 
+/**
+ * The default (and minimum) size of a #MusicChunk including its
+ * header.  A #MusicBuffer may be configured to allocate larger
+ * chunks.
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
-struct AudioFormat;
+/**
+ * A chunk does not contain more than this duration of audio data,
+ * unless the format's rate is so low that even #CHUNK_SIZE holds
+ * more.  This keeps cross-fading and the elapsed time precise with
+ * large chunks.
+ */
+static constexpr std::chrono::milliseconds MAX_CHUNK_DURATION(20);
+
 struct Tag;
 struct MusicChunk;
 
@@ -44,8 +55,20 @@ struct MusicChunk;
  * Meta information for #MusicChunk.
  */
 struct MusicChunkInfo {
-	/** the next chunk in a linked list */
-	MusicChunkPtr next;
+	/**
+	 * The next chunk in a #MusicPipe.  The pipe owns all chunks
+	 * linked here.  This is atomic because the producer appends
+	 * while the consumer (and the audio outputs) follow the list
+	 * without a lock.
+	 */
+	std::atomic<MusicChunk *> next{nullptr};
+
+	/**
+	 * The deleter of the #MusicChunkPtr which was passed to
+	 * MusicPipe::Push(); used to restore it in
+	 * MusicPipe::Shift().
+	 */
+	MusicChunkDeleter deleter;
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -66,7 +89,13 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
+
+	/**
+	 * The number of bytes available in #MusicChunk::data; set by
+	 * MusicBuffer::Allocate().
+	 */
+	uint32_t capacity = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -87,6 +116,15 @@ struct MusicChunkInfo {
 	 */
 	unsigned replay_gain_serial;
 
+	/**
+	 * Time stamps for latency telemetry: when the decoder
+	 * allocated this chunk, when it was pushed into the
+	 * #MusicPipe, and when the player thread handed it to the
+	 * audio outputs.
+	 */
+	std::chrono::steady_clock::time_point decode_time, pipe_time,
+		play_time;
+
 #ifndef NDEBUG
 	AudioFormat audio_format;
 #endif
@@ -116,9 +154,25 @@ struct MusicChunkInfo {
  * MusicPipe::Push() caller.
  */
 struct MusicChunk : MusicChunkInfo {
-	/** the data (probably PCM) */
+	/**
+	 * The data (probably PCM).  This is the minimum size; the
+	 * actual allocation may be larger, see #capacity.
+	 */
 	uint8_t data[CHUNK_SIZE - sizeof(MusicChunkInfo)];
 
+	/**
+	 * Determine how many bytes of data a chunk with the specified
+	 * capacity shall hold for the given audio format.  The
+	 * return value is a multiple of the frame size.
+	 */
+	gcc_const
+	static size_t GetMaxLength(AudioFormat af, size_t capacity) noexcept;
+
+	gcc_pure
+	size_t GetMaxLength(AudioFormat af) const noexcept {
+		return GetMaxLength(af, capacity);
+	}
+
 	/**
 	 * Prepares appending to the music chunk.  Returns a buffer
 	 * where you may write into.  After you are finished, call
@@ -25,9 +25,8 @@
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-
-	for (const MusicChunk *i = head.get(); i != nullptr; i = i->next.get())
+	for (const MusicChunk *i = Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire))
 		if (i == chunk)
 			return true;
 
@@ -39,32 +38,47 @@ MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 MusicChunkPtr
 MusicPipe::Shift() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-
-	auto chunk = std::move(head);
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return nullptr;
 
-		head = std::move(chunk->next);
-		--size;
-
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		MusicChunk *expected = chunk;
+		if (tail.compare_exchange_strong(expected, nullptr,
+						 std::memory_order_acq_rel)) {
+			/* this was the last chunk; Push() may have
+			   installed a new head meanwhile, which must
+			   not be overwritten */
+			expected = chunk;
+			head.compare_exchange_strong(expected, nullptr,
+						     std::memory_order_acq_rel);
 		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+			/* Push() has already replaced the tail, but
+			   hasn't linked the new chunk yet; this is
+			   only a matter of a few instructions */
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr) {}
+
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
+
+	chunk->next.store(nullptr, std::memory_order_relaxed);
 
 #ifndef NDEBUG
-		if (size == 0)
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		if (size.fetch_sub(1, std::memory_order_release) <= 1)
 			audio_format.Clear();
-#endif
 	}
+#else
+	size.fetch_sub(1, std::memory_order_release);
+#endif
 
-	return chunk;
+	return MusicChunkPtr(chunk, chunk->deleter);
 }
 
 void
@@ -79,20 +93,33 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const std::lock_guard<Mutex> protect(mutex);
+#ifndef NDEBUG
+	{
+		const std::lock_guard<Mutex> protect(mutex);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+		assert(size.load() > 0 || !audio_format.IsDefined());
+		assert(!audio_format.IsDefined() ||
+		       chunk->CheckFormat(audio_format));
 
-#ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+		if (!audio_format.IsDefined() && chunk->length > 0)
+			audio_format = chunk->audio_format;
+	}
 #endif
 
-	chunk->next.reset();
-	*tail_r = std::move(chunk);
-	tail_r = &(*tail_r)->next;
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+	chunk->deleter = chunk.get_deleter();
+
+	MusicChunk *const new_tail = chunk.release();
+
+	/* the consumer doesn't free the old tail as long as it is
+	   still the tail; after this exchange, it waits for us to
+	   link the new chunk */
+	MusicChunk *const old_tail = tail.exchange(new_tail,
+						   std::memory_order_acq_rel);
+	if (old_tail == nullptr)
+		head.store(new_tail, std::memory_order_release);
+	else
+		old_tail->next.store(new_tail, std::memory_order_release);
 
-	++size;
+	size.fetch_add(1, std::memory_order_release);
 }
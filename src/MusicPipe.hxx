@@ -28,30 +28,53 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * This class does not use a lock: Push() may only be called by one
+ * thread (the producer) and Shift() only by one other thread (the
+ * consumer); Peek() and GetSize() may be called by anybody.  Clear()
+ * may be called by either side as long as the other one doesn't
+ * access the pipe concurrently.
  */
 class MusicPipe {
-	/** the first chunk */
-	MusicChunkPtr head;
+	/**
+	 * The first chunk.  It is modified by the consumer, and by
+	 * the producer only while the pipe is empty.
+	 */
+	std::atomic<MusicChunk *> head{nullptr};
 
-	/** a pointer to the tail of the chunk */
-	MusicChunkPtr *tail_r = &head;
+	/**
+	 * The last chunk.  It is modified by the producer, and reset
+	 * to nullptr by the consumer when it removes the last chunk.
+	 */
+	std::atomic<MusicChunk *> tail{nullptr};
 
-	/** the current number of chunks */
-	unsigned size = 0;
+	/**
+	 * The current number of chunks.  It is incremented after the
+	 * new chunk has been linked, therefore it may be negative for
+	 * a short time.
+	 */
+	std::atomic_int size{0};
 
-	/** a mutex which protects #head and #tail_r */
+#ifndef NDEBUG
+	/** a mutex which protects #audio_format */
 	mutable Mutex mutex;
 
-#ifndef NDEBUG
 	AudioFormat audio_format = AudioFormat::Undefined();
 #endif
 
 public:
+	MusicPipe() = default;
+
+	MusicPipe(const MusicPipe &) = delete;
+	MusicPipe &operator=(const MusicPipe &) = delete;
+
 	~MusicPipe() noexcept {
 		Clear();
 	}
@@ -63,6 +86,7 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
 		return !audio_format.IsDefined() ||
 			audio_format == other;
 	}
@@ -80,8 +104,7 @@ public:
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
-		return head.get();
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -104,8 +127,8 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
-		return size;
+		const int value = size.load(std::memory_order_acquire);
+		return value > 0 ? value : 0;
 	}
 
 	gcc_pure
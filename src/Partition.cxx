@@ -25,22 +25,37 @@
 #include "IdleFlags.hxx"
 #include "client/Listener.hxx"
 
+/**
+ * The interval of Partition::suspend_player_timer.
+ */
+static constexpr std::chrono::steady_clock::duration suspend_player_interval =
+	std::chrono::minutes(1);
+
 Partition::Partition(Instance &_instance,
 		     const char *_name,
 		     unsigned max_length,
-		     unsigned buffer_chunks,
+		     unsigned buffer_chunks, size_t chunk_size,
+		     const MusicBufferConfig &buffer_config,
+		     bool warm_decoder, bool low_latency,
+		     bool gapless_convert,
+		     std::chrono::steady_clock::duration stream_tag_interval,
 		     AudioFormat configured_audio_format,
 		     const ReplayGainConfig &replay_gain_config)
 	:instance(_instance),
 	 name(_name),
 	 listener(new ClientListener(instance.event_loop, *this)),
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
+	 suspend_player_timer(instance.event_loop,
+			      BIND_THIS_METHOD(OnSuspendPlayerTimer)),
 	 playlist(max_length, *this),
 	 outputs(*this),
-	 pc(*this, outputs, buffer_chunks,
+	 pc(*this, outputs, buffer_chunks, chunk_size, buffer_config,
+	    warm_decoder, low_latency, gapless_convert, stream_tag_interval,
 	    configured_audio_format, replay_gain_config)
 {
 	UpdateEffectiveReplayGainMode();
+
+	suspend_player_timer.Schedule(suspend_player_interval);
 }
 
 Partition::~Partition() noexcept = default;
@@ -171,3 +186,12 @@ Partition::OnGlobalEvent(unsigned mask)
 	if ((mask & BORDER_PAUSE) != 0)
 		BorderPause();
 }
+
+void
+Partition::OnSuspendPlayerTimer() noexcept
+{
+	if (!playlist.playing)
+		pc.LockSuspendIdle();
+
+	suspend_player_timer.Schedule(suspend_player_interval);
+}
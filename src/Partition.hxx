@@ -21,6 +21,7 @@
 #define MPD_PARTITION_HXX
 
 #include "event/MaskMonitor.hxx"
+#include "event/TimerEvent.hxx"
 #include "queue/Playlist.hxx"
 #include "queue/Listener.hxx"
 #include "output/MultipleOutputs.hxx"
@@ -29,6 +30,7 @@
 #include "player/Listener.hxx"
 #include "ReplayGainMode.hxx"
 #include "SingleMode.hxx"
+#include "StatusCache.hxx"
 #include "Chrono.hxx"
 #include "util/Compiler.h"
 #include "config.h"
@@ -58,6 +60,13 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	MaskMonitor global_events;
 
+	/**
+	 * Periodically calls PlayerControl::LockSuspendIdle(), so
+	 * player threads of partitions which are not playing do not
+	 * occupy resources.
+	 */
+	TimerEvent suspend_player_timer;
+
 	struct playlist playlist;
 
 	MultipleOutputs outputs;
@@ -66,10 +75,21 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
+	/**
+	 * Preformatted responses for clients which poll "status" and
+	 * "currentsong".  Only used by the main thread.
+	 */
+	StatusCache status_cache;
+	CurrentSongCache current_song_cache;
+
 	Partition(Instance &_instance,
 		  const char *_name,
 		  unsigned max_length,
-		  unsigned buffer_chunks,
+		  unsigned buffer_chunks, size_t chunk_size,
+		  const MusicBufferConfig &buffer_config,
+		  bool warm_decoder, bool low_latency,
+		  bool gapless_convert,
+		  std::chrono::steady_clock::duration stream_tag_interval,
 		  AudioFormat configured_audio_format,
 		  const ReplayGainConfig &replay_gain_config);
 
@@ -261,6 +281,9 @@ private:
 
 	/* callback for #global_events */
 	void OnGlobalEvent(unsigned mask);
+
+	/* callback for #suspend_player_timer */
+	void OnSuspendPlayerTimer() noexcept;
 };
 
 #endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "PictureCache.hxx"
+#include "PictureScan.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/TextFile.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PICTURE_CACHE_INDEX_SUFFIX ".picture"
+#define PICTURE_CACHE_DATA_SUFFIX ".data"
+
+static constexpr Domain picture_cache_domain("picture_cache");
+
+PictureCache *picture_cache;
+
+/**
+ * Calculate the 64 bit FNV-1a hash of the given buffer and format
+ * it as a hex string.
+ */
+static std::string
+MakeHashName(const void *data, size_t size) noexcept
+{
+	const auto *p = (const unsigned char *)data;
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx",
+		 (unsigned long long)hash);
+	return buffer;
+}
+
+static unsigned long long
+ToSeconds(std::chrono::system_clock::time_point t) noexcept
+{
+	return (unsigned long long)std::chrono::system_clock::to_time_t(t);
+}
+
+AllocatedPath
+PictureCache::MakeIndexPath(const char *uri) const noexcept
+{
+	const auto name = MakeHashName(uri, strlen(uri)) +
+		PICTURE_CACHE_INDEX_SUFFIX;
+	return AllocatedPath::Build(directory, name.c_str());
+}
+
+AllocatedPath
+PictureCache::MakeDataPath(const std::string &name) const noexcept
+{
+	return AllocatedPath::Build(directory,
+				    (name + PICTURE_CACHE_DATA_SUFFIX).c_str());
+}
+
+inline bool
+PictureCache::LoadFile(const char *uri,
+		       std::chrono::system_clock::time_point mtime,
+		       Picture &picture)
+{
+	const auto index_path = MakeIndexPath(uri);
+	if (!FileExists(index_path))
+		return false;
+
+	std::string index_uri, type, data;
+	unsigned long long index_mtime = 0;
+
+	{
+		TextFile file(index_path);
+
+		char *line;
+		while ((line = file.ReadLine()) != nullptr) {
+			const char *value;
+			if ((value = StringAfterPrefix(line, "uri: ")) != nullptr)
+				index_uri = value;
+			else if ((value = StringAfterPrefix(line, "mtime: ")) != nullptr)
+				index_mtime = ParseUint64(value);
+			else if ((value = StringAfterPrefix(line, "type: ")) != nullptr)
+				type = value;
+			else if ((value = StringAfterPrefix(line, "data: ")) != nullptr)
+				data = value;
+			else
+				throw FormatRuntimeError("Unknown line in %s: %s",
+							 index_path.c_str(),
+							 line);
+		}
+	}
+
+	if (index_uri != uri || index_mtime != ToSeconds(mtime))
+		/* hash collision or stale entry */
+		return false;
+
+	if (data.empty()) {
+		/* the song is known to have no picture */
+		picture = Picture();
+		return true;
+	}
+
+	const auto data_path = MakeDataPath(data);
+	if (!FileExists(data_path))
+		/* the data file was deleted */
+		return false;
+
+	FileReader reader(data_path);
+	const auto size = reader.GetSize();
+	if (size == 0 || size > MAX_PICTURE_SIZE)
+		throw FormatRuntimeError("Malformed picture file: %s",
+					 data_path.c_str());
+
+	picture.mime_type = std::move(type);
+	picture.data.resize(size);
+
+	size_t position = 0;
+	while (position < size) {
+		size_t nbytes = reader.Read(&picture.data[position],
+					    size - position);
+		if (nbytes == 0)
+			throw FormatRuntimeError("Truncated picture file: %s",
+						 data_path.c_str());
+
+		position += nbytes;
+	}
+
+	return true;
+}
+
+bool
+PictureCache::Load(const char *uri,
+		   std::chrono::system_clock::time_point mtime,
+		   Picture &picture) noexcept
+{
+	try {
+		return LoadFile(uri, mtime, picture);
+	} catch (...) {
+		LogError(std::current_exception());
+		picture = Picture();
+		return false;
+	}
+}
+
+inline void
+PictureCache::StoreFile(const char *uri,
+			std::chrono::system_clock::time_point mtime,
+			const Picture &picture)
+{
+	std::string data;
+	if (picture.IsDefined()) {
+		if (picture.data.size() > MAX_PICTURE_SIZE) {
+			FormatDebug(picture_cache_domain,
+				    "Picture of %s is too large", uri);
+			return;
+		}
+
+		char size_buffer[24];
+		snprintf(size_buffer, sizeof(size_buffer), "-%zx",
+			 picture.data.size());
+		data = MakeHashName(picture.data.data(),
+				    picture.data.size()) + size_buffer;
+
+		/* the data file name depends only on its contents,
+		   so an existing file can be shared */
+		const auto data_path = MakeDataPath(data);
+		if (!FileExists(data_path)) {
+			FileOutputStream fos(data_path);
+			fos.Write(picture.data.data(), picture.data.size());
+			fos.Commit();
+		}
+	}
+
+	FileOutputStream fos(MakeIndexPath(uri));
+	BufferedOutputStream os(fos);
+
+	os.Format("uri: %s\n", uri);
+	os.Format("mtime: %llu\n", ToSeconds(mtime));
+	if (!data.empty()) {
+		if (!picture.mime_type.empty())
+			os.Format("type: %s\n", picture.mime_type.c_str());
+		os.Format("data: %s\n", data.c_str());
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
+void
+PictureCache::Store(const char *uri,
+		    std::chrono::system_clock::time_point mtime,
+		    const Picture &picture) noexcept
+{
+	try {
+		StoreFile(uri, mtime, picture);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to store the picture of %s", uri);
+	}
+}
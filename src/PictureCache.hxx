@@ -0,0 +1,99 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PICTURE_CACHE_HXX
+#define MPD_PICTURE_CACHE_HXX
+
+#include "fs/AllocatedPath.hxx"
+
+#include <chrono>
+#include <string>
+
+struct Picture;
+
+/**
+ * A persistent cache of pictures embedded in song files, so the
+ * "readpicture" command doesn't need to parse the song file each
+ * time a client asks for its cover.
+ *
+ * For each song (identified by its URI and modification time), an
+ * index file refers to a data file containing the picture.  Data
+ * files are named after a hash of their contents, which means that
+ * all songs of an album which embed the same cover share one copy.
+ * The index also records songs without a picture, to avoid scanning
+ * them again.
+ *
+ * The cache directory may be deleted at any time.
+ *
+ * All methods are thread-safe.
+ */
+class PictureCache {
+	/**
+	 * Pictures larger than this are not cached.
+	 */
+	static constexpr size_t MAX_PICTURE_SIZE = 16 * 1024 * 1024;
+
+	const AllocatedPath directory;
+
+public:
+	explicit PictureCache(AllocatedPath &&_directory) noexcept
+		:directory(std::move(_directory)) {}
+
+	PictureCache(const PictureCache &) = delete;
+	PictureCache &operator=(const PictureCache &) = delete;
+
+	/**
+	 * Look up the picture of the given song.  Errors are
+	 * logged.
+	 *
+	 * @return true if the song is known to the cache; the
+	 * #Picture is left undefined if the song has no picture
+	 */
+	bool Load(const char *uri, std::chrono::system_clock::time_point mtime,
+		  Picture &picture) noexcept;
+
+	/**
+	 * Store the picture of the given song; an undefined
+	 * #Picture records that the song has none.  Errors are
+	 * logged.
+	 */
+	void Store(const char *uri,
+		   std::chrono::system_clock::time_point mtime,
+		   const Picture &picture) noexcept;
+
+private:
+	AllocatedPath MakeIndexPath(const char *uri) const noexcept;
+	AllocatedPath MakeDataPath(const std::string &name) const noexcept;
+
+	bool LoadFile(const char *uri,
+		      std::chrono::system_clock::time_point mtime,
+		      Picture &picture);
+	void StoreFile(const char *uri,
+		       std::chrono::system_clock::time_point mtime,
+		       const Picture &picture);
+};
+
+/**
+ * The global #PictureCache instance; nullptr if none was
+ * configured.
+ */
+extern PictureCache *picture_cache;
+
+#endif
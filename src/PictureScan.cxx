@@ -0,0 +1,70 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "PictureScan.hxx"
+#include "TagFile.hxx"
+#include "TagStream.hxx"
+#include "tag/Generic.hxx"
+#include "tag/Handler.hxx"
+#include "fs/Path.hxx"
+
+namespace {
+
+/**
+ * Remembers the first picture passed to OnPicture().
+ */
+class PictureTagHandler final : public NullTagHandler {
+	Picture &picture;
+
+public:
+	explicit PictureTagHandler(Picture &_picture) noexcept
+		:NullTagHandler(WANT_PICTURE), picture(_picture) {}
+
+	void OnPicture(const char *mime_type,
+		       ConstBuffer<void> buffer) noexcept override {
+		if (picture.IsDefined() || buffer.empty())
+			return;
+
+		picture.mime_type = mime_type != nullptr ? mime_type : "";
+		picture.data.assign((const char *)buffer.data, buffer.size);
+	}
+};
+
+}
+
+bool
+ScanFilePicture(Path path_fs, Picture &picture) noexcept
+{
+	PictureTagHandler h(picture);
+	ScanFileTagsNoGeneric(path_fs, h);
+
+	if (!picture.IsDefined())
+		ScanGenericTags(path_fs, h);
+
+	return picture.IsDefined();
+}
+
+bool
+ScanStreamPicture(const char *uri, Picture &picture) noexcept
+{
+	PictureTagHandler h(picture);
+	tag_stream_scan(uri, h);
+	return picture.IsDefined();
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PICTURE_SCAN_HXX
+#define MPD_PICTURE_SCAN_HXX
+
+#include <string>
+
+class Path;
+
+/**
+ * A picture embedded in a song file.
+ */
+struct Picture {
+	/**
+	 * The MIME type; may be empty if the scanner did not know
+	 * it.
+	 */
+	std::string mime_type;
+
+	std::string data;
+
+	bool IsDefined() const noexcept {
+		return !data.empty();
+	}
+};
+
+/**
+ * Extract the embedded picture (preferably the front cover) from a
+ * local song file, using the tag scanners of the decoder plugins
+ * and the generic (ID3) scanner.
+ *
+ * @return true if a picture was found
+ */
+bool
+ScanFilePicture(Path path_fs, Picture &picture) noexcept;
+
+/**
+ * Like ScanFilePicture(), but for an arbitrary URI supported by the
+ * input plugins.
+ */
+bool
+ScanStreamPicture(const char *uri, Picture &picture) noexcept;
+
+#endif
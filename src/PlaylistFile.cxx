@@ -42,7 +42,19 @@
 #include "util/Macros.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriUtil.hxx"
+#include "Log.hxx"
 
+#ifdef ENABLE_INOTIFY
+#include "db/update/InotifySource.hxx"
+#include "util/Domain.hxx"
+
+#include <map>
+
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+#include <list>
 #include <memory>
 
 #include <assert.h>
@@ -54,6 +66,53 @@ static const char PLAYLIST_COMMENT = '#';
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+/**
+ * A parsed playlist file, kept in memory so playlist edits do not
+ * need to load and parse the whole file again.  The cached copy is
+ * valid as long as the file's modification time and size are
+ * unchanged.
+ */
+struct CachedPlaylistFile {
+	std::string name;
+
+	PlaylistFileContents contents;
+
+	std::chrono::system_clock::time_point mtime;
+
+	uint64_t size;
+};
+
+/**
+ * The maximum number of playlists in #playlist_file_cache.
+ */
+static constexpr std::size_t PLAYLIST_FILE_CACHE_SIZE = 8;
+
+/**
+ * Recently edited playlist files, the most recently used one first.
+ * Like all functions in this library, this may only be accessed
+ * from the main thread.
+ */
+static std::list<CachedPlaylistFile> playlist_file_cache;
+
+#ifdef ENABLE_INOTIFY
+
+static constexpr Domain playlist_file_domain("playlist_file");
+
+/**
+ * Watches the playlist directory to keep #playlist_list_cache up to
+ * date.
+ */
+static InotifySource *playlist_inotify;
+
+/**
+ * A copy of the ListPlaylistFiles() result (name to modification
+ * time), updated by inotify events and by our own edits.  This is
+ * only used while #playlist_inotify watches the directory.
+ */
+static std::unique_ptr<std::map<std::string, std::chrono::system_clock::time_point>> playlist_list_cache;
+
+#endif
+
 void
 spl_global_init(const ConfigData &config)
 {
@@ -122,6 +181,51 @@ spl_map_to_fs(const char *name_utf8)
 	return path_fs;
 }
 
+static std::list<CachedPlaylistFile>::iterator
+FindCachedPlaylistFile(const char *name_utf8) noexcept
+{
+	return std::find_if(playlist_file_cache.begin(),
+			    playlist_file_cache.end(),
+			    [name_utf8](const CachedPlaylistFile &f){
+				    return f.name == name_utf8;
+			    });
+}
+
+#ifdef ENABLE_INOTIFY
+
+static void
+UpdateListCache(const char *name_utf8, Path path_fs) noexcept
+{
+	if (!playlist_list_cache)
+		return;
+
+	FileInfo fi;
+	if (GetFileInfo(path_fs, fi) && fi.IsRegular())
+		(*playlist_list_cache)[name_utf8] = fi.GetModificationTime();
+	else
+		playlist_list_cache->erase(name_utf8);
+}
+
+#endif
+
+void
+spl_invalidate(const char *name_utf8) noexcept
+{
+	auto i = FindCachedPlaylistFile(name_utf8);
+	if (i != playlist_file_cache.end())
+		playlist_file_cache.erase(i);
+
+#ifdef ENABLE_INOTIFY
+	if (playlist_list_cache) {
+		try {
+			UpdateListCache(name_utf8, spl_map_to_fs(name_utf8));
+		} catch (...) {
+			playlist_list_cache.reset();
+		}
+	}
+#endif
+}
+
 static bool
 LoadPlaylistFileInfo(PlaylistInfo &info,
 		     const Path parent_path_fs,
@@ -162,6 +266,14 @@ ListPlaylistFiles()
 	const auto &parent_path_fs = spl_map();
 	assert(!parent_path_fs.IsNull());
 
+#ifdef ENABLE_INOTIFY
+	if (playlist_list_cache) {
+		for (const auto &i : *playlist_list_cache)
+			list.push_back(PlaylistInfo(i.first, i.second));
+		return list;
+	}
+#endif
+
 	DirectoryReader reader(parent_path_fs);
 
 	PlaylistInfo info;
@@ -171,9 +283,100 @@ ListPlaylistFiles()
 			list.push_back(std::move(info));
 	}
 
+#ifdef ENABLE_INOTIFY
+	if (playlist_inotify != nullptr) {
+		playlist_list_cache = std::make_unique<std::map<std::string, std::chrono::system_clock::time_point>>();
+		for (const auto &i : list)
+			playlist_list_cache->emplace(i.name, i.mtime);
+	}
+#endif
+
 	return list;
 }
 
+#ifdef ENABLE_INOTIFY
+
+static void
+playlist_inotify_callback(gcc_unused int wd, unsigned mask,
+			  const char *name, gcc_unused void *ctx) noexcept
+{
+	if (mask & (IN_Q_OVERFLOW|IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF)) {
+		/* events were lost, or the directory is gone; the
+		   next ListPlaylistFiles() call rebuilds the cache */
+		playlist_list_cache.reset();
+		return;
+	}
+
+	if (name == nullptr || !playlist_list_cache ||
+	    Path::FromFS(name).HasNewline())
+		return;
+
+	const auto *const name_end =
+		FindStringSuffix(name, PLAYLIST_FILE_SUFFIX);
+	if (name_end == nullptr)
+		return;
+
+	const auto name_fs = AllocatedPath::FromFS(name, name_end);
+
+	std::string name_utf8;
+	try {
+		name_utf8 = name_fs.ToUTF8Throw();
+	} catch (...) {
+		return;
+	}
+
+	UpdateListCache(name_utf8.c_str(), map_spl_path() / Path::FromFS(name));
+}
+
+#endif
+
+void
+spl_watch_init(EventLoop &loop) noexcept
+{
+#ifdef ENABLE_INOTIFY
+	const auto &path_fs = map_spl_path();
+	if (path_fs.IsNull())
+		return;
+
+	try {
+		playlist_inotify = new InotifySource(loop,
+						     playlist_inotify_callback,
+						     nullptr);
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
+
+	try {
+		playlist_inotify->Add(path_fs.c_str(),
+				      IN_CLOSE_WRITE|IN_CREATE|IN_DELETE|
+				      IN_MOVED_FROM|IN_MOVED_TO|IN_ATTRIB|
+				      IN_DELETE_SELF|IN_MOVE_SELF);
+	} catch (...) {
+		LogError(std::current_exception());
+		delete playlist_inotify;
+		playlist_inotify = nullptr;
+		return;
+	}
+
+	LogDebug(playlist_file_domain, "watching the playlist directory");
+#else
+	(void)loop;
+#endif
+}
+
+void
+spl_watch_finish() noexcept
+{
+#ifdef ENABLE_INOTIFY
+	playlist_list_cache.reset();
+	delete playlist_inotify;
+	playlist_inotify = nullptr;
+#endif
+
+	playlist_file_cache.clear();
+}
+
 static void
 SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
 {
@@ -253,6 +456,81 @@ try {
 	throw;
 }
 
+/**
+ * Load a playlist file for editing, from #playlist_file_cache if the
+ * file was not modified meanwhile.
+ */
+static CachedPlaylistFile &
+LoadCachedPlaylistFile(const char *utf8path)
+{
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
+
+	auto i = FindCachedPlaylistFile(utf8path);
+
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi) || !fi.IsRegular()) {
+		if (i != playlist_file_cache.end())
+			playlist_file_cache.erase(i);
+		throw PlaylistError::NoSuchList();
+	}
+
+	if (i != playlist_file_cache.end()) {
+		if (i->mtime == fi.GetModificationTime() &&
+		    i->size == fi.GetSize()) {
+			/* move to the front (most recently used) */
+			playlist_file_cache.splice(playlist_file_cache.begin(),
+						   playlist_file_cache, i);
+			return *i;
+		}
+
+		/* modified by somebody else */
+		playlist_file_cache.erase(i);
+	}
+
+	auto contents = LoadPlaylistFile(utf8path);
+
+	if (playlist_file_cache.size() >= PLAYLIST_FILE_CACHE_SIZE)
+		playlist_file_cache.pop_back();
+
+	playlist_file_cache.push_front({utf8path, std::move(contents),
+					fi.GetModificationTime(),
+					fi.GetSize()});
+	return playlist_file_cache.front();
+}
+
+/**
+ * Write the modified #CachedPlaylistFile back to disk and remember
+ * the new file's modification time and size.
+ */
+static void
+SaveCachedPlaylistFile(CachedPlaylistFile &file)
+{
+	/* copy the name, because spl_invalidate() may free it */
+	const std::string name = file.name;
+
+	try {
+		SavePlaylistFile(file.contents, name.c_str());
+	} catch (...) {
+		/* the cached contents do not match the file anymore */
+		spl_invalidate(name.c_str());
+		throw;
+	}
+
+	const auto path_fs = spl_map_to_fs(name.c_str());
+
+#ifdef ENABLE_INOTIFY
+	UpdateListCache(name.c_str(), path_fs);
+#endif
+
+	FileInfo fi;
+	if (GetFileInfo(path_fs, fi)) {
+		file.mtime = fi.GetModificationTime();
+		file.size = fi.GetSize();
+	} else
+		spl_invalidate(name.c_str());
+}
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 {
@@ -261,7 +539,8 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 		   what the hell.. */
 		return;
 
-	auto contents = LoadPlaylistFile(utf8path);
+	auto &file = LoadCachedPlaylistFile(utf8path);
+	auto &contents = file.contents;
 
 	if (src >= contents.size() || dest >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
@@ -273,7 +552,7 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 	const auto dest_i = std::next(contents.begin(), dest);
 	contents.insert(dest_i, std::move(value));
 
-	SavePlaylistFile(contents, utf8path);
+	SaveCachedPlaylistFile(file);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 }
@@ -294,6 +573,7 @@ spl_clear(const char *utf8path)
 			throw;
 	}
 
+	spl_invalidate(utf8path);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -313,20 +593,22 @@ spl_delete(const char *name_utf8)
 			throw;
 	}
 
+	spl_invalidate(name_utf8);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
 void
 spl_remove_index(const char *utf8path, unsigned pos)
 {
-	auto contents = LoadPlaylistFile(utf8path);
+	auto &file = LoadCachedPlaylistFile(utf8path);
+	auto &contents = file.contents;
 
 	if (pos >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
 	contents.erase(std::next(contents.begin(), pos));
 
-	SavePlaylistFile(contents, utf8path);
+	SaveCachedPlaylistFile(file);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -349,6 +631,10 @@ try {
 	bos.Flush();
 	fos.Commit();
 
+	/* the file was appended to without parsing it; the next edit
+	   will load it again */
+	spl_invalidate(utf8path);
+
 	idle_add(IDLE_STORED_PLAYLIST);
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
@@ -379,8 +665,6 @@ spl_rename_internal(Path from_path_fs, Path to_path_fs)
 		else
 			throw;
 	}
-
-	idle_add(IDLE_STORED_PLAYLIST);
 }
 
 void
@@ -393,4 +677,8 @@ spl_rename(const char *utf8from, const char *utf8to)
 	assert(!to_path_fs.IsNull());
 
 	spl_rename_internal(from_path_fs, to_path_fs);
+
+	spl_invalidate(utf8from);
+	spl_invalidate(utf8to);
+	idle_add(IDLE_STORED_PLAYLIST);
 }
@@ -24,6 +24,7 @@
 #include <string>
 
 struct ConfigData;
+class EventLoop;
 class DetachedSong;
 class SongLoader;
 class PlaylistVector;
@@ -39,6 +40,27 @@ extern bool playlist_saveAbsolutePaths;
 void
 spl_global_init(const ConfigData &config);
 
+/**
+ * Watch the playlist directory with inotify (if available), which
+ * allows ListPlaylistFiles() to serve a cached listing.
+ */
+void
+spl_watch_init(EventLoop &loop) noexcept;
+
+/**
+ * Stop watching the playlist directory and free all caches.
+ */
+void
+spl_watch_finish() noexcept;
+
+/**
+ * Discard cached information about the specified playlist.  Must be
+ * called after modifying a playlist file outside of this library
+ * (e.g. spl_save_queue()).
+ */
+void
+spl_invalidate(const char *name_utf8) noexcept;
+
 /**
  * Determines whether the specified string is a valid name for a
  * stored playlist.
@@ -27,6 +27,7 @@
 #include "Instance.hxx"
 #include "db/Interface.hxx"
 #include "client/Response.hxx"
+#include "util/ConstBuffer.hxx"
 
 #define SONG_FILE "file: "
 #define SONG_TIME "Time: "
@@ -89,6 +90,13 @@ playlist_print_find(Response &r, const playlist &playlist,
 	queue_find(r, playlist.queue, filter);
 }
 
+void
+playlist_print_contains(Response &r, const playlist &playlist,
+			ConstBuffer<const char *> uris)
+{
+	queue_print_contains(r, playlist.queue, uris);
+}
+
 void
 playlist_print_changes_info(Response &r, const playlist &playlist,
 			    uint32_t version,
@@ -25,6 +25,7 @@
 struct playlist;
 class SongFilter;
 class Response;
+template<typename T> struct ConstBuffer;
 
 /**
  * Sends the whole playlist to the client, song URIs only.
@@ -67,6 +68,14 @@ void
 playlist_print_find(Response &r, const playlist &playlist,
 		    const SongFilter &filter);
 
+/**
+ * Print the position and id of each queued song whose URI is one of
+ * the given ones.
+ */
+void
+playlist_print_contains(Response &r, const playlist &playlist,
+			ConstBuffer<const char *> uris);
+
 /**
  * Print detailed changes since the specified playlist version.
  */
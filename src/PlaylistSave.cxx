@@ -53,12 +53,10 @@ playlist_print_path(BufferedOutputStream &os, const Path path)
 void
 playlist_print_song(BufferedOutputStream &os, const DetachedSong &song)
 {
-	const char *uri_utf8 = playlist_saveAbsolutePaths
-		? song.GetRealURI()
-		: song.GetURI();
-
 	try {
-		const auto uri_fs = AllocatedPath::FromUTF8Throw(uri_utf8);
+		const auto uri_fs = playlist_saveAbsolutePaths
+			? AllocatedPath::FromUTF8Throw(song.GetRealURI().c_str())
+			: AllocatedPath::FromUTF8Throw(song.GetURI());
 		playlist_print_path(os, uri_fs);
 	} catch (...) {
 	}
@@ -102,6 +100,7 @@ spl_save_queue(const char *name_utf8, const Queue &queue)
 	bos.Flush();
 	fos.Commit();
 
+	spl_invalidate(name_utf8);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -20,15 +20,43 @@
 #include "RemoteTagCache.hxx"
 #include "RemoteTagCacheHandler.hxx"
 #include "input/ScanTags.hxx"
+#include "tag/Builder.hxx"
+#include "tag/ParseName.hxx"
+#include "TagSave.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringStrip.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <assert.h>
+#include <string.h>
+
+#define REMOTE_TAG_CACHE_URI "uri"
+#define REMOTE_TAG_CACHE_END "end"
+
+static constexpr Domain remote_tag_cache_domain("remote_tag_cache");
+
+constexpr size_t RemoteTagCache::INITIAL_BUCKETS;
+
 RemoteTagCache::RemoteTagCache(EventLoop &event_loop,
-			       RemoteTagCacheHandler &_handler) noexcept
+			       RemoteTagCacheHandler &_handler,
+			       unsigned _max_scanners,
+			       AllocatedPath &&_path) noexcept
 	:handler(_handler),
 	 defer_invoke_handler(event_loop, BIND_THIS_METHOD(InvokeHandlers)),
-	 map(typename KeyMap::bucket_traits(&buckets.front(), buckets.size()))
+	 max_scanners(_max_scanners),
+	 path(std::move(_path)),
+	 buckets(new KeyMap::bucket_type[INITIAL_BUCKETS]),
+	 map(KeyMap::bucket_traits(buckets.get(), INITIAL_BUCKETS))
 {
+	assert(max_scanners > 0);
 }
 
 RemoteTagCache::~RemoteTagCache() noexcept
@@ -36,6 +64,28 @@ RemoteTagCache::~RemoteTagCache() noexcept
 	map.clear_and_dispose(DeleteDisposer());
 }
 
+void
+RemoteTagCache::MaybeRehash() noexcept
+{
+	const size_t n_buckets = map.bucket_count();
+	if (map.size() <= n_buckets)
+		return;
+
+	const size_t new_n_buckets = n_buckets * 2 + 1;
+	std::unique_ptr<KeyMap::bucket_type[]> new_buckets;
+
+	try {
+		new_buckets.reset(new KeyMap::bucket_type[new_n_buckets]);
+	} catch (...) {
+		/* out of memory: keep the old table, which works,
+		   only slower */
+		return;
+	}
+
+	map.rehash(KeyMap::bucket_traits(new_buckets.get(), new_n_buckets));
+	buckets = std::move(new_buckets);
+}
+
 void
 RemoteTagCache::Lookup(const std::string &uri) noexcept
 {
@@ -46,48 +96,95 @@ RemoteTagCache::Lookup(const std::string &uri) noexcept
 	if (result.second) {
 		auto *item = new Item(*this, uri);
 		map.insert_commit(*item, hint);
-		waiting_list.push_back(*item);
+		queue_list.push_back(*item);
+		MaybeRehash();
+
+		StartScanners(lock);
+		return;
+	}
+
+	auto &item = *result.first;
+	switch (item.state) {
+	case Item::State::QUEUED:
+	case Item::State::WAITING:
+	case Item::State::INVOKE:
+		/* already scanning this one - no-op */
+		break;
+
+	case Item::State::IDLE:
+		/* already finished: re-invoke the handler */
+		idle_list.erase(idle_list.iterator_to(item));
+		item.state = Item::State::INVOKE;
+		invoke_list.push_back(item);
+
+		ScheduleInvokeHandlers();
+		break;
+	}
+}
+
+void
+RemoteTagCache::Prioritize(const std::string &uri) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	auto i = map.find(uri, Item::Hash(), Item::Equal());
+	if (i == map.end() || i->state != Item::State::QUEUED)
+		return;
+
+	auto &item = *i;
+	queue_list.erase(queue_list.iterator_to(item));
+	queue_list.push_front(item);
+}
+
+void
+RemoteTagCache::StartScanners(std::unique_lock<Mutex> &lock) noexcept
+{
+	while (n_scanners < max_scanners && !queue_list.empty()) {
+		auto &item = queue_list.front();
+		queue_list.pop_front();
+		item.state = Item::State::WAITING;
+		waiting_list.push_back(item);
+		++n_scanners;
+
 		lock.unlock();
 
 		try {
-			item->scanner = InputScanTags(uri.c_str(), *item);
-			if (!item->scanner) {
-				/* unsupported */
+			auto scanner = InputScanTags(item.uri.c_str(), item);
+			if (scanner) {
+				/* the scanner may finish before Start()
+				   returns */
+				auto &s = *scanner;
 				lock.lock();
-				ItemResolved(*item);
-				return;
+				item.scanner = std::move(scanner);
+				lock.unlock();
+				s.Start();
+				lock.lock();
+				continue;
 			}
 
-			item->scanner->Start();
+			/* unsupported */
 		} catch (...) {
 			FormatError(std::current_exception(),
 				    "Failed to scan tags of '%s'",
-				    uri.c_str());
-
-			item->scanner.reset();
-
-			lock.lock();
-			ItemResolved(*item);
-			return;
+				    item.uri.c_str());
 		}
-	} else if (result.first->scanner) {
-		/* already scanning this one - no-op */
-	} else {
-		/* already finished: re-invoke the handler */
-
-		auto &item = *result.first;
 
-		idle_list.erase(waiting_list.iterator_to(item));
-		invoke_list.push_back(item);
-
-		ScheduleInvokeHandlers();
+		lock.lock();
+		item.scanner.reset();
+		ItemResolved(item);
 	}
 }
 
 void
 RemoteTagCache::ItemResolved(Item &item) noexcept
 {
+	assert(item.state == Item::State::WAITING);
+	assert(n_scanners > 0);
+
 	waiting_list.erase(waiting_list.iterator_to(item));
+	--n_scanners;
+
+	item.state = Item::State::INVOKE;
 	invoke_list.push_back(item);
 
 	ScheduleInvokeHandlers();
@@ -96,11 +193,12 @@ RemoteTagCache::ItemResolved(Item &item) noexcept
 void
 RemoteTagCache::InvokeHandlers() noexcept
 {
-	const std::lock_guard<Mutex> lock(mutex);
+	std::unique_lock<Mutex> lock(mutex);
 
 	while (!invoke_list.empty()) {
 		auto &item = invoke_list.front();
 		invoke_list.pop_front();
+		item.state = Item::State::IDLE;
 		idle_list.push_back(item);
 
 		const ScopeUnlock unlock(mutex);
@@ -108,7 +206,16 @@ RemoteTagCache::InvokeHandlers() noexcept
 	}
 
 	/* evict items if there are too many */
-	while (map.size() > MAX_SIZE && !idle_list.empty()) {
+	EvictIdle(MAX_SIZE);
+
+	/* the finished scanners have made room for queued items */
+	StartScanners(lock);
+}
+
+void
+RemoteTagCache::EvictIdle(size_t max_items) noexcept
+{
+	while (map.size() > max_items && !idle_list.empty()) {
 		auto *item = &idle_list.front();
 		idle_list.pop_front();
 		map.erase(map.iterator_to(*item));
@@ -116,14 +223,30 @@ RemoteTagCache::InvokeHandlers() noexcept
 	}
 }
 
+size_t
+RemoteTagCache::GetMemoryUsage() noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	size_t result = map.bucket_count() * sizeof(KeyMap::bucket_type);
+	for (const auto &item : map)
+		result += sizeof(item) + item.uri.capacity() +
+			item.tag.num_items * sizeof(*item.tag.items);
+
+	return result;
+}
+
 void
 RemoteTagCache::Item::OnRemoteTag(Tag &&_tag) noexcept
 {
-	tag = std::move(_tag);
+	const std::lock_guard<Mutex> lock(parent.mutex);
 
+	tag = std::move(_tag);
 	scanner.reset();
 
-	const std::lock_guard<Mutex> lock(parent.mutex);
+	if (tag.IsDefined())
+		parent.modified = true;
+
 	parent.ItemResolved(*this);
 }
 
@@ -132,8 +255,136 @@ RemoteTagCache::Item::OnRemoteTagError(std::exception_ptr e) noexcept
 {
 	FormatError(e, "Failed to scan tags of '%s'", uri.c_str());
 
-	scanner.reset();
-
 	const std::lock_guard<Mutex> lock(parent.mutex);
+	scanner.reset();
 	parent.ItemResolved(*this);
 }
+
+void
+RemoteTagCache::LoadFile()
+{
+	TextFile file(path);
+
+	std::string uri;
+	TagBuilder tag;
+	bool in_item = false;
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (!in_item) {
+			const char *value =
+				StringAfterPrefix(line,
+						  REMOTE_TAG_CACHE_URI ": ");
+			if (value == nullptr)
+				throw FormatRuntimeError("unknown line in remote tag cache: %s",
+							 line);
+
+			uri = value;
+			tag.Clear();
+			in_item = true;
+			continue;
+		}
+
+		if (StringIsEqual(line, REMOTE_TAG_CACHE_END)) {
+			in_item = false;
+
+			if (map.size() >= MAX_SIZE)
+				continue;
+
+			KeyMap::insert_commit_data hint;
+			auto result = map.insert_check(uri, Item::Hash(),
+						       Item::Equal(), hint);
+			if (!result.second)
+				/* duplicate */
+				continue;
+
+			auto *item = new Item(*this, std::move(uri));
+			tag.Commit(item->tag);
+			item->state = Item::State::IDLE;
+			map.insert_commit(*item, hint);
+			idle_list.push_back(*item);
+			MaybeRehash();
+			continue;
+		}
+
+		char *colon = strchr(line, ':');
+		if (colon == nullptr || colon == line)
+			throw FormatRuntimeError("unknown line in remote tag cache: %s",
+						 line);
+
+		*colon++ = 0;
+		const char *value = StripLeft(colon);
+
+		TagType type;
+		if ((type = tag_name_parse(line)) != TAG_NUM_OF_ITEM_TYPES) {
+			tag.AddItem(type, value);
+		} else if (StringIsEqual(line, "Time")) {
+			tag.SetDuration(SignedSongTime::FromS(ParseDouble(value)));
+		} else if (StringIsEqual(line, "Playlist")) {
+			tag.SetHasPlaylist(StringIsEqual(value, "yes"));
+		} else
+			throw FormatRuntimeError("unknown line in remote tag cache: %s",
+						 line);
+	}
+}
+
+void
+RemoteTagCache::Load() noexcept
+{
+	if (path.IsNull() || !FileExists(path))
+		return;
+
+	const std::lock_guard<Mutex> lock(mutex);
+
+	try {
+		LoadFile();
+		FormatDebug(remote_tag_cache_domain,
+			    "loaded %zu remote tags", map.size());
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load the remote tag cache");
+	}
+}
+
+void
+RemoteTagCache::SaveFile()
+{
+	FileOutputStream fos(path);
+	BufferedOutputStream os(fos);
+
+	/* oldest first, so Load() restores the eviction order */
+	for (const auto &item : idle_list) {
+		if (!item.tag.IsDefined() ||
+		    item.uri.find('\n') != item.uri.npos)
+			/* failed, or can't be represented in the
+			   cache file */
+			continue;
+
+		os.Format(REMOTE_TAG_CACHE_URI ": %s\n", item.uri.c_str());
+		tag_save(os, item.tag);
+		os.Format(REMOTE_TAG_CACHE_END "\n");
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
+void
+RemoteTagCache::Save() noexcept
+{
+	if (path.IsNull())
+		return;
+
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (!modified)
+		return;
+
+	try {
+		SaveFile();
+		modified = false;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save the remote tag cache");
+	}
+}
@@ -24,24 +24,60 @@
 #include "tag/Tag.hxx"
 #include "event/DeferEvent.hxx"
 #include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
 
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/unordered_set.hpp>
 
+#include <memory>
 #include <string>
 
 class RemoteTagCacheHandler;
 
 /**
  * A cache for tags received via #RemoteTagScanner.
+ *
+ * At most #max_scanners #RemoteTagScanner instances run at a time;
+ * the others are queued in the order of their Lookup() calls, and
+ * Prioritize() moves an item to the front of the queue.
  */
 class RemoteTagCache final {
 	static constexpr size_t MAX_SIZE = 4096;
 
+	/**
+	 * The initial number of hash buckets.  The table grows
+	 * (approximately doubling) whenever it holds more items than
+	 * buckets.
+	 */
+	static constexpr size_t INITIAL_BUCKETS = 127;
+
 	RemoteTagCacheHandler &handler;
 
 	DeferEvent defer_invoke_handler;
 
+	/**
+	 * The maximum number of concurrent #RemoteTagScanner
+	 * instances.
+	 */
+	const unsigned max_scanners;
+
+	/**
+	 * The number of items in #waiting_list.
+	 */
+	unsigned n_scanners = 0;
+
+	/**
+	 * The file where resolved tags are saved by Save().  May be
+	 * "nulled" if persistence is disabled.
+	 */
+	const AllocatedPath path;
+
+	/**
+	 * Were items resolved since the cache file was loaded or
+	 * saved?
+	 */
+	bool modified = false;
+
 	Mutex mutex;
 
 	struct Item final
@@ -57,6 +93,13 @@ class RemoteTagCache final {
 
 		Tag tag;
 
+		/**
+		 * Which list does this item belong to?
+		 */
+		enum class State {
+			QUEUED, WAITING, INVOKE, IDLE,
+		} state = State::QUEUED;
+
 		template<typename U>
 		Item(RemoteTagCache &_parent, U &&_uri) noexcept
 			:parent(_parent), uri(std::forward<U>(_uri)) {}
@@ -100,6 +143,12 @@ class RemoteTagCache final {
 	 */
 	ItemList idle_list;
 
+	/**
+	 * These items wait for a free #RemoteTagScanner slot.  The
+	 * front item is the next one to be started.
+	 */
+	ItemList queue_list;
+
 	/**
 	 * A #RemoteTagScanner instances is currently busy on fetching
 	 * information, and we're waiting for our #RemoteTagHandler
@@ -119,25 +168,90 @@ class RemoteTagCache final {
 						boost::intrusive::equal<Item::Equal>,
 						boost::intrusive::constant_time_size<true>> KeyMap;
 
-	std::array<typename KeyMap::bucket_type, 127> buckets;
+	std::unique_ptr<KeyMap::bucket_type[]> buckets;
 
 	KeyMap map;
 
 public:
+	/**
+	 * @param _max_scanners the maximum number of concurrent
+	 * #RemoteTagScanner instances
+	 * @param _path the cache file for Load() and Save(); may be
+	 * "nulled"
+	 */
 	RemoteTagCache(EventLoop &event_loop,
-		       RemoteTagCacheHandler &_handler) noexcept;
+		       RemoteTagCacheHandler &_handler,
+		       unsigned _max_scanners,
+		       AllocatedPath &&_path) noexcept;
 	~RemoteTagCache() noexcept;
 
+	/**
+	 * Load the cache file (if one was configured).  Errors are
+	 * logged.
+	 */
+	void Load() noexcept;
+
+	/**
+	 * Write the cache file if it was configured and items have
+	 * been resolved since it was loaded.  Errors are logged.
+	 */
+	void Save() noexcept;
+
 	void Lookup(const std::string &uri) noexcept;
 
+	/**
+	 * If the given URI is queued, scan it before all others.
+	 * This is a hint from a client which is about to display
+	 * the song.
+	 */
+	void Prioritize(const std::string &uri) noexcept;
+
+	/**
+	 * Returns an estimate of the memory occupied by all items
+	 * (not including the tag values, which live in the tag
+	 * pool).
+	 */
+	size_t GetMemoryUsage() noexcept;
+
+	/**
+	 * Evict resolved items (the oldest first) until at most the
+	 * given number of items remain.  Items which are still
+	 * being resolved are kept.
+	 */
+	void Shrink(size_t max_items) noexcept {
+		const std::lock_guard<Mutex> lock(mutex);
+		EvictIdle(max_items);
+	}
+
 private:
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void EvictIdle(size_t max_items) noexcept;
+
 	void InvokeHandlers() noexcept;
 
 	void ScheduleInvokeHandlers() noexcept {
 		defer_invoke_handler.Schedule();
 	}
 
+	/**
+	 * Start queued items until the #max_scanners limit is
+	 * reached.  The mutex is unlocked while a scanner is being
+	 * started.
+	 */
+	void StartScanners(std::unique_lock<Mutex> &lock) noexcept;
+
 	void ItemResolved(Item &item) noexcept;
+
+	/**
+	 * Enlarge the hash table if it holds more items than
+	 * buckets.
+	 */
+	void MaybeRehash() noexcept;
+
+	void LoadFile();
+	void SaveFile();
 };
 
 #endif
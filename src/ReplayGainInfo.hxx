@@ -29,6 +29,10 @@ struct ReplayGainTuple {
 	float gain;
 	float peak;
 
+	static constexpr ReplayGainTuple Undefined() noexcept {
+		return {-200.0f, 0.0f};
+	}
+
 	void Clear() {
 		gain = -200;
 		peak = 0.0;
@@ -45,6 +49,13 @@ struct ReplayGainTuple {
 struct ReplayGainInfo {
 	ReplayGainTuple track, album;
 
+	static constexpr ReplayGainInfo Undefined() noexcept {
+		return {
+			ReplayGainTuple::Undefined(),
+			ReplayGainTuple::Undefined(),
+		};
+	}
+
 	constexpr bool IsDefined() const noexcept {
 		return track.IsDefined() || album.IsDefined();
 	}
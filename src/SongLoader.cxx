@@ -21,11 +21,15 @@
 #include "LocateUri.hxx"
 #include "client/Client.hxx"
 #include "db/DatabaseSong.hxx"
+#include "db/Interface.hxx"
 #include "storage/StorageInterface.hxx"
 #include "song/DetachedSong.hxx"
 #include "PlaylistError.hxx"
 #include "config.h"
 
+#include <memory>
+#include <vector>
+
 #include <assert.h>
 
 #ifdef ENABLE_DATABASE
@@ -101,3 +105,51 @@ SongLoader::LoadSong(const char *uri_utf8) const
 					   );
 	return LoadSong(located_uri);
 }
+
+void
+SongLoader::LoadSongs(ConstBuffer<const char *> uris,
+		      const LoadSongsCallback &callback) const
+{
+#ifdef ENABLE_DATABASE
+	/* collect the database songs for one GetSongs() call */
+	std::vector<const char *> db_uris;
+	std::vector<std::size_t> db_indexes;
+#endif
+
+	for (std::size_t i = 0; i < uris.size; ++i) {
+		std::unique_ptr<DetachedSong> song;
+
+		try {
+			const auto located_uri = LocateUri(uris[i], client
+#ifdef ENABLE_DATABASE
+							   , storage
+#endif
+							   );
+
+#ifdef ENABLE_DATABASE
+			if (located_uri.type == LocatedUri::Type::RELATIVE &&
+			    db != nullptr) {
+				db_uris.push_back(located_uri.canonical_uri);
+				db_indexes.push_back(i);
+				continue;
+			}
+#endif
+
+			song = std::make_unique<DetachedSong>(LoadSong(located_uri));
+		} catch (...) {
+			continue;
+		}
+
+		callback(i, std::move(*song));
+	}
+
+#ifdef ENABLE_DATABASE
+	if (!db_uris.empty())
+		db->GetSongs({db_uris.data(), db_uris.size()},
+			     [this, &db_indexes, &callback](std::size_t i,
+							    const LightSong &song){
+				     callback(db_indexes[i],
+					      DatabaseDetachSong(storage, song));
+			     });
+#endif
+}
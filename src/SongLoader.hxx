@@ -20,10 +20,12 @@
 #ifndef MPD_SONG_LOADER_HXX
 #define MPD_SONG_LOADER_HXX
 
+#include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <cstddef>
+#include <functional>
 
 class Client;
 class Database;
@@ -75,6 +77,20 @@ public:
 	gcc_nonnull_all
 	DetachedSong LoadSong(const char *uri_utf8) const;
 
+	typedef std::function<void(std::size_t, DetachedSong &&)> LoadSongsCallback;
+
+	/**
+	 * Load many songs at once.  All database songs are looked up
+	 * with one Database::GetSongs() call, which is much faster
+	 * than calling LoadSong() for each of them.
+	 *
+	 * @param callback invoked (in no particular order) for each
+	 * song which was loaded successfully, with its index in
+	 * #uris; it must not access the database
+	 */
+	void LoadSongs(ConstBuffer<const char *> uris,
+		       const LoadSongsCallback &callback) const;
+
 private:
 	gcc_nonnull_all
 	DetachedSong LoadFromDatabase(const char *uri) const;
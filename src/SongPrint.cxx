@@ -29,10 +29,15 @@
 #include "fs/Traits.hxx"
 #include "util/ChronoUtil.hxx"
 #include "util/UriUtil.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Mask.hxx"
+
+#include <stdio.h>
+#include <string.h>
 
 #define SONG_FILE "file: "
 
-static void
+void
 song_print_uri(Response &r, const char *uri, bool base) noexcept
 {
 	std::string allocated;
@@ -81,9 +86,144 @@ PrintRange(Response &r, SongTime start_time, SongTime end_time) noexcept
 			 start_ms % 1000);
 }
 
+/**
+ * Builds the payload of a binary song block; see #SongBinaryField.
+ */
+class SongBinaryBuilder {
+	std::string s;
+
+	/**
+	 * Encode a LEB128 number.
+	 *
+	 * @return the number of bytes written (at most 10)
+	 */
+	static size_t EncodeNumber(char *p, uint64_t value) noexcept {
+		size_t n = 0;
+		while (value >= 0x80) {
+			p[n++] = char(value | 0x80);
+			value >>= 7;
+		}
+
+		p[n++] = char(value);
+		return n;
+	}
+
+	void AppendField(uint8_t id, const char *value, size_t length) {
+		char buffer[10];
+
+		s.push_back(char(id));
+		s.append(buffer, EncodeNumber(buffer, length));
+		s.append(value, length);
+	}
+
+public:
+	void AppendString(SongBinaryField id, const char *value) {
+		AppendField(uint8_t(id), value, strlen(value));
+	}
+
+	void AppendNumber(SongBinaryField id, uint64_t value) {
+		char buffer[10];
+		AppendField(uint8_t(id), buffer, EncodeNumber(buffer, value));
+	}
+
+	void AppendRange(SongTime start_time, SongTime end_time) {
+		char buffer[20];
+		size_t n = EncodeNumber(buffer, start_time.ToMS());
+		n += EncodeNumber(buffer + n, end_time.ToMS());
+		AppendField(uint8_t(SongBinaryField::RANGE), buffer, n);
+	}
+
+	void AppendTag(const Tag &tag, TagMask tag_mask) {
+		for (const auto &i : tag)
+			if (tag_mask.Test(i.type))
+				AppendField(uint8_t(i.type),
+					    i.value, strlen(i.value));
+	}
+
+	/**
+	 * Return the complete block: a "binary" header line, the
+	 * payload and a newline, like other binary responses.
+	 */
+	std::string Commit() const noexcept {
+		char header[32];
+		snprintf(header, sizeof(header), "binary: %zu\n", s.size());
+
+		std::string result(header);
+		result += s;
+		result += '\n';
+		return result;
+	}
+};
+
+static std::string
+RenderSongBinary(const char *uri,
+		 SongTime start_time, SongTime end_time,
+		 std::chrono::system_clock::time_point mtime,
+		 AudioFormat audio_format,
+		 SignedSongTime duration,
+		 const Tag &tag, TagMask tag_mask) noexcept
+{
+	SongBinaryBuilder b;
+
+	b.AppendString(SongBinaryField::URI, uri);
+
+	if (start_time.ToMS() > 0 || end_time.ToMS() > 0)
+		b.AppendRange(start_time, end_time);
+
+	if (!IsNegative(mtime))
+		b.AppendNumber(SongBinaryField::LAST_MODIFIED,
+			       std::chrono::system_clock::to_time_t(mtime));
+
+	if (audio_format.IsDefined())
+		b.AppendString(SongBinaryField::FORMAT,
+			       ToString(audio_format).c_str());
+
+	if (!duration.IsNegative())
+		b.AppendNumber(SongBinaryField::DURATION, duration.ToMS());
+
+	b.AppendTag(tag, tag_mask);
+
+	return b.Commit();
+}
+
+/**
+ * Determine the URI to be printed for the given #DetachedSong URI.
+ */
+static const char *
+GetPrintURI(const char *uri, bool base, std::string &allocated) noexcept
+{
+	if (base)
+		return PathTraitsUTF8::GetBase(uri);
+
+	allocated = uri_remove_auth(uri);
+	return allocated.empty() ? uri : allocated.c_str();
+}
+
 void
 song_print_info(Response &r, const LightSong &song, bool base) noexcept
 {
+	if (r.IsBinarySongs()) {
+		std::string uri;
+		if (!base && song.directory != nullptr) {
+			uri = song.directory;
+			uri.push_back('/');
+			uri += song.uri;
+		} else {
+			std::string allocated;
+			uri = GetPrintURI(song.uri, base, allocated);
+		}
+
+		const auto s = RenderSongBinary(uri.c_str(),
+						song.start_time,
+						song.end_time,
+						song.mtime,
+						song.audio_format,
+						song.tag.duration,
+						song.tag, r.GetTagMask());
+		r.Write(s.data(), s.size());
+		return;
+	}
+
 	song_print_uri(r, song, base);
 
 	PrintRange(r, song.start_time, song.end_time);
@@ -97,8 +237,8 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 	tag_print(r, song.tag);
 }
 
-void
-song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
+static void
+PrintSongInfo(Response &r, const DetachedSong &song, bool base) noexcept
 {
 	song_print_uri(r, song, base);
 
@@ -116,3 +256,59 @@ song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
 			 duration.RoundS(),
 			 duration.ToDoubleS());
 }
+
+static std::string
+RenderSongBinary(const DetachedSong &song, bool base,
+		 TagMask tag_mask) noexcept
+{
+	std::string allocated;
+	return RenderSongBinary(GetPrintURI(song.GetURI(), base, allocated),
+				song.GetStartTime(),
+				song.GetEndTime(),
+				song.GetLastModified(),
+				AudioFormat::Undefined(),
+				song.GetDuration(),
+				song.GetTag(), tag_mask);
+}
+
+void
+song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
+{
+	const auto tag_mask = r.GetTagMask();
+
+	const bool binary = r.IsBinarySongs();
+
+	if (base) {
+		if (binary) {
+			const auto s = RenderSongBinary(song, base, tag_mask);
+			r.Write(s.data(), s.size());
+		} else
+			PrintSongInfo(r, song, base);
+		return;
+	}
+
+	/* the block is cached in the DetachedSong, because clients
+	   tend to request the whole queue over and over */
+	const std::string *s = song.GetInfoCache(tag_mask, binary);
+	if (s != nullptr) {
+		r.Write(s->data(), s->size());
+		return;
+	}
+
+	if (binary) {
+		s = &song.SetInfoCache(tag_mask, binary,
+				       RenderSongBinary(song, base, tag_mask));
+		r.Write(s->data(), s->size());
+	} else {
+		/* print it with the usual functions, keeping a copy
+		   for the next time */
+		std::string text;
+
+		{
+			const ScopeResponseCapture capture(r, text);
+			PrintSongInfo(r, song, base);
+		}
+
+		song.SetInfoCache(tag_mask, binary, std::move(text));
+	}
+}
@@ -20,10 +20,49 @@
 #ifndef MPD_SONG_PRINT_HXX
 #define MPD_SONG_PRINT_HXX
 
+#include <stdint.h>
+
 struct LightSong;
 class DetachedSong;
 class Response;
 
+/**
+ * Field identifiers of the binary song encoding, which is enabled
+ * with the "songformat" command.  Each field consists of the
+ * identifier byte, the LEB128-encoded length of the value and the
+ * value.  Identifiers below #TAG_NUM_OF_ITEM_TYPES are tag values,
+ * identified by their #TagType.
+ */
+enum class SongBinaryField : uint8_t {
+	/**
+	 * The URI (a string).
+	 */
+	URI = 0x80,
+
+	/**
+	 * The start and end time in milliseconds (two LEB128
+	 * numbers); the end is zero if the song plays until the end
+	 * of the file.
+	 */
+	RANGE,
+
+	/**
+	 * The modification time in seconds since the epoch (a LEB128
+	 * number).
+	 */
+	LAST_MODIFIED,
+
+	/**
+	 * The audio format (a string, e.g. "44100:16:2").
+	 */
+	FORMAT,
+
+	/**
+	 * The duration in milliseconds (a LEB128 number).
+	 */
+	DURATION,
+};
+
 void
 song_print_info(Response &r, const DetachedSong &song,
 		bool base=false) noexcept;
@@ -31,6 +70,12 @@ song_print_info(Response &r, const DetachedSong &song,
 void
 song_print_info(Response &r, const LightSong &song, bool base=false) noexcept;
 
+/**
+ * Print a "file" line for the given song URI.
+ */
+void
+song_print_uri(Response &r, const char *uri, bool base=false) noexcept;
+
 void
 song_print_uri(Response &r, const LightSong &song, bool base=false) noexcept;
 
@@ -21,6 +21,8 @@
 #include "AudioParser.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "song/DetachedSong.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
 #include "TagSave.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
@@ -39,6 +41,10 @@
 
 #define SONG_MTIME "mtime"
 #define SONG_END "song_end"
+#define SONG_REPLAY_GAIN_TRACK "replay_gain_track"
+#define SONG_REPLAY_GAIN_ALBUM "replay_gain_album"
+#define SONG_MIXRAMP_START "mixramp_start"
+#define SONG_MIXRAMP_END "mixramp_end"
 
 static void
 range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
@@ -49,6 +55,38 @@ range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
 		os.Format("Range: %u-\n", start_ms);
 }
 
+static void
+replay_gain_tuple_save(BufferedOutputStream &os, const char *name,
+		       const ReplayGainTuple &tuple)
+{
+	if (tuple.IsDefined())
+		os.Format("%s: %.2f %.6f\n", name, tuple.gain, tuple.peak);
+}
+
+static void
+replay_gain_save(BufferedOutputStream &os, const ReplayGainInfo &info)
+{
+	replay_gain_tuple_save(os, SONG_REPLAY_GAIN_TRACK, info.track);
+	replay_gain_tuple_save(os, SONG_REPLAY_GAIN_ALBUM, info.album);
+}
+
+static void
+mix_ramp_save(BufferedOutputStream &os, const MixRampInfo &info)
+{
+	if (info.GetStart() != nullptr)
+		os.Format(SONG_MIXRAMP_START ": %s\n", info.GetStart());
+	if (info.GetEnd() != nullptr)
+		os.Format(SONG_MIXRAMP_END ": %s\n", info.GetEnd());
+}
+
+static void
+replay_gain_tuple_parse(ReplayGainTuple &tuple, const char *value)
+{
+	char *endptr;
+	tuple.gain = ParseFloat(value, &endptr);
+	tuple.peak = ParseFloat(endptr);
+}
+
 void
 song_save(BufferedOutputStream &os, const Song &song)
 {
@@ -61,6 +99,9 @@ song_save(BufferedOutputStream &os, const Song &song)
 	if (song.audio_format.IsDefined())
 		os.Format("Format: %s\n", ToString(song.audio_format).c_str());
 
+	replay_gain_save(os, song.replay_gain);
+	mix_ramp_save(os, song.mix_ramp);
+
 	if (!IsNegative(song.mtime))
 		os.Format(SONG_MTIME ": %li\n",
 			  (long)std::chrono::system_clock::to_time_t(song.mtime));
@@ -76,6 +117,9 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 
 	tag_save(os, song.GetTag());
 
+	replay_gain_save(os, song.GetReplayGain());
+	mix_ramp_save(os, song.GetMixRamp());
+
 	if (!IsNegative(song.GetLastModified()))
 		os.Format(SONG_MTIME ": %li\n",
 			  (long)std::chrono::system_clock::to_time_t(song.GetLastModified()));
@@ -89,6 +133,8 @@ song_load(TextFile &file, const char *uri,
 	auto song = std::make_unique<DetachedSong>(uri);
 
 	TagBuilder tag;
+	auto replay_gain = ReplayGainInfo::Undefined();
+	MixRampInfo mix_ramp;
 
 	char *line;
 	while ((line = file.ReadLine()) != nullptr &&
@@ -117,6 +163,14 @@ song_load(TextFile &file, const char *uri,
 			}
 		} else if (strcmp(line, "Playlist") == 0) {
 			tag.SetHasPlaylist(strcmp(value, "yes") == 0);
+		} else if (StringIsEqual(line, SONG_REPLAY_GAIN_TRACK)) {
+			replay_gain_tuple_parse(replay_gain.track, value);
+		} else if (StringIsEqual(line, SONG_REPLAY_GAIN_ALBUM)) {
+			replay_gain_tuple_parse(replay_gain.album, value);
+		} else if (StringIsEqual(line, SONG_MIXRAMP_START)) {
+			mix_ramp.SetStart(value);
+		} else if (StringIsEqual(line, SONG_MIXRAMP_END)) {
+			mix_ramp.SetEnd(value);
 		} else if (strcmp(line, SONG_MTIME) == 0) {
 			song->SetLastModified(std::chrono::system_clock::from_time_t(atoi(value)));
 		} else if (strcmp(line, "Range") == 0) {
@@ -135,5 +189,7 @@ song_load(TextFile &file, const char *uri,
 	}
 
 	song->SetTag(tag.Commit());
+	song->SetReplayGain(replay_gain);
+	song->SetMixRamp(std::move(mix_ramp));
 	return song;
 }
@@ -21,6 +21,7 @@
 #include "song/DetachedSong.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "db/plugins/simple/Directory.hxx"
+#include "db/update/TagScanCache.hxx"
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "util/UriUtil.hxx"
@@ -43,13 +44,13 @@
 
 Song *
 Song::LoadFile(Storage &storage, const char *path_utf8,
-	       Directory &parent) noexcept
+	       Directory &parent, TagScanCache *tag_cache) noexcept
 {
 	assert(!uri_has_scheme(path_utf8));
 	assert(strchr(path_utf8, '\n') == nullptr);
 
 	Song *song = NewFile(path_utf8, parent);
-	if (!song->UpdateFile(storage)) {
+	if (!song->UpdateFile(storage, tag_cache)) {
 		song->Free();
 		return nullptr;
 	}
@@ -62,7 +63,7 @@ Song::LoadFile(Storage &storage, const char *path_utf8,
 #ifdef ENABLE_DATABASE
 
 bool
-Song::UpdateFile(Storage &storage) noexcept
+Song::UpdateFile(Storage &storage, TagScanCache *tag_cache) noexcept
 {
 	const auto &relative_uri = GetURI();
 
@@ -76,10 +77,27 @@ Song::UpdateFile(Storage &storage) noexcept
 	if (!info.IsRegular())
 		return false;
 
+	/* the file has been modified; measure its loudness again */
+	replay_gain = ReplayGainInfo::Undefined();
+	mix_ramp.Clear();
+
 	TagBuilder tag_builder;
 	auto new_audio_format = AudioFormat::Undefined();
 
 	const auto path_fs = storage.MapFS(relative_uri.c_str());
+
+	std::string cache_key;
+	if (tag_cache != nullptr) {
+		const auto absolute_uri = path_fs.IsNull()
+			? storage.MapUTF8(relative_uri.c_str())
+			: path_fs.ToUTF8();
+		cache_key = TagScanCache::MakeKey(absolute_uri.c_str(), info);
+		if (tag_cache->Lookup(cache_key, info, tag, audio_format)) {
+			mtime = info.mtime;
+			return true;
+		}
+	}
+
 	if (path_fs.IsNull()) {
 		const auto absolute_uri =
 			storage.MapUTF8(relative_uri.c_str());
@@ -95,6 +113,10 @@ Song::UpdateFile(Storage &storage) noexcept
 	mtime = info.mtime;
 	audio_format = new_audio_format;
 	tag_builder.Commit(tag);
+
+	if (tag_cache != nullptr)
+		tag_cache->Store(cache_key, info, tag, audio_format);
+
 	return true;
 }
 
@@ -156,6 +178,7 @@ DetachedSong::LoadFile(Path path) noexcept
 	if (!ScanFileTagsWithGeneric(path, tag_builder))
 		return false;
 
+	InvalidateInfoCache();
 	mtime = fi.GetModificationTime();
 	tag_builder.Commit(tag);
 	return true;
@@ -166,7 +189,7 @@ DetachedSong::Update() noexcept
 {
 	if (IsAbsoluteFile()) {
 		const AllocatedPath path_fs =
-			AllocatedPath::FromUTF8(GetRealURI());
+			AllocatedPath::FromUTF8(GetRealURI().c_str());
 		if (path_fs.IsNull())
 			return false;
 
@@ -176,6 +199,7 @@ DetachedSong::Update() noexcept
 		if (!tag_stream_scan(uri.c_str(), tag_builder))
 			return false;
 
+		InvalidateInfoCache();
 		mtime = std::chrono::system_clock::time_point::min();
 		tag_builder.Commit(tag);
 		return true;
@@ -24,26 +24,53 @@
 #include "fs/io/TextFile.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/StringOutputStream.hxx"
 #include "storage/StorageState.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "mixer/Volume.hxx"
 #include "SongLoader.hxx"
+#include "thread/Name.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
 #include <exception>
 
+#include <assert.h>
 #include <string.h>
 
 static constexpr Domain state_file_domain("state_file");
 
+/**
+ * The number of queue entries resolved with the database in one
+ * event loop iteration during startup.
+ */
+static constexpr unsigned RESTORE_BATCH = 1024;
+
 StateFile::StateFile(StateFileConfig &&_config,
 		     Partition &_partition, EventLoop &_loop)
 	:config(std::move(_config)), path_utf8(config.path.ToUTF8()),
 	 timer_event(_loop, BIND_THIS_METHOD(OnTimeout)),
-	 partition(_partition)
+	 partition(_partition),
+	 restore_event(_loop, BIND_THIS_METHOD(OnRestore)),
+	 thread(BIND_THIS_METHOD(RunWriter))
+{
+}
+
+StateFile::~StateFile() noexcept
 {
+	restore.reset();
+
+	if (!thread.IsDefined())
+		return;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		quit = true;
+		cond.signal();
+	}
+
+	thread.Join();
 }
 
 void
@@ -92,15 +119,40 @@ StateFile::Write(OutputStream &os)
 	bos.Flush();
 }
 
+void
+StateFile::WriteFile(const std::string &data) noexcept
+{
+	try {
+		FileOutputStream fos(config.path);
+		fos.Write(data.data(), data.size());
+		fos.Sync();
+		fos.Commit();
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
 void
 StateFile::Write()
 {
+	if (restore) {
+		/* the file on disk still contains the complete
+		   queue, which is better than the partial one in
+		   memory */
+		LogDebug(state_file_domain,
+			 "Not saving the state file, the queue is still being restored");
+		return;
+	}
+
 	FormatDebug(state_file_domain,
 		    "Saving state file %s", path_utf8.c_str());
 
+	CancelWrite();
+
 	try {
 		FileOutputStream fos(config.path);
 		Write(fos);
+		fos.Sync();
 		fos.Commit();
 	} catch (...) {
 		LogError(std::current_exception());
@@ -109,6 +161,65 @@ StateFile::Write()
 	RememberVersions();
 }
 
+void
+StateFile::StartWrite(std::string &&data)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (!thread.IsDefined())
+		thread.Start();
+
+	pending = std::move(data);
+	has_pending = true;
+	cond.signal();
+}
+
+void
+StateFile::CancelWrite() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	has_pending = false;
+	pending.clear();
+
+	while (busy)
+		done_cond.wait(mutex);
+}
+
+void
+StateFile::RunWriter() noexcept
+{
+	SetThreadName("state_file");
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (true) {
+		if (quit)
+			break;
+
+		if (!has_pending) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		std::string data = std::move(pending);
+		pending.clear();
+		has_pending = false;
+		busy = true;
+
+		{
+			const ScopeUnlock unlock(mutex);
+			WriteFile(data);
+		}
+
+		busy = false;
+		done_cond.signal();
+	}
+}
+
 void
 StateFile::Read()
 try {
@@ -118,20 +229,15 @@ try {
 
 	TextFile file(config.path);
 
-#ifdef ENABLE_DATABASE
-	const SongLoader song_loader(partition.instance.database,
-				     partition.instance.storage);
-#else
-	const SongLoader song_loader(nullptr, nullptr);
-#endif
+	auto r = std::make_unique<PlaylistStateRestore>();
 
 	const char *line;
 	while ((line = file.ReadLine()) != nullptr) {
 		success = read_sw_volume_state(line, partition.outputs) ||
 			audio_output_state_read(line, partition.outputs) ||
-			playlist_state_restore(config, line, file, song_loader,
-					       partition.playlist,
-					       partition.pc);
+			playlist_state_read(line, file,
+					    partition.playlist, partition.pc,
+					    *r);
 #ifdef ENABLE_DATABASE
 		success = success || storage_state_restore(line, file, partition.instance);
 #endif
@@ -143,13 +249,55 @@ try {
 	}
 
 	RememberVersions();
+
+	restore = std::move(r);
+	OnRestore();
 } catch (...) {
 	LogError(std::current_exception());
 }
 
+bool
+StateFile::RestoreSome(unsigned max) noexcept
+{
+#ifdef ENABLE_DATABASE
+	const SongLoader song_loader(partition.instance.database,
+				     partition.instance.storage);
+#else
+	const SongLoader song_loader(nullptr, nullptr);
+#endif
+
+	return playlist_state_load_some(*restore, song_loader,
+					partition.playlist, max);
+}
+
+void
+StateFile::FinishRestore() noexcept
+{
+	playlist_state_finish(config, *restore,
+			      partition.playlist, partition.pc);
+	restore.reset();
+
+	RememberVersions();
+}
+
+void
+StateFile::OnRestore() noexcept
+{
+	assert(restore);
+
+	if (RestoreSome(RESTORE_BATCH))
+		FinishRestore();
+	else
+		/* let clients in before resolving the next batch */
+		restore_event.ScheduleYield();
+}
+
 void
 StateFile::CheckModified()
 {
+	if (restore)
+		return;
+
 	if (!timer_event.IsActive() && IsModified())
 		timer_event.Schedule(config.interval);
 }
@@ -157,5 +305,27 @@ StateFile::CheckModified()
 void
 StateFile::OnTimeout()
 {
-	Write();
+	FormatDebug(state_file_domain,
+		    "Saving state file %s", path_utf8.c_str());
+
+	/* render the snapshot here in the main thread (it's cheap),
+	   but leave the slow disk I/O to the writer thread */
+	StringOutputStream sos;
+
+	try {
+		Write(sos);
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
+
+	RememberVersions();
+
+	try {
+		StartWrite(std::move(sos.GetValue()));
+	} catch (...) {
+		/* failed to start the thread: write synchronously */
+		LogError(std::current_exception());
+		WriteFile(sos.GetValue());
+	}
 }
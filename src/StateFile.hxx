@@ -22,14 +22,20 @@
 
 #include "StateFileConfig.hxx"
 #include "event/TimerEvent.hxx"
+#include "event/DeferEvent.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <string>
+#include <memory>
 #include <chrono>
 
 struct Partition;
+struct PlaylistStateRestore;
 class OutputStream;
 class BufferedOutputStream;
 
@@ -42,6 +48,19 @@ class StateFile final {
 
 	Partition &partition;
 
+	/**
+	 * Resolves the restored queue in batches, so clients can
+	 * connect to MPD while a huge queue is still being loaded.
+	 */
+	DeferEvent restore_event;
+
+	/**
+	 * The queue which is being restored by #restore_event.  While
+	 * this is set, the state file is not written, because the
+	 * partial state would overwrite the complete one.
+	 */
+	std::unique_ptr<PlaylistStateRestore> restore;
+
 	/**
 	 * These version numbers determine whether we need to save the state
 	 * file.  If nothing has changed, we won't let the hard drive spin up.
@@ -53,11 +72,60 @@ class StateFile final {
 	unsigned prev_storage_version = 0;
 #endif
 
+	/**
+	 * This thread writes the snapshots rendered by OnTimeout() to
+	 * disk, so slow storage (and fsync()) does not stall the main
+	 * thread.  It is started on demand.
+	 */
+	Thread thread;
+
+	/**
+	 * Protects #pending, #has_pending, #busy and #quit.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Wakes up the writer thread.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the writer thread after it has finished a
+	 * write.
+	 */
+	Cond done_cond;
+
+	/**
+	 * The most recent snapshot which has not yet been picked up by
+	 * the writer thread.  A new snapshot replaces an older one
+	 * which was never written, i.e. writes are coalesced.
+	 */
+	std::string pending;
+
+	bool has_pending = false;
+
+	/**
+	 * Is the writer thread currently writing a snapshot?
+	 */
+	bool busy = false;
+
+	bool quit = false;
+
 public:
 	StateFile(StateFileConfig &&_config,
 		  Partition &partition, EventLoop &loop);
+	~StateFile() noexcept;
+
+	StateFile(const StateFile &) = delete;
+	StateFile &operator=(const StateFile &) = delete;
 
 	void Read();
+
+	/**
+	 * Write the state file synchronously (e.g. at shutdown).  A
+	 * snapshot which is still pending in the writer thread is
+	 * discarded, because this one is newer.
+	 */
 	void Write();
 
 	/**
@@ -69,6 +137,26 @@ private:
 	void Write(OutputStream &os);
 	void Write(BufferedOutputStream &os);
 
+	/**
+	 * Write the given snapshot to the state file, replacing it
+	 * atomically.  Errors are logged.
+	 */
+	void WriteFile(const std::string &data) noexcept;
+
+	/**
+	 * Submit a snapshot to the writer thread.
+	 */
+	void StartWrite(std::string &&data);
+
+	/**
+	 * Discard the pending snapshot and wait until the writer thread
+	 * is idle.
+	 */
+	void CancelWrite() noexcept;
+
+	/* the writer thread's entry point */
+	void RunWriter() noexcept;
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
@@ -81,8 +169,24 @@ private:
 	gcc_pure
 	bool IsModified() const noexcept;
 
+	/**
+	 * Resolve up to #max entries of #restore.
+	 *
+	 * @return true if the queue has been restored completely
+	 */
+	bool RestoreSome(unsigned max) noexcept;
+
+	/**
+	 * Apply the playback state after the queue has been
+	 * restored.
+	 */
+	void FinishRestore() noexcept;
+
 	/* callback for #timer_event */
 	void OnTimeout();
+
+	/* callback for #restore_event */
+	void OnRestore() noexcept;
 };
 
 #endif /* STATE_FILE_H */
@@ -21,14 +21,23 @@
 #include "Stats.hxx"
 #include "player/Control.hxx"
 #include "client/Response.hxx"
+#include "client/Client.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "db/QueryCache.hxx"
+#include "MemoryBudget.hxx"
+#include "tag/Pool.hxx"
 #include "system/Clock.hxx"
 #include "Log.hxx"
 #include "util/ChronoUtil.hxx"
+#include "util/SegmentBuffer.hxx"
+
+#ifdef ENABLE_CURL
+#include "RemoteTagCache.hxx"
+#endif
 
 #include <chrono>
 #include <cmath>
@@ -85,6 +94,12 @@ stats_update(const Database &db)
 	}
 }
 
+const DatabaseStats *
+stats_get_database(const Database &db)
+{
+	return stats_update(db) ? &stats : nullptr;
+}
+
 static void
 db_stats_print(Response &r, const Database &db)
 {
@@ -109,23 +124,140 @@ db_stats_print(Response &r, const Database &db)
 			 (unsigned long)std::chrono::system_clock::to_time_t(update_stamp));
 }
 
+static void
+query_cache_stats_print(Response &r, const DatabaseQueryCache &cache)
+{
+	r.Format("db_cache_hits: %u\n"
+		 "db_cache_misses: %u\n",
+		 cache.GetHits(), cache.GetMisses());
+}
+
+#endif
+
+static const char *
+ToString(HugePageMode mode) noexcept
+{
+	switch (mode) {
+	case HugePageMode::NONE:
+		break;
+
+	case HugePageMode::TRANSPARENT:
+		return "transparent";
+
+	case HugePageMode::EXPLICIT:
+		return "explicit";
+	}
+
+	return "no";
+}
+
+static void
+buffer_stats_print(Response &r, const PlayerControl &pc)
+{
+	const auto buffer_stats = pc.LockGetBufferStats();
+	if (buffer_stats.size == 0)
+		return;
+
+	r.Format("buffer_size: %lu\n"
+		 "buffer_huge_pages: %s\n"
+		 "buffer_resident: %lu\n"
+		 "buffer_huge: %lu\n"
+		 "buffer_locked: %lu\n",
+		 (unsigned long)buffer_stats.size,
+		 ToString(buffer_stats.huge_pages),
+		 (unsigned long)buffer_stats.usage.resident,
+		 (unsigned long)buffer_stats.usage.huge,
+		 (unsigned long)buffer_stats.usage.locked);
+
+	if (buffer_stats.prefault_duration > buffer_stats.prefault_duration.zero())
+		r.Format("buffer_prefault_ms: %lu\n",
+			 (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(buffer_stats.prefault_duration).count());
+}
+
+static void
+client_output_stats_print(Response &r, const SegmentPool &pool)
+{
+	r.Format("output_buffer: %lu\n"
+		 "output_buffer_idle: %lu\n",
+		 (unsigned long)pool.GetBusySize(),
+		 (unsigned long)pool.GetIdleSize());
+}
+
+unsigned
+stats_get_uptime() noexcept
+{
+#ifdef _WIN32
+	return GetProcessUptimeS();
+#else
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start_time).count();
 #endif
+}
 
 void
 stats_print(Response &r, const Partition &partition)
 {
 	r.Format("uptime: %u\n"
 		 "playtime: %lu\n",
-#ifdef _WIN32
-		 GetProcessUptimeS(),
-#else
-		 (unsigned)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start_time).count(),
-#endif
+		 stats_get_uptime(),
 		 std::lround(partition.pc.GetTotalPlayTime().count()));
 
+	buffer_stats_print(r, partition.pc);
+	client_output_stats_print(r, client_output_pool);
+
 #ifdef ENABLE_DATABASE
 	const Database *db = partition.instance.database;
 	if (db != nullptr)
 		db_stats_print(r, *db);
+
+	const auto *query_cache = partition.instance.query_cache.get();
+	if (query_cache != nullptr)
+		query_cache_stats_print(r, *query_cache);
 #endif
 }
+
+void
+memstats_print(Response &r, Instance &instance)
+{
+	const size_t resident = GetProcessResidentSize();
+	if (resident > 0)
+		r.Format("resident: %zu\n", resident);
+
+	size_t music_buffer = 0, music_buffer_resident = 0, queue = 0;
+	for (const auto &partition : instance.partitions) {
+		const auto buffer_stats = partition.pc.LockGetBufferStats();
+		music_buffer += buffer_stats.size;
+		music_buffer_resident += buffer_stats.usage.resident;
+
+		queue += partition.playlist.queue.GetMemoryUsage();
+	}
+
+	r.Format("music_buffer: %zu\n"
+		 "music_buffer_resident: %zu\n"
+		 "queue: %zu\n",
+		 music_buffer, music_buffer_resident, queue);
+
+	r.Format("tag_pool: %zu\n"
+		 "client_output_buffer: %zu\n"
+		 "client_output_buffer_idle: %zu\n",
+		 tag_pool_get_stats().n_bytes,
+		 client_output_pool.GetBusySize(),
+		 client_output_pool.GetIdleSize());
+
+#ifdef ENABLE_DATABASE
+	if (instance.query_cache != nullptr)
+		r.Format("query_cache: %zu\n",
+			 instance.query_cache->GetSize());
+#endif
+
+#ifdef ENABLE_CURL
+	if (instance.remote_tag_cache != nullptr)
+		r.Format("remote_tag_cache: %zu\n",
+			 instance.remote_tag_cache->GetMemoryUsage());
+#endif
+
+	if (instance.memory_budget != nullptr)
+		r.Format("memory_budget: %zu\n"
+			 "memory_pressure: %d\n",
+			 instance.memory_budget->GetBudget(),
+			 instance.memory_budget->IsUnderPressure());
+}
@@ -20,13 +20,42 @@
 #ifndef MPD_STATS_HXX
 #define MPD_STATS_HXX
 
+#include "config.h"
+
 class Response;
 struct Partition;
+struct Instance;
+class Database;
+struct DatabaseStats;
 
 void
 stats_invalidate();
 
+/**
+ * Returns the number of seconds since MPD was started.
+ */
+unsigned
+stats_get_uptime() noexcept;
+
+#ifdef ENABLE_DATABASE
+
+/**
+ * Returns the (cached) statistics of the whole database, or nullptr
+ * on error.
+ */
+const DatabaseStats *
+stats_get_database(const Database &db);
+
+#endif
+
 void
 stats_print(Response &r, const Partition &partition);
 
+/**
+ * Print an estimate of the memory used by each subsystem (the
+ * "memstats" command).
+ */
+void
+memstats_print(Response &r, Instance &instance);
+
 #endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STATUS_CACHE_HXX
+#define MPD_STATUS_CACHE_HXX
+
+#include "player/Control.hxx"
+#include "tag/Mask.hxx"
+
+#include <exception>
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * The values which determine the "status" response (except for the
+ * elapsed time).  Options and errors are covered by
+ * Instance::idle_generation.
+ */
+struct StatusCacheKey {
+	unsigned idle_generation;
+	int volume;
+	uint32_t playlist_version;
+	int current, next;
+	unsigned update_id;
+	PlayerState state;
+	uint16_t bit_rate;
+	AudioFormat audio_format;
+	SignedSongTime total_time;
+	unsigned underruns;
+	std::exception_ptr error;
+
+	bool operator==(const StatusCacheKey &other) const noexcept {
+		return idle_generation == other.idle_generation &&
+			volume == other.volume &&
+			playlist_version == other.playlist_version &&
+			current == other.current && next == other.next &&
+			update_id == other.update_id &&
+			state == other.state &&
+			bit_rate == other.bit_rate &&
+			audio_format == other.audio_format &&
+			total_time == other.total_time &&
+			underruns == other.underruns &&
+			error == other.error;
+	}
+};
+
+/**
+ * A preformatted "status" response, so clients which poll it do
+ * not cost more than a copy.  The "time" and "elapsed" lines are
+ * formatted for each request between #head and #tail.
+ */
+struct StatusCache {
+	StatusCacheKey key;
+
+	bool valid = false;
+
+	std::string head, tail;
+};
+
+/**
+ * A preformatted "currentsong" response.  It depends on the client's
+ * tag mask and song format, which are part of the key.
+ */
+struct CurrentSongCache {
+	uint32_t playlist_version;
+	int position;
+	TagMask tag_mask = TagMask::None();
+	bool binary;
+
+	bool valid = false;
+
+	std::string text;
+
+	bool Check(uint32_t _version, int _position,
+		   TagMask _tag_mask, bool _binary) const noexcept {
+		return valid && playlist_version == _version &&
+			position == _position &&
+			tag_mask == _tag_mask && binary == _binary;
+	}
+
+	void Set(uint32_t _version, int _position,
+		 TagMask _tag_mask, bool _binary) noexcept {
+		playlist_version = _version;
+		position = _position;
+		tag_mask = _tag_mask;
+		binary = _binary;
+		valid = true;
+	}
+};
+
+#endif
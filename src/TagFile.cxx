@@ -26,14 +26,21 @@
 #include "decoder/DecoderPlugin.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
+#include "system/UniqueFileDescriptor.hxx"
 
 #include <exception>
 
 #include <assert.h>
+#include <fcntl.h>
+
+/**
+ * The number of bytes at the beginning and at the end of a file
+ * covered by PrefetchFileTags().
+ */
+static constexpr uint64_t TAG_PREFETCH_SIZE = 64 * 1024;
 
 class TagFileScan {
 	const Path path_fs;
-	const char *const suffix;
 
 	TagHandler &handler;
 
@@ -41,9 +48,8 @@ class TagFileScan {
 	InputStreamPtr is;
 
 public:
-	TagFileScan(Path _path_fs, const char *_suffix,
-		    TagHandler &_handler) noexcept
-		:path_fs(_path_fs), suffix(_suffix),
+	TagFileScan(Path _path_fs, TagHandler &_handler) noexcept
+		:path_fs(_path_fs),
 		 handler(_handler),
 		 is(nullptr) {}
 
@@ -74,8 +80,7 @@ public:
 	}
 
 	bool Scan(const DecoderPlugin &plugin) noexcept {
-		return plugin.SupportsSuffix(suffix) &&
-			(ScanFile(plugin) || ScanStream(plugin));
+		return ScanFile(plugin) || ScanStream(plugin);
 	}
 };
 
@@ -92,10 +97,11 @@ ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler) noexcept
 
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
-	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
-			return tfs.Scan(plugin);
-		});
+	TagFileScan tfs(path_fs, handler);
+	return decoder_plugins_try_suffix(suffix_utf8.c_str(),
+					  [&](const DecoderPlugin &plugin){
+						  return tfs.Scan(plugin);
+					  });
 }
 
 bool
@@ -112,3 +118,25 @@ ScanFileTagsWithGeneric(Path path, TagBuilder &builder,
 
 	return true;
 }
+
+void
+PrefetchFileTags(Path path, uint64_t size) noexcept
+{
+#ifdef POSIX_FADV_WILLNEED
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly(path.c_str()))
+		return;
+
+	if (size <= 2 * TAG_PREFETCH_SIZE) {
+		posix_fadvise(fd.Get(), 0, size, POSIX_FADV_WILLNEED);
+	} else {
+		posix_fadvise(fd.Get(), 0, TAG_PREFETCH_SIZE,
+			      POSIX_FADV_WILLNEED);
+		posix_fadvise(fd.Get(), size - TAG_PREFETCH_SIZE,
+			      TAG_PREFETCH_SIZE, POSIX_FADV_WILLNEED);
+	}
+#else
+	(void)path;
+	(void)size;
+#endif
+}
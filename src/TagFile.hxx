@@ -20,6 +20,8 @@
 #ifndef MPD_TAG_FILE_HXX
 #define MPD_TAG_FILE_HXX
 
+#include <stdint.h>
+
 struct AudioFormat;
 class Path;
 class TagHandler;
@@ -48,4 +50,20 @@ bool
 ScanFileTagsWithGeneric(Path path, TagBuilder &builder,
 			AudioFormat *audio_format=nullptr) noexcept;
 
+/**
+ * Announce that the tags of this song file will be scanned soon.
+ * This starts asynchronous read-ahead of the regions which tag
+ * scanners usually read: the beginning of the file (format headers,
+ * ID3v2, Vorbis comments) and its end (ID3v1, APE).
+ *
+ * Batch scanners (i.e. the database update) call this for many files
+ * before they scan them.  The kernel can then merge and sort the disk
+ * reads, and the scanners are served from the page cache.  Errors
+ * are ignored.
+ *
+ * @param size the size of the file in bytes
+ */
+void
+PrefetchFileTags(Path path, uint64_t size) noexcept;
+
 #endif
@@ -21,6 +21,7 @@
 #include "tag/Tag.hxx"
 #include "tag/Settings.hxx"
 #include "client/Response.hxx"
+#include "util/StringView.hxx"
 
 void
 tag_print_types(Response &r) noexcept
@@ -36,6 +37,13 @@ tag_print(Response &r, TagType type, const char *value) noexcept
 	r.Format("%s: %s\n", tag_item_names[type], value);
 }
 
+void
+tag_print(Response &r, TagType type, StringView value) noexcept
+{
+	r.Format("%s: %.*s\n", tag_item_names[type],
+		 int(value.size), value.data);
+}
+
 void
 tag_print_values(Response &r, const Tag &tag) noexcept
 {
@@ -25,6 +25,7 @@
 enum TagType : uint8_t;
 
 struct Tag;
+struct StringView;
 class Response;
 
 void
@@ -33,6 +34,9 @@ tag_print_types(Response &response) noexcept;
 void
 tag_print(Response &response, TagType type, const char *value) noexcept;
 
+void
+tag_print(Response &response, TagType type, StringView value) noexcept;
+
 void
 tag_print_values(Response &response, const Tag &tag) noexcept;
 
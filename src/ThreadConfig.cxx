@@ -0,0 +1,159 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ThreadConfig.hxx"
+#include "config/Data.hxx"
+#include "config/Block.hxx"
+#include "thread/Util.hxx"
+#include "thread/Slack.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <string.h>
+
+ThreadConfig player_thread_config;
+ThreadConfig decoder_thread_config;
+ThreadConfig update_thread_config;
+
+static unsigned
+ParseCpuNumber(const char *s, char **endptr)
+{
+	const unsigned long value = strtoul(s, endptr, 10);
+	if (*endptr == s)
+		throw FormatRuntimeError("CPU number expected: \"%s\"", s);
+
+	if (value >= 64)
+		throw FormatRuntimeError("CPU number too large: %lu", value);
+
+	return value;
+}
+
+uint64_t
+ParseCpuList(const char *s)
+{
+	uint64_t mask = 0;
+
+	while (true) {
+		char *endptr;
+		const unsigned first = ParseCpuNumber(s, &endptr);
+		unsigned last = first;
+		s = endptr;
+
+		if (*s == '-') {
+			last = ParseCpuNumber(s + 1, &endptr);
+			s = endptr;
+
+			if (last < first)
+				throw std::runtime_error("Malformed CPU range");
+		}
+
+		for (unsigned i = first; i <= last; ++i)
+			mask |= uint64_t(1) << i;
+
+		if (*s == 0)
+			break;
+
+		if (*s != ',')
+			throw FormatRuntimeError("Malformed CPU list: \"%s\"",
+						 s);
+
+		++s;
+	}
+
+	return mask;
+}
+
+void
+ThreadConfig::Load(const ConfigBlock &block)
+{
+	const char *affinity = block.GetBlockValue("cpu_affinity");
+	if (affinity != nullptr)
+		cpu_affinity = ParseCpuList(affinity);
+
+	realtime_priority = block.GetBlockValue("realtime_priority",
+						realtime_priority);
+	if (realtime_priority > 99)
+		throw std::runtime_error("realtime_priority must be 0..99");
+
+	timer_slack_us = block.GetBlockValue("timer_slack", timer_slack_us);
+}
+
+void
+ThreadConfig::Apply(const char *name) const noexcept
+{
+	if (cpu_affinity != 0) {
+		try {
+			SetThreadAffinity(cpu_affinity);
+		} catch (...) {
+			FormatError(std::current_exception(),
+				    "Thread '%s' could not set its CPU affinity, continuing anyway",
+				    name);
+		}
+	}
+
+	if (timer_slack_us > 0)
+		SetThreadTimerSlackUS(timer_slack_us);
+
+	if (realtime_priority > 0) {
+		try {
+			SetThreadRealtime(realtime_priority);
+		} catch (...) {
+			FormatError(std::current_exception(),
+				    "Thread '%s' could not get realtime scheduling, continuing anyway",
+				    name);
+		}
+	}
+}
+
+static ThreadConfig &
+GetThreadConfig(const char *name)
+{
+	if (strcmp(name, "player") == 0)
+		return player_thread_config;
+	else if (strcmp(name, "decoder") == 0)
+		return decoder_thread_config;
+	else if (strcmp(name, "update") == 0)
+		return update_thread_config;
+	else
+		throw FormatRuntimeError("No such thread: %s", name);
+}
+
+void
+thread_config_global_init(const ConfigData &config)
+{
+	for (const auto &block : config.GetBlockList(ConfigBlockOption::THREAD)) {
+		block.SetUsed();
+
+		try {
+			const char *name = block.GetBlockValue("name");
+			if (name == nullptr)
+				throw std::runtime_error("Missing \"name\" setting");
+
+			GetThreadConfig(name).Load(block);
+		} catch (...) {
+			std::throw_with_nested(FormatRuntimeError("Failed to configure thread in line %i",
+								  block.line));
+		}
+	}
+}
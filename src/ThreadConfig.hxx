@@ -0,0 +1,96 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREAD_CONFIG_HXX
+#define MPD_THREAD_CONFIG_HXX
+
+#include <stdint.h>
+
+struct ConfigData;
+struct ConfigBlock;
+
+/**
+ * Scheduling settings for one kind of thread: CPU affinity,
+ * SCHED_FIFO priority and timer slack.
+ */
+struct ThreadConfig {
+	/**
+	 * A bit mask of CPUs this thread may run on (bit N = CPU N);
+	 * 0 means no restriction.
+	 */
+	uint64_t cpu_affinity = 0;
+
+	/**
+	 * The SCHED_FIFO priority; 0 means don't request real-time
+	 * scheduling.
+	 */
+	unsigned realtime_priority;
+
+	/**
+	 * The timer slack in microseconds; 0 means don't change it.
+	 */
+	unsigned timer_slack_us;
+
+	constexpr ThreadConfig(unsigned _realtime_priority=0,
+			       unsigned _timer_slack_us=0) noexcept
+		:realtime_priority(_realtime_priority),
+		 timer_slack_us(_timer_slack_us) {}
+
+	/**
+	 * Load settings from a configuration block ("cpu_affinity",
+	 * "realtime_priority", "timer_slack"), keeping the current
+	 * values as defaults.
+	 *
+	 * Throws on error.
+	 */
+	void Load(const ConfigBlock &block);
+
+	/**
+	 * Apply these settings to the current thread.  Errors are
+	 * logged and otherwise ignored.
+	 *
+	 * @param name the thread name used in log messages
+	 */
+	void Apply(const char *name) const noexcept;
+};
+
+extern ThreadConfig player_thread_config;
+extern ThreadConfig decoder_thread_config;
+extern ThreadConfig update_thread_config;
+
+/**
+ * Parse a list of CPU numbers and ranges, e.g. "0,2-3".
+ *
+ * Throws on error.
+ *
+ * @return a bit mask (bit N = CPU N)
+ */
+uint64_t
+ParseCpuList(const char *s);
+
+/**
+ * Load the "thread" blocks from the configuration file.
+ *
+ * Throws on error.
+ */
+void
+thread_config_global_init(const ConfigData &config);
+
+#endif
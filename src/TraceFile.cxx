@@ -0,0 +1,99 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "TraceFile.hxx"
+#include "util/Trace.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+AllocatedPath trace_file = nullptr;
+
+static void
+WriteJsonString(BufferedOutputStream &os, const char *s)
+{
+	os.Write('"');
+
+	for (; *s != 0; ++s) {
+		const char ch = *s;
+		if (ch == '"' || ch == '\\') {
+			os.Write('\\');
+			os.Write(ch);
+		} else if ((unsigned char)ch < 0x20)
+			os.Format("\\u%04x", (unsigned char)ch);
+		else
+			os.Write(ch);
+	}
+
+	os.Write('"');
+}
+
+void
+TraceSave(Path path)
+{
+#ifdef _WIN32
+	const unsigned pid = 1;
+#else
+	const unsigned pid = getpid();
+#endif
+
+	const auto snapshot = TraceGetSnapshot();
+
+	FileOutputStream file(path);
+	BufferedOutputStream os(file);
+
+	os.Write("{\"traceEvents\":[\n");
+
+	bool first = true;
+
+	for (const auto &t : snapshot.threads) {
+		if (!first)
+			os.Write(",\n");
+		first = false;
+
+		os.Format("{\"name\":\"thread_name\",\"ph\":\"M\","
+			  "\"pid\":%u,\"tid\":%u,\"args\":{\"name\":",
+			  pid, t.id);
+		WriteJsonString(os, t.name.empty() ? "unknown" : t.name.c_str());
+		os.Write("}}");
+	}
+
+	for (const auto &e : snapshot.events) {
+		if (!first)
+			os.Write(",\n");
+		first = false;
+
+		os.Write("{\"name\":");
+		WriteJsonString(os, e.name);
+		os.Format(",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+			  "\"ts\":%lld,\"dur\":%lld}",
+			  pid, e.thread,
+			  (long long)e.start, (long long)e.duration);
+	}
+
+	os.Write("\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	os.Flush();
+	file.Commit();
+}
@@ -31,7 +31,11 @@
 
 #include <bzlib.h>
 
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
+
+#include <stdint.h>
 
 class Bzip2ArchiveFile final : public ArchiveFile {
 	std::string name;
@@ -55,14 +59,76 @@ public:
 				  Mutex &mutex) override;
 };
 
+/**
+ * The position of one bzip2 block.  Each block can be decompressed
+ * independently of the others, so it is a seek checkpoint which does
+ * not need a saved decompressor state.
+ */
+struct Bzip2Block {
+	/**
+	 * The bit offset of the block header within the compressed
+	 * file.
+	 */
+	uint64_t bit_offset;
+
+	/**
+	 * The offset of the block's first byte within the
+	 * uncompressed stream.
+	 */
+	uint64_t offset;
+};
+
 class Bzip2InputStream final : public InputStream {
+	static constexpr uint64_t BLOCK_MAGIC = 0x314159265359;
+	static constexpr uint64_t EOS_MAGIC = 0x177245385090;
+	static constexpr uint64_t MAGIC_MASK = (uint64_t(1) << 48) - 1;
+
+	static constexpr uint64_t NO_BLOCK = ~uint64_t(0);
+
 	std::shared_ptr<InputStream> input;
 
 	bool eof = false;
 
+	/**
+	 * Has BZ2_bzDecompressInit() been called on #bzstream?
+	 */
+	bool initialized = false;
+
 	bz_stream bzstream;
 
-	char buffer[5000];
+	/**
+	 * All blocks which have been found so far, ordered by
+	 * offset.  The first one is found by Open(), and each
+	 * following one when its predecessor has been decompressed.
+	 */
+	std::vector<Bzip2Block> blocks;
+
+	/**
+	 * The index of the block being decompressed in #blocks.
+	 */
+	size_t current_block;
+
+	/**
+	 * The bit offset of the block following the current one, or
+	 * #NO_BLOCK if this is the last one.
+	 */
+	uint64_t next_block_bit;
+
+	/**
+	 * The current block, wrapped in a self-contained single-block
+	 * bzip2 stream (the same trick as bzip2recover uses).
+	 */
+	std::vector<uint8_t> block_data;
+
+	/**
+	 * The offset of the end of #buffer within the compressed
+	 * file.
+	 */
+	uint64_t buffer_offset = 0;
+
+	size_t buffer_position = 0, buffer_fill = 0;
+
+	uint8_t buffer[5000];
 
 public:
 	Bzip2InputStream(const std::shared_ptr<InputStream> &_input,
@@ -73,10 +139,86 @@ public:
 	/* virtual methods from InputStream */
 	bool IsEOF() noexcept override;
 	size_t Read(void *ptr, size_t size) override;
+	void Seek(offset_type offset) override;
 
 private:
 	void Open();
-	bool FillBuffer();
+
+	/**
+	 * Move the read position within the compressed file.
+	 */
+	void SeekCompressed(uint64_t new_offset);
+
+	/**
+	 * Read the next byte from the compressed file.
+	 *
+	 * @return the byte or -1 on end of file
+	 */
+	int NextByte();
+
+	/**
+	 * Find the next block header at or after the given bit
+	 * offset.
+	 *
+	 * @return the bit offset of the block or #NO_BLOCK
+	 */
+	uint64_t FindBlock(uint64_t bit_offset);
+
+	/**
+	 * Copy the block at the given bit offset into #block_data.
+	 *
+	 * @return the bit offset of the following block or #NO_BLOCK
+	 */
+	uint64_t LoadBlock(uint64_t bit_offset);
+
+	/**
+	 * Start decompressing the specified block from #blocks.
+	 */
+	void StartBlock(size_t i);
+
+	/**
+	 * Like Read(), but the caller has unlocked the mutex.
+	 */
+	size_t ReadUnlocked(void *ptr, size_t length);
+};
+
+/**
+ * Appends bits to a byte vector, most significant bit first.
+ */
+class BitWriter {
+	std::vector<uint8_t> &dest;
+
+	unsigned value = 0, n_bits = 0;
+
+public:
+	explicit BitWriter(std::vector<uint8_t> &_dest) noexcept
+		:dest(_dest) {}
+
+	void Put(uint64_t bits, unsigned n) {
+		while (n > 0) {
+			--n;
+			value = (value << 1) | ((bits >> n) & 1);
+			if (++n_bits == 8) {
+				dest.push_back(value);
+				value = n_bits = 0;
+			}
+		}
+	}
+
+	void PutByte(uint8_t b) {
+		if (n_bits == 0)
+			dest.push_back(b);
+		else
+			Put(b, 8);
+	}
+
+	/**
+	 * Pad the last byte with zero bits.
+	 */
+	void Flush() {
+		if (n_bits > 0)
+			Put(0, 8 - n_bits);
+	}
 };
 
 /* single archive handling allocation helpers */
@@ -84,16 +226,25 @@ private:
 inline void
 Bzip2InputStream::Open()
 {
-	bzstream.bzalloc = nullptr;
-	bzstream.bzfree = nullptr;
-	bzstream.opaque = nullptr;
-
-	bzstream.next_in = (char *)buffer;
-	bzstream.avail_in = 0;
-
-	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
-	if (ret != BZ_OK)
-		throw std::runtime_error("BZ2_bzDecompressInit() has failed");
+	seekable = true;
+
+	uint8_t header[4];
+	input->LockReadFull(header, sizeof(header));
+	buffer_offset = sizeof(header);
+
+	if (header[0] != 'B' || header[1] != 'Z' || header[2] != 'h' ||
+	    header[3] < '1' || header[3] > '9')
+		throw std::runtime_error("Not a bzip2 file");
+
+	const uint64_t first = FindBlock(sizeof(header) * 8);
+	if (first == NO_BLOCK) {
+		/* an empty stream */
+		eof = true;
+		size = 0;
+	} else {
+		blocks.push_back({first, 0});
+		StartBlock(0);
+	}
 
 	SetReady();
 }
@@ -121,64 +272,270 @@ Bzip2InputStream::Bzip2InputStream(const std::shared_ptr<InputStream> &_input,
 
 Bzip2InputStream::~Bzip2InputStream()
 {
-	BZ2_bzDecompressEnd(&bzstream);
+	if (initialized)
+		BZ2_bzDecompressEnd(&bzstream);
 }
 
 InputStreamPtr
 Bzip2ArchiveFile::OpenStream(const char *path,
 			     Mutex &mutex)
 {
+	/* a previous Bzip2InputStream may have moved the file
+	   position */
+	istream->LockSeek(0);
+
 	return std::make_unique<Bzip2InputStream>(istream, path, mutex);
 }
 
-inline bool
-Bzip2InputStream::FillBuffer()
+void
+Bzip2InputStream::SeekCompressed(uint64_t new_offset)
 {
-	if (bzstream.avail_in > 0)
-		return true;
+	const uint64_t buffer_start = buffer_offset - buffer_fill;
+	if (new_offset >= buffer_start && new_offset < buffer_offset) {
+		buffer_position = new_offset - buffer_start;
+		return;
+	}
 
-	size_t count = input->LockRead(buffer, sizeof(buffer));
-	if (count == 0)
-		return false;
+	input->LockSeek(new_offset);
+	buffer_offset = new_offset;
+	buffer_position = buffer_fill = 0;
+}
 
-	bzstream.next_in = buffer;
-	bzstream.avail_in = count;
-	return true;
+inline int
+Bzip2InputStream::NextByte()
+{
+	if (buffer_position == buffer_fill) {
+		size_t nbytes = input->LockRead(buffer, sizeof(buffer));
+		if (nbytes == 0)
+			return -1;
+
+		buffer_offset += nbytes;
+		buffer_position = 0;
+		buffer_fill = nbytes;
+	}
+
+	return buffer[buffer_position++];
 }
 
-size_t
-Bzip2InputStream::Read(void *ptr, size_t length)
+uint64_t
+Bzip2InputStream::FindBlock(uint64_t bit_offset)
 {
-	const ScopeUnlock unlock(mutex);
+	SeekCompressed(bit_offset / 8);
 
-	int bz_result;
-	size_t nbytes = 0;
+	/* the most recently read bits; the least significant bit is
+	   the newest one */
+	uint64_t window = 0;
 
-	if (eof)
-		return 0;
+	/* the number of bits read since "bit_offset" */
+	uint64_t n_bits = 0;
 
-	bzstream.next_out = (char *)ptr;
-	bzstream.avail_out = length;
+	unsigned skip = bit_offset % 8;
 
-	do {
-		if (!FillBuffer())
-			return 0;
+	int b;
+	while ((b = NextByte()) >= 0) {
+		const unsigned n = 8 - skip;
+		window = (window << n) | (b & (0xff >> skip));
+		n_bits += n;
+		skip = 0;
 
-		bz_result = BZ2_bzDecompress(&bzstream);
+		/* check all magic numbers which end in one of the
+		   new bits */
+		for (unsigned i = n; i-- > 0;) {
+			if (n_bits - i < 48)
+				continue;
 
-		if (bz_result == BZ_STREAM_END) {
-			eof = true;
-			break;
+			if (((window >> i) & MAGIC_MASK) == BLOCK_MAGIC)
+				return bit_offset + n_bits - i - 48;
 		}
+	}
+
+	return NO_BLOCK;
+}
+
+uint64_t
+Bzip2InputStream::LoadBlock(uint64_t bit_offset)
+{
+	/* the block size digit '9' is the maximum, so every block
+	   fits */
+	block_data.assign({'B', 'Z', 'h', '9'});
+	BitWriter writer(block_data);
+
+	SeekCompressed(bit_offset / 8);
+
+	/* the most recently read bits; the least significant bit is
+	   the newest one */
+	uint64_t window = 0;
+
+	/* the number of bits in #window which have not yet been
+	   copied to #block_data; the last 48 bits are held back
+	   because they may be the beginning of the next magic
+	   number */
+	unsigned pending = 0;
+
+	/* the number of bits read since "bit_offset" */
+	uint64_t n_bits = 0;
+
+	unsigned skip = bit_offset % 8;
+
+	while (true) {
+		int b = NextByte();
+		if (b < 0)
+			throw std::runtime_error("Truncated bzip2 file");
+
+		const unsigned n = 8 - skip;
+		window = (window << n) | (b & (0xff >> skip));
+		pending += n;
+		n_bits += n;
+		skip = 0;
+
+		/* look for the next block header or the end of
+		   stream marker ending in one of the new bits; the
+		   first 80 bits are this block's magic number and
+		   CRC */
+		for (unsigned i = n; i-- > 0;) {
+			if (n_bits - i < 80 + 48)
+				continue;
+
+			const uint64_t magic = (window >> i) & MAGIC_MASK;
+			if (magic != BLOCK_MAGIC && magic != EOS_MAGIC)
+				continue;
+
+			/* copy the rest of this block */
+			const unsigned tail = pending - i - 48;
+			writer.Put(window >> (i + 48), tail);
+
+			/* terminate the stream; the combined CRC of a
+			   single-block stream equals the block CRC,
+			   which follows the block magic (bytes 4..9) */
+			const uint32_t crc = (uint32_t(block_data[10]) << 24) |
+				(uint32_t(block_data[11]) << 16) |
+				(uint32_t(block_data[12]) << 8) |
+				uint32_t(block_data[13]);
+			writer.Put(EOS_MAGIC, 48);
+			writer.Put(crc, 32);
+			writer.Flush();
+
+			const uint64_t magic_offset =
+				bit_offset + n_bits - i - 48;
+			if (magic == BLOCK_MAGIC)
+				return magic_offset;
+
+			/* end of this stream; there may be another
+			   one concatenated (e.g. by pbzip2) */
+			return FindBlock(magic_offset + 48 + 32);
+		}
+
+		while (pending >= 48 + 8) {
+			pending -= 8;
+			writer.PutByte(window >> pending);
+		}
+	}
+}
+
+void
+Bzip2InputStream::StartBlock(size_t i)
+{
+	const Bzip2Block &block = blocks[i];
+
+	next_block_bit = LoadBlock(block.bit_offset);
+	current_block = i;
+	offset = block.offset;
+	eof = false;
+
+	if (initialized) {
+		BZ2_bzDecompressEnd(&bzstream);
+		initialized = false;
+	}
+
+	bzstream.bzalloc = nullptr;
+	bzstream.bzfree = nullptr;
+	bzstream.opaque = nullptr;
+
+	bzstream.next_in = (char *)block_data.data();
+	bzstream.avail_in = block_data.size();
+
+	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
+	if (ret != BZ_OK)
+		throw std::runtime_error("BZ2_bzDecompressInit() has failed");
 
-		if (bz_result != BZ_OK)
+	initialized = true;
+}
+
+size_t
+Bzip2InputStream::ReadUnlocked(void *ptr, size_t length)
+{
+	while (!eof) {
+		bzstream.next_out = (char *)ptr;
+		bzstream.avail_out = length;
+
+		int bz_result = BZ2_bzDecompress(&bzstream);
+		if (bz_result != BZ_OK && bz_result != BZ_STREAM_END)
 			throw std::runtime_error("BZ2_bzDecompress() has failed");
-	} while (bzstream.avail_out == length);
 
-	nbytes = length - bzstream.avail_out;
-	offset += nbytes;
+		const size_t nbytes = length - bzstream.avail_out;
+		offset += nbytes;
+
+		if (bz_result == BZ_STREAM_END) {
+			/* end of this block */
+			if (next_block_bit == NO_BLOCK) {
+				eof = true;
+				size = offset;
+			} else {
+				if (current_block + 1 == blocks.size())
+					blocks.push_back({next_block_bit,
+							  uint64_t(offset)});
+
+				StartBlock(current_block + 1);
+			}
+		} else if (nbytes == 0 && bzstream.avail_in == 0)
+			throw std::runtime_error("Corrupt bzip2 block");
+
+		if (nbytes > 0)
+			return nbytes;
+	}
+
+	return 0;
+}
 
-	return nbytes;
+size_t
+Bzip2InputStream::Read(void *ptr, size_t length)
+{
+	const ScopeUnlock unlock(mutex);
+
+	return ReadUnlocked(ptr, length);
+}
+
+void
+Bzip2InputStream::Seek(offset_type new_offset)
+{
+	const ScopeUnlock unlock(mutex);
+
+	if (blocks.empty()) {
+		if (new_offset > 0)
+			throw std::runtime_error("Seek beyond end of file");
+		return;
+	}
+
+	/* find the last known block which begins at or before the
+	   new offset */
+	const auto i = std::prev(std::upper_bound(blocks.begin(), blocks.end(),
+						  uint64_t(new_offset),
+						  [](uint64_t o, const Bzip2Block &b){
+							  return o < b.offset;
+						  }));
+	const size_t block = std::distance(blocks.begin(), i);
+
+	if (new_offset < offset || block > current_block)
+		StartBlock(block);
+
+	/* decompress (and discard) the remaining bytes */
+	uint8_t discard[8192];
+	while (offset < new_offset) {
+		const size_t chunk = std::min<offset_type>(new_offset - offset,
+							   sizeof(discard));
+		if (ReadUnlocked(discard, chunk) == 0)
+			throw std::runtime_error("Seek beyond end of file");
+	}
 }
 
 bool
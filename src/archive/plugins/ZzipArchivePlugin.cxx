@@ -21,24 +21,95 @@
   * zip archive handling (requires zziplib)
   */
 
+#include "config.h"
 #include "ZzipArchivePlugin.hxx"
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
 #include "input/InputStream.hxx"
 #include "fs/Path.hxx"
+#include "system/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
 #include "util/RuntimeError.hxx"
 
+#ifdef ENABLE_ZLIB
+#include "lib/zlib/Error.hxx"
+#include <zlib.h>
+#endif
+
 #include <zzip/zzip.h>
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <unistd.h>
+
+/**
+ * One member of a ZIP file, as described by the central directory.
+ */
+struct ZipEntry {
+	std::string name;
+
+	/**
+	 * The general purpose bit flags.
+	 */
+	uint16_t flags;
+
+	/**
+	 * The compression method (0 = stored, 8 = deflate).
+	 */
+	uint16_t method;
+
+	uint64_t compressed_size, size;
+
+	/**
+	 * The offset of the local file header.
+	 */
+	uint64_t header_offset;
+
+	bool IsEncrypted() const noexcept {
+		return flags & 0x1;
+	}
+};
+
 struct ZzipDir {
 	ZZIP_DIR *const dir;
 
+	/**
+	 * A separate file descriptor for our own pread() calls,
+	 * independent of the file position used by zziplib.
+	 */
+	UniqueFileDescriptor fd;
+
+	/**
+	 * All members, in the order of the central directory.  This
+	 * index is parsed once when the archive is opened; it is used
+	 * for listing the members and for locating their data.  It
+	 * is empty (and #indexed is false) if the central directory
+	 * could not be parsed (e.g. ZIP64); in that case, only
+	 * zziplib is used.
+	 */
+	std::vector<ZipEntry> entries;
+
+	/**
+	 * Maps member names to indexes in #entries.
+	 */
+	std::unordered_map<std::string, size_t> names;
+
+	bool indexed = false;
+
 	explicit ZzipDir(Path path)
 		:dir(zzip_dir_open(path.c_str(), nullptr)) {
 		if (dir == nullptr)
 			throw FormatRuntimeError("Failed to open ZIP file %s",
 						 path.c_str());
+
+		if (fd.OpenReadOnly(path.c_str()))
+			indexed = LoadIndex();
 	}
 
 	~ZzipDir() noexcept {
@@ -47,8 +118,163 @@ struct ZzipDir {
 
 	ZzipDir(const ZzipDir &) = delete;
 	ZzipDir &operator=(const ZzipDir &) = delete;
+
+	gcc_pure
+	const ZipEntry *Find(const char *name) const noexcept {
+		auto i = names.find(name);
+		return i != names.end()
+			? &entries[i->second]
+			: nullptr;
+	}
+
+	/**
+	 * Read from the ZIP file at the given offset.
+	 *
+	 * Throws on error.
+	 */
+	size_t ReadAt(uint64_t offset, void *dest, size_t length) const;
+
+	/**
+	 * Determine the offset of the given member's data by reading
+	 * its local file header.
+	 *
+	 * Throws on error.
+	 */
+	uint64_t GetDataOffset(const ZipEntry &entry) const;
+
+private:
+	bool LoadIndex() noexcept;
 };
 
+static constexpr uint32_t
+ReadLE16(const uint8_t *p) noexcept
+{
+	return p[0] | (p[1] << 8);
+}
+
+static constexpr uint32_t
+ReadLE32(const uint8_t *p) noexcept
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+		(uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+size_t
+ZzipDir::ReadAt(uint64_t offset, void *dest, size_t length) const
+{
+#ifdef _WIN32
+	/* no pread() on Windows */
+	ssize_t nbytes = fd.Seek(offset) == off_t(offset)
+		? fd.Read(dest, length)
+		: -1;
+#else
+	ssize_t nbytes = pread(fd.Get(), dest, length, offset);
+#endif
+	if (nbytes < 0)
+		throw MakeErrno("Failed to read from ZIP file");
+
+	return nbytes;
+}
+
+uint64_t
+ZzipDir::GetDataOffset(const ZipEntry &entry) const
+{
+	uint8_t header[30];
+	if (ReadAt(entry.header_offset, header, sizeof(header)) != sizeof(header) ||
+	    ReadLE32(header) != 0x04034b50)
+		throw FormatRuntimeError("Malformed local header in ZIP file: %s",
+					 entry.name.c_str());
+
+	return entry.header_offset + sizeof(header) +
+		ReadLE16(header + 26) + ReadLE16(header + 28);
+}
+
+bool
+ZzipDir::LoadIndex() noexcept
+try {
+	const uint64_t file_size = fd.GetSize();
+
+	/* find the "end of central directory" record; it is
+	   followed by a comment of up to 64 kB */
+	static constexpr size_t EOCD_SIZE = 22;
+	if (file_size < EOCD_SIZE)
+		return false;
+
+	const size_t tail_size = std::min<uint64_t>(file_size,
+						    EOCD_SIZE + 0xffff);
+	std::unique_ptr<uint8_t[]> tail(new uint8_t[tail_size]);
+	if (ReadAt(file_size - tail_size, tail.get(), tail_size) != tail_size)
+		return false;
+
+	const uint8_t *eocd = nullptr;
+	for (size_t i = tail_size - EOCD_SIZE + 1; i-- > 0;) {
+		const uint8_t *p = tail.get() + i;
+		if (ReadLE32(p) == 0x06054b50 &&
+		    i + EOCD_SIZE + ReadLE16(p + 20) <= tail_size) {
+			eocd = p;
+			break;
+		}
+	}
+
+	if (eocd == nullptr)
+		return false;
+
+	const unsigned n_entries = ReadLE16(eocd + 10);
+	const uint32_t cd_size = ReadLE32(eocd + 12);
+	const uint32_t cd_offset = ReadLE32(eocd + 16);
+
+	if (ReadLE16(eocd + 4) != 0 || ReadLE16(eocd + 6) != 0 ||
+	    n_entries == 0xffff || cd_offset == 0xffffffff ||
+	    uint64_t(cd_offset) + cd_size > file_size)
+		/* multi-disk or ZIP64: leave this to zziplib */
+		return false;
+
+	std::unique_ptr<uint8_t[]> cd(new uint8_t[cd_size]);
+	if (ReadAt(cd_offset, cd.get(), cd_size) != cd_size)
+		return false;
+
+	entries.reserve(n_entries);
+
+	const uint8_t *p = cd.get(), *const end = p + cd_size;
+	for (unsigned i = 0; i < n_entries; ++i) {
+		static constexpr size_t HEADER_SIZE = 46;
+		if (size_t(end - p) < HEADER_SIZE || ReadLE32(p) != 0x02014b50)
+			return false;
+
+		const size_t name_length = ReadLE16(p + 28);
+		const size_t total_length = HEADER_SIZE + name_length +
+			ReadLE16(p + 30) + ReadLE16(p + 32);
+		if (size_t(end - p) < total_length)
+			return false;
+
+		ZipEntry entry;
+		entry.flags = ReadLE16(p + 8);
+		entry.method = ReadLE16(p + 10);
+		entry.compressed_size = ReadLE32(p + 20);
+		entry.size = ReadLE32(p + 24);
+		entry.header_offset = ReadLE32(p + 42);
+		entry.name.assign((const char *)p + HEADER_SIZE,
+				  name_length);
+
+		if (entry.compressed_size == 0xffffffff ||
+		    entry.size == 0xffffffff ||
+		    entry.header_offset == 0xffffffff)
+			/* ZIP64 extension */
+			return false;
+
+		names.emplace(entry.name, entries.size());
+		entries.emplace_back(std::move(entry));
+
+		p += total_length;
+	}
+
+	return true;
+} catch (...) {
+	entries.clear();
+	names.clear();
+	return false;
+}
+
 class ZzipArchiveFile final : public ArchiveFile {
 	std::shared_ptr<ZzipDir> dir;
 
@@ -73,6 +299,14 @@ zzip_archive_open(Path pathname)
 inline void
 ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
 {
+	if (dir->indexed) {
+		for (const auto &i : dir->entries)
+			//add only files
+			if (i.size > 0)
+				visitor.VisitArchiveEntry(i.name.c_str());
+		return;
+	}
+
 	zzip_rewinddir(dir->dir);
 
 	ZZIP_DIRENT dirent;
@@ -115,10 +349,336 @@ public:
 	void Seek(offset_type offset) override;
 };
 
+/**
+ * Reads a member which is stored without compression directly from
+ * the ZIP file.
+ */
+class ZipStoredInputStream final : public InputStream {
+	std::shared_ptr<ZzipDir> dir;
+
+	const uint64_t data_offset;
+
+public:
+	ZipStoredInputStream(const std::shared_ptr<ZzipDir> &_dir,
+			     const char *_uri, Mutex &_mutex,
+			     const ZipEntry &entry, uint64_t _data_offset)
+		:InputStream(_uri, _mutex),
+		 dir(_dir), data_offset(_data_offset) {
+		seekable = true;
+		size = entry.size;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() noexcept override {
+		return offset >= size;
+	}
+
+	size_t Read(void *ptr, size_t size) override;
+
+	void Seek(offset_type new_offset) override {
+		if (new_offset > size)
+			throw std::runtime_error("Seek beyond end of file");
+
+		offset = new_offset;
+	}
+};
+
+size_t
+ZipStoredInputStream::Read(void *ptr, size_t read_size)
+{
+	const ScopeUnlock unlock(mutex);
+
+	if (offset >= size)
+		return 0;
+
+	read_size = std::min<offset_type>(read_size, size - offset);
+	size_t nbytes = dir->ReadAt(data_offset + offset, ptr, read_size);
+	if (nbytes == 0)
+		throw std::runtime_error("Unexpected end of ZIP file");
+
+	offset += nbytes;
+	return nbytes;
+}
+
+#ifdef ENABLE_ZLIB
+
+/**
+ * Decompresses a deflated member with zlib.  While reading, it saves
+ * copies of the decompressor state at regular intervals, so seeking
+ * backwards doesn't need to start over at the beginning of the
+ * member.
+ */
+class ZipDeflateInputStream final : public InputStream {
+	/**
+	 * Limit the number of checkpoints; each one costs about
+	 * 40 kB (the 32 kB window and the inflate state).
+	 */
+	static constexpr size_t MAX_CHECKPOINTS = 32;
+
+	struct Checkpoint {
+		z_stream z;
+
+		/**
+		 * The uncompressed offset.
+		 */
+		offset_type offset;
+
+		/**
+		 * The number of compressed bytes consumed at this
+		 * point.
+		 */
+		uint64_t input_position;
+
+		Checkpoint(z_stream &src, offset_type _offset,
+			   uint64_t _input_position)
+			:offset(_offset), input_position(_input_position) {
+			int result = inflateCopy(&z, &src);
+			if (result != Z_OK)
+				throw ZlibError(result);
+		}
+
+		~Checkpoint() noexcept {
+			inflateEnd(&z);
+		}
+
+		Checkpoint(const Checkpoint &) = delete;
+		Checkpoint &operator=(const Checkpoint &) = delete;
+	};
+
+	std::shared_ptr<ZzipDir> dir;
+
+	const uint64_t data_offset, compressed_size;
+
+	z_stream z;
+
+	/**
+	 * The number of compressed bytes which have been read into
+	 * #input_buffer so far.
+	 */
+	uint64_t input_position = 0;
+
+	bool eof = false;
+
+	/**
+	 * Checkpoints ordered by offset.  New ones are only added
+	 * beyond the last one.
+	 */
+	std::vector<std::unique_ptr<Checkpoint>> checkpoints;
+
+	/**
+	 * The distance between two checkpoints; doubled each time
+	 * #MAX_CHECKPOINTS is reached.
+	 */
+	offset_type checkpoint_interval = 1024 * 1024;
+
+	uint8_t input_buffer[16384];
+
+public:
+	ZipDeflateInputStream(const std::shared_ptr<ZzipDir> &_dir,
+			      const char *_uri, Mutex &_mutex,
+			      const ZipEntry &entry, uint64_t _data_offset)
+		:InputStream(_uri, _mutex),
+		 dir(_dir), data_offset(_data_offset),
+		 compressed_size(entry.compressed_size) {
+		z.zalloc = Z_NULL;
+		z.zfree = Z_NULL;
+		z.opaque = Z_NULL;
+		z.next_in = Z_NULL;
+		z.avail_in = 0;
+
+		/* raw deflate data without zlib header */
+		int result = inflateInit2(&z, -MAX_WBITS);
+		if (result != Z_OK)
+			throw ZlibError(result);
+
+		seekable = true;
+		size = entry.size;
+		SetReady();
+	}
+
+	~ZipDeflateInputStream() noexcept {
+		inflateEnd(&z);
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() noexcept override {
+		return eof;
+	}
+
+	size_t Read(void *ptr, size_t size) override;
+	void Seek(offset_type offset) override;
+
+private:
+	size_t ReadUnlocked(void *ptr, size_t size);
+
+	void AddCheckpoint();
+
+	/**
+	 * Restore the decompressor state from a checkpoint (or from
+	 * the beginning if nullptr).
+	 */
+	void Restore(const Checkpoint *checkpoint);
+};
+
+inline void
+ZipDeflateInputStream::AddCheckpoint()
+{
+	if (checkpoints.size() >= MAX_CHECKPOINTS) {
+		/* thin out: keep every other checkpoint */
+		for (size_t i = 0; 2 * i + 1 < checkpoints.size(); ++i)
+			checkpoints[i] = std::move(checkpoints[2 * i + 1]);
+		checkpoints.resize(checkpoints.size() / 2);
+		checkpoint_interval *= 2;
+	}
+
+	checkpoints.emplace_back(std::make_unique<Checkpoint>(z, offset,
+							      input_position - z.avail_in));
+}
+
+void
+ZipDeflateInputStream::Restore(const Checkpoint *checkpoint)
+{
+	int result;
+	if (checkpoint != nullptr) {
+		inflateEnd(&z);
+		result = inflateCopy(&z, const_cast<z_stream *>(&checkpoint->z));
+		offset = checkpoint->offset;
+		input_position = checkpoint->input_position;
+	} else {
+		result = inflateReset(&z);
+		offset = 0;
+		input_position = 0;
+	}
+
+	if (result != Z_OK)
+		throw ZlibError(result);
+
+	z.next_in = Z_NULL;
+	z.avail_in = 0;
+	eof = false;
+}
+
+size_t
+ZipDeflateInputStream::ReadUnlocked(void *ptr, size_t read_size)
+{
+	while (!eof) {
+		if (z.avail_in == 0 && input_position < compressed_size) {
+			const size_t n = std::min<uint64_t>(sizeof(input_buffer),
+							    compressed_size - input_position);
+			const size_t nbytes = dir->ReadAt(data_offset + input_position,
+							  input_buffer, n);
+			if (nbytes == 0)
+				throw std::runtime_error("Unexpected end of ZIP file");
+
+			input_position += nbytes;
+			z.next_in = input_buffer;
+			z.avail_in = nbytes;
+		}
+
+		z.next_out = (Bytef *)ptr;
+		z.avail_out = read_size;
+
+		int result = inflate(&z, Z_NO_FLUSH);
+		const size_t nbytes = read_size - z.avail_out;
+		offset += nbytes;
+
+		if (result == Z_STREAM_END)
+			eof = true;
+		else if (result == Z_BUF_ERROR) {
+			if (z.avail_in == 0 && input_position >= compressed_size)
+				throw std::runtime_error("Truncated ZIP member");
+		} else if (result != Z_OK)
+			throw ZlibError(result);
+
+		if (nbytes > 0) {
+			const offset_type last = checkpoints.empty()
+				? 0
+				: checkpoints.back()->offset;
+			if (!eof && offset >= last + checkpoint_interval)
+				AddCheckpoint();
+
+			return nbytes;
+		}
+	}
+
+	return 0;
+}
+
+size_t
+ZipDeflateInputStream::Read(void *ptr, size_t read_size)
+{
+	const ScopeUnlock unlock(mutex);
+
+	return ReadUnlocked(ptr, read_size);
+}
+
+void
+ZipDeflateInputStream::Seek(offset_type new_offset)
+{
+	const ScopeUnlock unlock(mutex);
+
+	if (new_offset > size)
+		throw std::runtime_error("Seek beyond end of file");
+
+	/* find the last checkpoint before the new offset */
+	const Checkpoint *checkpoint = nullptr;
+	for (const auto &i : checkpoints) {
+		if (i->offset > new_offset)
+			break;
+		checkpoint = i.get();
+	}
+
+	const offset_type checkpoint_offset = checkpoint != nullptr
+		? checkpoint->offset
+		: 0;
+
+	if (new_offset < offset || checkpoint_offset > offset)
+		Restore(checkpoint);
+
+	/* decompress (and discard) the remaining bytes */
+	uint8_t discard[8192];
+	while (offset < new_offset) {
+		const size_t chunk = std::min<offset_type>(new_offset - offset,
+							   sizeof(discard));
+		if (ReadUnlocked(discard, chunk) == 0)
+			throw std::runtime_error("Seek beyond end of file");
+	}
+}
+
+#endif
+
 InputStreamPtr
 ZzipArchiveFile::OpenStream(const char *pathname,
 			    Mutex &mutex)
 {
+	if (dir->indexed) {
+		const ZipEntry *entry = dir->Find(pathname);
+		if (entry == nullptr)
+			throw FormatRuntimeError("not found in the ZIP file: %s",
+						 pathname);
+
+		if (!entry->IsEncrypted()) {
+			switch (entry->method) {
+			case 0:
+				return std::make_unique<ZipStoredInputStream>(dir, pathname,
+									      mutex,
+									      *entry,
+									      dir->GetDataOffset(*entry));
+
+#ifdef ENABLE_ZLIB
+			case 8:
+				return std::make_unique<ZipDeflateInputStream>(dir, pathname,
+									       mutex,
+									       *entry,
+									       dir->GetDataOffset(*entry));
+#endif
+			}
+		}
+
+		/* let zziplib handle all other cases */
+	}
+
 	ZZIP_FILE *_file = zzip_file_open(dir->dir, pathname, 0);
 	if (_file == nullptr)
 		throw FormatRuntimeError("not found in the ZIP file: %s",
@@ -20,16 +20,19 @@
 #ifndef MPD_CLIENT_H
 #define MPD_CLIENT_H
 
+#include "config.h"
 #include "ClientMessage.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "tag/Mask.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimerEvent.hxx"
+#include "event/DeferEvent.hxx"
 #include "util/Compiler.h"
 
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
+#include <memory>
 #include <set>
 #include <string>
 #include <list>
@@ -47,6 +50,24 @@ class PlayerControl;
 struct playlist;
 class Database;
 class Storage;
+class ResponseCursor;
+class ArtStreamCache;
+class ClientCompressor;
+class SegmentPool;
+enum class CommandResult;
+
+/**
+ * Caches the rendered "idle" response for one set of flags, so all
+ * clients which are notified in one pass share it instead of
+ * formatting the same lines again.
+ */
+class IdleResponseCache {
+	unsigned flags = 0;
+	std::string response;
+
+public:
+	const std::string &Get(unsigned _flags) noexcept;
+};
 
 class Client final
 	: FullyBufferedSocket,
@@ -55,6 +76,66 @@ class Client final
 
 	Partition *partition;
 
+	/**
+	 * The response of the current command which is still being
+	 * generated; see SetCursor().
+	 */
+	std::unique_ptr<ResponseCursor> cursor;
+
+	/**
+	 * Generates the next portion of the #cursor response outside
+	 * of FullyBufferedSocket::Flush().
+	 */
+	DeferEvent cursor_event;
+
+	/**
+	 * The remaining commands of the command list which is being
+	 * executed; see client_process_command_list().
+	 */
+	std::list<std::string> command_list;
+
+	/**
+	 * The index of the first command in #command_list within the
+	 * whole command list.
+	 */
+	unsigned command_list_num;
+
+	/**
+	 * The number of commands executed in the current slice;
+	 * reset by OnCommandEvent() and when OnSocketInput() finds no
+	 * complete line.  When this reaches
+	 * #client_max_command_slice, the #Client yields to other
+	 * clients.
+	 */
+	unsigned command_slice = 0;
+
+	/**
+	 * Continues executing #command_list or the buffered input
+	 * after other clients had their turn.
+	 */
+	DeferEvent command_event;
+
+	/**
+	 * Has command processing been suspended because
+	 * #client_output_pool is over its limit?  Then
+	 * OnSocketOutputEmpty() resumes it.
+	 */
+	bool output_blocked = false;
+
+#ifdef ENABLE_ZLIB
+	/**
+	 * Compresses all output after the "compress" command; see
+	 * StartCompression().
+	 */
+	std::unique_ptr<ClientCompressor> compressor;
+
+	/**
+	 * Flushes the #compressor after the output of the current
+	 * command has been generated.
+	 */
+	DeferEvent compress_event;
+#endif
+
 public:
 	unsigned permission;
 
@@ -65,6 +146,11 @@ public:
 
 	const unsigned int num;	/* client number */
 
+	/**
+	 * The address of the peer, for log messages.
+	 */
+	const std::string remote_address;
+
 	/** is this client waiting for an "idle" response? */
 	bool idle_waiting = false;
 
@@ -96,15 +182,30 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+	/**
+	 * The maximum number of bytes in one binary response chunk,
+	 * see the "binarylimit" command.
+	 */
+	size_t binary_limit = 8192;
+
+	/**
+	 * Print songs in the binary encoding?  See the "songformat"
+	 * command and #SongBinaryField.
+	 */
+	bool binary_songs = false;
+
+	/**
+	 * The stream most recently opened by "albumart"; created on
+	 * demand.
+	 */
+	std::unique_ptr<ArtStreamCache> art_stream_cache;
+
 	Client(EventLoop &loop, Partition &partition,
 	       UniqueSocketDescriptor fd, int uid,
 	       unsigned _permission,
-	       int num) noexcept;
+	       int num, std::string &&_remote_address) noexcept;
 
-	~Client() noexcept {
-		if (FullyBufferedSocket::IsDefined())
-			FullyBufferedSocket::Close();
-	}
+	~Client() noexcept;
 
 	bool IsConnected() const noexcept {
 		return FullyBufferedSocket::IsDefined();
@@ -125,6 +226,51 @@ public:
 	 */
 	bool Write(const char *data);
 
+#ifdef ENABLE_ZLIB
+	bool IsCompressing() const noexcept {
+		return compressor != nullptr;
+	}
+
+	/**
+	 * Compress all further output (beginning with the response of
+	 * the current command) with zlib.
+	 *
+	 * Throws #ZlibError on error.
+	 */
+	void StartCompression();
+
+	/**
+	 * Send everything which is pending inside the #compressor to
+	 * the output buffer.
+	 */
+	void FlushCompressed() noexcept;
+#endif
+
+	/**
+	 * Let the #ResponseCursor generate the response of the
+	 * current command incrementally, whenever the output buffer
+	 * has been sent.  The command handler shall return
+	 * CommandResult::DEFERRED after calling this.
+	 *
+	 * Must not be used inside a command list.
+	 */
+	void SetCursor(std::unique_ptr<ResponseCursor> &&_cursor) noexcept;
+
+	/**
+	 * Start executing a committed command list.  At most
+	 * #client_max_command_slice commands are executed in each
+	 * #EventLoop iteration; the rest is postponed with
+	 * DeferEvent::ScheduleYield().
+	 *
+	 * @return the result of the last command executed, or
+	 * CommandResult::DEFERRED if commands are left
+	 */
+	CommandResult StartCommandList(std::list<std::string> &&list) noexcept;
+
+	bool IsCommandListPending() const noexcept {
+		return !command_list.empty();
+	}
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -152,8 +298,14 @@ public:
 	/**
 	 * Send "idle" response to this client.
 	 */
-	void IdleNotify() noexcept;
+	void IdleNotify(IdleResponseCache &cache) noexcept;
 	void IdleAdd(unsigned flags) noexcept;
+
+	/**
+	 * Like IdleAdd(unsigned), but share the rendered response with
+	 * other clients notified in the same pass.
+	 */
+	void IdleAdd(unsigned flags, IdleResponseCache &cache) noexcept;
 	bool IdleWait(unsigned flags) noexcept;
 
 	enum class SubscribeResult {
@@ -232,10 +384,53 @@ private:
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketOutputEmpty() noexcept override;
+
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
+
+	/* callback for #cursor_event */
+	void OnCursorEvent() noexcept;
+
+	/**
+	 * Check whether the output of all clients occupies too much
+	 * memory while this client's output is still pending.  If
+	 * so, further commands of this client shall be postponed;
+	 * OnSocketOutputEmpty() will schedule #command_event.
+	 */
+	bool CheckOutputBlocked() noexcept;
+
+	/**
+	 * Execute the next slice of #command_list.
+	 */
+	CommandResult ContinueCommandList() noexcept;
+
+	/**
+	 * Translate the result of a command (or a command list) for
+	 * BufferedSocket::ResumeInput(), closing the connection if
+	 * requested.
+	 */
+	InputResult HandleCommandResult(CommandResult result) noexcept;
+
+	/* callback for #command_event */
+	void OnCommandEvent() noexcept;
+
+#ifdef ENABLE_ZLIB
+	bool Compress(const void *data, size_t length, int flush) noexcept;
+	bool WriteCompressed(const void *data, size_t length) noexcept;
+
+	/* callback for #compress_event */
+	void OnCompressEvent() noexcept;
+#endif
 };
 
+/**
+ * The pool which provides the output buffers of all clients while
+ * they have pending output.
+ */
+extern SegmentPool client_output_pool;
+
 void
 client_manager_init(const ConfigData &config);
 
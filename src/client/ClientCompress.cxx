@@ -0,0 +1,90 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ClientCompress.hxx"
+#include "ClientInternal.hxx"
+#include "lib/zlib/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+ClientCompressor::ClientCompressor()
+{
+	z.next_in = nullptr;
+	z.avail_in = 0;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+
+	int result = deflateInit(&z, Z_DEFAULT_COMPRESSION);
+	if (result != Z_OK)
+		throw ZlibError(result);
+}
+
+void
+Client::StartCompression()
+{
+	assert(compressor == nullptr);
+
+	compressor.reset(new ClientCompressor());
+}
+
+bool
+Client::Compress(const void *data, size_t length, int flush) noexcept
+{
+	if (compressor->Compress(data, length, flush,
+				 [this](const void *p, size_t n){
+					 return FullyBufferedSocket::Write(p, n);
+				 }))
+		return true;
+
+	if (!IsExpired()) {
+		/* the output buffer is still intact, so this is a
+		   zlib error */
+		FormatError(client_domain, "[%u] compression failed", num);
+		SetExpired();
+	}
+
+	return false;
+}
+
+bool
+Client::WriteCompressed(const void *data, size_t length) noexcept
+{
+	if (!Compress(data, length, Z_NO_FLUSH))
+		return false;
+
+	/* zlib holds back some of the output; flush it after the
+	   current command (or command slice) is done */
+	compress_event.Schedule();
+	return true;
+}
+
+void
+Client::FlushCompressed() noexcept
+{
+	if (compressor != nullptr && !IsExpired())
+		Compress(nullptr, 0, Z_SYNC_FLUSH);
+}
+
+void
+Client::OnCompressEvent() noexcept
+{
+	FlushCompressed();
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_COMPRESS_HXX
+#define MPD_CLIENT_COMPRESS_HXX
+
+#include <zlib.h>
+
+#include <stddef.h>
+
+/**
+ * Compresses the output of a #Client connection with zlib; see the
+ * "compress" command.
+ */
+class ClientCompressor {
+	z_stream z;
+
+public:
+	/**
+	 * Throws #ZlibError on error.
+	 */
+	ClientCompressor();
+
+	~ClientCompressor() noexcept {
+		deflateEnd(&z);
+	}
+
+	ClientCompressor(const ClientCompressor &) = delete;
+	ClientCompressor &operator=(const ClientCompressor &) = delete;
+
+	/**
+	 * Compress data and pass each portion of the output to the
+	 * given function, which returns false on error.
+	 *
+	 * @param flush the zlib flush mode; Z_NO_FLUSH lets zlib
+	 * collect more input, Z_SYNC_FLUSH emits everything so the
+	 * peer can decompress it right away
+	 * @return false on error
+	 */
+	template<typename F>
+	bool Compress(const void *data, size_t length, int flush, F &&f) noexcept {
+		/* zlib's API requires non-const input pointer */
+		z.next_in = (Bytef *)const_cast<void *>(data);
+		z.avail_in = length;
+
+		do {
+			Bytef output[4096];
+			z.next_out = output;
+			z.avail_out = sizeof(output);
+
+			int result = deflate(&z, flush);
+			if (result != Z_OK && result != Z_BUF_ERROR)
+				return false;
+
+			if (z.next_out > output &&
+			    !f(output, z.next_out - output))
+				return false;
+		} while (z.avail_out == 0);
+
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ClientInternal.hxx"
+#include "ResponseCursor.hxx"
+#include "Response.hxx"
+#include "protocol/Result.hxx"
+#include "command/CommandError.hxx"
+
+#include <assert.h>
+
+void
+Client::SetCursor(std::unique_ptr<ResponseCursor> &&_cursor) noexcept
+{
+	assert(cursor == nullptr);
+	assert(!cmd_list.IsActive());
+
+	cursor = std::move(_cursor);
+	cursor->SetWakeup(BIND_METHOD(cursor_event, &DeferEvent::Schedule));
+	cursor_event.Schedule();
+}
+
+void
+Client::OnSocketOutputEmpty() noexcept
+{
+	if (output_blocked) {
+		/* resume command processing, but not from inside
+		   Flush() */
+		output_blocked = false;
+		command_event.Schedule();
+	}
+
+	if (cursor != nullptr)
+		/* don't call the cursor from inside Flush(); it may
+		   finish the response and resume input processing,
+		   which may destroy this object */
+		cursor_event.Schedule();
+}
+
+void
+Client::OnCursorEvent() noexcept
+{
+	if (cursor == nullptr || IsExpired() || cursor->IsSuspended())
+		/* a suspended cursor calls Resume() which schedules
+		   this event again */
+		return;
+
+	/* the client is busy receiving the response; don't let it
+	   time out */
+	timeout_event.Schedule(client_timeout);
+
+	Response r(*this, 0);
+	r.SetCommand(cursor->GetCommand());
+
+	try {
+		if (cursor->Fill(r)) {
+			if (!IsExpired() && IsOutputEmpty())
+				/* nothing was written; there will be
+				   no OnSocketOutputEmpty() call, so ask
+				   for more right now */
+				cursor_event.Schedule();
+			return;
+		}
+
+		if (!IsExpired())
+			command_success(*this);
+	} catch (...) {
+		PrintError(r, std::current_exception());
+	}
+
+	cursor.reset();
+
+	if (IsExpired())
+		return;
+
+	/* process the commands which were received in the
+	   meantime; this may destroy this object */
+	ResumeInput();
+}
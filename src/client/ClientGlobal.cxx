@@ -19,14 +19,31 @@
 
 #include "ClientInternal.hxx"
 #include "config/Data.hxx"
+#include "util/SegmentBuffer.hxx"
 
 #define CLIENT_TIMEOUT_DEFAULT			(60)
 #define CLIENT_MAX_COMMAND_LIST_DEFAULT		(2048*1024)
 #define CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT	(8192*1024)
+#define CLIENT_MAX_COMMAND_SLICE_DEFAULT	64
+#define CLIENT_MAX_OUTPUT_BUFFER_TOTAL_DEFAULT	(65536*1024)
+
+/**
+ * The size of the segments in #client_output_pool.
+ */
+static constexpr size_t CLIENT_OUTPUT_SEGMENT_SIZE = 16384;
+
+/**
+ * The number of idle segments kept in #client_output_pool.
+ */
+static constexpr size_t CLIENT_OUTPUT_MAX_IDLE = 64;
 
 std::chrono::steady_clock::duration client_timeout;
 size_t client_max_command_list_size;
 size_t client_max_output_buffer_size;
+unsigned client_max_command_slice;
+
+SegmentPool client_output_pool(CLIENT_OUTPUT_SEGMENT_SIZE,
+			       CLIENT_OUTPUT_MAX_IDLE);
 
 void
 client_manager_init(const ConfigData &config)
@@ -44,4 +61,12 @@ client_manager_init(const ConfigData &config)
 		config.GetPositive(ConfigOption::MAX_OUTPUT_BUFFER_SIZE,
 				   CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT / 1024)
 		* 1024;
+
+	client_output_pool.SetLimit(config.GetPositive(ConfigOption::MAX_OUTPUT_BUFFER_TOTAL,
+						      CLIENT_MAX_OUTPUT_BUFFER_TOTAL_DEFAULT / 1024)
+				    * 1024);
+
+	client_max_command_slice =
+		config.GetPositive(ConfigOption::MAX_COMMAND_SLICE,
+				   CLIENT_MAX_COMMAND_SLICE_DEFAULT);
 }
@@ -18,25 +18,41 @@
  */
 
 #include "ClientInternal.hxx"
-#include "Response.hxx"
 #include "Idle.hxx"
 
 #include <assert.h>
 
-static void
-WriteIdleResponse(Response &r, unsigned flags) noexcept
+static std::string
+RenderIdleResponse(unsigned flags) noexcept
 {
+	std::string r;
+
 	const char *const*idle_names = idle_get_names();
 	for (unsigned i = 0; idle_names[i]; ++i) {
-		if (flags & (1 << i))
-			r.Format("changed: %s\n", idle_names[i]);
+		if (flags & (1 << i)) {
+			r += "changed: ";
+			r += idle_names[i];
+			r += '\n';
+		}
+	}
+
+	r += "OK\n";
+	return r;
+}
+
+const std::string &
+IdleResponseCache::Get(unsigned _flags) noexcept
+{
+	if (response.empty() || _flags != flags) {
+		flags = _flags;
+		response = RenderIdleResponse(flags);
 	}
 
-	r.Write("OK\n");
+	return response;
 }
 
 void
-Client::IdleNotify() noexcept
+Client::IdleNotify(IdleResponseCache &cache) noexcept
 {
 	assert(idle_waiting);
 	assert(idle_flags != 0);
@@ -44,21 +60,28 @@ Client::IdleNotify() noexcept
 	unsigned flags = std::exchange(idle_flags, 0) & idle_subscriptions;
 	idle_waiting = false;
 
-	Response r(*this, 0);
-	WriteIdleResponse(r, flags);
+	const auto &response = cache.Get(flags);
+	Write(response.data(), response.size());
 
 	timeout_event.Schedule(client_timeout);
 }
 
 void
-Client::IdleAdd(unsigned flags) noexcept
+Client::IdleAdd(unsigned flags, IdleResponseCache &cache) noexcept
 {
 	if (IsExpired())
 		return;
 
 	idle_flags |= flags;
 	if (idle_waiting && (idle_flags & idle_subscriptions))
-		IdleNotify();
+		IdleNotify(cache);
+}
+
+void
+Client::IdleAdd(unsigned flags) noexcept
+{
+	IdleResponseCache cache;
+	IdleAdd(flags, cache);
 }
 
 bool
@@ -70,7 +93,8 @@ Client::IdleWait(unsigned flags) noexcept
 	idle_subscriptions = flags;
 
 	if (idle_flags & idle_subscriptions) {
-		IdleNotify();
+		IdleResponseCache cache;
+		IdleNotify(cache);
 		return true;
 	} else {
 		/* disable timeouts while in "idle" */
@@ -33,6 +33,7 @@ extern const class Domain client_domain;
 extern std::chrono::steady_clock::duration client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
+extern unsigned client_max_command_slice;
 
 CommandResult
 client_process_line(Client &client, char *line);
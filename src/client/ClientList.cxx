@@ -42,6 +42,10 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
+	/* most clients subscribe to the same idle events, so they
+	   can share the rendered response */
+	IdleResponseCache cache;
+
 	for (auto &client : list)
-		client.IdleAdd(flags);
+		client.IdleAdd(flags, cache);
 }
@@ -20,6 +20,8 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "ClientList.hxx"
+#include "ResponseCursor.hxx"
+#include "command/ArtStreamCache.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
@@ -28,6 +30,10 @@
 #include "Permission.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_ZLIB
+#include "ClientCompress.hxx"
+#endif
+
 #include <assert.h>
 #ifdef _WIN32
 #include <winsock2.h>
@@ -40,25 +46,38 @@ static constexpr char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 Client::Client(EventLoop &_loop, Partition &_partition,
 	       UniqueSocketDescriptor _fd,
 	       int _uid, unsigned _permission,
-	       int _num) noexcept
+	       int _num, std::string &&_remote_address) noexcept
 	:FullyBufferedSocket(_fd.Release(), _loop,
-			     16384, client_max_output_buffer_size),
+			     client_output_pool,
+			     client_max_output_buffer_size),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
 	 partition(&_partition),
+	 cursor_event(_loop, BIND_THIS_METHOD(OnCursorEvent)),
+	 command_event(_loop, BIND_THIS_METHOD(OnCommandEvent)),
+#ifdef ENABLE_ZLIB
+	 compress_event(_loop, BIND_THIS_METHOD(OnCompressEvent)),
+#endif
 	 permission(_permission),
 	 uid(_uid),
-	 num(_num)
+	 num(_num),
+	 remote_address(std::move(_remote_address))
 {
 	timeout_event.Schedule(client_timeout);
 }
 
+Client::~Client() noexcept
+{
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+}
+
 void
 client_new(EventLoop &loop, Partition &partition,
 	   UniqueSocketDescriptor fd, SocketAddress address, int uid,
 	   unsigned permission) noexcept
 {
 	static unsigned int next_client_num;
-	const auto remote = ToString(address);
+	auto remote = ToString(address);
 
 	assert(fd.IsDefined());
 
@@ -72,12 +91,12 @@ client_new(EventLoop &loop, Partition &partition,
 
 	Client *client = new Client(loop, partition, std::move(fd), uid,
 				    permission,
-				    next_client_num++);
+				    next_client_num++, std::move(remote));
 
 	client_list.Add(*client);
 
 	FormatInfo(client_domain, "[%u] opened from %s",
-		   client->num, remote.c_str());
+		   client->num, client->remote_address.c_str());
 }
 
 void
@@ -23,36 +23,79 @@
 #include "Log.hxx"
 #include "util/StringAPI.hxx"
 #include "util/CharUtil.hxx"
+#include "util/Trace.hxx"
+
+#include <assert.h>
 
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
 #define CLIENT_LIST_MODE_END "command_list_end"
 
-static CommandResult
-client_process_command_list(Client &client, bool list_ok,
-			    std::list<std::string> &&list)
+CommandResult
+Client::StartCommandList(std::list<std::string> &&list) noexcept
+{
+	assert(!IsCommandListPending());
+
+	command_list = std::move(list);
+	command_list_num = 0;
+	return ContinueCommandList();
+}
+
+CommandResult
+Client::ContinueCommandList() noexcept
 {
+	assert(cmd_list.IsActive());
+
+	const bool list_ok = cmd_list.IsOKMode();
 	CommandResult ret = CommandResult::OK;
-	unsigned num = 0;
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+	while (!command_list.empty()) {
+		if (command_slice >= client_max_command_slice) {
+			/* let the other clients have their turn;
+			   OnCommandEvent() continues here */
+			command_event.ScheduleYield();
+			return CommandResult::DEFERRED;
+		}
+
+		if (CheckOutputBlocked())
+			return CommandResult::DEFERRED;
+
+		++command_slice;
+
+		char *cmd = &*command_list.front().begin();
 
 		FormatDebug(client_domain, "process command \"%s\"", cmd);
-		ret = command_process(client, num++, cmd);
+		ret = command_process(*this, command_list_num++, cmd);
 		FormatDebug(client_domain, "command returned %i", int(ret));
-		if (ret != CommandResult::OK || client.IsExpired())
+
+		command_list.pop_front();
+
+		if (ret != CommandResult::OK || IsExpired())
 			break;
 		else if (list_ok)
-			client.Write("list_OK\n");
+			Write("list_OK\n");
 	}
 
+	command_list.clear();
+
+	FormatDebug(client_domain,
+		    "[%u] process command list returned %i", num, int(ret));
+
+	if (ret == CommandResult::CLOSE || IsExpired())
+		return CommandResult::CLOSE;
+
+	if (ret == CommandResult::OK)
+		command_success(*this);
+
+	cmd_list.Reset();
 	return ret;
 }
 
 CommandResult
 client_process_line(Client &client, char *line)
 {
+	const TraceSpan trace_span("client/process_line");
+
 	CommandResult ret;
 
 	if (StringIsEqual(line, "noidle")) {
@@ -82,23 +125,7 @@ client_process_line(Client &client, char *line)
 				    "[%u] process command list",
 				    client.num);
 
-			auto &&cmd_list = client.cmd_list.Commit();
-
-			ret = client_process_command_list(client,
-							  client.cmd_list.IsOKMode(),
-							  std::move(cmd_list));
-			FormatDebug(client_domain,
-				    "[%u] process command "
-				    "list returned %i", client.num, int(ret));
-
-			if (ret == CommandResult::CLOSE ||
-			    client.IsExpired())
-				return CommandResult::CLOSE;
-
-			if (ret == CommandResult::OK)
-				command_success(client);
-
-			client.cmd_list.Reset();
+			ret = client.StartCommandList(client.cmd_list.Commit());
 		} else {
 			if (!client.cmd_list.Add(line)) {
 				FormatWarning(client_domain,
@@ -17,21 +17,49 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "ClientInternal.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "event/Loop.hxx"
 #include "util/StringStrip.hxx"
+#include "util/SegmentBuffer.hxx"
 
 #include <string.h>
 
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length) noexcept
 {
+	if (cursor != nullptr)
+		/* the response of the previous command is still being
+		   generated; postpone this one until
+		   OnCursorEvent() resumes input */
+		return InputResult::PAUSE;
+
+	if (IsCommandListPending())
+		/* the previous command list is still being executed;
+		   OnCommandEvent() resumes input when it's done */
+		return InputResult::PAUSE;
+
 	char *p = (char *)data;
 	char *newline = (char *)memchr(p, '\n', length);
-	if (newline == nullptr)
+	if (newline == nullptr) {
+		/* all pipelined commands have been executed */
+		command_slice = 0;
 		return InputResult::MORE;
+	}
+
+	if (command_slice >= client_max_command_slice) {
+		/* let the other clients have their turn;
+		   OnCommandEvent() resumes input */
+		command_event.ScheduleYield();
+		return InputResult::PAUSE;
+	}
+
+	if (CheckOutputBlocked())
+		return InputResult::PAUSE;
+
+	++command_slice;
 
 	timeout_event.Schedule(client_timeout);
 
@@ -43,11 +71,17 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 	/* terminate the string at the end of the line */
 	*end = 0;
 
-	CommandResult result = client_process_line(*this, p);
+	return HandleCommandResult(client_process_line(*this, p));
+}
+
+BufferedSocket::InputResult
+Client::HandleCommandResult(CommandResult result) noexcept
+{
 	switch (result) {
 	case CommandResult::OK:
 	case CommandResult::IDLE:
 	case CommandResult::ERROR:
+	case CommandResult::DEFERRED:
 		break;
 
 	case CommandResult::KILL:
@@ -56,6 +90,9 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 		return InputResult::CLOSED;
 
 	case CommandResult::FINISH:
+#ifdef ENABLE_ZLIB
+		FlushCompressed();
+#endif
 		if (Flush())
 			Close();
 		return InputResult::CLOSED;
@@ -70,5 +107,39 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 		return InputResult::CLOSED;
 	}
 
+	if (result == CommandResult::DEFERRED)
+		return InputResult::PAUSE;
+
 	return InputResult::AGAIN;
 }
+
+bool
+Client::CheckOutputBlocked() noexcept
+{
+	if (!client_output_pool.IsOverLimit() || IsOutputEmpty())
+		return false;
+
+	output_blocked = true;
+	return true;
+}
+
+void
+Client::OnCommandEvent() noexcept
+{
+	if (IsExpired())
+		return;
+
+	command_slice = 0;
+
+	if (IsCommandListPending()) {
+		/* the client is busy; don't let it time out */
+		timeout_event.Schedule(client_timeout);
+
+		if (HandleCommandResult(ContinueCommandList()) != InputResult::AGAIN)
+			return;
+	}
+
+	/* process the commands which were received in the
+	   meantime; this may destroy this object */
+	ResumeInput();
+}
@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "Client.hxx"
 
 #include <string.h>
@@ -25,7 +26,15 @@ bool
 Client::Write(const void *data, size_t length)
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+#ifdef ENABLE_ZLIB
+	if (compressor != nullptr)
+		return WriteCompressed(data, length);
+#endif
+
+	return FullyBufferedSocket::Write(data, length);
 }
 
 bool
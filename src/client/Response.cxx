@@ -22,22 +22,33 @@
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
 
+#include <string.h>
+
 TagMask
 Response::GetTagMask() const noexcept
 {
 	return GetClient().tag_mask;
 }
 
+bool
+Response::IsBinarySongs() const noexcept
+{
+	return GetClient().binary_songs;
+}
+
 bool
 Response::Write(const void *data, size_t length)
 {
+	if (capture != nullptr)
+		capture->append((const char *)data, length);
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data)
 {
-	return client.Write(data);
+	return Write(data, strlen(data));
 }
 
 bool
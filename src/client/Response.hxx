@@ -23,6 +23,8 @@
 #include "protocol/Ack.hxx"
 #include "util/Compiler.h"
 
+#include <string>
+
 #include <stddef.h>
 #include <stdarg.h>
 
@@ -43,6 +45,14 @@ class Response {
 	 */
 	const char *command;
 
+	/**
+	 * If not nullptr, then all output is appended to this string,
+	 * too.  See #ScopeResponseCapture.
+	 */
+	std::string *capture = nullptr;
+
+	friend class ScopeResponseCapture;
+
 public:
 	Response(Client &_client, unsigned _list_index)
 		:client(_client), list_index(_list_index), command("") {}
@@ -67,6 +77,12 @@ public:
 	gcc_pure
 	TagMask GetTagMask() const noexcept;
 
+	/**
+	 * Accessor for Client::binary_songs.
+	 */
+	gcc_pure
+	bool IsBinarySongs() const noexcept;
+
 	void SetCommand(const char *_command) {
 		command = _command;
 	}
@@ -80,4 +96,34 @@ public:
 	void FormatError(enum ack code, const char *fmt, ...);
 };
 
+/**
+ * Copies all output written to a #Response during the lifetime of
+ * this object to a string.  Captures may be nested; the output
+ * captured by the inner one is passed on to the outer one.
+ */
+class ScopeResponseCapture {
+	Response &r;
+
+	std::string &dest;
+
+	std::string *const previous;
+
+	const size_t start;
+
+public:
+	ScopeResponseCapture(Response &_r, std::string &_dest) noexcept
+		:r(_r), dest(_dest), previous(r.capture), start(dest.size()) {
+		r.capture = &dest;
+	}
+
+	~ScopeResponseCapture() noexcept {
+		r.capture = previous;
+		if (previous != nullptr)
+			previous->append(dest, start, std::string::npos);
+	}
+
+	ScopeResponseCapture(const ScopeResponseCapture &) = delete;
+	ScopeResponseCapture &operator=(const ScopeResponseCapture &) = delete;
+};
+
 #endif
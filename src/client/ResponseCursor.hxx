@@ -0,0 +1,106 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RESPONSE_CURSOR_HXX
+#define MPD_RESPONSE_CURSOR_HXX
+
+#include "util/BindMethod.hxx"
+
+class Response;
+
+/**
+ * Generates a (large) command response incrementally.  The #Client
+ * asks for the next portion each time its output buffer has been
+ * sent to the socket, so the memory used by the response stays
+ * bounded.  See Client::SetCursor().
+ */
+class ResponseCursor {
+	/**
+	 * The command name; used to generate error messages.
+	 */
+	const char *const command;
+
+public:
+	typedef BoundMethod<void() noexcept> WakeupCallback;
+
+private:
+	/**
+	 * Invoked by Resume(); installed by Client::SetCursor().
+	 */
+	WakeupCallback wakeup = nullptr;
+
+	/**
+	 * If true, then Fill() must not be called until Resume() is
+	 * called.
+	 */
+	bool suspended = false;
+
+public:
+	explicit ResponseCursor(const char *_command) noexcept
+		:command(_command) {}
+
+	virtual ~ResponseCursor() noexcept = default;
+
+	ResponseCursor(const ResponseCursor &) = delete;
+	ResponseCursor &operator=(const ResponseCursor &) = delete;
+
+	const char *GetCommand() const noexcept {
+		return command;
+	}
+
+	void SetWakeup(WakeupCallback _wakeup) noexcept {
+		wakeup = _wakeup;
+	}
+
+	bool IsSuspended() const noexcept {
+		return suspended;
+	}
+
+	/**
+	 * Write the next portion of the response.
+	 *
+	 * Throws on error; the error is sent to the client and the
+	 * response is finished.
+	 *
+	 * @return true if there is more, false if the response is
+	 * complete
+	 */
+	virtual bool Fill(Response &r) = 0;
+
+protected:
+	/**
+	 * Wait for an asynchronous operation; Fill() will not be
+	 * called until Resume().
+	 */
+	void Suspend() noexcept {
+		suspended = true;
+	}
+
+	/**
+	 * The asynchronous operation has finished; ask the #Client
+	 * to call Fill() again.  Must be called in the main thread.
+	 */
+	void Resume() noexcept {
+		suspended = false;
+		if (wakeup)
+			wakeup();
+	}
+};
+
+#endif
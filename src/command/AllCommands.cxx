@@ -39,7 +39,15 @@
 #include "Partition.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "metrics/Writer.hxx"
+#include "LatencyHistogram.hxx"
+#include "LatencyPrint.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 #include "util/Macros.hxx"
+#include "util/PerfectHash.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/StringAPI.hxx"
 
@@ -48,6 +56,12 @@
 #include "sticker/StickerDatabase.hxx"
 #endif
 
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
@@ -75,6 +89,9 @@ handle_commands(Client &client, Request request, Response &response);
 static CommandResult
 handle_not_commands(Client &client, Request request, Response &response);
 
+static CommandResult
+handle_commandstats(Client &client, Request request, Response &response);
+
 /**
  * The command registry.
  *
@@ -85,12 +102,17 @@ static constexpr struct command commands[] = {
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
 	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
+	{ "binarylimit", PERMISSION_NONE, 1, 1, handle_binary_limit },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_CONTROL, 0, 0, handle_clear },
 	{ "clearerror", PERMISSION_CONTROL, 0, 0, handle_clearerror },
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+	{ "commandstats", PERMISSION_READ, 0, 0, handle_commandstats },
+#ifdef ENABLE_ZLIB
+	{ "compress", PERMISSION_NONE, 1, 1, handle_compress },
+#endif
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
@@ -99,6 +121,7 @@ static constexpr struct command commands[] = {
 	{ "crossfade", PERMISSION_CONTROL, 1, 1, handle_crossfade },
 	{ "currentsong", PERMISSION_READ, 0, 0, handle_currentsong },
 	{ "decoders", PERMISSION_READ, 0, 0, handle_decoders },
+	{ "decoderstats", PERMISSION_READ, 0, 0, handle_decoderstats },
 	{ "delete", PERMISSION_CONTROL, 1, 1, handle_delete },
 	{ "deleteid", PERMISSION_CONTROL, 1, 1, handle_deleteid },
 	{ "disableoutput", PERMISSION_ADMIN, 1, 1, handle_disableoutput },
@@ -127,6 +150,7 @@ static constexpr struct command commands[] = {
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "memstats", PERMISSION_READ, 0, 0, handle_memstats },
 	{ "mixrampdb", PERMISSION_CONTROL, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_CONTROL, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -134,11 +158,13 @@ static constexpr struct command commands[] = {
 #endif
 	{ "move", PERMISSION_CONTROL, 2, 2, handle_move },
 	{ "moveid", PERMISSION_CONTROL, 2, 2, handle_moveid },
+	{ "moveoutput", PERMISSION_ADMIN, 1, 1, handle_moveoutput },
 	{ "newpartition", PERMISSION_ADMIN, 1, 1, handle_newpartition },
 	{ "next", PERMISSION_CONTROL, 0, 0, handle_next },
 	{ "notcommands", PERMISSION_NONE, 0, 0, handle_not_commands },
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
 	{ "outputset", PERMISSION_ADMIN, 3, 3, handle_outputset },
+	{ "outputstats", PERMISSION_READ, 0, 0, handle_outputstats },
 	{ "partition", PERMISSION_READ, 1, 1, handle_partition },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_CONTROL, 0, 1, handle_pause },
@@ -148,6 +174,7 @@ static constexpr struct command commands[] = {
 	{ "playlist", PERMISSION_READ, 0, 0, handle_playlist },
 	{ "playlistadd", PERMISSION_CONTROL, 2, 2, handle_playlistadd },
 	{ "playlistclear", PERMISSION_CONTROL, 1, 1, handle_playlistclear },
+	{ "playlistcontains", PERMISSION_READ, 1, -1, handle_playlistcontains },
 	{ "playlistdelete", PERMISSION_CONTROL, 2, 2, handle_playlistdelete },
 	{ "playlistfind", PERMISSION_READ, 1, -1, handle_playlistfind },
 	{ "playlistid", PERMISSION_READ, 0, 1, handle_playlistid },
@@ -163,6 +190,7 @@ static constexpr struct command commands[] = {
 	{ "rangeid", PERMISSION_ADD, 2, 2, handle_rangeid },
 	{ "readcomments", PERMISSION_READ, 1, 1, handle_read_comments },
 	{ "readmessages", PERMISSION_READ, 0, 0, handle_read_messages },
+	{ "readpicture", PERMISSION_READ, 2, 2, handle_read_picture },
 	{ "rename", PERMISSION_CONTROL, 2, 2, handle_rename },
 	{ "repeat", PERMISSION_CONTROL, 1, 1, handle_repeat },
 	{ "replay_gain_mode", PERMISSION_CONTROL, 1, 1,
@@ -184,6 +212,7 @@ static constexpr struct command commands[] = {
 	{ "setvol", PERMISSION_CONTROL, 1, 1, handle_setvol },
 	{ "shuffle", PERMISSION_CONTROL, 0, 1, handle_shuffle },
 	{ "single", PERMISSION_CONTROL, 1, 1, handle_single },
+	{ "songformat", PERMISSION_NONE, 1, 1, handle_songformat },
 	{ "stats", PERMISSION_READ, 0, 0, handle_stats },
 	{ "status", PERMISSION_READ, 0, 0, handle_status },
 #ifdef ENABLE_SQLITE
@@ -195,6 +224,7 @@ static constexpr struct command commands[] = {
 	{ "swapid", PERMISSION_CONTROL, 2, 2, handle_swapid },
 	{ "tagtypes", PERMISSION_READ, 0, -1, handle_tagtypes },
 	{ "toggleoutput", PERMISSION_ADMIN, 1, 1, handle_toggleoutput },
+	{ "trace", PERMISSION_ADMIN, 1, 1, handle_trace },
 #ifdef ENABLE_DATABASE
 	{ "unmount", PERMISSION_ADMIN, 1, 1, handle_unmount },
 #endif
@@ -206,6 +236,42 @@ static constexpr struct command commands[] = {
 
 static constexpr unsigned num_commands = ARRAY_SIZE(commands);
 
+/**
+ * How long did the handlers of each command take?  The index is the
+ * same as in #commands.  Only accessed in the main thread.
+ */
+static LatencyHistogram command_latency[num_commands];
+
+#ifdef ENABLE_DATABASE
+/**
+ * How much of #command_latency was spent waiting for the database
+ * lock?  The index is the same as in #commands.
+ */
+static LatencyHistogram command_lock_wait[num_commands];
+#endif
+
+static constexpr Domain command_domain("command");
+
+/**
+ * Commands taking longer than this are logged; zero disables the
+ * slow command log.
+ */
+static std::chrono::steady_clock::duration slow_command_threshold{};
+
+struct CommandName {
+	constexpr const char *operator()(const struct command &cmd) const noexcept {
+		return cmd.cmd;
+	}
+};
+
+/**
+ * Maps the name of each command to its index in #commands; generated
+ * at compile time.
+ */
+static constexpr PerfectHashTable<num_commands,
+				  PerfectHashSize(num_commands)>
+	command_hash(commands, CommandName());
+
 static bool
 command_available(gcc_unused const Partition &partition,
 		  gcc_unused const struct command *cmd)
@@ -275,9 +341,32 @@ handle_not_commands(Client &client, gcc_unused Request request, Response &r)
 	return PrintUnavailableCommands(r, client.GetPermission());
 }
 
+static CommandResult
+handle_commandstats(gcc_unused Client &client, gcc_unused Request request,
+		    Response &r)
+{
+	for (unsigned i = 0; i < num_commands; ++i) {
+		const auto &h = command_latency[i];
+		if (h.GetCount() == 0)
+			continue;
+
+		r.Format("command: %s\n", commands[i].cmd);
+		latency_print(r, "duration", h);
+#ifdef ENABLE_DATABASE
+		latency_print(r, "lock_wait", command_lock_wait[i]);
+#endif
+	}
+
+	return CommandResult::OK;
+}
+
 void
-command_init()
+command_init(const ConfigData &config)
 {
+	slow_command_threshold =
+		std::chrono::milliseconds(config.GetUnsigned(ConfigOption::SLOW_COMMAND_THRESHOLD,
+							     0));
+
 #ifndef NDEBUG
 	/* ensure that the command list is sorted */
 	for (unsigned i = 0; i < num_commands - 1; ++i)
@@ -285,25 +374,59 @@ command_init()
 #endif
 }
 
+/**
+ * A constexpr variant of StringIsEqual(), for the compile-time checks
+ * of command_find().
+ */
+static constexpr bool
+ConstStringIsEqual(const char *a, const char *b) noexcept
+{
+	for (; *a == *b; ++a, ++b)
+		if (*a == 0)
+			return true;
+
+	return false;
+}
+
+/**
+ * @return the index of the command in #commands, or #num_commands if
+ * there is no such command
+ */
+gcc_pure
+static constexpr size_t
+command_find(const char *name) noexcept
+{
+	const size_t i = command_hash.Find(name);
+	return i < num_commands && ConstStringIsEqual(name, commands[i].cmd)
+		? i
+		: num_commands;
+}
+
+static constexpr bool
+CheckCommandHash() noexcept
+{
+	for (size_t i = 0; i < num_commands; ++i)
+		if (command_find(commands[i].cmd) != i)
+			return false;
+
+	return true;
+}
+
+static_assert(CheckCommandHash(), "Command hash table is broken");
+static_assert(command_find("") == num_commands, "Empty command found");
+static_assert(command_find("ad") == num_commands, "Bad prefix match");
+static_assert(command_find("addidx") == num_commands, "Bad prefix match");
+static_assert(command_find("Play") == num_commands, "Case mismatch");
+static_assert(command_find("GET") == num_commands, "Bad command found");
+
+gcc_pure
 static const struct command *
-command_lookup(const char *name)
+command_lookup(const char *name) noexcept
 {
-	unsigned a = 0, b = num_commands, i;
-
-	/* binary search */
-	do {
-		i = (a + b) / 2;
-
-		const auto cmp = strcmp(name, commands[i].cmd);
-		if (cmp == 0)
-			return &commands[i];
-		else if (cmp < 0)
-			b = i;
-		else if (cmp > 0)
-			a = i + 1;
-	} while (a < b);
-
-	return nullptr;
+	const size_t i = command_find(name);
+	return i < num_commands
+		? &commands[i]
+		: nullptr;
 }
 
 static bool
@@ -359,6 +482,98 @@ command_checked_lookup(Response &r, unsigned permission,
 	return cmd;
 }
 
+/**
+ * Append an argument to a command line for the log, quoted the same
+ * way a client would send it.
+ */
+static void
+AppendQuotedArgument(std::string &dest, const char *arg) noexcept
+{
+	dest.push_back(' ');
+	dest.push_back('"');
+	for (const char *p = arg; *p != 0; ++p) {
+		if (*p == '"' || *p == '\\')
+			dest.push_back('\\');
+		dest.push_back(*p);
+	}
+	dest.push_back('"');
+}
+
+static void
+LogSlowCommand(const Client &client, const struct command &cmd,
+	       Request args,
+	       std::chrono::steady_clock::duration duration,
+	       std::chrono::steady_clock::duration lock_wait) noexcept
+{
+	std::string line(cmd.cmd);
+
+	/* don't write passwords to the log file */
+	if (StringIsEqual(cmd.cmd, "password"))
+		line += " ...";
+	else
+		for (const char *arg : args)
+			AppendQuotedArgument(line, arg);
+
+	using std::chrono::duration_cast;
+	using std::chrono::milliseconds;
+
+	FormatWarning(command_domain,
+		      "[%u] slow command from %s: %s (%lu ms, %lu ms waiting for the database lock)",
+		      client.num, client.remote_address.c_str(), line.c_str(),
+		      (unsigned long)duration_cast<milliseconds>(duration).count(),
+		      (unsigned long)duration_cast<milliseconds>(lock_wait).count());
+}
+
+/**
+ * Measures the execution of one command handler and records it in
+ * #command_latency (and #command_lock_wait), even if the handler
+ * throws.  For commands which defer their work (e.g. "idle"), only
+ * the synchronous part is measured.
+ */
+class ScopeCommandTimer {
+	const Client &client;
+	const struct command &cmd;
+	const Request args;
+
+	const std::chrono::steady_clock::time_point start_time;
+
+#ifdef ENABLE_DATABASE
+	const std::chrono::steady_clock::duration start_lock_wait;
+#endif
+
+public:
+	ScopeCommandTimer(const Client &_client, const struct command &_cmd,
+			  Request _args) noexcept
+		:client(_client), cmd(_cmd), args(_args),
+		 start_time(std::chrono::steady_clock::now())
+#ifdef ENABLE_DATABASE
+		, start_lock_wait(db_mutex_wait_time)
+#endif
+	{
+	}
+
+	~ScopeCommandTimer() noexcept {
+		const auto duration = std::chrono::steady_clock::now() -
+			start_time;
+		const size_t i = &cmd - commands;
+		command_latency[i].Add(duration);
+
+#ifdef ENABLE_DATABASE
+		const auto lock_wait = db_mutex_wait_time - start_lock_wait;
+		command_lock_wait[i].Add(lock_wait);
+#else
+		const std::chrono::steady_clock::duration lock_wait{};
+#endif
+
+		if (slow_command_threshold > std::chrono::steady_clock::duration::zero() &&
+		    duration >= slow_command_threshold)
+			LogSlowCommand(client, cmd, args, duration, lock_wait);
+	}
+
+	ScopeCommandTimer(const ScopeCommandTimer &) = delete;
+	ScopeCommandTimer &operator=(const ScopeCommandTimer &) = delete;
+};
+
 CommandResult
 command_process(Client &client, unsigned num, char *line)
 try {
@@ -410,13 +625,43 @@ try {
 		command_checked_lookup(r, client.GetPermission(),
 				       cmd_name, args);
 
-	CommandResult ret = cmd
-		? cmd->handler(client, args, r)
-		: CommandResult::ERROR;
+	if (cmd == nullptr)
+		return CommandResult::ERROR;
 
-	return ret;
+	const ScopeCommandTimer timer(client, *cmd, args);
+	return cmd->handler(client, args, r);
 } catch (const std::exception &e) {
 	Response r(client, num);
 	PrintError(r, std::current_exception());
 	return CommandResult::ERROR;
 }
+
+void
+command_metrics(MetricsWriter &w)
+{
+	w.Declare("mpd_command_duration_seconds", "histogram",
+		  "Time spent in command handlers");
+
+	for (unsigned i = 0; i < num_commands; ++i) {
+		const auto &h = command_latency[i];
+		if (h.GetCount() > 0)
+			w.Histogram("mpd_command_duration_seconds",
+				    MetricsWriter::Label("command",
+							 commands[i].cmd).c_str(),
+				    h);
+	}
+
+#ifdef ENABLE_DATABASE
+	w.Declare("mpd_command_lock_wait_seconds", "histogram",
+		  "Time spent by command handlers waiting for the database lock");
+
+	for (unsigned i = 0; i < num_commands; ++i) {
+		const auto &h = command_lock_wait[i];
+		if (h.GetCount() > 0)
+			w.Histogram("mpd_command_lock_wait_seconds",
+				    MetricsWriter::Label("command",
+							 commands[i].cmd).c_str(),
+				    h);
+	}
+#endif
+}
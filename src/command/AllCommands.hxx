@@ -22,10 +22,12 @@
 
 #include "CommandResult.hxx"
 
+struct ConfigData;
 class Client;
+class MetricsWriter;
 
 void
-command_init();
+command_init(const ConfigData &config);
 
 void
 command_finish();
@@ -33,4 +35,11 @@ command_finish();
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
+/**
+ * Write the number and the duration of all commands which have been
+ * executed.
+ */
+void
+command_metrics(MetricsWriter &w);
+
 #endif
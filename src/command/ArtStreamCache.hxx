@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_ART_STREAM_CACHE_HXX
+#define MPD_ART_STREAM_CACHE_HXX
+
+#include "input/InputStream.hxx"
+#include "PictureScan.hxx"
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <string>
+
+/**
+ * Keeps the art file most recently sent by the "albumart" command
+ * open, so the following chunk requests of the same client neither
+ * search the directory again nor reopen the stream.  Similarly, the
+ * picture most recently sent by "readpicture" is kept in memory.
+ * Each #Client owns one instance.
+ */
+class ArtStreamCache {
+	/**
+	 * How long an idle stream is reused.  After that, the
+	 * directory is searched again, so replaced files are picked
+	 * up.
+	 */
+	static constexpr std::chrono::steady_clock::duration MAX_AGE =
+		std::chrono::seconds(10);
+
+	/**
+	 * The UTF-8 directory URI which was searched for #is.
+	 */
+	std::string directory;
+
+	/**
+	 * The mutex of #is; declared before it, because it must
+	 * outlive the stream.
+	 */
+	Mutex mutex;
+
+	InputStreamPtr is;
+
+	std::chrono::steady_clock::time_point expires;
+
+	/**
+	 * The song which #picture was extracted from.
+	 */
+	std::string picture_key;
+
+	Picture picture;
+
+	std::chrono::steady_clock::time_point picture_expires;
+
+public:
+	Mutex &GetMutex() noexcept {
+		return mutex;
+	}
+
+	/**
+	 * Returns the cached stream for the given directory, or
+	 * nullptr if there is none (or it has expired).
+	 */
+	InputStream *Get(const std::string &_directory,
+			 std::chrono::steady_clock::time_point now) noexcept {
+		if (is == nullptr || now >= expires ||
+		    _directory != directory) {
+			Clear();
+			return nullptr;
+		}
+
+		expires = now + MAX_AGE;
+		return is.get();
+	}
+
+	/**
+	 * Store a new stream, which must have been opened with
+	 * GetMutex().
+	 */
+	InputStream &Set(std::string &&_directory, InputStreamPtr &&_is,
+			 std::chrono::steady_clock::time_point now) noexcept {
+		directory = std::move(_directory);
+		is = std::move(_is);
+		expires = now + MAX_AGE;
+		return *is;
+	}
+
+	void Clear() noexcept {
+		is.reset();
+	}
+
+	/**
+	 * Returns the cached picture of the given song, or nullptr
+	 * if there is none (or it has expired).
+	 */
+	const Picture *GetPicture(const std::string &key,
+				  std::chrono::steady_clock::time_point now) noexcept {
+		if (picture_key.empty() || now >= picture_expires ||
+		    key != picture_key) {
+			ClearPicture();
+			return nullptr;
+		}
+
+		picture_expires = now + MAX_AGE;
+		return &picture;
+	}
+
+	const Picture &SetPicture(std::string &&key, Picture &&_picture,
+				  std::chrono::steady_clock::time_point now) noexcept {
+		picture_key = std::move(key);
+		picture = std::move(_picture);
+		picture_expires = now + MAX_AGE;
+		return picture;
+	}
+
+	void ClearPicture() noexcept {
+		picture_key.clear();
+		picture = Picture();
+	}
+};
+
+#endif
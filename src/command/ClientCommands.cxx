@@ -17,13 +17,16 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "ClientCommands.hxx"
 #include "Request.hxx"
 #include "Permission.hxx"
 #include "client/Client.hxx"
+#include "client/ClientInternal.hxx"
 #include "client/Response.hxx"
 #include "TagPrint.hxx"
 #include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
 #include "util/StringAPI.hxx"
 
 CommandResult
@@ -54,6 +57,23 @@ handle_password(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_binary_limit(Client &client, Request args, Response &r)
+{
+	/* leave room for the response header and other responses
+	   in a command list */
+	const unsigned max_value = client_max_output_buffer_size / 2;
+
+	const size_t value = args.ParseUnsigned(0, max_value);
+	if (value < 64) {
+		r.Error(ACK_ERROR_ARG, "Value too small");
+		return CommandResult::ERROR;
+	}
+
+	client.binary_limit = value;
+	return CommandResult::OK;
+}
+
 static TagMask
 ParseTagMask(Request request)
 {
@@ -109,3 +129,47 @@ handle_tagtypes(Client &client, Request request, Response &r)
 		return CommandResult::ERROR;
 	}
 }
+
+CommandResult
+handle_songformat(Client &client, Request args, Response &r)
+{
+	const char *name = args.front();
+	if (StringIsEqual(name, "text")) {
+		client.binary_songs = false;
+		return CommandResult::OK;
+	} else if (StringIsEqual(name, "binary")) {
+		client.binary_songs = true;
+
+		/* tell the client which tag names the numeric field
+		   identifiers stand for */
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++)
+			if (IsTagEnabled(i))
+				r.Format("%s: %u\n", tag_item_names[i], i);
+
+		return CommandResult::OK;
+	} else {
+		r.Error(ACK_ERROR_ARG, "Unknown song format");
+		return CommandResult::ERROR;
+	}
+}
+
+#ifdef ENABLE_ZLIB
+
+CommandResult
+handle_compress(Client &client, Request args, Response &r)
+{
+	if (!StringIsEqual(args.front(), "deflate")) {
+		r.Error(ACK_ERROR_ARG, "Unsupported compression method");
+		return CommandResult::ERROR;
+	}
+
+	if (client.IsCompressing()) {
+		r.Error(ACK_ERROR_ARG, "Already compressing");
+		return CommandResult::ERROR;
+	}
+
+	client.StartCompression();
+	return CommandResult::OK;
+}
+
+#endif
@@ -35,7 +35,16 @@ handle_ping(Client &client, Request request, Response &response);
 CommandResult
 handle_password(Client &client, Request request, Response &response);
 
+CommandResult
+handle_binary_limit(Client &client, Request request, Response &response);
+
 CommandResult
 handle_tagtypes(Client &client, Request request, Response &response);
 
+CommandResult
+handle_songformat(Client &client, Request request, Response &response);
+
+CommandResult
+handle_compress(Client &client, Request request, Response &response);
+
 #endif
@@ -41,6 +41,14 @@ enum class CommandResult {
 	 */
 	IDLE,
 
+	/**
+	 * The command generates its response incrementally (see
+	 * Client::SetCursor()).  The "OK" response will be sent when
+	 * it is finished, and until then, no other command is
+	 * processed.
+	 */
+	DEFERRED,
+
 	/**
 	 * There was an error.  The "ACK" response was sent to the
 	 * client.
@@ -24,10 +24,12 @@
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/QueryCache.hxx"
 #include "CommandError.hxx"
 #include "protocol/RangeArg.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseCursor.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Mask.hxx"
 #include "util/ConstBuffer.hxx"
@@ -36,8 +38,10 @@
 #include "util/ASCII.hxx"
 #include "song/Filter.hxx"
 #include "BulkEdit.hxx"
+#include "Instance.hxx"
 
 #include <memory>
+#include <string>
 
 CommandResult
 handle_listfiles_db(Client &client, Response &r, const char *uri)
@@ -57,6 +61,79 @@ handle_lsinfo2(Client &client, const char *uri, Response &r)
 	return CommandResult::OK;
 }
 
+/**
+ * Build the #DatabaseQueryCache key prefix for a command.  It
+ * includes the client's tag mask and song format, because they
+ * affect how songs are printed.
+ */
+static std::string
+MakeQueryCacheKey(const Response &r, const char *command,
+		  const SongFilter *filter)
+{
+	std::string key(command);
+	key.push_back('\n');
+
+	const TagMask tag_mask = r.GetTagMask();
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		key.push_back(tag_mask.Test(TagType(i)) ? '1' : '0');
+	if (r.IsBinarySongs())
+		key.push_back('b');
+	key.push_back('\n');
+
+	if (filter != nullptr)
+		key += filter->ToExpression();
+	key.push_back('\n');
+
+	return key;
+}
+
+/**
+ * Invoke the given function which prints the response to a database
+ * query, or send the cached response from a previous invocation.
+ *
+ * @param cacheable false if the response must not be cached, see
+ * SongFilter::IsVolatile()
+ */
+template<typename F>
+static void
+CachedQuery(Client &client, Response &r, bool cacheable,
+	    std::string &&key, F &&f)
+{
+	auto *cache = client.GetInstance().query_cache.get();
+	if (cache == nullptr || !cacheable) {
+		f();
+		return;
+	}
+
+	const std::string *cached = cache->Get(key);
+	if (cached != nullptr) {
+		r.Write(cached->data(), cached->length());
+		return;
+	}
+
+	std::string output;
+
+	{
+		const ScopeResponseCapture capture(r, output);
+		f();
+	}
+
+	/* not reached if f() has thrown, so failed queries are not
+	   cached */
+	cache->Put(std::move(key), std::move(output));
+}
+
+/**
+ * Is there a cached response for this query?  Then it is cheaper to
+ * send it than to start an asynchronous query.
+ */
+static bool
+HasCachedQuery(Client &client, bool cacheable, const std::string &key)
+{
+	auto *cache = client.GetInstance().query_cache.get();
+	return cache != nullptr && cacheable && cache->Get(key) != nullptr;
+}
+
 static TagType
 ParseSortTag(const char *s)
 {
@@ -111,8 +188,35 @@ handle_match(Client &client, Request args, Response &r, bool fold_case)
 	selection.sort = sort;
 	selection.descending = descending;
 
-	db_selection_print(r, client.GetPartition(),
-			   selection, true, false);
+	std::string key = MakeQueryCacheKey(r, fold_case ? "search" : "find",
+					    &filter);
+	key += std::to_string(window.start);
+	key.push_back('-');
+	key += std::to_string(window.end);
+	key.push_back(descending ? '-' : '+');
+	key += std::to_string(unsigned(sort));
+
+	const bool cacheable = !filter.IsVolatile();
+
+	if (!client.cmd_list.IsActive() &&
+	    !HasCachedQuery(client, cacheable, key)) {
+		/* if the database supports it (e.g. the "proxy"
+		   plugin, or "simple" with "query_threads"),
+		   evaluate the query without blocking the main
+		   loop */
+		auto cursor = db_selection_print_async_cursor(client.GetPartition(),
+							      fold_case ? "search" : "find",
+							      selection, true);
+		if (cursor != nullptr) {
+			client.SetCursor(std::move(cursor));
+			return CommandResult::DEFERRED;
+		}
+	}
+
+	CachedQuery(client, r, cacheable, std::move(key), [&](){
+			db_selection_print(r, client.GetPartition(),
+					   selection, true, false);
+		});
 	return CommandResult::OK;
 }
 
@@ -213,20 +317,44 @@ handle_count(Client &client, Request args, Response &r)
 		filter.Optimize();
 	}
 
-	PrintSongCount(r, client.GetPartition(), "", &filter, group);
+	std::string key = MakeQueryCacheKey(r, "count", &filter);
+	key += std::to_string(unsigned(group));
+
+	CachedQuery(client, r, !filter.IsVolatile(), std::move(key), [&](){
+			PrintSongCount(r, client.GetPartition(), "",
+				       &filter, group);
+		});
 	return CommandResult::OK;
 }
 
+/**
+ * Print a (potentially huge) recursive listing incrementally, unless
+ * we're in a command list, where the whole response must be
+ * generated at once.
+ */
+static CommandResult
+PrintRecursive(Client &client, Response &r, const char *command,
+	       const char *uri, bool full)
+{
+	if (client.cmd_list.IsActive()) {
+		db_selection_print(r, client.GetPartition(),
+				   DatabaseSelection(uri, true),
+				   full, false);
+		return CommandResult::OK;
+	}
+
+	client.SetCursor(db_selection_print_cursor(client.GetPartition(),
+						   command, uri, full));
+	return CommandResult::DEFERRED;
+}
+
 CommandResult
 handle_listall(Client &client, Request args, Response &r)
 {
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   false, false);
-	return CommandResult::OK;
+	return PrintRecursive(client, r, "listall", uri, false);
 }
 
 static CommandResult
@@ -312,8 +440,16 @@ handle_list(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
-	PrintUniqueTags(r, client.GetPartition(),
-			tagType, group, filter.get());
+	std::string key = MakeQueryCacheKey(r, "list", filter.get());
+	key += std::to_string(unsigned(tagType));
+	key.push_back(' ');
+	key += std::to_string(unsigned(group));
+
+	CachedQuery(client, r, filter == nullptr || !filter->IsVolatile(),
+		    std::move(key), [&](){
+			PrintUniqueTags(r, client.GetPartition(),
+					tagType, group, filter.get());
+		});
 	return CommandResult::OK;
 }
 
@@ -323,8 +459,5 @@ handle_listallinfo(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   true, false);
-	return CommandResult::OK;
+	return PrintRecursive(client, r, "listallinfo", uri, true);
 }
@@ -28,6 +28,7 @@
 #include "client/Response.hxx"
 #include "util/CharUtil.hxx"
 #include "util/UriUtil.hxx"
+#include "util/StringView.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Generic.hxx"
 #include "TagStream.hxx"
@@ -38,11 +39,17 @@
 #include "fs/DirectoryReader.hxx"
 #include "input/InputStream.hxx"
 #include "input/Error.hxx"
+#include "ArtStreamCache.hxx"
+#include "PictureCache.hxx"
+#include "PictureScan.hxx"
 #include "LocateUri.hxx"
 #include "TimePrint.hxx"
 #include "thread/Mutex.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <memory>
+
 #include <assert.h>
 #include <inttypes.h> /* for PRIu64 */
 
@@ -110,30 +117,25 @@ handle_listfiles_local(Response &r, Path path_fs)
 
 gcc_pure
 static bool
-IsValidName(const char *p) noexcept
+IsValidName(StringView s) noexcept
 {
-	if (!IsAlphaASCII(*p))
+	if (s.empty() || !IsAlphaASCII(s.front()))
 		return false;
 
-	while (*++p) {
-		const char ch = *p;
+	for (const char ch : s)
 		if (!IsAlphaASCII(ch) && ch != '_' && ch != '-')
 			return false;
-	}
 
 	return true;
 }
 
 gcc_pure
 static bool
-IsValidValue(const char *p) noexcept
+IsValidValue(StringView s) noexcept
 {
-	while (*p) {
-		const char ch = *p++;
-
+	for (const char ch : s)
 		if ((unsigned char)ch < 0x20)
 			return false;
-	}
 
 	return true;
 }
@@ -145,9 +147,11 @@ public:
 	explicit PrintCommentHandler(Response &_response) noexcept
 		:NullTagHandler(WANT_PAIR), response(_response) {}
 
-	void OnPair(const char *key, const char *value) noexcept override {
+	void OnPair(StringView key, StringView value) noexcept override {
 		if (IsValidName(key) && IsValidValue(value))
-			response.Format("%s: %s\n", key, value);
+			response.Format("%.*s: %.*s\n",
+					int(key.size), key.data,
+					int(value.size), value.data);
 	}
 };
 
@@ -268,42 +272,71 @@ find_stream_art(const char *directory, Mutex &mutex)
 }
 
 static CommandResult
-read_stream_art(Response &r, const char *uri, size_t offset)
+read_stream_art(Client &client, Response &r, const char *uri, size_t offset)
 {
 	std::string art_directory = PathTraitsUTF8::GetParent(uri);
 
-	Mutex mutex;
-
-	InputStreamPtr is = find_stream_art(art_directory.c_str(), mutex);
+	if (client.art_stream_cache == nullptr)
+		client.art_stream_cache = std::make_unique<ArtStreamCache>();
+	auto &cache = *client.art_stream_cache;
 
+	const auto now = std::chrono::steady_clock::now();
+	InputStream *is = cache.Get(art_directory, now);
 	if (is == nullptr) {
-		r.Error(ACK_ERROR_NO_EXIST, "No file exists");
-		return CommandResult::ERROR;
+		auto new_is = find_stream_art(art_directory.c_str(),
+					      cache.GetMutex());
+		if (new_is == nullptr) {
+			r.Error(ACK_ERROR_NO_EXIST, "No file exists");
+			return CommandResult::ERROR;
+		}
+
+		is = &cache.Set(std::move(art_directory), std::move(new_is),
+				now);
 	}
+
 	if (!is->KnownSize()) {
+		cache.Clear();
 		r.Error(ACK_ERROR_NO_EXIST, "Cannot get size for stream");
 		return CommandResult::ERROR;
 	}
 
 	const offset_type art_file_size = is->GetSize();
 
-	constexpr size_t CHUNK_SIZE = 8192;
-	uint8_t buffer[CHUNK_SIZE];
-	size_t read_size;
+	const size_t chunk_size = client.binary_limit;
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[chunk_size]);
+	size_t read_size = 0;
 
-	{
-		const std::lock_guard<Mutex> protect(mutex);
+	try {
+		const std::lock_guard<Mutex> protect(cache.GetMutex());
 		is->Seek(offset);
-		read_size = is->Read(&buffer, CHUNK_SIZE);
+
+		/* fill the whole chunk; a remote stream may return
+		   less than requested */
+		while (read_size < chunk_size && !is->IsEOF()) {
+			size_t nbytes = is->Read(buffer.get() + read_size,
+						 chunk_size - read_size);
+			if (nbytes == 0)
+				break;
+
+			read_size += nbytes;
+		}
+	} catch (...) {
+		cache.Clear();
+		throw;
 	}
 
+	if (offset + read_size >= art_file_size)
+		/* this was the last chunk; the client will not ask
+		   for more */
+		cache.Clear();
+
 	r.Format("size: %" PRIoffset "\n"
 			 "binary: %u\n",
 			 art_file_size,
-			 read_size
+			 (unsigned)read_size
 			 );
 
-	r.Write(buffer, read_size);
+	r.Write(buffer.get(), read_size);
 	r.Write("\n");
 
 	return CommandResult::OK;
@@ -319,7 +352,7 @@ read_db_art(Client &client, Response &r, const char *uri, const uint64_t offset)
 		return CommandResult::ERROR;
 	}
 	std::string uri2 = storage->MapUTF8(uri);
-	return read_stream_art(r, uri2.c_str(), offset);
+	return read_stream_art(client, r, uri2.c_str(), offset);
 }
 #endif
 
@@ -340,7 +373,8 @@ handle_album_art(Client &client, Request args, Response &r)
 	switch (located_uri.type) {
 	case LocatedUri::Type::ABSOLUTE:
 	case LocatedUri::Type::PATH:
-		return read_stream_art(r, located_uri.canonical_uri, offset);
+		return read_stream_art(client, r, located_uri.canonical_uri,
+				       offset);
 	case LocatedUri::Type::RELATIVE:
 #ifdef ENABLE_DATABASE
 		return read_db_art(client, r, located_uri.canonical_uri, offset);
@@ -353,3 +387,142 @@ handle_album_art(Client &client, Request args, Response &r)
 	return CommandResult::ERROR;
 }
 
+/**
+ * Extract the picture embedded in a local song file, asking the
+ * #PictureCache first (if one was configured).
+ *
+ * @return false if the file does not exist
+ */
+static bool
+load_file_picture(Path path_fs, Picture &picture)
+{
+	FileInfo info;
+	if (!GetFileInfo(path_fs, info) || !info.IsRegular())
+		return false;
+
+	const auto mtime = info.GetModificationTime();
+	if (picture_cache != nullptr &&
+	    picture_cache->Load(path_fs.c_str(), mtime, picture))
+		return true;
+
+	ScanFilePicture(path_fs, picture);
+
+	if (picture_cache != nullptr)
+		picture_cache->Store(path_fs.c_str(), mtime, picture);
+
+	return true;
+}
+
+static bool
+load_db_picture(Client &client, const char *uri, Picture &picture)
+{
+#ifdef ENABLE_DATABASE
+	const Storage *storage = client.GetStorage();
+	if (storage == nullptr)
+		return false;
+
+	{
+		AllocatedPath path_fs = storage->MapFS(uri);
+		if (!path_fs.IsNull())
+			return load_file_picture(path_fs, picture);
+	}
+
+	{
+		const std::string uri2 = storage->MapUTF8(uri);
+		if (uri_has_scheme(uri2.c_str())) {
+			ScanStreamPicture(uri2.c_str(), picture);
+			return true;
+		}
+	}
+#else
+	(void)client;
+	(void)uri;
+	(void)picture;
+#endif
+
+	return false;
+}
+
+static bool
+load_picture(Client &client, const LocatedUri &located_uri,
+	     Picture &picture)
+{
+	switch (located_uri.type) {
+	case LocatedUri::Type::ABSOLUTE:
+		ScanStreamPicture(located_uri.canonical_uri, picture);
+		return true;
+
+	case LocatedUri::Type::RELATIVE:
+		return load_db_picture(client, located_uri.canonical_uri,
+				       picture);
+
+	case LocatedUri::Type::PATH:
+		return load_file_picture(located_uri.path, picture);
+	}
+
+	gcc_unreachable();
+}
+
+CommandResult
+handle_read_picture(Client &client, Request args, Response &r)
+{
+	assert(args.size == 2);
+
+	const char *const uri = args.front();
+	const size_t offset = args.ParseUnsigned(1);
+
+	const auto located_uri = LocateUri(uri, &client
+#ifdef ENABLE_DATABASE
+					   , nullptr
+#endif
+					   );
+
+	if (client.art_stream_cache == nullptr)
+		client.art_stream_cache = std::make_unique<ArtStreamCache>();
+	auto &cache = *client.art_stream_cache;
+
+	/* the following chunk requests are served from the
+	   client's cache */
+	const auto now = std::chrono::steady_clock::now();
+	std::string key = located_uri.canonical_uri;
+	const Picture *picture = cache.GetPicture(key, now);
+	if (picture == nullptr) {
+		Picture new_picture;
+		if (!load_picture(client, located_uri, new_picture)) {
+			r.Error(ACK_ERROR_NO_EXIST, "No such file");
+			return CommandResult::ERROR;
+		}
+
+		picture = &cache.SetPicture(std::move(key),
+					    std::move(new_picture), now);
+	}
+
+	if (!picture->IsDefined()) {
+		/* no picture: an empty response */
+		cache.ClearPicture();
+		return CommandResult::OK;
+	}
+
+	const size_t size = picture->data.size();
+	if (offset > size) {
+		r.Error(ACK_ERROR_ARG, "Offset too large");
+		return CommandResult::ERROR;
+	}
+
+	const size_t read_size = std::min(size - offset, client.binary_limit);
+
+	r.Format("size: %zu\n", size);
+	if (!picture->mime_type.empty())
+		r.Format("type: %s\n", picture->mime_type.c_str());
+	r.Format("binary: %zu\n", read_size);
+
+	r.Write(picture->data.data() + offset, read_size);
+	r.Write("\n");
+
+	if (offset + read_size >= size)
+		/* this was the last chunk; the client will not ask
+		   for more */
+		cache.ClearPicture();
+
+	return CommandResult::OK;
+}
@@ -33,7 +33,10 @@
 #include "tag/Handler.hxx"
 #include "TimePrint.hxx"
 #include "decoder/DecoderPrint.hxx"
+#include "decoder/DecoderStats.hxx"
 #include "ls.hxx"
+#include "TraceFile.hxx"
+#include "util/Trace.hxx"
 #include "mixer/Volume.hxx"
 #include "util/ChronoUtil.hxx"
 #include "util/UriUtil.hxx"
@@ -86,6 +89,14 @@ handle_decoders(gcc_unused Client &client, gcc_unused Request args,
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_decoderstats(gcc_unused Client &client, gcc_unused Request args,
+		    Response &r)
+{
+	decoder_stats_print(r);
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_kill(gcc_unused Client &client, gcc_unused Request request,
 	    gcc_unused Response &r)
@@ -93,6 +104,32 @@ handle_kill(gcc_unused Client &client, gcc_unused Request request,
 	return CommandResult::KILL;
 }
 
+CommandResult
+handle_trace(gcc_unused Client &client, Request args, Response &r)
+{
+	const char *const cmd = args.front();
+
+	if (StringIsEqual(cmd, "start")) {
+		TraceStart();
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "stop")) {
+		TraceStop();
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "save")) {
+		if (trace_file.IsNull()) {
+			r.Error(ACK_ERROR_NO_EXIST,
+				"No 'trace_file' configured");
+			return CommandResult::ERROR;
+		}
+
+		TraceSave(trace_file);
+		return CommandResult::OK;
+	} else {
+		r.Error(ACK_ERROR_ARG, "Unknown sub command");
+		return CommandResult::ERROR;
+	}
+}
+
 CommandResult
 handle_listfiles(Client &client, Request args, Response &r)
 {
@@ -121,7 +158,7 @@ handle_listfiles(Client &client, Request args, Response &r)
 		if (client.GetInstance().storage != nullptr)
 			/* if we have a storage instance, obtain a list of
 			   files from it */
-			return handle_listfiles_storage(r,
+			return handle_listfiles_storage(client, r,
 							*client.GetInstance().storage,
 							uri);
 
@@ -147,7 +184,7 @@ public:
 	explicit PrintTagHandler(Response &_response) noexcept
 		:NullTagHandler(WANT_TAG), response(_response) {}
 
-	void OnTag(TagType type, const char *value) noexcept override {
+	void OnTag(TagType type, StringView value) noexcept override {
 		if (response.GetClient().tag_mask.Test(type))
 			tag_print(response, type, value);
 	}
@@ -367,6 +404,13 @@ handle_stats(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_memstats(Client &client, gcc_unused Request args, Response &r)
+{
+	memstats_print(r, client.GetInstance());
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, gcc_unused Request args, Response &r)
 {
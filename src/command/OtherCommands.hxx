@@ -32,9 +32,15 @@ handle_urlhandlers(Client &client, Request request, Response &response);
 CommandResult
 handle_decoders(Client &client, Request request, Response &response);
 
+CommandResult
+handle_decoderstats(Client &client, Request request, Response &response);
+
 CommandResult
 handle_kill(Client &client, Request request, Response &response);
 
+CommandResult
+handle_trace(Client &client, Request request, Response &response);
+
 CommandResult
 handle_listfiles(Client &client, Request request, Response &response);
 
@@ -56,6 +62,9 @@ handle_volume(Client &client, Request request, Response &response);
 CommandResult
 handle_stats(Client &client, Request request, Response &response);
 
+CommandResult
+handle_memstats(Client &client, Request request, Response &response);
+
 CommandResult
 handle_config(Client &client, Request request, Response &response);
 
@@ -24,6 +24,7 @@
 #include "client/Client.hxx"
 #include "client/Response.hxx"
 #include "Partition.hxx"
+#include "LatencyPrint.hxx"
 #include "IdleFlags.hxx"
 #include "util/CharUtil.hxx"
 
@@ -125,3 +126,19 @@ handle_devices(Client &client, gcc_unused Request args, Response &r)
 	printAudioDevices(r, client.GetPartition().outputs);
 	return CommandResult::OK;
 }
+
+CommandResult
+handle_outputstats(Client &client, gcc_unused Request args, Response &r)
+{
+	assert(args.empty());
+
+	auto &partition = client.GetPartition();
+
+	const auto latency = partition.pc.LockGetLatency();
+	latency_print(r, "decode", latency.decode);
+	latency_print(r, "pipe", latency.pipe);
+	r.Format("underruns: %u\n", latency.underruns);
+
+	printAudioOutputStats(r, partition.outputs);
+	return CommandResult::OK;
+}
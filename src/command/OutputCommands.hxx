@@ -41,4 +41,7 @@ handle_outputset(Client &client, Request request, Response &response);
 CommandResult
 handle_devices(Client &client, Request request, Response &response);
 
+CommandResult
+handle_outputstats(Client &client, Request request, Response &response);
+
 #endif
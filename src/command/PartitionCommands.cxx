@@ -22,6 +22,11 @@
 #include "Instance.hxx"
 #include "Partition.hxx"
 #include "IdleFlags.hxx"
+#include "MusicChunk.hxx"
+#include "output/Filtered.hxx"
+#include "output/Control.hxx"
+#include "mixer/MixerInternal.hxx"
+#include "mixer/Volume.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
 #include "util/CharUtil.hxx"
@@ -100,7 +105,9 @@ handle_newpartition(Client &client, Request request, Response &response)
 	instance.partitions.emplace_back(instance, name,
 					 // TODO: use real configuration
 					 16384,
-					 1024,
+					 1024, CHUNK_SIZE, MusicBufferConfig(),
+					 false, false, false,
+					 std::chrono::steady_clock::duration::zero(),
 					 AudioFormat::Undefined(),
 					 ReplayGainConfig());
 	auto &partition = instance.partitions.back();
@@ -113,3 +120,65 @@ handle_newpartition(Client &client, Request request, Response &response)
 
 	return CommandResult::OK;
 }
+
+CommandResult
+handle_moveoutput(Client &client, Request request, Response &response)
+{
+	const char *output_name = request[0];
+
+	auto &dest_partition = client.GetPartition();
+	auto *existing_output = dest_partition.outputs.FindByName(output_name);
+	if (existing_output != nullptr && !existing_output->IsDummy())
+		/* this output is already in the specified partition,
+		   so nothing needs to be done */
+		return CommandResult::OK;
+
+	/* find the partition which owns this output currently */
+	auto &instance = client.GetInstance();
+	for (auto &partition : instance.partitions) {
+		if (&partition == &dest_partition)
+			continue;
+
+		auto *output = partition.outputs.FindByName(output_name);
+		if (output == nullptr || output->IsDummy())
+			continue;
+
+		const bool was_enabled = output->IsEnabled();
+
+		AudioOutputControl *moved;
+		if (existing_output != nullptr) {
+			/* move the output back where it once was */
+			existing_output->ReplaceDummy(output->Steal(),
+						      was_enabled);
+			moved = existing_output;
+		} else
+			/* move the device to a new AudioOutputControl
+			   in the destination partition */
+			moved = &dest_partition.outputs.AddMoveFrom(std::move(*output),
+								    dest_partition.pc,
+								    was_enabled);
+
+		/* mixer events must now be delivered to the
+		   destination partition */
+		Mixer *mixer = moved->GetMixer();
+		if (mixer != nullptr) {
+			mixer->SetListener(dest_partition);
+
+			/* the volume of both partitions may have
+			   changed */
+			InvalidateHardwareVolume();
+			partition.EmitIdle(IDLE_MIXER);
+			dest_partition.EmitIdle(IDLE_MIXER);
+		}
+
+		/* let the source partition's player notice the
+		   change */
+		partition.pc.LockUpdateAudio();
+
+		instance.EmitIdle(IDLE_OUTPUT);
+		return CommandResult::OK;
+	}
+
+	response.Error(ACK_ERROR_NO_EXIST, "No such output");
+	return CommandResult::ERROR;
+}
@@ -89,7 +89,30 @@ handle_stop(Client &client, gcc_unused Request args, gcc_unused Response &r)
 CommandResult
 handle_currentsong(Client &client, gcc_unused Request args, Response &r)
 {
-	playlist_print_current(r, client.GetPlaylist());
+	const playlist &playlist = client.GetPlaylist();
+	const int position = playlist.GetCurrentPosition();
+	if (position < 0)
+		return CommandResult::OK;
+
+	auto &cache = client.GetPartition().current_song_cache;
+	const auto version = playlist.GetVersion();
+	const auto tag_mask = r.GetTagMask();
+	const bool binary = r.IsBinarySongs();
+
+	if (cache.Check(version, position, tag_mask, binary)) {
+		r.Write(cache.text.data(), cache.text.size());
+		return CommandResult::OK;
+	}
+
+	cache.valid = false;
+	cache.text.clear();
+
+	{
+		const ScopeResponseCapture capture(r, cache.text);
+		playlist_print_current(r, playlist);
+	}
+
+	cache.Set(version, position, tag_mask, binary);
 	return CommandResult::OK;
 }
 
@@ -107,17 +130,19 @@ handle_pause(Client &client, Request args, gcc_unused Response &r)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_status(Client &client, gcc_unused Request args, Response &r)
+/**
+ * Print the part of the "status" response which precedes the
+ * "time" line.
+ */
+static void
+PrintStatusHead(Response &r, const Partition &partition,
+		const StatusCacheKey &key)
 {
-	auto &pc = client.GetPlayerControl();
+	const auto &pc = partition.pc;
+	const playlist &playlist = partition.playlist;
 
 	const char *state = nullptr;
-	int song;
-
-	const auto player_status = pc.LockGetStatus();
-
-	switch (player_status.state) {
+	switch (key.state) {
 	case PlayerState::STOP:
 		state = "stop";
 		break;
@@ -129,11 +154,8 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		break;
 	}
 
-	const playlist &playlist = client.GetPlaylist();
-
-	const auto volume = volume_level_get(client.GetPartition().outputs);
-	if (volume >= 0)
-		r.Format("volume: %i\n", volume);
+	if (key.volume >= 0)
+		r.Format("volume: %i\n", key.volume);
 
 	r.Format(COMMAND_STATUS_REPEAT ": %i\n"
 		 COMMAND_STATUS_RANDOM ": %i\n"
@@ -147,7 +169,7 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		 playlist.GetRandom(),
 		 SingleToString(playlist.GetSingle()),
 		 playlist.GetConsume(),
-		 (unsigned long)playlist.GetVersion(),
+		 (unsigned long)key.playlist_version,
 		 playlist.GetLength(),
 		 pc.GetMixRampDb(),
 		 state);
@@ -160,57 +182,139 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		r.Format(COMMAND_STATUS_MIXRAMPDELAY ": %f\n",
 			 pc.GetMixRampDelay().count());
 
-	song = playlist.GetCurrentPosition();
-	if (song >= 0) {
+	if (key.current >= 0) {
 		r.Format(COMMAND_STATUS_SONG ": %i\n"
 			 COMMAND_STATUS_SONGID ": %u\n",
-			 song, playlist.PositionToId(song));
+			 key.current, playlist.PositionToId(key.current));
 	}
+}
 
-	if (player_status.state != PlayerState::STOP) {
-		r.Format(COMMAND_STATUS_TIME ": %i:%i\n"
-			 "elapsed: %1.3f\n"
-			 COMMAND_STATUS_BITRATE ": %u\n",
-			 player_status.elapsed_time.RoundS(),
-			 player_status.total_time.IsNegative()
-			 ? 0u
-			 : unsigned(player_status.total_time.RoundS()),
-			 player_status.elapsed_time.ToDoubleS(),
-			 player_status.bit_rate);
-
-		if (!player_status.total_time.IsNegative())
+/**
+ * Print the "time" and "elapsed" lines, which are not cached.
+ */
+static void
+PrintStatusTime(Response &r, const PlayerStatus &player_status)
+{
+	if (player_status.state == PlayerState::STOP)
+		return;
+
+	r.Format(COMMAND_STATUS_TIME ": %i:%i\n"
+		 "elapsed: %1.3f\n",
+		 player_status.elapsed_time.RoundS(),
+		 player_status.total_time.IsNegative()
+		 ? 0u
+		 : unsigned(player_status.total_time.RoundS()),
+		 player_status.elapsed_time.ToDoubleS());
+}
+
+/**
+ * Print the part of the "status" response which follows the
+ * "elapsed" line.
+ */
+static void
+PrintStatusTail(Response &r, const Partition &partition,
+		const StatusCacheKey &key)
+{
+	const playlist &playlist = partition.playlist;
+
+	if (key.state != PlayerState::STOP) {
+		r.Format(COMMAND_STATUS_BITRATE ": %u\n", key.bit_rate);
+
+		if (!key.total_time.IsNegative())
 			r.Format("duration: %1.3f\n",
-				 player_status.total_time.ToDoubleS());
+				 key.total_time.ToDoubleS());
 
-		if (player_status.audio_format.IsDefined())
+		if (key.audio_format.IsDefined())
 			r.Format(COMMAND_STATUS_AUDIO ": %s\n",
-				 ToString(player_status.audio_format).c_str());
+				 ToString(key.audio_format).c_str());
 	}
 
+	if (key.underruns > 0)
+		r.Format("underruns: %u\n", key.underruns);
+
+	if (key.update_id != 0) {
+		r.Format(COMMAND_STATUS_UPDATING_DB ": %i\n",
+			 key.update_id);
+	}
+
+	if (key.error)
+		r.Format(COMMAND_STATUS_ERROR ": %s\n",
+			 GetFullMessage(key.error).c_str());
+
+	if (key.next >= 0)
+		r.Format(COMMAND_STATUS_NEXTSONG ": %i\n"
+			 COMMAND_STATUS_NEXTSONGID ": %u\n",
+			 key.next, playlist.PositionToId(key.next));
+}
+
+CommandResult
+handle_status(Client &client, gcc_unused Request args, Response &r)
+{
+	auto &partition = client.GetPartition();
+	const playlist &playlist = partition.playlist;
+
+	StatusCacheKey key;
+
+	/* read the generation before the state, so a concurrent
+	   change can only cause a needless refresh next time */
+	key.idle_generation = client.GetInstance().idle_generation;
+
+	auto player_status = partition.pc.GetStatus();
+
+	key.volume = volume_level_get(partition.outputs);
+	key.playlist_version = playlist.GetVersion();
+	key.current = playlist.GetCurrentPosition();
+	key.next = playlist.GetNextPosition();
+
 #ifdef ENABLE_DATABASE
 	const UpdateService *update_service = client.GetInstance().update;
-	unsigned updateJobId = update_service != nullptr
+	key.update_id = update_service != nullptr
 		? update_service->GetId()
 		: 0;
-	if (updateJobId != 0) {
-		r.Format(COMMAND_STATUS_UPDATING_DB ": %i\n",
-			 updateJobId);
-	}
+#else
+	key.update_id = 0;
 #endif
 
-	try {
-		pc.LockCheckRethrowError();
-	} catch (...) {
-		r.Format(COMMAND_STATUS_ERROR ": %s\n",
-			 GetFullMessage(std::current_exception()).c_str());
+	key.state = player_status.state;
+	key.underruns = player_status.underruns;
+	key.error = std::move(player_status.error);
+
+	if (player_status.state != PlayerState::STOP) {
+		key.bit_rate = player_status.bit_rate;
+		key.audio_format = player_status.audio_format;
+		key.total_time = player_status.total_time;
+	} else {
+		key.bit_rate = 0;
+		key.audio_format.Clear();
+		key.total_time = SignedSongTime::Negative();
 	}
 
-	song = playlist.GetNextPosition();
-	if (song >= 0)
-		r.Format(COMMAND_STATUS_NEXTSONG ": %i\n"
-			 COMMAND_STATUS_NEXTSONGID ": %u\n",
-			 song, playlist.PositionToId(song));
+	auto &cache = partition.status_cache;
+	if (cache.valid && cache.key == key) {
+		r.Write(cache.head.data(), cache.head.size());
+		PrintStatusTime(r, player_status);
+		r.Write(cache.tail.data(), cache.tail.size());
+		return CommandResult::OK;
+	}
+
+	cache.valid = false;
+	cache.head.clear();
+	cache.tail.clear();
+
+	{
+		const ScopeResponseCapture capture(r, cache.head);
+		PrintStatusHead(r, partition, key);
+	}
+
+	PrintStatusTime(r, player_status);
+
+	{
+		const ScopeResponseCapture capture(r, cache.tail);
+		PrintStatusTail(r, partition, key);
+	}
 
+	cache.key = std::move(key);
+	cache.valid = true;
 	return CommandResult::OK;
 }
 
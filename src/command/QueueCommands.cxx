@@ -40,6 +40,7 @@
 #include "util/StringAPI.hxx"
 #include "util/NumberParser.hxx"
 
+#include <algorithm>
 #include <memory>
 #include <limits>
 
@@ -244,6 +245,17 @@ handle_playlistinfo(Client &client, Request args, Response &r)
 
 	playlist_print_info(r, client.GetPlaylist(),
 			    range.start, range.end);
+
+	if (!range.IsAll()) {
+		/* the client is probably going to display this
+		   range: scan its remote tags first */
+		const Queue &queue = client.GetPlaylist().queue;
+		auto &instance = client.GetInstance();
+		const unsigned end = std::min(range.end, queue.GetLength());
+		for (unsigned i = end; i > range.start; --i)
+			instance.PrioritizeRemoteTag(queue.Get(i - 1).GetURI());
+	}
+
 	return CommandResult::OK;
 }
 
@@ -285,6 +297,13 @@ handle_playlistfind(Client &client, Request args, Response &r)
 	return handle_playlist_match(client, args, r, false);
 }
 
+CommandResult
+handle_playlistcontains(Client &client, Request args, Response &r)
+{
+	playlist_print_contains(r, client.GetPlaylist(), args);
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_playlistsearch(Client &client, Request args, Response &r)
 {
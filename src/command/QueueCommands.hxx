@@ -65,6 +65,9 @@ handle_playlistid(Client &client, Request request, Response &response);
 CommandResult
 handle_playlistfind(Client &client, Request request, Response &response);
 
+CommandResult
+handle_playlistcontains(Client &client, Request request, Response &response);
+
 CommandResult
 handle_playlistsearch(Client &client, Request request, Response &response);
 
@@ -21,6 +21,7 @@
 #include "Request.hxx"
 #include "SongPrint.hxx"
 #include "db/Interface.hxx"
+#include "song/LightSong.hxx"
 #include "sticker/SongSticker.hxx"
 #include "sticker/StickerPrint.hxx"
 #include "sticker/StickerDatabase.hxx"
@@ -29,6 +30,11 @@
 #include "Partition.hxx"
 #include "util/StringAPI.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <map>
+#include <string>
+#include <vector>
 
 namespace {
 struct sticker_song_find_data {
@@ -48,6 +54,14 @@ sticker_song_find_print_cb(const LightSong &song, const char *value,
 	sticker_print_value(data->r, data->name, value);
 }
 
+static void
+sticker_song_get_values_cb(const char *uri, const char *value,
+			   void *user_data)
+{
+	auto &values = *(std::map<std::string, std::string> *)user_data;
+	values.emplace(uri, value);
+}
+
 static CommandResult
 handle_sticker_song(Response &r, Partition &partition, Request args)
 {
@@ -69,6 +83,41 @@ handle_sticker_song(Response &r, Partition &partition, Request args)
 
 		sticker_print_value(r, args[3], value.c_str());
 
+		return CommandResult::OK;
+	/* getmany song key song_id... */
+	} else if (args.size >= 4 && StringIsEqual(cmd, "getmany")) {
+		const char *const name = args[2];
+
+		std::vector<std::string> uris;
+		uris.reserve(args.size - 3);
+		for (unsigned i = 3; i < args.size; ++i) {
+			const LightSong *song = db.GetSong(args[i]);
+			assert(song != nullptr);
+			AtScopeExit(&db, song) { db.ReturnSong(song); };
+
+			uris.emplace_back(song->GetURI());
+		}
+
+		std::vector<const char *> pointers;
+		pointers.reserve(uris.size());
+		for (const auto &uri : uris)
+			pointers.push_back(uri.c_str());
+
+		std::map<std::string, std::string> values;
+		sticker_song_get_values({pointers.data(), pointers.size()},
+					name,
+					sticker_song_get_values_cb, &values);
+
+		/* print in the order of the request */
+		for (const auto &uri : uris) {
+			auto i = values.find(uri);
+			if (i == values.end())
+				continue;
+
+			song_print_uri(r, uri.c_str());
+			sticker_print_value(r, name, i->second.c_str());
+		}
+
 		return CommandResult::OK;
 	/* list song song_id */
 	} else if (args.size == 3 && StringIsEqual(cmd, "list")) {
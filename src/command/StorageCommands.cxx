@@ -29,6 +29,7 @@
 #include "fs/Traits.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseCursor.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "storage/Registry.hxx"
@@ -36,12 +37,24 @@
 #include "storage/FileInfo.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/update/Service.hxx"
+#include "db/QueryCache.hxx"
+#include "event/MaskMonitor.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "TimePrint.hxx"
 #include "Idle.hxx"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
 #include <memory>
+#include <string>
+#include <exception>
+#include <vector>
 
 #include <inttypes.h> /* for PRIu64 */
+#include <assert.h>
 
 gcc_pure
 static bool
@@ -50,18 +63,33 @@ skip_path(const char *name_utf8) noexcept
 	return strchr(name_utf8, '\n') != nullptr;
 }
 
-#if defined(_WIN32) && GCC_CHECK_VERSION(4,6)
-/* PRIu64 causes bogus compiler warning */
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat"
-#pragma GCC diagnostic ignored "-Wformat-extra-args"
-#endif
+/**
+ * One entry of a storage directory listing.
+ */
+struct StorageListingEntry {
+	std::string name;
+
+	StorageFileInfo info;
+
+	StorageListingEntry(const char *_name,
+			    const StorageFileInfo &_info) noexcept
+		:name(_name), info(_info) {}
+};
 
+typedef std::vector<StorageListingEntry> StorageListing;
+
+/**
+ * Read all entries of a directory which "listfiles" shall print.
+ * May be called in any thread.
+ *
+ * @param cancel if this flag becomes true, reading is stopped
+ */
 static void
-handle_listfiles_storage(Response &r, StorageDirectoryReader &reader)
+ReadStorageListing(StorageListing &listing, StorageDirectoryReader &reader,
+		   const std::atomic_bool &cancel)
 {
 	const char *name_utf8;
-	while ((name_utf8 = reader.Read()) != nullptr) {
+	while (!cancel && (name_utf8 = reader.Read()) != nullptr) {
 		if (skip_path(name_utf8))
 			continue;
 
@@ -72,40 +100,320 @@ handle_listfiles_storage(Response &r, StorageDirectoryReader &reader)
 			continue;
 		}
 
-		switch (info.type) {
-		case StorageFileInfo::Type::OTHER:
+		if (info.type == StorageFileInfo::Type::OTHER)
 			/* ignore */
 			continue;
 
-		case StorageFileInfo::Type::REGULAR:
-			r.Format("file: %s\n"
-				 "size: %" PRIu64 "\n",
-				 name_utf8,
-				 info.size);
-			break;
+		listing.emplace_back(name_utf8, info);
+	}
+}
 
-		case StorageFileInfo::Type::DIRECTORY:
-			r.Format("directory: %s\n", name_utf8);
-			break;
-		}
+#if defined(_WIN32) && GCC_CHECK_VERSION(4,6)
+/* PRIu64 causes bogus compiler warning */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+#endif
 
-		if (!IsNegative(info.mtime))
-			time_print(r, "Last-Modified", info.mtime);
+static void
+print_storage_listing_entry(Response &r, const StorageListingEntry &entry)
+{
+	switch (entry.info.type) {
+	case StorageFileInfo::Type::OTHER:
+		assert(false);
+		gcc_unreachable();
+
+	case StorageFileInfo::Type::REGULAR:
+		r.Format("file: %s\n"
+			 "size: %" PRIu64 "\n",
+			 entry.name.c_str(),
+			 entry.info.size);
+		break;
+
+	case StorageFileInfo::Type::DIRECTORY:
+		r.Format("directory: %s\n", entry.name.c_str());
+		break;
 	}
+
+	if (!IsNegative(entry.info.mtime))
+		time_print(r, "Last-Modified", entry.info.mtime);
 }
 
 #if defined(_WIN32) && GCC_CHECK_VERSION(4,6)
 #pragma GCC diagnostic pop
 #endif
 
-CommandResult
-handle_listfiles_storage(Response &r, Storage &storage, const char *uri)
+/**
+ * How long a remote directory listing is reused.  Clients often
+ * send "listfiles" for the same directory several times in a row
+ * (e.g. when going back in a file browser).
+ */
+static constexpr std::chrono::steady_clock::duration STORAGE_LISTING_MAX_AGE =
+	std::chrono::seconds(5);
+
+/**
+ * Remembers the listings of the most recently listed remote
+ * directories for #STORAGE_LISTING_MAX_AGE.  Local directories are
+ * not cached, because reading them is cheap.
+ *
+ * This class is not thread-safe; it is only used in the main thread.
+ */
+class StorageListingCache {
+	static constexpr size_t MAX_ITEMS = 16;
+
+	struct Item {
+		/**
+		 * The storage URI of the directory for the
+		 * #CompositeStorage, or the absolute URI of the
+		 * directory.
+		 */
+		std::string key;
+
+		std::shared_ptr<const StorageListing> listing;
+
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	/**
+	 * The most recently added item first.
+	 */
+	std::list<Item> items;
+
+public:
+	std::shared_ptr<const StorageListing> Get(const std::string &key) noexcept {
+		Expire();
+
+		for (const auto &i : items)
+			if (i.key == key)
+				return i.listing;
+
+		return nullptr;
+	}
+
+	void Put(const std::string &key,
+		 std::shared_ptr<const StorageListing> listing) noexcept {
+		items.remove_if([&key](const Item &i){
+				return i.key == key;
+			});
+
+		if (items.size() >= MAX_ITEMS)
+			items.pop_back();
+
+		items.push_front({key, std::move(listing),
+				  std::chrono::steady_clock::now() +
+				  STORAGE_LISTING_MAX_AGE});
+	}
+
+	void Clear() noexcept {
+		items.clear();
+	}
+
+private:
+	void Expire() noexcept {
+		const auto now = std::chrono::steady_clock::now();
+		items.remove_if([now](const Item &i){
+				return now >= i.expires;
+			});
+	}
+};
+
+static StorageListingCache storage_listing_cache;
+
+/**
+ * The number of entries printed by each ListFilesCursor::Fill()
+ * call, so a huge directory is sent in windows instead of being
+ * rendered into one big response.
+ */
+static constexpr size_t LISTFILES_WINDOW = 256;
+
+/**
+ * Implementation of "listfiles" for remote storages outside of a
+ * command list: the directory is read in a separate thread while
+ * the client waits on a suspended response cursor, so the
+ * PROPFIND/READDIR round trips don't block the main loop (and all
+ * other clients).  The result is stored in #storage_listing_cache
+ * and printed in windows of #LISTFILES_WINDOW entries; a listing
+ * found in the cache is printed the same way, without a thread.
+ */
+class ListFilesCursor final : public ResponseCursor {
+	/**
+	 * Owns the storage if it was created only for this command.
+	 */
+	std::unique_ptr<Storage> owned_storage;
+
+	/**
+	 * The storage to be read; nullptr if the listing was found
+	 * in the cache.
+	 */
+	Storage *const storage;
+
+	const std::string uri;
+
+	const std::string cache_key;
+
+	std::shared_ptr<StorageListing> result;
+
+	std::shared_ptr<const StorageListing> listing;
+
+	size_t position = 0;
+
+	std::atomic_bool cancel;
+
+	Thread thread;
+
+	/**
+	 * Notifies the main thread that #thread has finished.
+	 */
+	MaskMonitor done_monitor;
+
+	/**
+	 * The error thrown while reading; only valid after #thread
+	 * has finished.
+	 */
+	std::exception_ptr error;
+
+public:
+	ListFilesCursor(Instance &instance,
+			std::unique_ptr<Storage> &&_owned_storage,
+			Storage &_storage, const char *_uri,
+			std::string &&_cache_key) noexcept
+		:ResponseCursor("listfiles"),
+		 owned_storage(std::move(_owned_storage)),
+		 storage(&_storage), uri(_uri),
+		 cache_key(std::move(_cache_key)),
+		 result(std::make_shared<StorageListing>()),
+		 cancel(false),
+		 thread(BIND_THIS_METHOD(RunList)),
+		 done_monitor(instance.event_loop,
+			      BIND_THIS_METHOD(OnListDone)) {}
+
+	ListFilesCursor(Instance &instance,
+			std::shared_ptr<const StorageListing> &&_listing) noexcept
+		:ResponseCursor("listfiles"),
+		 storage(nullptr),
+		 listing(std::move(_listing)),
+		 cancel(false),
+		 thread(BIND_THIS_METHOD(RunList)),
+		 done_monitor(instance.event_loop,
+			      BIND_THIS_METHOD(OnListDone)) {}
+
+	~ListFilesCursor() noexcept override {
+		done_monitor.Cancel();
+
+		/* the client has disconnected before the listing has
+		   finished; this blocks until the pending request of
+		   the storage plugin returns */
+		if (thread.IsDefined()) {
+			cancel = true;
+			thread.Join();
+		}
+	}
+
+	void Start() {
+		assert(storage != nullptr);
+
+		thread.Start();
+		Suspend();
+	}
+
+	/* virtual methods from class ResponseCursor */
+	bool Fill(Response &r) override {
+		assert(!thread.IsDefined());
+
+		if (error)
+			std::rethrow_exception(error);
+
+		const size_t end = std::min(position + LISTFILES_WINDOW,
+					    listing->size());
+		for (; position < end; ++position)
+			print_storage_listing_entry(r, (*listing)[position]);
+
+		return position < listing->size();
+	}
+
+private:
+	void RunList() noexcept {
+		SetThreadName("listfiles");
+
+		try {
+			const auto reader = storage->OpenDirectory(uri.c_str());
+			ReadStorageListing(*result, *reader, cancel);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		done_monitor.OrMask(1);
+	}
+
+	/* callback for #done_monitor */
+	void OnListDone(unsigned) noexcept {
+		thread.Join();
+
+		if (!error) {
+			listing = std::move(result);
+			storage_listing_cache.Put(cache_key, listing);
+		}
+
+		Resume();
+	}
+};
+
+static CommandResult
+handle_listfiles_storage(Client &client, Response &r,
+			 std::unique_ptr<Storage> &&owned_storage,
+			 Storage &storage, const char *uri,
+			 std::string &&cache_key)
 {
-	std::unique_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(uri));
-	handle_listfiles_storage(r, *reader);
+	/* local directories are read synchronously and not
+	   cached */
+	const bool remote = storage.MapFS(uri).IsNull();
+
+	std::shared_ptr<const StorageListing> listing;
+	if (remote)
+		listing = storage_listing_cache.Get(cache_key);
+
+	if (!client.cmd_list.IsActive()) {
+		if (listing != nullptr) {
+			client.SetCursor(std::make_unique<ListFilesCursor>(client.GetInstance(),
+									   std::move(listing)));
+			return CommandResult::DEFERRED;
+		}
+
+		if (remote) {
+			auto cursor = std::make_unique<ListFilesCursor>(client.GetInstance(),
+									std::move(owned_storage),
+									storage, uri,
+									std::move(cache_key));
+			cursor->Start();
+			client.SetCursor(std::move(cursor));
+			return CommandResult::DEFERRED;
+		}
+	}
+
+	if (listing == nullptr) {
+		const std::atomic_bool cancel(false);
+		auto l = std::make_shared<StorageListing>();
+		const auto reader = storage.OpenDirectory(uri);
+		ReadStorageListing(*l, *reader, cancel);
+		if (remote)
+			storage_listing_cache.Put(cache_key, l);
+		listing = std::move(l);
+	}
+
+	for (const auto &entry : *listing)
+		print_storage_listing_entry(r, entry);
+
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_listfiles_storage(Client &client, Response &r,
+			 Storage &storage, const char *uri)
+{
+	return handle_listfiles_storage(client, r, nullptr, storage, uri,
+					uri);
+}
+
 CommandResult
 handle_listfiles_storage(Client &client, Response &r, const char *uri)
 {
@@ -116,7 +424,9 @@ handle_listfiles_storage(Client &client, Response &r, const char *uri)
 		return CommandResult::ERROR;
 	}
 
-	return handle_listfiles_storage(r, *storage, "");
+	Storage &s = *storage;
+	return handle_listfiles_storage(client, r, std::move(storage), s, "",
+					uri);
 }
 
 static void
@@ -167,6 +477,128 @@ handle_listmounts(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
+/**
+ * Add a new #Storage to the #CompositeStorage and the database.
+ */
+static void
+MountStorage(Instance &instance, CompositeStorage &composite,
+	     const char *local_uri, const char *remote_uri,
+	     std::unique_ptr<Storage> storage)
+{
+	composite.Mount(local_uri, std::move(storage));
+	storage_listing_cache.Clear();
+	instance.EmitIdle(IDLE_MOUNT);
+
+#ifdef ENABLE_DATABASE
+	if (auto *db = dynamic_cast<SimpleDatabase *>(instance.database)) {
+		try {
+			db->Mount(local_uri, remote_uri);
+		} catch (...) {
+			composite.Unmount(local_uri);
+			throw;
+		}
+
+		// TODO: call Instance::OnDatabaseModified()?
+		// TODO: trigger database update?
+		if (instance.query_cache != nullptr)
+			instance.query_cache->Clear();
+		instance.EmitIdle(IDLE_DATABASE);
+	}
+#else
+	(void)remote_uri;
+#endif
+}
+
+/**
+ * Implementation of the "mount" command outside of a command list:
+ * the new #Storage is probed in a separate thread, so a file server
+ * which is slow to respond does not block the main loop (and all
+ * other clients) until it times out.  The actual mount happens in
+ * the main thread after the probe has succeeded.
+ */
+class MountCursor final : public ResponseCursor {
+	Instance &instance;
+	CompositeStorage &composite;
+
+	const std::string local_uri, remote_uri;
+
+	std::unique_ptr<Storage> storage;
+
+	Thread thread;
+
+	/**
+	 * Notifies the main thread that #thread has finished.
+	 */
+	MaskMonitor done_monitor;
+
+	/**
+	 * The error thrown by the probe; only valid after #thread
+	 * has finished.
+	 */
+	std::exception_ptr error;
+
+public:
+	MountCursor(Instance &_instance, CompositeStorage &_composite,
+		    const char *_local_uri, const char *_remote_uri,
+		    std::unique_ptr<Storage> &&_storage) noexcept
+		:ResponseCursor("mount"),
+		 instance(_instance), composite(_composite),
+		 local_uri(_local_uri), remote_uri(_remote_uri),
+		 storage(std::move(_storage)),
+		 thread(BIND_THIS_METHOD(RunProbe)),
+		 done_monitor(instance.event_loop,
+			      BIND_THIS_METHOD(OnProbeDone)) {}
+
+	~MountCursor() noexcept override {
+		done_monitor.Cancel();
+
+		/* the client has disconnected before the probe has
+		   finished; this blocks until the storage plugin's
+		   own timeout expires */
+		if (thread.IsDefined())
+			thread.Join();
+	}
+
+	void Start() {
+		thread.Start();
+		Suspend();
+	}
+
+	/* virtual methods from class ResponseCursor */
+	bool Fill(Response &) override {
+		assert(!thread.IsDefined());
+
+		if (error)
+			std::rethrow_exception(error);
+
+		MountStorage(instance, composite,
+			     local_uri.c_str(), remote_uri.c_str(),
+			     std::move(storage));
+		return false;
+	}
+
+private:
+	void RunProbe() noexcept {
+		SetThreadName("mount");
+
+		try {
+			/* check whether the server is reachable and
+			   the path exists */
+			storage->GetInfo("", true);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		done_monitor.OrMask(1);
+	}
+
+	/* callback for #done_monitor */
+	void OnProbeDone(unsigned) noexcept {
+		thread.Join();
+		Resume();
+	}
+};
+
 CommandResult
 handle_mount(Client &client, Request args, Response &r)
 {
@@ -205,24 +637,18 @@ handle_mount(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
-	composite.Mount(local_uri, std::move(storage));
-	instance.EmitIdle(IDLE_MOUNT);
-
-#ifdef ENABLE_DATABASE
-	if (auto *db = dynamic_cast<SimpleDatabase *>(instance.database)) {
-		try {
-			db->Mount(local_uri, remote_uri);
-		} catch (...) {
-			composite.Unmount(local_uri);
-			throw;
-		}
-
-		// TODO: call Instance::OnDatabaseModified()?
-		// TODO: trigger database update?
-		instance.EmitIdle(IDLE_DATABASE);
+	if (!client.cmd_list.IsActive()) {
+		std::unique_ptr<MountCursor>
+			cursor(new MountCursor(instance, composite,
+					       local_uri, remote_uri,
+					       std::move(storage)));
+		cursor->Start();
+		client.SetCursor(std::move(cursor));
+		return CommandResult::DEFERRED;
 	}
-#endif
 
+	MountStorage(instance, composite, local_uri, remote_uri,
+		     std::move(storage));
 	return CommandResult::OK;
 }
 
@@ -254,9 +680,12 @@ handle_unmount(Client &client, Request args, Response &r)
 		instance.update->CancelMount(local_uri);
 
 	if (auto *db = dynamic_cast<SimpleDatabase *>(instance.database)) {
-		if (db->Unmount(local_uri))
+		if (db->Unmount(local_uri)) {
 			// TODO: call Instance::OnDatabaseModified()?
+			if (instance.query_cache != nullptr)
+				instance.query_cache->Clear();
 			instance.EmitIdle(IDLE_DATABASE);
+		}
 	}
 #endif
 
@@ -265,6 +694,7 @@ handle_unmount(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
+	storage_listing_cache.Clear();
 	instance.EmitIdle(IDLE_MOUNT);
 
 	return CommandResult::OK;
@@ -28,7 +28,8 @@ class Request;
 class Response;
 
 CommandResult
-handle_listfiles_storage(Response &r, Storage &storage, const char *uri);
+handle_listfiles_storage(Client &client, Response &r,
+			 Storage &storage, const char *uri);
 
 CommandResult
 handle_listfiles_storage(Client &client, Response &r, const char *uri);
@@ -35,6 +35,7 @@ enum class ConfigOption {
 	FOLLOW_OUTSIDE_SYMLINKS,
 	DB_FILE,
 	STICKER_FILE,
+	STICKER_SYNCHRONOUS,
 	LOG_FILE,
 	PID_FILE,
 	STATE_FILE,
@@ -58,7 +59,12 @@ enum class ConfigOption {
 	REPLAYGAIN_LIMIT,
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
+	DITHER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_BUFFER_HUGE_PAGES,
+	AUDIO_BUFFER_LOCK,
+	AUDIO_BUFFER_PREFAULT,
+	AUDIO_CHUNK_SIZE,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
@@ -69,6 +75,9 @@ enum class ConfigOption {
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	MAX_OUTPUT_BUFFER_TOTAL,
+	MAX_COMMAND_SLICE,
+	SLOW_COMMAND_THRESHOLD,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
@@ -76,6 +85,28 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	UPDATE_THREADS,
+	QUERY_CACHE_SIZE,
+	TAG_CACHE_FILE,
+	LOUDNESS_SCAN,
+	MIXRAMP_SCAN,
+	FINGERPRINT_SCAN,
+	FINGERPRINT_DURATION,
+	INPUT_CACHE_DIRECTORY,
+	INPUT_CACHE_SIZE,
+	PICTURE_CACHE_DIRECTORY,
+	PICTURE_CACHE_SCAN,
+	REMOTE_TAG_SCANNERS,
+	REMOTE_TAG_CACHE_FILE,
+	SEEK_INDEX_FILE,
+	WARM_DECODER,
+	LOW_LATENCY,
+	GAPLESS_CONVERT,
+	STREAM_TAG_INTERVAL,
+	TRACE_FILE,
+	METRICS_PORT,
+	METRICS_BIND_TO_ADDRESS,
+	MEMORY_BUDGET,
 	DESPOTIFY_USER,
 	DESPOTIFY_PASSWORD,
 	DESPOTIFY_HIGH_BITRATE,
@@ -91,6 +122,7 @@ enum class ConfigBlockOption {
 	AUDIO_FILTER,
 	DATABASE,
 	NEIGHBORS,
+	THREAD,
 	MAX
 };
 
@@ -30,6 +30,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "follow_outside_symlinks" },
 	{ "db_file" },
 	{ "sticker_file" },
+	{ "sticker_synchronous" },
 	{ "log_file" },
 	{ "pid_file" },
 	{ "state_file" },
@@ -53,7 +54,12 @@ const ConfigTemplate config_param_templates[] = {
 	{ "replaygain_limit" },
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
+	{ "dither" },
 	{ "audio_buffer_size" },
+	{ "audio_buffer_huge_pages" },
+	{ "audio_buffer_lock" },
+	{ "audio_buffer_prefault" },
+	{ "audio_chunk_size" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -64,6 +70,9 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "max_output_buffer_total" },
+	{ "max_command_slice" },
+	{ "slow_command_threshold" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
@@ -71,6 +80,28 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback", false, true },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "update_threads" },
+	{ "query_cache_size" },
+	{ "tag_cache_file" },
+	{ "loudness_scan" },
+	{ "mixramp_scan" },
+	{ "fingerprint_scan" },
+	{ "fingerprint_duration" },
+	{ "input_cache_directory" },
+	{ "input_cache_size" },
+	{ "picture_cache_directory" },
+	{ "picture_cache_scan" },
+	{ "remote_tag_scanners" },
+	{ "remote_tag_cache_file" },
+	{ "seek_index_file" },
+	{ "warm_decoder" },
+	{ "low_latency" },
+	{ "gapless_convert" },
+	{ "stream_tag_interval" },
+	{ "trace_file" },
+	{ "metrics_port" },
+	{ "metrics_bind_to_address" },
+	{ "memory_budget" },
 	{ "despotify_user", false, true },
 	{ "despotify_password", false, true },
 	{ "despotify_high_bitrate", false, true },
@@ -87,10 +118,11 @@ const ConfigTemplate config_block_templates[] = {
 	{ "decoder", true },
 	{ "input", true },
 	{ "playlist_plugin", true },
-	{ "resampler" },
+	{ "resampler", true },
 	{ "filter", true },
 	{ "database" },
 	{ "neighbors", true },
+	{ "thread", true },
 };
 
 static constexpr unsigned n_config_block_templates =
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DB_ASYNC_HANDLER_HXX
+#define MPD_DB_ASYNC_HANDLER_HXX
+
+#include <exception>
+#include <vector>
+
+class DetachedSong;
+
+/**
+ * Receives the result of Database::VisitSongsAsync().  The methods
+ * are called in the main thread.
+ */
+class DatabaseAsyncHandler {
+public:
+	/**
+	 * The query has finished successfully.
+	 *
+	 * @param songs all matching songs, already sorted and
+	 * windowed as requested by the #DatabaseSelection
+	 */
+	virtual void OnDatabaseAsyncSongs(std::vector<DetachedSong> &&songs) noexcept = 0;
+
+	/**
+	 * The query has failed.
+	 */
+	virtual void OnDatabaseAsyncError(std::exception_ptr error) noexcept = 0;
+};
+
+#endif
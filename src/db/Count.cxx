@@ -20,6 +20,7 @@
 #include "Count.hxx"
 #include "Selection.hxx"
 #include "Interface.hxx"
+#include "Stats.hxx"
 #include "Partition.hxx"
 #include "client/Response.hxx"
 #include "song/LightSong.hxx"
@@ -28,18 +29,6 @@
 #include "TagPrint.hxx"
 
 #include <functional>
-#include <map>
-
-struct SearchStats {
-	unsigned n_songs;
-	std::chrono::duration<std::uint64_t, SongTime::period> total_duration;
-
-	constexpr SearchStats()
-		:n_songs(0), total_duration(0) {}
-};
-
-class TagCountMap : public std::map<std::string, SearchStats> {
-};
 
 static void
 PrintSearchStats(Response &r, const SearchStats &stats) noexcept
@@ -53,7 +42,7 @@ PrintSearchStats(Response &r, const SearchStats &stats) noexcept
 }
 
 static void
-Print(Response &r, TagType group, const TagCountMap &m) noexcept
+Print(Response &r, TagType group, const GroupStatsMap &m) noexcept
 {
 	assert(unsigned(group) < TAG_NUM_OF_ITEM_TYPES);
 
@@ -74,7 +63,7 @@ stats_visitor_song(SearchStats &stats, const LightSong &song) noexcept
 }
 
 static void
-CollectGroupCounts(TagCountMap &map, const Tag &tag,
+CollectGroupCounts(GroupStatsMap &map, const Tag &tag,
 		   const char *value) noexcept
 {
 	auto r = map.insert(std::make_pair(value, SearchStats()));
@@ -85,7 +74,7 @@ CollectGroupCounts(TagCountMap &map, const Tag &tag,
 }
 
 static void
-GroupCountVisitor(TagCountMap &map, TagType group,
+GroupCountVisitor(GroupStatsMap &map, TagType group,
 		  const LightSong &song) noexcept
 {
 	const Tag &tag = song.tag;
@@ -104,6 +93,20 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 
 	const DatabaseSelection selection(name, true, filter);
 
+	GroupStatsMap map;
+	if (db.GetGroupStats(selection, group, map)) {
+		/* the database maintains an aggregate for this
+		   query */
+
+		if (group == TAG_NUM_OF_ITEM_TYPES)
+			PrintSearchStats(r, map.empty()
+					 ? SearchStats()
+					 : map.begin()->second);
+		else
+			Print(r, group, map);
+		return;
+	}
+
 	if (group == TAG_NUM_OF_ITEM_TYPES) {
 		/* no grouping */
 
@@ -119,8 +122,6 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 		/* group by the specified tag: store counts in a
 		   std::map */
 
-		TagCountMap map;
-
 		using namespace std::placeholders;
 		const auto f = std::bind(GroupCountVisitor, std::ref(map),
 					 group, _1);
@@ -19,8 +19,12 @@
 
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex;
+
+thread_local std::chrono::steady_clock::duration db_mutex_wait_time{};
 
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
+thread_local unsigned db_mutex_shared_count;
+thread_local bool db_private_tree;
 #endif
@@ -26,12 +26,28 @@
 #ifndef MPD_DB_LOCK_HXX
 #define MPD_DB_LOCK_HXX
 
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 #include "util/Compiler.h"
 
+#include <chrono>
+
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Read-only accesses (e.g. visiting the
+ * #Directory tree) may obtain a shared lock and run concurrently;
+ * modifications need the exclusive lock.
+ */
+extern SharedMutex db_mutex;
+
+/**
+ * The total time the current thread has spent blocking on
+ * #db_mutex.  Only contended acquisitions are measured; callers
+ * (e.g. the command dispatcher) sample this before and after an
+ * operation to find out how much of it was spent waiting for the
+ * lock.
+ */
+extern thread_local std::chrono::steady_clock::duration db_mutex_wait_time;
 
 #ifndef NDEBUG
 
@@ -40,27 +56,53 @@ extern Mutex db_mutex;
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * The number of shared locks held by the current thread.
+ */
+extern thread_local unsigned db_mutex_shared_count;
+
+/**
+ * Is the current thread building a tree which is not visible to
+ * other threads?  See #ScopeDatabasePrivateTree.
+ */
+extern thread_local bool db_private_tree;
+
+/**
+ * Does the current thread hold the exclusive database lock?
+ */
+gcc_pure
+static inline bool
+holding_db_exclusive_lock() noexcept
+{
+	return db_mutex_holder.IsInside() || db_private_tree;
+}
+
+/**
+ * Does the current thread hold the database lock (shared or
+ * exclusive)?
  */
 gcc_pure
 static inline bool
 holding_db_lock() noexcept
 {
-	return db_mutex_holder.IsInside();
+	return holding_db_exclusive_lock() || db_mutex_shared_count > 0;
 }
 
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock exclusively.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
 {
 	assert(!holding_db_lock());
 
-	db_mutex.lock();
+	if (!db_mutex.try_lock()) {
+		const auto start = std::chrono::steady_clock::now();
+		db_mutex.lock();
+		db_mutex_wait_time += std::chrono::steady_clock::now() - start;
+	}
 
 	assert(db_mutex_holder.IsNull());
 #ifndef NDEBUG
@@ -69,12 +111,12 @@ db_lock(void)
 }
 
 /**
- * Release the global database lock.
+ * Release the exclusive global database lock.
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::Null();
 #endif
@@ -82,6 +124,41 @@ db_unlock(void)
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain a shared global database lock.  This is needed before
+ * dereferencing a #song or #directory without modifying it.  It is
+ * not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	if (!db_mutex.try_lock_shared()) {
+		const auto start = std::chrono::steady_clock::now();
+		db_mutex.lock_shared();
+		db_mutex_wait_time += std::chrono::steady_clock::now() - start;
+	}
+
+#ifndef NDEBUG
+	++db_mutex_shared_count;
+#endif
+}
+
+/**
+ * Release a shared global database lock.
+ */
+static inline void
+db_unlock_shared(void)
+{
+#ifndef NDEBUG
+	assert(db_mutex_shared_count > 0);
+	--db_mutex_shared_count;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
 class ScopeDatabaseLock {
 	bool locked = true;
 
@@ -107,7 +184,60 @@ public:
 };
 
 /**
- * Unlock the database while in the current scope.
+ * Like #ScopeDatabaseLock, but obtains only a shared lock.
+ */
+class ScopeDatabaseSharedLock {
+	bool locked = true;
+
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		if (locked)
+			db_unlock_shared();
+	}
+
+	/**
+	 * Unlock the mutex now, making the destructor a no-op.
+	 */
+	void unlock() {
+		assert(locked);
+
+		db_unlock_shared();
+		locked = false;
+	}
+};
+
+/**
+ * Declares that the current thread is building a #Directory tree
+ * which is not (yet) visible to other threads, e.g. while loading the
+ * database file into a new root.  Such a tree may be modified without
+ * #db_mutex; this class only tells the debug assertions about it.
+ * The current thread must not lock #db_mutex in this scope.
+ */
+class ScopeDatabasePrivateTree {
+public:
+	ScopeDatabasePrivateTree() noexcept {
+#ifndef NDEBUG
+		assert(!holding_db_lock());
+		db_private_tree = true;
+#endif
+	}
+
+	~ScopeDatabasePrivateTree() noexcept {
+#ifndef NDEBUG
+		db_private_tree = false;
+#endif
+	}
+
+	ScopeDatabasePrivateTree(const ScopeDatabasePrivateTree &) = delete;
+	ScopeDatabasePrivateTree &operator=(const ScopeDatabasePrivateTree &) = delete;
+};
+
+/**
+ * Unlock the (exclusive) database lock while in the current scope.
  */
 class ScopeDatabaseUnlock {
 public:
@@ -120,4 +250,18 @@ public:
 	}
 };
 
+/**
+ * Unlock the shared database lock while in the current scope.
+ */
+class ScopeDatabaseSharedUnlock {
+public:
+	ScopeDatabaseSharedUnlock() {
+		db_unlock_shared();
+	}
+
+	~ScopeDatabaseSharedUnlock() {
+		db_lock_shared();
+	}
+};
+
 #endif
@@ -33,10 +33,18 @@
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "DatabaseError.hxx"
+#include "AsyncHandler.hxx"
+#include "client/ResponseCursor.hxx"
 #include "fs/Traits.hxx"
 #include "util/ChronoUtil.hxx"
 
+#include <algorithm>
 #include <functional>
+#include <string>
+#include <vector>
+
+#include <string.h>
 
 gcc_pure
 static const char *
@@ -165,6 +173,286 @@ db_selection_print(Response &r, Partition &partition,
 	db.Visit(selection, d, s, p);
 }
 
+/**
+ * Walks the database like a recursive Database::Visit() call, but
+ * visits only one directory (non-recursively) at a time, with a
+ * stack of directories still to be visited.  This keeps the output
+ * order of Directory::Walk(): the contents of a directory, then each
+ * child's "directory" line followed by its contents.
+ */
+class DatabasePrintCursor final : public ResponseCursor {
+	/**
+	 * Stop filling after this number of entries, but only at the
+	 * end of a directory.
+	 */
+	static constexpr unsigned MAX_ENTRIES = 1024;
+
+	struct PendingDirectory {
+		std::string uri;
+		std::chrono::system_clock::time_point mtime;
+
+		PendingDirectory(const LightDirectory &d)
+			:uri(d.GetPath()), mtime(d.mtime) {}
+	};
+
+	Partition &partition;
+
+	const bool full;
+
+	/**
+	 * The base URI of the selection.
+	 */
+	const std::string base;
+
+	/**
+	 * Has the first Fill() call visited #base already?
+	 */
+	bool started = false;
+
+	/**
+	 * Directories which have been announced by their parent but
+	 * not yet printed.  The next one is at the back.
+	 */
+	std::vector<PendingDirectory> stack;
+
+public:
+	DatabasePrintCursor(const char *_command, Partition &_partition,
+			    const char *_uri, bool _full)
+		:ResponseCursor(_command), partition(_partition),
+		 full(_full), base(_uri) {}
+
+	/* virtual methods from class ResponseCursor */
+	bool Fill(Response &r) override;
+
+private:
+	void PrintBase(Response &r, const Database &db);
+	unsigned VisitDirectory(Response &r, const Database &db,
+				const char *uri);
+};
+
+void
+DatabasePrintCursor::PrintBase(Response &r, const Database &db)
+{
+	/* a recursive Visit() on a non-root directory prints the
+	   directory itself first; find its attributes by listing
+	   the parent */
+
+	const char *slash = strrchr(base.c_str(), '/');
+	const std::string parent = slash != nullptr
+		? std::string(base.c_str(), slash)
+		: std::string();
+
+	const auto print_directory = full
+		? PrintDirectoryFull
+		: PrintDirectoryBrief;
+
+	const DatabaseSelection selection(parent.c_str(), false);
+	db.Visit(selection, [this, &r, print_directory](const LightDirectory &d){
+			if (base == d.GetPath())
+				print_directory(r, false, d);
+		}, VisitSong());
+}
+
+unsigned
+DatabasePrintCursor::VisitDirectory(Response &r, const Database &db,
+				    const char *uri)
+{
+	unsigned n = 0;
+	std::vector<PendingDirectory> children;
+
+	const auto d = [&children](const LightDirectory &directory){
+		children.emplace_back(directory);
+	};
+	const auto s = [this, &r, &n](const LightSong &song){
+		if (full)
+			PrintSongFull(r, false, song);
+		else
+			PrintSongBrief(r, false, song);
+		++n;
+	};
+	const auto p = [this, &r, &n](const PlaylistInfo &playlist,
+				      const LightDirectory &directory){
+		if (full)
+			PrintPlaylistFull(r, false, playlist, directory);
+		else
+			PrintPlaylistBrief(r, false, playlist, directory);
+		++n;
+	};
+
+	const DatabaseSelection selection(uri, false);
+
+	try {
+		db.Visit(selection, d, s, p);
+	} catch (const DatabaseError &e) {
+		if (e.GetCode() != DatabaseErrorCode::NOT_FOUND ||
+		    *uri == 0 || uri == base)
+			throw;
+
+		/* the directory has been deleted since its parent was
+		   visited; skip it */
+		return 0;
+	}
+
+	stack.insert(stack.end(),
+		     std::make_move_iterator(children.rbegin()),
+		     std::make_move_iterator(children.rend()));
+	return n + children.size();
+}
+
+bool
+DatabasePrintCursor::Fill(Response &r)
+{
+	const Database &db = partition.GetDatabaseOrThrow();
+
+	unsigned n = 0;
+
+	if (!started) {
+		started = true;
+
+		if (!base.empty())
+			PrintBase(r, db);
+
+		n += VisitDirectory(r, db, base.c_str());
+	}
+
+	while (!stack.empty() && n < MAX_ENTRIES) {
+		const PendingDirectory directory = std::move(stack.back());
+		stack.pop_back();
+
+		const LightDirectory light(directory.uri.c_str(),
+					   directory.mtime);
+		if (full)
+			PrintDirectoryFull(r, false, light);
+		else
+			PrintDirectoryBrief(r, false, light);
+		++n;
+
+		n += VisitDirectory(r, db, directory.uri.c_str());
+	}
+
+	return !stack.empty();
+}
+
+std::unique_ptr<ResponseCursor>
+db_selection_print_cursor(Partition &partition, const char *command,
+			  const char *uri, bool full)
+{
+	return std::unique_ptr<ResponseCursor>(new DatabasePrintCursor(command,
+								       partition,
+								       uri,
+								       full));
+}
+
+/**
+ * Prints the songs of a Database::VisitSongsAsync() call, after it
+ * has finished.  Until then, the cursor is suspended, and the
+ * #Client does not block the main loop.
+ */
+class DatabaseAsyncPrintCursor final
+	: public ResponseCursor, DatabaseAsyncHandler {
+
+	/**
+	 * Stop filling after this number of songs.
+	 */
+	static constexpr std::size_t MAX_SONGS = 1024;
+
+	const Database &db;
+
+	const bool full;
+
+	/**
+	 * Is the query still running?
+	 */
+	bool running = false;
+
+	std::vector<DetachedSong> songs;
+
+	/**
+	 * The index of the next song in #songs to be printed.
+	 */
+	std::size_t position = 0;
+
+	std::exception_ptr error;
+
+public:
+	DatabaseAsyncPrintCursor(const char *_command, const Database &_db,
+				 bool _full) noexcept
+		:ResponseCursor(_command), db(_db), full(_full) {}
+
+	~DatabaseAsyncPrintCursor() noexcept override {
+		if (running)
+			db.CancelAsync(*this);
+	}
+
+	bool Start(const DatabaseSelection &selection) {
+		if (!db.VisitSongsAsync(selection, *this))
+			return false;
+
+		running = true;
+		Suspend();
+		return true;
+	}
+
+	/* virtual methods from class ResponseCursor */
+	bool Fill(Response &r) override;
+
+private:
+	/* virtual methods from class DatabaseAsyncHandler */
+	void OnDatabaseAsyncSongs(std::vector<DetachedSong> &&_songs) noexcept override {
+		running = false;
+		songs = std::move(_songs);
+		Resume();
+	}
+
+	void OnDatabaseAsyncError(std::exception_ptr _error) noexcept override {
+		running = false;
+		error = std::move(_error);
+		Resume();
+	}
+};
+
+bool
+DatabaseAsyncPrintCursor::Fill(Response &r)
+{
+	assert(!running);
+
+	if (error)
+		std::rethrow_exception(error);
+
+	const std::size_t end = std::min(songs.size(), position + MAX_SONGS);
+	for (; position < end; ++position) {
+		const auto &song = songs[position];
+
+		if (full)
+			song_print_info(r, song);
+		else
+			song_print_uri(r, song);
+
+		if (song.GetTag().has_playlist)
+			/* this song file has an embedded CUE sheet */
+			print_playlist_in_directory(r, false,
+						    (const char *)nullptr,
+						    song.GetURI());
+	}
+
+	return position < songs.size();
+}
+
+std::unique_ptr<ResponseCursor>
+db_selection_print_async_cursor(Partition &partition, const char *command,
+				const DatabaseSelection &selection,
+				bool full)
+{
+	std::unique_ptr<DatabaseAsyncPrintCursor>
+		cursor(new DatabaseAsyncPrintCursor(command,
+						    partition.GetDatabaseOrThrow(),
+						    full));
+	if (!cursor->Start(selection))
+		return nullptr;
+
+	return cursor;
+}
+
 static void
 PrintSongURIVisitor(Response &r, const LightSong &song) noexcept
 {
@@ -20,6 +20,8 @@
 #ifndef MPD_DB_PRINT_H
 #define MPD_DB_PRINT_H
 
+#include <memory>
+
 #include <stdint.h>
 
 enum TagType : uint8_t;
@@ -29,6 +31,7 @@ struct DatabaseSelection;
 struct RangeArg;
 struct Partition;
 class Response;
+class ResponseCursor;
 
 /**
  * @param full print attributes/tags
@@ -39,6 +42,33 @@ db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
 		   bool full, bool base);
 
+/**
+ * Create a #ResponseCursor which prints the same as
+ * db_selection_print() with a recursive selection without filter,
+ * but one directory at a time.  The database is not locked between
+ * two portions; if it gets modified meanwhile, the response reflects
+ * the new state of the directories which have not yet been printed.
+ *
+ * @param full print attributes/tags
+ */
+std::unique_ptr<ResponseCursor>
+db_selection_print_cursor(Partition &partition, const char *command,
+			  const char *uri, bool full);
+
+/**
+ * Create a #ResponseCursor which prints the songs of a recursive
+ * selection like db_selection_print(), but lets the database
+ * evaluate the selection asynchronously (see
+ * Database::VisitSongsAsync()).
+ *
+ * @return nullptr if the database does not support this; the
+ * caller shall use db_selection_print() instead
+ */
+std::unique_ptr<ResponseCursor>
+db_selection_print_async_cursor(Partition &partition, const char *command,
+				const DatabaseSelection &selection,
+				bool full);
+
 void
 PrintSongUris(Response &r, Partition &partition,
 	      const SongFilter *filter);
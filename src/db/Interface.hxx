@@ -22,6 +22,7 @@
 
 #include "Visitor.hxx"
 #include "tag/Type.h"
+#include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <chrono>
@@ -31,8 +32,10 @@
 
 struct DatabasePlugin;
 struct DatabaseStats;
+struct SearchStats;
 struct DatabaseSelection;
 struct LightSong;
+class DatabaseAsyncHandler;
 class TagMask;
 
 class Database {
@@ -84,6 +87,41 @@ public:
 	 */
 	virtual void ReturnSong(const LightSong *song) const noexcept = 0;
 
+	/**
+	 * Look up many songs at once.  The default implementation
+	 * calls GetSong() for each URI, but implementations may do
+	 * better, e.g. by locking and walking the directory tree only
+	 * once.
+	 *
+	 * Songs which are not found are skipped silently.
+	 *
+	 * @param visit invoked for each song which was found, with
+	 * its index in #uris; it must not call back into this object
+	 */
+	virtual void GetSongs(ConstBuffer<const char *> uris,
+			      const VisitSongIndex &visit) const {
+		for (std::size_t i = 0; i < uris.size; ++i) {
+			const LightSong *song;
+			try {
+				song = GetSong(uris[i]);
+			} catch (...) {
+				continue;
+			}
+
+			if (song == nullptr)
+				continue;
+
+			try {
+				visit(i, *song);
+			} catch (...) {
+				ReturnSong(song);
+				throw;
+			}
+
+			ReturnSong(song);
+		}
+	}
+
 	/**
 	 * Visit the selected entities.
 	 *
@@ -105,6 +143,29 @@ public:
 		return Visit(selection, VisitDirectory(), visit_song);
 	}
 
+	/**
+	 * Start visiting the songs of a recursive selection without
+	 * blocking the caller, e.g. because the implementation waits
+	 * for the network.  The selection is copied, so the caller
+	 * may free it (and its filter) right after this call.  The
+	 * result is passed to the handler in the main thread, unless
+	 * CancelAsync() is called first.
+	 *
+	 * @return false if this selection cannot be visited
+	 * asynchronously; the caller shall use Visit() instead
+	 */
+	virtual bool VisitSongsAsync(gcc_unused const DatabaseSelection &selection,
+				     gcc_unused DatabaseAsyncHandler &handler) const {
+		return false;
+	}
+
+	/**
+	 * Cancel all VisitSongsAsync() calls for the given handler;
+	 * after returning, it will not be invoked anymore.
+	 */
+	virtual void CancelAsync(gcc_unused DatabaseAsyncHandler &handler) const noexcept {
+	}
+
 	/**
 	 * Collect unique values of the given tag type.
 	 *
@@ -119,6 +180,24 @@ public:
 	 */
 	virtual DatabaseStats GetStats(const DatabaseSelection &selection) const = 0;
 
+	/**
+	 * Count the selected songs, grouped by the values of the given
+	 * tag (see VisitTagWithFallbackOrEmpty()), from aggregates
+	 * maintained by the database.  Without a group tag
+	 * (#TAG_NUM_OF_ITEM_TYPES), all songs are counted with the
+	 * empty string as key.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if this database cannot count the selection
+	 * this way; the caller must then visit it
+	 */
+	virtual bool GetGroupStats(gcc_unused const DatabaseSelection &selection,
+				   gcc_unused TagType group,
+				   gcc_unused std::map<std::string, SearchStats> &result) const {
+		return false;
+	}
+
 	/**
 	 * Update the database.
 	 *
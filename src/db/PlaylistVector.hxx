@@ -39,6 +39,7 @@ public:
 	using std::list<PlaylistInfo>::end;
 	using std::list<PlaylistInfo>::push_back;
 	using std::list<PlaylistInfo>::erase;
+	using std::list<PlaylistInfo>::clear;
 
 	/**
 	 * Caller must lock the #db_mutex.
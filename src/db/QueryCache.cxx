@@ -0,0 +1,84 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "QueryCache.hxx"
+
+#include <assert.h>
+
+const std::string *
+DatabaseQueryCache::Get(const std::string &key) noexcept
+{
+	auto i = map.find(key);
+	if (i == map.end()) {
+		++misses;
+		return nullptr;
+	}
+
+	++hits;
+
+	/* move to the front of the LRU list */
+	list.splice(list.begin(), list, i->second);
+	return &i->second->second;
+}
+
+void
+DatabaseQueryCache::Put(std::string &&key, std::string &&value) noexcept
+try {
+	const size_t item_size = key.length() + value.length();
+	if (item_size > max_size / 8)
+		/* don't let a single huge response flush the whole
+		   cache */
+		return;
+
+	auto old = map.find(key);
+	if (old != map.end()) {
+		size -= old->first.length() + old->second->second.length();
+		list.erase(old->second);
+		map.erase(old);
+	}
+
+	while (size + item_size > max_size)
+		EvictLast();
+
+	list.emplace_front(key, std::move(value));
+	map.emplace(std::move(key), list.begin());
+	size += item_size;
+} catch (...) {
+	/* out of memory: a cache is allowed to fail */
+	Clear();
+}
+
+void
+DatabaseQueryCache::EvictLast() noexcept
+{
+	assert(!list.empty());
+
+	auto &last = list.back();
+	size -= last.first.length() + last.second.length();
+	map.erase(last.first);
+	list.pop_back();
+}
+
+void
+DatabaseQueryCache::Clear() noexcept
+{
+	map.clear();
+	list.clear();
+	size = 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DB_QUERY_CACHE_HXX
+#define MPD_DB_QUERY_CACHE_HXX
+
+#include "util/Compiler.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <stddef.h>
+
+/**
+ * A cache for the responses of database queries such as "find",
+ * "list" and "count".  Clients tend to repeat the same queries over
+ * and over, and each one visits the whole database.
+ *
+ * The key is a normalized description of the query, the value is
+ * the response text.  The cache is
+ * limited by the total size of all responses; the least recently
+ * used entries are evicted first.  It must be cleared whenever the
+ * database is modified.
+ *
+ * This class is not thread-safe; it is only used in the main thread.
+ */
+class DatabaseQueryCache {
+	typedef std::list<std::pair<const std::string, std::string>> List;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List list;
+
+	std::unordered_map<std::string, List::iterator> map;
+
+	const size_t max_size;
+
+	/**
+	 * The sum of all key and value sizes.
+	 */
+	size_t size = 0;
+
+	unsigned hits = 0, misses = 0;
+
+public:
+	explicit DatabaseQueryCache(size_t _max_size) noexcept
+		:max_size(_max_size) {}
+
+	DatabaseQueryCache(const DatabaseQueryCache &) = delete;
+	DatabaseQueryCache &operator=(const DatabaseQueryCache &) = delete;
+
+	/**
+	 * Look up a cached response and update the hit/miss counters.
+	 *
+	 * @return the response or nullptr if there is no such entry;
+	 * the pointer is valid until the cache is modified
+	 */
+	const std::string *Get(const std::string &key) noexcept;
+
+	/**
+	 * Add a response to the cache.  Responses which are too large
+	 * are silently ignored.
+	 */
+	void Put(std::string &&key, std::string &&value) noexcept;
+
+	/**
+	 * Discard all entries.  The counters are preserved.
+	 */
+	void Clear() noexcept;
+
+	/**
+	 * Returns the sum of all key and value sizes.
+	 */
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	unsigned GetHits() const noexcept {
+		return hits;
+	}
+
+	unsigned GetMisses() const noexcept {
+		return misses;
+	}
+
+private:
+	void EvictLast() noexcept;
+};
+
+#endif
@@ -19,16 +19,20 @@
 
 #include "Selection.hxx"
 #include "song/Filter.hxx"
+#include "util/UriUtil.hxx"
 
 DatabaseSelection::DatabaseSelection(const char *_uri, bool _recursive,
 				     const SongFilter *_filter) noexcept
 	:uri(_uri), filter(_filter), recursive(_recursive)
 {
 	/* optimization: if the caller didn't specify a base URI, pick
-	   the one from SongFilter */
-	if (uri.empty() && filter != nullptr) {
+	   the one from SongFilter; for a recursive selection, a more
+	   specific "base" narrows the subtree to be visited */
+	if (filter != nullptr) {
 		auto base = filter->GetBase();
-		if (base != nullptr)
+		if (base != nullptr &&
+		    (uri.empty() ||
+		     (recursive && uri_is_child(uri.c_str(), base))))
 			uri = base;
 	}
 }
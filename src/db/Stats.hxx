@@ -22,6 +22,9 @@
 
 #include "Chrono.hxx"
 
+#include <map>
+#include <string>
+
 struct DatabaseStats {
 	/**
 	 * Number of songs.
@@ -50,4 +53,21 @@ struct DatabaseStats {
 	}
 };
 
+/**
+ * The numbers printed by the "count" command.
+ */
+struct SearchStats {
+	unsigned n_songs;
+	std::chrono::duration<std::uint64_t, SongTime::period> total_duration;
+
+	constexpr SearchStats()
+		:n_songs(0), total_duration(0) {}
+};
+
+/**
+ * Maps the values of the "count ... group" tag to the #SearchStats
+ * of the songs containing them.
+ */
+typedef std::map<std::string, SearchStats> GroupStatsMap;
+
 #endif
@@ -21,37 +21,156 @@
 #include "Interface.hxx"
 #include "song/LightSong.hxx"
 #include "tag/VisitFallback.hxx"
+#include "tag/Pool.hxx"
+#include "tag/Item.hxx"
+#include "util/StringView.hxx"
+#include "util/StringHash.hxx"
 
-static void
-CollectTags(std::set<std::string> &result,
-	    const Tag &tag,
-	    TagType tag_type) noexcept
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <string.h>
+
+namespace {
+
+/**
+ * Collects unique tag values in hash tables.  The strings are
+ * interned in the #tag_pool instead of being copied to a
+ * std::string for each visited song; converting and sorting happens
+ * only once, in Finish().
+ */
+class UniqueTagCollector {
+	/**
+	 * Maps TagItem::value to the #tag_pool item; each item is
+	 * referenced exactly once.
+	 */
+	typedef std::unordered_map<const char *, TagItem *,
+				   StringHash, StringEqual> ValueSet;
+
+	struct Group {
+		TagItem *name;
+		ValueSet values;
+
+		explicit Group(TagItem *_name) noexcept:name(_name) {}
+	};
+
+	typedef std::unordered_map<const char *, Group,
+				   StringHash, StringEqual> GroupMap;
+
+	const TagType tag_type, group;
+
+	GroupMap groups;
+
+public:
+	UniqueTagCollector(TagType _tag_type, TagType _group) noexcept
+		:tag_type(_tag_type), group(_group) {}
+
+	~UniqueTagCollector() noexcept {
+		for (const auto &i : groups) {
+			for (const auto &j : i.second.values)
+				tag_pool_put_item(j.second);
+			tag_pool_put_item(i.second.name);
+		}
+	}
+
+	UniqueTagCollector(const UniqueTagCollector &) = delete;
+	UniqueTagCollector &operator=(const UniqueTagCollector &) = delete;
+
+	void Add(const Tag &tag) {
+		VisitTagWithFallbackOrEmpty(tag, group, [&](const char *group_name){
+				CollectTags(GetGroup(group_name), tag);
+			});
+	}
+
+	std::map<std::string, std::set<std::string>> Finish() const;
+
+private:
+	/**
+	 * Obtain a #tag_pool item for the given value.  The #TagType
+	 * of the item is the requested one, even if the value came
+	 * from a fallback tag.
+	 */
+	static TagItem *Intern(TagType type, const char *value) noexcept {
+		return tag_pool_get_item(type, StringView(value));
+	}
+
+	ValueSet &GetGroup(const char *group_name) {
+		auto i = groups.find(group_name);
+		if (i == groups.end()) {
+			TagItem *item = Intern(group, group_name);
+			i = groups.emplace(item->value, Group(item)).first;
+		}
+
+		return i->second.values;
+	}
+
+	void CollectTags(ValueSet &result, const Tag &tag) {
+		VisitTagWithFallbackOrEmpty(tag, tag_type, [&](const char *value){
+				if (result.find(value) == result.end()) {
+					TagItem *item = Intern(tag_type, value);
+					result.emplace(item->value, item);
+				}
+			});
+	}
+};
+
+gcc_pure
+static bool
+CompareStrings(const char *a, const char *b) noexcept
 {
-	VisitTagWithFallbackOrEmpty(tag, tag_type, [&result](const char *value){
-			result.emplace(value);
-		});
+	return strcmp(a, b) < 0;
 }
 
-static void
-CollectGroupTags(std::map<std::string, std::set<std::string>> &result,
-		 const Tag &tag,
-		 TagType tag_type,
-		 TagType group) noexcept
+/**
+ * Return the keys of the given hash map, sorted.
+ */
+template<typename M>
+static std::vector<const char *>
+SortedKeys(const M &src)
 {
-	VisitTagWithFallbackOrEmpty(tag, group, [&](const char *group_name){
-			CollectTags(result[group_name], tag, tag_type);
-		});
+	std::vector<const char *> result;
+	result.reserve(src.size());
+	for (const auto &i : src)
+		result.push_back(i.first);
+
+	std::sort(result.begin(), result.end(), CompareStrings);
+	return result;
+}
+
+std::map<std::string, std::set<std::string>>
+UniqueTagCollector::Finish() const
+{
+	std::map<std::string, std::set<std::string>> result;
+
+	/* the keys are sorted already, so each emplace_hint() appends
+	   at the end in constant time */
+
+	for (const char *name : SortedKeys(groups)) {
+		auto &dest = result.emplace_hint(result.end(),
+						 std::piecewise_construct,
+						 std::forward_as_tuple(name),
+						 std::forward_as_tuple())->second;
+
+		for (const char *value : SortedKeys(groups.find(name)->second.values))
+			dest.emplace_hint(dest.end(), value);
+	}
+
+	return result;
 }
 
+} // namespace
+
 std::map<std::string, std::set<std::string>>
 CollectUniqueTags(const Database &db, const DatabaseSelection &selection,
 		  TagType tag_type, TagType group)
 {
-	std::map<std::string, std::set<std::string>> result;
+	UniqueTagCollector collector(tag_type, group);
 
-	db.Visit(selection, [&result, tag_type, group](const LightSong &song){
-			CollectGroupTags(result, song.tag, tag_type, group);
+	db.Visit(selection, [&collector](const LightSong &song){
+			collector.Add(song.tag);
 		});
 
-	return result;
+	return collector.Finish();
 }
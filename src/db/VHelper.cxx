@@ -21,6 +21,8 @@
 #include "song/LightSong.hxx"
 #include "song/Filter.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,7 +43,7 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(const DatabaseSelection &_selection
 
 		original_visit_song = std::move(visit_song);
 		visit_song = [this](const auto &song){
-			songs.emplace_back(song);
+			AddSorted(song);
 		};
 	} else if (selection.window != RangeArg::All()) {
 		original_visit_song = std::move(visit_song);
@@ -86,6 +88,85 @@ CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
 	}
 }
 
+gcc_pure
+static bool
+CompareSongs(TagType sort, bool descending,
+	     const Tag &a_tag, std::chrono::system_clock::time_point a_mtime,
+	     const Tag &b_tag, std::chrono::system_clock::time_point b_mtime) noexcept
+{
+	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
+		return descending
+			? a_mtime > b_mtime
+			: a_mtime < b_mtime;
+
+	return CompareTags(sort, descending, a_tag, b_tag);
+}
+
+bool
+DatabaseVisitorHelper::Less(const SortItem &a,
+			    const SortItem &b) const noexcept
+{
+	const auto sort = selection.sort;
+	const auto descending = selection.descending;
+
+	if (CompareSongs(sort, descending,
+			 a.song.GetTag(), a.song.GetLastModified(),
+			 b.song.GetTag(), b.song.GetLastModified()))
+		return true;
+
+	if (CompareSongs(sort, descending,
+			 b.song.GetTag(), b.song.GetLastModified(),
+			 a.song.GetTag(), a.song.GetLastModified()))
+		return false;
+
+	/* equal: keep the original order */
+	return a.position < b.position;
+}
+
+void
+DatabaseVisitorHelper::AddSorted(const LightSong &song)
+{
+	const unsigned limit = selection.window.end;
+	if (selection.window.start >= limit)
+		/* empty window */
+		return;
+
+	if (pruned) {
+		/* the new song comes after all collected songs in the
+		   original order, so it is only a candidate if it
+		   sorts before the last one which is still in the
+		   window; check that before copying it */
+		const auto &last = songs[limit - 1].song;
+		if (!CompareSongs(selection.sort, selection.descending,
+				  song.tag, song.mtime,
+				  last.GetTag(), last.GetLastModified()))
+			return;
+	}
+
+	songs.emplace_back(song, counter++);
+
+	/* prune only after collecting "limit" more songs, to keep
+	   the amortized cost linear */
+	if (limit < RangeArg::All().end && songs.size() >= 2 * size_t(limit))
+		Prune();
+}
+
+void
+DatabaseVisitorHelper::Prune() noexcept
+{
+	const unsigned limit = selection.window.end;
+	assert(limit > 0);
+	assert(songs.size() >= limit);
+
+	const auto nth = std::next(songs.begin(), limit - 1);
+	std::nth_element(songs.begin(), nth, songs.end(),
+			 [this](const SortItem &a, const SortItem &b){
+				 return Less(a, b);
+			 });
+	songs.erase(std::next(nth), songs.end());
+	pruned = true;
+}
+
 void
 DatabaseVisitorHelper::Commit()
 {
@@ -95,31 +176,25 @@ DatabaseVisitorHelper::Commit()
 
 	assert(original_visit_song);
 
-	/* sort the song collection */
-	const auto sort = selection.sort;
-	const auto descending = selection.descending;
+	if (selection.window.end == 0 ||
+	    selection.window.start >= selection.window.end)
+		return;
 
-	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetLastModified() > b.GetLastModified()
-						 : a.GetLastModified() < b.GetLastModified();
-				 });
-	else
-		std::stable_sort(songs.begin(), songs.end(),
-				 [sort, descending](const DetachedSong &a,
-						    const DetachedSong &b){
-					 return CompareTags(sort, descending,
-							    a.GetTag(),
-							    b.GetTag());
-				 });
+	const auto less = [this](const SortItem &a, const SortItem &b){
+		return Less(a, b);
+	};
 
-	/* apply the "window" */
-	if (selection.window.end < songs.size())
-		songs.erase(std::next(songs.begin(), selection.window.end),
-			    songs.end());
+	/* sort only what may be part of the window; thanks to the
+	   "position" tie breaker, this is a stable sort */
+	if (selection.window.end < songs.size()) {
+		const auto end = std::next(songs.begin(),
+					   selection.window.end);
+		std::partial_sort(songs.begin(), end, songs.end(), less);
+		songs.erase(end, songs.end());
+	} else
+		std::sort(songs.begin(), songs.end(), less);
 
+	/* apply the "window" */
 	if (selection.window.start >= songs.size())
 		return;
 
@@ -127,6 +202,6 @@ DatabaseVisitorHelper::Commit()
 		    std::next(songs.begin(), selection.window.start));
 
 	/* now pass all songs to the original visitor callback */
-	for (const auto &song : songs)
-		original_visit_song((LightSong)song);
+	for (const auto &i : songs)
+		original_visit_song((LightSong)i.song);
 }
@@ -40,12 +40,26 @@ class DetachedSong;
 class DatabaseVisitorHelper {
 	const DatabaseSelection selection;
 
+	struct SortItem {
+		DetachedSong song;
+
+		/**
+		 * The position in the original order; used to keep
+		 * the sort stable.
+		 */
+		unsigned position;
+
+		SortItem(const LightSong &_song, unsigned _position)
+			:song(_song), position(_position) {}
+	};
+
 	/**
 	 * If the plugin can't sort, then this container will collect
-	 * all songs, sort them and report them to the visitor in
-	 * Commit().
+	 * songs, sort them and report them to the visitor in
+	 * Commit().  If the "window" has an end, only the best
+	 * candidates for the window are kept (see Prune()).
 	 */
-	std::vector<DetachedSong> songs;
+	std::vector<SortItem> songs;
 
 	VisitSong original_visit_song;
 
@@ -54,6 +68,13 @@ class DatabaseVisitorHelper {
 	 */
 	unsigned counter = 0;
 
+	/**
+	 * Has Prune() been called?  Then songs[window.end-1] is the
+	 * last song which can still be part of the window, and new
+	 * songs sorting after it can be discarded right away.
+	 */
+	bool pruned = false;
+
 public:
 	/**
 	 * @param selection a #DatabaseSelection instance with only
@@ -66,6 +87,18 @@ public:
 	~DatabaseVisitorHelper() noexcept;
 
 	void Commit();
+
+private:
+	void AddSorted(const LightSong &song);
+
+	/**
+	 * Discard all songs which cannot be part of the window,
+	 * i.e. keep only the first window.end songs in sort order.
+	 */
+	void Prune() noexcept;
+
+	gcc_pure
+	bool Less(const SortItem &a, const SortItem &b) const noexcept;
 };
 
 #endif
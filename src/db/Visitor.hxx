@@ -22,6 +22,8 @@
 
 #include <functional>
 
+#include <cstddef>
+
 struct LightDirectory;
 struct LightSong;
 struct PlaylistInfo;
@@ -34,4 +36,11 @@ typedef std::function<void(const PlaylistInfo &,
 
 typedef std::function<void(const Tag &)> VisitTag;
 
+/**
+ * A #VisitSong variant which also receives the index of the song in
+ * the request; see Database::GetSongs().
+ */
+typedef std::function<void(std::size_t,
+			   const LightSong &)> VisitSongIndex;
+
 #endif
@@ -26,23 +26,43 @@
 #include "db/DatabaseError.hxx"
 #include "db/PlaylistInfo.hxx"
 #include "db/LightDirectory.hxx"
+#include "db/AsyncHandler.hxx"
 #include "song/LightSong.hxx"
 #include "db/Stats.hxx"
 #include "song/Filter.hxx"
 #include "song/UriSongFilter.hxx"
 #include "song/BaseSongFilter.hxx"
 #include "song/TagSongFilter.hxx"
+#include "song/ISongFilter.hxx"
 #include "util/Compiler.h"
 #include "config/Block.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
 #include "tag/Mask.hxx"
 #include "tag/ParseName.hxx"
+#include "TagSave.hxx"
+#include "SongSave.hxx"
+#include "song/DetachedSong.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/ChronoUtil.hxx"
+#include "util/StringCompare.hxx"
+#include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/RuntimeError.hxx"
 #include "protocol/Ack.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/IdleMonitor.hxx"
+#include "event/MaskMonitor.hxx"
+#include "event/AsyncResolver.hxx"
+#include "net/ResolverCache.hxx"
+#include "net/ToString.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
 #include "Log.hxx"
 
 #include <mpd/client.h>
@@ -51,6 +71,19 @@
 #include <cassert>
 #include <string>
 #include <list>
+#include <map>
+#include <set>
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+static constexpr Domain proxy_db_domain("proxy_db");
 
 class LibmpdclientError final : public std::runtime_error {
 	enum mpd_error code;
@@ -69,6 +102,12 @@ class ProxySong : public LightSong {
 
 public:
 	explicit ProxySong(const mpd_song *song);
+
+	virtual ~ProxySong() noexcept = default;
+
+protected:
+	ProxySong(const char *_uri, const Tag &_tag)
+		:LightSong(_uri, tag2), tag2(_tag) {}
 };
 
 class AllocatedProxySong : public ProxySong {
@@ -78,12 +117,116 @@ public:
 	explicit AllocatedProxySong(mpd_song *_song)
 		:ProxySong(_song), song(_song) {}
 
-	~AllocatedProxySong() {
+	~AllocatedProxySong() noexcept override {
 		mpd_song_free(song);
 	}
 };
 
-class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
+/**
+ * A song in the local replica of the remote database.  The URI is
+ * the key of #ReplicaMap and is not stored here.
+ */
+struct ReplicaSong {
+	Tag tag;
+
+	std::chrono::system_clock::time_point mtime =
+		std::chrono::system_clock::time_point::min();
+
+	SongTime start_time = SongTime::zero(), end_time = SongTime::zero();
+
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	ReplicaSong() = default;
+
+	explicit ReplicaSong(const LightSong &src)
+		:tag(src.tag), mtime(src.mtime),
+		 start_time(src.start_time), end_time(src.end_time),
+		 audio_format(src.audio_format) {}
+
+	ReplicaSong(DetachedSong &&src, AudioFormat _audio_format) noexcept
+		:tag(std::move(src.WritableTag())),
+		 mtime(src.GetLastModified()),
+		 start_time(src.GetStartTime()), end_time(src.GetEndTime()),
+		 audio_format(_audio_format) {}
+
+	void CopyTo(LightSong &dest) const noexcept {
+		dest.mtime = mtime;
+		dest.start_time = start_time;
+		dest.end_time = end_time;
+		dest.audio_format = audio_format;
+	}
+};
+
+/**
+ * Sorted by URI, so all songs below a directory are adjacent.
+ */
+using ReplicaMap = std::map<std::string, ReplicaSong>;
+
+/**
+ * Holds the URI for #ReplicaProxySong; this is a separate base
+ * class so it gets constructed before #LightSong.
+ */
+struct ReplicaSongUri {
+	const std::string value;
+};
+
+/**
+ * A copy of a #ReplicaSong returned by ProxyDatabase::GetSong().
+ * It owns all of its data, so it survives a refresh of the
+ * replica.
+ */
+class ReplicaProxySong final : ReplicaSongUri, public ProxySong {
+public:
+	ReplicaProxySong(const std::string &_uri, const ReplicaSong &src)
+		:ReplicaSongUri{_uri},
+		 ProxySong(ReplicaSongUri::value.c_str(), src.tag) {
+		src.CopyTo(*this);
+	}
+};
+
+/**
+ * A query submitted by ProxyDatabase::VisitSongsAsync(), to be
+ * executed by the query thread.
+ */
+struct ProxyQuery {
+	/**
+	 * The handler which receives the result.  This is set to
+	 * nullptr by ProxyDatabase::CancelAsync().  Only accessed in
+	 * the main thread.
+	 */
+	DatabaseAsyncHandler *handler;
+
+	std::string uri;
+
+	/**
+	 * The filter as MPD 0.21 "expression"; empty if there is no
+	 * filter.
+	 */
+	std::string expression;
+
+	/**
+	 * A copy of the filter, which is applied locally to the
+	 * result; nullptr if there is no filter.
+	 */
+	ISongFilterPtr filter;
+
+	bool exact;
+
+	TagType sort;
+	bool descending;
+
+	RangeArg window;
+
+	std::vector<DetachedSong> songs;
+
+	std::exception_ptr error;
+
+	ProxyQuery(DatabaseAsyncHandler &_handler,
+		   const DatabaseSelection &selection) noexcept;
+};
+
+class ProxyDatabase final
+	: public Database, SocketMonitor, IdleMonitor, AsyncResolverHandler {
 	DatabaseListener &listener;
 
 	const std::string host;
@@ -91,7 +234,14 @@ class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	const unsigned port;
 	const bool keepalive;
 
-	struct mpd_connection *connection;
+	struct mpd_connection *connection = nullptr;
+
+	/**
+	 * Resolves #host in a worker thread before the first
+	 * connection attempt, so Open() does not block the
+	 * #EventLoop in getaddrinfo().
+	 */
+	AsyncResolver resolver;
 
 	/* this is mutable because GetStats() must be "const" */
 	mutable std::chrono::system_clock::time_point update_stamp;
@@ -108,6 +258,81 @@ class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	 */
 	bool is_idle;
 
+	/**
+	 * Keep a local copy of all songs of the remote database?
+	 */
+	const bool replica_enabled;
+
+	/**
+	 * If not "nulled", then the replica is saved to this file
+	 * and loaded from it on startup.
+	 */
+	const AllocatedPath replica_path;
+
+	/**
+	 * The local copy of all songs.  It is only used if
+	 * #replica_valid is set.
+	 */
+	ReplicaMap replica;
+
+	/**
+	 * The "db_update" time stamp of the remote MPD at the time
+	 * #replica was last refreshed.
+	 */
+	time_t replica_stamp = 0;
+
+	/**
+	 * Does #replica contain a full copy of the remote database
+	 * (as of #replica_stamp)?
+	 */
+	bool replica_valid = false;
+
+	/**
+	 * This thread executes the queries submitted by
+	 * VisitSongsAsync() on its own connection, so the main
+	 * thread does not block.  All clients share this connection;
+	 * the queries are executed one after another.
+	 */
+	Thread query_thread;
+
+	/**
+	 * The connection used by #query_thread.  It is established
+	 * on demand and only accessed by the query thread.
+	 */
+	struct mpd_connection *query_connection = nullptr;
+
+	/**
+	 * Notifies the main thread about #finished_queries.
+	 */
+	MaskMonitor query_monitor;
+
+	/**
+	 * Protects #pending_queries, #running_query,
+	 * #finished_queries and #query_quit.
+	 */
+	Mutex query_mutex;
+	Cond query_cond;
+
+	/**
+	 * Queries which have not yet been started by
+	 * #query_thread.
+	 */
+	std::list<ProxyQuery> pending_queries;
+
+	/**
+	 * The query which is currently being executed by
+	 * #query_thread (at most one).
+	 */
+	std::list<ProxyQuery> running_query;
+
+	/**
+	 * Queries whose result has not yet been passed to the
+	 * handler.
+	 */
+	std::list<ProxyQuery> finished_queries;
+
+	bool query_quit = false;
+
 public:
 	ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener,
 		      const ConfigBlock &block);
@@ -131,6 +356,10 @@ public:
 								       TagType tag_type,
 								       TagType group) const override;
 
+	bool VisitSongsAsync(const DatabaseSelection &selection,
+			     DatabaseAsyncHandler &handler) const override;
+	void CancelAsync(DatabaseAsyncHandler &handler) const noexcept override;
+
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
 	unsigned Update(const char *uri_utf8, bool discard) override;
@@ -146,13 +375,128 @@ private:
 
 	void Disconnect() noexcept;
 
+	/**
+	 * Load #replica from #replica_path.
+	 *
+	 * Throws on error.
+	 */
+	void LoadReplica();
+
+	/**
+	 * Save #replica to #replica_path.
+	 *
+	 * Throws on error.
+	 */
+	void SaveReplica() const;
+
+	/**
+	 * Bring #replica up to date with the remote database.  If
+	 * possible, only songs which have been modified since the
+	 * last refresh are transferred.
+	 *
+	 * Throws on error.
+	 */
+	void RefreshReplica();
+
+	/**
+	 * Replace #replica with a complete copy of the remote
+	 * database.
+	 */
+	void FetchReplica();
+
+	/**
+	 * Merge all songs modified since #replica_stamp into
+	 * #replica and remove songs which have been deleted.
+	 *
+	 * @return false if the remote MPD does not support this
+	 */
+	bool UpdateReplica();
+
+	/**
+	 * Remove songs which no longer exist from #replica and
+	 * collect the URIs of songs which are not yet in #replica.
+	 */
+	std::set<std::string> PruneReplica();
+
+	void VisitReplica(const DatabaseSelection &selection,
+			  VisitSong visit_song) const;
+
+	/**
+	 * Can this selection be passed to VisitSongsAsync()?
+	 */
+	gcc_pure
+	bool IsAsyncSupported(const DatabaseSelection &selection) const noexcept;
+
+	void SubmitQuery(DatabaseAsyncHandler &handler,
+			 const DatabaseSelection &selection);
+	void StopQueryThread() noexcept;
+
+	/**
+	 * Execute one query on #query_connection.  Runs in
+	 * #query_thread.
+	 *
+	 * Throws on error.
+	 */
+	void RunQuery(ProxyQuery &query);
+
+	void RunQueryThread() noexcept;
+
+	/* callback for #query_monitor */
+	void OnQueriesFinished(unsigned mask) noexcept;
+
 	/* virtual methods from SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
 	/* virtual methods from IdleMonitor */
 	void OnIdle() noexcept override;
+
+	/* virtual methods from AsyncResolverHandler */
+	void OnResolverSuccess(std::vector<AllocatedSocketAddress> &&addresses) noexcept override;
+	void OnResolverError(std::exception_ptr error) noexcept override;
 };
 
+/**
+ * The port libmpdclient connects to if none was configured.
+ */
+static constexpr unsigned PROXY_DEFAULT_PORT = 6600;
+
+/**
+ * Does the configured "host" setting refer to a TCP host name (and
+ * not to a local socket or to libmpdclient's default)?
+ */
+gcc_pure
+static bool
+IsRemoteHost(const std::string &host) noexcept
+{
+	return !host.empty() && host.front() != '/' && host.front() != '@';
+}
+
+static constexpr unsigned
+GetEffectivePort(unsigned port) noexcept
+{
+	return port != 0 ? port : PROXY_DEFAULT_PORT;
+}
+
+/**
+ * Look up the numeric address of the given host in the resolver
+ * cache.  Returns an empty string if it is not (yet) known.
+ */
+gcc_pure
+static std::string
+GetCachedNumericHost(const std::string &host, unsigned port) noexcept
+{
+	if (!IsRemoteHost(host))
+		return std::string();
+
+	const auto addresses = LookupResolverCache(host.c_str(),
+						   GetEffectivePort(port),
+						   SOCK_STREAM);
+	if (addresses.empty())
+		return std::string();
+
+	return HostToString(addresses.front());
+}
+
 static constexpr struct {
 	TagType d;
 	enum mpd_tag_type s;
@@ -436,7 +780,14 @@ ProxyDatabase::ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener,
 	 host(block.GetBlockValue("host", "")),
 	 password(block.GetBlockValue("password", "")),
 	 port(block.GetBlockValue("port", 0u)),
-	 keepalive(block.GetBlockValue("keepalive", false))
+	 keepalive(block.GetBlockValue("keepalive", false)),
+	 resolver(_loop, *this),
+	 replica_enabled(block.GetBlockValue("replica", false)),
+	 replica_path(replica_enabled
+		      ? block.GetPath("replica_file")
+		      : AllocatedPath(nullptr)),
+	 query_thread(BIND_THIS_METHOD(RunQueryThread)),
+	 query_monitor(_loop, BIND_THIS_METHOD(OnQueriesFinished))
 {
 }
 
@@ -453,6 +804,25 @@ ProxyDatabase::Open()
 {
 	update_stamp = std::chrono::system_clock::time_point::min();
 
+	if (!replica_path.IsNull()) {
+		try {
+			LoadReplica();
+		} catch (...) {
+			/* the replica will be fetched again from the
+			   remote MPD */
+			LogError(std::current_exception());
+		}
+	}
+
+	if (IsRemoteHost(host) &&
+	    GetCachedNumericHost(host, port).empty()) {
+		/* resolve the host name in a worker thread;
+		   OnResolverSuccess() will connect */
+		resolver.Start(host.c_str(), GetEffectivePort(port),
+			       SOCK_STREAM);
+		return;
+	}
+
 	try {
 		Connect();
 	} catch (...) {
@@ -462,18 +832,54 @@ ProxyDatabase::Open()
 	}
 }
 
+void
+ProxyDatabase::OnResolverSuccess(std::vector<AllocatedSocketAddress> &&) noexcept
+{
+	if (connection != nullptr)
+		/* already connected by EnsureConnected() */
+		return;
+
+	try {
+		Connect();
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+void
+ProxyDatabase::OnResolverError(std::exception_ptr error) noexcept
+{
+	/* non-fatal; EnsureConnected() will try again (and report
+	   the error to the client) */
+	LogError(error);
+}
+
 void
 ProxyDatabase::Close() noexcept
 {
+	resolver.Cancel();
+	StopQueryThread();
+
 	if (connection != nullptr)
 		Disconnect();
 }
 
-void
-ProxyDatabase::Connect()
+/**
+ * Connect to the remote MPD and log in.
+ *
+ * Throws on error.
+ */
+static struct mpd_connection *
+OpenConnection(const std::string &host, unsigned port,
+	       const std::string &password, bool keepalive)
 {
-	const char *_host = host.empty() ? nullptr : host.c_str();
-	connection = mpd_connection_new(_host, port, 0);
+	/* prefer the address which was resolved by #AsyncResolver,
+	   so libmpdclient does not need to block in getaddrinfo() */
+	const std::string numeric_host = GetCachedNumericHost(host, port);
+	const char *_host = !numeric_host.empty()
+		? numeric_host.c_str()
+		: (host.empty() ? nullptr : host.c_str());
+	auto *connection = mpd_connection_new(_host, port, 0);
 	if (connection == nullptr)
 		throw LibmpdclientError(MPD_ERROR_OOM, "Out of memory");
 
@@ -489,7 +895,6 @@ ProxyDatabase::Connect()
 			ThrowError(connection);
 	} catch (...) {
 		mpd_connection_free(connection);
-		connection = nullptr;
 
 		std::throw_with_nested(host.empty()
 				       ? std::runtime_error("Failed to connect to remote MPD")
@@ -500,10 +905,17 @@ ProxyDatabase::Connect()
 #if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
 	mpd_connection_set_keepalive(connection, keepalive);
 #else
-	// suppress -Wunused-private-field
 	(void)keepalive;
 #endif
 
+	return connection;
+}
+
+void
+ProxyDatabase::Connect()
+{
+	connection = OpenConnection(host, port, password, keepalive);
+
 	idle_received = ~0u;
 	is_idle = false;
 
@@ -560,6 +972,323 @@ ProxyDatabase::Disconnect() noexcept
 	connection = nullptr;
 }
 
+#define REPLICA_STAMP "replica_stamp: "
+
+/**
+ * The number of songs requested per "search" command while
+ * fetching the replica; this keeps each response below the remote
+ * MPD's "max_output_buffer_size".
+ */
+static constexpr unsigned REPLICA_WINDOW = 4096;
+
+/**
+ * If more than this number of new songs cannot be obtained with a
+ * "modified-since" search, fetch the whole replica again instead of
+ * querying them one by one.
+ */
+static constexpr std::size_t REPLICA_MAX_MISSING = 256;
+
+static void
+replica_song_save(BufferedOutputStream &os, const std::string &uri,
+		  const ReplicaSong &song)
+{
+	os.Format(SONG_BEGIN "%s\n", uri.c_str());
+
+	const unsigned start_ms = song.start_time.ToMS();
+	const unsigned end_ms = song.end_time.ToMS();
+	if (end_ms > 0)
+		os.Format("Range: %u-%u\n", start_ms, end_ms);
+	else if (start_ms > 0)
+		os.Format("Range: %u-\n", start_ms);
+
+	tag_save(os, song.tag);
+
+	if (song.audio_format.IsDefined())
+		os.Format("Format: %s\n", ToString(song.audio_format).c_str());
+
+	if (!IsNegative(song.mtime))
+		os.Format("mtime: %li\n",
+			  (long)std::chrono::system_clock::to_time_t(song.mtime));
+	os.Format("song_end\n");
+}
+
+void
+ProxyDatabase::LoadReplica()
+{
+	assert(!replica_path.IsNull());
+
+	TextFile file(replica_path);
+
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, REPLICA_STAMP))
+		throw std::runtime_error("Malformed proxy replica file");
+
+	const time_t stamp = strtol(line + strlen(REPLICA_STAMP),
+				    nullptr, 10);
+
+	ReplicaMap songs;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (!StringStartsWith(line, SONG_BEGIN))
+			throw FormatRuntimeError("Malformed line in proxy replica file: %s",
+						 line);
+
+		const char *uri = line + strlen(SONG_BEGIN);
+		std::string key(uri);
+
+		AudioFormat audio_format = AudioFormat::Undefined();
+		auto song = song_load(file, uri, &audio_format);
+		songs[std::move(key)] = ReplicaSong(std::move(*song),
+						    audio_format);
+	}
+
+	replica = std::move(songs);
+	replica_stamp = stamp;
+	replica_valid = true;
+
+	FormatDebug(proxy_db_domain, "Loaded %zu songs from replica",
+		    replica.size());
+}
+
+void
+ProxyDatabase::SaveReplica() const
+{
+	assert(!replica_path.IsNull());
+	assert(replica_valid);
+
+	FileOutputStream fos(replica_path);
+	BufferedOutputStream bos(fos);
+
+	bos.Format(REPLICA_STAMP "%li\n", (long)replica_stamp);
+
+	for (const auto &i : replica)
+		replica_song_save(bos, i.first, i.second);
+
+	bos.Flush();
+	fos.Commit();
+}
+
+static std::size_t
+ReceiveReplicaSongs(struct mpd_connection *connection, ReplicaMap &dest)
+{
+	std::size_t n = 0;
+
+	while (auto *song = mpd_recv_song(connection)) {
+		const AllocatedProxySong song2(song);
+		dest[song2.uri] = ReplicaSong(song2);
+		++n;
+	}
+
+	if (!mpd_response_finish(connection))
+		ThrowError(connection);
+
+	return n;
+}
+
+#if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+
+/**
+ * Receive all songs modified since the given time stamp, using a
+ * series of windowed "search" commands.
+ */
+static void
+SearchModifiedSince(struct mpd_connection *connection, time_t since,
+		    ReplicaMap &dest)
+{
+	for (unsigned start = 0;; start += REPLICA_WINDOW) {
+		try {
+			if (!mpd_search_db_songs(connection, true) ||
+			    !mpd_search_add_modified_since_constraint(connection,
+								      MPD_OPERATOR_DEFAULT,
+								      since) ||
+			    !mpd_search_add_window(connection, start,
+						   start + REPLICA_WINDOW) ||
+			    !mpd_search_commit(connection))
+				ThrowError(connection);
+		} catch (...) {
+			mpd_search_cancel(connection);
+			throw;
+		}
+
+		if (ReceiveReplicaSongs(connection, dest) < REPLICA_WINDOW)
+			break;
+	}
+}
+
+gcc_pure
+static bool
+CanSearchModifiedSince(const struct mpd_connection *connection) noexcept
+{
+	/* the "window" parameter requires MPD 0.20 */
+	return mpd_connection_cmp_server_version(connection, 0, 20, 0) >= 0;
+}
+
+#endif
+
+void
+ProxyDatabase::FetchReplica()
+{
+	ReplicaMap songs;
+
+#if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+	if (CanSearchModifiedSince(connection))
+		SearchModifiedSince(connection, 0, songs);
+	else
+#endif
+	{
+		if (!mpd_send_list_all_meta(connection, ""))
+			ThrowError(connection);
+
+		ReceiveReplicaSongs(connection, songs);
+	}
+
+	replica = std::move(songs);
+}
+
+std::set<std::string>
+ProxyDatabase::PruneReplica()
+{
+	if (!mpd_send_list_all(connection, ""))
+		ThrowError(connection);
+
+	std::set<std::string> uris;
+
+	while (auto *pair = mpd_recv_pair_named(connection, "file")) {
+		AtScopeExit(this, pair) {
+			mpd_return_pair(connection, pair);
+		};
+
+		uris.emplace(pair->value);
+	}
+
+	if (!mpd_response_finish(connection))
+		ThrowError(connection);
+
+	/* both containers are sorted; walk them side by side */
+	auto r = replica.begin();
+	auto u = uris.begin();
+	while (r != replica.end()) {
+		if (u == uris.end() || r->first < *u) {
+			/* deleted from the remote database */
+			r = replica.erase(r);
+		} else if (*u < r->first) {
+			++u;
+		} else {
+			/* already known; not "missing" */
+			++r;
+			u = uris.erase(u);
+		}
+	}
+
+	return uris;
+}
+
+bool
+ProxyDatabase::UpdateReplica()
+{
+#if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+	if (!CanSearchModifiedSince(connection))
+		return false;
+
+	/* songs which were added or modified after the previous
+	   refresh */
+	SearchModifiedSince(connection, replica_stamp, replica);
+
+	/* songs which were deleted, and songs which were added (or
+	   moved) with an old modification time */
+	const auto missing = PruneReplica();
+	if (missing.size() > REPLICA_MAX_MISSING)
+		return false;
+
+	for (const auto &uri : missing) {
+		if (!mpd_send_list_meta(connection, uri.c_str()))
+			ThrowError(connection);
+
+		ReceiveReplicaSongs(connection, replica);
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void
+ProxyDatabase::RefreshReplica()
+{
+	assert(replica_enabled);
+	assert(connection != nullptr);
+
+	struct mpd_stats *stats = mpd_run_stats(connection);
+	if (stats == nullptr)
+		ThrowError(connection);
+
+	const time_t stamp = mpd_stats_get_db_update_time(stats);
+	const unsigned n_songs = mpd_stats_get_number_of_songs(stats);
+	mpd_stats_free(stats);
+
+	if (replica_valid && stamp == replica_stamp &&
+	    replica.size() == n_songs)
+		/* the replica is up to date (e.g. just loaded from
+		   the replica file) */
+		return;
+
+	if (replica_valid && UpdateReplica()) {
+		FormatDebug(proxy_db_domain, "Updated replica, %zu songs",
+			    replica.size());
+	} else {
+		replica_valid = false;
+		FetchReplica();
+		FormatDebug(proxy_db_domain, "Fetched replica, %zu songs",
+			    replica.size());
+	}
+
+	replica_stamp = stamp;
+	replica_valid = true;
+
+	if (!replica_path.IsNull()) {
+		try {
+			SaveReplica();
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+}
+
+void
+ProxyDatabase::VisitReplica(const DatabaseSelection &selection,
+			    VisitSong visit_song) const
+{
+	assert(replica_valid);
+	assert(visit_song);
+
+	/* "sort" and "window" are emulated; the rest is evaluated
+	   here */
+	DatabaseSelection emulate(selection);
+	emulate.uri.clear();
+	emulate.filter = nullptr;
+	DatabaseVisitorHelper helper(emulate, visit_song);
+
+	std::string prefix(selection.uri);
+	if (!prefix.empty())
+		prefix.push_back('/');
+
+	for (auto i = replica.lower_bound(prefix);
+	     i != replica.end() && StringStartsWith(i->first.c_str(), prefix.c_str());
+	     ++i) {
+		if (!selection.recursive &&
+		    i->first.find('/', prefix.length()) != std::string::npos)
+			continue;
+
+		LightSong song(i->first.c_str(), i->second.tag);
+		i->second.CopyTo(song);
+
+		if (selection.Match(song))
+			visit_song(song);
+	}
+
+	helper.Commit();
+}
+
 bool
 ProxyDatabase::OnSocketReady(gcc_unused unsigned flags) noexcept
 {
@@ -596,8 +1325,17 @@ ProxyDatabase::OnIdle() noexcept
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		if (replica_enabled) {
+			try {
+				RefreshReplica();
+			} catch (...) {
+				LogError(std::current_exception());
+			}
+		}
+
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -627,6 +1365,15 @@ ProxyDatabase::OnIdle() noexcept
 const LightSong *
 ProxyDatabase::GetSong(const char *uri) const
 {
+	if (replica_valid) {
+		auto i = replica.find(uri);
+		if (i != replica.end())
+			return new ReplicaProxySong(i->first, i->second);
+
+		/* not in the replica: ask the remote MPD, maybe it
+		   is a new song which we haven't seen yet */
+	}
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -652,9 +1399,7 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const noexcept
 {
 	assert(_song != nullptr);
 
-	AllocatedProxySong *song = (AllocatedProxySong *)
-		const_cast<LightSong *>(_song);
-	delete song;
+	delete static_cast<const ProxySong *>(_song);
 }
 
 static void
@@ -958,6 +1703,13 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitSong visit_song,
 		     VisitPlaylist visit_playlist) const
 {
+	if (replica_valid && visit_song && !visit_directory &&
+	    !visit_playlist) {
+		/* songs only: this can be served by the replica */
+		VisitReplica(selection, visit_song);
+		return;
+	}
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -981,6 +1733,235 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 	helper.Commit();
 }
 
+ProxyQuery::ProxyQuery(DatabaseAsyncHandler &_handler,
+		       const DatabaseSelection &selection) noexcept
+	:handler(&_handler), uri(selection.uri),
+	 exact(selection.filter == nullptr ||
+	       !selection.filter->HasFoldCase()),
+	 sort(selection.sort), descending(selection.descending),
+	 window(selection.window)
+{
+	if (selection.filter != nullptr && !selection.filter->IsEmpty()) {
+		expression = selection.filter->ToExpression();
+		filter = selection.filter->Clone();
+	}
+}
+
+bool
+ProxyDatabase::IsAsyncSupported(const DatabaseSelection &selection) const noexcept
+{
+#if LIBMPDCLIENT_CHECK_VERSION(2, 15, 0)
+	if (replica_valid)
+		/* the replica is faster */
+		return false;
+
+	if (connection == nullptr ||
+	    mpd_connection_cmp_server_version(connection, 0, 21, 0) < 0)
+		/* we need "expression" support to forward the
+		   filter */
+		return false;
+
+	return selection.recursive &&
+		(selection.sort == TAG_NUM_OF_ITEM_TYPES ||
+		 IsSortSupported(selection.sort, connection));
+#else
+	(void)selection;
+	return false;
+#endif
+}
+
+void
+ProxyDatabase::SubmitQuery(DatabaseAsyncHandler &handler,
+			   const DatabaseSelection &selection)
+{
+	if (!query_thread.IsDefined())
+		query_thread.Start();
+
+	const std::lock_guard<Mutex> lock(query_mutex);
+	pending_queries.emplace_back(handler, selection);
+	query_cond.signal();
+}
+
+bool
+ProxyDatabase::VisitSongsAsync(const DatabaseSelection &selection,
+			       DatabaseAsyncHandler &handler) const
+{
+	if (!IsAsyncSupported(selection))
+		return false;
+
+	// TODO: eliminate the const_cast
+	const_cast<ProxyDatabase *>(this)->SubmitQuery(handler, selection);
+	return true;
+}
+
+void
+ProxyDatabase::CancelAsync(DatabaseAsyncHandler &handler) const noexcept
+{
+	// TODO: eliminate the const_cast
+	auto &self = *const_cast<ProxyDatabase *>(this);
+
+	const auto cancel = [&handler](std::list<ProxyQuery> &list){
+		for (auto &i : list)
+			if (i.handler == &handler)
+				i.handler = nullptr;
+	};
+
+	const std::lock_guard<Mutex> lock(self.query_mutex);
+
+	self.pending_queries.remove_if([&handler](const ProxyQuery &q){
+			return q.handler == &handler;
+		});
+
+	/* the running query cannot be interrupted; its result will
+	   be discarded */
+	cancel(self.running_query);
+	cancel(self.finished_queries);
+}
+
+void
+ProxyDatabase::StopQueryThread() noexcept
+{
+	if (!query_thread.IsDefined())
+		return;
+
+	{
+		const std::lock_guard<Mutex> lock(query_mutex);
+		query_quit = true;
+		query_cond.signal();
+	}
+
+	query_thread.Join();
+	query_monitor.Cancel();
+
+	if (query_connection != nullptr) {
+		mpd_connection_free(query_connection);
+		query_connection = nullptr;
+	}
+
+	pending_queries.clear();
+	finished_queries.clear();
+	query_quit = false;
+}
+
+void
+ProxyDatabase::RunQuery(ProxyQuery &query)
+{
+#if LIBMPDCLIENT_CHECK_VERSION(2, 15, 0)
+	if (query_connection != nullptr &&
+	    !mpd_connection_clear_error(query_connection)) {
+		/* the previous query has failed fatally */
+		mpd_connection_free(query_connection);
+		query_connection = nullptr;
+	}
+
+	if (query_connection == nullptr)
+		query_connection = OpenConnection(host, port, password,
+						  keepalive);
+
+	auto *c = query_connection;
+
+	try {
+		if (!mpd_search_db_songs(c, query.exact) ||
+		    (!query.uri.empty() &&
+		     !mpd_search_add_base_constraint(c, MPD_OPERATOR_DEFAULT,
+						     query.uri.c_str())) ||
+		    (!query.expression.empty() &&
+		     !mpd_search_add_expression(c, query.expression.c_str())))
+			ThrowError(c);
+
+		if (query.sort == TagType(SORT_TAG_LAST_MODIFIED)) {
+			if (!mpd_search_add_sort_name(c, "Last-Modified",
+						      query.descending))
+				ThrowError(c);
+		} else if (query.sort != TAG_NUM_OF_ITEM_TYPES) {
+			if (!mpd_search_add_sort_tag(c, Convert(query.sort),
+						     query.descending))
+				ThrowError(c);
+		}
+
+		if (query.window != RangeArg::All() &&
+		    !mpd_search_add_window(c, query.window.start,
+					   query.window.end))
+			ThrowError(c);
+
+		if (!mpd_search_commit(c))
+			ThrowError(c);
+	} catch (...) {
+		mpd_search_cancel(c);
+		throw;
+	}
+
+	while (auto *song = mpd_recv_song(c)) {
+		const AllocatedProxySong song2(song);
+
+		if (query.filter == nullptr || query.filter->Match(song2))
+			query.songs.emplace_back(song2);
+	}
+
+	if (!mpd_response_finish(c))
+		ThrowError(c);
+#else
+	(void)query;
+	throw std::runtime_error("Asynchronous queries require libmpdclient 2.15");
+#endif
+}
+
+void
+ProxyDatabase::RunQueryThread() noexcept
+{
+	SetThreadName("proxy_db");
+
+	const std::lock_guard<Mutex> lock(query_mutex);
+
+	while (!query_quit) {
+		if (pending_queries.empty()) {
+			query_cond.wait(query_mutex);
+			continue;
+		}
+
+		running_query.splice(running_query.end(), pending_queries,
+				     pending_queries.begin());
+		auto &query = running_query.front();
+
+		{
+			const ScopeUnlock unlock(query_mutex);
+
+			try {
+				RunQuery(query);
+			} catch (...) {
+				query.songs.clear();
+				query.error = std::current_exception();
+			}
+		}
+
+		finished_queries.splice(finished_queries.end(),
+					running_query);
+		query_monitor.OrMask(1);
+	}
+}
+
+void
+ProxyDatabase::OnQueriesFinished(unsigned) noexcept
+{
+	std::list<ProxyQuery> finished;
+
+	{
+		const std::lock_guard<Mutex> lock(query_mutex);
+		finished.swap(finished_queries);
+	}
+
+	for (auto &i : finished) {
+		if (i.handler == nullptr)
+			/* canceled */
+			continue;
+
+		if (i.error)
+			i.handler->OnDatabaseAsyncError(std::move(i.error));
+		else
+			i.handler->OnDatabaseAsyncSongs(std::move(i.songs));
+	}
+}
+
 std::map<std::string, std::set<std::string>>
 ProxyDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				 TagType tag_type, TagType group) const
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "AsyncQuery.hxx"
+#include "db/Interface.hxx"
+#include "db/AsyncHandler.hxx"
+#include "song/LightSong.hxx"
+
+AsyncQueryRunner::AsyncQueryRunner(EventLoop &loop, const Database &_db,
+				   unsigned n_threads)
+	:db(_db),
+	 monitor(loop, BIND_THIS_METHOD(OnFinished)),
+	 pool("db_query", n_threads)
+{
+}
+
+void
+AsyncQueryRunner::Submit(DatabaseAsyncHandler &handler,
+			 const DatabaseSelection &selection) noexcept
+{
+	std::list<Query>::iterator i;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		running.emplace_front(handler, selection);
+		i = running.begin();
+	}
+
+	pool.Push([this, i](){ Run(i); });
+}
+
+void
+AsyncQueryRunner::Cancel(DatabaseAsyncHandler &handler) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	/* running queries cannot be interrupted; their result will
+	   be discarded */
+	for (auto &i : running)
+		if (i.handler == &handler)
+			i.handler = nullptr;
+
+	finished.remove_if([&handler](const Query &q){
+			return q.handler == &handler;
+		});
+}
+
+void
+AsyncQueryRunner::Run(std::list<Query>::iterator i) noexcept
+{
+	auto &query = *i;
+
+	bool canceled;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		canceled = query.handler == nullptr;
+	}
+
+	if (!canceled) {
+		try {
+			db.Visit(query.selection,
+				 [&query](const LightSong &song){
+					 query.songs.emplace_back(song);
+				 });
+		} catch (...) {
+			query.songs.clear();
+			query.error = std::current_exception();
+		}
+	}
+
+	const std::lock_guard<Mutex> lock(mutex);
+	finished.splice(finished.end(), running, i);
+	monitor.OrMask(1);
+
+	if (running.empty())
+		idle_cond.broadcast();
+}
+
+void
+AsyncQueryRunner::WaitIdle() noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	while (!running.empty())
+		idle_cond.wait(mutex);
+}
+
+void
+AsyncQueryRunner::OnFinished(unsigned) noexcept
+{
+	std::list<Query> result;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		result.swap(finished);
+	}
+
+	for (auto &i : result) {
+		if (i.handler == nullptr)
+			/* canceled */
+			continue;
+
+		if (i.error)
+			i.handler->OnDatabaseAsyncError(std::move(i.error));
+		else
+			i.handler->OnDatabaseAsyncSongs(std::move(i.songs));
+	}
+}
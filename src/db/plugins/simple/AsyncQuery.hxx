@@ -0,0 +1,159 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DB_SIMPLE_ASYNC_QUERY_HXX
+#define MPD_DB_SIMPLE_ASYNC_QUERY_HXX
+
+#include "db/Selection.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/Filter.hxx"
+#include "event/MaskMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/WorkerPool.hxx"
+
+#include <exception>
+#include <list>
+#include <vector>
+
+class Database;
+class EventLoop;
+class DatabaseAsyncHandler;
+
+/**
+ * Evaluates Database::VisitSongsAsync() calls on a #WorkerPool and
+ * passes the results to the #DatabaseAsyncHandler in the main
+ * thread.  This keeps expensive "find"/"search" commands from
+ * blocking all other clients.
+ */
+class AsyncQueryRunner {
+	const Database &db;
+
+	struct Query {
+		/**
+		 * The handler which receives the result.  This is set to
+		 * nullptr by AsyncQueryRunner::Cancel().
+		 */
+		DatabaseAsyncHandler *handler;
+
+		/**
+		 * A copy of the caller's filter; #selection points to it.
+		 */
+		SongFilter filter;
+
+		DatabaseSelection selection;
+
+		std::vector<DetachedSong> songs;
+
+		std::exception_ptr error;
+
+		Query(DatabaseAsyncHandler &_handler,
+		      const DatabaseSelection &_selection) noexcept
+			:handler(&_handler),
+			 selection(_selection)
+		{
+			if (_selection.filter != nullptr) {
+				filter = _selection.filter->Copy();
+				selection.filter = &filter;
+			}
+		}
+
+		Query(const Query &) = delete;
+		Query &operator=(const Query &) = delete;
+	};
+
+	/**
+	 * Notifies the main thread about #finished.
+	 */
+	MaskMonitor monitor;
+
+	/**
+	 * Protects #running and #finished.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled when #running becomes empty.
+	 */
+	Cond idle_cond;
+
+	/**
+	 * Queries which have been submitted to #pool, but have not
+	 * yet finished.
+	 */
+	std::list<Query> running;
+
+	/**
+	 * Queries whose result has not yet been passed to the
+	 * handler.
+	 */
+	std::list<Query> finished;
+
+	/**
+	 * This is declared last, because its destructor waits for
+	 * all queued jobs (whose results are discarded), and these
+	 * access the other attributes.
+	 */
+	WorkerPool pool;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads; must be
+	 * positive
+	 */
+	AsyncQueryRunner(EventLoop &loop, const Database &_db,
+			 unsigned n_threads);
+
+	AsyncQueryRunner(const AsyncQueryRunner &) = delete;
+	AsyncQueryRunner &operator=(const AsyncQueryRunner &) = delete;
+
+	/**
+	 * Start evaluating a query.  The #DatabaseSelection (and its
+	 * #SongFilter) is copied; the caller may destroy it
+	 * immediately.
+	 */
+	void Submit(DatabaseAsyncHandler &handler,
+		    const DatabaseSelection &selection) noexcept;
+
+	/**
+	 * Discard the results of all queries submitted by the given
+	 * handler.  Must be called in the main thread.
+	 */
+	void Cancel(DatabaseAsyncHandler &handler) noexcept;
+
+	/**
+	 * Wait until all submitted queries have finished running
+	 * (their results are still delivered to the handlers later).
+	 * This is used before the #Database walked by the queries
+	 * is modified without holding #db_mutex, e.g. when a mounted
+	 * database is closed.  Must be called in the main thread.
+	 */
+	void WaitIdle() noexcept;
+
+private:
+	void Run(std::list<Query>::iterator i) noexcept;
+
+	/* callback for #monitor */
+	void OnFinished(unsigned) noexcept;
+};
+
+#endif
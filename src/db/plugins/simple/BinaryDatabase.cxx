@@ -0,0 +1,611 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BinaryDatabase.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongArena.hxx"
+#include "db/PlaylistVector.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Builder.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
+#include "util/ChronoUtil.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * All integers are stored in host byte order; files written on a
+ * host with a different byte order are rejected.  All records have a
+ * size which is a multiple of 8 bytes, and each section is aligned
+ * to 8 bytes, so the records can be accessed directly in a memory
+ * mapping.
+ */
+
+static constexpr char BINARY_DB_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', 'D', 'B',
+};
+
+static constexpr uint32_t BINARY_DB_BYTE_ORDER = 0x01020304;
+
+static constexpr uint32_t BINARY_DB_FORMAT = 3;
+
+/**
+ * A value for "parent" in #BinaryDirectory which denotes the root
+ * directory.
+ */
+static constexpr uint32_t BINARY_DB_NO_PARENT = UINT32_MAX;
+
+/**
+ * A value for "mtime" which denotes an unknown modification time.
+ */
+static constexpr int64_t BINARY_DB_NO_MTIME = INT64_MIN;
+
+struct BinarySection {
+	/**
+	 * The offset of the section relative to the beginning of the
+	 * file.
+	 */
+	uint64_t offset;
+
+	/**
+	 * The number of records (or bytes in the string table).
+	 */
+	uint64_t count;
+};
+
+struct BinaryHeader {
+	char magic[sizeof(BINARY_DB_MAGIC)];
+	uint32_t byte_order;
+	uint32_t format;
+
+	/**
+	 * The filesystem charset (a string table offset).
+	 */
+	uint32_t fs_charset;
+
+	uint32_t reserved;
+
+	/**
+	 * NUL-terminated strings which are referenced by byte offset.
+	 */
+	BinarySection strings;
+
+	/**
+	 * An array of uint32_t string offsets with the names of the
+	 * tags which were enabled when the file was written.
+	 * #BinaryTagItem refers to tags by their index in this array.
+	 */
+	BinarySection tags;
+
+	/**
+	 * #BinaryDirectory records in pre-order; the first one is the
+	 * root directory.
+	 */
+	BinarySection directories;
+
+	/**
+	 * #BinarySong records, grouped by directory in the same order
+	 * as #directories.
+	 */
+	BinarySection songs;
+
+	/**
+	 * #BinaryTagItem records, grouped by song.
+	 */
+	BinarySection items;
+
+	/**
+	 * #BinaryPlaylist records, grouped by directory.
+	 */
+	BinarySection playlists;
+};
+
+struct BinaryDirectory {
+	uint32_t name;
+
+	/**
+	 * The index of the parent directory, which must be smaller
+	 * than the index of this directory.
+	 */
+	uint32_t parent;
+
+	uint32_t device;
+	uint32_t n_songs;
+	int64_t mtime;
+	uint32_t n_playlists;
+	uint32_t reserved;
+};
+
+struct BinarySong {
+	uint32_t uri;
+	uint32_t n_items;
+	int64_t mtime;
+	uint32_t start_ms, end_ms;
+
+	/**
+	 * The duration in milliseconds; negative if unknown.
+	 */
+	int32_t duration_ms;
+
+	uint32_t sample_rate;
+	uint8_t format, channels;
+	uint8_t has_playlist;
+	uint8_t reserved[5];
+
+	/**
+	 * Song::replay_gain; a gain of -200 or less is undefined.
+	 */
+	float track_gain, track_peak;
+	float album_gain, album_peak;
+
+	/**
+	 * Song::mix_ramp (string table offsets; empty if
+	 * undefined).
+	 */
+	uint32_t mix_ramp_start, mix_ramp_end;
+	uint32_t reserved2;
+};
+
+struct BinaryTagItem {
+	uint32_t tag;
+	uint32_t value;
+};
+
+struct BinaryPlaylist {
+	uint32_t name;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+static_assert(sizeof(BinaryHeader) % 8 == 0, "Bad BinaryHeader size");
+static_assert(sizeof(BinaryDirectory) % 8 == 0, "Bad BinaryDirectory size");
+static_assert(sizeof(BinarySong) % 8 == 0, "Bad BinarySong size");
+static_assert(sizeof(BinaryTagItem) % 8 == 0, "Bad BinaryTagItem size");
+static_assert(sizeof(BinaryPlaylist) % 8 == 0, "Bad BinaryPlaylist size");
+
+static int64_t
+ExportTime(std::chrono::system_clock::time_point t) noexcept
+{
+	return IsNegative(t)
+		? BINARY_DB_NO_MTIME
+		: int64_t(std::chrono::system_clock::to_time_t(t));
+}
+
+static std::chrono::system_clock::time_point
+ImportTime(int64_t t) noexcept
+{
+	return t == BINARY_DB_NO_MTIME
+		? std::chrono::system_clock::time_point::min()
+		: std::chrono::system_clock::from_time_t(time_t(t));
+}
+
+bool
+db_is_binary(ConstBuffer<void> _data) noexcept
+{
+	const auto data = ConstBuffer<char>::FromVoid(_data);
+	return data.size >= sizeof(BINARY_DB_MAGIC) &&
+		memcmp(data.data, BINARY_DB_MAGIC,
+		       sizeof(BINARY_DB_MAGIC)) == 0;
+}
+
+namespace {
+
+/**
+ * Collects all records in memory, and then writes the whole file.
+ */
+class BinaryDatabaseWriter {
+	std::string strings;
+
+	/**
+	 * Maps each string to its offset in #strings, to store
+	 * duplicate values (e.g. tag values) only once.
+	 */
+	std::unordered_map<std::string, uint32_t> string_map;
+
+	/**
+	 * Maps a #TagType to its index in #tags.
+	 */
+	uint32_t tag_index[TAG_NUM_OF_ITEM_TYPES];
+
+	std::vector<uint32_t> tags;
+	std::vector<BinaryDirectory> directories;
+	std::vector<BinarySong> songs;
+	std::vector<BinaryTagItem> items;
+	std::vector<BinaryPlaylist> playlists;
+
+public:
+	BinaryDatabaseWriter() noexcept {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+			if (IsTagEnabled(i)) {
+				tag_index[i] = tags.size();
+				tags.push_back(AddString(tag_item_names[i]));
+			} else
+				tag_index[i] = UINT32_MAX;
+		}
+	}
+
+	void AddDirectory(const Directory &directory, uint32_t parent);
+
+	void Write(BufferedOutputStream &os);
+
+private:
+	uint32_t AddString(const char *s);
+
+	void AddSong(const Song &song);
+};
+
+uint32_t
+BinaryDatabaseWriter::AddString(const char *s)
+{
+	auto i = string_map.emplace(s, strings.size());
+	if (i.second)
+		strings.append(s, strlen(s) + 1);
+
+	return i.first->second;
+}
+
+inline void
+BinaryDatabaseWriter::AddSong(const Song &song)
+{
+	BinarySong &s = *songs.emplace(songs.end());
+	memset(&s, 0, sizeof(s));
+
+	s.uri = AddString(song.uri);
+	s.mtime = ExportTime(song.mtime);
+	s.start_ms = song.start_time.ToMS();
+	s.end_ms = song.end_time.ToMS();
+	s.duration_ms = song.tag.duration.IsNegative()
+		? -1
+		: song.tag.duration.ToMS();
+	s.sample_rate = song.audio_format.sample_rate;
+	s.format = uint8_t(song.audio_format.format);
+	s.channels = song.audio_format.channels;
+	s.has_playlist = song.tag.has_playlist;
+	s.track_gain = song.replay_gain.track.gain;
+	s.track_peak = song.replay_gain.track.peak;
+	s.album_gain = song.replay_gain.album.gain;
+	s.album_peak = song.replay_gain.album.peak;
+	s.mix_ramp_start = AddString(song.mix_ramp.GetStart() != nullptr
+				     ? song.mix_ramp.GetStart() : "");
+	s.mix_ramp_end = AddString(song.mix_ramp.GetEnd() != nullptr
+				   ? song.mix_ramp.GetEnd() : "");
+
+	for (const auto &item : song.tag) {
+		const uint32_t tag = tag_index[item.type];
+		if (tag == UINT32_MAX)
+			continue;
+
+		items.push_back({tag, AddString(item.value)});
+		++s.n_items;
+	}
+}
+
+void
+BinaryDatabaseWriter::AddDirectory(const Directory &directory,
+				   uint32_t parent)
+{
+	const uint32_t index = directories.size();
+
+	{
+		BinaryDirectory &d = *directories.emplace(directories.end());
+		memset(&d, 0, sizeof(d));
+
+		d.name = AddString(directory.IsRoot()
+				   ? ""
+				   : directory.GetName());
+		d.parent = parent;
+		d.device = directory.device;
+		d.mtime = ExportTime(directory.mtime);
+	}
+
+	/* note: don't keep a reference to the BinaryDirectory
+	   because the recursion below may reallocate the vector */
+
+	for (const auto &song : directory.songs) {
+		AddSong(song);
+		++directories[index].n_songs;
+	}
+
+	for (const auto &playlist : directory.playlists) {
+		playlists.push_back({AddString(playlist.name.c_str()), 0,
+				     ExportTime(playlist.mtime)});
+		++directories[index].n_playlists;
+	}
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			AddDirectory(child, index);
+}
+
+template<typename T>
+static void
+WriteSection(BufferedOutputStream &os, uint64_t &position,
+	     const std::vector<T> &v)
+{
+	os.Write(v.data(), v.size() * sizeof(T));
+	position += v.size() * sizeof(T);
+}
+
+static constexpr uint64_t
+AlignSection(uint64_t position) noexcept
+{
+	return (position + 7) & ~uint64_t(7);
+}
+
+static BinarySection
+MakeSection(uint64_t &position, uint64_t count, size_t record_size) noexcept
+{
+	const BinarySection section{position, count};
+	position = AlignSection(position + count * record_size);
+	return section;
+}
+
+void
+BinaryDatabaseWriter::Write(BufferedOutputStream &os)
+{
+	BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.byte_order = BINARY_DB_BYTE_ORDER;
+	header.format = BINARY_DB_FORMAT;
+	header.fs_charset = AddString(GetFSCharset());
+
+	uint64_t position = sizeof(header);
+	header.strings = MakeSection(position, strings.size(), 1);
+	header.tags = MakeSection(position, tags.size(), sizeof(tags[0]));
+	header.directories = MakeSection(position, directories.size(),
+					 sizeof(BinaryDirectory));
+	header.songs = MakeSection(position, songs.size(),
+				   sizeof(BinarySong));
+	header.items = MakeSection(position, items.size(),
+				   sizeof(BinaryTagItem));
+	header.playlists = MakeSection(position, playlists.size(),
+				       sizeof(BinaryPlaylist));
+
+	os.Write(&header, sizeof(header));
+
+	static constexpr char padding[8] = {};
+
+	position = sizeof(header);
+	const auto pad = [&os, &position](){
+		const uint64_t aligned = AlignSection(position);
+		os.Write(padding, aligned - position);
+		position = aligned;
+	};
+
+	os.Write(strings.data(), strings.size());
+	position += strings.size();
+	pad();
+
+	WriteSection(os, position, tags);
+	pad();
+	WriteSection(os, position, directories);
+	pad();
+	WriteSection(os, position, songs);
+	pad();
+	WriteSection(os, position, items);
+	pad();
+	WriteSection(os, position, playlists);
+}
+
+/**
+ * Provides bounds-checked access to a binary database file.
+ */
+class BinaryDatabaseReader {
+	const ConstBuffer<uint8_t> data;
+	const BinaryHeader &header;
+
+	ConstBuffer<char> strings;
+
+public:
+	explicit BinaryDatabaseReader(ConstBuffer<void> _data)
+		:data(ConstBuffer<uint8_t>::FromVoid(_data)),
+		 header(*(const BinaryHeader *)data.data) {
+		if (data.size < sizeof(header) || !db_is_binary(_data))
+			throw std::runtime_error("Database corrupted");
+
+		if (header.byte_order != BINARY_DB_BYTE_ORDER ||
+		    header.format != BINARY_DB_FORMAT)
+			throw std::runtime_error("Database format mismatch, "
+						 "discarding database file");
+
+		strings = GetSection<char>(header.strings);
+		if (strings.empty() || strings.back() != 0)
+			throw std::runtime_error("Database corrupted");
+	}
+
+	const BinaryHeader &GetHeader() const noexcept {
+		return header;
+	}
+
+	template<typename T>
+	ConstBuffer<T> GetSection(const BinarySection &section) const {
+		if (section.offset % alignof(T) != 0 ||
+		    section.offset > data.size ||
+		    section.count > (data.size - section.offset) / sizeof(T))
+			throw std::runtime_error("Database corrupted");
+
+		return {(const T *)(data.data + section.offset),
+			size_t(section.count)};
+	}
+
+	const char *GetString(uint32_t offset) const {
+		if (offset >= strings.size)
+			throw std::runtime_error("Database corrupted");
+
+		return strings.data + offset;
+	}
+};
+
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &music_root)
+{
+	BinaryDatabaseWriter writer;
+	writer.AddDirectory(music_root, BINARY_DB_NO_PARENT);
+	writer.Write(os);
+}
+
+void
+db_load_binary(ConstBuffer<void> data, Directory &music_root)
+{
+	assert(music_root.IsRoot());
+	assert(music_root.IsEmpty());
+
+	const BinaryDatabaseReader reader(data);
+	const auto &header = reader.GetHeader();
+
+	const char *new_charset = reader.GetString(header.fs_charset);
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0)
+		throw FormatRuntimeError("Existing database has charset "
+					 "\"%s\" instead of \"%s\"; "
+					 "discarding database file",
+					 new_charset, old_charset);
+
+	/* map the tag indexes of this file to our TagType values */
+	const auto tag_names = reader.GetSection<uint32_t>(header.tags);
+	std::vector<TagType> tags;
+	tags.reserve(tag_names.size);
+
+	bool found_tags[TAG_NUM_OF_ITEM_TYPES];
+	memset(found_tags, false, sizeof(found_tags));
+
+	for (uint32_t i : tag_names) {
+		const char *name = reader.GetString(i);
+		TagType tag = tag_name_parse(name);
+		if (tag == TAG_NUM_OF_ITEM_TYPES)
+			throw FormatRuntimeError("Unrecognized tag '%s', "
+						 "discarding database file",
+						 name);
+
+		tags.push_back(tag);
+		found_tags[tag] = true;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i) && !found_tags[i])
+			throw std::runtime_error("Tag list mismatch, "
+						 "discarding database file");
+
+	const auto directories =
+		reader.GetSection<BinaryDirectory>(header.directories);
+	const auto songs = reader.GetSection<BinarySong>(header.songs);
+	const auto items = reader.GetSection<BinaryTagItem>(header.items);
+	const auto playlists =
+		reader.GetSection<BinaryPlaylist>(header.playlists);
+
+	if (directories.empty() ||
+	    directories.front().parent != BINARY_DB_NO_PARENT)
+		throw std::runtime_error("Database corrupted");
+
+	std::vector<Directory *> directory_objects;
+	directory_objects.reserve(directories.size);
+
+	SongArena arena;
+
+	size_t song_index = 0, item_index = 0, playlist_index = 0;
+
+	for (const auto &d : directories) {
+		Directory *directory;
+		if (directory_objects.empty()) {
+			directory = &music_root;
+		} else {
+			if (d.parent >= directory_objects.size())
+				throw std::runtime_error("Database corrupted");
+
+			directory = directory_objects[d.parent]
+				->CreateChild(reader.GetString(d.name));
+		}
+
+		directory_objects.push_back(directory);
+
+		directory->device = d.device;
+		directory->mtime = ImportTime(d.mtime);
+
+		if (d.n_songs > songs.size - song_index ||
+		    d.n_playlists > playlists.size - playlist_index)
+			throw std::runtime_error("Database corrupted");
+
+		for (const auto &s : ConstBuffer<BinarySong>(songs.data + song_index,
+							     d.n_songs)) {
+			if (s.n_items > items.size - item_index)
+				throw std::runtime_error("Database corrupted");
+
+			Song *song = Song::NewFile(reader.GetString(s.uri),
+						   *directory, &arena);
+			song->mtime = ImportTime(s.mtime);
+			song->start_time = SongTime::FromMS(s.start_ms);
+			song->end_time = SongTime::FromMS(s.end_ms);
+
+			const AudioFormat audio_format(s.sample_rate,
+						       SampleFormat(s.format),
+						       s.channels);
+			if (audio_format.IsValid())
+				song->audio_format = audio_format;
+
+			song->replay_gain.track = {s.track_gain, s.track_peak};
+			song->replay_gain.album = {s.album_gain, s.album_peak};
+			song->mix_ramp.SetStart(reader.GetString(s.mix_ramp_start));
+			song->mix_ramp.SetEnd(reader.GetString(s.mix_ramp_end));
+
+			TagBuilder tag;
+			if (s.duration_ms >= 0)
+				tag.SetDuration(SignedSongTime::FromMS(s.duration_ms));
+			tag.SetHasPlaylist(s.has_playlist);
+
+			for (const auto &i : ConstBuffer<BinaryTagItem>(items.data + item_index,
+									s.n_items)) {
+				if (i.tag >= tags.size()) {
+					song->Free();
+					throw std::runtime_error("Database corrupted");
+				}
+
+				tag.AddItem(tags[i.tag],
+					    reader.GetString(i.value));
+			}
+
+			item_index += s.n_items;
+
+			tag.Commit(song->tag);
+			directory->AddSong(song);
+		}
+
+		song_index += d.n_songs;
+
+		for (const auto &p : ConstBuffer<BinaryPlaylist>(playlists.data + playlist_index,
+								 d.n_playlists))
+			directory->playlists.push_back(PlaylistInfo(reader.GetString(p.name),
+								    ImportTime(p.mtime)));
+
+		playlist_index += d.n_playlists;
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BINARY_DATABASE_HXX
+#define MPD_BINARY_DATABASE_HXX
+
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+struct Directory;
+class BufferedOutputStream;
+
+/**
+ * Does the given buffer begin with the signature of the binary
+ * database format?
+ */
+gcc_pure
+bool
+db_is_binary(ConstBuffer<void> data) noexcept;
+
+/**
+ * Write the given #Directory tree in the binary database format.
+ * This format consists of a string table, fixed-size records for
+ * directories, songs, tag items and playlists, and can be loaded
+ * from a memory mapping without parsing text.
+ *
+ * Caller must hold a shared lock on #db_mutex (or be the update
+ * thread).
+ *
+ * Throws on error.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &music_root);
+
+/**
+ * Load a database in the binary format (see db_save_binary()) into
+ * the given (empty) root #Directory.  Locking is the caller's
+ * responsibility, as with db_load_internal().
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_binary(ConstBuffer<void> data, Directory &music_root);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/TextFile.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <string>
+
+#include <string.h>
+#include <inttypes.h>
+
+#define JOURNAL_FORMAT "journal_format: "
+#define JOURNAL_SNAPSHOT "snapshot: "
+#define JOURNAL_DIRECTORY "journal_directory: "
+#define JOURNAL_COMMIT "journal_commit"
+
+static constexpr unsigned JOURNAL_FORMAT_VERSION = 1;
+
+static std::string
+FormatSnapshot(const FileInfo &snapshot)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%" PRIu64 " %lld",
+		 snapshot.GetSize(),
+		 (long long)std::chrono::system_clock::to_time_t(snapshot.GetModificationTime()));
+	return buffer;
+}
+
+void
+db_journal_save_header(BufferedOutputStream &os, const FileInfo &snapshot)
+{
+	os.Format(JOURNAL_FORMAT "%u\n", JOURNAL_FORMAT_VERSION);
+	os.Format(JOURNAL_SNAPSHOT "%s\n", FormatSnapshot(snapshot).c_str());
+}
+
+void
+db_journal_save(BufferedOutputStream &os, const Directory &directory)
+{
+	os.Format(JOURNAL_DIRECTORY "%s\n", directory.GetPath());
+	directory_save_shallow(os, directory);
+}
+
+void
+db_journal_commit(BufferedOutputStream &os)
+{
+	os.Format(JOURNAL_COMMIT "\n");
+}
+
+/**
+ * Check the header; returns false if the journal does not belong to
+ * the given snapshot.
+ */
+static bool
+CheckHeader(TextFile &file, const FileInfo &snapshot)
+{
+	const char *line = file.ReadLine();
+	const char *p;
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_FORMAT)) == nullptr)
+		throw std::runtime_error("Malformed database journal");
+
+	if (strtoul(p, nullptr, 10) != JOURNAL_FORMAT_VERSION)
+		throw std::runtime_error("Database journal format mismatch");
+
+	line = file.ReadLine();
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_SNAPSHOT)) == nullptr)
+		throw std::runtime_error("Malformed database journal");
+
+	return FormatSnapshot(snapshot) == p;
+}
+
+/**
+ * Look up a directory by its path, creating all missing path
+ * segments.
+ */
+static Directory &
+MakeDirectory(Directory &root, const char *path)
+{
+	Directory *directory = &root;
+
+	while (*path != 0) {
+		const char *slash = strchr(path, '/');
+		const std::string name = slash != nullptr
+			? std::string(path, slash)
+			: std::string(path);
+		if (name.empty())
+			throw FormatRuntimeError("Malformed path: %s", path);
+
+		directory = directory->MakeChild(name.c_str());
+
+		if (slash == nullptr)
+			break;
+
+		path = slash + 1;
+	}
+
+	return *directory;
+}
+
+bool
+db_journal_load(Path path, const FileInfo &snapshot, Directory &root)
+{
+	/* pass 1: count the committed batches, so an incomplete
+	   batch at the end can be ignored */
+
+	unsigned n_batches = 0;
+	bool incomplete = false;
+
+	{
+		TextFile file(path);
+		if (!CheckHeader(file, snapshot))
+			return false;
+
+		const char *line;
+		while ((line = file.ReadLine()) != nullptr) {
+			if (strcmp(line, JOURNAL_COMMIT) == 0) {
+				++n_batches;
+				incomplete = false;
+			} else
+				incomplete = true;
+		}
+	}
+
+	if (n_batches == 0)
+		return !incomplete;
+
+	/* pass 2: apply the committed batches */
+
+	TextFile file(path);
+	CheckHeader(file, snapshot);
+
+	while (n_batches > 0) {
+		const char *line = file.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of file");
+
+		const char *p;
+		if ((p = StringAfterPrefix(line, JOURNAL_DIRECTORY))) {
+			Directory &directory = MakeDirectory(root, p);
+			directory_load_shallow(file, directory);
+		} else if (strcmp(line, JOURNAL_COMMIT) == 0) {
+			--n_batches;
+		} else
+			throw FormatRuntimeError("Malformed line: %s", line);
+	}
+
+	return !incomplete;
+}
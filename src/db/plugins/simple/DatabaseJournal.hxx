@@ -0,0 +1,70 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+/*
+ * The database journal is a text file next to the database file
+ * which collects modifications since the database file was last
+ * written.  It begins with a header identifying the database file
+ * (the "snapshot"), followed by batches of records, each of which
+ * replaces the contents of one directory (see
+ * directory_save_shallow()).  Each batch ends with a commit line;
+ * incomplete batches (e.g. after a crash) are ignored.
+ */
+
+struct Directory;
+class BufferedOutputStream;
+class FileInfo;
+class Path;
+
+void
+db_journal_save_header(BufferedOutputStream &os, const FileInfo &snapshot);
+
+/**
+ * Write a record describing the current contents of the given
+ * directory.
+ */
+void
+db_journal_save(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * Finish a batch of records written by db_journal_save().
+ */
+void
+db_journal_commit(BufferedOutputStream &os);
+
+/**
+ * Apply all committed batches of the given journal file to the
+ * tree.  Locking is the caller's responsibility, as with
+ * db_load_internal().
+ *
+ * Throws on error.
+ *
+ * @param snapshot information about the database file which was
+ * loaded into #root
+ * @return false if the journal does not belong to this database
+ * file (nothing was applied) or if it ends with an incomplete batch;
+ * the caller should write a new database file soon
+ */
+bool
+db_journal_load(Path path, const FileInfo &snapshot, Directory &root);
+
+#endif
@@ -18,7 +18,6 @@
  */
 
 #include "DatabaseSave.hxx"
-#include "db/DatabaseLock.hxx"
 #include "Directory.hxx"
 #include "DirectorySave.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
@@ -39,7 +38,7 @@
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
 
-static constexpr unsigned DB_FORMAT = 2;
+static constexpr unsigned DB_FORMAT = 4;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -126,6 +125,5 @@ db_load_internal(TextFile &file, Directory &music_root)
 			throw std::runtime_error("Tag list mismatch, "
 						 "discarding database file");
 
-	const ScopeDatabaseLock protect;
 	directory_load(file, music_root);
 }
@@ -28,6 +28,11 @@ void
 db_save_internal(BufferedOutputStream &os, const Directory &root);
 
 /**
+ * Load a database in the text format into the given (empty) root
+ * #Directory.  The caller must hold the exclusive database lock, or
+ * the tree must not be visible to other threads yet (see
+ * #ScopeDatabasePrivateTree).
+ *
  * Throws #std::runtime_error on error.
  */
 void
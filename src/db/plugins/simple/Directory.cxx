@@ -20,6 +20,7 @@
 #include "Directory.hxx"
 #include "SongSort.hxx"
 #include "Song.hxx"
+#include "StatsAggregate.hxx"
 #include "Mount.hxx"
 #include "db/LightDirectory.hxx"
 #include "song/LightSong.hxx"
@@ -43,6 +44,14 @@ Directory::Directory(std::string &&_path_utf8, Directory *_parent)
 {
 }
 
+Directory *
+Directory::NewRoot()
+{
+	auto *root = new Directory(std::string(), nullptr);
+	root->stats.reset(new StatsAggregate());
+	return root;
+}
+
 Directory::~Directory()
 {
 	delete mounted_database;
@@ -54,9 +63,15 @@ Directory::~Directory()
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(parent != nullptr);
 
+	/* usually, DatabaseEditor has emptied this directory
+	   already, but not when loading the database fails */
+	GetRootStats().Remove(*this);
+
+	parent->MarkModified();
+	parent->OnChildRemoved(*this);
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -72,7 +87,7 @@ Directory::GetName() const noexcept
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
@@ -82,14 +97,48 @@ Directory::CreateChild(const char *name_utf8)
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	++n_children;
+
+	child->MarkModified();
+	MarkModified();
+
+	if (child_index != nullptr)
+		child_index->emplace(child->GetName(), child);
+	else if (n_children > INDEX_THRESHOLD) {
+		child_index.reset(new ChildIndex());
+		for (auto &i : children)
+			child_index->emplace(i.GetName(), &i);
+	}
+
 	return child;
 }
 
+void
+Directory::OnChildRemoved(Directory &child) noexcept
+{
+	assert(holding_db_exclusive_lock());
+	assert(child.parent == this);
+	assert(n_children > 0);
+
+	--n_children;
+
+	if (child_index != nullptr) {
+		auto i = child_index->find(child.GetName());
+		if (i != child_index->end() && i->second == &child)
+			child_index->erase(i);
+	}
+}
+
 const Directory *
 Directory::FindChild(const char *name) const noexcept
 {
 	assert(holding_db_lock());
 
+	if (child_index != nullptr) {
+		auto i = child_index->find(name);
+		return i != child_index->end() ? i->second : nullptr;
+	}
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -100,16 +149,18 @@ Directory::FindChild(const char *name) const noexcept
 void
 Directory::PruneEmpty() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty() && !child->IsMount())
+		if (child->IsEmpty() && !child->IsMount()) {
+			MarkModified();
+			OnChildRemoved(*child);
 			child = children.erase_and_dispose(child,
 							   DeleteDisposer());
-		else
+		} else
 			++child;
 	}
 }
@@ -162,21 +213,74 @@ Directory::LookupDirectory(const char *uri) noexcept
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+	++n_songs;
+	MarkModified();
+
+	if (song_index != nullptr)
+		song_index->emplace(song->uri, song);
+	else if (n_songs > INDEX_THRESHOLD) {
+		song_index.reset(new SongIndex());
+		for (auto &i : songs)
+			song_index->emplace(i.uri, &i);
+	}
+
+	GetRootStats().Add(*song);
 }
 
 void
 Directory::RemoveSong(Song *song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+	assert(n_songs > 0);
+	--n_songs;
+	MarkModified();
+
+	if (song_index != nullptr) {
+		auto i = song_index->find(song->uri);
+		if (i != song_index->end() && i->second == song)
+			song_index->erase(i);
+	}
+
+	GetRootStats().Remove(*song);
+}
+
+void
+Directory::BeginModifySong(const Song &song) noexcept
+{
+	assert(holding_db_exclusive_lock());
+	assert(song.parent == this);
+
+	GetRootStats().Remove(song);
+}
+
+void
+Directory::EndModifySong(const Song &song) noexcept
+{
+	assert(holding_db_exclusive_lock());
+	assert(song.parent == this);
+
+	MarkModified();
+	GetRootStats().Add(song);
+}
+
+StatsAggregate &
+Directory::GetRootStats() noexcept
+{
+	Directory *directory = this;
+	while (directory->parent != nullptr)
+		directory = directory->parent;
+
+	assert(directory->stats != nullptr);
+	return *directory->stats;
 }
 
 const Song *
@@ -185,6 +289,11 @@ Directory::FindSong(const char *name_utf8) const noexcept
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index != nullptr) {
+		auto i = song_index->find(name_utf8);
+		return i != song_index->end() ? i->second : nullptr;
+	}
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -203,15 +312,16 @@ directory_cmp(const Directory &a, const Directory &b) noexcept
 }
 
 void
-Directory::Sort() noexcept
+Directory::Sort(bool recursive) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	children.sort(directory_cmp);
 	song_list_sort(songs);
 
-	for (auto &child : children)
-		child.Sort();
+	if (recursive)
+		for (auto &child : children)
+			child.Sort();
 }
 
 void
@@ -225,7 +335,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		const ScopeDatabaseUnlock unlock;
+		const ScopeDatabaseSharedUnlock unlock;
 		WalkMount(GetPath(), *mounted_database,
 			  "", DatabaseSelection("", recursive, filter),
 			  visit_directory, visit_song,
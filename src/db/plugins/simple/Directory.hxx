@@ -24,10 +24,13 @@
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "Song.hxx"
+#include "util/StringHash.hxx"
 
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 /**
  * Virtual directory that is really an archive file or a folder inside
@@ -44,6 +47,7 @@ static constexpr unsigned DEVICE_CONTAINER = -2;
 
 class SongFilter;
 class Database;
+class StatsAggregate;
 
 struct Directory {
 	static constexpr auto link_mode = boost::intrusive::normal_link;
@@ -81,6 +85,42 @@ struct Directory {
 	 */
 	SongList songs;
 
+	/**
+	 * Directories with more children (or songs) than this get a
+	 * hash index for FindChild() (or FindSong()).
+	 */
+	static constexpr unsigned INDEX_THRESHOLD = 32;
+
+	/**
+	 * The number of #children and #songs (the lists do not
+	 * count their items).
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	unsigned n_children = 0, n_songs = 0;
+
+	typedef std::unordered_map<const char *, Directory *,
+				   StringHash, StringEqual> ChildIndex;
+	typedef std::unordered_map<const char *, Song *,
+				   StringHash, StringEqual> SongIndex;
+
+	/**
+	 * An index of #children by GetName(), created by
+	 * CreateChild() when there are more than #INDEX_THRESHOLD
+	 * children.  It is never created by a (shared-locked) lookup,
+	 * so readers need no exclusive access.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<ChildIndex> child_index;
+
+	/**
+	 * An index of #songs by Song::uri, like #child_index.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<SongIndex> song_index;
+
 	PlaylistVector playlists;
 
 	Directory *const parent;
@@ -98,6 +138,32 @@ struct Directory {
 	 */
 	Database *mounted_database = nullptr;
 
+	/**
+	 * The statistics of all songs in this tree, updated by
+	 * AddSong() and RemoveSong().  Only the root directory has
+	 * one.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<StatsAggregate> stats;
+
+	/**
+	 * Have the attributes, the list of children, the songs or
+	 * the playlists of this directory been modified since the
+	 * database was last saved?  This decides which directories
+	 * are written to the database journal.
+	 *
+	 * This attribute is only accessed by the update thread.
+	 */
+	bool modified = false;
+
+	/**
+	 * Has this directory or one of its descendants been
+	 * modified?  Allows VisitModified() to skip unmodified
+	 * subtrees.
+	 */
+	bool subtree_modified = false;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent);
 	~Directory();
@@ -106,9 +172,7 @@ public:
 	 * Create a new root #Directory object.
 	 */
 	gcc_malloc gcc_returns_nonnull
-	static Directory *NewRoot() {
-		return new Directory(std::string(), nullptr);
-	}
+	static Directory *NewRoot();
 
 	bool IsMount() const {
 		return mounted_database != nullptr;
@@ -118,25 +182,34 @@ public:
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Delete();
 
 	/**
 	 * Create a new #Directory object as a child of the given one.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 *
 	 * @param name_utf8 the UTF-8 encoded name of the new sub directory
 	 */
 	Directory *CreateChild(const char *name_utf8);
 
 	/**
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex (a shared lock is
+	 * sufficient).
 	 */
 	gcc_pure
 	const Directory *FindChild(const char *name) const noexcept;
 
+	/**
+	 * Remove the given child from #child_index before it gets
+	 * unlinked from #children.
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 */
+	void OnChildRemoved(Directory &child) noexcept;
+
 	gcc_pure
 	Directory *FindChild(const char *name) noexcept {
 		const Directory *cthis = this;
@@ -147,7 +220,7 @@ public:
 	 * Look up a sub directory, and create the object if it does not
 	 * exist.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	Directory *MakeChild(const char *name_utf8) {
 		Directory *child = FindChild(name_utf8);
@@ -227,7 +300,8 @@ public:
 	/**
 	 * Look up a song in this directory by its name.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex (a shared lock is
+	 * sufficient).
 	 */
 	gcc_pure
 	const Song *FindSong(const char *name_utf8) const noexcept;
@@ -252,19 +326,78 @@ public:
 	void RemoveSong(Song *song) noexcept;
 
 	/**
-	 * Caller must lock the #db_mutex.
+	 * Call this before modifying the #Tag of a song which is
+	 * already in this directory: it withdraws the song from the
+	 * root's #StatsAggregate until EndModifySong() is called
+	 * with the modified song.
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 */
+	void BeginModifySong(const Song &song) noexcept;
+	void EndModifySong(const Song &song) noexcept;
+
+	/**
+	 * Flag this directory as modified, to be included in the next
+	 * database journal record.
+	 */
+	void MarkModified() noexcept {
+		modified = true;
+
+		for (Directory *i = this;
+		     i != nullptr && !i->subtree_modified;
+		     i = i->parent)
+			i->subtree_modified = true;
+	}
+
+	/**
+	 * Invoke the given function for each directory which has been
+	 * flagged with MarkModified(), and clear the flags.
+	 */
+	template<typename F>
+	void VisitModified(F &&f) {
+		if (!subtree_modified)
+			return;
+
+		subtree_modified = false;
+
+		if (modified) {
+			modified = false;
+			f(*this);
+		}
+
+		for (auto &child : children)
+			child.VisitModified(f);
+	}
+
+	/**
+	 * Clear the flags set by MarkModified() in this subtree
+	 * without visiting the directories.
+	 */
+	void ClearModified() noexcept {
+		VisitModified([](Directory &){});
+	}
+
+	/**
+	 * Returns the #StatsAggregate of the root directory.
+	 */
+	gcc_pure
+	StatsAggregate &GetRootStats() noexcept;
+
+	/**
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void PruneEmpty() noexcept;
 
 	/**
-	 * Sort all directory entries recursively.
+	 * Sort all directory entries (recursively, unless
+	 * #recursive is false).
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
-	void Sort() noexcept;
+	void Sort(bool recursive=true) noexcept;
 
 	/**
-	 * Caller must lock #db_mutex.
+	 * Caller must hold a shared lock on #db_mutex.
 	 */
 	void Walk(bool recursive, const SongFilter *match,
 		  VisitDirectory visit_directory, VisitSong visit_song,
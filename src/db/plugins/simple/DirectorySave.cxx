@@ -20,6 +20,7 @@
 #include "DirectorySave.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
+#include "SongArena.hxx"
 #include "SongSave.hxx"
 #include "song/DetachedSong.hxx"
 #include "PlaylistDatabase.hxx"
@@ -30,6 +31,9 @@
 #include "util/NumberParser.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <set>
+#include <string>
+
 #include <string.h>
 
 #define DIRECTORY_DIR "directory: "
@@ -98,6 +102,31 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 		os.Format(DIRECTORY_END "%s\n", directory.GetPath());
 }
 
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory)
+{
+	if (!directory.IsRoot()) {
+		const char *type = DeviceToTypeString(directory.device);
+		if (type != nullptr)
+			os.Format(DIRECTORY_TYPE "%s\n", type);
+
+		if (!IsNegative(directory.mtime))
+			os.Format(DIRECTORY_MTIME "%lu\n",
+				  (unsigned long)std::chrono::system_clock::to_time_t(directory.mtime));
+	}
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			os.Format(DIRECTORY_DIR "%s\n", child.GetName());
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Format(DIRECTORY_END "%s\n", directory.GetPath());
+}
+
 static bool
 ParseLine(Directory &directory, const char *line)
 {
@@ -114,8 +143,12 @@ ParseLine(Directory &directory, const char *line)
 	return true;
 }
 
+static void
+directory_load(TextFile &file, Directory &directory, SongArena &arena);
+
 static Directory *
-directory_load_subdir(TextFile &file, Directory &parent, const char *name)
+directory_load_subdir(TextFile &file, Directory &parent, const char *name,
+		      SongArena &arena)
 {
 	if (parent.FindChild(name) != nullptr)
 		throw FormatRuntimeError("Duplicate subdirectory '%s'", name);
@@ -135,7 +168,7 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 				throw FormatRuntimeError("Malformed line: %s", line);
 		}
 
-		directory_load(file, *directory);
+		directory_load(file, *directory, arena);
 	} catch (...) {
 		directory->Delete();
 		throw;
@@ -144,16 +177,71 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 	return directory;
 }
 
+static void
+directory_load(TextFile &file, Directory &directory, SongArena &arena)
+{
+	const char *line;
+
+	while ((line = file.ReadLine()) != nullptr &&
+	       !StringStartsWith(line, DIRECTORY_END)) {
+		const char *p;
+		if ((p = StringAfterPrefix(line, DIRECTORY_DIR))) {
+			directory_load_subdir(file, directory, p, arena);
+		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+			const char *name = p;
+
+			if (directory.FindSong(name) != nullptr)
+				throw FormatRuntimeError("Duplicate song '%s'", name);
+
+			auto audio_format = AudioFormat::Undefined();
+			auto detached_song = song_load(file, name,
+						       &audio_format);
+
+			auto song = Song::NewFrom(std::move(*detached_song),
+						  directory, &arena);
+			song->audio_format = audio_format;
+
+			directory.AddSong(song);
+		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
+			const char *name = p;
+			playlist_metadata_load(file, directory.playlists, name);
+		} else {
+			throw FormatRuntimeError("Malformed line: %s", line);
+		}
+	}
+}
+
 void
 directory_load(TextFile &file, Directory &directory)
 {
-	const char *line;
+	SongArena arena;
+	directory_load(file, directory, arena);
+}
+
+void
+directory_load_shallow(TextFile &file, Directory &directory)
+{
+	directory.device = 0;
+	directory.mtime = std::chrono::system_clock::time_point::min();
 
+	directory.ForEachSongSafe([&directory](Song &song){
+			directory.RemoveSong(&song);
+			song.Free();
+		});
+
+	directory.playlists.clear();
+
+	std::set<std::string> children;
+
+	const char *line;
 	while ((line = file.ReadLine()) != nullptr &&
 	       !StringStartsWith(line, DIRECTORY_END)) {
 		const char *p;
 		if ((p = StringAfterPrefix(line, DIRECTORY_DIR))) {
-			directory_load_subdir(file, directory, p);
+			if (directory.FindChild(p) == nullptr)
+				directory.CreateChild(p);
+
+			children.emplace(p);
 		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
 			const char *name = p;
 
@@ -172,8 +260,18 @@ directory_load(TextFile &file, Directory &directory)
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
 			const char *name = p;
 			playlist_metadata_load(file, directory.playlists, name);
-		} else {
+		} else if (!ParseLine(directory, line)) {
 			throw FormatRuntimeError("Malformed line: %s", line);
 		}
 	}
+
+	if (line == nullptr)
+		throw std::runtime_error("Unexpected end of file");
+
+	/* delete the children which are not listed anymore */
+	directory.ForEachChildSafe([&children](Directory &child){
+			if (!child.IsMount() &&
+			    children.find(child.GetName()) == children.end())
+				child.Delete();
+		});
 }
@@ -33,4 +33,24 @@ directory_save(BufferedOutputStream &os, const Directory &directory);
 void
 directory_load(TextFile &file, Directory &directory);
 
+/**
+ * Save the attributes, the names of the children, the songs and the
+ * playlists of the given directory, but not the contents of its
+ * children.  This is used for database journal records.
+ */
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * Replace the contents of an existing directory with a record written
+ * by directory_save_shallow().  Missing children are created (empty),
+ * and children which are not listed are deleted.
+ *
+ * Caller must lock the #db_mutex exclusively.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+directory_load_shallow(TextFile &file, Directory &directory);
+
 #endif
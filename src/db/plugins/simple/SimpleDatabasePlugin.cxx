@@ -21,6 +21,7 @@
 #include "SimpleDatabasePlugin.hxx"
 #include "PrefixedLightSong.hxx"
 #include "Mount.hxx"
+#include "AsyncQuery.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/Selection.hxx"
 #include "db/Helpers.hxx"
@@ -30,66 +31,159 @@
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
+#include "TagIndex.hxx"
+#include "StatsAggregate.hxx"
 #include "DatabaseSave.hxx"
+#include "BinaryDatabase.hxx"
+#include "DatabaseJournal.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
+#include "db/DatabaseListener.hxx"
 #include "tag/Mask.hxx"
 #include "fs/io/TextFile.hxx"
+#include "fs/io/MappedFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "event/TimerEvent.hxx"
+#include "thread/WorkerPool.hxx"
 #include "util/CharUtil.hxx"
+#include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
+#include "util/ScopeExit.hxx"
+#include "song/Filter.hxx"
 #include "Log.hxx"
+#include "util/Trace.hxx"
 
 #ifdef ENABLE_ZLIB
 #include "fs/io/GzipOutputStream.hxx"
 #endif
 
+#ifdef ENABLE_INOTIFY
+#include "db/update/InotifySource.hxx"
+
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <unordered_set>
+#include <vector>
 
 #include <errno.h>
+#include <string.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
-inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
+/**
+ * Below this number of songs, VisitParallel() is not worth the
+ * overhead.
+ */
+static constexpr size_t MIN_PARALLEL_SONGS = 4096;
+
+/**
+ * The number of songs evaluated by one VisitParallel() job.
+ */
+static constexpr size_t PARALLEL_JOB_SONGS = 1024;
+
+/**
+ * The default value of the "replica_interval" setting.
+ */
+static constexpr unsigned DEFAULT_REPLICA_INTERVAL_S = 30;
+
+/**
+ * How long a replica waits after an inotify event before it checks
+ * the database file; this lets the publisher finish writing the
+ * journal.
+ */
+static constexpr std::chrono::steady_clock::duration REPLICA_SETTLE_DELAY =
+	std::chrono::seconds(1);
+
+static AllocatedPath
+MakeJournalPath(Path path) noexcept
+{
+	return AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+				     PATH_LITERAL(".journal"));
+}
+
+static bool
+ParseFormat(const char *format)
+{
+	if (strcmp(format, "text") == 0)
+		return false;
+	else if (strcmp(format, "binary") == 0)
+		return true;
+	else
+		throw FormatRuntimeError("Unsupported database format: %s",
+					 format);
+}
+
+inline SimpleDatabase::SimpleDatabase(EventLoop &_event_loop,
+				      DatabaseListener &_listener,
+				      const ConfigBlock &block)
 	:Database(simple_db_plugin),
+	 event_loop(&_event_loop),
+	 listener(&_listener),
 	 path(block.GetPath("path")),
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
+	 binary(ParseFormat(block.GetBlockValue("format", "text"))),
+	 tag_index_enabled(block.GetBlockValue("tag_index", false)),
+	 journal(block.GetBlockValue("journal", false)),
+	 visit_threads(block.GetBlockValue("visit_threads", 0u)),
+	 query_threads(block.GetBlockValue("query_threads", 0u)),
+	 replica(block.GetBlockValue("replica", false)),
+	 replica_interval(std::chrono::seconds(block.GetBlockValue("replica_interval",
+								   DEFAULT_REPLICA_INTERVAL_S))),
 	 cache_path(block.GetPath("cache_directory")),
+	 journal_path(nullptr),
 	 prefixed_light_song(nullptr)
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
 
 	path_utf8 = path.ToUTF8();
+	journal_path = MakeJournalPath(path);
 }
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef ENABLE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress) noexcept
+				      bool _compress,
+				      bool _binary,
+				      bool _tag_index,
+				      bool _journal) noexcept
 	:Database(simple_db_plugin),
+	 event_loop(nullptr),
+	 listener(nullptr),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
+	 binary(_binary),
+	 tag_index_enabled(_tag_index),
+	 journal(_journal),
+	 visit_threads(0),
+	 query_threads(0),
+	 replica(false),
+	 replica_interval(std::chrono::steady_clock::duration::zero()),
 	 cache_path(nullptr),
+	 journal_path(MakeJournalPath(path)),
 	 prefixed_light_song(nullptr) {
 }
 
 Database *
-SimpleDatabase::Create(EventLoop &, EventLoop &,
-		       gcc_unused DatabaseListener &listener,
+SimpleDatabase::Create(EventLoop &main_event_loop, EventLoop &,
+		       DatabaseListener &listener,
 		       const ConfigBlock &block)
 {
-	return new SimpleDatabase(block);
+	return new SimpleDatabase(main_event_loop, listener, block);
 }
 
 void
@@ -146,20 +240,94 @@ SimpleDatabase::Check() const
 }
 
 void
-SimpleDatabase::Load()
+SimpleDatabase::Load(Directory &dest)
 {
 	assert(!path.IsNull());
-	assert(root != nullptr);
 
-	TextFile file(path);
+	const ScopeDatabasePrivateTree private_tree;
 
-	LogDebug(simple_db_domain, "reading DB");
+	{
+		const MappedFile mapped(path);
+		if (db_is_binary(mapped.GetData())) {
+			LogDebug(simple_db_domain, "reading binary DB");
 
-	db_load_internal(file, *root);
+			db_load_binary(mapped.GetData(), dest);
+		} else {
+			TextFile file(path);
 
-	FileInfo fi;
-	if (GetFileInfo(path, fi))
+			LogDebug(simple_db_domain, "reading DB");
+
+			db_load_internal(file, dest);
+		}
+	}
+
+	const FileInfo fi(path);
+	mtime = snapshot_mtime = fi.GetModificationTime();
+	snapshot_size = fi.GetSize();
+
+	FileInfo journal_fi;
+	if (GetFileInfo(journal_path, journal_fi)) {
+		LoadJournal(fi, dest);
+
+		/* remember the size even if the journal was unusable,
+		   so a replica doesn't load it again and again */
+		journal_size = journal_fi.GetSize();
+	} else
+		journal_size = 0;
+
+	/* loading has flagged all directories as modified */
+	dest.ClearModified();
+}
+
+void
+SimpleDatabase::LoadJournal(const FileInfo &snapshot,
+			    Directory &dest) noexcept
+{
+	try {
+		LogDebug(simple_db_domain, "reading DB journal");
+
+		if (!db_journal_load(journal_path, snapshot, dest)) {
+			LogDebug(simple_db_domain,
+				 "DB journal is stale or incomplete");
+			journal_invalid = true;
+			return;
+		}
+
+		const FileInfo fi(journal_path);
 		mtime = fi.GetModificationTime();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load the database journal");
+		journal_invalid = true;
+	}
+}
+
+void
+SimpleDatabase::RebuildTagIndex() noexcept
+{
+	if (!tag_index_enabled)
+		return;
+
+	const ScopeDatabaseSharedLock protect;
+	std::unique_ptr<TagIndex> new_index(new TagIndex(*root));
+
+	/* swap while still holding the database lock, so a concurrent
+	   Mount() cannot slip in between */
+	const std::lock_guard<Mutex> index_lock(tag_index_mutex);
+	tag_index = std::move(new_index);
+}
+
+void
+SimpleDatabase::BeginUpdate() noexcept
+{
+	const std::lock_guard<Mutex> protect(tag_index_mutex);
+	tag_index.reset();
+}
+
+void
+SimpleDatabase::EndUpdate() noexcept
+{
+	RebuildTagIndex();
 }
 
 void
@@ -175,18 +343,151 @@ SimpleDatabase::Open()
 #endif
 
 	try {
-		Load();
+		Load(*root);
 	} catch (...) {
 		LogError(std::current_exception());
 
 		delete root;
 
-		Check();
+		if (!replica)
+			/* a replica never writes the file */
+			Check();
 
 		root = Directory::NewRoot();
 	}
+
+	RebuildTagIndex();
+
+	if (visit_threads > 0)
+		visit_pool = std::make_unique<WorkerPool>("db_visit",
+							  visit_threads);
+
+	if (query_threads > 0 && event_loop != nullptr)
+		query_runner = std::make_unique<AsyncQueryRunner>(*event_loop,
+								  *this,
+								  query_threads);
+
+	if (replica)
+		StartReplica();
 }
 
+void
+SimpleDatabase::StartReplica() noexcept
+{
+	assert(replica);
+	assert(event_loop != nullptr);
+
+	replica_timer = std::make_unique<TimerEvent>(*event_loop,
+						     BIND_THIS_METHOD(OnReplicaTimer));
+
+#ifdef ENABLE_INOTIFY
+	/* watch the directory, because the publisher replaces the
+	   file instead of modifying it */
+	try {
+		auto inotify = std::make_unique<InotifySource>(*event_loop,
+							       OnReplicaInotify,
+							       this);
+		const auto directory = path.GetDirectoryName();
+		inotify->Add(directory.c_str(),
+			     IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE);
+		replica_inotify = std::move(inotify);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to watch the database file");
+	}
+#endif
+
+	if (replica_interval > std::chrono::steady_clock::duration::zero())
+		replica_timer->Schedule(replica_interval);
+}
+
+bool
+SimpleDatabase::IsSnapshotModified() const noexcept
+{
+	FileInfo fi;
+	if (!GetFileInfo(path, fi))
+		/* the publisher may be replacing the file right now;
+		   keep the current snapshot */
+		return false;
+
+	if (fi.GetModificationTime() != snapshot_mtime ||
+	    fi.GetSize() != snapshot_size)
+		return true;
+
+	FileInfo journal_fi;
+	const uint64_t new_journal_size =
+		GetFileInfo(journal_path, journal_fi)
+		? journal_fi.GetSize()
+		: 0;
+	return new_journal_size != journal_size;
+}
+
+void
+SimpleDatabase::ReloadReplica()
+{
+	assert(replica);
+	assert(listener != nullptr);
+
+	FormatDefault(simple_db_domain, "reloading database \"%s\"",
+		      path_utf8.c_str());
+
+	/* load into a separate tree, so a broken snapshot leaves the
+	   current one intact */
+	Directory *new_root = Directory::NewRoot();
+	AtScopeExit(&new_root) { delete new_root; };
+
+	Load(*new_root);
+
+	BeginUpdate();
+
+	{
+		const ScopeDatabaseLock protect;
+		std::swap(root, new_root);
+	}
+
+	/* the old tree is deleted by AtScopeExit; nobody can see it
+	   anymore, because all readers hold #db_mutex and
+	   VisitSongsAsync() copies its results */
+
+	RebuildTagIndex();
+
+	listener->OnDatabaseModified();
+}
+
+void
+SimpleDatabase::OnReplicaTimer() noexcept
+{
+	if (IsSnapshotModified()) {
+		try {
+			ReloadReplica();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to reload the database");
+		}
+	}
+
+	if (replica_interval > std::chrono::steady_clock::duration::zero())
+		replica_timer->Schedule(replica_interval);
+}
+
+#ifdef ENABLE_INOTIFY
+
+void
+SimpleDatabase::OnReplicaInotify(int, unsigned, const char *name,
+				 void *ctx) noexcept
+{
+	auto &db = *(SimpleDatabase *)ctx;
+
+	if (name == nullptr ||
+	    (strcmp(name, Path(db.path).GetBase().c_str()) != 0 &&
+	     strcmp(name, Path(db.journal_path).GetBase().c_str()) != 0))
+		return;
+
+	db.replica_timer->Schedule(REPLICA_SETTLE_DELAY);
+}
+
+#endif
+
 void
 SimpleDatabase::Close() noexcept
 {
@@ -194,6 +495,18 @@ SimpleDatabase::Close() noexcept
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+#ifdef ENABLE_INOTIFY
+	replica_inotify.reset();
+#endif
+	replica_timer.reset();
+
+	/* this waits for all pending queries, which may still use
+	   the tag index, the visit pool and the tree */
+	query_runner.reset();
+
+	tag_index.reset();
+	visit_pool.reset();
+
 	delete root;
 }
 
@@ -204,7 +517,7 @@ SimpleDatabase::GetSong(const char *uri) const
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	ScopeDatabaseLock protect;
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(uri);
 
@@ -266,6 +579,244 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const noexcept
 	}
 }
 
+/**
+ * Determine the length of the parent directory part of the given
+ * URI (without the trailing slash).
+ */
+gcc_pure
+static std::size_t
+GetParentLength(const char *uri) noexcept
+{
+	const char *slash = strrchr(uri, '/');
+	return slash != nullptr ? slash - uri : 0;
+}
+
+/**
+ * Resolve songs which are all in the given directory.
+ *
+ * @param skip the length of the directory prefix (including the
+ * slash) to be skipped in each URI
+ */
+static void
+VisitSongsInDirectory(const Directory &directory,
+		      ConstBuffer<const char *> uris, std::size_t skip,
+		      std::vector<std::size_t>::const_iterator begin,
+		      std::vector<std::size_t>::const_iterator end,
+		      const VisitSongIndex &visit)
+{
+	for (auto i = begin; i != end; ++i) {
+		const Song *song = directory.FindSong(uris[*i] + skip);
+		if (song != nullptr)
+			visit(*i, song->Export());
+	}
+}
+
+void
+SimpleDatabase::GetSongs(ConstBuffer<const char *> uris,
+			 const VisitSongIndex &visit) const
+{
+	assert(root != nullptr);
+
+	/* sort the URIs by their parent directory, so all songs of
+	   a directory are adjacent and each directory needs to be
+	   looked up only once */
+	std::vector<std::size_t> order(uris.size);
+	for (std::size_t i = 0; i < uris.size; ++i)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(),
+		  [uris](std::size_t a, std::size_t b){
+			  const char *x = uris[a], *y = uris[b];
+			  const std::size_t px = GetParentLength(x);
+			  const std::size_t py = GetParentLength(y);
+			  int c = memcmp(x, y, std::min(px, py));
+			  if (c != 0)
+				  return c < 0;
+			  if (px != py)
+				  return px < py;
+			  return strcmp(x + px, y + py) < 0;
+		  });
+
+	/* songs inside mounted databases, looked up after the lock
+	   has been released */
+	std::vector<std::size_t> mounted;
+
+	{
+		const ScopeDatabaseSharedLock protect;
+
+		for (auto begin = order.cbegin(), end = begin;
+		     begin != order.cend(); begin = end) {
+			const char *first = uris[*begin];
+			const std::size_t parent_length =
+				GetParentLength(first);
+
+			do {
+				++end;
+			} while (end != order.cend() &&
+				 GetParentLength(uris[*end]) == parent_length &&
+				 memcmp(uris[*end], first, parent_length) == 0);
+
+			const Directory *directory = root;
+			if (parent_length > 0) {
+				const std::string parent(first, parent_length);
+				const auto r = root->LookupDirectory(parent.c_str());
+				if (r.directory->IsMount()) {
+					mounted.insert(mounted.end(),
+						       begin, end);
+					continue;
+				}
+
+				if (r.uri != nullptr)
+					/* no such directory */
+					continue;
+
+				directory = r.directory;
+			}
+
+			VisitSongsInDirectory(*directory, uris,
+					      parent_length > 0
+					      ? parent_length + 1
+					      : 0,
+					      begin, end, visit);
+		}
+	}
+
+	for (std::size_t i : mounted) {
+		const LightSong *song;
+		try {
+			song = GetSong(uris[i]);
+		} catch (...) {
+			continue;
+		}
+
+		if (song == nullptr)
+			continue;
+
+		AtScopeExit(this, song) { ReturnSong(song); };
+		visit(i, *song);
+	}
+}
+
+static void
+WalkIndexed(const Directory &directory, bool recursive,
+	    const SongFilter &filter,
+	    const TagIndex::SongSet &songs,
+	    const std::unordered_set<const Directory *> &directories,
+	    const VisitSong &visit_song)
+{
+	for (const auto &song : directory.songs) {
+		if (songs.find(&song) == songs.end())
+			continue;
+
+		const LightSong song2 = song.Export();
+		if (filter.Match(song2))
+			visit_song(song2);
+	}
+
+	if (recursive)
+		for (const auto &child : directory.children)
+			if (directories.find(&child) != directories.end())
+				WalkIndexed(child, recursive, filter,
+					    songs, directories, visit_song);
+}
+
+bool
+SimpleDatabase::VisitIndexed(const Directory &directory, bool recursive,
+			     const SongFilter &filter,
+			     const VisitSong &visit_song) const
+{
+	assert(holding_db_lock());
+
+	TagIndex::SongSet songs;
+
+	{
+		const std::lock_guard<Mutex> protect(tag_index_mutex);
+		if (tag_index == nullptr ||
+		    !tag_index->FindCandidates(filter, songs))
+			return false;
+	}
+
+	/* collect the directories containing candidates (and their
+	   ancestors), so the walk can skip all others while still
+	   visiting songs in the usual order */
+
+	std::unordered_set<const Directory *> directories;
+	for (const Song *song : songs)
+		for (const Directory *d = song->parent;
+		     d != nullptr && directories.insert(d).second;
+		     d = d->parent) {}
+
+	WalkIndexed(directory, recursive, filter, songs, directories,
+		    visit_song);
+	return true;
+}
+
+/**
+ * Collect the songs which Directory::Walk() would visit, in the same
+ * order.
+ *
+ * @return false if there is a mount point, which needs to be visited
+ * by Directory::Walk()
+ */
+static bool
+CollectSongs(const Directory &directory, bool recursive,
+	     std::vector<const Song *> &songs)
+{
+	if (directory.IsMount())
+		return false;
+
+	for (const auto &song : directory.songs)
+		songs.push_back(&song);
+
+	if (recursive)
+		for (const auto &child : directory.children)
+			if (!CollectSongs(child, recursive, songs))
+				return false;
+
+	return true;
+}
+
+bool
+SimpleDatabase::VisitParallel(const Directory &directory, bool recursive,
+			      const SongFilter &filter,
+			      const VisitSong &visit_song) const
+{
+	assert(holding_db_lock());
+
+	if (visit_pool == nullptr)
+		return false;
+
+	std::vector<const Song *> songs;
+	if (!CollectSongs(directory, recursive, songs) ||
+	    songs.size() < MIN_PARALLEL_SONGS)
+		return false;
+
+	/* the workers only read the tree, which is protected by
+	   the shared lock held by this thread */
+	std::unique_ptr<bool[]> matches(new bool[songs.size()]);
+
+	WorkerPool::Group group;
+	for (size_t begin = 0; begin < songs.size();
+	     begin += PARALLEL_JOB_SONGS) {
+		const size_t end = std::min(begin + PARALLEL_JOB_SONGS,
+					    songs.size());
+		visit_pool->Push(group, [&songs, &matches, &filter, begin, end](){
+				for (size_t i = begin; i < end; ++i)
+					matches[i] = filter.Match(songs[i]->Export());
+			});
+	}
+
+	visit_pool->Wait(group);
+
+	/* the visitor is not thread-safe; invoke it in the
+	   original order */
+	for (size_t i = 0; i < songs.size(); ++i)
+		if (matches[i])
+			visit_song(songs[i]->Export());
+
+	return true;
+}
+
 gcc_const
 static DatabaseSelection
 CheckSelection(DatabaseSelection selection) noexcept
@@ -281,7 +832,17 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitSong visit_song,
 		      VisitPlaylist visit_playlist) const
 {
-	ScopeDatabaseLock protect;
+	const TraceSpan trace_span("db/visit");
+
+	const auto start_time = std::chrono::steady_clock::now();
+	AtScopeExit(this, start_time) {
+		const auto duration = std::chrono::steady_clock::now() -
+			start_time;
+		const std::lock_guard<Mutex> protect(visit_latency_mutex);
+		visit_latency.Add(duration);
+	};
+
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 
@@ -304,6 +865,16 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    selection.filter != nullptr &&
+		    (VisitIndexed(*r.directory, selection.recursive,
+				  *selection.filter, visit_song) ||
+		     VisitParallel(*r.directory, selection.recursive,
+				   *selection.filter, visit_song))) {
+			helper.Commit();
+			return;
+		}
+
 		r.directory->Walk(selection.recursive, selection.filter,
 				  visit_directory, visit_song,
 				  visit_playlist);
@@ -329,22 +900,191 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 			    "No such directory");
 }
 
+bool
+SimpleDatabase::VisitSongsAsync(const DatabaseSelection &selection,
+				DatabaseAsyncHandler &handler) const
+{
+	if (query_runner == nullptr)
+		return false;
+
+	query_runner->Submit(handler, selection);
+	return true;
+}
+
+void
+SimpleDatabase::CancelAsync(DatabaseAsyncHandler &handler) const noexcept
+{
+	if (query_runner != nullptr)
+		query_runner->Cancel(handler);
+}
+
 std::map<std::string, std::set<std::string>>
 SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				  TagType tag_type, TagType group) const
 {
+	/* an ungrouped "list" of the whole database can be answered
+	   from the tag index; everything else is handled by
+	   Visit(), which uses the index for filters on its own */
+	if (group == TAG_NUM_OF_ITEM_TYPES && selection.IsEmpty() &&
+	    selection.recursive && selection.window.IsAll()) {
+		std::set<std::string> values;
+
+		const ScopeDatabaseSharedLock protect;
+		const std::lock_guard<Mutex> index_lock(tag_index_mutex);
+		if (tag_index != nullptr &&
+		    tag_index->CollectValues(tag_type, values)) {
+			std::map<std::string, std::set<std::string>> result;
+			if (!tag_index->empty())
+				result.emplace(std::string(), std::move(values));
+			return result;
+		}
+	}
+
 	return ::CollectUniqueTags(*this, selection, tag_type, group);
 }
 
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (selection.recursive && selection.IsEmpty()) {
+		const ScopeDatabaseSharedLock protect;
+		/* songs of mounted databases are not in the
+		   aggregate */
+		if (!has_mounts)
+			return root->stats->Get();
+	}
+
 	return ::GetStats(*this, selection);
 }
 
+bool
+SimpleDatabase::GetGroupStats(const DatabaseSelection &selection,
+			      TagType group, GroupStatsMap &result) const
+{
+	if (!selection.uri.empty() || !selection.recursive ||
+	    /* the aggregate would not notice sticker changes */
+	    (selection.filter != nullptr && selection.filter->IsVolatile()))
+		return false;
+
+	const ScopeDatabaseSharedLock protect;
+
+	if (has_mounts)
+		return false;
+
+	StatsAggregate &stats = *root->stats;
+	const SongFilter *filter = selection.filter;
+	if (filter != nullptr && filter->IsEmpty())
+		filter = nullptr;
+
+	std::string key = filter != nullptr
+		? filter->ToExpression()
+		: std::string();
+
+	if (stats.GetGroups(group, key, result))
+		return true;
+
+	/* the first query for this group and filter visits the
+	   tree once; from now on, the result is updated along with
+	   the tree */
+
+	GroupAggregate aggregate(group, std::move(key), filter);
+	const VisitSong f = [&aggregate](const LightSong &song){
+		aggregate.AddMatching(song);
+	};
+
+	if (filter == nullptr ||
+	    !(VisitIndexed(*root, true, *filter, f) ||
+	      VisitParallel(*root, true, *filter, f)))
+		root->Walk(true, filter, VisitDirectory(), f,
+			   VisitPlaylist());
+
+	result = aggregate.GetMap();
+	stats.AddGroups(std::move(aggregate));
+	return true;
+}
+
+bool
+SimpleDatabase::UseJournal() const noexcept
+{
+	/* compact the journal (i.e. write a new database file) when
+	   it has grown larger than the database file */
+	return journal && FileExists() && !journal_invalid &&
+		journal_size < snapshot_size;
+}
+
+void
+SimpleDatabase::SaveJournal()
+{
+	std::vector<Directory *> directories;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		LogDebug(simple_db_domain, "removing empty directories from DB");
+		root->PruneEmpty();
+
+		root->VisitModified([&directories](Directory &directory){
+				directory.Sort(false);
+				directories.push_back(&directory);
+			});
+	}
+
+	if (directories.empty())
+		return;
+
+	FormatDebug(simple_db_domain, "writing %zu directories to DB journal",
+		    directories.size());
+
+	try {
+		FileOutputStream fos(journal_path,
+				     journal_size > 0
+				     ? FileOutputStream::Mode::APPEND_EXISTING
+				     : FileOutputStream::Mode::CREATE);
+		BufferedOutputStream bos(fos);
+
+		if (journal_size == 0)
+			db_journal_save_header(bos, FileInfo(path));
+
+		for (const auto *directory : directories)
+			db_journal_save(bos, *directory);
+
+		db_journal_commit(bos);
+		bos.Flush();
+		fos.Commit();
+	} catch (...) {
+		/* the modification flags have been cleared already;
+		   the next Save() must write everything */
+		journal_invalid = true;
+		throw;
+	}
+
+	const FileInfo fi(journal_path);
+	journal_size = fi.GetSize();
+	mtime = fi.GetModificationTime();
+}
+
+void
+SimpleDatabase::RemoveJournal() noexcept
+{
+	journal_size = 0;
+	journal_invalid = false;
+
+	try {
+		if (::FileExists(journal_path))
+			RemoveFile(journal_path);
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
 void
 SimpleDatabase::Save()
 {
+	if (UseJournal()) {
+		SaveJournal();
+		return;
+	}
+
 	{
 		const ScopeDatabaseLock protect;
 
@@ -353,6 +1093,9 @@ SimpleDatabase::Save()
 
 		LogDebug(simple_db_domain, "sorting DB");
 		root->Sort();
+
+		/* everything is going to be written */
+		root->ClearModified();
 	}
 
 	LogDebug(simple_db_domain, "writing DB");
@@ -363,7 +1106,9 @@ SimpleDatabase::Save()
 
 #ifdef ENABLE_ZLIB
 	std::unique_ptr<GzipOutputStream> gzip;
-	if (compress) {
+	if (compress && !binary) {
+		/* the binary format is not compressed, because it is
+		   loaded from a memory mapping */
 		gzip.reset(new GzipOutputStream(*os));
 		os = gzip.get();
 	}
@@ -371,7 +1116,10 @@ SimpleDatabase::Save()
 
 	BufferedOutputStream bos(*os);
 
-	db_save_internal(bos, *root);
+	if (binary)
+		db_save_binary(bos, *root);
+	else
+		db_save_internal(bos, *root);
 
 	bos.Flush();
 
@@ -384,9 +1132,11 @@ SimpleDatabase::Save()
 
 	fos.Commit();
 
-	FileInfo fi;
-	if (GetFileInfo(path, fi))
-		mtime = fi.GetModificationTime();
+	const FileInfo fi(path);
+	mtime = snapshot_mtime = fi.GetModificationTime();
+	snapshot_size = fi.GetSize();
+
+	RemoveJournal();
 }
 
 void
@@ -412,6 +1162,11 @@ SimpleDatabase::Mount(const char *uri, Database *db)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	has_mounts = true;
+
+	const std::lock_guard<Mutex> index_lock(tag_index_mutex);
+	if (tag_index != nullptr)
+		tag_index->SetHasMounts();
 }
 
 static constexpr bool
@@ -429,6 +1184,11 @@ IsUnsafeChar(char ch)
 void
 SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 {
+	if (replica)
+		/* the mounted database would need to be updated */
+		throw DatabaseError(DatabaseErrorCode::CONFLICT,
+				    "Cannot mount into a database replica");
+
 	if (cache_path.IsNull())
 		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 				    "No 'cache_directory' configured");
@@ -442,7 +1202,8 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	constexpr bool compress = false;
 #endif
 	auto db = new SimpleDatabase(cache_path / name_fs,
-				     compress);
+				     compress, binary, tag_index_enabled,
+				     journal);
 	try {
 		db->Open();
 	} catch (...) {
@@ -484,6 +1245,12 @@ SimpleDatabase::Unmount(const char *uri) noexcept
 	if (db == nullptr)
 		return false;
 
+	if (query_runner != nullptr)
+		/* Visit() walks mounted databases without holding
+		   #db_mutex; wait until no query can still be using
+		   this one */
+		query_runner->WaitIdle();
+
 	db->Close();
 	delete db;
 	return true;
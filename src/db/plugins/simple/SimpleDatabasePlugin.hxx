@@ -21,22 +21,47 @@
 #define MPD_SIMPLE_DATABASE_PLUGIN_HXX
 
 #include "db/Interface.hxx"
+#include "db/Stats.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "song/LightSong.hxx"
+#include "LatencyHistogram.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Manual.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
+#include <memory>
+
 #include <cassert>
 
 struct ConfigBlock;
+class FileInfo;
 struct Directory;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
 class PrefixedLightSong;
+class SongFilter;
+class TagIndex;
+class WorkerPool;
+class AsyncQueryRunner;
+class TimerEvent;
+class InotifySource;
 
 class SimpleDatabase : public Database {
+	/**
+	 * The #EventLoop which receives the results of
+	 * VisitSongsAsync(); nullptr for mounted databases, which do
+	 * not support asynchronous queries.
+	 */
+	EventLoop *const event_loop;
+
+	/**
+	 * Receives OnDatabaseModified() after a replica has been
+	 * reloaded; nullptr for mounted databases.
+	 */
+	DatabaseListener *const listener;
+
 	AllocatedPath path;
 	std::string path_utf8;
 
@@ -44,15 +69,149 @@ class SimpleDatabase : public Database {
 	bool compress;
 #endif
 
+	/**
+	 * Save the database in the binary format (see
+	 * db_save_binary())?  Loading auto-detects the format.
+	 */
+	bool binary;
+
+	/**
+	 * Maintain a #TagIndex?
+	 */
+	bool tag_index_enabled;
+
+	/**
+	 * Append modifications to #journal_path instead of rewriting
+	 * the whole database file after each update (the "journal"
+	 * setting)?
+	 */
+	bool journal;
+
+	/**
+	 * The number of threads evaluating filters in Visit() (the
+	 * "visit_threads" setting); 0 disables parallel visits.
+	 */
+	unsigned visit_threads;
+
+	/**
+	 * The number of threads evaluating VisitSongsAsync() calls
+	 * (the "query_threads" setting); 0 disables asynchronous
+	 * queries.
+	 */
+	unsigned query_threads;
+
+	/**
+	 * Is this a read-only replica of a database file written by
+	 * another MPD instance (the "replica" setting)?  Then the
+	 * database is never updated or saved; instead, a new
+	 * snapshot is loaded whenever the file changes.
+	 */
+	bool replica;
+
+	/**
+	 * How often a replica checks the database file for changes
+	 * (the "replica_interval" setting).  This is needed where
+	 * inotify does not see the publisher's writes (e.g. on NFS);
+	 * zero disables polling.
+	 */
+	std::chrono::steady_clock::duration replica_interval;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
 	AllocatedPath cache_path;
 
+	/**
+	 * The database journal (see DatabaseJournal.hxx).  It is
+	 * replayed by Load() even if #journal is disabled.
+	 */
+	AllocatedPath journal_path;
+
+	/**
+	 * The size of the database file; used to decide when the
+	 * journal shall be compacted.
+	 */
+	uint64_t snapshot_size = 0;
+
+	/**
+	 * The size of the journal file; 0 if there is none.
+	 */
+	uint64_t journal_size = 0;
+
+	/**
+	 * Is the journal unusable (e.g. because an earlier write has
+	 * failed), i.e. must the next Save() write the whole
+	 * database file?
+	 */
+	bool journal_invalid = false;
+
+	/**
+	 * The modification time of the database file as of the last
+	 * Load() or Save().
+	 */
+	std::chrono::system_clock::time_point snapshot_mtime;
+
 	Directory *root;
 
 	std::chrono::system_clock::time_point mtime;
 
+	/**
+	 * Has a database ever been mounted into the tree?  Then
+	 * GetStats() cannot use the root's #StatsAggregate.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	bool has_mounts = false;
+
+	/**
+	 * Protects #tag_index.
+	 */
+	mutable Mutex tag_index_mutex;
+
+	/**
+	 * The tag index, or nullptr if it is disabled or while the
+	 * database is being updated.
+	 */
+	std::unique_ptr<TagIndex> tag_index;
+
+	/**
+	 * The threads for VisitParallel(); nullptr if
+	 * #visit_threads is 0.
+	 */
+	std::unique_ptr<WorkerPool> visit_pool;
+
+	/**
+	 * Evaluates VisitSongsAsync() calls; nullptr if
+	 * #query_threads is 0.
+	 */
+	std::unique_ptr<AsyncQueryRunner> query_runner;
+
+	/**
+	 * Checks the database file of a replica for changes; nullptr
+	 * if this is not a replica.
+	 */
+	std::unique_ptr<TimerEvent> replica_timer;
+
+#ifdef ENABLE_INOTIFY
+	/**
+	 * Watches the directory containing the database file of a
+	 * replica; nullptr if this is not a replica or if inotify
+	 * could not be initialized.
+	 */
+	std::unique_ptr<InotifySource> replica_inotify;
+#endif
+
+	/**
+	 * Protects #visit_latency.
+	 */
+	mutable Mutex visit_latency_mutex;
+
+	/**
+	 * The durations of all Visit() calls (for the metrics
+	 * endpoint).
+	 */
+	mutable LatencyHistogram visit_latency;
+
 	/**
 	 * A buffer for GetSong() when prefixing the #LightSong
 	 * instance from a mounted #Database.
@@ -68,9 +227,11 @@ class SimpleDatabase : public Database {
 	mutable unsigned borrowed_song_count;
 #endif
 
-	SimpleDatabase(const ConfigBlock &block);
+	SimpleDatabase(EventLoop &_event_loop, DatabaseListener &_listener,
+		       const ConfigBlock &block);
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress) noexcept;
+	SimpleDatabase(AllocatedPath &&_path, bool _compress,
+		       bool _binary, bool _tag_index, bool _journal) noexcept;
 
 public:
 	static Database *Create(EventLoop &main_event_loop,
@@ -78,6 +239,15 @@ public:
 				DatabaseListener &listener,
 				const ConfigBlock &block);
 
+	/**
+	 * Returns a copy of the Visit() duration histogram.
+	 */
+	gcc_pure
+	LatencyHistogram GetVisitLatency() const noexcept {
+		const std::lock_guard<Mutex> protect(visit_latency_mutex);
+		return visit_latency;
+	}
+
 	gcc_pure
 	Directory &GetRoot() noexcept {
 		assert(root != NULL);
@@ -85,8 +255,34 @@ public:
 		return *root;
 	}
 
+	/**
+	 * Is this a read-only replica (the "replica" setting)?  Then
+	 * it must not be updated.
+	 */
+	bool IsReplica() const noexcept {
+		return replica;
+	}
+
+	/**
+	 * Write all modifications since the last call to the
+	 * database file, or append them to the journal.
+	 *
+	 * Throws on error.
+	 */
 	void Save();
 
+	/**
+	 * Called by the update thread before it modifies the
+	 * #Directory tree.  This discards the #TagIndex.
+	 */
+	void BeginUpdate() noexcept;
+
+	/**
+	 * Called by the update thread after it has finished modifying
+	 * the #Directory tree.  This rebuilds the #TagIndex.
+	 */
+	void EndUpdate() noexcept;
+
 	/**
 	 * Returns true if there is a valid database file on the disk.
 	 */
@@ -117,6 +313,9 @@ public:
 	const LightSong *GetSong(const char *uri_utf8) const override;
 	void ReturnSong(const LightSong *song) const noexcept override;
 
+	void GetSongs(ConstBuffer<const char *> uris,
+		      const VisitSongIndex &visit) const override;
+
 	void Visit(const DatabaseSelection &selection,
 		   VisitDirectory visit_directory,
 		   VisitSong visit_song,
@@ -128,6 +327,13 @@ public:
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
+	bool GetGroupStats(const DatabaseSelection &selection, TagType group,
+			   GroupStatsMap &result) const override;
+
+	bool VisitSongsAsync(const DatabaseSelection &selection,
+			     DatabaseAsyncHandler &handler) const override;
+	void CancelAsync(DatabaseAsyncHandler &handler) const noexcept override;
+
 	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
 		return mtime;
 	}
@@ -138,9 +344,99 @@ private:
 	void Check() const;
 
 	/**
+	 * Load the database file (and its journal) into the given
+	 * (empty) root #Directory, which must not be visible to other
+	 * threads yet; therefore, #db_mutex is not locked, and readers
+	 * of the current tree are not blocked while parsing.
+	 *
 	 * Throws #std::runtime_error on error.
 	 */
-	void Load();
+	void Load(Directory &dest);
+
+	/**
+	 * Replay the journal after Load() has loaded the database
+	 * file.  Errors are logged.
+	 */
+	void LoadJournal(const FileInfo &snapshot, Directory &dest) noexcept;
+
+	/**
+	 * Start watching the database file of a replica.
+	 */
+	void StartReplica() noexcept;
+
+	/**
+	 * Has the database file (or its journal) changed since the
+	 * last Load()?
+	 */
+	gcc_pure
+	bool IsSnapshotModified() const noexcept;
+
+	/**
+	 * Load the new snapshot into a new #Directory tree and swap
+	 * it with #root.  On error, the old tree remains.
+	 *
+	 * Throws on error.
+	 */
+	void ReloadReplica();
+
+	/* callback for #replica_timer */
+	void OnReplicaTimer() noexcept;
+
+#ifdef ENABLE_INOTIFY
+	static void OnReplicaInotify(int wd, unsigned mask,
+				     const char *name, void *ctx) noexcept;
+#endif
+
+	/**
+	 * Shall Save() append to the journal instead of writing the
+	 * database file?
+	 */
+	gcc_pure
+	bool UseJournal() const noexcept;
+
+	/**
+	 * Append the modified directories to the journal.
+	 *
+	 * Throws on error.
+	 */
+	void SaveJournal();
+
+	/**
+	 * Delete the journal after the database file has been
+	 * written.
+	 */
+	void RemoveJournal() noexcept;
+
+	/**
+	 * Build a new #TagIndex (if enabled) and replace the current
+	 * one.
+	 */
+	void RebuildTagIndex() noexcept;
+
+	/**
+	 * Attempt to visit the songs matching the given filter with
+	 * the help of the #TagIndex.
+	 *
+	 * Caller must hold a shared lock on #db_mutex.
+	 *
+	 * @return false if the index cannot be used for this filter
+	 */
+	bool VisitIndexed(const Directory &directory, bool recursive,
+			  const SongFilter &filter,
+			  const VisitSong &visit_song) const;
+
+	/**
+	 * Attempt to evaluate the filter on #visit_pool, and then
+	 * visit the matching songs in the usual order.
+	 *
+	 * Caller must hold a shared lock on #db_mutex.
+	 *
+	 * @return false if parallel visits are disabled or not
+	 * worth it for this directory
+	 */
+	bool VisitParallel(const Directory &directory, bool recursive,
+			   const SongFilter &filter,
+			   const VisitSong &visit_song) const;
 
 	Database *LockUmountSteal(const char *uri) noexcept;
 };
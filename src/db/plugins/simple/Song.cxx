@@ -19,11 +19,14 @@
 
 #include "Song.hxx"
 #include "Directory.hxx"
+#include "SongArena.hxx"
 #include "tag/Tag.hxx"
 #include "util/VarSize.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 
+#include <new>
+
 #include <assert.h>
 #include <string.h>
 
@@ -38,7 +41,7 @@ inline Song::~Song()
 }
 
 static Song *
-song_alloc(const char *uri, Directory &parent)
+song_alloc(const char *uri, Directory &parent, SongArena *arena)
 {
 	size_t uri_length;
 
@@ -46,32 +49,50 @@ song_alloc(const char *uri, Directory &parent)
 	uri_length = strlen(uri);
 	assert(uri_length);
 
+	if (arena != nullptr) {
+		SongArenaChunk *chunk;
+		void *p = arena->Allocate(sizeof(Song) - sizeof(Song::uri) +
+					  uri_length + 1, chunk);
+		if (p != nullptr) {
+			Song *song = new(p) Song(uri, uri_length, parent);
+			song->arena_chunk = chunk;
+			return song;
+		}
+	}
+
 	return NewVarSize<Song>(sizeof(Song::uri),
 				uri_length + 1,
 				uri, uri_length, parent);
 }
 
 Song *
-Song::NewFrom(DetachedSong &&other, Directory &parent)
+Song::NewFrom(DetachedSong &&other, Directory &parent, SongArena *arena)
 {
-	Song *song = song_alloc(other.GetURI(), parent);
+	Song *song = song_alloc(other.GetURI(), parent, arena);
 	song->tag = std::move(other.WritableTag());
 	song->mtime = other.GetLastModified();
 	song->start_time = other.GetStartTime();
 	song->end_time = other.GetEndTime();
+	song->replay_gain = other.GetReplayGain();
+	song->mix_ramp = other.GetMixRamp();
 	return song;
 }
 
 Song *
-Song::NewFile(const char *path, Directory &parent)
+Song::NewFile(const char *path, Directory &parent, SongArena *arena)
 {
-	return song_alloc(path, parent);
+	return song_alloc(path, parent, arena);
 }
 
 void
 Song::Free()
 {
-	DeleteVarSize(this);
+	if (arena_chunk != nullptr) {
+		SongArenaChunk *chunk = arena_chunk;
+		this->~Song();
+		SongArena::Release(chunk);
+	} else
+		DeleteVarSize(this);
 }
 
 std::string
@@ -104,5 +125,7 @@ Song::Export() const noexcept
 	dest.start_time = start_time;
 	dest.end_time = end_time;
 	dest.audio_format = audio_format;
+	dest.replay_gain = replay_gain;
+	dest.mix_ramp = &mix_ramp;
 	return dest;
 }
@@ -23,6 +23,8 @@
 #include "Chrono.hxx"
 #include "tag/Tag.hxx"
 #include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
@@ -37,6 +39,9 @@ struct Directory;
 class DetachedSong;
 class Storage;
 class ArchiveFile;
+class TagScanCache;
+class SongArena;
+struct SongArenaChunk;
 
 /**
  * A song file inside the configured music directory.  Internal
@@ -95,6 +100,26 @@ struct Song {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * ReplayGain values measured by the loudness scanner (or
+	 * copied from the file's tags by it).  Undefined if the file
+	 * has not been scanned yet.
+	 */
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
+	/**
+	 * The MixRamp profile measured by the loudness scanner (or
+	 * copied from the file's tags by it).  Undefined if the file
+	 * has not been scanned yet.
+	 */
+	MixRampInfo mix_ramp;
+
+	/**
+	 * The #SongArena chunk this object was allocated from, or
+	 * nullptr if it was allocated on the heap.
+	 */
+	SongArenaChunk *arena_chunk = nullptr;
+
 	/**
 	 * The file name.
 	 */
@@ -104,24 +129,35 @@ struct Song {
 	~Song();
 
 	gcc_malloc gcc_returns_nonnull
-	static Song *NewFrom(DetachedSong &&other, Directory &parent);
+	static Song *NewFrom(DetachedSong &&other, Directory &parent,
+			     SongArena *arena=nullptr);
 
-	/** allocate a new song with a local file name */
+	/**
+	 * allocate a new song with a local file name
+	 *
+	 * @param arena an optional arena to allocate from (used while
+	 * loading the database)
+	 */
 	gcc_malloc gcc_returns_nonnull
-	static Song *NewFile(const char *path_utf8, Directory &parent);
+	static Song *NewFile(const char *path_utf8, Directory &parent,
+			     SongArena *arena=nullptr);
 
 	/**
 	 * allocate a new song structure with a local file name and attempt to
 	 * load its metadata.  If all decoder plugin fail to read its meta
 	 * data, nullptr is returned.
+	 *
+	 * @param tag_cache an optional cache of tag scan results
 	 */
 	gcc_malloc
 	static Song *LoadFile(Storage &storage, const char *name_utf8,
-			      Directory &parent) noexcept;
+			      Directory &parent,
+			      TagScanCache *tag_cache=nullptr) noexcept;
 
 	void Free();
 
-	bool UpdateFile(Storage &storage) noexcept;
+	bool UpdateFile(Storage &storage,
+			TagScanCache *tag_cache=nullptr) noexcept;
 
 #ifdef ENABLE_ARCHIVE
 	static Song *LoadFromArchive(ArchiveFile &archive,
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SongArena.hxx"
+#include "util/Alloc.hxx"
+
+#include <atomic>
+#include <new>
+
+#include <assert.h>
+#include <stdlib.h>
+
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+struct alignas(max_align_t) SongArenaChunk {
+	/**
+	 * The number of live objects plus one if this is the
+	 * #SongArena's current chunk.
+	 */
+	std::atomic_uint ref{1};
+
+	size_t fill = 0;
+
+	static constexpr size_t Capacity() noexcept {
+		return CHUNK_SIZE - sizeof(SongArenaChunk);
+	}
+
+	static SongArenaChunk *New() noexcept {
+		return new(xalloc(CHUNK_SIZE)) SongArenaChunk();
+	}
+
+	void Unref() noexcept {
+		if (ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			this->~SongArenaChunk();
+			free(this);
+		}
+	}
+
+	void *Allocate(size_t size) noexcept {
+		/* keep all objects aligned */
+		size = (size + alignof(max_align_t) - 1)
+			& ~(alignof(max_align_t) - 1);
+
+		if (size > Capacity() - fill)
+			return nullptr;
+
+		void *p = (char *)(this + 1) + fill;
+		fill += size;
+		ref.fetch_add(1, std::memory_order_relaxed);
+		return p;
+	}
+};
+
+SongArena::~SongArena() noexcept
+{
+	if (current != nullptr)
+		current->Unref();
+}
+
+void *
+SongArena::Allocate(size_t size, SongArenaChunk *&chunk_r) noexcept
+{
+	if (size > SongArenaChunk::Capacity() / 4)
+		return nullptr;
+
+	void *p = current != nullptr
+		? current->Allocate(size)
+		: nullptr;
+	if (p == nullptr) {
+		/* start a new chunk */
+		if (current != nullptr)
+			current->Unref();
+
+		current = SongArenaChunk::New();
+		p = current->Allocate(size);
+		assert(p != nullptr);
+	}
+
+	chunk_r = current;
+	return p;
+}
+
+void
+SongArena::Release(SongArenaChunk *chunk) noexcept
+{
+	assert(chunk != nullptr);
+
+	chunk->Unref();
+}
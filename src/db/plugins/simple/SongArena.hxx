@@ -0,0 +1,67 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SONG_ARENA_HXX
+#define MPD_SONG_ARENA_HXX
+
+#include "util/Compiler.h"
+
+#include <stddef.h>
+
+struct SongArenaChunk;
+
+/**
+ * A bump allocator for #Song objects which are created in one go
+ * while loading the database.  Songs of the same directory end up
+ * next to each other in memory, which makes walking the tree
+ * cache-friendly.
+ *
+ * Each chunk counts the objects allocated from it and is freed
+ * when the last one is released; the #SongArena object itself may
+ * be destroyed as soon as loading is finished.
+ */
+class SongArena {
+	SongArenaChunk *current = nullptr;
+
+public:
+	SongArena() = default;
+	~SongArena() noexcept;
+
+	SongArena(const SongArena &) = delete;
+	SongArena &operator=(const SongArena &) = delete;
+
+	/**
+	 * Allocate memory for one object.
+	 *
+	 * @param chunk_r receives the chunk which must later be
+	 * passed to Release()
+	 * @return the memory or nullptr if the object is too large
+	 * for the arena (the caller shall use the heap instead)
+	 */
+	gcc_malloc
+	void *Allocate(size_t size, SongArenaChunk *&chunk_r) noexcept;
+
+	/**
+	 * Release an object allocated by Allocate().  Its destructor
+	 * must have been called already.
+	 */
+	static void Release(SongArenaChunk *chunk) noexcept;
+};
+
+#endif
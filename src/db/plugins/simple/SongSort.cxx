@@ -20,31 +20,44 @@
 #include "SongSort.hxx"
 #include "Song.hxx"
 #include "tag/Tag.hxx"
+#include "tag/Pool.hxx"
 #include "lib/icu/Collate.hxx"
 
 #include <stdlib.h>
+#include <string.h>
 
-static int
-compare_utf8_string(const char *a, const char *b) noexcept
+/**
+ * Returns the collation key (see tag_pool_get_collate_key()) of the
+ * first item with the given type, or nullptr if there is none.
+ */
+gcc_pure
+static const char *
+get_collate_key(const Tag &tag, TagType type) noexcept
 {
-	if (a == nullptr)
-		return b == nullptr ? 0 : -1;
-
-	if (b == nullptr)
-		return 1;
+	for (const auto &item : tag)
+		if (item.type == type)
+			return tag_pool_get_collate_key(item);
 
-	return IcuCollate(a, b);
+	return nullptr;
 }
 
 /**
  * Compare two string tag values, ignoring case.  Either one may be
- * nullptr.
+ * missing.
  */
 static int
 compare_string_tag_item(const Tag &a, const Tag &b, TagType type) noexcept
 {
-	return compare_utf8_string(a.GetValue(type),
-				   b.GetValue(type));
+	const char *a_key = get_collate_key(a, type);
+	const char *b_key = get_collate_key(b, type);
+
+	if (a_key == nullptr)
+		return b_key == nullptr ? 0 : -1;
+
+	if (b_key == nullptr)
+		return 1;
+
+	return strcmp(a_key, b_key);
 }
 
 /**
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "StatsAggregate.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Tag.hxx"
+#include "tag/VisitFallback.hxx"
+
+#include <assert.h>
+
+static void
+Ref(std::unordered_map<std::string, unsigned> &map,
+    const char *value) noexcept
+{
+	++map[value];
+}
+
+static void
+Unref(std::unordered_map<std::string, unsigned> &map,
+      const char *value) noexcept
+{
+	auto i = map.find(value);
+	assert(i != map.end());
+	if (i == map.end())
+		return;
+
+	assert(i->second > 0);
+	if (--i->second == 0)
+		map.erase(i);
+}
+
+GroupAggregate::GroupAggregate(TagType _group, std::string &&_key,
+			       const SongFilter *_filter) noexcept
+	:group(_group), key(std::move(_key)),
+	 filter(_filter != nullptr && !_filter->IsEmpty()
+		? _filter->Clone()
+		: nullptr)
+{
+}
+
+inline bool
+GroupAggregate::Match(const LightSong &song) const noexcept
+{
+	return filter == nullptr || filter->Match(song);
+}
+
+/**
+ * Invoke the function for each group the song belongs to, passing
+ * the duration to be accounted (the same as PrintSongCount() when
+ * visiting the selection).
+ */
+template<typename F>
+static void
+VisitGroup(const LightSong &song, TagType group, F &&f) noexcept
+{
+	if (group == TAG_NUM_OF_ITEM_TYPES) {
+		/* no grouping */
+		f("", song.GetDuration());
+		return;
+	}
+
+	const auto duration = song.tag.duration;
+	VisitTagWithFallbackOrEmpty(song.tag, group,
+				    [&f, duration](const char *value){
+					    f(value, duration);
+				    });
+}
+
+void
+GroupAggregate::AddMatching(const LightSong &song) noexcept
+{
+	VisitGroup(song, group, [this](const char *value,
+				       SignedSongTime duration){
+			SearchStats &s = map[value];
+			++s.n_songs;
+			if (!duration.IsNegative())
+				s.total_duration += duration;
+		});
+}
+
+void
+GroupAggregate::Add(const Song &song) noexcept
+{
+	const LightSong song2 = song.Export();
+	if (Match(song2))
+		AddMatching(song2);
+}
+
+void
+GroupAggregate::Remove(const Song &song) noexcept
+{
+	const LightSong song2 = song.Export();
+	if (!Match(song2))
+		return;
+
+	VisitGroup(song2, group, [this](const char *value,
+					SignedSongTime duration){
+			auto i = map.find(value);
+			assert(i != map.end());
+			if (i == map.end())
+				return;
+
+			SearchStats &s = i->second;
+			if (!duration.IsNegative())
+				s.total_duration -= duration;
+
+			assert(s.n_songs > 0);
+			if (--s.n_songs == 0)
+				map.erase(i);
+		});
+}
+
+void
+StatsAggregate::AddTag(const Tag &tag) noexcept
+{
+	if (!tag.duration.IsNegative())
+		total_duration += tag.duration;
+
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			Ref(artists, item.value);
+			break;
+
+		case TAG_ALBUM:
+			Ref(albums, item.value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+void
+StatsAggregate::RemoveTag(const Tag &tag) noexcept
+{
+	if (!tag.duration.IsNegative())
+		total_duration -= tag.duration;
+
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			Unref(artists, item.value);
+			break;
+
+		case TAG_ALBUM:
+			Unref(albums, item.value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+void
+StatsAggregate::Add(const Song &song) noexcept
+{
+	++song_count;
+	AddTag(song.tag);
+
+	for (auto &i : groups)
+		i.Add(song);
+}
+
+void
+StatsAggregate::Remove(const Song &song) noexcept
+{
+	assert(song_count > 0);
+
+	--song_count;
+	RemoveTag(song.tag);
+
+	for (auto &i : groups)
+		i.Remove(song);
+}
+
+void
+StatsAggregate::Remove(const Directory &directory) noexcept
+{
+	for (const auto &child : directory.children)
+		Remove(child);
+
+	for (const auto &song : directory.songs)
+		Remove(song);
+}
+
+DatabaseStats
+StatsAggregate::Get() const noexcept
+{
+	DatabaseStats stats;
+	stats.song_count = song_count;
+	stats.total_duration = total_duration;
+	stats.artist_count = artists.size();
+	stats.album_count = albums.size();
+	return stats;
+}
+
+bool
+StatsAggregate::GetGroups(TagType group, const std::string &key,
+			  GroupStatsMap &result) noexcept
+{
+	const std::lock_guard<Mutex> protect(groups_mutex);
+
+	for (auto i = groups.begin(); i != groups.end(); ++i) {
+		if (i->IsKey(group, key)) {
+			/* move to the front */
+			groups.splice(groups.begin(), groups, i);
+			result = i->GetMap();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+StatsAggregate::AddGroups(GroupAggregate &&group) noexcept
+{
+	const std::lock_guard<Mutex> protect(groups_mutex);
+
+	for (const auto &i : groups)
+		if (i.IsKey(group.GetGroup(), group.GetKey()))
+			/* a concurrent query was faster */
+			return;
+
+	groups.emplace_front(std::move(group));
+
+	if (groups.size() > MAX_GROUPS)
+		groups.pop_back();
+}
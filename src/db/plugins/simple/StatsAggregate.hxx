@@ -0,0 +1,173 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STATS_AGGREGATE_HXX
+#define MPD_STATS_AGGREGATE_HXX
+
+#include "db/Stats.hxx"
+#include "song/ISongFilter.hxx"
+#include "tag/Type.h"
+#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+struct Tag;
+struct Song;
+struct LightSong;
+struct Directory;
+class SongFilter;
+
+/**
+ * The result of one "count ... group" query (a group tag and a
+ * filter), maintained incrementally by #StatsAggregate.
+ */
+class GroupAggregate {
+	const TagType group;
+
+	/**
+	 * The filter expression (see SongFilter::ToExpression()).
+	 */
+	const std::string key;
+
+	/**
+	 * A copy of the filter; nullptr matches all songs.
+	 */
+	ISongFilterPtr filter;
+
+	GroupStatsMap map;
+
+public:
+	GroupAggregate(TagType _group, std::string &&_key,
+		       const SongFilter *_filter) noexcept;
+
+	TagType GetGroup() const noexcept {
+		return group;
+	}
+
+	const std::string &GetKey() const noexcept {
+		return key;
+	}
+
+	gcc_pure
+	bool IsKey(TagType _group, const std::string &_key) const noexcept {
+		return group == _group && key == _key;
+	}
+
+	const GroupStatsMap &GetMap() const noexcept {
+		return map;
+	}
+
+	/**
+	 * Add a song which is known to match the filter.
+	 */
+	void AddMatching(const LightSong &song) noexcept;
+
+	void Add(const Song &song) noexcept;
+	void Remove(const Song &song) noexcept;
+
+private:
+	gcc_pure
+	bool Match(const LightSong &song) const noexcept;
+};
+
+/**
+ * The #DatabaseStats of a #Directory tree, maintained incrementally
+ * while songs are added and removed, so "stats" does not need to
+ * visit all songs.  The distinct artist and album names are
+ * reference-counted, so removing a song can tell whether it was the
+ * last one carrying a value.
+ *
+ * This object is owned by the root #Directory and is protected by
+ * the global #db_mutex.
+ */
+class StatsAggregate {
+	/**
+	 * Maps a tag value to the number of songs containing it.
+	 * The keys are copies, because the #TagItem objects of one
+	 * song may be freed while others still share the value.
+	 */
+	typedef std::unordered_map<std::string, unsigned> Map;
+
+	Map artists, albums;
+
+	unsigned song_count = 0;
+
+	std::chrono::duration<std::uint64_t,
+			      SongTime::period> total_duration =
+		std::chrono::duration<std::uint64_t,
+				      SongTime::period>::zero();
+
+	/**
+	 * The number of #GroupAggregate instances kept; the least
+	 * recently used one is discarded when another is added.
+	 */
+	static constexpr size_t MAX_GROUPS = 16;
+
+	/**
+	 * Protects the #groups list against concurrent queries,
+	 * which hold only a shared lock on #db_mutex.
+	 */
+	Mutex groups_mutex;
+
+	/**
+	 * The aggregates for recent "count" queries, the most
+	 * recently used one first.
+	 */
+	std::list<GroupAggregate> groups;
+
+public:
+	void Add(const Song &song) noexcept;
+	void Remove(const Song &song) noexcept;
+
+	/**
+	 * Remove all songs of the given tree (recursively).
+	 */
+	void Remove(const Directory &directory) noexcept;
+
+	gcc_pure
+	DatabaseStats Get() const noexcept;
+
+	/**
+	 * Copy the result of the #GroupAggregate with the given
+	 * group tag and filter expression.
+	 *
+	 * Caller must hold a shared lock on #db_mutex.
+	 *
+	 * @return false if there is no such #GroupAggregate
+	 */
+	bool GetGroups(TagType group, const std::string &key,
+		       GroupStatsMap &result) noexcept;
+
+	/**
+	 * Keep a #GroupAggregate which was built from the current
+	 * tree.
+	 *
+	 * Caller must hold a shared lock on #db_mutex.
+	 */
+	void AddGroups(GroupAggregate &&group) noexcept;
+
+private:
+	void AddTag(const Tag &tag) noexcept;
+	void RemoveTag(const Tag &tag) noexcept;
+};
+
+#endif
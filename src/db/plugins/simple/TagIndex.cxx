@@ -0,0 +1,183 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Fallback.hxx"
+
+#include <assert.h>
+
+TagIndex::TagIndex(const Directory &root) noexcept
+{
+	assert(holding_db_lock());
+
+	Add(root);
+}
+
+inline void
+TagIndex::Add(const Song &song) noexcept
+{
+	++n_songs;
+
+	for (const auto &item : song.tag) {
+		auto &list = maps[item.type][item.value];
+
+		/* the same value may occur twice in one song */
+		if (list.empty() || list.back() != &song)
+			list.push_back(&song);
+	}
+}
+
+void
+TagIndex::Add(const Directory &directory) noexcept
+{
+	if (directory.IsMount())
+		has_mounts = true;
+
+	for (const auto &song : directory.songs)
+		Add(song);
+
+	for (const auto &child : directory.children)
+		Add(child);
+}
+
+const TagIndex::PostingList *
+TagIndex::Find(TagType type, const char *value) const noexcept
+{
+	assert(type < TAG_NUM_OF_ITEM_TYPES);
+
+	const auto &map = maps[type];
+	auto i = map.find(value);
+	return i != map.end()
+		? &i->second
+		: nullptr;
+}
+
+/**
+ * Can this filter item be resolved from the index?
+ */
+gcc_pure
+static bool
+IsIndexable(const TagSongFilter &f) noexcept
+{
+	return f.GetTagType() != TAG_NUM_OF_ITEM_TYPES &&
+		!f.IsNegated() && !f.GetFoldCase() &&
+		!f.IsSubstring() && !f.IsRegex() &&
+		/* an empty value matches songs without this tag */
+		!f.GetValue().empty();
+}
+
+bool
+TagIndex::FindCandidates(const SongFilter &filter,
+			 SongSet &result) const noexcept
+{
+	if (has_mounts)
+		return false;
+
+	/* find the most selective indexable predicate; since a song
+	   lacking the given tag may match by "fallback", the
+	   candidates include the postings of all fallback tags */
+
+	std::vector<const PostingList *> best;
+	size_t best_size = 0;
+	bool found = false;
+
+	for (const auto &item : filter.GetItems()) {
+		const auto *t = dynamic_cast<const TagSongFilter *>(item.get());
+		if (t == nullptr || !IsIndexable(*t))
+			continue;
+
+		const char *value = t->GetValue().c_str();
+
+		std::vector<const PostingList *> lists;
+		size_t size = 0;
+		ApplyTagWithFallback(t->GetTagType(),
+				     [this, value, &lists, &size](TagType type){
+					     const auto *list = Find(type, value);
+					     if (list != nullptr) {
+						     lists.push_back(list);
+						     size += list->size();
+					     }
+
+					     /* visit all fallbacks */
+					     return false;
+				     });
+
+		if (!found || size < best_size) {
+			best = std::move(lists);
+			best_size = size;
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	result.reserve(best_size);
+	for (const auto *list : best)
+		result.insert(list->begin(), list->end());
+
+	return true;
+}
+
+bool
+TagIndex::CollectValues(TagType type, std::set<std::string> &result) const
+{
+	assert(type < TAG_NUM_OF_ITEM_TYPES);
+
+	if (has_mounts)
+		return false;
+
+	/* the songs which have one of the tags visited so far; a
+	   fallback tag only counts for songs not in this set */
+	SongSet covered;
+
+	ApplyTagWithFallback(type, [this, &result, &covered](TagType t){
+			const bool is_fallback = !covered.empty();
+			SongSet found;
+
+			for (const auto &i : maps[t]) {
+				bool use = !is_fallback;
+				for (const Song *song : i.second) {
+					if (is_fallback &&
+					    covered.find(song) == covered.end())
+						use = true;
+					found.insert(song);
+				}
+
+				if (use)
+					result.emplace(i.first);
+			}
+
+			covered.insert(found.begin(), found.end());
+
+			/* visit all fallbacks */
+			return false;
+		});
+
+	if (covered.size() < n_songs)
+		result.emplace();
+
+	return true;
+}
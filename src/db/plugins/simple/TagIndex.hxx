@@ -0,0 +1,130 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "tag/Type.h"
+#include "util/StringHash.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * An in-memory inverted index which maps tag values to the songs
+ * containing them.  #SimpleDatabase uses it to find candidates for
+ * #TagSongFilter equality predicates instead of evaluating the filter
+ * on every song.
+ *
+ * The index points to #Song and #TagItem objects owned by the
+ * #Directory tree; it must be discarded before the tree is modified.
+ */
+class TagIndex {
+public:
+	typedef std::vector<const Song *> PostingList;
+	typedef std::unordered_set<const Song *> SongSet;
+
+private:
+	/**
+	 * The keys point to TagItem::value.
+	 */
+	typedef std::unordered_map<const char *, PostingList,
+				   StringHash, StringEqual> Map;
+
+	std::array<Map, TAG_NUM_OF_ITEM_TYPES> maps;
+
+	/**
+	 * Does the tree contain mounted databases?  Their songs are
+	 * not indexed, therefore the index cannot be used.
+	 */
+	bool has_mounts = false;
+
+	/**
+	 * The number of indexed songs.
+	 */
+	size_t n_songs = 0;
+
+public:
+	/**
+	 * Build the index for the given tree.
+	 *
+	 * Caller must hold a shared lock on #db_mutex.
+	 */
+	explicit TagIndex(const Directory &root) noexcept;
+
+	bool HasMounts() const noexcept {
+		return has_mounts;
+	}
+
+	/**
+	 * Called after a database was mounted into the tree.
+	 */
+	void SetHasMounts() noexcept {
+		has_mounts = true;
+	}
+
+	/**
+	 * Returns the songs which contain an item of the given type
+	 * with the given value, or nullptr if there is none.
+	 */
+	gcc_pure
+	const PostingList *Find(TagType type, const char *value) const noexcept;
+
+	/**
+	 * Determine a superset of the songs matching the given
+	 * filter, using one of its #TagSongFilter equality
+	 * predicates.
+	 *
+	 * @return false if the filter contains no predicate which
+	 * can be resolved from the index
+	 */
+	bool FindCandidates(const SongFilter &filter,
+			    SongSet &result) const noexcept;
+
+	/**
+	 * Collect the distinct values of the given tag in all songs,
+	 * the same way CollectUniqueTags() does when visiting all
+	 * songs: songs lacking the tag contribute the values of its
+	 * fallback tags, and songs lacking all of them contribute
+	 * the empty string.
+	 *
+	 * @return false if the index cannot be used
+	 */
+	bool CollectValues(TagType type,
+			   std::set<std::string> &result) const;
+
+	bool empty() const noexcept {
+		return n_songs == 0;
+	}
+
+private:
+	void Add(const Directory &directory) noexcept;
+	void Add(const Song &song) noexcept;
+};
+
+#endif
@@ -22,12 +22,17 @@
 #include "lib/upnp/UniqueIxml.hxx"
 #include "lib/upnp/Action.hxx"
 #include "Directory.hxx"
+#include "thread/WorkerPool.hxx"
 #include "util/NumberParser.hxx"
 #include "util/UriUtil.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/StringFormat.hxx"
 
+#include <algorithm>
+#include <exception>
+#include <vector>
+
 #include <stdio.h>
 
 static void
@@ -84,19 +89,95 @@ ContentDirectoryService::readDirSlice(UpnpClient_Handle hdl,
 	ReadResultTag(dirbuf, response);
 }
 
+/**
+ * One slice of a container requested by a #WorkerPool job.
+ */
+struct ReadDirSlice {
+	unsigned offset, count;
+
+	UPnPDirContent content;
+
+	/**
+	 * The number of entries actually returned; may be less than
+	 * #count if the server limits the response size.
+	 */
+	unsigned didread = 0;
+
+	std::exception_ptr error;
+
+	ReadDirSlice(unsigned _offset, unsigned _count) noexcept
+		:offset(_offset), count(_count) {}
+};
+
 UPnPDirContent
 ContentDirectoryService::readDir(UpnpClient_Handle handle,
-				 const char *objectId) const
+				 const char *objectId,
+				 WorkerPool *pool) const
 {
 	UPnPDirContent dirbuf;
 	unsigned offset = 0, total = -1, count;
 
-	do {
+	readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
+		     count, total);
+	offset += count;
+
+	if (pool != nullptr && count > 0 && total != unsigned(-1) &&
+	    total - offset > count) {
+		/* the total size is known now: request all remaining
+		   slices in parallel, using the slice size the
+		   server has just chosen */
+		std::vector<ReadDirSlice> slices;
+		for (unsigned o = offset; o < total; o += count)
+			slices.emplace_back(o, std::min(count, total - o));
+
+		WorkerPool::Group group;
+		for (auto &slice : slices) {
+			pool->Push(group, [this, handle, objectId, &slice](){
+					unsigned ignored_total;
+
+					try {
+						readDirSlice(handle, objectId,
+							     slice.offset, slice.count,
+							     slice.content,
+							     slice.didread,
+							     ignored_total);
+					} catch (...) {
+						slice.error = std::current_exception();
+					}
+				});
+		}
+
+		pool->Wait(group);
+
+		for (auto &slice : slices) {
+			if (slice.error)
+				std::rethrow_exception(slice.error);
+
+			/* the server may return less than requested;
+			   read the rest of this slice sequentially */
+			unsigned end = slice.offset + slice.count;
+			unsigned o = slice.offset + slice.didread;
+			unsigned n = slice.didread;
+			while (n > 0 && o < end) {
+				unsigned ignored_total;
+				readDirSlice(handle, objectId, o, end - o,
+					     slice.content, n, ignored_total);
+				o += n;
+			}
+
+			for (auto &object : slice.content.objects)
+				dirbuf.objects.emplace_back(std::move(object));
+		}
+
+		return dirbuf;
+	}
+
+	while (count > 0 && offset < total) {
 		readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
 			     count, total);
 
 		offset += count;
-	} while (count > 0 && offset < total);
+	}
 
 	return dirbuf;
 }
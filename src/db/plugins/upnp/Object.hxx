@@ -74,10 +74,12 @@ public:
 	Tag tag;
 
 	UPnPDirObject() = default;
+	UPnPDirObject(const UPnPDirObject &) = default;
 	UPnPDirObject(UPnPDirObject &&) = default;
 
 	~UPnPDirObject() noexcept;
 
+	UPnPDirObject &operator=(const UPnPDirObject &) = default;
 	UPnPDirObject &operator=(UPnPDirObject &&) = default;
 
 	void Clear() noexcept {
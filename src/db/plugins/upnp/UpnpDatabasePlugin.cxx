@@ -39,11 +39,15 @@
 #include "tag/Table.hxx"
 #include "tag/Mask.hxx"
 #include "fs/Traits.hxx"
+#include "thread/WorkerPool.hxx"
 #include "Log.hxx"
 #include "util/SplitString.hxx"
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <set>
+#include <unordered_map>
 
 #include <assert.h>
 #include <string.h>
@@ -77,15 +81,60 @@ class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	/**
+	 * The number of threads in #browse_pool; 0 disables parallel
+	 * Browse requests.
+	 */
+	const unsigned browse_threads;
+
+	/**
+	 * Requests the slices of large containers in parallel.
+	 */
+	std::unique_ptr<WorkerPool> browse_pool;
+
+	/**
+	 * How long are the parsed results of Browse and Search
+	 * actions cached?  Zero disables the cache.
+	 */
+	const std::chrono::steady_clock::duration cache_ttl;
+
+	/**
+	 * Discard all cached entries when there are more than this.
+	 */
+	static constexpr std::size_t MAX_CACHE_ENTRIES = 1024;
+
+	template<typename T>
+	struct CacheItem {
+		std::shared_ptr<const T> value;
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	/**
+	 * Parsed Browse/Search results.  The key is built by
+	 * MakeCacheKey().
+	 */
+	mutable std::unordered_map<std::string,
+				   CacheItem<UPnPDirContent>> content_cache;
+
+	/**
+	 * The result of "GetSearchCapabilities" for each server,
+	 * indexed by ContentDirectoryService::GetURI().
+	 */
+	mutable std::unordered_map<std::string,
+				   CacheItem<std::forward_list<std::string>>> searchcaps_cache;
+
 public:
-	explicit UpnpDatabase(EventLoop &_event_loop) noexcept
+	UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block)
 		:Database(upnp_db_plugin),
-		 event_loop(_event_loop) {}
+		 event_loop(_event_loop),
+		 browse_threads(block.GetBlockValue("browse_threads", 4u)),
+		 cache_ttl(std::chrono::seconds(block.GetBlockValue("cache_ttl",
+								    60u))) {}
 
 	static Database *Create(EventLoop &main_event_loop,
 				EventLoop &io_event_loop,
 				DatabaseListener &listener,
-				const ConfigBlock &block) noexcept;
+				const ConfigBlock &block);
 
 	void Open() override;
 	void Close() noexcept override;
@@ -108,6 +157,44 @@ public:
 	}
 
 private:
+	/**
+	 * Look up an entry in the given cache.
+	 *
+	 * @return nullptr if there is no valid entry
+	 */
+	template<typename T>
+	std::shared_ptr<const T> GetCached(std::unordered_map<std::string, CacheItem<T>> &cache,
+					   const std::string &key) const noexcept;
+
+	template<typename T>
+	std::shared_ptr<const T> PutCached(std::unordered_map<std::string, CacheItem<T>> &cache,
+					   std::string &&key, T &&value) const;
+
+	/**
+	 * Cached wrapper for ContentDirectoryService::readDir().
+	 */
+	std::shared_ptr<const UPnPDirContent> ReadDir(const ContentDirectoryService &server,
+						      const char *objid) const;
+
+	/**
+	 * Cached wrapper for ContentDirectoryService::getMetadata().
+	 */
+	std::shared_ptr<const UPnPDirContent> GetMetadata(const ContentDirectoryService &server,
+							  const char *objid) const;
+
+	/**
+	 * Cached wrapper for ContentDirectoryService::search().
+	 */
+	std::shared_ptr<const UPnPDirContent> Search(const ContentDirectoryService &server,
+						     const char *objid,
+						     const char *criteria) const;
+
+	/**
+	 * Cached wrapper for
+	 * ContentDirectoryService::getSearchCapabilities().
+	 */
+	std::shared_ptr<const std::forward_list<std::string>> GetSearchCapabilities(const ContentDirectoryService &server) const;
+
 	void VisitServer(const ContentDirectoryService &server,
 			 std::forward_list<std::string> &&vpath,
 			 const DatabaseSelection &selection,
@@ -124,9 +211,9 @@ private:
 			 const DatabaseSelection &selection,
 			 VisitSong visit_song) const;
 
-	UPnPDirContent SearchSongs(const ContentDirectoryService &server,
-				   const char *objid,
-				   const DatabaseSelection &selection) const;
+	std::shared_ptr<const UPnPDirContent> SearchSongs(const ContentDirectoryService &server,
+							  const char *objid,
+							  const DatabaseSelection &selection) const;
 
 	UPnPDirObject Namei(const ContentDirectoryService &server,
 			    std::forward_list<std::string> &&vpath) const;
@@ -149,9 +236,9 @@ private:
 Database *
 UpnpDatabase::Create(EventLoop &, EventLoop &io_event_loop,
 		     gcc_unused DatabaseListener &listener,
-		     const ConfigBlock &) noexcept
+		     const ConfigBlock &block)
 {
-	return new UpnpDatabase(io_event_loop);
+	return new UpnpDatabase(io_event_loop, block);
 }
 
 void
@@ -162,6 +249,10 @@ UpnpDatabase::Open()
 	discovery = new UPnPDeviceDirectory(event_loop, handle);
 	try {
 		discovery->Start();
+
+		if (browse_threads > 0)
+			browse_pool.reset(new WorkerPool("upnp_browse",
+							 browse_threads));
 	} catch (...) {
 		delete discovery;
 		UpnpClientGlobalFinish();
@@ -172,10 +263,132 @@ UpnpDatabase::Open()
 void
 UpnpDatabase::Close() noexcept
 {
+	browse_pool.reset();
+	content_cache.clear();
+	searchcaps_cache.clear();
+
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
 
+template<typename T>
+std::shared_ptr<const T>
+UpnpDatabase::GetCached(std::unordered_map<std::string, CacheItem<T>> &cache,
+			const std::string &key) const noexcept
+{
+	auto i = cache.find(key);
+	if (i == cache.end())
+		return nullptr;
+
+	if (std::chrono::steady_clock::now() >= i->second.expires) {
+		cache.erase(i);
+		return nullptr;
+	}
+
+	return i->second.value;
+}
+
+template<typename T>
+std::shared_ptr<const T>
+UpnpDatabase::PutCached(std::unordered_map<std::string, CacheItem<T>> &cache,
+			std::string &&key, T &&value) const
+{
+	auto result = std::make_shared<const T>(std::move(value));
+	if (cache_ttl <= std::chrono::steady_clock::duration::zero())
+		return result;
+
+	const auto now = std::chrono::steady_clock::now();
+
+	if (cache.size() >= MAX_CACHE_ENTRIES) {
+		for (auto i = cache.begin(); i != cache.end();) {
+			if (now >= i->second.expires)
+				i = cache.erase(i);
+			else
+				++i;
+		}
+
+		if (cache.size() >= MAX_CACHE_ENTRIES)
+			cache.clear();
+	}
+
+	auto &item = cache[std::move(key)];
+	item.value = result;
+	item.expires = now + cache_ttl;
+	return result;
+}
+
+/**
+ * Build a key for UpnpDatabase::content_cache.
+ */
+static std::string
+MakeCacheKey(const ContentDirectoryService &server, char action,
+	     const char *objid, const char *criteria=nullptr) noexcept
+{
+	std::string key = server.GetURI();
+	key.push_back('\n');
+	key.push_back(action);
+	key.push_back('\n');
+	key += objid;
+
+	if (criteria != nullptr) {
+		key.push_back('\n');
+		key += criteria;
+	}
+
+	return key;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid) const
+{
+	auto key = MakeCacheKey(server, 'B', objid);
+	auto cached = GetCached(content_cache, key);
+	if (cached)
+		return cached;
+
+	return PutCached(content_cache, std::move(key),
+			 server.readDir(handle, objid, browse_pool.get()));
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::GetMetadata(const ContentDirectoryService &server,
+			  const char *objid) const
+{
+	auto key = MakeCacheKey(server, 'M', objid);
+	auto cached = GetCached(content_cache, key);
+	if (cached)
+		return cached;
+
+	return PutCached(content_cache, std::move(key),
+			 server.getMetadata(handle, objid));
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::Search(const ContentDirectoryService &server,
+		     const char *objid, const char *criteria) const
+{
+	auto key = MakeCacheKey(server, 'S', objid, criteria);
+	auto cached = GetCached(content_cache, key);
+	if (cached)
+		return cached;
+
+	return PutCached(content_cache, std::move(key),
+			 server.search(handle, objid, criteria));
+}
+
+std::shared_ptr<const std::forward_list<std::string>>
+UpnpDatabase::GetSearchCapabilities(const ContentDirectoryService &server) const
+{
+	auto key = server.GetURI();
+	auto cached = GetCached(searchcaps_cache, key);
+	if (cached)
+		return cached;
+
+	return PutCached(searchcaps_cache, std::move(key),
+			 server.getSearchCapabilities(handle));
+}
+
 void
 UpnpDatabase::ReturnSong(const LightSong *_song) const noexcept
 {
@@ -241,18 +454,19 @@ dquote(std::string &out, const char *in) noexcept
 
 // Run an UPnP search, according to MPD parameters. Return results as
 // UPnP items
-UPnPDirContent
+std::shared_ptr<const UPnPDirContent>
 UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 			  const char *objid,
 			  const DatabaseSelection &selection) const
 {
 	const SongFilter *filter = selection.filter;
 	if (selection.filter == nullptr)
-		return UPnPDirContent();
+		return std::make_shared<const UPnPDirContent>();
 
-	const auto searchcaps = server.getSearchCapabilities(handle);
+	const auto searchcaps_ptr = GetSearchCapabilities(server);
+	const auto &searchcaps = *searchcaps_ptr;
 	if (searchcaps.empty())
-		return UPnPDirContent();
+		return std::make_shared<const UPnPDirContent>();
 
 	std::string cond;
 	for (const auto &item : filter->GetItems()) {
@@ -309,7 +523,7 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 		// TODO: support other ISongFilter implementations
 	}
 
-	return server.search(handle, objid, cond.c_str());
+	return Search(server, objid, cond.c_str());
 }
 
 static void
@@ -348,7 +562,8 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	if (!visit_song)
 		return;
 
-	for (auto &dirent : SearchSongs(server, objid, selection).objects) {
+	const auto result = SearchSongs(server, objid, selection);
+	for (const auto &dirent : result->objects) {
 		if (dirent.type != UPnPDirObject::Type::ITEM ||
 		    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
 			continue;
@@ -371,7 +586,7 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 		// which we later have to detect.
 		const std::string path = songPath(server.getFriendlyName(),
 						  dirent.id);
-		visitSong(std::move(dirent), path.c_str(),
+		visitSong(dirent, path.c_str(),
 			  selection, visit_song);
 	}
 }
@@ -380,11 +595,11 @@ UPnPDirObject
 UpnpDatabase::ReadNode(const ContentDirectoryService &server,
 		       const char *objid) const
 {
-	auto dirbuf = server.getMetadata(handle, objid);
-	if (dirbuf.objects.size() != 1)
+	const auto dirbuf = GetMetadata(server, objid);
+	if (dirbuf->objects.size() != 1)
 		throw std::runtime_error("Bad resource");
 
-	return std::move(dirbuf.objects.front());
+	return dirbuf->objects.front();
 }
 
 std::string
@@ -421,23 +636,23 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	while (true) {
-		auto dirbuf = server.readDir(handle, objid.c_str());
+		const auto dirbuf = ReadDir(server, objid.c_str());
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(vpath.front().c_str());
+		const UPnPDirObject *child = dirbuf->FindObject(vpath.front().c_str());
 		if (child == nullptr)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "No such object");
 
 		vpath.pop_front();
 		if (vpath.empty())
-			return std::move(*child);
+			return *child;
 
 		if (child->type != UPnPDirObject::Type::CONTAINER)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "Not a container");
 
-		objid = std::move(child->id);
+		objid = child->id;
 	}
 }
 
@@ -534,7 +749,7 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 
 			std::string path = songPath(server.getFriendlyName(),
 						    dirent.id);
-			visitSong(std::move(dirent), path.c_str(),
+			visitSong(dirent, path.c_str(),
 				  selection, visit_song);
 		}
 
@@ -567,7 +782,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	for (const auto &dirent : server.readDir(handle, tdirent.id.c_str()).objects) {
+	const auto contents = ReadDir(server, tdirent.id.c_str());
+	for (const auto &dirent : contents->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		VisitObject(dirent, uri.c_str(),
@@ -29,9 +29,12 @@
 #include "archive/ArchivePlugin.hxx"
 #include "archive/ArchiveFile.hxx"
 #include "archive/ArchiveVisitor.hxx"
+#include "tag/Builder.hxx"
 #include "util/StringCompare.hxx"
+#include "TagArchive.hxx"
 #include "Log.hxx"
 
+#include <forward_list>
 #include <string>
 #include <exception>
 
@@ -40,7 +43,7 @@
 static Directory *
 LockFindChild(Directory &directory, const char *name) noexcept
 {
-	const ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 	return directory.FindChild(name);
 }
 
@@ -54,13 +57,13 @@ LockMakeChild(Directory &directory, const char *name) noexcept
 static Song *
 LockFindSong(Directory &directory, const char *name) noexcept
 {
-	const ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 	return directory.FindSong(name);
 }
 
 void
-UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
-			      const char *name) noexcept
+UpdateWalk::UpdateArchiveTree(Directory &directory, const char *name,
+			      ArchiveMember &member) noexcept
 {
 	const char *tmp = strchr(name, '/');
 	if (tmp) {
@@ -71,7 +74,7 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		subdir->device = DEVICE_INARCHIVE;
 
 		//create directories first
-		UpdateArchiveTree(archive, *subdir, tmp + 1);
+		UpdateArchiveTree(*subdir, tmp + 1, member);
 	} else {
 		if (StringIsEmpty(name)) {
 			LogWarning(update_domain,
@@ -82,19 +85,30 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		//add file
 		Song *song = LockFindSong(directory, name);
 		if (song == nullptr) {
-			song = Song::LoadFromArchive(archive, name, directory);
-			if (song != nullptr) {
-				{
-					const ScopeDatabaseLock protect;
-					directory.AddSong(song);
-				}
-
-				modified = true;
-				FormatDefault(update_domain, "added %s/%s",
-					      directory.GetPath(), name);
+			if (!member.success)
+				return;
+
+			song = Song::NewFile(name, directory);
+			song->tag = std::move(member.tag);
+
+			{
+				const ScopeDatabaseLock protect;
+				directory.AddSong(song);
 			}
+
+			modified = true;
+			FormatDefault(update_domain, "added %s/%s",
+				      directory.GetPath(), name);
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			{
+				const ScopeDatabaseLock protect;
+				directory.BeginModifySong(*song);
+				if (member.success)
+					song->tag = std::move(member.tag);
+				directory.EndModifySong(*song);
+			}
+
+			if (!member.success) {
 				FormatDebug(update_domain,
 					    "deleting unrecognized file %s/%s",
 					    directory.GetPath(), name);
@@ -104,23 +118,80 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 	}
 }
 
-class UpdateArchiveVisitor final : public ArchiveVisitor {
-	UpdateWalk &walk;
-	ArchiveFile &archive;
-	Directory *directory;
+/**
+ * Collects the member names of an archive.
+ */
+class ArchiveNameCollector final : public ArchiveVisitor {
+	std::forward_list<std::string> &names;
 
- public:
-	UpdateArchiveVisitor(UpdateWalk &_walk, ArchiveFile &_archive,
-			     Directory *_directory) noexcept
-		:walk(_walk), archive(_archive), directory(_directory) {}
+public:
+	explicit ArchiveNameCollector(std::forward_list<std::string> &_names) noexcept
+		:names(_names) {}
 
 	virtual void VisitArchiveEntry(const char *path_utf8) override {
-		FormatDebug(update_domain,
-			    "adding archive file: %s", path_utf8);
-		walk.UpdateArchiveTree(archive, *directory, path_utf8);
+		names.emplace_front(path_utf8);
 	}
 };
 
+void
+UpdateWalk::PendingArchive::Scan() noexcept
+try {
+	auto file = archive_file_open(&plugin, path_fs);
+
+	FormatDebug(update_domain, "archive %s opened", path_fs.c_str());
+
+	std::forward_list<std::string> names;
+	ArchiveNameCollector visitor(names);
+	file->Visit(visitor);
+
+	/* restore the archive order */
+	names.reverse();
+
+	auto tail = members.before_begin();
+	for (auto &i : names) {
+		TagBuilder tag_builder;
+		const bool success = !i.empty() && i.back() != '/' &&
+			tag_archive_scan(*file, i.c_str(), tag_builder);
+		tail = members.emplace_after(tail, std::move(i),
+					     tag_builder.Commit(), success);
+	}
+} catch (...) {
+	error = std::current_exception();
+}
+
+void
+UpdateWalk::CommitArchive(PendingArchive &p) noexcept
+{
+	Directory *directory = LockFindChild(p.parent, p.name.c_str());
+
+	if (p.error) {
+		LogError(p.error);
+		if (directory != nullptr)
+			editor.LockDeleteDirectory(directory);
+		return;
+	}
+
+	if (directory == nullptr) {
+		FormatDebug(update_domain,
+			    "creating archive directory: %s", p.name.c_str());
+
+		const ScopeDatabaseLock protect;
+		directory = p.parent.CreateChild(p.name.c_str());
+		/* mark this directory as archive (we use device for
+		   this) */
+		directory->device = DEVICE_INARCHIVE;
+	}
+
+	directory->mtime = p.mtime;
+	directory->MarkModified();
+
+	for (auto &i : p.members) {
+		FormatDebug(update_domain,
+			    "adding archive file: %s", i.path.c_str());
+		UpdateArchiveTree(*directory, i.path.c_str(), i);
+	}
+}
+
 /**
  * Updates the file listing from an archive file.
  *
@@ -142,40 +213,29 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 		   changed since - don't consider updating it */
 		return;
 
-	const auto path_fs = storage.MapChildFS(parent.GetPath(), name);
+	auto path_fs = storage.MapChildFS(parent.GetPath(), name);
 	if (path_fs.IsNull())
 		/* not a local file: skip, because the archive API
 		   supports only local files */
 		return;
 
-	/* open archive */
-	std::unique_ptr<ArchiveFile> file;
-	try {
-		file = archive_file_open(&plugin, path_fs);
-	} catch (...) {
-		LogError(std::current_exception());
-		if (directory != nullptr)
-			editor.LockDeleteDirectory(directory);
+	if (pending_songs != nullptr) {
+		/* open and scan the archive in the thread pool; the
+		   results will be committed by FlushPendingSongs() */
+		pending_songs->archives.emplace_back(parent, name, plugin,
+						     std::move(path_fs),
+						     info.mtime);
+		auto &p = pending_songs->archives.back();
+		scan_pool->Push(pending_songs->group, [&p](){
+				p.Scan();
+			});
 		return;
 	}
 
-	FormatDebug(update_domain, "archive %s opened", path_fs.c_str());
-
-	if (directory == nullptr) {
-		FormatDebug(update_domain,
-			    "creating archive directory: %s", name);
-
-		const ScopeDatabaseLock protect;
-		directory = parent.CreateChild(name);
-		/* mark this directory as archive (we use device for
-		   this) */
-		directory->device = DEVICE_INARCHIVE;
-	}
-
-	directory->mtime = info.mtime;
-
-	UpdateArchiveVisitor visitor(*this, *file, directory);
-	file->Visit(visitor);
+	PendingArchive p(parent, name, plugin, std::move(path_fs),
+			 info.mtime);
+	p.Scan();
+	CommitArchive(p);
 }
 
 bool
@@ -22,6 +22,14 @@
 #include "config/Option.hxx"
 
 UpdateConfig::UpdateConfig(const ConfigData &config)
+	:threads(config.GetPositive(ConfigOption::UPDATE_THREADS,
+				    DEFAULT_THREADS)),
+	 loudness_scan(config.GetBool(ConfigOption::LOUDNESS_SCAN, false)),
+	 mixramp_scan(config.GetBool(ConfigOption::MIXRAMP_SCAN, false)),
+	 fingerprint_scan(config.GetBool(ConfigOption::FINGERPRINT_SCAN, false)),
+	 fingerprint_duration(config.GetPositive(ConfigOption::FINGERPRINT_DURATION,
+						 DEFAULT_FINGERPRINT_DURATION)),
+	 picture_scan(config.GetBool(ConfigOption::PICTURE_CACHE_SCAN, false))
 {
 #ifndef _WIN32
 	follow_inside_symlinks =
@@ -31,7 +39,5 @@ UpdateConfig::UpdateConfig(const ConfigData &config)
 	follow_outside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 			       DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
-#else
-	(void)config;
 #endif
 }
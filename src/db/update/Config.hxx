@@ -23,6 +23,45 @@
 struct ConfigData;
 
 struct UpdateConfig {
+	static constexpr unsigned DEFAULT_THREADS = 1;
+
+	/**
+	 * The number of threads which scan song files concurrently.
+	 */
+	unsigned threads = DEFAULT_THREADS;
+
+	/**
+	 * Measure the loudness of song files without ReplayGain
+	 * tags after the update?
+	 */
+	bool loudness_scan = false;
+
+	/**
+	 * Calculate MixRamp profiles of song files without MixRamp
+	 * tags after the update?
+	 */
+	bool mixramp_scan = false;
+
+	static constexpr unsigned DEFAULT_FINGERPRINT_DURATION = 120;
+
+	/**
+	 * Calculate Chromaprint fingerprints of song files and store
+	 * them in the sticker database after the update?
+	 */
+	bool fingerprint_scan = false;
+
+	/**
+	 * The number of seconds at the beginning of each song which
+	 * are fed into the fingerprint.
+	 */
+	unsigned fingerprint_duration = DEFAULT_FINGERPRINT_DURATION;
+
+	/**
+	 * Extract embedded pictures into the #PictureCache after
+	 * the update?
+	 */
+	bool picture_scan = false;
+
 #ifndef _WIN32
 	static constexpr bool DEFAULT_FOLLOW_INSIDE_SYMLINKS = true;
 	static constexpr bool DEFAULT_FOLLOW_OUTSIDE_SYMLINKS = true;
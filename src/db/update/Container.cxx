@@ -55,12 +55,45 @@ UpdateWalk::MakeDirectoryIfModified(Directory &parent, const char *name,
 	return directory;
 }
 
-static bool
-SupportsContainerSuffix(const DecoderPlugin &plugin,
-			const char *suffix) noexcept
+void
+UpdateWalk::PendingContainer::Scan() noexcept
 {
-	return plugin.container_scan != nullptr &&
-		plugin.SupportsSuffix(suffix);
+	try {
+		tracks = plugin.container_scan(path_fs);
+	} catch (...) {
+		error = std::current_exception();
+	}
+}
+
+bool
+UpdateWalk::CommitContainer(PendingContainer &p) noexcept
+{
+	if (p.error)
+		LogError(p.error);
+
+	if (p.tracks.empty()) {
+		editor.LockDeleteDirectory(&p.contdir);
+		return false;
+	}
+
+	for (auto &vtrack : p.tracks) {
+		Song *song = Song::NewFrom(std::move(vtrack), p.contdir);
+
+		// shouldn't be necessary but it's there..
+		song->mtime = p.info.mtime;
+
+		FormatDefault(update_domain, "added %s/%s",
+			      p.contdir.GetPath(), song->uri);
+
+		{
+			const ScopeDatabaseLock protect;
+			p.contdir.AddSong(song);
+		}
+
+		modified = true;
+	}
+
+	return true;
 }
 
 bool
@@ -68,8 +101,8 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 				const char *name, const char *suffix,
 				const StorageFileInfo &info) noexcept
 {
-	const DecoderPlugin *_plugin = decoder_plugins_find([suffix](const DecoderPlugin &plugin){
-			return SupportsContainerSuffix(plugin, suffix);
+	const DecoderPlugin *_plugin = decoder_plugins_find_suffix(suffix, [](const DecoderPlugin &plugin){
+			return plugin.container_scan != nullptr;
 		});
 	if (_plugin == nullptr)
 		return false;
@@ -86,7 +119,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		contdir->device = DEVICE_CONTAINER;
 	}
 
-	const auto pathname = storage.MapFS(contdir->GetPath());
+	auto pathname = storage.MapFS(contdir->GetPath());
 	if (pathname.IsNull()) {
 		/* not a local file: skip, because the container API
 		   supports only local files */
@@ -94,35 +127,24 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		return false;
 	}
 
-	try {
-		auto v = plugin.container_scan(pathname);
-		if (v.empty()) {
-			editor.LockDeleteDirectory(contdir);
-			return false;
-		}
-
-		for (auto &vtrack : v) {
-			Song *song = Song::NewFrom(std::move(vtrack),
-						   *contdir);
-
-			// shouldn't be necessary but it's there..
-			song->mtime = info.mtime;
-
-			FormatDefault(update_domain, "added %s/%s",
-				      contdir->GetPath(), song->uri);
-
-			{
-				const ScopeDatabaseLock protect;
-				contdir->AddSong(song);
-			}
-
-			modified = true;
-		}
-	} catch (...) {
-		LogError(std::current_exception());
-		editor.LockDeleteDirectory(contdir);
-		return false;
+	if (pending_songs != nullptr) {
+		/* enumerate the tracks in the thread pool; they will
+		   be committed by FlushPendingSongs(), which falls
+		   back to loading a plain song file if there are
+		   none */
+		pending_songs->containers.emplace_back(directory, name,
+						       *contdir, plugin,
+						       std::move(pathname),
+						       info);
+		auto &p = pending_songs->containers.back();
+		scan_pool->Push(pending_songs->group, [&p](){
+				p.Scan();
+			});
+		return true;
 	}
 
-	return true;
+	PendingContainer p(directory, name, *contdir, plugin,
+			   std::move(pathname), info);
+	p.Scan();
+	return CommitContainer(p);
 }
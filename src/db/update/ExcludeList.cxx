@@ -26,6 +26,7 @@
 #include "fs/Path.hxx"
 #include "fs/NarrowPath.hxx"
 #include "input/TextInputStream.hxx"
+#include "input/InputStream.hxx"
 #include "util/StringStrip.hxx"
 #include "Log.hxx"
 #include "config.h"
@@ -37,18 +38,87 @@
 
 #ifdef HAVE_CLASS_GLOB
 
+size_t
+ExcludePatterns::Hash::operator()(StringView s) const noexcept
+{
+	/* FNV-1a, like StringHash */
+	size_t hash = 2166136261u;
+	for (char ch : s)
+		hash = (hash ^ (unsigned char)ch) * 16777619u;
+	return hash;
+}
+
+bool
+ExcludePatterns::Equal::operator()(StringView a, StringView b) const noexcept
+{
+	return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
+#ifdef HAVE_FNMATCH
+
+/**
+ * Does the string contain characters which have a special meaning
+ * in fnmatch() patterns?
+ */
+gcc_pure
+static bool
+HasWildcard(StringView s) noexcept
+{
+	for (char ch : s)
+		if (ch == '*' || ch == '?' || ch == '[' || ch == '\\')
+			return true;
+
+	return false;
+}
+
+#endif
+
+void
+ExcludePatterns::Add(const char *pattern)
+{
+	empty = false;
+
+#ifdef HAVE_FNMATCH
+	/* PathMatchSpecA() on Windows is case-insensitive, therefore
+	   the hash tables are only used with fnmatch() */
+	const StringView p(pattern);
+
+	if (!HasWildcard(p)) {
+		strings.emplace_front(pattern);
+		literals.emplace(strings.front().data(), strings.front().size());
+		return;
+	}
+
+	if (p.size > 0 && p.front() == '*' && !HasWildcard({p.data + 1, p.size - 1})) {
+		strings.emplace_front(p.data + 1, p.size - 1);
+		const auto &s = strings.front();
+		suffixes[s.size()].emplace(s.data(), s.size());
+		return;
+	}
+
+	if (p.size > 0 && p.back() == '*' && !HasWildcard({p.data, p.size - 1})) {
+		strings.emplace_front(p.data, p.size - 1);
+		const auto &s = strings.front();
+		prefixes[s.size()].emplace(s.data(), s.size());
+		return;
+	}
+#endif
+
+	globs.emplace_front(pattern);
+}
+
 inline void
-ExcludeList::ParseLine(char *line) noexcept
+ExcludePatterns::ParseLine(char *line)
 {
 	char *p = Strip(line);
 	if (*p != 0 && *p != '#')
-		patterns.emplace_front(p);
+		Add(p);
 }
 
 #endif
 
-bool
-ExcludeList::Load(InputStreamPtr is)
+void
+ExcludePatterns::Load(InputStreamPtr is)
 {
 #ifdef HAVE_CLASS_GLOB
 	TextInputStream tis(std::move(is));
@@ -60,31 +130,36 @@ ExcludeList::Load(InputStreamPtr is)
 	/* not implemented */
 	(void)is;
 #endif
-
-	return true;
 }
 
 bool
-ExcludeList::Check(Path name_fs) const noexcept
+ExcludePatterns::Check(const char *name_fs) const noexcept
 {
-	assert(!name_fs.IsNull());
+#ifdef HAVE_CLASS_GLOB
+	const StringView name(name_fs);
 
-	/* XXX include full path name in check */
+	if (literals.find(name) != literals.end())
+		return true;
 
-#ifdef HAVE_CLASS_GLOB
-	if (parent != nullptr) {
-		if (parent->Check(name_fs)) {
+	for (const auto &i : suffixes) {
+		if (i.first > name.size)
+			break;
+
+		if (i.second.find({name.end() - i.first, i.first}) != i.second.end())
 			return true;
-		}
 	}
 
-	for (const auto &i : patterns) {
-		try {
-			if (i.Check(NarrowPath(name_fs).c_str()))
-				return true;
-		} catch (...) {
-		}
+	for (const auto &i : prefixes) {
+		if (i.first > name.size)
+			break;
+
+		if (i.second.find({name.data, i.first}) != i.second.end())
+			return true;
 	}
+
+	for (const auto &i : globs)
+		if (i.Check(name_fs))
+			return true;
 #else
 	/* not implemented */
 	(void)name_fs;
@@ -92,3 +167,59 @@ ExcludeList::Check(Path name_fs) const noexcept
 
 	return false;
 }
+
+bool
+ExcludeList::Load(InputStreamPtr is)
+{
+	auto p = std::make_shared<ExcludePatterns>();
+	p->Load(std::move(is));
+	patterns = std::move(p);
+	return true;
+}
+
+inline bool
+ExcludeList::Check(const char *name_fs) const noexcept
+{
+	if (parent != nullptr && parent->Check(name_fs))
+		return true;
+
+	return HasOwnPatterns() && patterns->Check(name_fs);
+}
+
+bool
+ExcludeList::Check(Path name_fs) const noexcept
+{
+	assert(!name_fs.IsNull());
+
+	/* XXX include full path name in check */
+
+	if (IsEmpty())
+		return false;
+
+	try {
+		return Check(NarrowPath(name_fs).c_str());
+	} catch (...) {
+		return false;
+	}
+}
+
+std::shared_ptr<const ExcludePatterns>
+ExcludeCache::Get(const std::string &uri,
+		  std::chrono::system_clock::time_point mtime,
+		  uint64_t size) const noexcept
+{
+	auto i = map.find(uri);
+	if (i == map.end() || i->second.mtime != mtime ||
+	    i->second.size != size)
+		return nullptr;
+
+	return i->second.patterns;
+}
+
+void
+ExcludeCache::Put(const std::string &uri,
+		  std::chrono::system_clock::time_point mtime, uint64_t size,
+		  std::shared_ptr<const ExcludePatterns> patterns)
+{
+	map[uri] = Item{mtime, size, std::move(patterns)};
+}
@@ -26,38 +26,115 @@
 #define MPD_EXCLUDE_H
 
 #include "util/Compiler.h"
+#include "util/StringView.hxx"
 #include "fs/Glob.hxx"
 #include "input/Ptr.hxx"
 #include "config.h"
 
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
 #ifdef HAVE_CLASS_GLOB
 #include <forward_list>
+#include <map>
+#include <unordered_set>
 #endif
 
+#include <stdint.h>
+
 class Path;
 
-class ExcludeList {
-	const ExcludeList *const parent;
+/**
+ * The compiled patterns of one ".mpdignore" file.  Patterns without
+ * wildcards and patterns which are a literal string with just one
+ * leading (or trailing) asterisk are looked up in hash tables; only
+ * the remaining patterns are matched one by one.
+ */
+class ExcludePatterns {
+#ifdef HAVE_CLASS_GLOB
+	struct Hash {
+		gcc_pure
+		size_t operator()(StringView s) const noexcept;
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(StringView a, StringView b) const noexcept;
+	};
+
+	typedef std::unordered_set<StringView, Hash, Equal> Set;
+
+	/**
+	 * Owns the strings referenced by the #Set keys.
+	 */
+	std::forward_list<std::string> strings;
+
+	/**
+	 * Patterns without wildcards.
+	 */
+	Set literals;
+
+	/**
+	 * Patterns of the form "*LITERAL" and "LITERAL*", grouped by
+	 * the length of the literal.
+	 */
+	std::map<size_t, Set> suffixes, prefixes;
+
+	/**
+	 * All other patterns.
+	 */
+	std::forward_list<Glob> globs;
 
+	bool empty = true;
+#endif
+
+public:
+	gcc_pure
+	bool IsEmpty() const noexcept {
 #ifdef HAVE_CLASS_GLOB
-	std::forward_list<Glob> patterns;
+		return empty;
+#else
+		return true;
 #endif
+	}
+
+	/**
+	 * Loads and parses a .mpdignore file.
+	 */
+	void Load(InputStreamPtr is);
+
+	gcc_pure
+	bool Check(const char *name_fs) const noexcept;
+
+private:
+	void Add(const char *pattern);
+	void ParseLine(char *line);
+};
+
+class ExcludeList {
+	/**
+	 * The nearest ancestor which has patterns (ancestors without
+	 * patterns are skipped).
+	 */
+	const ExcludeList *const parent;
+
+	std::shared_ptr<const ExcludePatterns> patterns;
 
 public:
 	ExcludeList()
 		:parent(nullptr) {}
 
 	ExcludeList(const ExcludeList &_parent)
-		:parent(&_parent) {}
+		:parent(_parent.HasOwnPatterns()
+			? &_parent
+			: _parent.parent) {}
 
 	gcc_pure
 	bool IsEmpty() const noexcept {
-#ifdef HAVE_CLASS_GLOB
-		return ((parent == nullptr) || parent->IsEmpty()) && patterns.empty();
-#else
-		/* not implemented */
-		return true;
-#endif
+		return ((parent == nullptr) || parent->IsEmpty()) &&
+			!HasOwnPatterns();
 	}
 
 	/**
@@ -65,6 +142,14 @@ public:
 	 */
 	bool Load(InputStreamPtr is);
 
+	/**
+	 * Use patterns which have already been compiled (e.g. from
+	 * #ExcludeCache).
+	 */
+	void Set(std::shared_ptr<const ExcludePatterns> _patterns) noexcept {
+		patterns = std::move(_patterns);
+	}
+
 	/**
 	 * Checks whether one of the patterns in the .mpdignore file matches
 	 * the specified file name.
@@ -72,7 +157,53 @@ public:
 	bool Check(Path name_fs) const noexcept;
 
 private:
-	void ParseLine(char *line) noexcept;
+	gcc_pure
+	bool HasOwnPatterns() const noexcept {
+		return patterns != nullptr && !patterns->IsEmpty();
+	}
+
+	gcc_pure
+	bool Check(const char *name_fs) const noexcept;
+};
+
+/**
+ * Keeps compiled ".mpdignore" files between database updates, so
+ * they need to be loaded and parsed again only after they have been
+ * modified.
+ *
+ * This class is not thread-safe; it is only used by the update
+ * thread.
+ */
+class ExcludeCache {
+	struct Item {
+		std::chrono::system_clock::time_point mtime;
+		uint64_t size;
+
+		std::shared_ptr<const ExcludePatterns> patterns;
+	};
+
+	/**
+	 * The key is the URI of the ".mpdignore" file.
+	 */
+	std::unordered_map<std::string, Item> map;
+
+public:
+	/**
+	 * @return the cached patterns or nullptr if the file is not in
+	 * the cache or has been modified
+	 */
+	gcc_pure
+	std::shared_ptr<const ExcludePatterns> Get(const std::string &uri,
+						   std::chrono::system_clock::time_point mtime,
+						   uint64_t size) const noexcept;
+
+	void Put(const std::string &uri,
+		 std::chrono::system_clock::time_point mtime, uint64_t size,
+		 std::shared_ptr<const ExcludePatterns> patterns);
+
+	void Remove(const std::string &uri) noexcept {
+		map.erase(uri);
+	}
 };
 
 
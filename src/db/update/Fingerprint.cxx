@@ -0,0 +1,184 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Walk.hxx"
+#include "FingerprintScan.hxx"
+#include "UpdateDomain.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/StorageInterface.hxx"
+#include "sticker/StickerDatabase.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Log.hxx"
+
+#include <list>
+#include <set>
+#include <vector>
+
+/**
+ * The name of the "song" sticker which stores the fingerprint.
+ */
+static constexpr char FINGERPRINT_STICKER[] = "chromaprint";
+
+/**
+ * Shall a fingerprint be calculated for this song?
+ */
+gcc_pure
+static bool
+IsFingerprintCandidate(const Song &song) noexcept
+{
+	/* sub-songs (e.g. from a CUE sheet) cannot be decoded
+	   separately */
+	return song.start_time.IsZero() && song.end_time.IsZero();
+}
+
+struct UpdateWalk::FingerprintItem {
+	const std::string uri;
+
+	const AllocatedPath path;
+
+	/**
+	 * The result; empty if the file could not be decoded.
+	 */
+	std::string fingerprint;
+
+	FingerprintItem(std::string &&_uri, AllocatedPath &&_path) noexcept
+		:uri(std::move(_uri)), path(std::move(_path)) {}
+};
+
+void
+UpdateWalk::ScanSongFingerprint(FingerprintItem &item) noexcept
+{
+	try {
+		item.fingerprint = ScanFileFingerprint(item.path,
+						       config.fingerprint_duration,
+						       cancel);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to calculate the fingerprint of %s",
+			    item.uri.c_str());
+	}
+}
+
+static void
+CollectFingerprintUri(const char *uri, const char *, void *user_data)
+{
+	auto &found = *(std::set<std::string> *)user_data;
+	found.emplace(uri);
+}
+
+void
+UpdateWalk::ScanDirectoryFingerprints(Directory &directory) noexcept
+{
+	if (directory.device == DEVICE_INARCHIVE ||
+	    directory.device == DEVICE_CONTAINER)
+		return;
+
+	std::list<FingerprintItem> items;
+	for (const auto &song : directory.songs) {
+		if (!IsFingerprintCandidate(song))
+			continue;
+
+		auto path = storage.MapFS(song.GetURI().c_str());
+		if (path.IsNull())
+			/* not a local file */
+			continue;
+
+		items.emplace_back(song.GetURI(), std::move(path));
+	}
+
+	if (items.empty())
+		return;
+
+	/* skip the songs which have a fingerprint already; this
+	   looks them all up with one batched query */
+
+	std::vector<const char *> uris;
+	uris.reserve(items.size());
+	for (const auto &item : items)
+		uris.push_back(item.uri.c_str());
+
+	std::set<std::string> found;
+	try {
+		sticker_load_values("song", FINGERPRINT_STICKER,
+				    {uris.data(), uris.size()},
+				    CollectFingerprintUri, &found);
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
+
+	items.remove_if([&found](const FingerprintItem &item){
+			return found.find(item.uri) != found.end();
+		});
+
+	if (items.empty())
+		return;
+
+	FormatDebug(update_domain, "fingerprinting %s",
+		    directory.GetPath());
+
+	if (scan_pool) {
+		WorkerPool::Group group;
+		for (auto &item : items)
+			scan_pool->Push(group, [this, &item](){
+					ScanSongFingerprint(item);
+				});
+		scan_pool->Wait(group);
+	} else {
+		for (auto &item : items) {
+			if (cancel)
+				break;
+
+			ScanSongFingerprint(item);
+		}
+	}
+
+	if (cancel)
+		return;
+
+	for (const auto &item : items) {
+		if (item.fingerprint.empty())
+			continue;
+
+		try {
+			sticker_store_value("song", item.uri.c_str(),
+					    FINGERPRINT_STICKER,
+					    item.fingerprint.c_str());
+		} catch (...) {
+			LogError(std::current_exception());
+			return;
+		}
+	}
+}
+
+void
+UpdateWalk::ScanFingerprints(Directory &directory) noexcept
+{
+	for (auto &child : directory.children) {
+		if (cancel)
+			return;
+
+		if (!child.IsMount())
+			ScanFingerprints(child);
+	}
+
+	ScanDirectoryFingerprints(directory);
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "FingerprintScan.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "tag/Chromaprint.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/Path.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <exception>
+#include <stdexcept>
+
+#include <assert.h>
+
+/**
+ * A #DecoderClient which feeds the first few seconds of a song into
+ * libchromaprint and then stops the decoder.
+ */
+class FingerprintDecoderClient final : public DecoderClient {
+	const std::atomic_bool &cancel;
+
+	const unsigned duration;
+
+	Chromaprint::Context chromaprint;
+
+	PcmBuffer buffer;
+
+	PcmDither dither;
+
+	SampleFormat format;
+
+	/**
+	 * The number of bytes (in the decoder's sample format) which
+	 * are still needed.
+	 */
+	uint64_t remaining_bytes;
+
+public:
+	Mutex mutex;
+
+	bool ready = false;
+
+	/**
+	 * An error thrown by libchromaprint in SubmitData(), to be
+	 * rethrown after the decoder has returned.
+	 */
+	std::exception_ptr error;
+
+	FingerprintDecoderClient(unsigned _duration,
+				 const std::atomic_bool &_cancel) noexcept
+		:cancel(_cancel), duration(_duration) {}
+
+	std::string Finish();
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) override;
+
+	DecoderCommand GetCommand() noexcept override {
+		return cancel || error || (ready && remaining_bytes == 0)
+			? DecoderCommand::STOP
+			: DecoderCommand::NONE;
+	}
+
+	void CommandFinished() override {}
+
+	SongTime GetSeekTime() noexcept override {
+		return SongTime::zero();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return 0;
+	}
+
+	void SeekError() override {}
+
+	InputStreamPtr OpenUri(const char *uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is, void *buffer, size_t length) override;
+
+	void SubmitTimestamp(FloatDuration) override {}
+
+	DecoderCommand SubmitData(InputStream *is,
+				  const void *data, size_t length,
+				  uint16_t kbit_rate) override;
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *) override {}
+
+	void SubmitMixRamp(MixRampInfo &&) override {}
+};
+
+void
+FingerprintDecoderClient::Ready(AudioFormat audio_format, bool, SignedSongTime)
+{
+	assert(!ready);
+	assert(audio_format.IsValid());
+
+	format = audio_format.format;
+	remaining_bytes =
+		audio_format.TimeToSize(std::chrono::seconds(duration));
+
+	try {
+		chromaprint.Start(audio_format.sample_rate,
+				  audio_format.channels);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	ready = true;
+}
+
+size_t
+FingerprintDecoderClient::Read(InputStream &is, void *dest, size_t length)
+{
+	if (GetCommand() != DecoderCommand::NONE)
+		return 0;
+
+	try {
+		return is.LockRead(dest, length);
+	} catch (...) {
+		return 0;
+	}
+}
+
+DecoderCommand
+FingerprintDecoderClient::SubmitData(InputStream *, const void *data,
+				     size_t length, uint16_t)
+{
+	assert(ready);
+
+	if (GetCommand() != DecoderCommand::NONE)
+		return GetCommand();
+
+	if (length > remaining_bytes)
+		/* the frame size divides remaining_bytes, so this
+		   doesn't split a frame */
+		length = remaining_bytes;
+	remaining_bytes -= length;
+
+	const auto s16 = pcm_convert_to_16(buffer, dither, format,
+					   {data, length});
+	if (s16.IsNull()) {
+		/* DSD is not supported */
+		remaining_bytes = 0;
+		error = std::make_exception_ptr(std::runtime_error("Unsupported sample format"));
+		return DecoderCommand::STOP;
+	}
+
+	try {
+		chromaprint.Feed(s16.data, s16.size);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	return GetCommand();
+}
+
+std::string
+FingerprintDecoderClient::Finish()
+{
+	assert(ready);
+
+	if (error)
+		std::rethrow_exception(error);
+
+	chromaprint.Finish();
+	return chromaprint.GetFingerprint();
+}
+
+std::string
+ScanFileFingerprint(Path path_fs, unsigned duration,
+		    const std::atomic_bool &cancel)
+{
+	const auto *suffix = path_fs.GetSuffix();
+	if (suffix == nullptr)
+		return std::string();
+
+	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
+
+	std::string fingerprint;
+
+	decoder_plugins_try_suffix(suffix_utf8.c_str(),
+				   [&](const DecoderPlugin &plugin){
+		if (cancel)
+			/* stop trying */
+			return true;
+
+		FingerprintDecoderClient client(duration, cancel);
+
+		if (plugin.file_decode != nullptr) {
+			plugin.FileDecode(client, path_fs);
+		} else if (plugin.stream_decode != nullptr) {
+			auto is = OpenLocalInputStream(path_fs, client.mutex);
+			plugin.StreamDecode(client, *is);
+		} else
+			return false;
+
+		if (!client.ready)
+			return false;
+
+		if (!cancel)
+			fingerprint = client.Finish();
+		return true;
+	});
+
+	return fingerprint;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_FINGERPRINT_SCAN_HXX
+#define MPD_UPDATE_FINGERPRINT_SCAN_HXX
+
+#include <atomic>
+#include <string>
+
+class Path;
+
+/**
+ * Decode the beginning of the given file and calculate its
+ * Chromaprint fingerprint.
+ *
+ * Throws on error.
+ *
+ * @param duration the number of seconds to be decoded
+ * @param cancel if this flag becomes true, decoding is stopped
+ * @return the fingerprint or an empty string if no decoder plugin
+ * was able to decode the file (or if cancelled)
+ */
+std::string
+ScanFileFingerprint(Path path_fs, unsigned duration,
+		    const std::atomic_bool &cancel);
+
+#endif
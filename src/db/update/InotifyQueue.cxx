@@ -32,6 +32,14 @@
 static constexpr std::chrono::steady_clock::duration INOTIFY_UPDATE_DELAY =
 	std::chrono::seconds(5);
 
+/**
+ * If more than this number of entries of one directory are queued,
+ * they are replaced with the directory.  One update of a directory
+ * is cheaper than lots of single-file updates, and it leaves room in
+ * the #UpdateService queue.
+ */
+static constexpr unsigned MAX_ENTRIES_PER_DIRECTORY = 16;
+
 void
 InotifyQueue::OnDelay() noexcept
 {
@@ -78,6 +86,19 @@ path_in(const char *path, const char *possible_parent) noexcept
 		(StringIsEmpty(rest) || rest[0] == '/');
 }
 
+/**
+ * Returns the parent directory of the given URI; the parent of a
+ * top-level entry is the empty string (the music directory).
+ */
+static std::string
+GetParentUri(const std::string &uri)
+{
+	const auto slash = uri.rfind('/');
+	return slash != std::string::npos
+		? uri.substr(0, slash)
+		: std::string();
+}
+
 void
 InotifyQueue::Enqueue(const char *uri_utf8)
 {
@@ -100,4 +121,18 @@ InotifyQueue::Enqueue(const char *uri_utf8)
 	}
 
 	queue.emplace_back(uri_utf8);
+
+	if (StringIsEmpty(uri_utf8))
+		return;
+
+	const std::string parent = GetParentUri(queue.back());
+	unsigned n = 0;
+	for (const auto &i : queue)
+		if (GetParentUri(i) == parent)
+			++n;
+
+	if (n > MAX_ENTRIES_PER_DIRECTORY)
+		/* this collapses all entries of the directory into
+		   one */
+		Enqueue(parent.c_str());
 }
@@ -236,7 +236,7 @@ WatchDirectory::GetDepth() const noexcept
 
 static void
 mpd_inotify_callback(int wd, unsigned mask,
-		     gcc_unused const char *name, gcc_unused void *ctx)
+		     const char *name, gcc_unused void *ctx)
 {
 	WatchDirectory *directory;
 
@@ -273,15 +273,29 @@ mpd_inotify_callback(int wd, unsigned mask,
 	    (directory->GetDepth() == inotify_max_depth &&
 	     (mask & (IN_CREATE|IN_ISDIR)) == (IN_CREATE|IN_ISDIR))) {
 		/* a file was changed, or a directory was
-		   moved/deleted: queue a database update */
+		   moved/deleted: queue a database update of just this
+		   directory entry */
 
+		std::string uri_utf8;
 		if (!uri_fs.IsNull()) {
-			const std::string uri_utf8 = uri_fs.ToUTF8();
-			if (!uri_utf8.empty())
-				inotify_queue->Enqueue(uri_utf8.c_str());
+			uri_utf8 = uri_fs.ToUTF8();
+			if (uri_utf8.empty())
+				return;
 		}
-		else
-			inotify_queue->Enqueue("");
+
+		/* a modified ".mpdignore" affects the whole
+		   directory */
+		if (name != nullptr && !skip_path(name) &&
+		    strcmp(name, ".mpdignore") != 0) {
+			const std::string name_utf8 = Path::FromFS(name).ToUTF8();
+			if (!name_utf8.empty()) {
+				if (!uri_utf8.empty())
+					uri_utf8.push_back('/');
+				uri_utf8 += name_utf8;
+			}
+		}
+
+		inotify_queue->Enqueue(uri_utf8.c_str());
 	}
 }
 
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Walk.hxx"
+#include "LoudnessScan.hxx"
+#include "UpdateDomain.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/StorageInterface.hxx"
+#include "pcm/LoudnessMeter.hxx"
+#include "pcm/MixRampMeter.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <list>
+#include <vector>
+
+#include <math.h>
+
+/**
+ * The loudness which corresponds to a ReplayGain of 0 dB
+ * (ReplayGain 2.0) [LUFS].
+ */
+static constexpr double REPLAY_GAIN_REFERENCE = -18;
+
+static ReplayGainTuple
+MakeReplayGainTuple(double loudness, float peak) noexcept
+{
+	/* if there's no audible sample at all, leave the volume
+	   alone, but remember that the file has been measured */
+	return {
+		isnan(loudness) ? 0.0f : float(REPLAY_GAIN_REFERENCE - loudness),
+		peak,
+	};
+}
+
+/**
+ * Shall the loudness of this song be measured?
+ */
+gcc_pure
+static bool
+IsLoudnessCandidate(const Song &song) noexcept
+{
+	/* sub-songs (e.g. from a CUE sheet) cannot be decoded
+	   separately */
+	return song.start_time.IsZero() && song.end_time.IsZero();
+}
+
+struct UpdateWalk::LoudnessItem {
+	Song &song;
+
+	const AllocatedPath path;
+
+	LoudnessMeter meter;
+
+	MixRampMeter mix_ramp_meter;
+
+	ReplayGainInfo tags = ReplayGainInfo::Undefined();
+
+	MixRampInfo mix_ramp_tags;
+
+	/**
+	 * Measure the loudness?  Only used for the album loudness
+	 * if the song itself has ReplayGain values already.
+	 */
+	const bool loudness;
+
+	/**
+	 * Calculate the MixRamp profile?
+	 */
+	const bool mix_ramp;
+
+	bool success = false;
+
+	LoudnessItem(Song &_song, AllocatedPath &&_path,
+		     bool _loudness, bool _mix_ramp) noexcept
+		:song(_song), path(std::move(_path)),
+		 loudness(_loudness), mix_ramp(_mix_ramp) {}
+};
+
+void
+UpdateWalk::ScanSongLoudness(LoudnessItem &item) noexcept
+{
+	try {
+		item.success = ScanFileLoudness(item.path,
+						item.loudness ? &item.meter : nullptr,
+						item.mix_ramp ? &item.mix_ramp_meter : nullptr,
+						item.tags, item.mix_ramp_tags,
+						cancel);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to measure the loudness of %s",
+			    item.song.GetURI().c_str());
+	}
+}
+
+void
+UpdateWalk::ScanDirectoryLoudness(Directory &directory) noexcept
+{
+	if (directory.device == DEVICE_INARCHIVE ||
+	    directory.device == DEVICE_CONTAINER)
+		return;
+
+	/* measure all songs of the directory if one of them is
+	   missing (because the album loudness is calculated from all
+	   of them); MixRamp profiles are calculated only for the
+	   songs which don't have one */
+
+	bool loudness = false;
+	if (config.loudness_scan) {
+		for (const auto &song : directory.songs) {
+			if (IsLoudnessCandidate(song) &&
+			    !song.replay_gain.IsDefined()) {
+				loudness = true;
+				break;
+			}
+		}
+	}
+
+	std::list<LoudnessItem> items;
+	for (auto &song : directory.songs) {
+		if (!IsLoudnessCandidate(song))
+			continue;
+
+		const bool mix_ramp = config.mixramp_scan &&
+			!song.mix_ramp.IsDefined();
+		if (!loudness && !mix_ramp)
+			continue;
+
+		auto path = storage.MapFS(song.GetURI().c_str());
+		if (path.IsNull())
+			/* not a local file */
+			continue;
+
+		items.emplace_back(song, std::move(path), loudness, mix_ramp);
+	}
+
+	if (items.empty())
+		return;
+
+	FormatDebug(update_domain, "analyzing %s",
+		    directory.GetPath());
+
+	if (scan_pool) {
+		WorkerPool::Group group;
+		for (auto &item : items)
+			scan_pool->Push(group, [this, &item](){
+					ScanSongLoudness(item);
+				});
+		scan_pool->Wait(group);
+	} else {
+		for (auto &item : items) {
+			if (cancel)
+				break;
+
+			ScanSongLoudness(item);
+		}
+	}
+
+	if (cancel)
+		return;
+
+	/* the album loudness: all gating blocks of all songs */
+
+	std::vector<double> album_blocks;
+	float album_peak = 0;
+
+	for (const auto &item : items) {
+		if (!item.success || !item.loudness)
+			continue;
+
+		const auto &blocks = item.meter.GetBlocks();
+		album_blocks.insert(album_blocks.end(),
+				    blocks.begin(), blocks.end());
+		album_peak = std::max(album_peak, item.meter.GetPeak());
+	}
+
+	const auto album =
+		MakeReplayGainTuple(LoudnessMeter::Integrate(album_blocks),
+				    album_peak);
+
+	const ScopeDatabaseLock protect;
+
+	for (auto &item : items) {
+		if (!item.success)
+			continue;
+
+		if (item.loudness) {
+			auto &rg = item.song.replay_gain;
+			if (item.tags.IsDefined()) {
+				/* the file has ReplayGain tags; the
+				   decoder will use them anyway, but
+				   store them to remember that this
+				   file has been done */
+				rg = item.tags;
+			} else {
+				rg.track = MakeReplayGainTuple(item.meter.GetLoudness(),
+							       item.meter.GetPeak());
+				rg.album = album;
+			}
+		}
+
+		if (item.mix_ramp) {
+			auto &mr = item.song.mix_ramp;
+			if (item.mix_ramp_tags.IsDefined()) {
+				/* same for MixRamp tags */
+				mr = std::move(item.mix_ramp_tags);
+			} else {
+				mr.SetStart(item.mix_ramp_meter.GetStart());
+				mr.SetEnd(item.mix_ramp_meter.GetEnd());
+			}
+		}
+
+		directory.MarkModified();
+		modified = true;
+	}
+}
+
+void
+UpdateWalk::ScanLoudness(Directory &directory) noexcept
+{
+	for (auto &child : directory.children) {
+		if (cancel)
+			return;
+
+		if (!child.IsMount())
+			ScanLoudness(child);
+	}
+
+	ScanDirectoryLoudness(directory);
+}
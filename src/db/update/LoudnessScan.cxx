@@ -0,0 +1,200 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "LoudnessScan.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "pcm/LoudnessMeter.hxx"
+#include "pcm/MixRampMeter.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/Path.hxx"
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <assert.h>
+
+/**
+ * A #DecoderClient which feeds all samples into a #LoudnessMeter
+ * and a #MixRampMeter instead of playing them.
+ */
+class LoudnessDecoderClient final : public DecoderClient {
+	const std::atomic_bool &cancel;
+
+	LoudnessMeter *const meter;
+
+	MixRampMeter *const mix_ramp_meter;
+
+	PcmBuffer buffer;
+
+	SampleFormat format;
+
+public:
+	Mutex mutex;
+
+	bool ready = false;
+
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
+	MixRampInfo mix_ramp;
+
+	LoudnessDecoderClient(LoudnessMeter *_meter,
+			      MixRampMeter *_mix_ramp_meter,
+			      const std::atomic_bool &_cancel) noexcept
+		:cancel(_cancel), meter(_meter),
+		 mix_ramp_meter(_mix_ramp_meter) {}
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) override;
+
+	DecoderCommand GetCommand() noexcept override {
+		return cancel ? DecoderCommand::STOP : DecoderCommand::NONE;
+	}
+
+	void CommandFinished() override {}
+
+	SongTime GetSeekTime() noexcept override {
+		return SongTime::zero();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return 0;
+	}
+
+	void SeekError() override {}
+
+	InputStreamPtr OpenUri(const char *uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is, void *buffer, size_t length) override;
+
+	void SubmitTimestamp(FloatDuration) override {}
+
+	DecoderCommand SubmitData(InputStream *is,
+				  const void *data, size_t length,
+				  uint16_t kbit_rate) override;
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *info) override {
+		if (info != nullptr)
+			replay_gain = *info;
+	}
+
+	void SubmitMixRamp(MixRampInfo &&_mix_ramp) override {
+		if (_mix_ramp.IsDefined())
+			mix_ramp = std::move(_mix_ramp);
+	}
+};
+
+void
+LoudnessDecoderClient::Ready(AudioFormat audio_format, bool, SignedSongTime)
+{
+	assert(!ready);
+	assert(audio_format.IsValid());
+
+	format = audio_format.format;
+	if (meter != nullptr)
+		meter->Open(audio_format.sample_rate, audio_format.channels);
+	if (mix_ramp_meter != nullptr)
+		mix_ramp_meter->Open(audio_format.sample_rate,
+				     audio_format.channels);
+	ready = true;
+}
+
+size_t
+LoudnessDecoderClient::Read(InputStream &is, void *dest, size_t length)
+{
+	if (cancel)
+		return 0;
+
+	try {
+		return is.LockRead(dest, length);
+	} catch (...) {
+		return 0;
+	}
+}
+
+DecoderCommand
+LoudnessDecoderClient::SubmitData(InputStream *, const void *data,
+				  size_t length, uint16_t)
+{
+	assert(ready);
+
+	const auto f = pcm_convert_to_float(buffer, format, {data, length});
+	if (f.IsNull())
+		/* DSD is not supported */
+		return DecoderCommand::STOP;
+
+	if (meter != nullptr)
+		meter->Feed(f);
+	if (mix_ramp_meter != nullptr)
+		mix_ramp_meter->Feed(f);
+	return GetCommand();
+}
+
+bool
+ScanFileLoudness(Path path_fs, LoudnessMeter *meter,
+		 MixRampMeter *mix_ramp_meter,
+		 ReplayGainInfo &replay_gain, MixRampInfo &mix_ramp,
+		 const std::atomic_bool &cancel)
+{
+	const auto *suffix = path_fs.GetSuffix();
+	if (suffix == nullptr)
+		return false;
+
+	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
+
+	const bool found = decoder_plugins_try_suffix(suffix_utf8.c_str(),
+						      [&](const DecoderPlugin &plugin){
+		if (cancel)
+			/* stop trying */
+			return true;
+
+		LoudnessDecoderClient client(meter, mix_ramp_meter, cancel);
+
+		if (plugin.file_decode != nullptr) {
+			plugin.FileDecode(client, path_fs);
+		} else if (plugin.stream_decode != nullptr) {
+			auto is = OpenLocalInputStream(path_fs, client.mutex);
+			plugin.StreamDecode(client, *is);
+		} else
+			return false;
+
+		if (!client.ready)
+			return false;
+
+		replay_gain = client.replay_gain;
+		mix_ramp = std::move(client.mix_ramp);
+		return true;
+	});
+
+	return found && !cancel;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_LOUDNESS_SCAN_HXX
+#define MPD_UPDATE_LOUDNESS_SCAN_HXX
+
+#include <atomic>
+
+class Path;
+class LoudnessMeter;
+class MixRampMeter;
+struct ReplayGainInfo;
+class MixRampInfo;
+
+/**
+ * Decode the given file and feed all samples into the
+ * #LoudnessMeter and the #MixRampMeter.
+ *
+ * Throws on error.
+ *
+ * @param meter the #LoudnessMeter or nullptr if the loudness shall
+ * not be measured
+ * @param mix_ramp_meter the #MixRampMeter or nullptr if no MixRamp
+ * profile shall be calculated
+ * @param replay_gain receives the ReplayGain tags submitted by the
+ * decoder plugin (undefined if the file has none)
+ * @param mix_ramp receives the MixRamp tags submitted by the
+ * decoder plugin (undefined if the file has none)
+ * @param cancel if this flag becomes true, decoding is stopped
+ * @return false if no decoder plugin was able to decode the file
+ * (or if cancelled)
+ */
+bool
+ScanFileLoudness(Path path_fs, LoudnessMeter *meter,
+		 MixRampMeter *mix_ramp_meter,
+		 ReplayGainInfo &replay_gain, MixRampInfo &mix_ramp,
+		 const std::atomic_bool &cancel);
+
+#endif
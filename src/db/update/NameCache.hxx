@@ -0,0 +1,70 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_NAME_CACHE_HXX
+#define MPD_UPDATE_NAME_CACHE_HXX
+
+#include "fs/AllocatedPath.hxx"
+#include "fs/Charset.hxx"
+
+#include <string>
+#include <unordered_map>
+
+/**
+ * Memoizes the conversion of file names within one directory from
+ * UTF-8 to the filesystem charset.  During an update, each name is
+ * converted more than once (for the ".mpdignore" check of existing
+ * children and again while reading the directory), and with a
+ * non-UTF-8 filesystem charset, each conversion goes through
+ * iconv/ICU.
+ *
+ * If no conversion is necessary, the cache is bypassed.
+ */
+class UpdateNameCache {
+	const bool enabled = IsFSCharsetConverted();
+
+	std::unordered_map<std::string, AllocatedPath> map;
+
+	/**
+	 * Holds the most recent result if the cache is disabled.
+	 */
+	AllocatedPath last = nullptr;
+
+public:
+	/**
+	 * Convert the name to the filesystem charset.  The returned
+	 * #Path is "nulled" if conversion failed; it is valid until
+	 * the next call.
+	 */
+	Path Get(const char *name_utf8) noexcept {
+		if (!enabled) {
+			last = AllocatedPath::FromUTF8(name_utf8);
+			return last;
+		}
+
+		auto i = map.find(name_utf8);
+		if (i == map.end())
+			i = map.emplace(name_utf8,
+					AllocatedPath::FromUTF8(name_utf8)).first;
+
+		return i->second;
+	}
+};
+
+#endif
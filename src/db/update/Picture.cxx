@@ -0,0 +1,75 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Walk.hxx"
+#include "UpdateDomain.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "PictureCache.hxx"
+#include "PictureScan.hxx"
+#include "Log.hxx"
+
+void
+UpdateWalk::ScanDirectoryPictures(Directory &directory) noexcept
+{
+	if (directory.device == DEVICE_INARCHIVE ||
+	    directory.device == DEVICE_CONTAINER)
+		return;
+
+	for (const auto &song : directory.songs) {
+		if (cancel)
+			return;
+
+		if (!song.start_time.IsZero() || !song.end_time.IsZero())
+			/* a sub-song (e.g. from a CUE sheet) */
+			continue;
+
+		const auto path = storage.MapFS(song.GetURI().c_str());
+		if (path.IsNull())
+			/* not a local file */
+			continue;
+
+		Picture picture;
+		if (picture_cache->Load(path.c_str(), song.mtime, picture))
+			continue;
+
+		FormatDebug(update_domain, "extracting picture from %s",
+			    path.c_str());
+
+		ScanFilePicture(path, picture);
+		picture_cache->Store(path.c_str(), song.mtime, picture);
+	}
+}
+
+void
+UpdateWalk::ScanPictures(Directory &directory) noexcept
+{
+	for (auto &child : directory.children) {
+		if (cancel)
+			return;
+
+		if (!child.IsMount())
+			ScanPictures(child);
+	}
+
+	ScanDirectoryPictures(directory);
+}
@@ -19,14 +19,19 @@
 
 #include "Service.hxx"
 #include "Walk.hxx"
+#include "TagScanCache.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseListener.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "tag/Pool.hxx"
 #include "protocol/Ack.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
 #include "Idle.hxx"
+#include "ThreadConfig.hxx"
 #include "Log.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
@@ -48,6 +53,9 @@ UpdateService::UpdateService(const ConfigData &_config,
 	 listener(_listener),
 	 update_thread(BIND_THIS_METHOD(Task))
 {
+	auto tag_cache_path = _config.GetPath(ConfigOption::TAG_CACHE_FILE);
+	if (!tag_cache_path.IsNull())
+		tag_cache = std::make_unique<TagScanCache>(std::move(tag_cache_path));
 }
 
 UpdateService::~UpdateService()
@@ -79,7 +87,7 @@ UpdateService::CancelMount(const char *uri)
 
 	Directory::LookupResult lr;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		lr = db.GetRoot().LookupDirectory(uri);
 	}
 
@@ -121,6 +129,12 @@ UpdateService::Task()
 		LogDebug(update_domain, "starting");
 
 	SetThreadIdlePriority();
+	update_thread_config.Apply("update");
+
+	if (tag_cache != nullptr)
+		tag_cache->Load();
+
+	next.db->BeginUpdate();
 
 	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
 			      next.discard);
@@ -133,12 +147,27 @@ UpdateService::Task()
 		}
 	}
 
+	next.db->EndUpdate();
+
+	if (tag_cache != nullptr)
+		/* after a full rescan of the music directory, entries
+		   which were not used refer to files which no longer
+		   exist (or have been modified) */
+		tag_cache->Save(next.discard && next.path_utf8.empty() &&
+				next.db == &db);
+
 	if (!next.path_utf8.empty())
 		FormatDebug(update_domain, "finished: %s",
 			    next.path_utf8.c_str());
 	else
 		LogDebug(update_domain, "finished");
 
+	const auto pool_stats = tag_pool_get_stats();
+	FormatDebug(update_domain,
+		    "tag pool: %zu items in %zu buckets, %llu contended locks",
+		    pool_stats.n_items, pool_stats.n_buckets,
+		    (unsigned long long)pool_stats.n_contended);
+
 	defer.Schedule();
 }
 
@@ -151,7 +180,8 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(config, GetEventLoop(), listener, *next.storage);
+	walk = new UpdateWalk(config, GetEventLoop(), listener, *next.storage,
+			      tag_cache.get(), exclude_cache);
 
 	update_thread.Start();
 
@@ -180,7 +210,7 @@ UpdateService::Enqueue(const char *path, bool discard)
 
 	Directory::LookupResult lr;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		lr = db.GetRoot().LookupDirectory(path);
 	}
 
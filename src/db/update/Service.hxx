@@ -22,14 +22,18 @@
 
 #include "Config.hxx"
 #include "Queue.hxx"
+#include "ExcludeList.hxx"
 #include "event/DeferEvent.hxx"
 #include "thread/Thread.hxx"
 #include "util/Compiler.h"
 
+#include <memory>
+
 class SimpleDatabase;
 class DatabaseListener;
 class UpdateWalk;
 class CompositeStorage;
+class TagScanCache;
 
 /**
  * This class manages the update queue and runs the update thread.
@@ -58,6 +62,18 @@ class UpdateService final {
 
 	UpdateWalk *walk = nullptr;
 
+	/**
+	 * The persistent tag scan cache; nullptr if
+	 * "tag_cache_file" is not configured.
+	 */
+	std::unique_ptr<TagScanCache> tag_cache;
+
+	/**
+	 * Compiled ".mpdignore" files, kept between updates.  Only
+	 * the update thread accesses it.
+	 */
+	ExcludeCache exclude_cache;
+
 public:
 	UpdateService(const ConfigData &_config,
 		      EventLoop &_loop, SimpleDatabase &_db,
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagScanCache.hxx"
+#include "UpdateDomain.hxx"
+#include "storage/FileInfo.hxx"
+#include "tag/Builder.hxx"
+#include "tag/ParseName.hxx"
+#include "TagSave.hxx"
+#include "AudioParser.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/StringStrip.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <string.h>
+
+#define TAG_CACHE_KEY "key"
+#define TAG_CACHE_END "end"
+
+std::string
+TagScanCache::MakeKey(const char *path_utf8,
+		      const StorageFileInfo &info) noexcept
+{
+	if (info.inode != 0) {
+		/* the inode number identifies the file even if it is
+		   reachable through more than one path */
+		return std::to_string(info.device) + ':' +
+			std::to_string(info.inode);
+	}
+
+	return path_utf8;
+}
+
+void
+TagScanCache::LoadFile()
+{
+	TextFile file(path);
+
+	std::string key;
+	Entry entry;
+	TagBuilder tag;
+	bool in_entry = false;
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (!in_entry) {
+			const char *value = StringAfterPrefix(line,
+							      TAG_CACHE_KEY ": ");
+			if (value == nullptr)
+				throw FormatRuntimeError("unknown line in tag cache: %s",
+							 line);
+
+			key = value;
+			entry.mtime = std::chrono::system_clock::time_point::min();
+			entry.size = 0;
+			entry.audio_format = AudioFormat::Undefined();
+			entry.used = false;
+			in_entry = true;
+			continue;
+		}
+
+		if (StringIsEqual(line, TAG_CACHE_END)) {
+			tag.Commit(entry.tag);
+			map.emplace(std::move(key), std::move(entry));
+			in_entry = false;
+			continue;
+		}
+
+		char *colon = strchr(line, ':');
+		if (colon == nullptr || colon == line)
+			throw FormatRuntimeError("unknown line in tag cache: %s",
+						 line);
+
+		*colon++ = 0;
+		const char *value = StripLeft(colon);
+
+		TagType type;
+		if ((type = tag_name_parse(line)) != TAG_NUM_OF_ITEM_TYPES) {
+			tag.AddItem(type, value);
+		} else if (StringIsEqual(line, "Time")) {
+			tag.SetDuration(SignedSongTime::FromS(ParseDouble(value)));
+		} else if (StringIsEqual(line, "Playlist")) {
+			tag.SetHasPlaylist(StringIsEqual(value, "yes"));
+		} else if (StringIsEqual(line, "Format")) {
+			try {
+				entry.audio_format =
+					ParseAudioFormat(value, false);
+			} catch (...) {
+				/* ignore parser errors */
+			}
+		} else if (StringIsEqual(line, "mtime")) {
+			entry.mtime = std::chrono::system_clock::from_time_t(ParseUint64(value));
+		} else if (StringIsEqual(line, "size")) {
+			entry.size = ParseUint64(value);
+		} else
+			throw FormatRuntimeError("unknown line in tag cache: %s",
+						 line);
+	}
+}
+
+void
+TagScanCache::Load() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (loaded)
+		return;
+
+	loaded = true;
+
+	if (!FileExists(path))
+		return;
+
+	try {
+		LoadFile();
+		FormatDebug(update_domain, "loaded %zu tag cache entries",
+			    map.size());
+	} catch (...) {
+		map.clear();
+		LogError(std::current_exception(),
+			 "Failed to load the tag cache");
+	}
+}
+
+void
+TagScanCache::SaveFile() const
+{
+	FileOutputStream fos(path);
+	BufferedOutputStream os(fos);
+
+	for (const auto &i : map) {
+		const auto &entry = i.second;
+
+		os.Format(TAG_CACHE_KEY ": %s\n", i.first.c_str());
+		os.Format("size: %llu\n", (unsigned long long)entry.size);
+		os.Format("mtime: %li\n",
+			  (long)std::chrono::system_clock::to_time_t(entry.mtime));
+
+		if (entry.audio_format.IsDefined())
+			os.Format("Format: %s\n",
+				  ToString(entry.audio_format).c_str());
+
+		tag_save(os, entry.tag);
+		os.Format(TAG_CACHE_END "\n");
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
+void
+TagScanCache::Save(bool prune) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (prune) {
+		for (auto i = map.begin(); i != map.end();) {
+			if (i->second.used) {
+				++i;
+			} else {
+				i = map.erase(i);
+				modified = true;
+			}
+		}
+	}
+
+	if (!modified)
+		return;
+
+	try {
+		SaveFile();
+		modified = false;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save the tag cache");
+	}
+}
+
+inline bool
+TagScanCache::Entry::IsValid(const StorageFileInfo &info) const noexcept
+{
+	/* the cache file stores the time stamp in seconds */
+	return std::chrono::system_clock::to_time_t(mtime) ==
+		std::chrono::system_clock::to_time_t(info.mtime) &&
+		size == info.size;
+}
+
+bool
+TagScanCache::Contains(const std::string &key,
+		       const StorageFileInfo &info) const noexcept
+{
+	if (key.empty())
+		return false;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(key);
+	return i != map.end() && i->second.IsValid(info);
+}
+
+bool
+TagScanCache::Lookup(const std::string &key, const StorageFileInfo &info,
+		     Tag &tag_r, AudioFormat &audio_format_r) noexcept
+{
+	if (key.empty())
+		return false;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(key);
+	if (i == map.end())
+		return false;
+
+	auto &entry = i->second;
+	if (!entry.IsValid(info))
+		return false;
+
+	entry.used = true;
+	tag_r = Tag(entry.tag);
+	audio_format_r = entry.audio_format;
+	return true;
+}
+
+void
+TagScanCache::Store(const std::string &key, const StorageFileInfo &info,
+		    const Tag &tag, AudioFormat audio_format) noexcept
+{
+	if (key.empty() || key.find('\n') != key.npos)
+		/* can't be represented in the cache file */
+		return;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto &entry = map[key];
+	entry.mtime = info.mtime;
+	entry.size = info.size;
+	entry.tag = Tag(tag);
+	entry.audio_format = audio_format;
+	entry.used = true;
+	modified = true;
+}
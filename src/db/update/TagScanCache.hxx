@@ -0,0 +1,143 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_SCAN_CACHE_HXX
+#define MPD_TAG_SCAN_CACHE_HXX
+
+#include "tag/Tag.hxx"
+#include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+#include <stdint.h>
+
+struct StorageFileInfo;
+
+/**
+ * A persistent cache of tag scan results.  It allows the database
+ * update to skip the decoder plugins for files whose contents have
+ * been scanned before, e.g. during a "rescan" or when the same files
+ * are reachable through more than one mounted storage.
+ *
+ * An entry is identified by the file's device/inode number if the
+ * storage knows it, or by its mapped path otherwise; it is only
+ * valid as long as the modification time and the size match.
+ *
+ * All methods except Load() and Save() are thread-safe; they may be
+ * called from the update thread pool.
+ */
+class TagScanCache {
+	struct Entry {
+		std::chrono::system_clock::time_point mtime;
+		uint64_t size;
+
+		Tag tag;
+		AudioFormat audio_format;
+
+		/**
+		 * Was this entry looked up or stored since it was
+		 * loaded?  Used by Save() to discard stale entries.
+		 */
+		bool used;
+
+		/**
+		 * Does this entry still describe the given file?
+		 */
+		gcc_pure
+		bool IsValid(const StorageFileInfo &info) const noexcept;
+	};
+
+	const AllocatedPath path;
+
+	mutable Mutex mutex;
+
+	std::unordered_map<std::string, Entry> map;
+
+	/**
+	 * Were entries added or replaced since the cache was loaded
+	 * or saved?
+	 */
+	bool modified = false;
+
+	bool loaded = false;
+
+public:
+	explicit TagScanCache(AllocatedPath &&_path) noexcept
+		:path(std::move(_path)) {}
+
+	TagScanCache(const TagScanCache &) = delete;
+	TagScanCache &operator=(const TagScanCache &) = delete;
+
+	/**
+	 * Build the key of a file.
+	 *
+	 * @param path_utf8 the mapped path or URI of the file
+	 */
+	static std::string MakeKey(const char *path_utf8,
+				   const StorageFileInfo &info) noexcept;
+
+	/**
+	 * Load the cache file if that has not been done already.
+	 * Errors are logged.
+	 */
+	void Load() noexcept;
+
+	/**
+	 * Write the cache file if it was modified.  Errors are
+	 * logged.
+	 *
+	 * @param prune discard entries which were not used since
+	 * the cache was loaded
+	 */
+	void Save(bool prune) noexcept;
+
+	/**
+	 * Look up a cached scan result.
+	 *
+	 * @return true if a valid entry was found and copied to
+	 * #tag_r and #audio_format_r
+	 */
+	bool Lookup(const std::string &key, const StorageFileInfo &info,
+		    Tag &tag_r, AudioFormat &audio_format_r) noexcept;
+
+	/**
+	 * Is there a valid entry for this file?  Unlike Lookup(), this
+	 * does not mark the entry as used.
+	 */
+	gcc_pure
+	bool Contains(const std::string &key,
+		      const StorageFileInfo &info) const noexcept;
+
+	/**
+	 * Add (or replace) the scan result of a file.
+	 */
+	void Store(const std::string &key, const StorageFileInfo &info,
+		   const Tag &tag, AudioFormat audio_format) noexcept;
+
+private:
+	void LoadFile();
+	void SaveFile() const;
+};
+
+#endif
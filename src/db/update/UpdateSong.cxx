@@ -20,14 +20,117 @@
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
 #include "UpdateDomain.hxx"
+#include "TagScanCache.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "decoder/DecoderList.hxx"
+#include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "TagFile.hxx"
 #include "Log.hxx"
 
 #include <unistd.h>
+#include <assert.h>
+
+void
+UpdateWalk::CommitLoadedSong(Directory &directory, const char *name,
+			     Song *song) noexcept
+{
+	if (song == nullptr) {
+		FormatDebug(update_domain,
+			    "ignoring unrecognized file %s/%s",
+			    directory.GetPath(), name);
+		return;
+	}
+
+	{
+		const ScopeDatabaseLock protect;
+		directory.AddSong(song);
+	}
+
+	modified = true;
+	FormatDefault(update_domain, "added %s/%s",
+		      directory.GetPath(), name);
+}
+
+void
+UpdateWalk::CommitUpdatedSong(Directory &directory, const char *name,
+			      Song &song, bool success) noexcept
+{
+	{
+		const ScopeDatabaseLock protect;
+		directory.EndModifySong(song);
+	}
+
+	if (!success) {
+		FormatDebug(update_domain,
+			    "deleting unrecognized file %s/%s",
+			    directory.GetPath(), name);
+		editor.LockDeleteSong(directory, &song);
+	}
+
+	modified = true;
+}
+
+void
+UpdateWalk::FlushPendingSongs(PendingSongList &list) noexcept
+{
+	assert(scan_pool != nullptr);
+
+	scan_pool->Wait(list.group);
+
+	for (auto &i : list.songs) {
+		if (i.is_new)
+			CommitLoadedSong(i.directory, i.name.c_str(), i.song);
+		else
+			CommitUpdatedSong(i.directory, i.name.c_str(),
+					  *i.song, i.success);
+	}
+
+	list.songs.clear();
+
+	for (auto &i : list.containers) {
+		if (!CommitContainer(i)) {
+			/* not a container after all: load it as a
+			   plain song file */
+			PendingSongList *const saved = pending_songs;
+			pending_songs = nullptr;
+			UpdatePlainSongFile(i.directory, i.name.c_str(),
+					    i.info, nullptr);
+			pending_songs = saved;
+		}
+	}
+
+	list.containers.clear();
+
+#ifdef ENABLE_ARCHIVE
+	for (auto &i : list.archives)
+		CommitArchive(i);
+
+	list.archives.clear();
+#endif
+}
+
+void
+UpdateWalk::PrefetchSongFile(Directory &directory, const char *name,
+			     const StorageFileInfo &info) noexcept
+{
+	const auto path_fs = storage.MapChildFS(directory.GetPath(), name);
+	if (path_fs.IsNull())
+		/* not a local file */
+		return;
+
+	if (tag_cache != nullptr &&
+	    tag_cache->Contains(TagScanCache::MakeKey(path_fs.ToUTF8().c_str(),
+						      info),
+				info))
+		/* will not be scanned */
+		return;
+
+	PrefetchFileTags(path_fs, info.size);
+}
 
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
@@ -36,7 +139,7 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 {
 	Song *song;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		song = directory.FindSong(name);
 	}
 
@@ -58,36 +161,61 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 		return;
 	}
 
+	UpdatePlainSongFile(directory, name, info, song);
+}
+
+void
+UpdateWalk::UpdatePlainSongFile(Directory &directory, const char *name,
+				const StorageFileInfo &info,
+				Song *song) noexcept
+{
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
-		if (song == nullptr) {
-			FormatDebug(update_domain,
-				    "ignoring unrecognized file %s/%s",
-				    directory.GetPath(), name);
+
+		if (pending_songs != nullptr) {
+			/* scan it in the thread pool; it will be
+			   committed by FlushPendingSongs() */
+			PrefetchSongFile(directory, name, info);
+			pending_songs->songs.emplace_back(directory, name,
+							  nullptr);
+			auto &p = pending_songs->songs.back();
+			scan_pool->Push(pending_songs->group, [this, &p](){
+					p.song = Song::LoadFile(storage,
+								p.name.c_str(),
+								p.directory,
+								tag_cache);
+				});
 			return;
 		}
 
+		CommitLoadedSong(directory, name,
+				 Song::LoadFile(storage, name, directory,
+					       tag_cache));
+	} else if (info.mtime != song->mtime || walk_discard) {
+		FormatDefault(update_domain, "updating %s/%s",
+			      directory.GetPath(), name);
+
+		/* CommitUpdatedSong() accounts the new tags */
 		{
 			const ScopeDatabaseLock protect;
-			directory.AddSong(song);
+			directory.BeginModifySong(*song);
 		}
 
-		modified = true;
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), name);
-	} else if (info.mtime != song->mtime || walk_discard) {
-		FormatDefault(update_domain, "updating %s/%s",
-			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
+		if (pending_songs != nullptr) {
+			PrefetchSongFile(directory, name, info);
+			pending_songs->songs.emplace_back(directory, name,
+							  song);
+			auto &p = pending_songs->songs.back();
+			scan_pool->Push(pending_songs->group, [this, &p](){
+					p.success = p.song->UpdateFile(storage,
+								     tag_cache);
+				});
+			return;
 		}
 
-		modified = true;
+		CommitUpdatedSong(directory, name, *song,
+				  song->UpdateFile(storage, tag_cache));
 	}
 }
 
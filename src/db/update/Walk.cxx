@@ -29,6 +29,7 @@
 #include "storage/StorageInterface.hxx"
 #include "playlist/PlaylistRegistry.hxx"
 #include "ExcludeList.hxx"
+#include "NameCache.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
@@ -38,10 +39,20 @@
 #include "util/Alloc.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriUtil.hxx"
+#include "PictureCache.hxx"
 #include "Log.hxx"
+#include "util/Trace.hxx"
+
+#if defined(ENABLE_CHROMAPRINT) && defined(ENABLE_SQLITE)
+#include "sticker/StickerDatabase.hxx"
+#endif
 
 #include <stdexcept>
+#include <forward_list>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <assert.h>
 #include <string.h>
@@ -50,13 +61,51 @@
 
 UpdateWalk::UpdateWalk(const UpdateConfig &_config,
 		       EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage) noexcept
+		       Storage &_storage, TagScanCache *_tag_cache,
+		       ExcludeCache &_exclude_cache) noexcept
 	:config(_config), cancel(false),
-	 storage(_storage),
+	 storage(_storage), tag_cache(_tag_cache),
+	 exclude_cache(_exclude_cache),
 	 editor(_loop, _listener)
 {
 }
 
+void
+UpdateWalk::LoadExcludeList(ExcludeList &exclude_list,
+			    const Directory &directory) noexcept
+try {
+	const auto uri =
+		PathTraitsUTF8::Build(storage.MapUTF8(directory.GetPath()).c_str(),
+				      ".mpdignore");
+
+	StorageFileInfo info;
+	try {
+		info = storage.GetInfo(PathTraitsUTF8::Build(directory.GetPath(),
+							     ".mpdignore").c_str(),
+				       true);
+	} catch (...) {
+		exclude_cache.Remove(uri);
+		throw;
+	}
+
+	auto patterns = exclude_cache.Get(uri, info.mtime, info.size);
+	if (patterns == nullptr) {
+		Mutex mutex;
+		auto is = InputStream::OpenReady(uri.c_str(), mutex);
+
+		auto p = std::make_shared<ExcludePatterns>();
+		p->Load(std::move(is));
+		patterns = std::move(p);
+
+		exclude_cache.Put(uri, info.mtime, info.size, patterns);
+	}
+
+	exclude_list.Set(std::move(patterns));
+} catch (...) {
+	if (!IsFileNotFound(std::current_exception()))
+		LogError(std::current_exception());
+}
+
 static void
 directory_set_stat(Directory &dir, const StorageFileInfo &info)
 {
@@ -66,13 +115,13 @@ directory_set_stat(Directory &dir, const StorageFileInfo &info)
 
 inline void
 UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
-					const ExcludeList &exclude_list) noexcept
+					const ExcludeList &exclude_list,
+					UpdateNameCache &name_cache) noexcept
 {
 	const ScopeDatabaseLock protect;
 
 	directory.ForEachChildSafe([&](Directory &child){
-			const auto name_fs =
-				AllocatedPath::FromUTF8(child.GetName());
+			const auto name_fs = name_cache.Get(child.GetName());
 
 			if (name_fs.IsNull() || exclude_list.Check(name_fs)) {
 				editor.DeleteDirectory(&child);
@@ -83,7 +132,7 @@ UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 	directory.ForEachSongSafe([&](Song &song){
 			assert(song.parent == &directory);
 
-			const auto name_fs = AllocatedPath::FromUTF8(song.uri);
+			const auto name_fs = name_cache.Get(song.uri);
 			if (name_fs.IsNull() || exclude_list.Check(name_fs)) {
 				editor.DeleteSong(directory, &song);
 				modified = true;
@@ -119,6 +168,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 						i->name.c_str())) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			directory.MarkModified();
 		} else
 			++i;
 	}
@@ -186,8 +236,10 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		directory.MarkModified();
 		modified = true;
+	}
 	return true;
 }
 
@@ -324,6 +376,8 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 			    const ExcludeList &exclude_list,
 			    const StorageFileInfo &info) noexcept
 {
+	const TraceSpan trace_span("update/directory");
+
 	assert(info.IsDirectory());
 
 	directory_set_stat(directory, info);
@@ -338,30 +392,30 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 	}
 
 	ExcludeList child_exclude_list(exclude_list);
+	LoadExcludeList(child_exclude_list, directory);
 
-	try {
-		Mutex mutex;
-		auto is = InputStream::OpenReady(PathTraitsUTF8::Build(storage.MapUTF8(directory.GetPath()).c_str(),
-								       ".mpdignore").c_str(),
-						 mutex);
-		child_exclude_list.Load(std::move(is));
-	} catch (...) {
-		if (!IsFileNotFound(std::current_exception()))
-			LogError(std::current_exception());
-	}
+	UpdateNameCache name_cache;
 
 	if (!child_exclude_list.IsEmpty())
-		RemoveExcludedFromDirectory(directory, child_exclude_list);
+		RemoveExcludedFromDirectory(directory, child_exclude_list,
+					    name_cache);
 
 	PurgeDeletedFromDirectory(directory);
 
+	PendingSongList directory_pending_songs;
+	PendingSongList *const parent_pending_songs = pending_songs;
+	if (scan_pool != nullptr)
+		pending_songs = &directory_pending_songs;
+
+	std::forward_list<std::pair<std::string, StorageFileInfo>> subdirectories;
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
 			continue;
 
 		{
-			const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
+			const auto name_fs = name_cache.Get(name_utf8);
 			if (name_fs.IsNull() || child_exclude_list.Check(name_fs))
 				continue;
 		}
@@ -377,10 +431,45 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 			continue;
 		}
 
+		if (info2.IsDirectory()) {
+			/* postpone the recursion, so the storage can
+			   fetch all listings of this level in
+			   parallel */
+			subdirectories.emplace_front(name_utf8, info2);
+			continue;
+		}
+
 		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
 	}
 
-	directory.mtime = info.mtime;
+	reader.reset();
+
+	subdirectories.reverse();
+
+	for (const auto &i : subdirectories) {
+		if (directory.IsRoot())
+			storage.PrefetchDirectory(i.first.c_str());
+		else
+			storage.PrefetchDirectory(PathTraitsUTF8::Build(directory.GetPath(),
+									 i.first.c_str()).c_str());
+	}
+
+	for (const auto &i : subdirectories) {
+		if (cancel)
+			break;
+
+		UpdateDirectoryChild(directory, child_exclude_list,
+				     i.first.c_str(), i.second);
+	}
+
+	pending_songs = parent_pending_songs;
+	if (scan_pool != nullptr)
+		FlushPendingSongs(directory_pending_songs);
+
+	if (directory.mtime != info.mtime) {
+		directory.mtime = info.mtime;
+		directory.MarkModified();
+	}
 
 	return true;
 }
@@ -392,7 +481,7 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 {
 	Directory *directory;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		directory = parent.FindChild(name_utf8);
 	}
 
@@ -473,7 +562,30 @@ try {
 		return;
 	}
 
-	ExcludeList exclude_list;
+	/* load the ".mpdignore" files of all ancestors, just like a
+	   full walk would have done; this matters for updates of
+	   single files, e.g. from inotify */
+
+	std::vector<const Directory *> ancestors;
+	for (const Directory *i = parent; i != nullptr; i = i->parent)
+		ancestors.push_back(i);
+
+	std::forward_list<ExcludeList> exclude_lists;
+	exclude_lists.emplace_front();
+	for (auto i = ancestors.rbegin(); i != ancestors.rend(); ++i) {
+		exclude_lists.emplace_front(exclude_lists.front());
+		LoadExcludeList(exclude_lists.front(), **i);
+	}
+
+	const ExcludeList &exclude_list = exclude_lists.front();
+
+	{
+		const auto name_fs = AllocatedPath::FromUTF8(name);
+		if (name_fs.IsNull() || exclude_list.Check(name_fs)) {
+			modified |= editor.DeleteNameIn(*parent, name);
+			return;
+		}
+	}
 
 	UpdateDirectoryChild(*parent, exclude_list, name, info);
 } catch (...) {
@@ -483,20 +595,43 @@ try {
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 {
+	const TraceSpan trace_span("update/walk");
+
 	walk_discard = discard;
 	modified = false;
 
+	if (config.threads > 1) {
+		try {
+			scan_pool.reset(new WorkerPool("update_scan",
+						       config.threads));
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
 		StorageFileInfo info;
-		if (!GetInfo(storage, "", info))
-			return false;
-
-		ExcludeList exclude_list;
+		if (GetInfo(storage, "", info)) {
+			ExcludeList exclude_list;
 
-		UpdateDirectory(root, exclude_list, info);
+			UpdateDirectory(root, exclude_list, info);
+		}
 	}
 
+	if ((config.loudness_scan || config.mixramp_scan) && !cancel)
+		ScanLoudness(root);
+
+	if (config.picture_scan && picture_cache != nullptr && !cancel)
+		ScanPictures(root);
+
+#if defined(ENABLE_CHROMAPRINT) && defined(ENABLE_SQLITE)
+	if (config.fingerprint_scan && sticker_enabled() && !cancel)
+		ScanFingerprints(root);
+#endif
+
+	scan_pool.reset();
+
 	return modified;
 }
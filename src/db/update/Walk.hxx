@@ -22,23 +22,33 @@
 
 #include "Config.hxx"
 #include "Editor.hxx"
+#include "song/DetachedSong.hxx"
+#include "storage/FileInfo.hxx"
+#include "tag/Tag.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/WorkerPool.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <exception>
+#include <forward_list>
+#include <list>
+#include <string>
 
-struct StorageFileInfo;
 struct Directory;
+struct Song;
 struct ArchivePlugin;
-class ArchiveFile;
+struct DecoderPlugin;
 class Storage;
 class ExcludeList;
+class ExcludeCache;
+class TagScanCache;
+class UpdateNameCache;
 
 class UpdateWalk final {
-#ifdef ENABLE_ARCHIVE
-	friend class UpdateArchiveVisitor;
-#endif
-
 	const UpdateConfig config;
 
 	bool walk_discard;
@@ -53,12 +63,192 @@ class UpdateWalk final {
 
 	Storage &storage;
 
+	/**
+	 * The persistent tag scan cache; nullptr if disabled.
+	 */
+	TagScanCache *const tag_cache;
+
+	/**
+	 * The compiled ".mpdignore" files of previous updates.
+	 */
+	ExcludeCache &exclude_cache;
+
 	DatabaseEditor editor;
 
+	/**
+	 * Scans song files concurrently.  This is only used if
+	 * UpdateConfig::threads is greater than one.
+	 */
+	std::unique_ptr<WorkerPool> scan_pool;
+
+	/**
+	 * A song file which is being scanned by #scan_pool.
+	 */
+	struct PendingSong {
+		Directory &directory;
+
+		const std::string name;
+
+		/**
+		 * The existing song which is being updated, or the
+		 * newly loaded song (nullptr if loading has failed).
+		 */
+		Song *song;
+
+		/**
+		 * Is this a new song, i.e. was it not yet in the
+		 * database?
+		 */
+		const bool is_new;
+
+		/**
+		 * Was Song::UpdateFile() successful?  Only used if
+		 * #is_new is false.
+		 */
+		bool success = false;
+
+		PendingSong(Directory &_directory, const char *_name,
+			    Song *_song) noexcept
+			:directory(_directory), name(_name),
+			 song(_song), is_new(_song == nullptr) {}
+	};
+
+	/**
+	 * A container file (see DecoderPlugin::container_scan) whose
+	 * tracks are being enumerated by #scan_pool.
+	 */
+	struct PendingContainer {
+		Directory &directory;
+
+		const std::string name;
+
+		/**
+		 * The virtual directory which receives the tracks.
+		 */
+		Directory &contdir;
+
+		const DecoderPlugin &plugin;
+
+		const AllocatedPath path_fs;
+
+		const StorageFileInfo info;
+
+		std::forward_list<DetachedSong> tracks;
+
+		std::exception_ptr error;
+
+		PendingContainer(Directory &_directory, const char *_name,
+				 Directory &_contdir,
+				 const DecoderPlugin &_plugin,
+				 AllocatedPath &&_path_fs,
+				 const StorageFileInfo &_info) noexcept
+			:directory(_directory), name(_name),
+			 contdir(_contdir), plugin(_plugin),
+			 path_fs(std::move(_path_fs)), info(_info) {}
+
+		/**
+		 * Open the file and enumerate all tracks in one
+		 * pass.  May be called in any thread.
+		 */
+		void Scan() noexcept;
+	};
+
+#ifdef ENABLE_ARCHIVE
+	/**
+	 * A file inside an archive, scanned by PendingArchive::Scan().
+	 */
+	struct ArchiveMember {
+		/**
+		 * The path within the archive.
+		 */
+		std::string path;
+
+		Tag tag;
+
+		/**
+		 * Was the file recognized by a decoder plugin?
+		 */
+		bool success;
+
+		ArchiveMember(std::string &&_path, Tag &&_tag,
+			      bool _success) noexcept
+			:path(std::move(_path)), tag(std::move(_tag)),
+			 success(_success) {}
+	};
+
+	/**
+	 * An archive file whose members are being scanned by
+	 * #scan_pool.
+	 */
+	struct PendingArchive {
+		Directory &parent;
+
+		const std::string name;
+
+		const ArchivePlugin &plugin;
+
+		const AllocatedPath path_fs;
+
+		const std::chrono::system_clock::time_point mtime;
+
+		std::forward_list<ArchiveMember> members;
+
+		std::exception_ptr error;
+
+		PendingArchive(Directory &_parent, const char *_name,
+			       const ArchivePlugin &_plugin,
+			       AllocatedPath &&_path_fs,
+			       std::chrono::system_clock::time_point _mtime) noexcept
+			:parent(_parent), name(_name), plugin(_plugin),
+			 path_fs(std::move(_path_fs)), mtime(_mtime) {}
+
+		/**
+		 * Open the archive and scan the tags of all members;
+		 * it is opened only once.  May be called in any
+		 * thread.
+		 */
+		void Scan() noexcept;
+	};
+#endif
+
+	/**
+	 * The song files of one directory which are being scanned
+	 * by #scan_pool.  They are committed to the database in
+	 * directory order by FlushPendingSongs().
+	 */
+	struct PendingSongList {
+		WorkerPool::Group group;
+		std::list<PendingSong> songs;
+		std::list<PendingContainer> containers;
+#ifdef ENABLE_ARCHIVE
+		std::list<PendingArchive> archives;
+#endif
+	};
+
+	/**
+	 * The #PendingSongList of the directory which is currently
+	 * being walked, or nullptr if song files shall be scanned
+	 * synchronously.
+	 */
+	PendingSongList *pending_songs = nullptr;
+
+	/**
+	 * A song file whose loudness is being measured.
+	 */
+	struct LoudnessItem;
+
+#if defined(ENABLE_CHROMAPRINT) && defined(ENABLE_SQLITE)
+	/**
+	 * A song file whose fingerprint is being calculated.
+	 */
+	struct FingerprintItem;
+#endif
+
 public:
 	UpdateWalk(const UpdateConfig &_config,
 		   EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage) noexcept;
+		   Storage &_storage, TagScanCache *_tag_cache,
+		   ExcludeCache &_exclude_cache) noexcept;
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -78,11 +268,48 @@ private:
 	bool SkipSymlink(const Directory *directory,
 			 const char *utf8_name) const noexcept;
 
+	/**
+	 * Load the ".mpdignore" file of the given directory (if any),
+	 * from #exclude_cache if it was not modified.
+	 */
+	void LoadExcludeList(ExcludeList &exclude_list,
+			     const Directory &directory) noexcept;
+
 	void RemoveExcludedFromDirectory(Directory &directory,
-					 const ExcludeList &exclude_list) noexcept;
+					 const ExcludeList &exclude_list,
+					 UpdateNameCache &name_cache) noexcept;
 
 	void PurgeDeletedFromDirectory(Directory &directory) noexcept;
 
+	void CommitLoadedSong(Directory &directory, const char *name,
+			      Song *song) noexcept;
+
+	void CommitUpdatedSong(Directory &directory, const char *name,
+			       Song &song, bool success) noexcept;
+
+	/**
+	 * Wait for all songs in the given list to be scanned and
+	 * commit them to the database.
+	 */
+	void FlushPendingSongs(PendingSongList &list) noexcept;
+
+	/**
+	 * Start read-ahead of the tags of a song file which is about
+	 * to be submitted to #scan_pool, unless #tag_cache already
+	 * knows it.  While the pool works on the files queued before,
+	 * the kernel fetches this one.
+	 */
+	void PrefetchSongFile(Directory &directory, const char *name,
+			      const StorageFileInfo &info) noexcept;
+
+	/**
+	 * Load a new song file or update an existing #Song (which
+	 * is not a container).
+	 */
+	void UpdatePlainSongFile(Directory &directory, const char *name,
+				 const StorageFileInfo &info,
+				 Song *song) noexcept;
+
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
 			     const StorageFileInfo &info) noexcept;
@@ -91,14 +318,29 @@ private:
 			    const char *name, const char *suffix,
 			    const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Add the tracks found by PendingContainer::Scan() to the
+	 * database.
+	 *
+	 * @return false if this is not a container (no tracks were
+	 * found)
+	 */
+	bool CommitContainer(PendingContainer &container) noexcept;
+
 	bool UpdateContainerFile(Directory &directory,
 				 const char *name, const char *suffix,
 				 const StorageFileInfo &info) noexcept;
 
 
 #ifdef ENABLE_ARCHIVE
-	void UpdateArchiveTree(ArchiveFile &archive, Directory &parent,
-			       const char *name) noexcept;
+	void UpdateArchiveTree(Directory &parent, const char *name,
+			       ArchiveMember &member) noexcept;
+
+	/**
+	 * Apply the results of PendingArchive::Scan() to the
+	 * database.
+	 */
+	void CommitArchive(PendingArchive &archive) noexcept;
 
 	bool UpdateArchiveFile(Directory &directory,
 			       const char *name, const char *suffix,
@@ -153,6 +395,52 @@ private:
 						 const char *uri) noexcept;
 
 	void UpdateUri(Directory &root, const char *uri) noexcept;
+
+	void ScanSongLoudness(LoudnessItem &item) noexcept;
+
+	/**
+	 * Measure the loudness of the songs in this directory (but
+	 * not in its children) if they have no ReplayGain values
+	 * yet; each directory is treated as one album.  Also
+	 * calculate MixRamp profiles for songs which have none.
+	 */
+	void ScanDirectoryLoudness(Directory &directory) noexcept;
+
+	/**
+	 * Call ScanDirectoryLoudness() for the directory and all of
+	 * its children.
+	 */
+	void ScanLoudness(Directory &directory) noexcept;
+
+	/**
+	 * Extract the embedded pictures of the songs in this
+	 * directory (but not in its children) into the
+	 * #PictureCache, unless it knows them already.
+	 */
+	void ScanDirectoryPictures(Directory &directory) noexcept;
+
+	/**
+	 * Call ScanDirectoryPictures() for the directory and all of
+	 * its children.
+	 */
+	void ScanPictures(Directory &directory) noexcept;
+
+#if defined(ENABLE_CHROMAPRINT) && defined(ENABLE_SQLITE)
+	void ScanSongFingerprint(FingerprintItem &item) noexcept;
+
+	/**
+	 * Calculate the Chromaprint fingerprints of the songs in
+	 * this directory (but not in its children) which have none
+	 * in the sticker database yet, and store them there.
+	 */
+	void ScanDirectoryFingerprints(Directory &directory) noexcept;
+
+	/**
+	 * Call ScanDirectoryFingerprints() for the directory and all
+	 * of its children.
+	 */
+	void ScanFingerprints(Directory &directory) noexcept;
+#endif
 };
 
 #endif
@@ -32,6 +32,7 @@
 #include "input/InputStream.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StringBuffer.hxx"
+#include "util/Trace.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -75,7 +76,10 @@ DecoderBridge::CheckCancelRead() const noexcept
 static DecoderCommand
 need_chunks(DecoderControl &dc) noexcept
 {
-	if (dc.command == DecoderCommand::NONE)
+	if (dc.command == DecoderCommand::NONE &&
+	    /* if the player has given us another buffer, don't
+	       wait, try that one instead */
+	    !dc.ApplyPendingBuffer())
 		dc.Wait();
 
 	return dc.command;
@@ -99,6 +103,8 @@ DecoderBridge::GetChunk() noexcept
 	do {
 		current_chunk = dc.buffer->Allocate();
 		if (current_chunk != nullptr) {
+			current_chunk->decode_time =
+				std::chrono::steady_clock::now();
 			current_chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
 				current_chunk->replay_gain_info = replay_gain_info;
@@ -106,7 +112,10 @@ DecoderBridge::GetChunk() noexcept
 			return current_chunk.get();
 		}
 
+		const auto wait_start = std::chrono::steady_clock::now();
 		cmd = LockNeedChunks(dc);
+		stats.buffer_wait_time +=
+			std::chrono::steady_clock::now() - wait_start;
 	} while (cmd == DecoderCommand::NONE);
 
 	return nullptr;
@@ -121,10 +130,13 @@ DecoderBridge::FlushChunk()
 	assert(current_chunk != nullptr);
 
 	auto chunk = std::move(current_chunk);
-	if (!chunk->IsEmpty())
+	if (!chunk->IsEmpty()) {
+		chunk->pipe_time = std::chrono::steady_clock::now();
 		dc.pipe->Push(std::move(chunk));
+	}
 
 	const std::lock_guard<Mutex> protect(dc.mutex);
+	dc.ApplyPendingBuffer();
 	if (dc.client_is_waiting)
 		dc.client_cond.signal();
 }
@@ -392,6 +404,9 @@ try {
 
 	std::lock_guard<Mutex> lock(is.mutex);
 
+	std::chrono::steady_clock::time_point wait_start;
+	bool waited = false;
+
 	while (true) {
 		if (CheckCancelRead())
 			return 0;
@@ -399,12 +414,23 @@ try {
 		if (is.IsAvailable())
 			break;
 
+		if (!waited) {
+			waited = true;
+			wait_start = std::chrono::steady_clock::now();
+		}
+
 		dc.cond.wait(is.mutex);
 	}
 
+	if (waited)
+		stats.input_wait_time +=
+			std::chrono::steady_clock::now() - wait_start;
+
 	size_t nbytes = is.Read(buffer, length);
 	assert(nbytes > 0 || is.IsEOF());
 
+	stats.input_bytes += nbytes;
+
 	return nbytes;
 } catch (...) {
 	error = std::current_exception();
@@ -425,6 +451,8 @@ DecoderBridge::SubmitData(InputStream *is,
 			  const void *data, size_t length,
 			  uint16_t kbit_rate)
 {
+	const TraceSpan trace_span("decoder/submit_data");
+
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
 	assert(length % dc.in_audio_format.GetFrameSize() == 0);
@@ -476,6 +504,9 @@ DecoderBridge::SubmitData(InputStream *is,
 		}
 	}
 
+	stats.audio_time +=
+		dc.in_audio_format.FramesToTime<DecoderStats::Duration>(data_frames);
+
 	if (convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
 
@@ -539,6 +570,112 @@ DecoderBridge::SubmitData(InputStream *is,
 	return cmd;
 }
 
+WritableBuffer<void>
+DecoderBridge::GetWriteBuffer(InputStream *is, uint16_t kbit_rate)
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	if (convert != nullptr)
+		/* the data needs to be converted; let SubmitData() do
+		   that */
+		return nullptr;
+
+	assert(dc.in_audio_format == dc.out_audio_format);
+
+	if (LockGetVirtualCommand() != DecoderCommand::NONE)
+		return nullptr;
+
+	assert(!initial_seek_pending);
+	assert(!initial_seek_running);
+
+	/* send stream tags */
+
+	if (UpdateStreamTag(is)) {
+		const DecoderCommand cmd = decoder_tag != nullptr
+			/* merge with tag from decoder plugin */
+			? DoSendTag(*Tag::Merge(*decoder_tag, *stream_tag))
+			/* send only the stream tag */
+			: DoSendTag(*stream_tag);
+
+		if (cmd != DecoderCommand::NONE)
+			/* SubmitData() will return this command */
+			return nullptr;
+	}
+
+	const size_t frame_size = dc.out_audio_format.GetFrameSize();
+	size_t max_size = SIZE_MAX;
+
+	if (dc.end_time.IsPositive()) {
+		/* enforce the given end time */
+
+		const uint64_t end_frame =
+			dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
+		if (absolute_frame >= end_frame)
+			/* SubmitData() will return STOP */
+			return nullptr;
+
+		const uint64_t remaining_frames = end_frame - absolute_frame;
+		if (remaining_frames < max_size / frame_size)
+			max_size = remaining_frames * frame_size;
+	}
+
+	while (true) {
+		auto *chunk = GetChunk();
+		if (chunk == nullptr) {
+			assert(dc.command != DecoderCommand::NONE);
+			return nullptr;
+		}
+
+		auto dest =
+			chunk->Write(dc.out_audio_format,
+				     SongTime::Cast(timestamp) -
+				     dc.song->GetStartTime(),
+				     kbit_rate);
+		if (dest.empty()) {
+			/* the chunk is full, flush it */
+			FlushChunk();
+			continue;
+		}
+
+		/* MusicChunk::Write() returns whole frames */
+		dest.size = std::min(dest.size, max_size);
+		return dest;
+	}
+}
+
+DecoderCommand
+DecoderBridge::CommitData(size_t length)
+{
+	const TraceSpan trace_span("decoder/commit_data");
+
+	assert(current_chunk != nullptr);
+	assert(length % dc.out_audio_format.GetFrameSize() == 0);
+
+	if (length == 0)
+		return DecoderCommand::NONE;
+
+	const size_t data_frames =
+		length / dc.out_audio_format.GetFrameSize();
+
+	stats.audio_time +=
+		dc.in_audio_format.FramesToTime<DecoderStats::Duration>(data_frames);
+
+	if (current_chunk->Expand(dc.out_audio_format, length))
+		/* the chunk is full, flush it */
+		FlushChunk();
+
+	timestamp += dc.out_audio_format.SizeToTime<FloatDuration>(length);
+	absolute_frame += data_frames;
+
+	if (dc.end_time.IsPositive() &&
+	    absolute_frame >= dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate))
+		/* the end of the range has been reached */
+		return DecoderCommand::STOP;
+
+	return DecoderCommand::NONE;
+}
+
 DecoderCommand
 DecoderBridge::SubmitTag(InputStream *is, Tag &&tag)
 {
@@ -610,5 +747,11 @@ DecoderBridge::SubmitReplayGain(const ReplayGainInfo *new_replay_gain_info)
 void
 DecoderBridge::SubmitMixRamp(MixRampInfo &&mix_ramp)
 {
+	if (!mix_ramp.IsDefined())
+		/* some decoder plugins submit an empty object if the
+		   file has no MixRamp tags; don't let that discard
+		   the profile from the database */
+		return;
+
 	dc.SetMixRamp(std::move(mix_ramp));
 }
@@ -21,6 +21,7 @@
 #define MPD_DECODER_BRIDGE_HXX
 
 #include "Client.hxx"
+#include "DecoderStats.hxx"
 #include "ReplayGainInfo.hxx"
 #include "MusicChunkPtr.hxx"
 
@@ -106,6 +107,12 @@ public:
 	 */
 	std::exception_ptr error;
 
+	/**
+	 * Performance counters of the current plugin run; they are
+	 * reset and collected by the decoder thread.
+	 */
+	DecoderStats stats;
+
 	DecoderBridge(DecoderControl &_dc, bool _initial_seek_pending,
 		      std::unique_ptr<Tag> _tag)
 		:dc(_dc),
@@ -152,6 +159,9 @@ public:
 	DecoderCommand SubmitData(InputStream *is,
 				  const void *data, size_t length,
 				  uint16_t kbit_rate) override;
+	WritableBuffer<void> GetWriteBuffer(InputStream *is,
+					    uint16_t kbit_rate) override;
+	DecoderCommand CommitData(size_t length) override;
 	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) override ;
 	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) override;
 	void SubmitMixRamp(MixRampInfo &&mix_ramp) override;
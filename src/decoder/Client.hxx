@@ -23,8 +23,10 @@
 #include "Command.hxx"
 #include "Chrono.hxx"
 #include "input/Ptr.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Compiler.h"
 
+#include <assert.h>
 #include <stdint.h>
 
 struct AudioFormat;
@@ -137,6 +139,46 @@ public:
 		return SubmitData(&is, data, length, kbit_rate);
 	}
 
+	/**
+	 * Obtain a buffer where the decoder plugin may write decoded
+	 * PCM data (in the audio format passed to Ready()) directly,
+	 * instead of passing it to SubmitData(), which would copy it.
+	 * The data must be committed with CommitData() before any
+	 * other method except for Read() is called; this allows
+	 * reading raw samples from the #InputStream directly into
+	 * the buffer.  Data which is not committed is discarded.
+	 *
+	 * The default implementation returns an empty buffer, and so
+	 * may an implementation if a command is pending or if the
+	 * data needs to be converted; in that case, the plugin shall
+	 * fall back to SubmitData().
+	 *
+	 * @param is an input stream which is buffering while we are waiting
+	 * for the player
+	 * @return a buffer for a whole number of frames (may be
+	 * empty)
+	 */
+	virtual WritableBuffer<void> GetWriteBuffer(gcc_unused InputStream *is,
+						    gcc_unused uint16_t kbit_rate) {
+		return nullptr;
+	}
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * GetWriteBuffer().
+	 *
+	 * @param length the number of bytes written, a multiple of
+	 * the frame size
+	 * @return the current command, or DecoderCommand::NONE if there is no
+	 * command pending
+	 */
+	virtual DecoderCommand CommitData(gcc_unused size_t length) {
+		/* not reachable, because the default
+		   GetWriteBuffer() never returns a buffer */
+		assert(false);
+		gcc_unreachable();
+	}
+
 	/**
 	 * This function is called by the decoder plugin when it has
 	 * successfully decoded a tag.
@@ -18,8 +18,13 @@
  */
 
 #include "Control.hxx"
+#include "Domain.hxx"
 #include "MusicPipe.hxx"
 #include "song/DetachedSong.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Name.hxx"
+#include "util/Exception.hxx"
+#include "Log.hxx"
 
 #include <stdexcept>
 
@@ -31,13 +36,125 @@ DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond,
 	:thread(BIND_THIS_METHOD(RunThread)),
 	 mutex(_mutex), client_cond(_client_cond),
 	 configured_audio_format(_configured_audio_format),
-	 replay_gain_config(_replay_gain_config) {}
+	 replay_gain_config(_replay_gain_config),
+	 prefetch_thread(BIND_THIS_METHOD(RunPrefetch)) {}
 
 DecoderControl::~DecoderControl() noexcept
 {
 	ClearError();
 }
 
+void
+DecoderControl::Prefetch(const DetachedSong &_song) noexcept
+{
+	if (!_song.IsRemote())
+		/* local files are opened quickly, there's nothing to
+		   gain */
+		return;
+
+	std::string new_uri = _song.GetRealURI();
+	if (prefetch_uri == new_uri)
+		/* already prefetched (or being prefetched) */
+		return;
+
+	CancelPrefetch();
+
+	prefetch_uri = std::move(new_uri);
+	prefetch_busy = true;
+
+	if (prefetch_thread.IsDefined()) {
+		prefetch_cond.signal();
+		return;
+	}
+
+	try {
+		prefetch_thread.Start();
+	} catch (...) {
+		FormatDebug(decoder_domain, "Prefetch failed: %s",
+			    GetFullMessage(std::current_exception()).c_str());
+		prefetch_uri.clear();
+		prefetch_busy = false;
+	}
+}
+
+void
+DecoderControl::RunPrefetch() noexcept
+{
+	SetThreadName("prefetch");
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (!prefetch_quit) {
+		if (!prefetch_busy) {
+			prefetch_cond.wait(mutex);
+			continue;
+		}
+
+		const std::string uri = prefetch_uri;
+		InputStreamPtr is;
+
+		try {
+			/* opening the stream may block for a while
+			   and the InputStream implementation may need
+			   to lock the mutex */
+			const ScopeUnlock unlock(mutex);
+			is = InputStream::Open(uri.c_str(), mutex);
+		} catch (...) {
+			FormatDebug(decoder_domain, "Prefetch failed: %s",
+				    GetFullMessage(std::current_exception()).c_str());
+		}
+
+		if (prefetch_busy && prefetch_uri == uri) {
+			/* a failed stream is not retried here; the
+			   decoder thread will report the error */
+			prefetch_stream = std::move(is);
+			prefetch_busy = false;
+			prefetch_cond.broadcast();
+		} else if (is) {
+			/* canceled meanwhile; the InputStream
+			   destructor may need to lock the mutex */
+			const ScopeUnlock unlock(mutex);
+			is.reset();
+		}
+	}
+}
+
+void
+DecoderControl::CancelPrefetch() noexcept
+{
+	auto is = std::move(prefetch_stream);
+	prefetch_uri.clear();
+
+	if (prefetch_busy) {
+		/* the result of a pending open will be discarded by
+		   the prefetch thread; wake up TakePrefetch() */
+		prefetch_busy = false;
+		prefetch_cond.broadcast();
+	}
+
+	if (is) {
+		/* the InputStream destructor may need to lock the
+		   mutex */
+		const ScopeUnlock unlock(mutex);
+		is.reset();
+	}
+}
+
+InputStreamPtr
+DecoderControl::TakePrefetch(const char *uri) noexcept
+{
+	while (prefetch_busy && prefetch_uri == uri)
+		/* the prefetch thread is opening it right now;
+		   waiting is quicker than opening it again */
+		prefetch_cond.wait(mutex);
+
+	if (prefetch_stream == nullptr || prefetch_uri != uri)
+		return nullptr;
+
+	prefetch_uri.clear();
+	return std::move(prefetch_stream);
+}
+
 void
 DecoderControl::WaitForDecoder() noexcept
 {
@@ -61,7 +178,9 @@ DecoderControl::SetReady(const AudioFormat audio_format,
 	assert(audio_format.IsValid());
 
 	in_audio_format = audio_format;
-	out_audio_format = audio_format.WithMask(configured_audio_format);
+	out_audio_format = force_audio_format.IsDefined()
+		? force_audio_format
+		: audio_format.WithMask(configured_audio_format);
 
 	seekable = _seekable;
 	total_time = _duration;
@@ -91,7 +210,8 @@ void
 DecoderControl::Start(std::unique_ptr<DetachedSong> _song,
 		      SongTime _start_time, SongTime _end_time,
 		      MusicBuffer &_buffer,
-		      std::shared_ptr<MusicPipe> _pipe) noexcept
+		      std::shared_ptr<MusicPipe> _pipe,
+		      AudioFormat _force_audio_format) noexcept
 {
 	assert(_song != nullptr);
 	assert(_pipe->IsEmpty());
@@ -100,8 +220,14 @@ DecoderControl::Start(std::unique_ptr<DetachedSong> _song,
 	start_time = _start_time;
 	end_time = _end_time;
 	buffer = &_buffer;
+	next_buffer = nullptr;
 	pipe = std::move(_pipe);
 
+	/* PCM cannot be converted to DSD */
+	force_audio_format = _force_audio_format.format != SampleFormat::DSD
+		? _force_audio_format
+		: AudioFormat::Undefined();
+
 	ClearError();
 	SynchronousCommandLocked(DecoderCommand::START);
 }
@@ -160,6 +286,15 @@ DecoderControl::Quit() noexcept
 	LockAsynchronousCommand(DecoderCommand::STOP);
 
 	thread.Join();
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		prefetch_quit = true;
+		prefetch_cond.signal();
+	}
+
+	if (prefetch_thread.IsDefined())
+		prefetch_thread.Join();
 }
 
 void
@@ -24,6 +24,7 @@
 #include "AudioFormat.hxx"
 #include "MixRampInfo.hxx"
 #include "input/Handler.hxx"
+#include "input/Ptr.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
@@ -34,6 +35,7 @@
 #include <exception>
 #include <utility>
 #include <memory>
+#include <string>
 
 #include <assert.h>
 #include <stdint.h>
@@ -125,6 +127,13 @@ private:
 	 */
 	const AudioFormat configured_audio_format;
 
+	/**
+	 * If defined, then the decoded song is converted to this
+	 * format instead of #configured_audio_format (passed to
+	 * Start()).
+	 */
+	AudioFormat force_audio_format = AudioFormat::Undefined();
+
 public:
 	/** the format of the song file */
 	AudioFormat in_audio_format;
@@ -160,6 +169,14 @@ public:
 	/** the #MusicChunk allocator */
 	MusicBuffer *buffer;
 
+	/**
+	 * If not nullptr, then the decoder thread shall switch to
+	 * this #MusicBuffer at the next opportunity; see SetBuffer().
+	 *
+	 * Protected by #mutex.
+	 */
+	MusicBuffer *next_buffer = nullptr;
+
 	/**
 	 * The destination pipe for decoded chunks.  The caller thread
 	 * owns this object, and is responsible for freeing it.
@@ -175,6 +192,43 @@ public:
 private:
 	MixRampInfo mix_ramp, previous_mix_ramp;
 
+	/**
+	 * This thread opens the streams requested by Prefetch(), so
+	 * the player thread never blocks in a slow input plugin.  It
+	 * is started on demand.
+	 */
+	Thread prefetch_thread;
+
+	/**
+	 * Signalled when #prefetch_thread has something to do or has
+	 * finished opening a stream.
+	 */
+	Cond prefetch_cond;
+
+	/**
+	 * An input stream which was opened in advance by
+	 * #prefetch_thread for the song which will be decoded next.
+	 * It fills its own (bounded) buffer in the background until
+	 * the decoder thread picks it up with TakePrefetch().
+	 *
+	 * Protected by #mutex (like the following attributes).
+	 */
+	InputStreamPtr prefetch_stream;
+
+	/**
+	 * The URI of the song to be prefetched; empty if there is
+	 * none.
+	 */
+	std::string prefetch_uri;
+
+	/**
+	 * Shall #prefetch_thread open #prefetch_uri (or is it doing
+	 * that right now)?
+	 */
+	bool prefetch_busy = false;
+
+	bool prefetch_quit;
+
 public:
 	/**
 	 * @param _mutex see #mutex
@@ -190,6 +244,7 @@ public:
 	 */
 	void StartThread() {
 		quit = false;
+		prefetch_quit = false;
 		thread.Start();
 	}
 
@@ -216,6 +271,45 @@ public:
 		cond.signal();
 	}
 
+	/**
+	 * Ask the (running) decoder thread to allocate all further
+	 * chunks from the given #MusicBuffer.  The switch is
+	 * performed by the decoder thread itself, because only one
+	 * thread may allocate from a #MusicBuffer at a time.
+	 *
+	 * Caller must lock the object.
+	 */
+	void SetBuffer(MusicBuffer &_buffer) noexcept {
+		next_buffer = &_buffer;
+		Signal();
+	}
+
+	/**
+	 * Has SetBuffer() been called, but the decoder thread hasn't
+	 * switched yet?
+	 *
+	 * Caller must lock the object.
+	 */
+	bool HasPendingBuffer() const noexcept {
+		return next_buffer != nullptr;
+	}
+
+	/**
+	 * Switch to the #MusicBuffer passed to SetBuffer().  This
+	 * method is only valid in the decoder thread.
+	 *
+	 * Caller must lock the object.
+	 *
+	 * @return true if the buffer has been switched
+	 */
+	bool ApplyPendingBuffer() noexcept {
+		if (next_buffer == nullptr)
+			return false;
+
+		buffer = std::exchange(next_buffer, nullptr);
+		return true;
+	}
+
 	/**
 	 * Waits for a signal on the #DecoderControl object.  This function
 	 * is only valid in the decoder thread.  The object must be locked
@@ -395,11 +489,14 @@ public:
 	 * @param end_time see #DecoderControl
 	 * @param pipe the pipe which receives the decoded chunks (owned by
 	 * the caller)
+	 * @param _force_audio_format if defined, convert the song to
+	 * this audio format (unless it is DSD)
 	 */
 	void Start(std::unique_ptr<DetachedSong> song,
 		   SongTime start_time, SongTime end_time,
 		   MusicBuffer &buffer,
-		   std::shared_ptr<MusicPipe> pipe) noexcept;
+		   std::shared_ptr<MusicPipe> pipe,
+		   AudioFormat _force_audio_format = AudioFormat::Undefined()) noexcept;
 
 	/**
 	 * Caller must lock the object.
@@ -415,6 +512,40 @@ public:
 
 	void Quit() noexcept;
 
+	/**
+	 * Open the input stream of the given song in the background
+	 * (in #prefetch_thread), to be used when the decoder is
+	 * started on it later.  This hides the connection setup and
+	 * initial buffering of remote streams behind the playback of
+	 * the current song.  Local files are ignored, because opening
+	 * them is cheap.
+	 *
+	 * This method does not block.  Errors are ignored; the
+	 * decoder thread will retry opening the stream and report the
+	 * error.
+	 *
+	 * Caller must lock the object.
+	 */
+	void Prefetch(const DetachedSong &song) noexcept;
+
+	/**
+	 * Close the stream opened by Prefetch() (if any).
+	 *
+	 * Caller must lock the object.
+	 */
+	void CancelPrefetch() noexcept;
+
+	/**
+	 * Obtain the stream opened by Prefetch() if it matches the
+	 * given URI; if it is still being opened, wait for it.  This
+	 * method is only valid in the decoder thread.
+	 *
+	 * Caller must lock the object.
+	 *
+	 * @return the stream (without a handler) or nullptr
+	 */
+	InputStreamPtr TakePrefetch(const char *uri) noexcept;
+
 	const char *GetMixRampStart() const noexcept {
 		return mix_ramp.GetStart();
 	}
@@ -440,6 +571,8 @@ public:
 private:
 	void RunThread() noexcept;
 
+	void RunPrefetch() noexcept;
+
 	/* virtual methods from class InputStreamHandler */
 	void OnInputStreamReady() noexcept override {
 		cond.signal();
@@ -19,10 +19,85 @@
 
 #include "DecoderBuffer.hxx"
 #include "DecoderAPI.hxx"
+#include "input/InputStream.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * The maximum buffer size for seekable remote streams (i.e. files
+ * on a server), which may have a high bit rate.
+ */
+static constexpr size_t MAX_REMOTE_SIZE = 256 * 1024;
+
+/**
+ * The maximum buffer size for non-seekable remote streams (i.e. live
+ * streams), which have a low bit rate.
+ */
+static constexpr size_t MAX_LIVE_SIZE = 32 * 1024;
+
+gcc_pure
+static size_t
+GetMaxSize(const InputStream &is, size_t size) noexcept
+{
+	if (*is.GetURI() == '/')
+		/* a local file, which is cheap to read (and usually
+		   supports InputStream::Peek()) */
+		return size;
+
+	return std::max(size, is.IsSeekable()
+			? MAX_REMOTE_SIZE
+			: MAX_LIVE_SIZE);
+}
+
+DecoderBuffer::DecoderBuffer(DecoderClient *_client, InputStream &_is,
+			     size_t _size) noexcept
+	:client(_client), is(_is), buffer(_size),
+	 max_size(GetMaxSize(_is, _size)) {}
+
+/**
+ * Borrow data from the #InputStream, but not more than fits into
+ * the buffer (so it can be copied into it by Fill()).
+ */
+static ConstBuffer<uint8_t>
+Borrow(ConstBuffer<void> src, size_t max_size) noexcept
+{
+	auto r = ConstBuffer<uint8_t>::FromVoid(src);
+	if (r.size > max_size)
+		r.size = max_size;
+	return r;
+}
+
+static ConstBuffer<uint8_t>
+Borrow(InputStream &is, size_t max_size) noexcept
+{
+	return Borrow(is.LockPeek(), max_size);
+}
 
 bool
 DecoderBuffer::Fill()
 {
+	if (!borrowed.empty()) {
+		/* the decoder needs more contiguous data than the
+		   stream provides: copy the borrowed data into the
+		   buffer and continue reading into it */
+		assert(buffer.empty());
+
+		auto w = buffer.Write();
+		assert(w.size >= borrowed.size);
+		memcpy(w.data, borrowed.data, borrowed.size);
+		buffer.Append(borrowed.size);
+
+		is.LockConsume(borrowed.size);
+		borrowed = nullptr;
+	} else if (buffer.empty()) {
+		borrowed = Borrow(is, buffer.GetCapacity());
+		if (!borrowed.empty())
+			return true;
+	}
+
 	auto w = buffer.Write();
 	if (w.empty())
 		/* buffer is full */
@@ -36,6 +111,16 @@ DecoderBuffer::Fill()
 		return false;
 
 	buffer.Append(nbytes);
+
+	if (nbytes == w.size) {
+		/* the stream had at least as much data as fitted into
+		   the buffer: grow it, so the next Fill() obtains more
+		   data with one read */
+		const size_t capacity = buffer.GetCapacity();
+		if (capacity < max_size)
+			buffer.Grow(std::min(capacity * 2, max_size));
+	}
+
 	return true;
 }
 
@@ -52,9 +137,63 @@ DecoderBuffer::Need(size_t min_size)
 	}
 }
 
+offset_type
+DecoderBuffer::GetOffset() const noexcept
+{
+	/* borrowed data has not been consumed from the stream yet */
+	return is.GetOffset() - buffer.GetAvailable();
+}
+
+void
+DecoderBuffer::Consume(size_t nbytes) noexcept
+{
+	if (!borrowed.empty()) {
+		assert(nbytes <= borrowed.size);
+
+		/* consume and obtain a new borrowed pointer (the old
+		   one is invalid now) with only one mutex cycle */
+		const std::lock_guard<Mutex> protect(is.mutex);
+		is.Consume(nbytes);
+		borrowed = Borrow(is.Peek(), buffer.GetCapacity());
+	} else
+		buffer.Consume(nbytes);
+}
+
+size_t
+DecoderBuffer::ReadInto(void *dest, size_t size)
+{
+	if (GetAvailable() == 0) {
+		if (size >= buffer.GetCapacity())
+			/* the buffer wouldn't help */
+			return decoder_read(client, is, dest, size);
+
+		if (!Fill())
+			return 0;
+	}
+
+	const auto r = Read();
+	const size_t nbytes = std::min(r.size, size);
+	memcpy(dest, r.data, nbytes);
+	Consume(nbytes);
+	return nbytes;
+}
+
 bool
 DecoderBuffer::Skip(size_t nbytes)
 {
+	if (!borrowed.empty()) {
+		if (nbytes <= borrowed.size) {
+			Consume(nbytes);
+			return true;
+		}
+
+		is.LockConsume(borrowed.size);
+		nbytes -= borrowed.size;
+		borrowed = nullptr;
+
+		return decoder_skip(client, is, nbytes);
+	}
+
 	const auto r = buffer.Read();
 	if (r.size >= nbytes) {
 		buffer.Consume(nbytes);
@@ -20,6 +20,7 @@
 #ifndef MPD_DECODER_BUFFER_HXX
 #define MPD_DECODER_BUFFER_HXX
 
+#include "input/Offset.hxx"
 #include "util/Compiler.h"
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/ConstBuffer.hxx"
@@ -34,6 +35,10 @@ class InputStream;
  * This objects handles buffered reads in decoder plugins easily.  You
  * create a buffer object, and use its high-level methods to fill and
  * read it.  It will automatically handle shifting the buffer.
+ *
+ * If the #InputStream supports InputStream::Peek(), its data is
+ * "borrowed" instead of being copied into the buffer, as long as the
+ * decoder doesn't need more contiguous data than the stream has.
  */
 class DecoderBuffer {
 	DecoderClient *const client;
@@ -41,25 +46,58 @@ class DecoderBuffer {
 
 	DynamicFifoBuffer<uint8_t> buffer;
 
+	/**
+	 * The #buffer grows up to this size while the stream keeps
+	 * providing more data than fits into it.
+	 */
+	const size_t max_size;
+
+	/**
+	 * Data obtained by InputStream::Peek(), which is not yet
+	 * consumed from the stream.  This is only used while
+	 * #buffer is empty.
+	 */
+	ConstBuffer<uint8_t> borrowed = nullptr;
+
 public:
 	/**
 	 * Creates a new buffer.
 	 *
+	 * Remote streams are read by another thread, and each read
+	 * cycles the #InputStream mutex; therefore, the buffer grows
+	 * beyond the given size (up to a limit which depends on
+	 * whether the stream is seekable) while each Fill() call
+	 * obtains as much data as fits, so the stream's bit rate
+	 * determines how much is read at a time.
+	 *
 	 * @param _client the decoder client, used for decoder_read(),
 	 * may be nullptr
 	 * @param _is the input stream object where we should read from
-	 * @param _size the maximum size of the buffer
+	 * @param _size the initial size of the buffer, i.e. the
+	 * maximum size the caller can pass to Need()
 	 */
 	DecoderBuffer(DecoderClient *_client, InputStream &_is,
-		      size_t _size)
-		:client(_client), is(_is), buffer(_size) {}
+		      size_t _size) noexcept;
 
 	const InputStream &GetStream() const noexcept {
 		return is;
 	}
 
+	/**
+	 * Forget the buffered data.  Call this after seeking the
+	 * #InputStream.  To throw away data at the current position,
+	 * use Discard().
+	 */
 	void Clear() noexcept {
 		buffer.Clear();
+		borrowed = nullptr;
+	}
+
+	/**
+	 * Consume all buffered data.
+	 */
+	void Discard() noexcept {
+		Consume(GetAvailable());
 	}
 
 	/**
@@ -76,15 +114,27 @@ public:
 	 */
 	gcc_pure
 	size_t GetAvailable() const noexcept {
-		return buffer.GetAvailable();
+		return borrowed.empty()
+			? buffer.GetAvailable()
+			: borrowed.size;
 	}
 
+	/**
+	 * Returns the stream offset of the first byte returned by
+	 * Read().
+	 */
+	gcc_pure
+	offset_type GetOffset() const noexcept;
+
 	/**
 	 * Reads data from the buffer.  This data is not yet consumed,
 	 * you have to call Consume() to do that.  The returned buffer
 	 * becomes invalid after a Fill() or a Consume() call.
 	 */
 	ConstBuffer<void> Read() const noexcept {
+		if (!borrowed.empty())
+			return borrowed.ToVoid();
+
 		auto r = buffer.Read();
 		return { r.data, r.size };
 	}
@@ -102,9 +152,20 @@ public:
 	 *
 	 * @param nbytes the number of bytes to consume
 	 */
-	void Consume(size_t nbytes) noexcept {
-		buffer.Consume(nbytes);
-	}
+	void Consume(size_t nbytes) noexcept;
+
+	/**
+	 * Copy data from the buffer to the given destination and
+	 * consume it.  If the buffer is empty, it is filled first
+	 * with everything the stream has available (up to the buffer
+	 * size); large reads bypass the buffer.  This is a
+	 * replacement for decoder_read() for decoders which read
+	 * small portions at a time.
+	 *
+	 * @return the number of bytes copied; 0 on end of file, I/O
+	 * error or if a decoder command was received
+	 */
+	size_t ReadInto(void *dest, size_t size);
 
 	/**
 	 * Skips the specified number of bytes, discarding its data.
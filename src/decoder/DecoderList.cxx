@@ -20,10 +20,14 @@
 #include "config.h"
 #include "DecoderList.hxx"
 #include "DecoderPlugin.hxx"
+#include "SeekIndexCache.hxx"
 #include "config/Data.hxx"
+#include "config/Option.hxx"
 #include "config/Block.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "plugins/AudiofileDecoderPlugin.hxx"
 #include "plugins/PcmDecoderPlugin.hxx"
+#include "plugins/WaveDecoderPlugin.hxx"
 #include "plugins/DsdiffDecoderPlugin.hxx"
 #include "plugins/DsfDecoderPlugin.hxx"
 #include "plugins/HybridDsdDecoderPlugin.hxx"
@@ -45,9 +49,21 @@
 #include "plugins/FluidsynthDecoderPlugin.hxx"
 #include "plugins/SidplayDecoderPlugin.hxx"
 #include "util/Macros.hxx"
+#include "util/StringHash.hxx"
 
+#include "thread/Mutex.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
 #include <string.h>
 
+static constexpr Domain decoder_list_domain("decoder");
+
 const struct DecoderPlugin *const decoder_plugins[] = {
 #ifdef ENABLE_MAD
 	&mad_decoder_plugin,
@@ -65,6 +81,7 @@ const struct DecoderPlugin *const decoder_plugins[] = {
 #ifdef ENABLE_OPUS
 	&opus_decoder_plugin,
 #endif
+	&wave_decoder_plugin,
 #ifdef ENABLE_SNDFILE
 	&sndfile_decoder_plugin,
 #endif
@@ -116,9 +133,109 @@ const struct DecoderPlugin *const decoder_plugins[] = {
 static constexpr unsigned num_decoder_plugins =
 	ARRAY_SIZE(decoder_plugins) - 1;
 
-/** which plugins have been initialized successfully? */
+/**
+ * which plugins have been initialized successfully (or are waiting
+ * for their postponed initialization)?
+ */
 bool decoder_plugins_enabled[num_decoder_plugins];
 
+enum class LazyInitState : uint8_t {
+	/**
+	 * The plugin has been initialized (or it is not enabled).
+	 */
+	READY,
+
+	/**
+	 * Initialization has been postponed until first use.
+	 */
+	PENDING,
+
+	/**
+	 * The postponed initialization has failed.
+	 */
+	FAILED,
+};
+
+static std::atomic<LazyInitState> lazy_init_state[num_decoder_plugins];
+
+/**
+ * The configuration blocks for plugins in state
+ * LazyInitState::PENDING.  Protected by #lazy_init_mutex.
+ */
+static const ConfigBlock *lazy_init_blocks[num_decoder_plugins];
+
+/**
+ * Serializes postponed plugin initialization.
+ */
+static Mutex lazy_init_mutex;
+
+/**
+ * Used for plugins which have no "decoder" block; must outlive
+ * postponed initialization.
+ */
+static const ConfigBlock empty_block;
+
+/**
+ * Maps a suffix or MIME type to the indices of all enabled plugins
+ * supporting it.  The keys point to the static strings in the
+ * #DecoderPlugin objects.
+ */
+using DecoderPluginMap =
+	std::unordered_map<const char *, std::vector<unsigned>,
+			   StringHashCaseASCII, StringEqualCaseASCII>;
+
+static DecoderPluginMap decoder_suffix_map, decoder_mime_type_map;
+
+static void
+AddToMap(DecoderPluginMap &map, const char *const*keys, unsigned i)
+{
+	if (keys == nullptr)
+		return;
+
+	for (; *keys != nullptr; ++keys) {
+		auto &v = map[*keys];
+		/* a plugin may list the same key twice */
+		if (v.empty() || v.back() != i)
+			v.push_back(i);
+	}
+}
+
+static void
+BuildMaps()
+{
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (!decoder_plugins_enabled[i])
+			continue;
+
+		const DecoderPlugin &plugin = *decoder_plugins[i];
+		AddToMap(decoder_suffix_map, plugin.suffixes, i);
+		AddToMap(decoder_mime_type_map, plugin.mime_types, i);
+	}
+}
+
+gcc_pure
+static ConstBuffer<unsigned>
+Lookup(const DecoderPluginMap &map, const char *key) noexcept
+{
+	auto i = map.find(key);
+	if (i == map.end())
+		return nullptr;
+
+	return {i->second.data(), i->second.size()};
+}
+
+ConstBuffer<unsigned>
+decoder_plugins_by_suffix(const char *suffix) noexcept
+{
+	return Lookup(decoder_suffix_map, suffix);
+}
+
+ConstBuffer<unsigned>
+decoder_plugins_by_mime_type(const char *mime_type) noexcept
+{
+	return Lookup(decoder_mime_type_map, mime_type);
+}
+
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name) noexcept
 {
@@ -130,8 +247,6 @@ decoder_plugin_from_name(const char *name) noexcept
 void
 decoder_plugin_init_all(const ConfigData &config)
 {
-	ConfigBlock empty;
-
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
 		const DecoderPlugin &plugin = *decoder_plugins[i];
 		const auto *param =
@@ -139,7 +254,7 @@ decoder_plugin_init_all(const ConfigData &config)
 					 plugin.name);
 
 		if (param == nullptr)
-			param = &empty;
+			param = &empty_block;
 		else if (!param->GetBlockValue("enabled", true))
 			/* the plugin is disabled in mpd.conf */
 			continue;
@@ -147,23 +262,104 @@ decoder_plugin_init_all(const ConfigData &config)
 		if (param != nullptr)
 			param->SetUsed();
 
+		if (param->GetBlockValue("lazy", plugin.lazy_init)) {
+			/* initialize on first use; until then, assume
+			   it is available */
+			lazy_init_blocks[i] = param;
+			lazy_init_state[i].store(LazyInitState::PENDING,
+						 std::memory_order_relaxed);
+			decoder_plugins_enabled[i] = true;
+			continue;
+		}
+
 		if (plugin.Init(*param))
 			decoder_plugins_enabled[i] = true;
 	}
+
+	BuildMaps();
+
+	auto seek_index_path = config.GetPath(ConfigOption::SEEK_INDEX_FILE);
+	if (!seek_index_path.IsNull()) {
+		seek_index_cache = new SeekIndexCache(std::move(seek_index_path));
+		seek_index_cache->Load();
+	}
+}
+
+bool
+decoder_plugin_prepare(unsigned i) noexcept
+{
+	assert(i < num_decoder_plugins);
+
+	switch (lazy_init_state[i].load(std::memory_order_acquire)) {
+	case LazyInitState::READY:
+		return true;
+
+	case LazyInitState::PENDING:
+		break;
+
+	case LazyInitState::FAILED:
+		return false;
+	}
+
+	const std::lock_guard<Mutex> protect(lazy_init_mutex);
+
+	/* check again; another thread may have won the race */
+	auto state = lazy_init_state[i].load(std::memory_order_relaxed);
+	if (state != LazyInitState::PENDING)
+		return state == LazyInitState::READY;
+
+	const DecoderPlugin &plugin = *decoder_plugins[i];
+	FormatDebug(decoder_list_domain, "Initializing decoder plugin '%s'",
+		    plugin.name);
+
+	bool success;
+	try {
+		success = plugin.Init(*lazy_init_blocks[i]);
+		if (!success)
+			FormatWarning(decoder_list_domain,
+				      "Decoder plugin '%s' is not available",
+				      plugin.name);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to initialize decoder plugin '%s'",
+			    plugin.name);
+		success = false;
+	}
+
+	lazy_init_blocks[i] = nullptr;
+	lazy_init_state[i].store(success
+				 ? LazyInitState::READY
+				 : LazyInitState::FAILED,
+				 std::memory_order_release);
+	return success;
 }
 
 void
 decoder_plugin_deinit_all() noexcept
 {
-	decoder_plugins_for_each_enabled([=](const DecoderPlugin &plugin){
-			plugin.Finish();
-		});
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (!decoder_plugins_enabled[i])
+			continue;
+
+		/* only plugins which were actually initialized
+		   need to be deinitialized */
+		if (lazy_init_state[i].exchange(LazyInitState::READY) ==
+		    LazyInitState::READY)
+			decoder_plugins[i]->Finish();
+	}
+
+	decoder_suffix_map.clear();
+	decoder_mime_type_map.clear();
+
+	if (seek_index_cache != nullptr) {
+		seek_index_cache->Save();
+		delete seek_index_cache;
+		seek_index_cache = nullptr;
+	}
 }
 
 bool
 decoder_plugins_supports_suffix(const char *suffix) noexcept
 {
-	return decoder_plugins_try([suffix](const DecoderPlugin &plugin){
-			return plugin.SupportsSuffix(suffix);
-		});
+	return !decoder_plugins_by_suffix(suffix).empty();
 }
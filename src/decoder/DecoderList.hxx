@@ -21,6 +21,7 @@
 #define MPD_DECODER_LIST_HXX
 
 #include "util/Compiler.h"
+#include "util/ConstBuffer.hxx"
 
 struct ConfigData;
 struct DecoderPlugin;
@@ -38,6 +39,18 @@ decoder_plugin_from_name(const char *name) noexcept;
 void
 decoder_plugin_init_all(const ConfigData &config);
 
+/**
+ * Ensure that the specified enabled plugin has been initialized; this
+ * performs the postponed initialization of plugins with
+ * #DecoderPlugin::lazy_init.  Thread-safe.
+ *
+ * @param i an index into #decoder_plugins
+ * @return false if the initialization has failed and the plugin may
+ * not be used
+ */
+bool
+decoder_plugin_prepare(unsigned i) noexcept;
+
 /* this is where we "unload" all the "plugins" */
 void
 decoder_plugin_deinit_all() noexcept;
@@ -58,7 +71,8 @@ static inline const DecoderPlugin *
 decoder_plugins_find(F f) noexcept
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i] && f(*decoder_plugins[i]))
+		if (decoder_plugins_enabled[i] && decoder_plugin_prepare(i) &&
+		    f(*decoder_plugins[i]))
 			return decoder_plugins[i];
 
 	return nullptr;
@@ -69,7 +83,8 @@ static inline bool
 decoder_plugins_try(F f)
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i] && f(*decoder_plugins[i]))
+		if (decoder_plugins_enabled[i] && decoder_plugin_prepare(i) &&
+		    f(*decoder_plugins[i]))
 			return true;
 
 	return false;
@@ -92,6 +107,92 @@ decoder_plugins_for_each_enabled(F f)
 			f(*decoder_plugins[i]);
 }
 
+/**
+ * Returns the indices (into #decoder_plugins) of all enabled plugins
+ * supporting the specified file name suffix (case insensitive), in
+ * ascending order.  The lookup table is built by
+ * decoder_plugin_init_all().
+ */
+gcc_pure gcc_nonnull_all
+ConstBuffer<unsigned>
+decoder_plugins_by_suffix(const char *suffix) noexcept;
+
+/**
+ * Like decoder_plugins_by_suffix(), but look up a MIME type (without
+ * parameters).
+ */
+gcc_pure gcc_nonnull_all
+ConstBuffer<unsigned>
+decoder_plugins_by_mime_type(const char *mime_type) noexcept;
+
+/**
+ * Like decoder_plugins_find(), but consider only the plugins which
+ * support the specified file name suffix.
+ */
+template<typename F>
+static inline const DecoderPlugin *
+decoder_plugins_find_suffix(const char *suffix, F f) noexcept
+{
+	for (unsigned i : decoder_plugins_by_suffix(suffix))
+		if (decoder_plugin_prepare(i) && f(*decoder_plugins[i]))
+			return decoder_plugins[i];
+
+	return nullptr;
+}
+
+/**
+ * Like decoder_plugins_try(), but consider only the plugins which
+ * support the specified file name suffix.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_suffix(const char *suffix, F f)
+{
+	for (unsigned i : decoder_plugins_by_suffix(suffix))
+		if (decoder_plugin_prepare(i) && f(*decoder_plugins[i]))
+			return true;
+
+	return false;
+}
+
+/**
+ * Like decoder_plugins_try(), but consider only the plugins which
+ * support the specified file name suffix or MIME type (both may be
+ * nullptr), in the order of #decoder_plugins.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_suffix_or_mime(const char *suffix, const char *mime_type,
+				   F f)
+{
+	const auto a = suffix != nullptr
+		? decoder_plugins_by_suffix(suffix)
+		: nullptr;
+	const auto b = mime_type != nullptr
+		? decoder_plugins_by_mime_type(mime_type)
+		: nullptr;
+
+	/* merge both sorted lists, skipping plugins which appear in
+	   both */
+	auto i = a.begin(), j = b.begin();
+	while (i != a.end() || j != b.end()) {
+		unsigned n;
+		if (j == b.end() || (i != a.end() && *i < *j))
+			n = *i++;
+		else if (i == a.end() || *j < *i)
+			n = *j++;
+		else {
+			n = *i++;
+			++j;
+		}
+
+		if (decoder_plugin_prepare(n) && f(*decoder_plugins[n]))
+			return true;
+	}
+
+	return false;
+}
+
 /**
  * Is there at least once #DecoderPlugin that supports the specified
  * file name suffix?
@@ -95,6 +95,13 @@ struct DecoderPlugin {
 	const char *const*suffixes;
 	const char *const*mime_types;
 
+	/**
+	 * Is init() expensive (e.g. loading patch sets or ROM images)?
+	 * Then it is postponed until the plugin is first used.  This
+	 * default can be overridden with the "lazy" setting.
+	 */
+	bool lazy_init = false;
+
 	/**
 	 * Initialize a decoder plugin.
 	 *
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "DecoderStats.hxx"
+#include "DecoderList.hxx"
+#include "DecoderPlugin.hxx"
+#include "client/Response.hxx"
+#include "metrics/Writer.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+
+static Mutex decoder_stats_mutex;
+
+/**
+ * The accumulated #DecoderStats of each plugin.  Protected by
+ * #decoder_stats_mutex.
+ */
+static std::map<const DecoderPlugin *, DecoderStats> decoder_stats_map;
+
+void
+DecoderStats::Add(const DecoderStats &other) noexcept
+{
+	songs += other.songs;
+	audio_time += other.audio_time;
+	wall_time += other.wall_time;
+	cpu_time += other.cpu_time;
+	buffer_wait_time += other.buffer_wait_time;
+	input_wait_time += other.input_wait_time;
+	input_bytes += other.input_bytes;
+}
+
+void
+decoder_stats_add(const DecoderPlugin &plugin,
+		  const DecoderStats &stats) noexcept
+{
+	const std::lock_guard<Mutex> protect(decoder_stats_mutex);
+	decoder_stats_map[&plugin].Add(stats);
+}
+
+static double
+ToSeconds(DecoderStats::Duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::duration<double>>(d).count();
+}
+
+static void
+decoder_stats_print(Response &r, const DecoderPlugin &plugin,
+		    const DecoderStats &stats)
+{
+	r.Format("plugin: %s\n"
+		 "songs: %u\n"
+		 "audio_time: %1.3f\n"
+		 "wall_time: %1.3f\n"
+		 "cpu_time: %1.3f\n"
+		 "buffer_wait_time: %1.3f\n"
+		 "input_wait_time: %1.3f\n"
+		 "input_bytes: %llu\n",
+		 plugin.name,
+		 stats.songs,
+		 ToSeconds(stats.audio_time),
+		 ToSeconds(stats.wall_time),
+		 ToSeconds(stats.cpu_time),
+		 ToSeconds(stats.buffer_wait_time),
+		 ToSeconds(stats.input_wait_time),
+		 (unsigned long long)stats.input_bytes);
+
+	if (stats.cpu_time > DecoderStats::Duration::zero())
+		/* how many seconds of audio are decoded per second
+		   of CPU time */
+		r.Format("realtime_factor: %1.1f\n",
+			 ToSeconds(stats.audio_time) /
+			 ToSeconds(stats.cpu_time));
+}
+
+void
+decoder_stats_print(Response &r)
+{
+	const std::lock_guard<Mutex> protect(decoder_stats_mutex);
+
+	decoder_plugins_for_each_enabled([&r](const DecoderPlugin &plugin){
+			auto i = decoder_stats_map.find(&plugin);
+			decoder_stats_print(r, plugin,
+					    i != decoder_stats_map.end()
+					    ? i->second
+					    : DecoderStats());
+		});
+}
+
+void
+decoder_stats_metrics(MetricsWriter &w)
+{
+	const std::lock_guard<Mutex> protect(decoder_stats_mutex);
+
+	w.Declare("mpd_decoder_songs_total", "counter",
+		  "Songs decoded by each plugin");
+	for (const auto &i : decoder_stats_map)
+		w.Sample("mpd_decoder_songs_total",
+			 MetricsWriter::Label("plugin", i.first->name).c_str(),
+			 uint64_t(i.second.songs));
+
+	w.Declare("mpd_decoder_audio_seconds_total", "counter",
+		  "Duration of the audio decoded by each plugin");
+	for (const auto &i : decoder_stats_map)
+		w.Sample("mpd_decoder_audio_seconds_total",
+			 MetricsWriter::Label("plugin", i.first->name).c_str(),
+			 ToSeconds(i.second.audio_time));
+
+	w.Declare("mpd_decoder_cpu_seconds_total", "counter",
+		  "CPU time consumed by each plugin; divide audio seconds by this to get the real-time factor");
+	for (const auto &i : decoder_stats_map)
+		w.Sample("mpd_decoder_cpu_seconds_total",
+			 MetricsWriter::Label("plugin", i.first->name).c_str(),
+			 ToSeconds(i.second.cpu_time));
+
+	w.Declare("mpd_decoder_realtime_factor", "gauge",
+		  "Seconds of audio decoded per second of CPU time");
+	for (const auto &i : decoder_stats_map)
+		if (i.second.cpu_time > DecoderStats::Duration::zero())
+			w.Sample("mpd_decoder_realtime_factor",
+				 MetricsWriter::Label("plugin", i.first->name).c_str(),
+				 ToSeconds(i.second.audio_time) /
+				 ToSeconds(i.second.cpu_time));
+
+	w.Declare("mpd_decoder_input_wait_seconds_total", "counter",
+		  "Time each plugin spent waiting for input data");
+	for (const auto &i : decoder_stats_map)
+		w.Sample("mpd_decoder_input_wait_seconds_total",
+			 MetricsWriter::Label("plugin", i.first->name).c_str(),
+			 ToSeconds(i.second.input_wait_time));
+}
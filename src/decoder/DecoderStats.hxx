@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_STATS_HXX
+#define MPD_DECODER_STATS_HXX
+
+#include <chrono>
+
+#include <stdint.h>
+
+struct DecoderPlugin;
+class Response;
+class MetricsWriter;
+
+/**
+ * Performance counters of one decoder run, or the sum of all runs of
+ * one #DecoderPlugin.  These are collected by #DecoderBridge and the
+ * decoder thread; the "decoderstats" command prints them.
+ */
+struct DecoderStats {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The number of songs decoded (i.e. accepted by the plugin).
+	 */
+	unsigned songs = 0;
+
+	/**
+	 * The duration of the submitted PCM data.
+	 */
+	Duration audio_time = Duration::zero();
+
+	/**
+	 * The wall-clock time spent inside the plugin.
+	 */
+	Duration wall_time = Duration::zero();
+
+	/**
+	 * The CPU time consumed by the decoder thread inside the
+	 * plugin (including PCM conversion).
+	 */
+	Duration cpu_time = Duration::zero();
+
+	/**
+	 * The time spent waiting for free space in the #MusicBuffer.
+	 */
+	Duration buffer_wait_time = Duration::zero();
+
+	/**
+	 * The time spent waiting for data from the #InputStream.
+	 */
+	Duration input_wait_time = Duration::zero();
+
+	/**
+	 * The number of bytes read from the #InputStream.
+	 */
+	uint64_t input_bytes = 0;
+
+	void Add(const DecoderStats &other) noexcept;
+};
+
+/**
+ * Add the counters of a decoder run to the global statistics of the
+ * given plugin.  This function is thread-safe.
+ */
+void
+decoder_stats_add(const DecoderPlugin &plugin,
+		  const DecoderStats &stats) noexcept;
+
+/**
+ * Print the statistics of all enabled decoder plugins.
+ */
+void
+decoder_stats_print(Response &r);
+
+/**
+ * Write the statistics of all decoder plugins which have decoded at
+ * least one song.
+ */
+void
+decoder_stats_metrics(MetricsWriter &w);
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "SeekIndexCache.hxx"
+#include "Domain.hxx"
+#include "input/InputStream.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <iterator>
+
+#include <string.h>
+
+#define SEEK_INDEX_URI "uri"
+#define SEEK_INDEX_VERSION "version"
+#define SEEK_INDEX_END "end"
+
+SeekIndexCache *seek_index_cache;
+
+constexpr size_t SeekIndexCache::MAX_ITEMS;
+
+bool
+SeekIndexCache::CanIndex(const InputStream &is) noexcept
+{
+	return is.IsSeekable() && is.HasVersion() &&
+		strchr(is.GetURI(), '\n') == nullptr &&
+		strchr(is.GetVersion(), '\n') == nullptr;
+}
+
+SeekIndexCache::Index
+SeekIndexCache::Get(const InputStream &is) noexcept
+{
+	if (!CanIndex(is))
+		return Index();
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(is.GetURI());
+	if (i == map.end())
+		return Index();
+
+	auto &item = i->second;
+	if (item.version != is.GetVersion()) {
+		/* the file has been modified */
+		map.erase(i);
+		modified = true;
+		return Index();
+	}
+
+	item.last_used = ++counter;
+
+	try {
+		return item.index;
+	} catch (...) {
+		return Index();
+	}
+}
+
+static bool
+CompareTime(const SeekIndexCache::Point &a,
+	    const SeekIndexCache::Point &b) noexcept
+{
+	return a.time < b.time;
+}
+
+static bool
+EqualPosition(const SeekIndexCache::Point &a,
+	      const SeekIndexCache::Point &b) noexcept
+{
+	return a.position == b.position;
+}
+
+void
+SeekIndexCache::Add(const InputStream &is, Index &&points) noexcept
+{
+	if (points.empty() || !CanIndex(is))
+		return;
+
+	std::sort(points.begin(), points.end(), CompareTime);
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	try {
+		auto &item = map[is.GetURI()];
+		if (item.version != is.GetVersion()) {
+			item.version = is.GetVersion();
+			item.index = std::move(points);
+		} else {
+			Index merged;
+			merged.reserve(item.index.size() + points.size());
+			std::merge(item.index.begin(), item.index.end(),
+				   points.begin(), points.end(),
+				   std::back_inserter(merged), CompareTime);
+			merged.erase(std::unique(merged.begin(), merged.end(),
+						 EqualPosition),
+				     merged.end());
+			item.index = std::move(merged);
+		}
+
+		item.last_used = ++counter;
+		modified = true;
+	} catch (...) {
+		/* out of memory: not fatal */
+		return;
+	}
+
+	Evict();
+}
+
+void
+SeekIndexCache::Evict() noexcept
+{
+	while (map.size() > MAX_ITEMS) {
+		auto oldest = std::min_element(map.begin(), map.end(),
+					       [](const decltype(map)::value_type &a,
+						  const decltype(map)::value_type &b){
+						       return a.second.last_used < b.second.last_used;
+					       });
+		map.erase(oldest);
+	}
+}
+
+const SeekIndexCache::Point *
+SeekIndexCache::Find(const Index &index, SongTime t) noexcept
+{
+	auto i = std::upper_bound(index.begin(), index.end(), t,
+				  [](SongTime _t, const Point &p){
+					  return _t < p.time;
+				  });
+	if (i == index.begin())
+		return nullptr;
+
+	return &*std::prev(i);
+}
+
+void
+SeekIndexCache::LoadFile()
+{
+	TextFile file(path);
+
+	std::string uri;
+	Item item;
+	bool in_item = false;
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (!in_item) {
+			const char *value = StringAfterPrefix(line,
+							      SEEK_INDEX_URI ": ");
+			if (value == nullptr)
+				throw FormatRuntimeError("unknown line in seek index cache: %s",
+							 line);
+
+			uri = value;
+			item.version.clear();
+			item.index.clear();
+			item.last_used = ++counter;
+			in_item = true;
+			continue;
+		}
+
+		if (StringIsEqual(line, SEEK_INDEX_END)) {
+			map[std::move(uri)] = std::move(item);
+			in_item = false;
+			continue;
+		}
+
+		const char *value = StringAfterPrefix(line,
+						      SEEK_INDEX_VERSION ": ");
+		if (value != nullptr) {
+			item.version = value;
+			continue;
+		}
+
+		/* "POSITION OFFSET TIME_MS" */
+		char *endptr;
+		Point p;
+		p.position = ParseUint64(line, &endptr);
+		if (endptr == line || *endptr != ' ')
+			throw FormatRuntimeError("unknown line in seek index cache: %s",
+						 line);
+
+		const char *s = endptr + 1;
+		p.offset = ParseUint64(s, &endptr);
+		if (endptr == s || *endptr != ' ')
+			throw FormatRuntimeError("unknown line in seek index cache: %s",
+						 line);
+
+		s = endptr + 1;
+		p.time = SongTime::FromMS(ParseUint64(s, &endptr));
+		if (endptr == s || *endptr != 0)
+			throw FormatRuntimeError("unknown line in seek index cache: %s",
+						 line);
+
+		item.index.push_back(p);
+	}
+}
+
+void
+SeekIndexCache::Load() noexcept
+{
+	if (!FileExists(path))
+		return;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	try {
+		LoadFile();
+		Evict();
+		FormatDebug(decoder_domain, "loaded %zu seek indexes",
+			    map.size());
+	} catch (...) {
+		map.clear();
+		LogError(std::current_exception(),
+			 "Failed to load the seek index cache");
+	}
+}
+
+void
+SeekIndexCache::SaveFile() const
+{
+	FileOutputStream fos(path);
+	BufferedOutputStream os(fos);
+
+	for (const auto &i : map) {
+		const auto &item = i.second;
+
+		os.Format(SEEK_INDEX_URI ": %s\n", i.first.c_str());
+		os.Format(SEEK_INDEX_VERSION ": %s\n", item.version.c_str());
+
+		for (const auto &p : item.index)
+			os.Format("%llu %llu %llu\n",
+				  (unsigned long long)p.position,
+				  (unsigned long long)p.offset,
+				  (unsigned long long)p.time.ToMS());
+
+		os.Format(SEEK_INDEX_END "\n");
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
+void
+SeekIndexCache::Save() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (!modified)
+		return;
+
+	try {
+		SaveFile();
+		modified = false;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save the seek index cache");
+	}
+}
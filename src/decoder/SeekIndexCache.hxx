@@ -0,0 +1,168 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SEEK_INDEX_CACHE_HXX
+#define MPD_SEEK_INDEX_CACHE_HXX
+
+#include "Chrono.hxx"
+#include "input/Offset.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/Compiler.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+class InputStream;
+
+/**
+ * A persistent cache of seek indexes for formats which cannot seek
+ * efficiently on their own (e.g. VBR MP3).  A decoder plugin records
+ * the byte offsets of some frames while it plays a song, and the
+ * next time this song is played, a seek can jump to the nearest
+ * known frame directly instead of decoding (or downloading)
+ * everything in between.
+ *
+ * An index is identified by the URI of the stream, and is only
+ * valid as long as the stream's version (e.g. the modification
+ * time) matches.
+ *
+ * All methods except Load() and Save() are thread-safe.
+ */
+class SeekIndexCache {
+public:
+	struct Point {
+		/**
+		 * A plugin specific position, e.g. the MP3 frame
+		 * number.
+		 */
+		uint64_t position;
+
+		/**
+		 * The byte offset where this position starts.
+		 */
+		offset_type offset;
+
+		/**
+		 * The song time where this position starts.
+		 */
+		SongTime time;
+	};
+
+	/**
+	 * A list of points sorted by time.
+	 */
+	typedef std::vector<Point> Index;
+
+private:
+	/**
+	 * The maximum number of songs in the cache.  When it is
+	 * exceeded, the least recently used index is discarded.
+	 */
+	static constexpr size_t MAX_ITEMS = 1024;
+
+	struct Item {
+		std::string version;
+
+		Index index;
+
+		/**
+		 * The value of #counter when this item was last used.
+		 */
+		unsigned long last_used;
+	};
+
+	const AllocatedPath path;
+
+	Mutex mutex;
+
+	std::unordered_map<std::string, Item> map;
+
+	unsigned long counter = 0;
+
+	/**
+	 * Were indexes added since the cache was loaded or saved?
+	 */
+	bool modified = false;
+
+public:
+	explicit SeekIndexCache(AllocatedPath &&_path) noexcept
+		:path(std::move(_path)) {}
+
+	SeekIndexCache(const SeekIndexCache &) = delete;
+	SeekIndexCache &operator=(const SeekIndexCache &) = delete;
+
+	/**
+	 * Load the cache file.  Errors are logged.
+	 */
+	void Load() noexcept;
+
+	/**
+	 * Write the cache file if it was modified.  Errors are
+	 * logged.
+	 */
+	void Save() noexcept;
+
+	/**
+	 * Can the given stream be indexed?  It must be seekable and
+	 * have a version.
+	 */
+	gcc_pure
+	static bool CanIndex(const InputStream &is) noexcept;
+
+	/**
+	 * Obtain a copy of the index of the given stream.
+	 *
+	 * @return the index or an empty list if there is none
+	 */
+	Index Get(const InputStream &is) noexcept;
+
+	/**
+	 * Add points to the index of the given stream.  They are
+	 * merged with the points which are already known.
+	 */
+	void Add(const InputStream &is, Index &&points) noexcept;
+
+	/**
+	 * Find the last point which starts at or before the given
+	 * time.
+	 *
+	 * @return the point or nullptr if there is none
+	 */
+	gcc_pure
+	static const Point *Find(const Index &index, SongTime t) noexcept;
+
+private:
+	void Evict() noexcept;
+
+	void LoadFile();
+	void SaveFile() const;
+};
+
+/**
+ * The global #SeekIndexCache instance; nullptr if none was
+ * configured.
+ */
+extern SeekIndexCache *seek_index_cache;
+
+#endif
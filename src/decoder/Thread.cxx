@@ -30,6 +30,7 @@
 #include "input/LocalOpen.hxx"
 #include "input/Registry.hxx"
 #include "DecoderList.hxx"
+#include "system/Clock.hxx"
 #include "system/Error.hxx"
 #include "util/MimeType.hxx"
 #include "util/UriUtil.hxx"
@@ -38,6 +39,7 @@
 #include "util/ScopeExit.hxx"
 #include "util/StringCompare.hxx"
 #include "thread/Name.hxx"
+#include "ThreadConfig.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "Log.hxx"
 
@@ -48,15 +50,64 @@
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
 /**
- * Opens the input stream with InputStream::Open(), and waits until
- * the stream gets ready.
+ * Measures the wall-clock and CPU time of one plugin run.  If the
+ * plugin has accepted the song, the counters collected in
+ * DecoderBridge::stats are added to the plugin's #DecoderStats.
+ *
+ * To be used in the decoder thread.
+ */
+class ScopeDecoderStats {
+	const DecoderPlugin &plugin;
+	DecoderBridge &bridge;
+
+	const std::chrono::steady_clock::time_point start_time;
+	const std::chrono::steady_clock::duration start_cpu_time;
+
+public:
+	ScopeDecoderStats(const DecoderPlugin &_plugin,
+			  DecoderBridge &_bridge) noexcept
+		:plugin(_plugin), bridge(_bridge),
+		 start_time(std::chrono::steady_clock::now()),
+		 start_cpu_time(GetThreadCPUTime()) {
+		bridge.stats = DecoderStats();
+	}
+
+	~ScopeDecoderStats() noexcept {
+		if (bridge.dc.state == DecoderState::START)
+			/* the plugin has rejected the song */
+			return;
+
+		auto &stats = bridge.stats;
+		stats.songs = 1;
+		stats.wall_time = std::chrono::steady_clock::now() - start_time;
+		stats.cpu_time = GetThreadCPUTime() - start_cpu_time;
+		decoder_stats_add(plugin, stats);
+	}
+
+	ScopeDecoderStats(const ScopeDecoderStats &) = delete;
+	ScopeDecoderStats &operator=(const ScopeDecoderStats &) = delete;
+};
+
+/**
+ * Opens the input stream with InputStream::Open() (or picks up the
+ * one opened by DecoderControl::Prefetch()), and waits until the
+ * stream gets ready.
  *
  * Unlock the decoder before calling this function.
  */
 static InputStreamPtr
 decoder_input_stream_open(DecoderControl &dc, const char *uri)
 {
-	auto is = InputStream::Open(uri, dc.mutex);
+	InputStreamPtr is;
+
+	{
+		const std::lock_guard<Mutex> protect(dc.mutex);
+		is = dc.TakePrefetch(uri);
+	}
+
+	if (!is)
+		is = InputStream::Open(uri, dc.mutex);
+
 	is->SetHandler(&dc);
 
 	/* wait for the input stream to become ready; its metadata
@@ -121,7 +172,10 @@ decoder_stream_decode(const DecoderPlugin &plugin,
 
 		FormatThreadName("decoder:%s", plugin.name);
 
-		plugin.StreamDecode(bridge, input_stream);
+		{
+			const ScopeDecoderStats measure(plugin, bridge);
+			plugin.StreamDecode(bridge, input_stream);
+		}
 
 		SetThreadName("decoder");
 	}
@@ -158,7 +212,10 @@ decoder_file_decode(const DecoderPlugin &plugin,
 
 		FormatThreadName("decoder:%s", plugin.name);
 
-		plugin.FileDecode(bridge, path);
+		{
+			const ScopeDecoderStats measure(plugin, bridge);
+			plugin.FileDecode(bridge, path);
+		}
 
 		SetThreadName("decoder");
 	}
@@ -169,45 +226,12 @@ decoder_file_decode(const DecoderPlugin &plugin,
 	return bridge.dc.state != DecoderState::START;
 }
 
-gcc_pure
-static bool
-decoder_check_plugin_mime(const DecoderPlugin &plugin,
-			  const InputStream &is) noexcept
-{
-	assert(plugin.stream_decode != nullptr);
-
-	const char *mime_type = is.GetMimeType();
-	return mime_type != nullptr &&
-		plugin.SupportsMimeType(GetMimeTypeBase(mime_type).c_str());
-}
-
-gcc_pure
-static bool
-decoder_check_plugin_suffix(const DecoderPlugin &plugin,
-			    const char *suffix) noexcept
-{
-	assert(plugin.stream_decode != nullptr);
-
-	return suffix != nullptr && plugin.SupportsSuffix(suffix);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
-		     const char *suffix) noexcept
-{
-	return plugin.stream_decode != nullptr &&
-		(decoder_check_plugin_mime(plugin, is) ||
-		 decoder_check_plugin_suffix(plugin, suffix));
-}
-
 static bool
 decoder_run_stream_plugin(DecoderBridge &bridge, InputStream &is,
-			  const char *suffix,
 			  const DecoderPlugin &plugin,
 			  bool &tried_r)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
+	if (plugin.stream_decode == nullptr)
 		return false;
 
 	bridge.error = std::exception_ptr();
@@ -223,11 +247,16 @@ decoder_run_stream_locked(DecoderBridge &bridge, InputStream &is,
 	UriSuffixBuffer suffix_buffer;
 	const char *const suffix = uri_get_suffix(uri, suffix_buffer);
 
+	const char *mime_type = is.GetMimeType();
+	std::string mime_base;
+	if (mime_type != nullptr)
+		mime_type = (mime_base = GetMimeTypeBase(mime_type)).c_str();
+
 	using namespace std::placeholders;
 	const auto f = std::bind(decoder_run_stream_plugin,
-				 std::ref(bridge), std::ref(is), suffix,
+				 std::ref(bridge), std::ref(is),
 				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+	return decoder_plugins_try_suffix_or_mime(suffix, mime_type, f);
 }
 
 /**
@@ -309,13 +338,10 @@ decoder_run_stream(DecoderBridge &bridge, const char *uri)
  * DecoderControl::mutex is not locked by caller.
  */
 static bool
-TryDecoderFile(DecoderBridge &bridge, Path path_fs, const char *suffix,
+TryDecoderFile(DecoderBridge &bridge, Path path_fs,
 	       InputStream &input_stream,
 	       const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	bridge.error = std::exception_ptr();
 
 	DecoderControl &dc = bridge.dc;
@@ -336,12 +362,11 @@ TryDecoderFile(DecoderBridge &bridge, Path path_fs, const char *suffix,
  * DecoderControl::mutex is not locked by caller.
  */
 static bool
-TryContainerDecoder(DecoderBridge &bridge, Path path_fs, const char *suffix,
+TryContainerDecoder(DecoderBridge &bridge, Path path_fs,
 		    const DecoderPlugin &plugin)
 {
 	if (plugin.container_scan == nullptr ||
-	    plugin.file_decode == nullptr ||
-	    !plugin.SupportsSuffix(suffix))
+	    plugin.file_decode == nullptr)
 		return false;
 
 	bridge.error = nullptr;
@@ -359,13 +384,12 @@ TryContainerDecoder(DecoderBridge &bridge, Path path_fs, const char *suffix,
 static bool
 TryContainerDecoder(DecoderBridge &bridge, Path path_fs, const char *suffix)
 {
-	return decoder_plugins_try([&bridge, path_fs,
-				    suffix](const DecoderPlugin &plugin){
-					   return TryContainerDecoder(bridge,
-								      path_fs,
-								      suffix,
-								      plugin);
-				   });
+	return decoder_plugins_try_suffix(suffix,
+					  [&bridge, path_fs](const DecoderPlugin &plugin){
+						  return TryContainerDecoder(bridge,
+									     path_fs,
+									     plugin);
+					  });
 }
 
 /**
@@ -399,14 +423,14 @@ decoder_run_file(DecoderBridge &bridge, const char *uri_utf8, Path path_fs)
 	MaybeLoadReplayGain(bridge, *input_stream);
 
 	auto &is = *input_stream;
-	return decoder_plugins_try([&bridge, path_fs, suffix,
-				    &is](const DecoderPlugin &plugin){
-					   return TryDecoderFile(bridge,
-								 path_fs,
-								 suffix,
-								 is,
-								 plugin);
-				   });
+	return decoder_plugins_try_suffix(suffix,
+					  [&bridge, path_fs,
+					   &is](const DecoderPlugin &plugin){
+						  return TryDecoderFile(bridge,
+									path_fs,
+									is,
+									plugin);
+					  });
 }
 
 /**
@@ -443,7 +467,7 @@ gcc_pure
 static bool
 SongHasVolatileTags(const DetachedSong &song) noexcept
 {
-	return !song.IsFile() && !HasRemoteTagScanner(song.GetRealURI());
+	return !song.IsFile() && !HasRemoteTagScanner(song.GetRealURI().c_str());
 }
 
 /**
@@ -463,6 +487,16 @@ decoder_run_song(DecoderControl &dc,
 				played it*/
 			     !SongHasVolatileTags(song) ? std::make_unique<Tag>(song.GetTag()) : nullptr);
 
+	if (song.GetReplayGain().IsDefined())
+		/* measured by the database update; if the file has
+		   ReplayGain tags, the decoder plugin will submit
+		   them, overriding these values */
+		bridge.SubmitReplayGain(&song.GetReplayGain());
+
+	if (song.GetMixRamp().IsDefined())
+		/* same for the MixRamp profile */
+		bridge.SubmitMixRamp(MixRampInfo(song.GetMixRamp()));
+
 	dc.state = DecoderState::START;
 	dc.CommandFinishedLocked();
 
@@ -510,7 +544,8 @@ try {
 	assert(dc.song != nullptr);
 	const DetachedSong &song = *dc.song;
 
-	const char *const uri_utf8 = song.GetRealURI();
+	const std::string real_uri = song.GetRealURI();
+	const char *const uri_utf8 = real_uri.c_str();
 
 	Path path_fs = nullptr;
 	AllocatedPath path_buffer = nullptr;
@@ -531,6 +566,7 @@ void
 DecoderControl::RunThread() noexcept
 {
 	SetThreadName("decoder");
+	decoder_thread_config.Apply("decoder");
 
 	const std::lock_guard<Mutex> protect(mutex);
 
@@ -31,12 +31,14 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
-#include "util/bit_reverse.h"
+#include "pcm/BitReverse.hxx"
 #include "system/ByteOrder.hxx"
 #include "tag/Handler.hxx"
 #include "DsdLib.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 struct DsdiffHeader {
 	DsdId id;
 	DffDsdUint64 size;
@@ -341,13 +343,6 @@ dsdiff_read_metadata(DecoderClient *client, InputStream &is,
 	}
 }
 
-static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
-{
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
-}
-
 static offset_type
 FrameToOffset(uint64_t frame, unsigned channels)
 {
@@ -370,6 +365,7 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 	const size_t frame_size = channels * sample_size;
 	const unsigned buffer_frames = sizeof(buffer) / frame_size;
 	const size_t buffer_size = buffer_frames * frame_size;
+	const uint16_t kbit_rate = sample_rate / 1000;
 
 	auto cmd = client.GetCommand();
 	for (offset_type remaining_bytes = total_bytes;
@@ -398,6 +394,26 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 			now_size = now_frames * frame_size;
 		}
 
+		/* DFF data is already interleaved: read it directly
+		   into the MusicChunk if possible */
+		const auto dest = client.GetWriteBuffer(&is, kbit_rate);
+		if (dest.size >= frame_size) {
+			now_size = std::min(now_size,
+					    dest.size - dest.size % frame_size);
+
+			uint8_t *p = (uint8_t *)dest.data;
+			if (!decoder_read_full(&client, is, p, now_size))
+				return false;
+
+			remaining_bytes -= now_size;
+
+			if (lsbitfirst)
+				PcmBitReverse(p, p, now_size);
+
+			cmd = client.CommitData(now_size);
+			continue;
+		}
+
 		if (!decoder_read_full(&client, is, buffer, now_size))
 			return false;
 
@@ -405,10 +421,9 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 		remaining_bytes -= nbytes;
 
 		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+			PcmBitReverse(buffer, buffer, nbytes);
 
-		cmd = client.SubmitData(is, buffer, nbytes,
-					sample_rate / 1000);
+		cmd = client.SubmitData(is, buffer, nbytes, kbit_rate);
 	}
 
 	return true;
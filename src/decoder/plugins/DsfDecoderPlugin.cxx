@@ -32,12 +32,14 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
-#include "util/bit_reverse.h"
+#include "pcm/DsdInterleave.hxx"
 #include "system/ByteOrder.hxx"
 #include "DsdLib.hxx"
 #include "tag/Handler.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
 static constexpr unsigned DSF_BLOCK_SIZE = 4096;
@@ -181,64 +183,63 @@ dsf_read_metadata(DecoderClient *client, InputStream &is,
 	return true;
 }
 
+/**
+ * DSF data is build up of alternating 4096 blocks of DSD samples for
+ * each channel.  Interleave frames starting at the given #offset of
+ * such a block group (and reverse the bit order if needed) into
+ * normal PCM channel order.
+ */
 static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
+InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+		   unsigned channels, size_t offset, size_t n_frames,
+		   bool bitreverse) noexcept
 {
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
-}
+	const uint8_t *planes[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c)
+		planes[c] = src + c * DSF_BLOCK_SIZE + offset;
 
-static void
-InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
-		       const uint8_t *gcc_restrict src)
-{
-	memcpy(dest, src, DSF_BLOCK_SIZE);
+	PcmInterleaveDsd(dest, {planes, channels}, n_frames, bitreverse);
 }
 
 /**
- * DSF data is build up of alternating 4096 blocks of DSD samples for left and
- * right. Convert the buffer holding 1 block of 4096 DSD left samples and 1
- * block of 4096 DSD right samples to 8k of samples in normal PCM left/right
- * order.
+ * Submit one group of channel blocks to the decoder client.  The
+ * frames are interleaved directly into the buffer obtained from
+ * DecoderClient::GetWriteBuffer() if possible, and the rest is
+ * copied with DecoderClient::SubmitData().
  */
-static void
-InterleaveDsfBlockStereo(uint8_t *gcc_restrict dest,
-			 const uint8_t *gcc_restrict src)
+static DecoderCommand
+dsf_submit_block(DecoderClient &client, InputStream &is,
+		 const uint8_t *src, unsigned channels,
+		 bool bitreverse, uint16_t kbit_rate)
 {
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i) {
-		dest[2 * i] = src[i];
-		dest[2 * i + 1] = src[DSF_BLOCK_SIZE + i];
+	size_t done = 0;
+	while (done < DSF_BLOCK_SIZE) {
+		const auto dest = client.GetWriteBuffer(&is, kbit_rate);
+		const size_t n = std::min(dest.size / channels,
+					  DSF_BLOCK_SIZE - done);
+		if (n == 0)
+			break;
+
+		InterleaveDsfBlock((uint8_t *)dest.data, src, channels,
+				   done, n, bitreverse);
+		done += n;
+
+		auto cmd = client.CommitData(n * channels);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
 	}
-}
 
-static void
-InterleaveDsfBlockChannel(uint8_t *gcc_restrict dest,
-			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
-{
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i, dest += channels, ++src)
-		*dest = *src;
-}
+	if (done == DSF_BLOCK_SIZE)
+		return DecoderCommand::NONE;
 
-static void
-InterleaveDsfBlockGeneric(uint8_t *gcc_restrict dest,
-			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
-{
-	for (unsigned c = 0; c < channels; ++c, ++dest, src += DSF_BLOCK_SIZE)
-		InterleaveDsfBlockChannel(dest, src, channels);
-}
+	/* worst-case buffer size */
+	uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
+	const size_t n = DSF_BLOCK_SIZE - done;
+	InterleaveDsfBlock(interleaved_buffer, src, channels,
+			   done, n, bitreverse);
 
-static void
-InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
-		   unsigned channels)
-{
-	if (channels == 1)
-		InterleaveDsfBlockMono(dest, src);
-	else if (channels == 2)
-		InterleaveDsfBlockStereo(dest, src);
-	else
-		InterleaveDsfBlockGeneric(dest, src, channels);
+	return client.SubmitData(is, interleaved_buffer, n * channels,
+				 kbit_rate);
 }
 
 static offset_type
@@ -283,15 +284,8 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 		if (!decoder_read_full(&client, is, buffer, block_size))
 			return false;
 
-		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
-
-		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
-
-		cmd = client.SubmitData(is,
-					interleaved_buffer, block_size,
-					sample_rate / 1000);
+		cmd = dsf_submit_block(client, is, buffer, channels,
+				       bitreverse, sample_rate / 1000);
 		++i;
 	}
 
@@ -77,7 +77,7 @@ adts_find_frame(DecoderBuffer &buffer)
 			memchr(data.data, 0xff, data.size);
 		if (p == nullptr) {
 			/* no marker - discard the buffer */
-			buffer.Clear();
+			buffer.Discard();
 			continue;
 		}
 
@@ -99,7 +99,7 @@ adts_find_frame(DecoderBuffer &buffer)
 		if (buffer.Need(frame_length).IsNull()) {
 			/* not enough data; discard this frame to
 			   prevent a possible buffer overflow */
-			buffer.Clear();
+			buffer.Discard();
 			continue;
 		}
 
@@ -144,8 +144,7 @@ adts_song_duration(DecoderBuffer &buffer)
 			   extrapolate the song duration from what we
 			   have until now */
 
-			const auto offset = is.GetOffset()
-				- buffer.GetAvailable();
+			const auto offset = buffer.GetOffset();
 			if (offset <= 0)
 				return SignedSongTime::Negative();
 
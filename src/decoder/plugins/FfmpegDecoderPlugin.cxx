@@ -28,6 +28,7 @@
 #include "lib/ffmpeg/Init.hxx"
 #include "lib/ffmpeg/Buffer.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndexCache.hxx"
 #include "FfmpegMetaData.hxx"
 #include "FfmpegIo.hxx"
 #include "pcm/Interleave.hxx"
@@ -57,6 +58,18 @@ extern "C" {
  */
 static AVDictionary *avformat_options = nullptr;
 
+/**
+ * The default size of the AVIOContext buffer.
+ */
+static constexpr size_t FFMPEG_DEFAULT_IO_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * Record a packet in the #SeekIndexCache at this interval.
+ */
+static constexpr SongTime FFMPEG_SEEK_INDEX_INTERVAL = SongTime::FromMS(1000);
+
+static size_t ffmpeg_io_buffer_size = FFMPEG_DEFAULT_IO_BUFFER_SIZE;
+
 static AVFormatContext *
 FfmpegOpenInput(AVIOContext *pb,
 		const char *filename,
@@ -95,6 +108,11 @@ ffmpeg_init(const ConfigBlock &block)
 			av_dict_set(&avformat_options, name, value, 0);
 	}
 
+	/* configured in KiB */
+	ffmpeg_io_buffer_size =
+		size_t(block.GetPositiveValue("io_buffer_size",
+					      unsigned(FFMPEG_DEFAULT_IO_BUFFER_SIZE / 1024))) * 1024;
+
 	return true;
 }
 
@@ -472,6 +490,51 @@ FfmpegScanMetadata(const AVFormatContext &format_context, int audio_stream,
 			   handler);
 }
 
+gcc_const
+static const char *
+FfmpegPictureMimeType(AVCodecID codec_id) noexcept
+{
+	switch (codec_id) {
+	case AV_CODEC_ID_MJPEG:
+		return "image/jpeg";
+
+	case AV_CODEC_ID_PNG:
+		return "image/png";
+
+	case AV_CODEC_ID_BMP:
+		return "image/bmp";
+
+	case AV_CODEC_ID_GIF:
+		return "image/gif";
+
+	default:
+		return nullptr;
+	}
+}
+
+/**
+ * Pass the first attached picture (e.g. MP4 "covr") to the
+ * #TagHandler.
+ */
+static void
+FfmpegScanPicture(const AVFormatContext &format_context,
+		  TagHandler &handler) noexcept
+{
+	assert(handler.WantPicture());
+
+	for (unsigned i = 0; i < format_context.nb_streams; ++i) {
+		const AVStream &stream = *format_context.streams[i];
+		if ((stream.disposition & AV_DISPOSITION_ATTACHED_PIC) == 0 ||
+		    stream.attached_pic.size <= 0)
+			continue;
+
+		handler.OnPicture(FfmpegPictureMimeType(stream.codecpar->codec_id),
+				  {stream.attached_pic.data,
+				   size_t(stream.attached_pic.size)});
+		return;
+	}
+}
+
 static void
 FfmpegScanTag(const AVFormatContext &format_context, int audio_stream,
 	      TagBuilder &tag)
@@ -502,6 +565,73 @@ FfmpegCheckTag(DecoderClient &client, InputStream &is,
 		client.SubmitTag(is, tag.Commit());
 }
 
+/**
+ * Helper which feeds the demuxer's index from the #SeekIndexCache,
+ * and records packet positions for it while playing.  This is only
+ * done for streams whose container has no index, because otherwise
+ * FFmpeg knows better.
+ */
+class FfmpegSeekIndex {
+	InputStream &input;
+
+	SeekIndexCache::Index new_points;
+
+	/**
+	 * The next packet starting at or after this time will be
+	 * added to #new_points.  It only moves forward, so
+	 * backwards seeks don't record the same points again.
+	 */
+	SongTime next_time = SongTime::zero();
+
+	bool enabled = false;
+
+public:
+	explicit FfmpegSeekIndex(InputStream &_input) noexcept
+		:input(_input) {}
+
+	~FfmpegSeekIndex() noexcept {
+		if (enabled && !new_points.empty())
+			seek_index_cache->Add(input, std::move(new_points));
+	}
+
+	void Load(AVStream &stream) noexcept {
+		if (seek_index_cache == nullptr ||
+		    stream.nb_index_entries > 0 ||
+		    !SeekIndexCache::CanIndex(input))
+			return;
+
+		enabled = true;
+
+		for (const auto &p : seek_index_cache->Get(input))
+			av_add_index_entry(&stream, p.offset, p.position,
+					   0, 0, AVINDEX_KEYFRAME);
+	}
+
+	void Record(const AVStream &stream, const AVPacket &packet) noexcept {
+		if (!enabled || packet.pos < 0 ||
+		    packet.pts == (int64_t)AV_NOPTS_VALUE)
+			return;
+
+		const int64_t start = start_time_fallback(stream);
+		if (packet.pts < start)
+			return;
+
+		const auto t = FromFfmpegTime(packet.pts - start,
+					      stream.time_base);
+		if (t < next_time)
+			return;
+
+		try {
+			new_points.push_back({uint64_t(packet.pts),
+					      offset_type(packet.pos), t});
+		} catch (...) {
+			enabled = false;
+		}
+
+		next_time = t + FFMPEG_SEEK_INDEX_INTERVAL;
+	}
+};
+
 static void
 FfmpegDecode(DecoderClient &client, InputStream &input,
 	     AVFormatContext &format_context)
@@ -586,6 +716,10 @@ FfmpegDecode(DecoderClient &client, InputStream &input,
 
 	FfmpegBuffer interleaved_buffer;
 
+	FfmpegSeekIndex seek_index(input);
+	if (input.IsSeekable())
+		seek_index.Load(av_stream);
+
 	uint64_t min_frame = 0;
 
 	DecoderCommand cmd = client.GetCommand();
@@ -621,6 +755,8 @@ FfmpegDecode(DecoderClient &client, InputStream &input,
 		FfmpegCheckTag(client, input, format_context, audio_stream);
 
 		if (packet.size > 0 && packet.stream_index == audio_stream) {
+			seek_index.Record(av_stream, packet);
+
 			cmd = ffmpeg_send_packet(client, input,
 						 packet,
 						 *codec_context,
@@ -638,7 +774,7 @@ static void
 ffmpeg_decode(DecoderClient &client, InputStream &input)
 {
 	AvioStream stream(&client, input);
-	if (!stream.Open()) {
+	if (!stream.Open(ffmpeg_io_buffer_size)) {
 		LogError(ffmpeg_domain, "Failed to open stream");
 		return;
 	}
@@ -694,6 +830,9 @@ FfmpegScanStream(AVFormatContext &format_context,
 
 	FfmpegScanMetadata(format_context, audio_stream, handler);
 
+	if (handler.WantPicture())
+		FfmpegScanPicture(format_context, handler);
+
 	return true;
 }
 
@@ -701,7 +840,7 @@ static bool
 ffmpeg_scan_stream(InputStream &is, TagHandler &handler) noexcept
 {
 	AvioStream stream(nullptr, is);
-	if (!stream.Open())
+	if (!stream.Open(ffmpeg_io_buffer_size))
 		return false;
 
 	AVFormatContext *f;
@@ -93,14 +93,13 @@ AvioStream::_Seek(void *opaque, int64_t pos, int whence)
 }
 
 bool
-AvioStream::Open()
+AvioStream::Open(size_t buffer_size)
 {
-	constexpr size_t BUFFER_SIZE = 8192;
-	auto buffer = (unsigned char *)av_malloc(BUFFER_SIZE);
+	auto buffer = (unsigned char *)av_malloc(buffer_size);
 	if (buffer == nullptr)
 		return false;
 
-	io = avio_alloc_context(buffer, BUFFER_SIZE,
+	io = avio_alloc_context(buffer, buffer_size,
 				false, this,
 				_Read, nullptr,
 				input.IsSeekable() ? _Seek : nullptr);
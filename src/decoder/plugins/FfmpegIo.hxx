@@ -40,7 +40,11 @@ struct AvioStream {
 
 	~AvioStream();
 
-	bool Open();
+	/**
+	 * @param buffer_size the size of the AVIOContext buffer,
+	 * i.e. how much is read from the #InputStream at a time
+	 */
+	bool Open(size_t buffer_size);
 
 private:
 	int Read(void *buffer, int size);
@@ -26,6 +26,7 @@
 #include "Log.hxx"
 #include "input/InputStream.hxx"
 
+#include <algorithm>
 #include <exception>
 
 bool
@@ -116,6 +117,38 @@ FlacDecoder::OnFirstFrame(const FLAC__FrameHeader &header)
 			  0);
 }
 
+inline size_t
+FlacDecoder::WriteDirect(const FLAC__int32 *const buf[], size_t n_frames)
+{
+	DecoderClient *client = GetClient();
+	if (client == nullptr)
+		return 0;
+
+	const size_t frame_size = pcm_import.GetAudioFormat().GetFrameSize();
+
+	size_t done = 0;
+	while (done < n_frames) {
+		/* this returns an empty buffer if a command (e.g. a
+		   seek in progress) is pending; then the data is
+		   submitted later by the decoder loop */
+		const auto dest = client->GetWriteBuffer(&GetInputStream(),
+							 kbit_rate);
+		const size_t n = std::min(dest.size / frame_size,
+					  n_frames - done);
+		if (n == 0)
+			break;
+
+		pcm_import.ImportTo(dest.data, buf, done, n);
+		done += n;
+
+		command = client->CommitData(n * frame_size);
+		if (command != DecoderCommand::NONE)
+			break;
+	}
+
+	return done;
+}
+
 FLAC__uint64
 FlacDecoder::GetDeltaPosition(const FLAC__StreamDecoder &sd)
 {
@@ -142,10 +175,27 @@ FlacDecoder::OnWrite(const FLAC__Frame &frame,
 	if (!initialized && !OnFirstFrame(frame.header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	chunk = pcm_import.Import(buf, frame.header.blocksize);
-
 	kbit_rate = nbytes * 8 * frame.header.sample_rate /
 		(1000 * frame.header.blocksize);
 
+	const size_t n_frames = frame.header.blocksize;
+
+	/* if there is a pending tag, it must be submitted before the
+	   data, so defer the data to the decoder loop */
+	size_t n_direct = 0;
+	if (tag.IsEmpty()) {
+		try {
+			n_direct = WriteDirect(buf, n_frames);
+		} catch (...) {
+			/* don't let exceptions pass through
+			   libFLAC */
+			LogError(std::current_exception());
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		}
+	}
+
+	if (n_direct < n_frames && command == DecoderCommand::NONE)
+		chunk = pcm_import.Import(buf, n_direct, n_frames - n_direct);
+
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -61,10 +61,18 @@ struct FlacDecoder : public FlacInput {
 	/**
 	 * Decoded PCM data obtained by our libFLAC write callback.
 	 * If this is non-empty, then DecoderBridge::SubmitData()
-	 * should be called.
+	 * should be called.  This is only used for frames which could
+	 * not be written with WriteDirect().
 	 */
 	ConstBuffer<void> chunk = nullptr;
 
+	/**
+	 * The command returned by DecoderClient::CommitData() while
+	 * our libFLAC write callback was writing directly to the
+	 * client's buffer.
+	 */
+	DecoderCommand command = DecoderCommand::NONE;
+
 	FlacDecoder(DecoderClient &_client, InputStream &_input_stream)
 		:FlacInput(_input_stream, &_client) {}
 
@@ -98,6 +106,15 @@ private:
 	 * (e.g. when seeking with SqueezeBox Server).
 	 */
 	bool OnFirstFrame(const FLAC__FrameHeader &header);
+
+	/**
+	 * Write decoded PCM data directly to buffers obtained by
+	 * DecoderClient::GetWriteBuffer(), saving the copy to
+	 * #chunk.
+	 *
+	 * @return the number of frames which were written
+	 */
+	size_t WriteDirect(const FLAC__int32 *const buf[], size_t n_frames);
 };
 
 #endif /* _FLAC_COMMON_H */
@@ -28,6 +28,8 @@
 #include "fs/NarrowPath.hxx"
 #include "Log.hxx"
 
+#include <utility>
+
 #if !defined(FLAC_API_VERSION_CURRENT) || FLAC_API_VERSION_CURRENT <= 7
 #error libFLAC is too old
 #endif
@@ -140,6 +142,9 @@ flac_decoder_initialize(FlacDecoder *data, FLAC__StreamDecoder *sd)
 static DecoderCommand
 FlacSubmitToClient(DecoderClient &client, FlacDecoder &d) noexcept
 {
+	if (d.command != DecoderCommand::NONE)
+		return std::exchange(d.command, DecoderCommand::NONE);
+
 	if (d.tag.IsEmpty() && d.chunk.empty())
 		return client.GetCommand();
 
@@ -22,6 +22,13 @@
 #include "lib/xiph/FlacAudioFormat.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/ConstBuffer.hxx"
+#include "pcm/Simd.hxx"
+
+#ifdef PCM_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
 
 #include <assert.h>
 
@@ -37,65 +44,209 @@ FlacPcmImport::Open(unsigned sample_rate, unsigned bits_per_sample,
 	audio_format = CheckAudioFormat(sample_rate, sample_format, channels);
 }
 
+#ifdef PCM_SIMD_SSE2
+
+/*
+ * Vectorized import kernels.  Each one processes a multiple of its
+ * block size and returns the number of frames it has written; the
+ * caller is responsible for the remaining frames.  The packing
+ * instructions saturate, which makes no difference because libFLAC
+ * never returns samples out of the range of the bit depth.
+ */
+
+static size_t
+FlacImportStereoSimd(int16_t *dest, const FLAC__int32 *left,
+		     const FLAC__int32 *right, size_t n_frames) noexcept
+{
+	const size_t n = n_frames & ~size_t(3);
+
+	for (size_t i = 0; i != n; i += 4, dest += 8) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+		const __m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_packs_epi32(_mm_unpacklo_epi32(l, r),
+						 _mm_unpackhi_epi32(l, r)));
+	}
+
+	return n;
+}
+
+static size_t
+FlacImportStereoSimd(int32_t *dest, const FLAC__int32 *left,
+		     const FLAC__int32 *right, size_t n_frames) noexcept
+{
+	const size_t n = n_frames & ~size_t(3);
+
+	for (size_t i = 0; i != n; i += 4, dest += 8) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+		const __m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi32(l, r));
+		_mm_storeu_si128((__m128i *)(dest + 4),
+				 _mm_unpackhi_epi32(l, r));
+	}
+
+	return n;
+}
+
+static size_t
+FlacImportMonoSimd(int16_t *dest, const FLAC__int32 *src,
+		   size_t n_frames) noexcept
+{
+	const size_t n = n_frames & ~size_t(7);
+
+	for (size_t i = 0; i != n; i += 8, dest += 8) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(a, b));
+	}
+
+	return n;
+}
+
+#elif defined(PCM_SIMD_NEON)
+
+/*
+ * Vectorized import kernels.  Each one processes a multiple of its
+ * block size and returns the number of frames it has written; the
+ * caller is responsible for the remaining frames.
+ */
+
+static size_t
+FlacImportStereoSimd(int16_t *dest, const FLAC__int32 *left,
+		     const FLAC__int32 *right, size_t n_frames) noexcept
+{
+	const size_t n = n_frames & ~size_t(7);
+
+	for (size_t i = 0; i != n; i += 8, dest += 16) {
+		int16x8x2_t v;
+		v.val[0] = vcombine_s16(vmovn_s32(vld1q_s32(left + i)),
+					vmovn_s32(vld1q_s32(left + i + 4)));
+		v.val[1] = vcombine_s16(vmovn_s32(vld1q_s32(right + i)),
+					vmovn_s32(vld1q_s32(right + i + 4)));
+		vst2q_s16(dest, v);
+	}
+
+	return n;
+}
+
+static size_t
+FlacImportStereoSimd(int32_t *dest, const FLAC__int32 *left,
+		     const FLAC__int32 *right, size_t n_frames) noexcept
+{
+	const size_t n = n_frames & ~size_t(3);
+
+	for (size_t i = 0; i != n; i += 4, dest += 8) {
+		int32x4x2_t v;
+		v.val[0] = vld1q_s32(left + i);
+		v.val[1] = vld1q_s32(right + i);
+		vst2q_s32(dest, v);
+	}
+
+	return n;
+}
+
+static size_t
+FlacImportMonoSimd(int16_t *dest, const FLAC__int32 *src,
+		   size_t n_frames) noexcept
+{
+	const size_t n = n_frames & ~size_t(7);
+
+	for (size_t i = 0; i != n; i += 8, dest += 8)
+		vst1q_s16(dest, vcombine_s16(vmovn_s32(vld1q_s32(src + i)),
+					     vmovn_s32(vld1q_s32(src + i + 4))));
+
+	return n;
+}
+
+#endif
+
+/**
+ * Fallback for sample formats without a vectorized kernel.
+ */
+template<typename T>
+static constexpr size_t
+FlacImportStereoSimd(T *, const FLAC__int32 *, const FLAC__int32 *,
+		     size_t) noexcept
+{
+	return 0;
+}
+
+template<typename T>
+static constexpr size_t
+FlacImportMonoSimd(T *, const FLAC__int32 *, size_t) noexcept
+{
+	return 0;
+}
+
 template<typename T>
 static void
-FlacImportStereo(T *dest, const FLAC__int32 *const src[], size_t n_frames)
+FlacImportStereo(T *dest, const FLAC__int32 *left, const FLAC__int32 *right,
+		 size_t n_frames) noexcept
 {
-	for (size_t i = 0; i != n_frames; ++i) {
-		*dest++ = (T)src[0][i];
-		*dest++ = (T)src[1][i];
+	const size_t n = FlacImportStereoSimd(dest, left, right, n_frames);
+	dest += 2 * n;
+
+	for (size_t i = n; i != n_frames; ++i) {
+		*dest++ = (T)left[i];
+		*dest++ = (T)right[i];
 	}
 }
 
 template<typename T>
 static void
-FlacImportAny(T *dest, const FLAC__int32 *const src[], size_t n_frames,
-	      unsigned n_channels)
+FlacImportMono(T *dest, const FLAC__int32 *src, size_t n_frames) noexcept
 {
-	for (size_t i = 0; i != n_frames; ++i)
-		for (unsigned c = 0; c != n_channels; ++c)
-			*dest++ = src[c][i];
+	const size_t n = FlacImportMonoSimd(dest, src, n_frames);
+	dest += n;
+
+	for (size_t i = n; i != n_frames; ++i)
+		*dest++ = (T)src[i];
 }
 
 template<typename T>
 static void
-FlacImport(T *dest, const FLAC__int32 *const src[], size_t n_frames,
-	   unsigned n_channels)
+FlacImportAny(T *dest, const FLAC__int32 *const src[], size_t offset,
+	      size_t n_frames, unsigned n_channels) noexcept
 {
-	if (n_channels == 2)
-		FlacImportStereo(dest, src, n_frames);
-	else
-		FlacImportAny(dest, src, n_frames, n_channels);
+	for (size_t i = offset, end = offset + n_frames; i != end; ++i)
+		for (unsigned c = 0; c != n_channels; ++c)
+			*dest++ = src[c][i];
 }
 
 template<typename T>
-static ConstBuffer<void>
-FlacImport(PcmBuffer &buffer, const FLAC__int32 *const src[], size_t n_frames,
-	   unsigned n_channels)
+static void
+FlacImport(T *dest, const FLAC__int32 *const src[], size_t offset,
+	   size_t n_frames, unsigned n_channels) noexcept
 {
-	size_t n_samples = n_frames * n_channels;
-	size_t dest_size = n_samples * sizeof(T);
-	T *dest = (T *)buffer.Get(dest_size);
-	FlacImport(dest, src, n_frames, n_channels);
-	return {dest, dest_size};
+	if (n_channels == 2)
+		FlacImportStereo(dest, src[0] + offset, src[1] + offset,
+				 n_frames);
+	else if (n_channels == 1)
+		FlacImportMono(dest, src[0] + offset, n_frames);
+	else
+		FlacImportAny(dest, src, offset, n_frames, n_channels);
 }
 
-ConstBuffer<void>
-FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames)
+void
+FlacPcmImport::ImportTo(void *dest, const FLAC__int32 *const src[],
+			size_t offset, size_t n_frames) const noexcept
 {
 	switch (audio_format.format) {
 	case SampleFormat::S16:
-		return FlacImport<int16_t>(buffer, src, n_frames,
-					   audio_format.channels);
+		FlacImport((int16_t *)dest, src, offset, n_frames,
+			   audio_format.channels);
+		return;
 
 	case SampleFormat::S24_P32:
 	case SampleFormat::S32:
-		return FlacImport<int32_t>(buffer, src, n_frames,
-					   audio_format.channels);
+		FlacImport((int32_t *)dest, src, offset, n_frames,
+			   audio_format.channels);
+		return;
 
 	case SampleFormat::S8:
-		return FlacImport<int8_t>(buffer, src, n_frames,
-					  audio_format.channels);
+		FlacImport((int8_t *)dest, src, offset, n_frames,
+			   audio_format.channels);
+		return;
 
 	case SampleFormat::FLOAT:
 	case SampleFormat::DSD:
@@ -106,3 +257,19 @@ FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames)
 	assert(false);
 	gcc_unreachable();
 }
+
+ConstBuffer<void>
+FlacPcmImport::Import(const FLAC__int32 *const src[], size_t offset,
+		      size_t n_frames) noexcept
+{
+	const size_t size = n_frames * audio_format.GetFrameSize();
+	void *dest = buffer.Get(size);
+	ImportTo(dest, src, offset, n_frames);
+	return {dest, size};
+}
+
+ConstBuffer<void>
+FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames) noexcept
+{
+	return Import(src, 0, n_frames);
+}
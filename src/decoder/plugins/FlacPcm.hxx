@@ -48,7 +48,22 @@ public:
 	}
 
 	ConstBuffer<void> Import(const FLAC__int32 *const src[],
-				 size_t n_frames);
+				 size_t n_frames) noexcept;
+
+	/**
+	 * Import frames beginning at the given offset into the
+	 * internal buffer.
+	 */
+	ConstBuffer<void> Import(const FLAC__int32 *const src[],
+				 size_t offset, size_t n_frames) noexcept;
+
+	/**
+	 * Import frames beginning at the given offset into a caller
+	 * provided buffer, which must be large enough for @a n_frames
+	 * frames in the format returned by GetAudioFormat().
+	 */
+	void ImportTo(void *dest, const FLAC__int32 *const src[],
+		      size_t offset, size_t n_frames) const noexcept;
 };
 
 #endif
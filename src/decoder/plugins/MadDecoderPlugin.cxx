@@ -20,6 +20,7 @@
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndexCache.hxx"
 #include "input/InputStream.hxx"
 #include "config/Block.hxx"
 #include "tag/Id3Scan.hxx"
@@ -49,6 +50,11 @@
 
 static constexpr unsigned long FRAMES_CUSHION = 2000;
 
+/**
+ * Record a frame in the #SeekIndexCache at this interval.
+ */
+static constexpr SongTime SEEK_INDEX_INTERVAL = SongTime::FromMS(1000);
+
 enum mp3_action {
 	DECODE_SKIP = -3,
 	DECODE_BREAK = -2,
@@ -71,6 +77,21 @@ static constexpr Domain mad_domain("mad");
 
 static bool gapless_playback;
 
+/**
+ * Pass floating point samples to the MPD core instead of quantizing
+ * them to 24 bit integers?
+ */
+static bool float_output;
+
+gcc_pure
+static SampleFormat
+GetSampleFormat() noexcept
+{
+	return float_output
+		? SampleFormat::FLOAT
+		: SampleFormat::S24_P32;
+}
+
 gcc_const
 static SongTime
 ToSongTime(mad_timer_t t) noexcept
@@ -108,11 +129,26 @@ mad_fixed_to_24_buffer(int32_t *dest, const struct mad_synth *synth,
 			*dest++ = mad_fixed_to_24_sample(synth->pcm.samples[c][i]);
 }
 
+static void
+mad_fixed_to_float_buffer(float *dest, const struct mad_synth *synth,
+			  unsigned int start, unsigned int end,
+			  unsigned int num_channels)
+{
+	/* no clipping here; values beyond 1.0 are clipped when
+	   they get converted to integers (if ever) */
+	static constexpr float factor = 1.0f / MAD_F_ONE;
+
+	for (unsigned i = start; i < end; ++i)
+		for (unsigned c = 0; c < num_channels; ++c)
+			*dest++ = synth->pcm.samples[c][i] * factor;
+}
+
 static bool
 mp3_plugin_init(const ConfigBlock &block)
 {
 	gapless_playback = block.GetBlockValue("gapless",
 					       DEFAULT_GAPLESS_MP3_PLAYBACK);
+	float_output = block.GetBlockValue("float", false);
 	return true;
 }
 
@@ -125,7 +161,18 @@ struct MadDecoder {
 	struct mad_synth synth;
 	mad_timer_t timer;
 	unsigned char input_buffer[READ_BUFFER_SIZE];
-	int32_t output_buffer[MP3_DATA_OUTPUT_BUFFER_SIZE];
+
+	/**
+	 * The samples passed to DecoderClient::SubmitData(), in the
+	 * format returned by GetSampleFormat().
+	 */
+	union {
+		int32_t s24[MP3_DATA_OUTPUT_BUFFER_SIZE];
+		float f[MP3_DATA_OUTPUT_BUFFER_SIZE];
+	} output_buffer;
+
+	static_assert(sizeof(float) == sizeof(int32_t),
+		      "Unexpected float size");
 	SignedSongTime total_time;
 	SongTime elapsed_time;
 	SongTime seek_time;
@@ -142,6 +189,30 @@ struct MadDecoder {
 	bool found_replay_gain = false;
 	bool found_first_frame = false;
 	bool decoded_first_frame = false;
+
+	/**
+	 * Record frames for the #SeekIndexCache?
+	 */
+	bool seek_indexing = false;
+
+	/**
+	 * The persistent seek index loaded from the #SeekIndexCache.
+	 * It is used for seeking beyond #highest_frame.
+	 */
+	SeekIndexCache::Index seek_index;
+
+	/**
+	 * Frames recorded while playing, to be added to the
+	 * #SeekIndexCache.
+	 */
+	SeekIndexCache::Index new_seek_points;
+
+	/**
+	 * The next frame starting at or after this time will be
+	 * added to #new_seek_points.
+	 */
+	SongTime next_seek_point_time = SongTime::zero();
+
 	unsigned long bit_rate;
 	DecoderClient *const client;
 	InputStream &input_stream;
@@ -181,6 +252,27 @@ struct MadDecoder {
 	gcc_pure
 	long TimeToFrame(SongTime t) const noexcept;
 
+	/**
+	 * Load the #SeekIndexCache entry of this stream, and start
+	 * recording frames for it.
+	 */
+	void LoadSeekIndex() noexcept;
+
+	/**
+	 * Add the frames recorded while playing to the
+	 * #SeekIndexCache.
+	 */
+	void SaveSeekIndex() noexcept;
+
+	/**
+	 * Jump to the nearest known frame beyond #highest_frame with
+	 * the help of #seek_index.
+	 *
+	 * @return false if there is no such frame or if seeking has
+	 * failed
+	 */
+	bool SeekIndexed(SongTime t) noexcept;
+
 	void UpdateTimerNextFrame();
 
 	/**
@@ -791,10 +883,78 @@ MadDecoder::TimeToFrame(SongTime t) const noexcept
 	return i;
 }
 
+inline void
+MadDecoder::LoadSeekIndex() noexcept
+{
+	if (seek_index_cache == nullptr ||
+	    !SeekIndexCache::CanIndex(input_stream))
+		return;
+
+	seek_indexing = true;
+	seek_index = seek_index_cache->Get(input_stream);
+}
+
+inline void
+MadDecoder::SaveSeekIndex() noexcept
+{
+	if (seek_indexing && !new_seek_points.empty())
+		seek_index_cache->Add(input_stream,
+				      std::move(new_seek_points));
+}
+
+inline bool
+MadDecoder::SeekIndexed(SongTime t) noexcept
+{
+	const auto *p = SeekIndexCache::Find(seek_index, t);
+	if (p == nullptr || p->position <= highest_frame ||
+	    p->position >= max_frames)
+		/* the in-memory tables are just as good */
+		return false;
+
+	if (!Seek(p->offset))
+		return false;
+
+	current_frame = p->position;
+	const auto ms = p->time.ToMS();
+	mad_timer_set(&timer, ms / 1000, ms % 1000, 1000);
+	elapsed_time = p->time;
+	next_seek_point_time = p->time;
+
+	if (p->time < t) {
+		/* skip the remaining frames */
+		seek_time = t;
+		mute_frame = MUTEFRAME_SEEK;
+	}
+
+	return true;
+}
+
 void
 MadDecoder::UpdateTimerNextFrame()
 {
-	if (current_frame >= highest_frame) {
+	if (seek_indexing && current_frame >= highest_frame &&
+	    elapsed_time >= next_seek_point_time) {
+		/* record this frame for the persistent seek index;
+		   "elapsed_time" is still the start time of this
+		   frame */
+		try {
+			new_seek_points.push_back({current_frame,
+						   ThisFrameOffset(),
+						   elapsed_time});
+		} catch (...) {
+			seek_indexing = false;
+		}
+
+		next_seek_point_time = elapsed_time + SEEK_INDEX_INTERVAL;
+	}
+
+	if (current_frame > highest_frame && current_frame < max_frames) {
+		/* after SeekIndexed(): the frames in between are
+		   unknown, so this one can't be recorded in
+		   frame_offsets */
+		bit_rate = frame.header.bitrate;
+		mad_timer_add(&timer, frame.header.duration);
+	} else if (current_frame >= highest_frame) {
 		/* record this frame's properties in frame_offsets
 		   (for seeking) and times */
 		bit_rate = frame.header.bitrate;
@@ -820,8 +980,7 @@ MadDecoder::UpdateTimerNextFrame()
 DecoderCommand
 MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 {
-	unsigned max_samples = sizeof(output_buffer) /
-		sizeof(output_buffer[0]) /
+	unsigned max_samples = MP3_DATA_OUTPUT_BUFFER_SIZE /
 		MAD_NCHANNELS(&frame.header);
 
 	while (i < pcm_length) {
@@ -831,13 +990,18 @@ MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 
 		i += num_samples;
 
-		mad_fixed_to_24_buffer(output_buffer, &synth,
-				       i - num_samples, i,
-				       MAD_NCHANNELS(&frame.header));
+		if (float_output)
+			mad_fixed_to_float_buffer(output_buffer.f, &synth,
+						  i - num_samples, i,
+						  MAD_NCHANNELS(&frame.header));
+		else
+			mad_fixed_to_24_buffer(output_buffer.s24, &synth,
+					       i - num_samples, i,
+					       MAD_NCHANNELS(&frame.header));
 		num_samples *= MAD_NCHANNELS(&frame.header);
 
-		auto cmd = client->SubmitData(input_stream, output_buffer,
-					      sizeof(output_buffer[0]) * num_samples,
+		auto cmd = client->SubmitData(input_stream, &output_buffer,
+					      sizeof(output_buffer.s24[0]) * num_samples,
 					      bit_rate / 1000);
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
@@ -926,6 +1090,8 @@ MadDecoder::Read()
 					client->CommandFinished();
 				} else
 					client->SeekError();
+			} else if (SeekIndexed(t)) {
+				client->CommandFinished();
 			} else {
 				seek_time = t;
 				mute_frame = MUTEFRAME_SEEK;
@@ -978,9 +1144,10 @@ mp3_decode(DecoderClient &client, InputStream &input_stream)
 	}
 
 	data.AllocateBuffers();
+	data.LoadSeekIndex();
 
 	client.Ready(CheckAudioFormat(data.frame.header.samplerate,
-				      SampleFormat::S24_P32,
+				      GetSampleFormat(),
 				      MAD_NCHANNELS(&data.frame.header)),
 		     input_stream.IsSeekable(),
 		     data.total_time);
@@ -989,6 +1156,8 @@ mp3_decode(DecoderClient &client, InputStream &input_stream)
 		client.SubmitTag(input_stream, std::move(tag));
 
 	while (data.Read()) {}
+
+	data.SaveSeekIndex();
 }
 
 static bool
@@ -1003,7 +1172,7 @@ mad_decoder_scan_stream(InputStream &is, TagHandler &handler) noexcept
 
 	try {
 		handler.OnAudioFormat(CheckAudioFormat(data.frame.header.samplerate,
-						       SampleFormat::S24_P32,
+						       GetSampleFormat(),
 						       MAD_NCHANNELS(&data.frame.header)));
 	} catch (...) {
 	}
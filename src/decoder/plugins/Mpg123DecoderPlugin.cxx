@@ -36,11 +36,19 @@
 
 static constexpr Domain mpg123_domain("mpg123");
 
+/**
+ * Let libmpg123 generate floating point samples instead of 16 bit
+ * integers?
+ */
+static bool mpg123_float_output;
+
 static bool
-mpd_mpg123_init(gcc_unused const ConfigBlock &block)
+mpd_mpg123_init(const ConfigBlock &block)
 {
 	mpg123_init();
 
+	mpg123_float_output = block.GetBlockValue("float", false);
+
 	return true;
 }
 
@@ -50,6 +58,17 @@ mpd_mpg123_finish() noexcept
 	mpg123_exit();
 }
 
+/**
+ * Let libmpg123 generate floating point samples.  This fails if it
+ * was built without floating point support; it generates 16 bit
+ * integers then.
+ */
+static int
+mpd_mpg123_enable_float(mpg123_handle *handle) noexcept
+{
+	return mpg123_param(handle, MPG123_ADD_FLAGS, MPG123_FORCE_FLOAT, 0);
+}
+
 /**
  * Opens a file with an existing #mpg123_handle.
  *
@@ -83,15 +102,25 @@ mpd_mpg123_open(mpg123_handle *handle, const char *path_fs,
 		return false;
 	}
 
-	if (encoding != MPG123_ENC_SIGNED_16) {
+	SampleFormat sample_format;
+	switch (encoding) {
+	case MPG123_ENC_SIGNED_16:
+		sample_format = SampleFormat::S16;
+		break;
+
+	case MPG123_ENC_FLOAT_32:
+		sample_format = SampleFormat::FLOAT;
+		break;
+
+	default:
 		/* other formats not yet implemented */
 		FormatWarning(mpg123_domain,
-			      "expected MPG123_ENC_SIGNED_16, got %d",
+			      "unsupported encoding %d",
 			      encoding);
 		return false;
 	}
 
-	audio_format = CheckAudioFormat(rate, SampleFormat::S16, channels);
+	audio_format = CheckAudioFormat(rate, sample_format, channels);
 	return true;
 }
 
@@ -195,6 +224,14 @@ mpd_mpg123_file_decode(DecoderClient &client, Path path_fs)
 
 	AtScopeExit(handle) { mpg123_delete(handle); };
 
+	if (mpg123_float_output) {
+		error = mpd_mpg123_enable_float(handle);
+		if (error != MPG123_OK)
+			FormatWarning(mpg123_domain,
+				      "Failed to enable floating point output: %s",
+				      mpg123_plain_strerror(error));
+	}
+
 	AudioFormat audio_format;
 	if (!mpd_mpg123_open(handle, path_fs.c_str(), audio_format))
 		return;
@@ -285,6 +322,11 @@ mpd_mpg123_scan_file(Path path_fs, TagHandler &handler) noexcept
 
 	AtScopeExit(handle) { mpg123_delete(handle); };
 
+	/* report the same format as mpd_mpg123_file_decode()
+	   would */
+	if (mpg123_float_output)
+		mpd_mpg123_enable_float(handle);
+
 	AudioFormat audio_format;
 	try {
 		if (!mpd_mpg123_open(handle, path_fs.c_str(), audio_format)) {
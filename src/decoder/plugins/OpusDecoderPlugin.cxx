@@ -44,8 +44,8 @@ namespace {
 static constexpr opus_int32 opus_sample_rate = 48000;
 
 /**
- * Allocate an output buffer for 16 bit PCM samples big enough to hold
- * a quarter second, larger than 120ms required by libopus.
+ * Allocate an output buffer for PCM samples big enough to hold a
+ * quarter second, larger than 120ms required by libopus.
  */
 static constexpr unsigned opus_output_buffer_frames = opus_sample_rate / 4;
 
@@ -63,11 +63,19 @@ IsOpusTags(const ogg_packet &packet) noexcept
 	return packet.bytes >= 8 && memcmp(packet.packet, "OpusTags", 8) == 0;
 }
 
+/**
+ * Decode to floating point samples (opus_decode_float()) instead of
+ * 16 bit integers?
+ */
+static bool opus_float_output;
+
 static bool
-mpd_opus_init(gcc_unused const ConfigBlock &block)
+mpd_opus_init(const ConfigBlock &block)
 {
 	LogDebug(opus_domain, opus_get_version_string());
 
+	opus_float_output = block.GetBlockValue("float", false);
+
 	return true;
 }
 
@@ -75,6 +83,12 @@ class MPDOpusDecoder final : public OggDecoder {
 	OpusDecoder *opus_decoder = nullptr;
 	opus_int16 *output_buffer = nullptr;
 
+	/**
+	 * Used instead of #output_buffer if #opus_float_output is
+	 * enabled.
+	 */
+	float *float_output_buffer = nullptr;
+
 	/**
 	 * If non-zero, then a previous Opus stream has been found
 	 * already with this number of channels.  If opus_decoder is
@@ -114,6 +128,7 @@ protected:
 MPDOpusDecoder::~MPDOpusDecoder()
 {
 	delete[] output_buffer;
+	delete[] float_output_buffer;
 
 	if (opus_decoder != nullptr)
 		opus_decoder_destroy(opus_decoder);
@@ -173,12 +188,19 @@ MPDOpusDecoder::OnOggBeginning(const ogg_packet &packet)
 
 	previous_channels = channels;
 	const AudioFormat audio_format(opus_sample_rate,
-				       SampleFormat::S16, channels);
+				       opus_float_output
+				       ? SampleFormat::FLOAT
+				       : SampleFormat::S16,
+				       channels);
 	client.Ready(audio_format, eos_granulepos > 0, duration);
 	frame_size = audio_format.GetFrameSize();
 
-	output_buffer = new opus_int16[opus_output_buffer_frames
-				       * audio_format.channels];
+	if (opus_float_output)
+		float_output_buffer = new float[opus_output_buffer_frames
+						* audio_format.channels];
+	else
+		output_buffer = new opus_int16[opus_output_buffer_frames
+					       * audio_format.channels];
 
 	auto cmd = client.GetCommand();
 	if (cmd != DecoderCommand::NONE)
@@ -191,7 +213,8 @@ MPDOpusDecoder::OnOggEnd()
 	if (!IsSeekable() && IsInitialized()) {
 		/* allow chaining of (unseekable) streams */
 		assert(opus_decoder != nullptr);
-		assert(output_buffer != nullptr);
+		assert(output_buffer != nullptr ||
+		       float_output_buffer != nullptr);
 
 		opus_decoder_destroy(opus_decoder);
 		opus_decoder = nullptr;
@@ -224,11 +247,25 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 {
 	assert(opus_decoder != nullptr);
 
-	int nframes = opus_decode(opus_decoder,
-				  (const unsigned char*)packet.packet,
-				  packet.bytes,
-				  output_buffer, opus_output_buffer_frames,
-				  0);
+	const void *data;
+	int nframes;
+	if (float_output_buffer != nullptr) {
+		data = float_output_buffer;
+		nframes = opus_decode_float(opus_decoder,
+					    (const unsigned char*)packet.packet,
+					    packet.bytes,
+					    float_output_buffer,
+					    opus_output_buffer_frames,
+					    0);
+	} else {
+		data = output_buffer;
+		nframes = opus_decode(opus_decoder,
+				      (const unsigned char*)packet.packet,
+				      packet.bytes,
+				      output_buffer, opus_output_buffer_frames,
+				      0);
+	}
+
 	if (nframes < 0)
 		throw FormatRuntimeError("libopus error: %s",
 					 opus_strerror(nframes));
@@ -236,7 +273,7 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 	if (nframes > 0) {
 		const size_t nbytes = nframes * frame_size;
 		auto cmd = client.SubmitData(input_stream,
-					     output_buffer, nbytes,
+					     data, nbytes,
 					     0);
 		if (cmd != DecoderCommand::NONE)
 			throw cmd;
@@ -355,7 +392,10 @@ mpd_opus_scan_stream(InputStream &is, TagHandler &handler) noexcept
 		return false;
 
 	handler.OnAudioFormat(AudioFormat(opus_sample_rate,
-					  SampleFormat::S16, channels));
+					  opus_float_output
+					  ? SampleFormat::FLOAT
+					  : SampleFormat::S16,
+					  channels));
 
 	VisitOpusDuration(is, oy, os, handler);
 	return true;
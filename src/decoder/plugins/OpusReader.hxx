@@ -20,7 +20,7 @@
 #ifndef MPD_OPUS_READER_HXX
 #define MPD_OPUS_READER_HXX
 
-#include <algorithm>
+#include "util/StringView.hxx"
 
 #include <stdint.h>
 #include <string.h>
@@ -81,7 +81,11 @@ public:
 		return ReadWord(length) && Skip(length);
 	}
 
-	char *ReadString() {
+	/**
+	 * Read a length-prefixed string.  The returned #StringView
+	 * points into the packet; it is not null-terminated.
+	 */
+	StringView ReadString() {
 		uint32_t length;
 		if (!ReadWord(length) || length >= 65536)
 			return nullptr;
@@ -90,9 +94,7 @@ public:
 		if (src == nullptr)
 			return nullptr;
 
-		char *dest = new char[length + 1];
-		*std::copy_n(src, length, dest) = 0;
-		return dest;
+		return {src, length};
 	}
 };
 
@@ -30,7 +30,7 @@
 
 gcc_pure
 static TagType
-ParseOpusTagName(const char *name) noexcept
+ParseOpusTagName(StringView name) noexcept
 {
 	TagType type = tag_name_parse_i(name);
 	if (type != TAG_NUM_OF_ITEM_TYPES)
@@ -39,28 +39,37 @@ ParseOpusTagName(const char *name) noexcept
 	return tag_table_lookup_i(xiph_tags, name);
 }
 
+/**
+ * Parse a Q7.8 fixed point number in dB.
+ */
+static bool
+ParseQ78(StringView _value, float &gain_r) noexcept
+{
+	char value[16];
+	if (_value.size >= sizeof(value))
+		return false;
+
+	memcpy(value, _value.data, _value.size);
+	value[_value.size] = 0;
+
+	char *endptr;
+	long l = strtol(value, &endptr, 10);
+	if (endptr == value || *endptr != 0)
+		return false;
+
+	gain_r = double(l) / 256.;
+	return true;
+}
+
 static void
-ScanOneOpusTag(const char *name, const char *value,
+ScanOneOpusTag(StringView name, StringView value,
 	       ReplayGainInfo *rgi,
 	       TagHandler &handler) noexcept
 {
-	if (rgi != nullptr && strcmp(name, "R128_TRACK_GAIN") == 0) {
-		/* R128_TRACK_GAIN is a Q7.8 fixed point number in
-		   dB */
-
-		char *endptr;
-		long l = strtol(value, &endptr, 10);
-		if (endptr > value && *endptr == 0)
-			rgi->track.gain = double(l) / 256.;
-	} else if (rgi != nullptr && strcmp(name, "R128_ALBUM_GAIN") == 0) {
-		/* R128_ALBUM_GAIN is a Q7.8 fixed point number in
-		   dB */
-
-		char *endptr;
-		long l = strtol(value, &endptr, 10);
-		if (endptr > value && *endptr == 0)
-			rgi->album.gain = double(l) / 256.;
-	}
+	if (rgi != nullptr && name.Equals("R128_TRACK_GAIN"))
+		ParseQ78(value, rgi->track.gain);
+	else if (rgi != nullptr && name.Equals("R128_ALBUM_GAIN"))
+		ParseQ78(value, rgi->album.gain);
 
 	handler.OnPair(name, value);
 
@@ -91,18 +100,15 @@ ScanOpusTags(const void *data, size_t size,
 		return false;
 
 	while (n-- > 0) {
-		char *p = r.ReadString();
-		if (p == nullptr)
+		const StringView comment = r.ReadString();
+		if (comment.IsNull())
 			return false;
 
-		char *eq = strchr(p, '=');
-		if (eq != nullptr && eq > p) {
-			*eq = 0;
-
-			ScanOneOpusTag(p, eq + 1, rgi, handler);
-		}
-
-		delete[] p;
+		const char *eq = comment.Find('=');
+		if (eq != nullptr && eq > comment.data)
+			ScanOneOpusTag({comment.data, eq},
+				       {eq + 1, comment.end()},
+				       rgi, handler);
 	}
 
 	return true;
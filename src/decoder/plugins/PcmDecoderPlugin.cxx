@@ -21,10 +21,10 @@
 #include "../DecoderAPI.hxx"
 #include "CheckAudioFormat.hxx"
 #include "pcm/PcmPack.hxx"
+#include "pcm/ReverseEndian.hxx"
 #include "input/InputStream.hxx"
 #include "system/ByteOrder.hxx"
 #include "util/Domain.hxx"
-#include "util/ByteReverse.hxx"
 #include "util/StaticFifoBuffer.hxx"
 #include "util/NumberParser.hxx"
 #include "util/MimeType.hxx"
@@ -54,6 +54,26 @@ FillBuffer(DecoderClient &client, InputStream &is, B &buffer)
 	return true;
 }
 
+template<typename B>
+static DecoderCommand
+HandleSeek(DecoderClient &client, InputStream &is, B &buffer,
+	   size_t in_frame_size)
+{
+	uint64_t frame = client.GetSeekFrame();
+	offset_type offset = frame * in_frame_size;
+
+	try {
+		is.LockSeek(offset);
+		buffer.Clear();
+		client.CommandFinished();
+	} catch (...) {
+		LogError(std::current_exception());
+		client.SeekError();
+	}
+
+	return DecoderCommand::NONE;
+}
+
 static void
 pcm_stream_decode(DecoderClient &client, InputStream &is)
 {
@@ -158,8 +178,28 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 	   results for a full source buffer */
 	int32_t unpack_buffer[buffer.GetCapacity() / 3];
 
+	/* can the samples be submitted straight from the
+	   InputStream's memory (see InputStream::Peek())? */
+	const bool direct = !reverse_endian && !l24;
+
 	DecoderCommand cmd;
 	do {
+		if (direct && buffer.empty()) {
+			auto r = ConstBuffer<uint8_t>::FromVoid(is.LockPeek());
+			if (r.size > 16384)
+				r.size = 16384;
+			r.size -= r.size % in_frame_size;
+
+			if (!r.empty()) {
+				cmd = client.SubmitData(is, r.data, r.size, 0);
+				is.LockConsume(r.size);
+				if (cmd == DecoderCommand::SEEK)
+					cmd = HandleSeek(client, is, buffer,
+							 in_frame_size);
+				continue;
+			}
+		}
+
 		if (!FillBuffer(client, is, buffer))
 			break;
 
@@ -172,9 +212,7 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 
 		if (reverse_endian)
 			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)r.data,
-					 (uint16_t *)r.data,
-					 (uint16_t *)(r.data + r.size));
+			PcmReverseEndian(r.data, r, 2);
 		else if (l24) {
 			/* convert big-endian packed 24 bit
 			   (audio/L24) to native-endian 24 bit (in 32
@@ -187,21 +225,8 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 		cmd = !r.empty()
 			? client.SubmitData(is, r.data, r.size, 0)
 			: client.GetCommand();
-		if (cmd == DecoderCommand::SEEK) {
-			uint64_t frame = client.GetSeekFrame();
-			offset_type offset = frame * in_frame_size;
-
-			try {
-				is.LockSeek(offset);
-				buffer.Clear();
-				client.CommandFinished();
-			} catch (...) {
-				LogError(std::current_exception());
-				client.SeekError();
-			}
-
-			cmd = DecoderCommand::NONE;
-		}
+		if (cmd == DecoderCommand::SEEK)
+			cmd = HandleSeek(client, is, buffer, in_frame_size);
 	} while (cmd == DecoderCommand::NONE);
 }
 
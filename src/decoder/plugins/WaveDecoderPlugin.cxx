@@ -0,0 +1,698 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "WaveDecoderPlugin.hxx"
+#include "../DecoderAPI.hxx"
+#include "CheckAudioFormat.hxx"
+#include "input/InputStream.hxx"
+#include "tag/Riff.hxx"
+#include "tag/Aiff.hxx"
+#include "tag/Handler.hxx"
+#include "tag/Type.h"
+#include "pcm/PcmPack.hxx"
+#include "pcm/ReverseEndian.hxx"
+#include "system/ByteOrder.hxx"
+#include "util/Domain.hxx"
+#include "util/Exception.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain wave_domain("wave");
+
+static constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+static constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+static constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xfffe;
+
+/**
+ * The "fmt " chunk of a WAV file.
+ */
+struct WaveFmt {
+	uint16_t format_tag;
+	uint16_t channels;
+	uint32_t sample_rate;
+	uint32_t byte_rate;
+	uint16_t block_align;
+	uint16_t bits_per_sample;
+};
+
+static_assert(sizeof(WaveFmt) == 16, "Wrong size");
+
+/**
+ * The #WAVE_FORMAT_EXTENSIBLE extension of #WaveFmt.
+ */
+struct WaveFmtExtension {
+	uint16_t size;
+	uint16_t valid_bits_per_sample;
+	uint32_t channel_mask;
+
+	/**
+	 * A GUID whose first two bytes are the actual format tag.
+	 */
+	uint8_t sub_format[16];
+};
+
+static_assert(sizeof(WaveFmtExtension) == 24, "Wrong size");
+
+/**
+ * Describes the sample data of a WAV or AIFF file.
+ */
+struct WaveInfo {
+	AudioFormat audio_format;
+
+	/**
+	 * The size of one sample in the file.  This is 3 for packed
+	 * 24 bit samples, which are unpacked to
+	 * SampleFormat::S24_P32.
+	 */
+	unsigned sample_size;
+
+	bool big_endian;
+
+	/**
+	 * Is this an AIFF file (and not WAV)?
+	 */
+	bool aiff;
+
+	/**
+	 * The position of the first sample in the #InputStream.
+	 */
+	offset_type data_offset;
+
+	/**
+	 * The number of frames in the data chunk.
+	 */
+	uint64_t n_frames;
+
+	size_t GetInFrameSize() const noexcept {
+		return sample_size * audio_format.channels;
+	}
+
+	bool IsPacked24() const noexcept {
+		return sample_size == 3;
+	}
+
+	/**
+	 * Must the bytes of each sample be swapped?
+	 */
+	bool IsReverseEndian() const noexcept {
+		return sample_size > 1 && big_endian != IsBigEndian();
+	}
+
+	gcc_pure
+	SongTime GetDuration() const noexcept {
+		return SongTime::FromScale<uint64_t>(n_frames,
+						     audio_format.sample_rate);
+	}
+};
+
+/**
+ * Skip the rest of a chunk, including the pad byte.
+ */
+static void
+SkipChunkRest(InputStream &is, size_t size, size_t consumed)
+{
+	size_t rest = size - consumed;
+	if (size % 2 != 0)
+		++rest;
+
+	if (rest > 0)
+		is.Skip(rest);
+}
+
+/**
+ * Determine the number of frames in the data chunk, which begins at
+ * the current position.  Bogus chunk sizes (e.g. written by a
+ * streaming encoder which did not know the final size) are clipped
+ * to the stream size.
+ */
+static uint64_t
+GetDataFrames(const InputStream &is, uint64_t size, size_t frame_size)
+{
+	if (is.KnownSize()) {
+		const uint64_t available = is.GetSize() > is.GetOffset()
+			? is.GetSize() - is.GetOffset()
+			: 0;
+		if (size > available)
+			size = available;
+	}
+
+	return size / frame_size;
+}
+
+/**
+ * Parse a WAV file.
+ *
+ * Throws on error.
+ *
+ * @param is a locked #InputStream
+ * @return false if the sample format is not supported by this plugin
+ */
+static bool
+ParseWave(InputStream &is, WaveInfo &info)
+{
+	riff_read_header(is, "WAVE");
+
+	const size_t fmt_size = riff_seek_chunk(is, "fmt ");
+	if (fmt_size < sizeof(WaveFmt))
+		throw std::runtime_error("Malformed fmt chunk");
+
+	WaveFmt fmt;
+	is.ReadFull(&fmt, sizeof(fmt));
+	size_t consumed = sizeof(fmt);
+
+	uint16_t format_tag = FromLE16(fmt.format_tag);
+	if (format_tag == WAVE_FORMAT_EXTENSIBLE &&
+	    fmt_size >= sizeof(fmt) + sizeof(WaveFmtExtension)) {
+		WaveFmtExtension ext;
+		is.ReadFull(&ext, sizeof(ext));
+		consumed += sizeof(ext);
+
+		format_tag = ext.sub_format[0] | (ext.sub_format[1] << 8);
+	}
+
+	SkipChunkRest(is, fmt_size, consumed);
+
+	const unsigned channels = FromLE16(fmt.channels);
+	const unsigned bits = FromLE16(fmt.bits_per_sample);
+	if (channels == 0)
+		throw std::runtime_error("Malformed fmt chunk");
+
+	info.sample_size = FromLE16(fmt.block_align) / channels;
+	info.big_endian = false;
+	info.aiff = false;
+
+	SampleFormat format;
+	if (format_tag == WAVE_FORMAT_PCM) {
+		if (bits <= 8)
+			/* unsigned 8 bit samples */
+			return false;
+
+		if (info.sample_size == 2 && bits <= 16)
+			format = SampleFormat::S16;
+		else if (info.sample_size == 3 && bits <= 24 &&
+			 IsLittleEndian())
+			format = SampleFormat::S24_P32;
+		else if (info.sample_size == 4 && bits <= 32)
+			/* the samples are left-aligned */
+			format = SampleFormat::S32;
+		else
+			return false;
+	} else if (format_tag == WAVE_FORMAT_IEEE_FLOAT &&
+		   info.sample_size == 4 && bits == 32) {
+		format = SampleFormat::FLOAT;
+	} else
+		return false;
+
+	info.audio_format = CheckAudioFormat(FromLE32(fmt.sample_rate),
+					     format, channels);
+
+	const size_t data_size = riff_seek_chunk(is, "data");
+	info.data_offset = is.GetOffset();
+	info.n_frames = GetDataFrames(is, data_size, info.GetInFrameSize());
+	return true;
+}
+
+/**
+ * Convert an 80 bit IEEE 754 extended precision number (the AIFF
+ * sample rate) to an integer.
+ *
+ * @return the integer value or 0 if it is out of range
+ */
+gcc_pure
+static unsigned
+ParseExtended(const uint8_t *p) noexcept
+{
+	if (p[0] & 0x80)
+		/* negative */
+		return 0;
+
+	const unsigned exponent = (p[0] << 8) | p[1];
+
+	uint64_t mantissa;
+	memcpy(&mantissa, p + 2, sizeof(mantissa));
+	mantissa = FromBE64(mantissa);
+
+	constexpr unsigned bias = 16383;
+	if (exponent < bias || exponent > bias + 31)
+		return 0;
+
+	return mantissa >> (bias + 63 - exponent);
+}
+
+/**
+ * Parse an AIFF or AIFF-C file.
+ *
+ * Throws on error.
+ *
+ * @param is a locked #InputStream
+ * @return false if the sample format is not supported by this plugin
+ */
+static bool
+ParseAiff(InputStream &is, WaveInfo &info)
+{
+	const bool aifc = aiff_read_header(is);
+
+	const size_t comm_size = aiff_seek_chunk(is, "COMM");
+
+	/* channels (16 bit), frames (32 bit), bits per sample (16
+	   bit), sample rate (80 bit) and the AIFF-C compression
+	   type */
+	uint8_t comm[22];
+	const size_t comm_min_size = aifc ? 22 : 18;
+	if (comm_size < comm_min_size)
+		throw std::runtime_error("Malformed COMM chunk");
+
+	is.ReadFull(comm, comm_min_size);
+	SkipChunkRest(is, comm_size, comm_min_size);
+
+	const unsigned channels = (comm[0] << 8) | comm[1];
+	const unsigned bits = (comm[6] << 8) | comm[7];
+	const unsigned sample_rate = ParseExtended(comm + 8);
+
+	info.big_endian = true;
+	info.aiff = true;
+
+	bool is_float = false;
+	if (aifc) {
+		const char *compression = (const char *)comm + 18;
+		if (memcmp(compression, "sowt", 4) == 0)
+			info.big_endian = false;
+		else if (memcmp(compression, "fl32", 4) == 0 ||
+			 memcmp(compression, "FL32", 4) == 0)
+			is_float = true;
+		else if (memcmp(compression, "NONE", 4) != 0 &&
+			 memcmp(compression, "twos", 4) != 0)
+			return false;
+	}
+
+	/* AIFF samples are left-aligned in whole bytes */
+	info.sample_size = (bits + 7) / 8;
+
+	SampleFormat format;
+	if (is_float) {
+		if (bits != 32)
+			return false;
+
+		format = SampleFormat::FLOAT;
+	} else if (info.sample_size == 1)
+		format = SampleFormat::S8;
+	else if (info.sample_size == 2)
+		format = SampleFormat::S16;
+	else if (info.sample_size == 3 && info.big_endian)
+		format = SampleFormat::S24_P32;
+	else if (info.sample_size == 4)
+		format = SampleFormat::S32;
+	else
+		return false;
+
+	info.audio_format = CheckAudioFormat(sample_rate, format, channels);
+
+	const size_t ssnd_size = aiff_seek_chunk(is, "SSND");
+
+	/* offset and block size (32 bit each) */
+	uint32_t ssnd[2];
+	if (ssnd_size < sizeof(ssnd))
+		throw std::runtime_error("Malformed SSND chunk");
+
+	is.ReadFull(ssnd, sizeof(ssnd));
+
+	const size_t offset = FromBE32(ssnd[0]);
+	if (offset > ssnd_size - sizeof(ssnd))
+		throw std::runtime_error("Malformed SSND chunk");
+
+	if (offset > 0)
+		is.Skip(offset);
+
+	info.data_offset = is.GetOffset();
+	info.n_frames = GetDataFrames(is, ssnd_size - sizeof(ssnd) - offset,
+				      info.GetInFrameSize());
+	return true;
+}
+
+/**
+ * Parse a WAV or AIFF file and leave the #InputStream at the first
+ * sample.
+ *
+ * @return false if the file was not recognized or is not supported
+ * by this plugin
+ */
+static bool
+ParseWaveOrAiff(InputStream &is, WaveInfo &info) noexcept
+try {
+	const std::lock_guard<Mutex> protect(is.mutex);
+
+	try {
+		return ParseWave(is, info);
+	} catch (...) {
+		return ParseAiff(is, info);
+	}
+} catch (...) {
+	FormatDebug(wave_domain, "%s",
+		    GetFullMessage(std::current_exception()).c_str());
+	return false;
+}
+
+/**
+ * Convert samples read from the file to host byte order and to the
+ * #AudioFormat passed to DecoderClient::Ready().  May be in-place
+ * unless the samples need to be unpacked.
+ */
+static void
+ConvertSamples(const WaveInfo &info, uint8_t *dest,
+	       const uint8_t *src, size_t src_size) noexcept
+{
+	if (info.IsPacked24()) {
+		if (info.big_endian)
+			pcm_unpack_24be((int32_t *)dest, src, src + src_size);
+		else
+			pcm_unpack_24((int32_t *)dest, src, src + src_size);
+	} else if (info.IsReverseEndian())
+		PcmReverseEndian(dest, {src, src_size}, info.sample_size);
+}
+
+static void
+wave_decode_data(DecoderClient &client, InputStream &is,
+		 const WaveInfo &info)
+{
+	const size_t out_frame_size = info.audio_format.GetFrameSize();
+	const size_t in_frame_size = info.GetInFrameSize();
+	const uint16_t kbit_rate =
+		info.audio_format.sample_rate * in_frame_size * 8 / 1000;
+
+	/* the file's samples are read into this buffer if they have
+	   to be unpacked */
+	uint8_t packed_buffer[3 * 4096];
+
+	/* used if DecoderClient::GetWriteBuffer() does not provide
+	   a buffer */
+	int32_t fallback_buffer[4096];
+
+	uint64_t frame = 0;
+	auto cmd = client.GetCommand();
+	while (true) {
+		if (cmd == DecoderCommand::SEEK) {
+			const uint64_t where = client.GetSeekFrame();
+			try {
+				if (where > info.n_frames)
+					throw std::runtime_error("Seek beyond end of data");
+
+				is.LockSeek(info.data_offset +
+					    where * in_frame_size);
+				frame = where;
+				client.CommandFinished();
+			} catch (...) {
+				LogError(std::current_exception());
+				client.SeekError();
+			}
+		} else if (cmd != DecoderCommand::NONE)
+			break;
+
+		if (frame >= info.n_frames)
+			break;
+
+		/* if possible, read (and convert) the samples directly
+		   into the MusicChunk */
+		auto dest = client.GetWriteBuffer(&is, kbit_rate);
+		const bool direct = dest.size >= out_frame_size;
+		if (!direct)
+			dest = {fallback_buffer, sizeof(fallback_buffer)};
+
+		size_t n = std::min<uint64_t>(dest.size / out_frame_size,
+					      info.n_frames - frame);
+
+		uint8_t *out = (uint8_t *)dest.data;
+		uint8_t *in = out;
+		if (info.IsPacked24()) {
+			n = std::min(n, sizeof(packed_buffer) / in_frame_size);
+			in = packed_buffer;
+		}
+
+		const size_t in_size = n * in_frame_size;
+		if (!decoder_read_full(&client, is, in, in_size)) {
+			/* end of file or a command was received */
+			cmd = client.GetCommand();
+			if (cmd == DecoderCommand::NONE)
+				break;
+
+			continue;
+		}
+
+		frame += n;
+
+		ConvertSamples(info, out, in, in_size);
+
+		const size_t out_size = n * out_frame_size;
+		cmd = direct
+			? client.CommitData(out_size)
+			: client.SubmitData(is, out, out_size, kbit_rate);
+	}
+}
+
+static void
+wave_stream_decode(DecoderClient &client, InputStream &is)
+{
+	WaveInfo info;
+	if (!ParseWaveOrAiff(is, info))
+		return;
+
+	client.Ready(info.audio_format, is.IsSeekable(), info.GetDuration());
+
+	wave_decode_data(client, is, info);
+}
+
+/**
+ * Maps text chunk ids to tag types: the sub-chunks of a RIFF
+ * "LIST/INFO" chunk, and the AIFF text chunks.
+ */
+struct TextChunkTag {
+	char id[5];
+	TagType type;
+};
+
+static constexpr TextChunkTag riff_info_tags[] = {
+	{ "INAM", TAG_TITLE },
+	{ "IART", TAG_ARTIST },
+	{ "IPRD", TAG_ALBUM },
+	{ "ICMT", TAG_COMMENT },
+	{ "ICRD", TAG_DATE },
+	{ "IGNR", TAG_GENRE },
+	{ "ITRK", TAG_TRACK },
+	{ "IPRT", TAG_TRACK },
+};
+
+static constexpr TextChunkTag aiff_text_tags[] = {
+	{ "NAME", TAG_TITLE },
+	{ "AUTH", TAG_ARTIST },
+	{ "ANNO", TAG_COMMENT },
+};
+
+/**
+ * Text chunks larger than this are ignored.
+ */
+static constexpr size_t MAX_TEXT_CHUNK_SIZE = 4096;
+
+/**
+ * Read the header of the next chunk.
+ *
+ * Throws on error (including end of file).
+ *
+ * @return the size of the chunk
+ */
+static size_t
+ReadChunkHeader(InputStream &is, bool big_endian, char id[4])
+{
+	struct {
+		char id[4];
+		uint32_t size;
+	} header;
+
+	is.ReadFull(&header, sizeof(header));
+	memcpy(id, header.id, 4);
+	return big_endian ? FromBE32(header.size) : FromLE32(header.size);
+}
+
+/**
+ * Read a text chunk (padded and possibly null-terminated) and pass
+ * it to the #TagHandler if its id is in the given table; skip it
+ * otherwise.
+ */
+template<size_t N>
+static void
+ReadTextChunk(InputStream &is, const char *id, size_t size,
+	      const TextChunkTag (&tags)[N], TagHandler &handler)
+{
+	const auto i = std::find_if(std::begin(tags), std::end(tags),
+				    [id](const TextChunkTag &t){
+					    return memcmp(t.id, id, 4) == 0;
+				    });
+	if (i == std::end(tags) || size > MAX_TEXT_CHUNK_SIZE) {
+		SkipChunkRest(is, size, 0);
+		return;
+	}
+
+	char buffer[MAX_TEXT_CHUNK_SIZE];
+	is.ReadFull(buffer, size);
+	SkipChunkRest(is, size, size);
+
+	size_t length = strnlen(buffer, size);
+	while (length > 0 && buffer[length - 1] == ' ')
+		--length;
+
+	if (length > 0)
+		handler.OnTag(i->type, {buffer, length});
+}
+
+/**
+ * Parse the "LIST/INFO" chunks of a WAV file.
+ *
+ * Throws on error; reaching the end of the file is an error, too,
+ * but the tags found until then have already been passed to the
+ * #TagHandler.
+ *
+ * @param is a locked #InputStream
+ */
+static void
+ScanWaveTags(InputStream &is, TagHandler &handler)
+{
+	riff_read_header(is, "WAVE");
+
+	while (true) {
+		char id[4];
+		const size_t size = ReadChunkHeader(is, false, id);
+
+		char list_type[4];
+		if (memcmp(id, "LIST", 4) != 0 || size < sizeof(list_type)) {
+			SkipChunkRest(is, size, 0);
+			continue;
+		}
+
+		is.ReadFull(list_type, sizeof(list_type));
+		if (memcmp(list_type, "INFO", 4) != 0) {
+			SkipChunkRest(is, size, sizeof(list_type));
+			continue;
+		}
+
+		size_t consumed = sizeof(list_type);
+		while (consumed + 8 <= size) {
+			char sub_id[4];
+			const size_t sub_size = ReadChunkHeader(is, false,
+								sub_id);
+			consumed += 8;
+
+			if (sub_size > size - consumed)
+				throw std::runtime_error("Malformed INFO chunk");
+
+			ReadTextChunk(is, sub_id, sub_size,
+				      riff_info_tags, handler);
+			consumed += sub_size + sub_size % 2;
+		}
+
+		if (consumed < size)
+			SkipChunkRest(is, size, consumed);
+	}
+}
+
+/**
+ * Parse the text chunks of an AIFF file.
+ *
+ * Throws on error (see ScanWaveTags()).
+ *
+ * @param is a locked #InputStream
+ */
+static void
+ScanAiffTags(InputStream &is, TagHandler &handler)
+{
+	aiff_read_header(is);
+
+	while (true) {
+		char id[4];
+		const size_t size = ReadChunkHeader(is, true, id);
+		ReadTextChunk(is, id, size, aiff_text_tags, handler);
+	}
+}
+
+/**
+ * Pass the text tags of a WAV or AIFF file to the #TagHandler.  They
+ * may be anywhere in the file (often after the sample data), so this
+ * walks over all chunks.  ID3 chunks are handled by
+ * ScanGenericTags().
+ */
+static void
+ScanTextTags(InputStream &is, bool aiff, TagHandler &handler) noexcept
+try {
+	const std::lock_guard<Mutex> protect(is.mutex);
+
+	if (aiff)
+		ScanAiffTags(is, handler);
+	else
+		ScanWaveTags(is, handler);
+} catch (...) {
+	/* end of file or a malformed chunk; keep the tags we have
+	   found so far */
+}
+
+static bool
+wave_scan_stream(InputStream &is, TagHandler &handler) noexcept
+{
+	WaveInfo info;
+	if (!ParseWaveOrAiff(is, info))
+		return false;
+
+	handler.OnAudioFormat(info.audio_format);
+	handler.OnDuration(info.GetDuration());
+
+	if (handler.WantTag())
+		ScanTextTags(is, info.aiff, handler);
+
+	return true;
+}
+
+static const char *const wave_suffixes[] = {
+	"wav", "wave", "aif", "aiff", "aifc",
+	nullptr
+};
+
+static const char *const wave_mime_types[] = {
+	"audio/wav",
+	"audio/wave",
+	"audio/x-wav",
+	"audio/aiff",
+	"audio/x-aiff",
+	nullptr
+};
+
+const struct DecoderPlugin wave_decoder_plugin = {
+	"wave",
+	nullptr,
+	nullptr,
+	wave_stream_decode,
+	nullptr,
+	nullptr,
+	wave_scan_stream,
+	nullptr,
+	wave_suffixes,
+	wave_mime_types,
+};
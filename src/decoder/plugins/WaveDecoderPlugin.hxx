@@ -0,0 +1,33 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * A decoder plugin for uncompressed WAV and AIFF files, which
+ * passes the samples to the decoder client without a codec library.
+ * Unsupported variants are left to other plugins (e.g. "sndfile").
+ */
+
+#ifndef MPD_DECODER_WAVE_HXX
+#define MPD_DECODER_WAVE_HXX
+
+extern const struct DecoderPlugin wave_decoder_plugin;
+
+#endif
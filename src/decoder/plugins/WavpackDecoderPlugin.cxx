@@ -20,6 +20,7 @@
 #include "config.h"
 #include "WavpackDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../DecoderBuffer.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -281,22 +282,30 @@ wavpack_decode(DecoderClient &client, WavpackContext *wpc, bool can_seek)
 
 /* This struct is needed for per-stream last_byte storage. */
 struct WavpackInput {
-	DecoderClient *const client;
 	InputStream &is;
+
+	/**
+	 * libwavpack reads in small portions; this buffer reduces the
+	 * number of #InputStream calls.
+	 */
+	DecoderBuffer buffer;
+
 	/* Needed for push_back_byte() */
 	int last_byte;
 
-	constexpr WavpackInput(DecoderClient *_client, InputStream &_is)
-		:client(_client), is(_is), last_byte(EOF) {}
+	WavpackInput(DecoderClient *_client, InputStream &_is)
+		:is(_is), buffer(_client, _is, 8192),
+		 last_byte(EOF) {}
 
 	int32_t ReadBytes(void *data, size_t bcount);
 
 	InputStream::offset_type GetPos() const {
-		return is.GetOffset();
+		return buffer.GetOffset();
 	}
 
 	int SetPosAbs(InputStream::offset_type pos) {
 		try {
+			buffer.Clear();
 			is.LockSeek(pos);
 			return 0;
 		} catch (...) {
@@ -311,7 +320,7 @@ struct WavpackInput {
 			break;
 
 		case SEEK_CUR:
-			offset += is.GetOffset();
+			offset += GetPos();
 			break;
 
 		case SEEK_END:
@@ -381,7 +390,7 @@ WavpackInput::ReadBytes(void *data, size_t bcount)
 	/* wavpack fails if we return a partial read, so we just wait
 	   until the buffer is full */
 	while (bcount > 0) {
-		size_t nbytes = decoder_read(client, is, buf, bcount);
+		size_t nbytes = buffer.ReadInto(buf, bcount);
 		if (nbytes == 0) {
 			/* EOF, error or a decoder command */
 			break;
@@ -161,4 +161,5 @@ const struct DecoderPlugin wildmidi_decoder_plugin = {
 	nullptr,
 	wildmidi_suffixes,
 	nullptr,
+	true,
 };
@@ -20,6 +20,8 @@
 #include "Configured.hxx"
 #include "EncoderList.hxx"
 #include "EncoderPlugin.hxx"
+#include "SharedEncoder.hxx"
+#include "ThreadedEncoder.hxx"
 #include "config/Block.hxx"
 #include "util/StringAPI.hxx"
 #include "util/RuntimeError.hxx"
@@ -51,6 +53,19 @@ GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 PreparedEncoder *
 CreateConfiguredEncoder(const ConfigBlock &block, bool shout_legacy)
 {
-	return encoder_init(GetConfiguredEncoderPlugin(block, shout_legacy),
-			    block);
+	auto *encoder =
+		encoder_init(GetConfiguredEncoderPlugin(block, shout_legacy),
+			     block);
+
+	const char *shared = block.GetBlockValue("shared_encoder", nullptr);
+	if (shared != nullptr)
+		encoder = shared_encoder_new(shared, encoder);
+
+	if (block.GetBlockValue("encoder_thread", false))
+		/* outermost, so each output has its own queue even
+		   if the encoder is shared */
+		encoder = threaded_encoder_new(encoder,
+					       block.GetPositiveValue("encoder_queue", 256u) * size_t(1024));
+
+	return encoder;
 }
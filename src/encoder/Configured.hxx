@@ -26,7 +26,10 @@ class PreparedEncoder;
 /**
  * Create a #PreparedEncoder instance from the settings in the
  * #ConfigBlock.  Its "encoder" setting is used to choose the encoder
- * plugin.
+ * plugin.  If "shared_encoder" is set, the encoder is shared with
+ * all other outputs which use the same name (see
+ * shared_encoder_new()).  If "encoder_thread" is enabled, the encoder
+ * runs in a worker thread (see threaded_encoder_new()).
  *
  * Throws an exception on error.
  *
@@ -21,6 +21,7 @@
 #define MPD_ENCODER_INTERFACE_HXX
 
 #include "EncoderPlugin.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <assert.h>
@@ -107,6 +108,29 @@ public:
 	 * @return the number of bytes written to #dest
 	 */
 	virtual size_t Read(void *dest, size_t length) = 0;
+
+	/**
+	 * Obtain a pointer to encoded data in the encoder's internal
+	 * buffer, which may be used instead of Read() to avoid
+	 * copying it.  After using the data, call Consume().
+	 *
+	 * Not all encoders implement this; the default
+	 * implementation returns an empty buffer, and the caller
+	 * needs to fall back to Read().
+	 */
+	virtual ConstBuffer<void> Peek() noexcept {
+		return nullptr;
+	}
+
+	/**
+	 * Remove data which was returned by Peek() from the buffer.
+	 *
+	 * @param nbytes the number of bytes to remove; must not be
+	 * larger than the buffer returned by the last Peek() call
+	 */
+	virtual void Consume(gcc_unused size_t nbytes) noexcept {
+		assert(nbytes == 0);
+	}
 };
 
 class PreparedEncoder {
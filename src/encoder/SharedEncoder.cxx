@@ -0,0 +1,766 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef std::shared_ptr<const AllocatedArray<uint8_t>> SharedBuffer;
+
+namespace {
+
+constexpr Domain shared_encoder_domain("shared_encoder");
+
+/**
+ * An operation on the #Encoder.
+ */
+enum class EncoderOp : uint8_t {
+	/**
+	 * The (re)opened encoder; the output is the stream header.
+	 * This is not a method call.
+	 */
+	OPEN,
+
+	WRITE,
+	FLUSH,
+	PRE_TAG,
+	SEND_TAG,
+	END,
+};
+
+/**
+ * Operations which an instance may skip over if it does not
+ * perform them itself; their output however is part of the stream.
+ * After #EncoderOp::END, the stream continues with the next
+ * #EncoderOp::OPEN.
+ */
+constexpr bool
+IsSkippable(EncoderOp op) noexcept
+{
+	return op == EncoderOp::OPEN || op == EncoderOp::FLUSH ||
+		op == EncoderOp::END;
+}
+
+SharedBuffer
+MakeBuffer(const void *data, size_t size) noexcept
+{
+	auto b = std::make_shared<AllocatedArray<uint8_t>>(size);
+	std::copy_n((const uint8_t *)data, size, b->begin());
+	return b;
+}
+
+/**
+ * Serialize the #Tag for comparisons.
+ */
+std::string
+SerializeTag(const Tag &tag) noexcept
+{
+	std::string result;
+
+	for (const auto &item : tag) {
+		result.push_back(char(item.type));
+		result.append(item.value);
+		result.push_back(0);
+	}
+
+	return result;
+}
+
+struct SharedEncoderGroup {
+	/**
+	 * The maximum number of operations kept for instances which
+	 * lag behind.
+	 */
+	static constexpr size_t MAX_ENTRIES = 256;
+
+	const std::string key;
+
+	/**
+	 * The number of instances referring to this group; protected
+	 * by #registry_mutex.
+	 */
+	unsigned n_clients = 0;
+
+	/**
+	 * Protects all of the following attributes.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The number of instances in State::SYNCED.
+	 */
+	unsigned n_synced = 0;
+
+	/**
+	 * The shared encoder; nullptr if it has not been opened yet
+	 * or if it has been ended.
+	 */
+	std::unique_ptr<Encoder> encoder;
+
+	/**
+	 * The audio format chosen by the encoder.
+	 */
+	AudioFormat out_audio_format;
+
+	/**
+	 * The most recent stream header, for instances which join a
+	 * running stream: the output of the last #EncoderOp::OPEN,
+	 * or the output of #EncoderOp::SEND_TAG and the following
+	 * operations up to the next #EncoderOp::WRITE.
+	 */
+	SharedBuffer header;
+	bool collecting_header = false;
+
+	/**
+	 * The sequence number of the entry which began #header.
+	 */
+	uint64_t header_seq = 0;
+
+	struct Entry {
+		EncoderOp op;
+
+		/**
+		 * A copy of the operation's input: PCM data or a
+		 * serialized #Tag.
+		 */
+		AllocatedArray<uint8_t> input;
+
+		SharedBuffer output;
+
+		Entry(EncoderOp _op, ConstBuffer<void> _input,
+		      SharedBuffer &&_output) noexcept
+			:op(_op), input(_input.size),
+			 output(std::move(_output)) {
+			std::copy_n((const uint8_t *)_input.data, _input.size,
+				    input.begin());
+		}
+
+		gcc_pure
+		bool Matches(EncoderOp other_op,
+			     ConstBuffer<void> other) const noexcept {
+			return other_op == op && other.size == input.size() &&
+				memcmp(other.data, input.begin(),
+				       other.size) == 0;
+		}
+	};
+
+	std::deque<Entry> entries;
+
+	/**
+	 * The sequence number of entries.front().
+	 */
+	uint64_t first_seq = 0;
+
+	/**
+	 * The sequence number of the last #EncoderOp::OPEN.
+	 */
+	uint64_t open_seq = 0;
+
+	explicit SharedEncoderGroup(std::string &&_key) noexcept
+		:key(std::move(_key)) {}
+
+	uint64_t GetNextSeq() const noexcept {
+		return first_seq + entries.size();
+	}
+
+	/**
+	 * Has the stream just been opened, without any input yet?
+	 */
+	bool IsFresh() const noexcept {
+		return encoder && GetNextSeq() == open_seq + 1;
+	}
+
+	/**
+	 * Find the newest entry with the given operation after the
+	 * current #header; a joining instance has already received
+	 * that header, and cannot go back to an older position.
+	 *
+	 * @return the sequence number or GetNextSeq() if there is no
+	 * match
+	 */
+	gcc_pure
+	uint64_t Find(EncoderOp op, ConstBuffer<void> input) const noexcept {
+		for (size_t i = entries.size(); i > 0; --i) {
+			const uint64_t seq = first_seq + i - 1;
+			if (seq <= header_seq)
+				break;
+
+			if (entries[i - 1].Matches(op, input))
+				return seq;
+		}
+
+		return GetNextSeq();
+	}
+
+	/**
+	 * Read all pending output of the encoder.
+	 */
+	SharedBuffer Drain() {
+		std::string data;
+		char buffer[16384];
+
+		size_t nbytes;
+		while ((nbytes = encoder->Read(buffer, sizeof(buffer))) > 0)
+			data.append(buffer, nbytes);
+
+		return MakeBuffer(data.data(), data.size());
+	}
+
+	const Entry &Push(EncoderOp op, ConstBuffer<void> input,
+			  SharedBuffer &&output) noexcept {
+		entries.emplace_back(op, input, std::move(output));
+
+		if (entries.size() > MAX_ENTRIES) {
+			entries.pop_front();
+			++first_seq;
+		}
+
+		return entries.back();
+	}
+
+	/**
+	 * (Re)open the encoder and start a new stream.
+	 *
+	 * Throws on error.
+	 */
+	const Entry &Open(PreparedEncoder &prepared, AudioFormat audio_format) {
+		encoder.reset();
+		encoder.reset(prepared.Open(audio_format));
+		out_audio_format = audio_format;
+
+		header = Drain();
+		collecting_header = false;
+		open_seq = header_seq = GetNextSeq();
+		return Push(EncoderOp::OPEN, nullptr, SharedBuffer(header));
+	}
+
+	/**
+	 * Perform the next operation of the stream.
+	 *
+	 * Throws on error.
+	 */
+	const Entry &Append(EncoderOp op, ConstBuffer<void> input,
+			    const Tag *tag) {
+		assert(encoder);
+
+		switch (op) {
+		case EncoderOp::OPEN:
+			assert(false);
+			gcc_unreachable();
+
+		case EncoderOp::WRITE:
+			encoder->Write(input.data, input.size);
+			break;
+
+		case EncoderOp::FLUSH:
+			encoder->Flush();
+			break;
+
+		case EncoderOp::PRE_TAG:
+			encoder->PreTag();
+			break;
+
+		case EncoderOp::SEND_TAG:
+			assert(tag != nullptr);
+			encoder->SendTag(*tag);
+			break;
+
+		case EncoderOp::END:
+			encoder->End();
+			break;
+		}
+
+		auto output = Drain();
+
+		if (op == EncoderOp::SEND_TAG) {
+			header = output;
+			collecting_header = true;
+			header_seq = GetNextSeq();
+		} else if (op == EncoderOp::WRITE) {
+			collecting_header = false;
+		} else if (collecting_header && !output->empty()) {
+			std::string h((const char *)header->begin(),
+				      header->size());
+			h.append((const char *)output->begin(),
+				 output->size());
+			header = MakeBuffer(h.data(), h.size());
+		}
+
+		if (op == EncoderOp::END)
+			/* the encoder cannot be used anymore; the
+			   next operation reopens it */
+			encoder.reset();
+
+		return Push(op, input, std::move(output));
+	}
+};
+
+Mutex registry_mutex;
+std::list<SharedEncoderGroup> *registry;
+
+class SharedEncoder final : public Encoder {
+	enum class State : uint8_t {
+		/**
+		 * Following the shared encoder at #position.
+		 */
+		SYNCED,
+
+		/**
+		 * Attached to the group, but the position in its
+		 * stream is unknown.  The next operation determines
+		 * it.
+		 */
+		UNSYNCED,
+
+		/**
+		 * The input differs from the group's stream; #own is
+		 * used from now on.
+		 */
+		DETACHED,
+	};
+
+	SharedEncoderGroup &group;
+
+	PreparedEncoder &prepared;
+
+	/**
+	 * The audio format passed to Open(); used to open #own.
+	 */
+	const AudioFormat audio_format;
+
+	State state;
+
+	/**
+	 * The sequence number of the next operation in the group's
+	 * stream.
+	 */
+	uint64_t position;
+
+	/**
+	 * The private encoder; opened lazily.
+	 */
+	std::unique_ptr<Encoder> own;
+
+	/**
+	 * Shared output which has not been read yet.
+	 */
+	std::deque<SharedBuffer> queue;
+
+	/**
+	 * The number of bytes of queue.front() which have already
+	 * been read.
+	 */
+	size_t queue_offset = 0;
+
+public:
+	SharedEncoder(SharedEncoderGroup &_group, PreparedEncoder &_prepared,
+		      AudioFormat _audio_format) noexcept
+		:Encoder(_group.encoder->ImplementsTag()),
+		 group(_group), prepared(_prepared),
+		 audio_format(_audio_format) {
+		/* the caller holds the group's mutex */
+		Enqueue(group.header);
+
+		if (group.IsFresh()) {
+			state = State::SYNCED;
+			++group.n_synced;
+			position = group.GetNextSeq();
+		} else
+			state = State::UNSYNCED;
+	}
+
+	~SharedEncoder() noexcept override;
+
+	/* virtual methods from class Encoder */
+
+	void End() override {
+		Apply(EncoderOp::END, nullptr, nullptr);
+	}
+
+	void Flush() override {
+		Apply(EncoderOp::FLUSH, nullptr, nullptr);
+	}
+
+	void PreTag() override {
+		Apply(EncoderOp::PRE_TAG, nullptr, nullptr);
+	}
+
+	void SendTag(const Tag &tag) override {
+		const auto s = SerializeTag(tag);
+		Apply(EncoderOp::SEND_TAG, {s.data(), s.size()}, &tag);
+	}
+
+	void Write(const void *data, size_t length) override {
+		Apply(EncoderOp::WRITE, {data, length}, nullptr);
+	}
+
+	size_t Read(void *dest, size_t length) override;
+
+private:
+	void Enqueue(const SharedBuffer &b) noexcept {
+		if (b && !b->empty())
+			queue.push_back(b);
+	}
+
+	void Apply(EncoderOp op, ConstBuffer<void> input, const Tag *tag);
+
+	/**
+	 * @return false if this instance has been detached and the
+	 * operation needs to be performed by #own
+	 */
+	bool ApplyShared(EncoderOp op, ConstBuffer<void> input,
+			 const Tag *tag);
+
+	void ApplyOwn(EncoderOp op, ConstBuffer<void> input,
+		      const Tag *tag);
+};
+
+SharedEncoder::~SharedEncoder() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(group.mutex);
+		if (state == State::SYNCED)
+			--group.n_synced;
+	}
+
+	const std::lock_guard<Mutex> protect(registry_mutex);
+
+	if (--group.n_clients == 0) {
+		SharedEncoderGroup *g = &group;
+		registry->remove_if([g](const SharedEncoderGroup &i){
+				return &i == g;
+			});
+
+		if (registry->empty()) {
+			delete registry;
+			registry = nullptr;
+		}
+	}
+}
+
+void
+SharedEncoder::Apply(EncoderOp op, ConstBuffer<void> input, const Tag *tag)
+{
+	if (state != State::DETACHED && ApplyShared(op, input, tag))
+		return;
+
+	ApplyOwn(op, input, tag);
+}
+
+bool
+SharedEncoder::ApplyShared(EncoderOp op, ConstBuffer<void> input,
+			   const Tag *tag)
+{
+	SharedEncoderGroup &g = group;
+	const std::lock_guard<Mutex> protect(g.mutex);
+
+	if (state == State::SYNCED && op == EncoderOp::END &&
+	    position >= g.first_seq) {
+		/* our stream needs the encoder's trailer, which ends
+		   the shared stream for all instances: catch up with
+		   the others (their additional output is part of the
+		   same stream) and end it; the others skip over the
+		   trailer and continue with a reopened stream */
+		while (position < g.GetNextSeq()) {
+			const auto &e = g.entries[position++ - g.first_seq];
+			Enqueue(e.output);
+			if (e.op == EncoderOp::END)
+				/* another instance has already
+				   ended it */
+				return true;
+		}
+
+		if (g.encoder) {
+			Enqueue(g.Append(op, input, tag).output);
+			position = g.GetNextSeq();
+		}
+
+		return true;
+	}
+
+	if (state == State::SYNCED) {
+		while (position >= g.first_seq) {
+			if (position == g.GetNextSeq()) {
+				/* we're the first one to get here */
+				if (!g.encoder)
+					Enqueue(g.Open(prepared,
+						       audio_format).output);
+
+				Enqueue(g.Append(op, input, tag).output);
+				position = g.GetNextSeq();
+				return true;
+			}
+
+			const auto &e = g.entries[position - g.first_seq];
+			if (e.Matches(op, input)) {
+				/* reuse the output of another
+				   instance */
+				Enqueue(e.output);
+				++position;
+				return true;
+			}
+
+			if (IsSkippable(e.op)) {
+				Enqueue(e.output);
+				++position;
+				continue;
+			}
+
+			if (op == EncoderOp::FLUSH)
+				/* the others haven't done that; it's
+				   not necessary for the stream */
+				return true;
+
+			/* our input differs */
+			break;
+		}
+
+		/* we have fallen too far behind, or our input
+		   differs */
+		--g.n_synced;
+		state = State::UNSYNCED;
+	}
+
+	assert(state == State::UNSYNCED);
+
+	if (op == EncoderOp::FLUSH || op == EncoderOp::END)
+		return true;
+
+	/* only PCM data identifies a position in the stream */
+	const uint64_t seq = op == EncoderOp::WRITE
+		? g.Find(op, input)
+		: g.GetNextSeq();
+	if (seq != g.GetNextSeq()) {
+		/* (re)join the stream */
+		state = State::SYNCED;
+		++g.n_synced;
+		position = seq + 1;
+		Enqueue(g.entries[seq - g.first_seq].output);
+		return true;
+	}
+
+	if (g.n_synced == 0) {
+		/* nobody else is using the shared encoder; continue
+		   its stream with our input */
+		if (!g.encoder)
+			Enqueue(g.Open(prepared, audio_format).output);
+
+		state = State::SYNCED;
+		++g.n_synced;
+		Enqueue(g.Append(op, input, tag).output);
+		position = g.GetNextSeq();
+		return true;
+	}
+
+	if (op != EncoderOp::WRITE)
+		/* the shared stream carries its own tags; wait for
+		   PCM data to find our position */
+		return true;
+
+	/* the other instances are encoding something else; don't
+	   disturb them */
+	state = State::DETACHED;
+	return false;
+}
+
+void
+SharedEncoder::ApplyOwn(EncoderOp op, ConstBuffer<void> input,
+			const Tag *tag)
+{
+	if (!own) {
+		AudioFormat af = audio_format;
+		own.reset(prepared.Open(af));
+	}
+
+	switch (op) {
+	case EncoderOp::OPEN:
+		assert(false);
+		gcc_unreachable();
+
+	case EncoderOp::WRITE:
+		own->Write(input.data, input.size);
+		break;
+
+	case EncoderOp::FLUSH:
+		own->Flush();
+		break;
+
+	case EncoderOp::PRE_TAG:
+		own->PreTag();
+		break;
+
+	case EncoderOp::SEND_TAG:
+		own->SendTag(*tag);
+		break;
+
+	case EncoderOp::END:
+		own->End();
+		break;
+	}
+}
+
+size_t
+SharedEncoder::Read(void *dest, size_t length)
+{
+	if (!queue.empty()) {
+		const auto &b = *queue.front();
+		const size_t nbytes = std::min(length,
+					       b.size() - queue_offset);
+		memcpy(dest, b.begin() + queue_offset, nbytes);
+		queue_offset += nbytes;
+
+		if (queue_offset == b.size()) {
+			queue.pop_front();
+			queue_offset = 0;
+		}
+
+		return nbytes;
+	}
+
+	return own
+		? own->Read(dest, length)
+		: 0;
+}
+
+class PreparedSharedEncoder final : public PreparedEncoder {
+	const std::string name;
+
+	const std::unique_ptr<PreparedEncoder> encoder;
+
+	/**
+	 * Can the encoder's streams be chained?  Only then it can be
+	 * shared: Encoder::End() ends the shared stream, and the
+	 * other instances continue with a new one.  This is cleared
+	 * when the first shared encoder turns out to be unsuitable;
+	 * from then on, this only creates private encoders.
+	 */
+	bool chainable = true;
+
+public:
+	PreparedSharedEncoder(const char *_name,
+			      PreparedEncoder *_encoder) noexcept
+		:name(_name), encoder(_encoder) {}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override;
+
+	const char *GetMimeType() const override {
+		return encoder->GetMimeType();
+	}
+};
+
+/**
+ * Remove the group from the registry if it is not used anymore.  The
+ * caller holds #registry_mutex.
+ */
+static void
+RemoveUnused(std::list<SharedEncoderGroup>::iterator i) noexcept
+{
+	if (i->n_clients > 0)
+		return;
+
+	registry->erase(i);
+
+	if (registry->empty()) {
+		delete registry;
+		registry = nullptr;
+	}
+}
+
+Encoder *
+PreparedSharedEncoder::Open(AudioFormat &audio_format)
+{
+	if (!chainable)
+		return encoder->Open(audio_format);
+
+	std::string key = name;
+	key += '\n';
+	key += ToString(audio_format).c_str();
+
+	const std::lock_guard<Mutex> protect(registry_mutex);
+
+	if (registry == nullptr)
+		registry = new std::list<SharedEncoderGroup>();
+
+	auto i = std::find_if(registry->begin(), registry->end(),
+			      [&key](const SharedEncoderGroup &g){
+				      return g.key == key;
+			      });
+	if (i == registry->end()) {
+		registry->emplace_front(std::move(key));
+		i = registry->begin();
+	}
+
+	SharedEncoderGroup &g = *i;
+
+	try {
+		const std::lock_guard<Mutex> protect_group(g.mutex);
+
+		if (!g.encoder)
+			g.Open(*encoder, audio_format);
+
+		if (g.n_clients > 0 || g.encoder->ImplementsTag()) {
+			auto *e = new SharedEncoder(g, *encoder, audio_format);
+			++g.n_clients;
+			audio_format = g.out_audio_format;
+			return e;
+		}
+	} catch (...) {
+		RemoveUnused(i);
+		throw;
+	}
+
+	/* a trailer followed by a new header (e.g. RIFF or fLaC) in
+	   the middle of the stream would break the other instances'
+	   streams; only Ogg streams (the encoders which implement
+	   tags) can be chained like that */
+	RemoveUnused(i);
+	chainable = false;
+
+	FormatWarning(shared_encoder_domain,
+		      "Encoder \"%s\" cannot be shared, because its streams cannot be chained",
+		      name.c_str());
+
+	return encoder->Open(audio_format);
+}
+
+} // namespace
+
+PreparedEncoder *
+shared_encoder_new(const char *name, PreparedEncoder *encoder)
+{
+	return new PreparedSharedEncoder(name, encoder);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+class PreparedEncoder;
+
+/**
+ * Wrap a #PreparedEncoder so that all instances with the same name
+ * and audio format share one #Encoder: the input which all of them
+ * write is encoded only once, and each instance reads a copy of the
+ * encoded stream.
+ *
+ * Like with #SharedPcmConvert, each instance verifies that its input
+ * is the same as the shared encoder's input; if not, it falls back
+ * to a private #Encoder.  An instance which is opened while the
+ * shared stream is already running starts with the most recent
+ * stream header, just like a new client of the "httpd" output.
+ *
+ * Ending the stream (Encoder::End()) ends it for all instances: the
+ * ending instance receives the encoder's trailer, and the others
+ * skip over it and continue with a reopened stream.  This is a
+ * chained Ogg stream, just like after a tag change; encoders whose
+ * streams cannot be chained (i.e. which don't implement tags) are
+ * therefore not shared, and this falls back to private encoders.
+ *
+ * The settings of the first instance which opens the shared encoder
+ * are used; all instances with the same name should have the same
+ * settings.
+ *
+ * @param name the name of the shared encoder
+ * @param encoder the wrapped encoder; ownership is transferred
+ */
+PreparedEncoder *
+shared_encoder_new(const char *name, PreparedEncoder *encoder);
+
+#endif
@@ -0,0 +1,371 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "ThreadedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Name.hxx"
+#include "thread/Thread.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <memory>
+
+#include <assert.h>
+#include <stdint.h>
+
+namespace {
+
+class ThreadedEncoder final : public Encoder {
+	/**
+	 * A queued method call.
+	 */
+	struct Operation {
+		enum class Type : uint8_t {
+			WRITE,
+			PRE_TAG,
+			SEND_TAG,
+		} type;
+
+		/**
+		 * A copy of the PCM data for #Type::WRITE.
+		 */
+		AllocatedArray<uint8_t> data;
+
+		/**
+		 * A copy of the tag for #Type::SEND_TAG.
+		 */
+		std::unique_ptr<Tag> tag;
+
+		explicit Operation(Type _type) noexcept:type(_type) {}
+	};
+
+	const std::unique_ptr<Encoder> encoder;
+
+	const size_t max_pending;
+
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by the client when #queue has grown or when the
+	 * thread shall quit.
+	 */
+	Cond thread_cond;
+
+	/**
+	 * Signalled by the thread after it has finished an operation.
+	 */
+	Cond client_cond;
+
+	/**
+	 * Operations waiting for the thread.  Protected by #mutex.
+	 */
+	std::deque<Operation> queue;
+
+	/**
+	 * The total size of all #Type::WRITE operations in #queue.
+	 * Protected by #mutex.
+	 */
+	size_t pending = 0;
+
+	/**
+	 * Encoded data waiting to be read.  Protected by #mutex.
+	 */
+	DynamicFifoBuffer<uint8_t> output;
+
+	/**
+	 * The error thrown by the #encoder in the thread.  Protected
+	 * by #mutex.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Is the thread currently executing an operation?  Protected
+	 * by #mutex.
+	 */
+	bool busy = false;
+
+	/**
+	 * Shall the thread quit?  Protected by #mutex.
+	 */
+	bool quit = false;
+
+public:
+	ThreadedEncoder(std::unique_ptr<Encoder> &&_encoder,
+			size_t _max_pending)
+		:Encoder(_encoder->ImplementsTag()),
+		 encoder(std::move(_encoder)), max_pending(_max_pending),
+		 thread(BIND_THIS_METHOD(Run)),
+		 output(16384) {
+		/* collect the stream header */
+		DrainEncoder();
+
+		thread.Start();
+	}
+
+	~ThreadedEncoder() noexcept override;
+
+	/* virtual methods from class Encoder */
+	void End() override;
+	void Flush() override;
+	void PreTag() override;
+	void SendTag(const Tag &tag) override;
+	void Write(const void *data, size_t length) override;
+	size_t Read(void *dest, size_t length) override;
+
+private:
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void CheckRethrow() {
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	/**
+	 * Append an operation to the queue.  Caller must lock the
+	 * mutex.
+	 */
+	void Push(Operation &&o) noexcept {
+		queue.emplace_back(std::move(o));
+		thread_cond.signal();
+	}
+
+	/**
+	 * Wait until the thread has finished all operations;
+	 * afterwards, the client may use the #encoder directly.
+	 * Caller must lock the mutex.
+	 *
+	 * Throws on error.
+	 */
+	void WaitIdle() {
+		while (true) {
+			CheckRethrow();
+
+			if (queue.empty() && !busy)
+				return;
+
+			client_cond.wait(mutex);
+		}
+	}
+
+	/**
+	 * Move all pending output of the #encoder to #output.
+	 * Caller must lock the mutex or must be the thread.
+	 */
+	void DrainEncoder();
+
+	void Execute(Operation &o);
+
+	void Run() noexcept;
+};
+
+ThreadedEncoder::~ThreadedEncoder() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		quit = true;
+		thread_cond.signal();
+	}
+
+	thread.Join();
+}
+
+void
+ThreadedEncoder::DrainEncoder()
+{
+	while (true) {
+		uint8_t buffer[16384];
+		const size_t nbytes = encoder->Read(buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		output.Append(buffer, nbytes);
+	}
+}
+
+void
+ThreadedEncoder::End()
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	WaitIdle();
+	encoder->End();
+	DrainEncoder();
+}
+
+void
+ThreadedEncoder::Flush()
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	WaitIdle();
+	encoder->Flush();
+	DrainEncoder();
+}
+
+void
+ThreadedEncoder::PreTag()
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	CheckRethrow();
+	Push(Operation(Operation::Type::PRE_TAG));
+}
+
+void
+ThreadedEncoder::SendTag(const Tag &tag)
+{
+	Operation o(Operation::Type::SEND_TAG);
+	o.tag.reset(new Tag(tag));
+
+	const std::lock_guard<Mutex> protect(mutex);
+	CheckRethrow();
+	Push(std::move(o));
+}
+
+void
+ThreadedEncoder::Write(const void *data, size_t length)
+{
+	Operation o(Operation::Type::WRITE);
+	o.data.ResizeDiscard(length);
+	std::copy_n((const uint8_t *)data, length, o.data.begin());
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	/* apply backpressure if the thread lags behind */
+	while (true) {
+		CheckRethrow();
+
+		if (pending < max_pending)
+			break;
+
+		client_cond.wait(mutex);
+	}
+
+	pending += length;
+	Push(std::move(o));
+}
+
+size_t
+ThreadedEncoder::Read(void *dest, size_t length)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto r = output.Read();
+	const size_t nbytes = std::min(r.size, length);
+	std::copy_n(r.data, nbytes, (uint8_t *)dest);
+	output.Consume(nbytes);
+	return nbytes;
+}
+
+inline void
+ThreadedEncoder::Execute(Operation &o)
+{
+	switch (o.type) {
+	case Operation::Type::WRITE:
+		encoder->Write(o.data.begin(), o.data.size());
+		break;
+
+	case Operation::Type::PRE_TAG:
+		encoder->PreTag();
+		break;
+
+	case Operation::Type::SEND_TAG:
+		encoder->SendTag(*o.tag);
+		break;
+	}
+}
+
+void
+ThreadedEncoder::Run() noexcept
+{
+	SetThreadName("encoder");
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (!quit) {
+		if (queue.empty() || error) {
+			thread_cond.wait(mutex);
+			continue;
+		}
+
+		Operation o = std::move(queue.front());
+		queue.pop_front();
+		busy = true;
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			Execute(o);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		/* the client doesn't touch the encoder while we're
+		   busy, so its output can be collected under the
+		   lock */
+		if (!error) {
+			try {
+				DrainEncoder();
+			} catch (...) {
+				error = std::current_exception();
+			}
+		}
+
+		if (o.type == Operation::Type::WRITE)
+			pending -= o.data.size();
+
+		busy = false;
+		client_cond.signal();
+	}
+}
+
+class PreparedThreadedEncoder final : public PreparedEncoder {
+	const std::unique_ptr<PreparedEncoder> encoder;
+
+	const size_t max_pending;
+
+public:
+	PreparedThreadedEncoder(PreparedEncoder *_encoder,
+				size_t _max_pending) noexcept
+		:encoder(_encoder), max_pending(_max_pending) {}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override {
+		std::unique_ptr<Encoder> e(encoder->Open(audio_format));
+		return new ThreadedEncoder(std::move(e), max_pending);
+	}
+
+	const char *GetMimeType() const override {
+		return encoder->GetMimeType();
+	}
+};
+
+} // namespace
+
+PreparedEncoder *
+threaded_encoder_new(PreparedEncoder *encoder, size_t max_pending)
+{
+	return new PreparedThreadedEncoder(encoder, max_pending);
+}
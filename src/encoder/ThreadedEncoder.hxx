@@ -0,0 +1,45 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREADED_ENCODER_HXX
+#define MPD_THREADED_ENCODER_HXX
+
+#include <stddef.h>
+
+class PreparedEncoder;
+
+/**
+ * Wrap a #PreparedEncoder so that each #Encoder runs in a dedicated
+ * worker thread.  Write(), PreTag() and SendTag() only append to a
+ * queue and return immediately (unless more than #max_pending bytes
+ * of PCM are queued already); Read() returns whatever the worker has
+ * produced so far.  Flush() and End() wait for the worker to catch
+ * up, so everything is available to Read() after they return.
+ *
+ * This pipelines CPU-heavy encoding with the rest of the output
+ * thread's work (e.g. sending data to network clients).
+ *
+ * @param encoder the wrapped encoder; ownership is transferred
+ * @param max_pending the maximum number of PCM bytes in the queue
+ */
+PreparedEncoder *
+threaded_encoder_new(PreparedEncoder *encoder, size_t max_pending);
+
+#endif
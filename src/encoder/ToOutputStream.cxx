@@ -25,6 +25,16 @@ void
 EncoderToOutputStream(OutputStream &os, Encoder &encoder)
 {
 	while (true) {
+		/* write directly from the encoder's buffer if it
+		   allows that */
+
+		auto r = encoder.Peek();
+		if (!r.empty()) {
+			os.Write(r.data, r.size);
+			encoder.Consume(r.size);
+			continue;
+		}
+
 		/* read from the encoder */
 
 		char buffer[32768];
@@ -24,6 +24,8 @@
 #include "config/Domain.hxx"
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <FLAC/stream_encoder.h>
 
@@ -66,6 +68,15 @@ public:
 		return output_buffer.Read((uint8_t *)dest, length);
 	}
 
+	ConstBuffer<void> Peek() noexcept override {
+		const auto r = output_buffer.Read();
+		return {r.data, r.size};
+	}
+
+	void Consume(size_t nbytes) noexcept override {
+		output_buffer.Consume(nbytes);
+	}
+
 private:
 	static FLAC__StreamEncoderWriteStatus WriteCallback(const FLAC__StreamEncoder *,
 							    const FLAC__byte data[],
@@ -79,9 +90,23 @@ private:
 	}
 };
 
+static constexpr Domain flac_encoder_domain("flac_encoder");
+
 class PreparedFlacEncoder final : public PreparedEncoder {
 	const unsigned compression;
 
+	/**
+	 * The number of libFLAC worker threads; 1 means encode in
+	 * the calling thread.
+	 */
+	const unsigned threads;
+
+	/**
+	 * The block size in frames; 0 means libFLAC chooses it
+	 * according to the compression level.
+	 */
+	const unsigned blocksize;
+
 public:
 	PreparedFlacEncoder(const ConfigBlock &block);
 
@@ -94,8 +119,18 @@ public:
 };
 
 PreparedFlacEncoder::PreparedFlacEncoder(const ConfigBlock &block)
-	:compression(block.GetBlockValue("compression", 5u))
+	:compression(block.GetBlockValue("compression", 5u)),
+	 threads(block.GetBlockValue("threads", 1u)),
+	 blocksize(block.GetBlockValue("blocksize", 0u))
 {
+	if (threads == 0)
+		throw std::runtime_error("\"threads\" must be positive");
+
+#if FLAC_API_VERSION_CURRENT < 14
+	if (threads > 1)
+		LogWarning(flac_encoder_domain,
+			   "libFLAC is too old for multithreaded encoding");
+#endif
 }
 
 static PreparedEncoder *
@@ -106,12 +141,35 @@ flac_encoder_init(const ConfigBlock &block)
 
 static void
 flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression,
+		   unsigned threads, unsigned blocksize,
 		   const AudioFormat &audio_format, unsigned bits_per_sample)
 {
 	if (!FLAC__stream_encoder_set_compression_level(fse, compression))
 		throw FormatRuntimeError("error setting flac compression to %d",
 					 compression);
 
+	if (blocksize > 0 &&
+	    !FLAC__stream_encoder_set_blocksize(fse, blocksize))
+		throw FormatRuntimeError("error setting flac blocksize to %u",
+					 blocksize);
+
+#if FLAC_API_VERSION_CURRENT >= 14
+	if (threads > 1) {
+		/* let libFLAC encode frames in parallel worker
+		   threads */
+		const auto status =
+			FLAC__stream_encoder_set_num_threads(fse, threads);
+		if (status == FLAC__STREAM_ENCODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED)
+			LogWarning(flac_encoder_domain,
+				   "libFLAC was built without multithreading");
+		else if (status != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK)
+			throw FormatRuntimeError("error setting flac threads to %u",
+						 threads);
+	}
+#else
+	(void)threads;
+#endif
+
 	if (!FLAC__stream_encoder_set_channels(fse, audio_format.channels))
 		throw FormatRuntimeError("error setting flac channels num to %d",
 					 audio_format.channels);
@@ -174,7 +232,7 @@ PreparedFlacEncoder::Open(AudioFormat &audio_format)
 		throw std::runtime_error("FLAC__stream_encoder_new() failed");
 
 	try {
-		flac_encoder_setup(fse, compression,
+		flac_encoder_setup(fse, compression, threads, blocksize,
 				   audio_format, bits_per_sample);
 	} catch (...) {
 		FLAC__stream_encoder_delete(fse);
@@ -38,6 +38,15 @@ public:
 	size_t Read(void *dest, size_t length) override {
 		return buffer.Read((uint8_t *)dest, length);
 	}
+
+	ConstBuffer<void> Peek() noexcept override {
+		const auto r = buffer.Read();
+		return {r.data, r.size};
+	}
+
+	void Consume(size_t nbytes) noexcept override {
+		buffer.Consume(nbytes);
+	}
 };
 
 class PreparedNullEncoder final : public PreparedEncoder {
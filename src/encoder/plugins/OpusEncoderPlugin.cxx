@@ -24,10 +24,12 @@
 #include "util/Alloc.hxx"
 #include "system/ByteOrder.hxx"
 #include "util/StringUtil.hxx"
+#include "system/Clock.hxx"
 
 #include <opus.h>
 #include <ogg/ogg.h>
 
+#include <chrono>
 #include <stdexcept>
 
 #include <assert.h>
@@ -35,6 +37,25 @@
 
 namespace {
 
+/**
+ * Settings for complexity autotuning: the encoder's CPU time is
+ * compared with the duration of the audio it has encoded, once per
+ * #AUTOTUNE_INTERVAL of audio.
+ */
+static constexpr unsigned AUTOTUNE_INTERVAL_MS = 1000;
+
+/**
+ * Decrease the complexity if encoding takes more than this share
+ * (in percent) of real time.
+ */
+static constexpr unsigned AUTOTUNE_MAX_LOAD = 10;
+
+/**
+ * Increase the complexity if encoding takes less than this share
+ * (in percent) of real time.
+ */
+static constexpr unsigned AUTOTUNE_MIN_LOAD = 3;
+
 class OpusEncoder final : public OggEncoder {
 	const AudioFormat audio_format;
 
@@ -46,6 +67,35 @@ class OpusEncoder final : public OggEncoder {
 
 	::OpusEncoder *const enc;
 
+	/**
+	 * Flush an Ogg page after each Opus packet, to minimize
+	 * latency?
+	 */
+	const bool flush_packets;
+
+	/**
+	 * Adjust the complexity according to the measured CPU time?
+	 */
+	const bool autotune;
+
+	/**
+	 * The current complexity; only used if #autotune is set.
+	 */
+	int complexity;
+
+	/**
+	 * The number of frames encoded since the last autotune
+	 * check.
+	 */
+	size_t autotune_frames = 0;
+
+	/**
+	 * The CPU time spent in libopus since the last autotune
+	 * check.
+	 */
+	std::chrono::steady_clock::duration autotune_cpu_time =
+		std::chrono::steady_clock::duration::zero();
+
 	unsigned char buffer2[1275 * 3 + 7];
 
 	int lookahead;
@@ -55,7 +105,9 @@ class OpusEncoder final : public OggEncoder {
 	ogg_int64_t granulepos = 0;
 
 public:
-	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining);
+	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+		    bool _chaining, unsigned _buffer_frames,
+		    bool _flush_packets, int _complexity);
 	~OpusEncoder() override;
 
 	/* virtual methods from class Encoder */
@@ -67,6 +119,7 @@ public:
 
 private:
 	void DoEncode(bool eos);
+	void Autotune(std::chrono::steady_clock::duration cpu_time) noexcept;
 	void WriteSilence(unsigned fill_frames);
 
 	void GenerateHeaders(const Tag *tag);
@@ -76,8 +129,20 @@ private:
 
 class PreparedOpusEncoder final : public PreparedEncoder {
 	opus_int32 bitrate;
+
+	/**
+	 * The configured complexity, or -1 for "auto".
+	 */
 	int complexity;
+
 	int signal;
+	int application;
+
+	/**
+	 * The number of frames (at 48 kHz) per Opus packet.
+	 */
+	unsigned frame_frames;
+
 	const bool chaining;
 
 public:
@@ -107,9 +172,16 @@ PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 			throw std::runtime_error("Invalid bit rate");
 	}
 
-	complexity = block.GetBlockValue("complexity", 10u);
-	if (complexity > 10)
-		throw std::runtime_error("Invalid complexity");
+	value = block.GetBlockValue("complexity", "10");
+	if (strcmp(value, "auto") == 0)
+		complexity = -1;
+	else {
+		char *endptr;
+		complexity = strtoul(value, &endptr, 10);
+		if (endptr == value || *endptr != 0 ||
+		    complexity < 0 || complexity > 10)
+			throw std::runtime_error("Invalid complexity");
+	}
 
 	value = block.GetBlockValue("signal", "auto");
 	if (strcmp(value, "auto") == 0)
@@ -120,6 +192,32 @@ PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 		signal = OPUS_SIGNAL_MUSIC;
 	else
 		throw std::runtime_error("Invalid signal");
+
+	value = block.GetBlockValue("application", "audio");
+	if (strcmp(value, "audio") == 0)
+		application = OPUS_APPLICATION_AUDIO;
+	else if (strcmp(value, "voip") == 0)
+		application = OPUS_APPLICATION_VOIP;
+	else if (strcmp(value, "lowdelay") == 0)
+		application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+	else
+		throw std::runtime_error("Invalid application");
+
+	value = block.GetBlockValue("frame_duration", "20");
+	if (strcmp(value, "2.5") == 0)
+		frame_frames = 120;
+	else if (strcmp(value, "5") == 0)
+		frame_frames = 240;
+	else if (strcmp(value, "10") == 0)
+		frame_frames = 480;
+	else if (strcmp(value, "20") == 0)
+		frame_frames = 960;
+	else if (strcmp(value, "40") == 0)
+		frame_frames = 1920;
+	else if (strcmp(value, "60") == 0)
+		frame_frames = 2880;
+	else
+		throw std::runtime_error("Invalid frame duration");
 }
 
 static PreparedEncoder *
@@ -128,14 +226,19 @@ opus_encoder_init(const ConfigBlock &block)
 	return new PreparedOpusEncoder(block);
 }
 
-OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining)
+OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+			 bool _chaining, unsigned _buffer_frames,
+			 bool _flush_packets, int _complexity)
 	:OggEncoder(_chaining),
 	 audio_format(_audio_format),
 	 frame_size(_audio_format.GetFrameSize()),
-	 buffer_frames(_audio_format.sample_rate / 50),
+	 buffer_frames(_buffer_frames),
 	 buffer_size(frame_size * buffer_frames),
 	 buffer((unsigned char *)xalloc(buffer_size)),
-	 enc(_enc)
+	 enc(_enc),
+	 flush_packets(_flush_packets),
+	 autotune(_complexity < 0),
+	 complexity(autotune ? 10 : _complexity)
 {
 	opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
 	GenerateHeaders(nullptr);
@@ -167,16 +270,26 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format)
 	int error_code;
 	auto *enc = opus_encoder_create(audio_format.sample_rate,
 					audio_format.channels,
-					OPUS_APPLICATION_AUDIO,
+					application,
 					&error_code);
 	if (enc == nullptr)
 		throw std::runtime_error(opus_strerror(error_code));
 
 	opus_encoder_ctl(enc, OPUS_SET_BITRATE(bitrate));
-	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
+	/* "auto" starts with the highest complexity and backs off
+	   if the CPU cannot keep up */
+	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity >= 0
+						  ? complexity : 10));
 	opus_encoder_ctl(enc, OPUS_SET_SIGNAL(signal));
 
-	return new OpusEncoder(audio_format, enc, chaining);
+	/* with short frames, the caller wants low latency, so don't
+	   let libogg collect several packets in one page */
+	const bool flush_packets =
+		application == OPUS_APPLICATION_RESTRICTED_LOWDELAY ||
+		frame_frames < 960;
+
+	return new OpusEncoder(audio_format, enc, chaining,
+			       frame_frames, flush_packets, complexity);
 }
 
 OpusEncoder::~OpusEncoder()
@@ -190,6 +303,10 @@ OpusEncoder::DoEncode(bool eos)
 {
 	assert(buffer_position == buffer_size || eos);
 
+	const auto cpu_start = autotune
+		? GetThreadCPUTime()
+		: std::chrono::steady_clock::duration::zero();
+
 	opus_int32 result =
 		audio_format.format == SampleFormat::S16
 		? opus_encode(enc,
@@ -205,6 +322,9 @@ OpusEncoder::DoEncode(bool eos)
 	if (result < 0)
 		throw std::runtime_error("Opus encoder error");
 
+	if (autotune)
+		Autotune(GetThreadCPUTime() - cpu_start);
+
 	granulepos += buffer_position / frame_size;
 
 	ogg_packet packet;
@@ -216,9 +336,42 @@ OpusEncoder::DoEncode(bool eos)
 	packet.packetno = packetno++;
 	stream.PacketIn(packet);
 
+	if (flush_packets)
+		Flush();
+
 	buffer_position = 0;
 }
 
+void
+OpusEncoder::Autotune(std::chrono::steady_clock::duration cpu_time) noexcept
+{
+	autotune_cpu_time += cpu_time;
+	autotune_frames += buffer_frames;
+
+	const size_t interval_frames =
+		audio_format.sample_rate * AUTOTUNE_INTERVAL_MS / 1000;
+	if (autotune_frames < interval_frames)
+		return;
+
+	/* the encoder load in percent of real time */
+	const auto audio_time = std::chrono::microseconds(uint64_t(autotune_frames) * 1000000 / audio_format.sample_rate);
+	const uint64_t load = 100 * autotune_cpu_time / audio_time;
+
+	int new_complexity = complexity;
+	if (load > AUTOTUNE_MAX_LOAD && complexity > 0)
+		--new_complexity;
+	else if (load < AUTOTUNE_MIN_LOAD && complexity < 10)
+		++new_complexity;
+
+	if (new_complexity != complexity) {
+		complexity = new_complexity;
+		opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
+	}
+
+	autotune_frames = 0;
+	autotune_cpu_time = std::chrono::steady_clock::duration::zero();
+}
+
 void
 OpusEncoder::End()
 {
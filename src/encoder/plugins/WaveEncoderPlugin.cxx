@@ -19,7 +19,9 @@
 
 #include "WaveEncoderPlugin.hxx"
 #include "../EncoderAPI.hxx"
+#include "pcm/PcmPack.hxx"
 #include "system/ByteOrder.hxx"
+#include "util/ByteReverse.hxx"
 #include "util/DynamicFifoBuffer.hxx"
 
 #include <assert.h>
@@ -41,6 +43,15 @@ public:
 	size_t Read(void *dest, size_t length) override {
 		return buffer.Read((uint8_t *)dest, length);
 	}
+
+	ConstBuffer<void> Peek() noexcept override {
+		const auto r = buffer.Read();
+		return {r.data, r.size};
+	}
+
+	void Consume(size_t nbytes) noexcept override {
+		buffer.Consume(nbytes);
+	}
 };
 
 class PreparedWaveEncoder final : public PreparedEncoder {
@@ -145,28 +156,11 @@ WaveEncoder::WaveEncoder(AudioFormat &audio_format)
 	buffer.Append(sizeof(*header));
 }
 
-static size_t
-pcm16_to_wave(uint16_t *dst16, const uint16_t *src16, size_t length)
-{
-	size_t cnt = length >> 1;
-	while (cnt > 0) {
-		*dst16++ = ToLE16(*src16++);
-		cnt--;
-	}
-	return length;
-}
-
-static size_t
-pcm32_to_wave(uint32_t *dst32, const uint32_t *src32, size_t length)
-{
-	size_t cnt = length >> 2;
-	while (cnt > 0){
-		*dst32++ = ToLE32(*src32++);
-		cnt--;
-	}
-	return length;
-}
-
+/**
+ * Pack 24 bit samples to little-endian triples.  This is only used
+ * on big-endian hosts; on little-endian hosts, pcm_pack_24() does
+ * the same.
+ */
 static size_t
 pcm24_to_wave(uint8_t *dst8, const uint32_t *src32, size_t length)
 {
@@ -197,27 +191,34 @@ WaveEncoder::Write(const void *src, size_t length)
 		case 32:// optimized cases
 			memcpy(dst, src, length);
 			break;
-		case 24:
-			length = pcm24_to_wave(dst, (const uint32_t *)src, length);
+		case 24: {
+			const auto *src32 = (const int32_t *)src;
+			pcm_pack_24(dst, src32, src32 + length / 4);
+			length = length / 4 * 3;
 			break;
 		}
+		}
 	} else {
 		switch (bits) {
 		case 8:
 			memcpy(dst, src, length);
 			break;
-		case 16:
-			length = pcm16_to_wave((uint16_t *)dst,
-					       (const uint16_t *)src, length);
+		case 16: {
+			const auto *src16 = (const uint16_t *)src;
+			reverse_bytes_16((uint16_t *)dst,
+					 src16, src16 + length / 2);
 			break;
+		}
 		case 24:
 			length = pcm24_to_wave(dst, (const uint32_t *)src, length);
 			break;
-		case 32:
-			length = pcm32_to_wave((uint32_t *)dst,
-					       (const uint32_t *)src, length);
+		case 32: {
+			const auto *src32 = (const uint32_t *)src;
+			reverse_bytes_32((uint32_t *)dst,
+					 src32, src32 + length / 4);
 			break;
 		}
+		}
 	}
 
 	buffer.Append(length);
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "AsyncResolver.hxx"
+#include "net/ResolverCache.hxx"
+#include "thread/WorkerPool.hxx"
+#include "thread/Mutex.hxx"
+
+/**
+ * The number of threads in the resolver pool.  More than one, so a
+ * host whose DNS server does not respond does not delay all other
+ * lookups.
+ */
+static constexpr unsigned resolver_pool_threads = 2;
+
+struct AsyncResolver::State {
+	Mutex mutex;
+
+	/**
+	 * The owning #AsyncResolver.  This is cleared by
+	 * AsyncResolver::Cancel(), so the worker thread knows that
+	 * nobody is interested in the result anymore.  Protected by
+	 * #mutex.
+	 */
+	AsyncResolver *owner;
+
+	std::vector<AllocatedSocketAddress> addresses;
+
+	std::exception_ptr error;
+
+	explicit State(AsyncResolver &_owner) noexcept
+		:owner(&_owner) {}
+};
+
+static WorkerPool &
+GetResolverPool()
+{
+	/* constructed on first use; the destructor joins the
+	   threads at exit */
+	static WorkerPool pool("resolver", resolver_pool_threads);
+	return pool;
+}
+
+AsyncResolver::AsyncResolver(EventLoop &_loop,
+			     AsyncResolverHandler &_handler) noexcept
+	:defer_event(_loop, BIND_THIS_METHOD(OnDeferred)),
+	 handler(_handler) {}
+
+void
+AsyncResolver::Start(const char *host_and_port, unsigned default_port,
+		     int socktype) noexcept
+{
+	Cancel();
+
+	state = std::make_shared<State>(*this);
+
+	auto cached = LookupResolverCache(host_and_port, default_port,
+					  socktype);
+	if (!cached.empty()) {
+		state->addresses = std::move(cached);
+		defer_event.Schedule();
+		return;
+	}
+
+	try {
+		GetResolverPool().Push([s = state,
+					host = std::string(host_and_port),
+					default_port, socktype]{
+			std::vector<AllocatedSocketAddress> addresses;
+			std::exception_ptr error;
+
+			try {
+				addresses = CachedResolve(host.c_str(),
+							  default_port,
+							  socktype);
+			} catch (...) {
+				error = std::current_exception();
+			}
+
+			const std::lock_guard<Mutex> lock(s->mutex);
+			if (s->owner == nullptr)
+				/* canceled */
+				return;
+
+			s->addresses = std::move(addresses);
+			s->error = std::move(error);
+			s->owner->defer_event.Schedule();
+		});
+	} catch (...) {
+		/* failed to launch the worker threads */
+		state->error = std::current_exception();
+		defer_event.Schedule();
+	}
+}
+
+void
+AsyncResolver::Cancel() noexcept
+{
+	if (state == nullptr)
+		return;
+
+	{
+		const std::lock_guard<Mutex> lock(state->mutex);
+		state->owner = nullptr;
+	}
+
+	state.reset();
+	defer_event.Cancel();
+}
+
+void
+AsyncResolver::OnDeferred() noexcept
+{
+	if (state == nullptr)
+		return;
+
+	std::vector<AllocatedSocketAddress> addresses;
+	std::exception_ptr error;
+
+	{
+		const std::lock_guard<Mutex> lock(state->mutex);
+		addresses = std::move(state->addresses);
+		error = std::move(state->error);
+		state->owner = nullptr;
+	}
+
+	state.reset();
+
+	if (error)
+		handler.OnResolverError(std::move(error));
+	else
+		handler.OnResolverSuccess(std::move(addresses));
+}
+
+void
+PrefetchResolve(const char *host_and_port, unsigned default_port,
+		int socktype) noexcept
+try {
+	if (!LookupResolverCache(host_and_port, default_port,
+				 socktype).empty())
+		return;
+
+	GetResolverPool().Push([host = std::string(host_and_port),
+				default_port, socktype]{
+		try {
+			CachedResolve(host.c_str(), default_port, socktype);
+		} catch (...) {
+		}
+	});
+} catch (...) {
+	/* this is only an optimization; ignore errors */
+}
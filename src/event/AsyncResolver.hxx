@@ -0,0 +1,109 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ASYNC_RESOLVER_HXX
+#define MPD_ASYNC_RESOLVER_HXX
+
+#include "DeferEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AsyncResolverHandler {
+public:
+	/**
+	 * @param addresses a non-empty list of addresses
+	 */
+	virtual void OnResolverSuccess(std::vector<AllocatedSocketAddress> &&addresses) noexcept = 0;
+	virtual void OnResolverError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * Resolve a host name in a worker thread (with CachedResolve()) and
+ * deliver the result to the #AsyncResolverHandler in the #EventLoop
+ * thread.  This shall be used by all clients which connect from
+ * inside the #EventLoop, because a slow DNS server would otherwise
+ * block the whole loop.
+ *
+ * Cached results are delivered without a detour through the worker
+ * thread, but still asynchronously.
+ */
+class AsyncResolver final {
+	struct State;
+
+	DeferEvent defer_event;
+
+	AsyncResolverHandler &handler;
+
+	/**
+	 * The state shared with the worker thread.  This is nullptr
+	 * if no lookup is in progress.
+	 */
+	std::shared_ptr<State> state;
+
+public:
+	AsyncResolver(EventLoop &_loop,
+		      AsyncResolverHandler &_handler) noexcept;
+
+	~AsyncResolver() noexcept {
+		Cancel();
+	}
+
+	AsyncResolver(const AsyncResolver &) = delete;
+	AsyncResolver &operator=(const AsyncResolver &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return defer_event.GetEventLoop();
+	}
+
+	bool IsBusy() const noexcept {
+		return state != nullptr;
+	}
+
+	/**
+	 * Start resolving a host name.  A lookup which is already in
+	 * progress is canceled.
+	 */
+	void Start(const char *host_and_port, unsigned default_port,
+		   int socktype) noexcept;
+
+	/**
+	 * Cancel the lookup.  The handler will not be invoked.  The
+	 * worker thread may still finish the lookup and fill the
+	 * cache.
+	 */
+	void Cancel() noexcept;
+
+private:
+	void OnDeferred() noexcept;
+};
+
+/**
+ * Resolve the given host in a worker thread to fill the cache (see
+ * CachedResolve()), without waiting for the result.  Errors are
+ * ignored.  This function is thread-safe.
+ */
+void
+PrefetchResolve(const char *host_and_port, unsigned default_port,
+		int socktype) noexcept;
+
+#endif
@@ -31,3 +31,9 @@ DeferEvent::Schedule() noexcept
 {
 	loop.AddDeferred(*this);
 }
+
+void
+DeferEvent::ScheduleYield() noexcept
+{
+	loop.AddYield(*this);
+}
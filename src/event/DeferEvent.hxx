@@ -39,6 +39,12 @@ class DeferEvent final {
 
 	EventLoop &loop;
 
+	/**
+	 * Is this object in EventLoop::yielded?  Protected with
+	 * EventLoop::mutex.
+	 */
+	bool yielded = false;
+
 	typedef BoundMethod<void() noexcept> Callback;
 	const Callback callback;
 
@@ -55,6 +61,13 @@ public:
 	}
 
 	void Schedule() noexcept;
+
+	/**
+	 * Like Schedule(), but let the #EventLoop poll its sockets
+	 * first; see EventLoop::AddYield().
+	 */
+	void ScheduleYield() noexcept;
+
 	void Cancel() noexcept;
 
 private:
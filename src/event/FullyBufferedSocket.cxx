@@ -19,6 +19,7 @@
 
 #include "FullyBufferedSocket.hxx"
 #include "net/SocketError.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <assert.h>
@@ -50,25 +51,35 @@ FullyBufferedSocket::Flush() noexcept
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.empty()) {
+	if (output.empty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
-	if (gcc_unlikely(nbytes <= 0))
-		return nbytes == 0;
+	/* the output buffer consists of segments; send as many of
+	   them as the socket accepts */
+	while (true) {
+		const auto data = output.Read();
+		assert(!data.empty());
 
-	output.Consume(nbytes);
+		auto nbytes = DirectWrite(data.data, data.size);
+		if (gcc_unlikely(nbytes <= 0))
+			return nbytes == 0;
 
-	if (output.empty()) {
-		IdleMonitor::Cancel();
-		CancelWrite();
-	}
+		output.Consume(nbytes);
 
-	return true;
+		if (output.empty()) {
+			IdleMonitor::Cancel();
+			CancelWrite();
+			OnSocketOutputEmpty();
+			return true;
+		}
+
+		if (size_t(nbytes) < data.size)
+			/* the socket's send buffer is full */
+			return true;
+	}
 }
 
 bool
@@ -22,19 +22,24 @@
 
 #include "BufferedSocket.hxx"
 #include "IdleMonitor.hxx"
-#include "util/PeakBuffer.hxx"
+#include "util/SegmentBuffer.hxx"
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
  */
 class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
-	PeakBuffer output;
+	SegmentBuffer output;
 
 public:
+	/**
+	 * @param pool the pool which provides the output buffer
+	 * memory while output is pending
+	 * @param max_output the maximum size of the output buffer
+	 */
 	FullyBufferedSocket(SocketDescriptor _fd, EventLoop &_loop,
-			    size_t normal_size, size_t peak_size=0) noexcept
+			    SegmentPool &pool, size_t max_output) noexcept
 		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
+		 output(pool, max_output) {
 	}
 
 	using BufferedSocket::IsDefined;
@@ -48,6 +53,10 @@ private:
 	ssize_t DirectWrite(const void *data, size_t length) noexcept;
 
 protected:
+	bool IsOutputEmpty() const noexcept {
+		return output.empty();
+	}
+
 	/**
 	 * Send data from the output buffer to the socket.
 	 *
@@ -60,6 +69,14 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+	/**
+	 * The output buffer has been sent completely.  This can be
+	 * used to generate more output.  It is invoked from within
+	 * Flush(), which means the implementation must not destroy
+	 * this object.
+	 */
+	virtual void OnSocketOutputEmpty() noexcept {}
+
 	/* virtual methods from class SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
@@ -23,6 +23,10 @@
 #include "DeferEvent.hxx"
 #include "util/ScopeExit.hxx"
 
+#include <algorithm>
+
+constexpr std::chrono::seconds EventLoop::WHEEL_THRESHOLD;
+
 EventLoop::EventLoop(ThreadId _thread)
 	:SocketMonitor(*this),
 	 /* if this instance is hosted by an EventThread (no ThreadId
@@ -41,6 +45,7 @@ EventLoop::~EventLoop() noexcept
 {
 	assert(idle.empty());
 	assert(timers.empty());
+	assert(wheel.IsEmpty());
 }
 
 void
@@ -93,7 +98,10 @@ EventLoop::AddTimer(TimerEvent &t, std::chrono::steady_clock::duration d) noexce
 	assert(IsInside());
 
 	t.due = now + d;
-	timers.insert(t);
+	if (d >= WHEEL_THRESHOLD)
+		wheel.Insert(t);
+	else
+		timers.insert(t);
 	again = true;
 }
 
@@ -102,7 +110,10 @@ EventLoop::CancelTimer(TimerEvent &t) noexcept
 {
 	assert(IsInside());
 
-	timers.erase(timers.iterator_to(t));
+	if (t.timer_set_hook.is_linked())
+		timers.erase(timers.iterator_to(t));
+	else
+		wheel.Cancel(t);
 }
 
 inline std::chrono::steady_clock::duration
@@ -117,15 +128,22 @@ EventLoop::HandleTimers() noexcept
 
 		TimerEvent &t = *i;
 		timeout = t.due - now;
-		if (timeout > timeout.zero())
-			return timeout;
+		if (timeout > timeout.zero()) {
+			const auto wheel_timeout = wheel.Run(now, quit);
+			return wheel_timeout >= wheel_timeout.zero()
+				? std::min(timeout, wheel_timeout)
+				: timeout;
+		}
 
 		timers.erase(i);
 
 		t.Run();
 	}
 
-	return std::chrono::steady_clock::duration(-1);
+	if (quit)
+		return std::chrono::steady_clock::duration(-1);
+
+	return wheel.Run(now, quit);
 }
 
 /**
@@ -180,6 +198,7 @@ EventLoop::Run() noexcept
 
 		/* try to handle DeferEvents without WakeFD
 		   overhead */
+		bool has_yielded;
 		{
 			const std::lock_guard<Mutex> lock(mutex);
 			HandleDeferred();
@@ -190,11 +209,15 @@ EventLoop::Run() noexcept
 				   the IdleMonitors may have added a
 				   new timeout */
 				continue;
+
+			has_yielded = !yielded.empty();
 		}
 
-		/* wait for new event */
+		/* wait for new event; don't block if there are
+		   yielded DeferEvents */
 
-		poll_group.ReadEvents(poll_result, ExportTimeoutMS(timeout));
+		poll_group.ReadEvents(poll_result,
+				      has_yielded ? 0 : ExportTimeoutMS(timeout));
 
 		now = std::chrono::steady_clock::now();
 
@@ -217,6 +240,15 @@ EventLoop::Run() noexcept
 
 		poll_result.Reset();
 
+		/* now that the sockets have been handled, the yielded
+		   DeferEvents may run again */
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			for (auto &d : yielded)
+				d.yielded = false;
+			deferred.splice(deferred.end(), yielded);
+		}
+
 	} while (!quit);
 
 #ifndef NDEBUG
@@ -247,12 +279,38 @@ EventLoop::AddDeferred(DeferEvent &d) noexcept
 		wake_fd.Write();
 }
 
+void
+EventLoop::AddYield(DeferEvent &d) noexcept
+{
+	bool must_wake;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		if (d.IsPending())
+			return;
+
+		must_wake = !busy && deferred.empty() && yielded.empty();
+
+		yielded.push_back(d);
+		d.yielded = true;
+	}
+
+	if (must_wake)
+		wake_fd.Write();
+}
+
 void
 EventLoop::RemoveDeferred(DeferEvent &d) noexcept
 {
 	const std::lock_guard<Mutex> protect(mutex);
 
-	if (d.IsPending())
+	if (!d.IsPending())
+		return;
+
+	if (d.yielded) {
+		yielded.erase(yielded.iterator_to(d));
+		d.yielded = false;
+	} else
 		deferred.erase(deferred.iterator_to(d));
 }
 
@@ -28,6 +28,7 @@
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
 #include "TimerEvent.hxx"
+#include "TimerWheel.hxx"
 #include "IdleMonitor.hxx"
 #include "DeferEvent.hxx"
 
@@ -83,8 +84,22 @@ class EventLoop final : SocketMonitor
 				       boost::intrusive::constant_time_size<false>> DeferredList;
 	DeferredList deferred;
 
+	/**
+	 * DeferEvents scheduled with AddYield().  They are moved to
+	 * #deferred after the sockets have been polled.
+	 *
+	 * Protected with #mutex.
+	 */
+	DeferredList yielded;
+
 	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
+	/**
+	 * Timers of at least #WHEEL_THRESHOLD; the others are in
+	 * #timers.
+	 */
+	TimerWheel wheel{now};
+
 	/**
 	 * Is this #EventLoop alive, i.e. can events be scheduled?
 	 * This is used by BlockingCall() to determine whether
@@ -118,6 +133,12 @@ class EventLoop final : SocketMonitor
 	ThreadId thread = ThreadId::Null();
 
 public:
+	/**
+	 * Timeouts of at least this duration are managed by the
+	 * (coarse) #TimerWheel instead of the (precise) #TimerSet.
+	 */
+	static constexpr std::chrono::seconds WHEEL_THRESHOLD{1};
+
 	/**
 	 * Throws on error.
 	 */
@@ -178,6 +199,17 @@ public:
 	 */
 	void AddDeferred(DeferEvent &d) noexcept;
 
+	/**
+	 * Like AddDeferred(), but the call happens only after the
+	 * sockets have been polled (without blocking), i.e. after
+	 * other pending I/O events have been handled.  This allows
+	 * splitting a long-running job into slices without starving
+	 * other clients.
+	 *
+	 * This method is thread-safe.
+	 */
+	void AddYield(DeferEvent &d) noexcept;
+
 	/**
 	 * Cancel a pending call to DeferEvent::RunDeferred().
 	 * However after returning, the call may still be running.
@@ -22,6 +22,12 @@
 
 #include "config.h"
 
+#ifdef USE_IO_URING
+#include "PollGroupUring.hxx"
+typedef PollResultGeneric PollResult;
+typedef PollGroupUring PollGroup;
+#endif
+
 #ifdef USE_EPOLL
 #include "PollGroupEpoll.hxx"
 typedef PollResultEpoll PollResult;
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#ifdef USE_IO_URING
+#include "PollGroupUring.hxx"
+
+#include <errno.h>
+
+/**
+ * The user_data value of requests whose completions are ignored.
+ */
+static constexpr uint64_t IGNORE_USER_DATA = ~uint64_t(0);
+
+static constexpr uint64_t
+MakeUserData(int fd, uint32_t generation) noexcept
+{
+	return (uint64_t(generation) << 32) | uint32_t(fd);
+}
+
+PollGroupUring::PollGroupUring()
+	:ring(256)
+{
+}
+
+struct io_uring_sqe &
+PollGroupUring::GetSqe() noexcept
+{
+	auto *sqe = ring.GetSqe();
+	if (sqe == nullptr) {
+		/* the submission queue is full; submit it now */
+		ring.Enter(0, 0);
+		sqe = ring.GetSqe();
+	}
+
+	return *sqe;
+}
+
+void
+PollGroupUring::Arm(int fd, Item &item) noexcept
+{
+	auto &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_ADD;
+	sqe.fd = fd;
+	sqe.poll_events = item.events;
+	sqe.user_data = MakeUserData(fd, item.generation);
+
+	item.armed = true;
+}
+
+void
+PollGroupUring::Disarm(int fd, Item &item) noexcept
+{
+	if (!item.armed)
+		return;
+
+	auto &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_REMOVE;
+	sqe.fd = -1;
+	sqe.addr = MakeUserData(fd, item.generation);
+	sqe.user_data = IGNORE_USER_DATA;
+
+	item.armed = false;
+}
+
+void
+PollGroupUring::ReadEvents(PollResultGeneric &result, int timeout_ms) noexcept
+{
+	for (int fd : unarmed) {
+		auto i = items.find(fd);
+		if (i != items.end() && !i->second.armed)
+			Arm(fd, i->second);
+	}
+
+	unarmed.clear();
+
+	struct __kernel_timespec ts;
+	if (timeout_ms > 0) {
+		/* this timeout request completes after the given
+		   time or after one other completion, whichever comes
+		   first */
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+
+		auto &sqe = GetSqe();
+		sqe.opcode = IORING_OP_TIMEOUT;
+		sqe.fd = -1;
+		sqe.addr = (uint64_t)&ts;
+		sqe.len = 1;
+		sqe.off = 1;
+		sqe.user_data = IGNORE_USER_DATA;
+	}
+
+	ring.Enter(timeout_ms != 0 ? 1 : 0, IORING_ENTER_GETEVENTS);
+
+	const struct io_uring_cqe *cqe;
+	while ((cqe = ring.PeekCqe()) != nullptr) {
+		const uint64_t user_data = cqe->user_data;
+		const int res = cqe->res;
+		ring.SeenCqe();
+
+		if (user_data == IGNORE_USER_DATA)
+			continue;
+
+		const int fd = int(uint32_t(user_data));
+		auto i = items.find(fd);
+		if (i == items.end() ||
+		    i->second.generation != uint32_t(user_data >> 32))
+			/* a completion of an obsolete registration */
+			continue;
+
+		auto &item = i->second;
+		item.armed = false;
+		unarmed.push_back(fd);
+
+		if (res == -ECANCELED)
+			continue;
+
+		result.Add(res < 0 ? ERROR : unsigned(res), item.obj);
+	}
+}
+
+bool
+PollGroupUring::Add(int fd, unsigned events, void *obj) noexcept
+{
+	auto result = items.emplace(fd, Item{obj, events, next_generation++,
+				false});
+	if (!result.second)
+		return false;
+
+	unarmed.push_back(fd);
+	return true;
+}
+
+bool
+PollGroupUring::Modify(int fd, unsigned events, void *obj) noexcept
+{
+	auto i = items.find(fd);
+	if (i == items.end())
+		return false;
+
+	auto &item = i->second;
+	Disarm(fd, item);
+
+	item.obj = obj;
+	item.events = events;
+	item.generation = next_generation++;
+	unarmed.push_back(fd);
+	return true;
+}
+
+bool
+PollGroupUring::Remove(int fd) noexcept
+{
+	auto i = items.find(fd);
+	if (i == items.end())
+		return false;
+
+	Disarm(fd, i->second);
+	items.erase(i);
+	return true;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EVENT_POLLGROUP_URING_HXX
+#define MPD_EVENT_POLLGROUP_URING_HXX
+
+#include "PollResultGeneric.hxx"
+#include "system/IoUring.hxx"
+
+#include <vector>
+#include <unordered_map>
+
+#include <stdint.h>
+#include <sys/poll.h>
+
+/**
+ * A #PollGroup implementation based on Linux io_uring.  Each
+ * registered file descriptor has a (one-shot) IORING_OP_POLL_ADD
+ * request, which is re-armed after it has completed.  All changes
+ * (registering, modifying, removing and re-arming) are collected and
+ * submitted with the io_uring_enter() call which waits for the next
+ * events, i.e. a loop iteration which handles hundreds of sockets
+ * costs one system call instead of one epoll_ctl() per socket.
+ */
+class PollGroupUring
+{
+	struct Item
+	{
+		void *obj;
+
+		unsigned events;
+
+		/**
+		 * Distinguishes this registration from earlier ones
+		 * of the same file descriptor, whose completions may
+		 * still be in the queue.
+		 */
+		uint32_t generation;
+
+		/**
+		 * Is a IORING_OP_POLL_ADD request pending?
+		 */
+		bool armed;
+	};
+
+	IoUring ring;
+
+	std::unordered_map<int, Item> items;
+
+	/**
+	 * File descriptors which need a new IORING_OP_POLL_ADD
+	 * request.  May contain duplicates and stale entries.
+	 */
+	std::vector<int> unarmed;
+
+	uint32_t next_generation = 0;
+
+	PollGroupUring(PollGroupUring &) = delete;
+	PollGroupUring &operator=(PollGroupUring &) = delete;
+public:
+	static constexpr unsigned READ = POLLIN;
+	static constexpr unsigned WRITE = POLLOUT;
+	static constexpr unsigned ERROR = POLLERR;
+	static constexpr unsigned HANGUP = POLLHUP;
+
+	PollGroupUring();
+
+	void ReadEvents(PollResultGeneric &result, int timeout_ms) noexcept;
+	bool Add(int fd, unsigned events, void *obj) noexcept;
+	bool Modify(int fd, unsigned events, void *obj) noexcept;
+	bool Remove(int fd) noexcept;
+
+	bool Abandon(int fd) noexcept {
+		/* unlike epoll, a pending poll request keeps the file
+		   open, so it must be canceled explicitly */
+		return Remove(fd);
+	}
+
+private:
+	/**
+	 * Obtain a submission queue entry; if the queue is full, it
+	 * is submitted first.
+	 */
+	struct io_uring_sqe &GetSqe() noexcept;
+
+	void Arm(int fd, Item &item) noexcept;
+
+	/**
+	 * Cancel the pending IORING_OP_POLL_ADD request of the
+	 * given registration.
+	 */
+	void Disarm(int fd, Item &item) noexcept;
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "util/BindMethod.hxx"
 
 #include <boost/intrusive/set_hook.hpp>
+#include <boost/intrusive/list_hook.hpp>
 
 #include <chrono>
 
@@ -32,16 +33,24 @@ class EventLoop;
  * This class invokes a callback function after a certain amount of
  * time.  Use Schedule() to start the timer or Cancel() to cancel it.
  *
+ * Timeouts of at least EventLoop::WHEEL_THRESHOLD are managed by a
+ * #TimerWheel; they may be invoked up to TimerWheel::RESOLUTION
+ * late.  Shorter timeouts are precise.
+ *
  * This class is not thread-safe, all methods must be called from the
  * thread that runs the #EventLoop, except where explicitly documented
  * as thread-safe.
  */
 class TimerEvent final {
 	friend class EventLoop;
+	friend class TimerWheel;
 
 	typedef boost::intrusive::set_member_hook<> TimerSetHook;
 	TimerSetHook timer_set_hook;
 
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> TimerWheelHook;
+	TimerWheelHook timer_wheel_hook;
+
 	EventLoop &loop;
 
 	typedef BoundMethod<void()> Callback;
@@ -67,7 +76,8 @@ public:
 	}
 
 	bool IsActive() const noexcept {
-		return timer_set_hook.is_linked();
+		return timer_set_hook.is_linked() ||
+			timer_wheel_hook.is_linked();
 	}
 
 	void Schedule(std::chrono::steady_clock::duration d) noexcept;
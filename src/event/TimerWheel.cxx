@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "TimerWheel.hxx"
+
+#include <algorithm>
+
+constexpr size_t TimerWheel::N_BUCKETS;
+constexpr std::chrono::milliseconds TimerWheel::RESOLUTION;
+
+TimerWheel::TimerWheel(TimePoint now) noexcept
+	:next_tick(TickFloor(now))
+{
+}
+
+void
+TimerWheel::Insert(TimerEvent &t) noexcept
+{
+	/* never put it in a bucket which has already been handled,
+	   or it would wait for a whole revolution */
+	const auto tick = std::max(TickCeil(t.due), next_tick);
+	GetBucket(tick).push_back(t);
+	++n_timers;
+}
+
+void
+TimerWheel::Cancel(TimerEvent &t) noexcept
+{
+	assert(n_timers > 0);
+
+	t.timer_wheel_hook.unlink();
+	--n_timers;
+}
+
+TimerWheel::Duration
+TimerWheel::GetTimeout(TimePoint now) const noexcept
+{
+	if (IsEmpty())
+		return Duration(-1);
+
+	/* find the next non-empty bucket; it may contain only timers
+	   of a later revolution, but then Run() will simply look
+	   again */
+	for (size_t i = 0; i < N_BUCKETS; ++i) {
+		const auto tick = next_tick + i;
+		if (!buckets[tick % N_BUCKETS].empty()) {
+			const auto timeout = TickToTime(tick) - now;
+			return std::max(timeout, Duration::zero());
+		}
+	}
+
+	/* can't happen, because we're not empty; all timers must be
+	   in some bucket (or in the "ready" list, but that is only
+	   used inside Run()) */
+	return Duration::zero();
+}
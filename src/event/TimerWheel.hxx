@@ -0,0 +1,187 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_TIMER_WHEEL_HXX
+#define MPD_EVENT_TIMER_WHEEL_HXX
+
+#include "TimerEvent.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <array>
+#include <chrono>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A hashed timer wheel for coarse #TimerEvent instances; this is
+ * used by #EventLoop for long timeouts (e.g. client connection
+ * timeouts), which would otherwise need an O(log n) tree
+ * operation on each Schedule() and Cancel().  Scheduling and
+ * canceling is O(1).
+ *
+ * Timers are sorted into buckets with a resolution of
+ * #RESOLUTION; they may fire up to that much later than
+ * requested, but never earlier.  Timers due after more than one
+ * revolution remain in their bucket, and are skipped until their
+ * round has come.
+ */
+class TimerWheel final {
+public:
+	using Duration = std::chrono::steady_clock::duration;
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	static constexpr size_t N_BUCKETS = 1024;
+
+	/**
+	 * The duration of one bucket.
+	 */
+	static constexpr std::chrono::milliseconds RESOLUTION{64};
+
+private:
+	typedef boost::intrusive::list<TimerEvent,
+				       boost::intrusive::member_hook<TimerEvent,
+								     TimerEvent::TimerWheelHook,
+								     &TimerEvent::timer_wheel_hook>,
+				       boost::intrusive::constant_time_size<false>> List;
+
+	std::array<List, N_BUCKETS> buckets;
+
+	/**
+	 * The number of timers in this wheel.
+	 */
+	size_t n_timers = 0;
+
+	/**
+	 * The next tick (i.e. the bucket end time divided by
+	 * #RESOLUTION) which has not yet been handled by Run().
+	 */
+	uint_least64_t next_tick;
+
+public:
+	explicit TimerWheel(TimePoint now) noexcept;
+
+	~TimerWheel() noexcept {
+		assert(IsEmpty());
+	}
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	bool IsEmpty() const noexcept {
+		return n_timers == 0;
+	}
+
+	/**
+	 * Add a timer.  Its TimerEvent::due attribute must be set
+	 * already.
+	 */
+	void Insert(TimerEvent &t) noexcept;
+
+	/**
+	 * Remove a timer which was previously added with Insert().
+	 */
+	void Cancel(TimerEvent &t) noexcept;
+
+	/**
+	 * Invoke all expired timers.
+	 *
+	 * @param quit if this becomes true (e.g. because a callback
+	 * requested it), stop invoking timers
+	 * @return the duration until the next bucket containing
+	 * timers needs to be handled, or a negative value if there
+	 * are no timers
+	 */
+	template<typename Q>
+	Duration Run(TimePoint now, const Q &quit) noexcept {
+		const auto now_tick = TickFloor(now);
+		while (next_tick <= now_tick && !IsEmpty() && !quit) {
+			RunBucket(next_tick, now, quit);
+
+			if (quit)
+				break;
+
+			++next_tick;
+		}
+
+		if (next_tick <= now_tick)
+			/* nothing left to do in the skipped ticks
+			   (or all timers are gone) */
+			next_tick = now_tick + 1;
+
+		return GetTimeout(now);
+	}
+
+private:
+	static uint_least64_t TickFloor(TimePoint t) noexcept {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count()
+			/ RESOLUTION.count();
+	}
+
+	static uint_least64_t TickCeil(TimePoint t) noexcept {
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch() + RESOLUTION - std::chrono::nanoseconds(1));
+		return ms.count() / RESOLUTION.count();
+	}
+
+	static TimePoint TickToTime(uint_least64_t tick) noexcept {
+		return TimePoint(std::chrono::duration_cast<Duration>(tick * RESOLUTION));
+	}
+
+	List &GetBucket(uint_least64_t tick) noexcept {
+		return buckets[tick % N_BUCKETS];
+	}
+
+	template<typename Q>
+	void RunBucket(uint_least64_t tick, TimePoint now,
+		       const Q &quit) noexcept {
+		auto &bucket = GetBucket(tick);
+
+		/* first move all expired timers to a separate list,
+		   because callbacks may schedule new timers in this
+		   bucket */
+		List ready;
+		for (auto i = bucket.begin(); i != bucket.end();) {
+			auto &t = *i++;
+			if (t.due <= now)
+				ready.splice(ready.end(), bucket,
+					     bucket.iterator_to(t));
+		}
+
+		while (!ready.empty()) {
+			if (quit) {
+				/* try again in the next Run() call */
+				bucket.splice(bucket.begin(), ready);
+				break;
+			}
+
+			auto &t = ready.front();
+			ready.pop_front();
+			--n_timers;
+
+			t.Run();
+		}
+	}
+
+	Duration GetTimeout(TimePoint now) const noexcept;
+};
+
+#endif
@@ -19,6 +19,28 @@
 
 #include "Filter.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+bool
+Filter::FilterInPlace(WritableBuffer<void>)
+{
+	return false;
+}
+
+ConstBuffer<void>
+Filter::FilterPrivatePCM(WritableBuffer<void> src)
+{
+	if (FilterInPlace(src))
+		return {src.data, src.size};
+
+	return FilterPCM({src.data, src.size});
+}
+
+ConstBuffer<void>
+Filter::FilterPCMWithGain(ConstBuffer<void>, unsigned)
+{
+	return nullptr;
+}
 
 ConstBuffer<void>
 Filter::Flush()
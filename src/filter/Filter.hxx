@@ -25,6 +25,7 @@
 #include <assert.h>
 
 template<typename T> struct ConstBuffer;
+template<typename T> struct WritableBuffer;
 
 class Filter {
 protected:
@@ -63,6 +64,58 @@ public:
 	 */
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src) = 0;
 
+	/**
+	 * Attempt to filter the given buffer in place, without
+	 * allocating a destination buffer.  This is only possible if
+	 * the output format equals the input format.  The default
+	 * implementation always fails.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @param data a buffer owned by the caller which may be
+	 * modified
+	 * @return true on success, false if this filter cannot do
+	 * that (and #data has not been modified); the caller shall
+	 * then fall back to FilterPCM()
+	 */
+	virtual bool FilterInPlace(WritableBuffer<void> data);
+
+	/**
+	 * Like FilterPCM(), but this filter may modify the input
+	 * buffer, which is owned by the caller.  This saves one
+	 * buffer (and one copy) for filters which support
+	 * FilterInPlace().
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return the destination buffer (which may be #src)
+	 */
+	virtual ConstBuffer<void> FilterPrivatePCM(WritableBuffer<void> src);
+
+	/**
+	 * If this filter currently does nothing but multiply all
+	 * samples with a constant factor, return it (#PCM_VOLUME_1
+	 * means 100%); -1 otherwise.  This allows a filter chain to
+	 * fuse it with the following filter (see
+	 * FilterPCMWithGain()).
+	 */
+	virtual int GetConstantGain() const noexcept {
+		return -1;
+	}
+
+	/**
+	 * Like FilterPCM(), but multiply the input with the given
+	 * volume level first, in the same pass over the data.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return the destination buffer or nullptr if this filter
+	 * cannot do that; the caller shall then fall back to calling
+	 * both filters separately
+	 */
+	virtual ConstBuffer<void> FilterPCMWithGain(ConstBuffer<void> src,
+						    unsigned volume);
+
 	/**
 	 * Flush pending data and return it.  This should be called
 	 * repepatedly until it returns nullptr.
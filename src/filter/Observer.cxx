@@ -28,6 +28,15 @@ class FilterObserver::PreparedProxy final : public PreparedFilter {
 	FilterObserver &observer;
 
 	std::unique_ptr<PreparedFilter> prepared_filter;
+
+	/**
+	 * The number of existing #Proxy instances.
+	 */
+	unsigned n_children = 0;
+
+	/**
+	 * The #Proxy instance which is currently in use.
+	 */
 	Proxy *child = nullptr;
 
 public:
@@ -37,15 +46,22 @@ public:
 		 prepared_filter(std::move(_prepared_filter)) {}
 
 	~PreparedProxy() {
-		assert(child == nullptr);
+		assert(n_children == 0);
 		assert(observer.proxy == this);
 
 		observer.proxy = nullptr;
 	}
 
-	void Clear(gcc_unused Proxy *_child) {
-		assert(child == _child);
-		child = nullptr;
+	void SetCurrent(Proxy *_child) noexcept {
+		child = _child;
+	}
+
+	void Clear(Proxy *_child) noexcept {
+		assert(n_children > 0);
+		--n_children;
+
+		if (child == _child)
+			child = nullptr;
 	}
 
 	Filter *Get();
@@ -72,6 +88,9 @@ public:
 	}
 
 	void Reset() noexcept override {
+		/* a cached instance is reset before it is used
+		   again */
+		parent.SetCurrent(this);
 		filter->Reset();
 	}
 
@@ -95,9 +114,8 @@ FilterObserver::PreparedProxy::Get()
 std::unique_ptr<Filter>
 FilterObserver::PreparedProxy::Open(AudioFormat &af)
 {
-	assert(child == nullptr);
-
 	auto c = std::make_unique<Proxy>(*this, prepared_filter->Open(af));
+	++n_children;
 	child = c.get();
 	return c;
 }
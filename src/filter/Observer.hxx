@@ -28,6 +28,10 @@ class Filter;
 /**
  * A helper class which observes calls to a #PreparedFilter and allows
  * the caller to access the #Filter instances created by it.
+ *
+ * Several instances may exist at a time (e.g. when filters are
+ * cached for different input formats); Get() returns the one which
+ * was most recently opened or reset.
  */
 class FilterObserver {
 	class PreparedProxy;
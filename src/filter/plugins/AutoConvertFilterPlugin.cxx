@@ -25,6 +25,7 @@
 #include "filter/FilterRegistry.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 
 #include <memory>
 
@@ -56,6 +57,10 @@ public:
 	}
 
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+
+	bool FilterInPlace(WritableBuffer<void> data) override {
+		return convert == nullptr && filter->FilterInPlace(data);
+	}
 };
 
 class PreparedAutoConvertFilter final : public PreparedFilter {
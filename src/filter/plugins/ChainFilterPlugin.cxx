@@ -21,10 +21,13 @@
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "AudioFormat.hxx"
+#include "pcm/Volume.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/StringBuffer.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <iterator>
 #include <memory>
 #include <list>
 
@@ -65,6 +68,7 @@ public:
 	/* virtual methods from class Filter */
 	void Reset() noexcept override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+	ConstBuffer<void> FilterPrivatePCM(WritableBuffer<void> src) override;
 	ConstBuffer<void> Flush() override;
 
 private:
@@ -141,10 +145,26 @@ template<typename I>
 static ConstBuffer<void>
 ApplyFilterChain(I begin, I end, ConstBuffer<void> src)
 {
-	for (auto i = begin; i != end; ++i)
+	for (auto i = begin; i != end; ++i) {
+		const int gain = i->filter->GetConstantGain();
+		if (gain >= 0 && gain != int(PCM_VOLUME_1) &&
+		    std::next(i) != end) {
+			/* a constant gain stage: try to fuse it with
+			   the following filter, to save one pass over
+			   the data */
+			auto fused = std::next(i)->filter->FilterPCMWithGain(src,
+									     gain);
+			if (!fused.IsNull()) {
+				src = fused;
+				++i;
+				continue;
+			}
+		}
+
 		/* feed the output of the previous filter as input
 		   into the current one */
 		src = i->filter->FilterPCM(src);
+	}
 
 	return src;
 }
@@ -158,6 +178,39 @@ ChainFilter::FilterPCM(ConstBuffer<void> src)
 	return ApplyFilterChain(children.begin(), children.end(), src);
 }
 
+ConstBuffer<void>
+ChainFilter::FilterPrivatePCM(WritableBuffer<void> src)
+{
+	RewindFlush();
+
+	/* let the leading filters modify the caller's buffer until
+	   one needs a buffer of its own */
+	const auto end = children.end();
+	auto i = children.begin();
+	while (i != end) {
+		const int gain = i->filter->GetConstantGain();
+		if (gain >= 0 && gain != int(PCM_VOLUME_1) &&
+		    std::next(i) != end) {
+			/* fusing is cheaper than an in-place pass
+			   (see ApplyFilterChain()) */
+			auto &next = *std::next(i)->filter;
+			auto fused = next.FilterPCMWithGain({src.data, src.size},
+							    gain);
+			if (!fused.IsNull())
+				return ApplyFilterChain(std::next(i, 2), end,
+							fused);
+		}
+
+		if (!i->filter->FilterInPlace(src))
+			break;
+
+		++i;
+	}
+
+	return ApplyFilterChain(i, end, ConstBuffer<void>(src.data,
+							  src.size));
+}
+
 ConstBuffer<void>
 ChainFilter::Flush()
 {
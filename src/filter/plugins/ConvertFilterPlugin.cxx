@@ -20,9 +20,12 @@
 #include "ConvertFilterPlugin.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
-#include "pcm/PcmConvert.hxx"
+#include "SharedConvert.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/Volume.hxx"
 #include "util/Manual.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "AudioFormat.hxx"
 
 #include <stdexcept>
@@ -37,14 +40,23 @@ class ConvertFilter final : public Filter {
 	 */
 	AudioFormat in_audio_format;
 
+	const PcmResamplerProfile *const resampler_profile;
+
 	/**
 	 * This object is only "open" if #in_audio_format !=
-	 * #out_audio_format.
+	 * #out_audio_format.  Outputs resampling the same stream to
+	 * the same format share one resampler.
+	 */
+	SharedPcmConvert state;
+
+	/**
+	 * The destination buffer for FilterPCMWithGain().
 	 */
-	PcmConvert state;
+	PcmBuffer gain_buffer;
 
 public:
-	ConvertFilter(const AudioFormat &audio_format);
+	ConvertFilter(const AudioFormat &audio_format,
+		      const PcmResamplerProfile *_resampler_profile);
 	~ConvertFilter();
 
 	void Set(const AudioFormat &_out_audio_format);
@@ -55,6 +67,13 @@ public:
 	}
 
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+	ConstBuffer<void> FilterPCMWithGain(ConstBuffer<void> src,
+					    unsigned volume) override;
+
+	bool FilterInPlace(WritableBuffer<void>) override {
+		/* nothing to do if there is no conversion */
+		return !IsActive();
+	}
 
 	ConstBuffer<void> Flush() override {
 		return IsActive()
@@ -69,7 +88,12 @@ private:
 };
 
 class PreparedConvertFilter final : public PreparedFilter {
+	const PcmResamplerProfile *const resampler_profile;
+
 public:
+	explicit PreparedConvertFilter(const PcmResamplerProfile *_resampler_profile) noexcept
+		:resampler_profile(_resampler_profile) {}
+
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
 
@@ -92,13 +116,15 @@ ConvertFilter::Set(const AudioFormat &_out_audio_format)
 		/* optimized special case: no-op */
 		return;
 
-	state.Open(in_audio_format, _out_audio_format);
+	state.Open(in_audio_format, _out_audio_format, resampler_profile);
 
 	out_audio_format = _out_audio_format;
 }
 
-ConvertFilter::ConvertFilter(const AudioFormat &audio_format)
-	:Filter(audio_format), in_audio_format(audio_format)
+ConvertFilter::ConvertFilter(const AudioFormat &audio_format,
+			     const PcmResamplerProfile *_resampler_profile)
+	:Filter(audio_format), in_audio_format(audio_format),
+	 resampler_profile(_resampler_profile)
 {
 }
 
@@ -107,7 +133,8 @@ PreparedConvertFilter::Open(AudioFormat &audio_format)
 {
 	assert(audio_format.IsValid());
 
-	return std::make_unique<ConvertFilter>(audio_format);
+	return std::make_unique<ConvertFilter>(audio_format,
+					       resampler_profile);
 }
 
 ConvertFilter::~ConvertFilter()
@@ -129,17 +156,35 @@ ConvertFilter::FilterPCM(ConstBuffer<void> src)
 		: src;
 }
 
+ConstBuffer<void>
+ConvertFilter::FilterPCMWithGain(ConstBuffer<void> src, unsigned volume)
+{
+	/* only a plain sample format conversion can be fused with
+	   the volume; resampling and channel conversion keep their
+	   own pass */
+	if (!IsActive() ||
+	    in_audio_format.sample_rate != out_audio_format.sample_rate ||
+	    in_audio_format.channels != out_audio_format.channels)
+		return nullptr;
+
+	return pcm_volume_convert(gain_buffer,
+				  in_audio_format.format,
+				  out_audio_format.format,
+				  src, volume);
+}
+
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept
+convert_filter_prepare(const PcmResamplerProfile *resampler_profile) noexcept
 {
-	return std::make_unique<PreparedConvertFilter>();
+	return std::make_unique<PreparedConvertFilter>(resampler_profile);
 }
 
 Filter *
 convert_filter_new(const AudioFormat in_audio_format,
 		   const AudioFormat out_audio_format)
 {
-	std::unique_ptr<ConvertFilter> filter(new ConvertFilter(in_audio_format));
+	std::unique_ptr<ConvertFilter> filter(new ConvertFilter(in_audio_format,
+								nullptr));
 	filter->Set(out_audio_format);
 	return filter.release();
 }
@@ -25,9 +25,14 @@
 class PreparedFilter;
 class Filter;
 struct AudioFormat;
+struct PcmResamplerProfile;
 
+/**
+ * @param resampler_profile the resampler profile (see
+ * pcm_resampler_find()); nullptr selects the default profile
+ */
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept;
+convert_filter_prepare(const PcmResamplerProfile *resampler_profile=nullptr) noexcept;
 
 Filter *
 convert_filter_new(AudioFormat in_audio_format,
@@ -26,7 +26,9 @@
 #include "AudioFormat.hxx"
 #include "AudioCompress/compress.h"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 
+#include <assert.h>
 #include <string.h>
 
 class NormalizeFilter final : public Filter {
@@ -45,6 +47,10 @@ public:
 
 	/* virtual methods from class Filter */
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+	bool FilterInPlace(WritableBuffer<void> data) override;
+
+private:
+	void Process(WritableBuffer<void> data) noexcept;
 };
 
 class PreparedNormalizeFilter final : public PreparedFilter {
@@ -62,21 +68,69 @@ normalize_filter_init(gcc_unused const ConfigBlock &block)
 std::unique_ptr<Filter>
 PreparedNormalizeFilter::Open(AudioFormat &audio_format)
 {
-	audio_format.format = SampleFormat::S16;
+	switch (audio_format.format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		/* supported natively, no conversion needed */
+		break;
+
+	default:
+		audio_format.format = SampleFormat::S16;
+		break;
+	}
 
 	return std::make_unique<NormalizeFilter>(audio_format);
 }
 
+inline void
+NormalizeFilter::Process(WritableBuffer<void> data) noexcept
+{
+	switch (out_audio_format.format) {
+	case SampleFormat::S16:
+		Compressor_Process_int16(compressor, (int16_t *)data.data,
+					 data.size / sizeof(int16_t));
+		break;
+
+	case SampleFormat::S24_P32:
+		Compressor_Process_int24(compressor, (int32_t *)data.data,
+					 data.size / sizeof(int32_t));
+		break;
+
+	case SampleFormat::S32:
+		Compressor_Process_int32(compressor, (int32_t *)data.data,
+					 data.size / sizeof(int32_t));
+		break;
+
+	case SampleFormat::FLOAT:
+		Compressor_Process_float(compressor, (float *)data.data,
+					 data.size / sizeof(float));
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+}
+
 ConstBuffer<void>
 NormalizeFilter::FilterPCM(ConstBuffer<void> src)
 {
-	int16_t *dest = (int16_t *)buffer.Get(src.size);
+	void *dest = buffer.Get(src.size);
 	memcpy(dest, src.data, src.size);
 
-	Compressor_Process_int16(compressor, dest, src.size / 2);
+	Process({dest, src.size});
 	return { (const void *)dest, src.size };
 }
 
+bool
+NormalizeFilter::FilterInPlace(WritableBuffer<void> data)
+{
+	Process(data);
+	return true;
+}
+
 const FilterPlugin normalize_filter_plugin = {
 	"normalize",
 	normalize_filter_init,
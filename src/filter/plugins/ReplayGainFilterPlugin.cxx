@@ -26,6 +26,7 @@
 #include "mixer/MixerControl.hxx"
 #include "pcm/Volume.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -77,7 +78,7 @@ public:
 		 mixer(_mixer), base(_base) {
 		info.Clear();
 
-		pv.Open(out_audio_format.format);
+		pv.Open(out_audio_format.format, out_audio_format.channels);
 	}
 
 	void SetInfo(const ReplayGainInfo *_info) {
@@ -109,6 +110,7 @@ public:
 
 	/* virtual methods from class Filter */
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+	bool FilterInPlace(WritableBuffer<void> data) override;
 };
 
 class PreparedReplayGainFilter final : public PreparedFilter {
@@ -191,6 +193,14 @@ ReplayGainFilter::FilterPCM(ConstBuffer<void> src)
 		: pv.Apply(src);
 }
 
+bool
+ReplayGainFilter::FilterInPlace(WritableBuffer<void> data)
+{
+	if (mixer == nullptr)
+		pv.ApplyInPlace(data);
+	return true;
+}
+
 void
 replay_gain_filter_set_mixer(PreparedFilter &_filter, Mixer *mixer,
 			     unsigned base)
@@ -47,44 +47,22 @@
 #include "filter/Prepared.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmBuffer.hxx"
-#include "pcm/Silence.hxx"
+#include "pcm/ChannelMatrix.hxx"
 #include "util/StringStrip.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/ConstBuffer.hxx"
-#include "util/WritableBuffer.hxx"
 
 #include <algorithm>
 #include <array>
 
-#include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 class RouteFilter final : public Filter {
 	/**
-	 * The set of copy operations to perform on each sample
-	 * The index is an output channel to use, the value is
-	 * a corresponding input channel from which to take the
-	 * data. A -1 means "no source"
+	 * The copy operations, compiled for the sample format.
 	 */
-	const std::array<int8_t, MAX_CHANNELS> sources;
-
-	/**
-	 * The actual input format of our signal, once opened
-	 */
-	const AudioFormat input_format;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * input buffer
-	 */
-	const size_t input_frame_size;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * output buffer
-	 */
-	size_t output_frame_size;
+	PcmChannelMixer mixer;
 
 	/**
 	 * The output buffer used last time around, can be reused if the size doesn't differ.
@@ -93,7 +71,7 @@ class RouteFilter final : public Filter {
 
 public:
 	RouteFilter(const AudioFormat &audio_format, unsigned out_channels,
-		    const std::array<int8_t, MAX_CHANNELS> &_sources);
+		    const std::array<int8_t, MAX_CHANNELS> &sources);
 
 	/* virtual methods from class Filter */
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
@@ -204,16 +182,16 @@ route_filter_init(const ConfigBlock &block)
 
 RouteFilter::RouteFilter(const AudioFormat &audio_format,
 			 unsigned out_channels,
-			 const std::array<int8_t, MAX_CHANNELS> &_sources)
-	:Filter(audio_format), sources(_sources), input_format(audio_format),
-	 input_frame_size(input_format.GetFrameSize())
+			 const std::array<int8_t, MAX_CHANNELS> &sources)
+	:Filter(audio_format)
 {
 	// Decide on an output format which has enough channels,
 	// and is otherwise identical
 	out_audio_format.channels = out_channels;
 
-	// Precalculate this simple value, to speed up allocation later
-	output_frame_size = out_audio_format.GetFrameSize();
+	mixer.Open(audio_format.format,
+		   PcmChannelMatrix::Route(audio_format.channels, out_channels,
+					   &sources.front()));
 }
 
 std::unique_ptr<Filter>
@@ -226,51 +204,7 @@ PreparedRouteFilter::Open(AudioFormat &audio_format)
 ConstBuffer<void>
 RouteFilter::FilterPCM(ConstBuffer<void> src)
 {
-	size_t number_of_frames = src.size / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
-
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src.data;
-
-	// Grow our reusable buffer, if needed, and set the moving pointer
-	const size_t result_size = number_of_frames * output_frame_size;
-	void *const result = output_buffer.Get(result_size);
-
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination = (uint8_t *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned c = 0; c < out_audio_format.channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				PcmSilence({chan_destination, bytes_per_frame_per_channel},
-					   input_format.format);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
-	}
-
-	// Here it is, ladies and gentlemen! Rerouted data!
-	return { result, result_size };
+	return mixer.Apply(output_buffer, src);
 }
 
 const FilterPlugin route_filter_plugin = {
@@ -0,0 +1,399 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedConvert.hxx"
+#include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <deque>
+#include <list>
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+struct SharedPcmConvert::Group {
+	/**
+	 * The maximum number of blocks kept for instances which lag
+	 * behind.  Outputs which fall back further than this detach
+	 * from the group.
+	 */
+	static constexpr size_t MAX_ENTRIES = 64;
+
+	const AudioFormat src_format, dest_format;
+
+	const PcmResamplerProfile *const resampler_profile;
+
+	/**
+	 * The number of attached #SharedPcmConvert instances;
+	 * protected by #registry_mutex.
+	 */
+	unsigned n_clients = 0;
+
+	/**
+	 * Protects all of the following attributes.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The number of instances in State::SYNCED.
+	 */
+	unsigned n_synced = 0;
+
+	PcmConvert convert;
+
+	struct Entry {
+		AllocatedArray<uint8_t> input, output;
+
+		Entry(ConstBuffer<void> _input, ConstBuffer<void> _output) noexcept
+			:input(_input.size), output(_output.size) {
+			std::copy_n((const uint8_t *)_input.data, _input.size,
+				    input.begin());
+			std::copy_n((const uint8_t *)_output.data,
+				    _output.size, output.begin());
+		}
+
+		gcc_pure
+		bool InputEquals(ConstBuffer<void> other) const noexcept {
+			return other.size == input.size() &&
+				memcmp(other.data, input.begin(),
+				       other.size) == 0;
+		}
+	};
+
+	/**
+	 * The most recent blocks of the stream: their input and the
+	 * converter's output.
+	 */
+	std::deque<Entry> entries;
+
+	/**
+	 * The sequence number of entries.front().
+	 */
+	uint64_t first_seq = 0;
+
+	Group(AudioFormat _src_format, AudioFormat _dest_format,
+	      const PcmResamplerProfile *_resampler_profile)
+		:src_format(_src_format), dest_format(_dest_format),
+		 resampler_profile(_resampler_profile) {
+		convert.Open(src_format, dest_format, resampler_profile);
+	}
+
+	~Group() noexcept {
+		convert.Close();
+	}
+
+	uint64_t GetNextSeq() const noexcept {
+		return first_seq + entries.size();
+	}
+
+	/**
+	 * Find the newest block with the given input.
+	 *
+	 * @return the sequence number or GetNextSeq() if there is no
+	 * match
+	 */
+	gcc_pure
+	uint64_t Find(ConstBuffer<void> src) const noexcept {
+		for (size_t i = entries.size(); i > 0; --i)
+			if (entries[i - 1].InputEquals(src))
+				return first_seq + i - 1;
+
+		return GetNextSeq();
+	}
+
+	/**
+	 * Start the stream over, resetting the converter's state.
+	 */
+	void Restart() noexcept {
+		convert.Reset();
+		first_seq = GetNextSeq();
+		entries.clear();
+	}
+
+	/**
+	 * Convert the next block of the stream.
+	 */
+	const Entry &Append(ConstBuffer<void> src) {
+		entries.emplace_back(src, convert.Convert(src));
+
+		if (entries.size() > MAX_ENTRIES) {
+			entries.pop_front();
+			++first_seq;
+		}
+
+		return entries.back();
+	}
+};
+
+static Mutex registry_mutex;
+static std::list<SharedPcmConvert::Group> *registry;
+
+void
+SharedPcmConvert::Open(AudioFormat _src_format, AudioFormat _dest_format,
+		       const PcmResamplerProfile *_resampler_profile)
+{
+	assert(group == nullptr);
+	assert(!own_open);
+
+	src_format = _src_format;
+	dest_format = _dest_format;
+	resampler_profile = _resampler_profile;
+
+	if (src_format.sample_rate == dest_format.sample_rate) {
+		/* no resampler, nothing expensive to share */
+		state = State::PRIVATE;
+		OpenOwn();
+		return;
+	}
+
+	const std::lock_guard<Mutex> protect(registry_mutex);
+
+	if (registry == nullptr)
+		registry = new std::list<Group>();
+
+	auto i = std::find_if(registry->begin(), registry->end(),
+			      [this](const Group &g){
+				      return g.src_format == src_format &&
+					      g.dest_format == dest_format &&
+					      g.resampler_profile == resampler_profile;
+			      });
+	if (i == registry->end()) {
+		registry->emplace_front(src_format, dest_format,
+					resampler_profile);
+		i = registry->begin();
+	}
+
+	group = &*i;
+	++group->n_clients;
+	state = State::UNSYNCED;
+}
+
+void
+SharedPcmConvert::Close() noexcept
+{
+	if (own_open) {
+		own.Close();
+		own_open = false;
+	}
+
+	if (group == nullptr)
+		return;
+
+	{
+		const std::lock_guard<Mutex> protect(group->mutex);
+		if (state == State::SYNCED)
+			--group->n_synced;
+	}
+
+	const std::lock_guard<Mutex> protect(registry_mutex);
+
+	if (--group->n_clients == 0) {
+		registry->remove_if([this](const Group &g){
+				return &g == group;
+			});
+
+		if (registry->empty()) {
+			delete registry;
+			registry = nullptr;
+		}
+	}
+
+	group = nullptr;
+}
+
+void
+SharedPcmConvert::OpenOwn()
+{
+	assert(!own_open);
+
+	own.Open(src_format, dest_format, resampler_profile);
+	own_open = true;
+}
+
+void
+SharedPcmConvert::Reset() noexcept
+{
+	if (own_open)
+		own.Reset();
+
+	if (group == nullptr)
+		return;
+
+	const std::lock_guard<Mutex> protect(group->mutex);
+	if (state == State::SYNCED)
+		--group->n_synced;
+
+	state = State::UNSYNCED;
+}
+
+inline ConstBuffer<void>
+SharedPcmConvert::Copy(ConstBuffer<void> src) noexcept
+{
+	void *dest = buffer.Get(src.size);
+	memcpy(dest, src.data, src.size);
+	return {dest, src.size};
+}
+
+inline ConstBuffer<void>
+SharedPcmConvert::ConvertShared(ConstBuffer<void> src)
+{
+	Group &g = *group;
+	const std::lock_guard<Mutex> protect(g.mutex);
+
+	if (state == State::SYNCED) {
+		if (position == g.GetNextSeq()) {
+			/* we're the first one to get here */
+			const auto &output = g.Append(src).output;
+			position = g.GetNextSeq();
+			return Copy({output.begin(), output.size()});
+		}
+
+		if (position >= g.first_seq &&
+		    g.entries[position - g.first_seq].InputEquals(src)) {
+			/* reuse a block converted by another
+			   instance */
+			const auto &output =
+				g.entries[position++ - g.first_seq].output;
+			return Copy({output.begin(), output.size()});
+		}
+
+		/* we have fallen too far behind, or our input
+		   differs */
+		--g.n_synced;
+		state = State::UNSYNCED;
+	}
+
+	assert(state == State::UNSYNCED);
+
+	uint64_t seq = g.Find(src);
+	if (seq != g.GetNextSeq()) {
+		/* (re)join the stream */
+		state = State::SYNCED;
+		++g.n_synced;
+		position = seq + 1;
+
+		const auto &output = g.entries[seq - g.first_seq].output;
+		return Copy({output.begin(), output.size()});
+	}
+
+	if (g.n_synced == 0) {
+		/* nobody else is using the shared converter; start a
+		   new stream */
+		g.Restart();
+
+		const auto &output = g.Append(src).output;
+		state = State::SYNCED;
+		++g.n_synced;
+		position = g.GetNextSeq();
+		return Copy({output.begin(), output.size()});
+	}
+
+	/* the other instances are playing something else; don't
+	   disturb them */
+	state = State::DETACHED;
+	return nullptr;
+}
+
+ConstBuffer<void>
+SharedPcmConvert::Convert(ConstBuffer<void> src)
+{
+	if (state != State::PRIVATE && state != State::DETACHED) {
+		auto result = ConvertShared(src);
+		if (state != State::DETACHED)
+			return result;
+	}
+
+	if (!own_open)
+		OpenOwn();
+
+	return own.Convert(src);
+}
+
+ConstBuffer<void>
+SharedPcmConvert::Flush()
+{
+	switch (state) {
+	case State::PRIVATE:
+	case State::DETACHED:
+		return own_open
+			? own.Flush()
+			: nullptr;
+
+	case State::SYNCED:
+		break;
+
+	case State::UNSYNCED:
+		return nullptr;
+	}
+
+	AllocatedArray<uint8_t> replay;
+
+	{
+		Group &g = *group;
+		const std::lock_guard<Mutex> protect(g.mutex);
+
+		if (g.n_synced == 1) {
+			/* we're the only one: drain the shared converter;
+			   the blocks in the history are now stale */
+			g.first_seq = g.GetNextSeq();
+			g.entries.clear();
+			position = g.GetNextSeq();
+
+			auto result = g.convert.Flush();
+			return result.IsNull()
+				? result
+				: Copy(result);
+		}
+
+		/* the shared stream continues for the others, so its
+		   converter must not be drained; instead, copy the
+		   most recent blocks of our input, and replay them
+		   into the private converter below */
+		--g.n_synced;
+		state = State::DETACHED;
+
+		size_t size = 0;
+		for (uint64_t seq = g.first_seq; seq < position; ++seq)
+			size += g.entries[seq - g.first_seq].input.size();
+
+		replay.ResizeDiscard(size);
+		uint8_t *p = replay.begin();
+		for (uint64_t seq = g.first_seq; seq < position; ++seq) {
+			const auto &input = g.entries[seq - g.first_seq].input;
+			p = std::copy(input.begin(), input.end(), p);
+		}
+	}
+
+	/* the resampler's memory is much shorter than the history,
+	   so after the replay, the private converter's state matches
+	   the shared one's at our position, and its tail is ours;
+	   the replayed output has already been delivered and is
+	   discarded */
+	if (own_open)
+		own.Reset();
+	else
+		OpenOwn();
+
+	if (!replay.empty())
+		own.Convert({replay.begin(), replay.size()});
+
+	return own.Flush();
+}
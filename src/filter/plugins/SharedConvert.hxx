@@ -0,0 +1,152 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_CONVERT_HXX
+#define MPD_SHARED_CONVERT_HXX
+
+#include "pcm/PcmConvert.hxx"
+#include "pcm/PcmBuffer.hxx"
+
+#include <assert.h>
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+struct PcmResamplerProfile;
+
+/**
+ * A wrapper for #PcmConvert which shares the resampler between all
+ * instances with the same input and output format and the same
+ * resampler profile.  If several audio
+ * outputs resample the same stream to the same sample rate, the
+ * expensive resampler runs only once.
+ *
+ * Each instance verifies that its input is really the same as the
+ * input of the shared resampler (it may differ, e.g. because of
+ * output-specific filters or because the outputs have been
+ * canceled at different positions); if not, it falls back to a
+ * private #PcmConvert.  Conversions without resampling are never
+ * shared.
+ */
+class SharedPcmConvert {
+public:
+	/**
+	 * The shared state of all instances with the same formats.
+	 */
+	struct Group;
+
+private:
+	enum class State : uint8_t {
+		/**
+		 * Not sharing; #own is used.
+		 */
+		PRIVATE,
+
+		/**
+		 * Following the shared converter at #position.
+		 */
+		SYNCED,
+
+		/**
+		 * Attached to the group, but the position in its
+		 * stream is unknown (after Open() or Reset()).  The
+		 * next Convert() call determines it.
+		 */
+		UNSYNCED,
+
+		/**
+		 * The input differs from the group's stream; #own is
+		 * used until the next Reset().
+		 */
+		DETACHED,
+	};
+
+	Group *group = nullptr;
+
+	State state;
+
+	/**
+	 * The sequence number of the next block in the group's
+	 * stream.
+	 */
+	uint64_t position;
+
+	AudioFormat src_format, dest_format;
+
+	const PcmResamplerProfile *resampler_profile;
+
+	/**
+	 * The private converter; opened lazily.
+	 */
+	PcmConvert own;
+	bool own_open = false;
+
+	/**
+	 * A private copy of the shared converter's output, which
+	 * stays valid until the next call.
+	 */
+	PcmBuffer buffer;
+
+public:
+	SharedPcmConvert() noexcept = default;
+
+	~SharedPcmConvert() noexcept {
+		assert(group == nullptr);
+		assert(!own_open);
+	}
+
+	SharedPcmConvert(const SharedPcmConvert &) = delete;
+	SharedPcmConvert &operator=(const SharedPcmConvert &) = delete;
+
+	/**
+	 * Throws std::runtime_error on error.
+	 *
+	 * @param _resampler_profile the resampler profile; nullptr
+	 * selects the default profile
+	 */
+	void Open(AudioFormat _src_format, AudioFormat _dest_format,
+		  const PcmResamplerProfile *_resampler_profile=nullptr);
+
+	void Close() noexcept;
+
+	void Reset() noexcept;
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	ConstBuffer<void> Convert(ConstBuffer<void> src);
+
+	/**
+	 * Throws std::runtime_error on error.
+	 *
+	 * If other instances are still following the shared stream,
+	 * the shared converter is left alone; this instance detaches
+	 * and obtains its tail by replaying its most recent input
+	 * into the private converter.
+	 */
+	ConstBuffer<void> Flush();
+
+private:
+	void OpenOwn();
+
+	ConstBuffer<void> Copy(ConstBuffer<void> src) noexcept;
+
+	ConstBuffer<void> ConvertShared(ConstBuffer<void> src);
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "pcm/Volume.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 
 #include <stdexcept>
 
@@ -32,7 +33,7 @@ class VolumeFilter final : public Filter {
 public:
 	explicit VolumeFilter(const AudioFormat &audio_format)
 		:Filter(audio_format) {
-		pv.Open(out_audio_format.format);
+		pv.Open(out_audio_format.format, out_audio_format.channels);
 	}
 
 	unsigned GetVolume() const noexcept {
@@ -43,8 +44,24 @@ public:
 		pv.SetVolume(_volume);
 	}
 
+	void RampVolume(unsigned _volume) noexcept {
+		pv.RampVolume(_volume);
+	}
+
 	/* virtual methods from class Filter */
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+
+	bool FilterInPlace(WritableBuffer<void> data) override {
+		pv.ApplyInPlace(data);
+		return true;
+	}
+
+	int GetConstantGain() const noexcept override {
+		/* a fade (RampVolume()) cannot be fused */
+		return pv.IsRamping()
+			? -1
+			: int(pv.GetVolume());
+	}
 };
 
 class PreparedVolumeFilter final : public PreparedFilter {
@@ -88,3 +105,11 @@ volume_filter_set(Filter *_filter, unsigned volume) noexcept
 	filter->SetVolume(volume);
 }
 
+
+void
+volume_filter_ramp(Filter *_filter, unsigned volume) noexcept
+{
+	VolumeFilter *filter = (VolumeFilter *)_filter;
+
+	filter->RampVolume(volume);
+}
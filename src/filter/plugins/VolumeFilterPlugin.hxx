@@ -34,4 +34,11 @@ volume_filter_get(const Filter *filter) noexcept;
 void
 volume_filter_set(Filter *filter, unsigned volume) noexcept;
 
+/**
+ * Like volume_filter_set(), but fade to the new volume during the
+ * next chunk to avoid clicks.
+ */
+void
+volume_filter_ramp(Filter *filter, unsigned volume) noexcept;
+
 #endif
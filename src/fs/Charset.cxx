@@ -22,6 +22,7 @@
 #include "Log.hxx"
 #include "lib/icu/Converter.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/CharUtil.hxx"
 #include "config.h"
 
 #ifdef _WIN32
@@ -41,6 +42,45 @@ static std::string fs_charset;
 
 static IcuConverter *fs_converter;
 
+/**
+ * Does #fs_converter map all ASCII characters to themselves?  This
+ * is true for nearly all charsets (e.g. ISO-8859-*), but not for
+ * UTF-16, EBCDIC and a few others.  If true, pure ASCII strings can
+ * be copied without conversion.
+ */
+static bool fs_ascii_compatible;
+
+gcc_pure
+static bool
+IsPlainASCII(const char *p) noexcept
+{
+	for (; *p != 0; ++p)
+		if (!IsASCII(*p))
+			return false;
+
+	return true;
+}
+
+/**
+ * Find out whether #fs_converter converts ASCII strings to
+ * themselves in both directions.
+ */
+static bool
+ProbeASCIICompatible(const IcuConverter &converter) noexcept
+{
+	char probe[0x80];
+	for (unsigned i = 1; i < sizeof(probe); ++i)
+		probe[i - 1] = char(i);
+	probe[sizeof(probe) - 1] = 0;
+
+	try {
+		return strcmp(converter.ToUTF8(probe).c_str(), probe) == 0 &&
+			strcmp(converter.FromUTF8(probe).c_str(), probe) == 0;
+	} catch (...) {
+		return false;
+	}
+}
+
 void
 SetFSCharset(const char *charset)
 {
@@ -50,6 +90,9 @@ SetFSCharset(const char *charset)
 	fs_converter = IcuConverter::Create(charset);
 	assert(fs_converter != nullptr);
 
+	fs_charset = charset;
+	fs_ascii_compatible = ProbeASCIICompatible(*fs_converter);
+
 	FormatDebug(path_domain,
 		    "SetFSCharset: fs charset is: %s", fs_charset.c_str());
 }
@@ -65,6 +108,18 @@ DeinitFSCharset() noexcept
 #endif
 }
 
+bool
+IsFSCharsetConverted() noexcept
+{
+#ifdef HAVE_FS_CHARSET
+	return fs_converter != nullptr;
+#elif defined(_WIN32)
+	return true;
+#else
+	return false;
+#endif
+}
+
 const char *
 GetFSCharset() noexcept
 {
@@ -105,7 +160,8 @@ PathToUTF8(PathTraitsFS::const_pointer_type path_fs)
 	return FixSeparators(PathTraitsUTF8::string(buffer.c_str()));
 #else
 #ifdef HAVE_FS_CHARSET
-	if (fs_converter == nullptr)
+	if (fs_converter == nullptr ||
+	    (fs_ascii_compatible && IsPlainASCII(path_fs)))
 #endif
 		return FixSeparators(path_fs);
 #ifdef HAVE_FS_CHARSET
@@ -130,7 +186,8 @@ PathFromUTF8(PathTraitsUTF8::const_pointer_type path_utf8)
 	const auto buffer = MultiByteToWideChar(CP_UTF8, path_utf8);
 	return PathTraitsFS::string(buffer.c_str());
 #else
-	if (fs_converter == nullptr)
+	if (fs_converter == nullptr ||
+	    (fs_ascii_compatible && IsPlainASCII(path_utf8)))
 		return path_utf8;
 
 	const auto buffer = fs_converter->FromUTF8(path_utf8);
@@ -44,6 +44,15 @@ SetFSCharset(const char *charset);
 void
 DeinitFSCharset() noexcept;
 
+/**
+ * Does converting paths between the filesystem charset and UTF-8
+ * involve more than copying?  Callers may use this to decide whether
+ * memoizing the conversion is worth the trouble.
+ */
+gcc_pure
+bool
+IsFSCharsetConverted() noexcept;
+
 /**
  * Convert the path to UTF-8.
  *
@@ -146,6 +146,28 @@ public:
 		assert(HasEntry());
 		return Path::FromFS(ent->d_name);
 	}
+
+	/**
+	 * Returns the file type of the entry that was previously
+	 * read by #ReadEntry (one of the DT_* constants), or
+	 * DT_UNKNOWN if the file system doesn't provide it.
+	 */
+	unsigned char GetEntryType() const {
+		assert(HasEntry());
+#ifdef _DIRENT_HAVE_D_TYPE
+		return ent->d_type;
+#else
+		return DT_UNKNOWN;
+#endif
+	}
+
+	/**
+	 * Returns the file descriptor of the directory, to be used
+	 * with fstatat() and similar functions.
+	 */
+	int GetFD() const {
+		return dirfd(dirp);
+	}
 };
 
 #endif
@@ -138,6 +138,16 @@ FileOutputStream::Write(const void *data, size_t size)
 				      GetPath().c_str());
 }
 
+void
+FileOutputStream::Sync()
+{
+	assert(IsDefined());
+
+	if (!FlushFileBuffers(handle))
+		throw FormatLastError("Failed to flush %s",
+				      GetPath().c_str());
+}
+
 void
 FileOutputStream::Commit()
 {
@@ -236,6 +246,19 @@ FileOutputStream::Tell() const noexcept
 	return fd.Tell();
 }
 
+#ifdef __linux__
+
+void
+FileOutputStream::Allocate(uint64_t size) noexcept
+{
+	assert(IsDefined());
+
+	if (fallocate(fd.Get(), FALLOC_FL_KEEP_SIZE, 0, size) == 0)
+		allocated = true;
+}
+
+#endif
+
 void
 FileOutputStream::Write(const void *data, size_t size)
 {
@@ -249,11 +272,27 @@ FileOutputStream::Write(const void *data, size_t size)
 				  GetPath().c_str());
 }
 
+void
+FileOutputStream::Sync()
+{
+	assert(IsDefined());
+
+	if (fsync(fd.Get()) < 0)
+		throw FormatErrno("Failed to flush %s", GetPath().c_str());
+}
+
 void
 FileOutputStream::Commit()
 {
 	assert(IsDefined());
 
+#ifdef __linux__
+	/* release the preallocated space beyond the end of the
+	   file */
+	if (allocated && ftruncate(fd.Get(), Tell()) < 0)
+		throw FormatErrno("Failed to truncate %s", path.c_str());
+#endif
+
 #ifdef HAVE_O_TMPFILE
 	if (is_tmpfile) {
 		unlinkat(directory_fd.Get(), GetPath().c_str(), 0);
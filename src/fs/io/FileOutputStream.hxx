@@ -77,6 +77,14 @@ class FileOutputStream final : public OutputStream {
 	bool is_tmpfile = false;
 #endif
 
+#ifdef __linux__
+	/**
+	 * Has Allocate() been called?  If yes, then Commit() must
+	 * release space beyond the end of the file.
+	 */
+	bool allocated = false;
+#endif
+
 public:
 	enum class Mode : uint8_t {
 		/**
@@ -133,9 +141,28 @@ public:
 	gcc_pure
 	uint64_t Tell() const noexcept;
 
+#ifdef __linux__
+	/**
+	 * Reserve disk space for the first #size bytes of the file
+	 * (fallocate() with FALLOC_FL_KEEP_SIZE), which reduces
+	 * fragmentation of long recordings.  The file size is not
+	 * changed, and space beyond the end of the file is released
+	 * by Commit().  Errors are ignored; this is only a hint.
+	 */
+	void Allocate(uint64_t size) noexcept;
+#endif
+
 	/* virtual methods from class OutputStream */
 	void Write(const void *data, size_t size) override;
 
+	/**
+	 * Flush the data to the storage device (fsync()) before
+	 * Commit(), so the new file survives a power failure.
+	 *
+	 * Throws on error.
+	 */
+	void Sync();
+
 	void Commit();
 	void Cancel() noexcept;
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Path.hxx"
+#include "system/Error.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile(Path path)
+{
+	FileReader reader(path);
+	const auto info = reader.GetFileInfo();
+	if (!info.IsRegular())
+		throw FormatRuntimeError("Not a regular file: %s",
+					 path.ToUTF8().c_str());
+
+	size = info.GetSize();
+
+#ifdef _WIN32
+	data = new char[size];
+
+	size_t position = 0;
+	while (position < size) {
+		size_t nbytes = reader.Read((char *)data + position,
+					    size - position);
+		if (nbytes == 0) {
+			delete[] (char *)data;
+			throw std::runtime_error("Unexpected end of file");
+		}
+
+		position += nbytes;
+	}
+#else
+	if (size == 0) {
+		/* mmap() does not allow mapping empty files */
+		data = nullptr;
+		return;
+	}
+
+	data = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+		    reader.GetFD().Get(), 0);
+	if (data == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path.ToUTF8().c_str());
+#endif
+}
+
+MappedFile::~MappedFile() noexcept
+{
+#ifdef _WIN32
+	delete[] (char *)data;
+#else
+	if (data != nullptr)
+		munmap(data, size);
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MAPPED_FILE_HXX
+#define MPD_MAPPED_FILE_HXX
+
+#include "util/ConstBuffer.hxx"
+
+#include <stddef.h>
+
+class Path;
+
+/**
+ * A read-only view of a whole file.  It is mapped into memory with
+ * mmap() (sharing its pages with the kernel's page cache); on systems
+ * without mmap(), the file is read into a buffer.
+ */
+class MappedFile {
+	void *data;
+	size_t size;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit MappedFile(Path path);
+
+	~MappedFile() noexcept;
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	ConstBuffer<void> GetData() const noexcept {
+		return {data, size};
+	}
+};
+
+#endif
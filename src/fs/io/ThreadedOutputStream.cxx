@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014-2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ThreadedOutputStream.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+ThreadedOutputStream::ThreadedOutputStream(OutputStream &_next,
+					   size_t buffer_size)
+	:next(_next),
+	 thread(BIND_THIS_METHOD(Run)),
+	 allocation(buffer_size),
+	 buffer(&allocation.front(), allocation.size())
+{
+	thread.Start();
+}
+
+ThreadedOutputStream::~ThreadedOutputStream() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		quit = true;
+		thread_cond.signal();
+	}
+
+	thread.Join();
+}
+
+void
+ThreadedOutputStream::CheckRethrow() const
+{
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void
+ThreadedOutputStream::Write(const void *_data, size_t size)
+{
+	auto *data = (const uint8_t *)_data;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (size > 0) {
+		CheckRethrow();
+
+		auto w = buffer.Write();
+		if (w.empty()) {
+			/* the buffer is full: wait for the thread to
+			   make room */
+			client_cond.wait(mutex);
+			continue;
+		}
+
+		const bool was_empty = buffer.empty();
+
+		const size_t nbytes = std::min(w.size, size);
+		memcpy(w.data, data, nbytes);
+		buffer.Append(nbytes);
+
+		data += nbytes;
+		size -= nbytes;
+		position += nbytes;
+
+		if (was_empty)
+			thread_cond.signal();
+	}
+}
+
+void
+ThreadedOutputStream::Flush()
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (true) {
+		CheckRethrow();
+
+		if (buffer.empty() && !busy)
+			return;
+
+		client_cond.wait(mutex);
+	}
+}
+
+void
+ThreadedOutputStream::Run() noexcept
+{
+	SetThreadName("output_io");
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (!quit) {
+		auto r = buffer.Read();
+		if (r.empty() || error) {
+			thread_cond.wait(mutex);
+			continue;
+		}
+
+		busy = true;
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			next.Write(r.data, r.size);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		busy = false;
+
+		if (!error)
+			buffer.Consume(r.size);
+
+		client_cond.signal();
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2014-2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREADED_OUTPUT_STREAM_HXX
+#define THREADED_OUTPUT_STREAM_HXX
+
+#include "OutputStream.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/CircularBuffer.hxx"
+
+#include <exception>
+
+#include <stdint.h>
+
+/**
+ * An #OutputStream which copies all data into a bounded buffer and
+ * writes it to another #OutputStream in a separate thread.  This
+ * prevents a slow destination (e.g. a disk or a network file
+ * system) from stalling the caller, unless the buffer fills up.
+ *
+ * Errors are postponed: they are thrown by the next Write() or
+ * Flush() call.
+ */
+class ThreadedOutputStream final : public OutputStream {
+	OutputStream &next;
+
+	Thread thread;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Signalled by the thread when buffer space has become
+	 * available or when it has finished a write.
+	 */
+	Cond client_cond;
+
+	/**
+	 * Signalled by the client when new data is available or when
+	 * the thread shall quit.
+	 */
+	Cond thread_cond;
+
+	AllocatedArray<uint8_t> allocation;
+
+	/**
+	 * Protected by #mutex.  The thread only reads from it and
+	 * the client only writes to it, so the data to be written by
+	 * next.Write() remains valid during the write while the
+	 * lock is released.
+	 */
+	CircularBuffer<uint8_t> buffer;
+
+	/**
+	 * The error thrown by next.Write().  Protected by #mutex.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * The total number of bytes passed to Write().
+	 */
+	uint64_t position = 0;
+
+	/**
+	 * Is the thread currently inside next.Write()?  Protected
+	 * by #mutex.
+	 */
+	bool busy = false;
+
+	/**
+	 * Shall the thread quit?  Protected by #mutex.
+	 */
+	bool quit = false;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param buffer_size the maximum number of bytes which may be
+	 * pending
+	 */
+	ThreadedOutputStream(OutputStream &_next, size_t buffer_size);
+
+	/**
+	 * Stops the thread.  Pending data which has not been written
+	 * yet is discarded; call Flush() first to avoid that.
+	 */
+	~ThreadedOutputStream() noexcept;
+
+	/**
+	 * Returns the total number of bytes passed to Write().
+	 */
+	uint64_t GetPosition() const noexcept {
+		return position;
+	}
+
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+
+	/**
+	 * Wait until all pending data has been written to the next
+	 * #OutputStream.
+	 *
+	 * Throws on error.
+	 */
+	void Flush();
+
+private:
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void CheckRethrow() const;
+
+	void Run() noexcept;
+};
+
+#endif
@@ -28,16 +28,33 @@
 #include <assert.h>
 #include <string.h>
 
+std::atomic_uint AsyncInputStream::total_underruns{0};
+std::atomic_size_t AsyncInputStream::capacity_limit{0};
+
+size_t
+AsyncInputStream::ClipCapacity(size_t capacity) noexcept
+{
+	const size_t limit = capacity_limit.load(std::memory_order_relaxed);
+	return limit > 1 && capacity > limit
+		? limit
+		: capacity;
+}
+
 AsyncInputStream::AsyncInputStream(EventLoop &event_loop, const char *_url,
 				   Mutex &_mutex,
 				   size_t _buffer_size,
-				   size_t _resume_at)
+				   size_t _resume_at,
+				   size_t _initial_capacity)
 	:InputStream(_url, _mutex),
 	 deferred_resume(event_loop, BIND_THIS_METHOD(DeferredResume)),
 	 deferred_seek(event_loop, BIND_THIS_METHOD(DeferredSeek)),
 	 allocation(_buffer_size),
-	 buffer(&allocation.front(), allocation.size()),
-	 resume_at(_resume_at)
+	 buffer(&allocation.front(),
+		ClipCapacity(_initial_capacity > 0 &&
+			     _initial_capacity < allocation.size()
+			     ? _initial_capacity
+			     : allocation.size())),
+	 resume_at(std::min(_resume_at, buffer.GetCapacity() - 1))
 {
 	allocation.ForkCow(false);
 }
@@ -64,9 +81,32 @@ AsyncInputStream::Pause() noexcept
 {
 	assert(GetEventLoop().IsInside());
 
+	if (!paused)
+		++n_pauses;
+
 	paused = true;
 }
 
+void
+AsyncInputStream::ResizeBuffer(size_t capacity, size_t _resume_at) noexcept
+{
+	capacity = ClipCapacity(std::min(capacity, allocation.size()));
+	assert(capacity > 1);
+
+	resume_at = std::min(_resume_at, capacity - 1);
+
+	if (capacity == buffer.GetCapacity()) {
+		pending_capacity = 0;
+		return;
+	}
+
+	pending_capacity = capacity;
+	ApplyPendingCapacity();
+
+	if (paused && buffer.GetSize() < resume_at)
+		deferred_resume.Schedule();
+}
+
 inline void
 AsyncInputStream::Resume()
 {
@@ -179,6 +219,7 @@ AsyncInputStream::Read(void *ptr, size_t read_size)
 
 	/* wait for data */
 	CircularBuffer<uint8_t>::Range r;
+	bool waited = false;
 	while (true) {
 		Check();
 
@@ -186,20 +227,46 @@ AsyncInputStream::Read(void *ptr, size_t read_size)
 		if (!r.empty() || IsEOF())
 			break;
 
+		if (!waited && seek_state == SeekState::NONE) {
+			waited = true;
+			++n_underruns;
+			total_underruns.fetch_add(1, std::memory_order_relaxed);
+		}
+
 		const ScopeExchangeInputStreamHandler h(*this, &cond_handler);
 		cond_handler.cond.wait(mutex);
 	}
 
 	const size_t nbytes = std::min(read_size, r.size);
 	memcpy(ptr, r.data, nbytes);
+	Consume(nbytes);
+	return nbytes;
+}
+
+ConstBuffer<void>
+AsyncInputStream::Peek() noexcept
+{
+	assert(!GetEventLoop().IsInside());
+
+	/* the I/O thread only writes to the free part of the
+	   buffer, so the readable part stays valid until Consume() */
+	auto r = buffer.Read();
+	return {r.data, r.size};
+}
+
+void
+AsyncInputStream::Consume(size_t nbytes) noexcept
+{
+	assert(!GetEventLoop().IsInside());
+
 	buffer.Consume(nbytes);
 
 	offset += (offset_type)nbytes;
 
+	ApplyPendingCapacity();
+
 	if (paused && buffer.GetSize() < resume_at)
 		deferred_resume.Schedule();
-
-	return nbytes;
 }
 
 void
@@ -264,6 +331,7 @@ AsyncInputStream::DeferredSeek() noexcept
 
 		seek_state = SeekState::PENDING;
 		buffer.Clear();
+		ApplyPendingCapacity();
 		paused = false;
 
 		DoSeek(seek_offset);
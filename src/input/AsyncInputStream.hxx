@@ -25,6 +25,7 @@
 #include "util/HugeAllocator.hxx"
 #include "util/CircularBuffer.hxx"
 
+#include <atomic>
 #include <exception>
 
 /**
@@ -44,7 +45,34 @@ class AsyncInputStream : public InputStream {
 	HugeArray<uint8_t> allocation;
 
 	CircularBuffer<uint8_t> buffer;
-	const size_t resume_at;
+	size_t resume_at;
+
+	/**
+	 * A buffer capacity requested by ResizeBuffer() which could
+	 * not be applied yet because the data in the buffer wraps
+	 * around; 0 if there is none.
+	 */
+	size_t pending_capacity = 0;
+
+	/**
+	 * Statistics: how often was the connection paused because
+	 * the buffer was full, and how often did Read() have to wait
+	 * for data?
+	 */
+	unsigned n_pauses = 0, n_underruns = 0;
+
+	/**
+	 * The sum of #n_underruns of all instances, for the metrics
+	 * endpoint.
+	 */
+	static std::atomic_uint total_underruns;
+
+	/**
+	 * If non-zero, then the capacity of new buffers and of
+	 * ResizeBuffer() calls is clipped to this value.  See
+	 * SetCapacityLimit().
+	 */
+	static std::atomic_size_t capacity_limit;
 
 	bool open = true;
 
@@ -69,10 +97,17 @@ protected:
 	std::exception_ptr postponed_exception;
 
 public:
+	/**
+	 * @param _buffer_size the maximum buffer size; see
+	 * ResizeBuffer()
+	 * @param _initial_capacity the buffer capacity to start with
+	 * (0 means #_buffer_size)
+	 */
 	AsyncInputStream(EventLoop &event_loop, const char *_url,
 			 Mutex &_mutex,
 			 size_t _buffer_size,
-			 size_t _resume_at);
+			 size_t _resume_at,
+			 size_t _initial_capacity=0);
 
 	virtual ~AsyncInputStream();
 
@@ -87,6 +122,26 @@ public:
 	std::unique_ptr<Tag> ReadTag() final;
 	bool IsAvailable() noexcept final;
 	size_t Read(void *ptr, size_t read_size) final;
+	ConstBuffer<void> Peek() noexcept final;
+	void Consume(size_t nbytes) noexcept final;
+
+	/**
+	 * Returns how often Read() had to wait for data, summed over
+	 * all instances since MPD was started.
+	 */
+	static unsigned GetTotalUnderrunCount() noexcept {
+		return total_underruns.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Limit the buffer capacity of all instances, to reduce
+	 * memory usage (e.g. when the memory budget is exceeded); 0
+	 * means no limit.  Existing instances apply the limit at
+	 * their next ResizeBuffer() call.
+	 */
+	static void SetCapacityLimit(size_t limit) noexcept {
+		capacity_limit.store(limit, std::memory_order_relaxed);
+	}
 
 protected:
 	/**
@@ -101,6 +156,14 @@ protected:
 		return paused;
 	}
 
+	unsigned GetPauseCount() const noexcept {
+		return n_pauses;
+	}
+
+	unsigned GetUnderrunCount() const noexcept {
+		return n_underruns;
+	}
+
 	/**
 	 * Declare that the underlying stream was closed.  We will
 	 * continue feeding Read() calls from the buffer until it runs
@@ -118,6 +181,24 @@ protected:
 		return buffer.IsFull();
 	}
 
+	size_t GetBufferCapacity() const noexcept {
+		return pending_capacity > 0
+			? pending_capacity
+			: buffer.GetCapacity();
+	}
+
+	/**
+	 * Change the buffer capacity (which is clipped to the size
+	 * passed to the constructor) and the resume threshold.  Only
+	 * those pages of the allocation which are actually written
+	 * consume memory, so a small capacity saves memory.  If the
+	 * capacity cannot be changed right now, it will be applied
+	 * later.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void ResizeBuffer(size_t capacity, size_t _resume_at) noexcept;
+
 	/**
 	 * Determine how many bytes can be added to the buffer.
 	 */
@@ -162,8 +243,17 @@ protected:
 	void SeekDone() noexcept;
 
 private:
+	gcc_pure
+	static size_t ClipCapacity(size_t capacity) noexcept;
+
 	void Resume();
 
+	void ApplyPendingCapacity() noexcept {
+		if (pending_capacity > 0 &&
+		    buffer.SetCapacity(pending_capacity))
+			pending_capacity = 0;
+	}
+
 	/* for DeferEvent */
 	void DeferredResume() noexcept;
 	void DeferredSeek() noexcept;
@@ -36,6 +36,9 @@ BufferedInputStream::BufferedInputStream(InputStreamPtr _input)
 	if (input->HasMimeType())
 		SetMimeType(input->GetMimeType());
 
+	if (input->HasVersion())
+		SetVersion(input->GetVersion());
+
 	size = input->GetSize();
 	seekable = input->IsSeekable();
 	offset = input->GetOffset();
@@ -118,14 +121,7 @@ BufferedInputStream::Read(void *ptr, size_t s)
 			/* yay, we have some data */
 			size_t nbytes = std::min(s, r.defined_buffer.size);
 			memcpy(ptr, r.defined_buffer.data, nbytes);
-			offset += nbytes;
-
-			if (!IsAvailable()) {
-				/* wake up the sleeping thread */
-				idle = false;
-				wake_cond.signal();
-			}
-
+			Consume(nbytes);
 			return nbytes;
 		}
 
@@ -144,6 +140,32 @@ BufferedInputStream::Read(void *ptr, size_t s)
 	}
 }
 
+ConstBuffer<void>
+BufferedInputStream::Peek() noexcept
+{
+	if (offset >= size)
+		return nullptr;
+
+	/* defined parts of the SparseBuffer are never modified */
+	auto r = buffer.Read(offset);
+	if (!r.HasData())
+		return nullptr;
+
+	return {r.defined_buffer.data, r.defined_buffer.size};
+}
+
+void
+BufferedInputStream::Consume(size_t nbytes) noexcept
+{
+	offset += nbytes;
+
+	if (!IsAvailable()) {
+		/* wake up the sleeping thread */
+		idle = false;
+		wake_cond.signal();
+	}
+}
+
 void
 BufferedInputStream::RunThread() noexcept
 {
@@ -91,6 +91,8 @@ public:
 	// std::unique_ptr<Tag> ReadTag() override;
 	bool IsAvailable() noexcept override;
 	size_t Read(void *ptr, size_t size) override;
+	ConstBuffer<void> Peek() noexcept override;
+	void Consume(size_t nbytes) noexcept override;
 
 	/* virtual methods from class InputStreamHandler */
 	void OnInputStreamReady() noexcept override {
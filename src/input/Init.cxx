@@ -20,9 +20,17 @@
 #include "Init.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "plugins/FileInputPlugin.hxx"
+#include "config.h"
+
+#ifdef ENABLE_INPUT_CACHE
+#include "cache/Manager.hxx"
+#endif
+
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "config/Block.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "Log.hxx"
 #include "PluginUnavailable.hxx"
 #include "util/RuntimeError.hxx"
@@ -31,11 +39,53 @@
 
 #include <assert.h>
 
+#ifdef ENABLE_INPUT_CACHE
+
+static void
+input_cache_global_init(const ConfigData &config)
+{
+	auto directory = config.GetPath(ConfigOption::INPUT_CACHE_DIRECTORY);
+	if (directory.IsNull())
+		return;
+
+	/* the size is configured in KiB; default is 1 GiB */
+	const uint64_t size =
+		uint64_t(config.GetPositive(ConfigOption::INPUT_CACHE_SIZE,
+					    1024 * 1024)) * 1024;
+
+	try {
+		input_cache_manager = new InputCacheManager(std::move(directory),
+							    size);
+	} catch (...) {
+		std::throw_with_nested(std::runtime_error("Failed to initialize the input cache"));
+	}
+}
+
+#endif
+
 void
 input_stream_global_init(const ConfigData &config, EventLoop &event_loop)
 {
 	const ConfigBlock empty;
 
+#ifdef ENABLE_INPUT_CACHE
+	input_cache_global_init(config);
+#endif
+
+	/* the "file" plugin is not in the registry, because it
+	   handles only local files; it has a few settings, though */
+	const auto *file_block =
+		config.FindBlock(ConfigBlockOption::INPUT, "plugin", "file");
+	if (file_block != nullptr) {
+		file_block->SetUsed();
+
+		try {
+			file_input_global_init(*file_block);
+		} catch (...) {
+			std::throw_with_nested(std::runtime_error("Failed to initialize input plugin 'file'"));
+		}
+	}
+
 	for (unsigned i = 0; input_plugins[i] != nullptr; ++i) {
 		const InputPlugin *plugin = input_plugins[i];
 
@@ -76,4 +126,9 @@ input_stream_global_finish() noexcept
 	input_plugins_for_each_enabled(plugin)
 		if (plugin->finish != nullptr)
 			plugin->finish();
+
+#ifdef ENABLE_INPUT_CACHE
+	delete input_cache_manager;
+	input_cache_manager = nullptr;
+#endif
 }
@@ -152,6 +152,33 @@ InputStream::LockReadFull(void *ptr, size_t _size)
 	ReadFull(ptr, _size);
 }
 
+ConstBuffer<void>
+InputStream::Peek() noexcept
+{
+	return nullptr;
+}
+
+ConstBuffer<void>
+InputStream::LockPeek() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return Peek();
+}
+
+void
+InputStream::Consume(gcc_unused size_t nbytes) noexcept
+{
+	/* Peek() has returned an empty buffer */
+	assert(nbytes == 0);
+}
+
+void
+InputStream::LockConsume(size_t nbytes) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	Consume(nbytes);
+}
+
 bool
 InputStream::LockIsEOF() noexcept
 {
@@ -23,6 +23,7 @@
 #include "Offset.hxx"
 #include "Ptr.hxx"
 #include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <string>
@@ -95,6 +96,13 @@ private:
 	 */
 	std::string mime;
 
+	/**
+	 * An opaque string which changes whenever the resource is
+	 * modified (e.g. the HTTP "ETag" or the modification time),
+	 * or empty if unknown.  It is used to validate cached copies.
+	 */
+	std::string version;
+
 public:
 	InputStream(const char *_uri, Mutex &_mutex) noexcept
 		:uri(_uri),
@@ -214,6 +222,26 @@ public:
 		mime = std::move(_mime);
 	}
 
+	gcc_pure
+	bool HasVersion() const noexcept {
+		assert(ready);
+
+		return !version.empty();
+	}
+
+	gcc_pure
+	const char *GetVersion() const noexcept {
+		assert(ready);
+
+		return version.c_str();
+	}
+
+	void SetVersion(std::string &&_version) noexcept {
+		assert(!ready);
+
+		version = std::move(_version);
+	}
+
 	gcc_pure
 	bool KnownSize() const noexcept {
 		assert(ready);
@@ -390,6 +418,42 @@ public:
 	gcc_nonnull_all
 	void LockReadFull(void *ptr, size_t size);
 
+	/**
+	 * Returns the data at the current offset if it can be
+	 * accessed without copying it (e.g. from a memory mapping).
+	 * The buffer remains valid until the next Read(), Seek() or
+	 * Consume() call.  The default implementation returns an
+	 * empty buffer; the caller must use Read() then.
+	 *
+	 * The caller must lock the mutex.
+	 */
+	gcc_pure
+	virtual ConstBuffer<void> Peek() noexcept;
+
+	/**
+	 * Wrapper for Peek() which locks and unlocks the mutex; the
+	 * caller must not be holding it already.
+	 */
+	gcc_pure
+	ConstBuffer<void> LockPeek() noexcept;
+
+	/**
+	 * Skip data which was obtained by Peek() and advance the
+	 * offset.
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @param nbytes the number of bytes; must not be larger than
+	 * the buffer returned by Peek()
+	 */
+	virtual void Consume(size_t nbytes) noexcept;
+
+	/**
+	 * Wrapper for Consume() which locks and unlocks the mutex;
+	 * the caller must not be holding it already.
+	 */
+	void LockConsume(size_t nbytes) noexcept;
+
 protected:
 	void InvokeOnReady() noexcept;
 	void InvokeOnAvailable() noexcept;
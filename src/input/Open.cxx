@@ -25,6 +25,11 @@
 #include "RewindInputStream.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "config.h"
+
+#ifdef ENABLE_INPUT_CACHE
+#include "cache/Stream.hxx"
+#endif
 
 #include <stdexcept>
 
@@ -41,8 +46,15 @@ InputStream::Open(const char *url, Mutex &mutex)
 			continue;
 
 		auto is = plugin->open(url, mutex);
-		if (is != nullptr)
+		if (is != nullptr) {
+#ifdef ENABLE_INPUT_CACHE
+			if (input_cache_manager != nullptr)
+				is = std::make_unique<CacheInputStream>(std::move(is),
+									*input_cache_manager);
+#endif
+
 			return input_rewind_open(std::move(is));
+		}
 	}
 
 	throw std::runtime_error("Unrecognized URI");
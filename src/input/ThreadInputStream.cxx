@@ -21,6 +21,9 @@
 #include "CondHandler.hxx"
 #include "thread/Name.hxx"
 
+#include <stdexcept>
+#include <utility>
+
 #include <assert.h>
 #include <string.h>
 
@@ -83,8 +86,26 @@ ThreadInputStream::ThreadFunc() noexcept
 	while (!close) {
 		assert(!postponed_exception);
 
+		if (seek) {
+			buffer.Clear();
+			eof = false;
+
+			try {
+				const ScopeUnlock unlock(mutex);
+				ThreadSeek(seek_offset);
+			} catch (...) {
+				seek_error = std::current_exception();
+			}
+
+			seek = false;
+			InvokeOnAvailable();
+			continue;
+		}
+
 		auto w = buffer.Write();
-		if (w.empty()) {
+		if (w.empty() || eof) {
+			/* wait until there is room in the buffer (or
+			   until the client seeks) */
 			wake_cond.wait(mutex);
 		} else {
 			size_t nbytes;
@@ -102,7 +123,12 @@ ThreadInputStream::ThreadFunc() noexcept
 
 			if (nbytes == 0) {
 				eof = true;
-				break;
+
+				if (!seekable)
+					/* nothing left to do */
+					break;
+
+				continue;
 			}
 
 			buffer.Append(nbytes);
@@ -144,9 +170,7 @@ ThreadInputStream::Read(void *ptr, size_t read_size)
 		if (!r.empty()) {
 			size_t nbytes = std::min(read_size, r.size);
 			memcpy(ptr, r.data, nbytes);
-			buffer.Consume(nbytes);
-			wake_cond.broadcast();
-			offset += nbytes;
+			Consume(nbytes);
 			return nbytes;
 		}
 
@@ -158,10 +182,80 @@ ThreadInputStream::Read(void *ptr, size_t read_size)
 	}
 }
 
+ConstBuffer<void>
+ThreadInputStream::Peek() noexcept
+{
+	assert(!thread.IsInside());
+
+	/* the thread only writes to the free part of the buffer, so
+	   the readable part stays valid until Consume() */
+	auto r = buffer.Read();
+	return {r.data, r.size};
+}
+
+void
+ThreadInputStream::Consume(size_t nbytes) noexcept
+{
+	assert(!thread.IsInside());
+
+	buffer.Consume(nbytes);
+	wake_cond.broadcast();
+	offset += nbytes;
+}
+
+void
+ThreadInputStream::ThreadSeek(offset_type)
+{
+	throw std::runtime_error("Not seekable");
+}
+
+void
+ThreadInputStream::Seek(offset_type new_offset)
+{
+	assert(!thread.IsInside());
+	assert(IsSeekable());
+
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+
+	if (new_offset >= offset &&
+	    offset_type(new_offset - offset) <= buffer.GetSize()) {
+		/* the data is already in the buffer: skip it */
+		size_t skip = new_offset - offset;
+		while (skip > 0) {
+			auto r = buffer.Read();
+			size_t nbytes = std::min(skip, r.size);
+			Consume(nbytes);
+			skip -= nbytes;
+		}
+
+		return;
+	}
+
+	seek_offset = new_offset;
+	seek = true;
+	wake_cond.signal();
+
+	CondInputStreamHandler cond_handler;
+	const ScopeExchangeInputStreamHandler h(*this, &cond_handler);
+	while (seek && !postponed_exception)
+		cond_handler.cond.wait(mutex);
+
+	if (postponed_exception)
+		/* ThreadRead() has failed before the thread
+		   noticed the seek request */
+		std::rethrow_exception(postponed_exception);
+
+	if (seek_error)
+		std::rethrow_exception(std::exchange(seek_error, nullptr));
+
+	offset = new_offset;
+}
+
 bool
 ThreadInputStream::IsEOF() noexcept
 {
 	assert(!thread.IsInside());
 
-	return eof;
+	return eof && buffer.empty();
 }
@@ -38,7 +38,10 @@
  * another thread using the regular #InputStream API.  This class
  * manages the thread and the buffer.
  *
- * This works only for "streams": unknown length, no seeking, no tags.
+ * This works only for "streams" without tags.  Seeking is supported
+ * if the implementation sets the "seekable" flag and implements
+ * ThreadSeek(); seeking forward within the buffer is done without
+ * the thread.
  *
  * The implementation must call Stop() before its destruction
  * completes.  This cannot be done in ~ThreadInputStream() because at
@@ -73,6 +76,19 @@ class ThreadInputStream : public InputStream {
 	 */
 	bool eof = false;
 
+	/**
+	 * Shall the thread seek to #seek_offset?  Cleared by the
+	 * thread when done.
+	 */
+	bool seek = false;
+
+	offset_type seek_offset;
+
+	/**
+	 * The error thrown by ThreadSeek(); rethrown by Seek().
+	 */
+	std::exception_ptr seek_error;
+
 public:
 	ThreadInputStream(const char *_plugin,
 			  const char *_uri, Mutex &_mutex,
@@ -95,6 +111,9 @@ public:
 	bool IsEOF() noexcept final;
 	bool IsAvailable() noexcept final;
 	size_t Read(void *ptr, size_t size) override final;
+	ConstBuffer<void> Peek() noexcept final;
+	void Consume(size_t nbytes) noexcept final;
+	void Seek(offset_type offset) override final;
 
 protected:
 	/**
@@ -135,6 +154,17 @@ protected:
 	 */
 	virtual size_t ThreadRead(void *ptr, size_t size) = 0;
 
+	/**
+	 * Seek to the given offset; all data read so far has been
+	 * discarded already.  Only called if the "seekable" flag is
+	 * set.
+	 *
+	 * The #InputStream is not locked.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	virtual void ThreadSeek(offset_type new_offset);
+
 	/**
 	 * Optional deinitialization before leaving the thread.
 	 *
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Item.hxx"
+#include "Domain.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "system/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+InputCacheItem::InputCacheItem(std::string &&_uri, std::string &&_version,
+			       AllocatedPath &&_data_path,
+			       AllocatedPath &&_meta_path,
+			       offset_type _size, bool create)
+	:uri(std::move(_uri)), version(std::move(_version)),
+	 data_path(std::move(_data_path)), meta_path(std::move(_meta_path)),
+	 size(_size), map(_size)
+{
+	assert(size > 0);
+
+	int flags = O_RDWR | O_CREAT;
+	if (create)
+		flags |= O_TRUNC;
+
+	if (!fd.Open(data_path.c_str(), flags, 0600))
+		throw FormatErrno("Failed to open %s", data_path.c_str());
+
+	/* reserve the whole size as a sparse file; the blocks are
+	   only allocated when they get written */
+	if (ftruncate(fd.Get(), size) < 0)
+		throw FormatErrno("Failed to resize %s", data_path.c_str());
+}
+
+InputCacheItem::~InputCacheItem() noexcept
+{
+	assert(references == 0);
+}
+
+bool
+InputCacheItem::IsDefined(offset_type offset) const noexcept
+{
+	if (offset >= size)
+		return false;
+
+	const std::lock_guard<Mutex> protect(mutex);
+	return map.Check(offset).undefined_size == 0;
+}
+
+bool
+InputCacheItem::IsComplete() const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	const auto c = map.Check(0);
+	return c.undefined_size == 0 && c.defined_size == size;
+}
+
+size_t
+InputCacheItem::Read(offset_type offset, void *dest, size_t length)
+{
+	if (offset >= size)
+		return 0;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		const auto c = map.Check(offset);
+		if (c.undefined_size > 0)
+			return 0;
+
+		length = std::min(length, c.defined_size);
+	}
+
+	ssize_t nbytes = pread(fd.Get(), dest, length, offset);
+	if (nbytes < 0)
+		throw FormatErrno("Failed to read from %s",
+				  data_path.c_str());
+
+	if (nbytes == 0)
+		/* the file was truncated behind our back */
+		throw std::runtime_error("Premature end of cache file");
+
+	return nbytes;
+}
+
+void
+InputCacheItem::Write(offset_type offset, const void *src,
+		      size_t length) noexcept
+{
+	assert(offset + length <= size);
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		if (failed)
+			return;
+	}
+
+	ssize_t nbytes = pwrite(fd.Get(), src, length, offset);
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (nbytes < 0) {
+		FormatErrno(input_cache_domain, "Failed to write to %s",
+			    data_path.c_str());
+		failed = true;
+		return;
+	}
+
+	if (nbytes > 0) {
+		map.Commit(offset, offset + nbytes);
+		dirty = true;
+	}
+}
+
+void
+InputCacheItem::Save() const
+{
+	FileOutputStream fos(meta_path);
+	BufferedOutputStream os(fos);
+
+	os.Format("uri: %s\n", uri.c_str());
+	os.Format("version: %s\n", version.c_str());
+	os.Format("size: %llu\n", (unsigned long long)size);
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		map.VisitDefined([&os](size_t start, size_t end){
+				os.Format("range: %llu %llu\n",
+					  (unsigned long long)start,
+					  (unsigned long long)end);
+			});
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
+void
+InputCacheItem::Remove() noexcept
+{
+	try {
+		RemoveFile(meta_path);
+	} catch (...) {
+	}
+
+	try {
+		RemoveFile(data_path);
+	} catch (...) {
+	}
+}
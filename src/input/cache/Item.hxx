@@ -0,0 +1,193 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_ITEM_HXX
+#define MPD_INPUT_CACHE_ITEM_HXX
+
+#include "input/Offset.hxx"
+#include "thread/Mutex.hxx"
+#include "system/UniqueFileDescriptor.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/SparseBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <boost/intrusive/list_hook.hpp>
+#include <boost/intrusive/unordered_set_hook.hpp>
+
+#include <string>
+
+#include <stddef.h>
+
+/**
+ * One resource in the #InputCacheManager.  Its contents are stored
+ * in a sparse file on disk; a #SparseMap remembers which ranges have
+ * been filled already, and the "meta" file next to it persists this
+ * information (together with the URI and the version) across
+ * restarts.
+ *
+ * The methods Read() and Write() are thread-safe.  All other
+ * attributes are protected by InputCacheManager::mutex.
+ */
+class InputCacheItem final
+	: public boost::intrusive::unordered_set_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>,
+	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>
+{
+	friend class InputCacheManager;
+
+	const std::string uri;
+
+	/**
+	 * See InputStream::GetVersion().
+	 */
+	const std::string version;
+
+	const AllocatedPath data_path, meta_path;
+
+	const offset_type size;
+
+	UniqueFileDescriptor fd;
+
+	/**
+	 * Protects #map and #failed.
+	 */
+	mutable Mutex mutex;
+
+	SparseMap map;
+
+	/**
+	 * The number of #InputCacheLease instances referring to this
+	 * item.  An item cannot be evicted while it is referenced.
+	 */
+	unsigned references = 0;
+
+	/**
+	 * Was data written since the "meta" file was last saved?
+	 */
+	bool dirty = false;
+
+	/**
+	 * Has a write failed?  No more data will be added then.
+	 */
+	bool failed = false;
+
+public:
+	/**
+	 * Open (or create) the data file.
+	 *
+	 * Throws on error.
+	 *
+	 * @param create discard existing file contents?
+	 */
+	InputCacheItem(std::string &&_uri, std::string &&_version,
+		       AllocatedPath &&_data_path,
+		       AllocatedPath &&_meta_path,
+		       offset_type _size, bool create);
+
+	~InputCacheItem() noexcept;
+
+	InputCacheItem(const InputCacheItem &) = delete;
+	InputCacheItem &operator=(const InputCacheItem &) = delete;
+
+	const std::string &GetUri() const noexcept {
+		return uri;
+	}
+
+	const std::string &GetVersion() const noexcept {
+		return version;
+	}
+
+	offset_type GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Is the data at the given offset in the cache?
+	 */
+	gcc_pure
+	bool IsDefined(offset_type offset) const noexcept;
+
+	/**
+	 * Has the whole resource been cached?
+	 */
+	gcc_pure
+	bool IsComplete() const noexcept;
+
+	/**
+	 * Read cached data at the given offset.
+	 *
+	 * Throws on I/O error.
+	 *
+	 * @return the number of bytes read; 0 if the data at this
+	 * offset is not in the cache
+	 */
+	size_t Read(offset_type offset, void *dest, size_t length);
+
+	/**
+	 * Store data at the given offset.  Errors are logged and
+	 * disable further writes; they are not fatal, because the
+	 * caller already has the data.
+	 */
+	void Write(offset_type offset, const void *src,
+		   size_t length) noexcept;
+
+	/**
+	 * Mark the given range as "defined" (used while loading the
+	 * "meta" file).
+	 */
+	void Commit(offset_type start, offset_type end) noexcept {
+		map.Commit(start, end);
+	}
+
+	/**
+	 * Write the "meta" file.
+	 *
+	 * Throws on error.
+	 */
+	void Save() const;
+
+	/**
+	 * Delete the data and the "meta" file.
+	 */
+	void Remove() noexcept;
+
+	struct Hash : std::hash<std::string> {
+		using std::hash<std::string>::operator();
+
+		gcc_pure
+		std::size_t operator()(const InputCacheItem &item) const noexcept {
+			return std::hash<std::string>::operator()(item.uri);
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const InputCacheItem &a,
+				const InputCacheItem &b) const noexcept {
+			return a.uri == b.uri;
+		}
+
+		gcc_pure
+		bool operator()(const std::string &a,
+				const InputCacheItem &b) const noexcept {
+			return a == b.uri;
+		}
+	};
+};
+
+#endif
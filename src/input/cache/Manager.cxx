@@ -0,0 +1,338 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Manager.hxx"
+#include "Domain.hxx"
+#include "input/InputStream.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/TextFile.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringCompare.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <vector>
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define INPUT_CACHE_DATA_SUFFIX ".data"
+#define INPUT_CACHE_META_SUFFIX ".meta"
+
+InputCacheManager *input_cache_manager;
+
+void
+InputCacheLease::Release() noexcept
+{
+	if (item != nullptr)
+		manager->Release(*std::exchange(item, nullptr));
+}
+
+InputCacheManager::InputCacheManager(AllocatedPath &&_directory,
+				     uint64_t _max_size)
+	:directory(std::move(_directory)), max_total_size(_max_size),
+	 map(KeyMap::bucket_traits(&buckets.front(), buckets.size()))
+{
+	Load();
+
+	FormatDebug(input_cache_domain,
+		    "loaded %zu items, %llu of %llu bytes",
+		    map.size(), (unsigned long long)total_size,
+		    (unsigned long long)max_total_size);
+}
+
+InputCacheManager::~InputCacheManager() noexcept
+{
+	map.clear();
+	items.clear_and_dispose([](InputCacheItem *item){
+			if (item->dirty) {
+				try {
+					item->Save();
+				} catch (...) {
+					LogError(std::current_exception());
+				}
+			}
+
+			delete item;
+		});
+}
+
+std::string
+InputCacheManager::MakeBaseName(const std::string &uri) const noexcept
+{
+	/* 64 bit FNV-1a */
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char ch : uri)
+		hash = (hash ^ ch) * 1099511628211ull;
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx",
+		 (unsigned long long)hash);
+	return buffer;
+}
+
+void
+InputCacheManager::LoadItem(Path meta_path)
+{
+	TextFile file(meta_path);
+
+	std::string uri, version;
+	offset_type size = 0;
+	std::vector<std::pair<offset_type, offset_type>> ranges;
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		const char *value;
+		if ((value = StringAfterPrefix(line, "uri: ")) != nullptr)
+			uri = value;
+		else if ((value = StringAfterPrefix(line, "version: ")) != nullptr)
+			version = value;
+		else if ((value = StringAfterPrefix(line, "size: ")) != nullptr)
+			size = ParseUint64(value);
+		else if ((value = StringAfterPrefix(line, "range: ")) != nullptr) {
+			char *endptr;
+			offset_type start = ParseUint64(value, &endptr);
+			offset_type end = ParseUint64(endptr);
+			if (start >= end || end > size)
+				throw FormatRuntimeError("Malformed range in %s",
+							 meta_path.c_str());
+
+			ranges.emplace_back(start, end);
+		} else
+			throw FormatRuntimeError("Unknown line in %s: %s",
+						 meta_path.c_str(), line);
+	}
+
+	if (uri.empty() || version.empty() || size == 0 || size > SIZE_MAX)
+		throw FormatRuntimeError("Incomplete cache item %s",
+					 meta_path.c_str());
+
+	const auto base = MakeBaseName(uri);
+	if (!StringStartsWith(meta_path.GetBase().c_str(), base.c_str()))
+		throw FormatRuntimeError("Wrong file name: %s",
+					 meta_path.c_str());
+
+	auto *item = new InputCacheItem(std::move(uri), std::move(version),
+					AllocatedPath::Build(directory,
+							     (base + INPUT_CACHE_DATA_SUFFIX).c_str()),
+					AllocatedPath::FromFS(meta_path.c_str()),
+					size, false);
+
+	for (const auto &i : ranges)
+		item->Commit(i.first, i.second);
+
+	Add(*item);
+}
+
+void
+InputCacheManager::Load()
+{
+	struct MetaFile {
+		std::chrono::system_clock::time_point mtime;
+		AllocatedPath path;
+	};
+
+	std::vector<MetaFile> meta_files;
+	std::vector<AllocatedPath> data_files;
+
+	DirectoryReader reader(directory);
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		auto path = AllocatedPath::Build(directory, name);
+
+		if (StringEndsWith(name.c_str(), INPUT_CACHE_META_SUFFIX)) {
+			FileInfo info;
+			if (GetFileInfo(path, info) && info.IsRegular())
+				meta_files.push_back({info.GetModificationTime(),
+							std::move(path)});
+		} else if (StringEndsWith(name.c_str(), INPUT_CACHE_DATA_SUFFIX))
+			data_files.emplace_back(std::move(path));
+	}
+
+	/* the oldest "meta" file is the least recently used item */
+	std::sort(meta_files.begin(), meta_files.end(),
+		  [](const MetaFile &a, const MetaFile &b){
+			  return a.mtime < b.mtime;
+		  });
+
+	for (const auto &i : meta_files) {
+		try {
+			LoadItem(i.path);
+		} catch (...) {
+			LogError(std::current_exception());
+
+			try {
+				RemoveFile(i.path);
+			} catch (...) {
+			}
+		}
+	}
+
+	/* delete data files which have no "meta" file */
+	std::set<std::string> known;
+	for (const auto &i : items)
+		known.emplace(i.data_path.c_str());
+
+	for (const auto &i : data_files) {
+		if (known.find(i.c_str()) != known.end())
+			continue;
+
+		try {
+			RemoveFile(i);
+		} catch (...) {
+		}
+	}
+
+	/* the configured size may have been reduced */
+	MakeRoom(0);
+}
+
+bool
+InputCacheManager::IsEligible(const InputStream &is) const noexcept
+{
+	assert(is.IsReady());
+
+	return is.IsSeekable() && is.KnownSize() && is.HasVersion() &&
+		is.GetSize() > 0 &&
+		is.GetSize() <= max_total_size &&
+		is.GetSize() <= SIZE_MAX;
+}
+
+inline void
+InputCacheManager::Add(InputCacheItem &item) noexcept
+{
+	map.insert(item);
+	items.push_back(item);
+	total_size += item.size;
+}
+
+void
+InputCacheManager::Delete(InputCacheItem &item) noexcept
+{
+	assert(item.references == 0);
+	assert(total_size >= item.size);
+
+	map.erase(map.iterator_to(item));
+	items.erase(items.iterator_to(item));
+	total_size -= item.size;
+
+	item.Remove();
+	delete &item;
+}
+
+bool
+InputCacheManager::MakeRoom(uint64_t needed) noexcept
+{
+	if (needed > max_total_size)
+		return false;
+
+	for (auto i = items.begin();
+	     total_size + needed > max_total_size;) {
+		if (i == items.end())
+			/* all remaining items are in use */
+			return false;
+
+		auto &item = *i++;
+		if (item.references == 0) {
+			FormatDebug(input_cache_domain, "evicting %s",
+				    item.uri.c_str());
+			Delete(item);
+		}
+	}
+
+	return true;
+}
+
+InputCacheLease
+InputCacheManager::Get(const InputStream &is) noexcept
+{
+	assert(IsEligible(is));
+
+	const std::string uri(is.GetURI());
+	const char *const version = is.GetVersion();
+	const offset_type size = is.GetSize();
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(uri, InputCacheItem::Hash(), InputCacheItem::Equal());
+	if (i != map.end()) {
+		if (i->version == version && i->size == size) {
+			/* move to the end of the LRU list */
+			items.erase(items.iterator_to(*i));
+			items.push_back(*i);
+
+			++i->references;
+			return {*this, *i};
+		}
+
+		if (i->references > 0)
+			/* still being used with the old version */
+			return {};
+
+		FormatDebug(input_cache_domain, "discarding stale %s",
+			    uri.c_str());
+		Delete(*i);
+	}
+
+	if (!MakeRoom(size))
+		return {};
+
+	try {
+		const auto base = MakeBaseName(uri);
+		auto *item = new InputCacheItem(std::string(uri), version,
+						AllocatedPath::Build(directory,
+								     (base + INPUT_CACHE_DATA_SUFFIX).c_str()),
+						AllocatedPath::Build(directory,
+								     (base + INPUT_CACHE_META_SUFFIX).c_str()),
+						size, true);
+		Add(*item);
+
+		++item->references;
+		return {*this, *item};
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to create input cache item");
+		return {};
+	}
+}
+
+void
+InputCacheManager::Release(InputCacheItem &item) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	assert(item.references > 0);
+	if (--item.references > 0)
+		return;
+
+	/* save even if nothing was written, because the "meta" file's
+	   modification time records the LRU order */
+	try {
+		item.Save();
+		item.dirty = false;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save input cache item");
+	}
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_MANAGER_HXX
+#define MPD_INPUT_CACHE_MANAGER_HXX
+
+#include "Item.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+
+#include <boost/intrusive/list.hpp>
+#include <boost/intrusive/unordered_set.hpp>
+
+#include <array>
+#include <string>
+
+#include <stdint.h>
+
+class InputStream;
+class InputCacheManager;
+
+/**
+ * A reference to an #InputCacheItem.  As long as it exists, the item
+ * will not be evicted.
+ */
+class InputCacheLease {
+	InputCacheManager *manager = nullptr;
+	InputCacheItem *item = nullptr;
+
+public:
+	InputCacheLease() = default;
+
+	InputCacheLease(InputCacheManager &_manager,
+			InputCacheItem &_item) noexcept
+		:manager(&_manager), item(&_item) {}
+
+	InputCacheLease(InputCacheLease &&src) noexcept
+		:manager(src.manager), item(src.item) {
+		src.item = nullptr;
+	}
+
+	~InputCacheLease() noexcept {
+		Release();
+	}
+
+	InputCacheLease &operator=(InputCacheLease &&src) noexcept {
+		std::swap(manager, src.manager);
+		std::swap(item, src.item);
+		return *this;
+	}
+
+	explicit operator bool() const noexcept {
+		return item != nullptr;
+	}
+
+	InputCacheItem *operator->() const noexcept {
+		return item;
+	}
+
+	InputCacheItem &operator*() const noexcept {
+		return *item;
+	}
+
+	void Release() noexcept;
+};
+
+/**
+ * A size-bounded persistent cache for the contents of remote
+ * resources.  The items are stored in a directory; the least recently
+ * used ones are evicted when the configured size is exceeded.
+ *
+ * All public methods are thread-safe.
+ */
+class InputCacheManager {
+	friend class InputCacheLease;
+
+	const AllocatedPath directory;
+
+	const uint64_t max_total_size;
+
+	Mutex mutex;
+
+	/**
+	 * The sum of the sizes of all items.  Sparse items are
+	 * accounted with their whole size, because they will usually
+	 * be filled sooner or later.
+	 */
+	uint64_t total_size = 0;
+
+	typedef boost::intrusive::list<InputCacheItem,
+				       boost::intrusive::constant_time_size<false>> ItemList;
+
+	/**
+	 * All items; the least recently used one comes first and is
+	 * the first one to be evicted.
+	 */
+	ItemList items;
+
+	typedef boost::intrusive::unordered_set<InputCacheItem,
+						boost::intrusive::hash<InputCacheItem::Hash>,
+						boost::intrusive::equal<InputCacheItem::Equal>,
+						boost::intrusive::constant_time_size<true>> KeyMap;
+
+	std::array<typename KeyMap::bucket_type, 1021> buckets;
+
+	KeyMap map;
+
+public:
+	/**
+	 * Load the existing items from the given directory.
+	 *
+	 * Throws on error.
+	 */
+	InputCacheManager(AllocatedPath &&_directory, uint64_t _max_size);
+	~InputCacheManager() noexcept;
+
+	InputCacheManager(const InputCacheManager &) = delete;
+	InputCacheManager &operator=(const InputCacheManager &) = delete;
+
+	/**
+	 * Can the given (ready) #InputStream be cached?  It must be
+	 * seekable, have a known size and a version.
+	 */
+	gcc_pure
+	bool IsEligible(const InputStream &is) const noexcept;
+
+	/**
+	 * Look up (or create) the item for the given (ready and
+	 * eligible) #InputStream.  An existing item whose version or
+	 * size differs is discarded.
+	 *
+	 * @return a lease or an empty lease if there is not enough
+	 * room in the cache or if the item could not be created
+	 */
+	InputCacheLease Get(const InputStream &is) noexcept;
+
+private:
+	void Load();
+	void LoadItem(Path meta_path);
+
+	/**
+	 * Evict unreferenced items until there is room for the given
+	 * number of bytes.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @return false if there is not enough room
+	 */
+	bool MakeRoom(uint64_t needed) noexcept;
+
+	/**
+	 * Remove the given (unreferenced) item from the cache,
+	 * including its files.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Delete(InputCacheItem &item) noexcept;
+
+	void Add(InputCacheItem &item) noexcept;
+
+	std::string MakeBaseName(const std::string &uri) const noexcept;
+
+	void Release(InputCacheItem &item) noexcept;
+};
+
+/**
+ * The global cache instance, or nullptr if the cache is disabled.
+ */
+extern InputCacheManager *input_cache_manager;
+
+#endif
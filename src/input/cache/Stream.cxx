@@ -0,0 +1,143 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Stream.hxx"
+#include "Domain.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+
+void
+CacheInputStream::CheckLease() noexcept
+{
+	if (checked || !IsReady())
+		return;
+
+	checked = true;
+
+	if (!manager.IsEligible(*this))
+		return;
+
+	lease = manager.Get(*this);
+	if (!lease)
+		return;
+
+	if (lease->IsComplete()) {
+		FormatDebug(input_cache_domain, "serving %s from cache",
+			    GetURI());
+
+		/* we don't need the input anymore; its destructor may
+		   need to lock the mutex */
+		auto old_input = std::move(input);
+		const ScopeUnlock unlock(mutex);
+		old_input.reset();
+	}
+}
+
+void
+CacheInputStream::Update() noexcept
+{
+	if (lease) {
+		/* don't copy the attributes from the input: our
+		   offset is not necessarily the input's offset */
+		if (input)
+			input->Update();
+		return;
+	}
+
+	ProxyInputStream::Update();
+	CheckLease();
+}
+
+void
+CacheInputStream::Seek(offset_type new_offset)
+{
+	if (!lease) {
+		ProxyInputStream::Seek(new_offset);
+		CheckLease();
+		return;
+	}
+
+	if (new_offset > size)
+		throw std::runtime_error("Invalid offset");
+
+	/* the input will be seeked lazily by Read(), only if the
+	   data at the new offset is not cached */
+	offset = new_offset;
+}
+
+bool
+CacheInputStream::IsEOF() noexcept
+{
+	if (!lease)
+		return ProxyInputStream::IsEOF();
+
+	return offset >= size;
+}
+
+bool
+CacheInputStream::IsAvailable() noexcept
+{
+	if (!lease)
+		return ProxyInputStream::IsAvailable();
+
+	/* if the input is at a different offset, Read() is going to
+	   seek it, which blocks, but doesn't need to be waited for */
+	return offset >= size || lease->IsDefined(offset) ||
+		!input || input->GetOffset() != offset ||
+		input->IsAvailable();
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size)
+{
+	if (!lease) {
+		size_t nbytes = ProxyInputStream::Read(ptr, read_size);
+		CheckLease();
+		return nbytes;
+	}
+
+	if (offset >= size)
+		return 0;
+
+	size_t nbytes = lease->Read(offset, ptr, read_size);
+	if (nbytes == 0) {
+		/* not cached: read from the input and store the data
+		   in the cache */
+
+		if (!input)
+			throw std::runtime_error("Data missing from cache");
+
+		if (input->GetOffset() != offset)
+			input->Seek(offset);
+
+		nbytes = input->Read(ptr, read_size);
+		if (nbytes == 0)
+			return 0;
+
+		if (nbytes > size - offset)
+			/* the input is larger than announced */
+			nbytes = size - offset;
+
+		lease->Write(offset, ptr, nbytes);
+	}
+
+	offset += nbytes;
+	return nbytes;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CACHE_INPUT_STREAM_HXX
+#define MPD_CACHE_INPUT_STREAM_HXX
+
+#include "Manager.hxx"
+#include "input/ProxyInputStream.hxx"
+
+/**
+ * A proxy which stores the data read from its input in an
+ * #InputCacheItem, and serves subsequent reads of the same ranges
+ * (in this stream or in later ones for the same URI and version)
+ * from there.
+ *
+ * Once the input becomes ready, it is checked whether it is eligible
+ * (see InputCacheManager::IsEligible()); if not, this class is just a
+ * transparent proxy.  If the resource is already cached completely,
+ * the input is closed.
+ */
+class CacheInputStream final : public ProxyInputStream {
+	InputCacheManager &manager;
+
+	InputCacheLease lease;
+
+	/**
+	 * Has the input been checked by CheckLease() already?
+	 */
+	bool checked = false;
+
+public:
+	CacheInputStream(InputStreamPtr _input,
+			 InputCacheManager &_manager) noexcept
+		:ProxyInputStream(std::move(_input)), manager(_manager) {}
+
+	/* virtual methods from class InputStream */
+	void Update() noexcept override;
+	void Seek(offset_type new_offset) override;
+	bool IsEOF() noexcept override;
+	bool IsAvailable() noexcept override;
+	size_t Read(void *ptr, size_t read_size) override;
+
+private:
+	/**
+	 * If the input has become ready, obtain a lease from the
+	 * #InputCacheManager (once).
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void CheckLease() noexcept;
+};
+
+#endif
@@ -25,22 +25,24 @@
  */
 
 #include "AlsaInputPlugin.hxx"
-#include "lib/alsa/NonBlock.hxx"
 #include "../InputPlugin.hxx"
-#include "../AsyncInputStream.hxx"
-#include "event/Call.hxx"
-#include "thread/Cond.hxx"
+#include "../ThreadInputStream.hxx"
+#include "config/Block.hxx"
+#include "thread/Util.hxx"
 #include "util/Domain.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/StringCompare.hxx"
 #include "util/ASCII.hxx"
 #include "Log.hxx"
-#include "event/MultiSocketMonitor.hxx"
-#include "event/DeferEvent.hxx"
 
 #include <alsa/asoundlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 static constexpr Domain alsa_input_domain("alsa");
@@ -53,11 +55,49 @@ static constexpr int default_channels = 2; // stereo
 static constexpr unsigned int default_rate = 44100; // cd quality
 
 static constexpr size_t ALSA_MAX_BUFFERED = default_rate * default_channels * 2;
-static constexpr size_t ALSA_RESUME_AT = ALSA_MAX_BUFFERED / 2;
 
-class AlsaInputStream final
-	: public AsyncInputStream,
-	  MultiSocketMonitor {
+/**
+ * The largest frame size supported by this plugin; used for the
+ * #AlsaInputStream::partial_frame buffer.
+ */
+static constexpr size_t MAX_FRAME_SIZE = 32;
+
+/**
+ * How long the capture thread waits for the device in one
+ * snd_pcm_wait() call.  This limits how long it takes to notice
+ * Cancel().
+ */
+static constexpr int WAIT_TIMEOUT_MS = 100;
+
+/**
+ * libasound's buffer_time setting (in microseconds; the "buffer_time"
+ * setting); 0 means use the largest buffer the device supports.
+ */
+static unsigned alsa_buffer_time;
+
+/**
+ * libasound's period_time setting (in microseconds; the
+ * "period_time" setting); 0 means a quarter of the buffer.
+ */
+static unsigned alsa_period_time;
+
+/**
+ * Attempt to use mmap access (the "mmap" setting)?
+ */
+static bool alsa_mmap = true;
+
+/**
+ * The SCHED_FIFO priority of the capture thread (the
+ * "realtime_priority" setting); 0 means don't request real-time
+ * scheduling.
+ */
+static unsigned alsa_realtime_priority = 50;
+
+/**
+ * Captures from an ALSA device in a dedicated thread, so a busy
+ * #EventLoop cannot cause overruns.
+ */
+class AlsaInputStream final : public ThreadInputStream {
 
 	/**
 	 * The configured name of the ALSA device.
@@ -67,86 +107,84 @@ class AlsaInputStream final
 	snd_pcm_t *const capture_handle;
 	const size_t frame_size;
 
-	AlsaNonBlockPcm non_block;
+	/**
+	 * Was mmap access configured?  Then frames are copied
+	 * straight from the hardware buffer with
+	 * snd_pcm_mmap_begin().
+	 */
+	const bool use_mmap;
+
+	/**
+	 * Set by Cancel() to make the capture thread return from
+	 * ThreadRead() early.
+	 */
+	std::atomic_bool cancel;
+
+	/**
+	 * A frame which did not fit into the free part of the
+	 * #ThreadInputStream buffer; its remainder is returned by the
+	 * next ThreadRead() call.
+	 */
+	uint8_t partial_frame[MAX_FRAME_SIZE];
 
-	DeferEvent defer_invalidate_sockets;
+	size_t partial_position = 0, partial_size = 0;
 
 public:
-	AlsaInputStream(EventLoop &_loop,
-			const char *_uri, Mutex &_mutex,
+	AlsaInputStream(const char *_uri, Mutex &_mutex,
 			const char *_device,
-			snd_pcm_t *_handle, int _frame_size)
-		:AsyncInputStream(_loop, _uri, _mutex,
-				  ALSA_MAX_BUFFERED, ALSA_RESUME_AT),
-		 MultiSocketMonitor(_loop),
+			snd_pcm_t *_handle, size_t _frame_size,
+			bool _use_mmap)
+		:ThreadInputStream(input_plugin_alsa.name, _uri, _mutex,
+				   ALSA_MAX_BUFFERED),
 		 device(_device),
 		 capture_handle(_handle),
 		 frame_size(_frame_size),
-		 defer_invalidate_sockets(_loop,
-					  BIND_THIS_METHOD(InvalidateSockets))
+		 use_mmap(_use_mmap),
+		 cancel(false)
 	{
 		assert(_uri != nullptr);
 		assert(_handle != nullptr);
-
-		/* this mime type forces use of the PcmDecoderPlugin.
-		   Needs to be generalised when/if that decoder is
-		   updated to support other audio formats */
-		SetMimeType("audio/x-mpd-cdda-pcm");
-		InputStream::SetReady();
-
-		snd_pcm_start(capture_handle);
-
-		defer_invalidate_sockets.Schedule();
+		assert(frame_size > 0 && frame_size <= MAX_FRAME_SIZE);
 	}
 
-	~AlsaInputStream() {
-		BlockingCall(MultiSocketMonitor::GetEventLoop(), [this](){
-				MultiSocketMonitor::Reset();
-				defer_invalidate_sockets.Cancel();
-			});
+	~AlsaInputStream() override {
+		Stop();
 
 		snd_pcm_close(capture_handle);
 	}
 
-	static InputStreamPtr Create(EventLoop &event_loop, const char *uri,
-				     Mutex &mutex);
+	static InputStreamPtr Create(const char *uri, Mutex &mutex);
 
 protected:
-	/* virtual methods from AsyncInputStream */
-	virtual void DoResume() override {
-		snd_pcm_resume(capture_handle);
-
-		InvalidateSockets();
-	}
+	/* virtual methods from ThreadInputStream */
+	void Open() override;
+	size_t ThreadRead(void *ptr, size_t size) override;
 
-	virtual void DoSeek(gcc_unused offset_type new_offset) override {
-		/* unreachable because seekable==false */
-		SeekDone();
+	void Cancel() noexcept override {
+		cancel = true;
 	}
 
 private:
 	static snd_pcm_t *OpenDevice(const char *device, int rate,
-				     snd_pcm_format_t format, int channels);
+				     snd_pcm_format_t format, int channels,
+				     bool &use_mmap);
 
-	void Pause() {
-		AsyncInputStream::Pause();
-		InvalidateSockets();
-	}
+	/**
+	 * Wait until the device has captured at least one frame and
+	 * copy up to #max_frames to #dest.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return the number of frames copied, or 0 if Cancel() was
+	 * called
+	 */
+	snd_pcm_uframes_t Capture(void *dest, snd_pcm_uframes_t max_frames);
 
 	int Recover(int err);
-
-	void SafeInvalidateSockets() {
-		defer_invalidate_sockets.Schedule();
-	}
-
-	/* virtual methods from class MultiSocketMonitor */
-	std::chrono::steady_clock::duration PrepareSockets() noexcept override;
-	void DispatchSockets() noexcept override;
 };
 
 inline InputStreamPtr
-AlsaInputStream::Create(EventLoop &event_loop, const char *uri,
-			Mutex &mutex)
+AlsaInputStream::Create(const char *uri, Mutex &mutex)
 {
 	const char *device = StringAfterPrefixCaseASCII(uri, "alsa://");
 	if (device == nullptr)
@@ -162,55 +200,133 @@ AlsaInputStream::Create(EventLoop &event_loop, const char *uri,
 	snd_pcm_format_t format = default_format;
 	int channels = default_channels;
 
-	snd_pcm_t *handle = OpenDevice(device, rate, format, channels);
+	bool use_mmap;
+	snd_pcm_t *handle = OpenDevice(device, rate, format, channels,
+				       use_mmap);
 
-	int frame_size = snd_pcm_format_width(format) / 8 * channels;
-	return std::make_unique<AlsaInputStream>(event_loop,
-						 uri, mutex,
-						 device, handle, frame_size);
+	size_t frame_size = snd_pcm_format_width(format) / 8 * channels;
+	auto is = std::make_unique<AlsaInputStream>(uri, mutex,
+						    device, handle, frame_size,
+						    use_mmap);
+	is->Start();
+	return is;
 }
 
-std::chrono::steady_clock::duration
-AlsaInputStream::PrepareSockets() noexcept
+void
+AlsaInputStream::Open()
 {
-	if (IsPaused()) {
-		ClearSocketList();
-		return std::chrono::steady_clock::duration(-1);
+	if (alsa_realtime_priority > 0) {
+		try {
+			SetThreadRealtime(alsa_realtime_priority);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "ALSA capture thread could not get realtime scheduling, continuing anyway");
+		}
 	}
 
-	return non_block.PrepareSockets(*this, capture_handle);
+	/* this mime type forces use of the PcmDecoderPlugin.
+	   Needs to be generalised when/if that decoder is
+	   updated to support other audio formats */
+	SetMimeType("audio/x-mpd-cdda-pcm");
+
+	int err = snd_pcm_start(capture_handle);
+	if (err < 0)
+		throw FormatRuntimeError("Failed to start ALSA capture device \"%s\": %s",
+					 device.c_str(), snd_strerror(-err));
 }
 
-void
-AlsaInputStream::DispatchSockets() noexcept
+snd_pcm_uframes_t
+AlsaInputStream::Capture(void *dest, snd_pcm_uframes_t max_frames)
 {
-	non_block.DispatchSockets(*this, capture_handle);
+	assert(max_frames > 0);
+
+	while (!cancel) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(capture_handle);
+		if (avail == 0) {
+			int err = snd_pcm_wait(capture_handle,
+					       WAIT_TIMEOUT_MS);
+			if (err < 0 && Recover(err) < 0)
+				throw std::runtime_error("PCM error - stream aborted");
+			continue;
+		}
+
+		if (avail < 0) {
+			if (Recover(avail) < 0)
+				throw std::runtime_error("PCM error - stream aborted");
+			continue;
+		}
 
-	const std::lock_guard<Mutex> protect(mutex);
+		snd_pcm_uframes_t frames =
+			std::min<snd_pcm_uframes_t>(avail, max_frames);
 
-	auto w = PrepareWriteBuffer();
-	const snd_pcm_uframes_t w_frames = w.size / frame_size;
-	if (w_frames == 0) {
-		/* buffer is full */
-		Pause();
-		return;
-	}
+		if (!use_mmap) {
+			const auto n = snd_pcm_readi(capture_handle,
+						     dest, frames);
+			if (n > 0)
+				return n;
 
-	snd_pcm_sframes_t n_frames;
-	while ((n_frames = snd_pcm_readi(capture_handle,
-					 w.data, w_frames)) < 0) {
-		if (n_frames == -EAGAIN)
-			return;
+			if (n < 0 && n != -EAGAIN &&
+			    Recover(n) < 0)
+				throw std::runtime_error("PCM error - stream aborted");
+			continue;
+		}
 
-		if (Recover(n_frames) < 0) {
-			postponed_exception = std::make_exception_ptr(std::runtime_error("PCM error - stream aborted"));
-			InvokeOnAvailable();
-			return;
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		int err = snd_pcm_mmap_begin(capture_handle, &areas,
+					     &offset, &frames);
+		if (err < 0) {
+			if (Recover(err) < 0)
+				throw std::runtime_error("PCM error - stream aborted");
+			continue;
 		}
+
+		/* with interleaved access, all channels share one
+		   area */
+		const auto *src = (const uint8_t *)areas[0].addr
+			+ areas[0].first / 8
+			+ offset * (areas[0].step / 8);
+		memcpy(dest, src, frames * frame_size);
+
+		const auto committed = snd_pcm_mmap_commit(capture_handle,
+							   offset, frames);
+		if (committed > 0)
+			return committed;
+
+		if (committed < 0 && Recover(committed) < 0)
+			throw std::runtime_error("PCM error - stream aborted");
+	}
+
+	return 0;
+}
+
+size_t
+AlsaInputStream::ThreadRead(void *ptr, size_t size)
+{
+	if (partial_position < partial_size) {
+		/* return the rest of the frame which didn't fit last
+		   time */
+		const size_t nbytes = std::min(size,
+					       partial_size - partial_position);
+		memcpy(ptr, partial_frame + partial_position, nbytes);
+		partial_position += nbytes;
+		return nbytes;
+	}
+
+	if (size < frame_size) {
+		/* the free part of the buffer ends in the middle of
+		   a frame; capture one frame and split it */
+		partial_position = partial_size = 0;
+		if (Capture(partial_frame, 1) == 0)
+			return 0;
+
+		partial_size = frame_size;
+		memcpy(ptr, partial_frame, size);
+		partial_position = size;
+		return size;
 	}
 
-	size_t nbytes = n_frames * frame_size;
-	CommitWriteBuffer(nbytes);
+	return Capture(ptr, size / frame_size) * frame_size;
 }
 
 inline int
@@ -272,7 +388,10 @@ AlsaInputStream::Recover(int err)
 	return err;
 }
 
-static void
+/**
+ * @return true if mmap access was configured
+ */
+static bool
 ConfigureCapture(snd_pcm_t *capture_handle,
 		 int rate, snd_pcm_format_t format, int channels)
 {
@@ -285,7 +404,20 @@ ConfigureCapture(snd_pcm_t *capture_handle,
 		throw FormatRuntimeError("Cannot initialize hardware parameter structure (%s)",
 					 snd_strerror(err));
 
-	if ((err = snd_pcm_hw_params_set_access(capture_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
+	bool use_mmap = false;
+	if (alsa_mmap) {
+		err = snd_pcm_hw_params_set_access(capture_handle, hw_params,
+						   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if (err == 0)
+			use_mmap = true;
+		else
+			FormatDebug(alsa_input_domain,
+				    "mmap access not supported: %s",
+				    snd_strerror(-err));
+	}
+
+	if (!use_mmap &&
+	    (err = snd_pcm_hw_params_set_access(capture_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
 		throw FormatRuntimeError("Cannot set access type (%s)",
 					 snd_strerror(err));
 
@@ -321,21 +453,37 @@ ConfigureCapture(snd_pcm_t *capture_handle,
 		    (unsigned)period_size_min, (unsigned)period_size_max,
 		    period_time_min, period_time_max);
 
-	/* choose the maximum possible buffer_size ... */
-	snd_pcm_hw_params_set_buffer_size(capture_handle, hw_params,
-					  buffer_size_max);
-
-	/* ... and calculate the period_size to have four periods in
-	   one buffer; this way, we get woken up often enough to avoid
-	   buffer overruns, but not too often */
-	snd_pcm_uframes_t buffer_size;
-	if (snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_size) == 0) {
-		snd_pcm_uframes_t period_size = buffer_size / 4;
-		int direction = -1;
-		if ((err = snd_pcm_hw_params_set_period_size_near(capture_handle, hw_params,
-								  &period_size, &direction)) < 0)
-			throw FormatRuntimeError("Cannot set period size (%s)",
+	if (alsa_buffer_time > 0) {
+		unsigned buffer_time = alsa_buffer_time;
+		if ((err = snd_pcm_hw_params_set_buffer_time_near(capture_handle, hw_params,
+								  &buffer_time, nullptr)) < 0)
+			throw FormatRuntimeError("Cannot set buffer time (%s)",
 						 snd_strerror(err));
+	} else
+		/* choose the maximum possible buffer_size ... */
+		snd_pcm_hw_params_set_buffer_size(capture_handle, hw_params,
+						  buffer_size_max);
+
+	if (alsa_period_time > 0) {
+		unsigned period_time = alsa_period_time;
+		if ((err = snd_pcm_hw_params_set_period_time_near(capture_handle, hw_params,
+								  &period_time, nullptr)) < 0)
+			throw FormatRuntimeError("Cannot set period time (%s)",
+						 snd_strerror(err));
+	} else {
+		/* ... and calculate the period_size to have four
+		   periods in one buffer; this way, we get woken up
+		   often enough to avoid buffer overruns, but not too
+		   often */
+		snd_pcm_uframes_t buffer_size;
+		if (snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_size) == 0) {
+			snd_pcm_uframes_t period_size = buffer_size / 4;
+			int direction = -1;
+			if ((err = snd_pcm_hw_params_set_period_size_near(capture_handle, hw_params,
+									  &period_size, &direction)) < 0)
+				throw FormatRuntimeError("Cannot set period size (%s)",
+							 snd_strerror(err));
+		}
 	}
 
 	if ((err = snd_pcm_hw_params(capture_handle, hw_params)) < 0)
@@ -355,8 +503,9 @@ ConfigureCapture(snd_pcm_t *capture_handle,
 		throw FormatRuntimeError("snd_pcm_hw_params_get_period_size() failed: %s",
 					 snd_strerror(-err));
 
-	FormatDebug(alsa_input_domain, "buffer_size=%u period_size=%u",
-		    (unsigned)alsa_buffer_size, (unsigned)alsa_period_size);
+	FormatDebug(alsa_input_domain, "buffer_size=%u period_size=%u mmap=%d",
+		    (unsigned)alsa_buffer_size, (unsigned)alsa_period_size,
+		    use_mmap);
 
 	snd_pcm_sw_params_t *sw_params;
 	snd_pcm_sw_params_alloca(&sw_params);
@@ -366,11 +515,14 @@ ConfigureCapture(snd_pcm_t *capture_handle,
 	if ((err = snd_pcm_sw_params(capture_handle, sw_params)) < 0)
 		throw FormatRuntimeError("unable to install sw params (%s)",
 					 snd_strerror(err));
+
+	return use_mmap;
 }
 
 inline snd_pcm_t *
 AlsaInputStream::OpenDevice(const char *device,
-			    int rate, snd_pcm_format_t format, int channels)
+			    int rate, snd_pcm_format_t format, int channels,
+			    bool &use_mmap)
 {
 	snd_pcm_t *capture_handle;
 	int err;
@@ -381,7 +533,8 @@ AlsaInputStream::OpenDevice(const char *device,
 					 device, snd_strerror(err));
 
 	try {
-		ConfigureCapture(capture_handle, rate, format, channels);
+		use_mmap = ConfigureCapture(capture_handle,
+					    rate, format, channels);
 	} catch (...) {
 		snd_pcm_close(capture_handle);
 		throw;
@@ -394,19 +547,23 @@ AlsaInputStream::OpenDevice(const char *device,
 
 /*#########################  Plugin Functions  ##############################*/
 
-static EventLoop *alsa_input_event_loop;
-
 static void
-alsa_input_init(EventLoop &event_loop, const ConfigBlock &)
+alsa_input_init(EventLoop &, const ConfigBlock &block)
 {
-	alsa_input_event_loop = &event_loop;
+	alsa_buffer_time = block.GetPositiveValue("buffer_time", 0u);
+	alsa_period_time = block.GetPositiveValue("period_time", 0u);
+	alsa_mmap = block.GetBlockValue("mmap", true);
+
+	alsa_realtime_priority = block.GetBlockValue("realtime_priority",
+						     alsa_realtime_priority);
+	if (alsa_realtime_priority > 99)
+		throw std::runtime_error("realtime_priority must be 0..99");
 }
 
 static InputStreamPtr
 alsa_input_open(const char *uri, Mutex &mutex)
 {
-	return AlsaInputStream::Create(*alsa_input_event_loop, uri,
-				       mutex);
+	return AlsaInputStream::Create(uri, mutex);
 }
 
 static constexpr const char *alsa_prefixes[] = {
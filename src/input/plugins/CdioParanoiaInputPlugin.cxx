@@ -24,7 +24,7 @@
 #include "config.h"
 #include "CdioParanoiaInputPlugin.hxx"
 #include "lib/cdio/Paranoia.hxx"
-#include "../InputStream.hxx"
+#include "../ThreadInputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "util/TruncateString.hxx"
 #include "util/StringCompare.hxx"
@@ -36,6 +36,9 @@
 #include "config/Block.hxx"
 #include "config/Domain.hxx"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -44,61 +47,106 @@
 
 #include <cdio/cd_types.h>
 
-class CdioParanoiaInputStream final : public InputStream {
+static constexpr Domain cdio_domain("cdio");
+
+static bool default_reverse_endian;
+static unsigned speed = 0;
+
+/**
+ * The flags passed to paranoia_modeset().
+ */
+static int mode_flags = PARANOIA_MODE_FULL ^ PARANOIA_MODE_NEVERSKIP;
+
+static constexpr size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+/**
+ * The size of the read-ahead buffer in bytes.
+ */
+static size_t buffer_size = DEFAULT_BUFFER_SIZE;
+
+/**
+ * Read at most this number of sectors in one ThreadRead() call, so
+ * the decoder gets the first sectors without waiting for a large
+ * buffer to be filled.
+ */
+static constexpr unsigned MAX_READ_SECTORS = 32;
+
+class CdioParanoiaInputStream final : public ThreadInputStream {
 	cdrom_drive_t *const drv;
 	CdIo_t *const cdio;
 	CdromParanoia para;
 
 	const lsn_t lsn_from, lsn_to;
-	int lsn_relofs;
 
-	char buffer[CDIO_CD_FRAMESIZE_RAW];
-	int buffer_lsn;
+	const bool reverse_endian;
+
+	/**
+	 * The sector which will be read next by ThreadRead().
+	 */
+	lsn_t lsn;
 
- public:
+	/**
+	 * A sector which could not be copied completely because the
+	 * read-ahead buffer had not enough contiguous space, or which
+	 * was read by ThreadSeek() to skip its beginning.
+	 */
+	char sector[CDIO_CD_FRAMESIZE_RAW];
+
+	/**
+	 * The position within #sector; if this is
+	 * #CDIO_CD_FRAMESIZE_RAW, then #sector is empty.
+	 */
+	size_t sector_position = CDIO_CD_FRAMESIZE_RAW;
+
+public:
 	CdioParanoiaInputStream(const char *_uri, Mutex &_mutex,
 				cdrom_drive_t *_drv, CdIo_t *_cdio,
-				bool reverse_endian,
+				bool _reverse_endian,
 				lsn_t _lsn_from, lsn_t _lsn_to)
-		:InputStream(_uri, _mutex),
+		:ThreadInputStream(input_plugin_cdio_paranoia.name,
+				   _uri, _mutex, buffer_size),
 		 drv(_drv), cdio(_cdio), para(drv),
 		 lsn_from(_lsn_from), lsn_to(_lsn_to),
-		 lsn_relofs(0),
-		 buffer_lsn(-1)
+		 reverse_endian(_reverse_endian),
+		 lsn(_lsn_from)
 	{
-		/* Set reading mode for full paranoia, but allow
-		   skipping sectors. */
-		para.SetMode(PARANOIA_MODE_FULL^PARANOIA_MODE_NEVERSKIP);
+		para.SetMode(mode_flags);
 
 		/* seek to beginning of the track */
 		para.Seek(lsn_from);
 
 		seekable = true;
 		size = (lsn_to - lsn_from + 1) * CDIO_CD_FRAMESIZE_RAW;
-
-		/* hack to make MPD select the "pcm" decoder plugin */
-		SetMimeType(reverse_endian
-			    ? "audio/x-mpd-cdda-pcm-reverse"
-			    : "audio/x-mpd-cdda-pcm");
-		SetReady();
 	}
 
-	~CdioParanoiaInputStream() {
+	~CdioParanoiaInputStream() noexcept override {
+		Stop();
+
 		para = {};
 		cdio_cddap_close_no_free_cdio(drv);
 		cdio_destroy(cdio);
 	}
 
-	/* virtual methods from InputStream */
-	bool IsEOF() noexcept override;
-	size_t Read(void *ptr, size_t size) override;
-	void Seek(offset_type offset) override;
-};
+protected:
+	/* virtual methods from ThreadInputStream */
+	void Open() override {
+		/* hack to make MPD select the "pcm" decoder plugin */
+		SetMimeType(reverse_endian
+			    ? "audio/x-mpd-cdda-pcm-reverse"
+			    : "audio/x-mpd-cdda-pcm");
+	}
 
-static constexpr Domain cdio_domain("cdio");
+	size_t ThreadRead(void *ptr, size_t size) override;
+	void ThreadSeek(offset_type new_offset) override;
 
-static bool default_reverse_endian;
-static unsigned speed = 0;
+private:
+	/**
+	 * Read the sector #lsn with paranoia verification.
+	 *
+	 * Throws on error.
+	 */
+	const int16_t *ReadSector();
+};
 
 static void
 input_cdio_init(EventLoop &, const ConfigBlock &block)
@@ -114,6 +162,30 @@ input_cdio_init(EventLoop &, const ConfigBlock &block)
 						 value);
 	}
 	speed = block.GetBlockValue("speed",0u);
+
+	value = block.GetBlockValue("mode");
+	if (value != nullptr) {
+		if (strcmp(value, "disable") == 0)
+			mode_flags = PARANOIA_MODE_DISABLE;
+		else if (strcmp(value, "overlap") == 0)
+			mode_flags = PARANOIA_MODE_OVERLAP;
+		else if (strcmp(value, "full") == 0)
+			mode_flags = PARANOIA_MODE_FULL;
+		else
+			throw FormatRuntimeError("Unrecognized 'mode' setting: %s",
+						 value);
+	} else
+		mode_flags = PARANOIA_MODE_FULL;
+
+	if (block.GetBlockValue("skip", true))
+		mode_flags &= ~PARANOIA_MODE_NEVERSKIP;
+	else
+		mode_flags |= PARANOIA_MODE_NEVERSKIP;
+
+	buffer_size = block.GetPositiveValue("buffer_size",
+					     DEFAULT_BUFFER_SIZE / 1024) * size_t(1024);
+	if (buffer_size < CDIO_CD_FRAMESIZE_RAW * MAX_READ_SECTORS)
+		throw std::runtime_error("'buffer_size' is too small");
 }
 
 struct CdioUri {
@@ -248,102 +320,98 @@ input_cdio_open(const char *uri,
 		lsn_to = cdio_get_disc_last_lsn(cdio);
 	}
 
-	return std::make_unique<CdioParanoiaInputStream>(uri, mutex,
-							 drv, cdio,
-							 reverse_endian,
-							 lsn_from, lsn_to);
-}
-
-void
-CdioParanoiaInputStream::Seek(offset_type new_offset)
-{
-	if (new_offset > size)
-		throw FormatRuntimeError("Invalid offset to seek %ld (%ld)",
-					 (long int)new_offset, (long int)size);
-
-	/* simple case */
-	if (new_offset == offset)
-		return;
-
-	/* calculate current LSN */
-	lsn_relofs = new_offset / CDIO_CD_FRAMESIZE_RAW;
-	offset = new_offset;
-
-	{
-		const ScopeUnlock unlock(mutex);
-		para.Seek(lsn_from + lsn_relofs);
-	}
+	auto is = std::make_unique<CdioParanoiaInputStream>(uri, mutex,
+							    drv, cdio,
+							    reverse_endian,
+							    lsn_from, lsn_to);
+	is->Start();
+	return is;
 }
 
-size_t
-CdioParanoiaInputStream::Read(void *ptr, size_t length)
+const int16_t *
+CdioParanoiaInputStream::ReadSector()
 {
-	size_t nbytes = 0;
-	char *wptr = (char *) ptr;
-
-	while (length > 0) {
-		/* end of track ? */
-		if (lsn_from + lsn_relofs > lsn_to)
-			break;
-
-		//current sector was changed ?
-		const int16_t *rbuf;
-		if (lsn_relofs != buffer_lsn) {
-			const ScopeUnlock unlock(mutex);
-
-			try {
-				rbuf = para.Read().data;
-			} catch (...) {
-				char *s_err = cdio_cddap_errors(drv);
-				if (s_err) {
-					FormatError(cdio_domain,
-						    "paranoia_read: %s", s_err);
+	assert(lsn <= lsn_to);
+
+	try {
+		const int16_t *data = para.Read().data;
+		++lsn;
+		return data;
+	} catch (...) {
+		char *s_err = cdio_cddap_errors(drv);
+		if (s_err) {
+			FormatError(cdio_domain,
+				    "paranoia_read: %s", s_err);
 #if LIBCDIO_VERSION_NUM >= 90
-					cdio_cddap_free_messages(s_err);
+			cdio_cddap_free_messages(s_err);
 #else
-					free(s_err);
+			free(s_err);
 #endif
-				}
-
-				throw;
-			}
-
-			//store current buffer
-			memcpy(buffer, rbuf, CDIO_CD_FRAMESIZE_RAW);
-			buffer_lsn = lsn_relofs;
-		} else {
-			//use cached sector
-			rbuf = (const int16_t *)buffer;
 		}
 
-		//correct offset
-		const int diff = offset - lsn_relofs * CDIO_CD_FRAMESIZE_RAW;
+		throw;
+	}
+}
 
-		assert(diff >= 0 && diff < CDIO_CD_FRAMESIZE_RAW);
+size_t
+CdioParanoiaInputStream::ThreadRead(void *ptr, size_t length)
+{
+	if (sector_position < CDIO_CD_FRAMESIZE_RAW) {
+		/* copy the rest of the previous sector first */
+		const size_t nbytes =
+			std::min<size_t>(length,
+					 CDIO_CD_FRAMESIZE_RAW - sector_position);
+		memcpy(ptr, sector + sector_position, nbytes);
+		sector_position += nbytes;
+		return nbytes;
+	}
 
-		const size_t maxwrite = CDIO_CD_FRAMESIZE_RAW - diff;  //# of bytes pending in current buffer
-		const size_t len = (length < maxwrite? length : maxwrite);
+	/* end of track? */
+	if (lsn > lsn_to)
+		return 0;
+
+	if (length < CDIO_CD_FRAMESIZE_RAW) {
+		/* not enough contiguous room for a whole sector:
+		   read it into #sector and copy only the beginning */
+		memcpy(sector, ReadSector(), CDIO_CD_FRAMESIZE_RAW);
+		memcpy(ptr, sector, length);
+		sector_position = length;
+		return length;
+	}
 
-		//skip diff bytes from this lsn
-		memcpy(wptr, ((const char *)rbuf) + diff, len);
-		//update pointer
-		wptr += len;
-		nbytes += len;
+	/* read whole sectors directly into the buffer */
+	size_t n_sectors = std::min<size_t>(length / CDIO_CD_FRAMESIZE_RAW,
+					    MAX_READ_SECTORS);
+	n_sectors = std::min<size_t>(n_sectors, lsn_to - lsn + 1);
 
-		//update offset
-		offset += len;
-		lsn_relofs = offset / CDIO_CD_FRAMESIZE_RAW;
-		//update length
-		length -= len;
+	char *dest = (char *)ptr;
+	for (size_t i = 0; i < n_sectors; ++i) {
+		memcpy(dest, ReadSector(), CDIO_CD_FRAMESIZE_RAW);
+		dest += CDIO_CD_FRAMESIZE_RAW;
 	}
 
-	return nbytes;
+	return n_sectors * CDIO_CD_FRAMESIZE_RAW;
 }
 
-bool
-CdioParanoiaInputStream::IsEOF() noexcept
+void
+CdioParanoiaInputStream::ThreadSeek(offset_type new_offset)
 {
-	return lsn_from + lsn_relofs > lsn_to;
+	if (new_offset > size)
+		throw FormatRuntimeError("Invalid offset to seek %ld (%ld)",
+					 (long int)new_offset, (long int)size);
+
+	lsn = lsn_from + new_offset / CDIO_CD_FRAMESIZE_RAW;
+	sector_position = CDIO_CD_FRAMESIZE_RAW;
+
+	para.Seek(lsn);
+
+	const size_t skip = new_offset % CDIO_CD_FRAMESIZE_RAW;
+	if (skip > 0) {
+		/* read the sector now and let ThreadRead() copy only
+		   the part after the new offset */
+		memcpy(sector, ReadSector(), CDIO_CD_FRAMESIZE_RAW);
+		sector_position = skip;
+	}
 }
 
 static constexpr const char *cdio_paranoia_prefixes[] = {
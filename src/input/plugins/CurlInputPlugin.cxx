@@ -44,6 +44,8 @@
 #include "Log.hxx"
 #include "PluginUnavailable.hxx"
 
+#include <algorithm>
+#include <chrono>
 #include <cinttypes>
 
 #include <assert.h>
@@ -56,16 +58,32 @@
 #endif
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The buffer starts with this size (unless configured with
+ * "min_buffer_size").  It is enough for low-bitrate streams, and
+ * it grows for others; see CurlInputStream::AdjustBuffer().
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t CURL_DEFAULT_MIN_BUFFER = 128 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * Do not buffer more than this number of bytes (unless configured
+ * with "max_buffer_size").  It should be a reasonable limit that
+ * doesn't make low-end machines suffer too much, but doesn't cause
+ * stuttering on high-latency lines.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static constexpr size_t CURL_DEFAULT_MAX_BUFFER = 8 * 1024 * 1024;
+
+/**
+ * Try to buffer this many seconds of the stream (unless configured
+ * with "buffer_time").
+ */
+static constexpr unsigned CURL_DEFAULT_BUFFER_TIME = 10;
+
+/**
+ * Measure the bitrate over at least this duration before adjusting
+ * the buffer size.
+ */
+static constexpr std::chrono::steady_clock::duration CURL_MEASURE_TIME =
+	std::chrono::seconds(2);
 
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
@@ -77,6 +95,33 @@ class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/** parser for icy-metadata */
 	std::shared_ptr<IcyMetaDataParser> icy;
 
+	/**
+	 * When was the request started?  Used to measure the
+	 * round-trip time.
+	 */
+	std::chrono::steady_clock::time_point request_time;
+
+	/**
+	 * The duration between starting the request and receiving
+	 * the response headers.  This is an estimate for the
+	 * round-trip time (including server latency).
+	 */
+	std::chrono::steady_clock::duration rtt =
+		std::chrono::steady_clock::duration::zero();
+
+	/**
+	 * The start of the current bitrate measurement: the time and
+	 * the stream offset consumed by the client.
+	 */
+	std::chrono::steady_clock::time_point measure_time;
+	offset_type measure_offset;
+
+	/**
+	 * The value of GetUnderrunCount() at the last AdjustBuffer()
+	 * call.
+	 */
+	unsigned last_underruns = 0;
+
 public:
 	template<typename I>
 	CurlInputStream(EventLoop &event_loop, const char *_url,
@@ -128,6 +173,26 @@ private:
 	 */
 	void SeekInternal(offset_type new_offset);
 
+	/**
+	 * Restart the bitrate measurement, e.g. after seeking.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StartMeasurement() noexcept {
+		measure_time = std::chrono::steady_clock::now();
+		measure_offset = offset;
+	}
+
+	/**
+	 * Enlarge the buffer according to the observed bitrate and
+	 * round-trip time, and after the client had to wait for
+	 * data.  The buffer never shrinks, because the pages which
+	 * have been used already consume memory anyway.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void AdjustBuffer() noexcept;
+
 	/* virtual methods from CurlResponseHandler */
 	void OnHeaders(unsigned status,
 		       std::multimap<std::string, std::string> &&headers) override;
@@ -149,6 +214,10 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
+/** buffer settings; see CurlInputStream::AdjustBuffer() */
+static size_t min_buffer_size, max_buffer_size;
+static unsigned buffer_time;
+
 static CurlInit *curl_init;
 
 static constexpr Domain curl_domain("curl");
@@ -199,6 +268,9 @@ CurlInputStream::OnHeaders(unsigned status,
 
 	const std::lock_guard<Mutex> protect(mutex);
 
+	rtt = std::max(rtt, std::chrono::steady_clock::now() - request_time);
+	StartMeasurement();
+
 	if (IsSeekPending()) {
 		/* don't update metadata while seeking */
 		SeekDone();
@@ -216,6 +288,12 @@ CurlInputStream::OnHeaders(unsigned status,
 	if (i != headers.end())
 		SetMimeType(std::move(i->second));
 
+	i = headers.find("etag");
+	if (i == headers.end())
+		i = headers.find("last-modified");
+	if (i != headers.end())
+		SetVersion(std::move(i->second));
+
 	i = headers.find("icy-name");
 	if (i == headers.end()) {
 		i = headers.find("ice-name");
@@ -263,6 +341,8 @@ CurlInputStream::OnData(ConstBuffer<void> data)
 	if (IsSeekPending())
 		SeekDone();
 
+	AdjustBuffer();
+
 	if (data.size > GetBufferSpace()) {
 		AsyncInputStream::Pause();
 		throw CurlRequest::Pause();
@@ -296,6 +376,55 @@ CurlInputStream::OnError(std::exception_ptr e) noexcept
 	AsyncInputStream::SetClosed();
 }
 
+void
+CurlInputStream::AdjustBuffer() noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+	const auto elapsed = now - measure_time;
+	const unsigned underruns = GetUnderrunCount();
+	if (elapsed < CURL_MEASURE_TIME && underruns == last_underruns)
+		return;
+
+	const size_t capacity = GetBufferCapacity();
+	size_t target = capacity;
+
+	if (elapsed >= CURL_MEASURE_TIME && offset > measure_offset) {
+		/* bytes per second consumed by the client */
+		const double seconds =
+			std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+		const double rate = (offset - measure_offset) / seconds;
+
+		/* buffer the configured playing time, plus enough
+		   to bridge a few round trips for reconnecting */
+		const double rtt_seconds =
+			std::chrono::duration_cast<std::chrono::duration<double>>(rtt).count();
+		const double wanted = rate * (buffer_time + 4 * rtt_seconds);
+		if (wanted > target)
+			target = wanted < max_buffer_size
+				? size_t(wanted)
+				: max_buffer_size;
+	}
+
+	if (underruns != last_underruns) {
+		/* the client had to wait: the buffer was too small
+		   to cover a hiccup of the connection */
+		last_underruns = underruns;
+		target = std::max(target, std::min(capacity * 2,
+						   max_buffer_size));
+	}
+
+	if (elapsed >= CURL_MEASURE_TIME)
+		StartMeasurement();
+
+	if (target > capacity) {
+		FormatDebug(curl_domain, "%s: growing buffer to %u KiB",
+			    GetURI(), unsigned(target / 1024));
+
+		/* resume at 3/4 of the capacity */
+		ResizeBuffer(target, target / 4 * 3);
+	}
+}
+
 /*
  * InputPlugin methods
  *
@@ -328,6 +457,18 @@ input_curl_init(EventLoop &event_loop, const ConfigBlock &block)
 
 	verify_peer = block.GetBlockValue("verify_peer", true);
 	verify_host = block.GetBlockValue("verify_host", true);
+
+	/* the sizes are configured in KiB */
+	min_buffer_size = size_t(block.GetPositiveValue("min_buffer_size",
+							CURL_DEFAULT_MIN_BUFFER / 1024)) * 1024;
+	max_buffer_size = size_t(block.GetPositiveValue("max_buffer_size",
+							CURL_DEFAULT_MAX_BUFFER / 1024)) * 1024;
+	if (max_buffer_size < min_buffer_size)
+		throw FormatRuntimeError("max_buffer_size is smaller than min_buffer_size on line %d",
+					 block.line);
+
+	buffer_time = block.GetPositiveValue("buffer_time",
+					     CURL_DEFAULT_BUFFER_TIME);
 }
 
 static void
@@ -346,10 +487,13 @@ CurlInputStream::CurlInputStream(EventLoop &event_loop, const char *_url,
 				 I &&_icy,
 				 Mutex &_mutex)
 	:AsyncInputStream(event_loop, _url, _mutex,
-			  CURL_MAX_BUFFERED,
-			  CURL_RESUME_AT),
+			  max_buffer_size,
+			  min_buffer_size / 4 * 3,
+			  min_buffer_size),
 	 icy(std::forward<I>(_icy))
 {
+	StartMeasurement();
+
 	request_headers.Append("Icy-Metadata: 1");
 
 	for (const auto &i : headers)
@@ -359,6 +503,11 @@ CurlInputStream::CurlInputStream(EventLoop &event_loop, const char *_url,
 CurlInputStream::~CurlInputStream() noexcept
 {
 	FreeEasyIndirect();
+
+	FormatDebug(curl_domain,
+		    "%s: closed; buffer=%u KiB, %u pauses, %u underruns",
+		    GetURI(), unsigned(GetBufferCapacity() / 1024),
+		    GetPauseCount(), GetUnderrunCount());
 }
 
 void
@@ -390,6 +539,7 @@ CurlInputStream::InitEasy()
 void
 CurlInputStream::StartRequest()
 {
+	request_time = std::chrono::steady_clock::now();
 	request->Start();
 }
 
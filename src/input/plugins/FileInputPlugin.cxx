@@ -24,22 +24,93 @@
 #include "fs/FileInfo.hxx"
 #include "fs/io/FileReader.hxx"
 #include "system/FileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "config/Block.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Map local files into memory instead of reading them?  See
+ * file_input_global_init().
+ */
+static bool file_input_mmap = false;
 
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
 public:
 	FileInputStream(const char *path, FileReader &&_reader, off_t _size,
-			Mutex &_mutex)
+			std::string &&_version, Mutex &_mutex)
 		:InputStream(path, _mutex),
 		 reader(std::move(_reader)) {
 		size = _size;
 		seekable = true;
+		SetVersion(std::move(_version));
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+
+	bool IsEOF() noexcept override {
+		return GetOffset() >= GetSize();
+	}
+
+	size_t Read(void *ptr, size_t size) override;
+	void Seek(offset_type offset) override;
+};
+
+#ifndef _WIN32
+
+/**
+ * An #InputStream implementation which maps the whole file into
+ * memory.  Decoders may access the mapping directly with Peek().
+ */
+class MmapInputStream final : public InputStream {
+	/**
+	 * How much data behind the current offset is announced to
+	 * the kernel with MADV_WILLNEED?
+	 */
+	static constexpr size_t READ_AHEAD = 1024 * 1024;
+
+	const uint8_t *const data;
+
+	/**
+	 * The end of the range which was announced with
+	 * MADV_WILLNEED.
+	 */
+	size_t advised_end = 0;
+
+public:
+	MmapInputStream(const char *path, const void *_data, size_t _size,
+			std::string &&_version, Mutex &_mutex)
+		:InputStream(path, _mutex),
+		 data((const uint8_t *)_data) {
+		size = _size;
+		seekable = true;
+		SetVersion(std::move(_version));
 		SetReady();
+		ReadAhead();
+	}
+
+	~MmapInputStream() noexcept {
+		munmap(const_cast<uint8_t *>(data), size);
 	}
 
 	/* virtual methods from InputStream */
@@ -50,8 +121,123 @@ public:
 
 	size_t Read(void *ptr, size_t size) override;
 	void Seek(offset_type offset) override;
+	ConstBuffer<void> Peek() noexcept override;
+	void Consume(size_t nbytes) noexcept override;
+
+private:
+	/**
+	 * Ask the kernel to read the next #READ_AHEAD bytes if less
+	 * than half of that is still announced.
+	 */
+	void ReadAhead() noexcept;
 };
 
+void
+MmapInputStream::ReadAhead() noexcept
+{
+	const size_t position = offset;
+	if (advised_end >= position + READ_AHEAD / 2 ||
+	    advised_end >= size)
+		return;
+
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	const size_t start = std::max(advised_end, position)
+		& ~(page_size - 1);
+	const size_t end = std::min<size_t>(position + READ_AHEAD, size);
+
+	madvise(const_cast<uint8_t *>(data) + start, end - start,
+		MADV_WILLNEED);
+	advised_end = end;
+}
+
+void
+MmapInputStream::Seek(offset_type new_offset)
+{
+	if (new_offset > size)
+		throw std::runtime_error("Invalid offset");
+
+	offset = new_offset;
+
+	/* re-announce the read-ahead window at the new position */
+	advised_end = 0;
+	ReadAhead();
+}
+
+size_t
+MmapInputStream::Read(void *ptr, size_t read_size)
+{
+	const auto src = Peek();
+	const size_t nbytes = std::min(read_size, src.size);
+	memcpy(ptr, src.data, nbytes);
+	Consume(nbytes);
+	return nbytes;
+}
+
+ConstBuffer<void>
+MmapInputStream::Peek() noexcept
+{
+	assert(offset <= size);
+
+	return {data + offset, size_t(size - offset)};
+}
+
+void
+MmapInputStream::Consume(size_t nbytes) noexcept
+{
+	assert(offset + offset_type(nbytes) <= size);
+
+	offset += nbytes;
+	ReadAhead();
+}
+
+/**
+ * Throws on error.
+ */
+static InputStreamPtr
+OpenMmapInputStream(Path path, const FileReader &reader, size_t size,
+		    std::string &&version, Mutex &mutex)
+{
+	void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+			  reader.GetFD().Get(), 0);
+	if (data == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path.c_str());
+
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	try {
+		return std::make_unique<MmapInputStream>(path.ToUTF8Throw().c_str(),
+							 data, size,
+							 std::move(version),
+							 mutex);
+	} catch (...) {
+		munmap(data, size);
+		throw;
+	}
+}
+
+#endif
+
+/**
+ * Build the InputStream::GetVersion() value: the modification time.
+ */
+static std::string
+MakeVersion(const FileInfo &info)
+{
+	return std::to_string(std::chrono::system_clock::to_time_t(info.GetModificationTime()));
+}
+
+void
+file_input_global_init(const ConfigBlock &block)
+{
+#ifdef _WIN32
+	if (block.GetBlockValue("mmap", false))
+		throw std::runtime_error("mmap is not available on this platform");
+#else
+	file_input_mmap = block.GetBlockValue("mmap", false);
+#endif
+}
+
 InputStreamPtr
 OpenFileInputStream(Path path, Mutex &mutex)
 {
@@ -63,6 +249,14 @@ OpenFileInputStream(Path path, Mutex &mutex)
 		throw FormatRuntimeError("Not a regular file: %s",
 					 path.c_str());
 
+#ifndef _WIN32
+	if (file_input_mmap && info.GetSize() > 0 &&
+	    info.GetSize() <= std::numeric_limits<size_t>::max())
+		/* the file descriptor is not needed after mmap() */
+		return OpenMmapInputStream(path, reader, info.GetSize(),
+					   MakeVersion(info), mutex);
+#endif
+
 #ifdef POSIX_FADV_SEQUENTIAL
 	posix_fadvise(reader.GetFD().Get(), (off_t)0, info.GetSize(),
 		      POSIX_FADV_SEQUENTIAL);
@@ -70,6 +264,7 @@ OpenFileInputStream(Path path, Mutex &mutex)
 
 	return std::make_unique<FileInputStream>(path.ToUTF8Throw().c_str(),
 						 std::move(reader), info.GetSize(),
+						 MakeVersion(info),
 						 mutex);
 }
 
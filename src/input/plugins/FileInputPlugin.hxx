@@ -24,6 +24,15 @@
 
 class Path;
 class Mutex;
+struct ConfigBlock;
+
+/**
+ * Apply the settings of the "input" block with 'plugin "file"'.
+ *
+ * Throws on error.
+ */
+void
+file_input_global_init(const ConfigBlock &block);
 
 InputStreamPtr
 OpenFileInputStream(Path path, Mutex &mutex);
@@ -22,19 +22,30 @@
 #include "../InputPlugin.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
+#include "config/Block.hxx"
 #include "util/ASCII.hxx"
 
 /**
  * Do not buffer more than this number of bytes.  It should be a
  * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * much, but doesn't cause stuttering on high-latency lines.  It is
+ * raised to twice the #nfs_read_ahead setting.
  */
-static const size_t NFS_MAX_BUFFERED = 512 * 1024;
+static size_t nfs_max_buffered = 512 * 1024;
 
 /**
  * Resume the stream at this number of bytes after it has been paused.
  */
-static const size_t NFS_RESUME_AT = 384 * 1024;
+static size_t nfs_resume_at = 384 * 1024;
+
+/**
+ * The maximum size of one nfs_pread_async() call.  libnfs splits
+ * it into READ requests of the server's "readmax" size and sends
+ * them all at once, so this is the number of bytes in flight, and
+ * the throughput on a high-latency link is limited to about this
+ * size per round trip.
+ */
+static size_t nfs_read_ahead = 256 * 1024;
 
 class NfsInputStream final : NfsFileReader, public AsyncInputStream {
 	uint64_t next_offset;
@@ -45,8 +56,8 @@ public:
 	NfsInputStream(const char *_uri, Mutex &_mutex)
 		:AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  _uri, _mutex,
-				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  nfs_max_buffered,
+				  nfs_resume_at) {}
 
 	virtual ~NfsInputStream() {
 		DeferClose();
@@ -88,7 +99,8 @@ NfsInputStream::DoRead()
 		return;
 	}
 
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
+	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining,
+							    nfs_read_ahead),
 					 buffer_space);
 
 	try {
@@ -201,8 +213,12 @@ NfsInputStream::OnNfsFileError(std::exception_ptr &&e) noexcept
  */
 
 static void
-input_nfs_init(EventLoop &event_loop, const ConfigBlock &)
+input_nfs_init(EventLoop &event_loop, const ConfigBlock &block)
 {
+	nfs_read_ahead = block.GetPositiveValue("read_ahead", 256u) * 1024;
+	nfs_max_buffered = std::max<size_t>(512 * 1024, 2 * nfs_read_ahead);
+	nfs_resume_at = nfs_max_buffered / 4 * 3;
+
 	nfs_init(event_loop);
 }
 
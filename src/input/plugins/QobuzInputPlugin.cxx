@@ -21,6 +21,7 @@
 #include "QobuzClient.hxx"
 #include "QobuzTrackRequest.hxx"
 #include "QobuzTagScanner.hxx"
+#include "TrackUrlCache.hxx"
 #include "CurlInputPlugin.hxx"
 #include "PluginUnavailable.hxx"
 #include "input/ProxyInputStream.hxx"
@@ -38,6 +39,11 @@
 
 static QobuzClient *qobuz_client;
 
+/**
+ * Streaming URLs of recently played tracks, indexed by the track id.
+ */
+static TrackUrlCache qobuz_track_urls;
+
 class QobuzInputStream final
 	: public ProxyInputStream, QobuzSessionHandler, QobuzTrackHandler {
 
@@ -53,7 +59,15 @@ public:
 		:ProxyInputStream(_uri, _mutex),
 		 track_id(_track_id)
 	{
-		qobuz_client->AddLoginHandler(*this);
+		const auto url = qobuz_track_urls.Get(track_id);
+		if (url.empty()) {
+			qobuz_client->AddLoginHandler(*this);
+		} else {
+			/* the URL obtained by an earlier request is
+			   still valid */
+			const std::lock_guard<Mutex> protect(mutex);
+			OpenTrackUrl(url.c_str());
+		}
 	}
 
 	~QobuzInputStream() {
@@ -73,6 +87,17 @@ private:
 							      mutex));
 	}
 
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void OpenTrackUrl(const char *url) noexcept {
+		try {
+			SetInput(OpenCurlInputStream(url, {}, mutex));
+		} catch (...) {
+			Failed(std::current_exception());
+		}
+	}
+
 	/* virtual methods from QobuzSessionHandler */
 	void OnQobuzSession() noexcept override;
 
@@ -106,12 +131,8 @@ QobuzInputStream::OnQobuzTrackSuccess(std::string url) noexcept
 	const std::lock_guard<Mutex> protect(mutex);
 	track_request.reset();
 
-	try {
-		SetInput(OpenCurlInputStream(url.c_str(), {},
-					     mutex));
-	} catch (...) {
-		Failed(std::current_exception());
-	}
+	qobuz_track_urls.Put(track_id, url);
+	OpenTrackUrl(url.c_str());
 }
 
 void
@@ -19,7 +19,7 @@
 
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "PluginUnavailable.hxx"
@@ -29,27 +29,33 @@
 #include <libsmbclient.h>
 
 #include <stdexcept>
+#include <string>
 
 class SmbclientInputStream final : public InputStream {
-	SMBCCTX *ctx;
-	int fd;
+	/**
+	 * This stream's own context; it is only used by the thread
+	 * which reads from this stream, so no other stream is
+	 * blocked while it waits for the server.
+	 */
+	SmbclientContext ctx;
+
+	SMBCFILE *const handle;
 
 public:
 	SmbclientInputStream(const char *_uri,
 			     Mutex &_mutex,
-			     SMBCCTX *_ctx, int _fd, const struct stat &st)
+			     SmbclientContext &&_ctx,
+			     SMBCFILE &_handle, const struct stat &st)
 		:InputStream(_uri, _mutex),
-		 ctx(_ctx), fd(_fd) {
+		 ctx(std::move(_ctx)), handle(&_handle) {
 		seekable = true;
 		size = st.st_size;
+		SetVersion(std::to_string(st.st_mtime));
 		SetReady();
 	}
 
 	~SmbclientInputStream() {
-		smbclient_mutex.lock();
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
+		ctx.Close(*handle);
 	}
 
 	/* virtual methods from InputStream */
@@ -86,37 +92,22 @@ static InputStreamPtr
 input_smbclient_open(const char *uri,
 		     Mutex &mutex)
 {
-	const std::lock_guard<Mutex> protect(smbclient_mutex);
-
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr)
-		throw MakeErrno("smbc_new_context() failed");
-
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		int e = errno;
-		smbc_free_context(ctx, 1);
-		throw MakeErrno(e, "smbc_init_context() failed");
-	}
-
-	ctx = ctx2;
+	auto ctx = SmbclientContext::New();
 
-	int fd = smbc_open(uri, O_RDONLY, 0);
-	if (fd < 0) {
-		int e = errno;
-		smbc_free_context(ctx, 1);
-		throw MakeErrno(e, "smbc_open() failed");
-	}
+	SMBCFILE *handle = ctx.Open(uri, O_RDONLY, 0);
+	if (handle == nullptr)
+		throw MakeErrno("smbc_open() failed");
 
 	struct stat st;
-	if (smbc_fstat(fd, &st) < 0) {
+	if (ctx.Stat(*handle, st) < 0) {
 		int e = errno;
-		smbc_free_context(ctx, 1);
+		ctx.Close(*handle);
 		throw MakeErrno(e, "smbc_fstat() failed");
 	}
 
 	return std::make_unique<SmbclientInputStream>(uri, mutex,
-						      ctx, fd, st);
+						      std::move(ctx),
+						      *handle, st);
 }
 
 size_t
@@ -126,8 +117,7 @@ SmbclientInputStream::Read(void *ptr, size_t read_size)
 
 	{
 		const ScopeUnlock unlock(mutex);
-		const std::lock_guard<Mutex> lock(smbclient_mutex);
-		nbytes = smbc_read(fd, ptr, read_size);
+		nbytes = ctx.Read(*handle, ptr, read_size);
 	}
 
 	if (nbytes < 0)
@@ -144,8 +134,7 @@ SmbclientInputStream::Seek(offset_type new_offset)
 
 	{
 		const ScopeUnlock unlock(mutex);
-		const std::lock_guard<Mutex> lock(smbclient_mutex);
-		result = smbc_lseek(fd, new_offset, SEEK_SET);
+		result = ctx.Seek(*handle, new_offset);
 	}
 
 	if (result < 0)
@@ -21,6 +21,7 @@
 #include "TidalSessionManager.hxx"
 #include "TidalTrackRequest.hxx"
 #include "TidalTagScanner.hxx"
+#include "TrackUrlCache.hxx"
 #include "TidalError.hxx"
 #include "CurlInputPlugin.hxx"
 #include "PluginUnavailable.hxx"
@@ -42,6 +43,11 @@ static constexpr Domain tidal_domain("tidal");
 static TidalSessionManager *tidal_session;
 static const char *tidal_audioquality;
 
+/**
+ * Streaming URLs of recently played tracks, indexed by the track id.
+ */
+static TrackUrlCache tidal_track_urls;
+
 class TidalInputStream final
 	: public ProxyInputStream, TidalSessionHandler, TidalTrackHandler {
 
@@ -63,7 +69,15 @@ public:
 		:ProxyInputStream(_uri, _mutex),
 		 track_id(_track_id)
 	{
-		tidal_session->AddLoginHandler(*this);
+		const auto url = tidal_track_urls.Get(track_id);
+		if (url.empty()) {
+			tidal_session->AddLoginHandler(*this);
+		} else {
+			/* the URL obtained by an earlier request is
+			   still valid */
+			const std::lock_guard<Mutex> protect(mutex);
+			OpenTrackUrl(url.c_str());
+		}
 	}
 
 	~TidalInputStream() {
@@ -83,6 +97,17 @@ private:
 							      mutex));
 	}
 
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void OpenTrackUrl(const char *url) noexcept {
+		try {
+			SetInput(OpenCurlInputStream(url, {}, mutex));
+		} catch (...) {
+			Failed(std::current_exception());
+		}
+	}
+
 	/* virtual methods from TidalSessionHandler */
 	void OnTidalSession() noexcept override;
 
@@ -121,12 +146,8 @@ TidalInputStream::OnTidalTrackSuccess(std::string url) noexcept
 
 	track_request.reset();
 
-	try {
-		SetInput(OpenCurlInputStream(url.c_str(), {},
-					     mutex));
-	} catch (...) {
-		Failed(std::current_exception());
-	}
+	tidal_track_urls.Put(track_id, url);
+	OpenTrackUrl(url.c_str());
 }
 
 gcc_pure
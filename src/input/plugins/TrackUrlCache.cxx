@@ -0,0 +1,134 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "TrackUrlCache.hxx"
+#include "util/Compiler.h"
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Find the value of a query string parameter with a UNIX time stamp.
+ *
+ * @return the time stamp or 0 if there is none
+ */
+gcc_pure
+static time_t
+FindQueryTime(const char *url, const char *name) noexcept
+{
+	const size_t name_length = strlen(name);
+
+	const char *p = strchr(url, '?');
+	while (p != nullptr) {
+		++p;
+
+		if (strncmp(p, name, name_length) == 0 &&
+		    p[name_length] == '=') {
+			char *endptr;
+			unsigned long value = strtoul(p + name_length + 1,
+						      &endptr, 10);
+			if (endptr > p + name_length + 1)
+				return time_t(value);
+		}
+
+		p = strpbrk(p, "&~");
+	}
+
+	return 0;
+}
+
+/**
+ * Determine when the given streaming URL expires.
+ *
+ * @return the expiry time or 0 if the URL does not specify one
+ */
+gcc_pure
+static time_t
+GetUrlExpiry(const char *url) noexcept
+{
+	/* Qobuz; CloudFront; Akamai ("__token__=exp=...~hmac=...") */
+	for (const char *name : {"etsp", "Expires", "__token__=exp", "exp"}) {
+		time_t expires = FindQueryTime(url, name);
+		if (expires > 0)
+			return expires;
+	}
+
+	return 0;
+}
+
+std::string
+TrackUrlCache::Get(const std::string &track_id) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(track_id);
+	if (i == map.end())
+		return std::string();
+
+	if (i->second.second <= time(nullptr) + MARGIN) {
+		/* expired */
+		map.erase(i);
+		return std::string();
+	}
+
+	return i->second.first;
+}
+
+void
+TrackUrlCache::Put(const std::string &track_id, const std::string &url) noexcept
+{
+	const time_t now = time(nullptr);
+	time_t expires = GetUrlExpiry(url.c_str());
+	if (expires == 0)
+		expires = now + DEFAULT_LIFETIME;
+	if (expires <= now + MARGIN)
+		/* not worth caching */
+		return;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	map[track_id] = std::make_pair(url, expires);
+
+	if (map.size() > MAX_ITEMS)
+		Evict(now);
+}
+
+void
+TrackUrlCache::Evict(time_t now) noexcept
+{
+	for (auto i = map.begin(); i != map.end();) {
+		if (i->second.second <= now + MARGIN)
+			i = map.erase(i);
+		else
+			++i;
+	}
+
+	if (map.size() <= MAX_ITEMS)
+		return;
+
+	auto i = std::min_element(map.begin(), map.end(),
+				  [](const decltype(map)::value_type &a,
+				     const decltype(map)::value_type &b){
+					  return a.second.second < b.second.second;
+				  });
+	map.erase(i);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TRACK_URL_CACHE_HXX
+#define MPD_TRACK_URL_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <string>
+#include <unordered_map>
+
+#include <time.h>
+
+/**
+ * A cache for the (signed, short-lived) streaming URLs which the
+ * Tidal and Qobuz APIs return for a track id.  Playing a track
+ * again (e.g. with "repeat", or after seeking back across a
+ * playlist) within the lifetime of its URL does not need another
+ * login check and API round trip.
+ *
+ * The expiry time is parsed from the URL itself if it carries one
+ * (CDN signature parameters like "etsp", "Expires" or "exp");
+ * otherwise a fixed lifetime is assumed.
+ *
+ * All methods are thread-safe.
+ */
+class TrackUrlCache {
+	/**
+	 * The maximum number of URLs in the cache.  When it is
+	 * exceeded, the URL which expires first is discarded.
+	 */
+	static constexpr size_t MAX_ITEMS = 256;
+
+	/**
+	 * The lifetime of a URL which does not carry its expiry
+	 * time.
+	 */
+	static constexpr time_t DEFAULT_LIFETIME = 10 * 60;
+
+	/**
+	 * URLs are discarded this long before they expire, to leave
+	 * room for opening the connection and for clock skew.
+	 */
+	static constexpr time_t MARGIN = 60;
+
+	Mutex mutex;
+
+	std::unordered_map<std::string, std::pair<std::string, time_t>> map;
+
+public:
+	TrackUrlCache() = default;
+
+	TrackUrlCache(const TrackUrlCache &) = delete;
+	TrackUrlCache &operator=(const TrackUrlCache &) = delete;
+
+	/**
+	 * Look up the URL of a track.
+	 *
+	 * @return the URL or an empty string if the track is not in
+	 * the cache (or its URL has expired)
+	 */
+	std::string Get(const std::string &track_id) noexcept;
+
+	/**
+	 * Add the URL of a track to the cache.
+	 */
+	void Put(const std::string &track_id, const std::string &url) noexcept;
+
+private:
+	void Evict(time_t now) noexcept;
+};
+
+#endif
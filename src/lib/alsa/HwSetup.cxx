@@ -179,8 +179,11 @@ SetupSampleFormat(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 HwResult
 SetupHw(snd_pcm_t *pcm,
 	unsigned buffer_time, unsigned period_time,
+	bool mmap, bool period_wakeup,
 	AudioFormat &audio_format, PcmExport::Params &params)
 {
+	HwResult result;
+
 	snd_pcm_hw_params_t *hwparams;
 	snd_pcm_hw_params_alloca(&hwparams);
 
@@ -193,8 +196,21 @@ SetupHw(snd_pcm_t *pcm,
 		throw FormatRuntimeError("snd_pcm_hw_params_any() failed: %s",
 					 snd_strerror(-err));
 
-	err = snd_pcm_hw_params_set_access(pcm, hwparams,
-					   SND_PCM_ACCESS_RW_INTERLEAVED);
+	result.mmap = false;
+	if (mmap) {
+		err = snd_pcm_hw_params_set_access(pcm, hwparams,
+						   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if (err == 0)
+			result.mmap = true;
+		else
+			FormatDebug(alsa_output_domain,
+				    "mmap access not supported: %s",
+				    snd_strerror(-err));
+	}
+
+	if (!result.mmap)
+		err = snd_pcm_hw_params_set_access(pcm, hwparams,
+						   SND_PCM_ACCESS_RW_INTERLEAVED);
 	if (err < 0)
 		throw FormatRuntimeError("snd_pcm_hw_params_set_access() failed: %s",
 					 snd_strerror(-err));
@@ -284,12 +300,22 @@ SetupHw(snd_pcm_t *pcm,
 						 snd_strerror(-err));
 	}
 
+	result.period_wakeup = true;
+	if (!period_wakeup) {
+		if (snd_pcm_hw_params_can_disable_period_wakeup(hwparams) &&
+		    snd_pcm_hw_params_set_period_wakeup(pcm, hwparams, 0) == 0)
+			result.period_wakeup = false;
+		else
+			FormatDebug(alsa_output_domain,
+				    "cannot disable period wakeups");
+	}
+
 	err = snd_pcm_hw_params(pcm, hwparams);
 	if (err < 0)
 		throw FormatRuntimeError("snd_pcm_hw_params() failed: %s",
 					 snd_strerror(-err));
 
-	HwResult result;
+	result.rate = output_sample_rate;
 
 	err = snd_pcm_hw_params_get_format(hwparams, &result.format);
 	if (err < 0)
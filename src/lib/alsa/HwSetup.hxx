@@ -31,6 +31,23 @@ namespace Alsa {
 struct HwResult {
 	snd_pcm_format_t format;
 	snd_pcm_uframes_t buffer_size, period_size;
+
+	/**
+	 * The sample rate of the device.
+	 */
+	unsigned rate;
+
+	/**
+	 * Was mmap access configured?  Then data must be written
+	 * with snd_pcm_mmap_writei() or snd_pcm_mmap_begin().
+	 */
+	bool mmap;
+
+	/**
+	 * Are period wakeups enabled?  If not, the caller must poll
+	 * with a timer.
+	 */
+	bool period_wakeup;
 };
 
 /**
@@ -38,6 +55,9 @@ struct HwResult {
  *
  * @param buffer_time the configured buffer time, or 0 if not configured
  * @param period_time the configured period time, or 0 if not configured
+ * @param mmap attempt to configure mmap access (falls back to
+ * read/write access)
+ * @param period_wakeup false to attempt to disable period wakeups
  * @param audio_format an #AudioFormat to be configured (or modified)
  * by this function
  * @param params to be modified by this function
@@ -45,6 +65,7 @@ struct HwResult {
 HwResult
 SetupHw(snd_pcm_t *pcm,
 	unsigned buffer_time, unsigned period_time,
+	bool mmap, bool period_wakeup,
 	AudioFormat &audio_format, PcmExport::Params &params);
 
 } // namespace Alsa
@@ -104,6 +104,38 @@ CurlGlobal::CurlGlobal(EventLoop &_loop)
 
 	multi.SetOption(CURLMOPT_TIMERFUNCTION, TimerFunction);
 	multi.SetOption(CURLMOPT_TIMERDATA, this);
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* multiplex requests to the same server over one HTTP/2
+	   connection */
+	multi.SetOption(CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+	share.SetOption(CURLSHOPT_LOCKFUNC, ShareLock);
+	share.SetOption(CURLSHOPT_UNLOCKFUNC, ShareUnlock);
+	share.SetOption(CURLSHOPT_USERDATA, this);
+	share.SetOption(CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+	/* share the DNS cache (and the CURLOPT_RESOLVE entries added
+	   by CurlRequest) between all requests */
+	share.SetOption(CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+}
+
+void
+CurlGlobal::ShareLock(gcc_unused CURL *easy, curl_lock_data data,
+		      gcc_unused curl_lock_access access,
+		      void *userp) noexcept
+{
+	auto &global = *(CurlGlobal *)userp;
+	global.share_locks[data].lock();
+}
+
+void
+CurlGlobal::ShareUnlock(gcc_unused CURL *easy, curl_lock_data data,
+			void *userp) noexcept
+{
+	auto &global = *(CurlGlobal *)userp;
+	global.share_locks[data].unlock();
 }
 
 int
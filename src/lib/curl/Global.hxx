@@ -31,8 +31,12 @@
 #define CURL_GLOBAL_HXX
 
 #include "Multi.hxx"
+#include "Share.hxx"
 #include "event/TimerEvent.hxx"
 #include "event/DeferEvent.hxx"
+#include "thread/Mutex.hxx"
+
+#include <array>
 
 class CurlSocket;
 class CurlRequest;
@@ -43,6 +47,16 @@ class CurlRequest;
 class CurlGlobal final {
 	CurlMulti multi;
 
+	/**
+	 * Shares the TLS session cache between all easy handles (the
+	 * DNS cache and the connection pool are already shared by
+	 * the #multi handle).  Easy handles may be cleaned up outside
+	 * of the I/O thread, therefore it needs locking.
+	 */
+	CurlShare share;
+
+	std::array<Mutex, CURL_LOCK_DATA_LAST> share_locks;
+
 	DeferEvent defer_read_info;
 
 	TimerEvent timeout_event;
@@ -54,6 +68,10 @@ public:
 		return timeout_event.GetEventLoop();
 	}
 
+	CURLSH *GetShare() noexcept {
+		return share.Get();
+	}
+
 	void Add(CURL *easy, CurlRequest &request);
 	void Remove(CURL *easy) noexcept;
 
@@ -85,6 +103,11 @@ public:
 	}
 
 private:
+	static void ShareLock(CURL *easy, curl_lock_data data,
+			      curl_lock_access access, void *userp) noexcept;
+	static void ShareUnlock(CURL *easy, curl_lock_data data,
+				void *userp) noexcept;
+
 	void UpdateTimeout(long timeout_ms) noexcept;
 	static int TimerFunction(CURLM *global, long timeout_ms,
 				 void *userp) noexcept;
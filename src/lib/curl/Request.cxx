@@ -33,10 +33,14 @@
 #include "Version.hxx"
 #include "Handler.hxx"
 #include "event/Call.hxx"
+#include "event/AsyncResolver.hxx"
+#include "net/ResolverCache.hxx"
+#include "net/ToString.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/StringStrip.hxx"
 #include "util/StringView.hxx"
 #include "util/CharUtil.hxx"
+#include "util/ASCII.hxx"
 
 #include <curl/curl.h>
 
@@ -44,6 +48,13 @@
 
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
 
 CurlRequest::CurlRequest(CurlGlobal &_global,
 			 CurlResponseHandler &_handler)
@@ -65,6 +76,130 @@ CurlRequest::CurlRequest(CurlGlobal &_global,
 	easy.SetOption(CURLOPT_NOSIGNAL, 1l);
 	easy.SetOption(CURLOPT_CONNECTTIMEOUT, 10l);
 	easy.SetOption(CURLOPT_HTTPAUTH, (long) CURLAUTH_ANY);
+	easy.SetOption(CURLOPT_SHARE, global.GetShare());
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	/* negotiate HTTP/2 for https:// URLs if the server supports
+	   it; this fails if libcurl was built without HTTP/2 support,
+	   which is not fatal */
+	curl_easy_setopt(easy.Get(), CURLOPT_HTTP_VERSION,
+			 (long)CURL_HTTP_VERSION_2TLS);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* rather wait for a connection which can be multiplexed than
+	   opening a new one */
+	easy.SetOption(CURLOPT_PIPEWAIT, 1l);
+#endif
+}
+
+#if LIBCURL_VERSION_NUM >= 0x074b00
+
+/**
+ * Extract the host name and the port from a "http://" or
+ * "https://" URL.
+ *
+ * @return false if the URL has a different scheme, if the host is
+ * a numeric IPv6 address or if the URL is malformed
+ */
+static bool
+ParseHttpHostPort(const char *url, std::string &host, unsigned &port)
+{
+	unsigned default_port;
+	if (StringStartsWithCaseASCII(url, "http://")) {
+		url += 7;
+		default_port = 80;
+	} else if (StringStartsWithCaseASCII(url, "https://")) {
+		url += 8;
+		default_port = 443;
+	} else
+		return false;
+
+	std::string authority(url, strcspn(url, "/?#"));
+
+	/* strip the user info */
+	const auto at = authority.rfind('@');
+	if (at != authority.npos)
+		authority.erase(0, at + 1);
+
+	if (authority.empty() || authority.front() == '[')
+		return false;
+
+	port = default_port;
+
+	const auto colon = authority.find(':');
+	if (colon != authority.npos) {
+		char *endptr;
+		const auto value = strtoul(authority.c_str() + colon + 1,
+					   &endptr, 10);
+		if (*endptr != 0 || value == 0 || value > 0xffff)
+			return false;
+
+		port = value;
+		authority.erase(colon);
+	}
+
+	if (authority.empty())
+		return false;
+
+	host = std::move(authority);
+	return true;
+}
+
+#endif
+
+void
+CurlRequest::SetUrl(const char *url)
+{
+	easy.SetOption(CURLOPT_URL, url);
+	PrepopulateResolve(url);
+}
+
+void
+CurlRequest::PrepopulateResolve(const char *url) noexcept
+{
+#if LIBCURL_VERSION_NUM >= 0x074b00
+	/* this requires the "+" prefix (libcurl 7.75), which lets the
+	   entry time out like any other DNS cache entry; older
+	   versions would keep it forever */
+	try {
+		CurlSlist new_resolve;
+
+		std::string host;
+		unsigned port;
+		if (ParseHttpHostPort(url, host, port)) {
+			const auto addresses =
+				LookupResolverCache(host.c_str(), port,
+						    SOCK_STREAM);
+			const auto address = addresses.empty()
+				? std::string()
+				: HostToString(addresses.front());
+
+			if (address.empty()) {
+				/* not cached yet; fill the cache for
+				   subsequent requests to this host */
+				PrefetchResolve(host.c_str(), port,
+						SOCK_STREAM);
+			} else {
+				std::string entry = "+" + host + ":" +
+					std::to_string(port) + ":";
+				if (address.find(':') != address.npos)
+					entry += "[" + address + "]";
+				else
+					entry += address;
+
+				new_resolve.Append(entry.c_str());
+			}
+		}
+
+		easy.SetOption(CURLOPT_RESOLVE, new_resolve.Get());
+		resolve = std::move(new_resolve);
+	} catch (...) {
+		/* this is only an optimization; ignore errors */
+	}
+#else
+	(void)url;
+#endif
 }
 
 CurlRequest::~CurlRequest() noexcept
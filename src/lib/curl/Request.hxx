@@ -31,6 +31,7 @@
 #define CURL_REQUEST_HXX
 
 #include "Easy.hxx"
+#include "Slist.hxx"
 #include "event/DeferEvent.hxx"
 
 #include <map>
@@ -46,6 +47,13 @@ class CurlRequest final {
 
 	CurlResponseHandler &handler;
 
+	/**
+	 * The CURLOPT_RESOLVE list which was filled from the
+	 * resolver cache by SetUrl().  It is declared before #easy so
+	 * it outlives the curl handle.
+	 */
+	CurlSlist resolve;
+
 	/** the curl handle */
 	CurlEasy easy;
 
@@ -126,9 +134,7 @@ public:
 		easy.SetOption(option, value);
 	}
 
-	void SetUrl(const char *url) {
-		easy.SetOption(CURLOPT_URL, url);
-	}
+	void SetUrl(const char *url);
 
 	/**
 	 * CurlResponseHandler::OnData() shall throw this to pause the
@@ -138,6 +144,17 @@ public:
 
 	void Resume() noexcept;
 
+private:
+	/**
+	 * Pass the cached address of the URL's host to libcurl with
+	 * CURLOPT_RESOLVE, or let a worker thread resolve it for
+	 * the next request, so libcurl's resolver does not need to
+	 * block.
+	 */
+	void PrepopulateResolve(const char *url) noexcept;
+
+public:
+
 	/**
 	 * A HTTP request is finished.  Called by #CurlGlobal.
 	 */
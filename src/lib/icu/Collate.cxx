@@ -23,6 +23,7 @@
 
 #ifdef HAVE_ICU
 #include "Util.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/RuntimeError.hxx"
 
 #include <unicode/ucol.h>
@@ -124,3 +125,75 @@ IcuCollate(const char *a, const char *b) noexcept
 	return strcoll(a, b);
 #endif
 }
+
+AllocatedString<>
+IcuCollateKey(const char *s) noexcept
+{
+#if !CLANG_CHECK_VERSION(3,6)
+	/* disabled on clang due to -Wtautological-pointer-compare */
+	assert(s != nullptr);
+#endif
+
+#ifdef HAVE_ICU
+	assert(collator != nullptr);
+
+	AllocatedArray<UChar> u;
+
+	try {
+		u = UCharFromUTF8(s);
+	} catch (...) {
+		/* invalid UTF-8: sort by the raw bytes */
+		return AllocatedString<>::Duplicate(s);
+	}
+
+	/* the key is terminated with a null byte, and contains no
+	   other null bytes; one call usually suffices with this
+	   estimate */
+	size_t capacity = u.size() * 4 + 16;
+	std::unique_ptr<char[]> key(new char[capacity]);
+	size_t length = ucol_getSortKey(collator, u.begin(), u.size(),
+					(uint8_t *)key.get(), capacity);
+	if (length > capacity) {
+		capacity = length;
+		key.reset(new char[capacity]);
+		length = ucol_getSortKey(collator, u.begin(), u.size(),
+					 (uint8_t *)key.get(), capacity);
+	}
+
+	if (length == 0)
+		return AllocatedString<>::Duplicate(s);
+
+	return AllocatedString<>::Donate(key.release());
+
+#elif defined(_WIN32)
+	AllocatedString<wchar_t> w = nullptr;
+
+	try {
+		w = MultiByteToWideChar(CP_UTF8, s);
+	} catch (...) {
+		return AllocatedString<>::Duplicate(s);
+	}
+
+	/* the sort key is a null-terminated byte array */
+	int length = LCMapStringEx(LOCALE_NAME_INVARIANT,
+				   LCMAP_SORTKEY|LINGUISTIC_IGNORECASE,
+				   w.c_str(), -1, nullptr, 0,
+				   nullptr, nullptr, 0);
+	if (length <= 0)
+		return AllocatedString<>::Duplicate(s);
+
+	std::unique_ptr<char[]> key(new char[length]);
+	if (LCMapStringEx(LOCALE_NAME_INVARIANT,
+			  LCMAP_SORTKEY|LINGUISTIC_IGNORECASE,
+			  w.c_str(), -1, (LPWSTR)key.get(), length,
+			  nullptr, nullptr, 0) <= 0)
+		return AllocatedString<>::Duplicate(s);
+
+	return AllocatedString<>::Donate(key.release());
+#else
+	const size_t length = strxfrm(nullptr, s, 0);
+	std::unique_ptr<char[]> key(new char[length + 1]);
+	strxfrm(key.get(), s, length + 1);
+	return AllocatedString<>::Donate(key.release());
+#endif
+}
@@ -22,6 +22,8 @@
 
 #include "util/Compiler.h"
 
+template<typename T> class AllocatedString;
+
 /**
  * Throws #std::runtime_error on error.
  */
@@ -35,4 +37,14 @@ gcc_pure gcc_nonnull_all
 int
 IcuCollate(const char *a, const char *b) noexcept;
 
+/**
+ * Calculate a sort key for the given string: comparing two keys
+ * with strcmp() yields the same order as IcuCollate() on the
+ * original strings.  This is worth it if a string gets compared
+ * many times.
+ */
+gcc_nonnull_all
+AllocatedString<char>
+IcuCollateKey(const char *s) noexcept;
+
 #endif
@@ -64,3 +64,23 @@ IcuCompare::IsIn(const char *haystack) const noexcept
 	return false;
 #endif
 }
+
+bool
+IcuCompare::EqualsFolded(const char *folded_haystack) const noexcept
+{
+#ifdef HAVE_ICU_CASE_FOLD
+	return StringIsEqual(folded_haystack, needle.c_str());
+#else
+	return *this == folded_haystack;
+#endif
+}
+
+bool
+IcuCompare::IsInFolded(const char *folded_haystack) const noexcept
+{
+#ifdef HAVE_ICU_CASE_FOLD
+	return StringFind(folded_haystack, needle.c_str()) != nullptr;
+#else
+	return IsIn(folded_haystack);
+#endif
+}
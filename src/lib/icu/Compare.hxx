@@ -61,6 +61,22 @@ public:
 
 	gcc_pure
 	bool IsIn(const char *haystack) const noexcept;
+
+	/**
+	 * Like operator==(), but the haystack has already been
+	 * case-folded by IcuCaseFold() (or, without ICU, is the
+	 * original string).
+	 */
+	gcc_pure
+	bool EqualsFolded(const char *folded_haystack) const noexcept;
+
+	/**
+	 * Like IsIn(), but the haystack has already been case-folded
+	 * by IcuCaseFold() (or, without ICU, is the original
+	 * string).
+	 */
+	gcc_pure
+	bool IsInFolded(const char *folded_haystack) const noexcept;
 };
 
 #endif
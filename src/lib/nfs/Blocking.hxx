@@ -55,7 +55,24 @@ public:
 	/**
 	 * Throws std::runtime_error on error.
 	 */
-	void Run();
+	void Run() {
+		Begin();
+		Finish();
+	}
+
+	/**
+	 * Start the operation in the #EventLoop thread, but do not
+	 * wait for its completion.  Each call must be followed by a
+	 * Finish() call before this object is destructed.
+	 */
+	void Begin();
+
+	/**
+	 * Wait for completion of an operation started by Begin().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Finish();
 
 private:
 	bool LockWaitFinished() noexcept {
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2007-2018 Content Management AG
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RegexCache.hxx"
+#include "UniqueRegex.hxx"
+#include "thread/Mutex.hxx"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/**
+ * The maximum number of cached expressions.
+ */
+static constexpr size_t MAX_REGEX_CACHE = 64;
+
+namespace {
+
+class RegexCache {
+	typedef std::list<std::pair<const std::string,
+				    std::shared_ptr<UniqueRegex>>> List;
+
+	Mutex mutex;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List list;
+
+	std::unordered_map<std::string, List::iterator> map;
+
+public:
+	std::shared_ptr<UniqueRegex> Get(const char *pattern, bool anchored,
+					 bool capture, bool caseless);
+};
+
+}
+
+std::shared_ptr<UniqueRegex>
+RegexCache::Get(const char *pattern, bool anchored, bool capture,
+		bool caseless)
+{
+	/* the key is the pattern, prefixed with the flags */
+	std::string key;
+	key.push_back(anchored ? 'a' : '-');
+	key.push_back(capture ? 'c' : '-');
+	key.push_back(caseless ? 'i' : '-');
+	key.append(pattern);
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		auto i = map.find(key);
+		if (i != map.end()) {
+			/* move to the front of the LRU list */
+			list.splice(list.begin(), list, i->second);
+			return i->second->second;
+		}
+	}
+
+	/* compile without holding the lock; if another thread
+	   compiles the same pattern meanwhile, one of the results is
+	   discarded */
+	auto regex = std::make_shared<UniqueRegex>(pattern, anchored,
+						   capture, caseless);
+
+	const std::lock_guard<Mutex> protect(mutex);
+	auto i = map.find(key);
+	if (i != map.end())
+		return i->second->second;
+
+	if (list.size() >= MAX_REGEX_CACHE) {
+		/* evict the least recently used entry; clients still
+		   using it hold their own reference */
+		map.erase(list.back().first);
+		list.pop_back();
+	}
+
+	list.emplace_front(key, regex);
+	map.emplace(std::move(key), list.begin());
+	return regex;
+}
+
+static RegexCache regex_cache;
+
+std::shared_ptr<UniqueRegex>
+GetCachedRegex(const char *pattern, bool anchored, bool capture,
+	       bool caseless)
+{
+	return regex_cache.Get(pattern, anchored, capture, caseless);
+}
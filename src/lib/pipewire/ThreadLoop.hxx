@@ -0,0 +1,50 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PIPEWIRE_THREAD_LOOP_HXX
+#define MPD_PIPEWIRE_THREAD_LOOP_HXX
+
+#include <pipewire/thread-loop.h>
+
+namespace PipeWire {
+
+/**
+ * Lock a #pw_thread_loop for the lifetime of this object.
+ */
+class ThreadLoopLock {
+	struct pw_thread_loop *const thread_loop;
+
+public:
+	explicit ThreadLoopLock(struct pw_thread_loop *_thread_loop) noexcept
+		:thread_loop(_thread_loop) {
+		pw_thread_loop_lock(thread_loop);
+	}
+
+	~ThreadLoopLock() noexcept {
+		pw_thread_loop_unlock(thread_loop);
+	}
+
+	ThreadLoopLock(const ThreadLoopLock &) = delete;
+	ThreadLoopLock &operator=(const ThreadLoopLock &) = delete;
+};
+
+} // namespace PipeWire
+
+#endif
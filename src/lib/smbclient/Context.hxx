@@ -0,0 +1,107 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SMBCLIENT_CONTEXT_HXX
+#define MPD_SMBCLIENT_CONTEXT_HXX
+
+#include <libsmbclient.h>
+
+#include <utility>
+
+/**
+ * Wrapper for a #SMBCCTX.  Each instance owns a separate
+ * libsmbclient context with its own connections, so operations on
+ * different instances may run in parallel.  One instance must not be
+ * used by more than one thread at a time.
+ *
+ * Unlike the legacy smbc_*() functions, the methods of this class do
+ * not use the process-wide default context.
+ */
+class SmbclientContext {
+	SMBCCTX *ctx = nullptr;
+
+	explicit SmbclientContext(SMBCCTX *_ctx) noexcept
+		:ctx(_ctx) {}
+
+public:
+	SmbclientContext() = default;
+
+	SmbclientContext(SmbclientContext &&src) noexcept
+		:ctx(std::exchange(src.ctx, nullptr)) {}
+
+	~SmbclientContext() noexcept;
+
+	SmbclientContext &operator=(SmbclientContext &&src) noexcept {
+		std::swap(ctx, src.ctx);
+		return *this;
+	}
+
+	/**
+	 * Create and initialize a new context.  SmbclientInit() must
+	 * have been called before.
+	 *
+	 * Throws on error.
+	 *
+	 * @param timeout_ms the libsmbclient timeout [ms]; 0 means
+	 * the libsmbclient default
+	 */
+	static SmbclientContext New(unsigned timeout_ms=0);
+
+	SMBCFILE *Open(const char *fname, int flags, mode_t mode) noexcept {
+		return smbc_getFunctionOpen(ctx)(ctx, fname, flags, mode);
+	}
+
+	ssize_t Read(SMBCFILE &file, void *buf, size_t count) noexcept {
+		return smbc_getFunctionRead(ctx)(ctx, &file, buf, count);
+	}
+
+	off_t Seek(SMBCFILE &file, off_t offset, int whence=SEEK_SET) noexcept {
+		return smbc_getFunctionLseek(ctx)(ctx, &file, offset, whence);
+	}
+
+	int Stat(const char *fname, struct stat &st) noexcept {
+		return smbc_getFunctionStat(ctx)(ctx, fname, &st);
+	}
+
+	int Stat(SMBCFILE &file, struct stat &st) noexcept {
+		return smbc_getFunctionFstat(ctx)(ctx, &file, &st);
+	}
+
+	void Close(SMBCFILE &file) noexcept {
+		smbc_getFunctionClose(ctx)(ctx, &file);
+	}
+
+	SMBCFILE *OpenDirectory(const char *fname) noexcept {
+		return smbc_getFunctionOpendir(ctx)(ctx, fname);
+	}
+
+	/**
+	 * Read the next directory entry.  The returned pointer is
+	 * only valid until the next call on this context.
+	 */
+	const struct smbc_dirent *ReadDirectory(SMBCFILE &dir) noexcept {
+		return smbc_getFunctionReaddir(ctx)(ctx, &dir);
+	}
+
+	void CloseDirectory(SMBCFILE &dir) noexcept {
+		smbc_getFunctionClosedir(ctx)(ctx, &dir);
+	}
+};
+
+#endif
@@ -18,33 +18,24 @@
  */
 
 #include "Init.hxx"
+#include "Context.hxx"
 #include "Mutex.hxx"
 #include "thread/Mutex.hxx"
-#include "system/Error.hxx"
 
 #include <libsmbclient.h>
 
-#include <string.h>
-
-static void
-mpd_smbc_get_auth_data(gcc_unused const char *srv,
-		       gcc_unused const char *shr,
-		       char *wg, gcc_unused int wglen,
-		       char *un, gcc_unused int unlen,
-		       char *pw, gcc_unused int pwlen)
-{
-	// TODO: implement
-	strcpy(wg, "WORKGROUP");
-	strcpy(un, "");
-	strcpy(pw, "");
-}
-
 void
 SmbclientInit()
 {
-	const std::lock_guard<Mutex> protect(smbclient_mutex);
+	{
+		const std::lock_guard<Mutex> protect(smbclient_mutex);
+
+		/* let libsmbclient protect its global state, so
+		   separate contexts can be used in parallel */
+		smbc_thread_posix();
+	}
 
-	constexpr int debug = 0;
-	if (smbc_init(mpd_smbc_get_auth_data, debug) < 0)
-		throw MakeErrno("smbc_init() failed");
+	/* probe whether libsmbclient works at all; this throws if
+	   it is not configured properly */
+	SmbclientContext::New();
 }
@@ -23,8 +23,9 @@
 class Mutex;
 
 /**
- * Since libsmbclient is not thread-safe, this mutex must be locked
- * during all libsmbclient function calls.
+ * This mutex protects the global state of libsmbclient; it must be
+ * locked while a #SMBCCTX is created or freed.  Operations on a
+ * context are not protected by it; see #SmbclientContext.
  */
 extern Mutex smbclient_mutex;
 
@@ -30,6 +30,7 @@
 class UPnPDevice;
 struct UPnPService;
 class UPnPDirContent;
+class WorkerPool;
 
 /**
  * Content Directory Service class.
@@ -75,9 +76,12 @@ public:
 	/** Read a container's children list into dirbuf.
 	 *
 	 * @param objectId the UPnP object Id for the container. Root has Id "0"
+	 * @param pool if not nullptr, then the slices after the
+	 * first one are requested in parallel by this pool's threads
 	 */
 	UPnPDirContent readDir(UpnpClient_Handle handle,
-			       const char *objectId) const;
+			       const char *objectId,
+			       WorkerPool *pool=nullptr) const;
 
 	void readDirSlice(UpnpClient_Handle handle,
 			  const char *objectId, unsigned offset,
@@ -41,6 +41,11 @@ UPnPDeviceDirectory::Downloader::Downloader(UPnPDeviceDirectory &_parent,
 	 expires(std::chrono::seconds(UpnpDiscovery_get_Expires(&disco))),
 	 request(*parent.curl, url.c_str(), *this)
 {
+	/* don't let an unresponsive device occupy a download slot
+	   for long */
+	request.SetOption(CURLOPT_CONNECTTIMEOUT, 5L);
+	request.SetOption(CURLOPT_TIMEOUT, 15L);
+
 	const std::lock_guard<Mutex> protect(parent.mutex);
 	parent.downloaders.push_back(*this);
 }
@@ -136,6 +141,32 @@ AnnounceLostUPnP(UPnPDiscoveryListener &listener, const UPnPDevice &device)
 								  service));
 }
 
+inline bool
+UPnPDeviceDirectory::LockRefresh(const UpnpDiscovery &disco) noexcept
+{
+	const char *id = UpnpDiscovery_get_DeviceID_cstr(&disco);
+	const char *location = UpnpDiscovery_get_Location_cstr(&disco);
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	for (const auto &i : downloaders)
+		if (i.IsDevice(id, location))
+			/* already being downloaded */
+			return true;
+
+	for (auto &i : directories) {
+		if (i.id == id && i.location == location) {
+			/* the description is still valid; the
+			   device just announced that it's alive */
+			i.Refresh(std::chrono::steady_clock::now(),
+				  std::chrono::seconds(UpnpDiscovery_get_Expires(&disco)));
+			return true;
+		}
+	}
+
+	return false;
+}
+
 inline void
 UPnPDeviceDirectory::LockAdd(ContentDirectoryDescriptor &&d)
 {
@@ -176,6 +207,9 @@ UPnPDeviceDirectory::OnAlive(const UpnpDiscovery *disco) noexcept
 {
 	if (isMSDevice(UpnpDiscovery_get_DeviceType_cstr(disco)) ||
 	    isCDService(UpnpDiscovery_get_ServiceType_cstr(disco))) {
+		if (LockRefresh(*disco))
+			return UPNP_E_SUCCESS;
+
 		try {
 			auto *downloader = new Downloader(*this, *disco);
 
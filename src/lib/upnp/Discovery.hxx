@@ -67,6 +67,11 @@ class UPnPDeviceDirectory final : UpnpCallback {
 	public:
 		std::string id;
 
+		/**
+		 * The URL of the device description.
+		 */
+		std::string location;
+
 		UPnPDevice device;
 
 		/**
@@ -82,7 +87,13 @@ class UPnPDeviceDirectory final : UpnpCallback {
 			:id(std::move(_id)),
 			 expires(last + exp + std::chrono::seconds(20)) {}
 
+		void Refresh(std::chrono::steady_clock::time_point last,
+			     std::chrono::steady_clock::duration exp) noexcept {
+			expires = last + exp + std::chrono::seconds(20);
+		}
+
 		void Parse(const std::string &url, const char *description) {
+			location = url;
 			device.Parse(url, description);
 		}
 	};
@@ -113,6 +124,16 @@ class UPnPDeviceDirectory final : UpnpCallback {
 
 		void Destroy() noexcept;
 
+		/**
+		 * Is this downloading the description of the given
+		 * device?  Caller must lock UPnPDeviceDirectory::mutex.
+		 */
+		gcc_pure
+		bool IsDevice(const char *device_id,
+			      const char *location) const noexcept {
+			return id == device_id && url == location;
+		}
+
 	private:
 		void OnDeferredStart() noexcept {
 			try {
@@ -192,6 +213,15 @@ private:
 	 */
 	void ExpireDevices();
 
+	/**
+	 * Handle an "alive" message of a device which is already
+	 * known (or being downloaded): extend its expiry time.
+	 *
+	 * @return true if the description does not need to be
+	 * downloaded
+	 */
+	bool LockRefresh(const UpnpDiscovery &disco) noexcept;
+
 	void LockAdd(ContentDirectoryDescriptor &&d);
 	void LockRemove(const std::string &id);
 
@@ -19,18 +19,15 @@
 
 #include "FlacStreamMetadata.hxx"
 #include "FlacAudioFormat.hxx"
-#include "XiphTags.hxx"
+#include "VorbisComments.hxx"
 #include "CheckAudioFormat.hxx"
 #include "MixRampInfo.hxx"
 #include "tag/Handler.hxx"
-#include "tag/Table.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
-#include "tag/VorbisComment.hxx"
 #include "tag/ReplayGain.hxx"
 #include "tag/MixRamp.hxx"
 #include "ReplayGainInfo.hxx"
-#include "util/DivideString.hxx"
 
 bool
 flac_parse_replay_gain(ReplayGainInfo &rgi,
@@ -62,55 +59,12 @@ flac_parse_mixramp(const FLAC__StreamMetadata_VorbisComment &vc)
 	return mix_ramp;
 }
 
-/**
- * Checks if the specified name matches the entry's name, and if yes,
- * returns the comment value;
- */
-static const char *
-flac_comment_value(const FLAC__StreamMetadata_VorbisComment_Entry *entry,
-		   const char *name) noexcept
-{
-	return vorbis_comment_value((const char *)entry->entry, name);
-}
-
-/**
- * Check if the comment's name equals the passed name, and if so, copy
- * the comment value into the tag.
- */
-static bool
-flac_copy_comment(const FLAC__StreamMetadata_VorbisComment_Entry *entry,
-		  const char *name, TagType tag_type,
-		  TagHandler &handler) noexcept
-{
-	const char *value = flac_comment_value(entry, name);
-	if (value != nullptr) {
-		handler.OnTag(tag_type, value);
-		return true;
-	}
-
-	return false;
-}
-
 static void
 flac_scan_comment(const FLAC__StreamMetadata_VorbisComment_Entry *entry,
 		  TagHandler &handler) noexcept
 {
-	if (handler.WantPair()) {
-		const char *comment = (const char *)entry->entry;
-		const DivideString split(comment, '=');
-		if (split.IsDefined() && !split.empty())
-			handler.OnPair(split.GetFirst(), split.GetSecond());
-	}
-
-	for (const struct tag_table *i = xiph_tags; i->name != nullptr; ++i)
-		if (flac_copy_comment(entry, i->name, i->type, handler))
-			return;
-
-	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
-		if (flac_copy_comment(entry,
-				      tag_item_names[i], (TagType)i,
-				      handler))
-			return;
+	vorbis_comment_scan({(const char *)entry->entry, entry->length},
+			    handler);
 }
 
 static void
@@ -161,6 +115,13 @@ flac_scan_metadata(const FLAC__StreamMetadata *block,
 		Scan(block->data.stream_info, handler);
 		break;
 
+	case FLAC__METADATA_TYPE_PICTURE:
+		if (handler.WantPicture())
+			handler.OnPicture(block->data.picture.mime_type,
+					  {block->data.picture.data,
+					   block->data.picture.data_length});
+		break;
+
 	default:
 		break;
 	}
@@ -23,10 +23,10 @@
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
-#include "tag/VorbisComment.hxx"
+#include "tag/ParseName.hxx"
 #include "tag/ReplayGain.hxx"
 #include "ReplayGainInfo.hxx"
-#include "util/DivideString.hxx"
+#include "util/StringView.hxx"
 
 bool
 vorbis_comments_to_replay_gain(ReplayGainInfo &rgi, char **comments) noexcept
@@ -45,53 +45,32 @@ vorbis_comments_to_replay_gain(ReplayGainInfo &rgi, char **comments) noexcept
 	return found;
 }
 
-/**
- * Check if the comment's name equals the passed name, and if so, copy
- * the comment value into the tag.
- */
-static bool
-vorbis_copy_comment(const char *comment,
-		    const char *name, TagType tag_type,
-		    TagHandler &handler) noexcept
+void
+vorbis_comment_scan(StringView comment, TagHandler &handler) noexcept
 {
-	const char *value;
-
-	value = vorbis_comment_value(comment, name);
-	if (value != nullptr) {
-		handler.OnTag(tag_type, value);
-		return true;
-	}
+	const char *eq = comment.Find('=');
+	if (eq == nullptr || eq == comment.data)
+		return;
 
-	return false;
-}
+	const StringView name(comment.data, eq);
+	const StringView value(eq + 1, comment.end());
 
-static void
-vorbis_scan_comment(const char *comment, TagHandler &handler) noexcept
-{
-	if (handler.WantPair()) {
-		const DivideString split(comment, '=');
-		if (split.IsDefined() && !split.empty())
-			handler.OnPair(split.GetFirst(), split.GetSecond());
-	}
+	if (handler.WantPair())
+		handler.OnPair(name, value);
 
-	for (const struct tag_table *i = xiph_tags; i->name != nullptr; ++i)
-		if (vorbis_copy_comment(comment, i->name, i->type,
-					handler))
-			return;
+	TagType type = tag_table_lookup_i(xiph_tags, name);
+	if (type == TAG_NUM_OF_ITEM_TYPES)
+		type = tag_name_parse_i(name);
 
-	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
-		if (vorbis_copy_comment(comment,
-					tag_item_names[i], TagType(i),
-					handler))
-			return;
+	if (type != TAG_NUM_OF_ITEM_TYPES)
+		handler.OnTag(type, value);
 }
 
 void
 vorbis_comments_scan(char **comments, TagHandler &handler) noexcept
 {
 	while (*comments)
-		vorbis_scan_comment(*comments++, handler);
-
+		vorbis_comment_scan(*comments++, handler);
 }
 
 std::unique_ptr<Tag>
@@ -23,12 +23,21 @@
 #include <memory>
 
 struct ReplayGainInfo;
+struct StringView;
 class TagHandler;
 struct Tag;
 
 bool
 vorbis_comments_to_replay_gain(ReplayGainInfo &rgi, char **comments) noexcept;
 
+/**
+ * Parse one "NAME=value" comment and pass it to the #TagHandler.
+ * The string does not need to be null-terminated; the name and the
+ * value are passed to the handler without copying them.
+ */
+void
+vorbis_comment_scan(StringView comment, TagHandler &handler) noexcept;
+
 void
 vorbis_comments_scan(char **comments, TagHandler &handler) noexcept;
 
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Collect.hxx"
+#include "Writer.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "Stats.hxx"
+#include "LatencyHistogram.hxx"
+#include "command/AllCommands.hxx"
+#include "decoder/DecoderStats.hxx"
+#include "input/AsyncInputStream.hxx"
+#include "client/ClientList.hxx"
+#include "tag/Pool.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/Stats.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#endif
+
+static double
+ToSeconds(std::chrono::steady_clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::duration<double>>(d).count();
+}
+
+static void
+CollectPartitions(MetricsWriter &w, const Instance &instance)
+{
+	w.Declare("mpd_queue_length", "gauge",
+		  "Number of songs in the queue");
+	for (const auto &partition : instance.partitions)
+		w.Sample("mpd_queue_length",
+			 MetricsWriter::Label("partition",
+					      partition.name.c_str()).c_str(),
+			 uint64_t(partition.playlist.queue.GetLength()));
+
+	w.Declare("mpd_player_underruns_total", "counter",
+		  "How often the player found the music pipe empty");
+	w.Declare("mpd_player_decode_latency_seconds", "histogram",
+		  "From the allocation of a chunk until it was pushed into the music pipe");
+	w.Declare("mpd_player_pipe_latency_seconds", "histogram",
+		  "From the music pipe until the chunk was handed to the outputs");
+
+	for (const auto &partition : instance.partitions) {
+		const auto label =
+			MetricsWriter::Label("partition", partition.name.c_str());
+		const auto latency = partition.pc.LockGetLatency();
+
+		w.Sample("mpd_player_underruns_total", label.c_str(),
+			 uint64_t(latency.underruns));
+		w.Histogram("mpd_player_decode_latency_seconds",
+			    label.c_str(), latency.decode);
+		w.Histogram("mpd_player_pipe_latency_seconds",
+			    label.c_str(), latency.pipe);
+	}
+
+	w.Declare("mpd_music_buffer_bytes", "gauge",
+		  "Size of the music buffer allocation");
+	w.Declare("mpd_music_buffer_resident_bytes", "gauge",
+		  "Bytes of the music buffer present in physical memory");
+
+	for (const auto &partition : instance.partitions) {
+		const auto label =
+			MetricsWriter::Label("partition", partition.name.c_str());
+		const auto stats = partition.pc.LockGetBufferStats();
+
+		w.Sample("mpd_music_buffer_bytes", label.c_str(),
+			 uint64_t(stats.size));
+		w.Sample("mpd_music_buffer_resident_bytes", label.c_str(),
+			 uint64_t(stats.usage.resident));
+	}
+}
+
+static void
+CollectOutputs(MetricsWriter &w, const Instance &instance)
+{
+	w.Declare("mpd_output_play_latency_seconds", "histogram",
+		  "Duration of the output plugin's play() calls");
+	w.Declare("mpd_output_play_cpu_seconds_total", "counter",
+		  "CPU time spent by the output thread in play()");
+
+	for (const auto &partition : instance.partitions) {
+		const auto &outputs = partition.outputs;
+		for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+			const auto &ao = outputs.Get(i);
+
+			LatencyHistogram play;
+			std::chrono::steady_clock::duration play_cpu_time;
+
+			{
+				const std::lock_guard<Mutex> protect(ao.mutex);
+				play = ao.GetPlayLatency();
+				play_cpu_time = ao.GetPlayCPUTime();
+			}
+
+			const auto labels =
+				MetricsWriter::Label("partition",
+						     partition.name.c_str()) +
+				"," +
+				MetricsWriter::Label("output", ao.GetName());
+
+			w.Histogram("mpd_output_play_latency_seconds",
+				    labels.c_str(), play);
+			w.Sample("mpd_output_play_cpu_seconds_total",
+				 labels.c_str(), ToSeconds(play_cpu_time));
+		}
+	}
+}
+
+#ifdef ENABLE_DATABASE
+
+static void
+CollectDatabase(MetricsWriter &w, const Database &db)
+{
+	if (&db.GetPlugin() == &simple_db_plugin) {
+		const auto &simple = static_cast<const SimpleDatabase &>(db);
+		w.Declare("mpd_database_visit_latency_seconds", "histogram",
+			  "Duration of database queries");
+		w.Histogram("mpd_database_visit_latency_seconds", nullptr,
+			    simple.GetVisitLatency());
+	}
+
+	const auto *stats = stats_get_database(db);
+	if (stats != nullptr) {
+		w.Declare("mpd_database_songs", "gauge",
+			  "Number of songs in the database");
+		w.Sample("mpd_database_songs", uint64_t(stats->song_count));
+	}
+}
+
+#endif
+
+std::string
+CollectMetrics(const Instance &instance)
+{
+	MetricsWriter w;
+
+	w.Declare("mpd_uptime_seconds", "gauge",
+		  "Seconds since MPD was started");
+	w.Sample("mpd_uptime_seconds", uint64_t(stats_get_uptime()));
+
+	w.Declare("mpd_clients", "gauge", "Number of connected clients");
+	w.Sample("mpd_clients", uint64_t(instance.client_list->GetSize()));
+
+	command_metrics(w);
+
+	CollectPartitions(w, instance);
+	CollectOutputs(w, instance);
+
+	decoder_stats_metrics(w);
+
+	w.Declare("mpd_input_underruns_total", "counter",
+		  "How often a reader found an input buffer empty");
+	w.Sample("mpd_input_underruns_total",
+		 uint64_t(AsyncInputStream::GetTotalUnderrunCount()));
+
+#ifdef ENABLE_DATABASE
+	if (instance.database != nullptr)
+		CollectDatabase(w, *instance.database);
+#endif
+
+	const auto tag_pool = tag_pool_get_stats();
+	w.Declare("mpd_tag_pool_items", "gauge",
+		  "Number of distinct tag values in the tag pool");
+	w.Sample("mpd_tag_pool_items", uint64_t(tag_pool.n_items));
+	w.Declare("mpd_tag_pool_contended_total", "counter",
+		  "How often a thread had to wait for a tag pool lock");
+	w.Sample("mpd_tag_pool_contended_total", tag_pool.n_contended);
+
+	return w.Steal();
+}
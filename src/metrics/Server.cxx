@@ -0,0 +1,226 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Server.hxx"
+#include "Collect.hxx"
+#include "config/Data.hxx"
+#include "config/Net.hxx"
+#include "config/Option.hxx"
+#include "client/Client.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/DeferEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/SocketAddress.hxx"
+#include "util/Domain.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <stdio.h>
+#include <string.h>
+
+static constexpr Domain metrics_domain("metrics");
+
+/**
+ * Connections beyond this number are refused.
+ */
+static constexpr unsigned MAX_CONNECTIONS = 16;
+
+/**
+ * The maximum size of a response; this is far more than MPD generates
+ * normally.
+ */
+static constexpr size_t MAX_OUTPUT = 16 * 1024 * 1024;
+
+class MetricsConnection final
+	: public boost::intrusive::list_base_hook<>,
+	  FullyBufferedSocket {
+
+	MetricsServer &server;
+
+	/**
+	 * Destroys this object after the response has been sent; it
+	 * cannot be done from within OnSocketOutputEmpty().
+	 */
+	DeferEvent defer_close;
+
+public:
+	MetricsConnection(MetricsServer &_server,
+			  UniqueSocketDescriptor _fd) noexcept
+		:FullyBufferedSocket(_fd.Release(), _server.GetEventLoop(),
+				     client_output_pool, MAX_OUTPUT),
+		 server(_server),
+		 defer_close(_server.GetEventLoop(),
+			     BIND_THIS_METHOD(Destroy)) {}
+
+	~MetricsConnection() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+	void Destroy() noexcept {
+		server.connections.erase(server.connections.iterator_to(*this));
+		delete this;
+	}
+
+private:
+	void HandleRequest(const char *line) noexcept;
+
+	void SendResponse(const char *status, const char *content_type,
+			  const std::string &body) noexcept;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *data, size_t length) noexcept override;
+
+	void OnSocketError(std::exception_ptr ep) noexcept override {
+		LogError(ep);
+		defer_close.Schedule();
+	}
+
+	void OnSocketClosed() noexcept override {
+		defer_close.Schedule();
+	}
+
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketOutputEmpty() noexcept override {
+		defer_close.Schedule();
+	}
+};
+
+void
+MetricsConnection::SendResponse(const char *status, const char *content_type,
+				const std::string &body) noexcept
+{
+	char header[256];
+	snprintf(header, sizeof(header),
+		 "HTTP/1.0 %s\r\n"
+		 "Content-Type: %s\r\n"
+		 "Content-Length: %zu\r\n"
+		 "Connection: close\r\n"
+		 "\r\n",
+		 status, content_type, body.size());
+
+	if (Write(header, strlen(header)))
+		Write(body.data(), body.size());
+}
+
+void
+MetricsConnection::HandleRequest(const char *line) noexcept
+{
+	static constexpr char text_plain[] = "text/plain; charset=utf-8";
+
+	if (strncmp(line, "GET ", 4) != 0) {
+		SendResponse("405 Method Not Allowed", text_plain,
+			     "Method not allowed\n");
+		return;
+	}
+
+	const char *uri = line + 4;
+	const char *end = strchr(uri, ' ');
+	const size_t uri_length = end != nullptr ? size_t(end - uri) : strlen(uri);
+
+	if ((uri_length == 1 && *uri == '/') ||
+	    (uri_length == 8 && memcmp(uri, "/metrics", 8) == 0))
+		SendResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+			     CollectMetrics(server.instance));
+	else
+		SendResponse("404 Not Found", text_plain, "Not found\n");
+}
+
+BufferedSocket::InputResult
+MetricsConnection::OnSocketInput(void *data, size_t length) noexcept
+{
+	char *p = (char *)data;
+
+	/* wait for the end of the request header; closing the
+	   socket with unread data would make the kernel discard our
+	   response */
+	char *end = (char *)memmem(p, length, "\n\r\n", 3);
+	if (end == nullptr)
+		end = (char *)memmem(p, length, "\n\n", 2);
+	if (end == nullptr) {
+		if (length >= 4096) {
+			LogWarning(metrics_domain, "Request header too long");
+			Close();
+			defer_close.Schedule();
+			return InputResult::CLOSED;
+		}
+
+		return InputResult::MORE;
+	}
+
+	/* terminate the request line */
+	char *eol = (char *)memchr(p, '\n', end + 1 - p);
+	*eol = 0;
+	if (eol > p && eol[-1] == '\r')
+		eol[-1] = 0;
+
+	ConsumeInput(length);
+	HandleRequest(p);
+	return InputResult::PAUSE;
+}
+
+MetricsServer::MetricsServer(EventLoop &_loop,
+			     const Instance &_instance) noexcept
+	:ServerSocket(_loop), instance(_instance) {}
+
+MetricsServer::~MetricsServer() noexcept
+{
+	connections.clear_and_dispose([](MetricsConnection *c){
+		delete c;
+	});
+}
+
+void
+MetricsServer::OnAccept(UniqueSocketDescriptor fd,
+			SocketAddress, int) noexcept
+{
+	if (connections.size() >= MAX_CONNECTIONS) {
+		LogWarning(metrics_domain, "Too many connections");
+		return;
+	}
+
+	auto *c = new MetricsConnection(*this, std::move(fd));
+	connections.push_back(*c);
+}
+
+std::unique_ptr<MetricsServer>
+metrics_server_init(const ConfigData &config, EventLoop &loop,
+		    const Instance &instance)
+{
+	const unsigned port = config.GetPositive(ConfigOption::METRICS_PORT, 0);
+	if (port == 0)
+		return nullptr;
+
+	auto server = std::make_unique<MetricsServer>(loop, instance);
+
+	const auto *param = config.GetParam(ConfigOption::METRICS_BIND_TO_ADDRESS);
+	const char *address = param != nullptr
+		? param->value.c_str()
+		: "localhost";
+
+	try {
+		ServerSocketAddGeneric(*server, address, port);
+		server->Open();
+	} catch (...) {
+		std::throw_with_nested(FormatRuntimeError("Failed to listen on %s:%u",
+							  address, port));
+	}
+
+	return server;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METRICS_SERVER_HXX
+#define MPD_METRICS_SERVER_HXX
+
+#include "event/ServerSocket.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <memory>
+
+struct ConfigData;
+struct Instance;
+class MetricsConnection;
+
+/**
+ * A minimal HTTP server which responds to "GET /metrics" with the
+ * output of CollectMetrics(), to be scraped by Prometheus or a
+ * compatible collector.
+ */
+class MetricsServer final : public ServerSocket {
+	friend class MetricsConnection;
+
+	const Instance &instance;
+
+	typedef boost::intrusive::list<MetricsConnection,
+				       boost::intrusive::base_hook<boost::intrusive::list_base_hook<>>,
+				       boost::intrusive::constant_time_size<true>> ConnectionList;
+
+	ConnectionList connections;
+
+public:
+	MetricsServer(EventLoop &_loop, const Instance &_instance) noexcept;
+
+	~MetricsServer() noexcept;
+
+private:
+	void OnAccept(UniqueSocketDescriptor fd,
+		      SocketAddress address, int uid) noexcept override;
+};
+
+/**
+ * Create and open a #MetricsServer according to the "metrics_port"
+ * and "metrics_bind_to_address" settings.
+ *
+ * Throws on error.
+ *
+ * @return the new server, or nullptr if "metrics_port" is not
+ * configured
+ */
+std::unique_ptr<MetricsServer>
+metrics_server_init(const ConfigData &config, EventLoop &loop,
+		    const Instance &instance);
+
+#endif
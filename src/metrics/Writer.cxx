@@ -0,0 +1,149 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Writer.hxx"
+#include "LatencyHistogram.hxx"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+static double
+ToSeconds(LatencyHistogram::Duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::duration<double>>(d).count();
+}
+
+void
+MetricsWriter::Declare(const char *name, const char *type, const char *help)
+{
+	buffer += "# HELP ";
+	buffer += name;
+	buffer.push_back(' ');
+	buffer += help;
+	buffer += "\n# TYPE ";
+	buffer += name;
+	buffer.push_back(' ');
+	buffer += type;
+	buffer.push_back('\n');
+}
+
+void
+MetricsWriter::AppendName(const char *name, const char *suffix,
+			  const char *labels, const char *extra_label)
+{
+	buffer += name;
+	if (suffix != nullptr)
+		buffer += suffix;
+
+	const bool have_labels = labels != nullptr && *labels != 0;
+	if (have_labels || extra_label != nullptr) {
+		buffer.push_back('{');
+		if (have_labels)
+			buffer += labels;
+		if (extra_label != nullptr) {
+			if (have_labels)
+				buffer.push_back(',');
+			buffer += extra_label;
+		}
+		buffer.push_back('}');
+	}
+
+	buffer.push_back(' ');
+}
+
+void
+MetricsWriter::Sample(const char *name, const char *labels, double value)
+{
+	AppendName(name, nullptr, labels);
+
+	char s[32];
+	snprintf(s, sizeof(s), "%.9g\n", value);
+	buffer += s;
+}
+
+void
+MetricsWriter::Sample(const char *name, const char *labels, uint64_t value)
+{
+	AppendName(name, nullptr, labels);
+
+	char s[32];
+	snprintf(s, sizeof(s), "%" PRIu64 "\n", value);
+	buffer += s;
+}
+
+void
+MetricsWriter::Histogram(const char *name, const char *labels,
+			 const LatencyHistogram &h)
+{
+	char s[64];
+	uint64_t cumulative = 0;
+
+	for (unsigned i = 0; i < LatencyHistogram::N_BUCKETS - 1; ++i) {
+		cumulative += h.GetBucket(i);
+
+		char le[32];
+		snprintf(le, sizeof(le), "le=\"%g\"",
+			 ToSeconds(LatencyHistogram::GetBucketUpperBound(i)));
+		AppendName(name, "_bucket", labels, le);
+
+		snprintf(s, sizeof(s), "%" PRIu64 "\n", cumulative);
+		buffer += s;
+	}
+
+	AppendName(name, "_bucket", labels, "le=\"+Inf\"");
+	snprintf(s, sizeof(s), "%" PRIu64 "\n", h.GetCount());
+	buffer += s;
+
+	AppendName(name, "_sum", labels);
+	snprintf(s, sizeof(s), "%.9g\n", ToSeconds(h.GetSum()));
+	buffer += s;
+
+	AppendName(name, "_count", labels);
+	snprintf(s, sizeof(s), "%" PRIu64 "\n", h.GetCount());
+	buffer += s;
+}
+
+std::string
+MetricsWriter::Label(const char *name, const char *value)
+{
+	std::string result(name);
+	result += "=\"";
+
+	for (; *value != 0; ++value) {
+		switch (*value) {
+		case '\\':
+			result += "\\\\";
+			break;
+
+		case '"':
+			result += "\\\"";
+			break;
+
+		case '\n':
+			result += "\\n";
+			break;
+
+		default:
+			result.push_back(*value);
+		}
+	}
+
+	result.push_back('"');
+	return result;
+}
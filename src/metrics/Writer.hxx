@@ -0,0 +1,84 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METRICS_WRITER_HXX
+#define MPD_METRICS_WRITER_HXX
+
+#include "util/Compiler.h"
+
+#include <string>
+
+#include <stdint.h>
+
+class LatencyHistogram;
+
+/**
+ * Generates a response in the Prometheus text exposition format
+ * (version 0.0.4), which is also understood by OpenMetrics
+ * scrapers.
+ *
+ * Label strings are passed preformatted (e.g. `plugin="mad"`); use
+ * Label() to build them with proper escaping.
+ */
+class MetricsWriter {
+	std::string buffer;
+
+public:
+	/**
+	 * Begin a new metric family.
+	 *
+	 * @param type "counter", "gauge" or "histogram"
+	 */
+	void Declare(const char *name, const char *type, const char *help);
+
+	void Sample(const char *name, const char *labels, double value);
+
+	void Sample(const char *name, const char *labels, uint64_t value);
+
+	void Sample(const char *name, double value) {
+		Sample(name, nullptr, value);
+	}
+
+	void Sample(const char *name, uint64_t value) {
+		Sample(name, nullptr, value);
+	}
+
+	/**
+	 * Write the buckets, the sum and the count of a
+	 * #LatencyHistogram; the unit is seconds.
+	 */
+	void Histogram(const char *name, const char *labels,
+		       const LatencyHistogram &h);
+
+	/**
+	 * Format one label, escaping the value.
+	 */
+	gcc_pure
+	static std::string Label(const char *name, const char *value);
+
+	std::string &&Steal() noexcept {
+		return std::move(buffer);
+	}
+
+private:
+	void AppendName(const char *name, const char *suffix,
+			const char *labels, const char *extra_label=nullptr);
+};
+
+#endif
@@ -25,13 +25,24 @@
 #include "thread/Mutex.hxx"
 #include "util/Compiler.h"
 
+#include <atomic>
+
 class MixerListener;
 
 class Mixer {
 public:
 	const MixerPlugin &plugin;
 
-	MixerListener &listener;
+private:
+	/**
+	 * Receives volume change events.  This is atomic because it
+	 * may be replaced by SetListener() (e.g. when the output is
+	 * moved to another partition) while a plugin thread is
+	 * invoking it.
+	 */
+	std::atomic<MixerListener *> listener;
+
+public:
 
 	/**
 	 * This mutex protects all of the mixer struct, including its
@@ -53,7 +64,7 @@ public:
 public:
 	explicit Mixer(const MixerPlugin &_plugin,
 		       MixerListener &_listener) noexcept
-		:plugin(_plugin), listener(_listener) {}
+		:plugin(_plugin), listener(&_listener) {}
 
 	Mixer(const Mixer &) = delete;
 
@@ -63,6 +74,14 @@ public:
 		return &plugin == &other;
 	}
 
+	MixerListener &GetListener() const noexcept {
+		return *listener.load(std::memory_order_acquire);
+	}
+
+	void SetListener(MixerListener &_listener) noexcept {
+		listener.store(&_listener, std::memory_order_release);
+	}
+
 	/**
 	 * Open mixer device
 	 *
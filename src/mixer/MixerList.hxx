@@ -33,6 +33,7 @@ extern const MixerPlugin alsa_mixer_plugin;
 extern const MixerPlugin haiku_mixer_plugin;
 extern const MixerPlugin oss_mixer_plugin;
 extern const MixerPlugin osx_mixer_plugin;
+extern const MixerPlugin pipewire_mixer_plugin;
 extern const MixerPlugin pulse_mixer_plugin;
 extern const MixerPlugin winmm_mixer_plugin;
 extern const MixerPlugin sndio_mixer_plugin;
@@ -35,6 +35,8 @@ extern "C" {
 
 #include <alsa/asoundlib.h>
 
+#include <atomic>
+
 #include <math.h>
 
 #define VOLUME_MIXER_ALSA_DEFAULT		"default"
@@ -81,21 +83,47 @@ class AlsaMixer final : public Mixer {
 
 	AlsaMixerMonitor *monitor;
 
+	/**
+	 * The volume of #elem as of the last element event or
+	 * SetVolume() call; -1 if unknown.  This allows GetVolume()
+	 * to answer without accessing the hardware.
+	 */
+	std::atomic_int cached_volume;
+
 public:
 	AlsaMixer(EventLoop &_event_loop, MixerListener &_listener)
 		:Mixer(alsa_mixer_plugin, _listener),
-		 event_loop(_event_loop) {}
+		 event_loop(_event_loop), cached_volume(-1) {}
 
 	virtual ~AlsaMixer();
 
 	void Configure(const ConfigBlock &block);
 	void Setup();
 
+	/**
+	 * Read the volume from #elem (which libasound keeps up to
+	 * date with the element events) into #cached_volume.
+	 */
+	int UpdateVolume() noexcept {
+		int volume = ReadVolume();
+		cached_volume.store(volume, std::memory_order_relaxed);
+		return volume;
+	}
+
+	void InvalidateVolume() noexcept {
+		cached_volume.store(-1, std::memory_order_relaxed);
+	}
+
 	/* virtual methods from class Mixer */
 	void Open() override;
 	void Close() noexcept override;
 	int GetVolume() override;
 	void SetVolume(unsigned volume) override;
+
+private:
+	int ReadVolume() const noexcept {
+		return lrint(100 * get_normalized_playback_volume(elem, SND_MIXER_SCHN_FRONT_LEFT));
+	}
 };
 
 static constexpr Domain alsa_mixer_domain("alsa_mixer");
@@ -145,12 +173,17 @@ alsa_mixer_elem_callback(snd_mixer_elem_t *elem, unsigned mask)
 	AlsaMixer &mixer = *(AlsaMixer *)
 		snd_mixer_elem_get_callback_private(elem);
 
+	if (mask == SND_CTL_EVENT_MASK_REMOVE) {
+		/* the element is gone (e.g. the device was
+		   unplugged); let the next GetVolume() call report
+		   the error */
+		mixer.InvalidateVolume();
+		return 0;
+	}
+
 	if (mask & SND_CTL_EVENT_MASK_VALUE) {
-		try {
-			int volume = mixer.GetVolume();
-			mixer.listener.OnMixerVolumeChanged(mixer, volume);
-		} catch (...) {
-		}
+		int volume = mixer.UpdateVolume();
+		mixer.GetListener().OnMixerVolumeChanged(mixer, volume);
 	}
 
 	return 0;
@@ -230,6 +263,8 @@ AlsaMixer::Setup()
 	snd_mixer_elem_set_callback_private(elem, this);
 	snd_mixer_elem_set_callback(elem, alsa_mixer_elem_callback);
 
+	UpdateVolume();
+
 	monitor = new AlsaMixerMonitor(event_loop, handle);
 }
 
@@ -265,16 +300,19 @@ AlsaMixer::Close() noexcept
 int
 AlsaMixer::GetVolume()
 {
-	int err;
-
 	assert(handle != nullptr);
 
-	err = snd_mixer_handle_events(handle);
+	int volume = cached_volume.load(std::memory_order_relaxed);
+	if (volume >= 0)
+		/* the AlsaMixerMonitor keeps this up to date */
+		return volume;
+
+	int err = snd_mixer_handle_events(handle);
 	if (err < 0)
 		throw FormatRuntimeError("snd_mixer_handle_events() failed: %s",
 					 snd_strerror(err));
 
-	return lrint(100 * get_normalized_playback_volume(elem, SND_MIXER_SCHN_FRONT_LEFT));
+	return UpdateVolume();
 }
 
 void
@@ -288,6 +326,9 @@ AlsaMixer::SetVolume(unsigned volume)
 	if (err < 0)
 		throw FormatRuntimeError("failed to set ALSA volume: %s",
 					 snd_strerror(err));
+
+	/* libasound has updated the element's value */
+	UpdateVolume();
 }
 
 const MixerPlugin alsa_mixer_plugin = {
@@ -79,7 +79,7 @@ PulseMixer::Offline()
 
 	online = false;
 
-	listener.OnMixerVolumeChanged(*this, -1);
+	GetListener().OnMixerVolumeChanged(*this, -1);
 }
 
 inline void
@@ -96,7 +96,7 @@ PulseMixer::VolumeCallback(const pa_sink_input_info *i, int eol)
 	online = true;
 	volume = i->volume;
 
-	listener.OnMixerVolumeChanged(*this, GetVolumeInternal());
+	GetListener().OnMixerVolumeChanged(*this, GetVolumeInternal());
 }
 
 /**
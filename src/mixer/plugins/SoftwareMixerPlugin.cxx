@@ -87,7 +87,8 @@ SoftwareMixer::SetVolume(unsigned new_volume)
 	volume = new_volume;
 
 	if (filter != nullptr)
-		volume_filter_set(filter, PercentVolumeToSoftwareVolume(new_volume));
+		volume_filter_ramp(filter,
+				   PercentVolumeToSoftwareVolume(new_volume));
 }
 
 const MixerPlugin software_mixer_plugin = {
@@ -20,7 +20,7 @@
 #include "SmbclientNeighborPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
 #include "lib/smbclient/Domain.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "neighbor/NeighborPlugin.hxx"
 #include "neighbor/Explorer.hxx"
 #include "neighbor/Listener.hxx"
@@ -29,11 +29,16 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
+#include "config/Block.hxx"
 #include "Log.hxx"
 
 #include <libsmbclient.h>
 
 #include <algorithm>
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
 
 class SmbclientNeighborExplorer final : public NeighborExplorer {
 	struct Server {
@@ -64,12 +69,26 @@ class SmbclientNeighborExplorer final : public NeighborExplorer {
 
 	List list;
 
+	/**
+	 * The pause between two scans of the network.
+	 */
+	const std::chrono::steady_clock::duration interval;
+
+	/**
+	 * The libsmbclient timeout for each server [ms]; 0 means
+	 * the libsmbclient default.
+	 */
+	const unsigned timeout_ms;
+
 	bool quit;
 
 public:
-	SmbclientNeighborExplorer(NeighborListener &_listener)
+	SmbclientNeighborExplorer(NeighborListener &_listener,
+				  std::chrono::steady_clock::duration _interval,
+				  unsigned _timeout_ms)
 		:NeighborExplorer(_listener),
-		 thread(BIND_THIS_METHOD(ThreadFunc)) {}
+		 thread(BIND_THIS_METHOD(ThreadFunc)),
+		 interval(_interval), timeout_ms(_timeout_ms) {}
 
 	/* virtual methods from class NeighborExplorer */
 	void Open() override;
@@ -77,6 +96,26 @@ public:
 	List GetList() const noexcept override;
 
 private:
+	/**
+	 * Add the servers of one workgroup to #list and announce the
+	 * new ones.
+	 *
+	 * @param seen collects the URIs of all servers seen during
+	 * this scan
+	 */
+	void Merge(List &&found, std::set<std::string> &seen) noexcept;
+
+	/**
+	 * Remove all servers which have not been seen during this
+	 * scan and announce them.
+	 */
+	void Expire(const std::set<std::string> &seen) noexcept;
+
+	bool LockIsQuit() const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return quit;
+	}
+
 	void Run();
 	void ThreadFunc();
 };
@@ -120,112 +159,139 @@ ReadServer(NeighborExplorer::List &list, const smbc_dirent &e)
 	list.emplace_front("smb://" + name, name + " (" + comment + ")");
 }
 
+/**
+ * Read one directory of the "smb://" hierarchy, i.e. the list of
+ * workgroups or the servers of one workgroup.
+ *
+ * @param workgroups receives the names of workgroups
+ */
 static void
-ReadServers(NeighborExplorer::List &list, const char *uri);
-
-static void
-ReadWorkgroup(NeighborExplorer::List &list, const std::string &name)
-{
-	std::string uri = "smb://" + name;
-	ReadServers(list, uri.c_str());
-}
-
-static void
-ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e)
+ReadEntries(SmbclientContext &ctx,
+	    NeighborExplorer::List &servers,
+	    std::vector<std::string> &workgroups,
+	    const char *uri) noexcept
 {
-	switch (e.smbc_type) {
-	case SMBC_WORKGROUP:
-		ReadWorkgroup(list, std::string(e.name, e.namelen));
-		break;
-
-	case SMBC_SERVER:
-		ReadServer(list, e);
-		break;
+	SMBCFILE *dir = ctx.OpenDirectory(uri);
+	if (dir == nullptr) {
+		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
+			    uri);
+		return;
 	}
-}
 
-static void
-ReadServers(NeighborExplorer::List &list, int fd)
-{
-	smbc_dirent *e;
-	while ((e = smbc_readdir(fd)) != nullptr)
-		ReadEntry(list, *e);
+	const smbc_dirent *e;
+	while ((e = ctx.ReadDirectory(*dir)) != nullptr) {
+		switch (e->smbc_type) {
+		case SMBC_WORKGROUP:
+			workgroups.emplace_back(e->name, e->namelen);
+			break;
 
-	smbc_closedir(fd);
-}
+		case SMBC_SERVER:
+			ReadServer(servers, *e);
+			break;
+		}
+	}
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri)
-{
-	int fd = smbc_opendir(uri);
-	if (fd >= 0) {
-		ReadServers(list, fd);
-		smbc_closedir(fd);
-	} else
-		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
-			    uri);
+	ctx.CloseDirectory(*dir);
 }
 
-gcc_pure
-static NeighborExplorer::List
-DetectServers() noexcept
+void
+SmbclientNeighborExplorer::Merge(List &&found,
+				 std::set<std::string> &seen) noexcept
 {
-	NeighborExplorer::List list;
-	const std::lock_guard<Mutex> protect(smbclient_mutex);
-	ReadServers(list, "smb://");
-	return list;
+	List added;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		for (auto &i : found) {
+			if (!seen.emplace(i.uri).second)
+				/* duplicate */
+				continue;
+
+			auto existing = std::find_if(list.begin(), list.end(),
+						     [&i](const NeighborInfo &n){
+							     return n.uri == i.uri;
+						     });
+			if (existing != list.end()) {
+				/* still visible; update the
+				   display name */
+				existing->display_name = std::move(i.display_name);
+				continue;
+			}
+
+			list.push_front(i);
+			added.push_front(std::move(i));
+		}
+	}
+
+	for (const auto &i : added)
+		listener.FoundNeighbor(i);
 }
 
-gcc_pure
-static NeighborExplorer::List::const_iterator
-FindBeforeServerByURI(NeighborExplorer::List::const_iterator prev,
-		      NeighborExplorer::List::const_iterator end,
-		      const std::string &uri) noexcept
+void
+SmbclientNeighborExplorer::Expire(const std::set<std::string> &seen) noexcept
 {
-	for (auto i = std::next(prev); i != end; prev = i, i = std::next(prev))
-		if (i->uri == uri)
-			return prev;
+	List lost;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		for (auto prev = list.before_begin(), i = std::next(prev);
+		     i != list.end(); i = std::next(prev)) {
+			if (seen.find(i->uri) == seen.end())
+				/* can't see it anymore: move to
+				   "lost" */
+				lost.splice_after(lost.before_begin(), list,
+						  prev);
+			else
+				prev = i;
+		}
+	}
 
-	return end;
+	for (const auto &i : lost)
+		listener.LostNeighbor(i);
 }
 
 inline void
 SmbclientNeighborExplorer::Run()
 {
-	List found = DetectServers(), lost;
+	/* scan one workgroup at a time and announce its servers
+	   right away, instead of waiting for the whole network; this
+	   thread has its own context, so it does not block storages
+	   and input streams */
+
+	SmbclientContext ctx;
+	try {
+		ctx = SmbclientContext::New(timeout_ms);
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
 
-	mutex.lock();
+	std::set<std::string> seen;
+	std::vector<std::string> workgroups;
 
-	const auto found_before_begin = found.before_begin();
-	const auto found_end = found.end();
-
-	for (auto prev = list.before_begin(), i = std::next(prev), end = list.end();
-	     i != end; i = std::next(prev)) {
-		auto f = FindBeforeServerByURI(found_before_begin, found_end,
-					       i->uri);
-		if (f != found_end) {
-			/* still visible: remove from "found" so we
-			   don't believe it's a new one */
-			*i = std::move(*std::next(f));
-			found.erase_after(f);
-			prev = i;
-		} else {
-			/* can't see it anymore: move to "lost" */
-			lost.splice_after(lost.before_begin(), list, prev);
-		}
+	{
+		List servers;
+		ReadEntries(ctx, servers, workgroups, "smb://");
+		Merge(std::move(servers), seen);
 	}
 
-	for (auto prev = found_before_begin, i = std::next(prev);
-	     i != found_end; prev = i, i = std::next(prev))
-		list.push_front(*i);
+	for (std::size_t i = 0; i < workgroups.size(); ++i) {
+		if (LockIsQuit())
+			return;
 
-	mutex.unlock();
+		const std::string uri = "smb://" + workgroups[i];
 
-	for (auto &i : lost)
-		listener.LostNeighbor(i);
+		List servers;
+		/* nested workgroups are appended and scanned in a
+		   later iteration */
+		ReadEntries(ctx, servers, workgroups, uri.c_str());
 
-	for (auto &i : found)
-		listener.FoundNeighbor(i);
+		Merge(std::move(servers), seen);
+	}
+
+	Expire(seen);
 }
 
 inline void
@@ -244,8 +310,7 @@ SmbclientNeighborExplorer::ThreadFunc()
 		if (quit)
 			break;
 
-		// TODO: sleep for how long?
-		cond.timed_wait(mutex, std::chrono::seconds(10));
+		cond.timed_wait(mutex, interval);
 	}
 
 	mutex.unlock();
@@ -254,11 +319,17 @@ SmbclientNeighborExplorer::ThreadFunc()
 static std::unique_ptr<NeighborExplorer>
 smbclient_neighbor_create(gcc_unused EventLoop &loop,
 			  NeighborListener &listener,
-			  gcc_unused const ConfigBlock &block)
+			  const ConfigBlock &block)
 {
+	const std::chrono::seconds interval(block.GetBlockValue("interval",
+								 10u));
+	const unsigned timeout_ms = block.GetBlockValue("timeout", 0u) * 1000;
+
 	SmbclientInit();
 
-	return std::make_unique<SmbclientNeighborExplorer>(listener);
+	return std::make_unique<SmbclientNeighborExplorer>(listener,
+							   interval,
+							   timeout_ms);
 }
 
 const NeighborPlugin smbclient_neighbor_plugin = {
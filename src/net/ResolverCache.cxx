@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2009-2019 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ResolverCache.hxx"
+#include "Resolver.hxx"
+#include "AddressInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#endif
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <tuple>
+
+/**
+ * How long are cached results valid?
+ */
+static constexpr std::chrono::steady_clock::duration resolver_cache_ttl =
+	std::chrono::minutes(5);
+
+/**
+ * The maximum number of cache entries.  If the cache is full,
+ * expired entries are purged, and if that is not enough, the
+ * oldest entry is evicted.
+ */
+static constexpr std::size_t resolver_cache_max_size = 64;
+
+namespace {
+
+struct ResolverCacheKey {
+	std::string host_and_port;
+	unsigned default_port;
+	int socktype;
+
+	bool operator<(const ResolverCacheKey &other) const noexcept {
+		return std::tie(host_and_port, default_port, socktype) <
+			std::tie(other.host_and_port, other.default_port,
+				 other.socktype);
+	}
+};
+
+struct ResolverCacheItem {
+	std::vector<AllocatedSocketAddress> addresses;
+	std::chrono::steady_clock::time_point expires;
+};
+
+}
+
+static Mutex resolver_cache_mutex;
+static std::map<ResolverCacheKey, ResolverCacheItem> resolver_cache;
+
+/**
+ * Caller must lock #resolver_cache_mutex.
+ */
+static void
+PurgeResolverCache(std::chrono::steady_clock::time_point now) noexcept
+{
+	auto oldest = resolver_cache.end();
+
+	for (auto i = resolver_cache.begin(); i != resolver_cache.end();) {
+		if (i->second.expires <= now) {
+			i = resolver_cache.erase(i);
+			continue;
+		}
+
+		if (oldest == resolver_cache.end() ||
+		    i->second.expires < oldest->second.expires)
+			oldest = i;
+		++i;
+	}
+
+	if (resolver_cache.size() >= resolver_cache_max_size)
+		resolver_cache.erase(oldest);
+}
+
+std::vector<AllocatedSocketAddress>
+LookupResolverCache(const char *host_and_port, unsigned default_port,
+		    int socktype) noexcept
+try {
+	const ResolverCacheKey key{host_and_port, default_port, socktype};
+	const auto now = std::chrono::steady_clock::now();
+
+	const std::lock_guard<Mutex> lock(resolver_cache_mutex);
+	auto i = resolver_cache.find(key);
+	if (i == resolver_cache.end())
+		return {};
+
+	if (i->second.expires <= now) {
+		resolver_cache.erase(i);
+		return {};
+	}
+
+	return i->second.addresses;
+} catch (...) {
+	/* out of memory */
+	return {};
+}
+
+std::vector<AllocatedSocketAddress>
+CachedResolve(const char *host_and_port, unsigned default_port,
+	      int socktype)
+{
+	auto result = LookupResolverCache(host_and_port, default_port,
+					  socktype);
+	if (!result.empty())
+		return result;
+
+	/* resolve without holding the lock; concurrent lookups of
+	   the same host may both call getaddrinfo(), which is
+	   harmless */
+	const auto ai = Resolve(host_and_port, default_port,
+				AI_ADDRCONFIG, socktype);
+	for (const auto &i : ai)
+		result.emplace_back(SocketAddress(i));
+
+	if (result.empty())
+		return result;
+
+	ResolverCacheKey key{host_and_port, default_port, socktype};
+	const auto now = std::chrono::steady_clock::now();
+
+	const std::lock_guard<Mutex> lock(resolver_cache_mutex);
+	resolver_cache.erase(key);
+	if (resolver_cache.size() >= resolver_cache_max_size)
+		PurgeResolverCache(now);
+
+	resolver_cache.emplace(std::move(key),
+			       ResolverCacheItem{result,
+					       now + resolver_cache_ttl});
+	return result;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2009-2019 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef NET_RESOLVER_CACHE_HXX
+#define NET_RESOLVER_CACHE_HXX
+
+#include "AllocatedSocketAddress.hxx"
+
+#include <vector>
+
+/**
+ * Like Resolve(), but consult a process-wide cache first, and store
+ * successful results in the cache.  This is meant for client
+ * connections; getaddrinfo() does not expose the DNS record's TTL,
+ * so entries expire after a fixed period.
+ *
+ * This function is thread-safe, but it blocks while resolving a
+ * host which is not in the cache; #EventLoop code should use
+ * #AsyncResolver instead.
+ *
+ * Throws on error.
+ *
+ * @return a non-empty list of addresses
+ */
+std::vector<AllocatedSocketAddress>
+CachedResolve(const char *host_and_port, unsigned default_port,
+	      int socktype);
+
+/**
+ * Look up the given host in the cache without resolving it.  This
+ * function is thread-safe and never blocks.
+ *
+ * @return the cached addresses or an empty list if the host is not
+ * (or no longer) in the cache
+ */
+std::vector<AllocatedSocketAddress>
+LookupResolverCache(const char *host_and_port, unsigned default_port,
+		    int socktype) noexcept;
+
+#endif
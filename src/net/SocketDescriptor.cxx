@@ -39,6 +39,7 @@
 #include <ws2tcpip.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #endif
@@ -444,6 +445,26 @@ SocketDescriptor::Write(const void *buffer, size_t length) noexcept
 	return ::send(Get(), (const char *)buffer, length, flags);
 }
 
+#ifndef _WIN32
+
+ssize_t
+SocketDescriptor::Write(const struct iovec *v, size_t n) noexcept
+{
+	int flags = 0;
+#ifdef __linux__
+	flags |= MSG_NOSIGNAL;
+#endif
+
+	struct msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = const_cast<struct iovec *>(v);
+	m.msg_iovlen = n;
+
+	return ::sendmsg(Get(), &m, flags);
+}
+
+#endif
+
 #ifdef _WIN32
 
 int
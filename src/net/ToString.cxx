@@ -139,3 +139,22 @@ ToString(SocketAddress address) noexcept
 	result.append(serv);
 	return result;
 }
+
+std::string
+HostToString(SocketAddress address) noexcept
+{
+#if defined(HAVE_IPV6) && defined(IN6_IS_ADDR_V4MAPPED)
+	struct sockaddr_in in_buffer;
+	if (address.IsV4Mapped())
+		address = UnmapV4(address, in_buffer);
+#endif
+
+	char host[NI_MAXHOST];
+	int ret = getnameinfo(address.GetAddress(), address.GetSize(),
+			      host, sizeof(host), nullptr, 0,
+			      NI_NUMERICHOST);
+	if (ret != 0)
+		return std::string();
+
+	return host;
+}
@@ -44,4 +44,13 @@ gcc_pure
 std::string
 ToString(SocketAddress address) noexcept;
 
+/**
+ * Converts the host part of the specified IP address into a numeric
+ * string (without brackets and without the port).  Returns an empty
+ * string on error.
+ */
+gcc_pure
+std::string
+HostToString(SocketAddress address) noexcept;
+
 #endif
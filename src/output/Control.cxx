@@ -19,6 +19,7 @@
 
 #include "Control.hxx"
 #include "Filtered.hxx"
+#include "Client.hxx"
 #include "Domain.hxx"
 #include "mixer/MixerControl.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
@@ -35,11 +36,25 @@ static constexpr PeriodClock::Duration REOPEN_AFTER = std::chrono::seconds(10);
 
 AudioOutputControl::AudioOutputControl(std::unique_ptr<FilteredAudioOutput> _output,
 				       AudioOutputClient &_client) noexcept
-	:output(std::move(_output)), client(_client),
+	:output(std::move(_output)), name(output->GetName()),
+	 client(_client),
 	 thread(BIND_THIS_METHOD(Task))
 {
 }
 
+AudioOutputControl::AudioOutputControl(AudioOutputControl &&src,
+				       AudioOutputClient &_client) noexcept
+	:output(src.Steal()), name(src.name),
+	 client(_client),
+	 thread(BIND_THIS_METHOD(Task)),
+	 tags(src.tags), always_on(src.always_on),
+	 keep_device_format(src.keep_device_format),
+	 sync(src.sync),
+	 thread_config(src.thread_config),
+	 enabled(false)
+{
+}
+
 AudioOutputControl::~AudioOutputControl() noexcept
 {
 	if (thread.IsDefined())
@@ -51,43 +66,87 @@ AudioOutputControl::Configure(const ConfigBlock &block)
 {
 	tags = block.GetBlockValue("tags", true);
 	always_on = block.GetBlockValue("always_on", false);
+	keep_device_format = block.GetBlockValue("keep_device_format", false);
+	sync = block.GetBlockValue("sync", false);
 	enabled = block.GetBlockValue("enabled", true);
+	thread_config.Load(block);
 }
 
-const char *
-AudioOutputControl::GetName() const noexcept
+std::unique_ptr<FilteredAudioOutput>
+AudioOutputControl::Steal() noexcept
+{
+	assert(!IsDummy());
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		/* clear the flag first, or the player thread might
+		   reopen the device right away */
+		enabled = false;
+
+		CloseWait();
+	}
+
+	/* the KILL command disables the device */
+	BeginDestroy();
+	if (thread.IsDefined())
+		thread.Join();
+
+	const std::lock_guard<Mutex> protect(mutex);
+	really_enabled = false;
+	return std::exchange(output, nullptr);
+}
+
+void
+AudioOutputControl::ReplaceDummy(std::unique_ptr<FilteredAudioOutput> new_output,
+				 bool _enabled) noexcept
 {
-	return output->GetName();
+	assert(IsDummy());
+	assert(new_output);
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		output = std::move(new_output);
+		enabled = _enabled;
+	}
+
+	client.ApplyEnabled();
 }
 
 const char *
 AudioOutputControl::GetPluginName() const noexcept
 {
-	return output->GetPluginName();
+	return output ? output->GetPluginName() : "dummy";
 }
 
 const char *
 AudioOutputControl::GetLogName() const noexcept
 {
-	return output->GetLogName();
+	return output ? output->GetLogName() : name.c_str();
 }
 
 Mixer *
 AudioOutputControl::GetMixer() const noexcept
 {
-	return output->mixer;
+	return output ? output->mixer : nullptr;
 }
 
 const std::map<std::string, std::string>
 AudioOutputControl::GetAttributes() const noexcept
 {
-	return output->GetAttributes();
+	return output
+		? output->GetAttributes()
+		: std::map<std::string, std::string>();
 }
 
 void
-AudioOutputControl::SetAttribute(std::string &&name, std::string &&value)
+AudioOutputControl::SetAttribute(std::string &&attribute_name,
+				 std::string &&value)
 {
-	output->SetAttribute(std::move(name), std::move(value));
+	if (!output)
+		throw std::runtime_error("Cannot set attribute on dummy output");
+
+	output->SetAttribute(std::move(attribute_name), std::move(value));
 }
 
 bool
@@ -142,6 +201,9 @@ AudioOutputControl::LockCommandWait(Command cmd) noexcept
 void
 AudioOutputControl::EnableAsync()
 {
+	if (!output)
+		return;
+
 	if (!thread.IsDefined()) {
 		if (!output->SupportsEnableDisable()) {
 			/* don't bother to start the thread now if the
@@ -161,7 +223,7 @@ void
 AudioOutputControl::DisableAsync() noexcept
 {
 	if (!thread.IsDefined()) {
-		if (!output->SupportsEnableDisable())
+		if (!output || !output->SupportsEnableDisable())
 			really_enabled = false;
 		else
 			/* if there's no thread yet, the device cannot
@@ -238,8 +300,9 @@ AudioOutputControl::CloseWait() noexcept
 {
 	assert(allow_play);
 
-	if (output->mixer != nullptr)
-		mixer_auto_close(output->mixer);
+	Mixer *const mixer = GetMixer();
+	if (mixer != nullptr)
+		mixer_auto_close(mixer);
 
 	assert(!open || !fail_timer.IsDefined());
 
@@ -299,7 +362,7 @@ AudioOutputControl::LockPlay() noexcept
 void
 AudioOutputControl::LockPauseAsync() noexcept
 {
-	if (output->mixer != nullptr && !output->SupportsPause())
+	if (output && output->mixer != nullptr && !output->SupportsPause())
 		/* the device has no pause mode: close the mixer,
 		   unless its "global" flag is set (checked by
 		   mixer_auto_close()) */
@@ -346,7 +409,7 @@ AudioOutputControl::LockAllowPlay() noexcept
 void
 AudioOutputControl::LockRelease() noexcept
 {
-	if (output->mixer != nullptr &&
+	if (output && output->mixer != nullptr &&
 	    (!always_on || !output->SupportsPause()))
 		/* the device has no pause mode: close the mixer,
 		   unless its "global" flag is set (checked by
@@ -21,13 +21,16 @@
 #define MPD_OUTPUT_CONTROL_HXX
 
 #include "Source.hxx"
+#include "SyncClock.hxx"
 #include "AudioFormat.hxx"
+#include "ThreadConfig.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "system/PeriodClock.hxx"
 #include "util/Compiler.h"
 
+#include <chrono>
 #include <utility>
 #include <exception>
 #include <memory>
@@ -53,8 +56,19 @@ class AudioOutputClient;
  * Controller for an #AudioOutput and its output thread.
  */
 class AudioOutputControl {
+	/**
+	 * The output device; nullptr if this instance is a "dummy"
+	 * which remains after the device has been moved to another
+	 * partition (see Steal()).
+	 */
 	std::unique_ptr<FilteredAudioOutput> output;
 
+	/**
+	 * The name of the output device.  This is a copy, because a
+	 * "dummy" needs to retain it.
+	 */
+	const std::string name;
+
 	/**
 	 * The PlayerControl object which "owns" this output.  This
 	 * object is needed to signal command completion.
@@ -160,6 +174,31 @@ class AudioOutputControl {
 	 */
 	bool always_on;
 
+	/**
+	 * If the input format changes while the device is open,
+	 * convert to the current device format instead of reopening
+	 * the device ("keep_device_format")?
+	 */
+	bool keep_device_format;
+
+	/**
+	 * Keep the device aligned with the monotonic system clock by
+	 * inserting silence or dropping frames ("sync")?
+	 */
+	bool sync;
+
+	/**
+	 * Used only if #sync is enabled.  Only accessed by the output
+	 * thread.
+	 */
+	OutputSyncClock sync_clock;
+
+	/**
+	 * Scheduling settings for the output thread
+	 * ("cpu_affinity", "realtime_priority", "timer_slack").
+	 */
+	ThreadConfig thread_config{50, 100};
+
 	/**
 	 * Has the user enabled this device?
 	 */
@@ -218,6 +257,20 @@ class AudioOutputControl {
 	 */
 	bool skip_delay;
 
+	/**
+	 * How long did each AudioOutput::Play() call take?
+	 * Protected by #mutex.
+	 */
+	LatencyHistogram play_latency;
+
+	/**
+	 * The CPU time this output thread has spent in
+	 * AudioOutput::Play() calls, i.e. mostly encoding for
+	 * streaming outputs.  Protected by #mutex.
+	 */
+	std::chrono::steady_clock::duration play_cpu_time =
+		std::chrono::steady_clock::duration::zero();
+
 public:
 	/**
 	 * This mutex protects #open, #fail_timer, #pipe.
@@ -227,6 +280,15 @@ public:
 	AudioOutputControl(std::unique_ptr<FilteredAudioOutput> _output,
 			   AudioOutputClient &_client) noexcept;
 
+	/**
+	 * Move the output device from another instance (which is
+	 * turned into a "dummy") to a new instance owned by a
+	 * different #AudioOutputClient.  The new instance is
+	 * disabled.
+	 */
+	AudioOutputControl(AudioOutputControl &&src,
+			   AudioOutputClient &_client) noexcept;
+
 	~AudioOutputControl() noexcept;
 
 	AudioOutputControl(const AudioOutputControl &) = delete;
@@ -237,8 +299,31 @@ public:
 	 */
 	void Configure(const ConfigBlock &block);
 
-	gcc_pure
-	const char *GetName() const noexcept;
+	/**
+	 * Is this a "dummy" which remains after the output device
+	 * has been moved to another partition?
+	 */
+	bool IsDummy() const noexcept {
+		return !output;
+	}
+
+	/**
+	 * Close and disable the output device, stop the output
+	 * thread and remove the device from this object, turning it
+	 * into a "dummy".
+	 */
+	std::unique_ptr<FilteredAudioOutput> Steal() noexcept;
+
+	/**
+	 * Attach an output device (obtained by Steal()) to this
+	 * "dummy" again.
+	 */
+	void ReplaceDummy(std::unique_ptr<FilteredAudioOutput> new_output,
+			  bool _enabled) noexcept;
+
+	const char *GetName() const noexcept {
+		return name.c_str();
+	}
 
 	gcc_pure
 	const char *GetPluginName() const noexcept;
@@ -331,6 +416,35 @@ public:
 	void BeginDestroy() noexcept;
 
 	const std::map<std::string, std::string> GetAttributes() const noexcept;
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	const LatencyHistogram &GetQueueLatency() const noexcept {
+		return source.GetQueueLatency();
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	const LatencyHistogram &GetFilterLatency() const noexcept {
+		return source.GetFilterLatency();
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	const LatencyHistogram &GetPlayLatency() const noexcept {
+		return play_latency;
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	std::chrono::steady_clock::duration GetPlayCPUTime() const noexcept {
+		return play_cpu_time;
+	}
+
 	void SetAttribute(std::string &&name, std::string &&value);
 
 	/**
@@ -370,6 +484,16 @@ public:
 		source.SetReplayGainMode(_mode);
 	}
 
+	/**
+	 * Attempt to convert the new filter output to the format of
+	 * the open device ("keep_device_format").
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @return false if the device needs to be reopened
+	 */
+	bool KeepDeviceFormat() noexcept;
+
 	/**
 	 * Caller must lock the mutex.
 	 *
@@ -502,6 +626,17 @@ private:
 	 */
 	bool PlayChunk() noexcept;
 
+	/**
+	 * Apply a correction determined by #sync_clock: play
+	 * silence, or drop frames from the #source.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @return false if the device has failed (and has been
+	 * closed)
+	 */
+	bool SyncToClock() noexcept;
+
 	/**
 	 * Plays all remaining chunks, until the tail of the pipe has
 	 * been reached (and no more chunks are queued), or until a
@@ -33,6 +33,12 @@ struct AudioOutputDefaults {
 
 	MixerType mixer_type = MixerType::HARDWARE;
 
+	/**
+	 * The global "low_latency" setting; see
+	 * AudioOutput::SetLowLatency().
+	 */
+	bool low_latency = false;
+
 	constexpr AudioOutputDefaults() = default;
 
 	/**
@@ -124,6 +124,15 @@ public:
 	 */
 	FilterObserver convert_filter;
 
+	/**
+	 * Describes the filter configuration; outputs with the same
+	 * key share their filter results (see
+	 * AudioOutputSource::Share()).  Empty if the filters have
+	 * per-output state (e.g. a software mixer) and must not be
+	 * shared.
+	 */
+	std::string share_key;
+
 	/**
 	 * Throws #std::runtime_error on error.
 	 */
@@ -35,6 +35,7 @@
 #include "filter/plugins/ChainFilterPlugin.hxx"
 #include "filter/plugins/VolumeFilterPlugin.hxx"
 #include "filter/plugins/NormalizeFilterPlugin.hxx"
+#include "pcm/ConfiguredResampler.hxx"
 #include "config/Domain.hxx"
 #include "config/Option.hxx"
 #include "config/Block.hxx"
@@ -183,10 +184,14 @@ FilteredAudioOutput::Configure(const ConfigBlock &block,
 				    autoconvert_filter_new(normalize_filter_prepare()));
 	}
 
+	const char *filters = block.GetBlockValue(AUDIO_FILTERS, "");
+	share_key = defaults.normalize ? "normalize;" : ";";
+	share_key += filters;
+
 	try {
 		if (filter_factory != nullptr)
 			filter_chain_parse(*prepared_filter, *filter_factory,
-					   block.GetBlockValue(AUDIO_FILTERS, ""));
+					   filters);
 	} catch (...) {
 		/* It's not really fatal - Part of the filter chain
 		   has been set up already and even an empty one will
@@ -252,10 +257,30 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		throw std::runtime_error("Invalid \"replay_gain_handler\" value");
 	}
 
+	if (audio_output_mixer_type(block, defaults) == MixerType::SOFTWARE ||
+	    strcmp(replay_gain_handler, "mixer") == 0)
+		/* the volume is specific to this output */
+		share_key.clear();
+	else {
+		share_key += ';';
+		share_key += replay_gain_handler;
+	}
+
 	/* the "convert" filter must be the last one in the chain */
 
+	const PcmResamplerProfile *resampler_profile = nullptr;
+	const char *resampler_name = block.GetBlockValue("resampler");
+	if (resampler_name != nullptr) {
+		resampler_profile = &pcm_resampler_find(resampler_name);
+
+		if (!share_key.empty()) {
+			share_key += ';';
+			share_key += resampler_name;
+		}
+	}
+
 	filter_chain_append(*prepared_filter, "convert",
-			    convert_filter.Set(convert_filter_prepare()));
+			    convert_filter.Set(convert_filter_prepare(resampler_profile)));
 }
 
 std::unique_ptr<FilteredAudioOutput>
@@ -293,6 +318,9 @@ audio_output_new(EventLoop &event_loop,
 						       block));
 	assert(ao != nullptr);
 
+	if (defaults.low_latency)
+		ao->SetLowLatency();
+
 	auto f = std::make_unique<FilteredAudioOutput>(plugin->name,
 						       std::move(ao), block,
 						       defaults,
@@ -76,6 +76,15 @@ public:
 	 */
 	virtual void SetAttribute(std::string &&name, std::string &&value);
 
+	/**
+	 * The user prefers low latency over robustness (the global
+	 * "low_latency" setting).  The plugin may choose a small
+	 * device buffer and grow it automatically after underruns.
+	 * This is called once, right after the plugin was
+	 * constructed.
+	 */
+	virtual void SetLowLatency() noexcept {}
+
 	/**
 	 * Enable the device.  This may allocate resources, preparing
 	 * for the device to be opened.
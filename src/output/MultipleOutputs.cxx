@@ -19,6 +19,7 @@
 
 #include "MultipleOutputs.hxx"
 #include "Filtered.hxx"
+#include "Client.hxx"
 #include "Defaults.hxx"
 #include "Domain.hxx"
 #include "MusicPipe.hxx"
@@ -143,6 +144,19 @@ MultipleOutputs::AddNullOutput(EventLoop &event_loop,
 	outputs.push_back(output);
 }
 
+AudioOutputControl &
+MultipleOutputs::AddMoveFrom(AudioOutputControl &&src,
+			     AudioOutputClient &client,
+			     bool enable) noexcept
+{
+	auto *output = new AudioOutputControl(std::move(src), client);
+	output->LockSetEnabled(enable);
+	outputs.push_back(output);
+
+	client.ApplyEnabled();
+	return *output;
+}
+
 AudioOutputControl *
 MultipleOutputs::FindByName(const char *name) noexcept
 {
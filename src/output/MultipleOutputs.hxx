@@ -81,6 +81,17 @@ public:
 			   const ReplayGainConfig &replay_gain_config,
 			   AudioOutputClient &client);
 
+	/**
+	 * Move an output device from another #MultipleOutputs
+	 * instance (see AudioOutputControl::Steal()) to this one.
+	 * The source is left behind as a "dummy".
+	 *
+	 * @return the new #AudioOutputControl
+	 */
+	AudioOutputControl &AddMoveFrom(AudioOutputControl &&src,
+			 AudioOutputClient &client,
+			 bool enable) noexcept;
+
 	/**
 	 * Returns the total number of audio output devices, including
 	 * those which are disabled right now.
@@ -25,6 +25,7 @@
 #include "Print.hxx"
 #include "MultipleOutputs.hxx"
 #include "Filtered.hxx"
+#include "LatencyPrint.hxx"
 #include "client/Response.hxx"
 
 void
@@ -46,3 +47,32 @@ printAudioDevices(Response &r, const MultipleOutputs &outputs)
 				 a.first.c_str(), a.second.c_str());
 	}
 }
+
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs)
+{
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+		const auto &ao = outputs.Get(i);
+
+		r.Format("outputid: %u\n"
+			 "outputname: %s\n",
+			 i, ao.GetName());
+
+		LatencyHistogram queue, filter, play;
+		std::chrono::steady_clock::duration play_cpu_time;
+
+		{
+			const std::lock_guard<Mutex> protect(ao.mutex);
+			queue = ao.GetQueueLatency();
+			filter = ao.GetFilterLatency();
+			play = ao.GetPlayLatency();
+			play_cpu_time = ao.GetPlayCPUTime();
+		}
+
+		latency_print(r, "queue", queue);
+		latency_print(r, "filter", filter);
+		latency_print(r, "play", play);
+		r.Format("play_cpu_time: %1.3f\n",
+			 std::chrono::duration_cast<std::chrono::duration<double>>(play_cpu_time).count());
+	}
+}
@@ -31,4 +31,10 @@ class MultipleOutputs;
 void
 printAudioDevices(Response &r, const MultipleOutputs &outputs);
 
+/**
+ * Print the latency telemetry of all audio outputs.
+ */
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs);
+
 #endif
@@ -32,8 +32,10 @@
 #include "plugins/OssOutputPlugin.hxx"
 #include "plugins/OSXOutputPlugin.hxx"
 #include "plugins/PipeOutputPlugin.hxx"
+#include "plugins/PipeWireOutputPlugin.hxx"
 #include "plugins/PulseOutputPlugin.hxx"
 #include "plugins/RecorderOutputPlugin.hxx"
+#include "plugins/ShmOutputPlugin.hxx"
 #include "plugins/ShoutOutputPlugin.hxx"
 #include "plugins/sles/SlesOutputPlugin.hxx"
 #include "plugins/SolarisOutputPlugin.hxx"
@@ -52,6 +54,9 @@ const AudioOutputPlugin *const audio_output_plugins[] = {
 #ifdef HAVE_FIFO
 	&fifo_output_plugin,
 #endif
+#ifdef ENABLE_SHM_OUTPUT
+	&shm_output_plugin,
+#endif
 #ifdef ENABLE_SNDIO
 	&sndio_output_plugin,
 #endif
@@ -79,6 +84,9 @@ const AudioOutputPlugin *const audio_output_plugins[] = {
 #ifdef ENABLE_SOLARIS_OUTPUT
 	&solaris_output_plugin,
 #endif
+#ifdef ENABLE_PIPEWIRE
+	&pipewire_output_plugin,
+#endif
 #ifdef ENABLE_PULSE
 	&pulse_output_plugin,
 #endif
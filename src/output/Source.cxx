@@ -25,12 +25,233 @@
 #include "pcm/PcmMix.hxx"
 #include "thread/Mutex.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/Trace.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <vector>
 
 #include <string.h>
 
+struct AudioOutputSource::ShareGroup {
+	/**
+	 * The maximum number of chunks kept for sources which lag
+	 * behind.  Sources which fall back further than this detach
+	 * from the group.
+	 */
+	static constexpr size_t MAX_ENTRIES = 256;
+
+	const std::string key;
+
+	/**
+	 * Protects all of the following attributes and the share_*
+	 * attributes of all members.
+	 */
+	Mutex mutex;
+
+	/**
+	 * All attached sources.  Modifications are also protected by
+	 * #registry_mutex.
+	 */
+	std::vector<AudioOutputSource *> members;
+
+	/**
+	 * The source whose filters are used by the group; nullptr if
+	 * all members are detached.
+	 */
+	AudioOutputSource *owner = nullptr;
+
+	struct Entry {
+		const MusicChunk *chunk;
+		const MusicChunk *other;
+		float mix_ratio;
+		unsigned replay_gain_serial, other_replay_gain_serial;
+		ReplayGainMode mode;
+
+		/**
+		 * A copy of the chunk's data (followed by the data
+		 * of the "other" chunk), because the chunk may be
+		 * freed and its address reused.
+		 */
+		AllocatedArray<uint8_t> input;
+
+		SharedBuffer output;
+
+		Entry(const MusicChunk &_chunk, ReplayGainMode _mode,
+		      ConstBuffer<void> _output) noexcept
+			:chunk(&_chunk), other(_chunk.other.get()),
+			 mix_ratio(_chunk.mix_ratio),
+			 replay_gain_serial(_chunk.replay_gain_serial),
+			 other_replay_gain_serial(other != nullptr
+						  ? other->replay_gain_serial
+						  : 0),
+			 mode(_mode),
+			 input(_chunk.length +
+			       (other != nullptr ? other->length : 0)),
+			 output(MakeBuffer(_output)) {
+			auto i = std::copy_n(_chunk.data, _chunk.length,
+					     input.begin());
+			if (other != nullptr)
+				std::copy_n(other->data, other->length, i);
+		}
+
+		gcc_pure
+		bool Matches(const MusicChunk &c,
+			     ReplayGainMode m) const noexcept {
+			const MusicChunk *o = c.other.get();
+			if (&c != chunk || o != other ||
+			    c.replay_gain_serial != replay_gain_serial ||
+			    m != mode)
+				return false;
+
+			const size_t other_length = o != nullptr
+				? o->length
+				: 0;
+			if (c.length + other_length != input.size())
+				return false;
+
+			if (o != nullptr &&
+			    (o->replay_gain_serial != other_replay_gain_serial ||
+			     c.mix_ratio != mix_ratio ||
+			     memcmp(o->data, input.begin() + c.length,
+				    o->length) != 0))
+				return false;
+
+			return memcmp(c.data, input.begin(), c.length) == 0;
+		}
+	};
+
+	/**
+	 * The most recent chunks of the stream and their filter
+	 * results.
+	 */
+	std::deque<Entry> entries;
+
+	/**
+	 * The sequence number of entries.front().
+	 */
+	uint64_t first_seq = 0;
+
+	/**
+	 * The results of flushing the owner's filters after the last
+	 * chunk; only valid if #flushed is true.
+	 */
+	std::vector<SharedBuffer> flush_results;
+	bool flushed = false;
+
+	explicit ShareGroup(const std::string &_key) noexcept
+		:key(_key) {}
+
+	static SharedBuffer MakeBuffer(ConstBuffer<void> src) noexcept {
+		auto b = std::make_shared<AllocatedArray<uint8_t>>(src.size);
+		std::copy_n((const uint8_t *)src.data, src.size, b->begin());
+		return b;
+	}
+
+	uint64_t GetNextSeq() const noexcept {
+		return first_seq + entries.size();
+	}
+
+	/**
+	 * Find the newest entry for the given chunk.
+	 *
+	 * @return the sequence number or GetNextSeq() if there is no
+	 * match
+	 */
+	gcc_pure
+	uint64_t Find(const MusicChunk &chunk,
+		      ReplayGainMode mode) const noexcept {
+		for (size_t i = entries.size(); i > 0; --i)
+			if (entries[i - 1].Matches(chunk, mode))
+				return first_seq + i - 1;
+
+		return GetNextSeq();
+	}
+
+	/**
+	 * Is any other member following the stream?  Members whose
+	 * position has vanished from the history (because they have
+	 * fallen behind or because the history has been discarded by
+	 * Restart()) don't count; they will have to find their
+	 * position again anyway.
+	 */
+	gcc_pure
+	bool IsFollowed(const AudioOutputSource *except) const noexcept {
+		for (const auto *m : members)
+			if (m != except &&
+			    m->share_state == ShareState::SYNCED &&
+			    m->share_position >= first_seq)
+				return true;
+
+		return false;
+	}
+
+	/**
+	 * Find a member which may take over the group's filters.
+	 */
+	gcc_pure
+	AudioOutputSource *FindOwner(const AudioOutputSource *except) const noexcept {
+		for (auto *m : members)
+			if (m != except &&
+			    (m->share_state == ShareState::SYNCED ||
+			     m->share_state == ShareState::UNSYNCED))
+				return m;
+
+		return nullptr;
+	}
+
+	/**
+	 * Start the stream over, resetting the owner's filters.
+	 */
+	void Restart() noexcept {
+		if (owner != nullptr)
+			owner->ResetFilter();
+
+		first_seq = GetNextSeq();
+		entries.clear();
+		flush_results.clear();
+		flushed = false;
+	}
+
+	void SetOwner(AudioOutputSource *_owner) noexcept {
+		owner = _owner;
+		Restart();
+	}
+
+	/**
+	 * Filter the next chunk of the stream with the owner's
+	 * filters.
+	 */
+	const Entry &Append(const MusicChunk &chunk, ReplayGainMode mode) {
+		assert(owner != nullptr);
+
+		entries.emplace_back(chunk, mode,
+				     owner->FilterChunk(chunk, mode));
+		flush_results.clear();
+		flushed = false;
+
+		if (entries.size() > MAX_ENTRIES) {
+			entries.pop_front();
+			++first_seq;
+		}
+
+		return entries.back();
+	}
+};
+
+static Mutex share_registry_mutex;
+static std::list<AudioOutputSource::ShareGroup> *share_registry;
+
 AudioOutputSource::AudioOutputSource() noexcept {}
-AudioOutputSource::~AudioOutputSource() noexcept = default;
+
+AudioOutputSource::~AudioOutputSource() noexcept
+{
+	assert(share_group == nullptr);
+}
 
 AudioFormat
 AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
@@ -40,6 +261,8 @@ AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
 {
 	assert(audio_format.IsValid());
 
+	Unshare();
+
 	if (!IsOpen() || &_pipe != &pipe.GetPipe()) {
 		current_chunk = nullptr;
 		pipe.Init(_pipe);
@@ -49,10 +272,11 @@ AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
 
 	if (filter && audio_format != in_audio_format)
 		/* the filter must be reopened on all input format
-		   changes */
-		CloseFilter();
+		   changes; keep the old one in case the previous
+		   format comes back */
+		StashFilter();
 
-	if (filter == nullptr)
+	if (filter == nullptr && !RestoreFilter(audio_format))
 		/* open the filter */
 		OpenFilter(audio_format,
 			   prepared_replay_gain_filter,
@@ -69,17 +293,42 @@ AudioOutputSource::Close() noexcept
 	assert(in_audio_format.IsValid());
 	in_audio_format.Clear();
 
+	Unshare();
 	Cancel();
 
 	CloseFilter();
+	filter_cache.clear();
 }
 
 void
 AudioOutputSource::Cancel() noexcept
 {
 	current_chunk = nullptr;
+	pending_buffer.reset();
 	pipe.Cancel();
 
+	if (share_group == nullptr) {
+		ResetFilter();
+		return;
+	}
+
+	ShareGroup &g = *share_group;
+	const std::lock_guard<Mutex> protect(g.mutex);
+
+	share_state = ShareState::UNSYNCED;
+
+	if (g.owner == nullptr)
+		g.SetOwner(this);
+	else if (g.owner != this)
+		ResetFilter();
+	else if (!g.IsFollowed(this))
+		g.Restart();
+	/* else: the others continue to use our filters */
+}
+
+void
+AudioOutputSource::ResetFilter() noexcept
+{
 	if (replay_gain_filter)
 		replay_gain_filter->Reset();
 
@@ -90,6 +339,94 @@ AudioOutputSource::Cancel() noexcept
 		filter->Reset();
 }
 
+void
+AudioOutputSource::Share(const std::string &key,
+			 AudioFormat out_audio_format) noexcept
+{
+	assert(IsOpen());
+	assert(filter);
+
+	Unshare();
+
+	if (key.empty())
+		return;
+
+	std::string full_key = key;
+	full_key += '\n';
+	full_key += ToString(in_audio_format).c_str();
+	full_key += '\n';
+	full_key += ToString(out_audio_format).c_str();
+
+	const std::lock_guard<Mutex> protect(share_registry_mutex);
+
+	if (share_registry == nullptr)
+		share_registry = new std::list<ShareGroup>();
+
+	auto i = std::find_if(share_registry->begin(), share_registry->end(),
+			      [&full_key](const ShareGroup &g){
+				      return g.key == full_key;
+			      });
+	if (i == share_registry->end()) {
+		share_registry->emplace_front(full_key);
+		i = share_registry->begin();
+	}
+
+	ShareGroup &g = *i;
+	const std::lock_guard<Mutex> protect_group(g.mutex);
+
+	share_group = &g;
+	share_state = ShareState::UNSYNCED;
+	g.members.push_back(this);
+
+	if (g.owner == nullptr)
+		g.SetOwner(this);
+}
+
+void
+AudioOutputSource::Unshare() noexcept
+{
+	if (share_group == nullptr)
+		return;
+
+	ShareGroup &g = *share_group;
+
+	const std::lock_guard<Mutex> protect(share_registry_mutex);
+
+	bool empty;
+
+	{
+		const std::lock_guard<Mutex> protect_group(g.mutex);
+
+		g.members.erase(std::find(g.members.begin(),
+					  g.members.end(), this));
+
+		if (g.owner == this)
+			/* somebody else has to lend filters to the
+			   group */
+			g.SetOwner(g.FindOwner(this));
+		else
+			/* our filters have been idle while we
+			   followed the group */
+			ResetFilter();
+
+		empty = g.members.empty();
+	}
+
+	if (empty) {
+		share_registry->remove_if([&g](const ShareGroup &i){
+				return &i == &g;
+			});
+
+		if (share_registry->empty()) {
+			delete share_registry;
+			share_registry = nullptr;
+		}
+	}
+
+	share_group = nullptr;
+	share_state = ShareState::PRIVATE;
+}
+
 void
 AudioOutputSource::OpenFilter(AudioFormat audio_format,
 			      PreparedFilter *prepared_replay_gain_filter,
@@ -125,8 +462,49 @@ AudioOutputSource::CloseFilter() noexcept
 	filter.reset();
 }
 
+void
+AudioOutputSource::StashFilter() noexcept
+{
+	assert(filter);
+
+	filter_cache.push_front(CachedFilter{in_audio_format,
+				std::move(replay_gain_filter),
+				std::move(other_replay_gain_filter),
+				std::move(filter)});
+
+	if (filter_cache.size() > MAX_CACHED_FILTERS)
+		filter_cache.pop_back();
+}
+
+bool
+AudioOutputSource::RestoreFilter(AudioFormat audio_format) noexcept
+{
+	assert(!filter);
+
+	auto i = std::find_if(filter_cache.begin(), filter_cache.end(),
+			      [audio_format](const CachedFilter &c){
+				      return c.in_audio_format == audio_format;
+			      });
+	if (i == filter_cache.end())
+		return false;
+
+	replay_gain_filter = std::move(i->replay_gain_filter);
+	other_replay_gain_filter = std::move(i->other_replay_gain_filter);
+	filter = std::move(i->filter);
+	filter_cache.erase(i);
+
+	/* discard state left from the last time these filters were
+	   used; this also makes their FilterObserver instances
+	   return them again */
+	replay_gain_serial = 0;
+	other_replay_gain_serial = 0;
+	ResetFilter();
+	return true;
+}
+
 ConstBuffer<void>
 AudioOutputSource::GetChunkData(const MusicChunk &chunk,
+				ReplayGainMode mode,
 				Filter *current_replay_gain_filter,
 				unsigned *replay_gain_serial_p)
 {
@@ -139,7 +517,7 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 
 	if (!data.empty() && current_replay_gain_filter != nullptr) {
 		replay_gain_filter_set_mode(*current_replay_gain_filter,
-					    replay_gain_mode);
+					    mode);
 
 		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
 			replay_gain_filter_set_info(*current_replay_gain_filter,
@@ -156,9 +534,11 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 }
 
 ConstBuffer<void>
-AudioOutputSource::FilterChunk(const MusicChunk &chunk)
+AudioOutputSource::FilterChunk(const MusicChunk &chunk, ReplayGainMode mode)
 {
-	auto data = GetChunkData(chunk, replay_gain_filter.get(),
+	const TraceSpan trace_span("output/filter_chunk");
+
+	auto data = GetChunkData(chunk, mode, replay_gain_filter.get(),
 				 &replay_gain_serial);
 	if (data.empty())
 		return data;
@@ -166,7 +546,7 @@ AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 	/* cross-fade */
 
 	if (chunk.other != nullptr) {
-		auto other_data = GetChunkData(*chunk.other,
+		auto other_data = GetChunkData(*chunk.other, mode,
 					       other_replay_gain_filter.get(),
 					       &other_replay_gain_serial);
 		if (other_data.empty())
@@ -203,9 +583,115 @@ AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 
 	/* apply filter chain */
 
+	if (data.data != chunk.data)
+		/* the data lives in a buffer owned by this object
+		   (the replay gain filter or the cross-fade buffer),
+		   and the filters may modify it in place; the
+		   MusicChunk, however, may be shared with other
+		   outputs */
+		return filter->FilterPrivatePCM({const_cast<void *>(data.data),
+						 data.size});
+
 	return filter->FilterPCM(data);
 }
 
+ConstBuffer<void>
+AudioOutputSource::FilterChunkShared(const MusicChunk &chunk)
+{
+	ShareGroup &g = *share_group;
+	const std::lock_guard<Mutex> protect(g.mutex);
+
+	share_flush_position = 0;
+
+	if (share_state == ShareState::SYNCED) {
+		assert(g.owner != nullptr);
+
+		if (share_position == g.GetNextSeq()) {
+			/* we're the first one to get here */
+			pending_buffer = g.Append(chunk, replay_gain_mode).output;
+			++share_position;
+			return {pending_buffer->begin(), pending_buffer->size()};
+		}
+
+		if (share_position >= g.first_seq &&
+		    g.entries[share_position - g.first_seq].Matches(chunk,
+								    replay_gain_mode)) {
+			/* reuse the result of another source */
+			pending_buffer =
+				g.entries[share_position++ - g.first_seq].output;
+			return {pending_buffer->begin(), pending_buffer->size()};
+		}
+
+		/* we have fallen too far behind, or our input
+		   differs */
+		share_state = ShareState::UNSYNCED;
+	}
+
+	assert(share_state == ShareState::UNSYNCED);
+
+	const uint64_t seq = g.Find(chunk, replay_gain_mode);
+	if (seq != g.GetNextSeq()) {
+		/* (re)join the stream */
+		share_state = ShareState::SYNCED;
+		share_position = seq + 1;
+
+		pending_buffer = g.entries[seq - g.first_seq].output;
+		return {pending_buffer->begin(), pending_buffer->size()};
+	}
+
+	if (!g.IsFollowed(this)) {
+		/* nobody else is using the group's filters; start a
+		   new stream */
+		assert(g.owner != nullptr);
+
+		g.Restart();
+
+		share_state = ShareState::SYNCED;
+		pending_buffer = g.Append(chunk, replay_gain_mode).output;
+		share_position = g.GetNextSeq();
+		return {pending_buffer->begin(), pending_buffer->size()};
+	}
+
+	/* the other sources are playing something else; don't
+	   disturb them */
+
+	if (g.owner == this)
+		g.SetOwner(g.FindOwner(this));
+
+	ResetFilter();
+	share_state = ShareState::DETACHED;
+	return nullptr;
+}
+
+ConstBuffer<void>
+AudioOutputSource::FlushShared()
+{
+	ShareGroup &g = *share_group;
+	const std::lock_guard<Mutex> protect(g.mutex);
+
+	if (!g.flushed) {
+		/* we're the first one to get here: drain the
+		   owner's filters */
+		assert(g.owner != nullptr);
+
+		while (true) {
+			auto result = g.owner->filter->Flush();
+			if (result.IsNull())
+				break;
+
+			g.flush_results.emplace_back(ShareGroup::MakeBuffer(result));
+		}
+
+		g.flushed = true;
+	}
+
+	if (share_flush_position >= g.flush_results.size())
+		return nullptr;
+
+	pending_buffer = g.flush_results[share_flush_position++];
+	return {pending_buffer->begin(), pending_buffer->size()};
+}
+
 bool
 AudioOutputSource::Fill(Mutex &mutex)
 {
@@ -222,17 +708,33 @@ AudioOutputSource::Fill(Mutex &mutex)
 
 	pending_tag = current_chunk->tag.get();
 
+	const auto fill_time = std::chrono::steady_clock::now();
+	queue_latency.Add(fill_time - current_chunk->play_time);
+
 	try {
 		/* release the mutex while the filter runs, because
 		   that may take a while */
 		const ScopeUnlock unlock(mutex);
 
-		pending_data = pending_data.FromVoid(FilterChunk(*current_chunk));
+		ConstBuffer<void> data = nullptr;
+		if (share_state == ShareState::SYNCED ||
+		    share_state == ShareState::UNSYNCED)
+			data = FilterChunkShared(*current_chunk);
+
+		if (share_state == ShareState::PRIVATE ||
+		    share_state == ShareState::DETACHED) {
+			pending_buffer.reset();
+			data = FilterChunk(*current_chunk, replay_gain_mode);
+		}
+
+		pending_data = pending_data.FromVoid(data);
 	} catch (...) {
 		current_chunk = nullptr;
 		throw;
 	}
 
+	filter_latency.Add(std::chrono::steady_clock::now() - fill_time);
+
 	return true;
 }
 
@@ -248,6 +750,18 @@ AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 ConstBuffer<void>
 AudioOutputSource::Flush()
 {
+	switch (share_state) {
+	case ShareState::PRIVATE:
+	case ShareState::DETACHED:
+		break;
+
+	case ShareState::SYNCED:
+		return FlushShared();
+
+	case ShareState::UNSYNCED:
+		return nullptr;
+	}
+
 	return filter
 		? filter->Flush()
 		: nullptr;
@@ -22,14 +22,18 @@
 
 #include "util/Compiler.h"
 #include "SharedPipeConsumer.hxx"
+#include "LatencyHistogram.hxx"
 #include "AudioFormat.hxx"
 #include "ReplayGainMode.hxx"
 #include "pcm/PcmBuffer.hxx"
 #include "pcm/PcmDither.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/AllocatedArray.hxx"
 
 #include <utility>
 #include <memory>
+#include <string>
+#include <list>
 
 #include <assert.h>
 #include <stdint.h>
@@ -45,8 +49,52 @@ class PreparedFilter;
  * #MusicChunk instances from a #MusicPipe (via #SharedPipeConsumer).
  * It applies configured filters, ReplayGain and returns plain PCM
  * data.
+ *
+ * Sources with the same sharing key (see Share()) run their filters
+ * only once: one of them (the "owner") lends its filters to the
+ * group, and the others reuse the results, as long as they receive
+ * the same chunks.  A source which gets out of step falls back to
+ * its own filters.
  */
 class AudioOutputSource {
+public:
+	/**
+	 * The shared state of all sources with the same sharing key.
+	 */
+	struct ShareGroup;
+
+	/**
+	 * An immutable filter result which may be referenced by
+	 * several sources.
+	 */
+	typedef std::shared_ptr<const AllocatedArray<uint8_t>> SharedBuffer;
+
+private:
+	enum class ShareState : uint8_t {
+		/**
+		 * Not sharing; #filter is used.
+		 */
+		PRIVATE,
+
+		/**
+		 * Following the group's stream at #share_position.
+		 */
+		SYNCED,
+
+		/**
+		 * Attached to the group, but the position in its
+		 * stream is unknown (after Share() or Cancel()).  The
+		 * next chunk determines it.
+		 */
+		UNSYNCED,
+
+		/**
+		 * The input differs from the group's stream; #filter
+		 * is used until the next Cancel().
+		 */
+		DETACHED,
+	};
+
 	/**
 	 * The audio_format in which audio data is received from the
 	 * player thread (which in turn receives it from the decoder).
@@ -101,6 +149,27 @@ class AudioOutputSource {
 	 */
 	std::unique_ptr<Filter> filter;
 
+	/**
+	 * Filters which were opened for an earlier input format.
+	 */
+	struct CachedFilter {
+		AudioFormat in_audio_format;
+
+		std::unique_ptr<Filter> replay_gain_filter;
+		std::unique_ptr<Filter> other_replay_gain_filter;
+		std::unique_ptr<Filter> filter;
+	};
+
+	static constexpr size_t MAX_CACHED_FILTERS = 3;
+
+	/**
+	 * Filters of previous input formats, most recently used
+	 * first.  Switching back to one of these formats (e.g. in
+	 * playlists mixing 44.1 kHz and 48 kHz songs) reuses them
+	 * instead of opening new ones.
+	 */
+	std::list<CachedFilter> filter_cache;
+
 	/**
 	 * The #MusicChunk currently being processed (see
 	 * #pending_tag, #pending_data).
@@ -118,6 +187,40 @@ class AudioOutputSource {
 	 */
 	ConstBuffer<uint8_t> pending_data;
 
+	/**
+	 * The shared buffer which contains #pending_data (or the last
+	 * Flush() result); nullptr if it is owned by #filter.
+	 */
+	SharedBuffer pending_buffer;
+
+	ShareGroup *share_group = nullptr;
+
+	ShareState share_state = ShareState::PRIVATE;
+
+	/**
+	 * The sequence number of the next chunk in the group's
+	 * stream.
+	 */
+	uint64_t share_position;
+
+	/**
+	 * The number of shared Flush() results returned since the
+	 * last chunk.
+	 */
+	size_t share_flush_position;
+
+	/**
+	 * How long did chunks wait between the player thread and
+	 * Fill()?  Protected by the mutex passed to Fill().
+	 */
+	LatencyHistogram queue_latency;
+
+	/**
+	 * How long did the filter take for each chunk?  Protected by
+	 * the mutex passed to Fill().
+	 */
+	LatencyHistogram filter_latency;
+
 public:
 	AudioOutputSource() noexcept;
 	~AudioOutputSource() noexcept;
@@ -130,6 +233,14 @@ public:
 		return in_audio_format.IsDefined();
 	}
 
+	const LatencyHistogram &GetQueueLatency() const noexcept {
+		return queue_latency;
+	}
+
+	const LatencyHistogram &GetFilterLatency() const noexcept {
+		return filter_latency;
+	}
+
 	const AudioFormat &GetInputAudioFormat() const {
 		assert(IsOpen());
 
@@ -144,6 +255,18 @@ public:
 	void Close() noexcept;
 	void Cancel() noexcept;
 
+	/**
+	 * Share the filter results with all other sources which have
+	 * the same key and the same input and output audio format.
+	 * This must be called after Open() (which ends sharing) once
+	 * the output audio format is known.
+	 *
+	 * @param key describes the filter configuration; an empty
+	 * string disables sharing
+	 */
+	void Share(const std::string &key,
+		   AudioFormat out_audio_format) noexcept;
+
 	/**
 	 * Ensure that ReadTag() or PeekData() return any input.
 	 *
@@ -207,11 +330,42 @@ private:
 
 	void CloseFilter() noexcept;
 
+	/**
+	 * Move the open filters to #filter_cache.
+	 */
+	void StashFilter() noexcept;
+
+	/**
+	 * Take filters for the given input format from
+	 * #filter_cache.
+	 *
+	 * @return false if there are none
+	 */
+	bool RestoreFilter(AudioFormat audio_format) noexcept;
+
+	void ResetFilter() noexcept;
+
 	ConstBuffer<void> GetChunkData(const MusicChunk &chunk,
+				       ReplayGainMode mode,
 				       Filter *replay_gain_filter,
 				       unsigned *replay_gain_serial_p);
 
-	ConstBuffer<void> FilterChunk(const MusicChunk &chunk);
+	ConstBuffer<void> FilterChunk(const MusicChunk &chunk,
+				      ReplayGainMode mode);
+
+	/**
+	 * Leave the #ShareGroup.
+	 */
+	void Unshare() noexcept;
+
+	/**
+	 * Obtain the filtered chunk from the #ShareGroup.  Sets
+	 * #share_state to ShareState::DETACHED if that is not
+	 * possible.
+	 */
+	ConstBuffer<void> FilterChunkShared(const MusicChunk &chunk);
+
+	ConstBuffer<void> FlushShared();
 };
 
 #endif
@@ -42,6 +42,11 @@ audio_output_state_save(BufferedOutputStream &os,
 {
 	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
 		const auto &ao = outputs.Get(i);
+		if (ao.IsDummy())
+			/* the device has been moved to another
+			   partition */
+			continue;
+
 		const std::lock_guard<Mutex> lock(ao.mutex);
 
 		os.Format(AUDIO_DEVICE_STATE "%d:%s\n",
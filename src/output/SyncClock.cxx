@@ -0,0 +1,77 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "SyncClock.hxx"
+
+#include <algorithm>
+
+constexpr OutputSyncClock::Clock::duration OutputSyncClock::TOLERANCE;
+constexpr OutputSyncClock::Clock::duration OutputSyncClock::MAX_STEP;
+constexpr OutputSyncClock::Clock::duration OutputSyncClock::WARMUP;
+constexpr OutputSyncClock::Clock::duration OutputSyncClock::INTERVAL;
+
+inline OutputSyncClock::Clock::duration
+OutputSyncClock::FramesToDuration(uint64_t n) const noexcept
+{
+	/* split into seconds and remainder to avoid overflow */
+	const std::chrono::seconds s(n / sample_rate);
+	const std::chrono::nanoseconds ns((n % sample_rate) * 1000000000ULL
+					  / sample_rate);
+	return std::chrono::duration_cast<Clock::duration>(s + ns);
+}
+
+inline int64_t
+OutputSyncClock::DurationToFrames(Clock::duration d) const noexcept
+{
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+	return int64_t(ns) * int64_t(sample_rate) / 1000000000LL;
+}
+
+int64_t
+OutputSyncClock::Check(Clock::time_point now) noexcept
+{
+	if (!IsActive())
+		return 0;
+
+	const auto elapsed = now - start;
+	const auto offset = FramesToDuration(frames) - elapsed;
+
+	if (!have_baseline) {
+		if (elapsed < WARMUP)
+			return 0;
+
+		baseline = offset;
+		have_baseline = true;
+		last_correction = now;
+		return 0;
+	}
+
+	if (now - last_correction < INTERVAL)
+		return 0;
+
+	/* positive: the device consumes faster than the clock */
+	auto error = offset - baseline;
+	if (error > -TOLERANCE && error < TOLERANCE)
+		return 0;
+
+	error = std::min(std::max(error, -MAX_STEP), MAX_STEP);
+	last_correction = now;
+	return DurationToFrames(error);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_SYNC_CLOCK_HXX
+#define MPD_OUTPUT_SYNC_CLOCK_HXX
+
+#include <chrono>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compares the number of frames consumed by an output with the
+ * monotonic system clock ("sync" setting).  Devices whose clock
+ * drifts are kept aligned by inserting silence or dropping frames,
+ * so several devices playing the same #MusicPipe stay in sync.
+ *
+ * After Reset(), the difference between the position and the clock
+ * is measured once the device buffer has filled ("baseline"); later
+ * deviations from this baseline are corrected in small steps.
+ *
+ * This object is not thread-safe; it is only used by the output
+ * thread.
+ */
+class OutputSyncClock {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+private:
+	/**
+	 * Smaller deviations are not corrected.
+	 */
+	static constexpr Clock::duration TOLERANCE =
+		std::chrono::milliseconds(5);
+
+	/**
+	 * The largest correction applied at once.
+	 */
+	static constexpr Clock::duration MAX_STEP =
+		std::chrono::milliseconds(10);
+
+	/**
+	 * After Reset(), wait this long for the device buffer to fill
+	 * before the baseline is taken.
+	 */
+	static constexpr Clock::duration WARMUP = std::chrono::seconds(1);
+
+	/**
+	 * The minimum duration between two corrections, which gives
+	 * the device time to absorb a correction.
+	 */
+	static constexpr Clock::duration INTERVAL = std::chrono::seconds(1);
+
+	Clock::time_point start, last_correction;
+
+	Clock::duration baseline;
+
+	/**
+	 * The number of frames consumed (played or dropped) since
+	 * Reset().
+	 */
+	uint64_t frames;
+
+	/**
+	 * The sample rate of the device; 0 if this object is
+	 * inactive.
+	 */
+	unsigned sample_rate = 0;
+
+	bool have_baseline;
+
+public:
+	bool IsActive() const noexcept {
+		return sample_rate > 0;
+	}
+
+	/**
+	 * Start a new timeline, e.g. after the device has been opened
+	 * or resumed.
+	 */
+	void Reset(unsigned _sample_rate, Clock::time_point now) noexcept {
+		start = now;
+		frames = 0;
+		sample_rate = _sample_rate;
+		have_baseline = false;
+	}
+
+	/**
+	 * Deactivate this object; the next Reset() call starts a new
+	 * timeline.
+	 */
+	void Clear() noexcept {
+		sample_rate = 0;
+	}
+
+	/**
+	 * Frames have been consumed from the source.
+	 */
+	void Add(size_t n) noexcept {
+		frames += n;
+	}
+
+	/**
+	 * Determine whether the device needs to be corrected now.
+	 *
+	 * @return the number of frames of silence to be inserted
+	 * (positive), or the number of frames to be dropped
+	 * (negative)
+	 */
+	int64_t Check(Clock::time_point now) noexcept;
+
+private:
+	Clock::duration FramesToDuration(uint64_t n) const noexcept;
+	int64_t DurationToFrames(Clock::duration d) const noexcept;
+};
+
+#endif
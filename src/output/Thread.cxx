@@ -22,13 +22,15 @@
 #include "Client.hxx"
 #include "Domain.hxx"
 #include "mixer/MixerInternal.hxx"
-#include "thread/Util.hxx"
-#include "thread/Slack.hxx"
 #include "thread/Name.hxx"
+#include "system/Clock.hxx"
 #include "util/StringBuffer.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/RuntimeError.hxx"
 #include "Log.hxx"
+#include "util/Trace.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 #include <string.h>
@@ -42,6 +44,21 @@ AudioOutputControl::CommandFinished() noexcept
 	client_cond.signal();
 }
 
+inline bool
+AudioOutputControl::KeepDeviceFormat() noexcept
+{
+	try {
+		output->ConfigureConvertFilter();
+		return true;
+	} catch (...) {
+		/* the converter doesn't support this combination
+		   (e.g. PCM to DSD); fall back to reopening the
+		   device */
+		LogError(std::current_exception());
+		return false;
+	}
+}
+
 inline void
 AudioOutputControl::InternalOpen2(const AudioFormat in_audio_format)
 {
@@ -49,23 +66,25 @@ AudioOutputControl::InternalOpen2(const AudioFormat in_audio_format)
 
 	const auto cf = in_audio_format.WithMask(output->config_audio_format);
 
-	if (open && cf != output->filter_audio_format)
+	if (open && cf != output->filter_audio_format &&
+	    !(keep_device_format && KeepDeviceFormat()))
 		/* if the filter's output format changes, the output
 		   must be reopened as well */
 		InternalCloseOutput(true);
 
-	output->filter_audio_format = cf;
-
 	if (!open) {
+		output->filter_audio_format = cf;
+
 		{
 			const ScopeUnlock unlock(mutex);
 			output->OpenOutputAndConvert(output->filter_audio_format);
 		}
 
 		open = true;
-	} else if (in_audio_format != output->out_audio_format) {
+	} else {
 		/* reconfigure the final ConvertFilter for its new
-		   input AudioFormat */
+		   input AudioFormat; this is a no-op if neither
+		   format has changed */
 
 		try {
 			output->ConfigureConvertFilter();
@@ -129,6 +148,8 @@ inline void
 AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 				 const MusicPipe &pipe) noexcept
 {
+	const TraceSpan trace_span("output/open");
+
 	/* enable the device (just in case the last enable has failed) */
 	if (!InternalEnable())
 		return;
@@ -136,6 +157,7 @@ AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 	last_error = nullptr;
 	fail_timer.Reset();
 	skip_delay = true;
+	sync_clock.Clear();
 
 	AudioFormat f;
 
@@ -156,6 +178,8 @@ AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 			source.Close();
 			throw;
 		}
+
+		source.Share(output->share_key, output->out_audio_format);
 	} catch (...) {
 		LogError(std::current_exception());
 		Failure(std::current_exception());
@@ -236,6 +260,8 @@ try {
 inline bool
 AudioOutputControl::PlayChunk() noexcept
 {
+	const TraceSpan trace_span("output/play_chunk");
+
 	// ensure pending tags are flushed in all cases
 	const auto *tag = source.ReadTag();
 	if (tags && tag != nullptr) {
@@ -250,7 +276,7 @@ AudioOutputControl::PlayChunk() noexcept
 	}
 
 	while (command == Command::NONE) {
-		const auto data = source.PeekData();
+		auto data = source.PeekData();
 		if (data.empty())
 			break;
 
@@ -259,8 +285,21 @@ AudioOutputControl::PlayChunk() noexcept
 		else if (!WaitForDelay())
 			break;
 
+		if (sync) {
+			if (!SyncToClock())
+				return false;
+
+			/* frames may have been dropped */
+			data = source.PeekData();
+			if (data.empty())
+				break;
+		}
+
 		size_t nbytes;
 
+		const auto play_start = std::chrono::steady_clock::now();
+		const auto cpu_start = GetThreadCPUTime();
+
 		try {
 			const ScopeUnlock unlock(mutex);
 			nbytes = output->Play(data.data, data.size);
@@ -275,7 +314,61 @@ AudioOutputControl::PlayChunk() noexcept
 
 		assert(nbytes % output->out_audio_format.GetFrameSize() == 0);
 
+		play_latency.Add(std::chrono::steady_clock::now() - play_start);
+		play_cpu_time += GetThreadCPUTime() - cpu_start;
+
 		source.ConsumeData(nbytes);
+
+		if (sync)
+			sync_clock.Add(nbytes / output->out_audio_format.GetFrameSize());
+	}
+
+	return true;
+}
+
+bool
+AudioOutputControl::SyncToClock() noexcept
+{
+	const auto now = OutputSyncClock::Clock::now();
+	const AudioFormat &af = output->out_audio_format;
+
+	if (!sync_clock.IsActive()) {
+		sync_clock.Reset(af.sample_rate, now);
+		return true;
+	}
+
+	const int64_t correction = sync_clock.Check(now);
+	const size_t frame_size = af.GetFrameSize();
+
+	if (correction < 0) {
+		/* the device consumes slower than the clock: drop
+		   some frames to catch up */
+		const auto data = source.PeekData();
+		size_t nbytes = std::min<size_t>(size_t(-correction) * frame_size,
+						 data.size);
+		nbytes -= nbytes % frame_size;
+
+		source.ConsumeData(nbytes);
+		sync_clock.Add(nbytes / frame_size);
+	} else if (correction > 0 && af.format != SampleFormat::DSD) {
+		/* the device consumes faster than the clock: play
+		   silence to let the clock catch up */
+		static constexpr uint8_t silence[4096] = {};
+		const size_t max_size = sizeof(silence) / frame_size * frame_size;
+
+		size_t remaining = size_t(correction) * frame_size;
+		while (remaining > 0) {
+			try {
+				const ScopeUnlock unlock(mutex);
+				remaining -= output->Play(silence,
+							  std::min(remaining, max_size));
+			} catch (...) {
+				FormatError(std::current_exception(),
+					    "Failed to play on %s", GetLogName());
+				InternalCloseError(std::current_exception());
+				return false;
+			}
+		}
 	}
 
 	return true;
@@ -357,6 +450,7 @@ AudioOutputControl::InternalPause() noexcept
 	}
 
 	skip_delay = true;
+	sync_clock.Clear();
 }
 
 static void
@@ -403,14 +497,7 @@ AudioOutputControl::Task() noexcept
 {
 	FormatThreadName("output:%s", GetName());
 
-	try {
-		SetThreadRealtime();
-	} catch (...) {
-		LogError(std::current_exception(),
-			 "OutputThread could not get realtime scheduling, continuing anyway");
-	}
-
-	SetThreadTimerSlackUS(100);
+	thread_config.Apply(GetLogName());
 
 	const std::lock_guard<Mutex> lock(mutex);
 
@@ -493,6 +580,7 @@ AudioOutputControl::Task() noexcept
 
 		case Command::CANCEL:
 			source.Cancel();
+			sync_clock.Clear();
 
 			if (open) {
 				const ScopeUnlock unlock(mutex);
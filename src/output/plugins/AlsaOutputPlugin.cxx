@@ -44,6 +44,8 @@
 
 #include <boost/lockfree/spsc_queue.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <forward_list>
 
@@ -51,6 +53,11 @@ static const char default_device[] = "default";
 
 static constexpr unsigned MPD_ALSA_BUFFER_TIME_US = 500000;
 
+/**
+ * The initial buffer_time in "low_latency" mode.
+ */
+static constexpr unsigned MPD_ALSA_LOW_LATENCY_BUFFER_TIME_US = 20000;
+
 class AlsaOutput final
 	: AudioOutput, MultiSocketMonitor {
 
@@ -79,6 +86,28 @@ class AlsaOutput final
 	/** libasound's period_time setting (in microseconds) */
 	const unsigned period_time;
 
+	/**
+	 * The buffer_time (in microseconds) used in "low_latency"
+	 * mode; 0 if that mode is disabled.  It starts small and is
+	 * doubled after each underrun (up to #buffer_time), taking
+	 * effect when the device is opened the next time.
+	 *
+	 * Modified by Recover() while the device is open and read
+	 * by Setup() while it is closed, so this needs no lock.
+	 */
+	unsigned low_latency_buffer_time = 0;
+
+	/**
+	 * Attempt to use mmap access (the "mmap" setting)?
+	 */
+	const bool mmap_setting;
+
+	/**
+	 * Keep period wakeups enabled (the "period_wakeup" setting)?
+	 * If disabled, a timer feeds the device.
+	 */
+	const bool period_wakeup_setting;
+
 	/** the mode flags passed to snd_pcm_open */
 	int mode = 0;
 
@@ -116,6 +145,26 @@ class AlsaOutput final
 	 */
 	snd_pcm_sframes_t max_avail_frames;
 
+	/**
+	 * The start threshold configured with snd_pcm_sw_params();
+	 * needed to start the PCM explicitly after
+	 * snd_pcm_mmap_commit().
+	 */
+	snd_pcm_uframes_t start_threshold;
+
+	/**
+	 * The interval of the timer which replaces period wakeups;
+	 * negative if period wakeups are enabled.
+	 */
+	std::chrono::steady_clock::duration wakeup_interval;
+
+	/**
+	 * Was mmap access configured?  Then whole periods are copied
+	 * from #ring_buffer straight into the hardware buffer (see
+	 * CopyRingToMmap()).
+	 */
+	bool use_mmap;
+
 	/**
 	 * Is this a buggy alsa-lib version, which needs a workaround
 	 * for the snd_pcm_drain() bug always returning -EAGAIN?  See
@@ -182,11 +231,27 @@ class AlsaOutput final
 
 	/**
 	 * Used to wait when #ring_buffer is full.  It will be
-	 * signalled each time data is popped from the #ring_buffer,
-	 * making space for more data.
+	 * signalled when data is popped from the #ring_buffer while
+	 * #waiting_for_space is set.
 	 */
 	Cond cond;
 
+	/**
+	 * Is the OutputThread blocked in Play(), waiting for room in
+	 * #ring_buffer?  Only then does the IOThread need to lock
+	 * #mutex and signal #cond after popping data (see
+	 * WakeOutputThread()).  Modified by the OutputThread while
+	 * holding #mutex.
+	 */
+	std::atomic_bool waiting_for_space{false};
+
+	/**
+	 * Counters which make the cost of the handoff between the
+	 * OutputThread and the IOThread visible; reported as
+	 * read-only attributes.
+	 */
+	std::atomic<uint64_t> n_dispatches{0}, n_waits{0}, n_wakeups{0};
+
 	std::exception_ptr error;
 
 public:
@@ -212,6 +277,7 @@ public:
 private:
 	const std::map<std::string, std::string> GetAttributes() const noexcept override;
 	void SetAttribute(std::string &&name, std::string &&value) override;
+	void SetLowLatency() noexcept override;
 
 	void Enable() override;
 	void Disable() noexcept override;
@@ -302,19 +368,48 @@ private:
 
 		period_buffer.AppendBytes(nbytes);
 
+		WakeOutputThread();
+		return true;
+	}
+
+	/**
+	 * Notify the OutputThread that there is now room in
+	 * #ring_buffer, but only if it is waiting for that.  To be
+	 * called by the IOThread after popping data.
+	 */
+	void WakeOutputThread() noexcept {
+		/* pairs with the fence in Play(): either Play() sees
+		   the room we just made, or we see its flag */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!waiting_for_space.load(std::memory_order_relaxed))
+			return;
+
+		++n_wakeups;
+
 		const std::lock_guard<Mutex> lock(mutex);
-		/* notify the OutputThread that there is now
-		   room in ring_buffer */
 		cond.signal();
-
-		return true;
 	}
 
+	/**
+	 * Copy whole periods from #ring_buffer directly into the
+	 * mmap()ed hardware buffer, bypassing #period_buffer and
+	 * libasound's copy.  Only valid if #use_mmap is set and
+	 * #period_buffer is empty at a period boundary.
+	 *
+	 * @return the number of frames written (0 if less than one
+	 * period is available) or a negative error code
+	 */
+	snd_pcm_sframes_t CopyRingToMmap() noexcept;
+
 	snd_pcm_sframes_t WriteFromPeriodBuffer() noexcept {
 		assert(!period_buffer.IsEmpty());
 
-		auto frames_written = snd_pcm_writei(pcm, period_buffer.GetHead(),
-						     period_buffer.GetFrames(out_frame_size));
+		const auto frames = period_buffer.GetFrames(out_frame_size);
+		auto frames_written = use_mmap
+			? snd_pcm_mmap_writei(pcm, period_buffer.GetHead(),
+					      frames)
+			: snd_pcm_writei(pcm, period_buffer.GetHead(),
+					 frames);
 		if (frames_written > 0) {
 			written = true;
 			period_buffer.ConsumeFrames(frames_written,
@@ -352,7 +447,9 @@ AlsaOutput::AlsaOutput(EventLoop &_loop, const ConfigBlock &block)
 #endif
 	 buffer_time(block.GetPositiveValue("buffer_time",
 					    MPD_ALSA_BUFFER_TIME_US)),
-	 period_time(block.GetPositiveValue("period_time", 0u))
+	 period_time(block.GetPositiveValue("period_time", 0u)),
+	 mmap_setting(block.GetBlockValue("mmap", false)),
+	 period_wakeup_setting(block.GetBlockValue("period_wakeup", true))
 {
 #ifdef SND_PCM_NO_AUTO_RESAMPLE
 	if (!block.GetBlockValue("auto_resample", true))
@@ -386,6 +483,12 @@ AlsaOutput::GetAttributes() const noexcept
 #ifdef ENABLE_DSD
 		std::make_pair("dop", dop_setting ? "1" : "0"),
 #endif
+		std::make_pair("dispatches",
+			       std::to_string(n_dispatches.load(std::memory_order_relaxed))),
+		std::make_pair("waits",
+			       std::to_string(n_waits.load(std::memory_order_relaxed))),
+		std::make_pair("wakeups",
+			       std::to_string(n_wakeups.load(std::memory_order_relaxed))),
 	};
 }
 
@@ -409,6 +512,13 @@ AlsaOutput::SetAttribute(std::string &&name, std::string &&value)
 		AudioOutput::SetAttribute(std::move(name), std::move(value));
 }
 
+void
+AlsaOutput::SetLowLatency() noexcept
+{
+	low_latency_buffer_time = std::min(MPD_ALSA_LOW_LATENCY_BUFFER_TIME_US,
+					   buffer_time);
+}
+
 void
 AlsaOutput::Enable()
 {
@@ -476,7 +586,12 @@ AlsaOutput::Setup(AudioFormat &audio_format,
 		  PcmExport::Params &params)
 {
 	const auto hw_result = Alsa::SetupHw(pcm,
-					     buffer_time, period_time,
+					     low_latency_buffer_time > 0
+					     ? low_latency_buffer_time
+					     : buffer_time,
+					     period_time,
+					     mmap_setting,
+					     period_wakeup_setting,
 					     audio_format, params);
 
 	FormatDebug(alsa_output_domain, "format=%s (%s)",
@@ -487,8 +602,10 @@ AlsaOutput::Setup(AudioFormat &audio_format,
 		    (unsigned)hw_result.buffer_size,
 		    (unsigned)hw_result.period_size);
 
-	AlsaSetupSw(pcm, hw_result.buffer_size - hw_result.period_size,
-		    hw_result.period_size);
+	start_threshold = hw_result.buffer_size - hw_result.period_size;
+	AlsaSetupSw(pcm, start_threshold, hw_result.period_size);
+
+	use_mmap = hw_result.mmap;
 
 	auto alsa_period_size = hw_result.period_size;
 	if (alsa_period_size == 0)
@@ -505,6 +622,17 @@ AlsaOutput::Setup(AudioFormat &audio_format,
 	   in the ALSA-PCM buffer */
 	max_avail_frames = hw_result.buffer_size - hw_result.period_size;
 
+	if (hw_result.period_wakeup || hw_result.rate == 0)
+		wakeup_interval = std::chrono::steady_clock::duration(-1);
+	else {
+		/* without period interrupts, poll the device once per
+		   period */
+		const std::chrono::microseconds period_duration(uint64_t(alsa_period_size) * 1000000u / hw_result.rate);
+		wakeup_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period_duration);
+		FormatDebug(alsa_output_domain,
+			    "period wakeups disabled");
+	}
+
 	silence = new uint8_t[snd_pcm_frames_to_bytes(pcm, alsa_period_size)];
 	snd_pcm_format_set_silence(hw_result.format, silence,
 				   alsa_period_size * audio_format.channels);
@@ -680,6 +808,7 @@ AlsaOutput::Open(AudioFormat &audio_format)
 
 	size_t period_size = period_frames * out_frame_size;
 	ring_buffer = new boost::lockfree::spsc_queue<uint8_t>(period_size * 4);
+	waiting_for_space = false;
 
 	period_buffer.Allocate(period_frames, out_frame_size);
 
@@ -689,6 +818,65 @@ AlsaOutput::Open(AudioFormat &audio_format)
 	error = {};
 }
 
+snd_pcm_sframes_t
+AlsaOutput::CopyRingToMmap() noexcept
+{
+	assert(use_mmap);
+	assert(period_buffer.IsEmpty());
+
+	const snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		return avail;
+
+	snd_pcm_uframes_t frames =
+		std::min<snd_pcm_uframes_t>(avail,
+					    ring_buffer->read_available() / out_frame_size);
+	frames -= frames % period_frames;
+	if (frames == 0)
+		return 0;
+
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset;
+	int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+	if (err < 0)
+		return err;
+
+	/* the contiguous area may end before the next period
+	   boundary if the buffer size is not a multiple of the
+	   period size */
+	frames -= frames % period_frames;
+
+	if (frames > 0) {
+		/* with interleaved access, all channels share one
+		   area */
+		auto *dest = (uint8_t *)areas[0].addr +
+			(areas[0].first + offset * areas[0].step) / 8;
+		ring_buffer->pop(dest, frames * out_frame_size);
+	}
+
+	const auto committed = snd_pcm_mmap_commit(pcm, offset, frames);
+	if (committed <= 0)
+		return committed;
+
+	written = true;
+
+	WakeOutputThread();
+
+	/* unlike snd_pcm_writei(), snd_pcm_mmap_commit() does not
+	   start the PCM automatically */
+	if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED) {
+		const snd_pcm_sframes_t new_avail = snd_pcm_avail_update(pcm);
+		if (new_avail >= 0 &&
+		    snd_pcm_uframes_t(max_avail_frames + period_frames - new_avail) >= start_threshold) {
+			err = snd_pcm_start(pcm);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	return committed;
+}
+
 inline int
 AlsaOutput::Recover(int err) noexcept
 {
@@ -696,6 +884,16 @@ AlsaOutput::Recover(int err) noexcept
 		FormatDebug(alsa_output_domain,
 			    "Underrun on ALSA device \"%s\"",
 			    GetDevice());
+
+		if (low_latency_buffer_time > 0 &&
+		    low_latency_buffer_time < buffer_time) {
+			low_latency_buffer_time =
+				std::min(low_latency_buffer_time * 2,
+					 buffer_time);
+			FormatDebug(alsa_output_domain,
+				    "buffer_time=%u will be used after reopening",
+				    low_latency_buffer_time);
+		}
 	} else if (err == -ESTRPIPE) {
 		FormatDebug(alsa_output_domain,
 			    "ALSA device \"%s\" was suspended",
@@ -882,14 +1080,23 @@ AlsaOutput::Play(const void *chunk, size_t size)
 		   been played */
 		return size;
 
+	/* fast path: as long as there is room in the ring_buffer,
+	   the handoff is lock-free; errors are detected as soon as the
+	   ring_buffer runs full, because the IOThread stops consuming
+	   after an error */
+	size_t bytes_written = ring_buffer->push((const uint8_t *)e.data,
+						 e.size);
+	if (bytes_written > 0)
+		return pcm_export->CalcSourceSize(bytes_written);
+
 	const std::lock_guard<Mutex> lock(mutex);
 
 	while (true) {
 		if (error)
 			std::rethrow_exception(error);
 
-		size_t bytes_written = ring_buffer->push((const uint8_t *)e.data,
-							 e.size);
+		bytes_written = ring_buffer->push((const uint8_t *)e.data,
+						  e.size);
 		if (bytes_written > 0)
 			return pcm_export->CalcSourceSize(bytes_written);
 
@@ -903,9 +1110,26 @@ AlsaOutput::Play(const void *chunk, size_t size)
 			   status */
 			continue;
 
+		/* announce that we're going to wait, and check again
+		   after that: this pairs with the fence in
+		   WakeOutputThread() */
+		waiting_for_space.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		bytes_written = ring_buffer->push((const uint8_t *)e.data,
+						  e.size);
+		if (bytes_written > 0) {
+			waiting_for_space.store(false,
+						std::memory_order_relaxed);
+			return pcm_export->CalcSourceSize(bytes_written);
+		}
+
+		++n_waits;
+
 		/* wait for the DispatchSockets() to make room in the
 		   ring_buffer */
 		cond.wait(mutex);
+		waiting_for_space.store(false, std::memory_order_relaxed);
 	}
 }
 
@@ -918,7 +1142,10 @@ AlsaOutput::PrepareSockets() noexcept
 	}
 
 	try {
-		return non_block.PrepareSockets(*this, pcm);
+		const auto timeout = non_block.PrepareSockets(*this, pcm);
+		return wakeup_interval >= wakeup_interval.zero()
+			? wakeup_interval
+			: timeout;
 	} catch (...) {
 		ClearSocketList();
 		LockCaughtError();
@@ -929,6 +1156,8 @@ AlsaOutput::PrepareSockets() noexcept
 void
 AlsaOutput::DispatchSockets() noexcept
 try {
+	++n_dispatches;
+
 	non_block.DispatchSockets(*this, pcm);
 
 	if (must_prepare) {
@@ -961,6 +1190,28 @@ try {
 		}
 	}
 
+	if (use_mmap && period_buffer.IsEmpty() &&
+	    period_buffer.GetPeriodPosition(out_frame_size) == 0) {
+		const auto frames_written = CopyRingToMmap();
+		if (frames_written > 0)
+			return;
+
+		if (frames_written < 0) {
+			if (frames_written == -EAGAIN ||
+			    frames_written == -EINTR)
+				return;
+
+			if (Recover(frames_written) < 0)
+				throw FormatRuntimeError("snd_pcm_mmap_commit() failed: %s",
+							 snd_strerror(-frames_written));
+
+			return;
+		}
+
+		/* less than one period available: fall back to
+		   #period_buffer */
+	}
+
 	CopyRingToPeriodBuffer();
 
 	if (period_buffer.IsEmpty()) {
@@ -34,6 +34,9 @@
 #include <jack/types.h>
 #include <jack/ringbuffer.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include <unistd.h> /* for usleep() */
 #include <stdlib.h>
 
@@ -41,6 +44,12 @@ static constexpr unsigned MAX_PORTS = 16;
 
 static constexpr size_t jack_sample_size = sizeof(jack_default_audio_sample_t);
 
+/**
+ * The initial fill limit of each ring buffer (in bytes) in
+ * "low_latency" mode.
+ */
+static constexpr size_t jack_low_latency_fill = 4096;
+
 struct JackOutput final : AudioOutput {
 	/**
 	 * libjack options passed to jack_client_open().
@@ -61,6 +70,28 @@ struct JackOutput final : AudioOutput {
 
 	size_t ringbuffer_size;
 
+	/**
+	 * Never fill a ring buffer with more than this number of
+	 * bytes.  This equals #ringbuffer_size unless "low_latency"
+	 * mode is enabled; then it starts small and is doubled after
+	 * each underrun.  Only accessed by the output thread.
+	 */
+	size_t fill_limit;
+
+	/**
+	 * Set by the "process" callback if it ran out of data while
+	 * playing; evaluated (and cleared) by Play().
+	 */
+	std::atomic_bool underrun;
+
+	/**
+	 * Has Play() submitted data since Open() or Pause()?  Before
+	 * that, an empty ring buffer is not an underrun.
+	 */
+	std::atomic_bool playing;
+
+	bool low_latency = false;
+
 	/* the current audio format */
 	AudioFormat audio_format;
 
@@ -118,6 +149,7 @@ struct JackOutput final : AudioOutput {
 
 	/* virtual methods from class AudioOutput */
 
+	void SetLowLatency() noexcept override;
 	void Enable() override;
 	void Disable() noexcept override;
 
@@ -211,6 +243,14 @@ JackOutput::JackOutput(const ConfigBlock &block)
 			      block.line);
 
 	ringbuffer_size = block.GetPositiveValue("ringbuffer_size", 32768u);
+	fill_limit = ringbuffer_size;
+}
+
+void
+JackOutput::SetLowLatency() noexcept
+{
+	low_latency = true;
+	fill_limit = std::min(jack_low_latency_fill, ringbuffer_size);
 }
 
 inline jack_nframes_t
@@ -319,6 +359,8 @@ JackOutput::Process(jack_nframes_t nframes)
 
 	if (available > nframes)
 		available = nframes;
+	else if (available < nframes && playing.load(std::memory_order_relaxed))
+		underrun.store(true, std::memory_order_relaxed);
 
 	for (unsigned i = 0; i < n_channels; ++i)
 		Copy(*ports[i], nframes, *ringbuffer[i], available);
@@ -591,6 +633,9 @@ JackOutput::Open(AudioFormat &new_audio_format)
 	set_audioformat(this, new_audio_format);
 	audio_format = new_audio_format;
 
+	playing = false;
+	underrun = false;
+
 	Start();
 }
 
@@ -614,6 +659,12 @@ JackOutput::WriteSamples(const float *src, size_t n_frames)
 			/* send data symmetrically */
 			space = e.len;
 
+		const size_t filled = jack_ringbuffer_read_space(ringbuffer[i]);
+		if (filled >= fill_limit)
+			space = 0;
+		else if (fill_limit - filled < space)
+			space = fill_limit - filled;
+
 		dest[i] = (float *)e.buf;
 	}
 
@@ -640,6 +691,14 @@ JackOutput::Play(const void *chunk, size_t size)
 {
 	pause = false;
 
+	if (low_latency && fill_limit < ringbuffer_size &&
+	    underrun.exchange(false, std::memory_order_relaxed)) {
+		fill_limit = std::min(fill_limit * 2, ringbuffer_size);
+		FormatDebug(jack_output_domain,
+			    "underrun: ring buffer fill limit is now %zu",
+			    fill_limit);
+	}
+
 	const size_t frame_size = audio_format.GetFrameSize();
 	assert(size % frame_size == 0);
 	size /= frame_size;
@@ -651,8 +710,10 @@ JackOutput::Play(const void *chunk, size_t size)
 
 		size_t frames_written =
 			WriteSamples((const float *)chunk, size);
-		if (frames_written > 0)
+		if (frames_written > 0) {
+			playing.store(true, std::memory_order_relaxed);
 			return frames_written * frame_size;
+		}
 
 		/* XXX do something more intelligent to
 		   synchronize */
@@ -667,6 +728,7 @@ JackOutput::Pause()
 		return false;
 
 	pause = true;
+	playing.store(false, std::memory_order_relaxed);
 
 	return true;
 }
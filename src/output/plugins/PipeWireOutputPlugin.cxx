@@ -0,0 +1,722 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PipeWireOutputPlugin.hxx"
+#include "lib/pipewire/ThreadLoop.hxx"
+#include "../OutputAPI.hxx"
+#include "mixer/MixerList.hxx"
+#include "mixer/plugins/PipeWireMixerPlugin.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/Silence.hxx"
+#include "system/Error.hxx"
+#include "util/Domain.hxx"
+#include "util/Manual.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/WritableBuffer.hxx"
+#include "Log.hxx"
+
+#include <pipewire/pipewire.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/props.h>
+#include <spa/pod/builder.h>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr Domain pipewire_output_domain("pipewire_output");
+
+class PipeWireOutput final : AudioOutput {
+	const char *const name;
+	const char *const remote;
+	const char *const target;
+
+	struct pw_thread_loop *thread_loop = nullptr;
+	struct pw_stream *stream = nullptr;
+
+	PipeWireMixer *mixer = nullptr;
+
+	/**
+	 * The current linear volume, applied to each new stream.
+	 * Protected by the #thread_loop lock.
+	 */
+	float volume = 1.0;
+
+	unsigned channels;
+
+	/**
+	 * The sample format which is written to #ring_buffer (needed
+	 * for generating silence).
+	 */
+	SampleFormat sample_format;
+
+	/**
+	 * The size of one frame after #pcm_export.
+	 */
+	size_t frame_size;
+
+	Manual<PcmExport> pcm_export;
+
+	/**
+	 * For copying data from the OutputThread to the PipeWire
+	 * "process" callback.
+	 */
+	boost::lockfree::spsc_queue<uint8_t> *ring_buffer;
+
+	/**
+	 * Has the stream failed or been disconnected?  Protected by
+	 * the #thread_loop lock.
+	 */
+	bool disconnected;
+
+	/**
+	 * Has pw_stream_set_active(true) been called?  Before the
+	 * #ring_buffer is full, the stream is left inactive, so the
+	 * "process" callback doesn't play silence.
+	 */
+	bool active;
+
+	/**
+	 * Is the output paused?  Only used by Delay().
+	 */
+	bool paused;
+
+	/**
+	 * Drain() has requested that the stream be flushed when
+	 * #ring_buffer runs empty.
+	 */
+	bool drain_requested;
+
+	/**
+	 * Set by the "drained" callback.
+	 */
+	bool drained;
+
+	explicit PipeWireOutput(const ConfigBlock &block);
+
+public:
+	static AudioOutput *Create(EventLoop &,
+				   const ConfigBlock &block) {
+		pw_init(0, nullptr);
+
+		return new PipeWireOutput(block);
+	}
+
+	void SetMixer(PipeWireMixer &_mixer) noexcept;
+
+	void ClearMixer(gcc_unused PipeWireMixer &old_mixer) noexcept {
+		assert(mixer == &old_mixer);
+
+		mixer = nullptr;
+	}
+
+	void SetVolume(float volume);
+
+private:
+	void Enable() override;
+	void Disable() noexcept override;
+
+	void Open(AudioFormat &audio_format) override;
+	void Close() noexcept override;
+
+	std::chrono::steady_clock::duration Delay() const noexcept override;
+	size_t Play(const void *chunk, size_t size) override;
+	void Drain() override;
+	void Cancel() noexcept override;
+	bool Pause() override;
+
+	/**
+	 * Apply #volume to the stream.
+	 *
+	 * Caller must lock the #thread_loop.
+	 */
+	void ApplyVolume() noexcept;
+
+	/**
+	 * Make sure the "process" callback gets invoked.
+	 *
+	 * Caller must lock the #thread_loop.
+	 */
+	void Activate() noexcept {
+		if (!active) {
+			active = true;
+			pw_stream_set_active(stream, true);
+		}
+	}
+
+	/**
+	 * Caller must lock the #thread_loop.
+	 */
+	void CheckThrowError() const {
+		if (disconnected)
+			throw std::runtime_error("PipeWire stream disconnected");
+	}
+
+	void StateChanged(enum pw_stream_state state,
+			  const char *error) noexcept;
+	void ControlInfo(uint32_t id,
+			 const struct pw_stream_control &control) noexcept;
+	void Process() noexcept;
+	void Drained() noexcept;
+
+	static void StateChanged(void *data,
+				 gcc_unused enum pw_stream_state old,
+				 enum pw_stream_state state,
+				 const char *error) noexcept {
+		auto &o = *(PipeWireOutput *)data;
+		o.StateChanged(state, error);
+	}
+
+	static void ControlInfo(void *data, uint32_t id,
+				const struct pw_stream_control *control) noexcept {
+		auto &o = *(PipeWireOutput *)data;
+		o.ControlInfo(id, *control);
+	}
+
+	static void Process(void *data) noexcept {
+		auto &o = *(PipeWireOutput *)data;
+		o.Process();
+	}
+
+	static void Drained(void *data) noexcept {
+		auto &o = *(PipeWireOutput *)data;
+		o.Drained();
+	}
+
+	static const struct pw_stream_events stream_events;
+
+	static struct pw_stream_events MakeStreamEvents() noexcept {
+		struct pw_stream_events events;
+		memset(&events, 0, sizeof(events));
+		events.version = PW_VERSION_STREAM_EVENTS;
+		events.state_changed = StateChanged;
+		events.control_info = ControlInfo;
+		events.process = Process;
+		events.drained = Drained;
+		return events;
+	}
+};
+
+const struct pw_stream_events PipeWireOutput::stream_events =
+	PipeWireOutput::MakeStreamEvents();
+
+PipeWireOutput::PipeWireOutput(const ConfigBlock &block)
+	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
+	 name(block.GetBlockValue("name", "mpd")),
+	 remote(block.GetBlockValue("remote")),
+	 target(block.GetBlockValue("target"))
+{
+}
+
+inline void
+PipeWireOutput::SetMixer(PipeWireMixer &_mixer) noexcept
+{
+	assert(mixer == nullptr);
+
+	mixer = &_mixer;
+}
+
+void
+pipewire_output_set_mixer(PipeWireOutput &po, PipeWireMixer &pm) noexcept
+{
+	po.SetMixer(pm);
+}
+
+void
+pipewire_output_clear_mixer(PipeWireOutput &po, PipeWireMixer &pm) noexcept
+{
+	po.ClearMixer(pm);
+}
+
+void
+PipeWireOutput::ApplyVolume() noexcept
+{
+	float values[MAX_CHANNELS];
+	std::fill_n(values, channels, volume);
+
+	pw_stream_set_control(stream,
+			      SPA_PROP_channelVolumes, channels, values,
+			      0);
+}
+
+inline void
+PipeWireOutput::SetVolume(float _volume)
+{
+	if (thread_loop == nullptr) {
+		/* not enabled: remember the value for later */
+		volume = _volume;
+		return;
+	}
+
+	const PipeWire::ThreadLoopLock lock(thread_loop);
+
+	volume = _volume;
+
+	if (stream != nullptr)
+		ApplyVolume();
+}
+
+void
+pipewire_output_set_volume(PipeWireOutput &po, float volume)
+{
+	po.SetVolume(volume);
+}
+
+void
+PipeWireOutput::Enable()
+{
+	thread_loop = pw_thread_loop_new(name, nullptr);
+	if (thread_loop == nullptr)
+		throw MakeErrno("pw_thread_loop_new() failed");
+
+	if (pw_thread_loop_start(thread_loop) < 0) {
+		pw_thread_loop_destroy(thread_loop);
+		thread_loop = nullptr;
+		throw std::runtime_error("pw_thread_loop_start() failed");
+	}
+
+	pcm_export.Construct();
+}
+
+void
+PipeWireOutput::Disable() noexcept
+{
+	pcm_export.Destruct();
+
+	pw_thread_loop_stop(thread_loop);
+	pw_thread_loop_destroy(thread_loop);
+	thread_loop = nullptr;
+}
+
+/**
+ * Convert a MPD sample format to a PipeWire one, modifying
+ * #sample_format if PipeWire doesn't support it.
+ */
+static enum spa_audio_format
+ToPipeWireAudioFormat(SampleFormat &sample_format) noexcept
+{
+	switch (sample_format) {
+	case SampleFormat::S8:
+		return SPA_AUDIO_FORMAT_S8;
+
+	case SampleFormat::S16:
+		return SPA_AUDIO_FORMAT_S16;
+
+	case SampleFormat::S24_P32:
+		return SPA_AUDIO_FORMAT_S24_32;
+
+	case SampleFormat::S32:
+		return SPA_AUDIO_FORMAT_S32;
+
+	case SampleFormat::FLOAT:
+		return SPA_AUDIO_FORMAT_F32;
+
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		break;
+	}
+
+	/* let MPD convert everything else to floating point */
+	sample_format = SampleFormat::FLOAT;
+	return SPA_AUDIO_FORMAT_F32;
+}
+
+/**
+ * Fill the PipeWire channel map according to MPD's channel order
+ * (which is the same as FLAC's and WAVE-EX's).
+ */
+static void
+SetChannelMap(uint32_t *position, unsigned channels) noexcept
+{
+	switch (channels) {
+	case 1:
+		position[0] = SPA_AUDIO_CHANNEL_MONO;
+		break;
+
+	case 2:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		break;
+
+	case 3:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		position[2] = SPA_AUDIO_CHANNEL_FC;
+		break;
+
+	case 4:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		position[2] = SPA_AUDIO_CHANNEL_RL;
+		position[3] = SPA_AUDIO_CHANNEL_RR;
+		break;
+
+	case 5:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		position[2] = SPA_AUDIO_CHANNEL_FC;
+		position[3] = SPA_AUDIO_CHANNEL_RL;
+		position[4] = SPA_AUDIO_CHANNEL_RR;
+		break;
+
+	case 6:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		position[2] = SPA_AUDIO_CHANNEL_FC;
+		position[3] = SPA_AUDIO_CHANNEL_LFE;
+		position[4] = SPA_AUDIO_CHANNEL_RL;
+		position[5] = SPA_AUDIO_CHANNEL_RR;
+		break;
+
+	case 7:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		position[2] = SPA_AUDIO_CHANNEL_FC;
+		position[3] = SPA_AUDIO_CHANNEL_LFE;
+		position[4] = SPA_AUDIO_CHANNEL_RC;
+		position[5] = SPA_AUDIO_CHANNEL_SL;
+		position[6] = SPA_AUDIO_CHANNEL_SR;
+		break;
+
+	case 8:
+		position[0] = SPA_AUDIO_CHANNEL_FL;
+		position[1] = SPA_AUDIO_CHANNEL_FR;
+		position[2] = SPA_AUDIO_CHANNEL_FC;
+		position[3] = SPA_AUDIO_CHANNEL_LFE;
+		position[4] = SPA_AUDIO_CHANNEL_RL;
+		position[5] = SPA_AUDIO_CHANNEL_RR;
+		position[6] = SPA_AUDIO_CHANNEL_SL;
+		position[7] = SPA_AUDIO_CHANNEL_SR;
+		break;
+
+	default:
+		assert(false);
+	}
+}
+
+void
+PipeWireOutput::Open(AudioFormat &audio_format)
+{
+	disconnected = false;
+	active = false;
+	paused = false;
+	drain_requested = false;
+	drained = true;
+
+	auto *props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio",
+					PW_KEY_MEDIA_CATEGORY, "Playback",
+					PW_KEY_MEDIA_ROLE, "Music",
+					PW_KEY_APP_NAME, "Music Player Daemon",
+					PW_KEY_NODE_NAME, name,
+					nullptr);
+	if (remote != nullptr)
+		pw_properties_set(props, PW_KEY_REMOTE_NAME, remote);
+	if (target != nullptr)
+		pw_properties_set(props, PW_KEY_NODE_TARGET, target);
+
+	const PipeWire::ThreadLoopLock lock(thread_loop);
+
+	stream = pw_stream_new_simple(pw_thread_loop_get_loop(thread_loop),
+				      name, props,
+				      &stream_events, this);
+	if (stream == nullptr)
+		throw MakeErrno("pw_stream_new_simple() failed");
+
+	channels = audio_format.channels;
+
+	PcmExport::Params params;
+
+	uint8_t pod_buffer[1024];
+	struct spa_pod_builder pod_builder =
+		SPA_POD_BUILDER_INIT(pod_buffer, sizeof(pod_buffer));
+	const struct spa_pod *param;
+
+#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
+	if (audio_format.format == SampleFormat::DSD) {
+		/* native DSD: 32 bit words of DSD bytes in
+		   chronological order, MSB first */
+		params.dsd_u32 = true;
+
+		struct spa_audio_info_dsd dsd;
+		memset(&dsd, 0, sizeof(dsd));
+		dsd.bitorder = SPA_PARAM_BITORDER_msb;
+		dsd.interleave = 4;
+		/* in bytes per second and channel, just like MPD's
+		   DSD sample rate */
+		dsd.rate = audio_format.sample_rate;
+		dsd.channels = channels;
+		SetChannelMap(dsd.position, channels);
+
+		param = spa_format_audio_dsd_build(&pod_builder,
+						   SPA_PARAM_EnumFormat,
+						   &dsd);
+	} else
+#endif
+	{
+		struct spa_audio_info_raw raw;
+		memset(&raw, 0, sizeof(raw));
+		raw.format = ToPipeWireAudioFormat(audio_format.format);
+		raw.rate = audio_format.sample_rate;
+		raw.channels = channels;
+		SetChannelMap(raw.position, channels);
+
+		param = spa_format_audio_raw_build(&pod_builder,
+						   SPA_PARAM_EnumFormat,
+						   &raw);
+	}
+
+	sample_format = audio_format.format;
+	pcm_export->Open(audio_format.format, channels, params);
+	frame_size = pcm_export->GetFrameSize(audio_format);
+
+	/* a quarter of a second */
+	ring_buffer = new boost::lockfree::spsc_queue<uint8_t>(std::max<size_t>(frame_size * (audio_format.sample_rate / 4),
+										 frame_size * 1024));
+
+	/* the stream is created inactive; Play() activates it as
+	   soon as the ring_buffer is full; the buffers are shared
+	   memory provided by the PipeWire daemon */
+	const auto flags = pw_stream_flags(PW_STREAM_FLAG_AUTOCONNECT |
+					   PW_STREAM_FLAG_INACTIVE |
+					   PW_STREAM_FLAG_MAP_BUFFERS |
+					   PW_STREAM_FLAG_RT_PROCESS);
+
+	if (pw_stream_connect(stream, PW_DIRECTION_OUTPUT, PW_ID_ANY,
+			      flags, &param, 1) < 0) {
+		pw_stream_destroy(stream);
+		stream = nullptr;
+		delete ring_buffer;
+		throw std::runtime_error("pw_stream_connect() failed");
+	}
+
+	ApplyVolume();
+}
+
+void
+PipeWireOutput::Close() noexcept
+{
+	{
+		const PipeWire::ThreadLoopLock lock(thread_loop);
+		pw_stream_destroy(stream);
+		stream = nullptr;
+	}
+
+	delete ring_buffer;
+}
+
+inline void
+PipeWireOutput::StateChanged(enum pw_stream_state state,
+			     const char *error) noexcept
+{
+	const bool was_disconnected = disconnected;
+	disconnected = state == PW_STREAM_STATE_ERROR ||
+		state == PW_STREAM_STATE_UNCONNECTED;
+
+	if (!was_disconnected && disconnected) {
+		if (error != nullptr)
+			FormatWarning(pipewire_output_domain,
+				      "Stream error: %s", error);
+
+		pw_thread_loop_signal(thread_loop, false);
+	}
+}
+
+inline void
+PipeWireOutput::ControlInfo(uint32_t id,
+			    const struct pw_stream_control &control) noexcept
+{
+	if (id != SPA_PROP_channelVolumes || control.n_values == 0)
+		return;
+
+	/* the volume was changed by another PipeWire client; report
+	   the average of all channels */
+	float sum = 0;
+	for (unsigned i = 0; i < control.n_values; ++i)
+		sum += control.values[i];
+
+	volume = sum / control.n_values;
+
+	if (mixer != nullptr)
+		pipewire_mixer_on_change(*mixer, volume);
+}
+
+inline void
+PipeWireOutput::Process() noexcept
+{
+	auto *b = pw_stream_dequeue_buffer(stream);
+	if (b == nullptr) {
+		pw_log_warn("out of buffers: %m");
+		return;
+	}
+
+	auto &buffer = *b->buffer;
+	auto &d = buffer.datas[0];
+
+	auto *dest = (uint8_t *)d.data;
+	if (dest == nullptr) {
+		pw_stream_queue_buffer(stream, b);
+		return;
+	}
+
+	const size_t max_size = d.maxsize - d.maxsize % frame_size;
+	size_t nbytes = ring_buffer->pop(dest, max_size);
+	if (nbytes == 0) {
+		if (drain_requested) {
+			pw_stream_queue_buffer(stream, b);
+			pw_stream_flush(stream, true);
+			return;
+		}
+
+		/* buffer underrun: generate some silence */
+		PcmSilence({dest, max_size}, sample_format);
+		nbytes = max_size;
+	}
+
+	d.chunk->offset = 0;
+	d.chunk->stride = frame_size;
+	d.chunk->size = nbytes;
+
+	pw_stream_queue_buffer(stream, b);
+
+	/* notify the OutputThread that there is now room in
+	   ring_buffer */
+	pw_thread_loop_signal(thread_loop, false);
+}
+
+inline void
+PipeWireOutput::Drained() noexcept
+{
+	drained = true;
+	pw_thread_loop_signal(thread_loop, false);
+}
+
+std::chrono::steady_clock::duration
+PipeWireOutput::Delay() const noexcept
+{
+	return paused
+		? std::chrono::seconds(1)
+		: std::chrono::steady_clock::duration::zero();
+}
+
+size_t
+PipeWireOutput::Play(const void *chunk, size_t size)
+{
+	paused = false;
+
+	const auto e = pcm_export->Export({chunk, size});
+	if (e.size == 0)
+		/* the DoP (DSD over PCM) filter converts two frames
+		   at a time and ignores the last odd frame; pretend
+		   the one frame has been played */
+		return size;
+
+	/* fast path: as long as there is room in the ring_buffer,
+	   the thread loop doesn't need to be locked */
+	size_t bytes_written = ring_buffer->push((const uint8_t *)e.data,
+						 e.size);
+	if (bytes_written > 0)
+		return pcm_export->CalcSourceSize(bytes_written);
+
+	const PipeWire::ThreadLoopLock lock(thread_loop);
+
+	while (true) {
+		CheckThrowError();
+
+		bytes_written = ring_buffer->push((const uint8_t *)e.data,
+						  e.size);
+		if (bytes_written > 0)
+			return pcm_export->CalcSourceSize(bytes_written);
+
+		/* now that the ring_buffer is full, start playback */
+		Activate();
+
+		/* wait for the "process" callback to make room in
+		   the ring_buffer */
+		pw_thread_loop_wait(thread_loop);
+	}
+}
+
+void
+PipeWireOutput::Drain()
+{
+	const PipeWire::ThreadLoopLock lock(thread_loop);
+
+	CheckThrowError();
+
+	drain_requested = true;
+	drained = false;
+	AtScopeExit(this) { drain_requested = false; };
+
+	Activate();
+
+	while (!drained && !disconnected)
+		pw_thread_loop_wait(thread_loop);
+}
+
+void
+PipeWireOutput::Cancel() noexcept
+{
+	const PipeWire::ThreadLoopLock lock(thread_loop);
+
+	/* deactivate the stream first, so the "process" callback
+	   doesn't run while the ring_buffer is being cleared; it
+	   will be reactivated by Play() after the ring_buffer has
+	   been refilled */
+	if (active) {
+		active = false;
+		pw_stream_set_active(stream, false);
+	}
+
+	/* clear MPD's ring buffer */
+	ring_buffer->reset();
+
+	/* clear libpipewire's buffer */
+	pw_stream_flush(stream, false);
+
+	pcm_export->Reset();
+}
+
+bool
+PipeWireOutput::Pause()
+{
+	const PipeWire::ThreadLoopLock lock(thread_loop);
+
+	CheckThrowError();
+
+	paused = true;
+
+	if (active) {
+		active = false;
+		pw_stream_set_active(stream, false);
+	}
+
+	return true;
+}
+
+const struct AudioOutputPlugin pipewire_output_plugin = {
+	"pipewire",
+	nullptr,
+	&PipeWireOutput::Create,
+	&pipewire_mixer_plugin,
+};
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PIPEWIRE_OUTPUT_PLUGIN_HXX
+#define MPD_PIPEWIRE_OUTPUT_PLUGIN_HXX
+
+class PipeWireOutput;
+class PipeWireMixer;
+
+extern const struct AudioOutputPlugin pipewire_output_plugin;
+
+void
+pipewire_output_set_mixer(PipeWireOutput &po, PipeWireMixer &pm) noexcept;
+
+void
+pipewire_output_clear_mixer(PipeWireOutput &po, PipeWireMixer &pm) noexcept;
+
+/**
+ * @param volume the linear volume (0.0 .. 1.0)
+ */
+void
+pipewire_output_set_volume(PipeWireOutput &po, float volume);
+
+#endif
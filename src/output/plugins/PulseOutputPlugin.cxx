@@ -35,19 +35,33 @@
 #include <pulse/subscribe.h>
 #include <pulse/version.h>
 
+#include <algorithm>
 #include <stdexcept>
 
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MPD_PULSE_NAME "Music Player Daemon"
 
+/**
+ * A value for the #pa_buffer_attr settings which lets the server
+ * choose.
+ */
+static constexpr unsigned PULSE_BUFFER_DEFAULT = unsigned(-1);
+
 class PulseOutput final : AudioOutput {
 	const char *name;
 	const char *server;
 	const char *sink;
 
+	/**
+	 * The configured #pa_buffer_attr values in microseconds
+	 * ("tlength", "minreq", "prebuf"), or #PULSE_BUFFER_DEFAULT.
+	 */
+	const unsigned tlength_us, minreq_us, prebuf_us;
+
 	PulseMixer *mixer = nullptr;
 
 	struct pa_threaded_mainloop *mainloop = nullptr;
@@ -179,7 +193,10 @@ PulseOutput::PulseOutput(const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
 	 name(block.GetBlockValue("name", "mpd_pulse")),
 	 server(block.GetBlockValue("server")),
-	 sink(block.GetBlockValue("sink"))
+	 sink(block.GetBlockValue("sink")),
+	 tlength_us(block.GetBlockValue("tlength", PULSE_BUFFER_DEFAULT)),
+	 minreq_us(block.GetBlockValue("minreq", PULSE_BUFFER_DEFAULT)),
+	 prebuf_us(block.GetBlockValue("prebuf", PULSE_BUFFER_DEFAULT))
 {
 	setenv("PULSE_PROP_media.role", "music", true);
 	setenv("PULSE_PROP_application.icon_name", "mpd", true);
@@ -574,6 +591,18 @@ pulse_output_stream_write_cb(gcc_unused pa_stream *stream, size_t nbytes,
 	return po.OnStreamWrite(nbytes);
 }
 
+/**
+ * Convert a #pa_buffer_attr setting from microseconds to bytes.
+ */
+static uint32_t
+UsecToBytes(unsigned us, const pa_sample_spec &ss) noexcept
+{
+	if (us == PULSE_BUFFER_DEFAULT)
+		return uint32_t(-1);
+
+	return pa_usec_to_bytes(pa_usec_t(us), &ss);
+}
+
 inline void
 PulseOutput::SetupStream(const pa_sample_spec &ss)
 {
@@ -659,8 +688,26 @@ PulseOutput::Open(AudioFormat &audio_format)
 
 	/* .. and connect it (asynchronously) */
 
+	const bool custom_attr = tlength_us != PULSE_BUFFER_DEFAULT ||
+		minreq_us != PULSE_BUFFER_DEFAULT ||
+		prebuf_us != PULSE_BUFFER_DEFAULT;
+
+	pa_buffer_attr attr;
+	attr.maxlength = uint32_t(-1);
+	attr.tlength = UsecToBytes(tlength_us, ss);
+	attr.prebuf = UsecToBytes(prebuf_us, ss);
+	attr.minreq = UsecToBytes(minreq_us, ss);
+	attr.fragsize = uint32_t(-1);
+
+	/* with an explicit tlength, let the server configure the
+	   sink latency accordingly */
+	const pa_stream_flags_t flags = tlength_us != PULSE_BUFFER_DEFAULT
+		? PA_STREAM_ADJUST_LATENCY
+		: pa_stream_flags_t(0);
+
 	if (pa_stream_connect_playback(stream, sink,
-				       nullptr, pa_stream_flags_t(0),
+				       custom_attr ? &attr : nullptr,
+				       flags,
 				       nullptr, nullptr) < 0) {
 		DeleteStream();
 
@@ -770,32 +817,54 @@ PulseOutput::Play(const void *chunk, size_t size)
 	if (pa_stream_is_corked(stream))
 		StreamPause(false);
 
-	/* wait until the server allows us to write */
+	/* submit as much of the chunk as possible while the main
+	   loop is locked, instead of returning after each partial
+	   write and locking it again for the rest */
 
-	while (writable == 0) {
-		if (pa_stream_is_suspended(stream))
-			throw std::runtime_error("suspended");
+	const auto *src = (const uint8_t *)chunk;
+	size_t done = 0;
 
-		pa_threaded_mainloop_wait(mainloop);
+	do {
+		/* wait until the server allows us to write */
 
-		if (pa_stream_get_state(stream) != PA_STREAM_READY)
-			throw std::runtime_error("disconnected");
-	}
+		while (writable == 0) {
+			if (done > 0)
+				/* return what we have; the
+				   OutputThread will call again */
+				return done;
+
+			if (pa_stream_is_suspended(stream))
+				throw std::runtime_error("suspended");
+
+			pa_threaded_mainloop_wait(mainloop);
+
+			if (pa_stream_get_state(stream) != PA_STREAM_READY)
+				throw std::runtime_error("disconnected");
+		}
 
-	/* now write */
+		/* now write directly into a buffer owned by
+		   libpulse, which saves the copy pa_stream_write()
+		   would make */
 
-	if (size > writable)
-		/* don't send more than possible */
-		size = writable;
+		size_t nbytes = std::min(size - done, writable);
+		void *dest;
+		if (pa_stream_begin_write(stream, &dest, &nbytes) < 0)
+			throw MakePulseError(context,
+					     "pa_stream_begin_write() failed");
+
+		nbytes = std::min(nbytes, size - done);
+		memcpy(dest, src + done, nbytes);
 
-	writable -= size;
+		if (pa_stream_write(stream, dest, nbytes, nullptr,
+				    0, PA_SEEK_RELATIVE) < 0)
+			throw MakePulseError(context,
+					     "pa_stream_write() failed");
 
-	int result = pa_stream_write(stream, chunk, size, nullptr,
-				     0, PA_SEEK_RELATIVE);
-	if (result < 0)
-		throw MakePulseError(context, "pa_stream_write() failed");
+		writable -= std::min(nbytes, writable);
+		done += nbytes;
+	} while (done < size);
 
-	return size;
+	return done;
 }
 
 void
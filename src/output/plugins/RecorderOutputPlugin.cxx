@@ -28,17 +28,81 @@
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/io/FileOutputStream.hxx"
+#include "fs/io/ThreadedOutputStream.hxx"
+#include "tag/Tag.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
 
 #include <stdexcept>
 #include <memory>
+#include <string>
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static constexpr Domain recorder_domain("recorder");
 
+/**
+ * An output file together with the thread which writes to it, so a
+ * slow disk doesn't stall the output thread.
+ */
+class RecorderFile final : OutputStream {
+	FileOutputStream file;
+
+	/**
+	 * Reserve disk space in chunks of this size (0 = disabled).
+	 */
+	const uint64_t preallocate;
+
+	/**
+	 * The number of bytes written to #file so far and the number
+	 * of bytes reserved with FileOutputStream::Allocate().  Only
+	 * used by the #stream thread.
+	 */
+	uint64_t written = 0, allocated = 0;
+
+public:
+	ThreadedOutputStream stream;
+
+	RecorderFile(Path path, size_t buffer_size, uint64_t _preallocate)
+		:file(path), preallocate(_preallocate),
+		 stream(*this, buffer_size) {}
+
+	/**
+	 * Returns the number of bytes submitted to #stream so far.
+	 */
+	uint64_t GetSize() const noexcept {
+		return stream.GetPosition();
+	}
+
+	/**
+	 * Write all pending data and commit the file.
+	 *
+	 * Throws on error.
+	 */
+	void Commit() {
+		stream.Flush();
+		file.Commit();
+	}
+
+private:
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override {
+		written += size;
+
+#ifdef __linux__
+		if (preallocate > 0 && written > allocated) {
+			allocated = written + preallocate;
+			file.Allocate(allocated);
+		}
+#endif
+
+		file.Write(data, size);
+	}
+};
+
 class RecorderOutput final : AudioOutput {
 	/**
 	 * The configured encoder plugin.
@@ -66,7 +130,52 @@ class RecorderOutput final : AudioOutput {
 	/**
 	 * The destination file.
 	 */
-	FileOutputStream *file;
+	RecorderFile *file;
+
+	/**
+	 * The maximum number of bytes which may be waiting for the
+	 * I/O thread.
+	 */
+	size_t io_buffer_size;
+
+	/**
+	 * Reserve disk space in chunks of this size (0 = disabled).
+	 */
+	uint64_t preallocate;
+
+	/**
+	 * Start a new file after this many seconds of audio
+	 * (0 = disabled).  Requires #format_path.
+	 */
+	unsigned segment_time;
+
+	/**
+	 * Start a new file after this many bytes (0 = disabled).
+	 * Requires #format_path.
+	 */
+	uint64_t segment_size;
+
+	/**
+	 * #segment_time converted to a number of PCM bytes.
+	 */
+	uint64_t segment_pcm_limit;
+
+	/**
+	 * The number of PCM bytes written into the current segment.
+	 */
+	uint64_t segment_pcm_bytes;
+
+	/**
+	 * The number of the current segment of the current song.  It
+	 * is appended to all file names after the first one.
+	 */
+	unsigned segment_number = 0;
+
+	/**
+	 * The most recent tag, used to build the path of the next
+	 * segment.
+	 */
+	std::unique_ptr<Tag> last_tag;
 
 	RecorderOutput(const ConfigBlock &block);
 
@@ -94,6 +203,23 @@ private:
 		return !format_path.empty();
 	}
 
+	gcc_pure
+	bool HasSegments() const noexcept {
+		return segment_time > 0 || segment_size > 0;
+	}
+
+	RecorderFile *OpenFile(Path p) {
+		return new RecorderFile(p, io_buffer_size, preallocate);
+	}
+
+	/**
+	 * Build the path for the given tag and #segment_number.
+	 *
+	 * Returns a "nulled" instance if no path could be composed.
+	 * Throws on error.
+	 */
+	AllocatedPath MakePath(const Tag &tag) const;
+
 	/**
 	 * Finish the encoder and commit the file.
 	 *
@@ -103,6 +229,11 @@ private:
 
 	void FinishFormat();
 	void ReopenFormat(AllocatedPath &&new_path);
+
+	/**
+	 * Finish the current segment and start a new file.
+	 */
+	void NextSegment();
 };
 
 RecorderOutput::RecorderOutput(const ConfigBlock &block)
@@ -122,6 +253,15 @@ RecorderOutput::RecorderOutput(const ConfigBlock &block)
 
 	if (!path.IsNull() && fmt != nullptr)
 		throw std::runtime_error("Cannot have both 'path' and 'format_path'");
+
+	io_buffer_size = block.GetPositiveValue("io_buffer_size", 1024u) * size_t(1024);
+	preallocate = uint64_t(block.GetBlockValue("preallocate", 0u)) * 1024;
+
+	segment_time = block.GetBlockValue("segment_time", 0u);
+	segment_size = uint64_t(block.GetBlockValue("segment_size", 0u)) * 1024;
+
+	if (HasSegments() && fmt == nullptr)
+		throw std::runtime_error("Segmenting requires 'format_path'");
 }
 
 inline void
@@ -129,7 +269,7 @@ RecorderOutput::EncoderToFile()
 {
 	assert(file != nullptr);
 
-	EncoderToOutputStream(*file, *encoder);
+	EncoderToOutputStream(file->stream, *encoder);
 }
 
 void
@@ -140,7 +280,7 @@ RecorderOutput::Open(AudioFormat &audio_format)
 	if (!HasDynamicPath()) {
 		assert(!path.IsNull());
 
-		file = new FileOutputStream(path);
+		file = OpenFile(path);
 	} else {
 		/* don't open the file just yet; wait until we have
 		   a tag that we can use to build the path */
@@ -169,6 +309,8 @@ RecorderOutput::Open(AudioFormat &audio_format)
 		/* remember the AudioFormat for ReopenFormat() */
 		effective_audio_format = audio_format;
 
+		segment_pcm_limit = audio_format.TimeToSize(std::chrono::seconds(segment_time));
+
 		/* close the encoder for now; it will be opened as
 		   soon as we have received a tag */
 		delete encoder;
@@ -224,6 +366,7 @@ RecorderOutput::Close() noexcept
 	if (HasDynamicPath()) {
 		assert(!path.IsNull());
 		path.SetNull();
+		last_tag.reset();
 	}
 }
 
@@ -252,7 +395,7 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 	assert(path.IsNull());
 	assert(file == nullptr);
 
-	FileOutputStream *new_file = new FileOutputStream(new_path);
+	RecorderFile *new_file = OpenFile(new_path);
 
 	AudioFormat new_audio_format = effective_audio_format;
 
@@ -268,7 +411,7 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 	assert(new_audio_format == effective_audio_format);
 
 	try {
-		EncoderToOutputStream(*new_file, *encoder);
+		EncoderToOutputStream(new_file->stream, *encoder);
 	} catch (...) {
 		delete encoder;
 		delete new_file;
@@ -277,36 +420,65 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 
 	path = std::move(new_path);
 	file = new_file;
+	segment_pcm_bytes = 0;
 
 	FormatDebug(recorder_domain, "Recording to \"%s\"",
 		    path.ToUTF8().c_str());
 }
 
+AllocatedPath
+RecorderOutput::MakePath(const Tag &tag) const
+{
+	char *p = FormatTag(tag, format_path.c_str());
+	if (p == nullptr || *p == 0) {
+		free(p);
+		return nullptr;
+	}
+
+	AtScopeExit(p) { free(p); };
+
+	if (segment_number == 0)
+		return ParsePath(p);
+
+	/* insert the segment number before the file name suffix */
+	std::string s(p);
+	const char *base = strrchr(p, '/');
+	const char *dot = strrchr(base != nullptr ? base : p, '.');
+	const size_t i = dot != nullptr ? size_t(dot - p) : s.length();
+
+	char number[16];
+	snprintf(number, sizeof(number), "-%03u", segment_number);
+	s.insert(i, number);
+
+	return ParsePath(s.c_str());
+}
+
 void
 RecorderOutput::SendTag(const Tag &tag)
 {
 	if (HasDynamicPath()) {
-		char *p = FormatTag(tag, format_path.c_str());
-		if (p == nullptr || *p == 0) {
-			/* no path could be composed with this tag:
-			   don't write a file */
-			free(p);
-			FinishFormat();
-			return;
+		if (HasSegments()) {
+			last_tag.reset(new Tag(tag));
+			segment_number = 0;
 		}
 
-		AtScopeExit(p) { free(p); };
-
 		AllocatedPath new_path = nullptr;
 
 		try {
-			new_path = ParsePath(p);
+			new_path = MakePath(tag);
 		} catch (...) {
 			LogError(std::current_exception());
 			FinishFormat();
 			return;
 		}
 
+		if (new_path.IsNull()) {
+			/* no path could be composed with this tag:
+			   don't write a file */
+			FinishFormat();
+			return;
+		}
+
 		if (new_path != path) {
 			FinishFormat();
 
@@ -324,6 +496,33 @@ RecorderOutput::SendTag(const Tag &tag)
 	encoder->SendTag(tag);
 }
 
+inline void
+RecorderOutput::NextSegment()
+{
+	assert(HasSegments());
+	assert(last_tag);
+
+	FinishFormat();
+
+	++segment_number;
+
+	try {
+		AllocatedPath new_path = MakePath(*last_tag);
+		if (new_path.IsNull())
+			return;
+
+		ReopenFormat(std::move(new_path));
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
+
+	/* tag the new segment just like the first one */
+	encoder->PreTag();
+	EncoderToFile();
+	encoder->SendTag(*last_tag);
+}
+
 size_t
 RecorderOutput::Play(const void *chunk, size_t size)
 {
@@ -339,6 +538,15 @@ RecorderOutput::Play(const void *chunk, size_t size)
 
 	EncoderToFile();
 
+	if (HasSegments()) {
+		segment_pcm_bytes += size;
+
+		if ((segment_pcm_limit > 0 &&
+		     segment_pcm_bytes >= segment_pcm_limit) ||
+		    (segment_size > 0 && file->GetSize() >= segment_size))
+			NextSegment();
+	}
+
 	return size;
 }
 
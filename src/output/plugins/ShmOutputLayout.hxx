@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SHM_OUTPUT_LAYOUT_HXX
+#define MPD_SHM_OUTPUT_LAYOUT_HXX
+
+#include <atomic>
+
+#include <stdint.h>
+
+/**
+ * The layout of the file shared by the "shm" output plugin with its
+ * consumers.  The file begins with this header, followed by
+ * #data_size bytes of ring buffer at #data_offset.
+ *
+ * The writer never waits for consumers.  Each consumer keeps its own
+ * read position; if #write_position grows by more than #data_size
+ * beyond it, the consumer has been overrun.
+ *
+ * The fields after #sequence are protected by a sequence lock: the
+ * writer makes #sequence odd before modifying them and even after;
+ * consumers retry reading if #sequence was odd or has changed.
+ * #sequence is also the futex word: consumers which have incremented
+ * #n_waiters may FUTEX_WAIT on it.
+ */
+struct ShmOutputHeader {
+	static constexpr uint32_t MAGIC = 0x5344504d; /* "MPDS" */
+	static constexpr uint32_t VERSION = 1;
+
+	uint32_t magic;
+	uint32_t version;
+
+	uint32_t data_offset;
+	uint32_t data_size;
+
+	std::atomic<uint32_t> sequence;
+
+	/**
+	 * The number of consumers blocked in FUTEX_WAIT.  The writer
+	 * skips the FUTEX_WAKE system call while this is zero.
+	 */
+	std::atomic<uint32_t> n_waiters;
+
+	/**
+	 * Incremented when the audio format changes or when buffered
+	 * data has been discarded (seeking); consumers should drop
+	 * what they have buffered.
+	 */
+	std::atomic<uint32_t> serial;
+
+	std::atomic<uint32_t> sample_rate;
+
+	/**
+	 * The MPD #SampleFormat enum value.
+	 */
+	std::atomic<uint8_t> sample_format;
+
+	std::atomic<uint8_t> channels;
+
+	/**
+	 * Non-zero while the output is open.
+	 */
+	std::atomic<uint8_t> playing;
+
+	uint8_t reserved;
+
+	std::atomic<uint32_t> frame_size;
+
+	/**
+	 * The total number of bytes ever written to the ring
+	 * buffer.  The next byte goes to offset (write_position %
+	 * data_size).
+	 */
+	std::atomic<uint64_t> write_position;
+
+	/**
+	 * The CLOCK_MONOTONIC time (nanoseconds) at which
+	 * #write_position was last updated.
+	 */
+	std::atomic<int64_t> timestamp_ns;
+};
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "ShmOutputPlugin.hxx"
+#include "ShmOutputLayout.hxx"
+#include "../OutputAPI.hxx"
+#include "../Timer.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "system/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The ring buffer begins at this offset, page-aligned.
+ */
+static constexpr size_t SHM_DATA_OFFSET = 4096;
+
+static_assert(sizeof(ShmOutputHeader) <= SHM_DATA_OFFSET,
+	      "Header too large");
+
+class ShmOutput final : AudioOutput {
+	const AllocatedPath path;
+	std::string path_utf8;
+
+	const size_t data_size;
+
+	void *mapping;
+	ShmOutputHeader *header;
+	uint8_t *data;
+
+	Timer *timer;
+
+	/**
+	 * The maximum number of bytes passed to the ring buffer by
+	 * one Play() call: half of the ring, rounded down to a whole
+	 * number of frames.
+	 */
+	size_t max_play;
+
+	/**
+	 * A copy of ShmOutputHeader::write_position; only this
+	 * process writes to it.
+	 */
+	uint64_t write_position = 0;
+
+public:
+	explicit ShmOutput(const ConfigBlock &block);
+	~ShmOutput() noexcept;
+
+	static AudioOutput *Create(EventLoop &,
+				   const ConfigBlock &block) {
+		return new ShmOutput(block);
+	}
+
+private:
+	void Open(AudioFormat &audio_format) override;
+	void Close() noexcept override;
+
+	std::chrono::steady_clock::duration Delay() const noexcept override;
+	size_t Play(const void *chunk, size_t size) override;
+	void Cancel() noexcept override;
+
+	void BeginUpdate() noexcept {
+		header->sequence.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	/**
+	 * Finish the update started by BeginUpdate() and wake up
+	 * all blocked consumers.
+	 */
+	void EndUpdate() noexcept;
+};
+
+static constexpr Domain shm_output_domain("shm_output");
+
+static size_t
+GetDataSize(const ConfigBlock &block)
+{
+	const size_t size = size_t(block.GetPositiveValue("buffer_size",
+							  1024u)) * 1024;
+	if (size > UINT32_MAX)
+		throw std::runtime_error("\"buffer_size\" is too large");
+
+	return size;
+}
+
+ShmOutput::ShmOutput(const ConfigBlock &block)
+	:AudioOutput(0),
+	 path(block.GetPath("path")),
+	 data_size(GetDataSize(block))
+{
+	if (path.IsNull())
+		throw std::runtime_error("No \"path\" parameter specified");
+
+	path_utf8 = path.ToUTF8();
+
+	auto fd = OpenFile(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (!fd.IsDefined())
+		throw FormatErrno("Failed to create \"%s\"",
+				  path_utf8.c_str());
+
+	const size_t total_size = SHM_DATA_OFFSET + data_size;
+	if (ftruncate(fd.Get(), total_size) < 0)
+		throw FormatErrno("Failed to resize \"%s\"",
+				  path_utf8.c_str());
+
+	mapping = mmap(nullptr, total_size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED, fd.Get(), 0);
+	if (mapping == MAP_FAILED)
+		throw FormatErrno("Failed to map \"%s\"",
+				  path_utf8.c_str());
+
+	header = new(mapping) ShmOutputHeader();
+	data = (uint8_t *)mapping + SHM_DATA_OFFSET;
+
+	header->data_offset = SHM_DATA_OFFSET;
+	header->data_size = data_size;
+	header->version = ShmOutputHeader::VERSION;
+
+	/* the magic is written last; consumers which see it may
+	   rely on all other fields being initialized */
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = ShmOutputHeader::MAGIC;
+}
+
+ShmOutput::~ShmOutput() noexcept
+{
+	munmap(mapping, SHM_DATA_OFFSET + data_size);
+
+	try {
+		RemoveFile(path);
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+static int64_t
+NowMonotonicNS() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void
+ShmOutput::EndUpdate() noexcept
+{
+	header->timestamp_ns.store(NowMonotonicNS(),
+				   std::memory_order_relaxed);
+	header->sequence.fetch_add(1, std::memory_order_release);
+
+	/* only enter the kernel if somebody is waiting */
+	if (header->n_waiters.load(std::memory_order_seq_cst) > 0)
+		syscall(SYS_futex, &header->sequence, FUTEX_WAKE, INT_MAX,
+			nullptr, nullptr, 0);
+}
+
+void
+ShmOutput::Open(AudioFormat &audio_format)
+{
+	timer = new Timer(audio_format);
+
+	const size_t frame_size = audio_format.GetFrameSize();
+	max_play = data_size / 2 - (data_size / 2) % frame_size;
+
+	BeginUpdate();
+	header->serial.fetch_add(1, std::memory_order_relaxed);
+	header->sample_rate.store(audio_format.sample_rate,
+				  std::memory_order_relaxed);
+	header->sample_format.store(uint8_t(audio_format.format),
+				    std::memory_order_relaxed);
+	header->channels.store(audio_format.channels,
+			       std::memory_order_relaxed);
+	header->frame_size.store(frame_size,
+				 std::memory_order_relaxed);
+	header->playing.store(1, std::memory_order_relaxed);
+	EndUpdate();
+
+	FormatDebug(shm_output_domain, "Opened \"%s\"", path_utf8.c_str());
+}
+
+void
+ShmOutput::Close() noexcept
+{
+	BeginUpdate();
+	header->playing.store(0, std::memory_order_relaxed);
+	EndUpdate();
+
+	delete timer;
+}
+
+void
+ShmOutput::Cancel() noexcept
+{
+	timer->Reset();
+
+	/* tell consumers to drop everything they have buffered */
+	BeginUpdate();
+	header->serial.fetch_add(1, std::memory_order_relaxed);
+	EndUpdate();
+}
+
+std::chrono::steady_clock::duration
+ShmOutput::Delay() const noexcept
+{
+	return timer->IsStarted()
+		? timer->GetDelay()
+		: std::chrono::steady_clock::duration::zero();
+}
+
+size_t
+ShmOutput::Play(const void *chunk, size_t size)
+{
+	/* never write more than half of the ring at a time, to give
+	   consumers a chance */
+	size = std::min(size, max_play);
+
+	if (!timer->IsStarted())
+		timer->Start();
+	timer->Add(size);
+
+	/* copy the data into the ring (consumers read it in place,
+	   without another copy) */
+	const size_t offset = write_position % data_size;
+	const size_t first = std::min(size, data_size - offset);
+	memcpy(data + offset, chunk, first);
+	if (first < size)
+		memcpy(data, (const uint8_t *)chunk + first, size - first);
+
+	write_position += size;
+
+	BeginUpdate();
+	header->write_position.store(write_position,
+				     std::memory_order_relaxed);
+	EndUpdate();
+
+	return size;
+}
+
+const struct AudioOutputPlugin shm_output_plugin = {
+	"shm",
+	nullptr,
+	&ShmOutput::Create,
+	nullptr,
+};
@@ -26,12 +26,20 @@
 #include "util/ScopeExit.hxx"
 #include "util/StringAPI.hxx"
 #include "util/StringFormat.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/ConstBuffer.hxx"
+#include "AudioFormat.hxx"
 #include "Log.hxx"
 
 #include <shout/shout.h>
 
 #include <stdexcept>
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
 
 #include <assert.h>
 #include <stdlib.h>
@@ -40,14 +48,87 @@
 
 static constexpr unsigned DEFAULT_CONN_TIMEOUT = 2;
 
+static constexpr unsigned DEFAULT_JITTER_BUFFER_SIZE = 256 * 1024;
+
+/**
+ * How long to wait before reconnecting after the connection was
+ * lost (non-blocking mode only).
+ */
+static constexpr std::chrono::steady_clock::duration SHOUT_RECONNECT_INTERVAL =
+	std::chrono::seconds(5);
+
+/**
+ * If the output thread falls behind the pacing clock by more than
+ * this, the clock is reset instead of catching up in a burst.
+ */
+static constexpr std::chrono::steady_clock::duration SHOUT_MAX_CLOCK_LAG =
+	std::chrono::seconds(1);
+
 struct ShoutOutput final : AudioOutput {
 	shout_t *shout_conn;
 
 	std::unique_ptr<PreparedEncoder> prepared_encoder;
+
+	/**
+	 * In non-blocking mode, this is nullptr after the connection
+	 * was lost; the encoder is reopened when the connection is
+	 * established again, so the new stream begins with fresh
+	 * headers.
+	 */
 	Encoder *encoder;
 
 	int timeout = DEFAULT_CONN_TIMEOUT;
 
+	/**
+	 * Use libshout's non-blocking mode?  Encoded data is then
+	 * queued in #jitter_buffer, and the output thread never waits
+	 * for the network.
+	 */
+	const bool nonblocking;
+
+	/**
+	 * The maximum number of bytes in #jitter_buffer.  If the
+	 * server cannot keep up, the oldest chunks are dropped.
+	 */
+	const size_t jitter_buffer_limit;
+
+	AudioFormat audio_format;
+
+	/**
+	 * Encoded chunks which have not yet been passed to libshout
+	 * (non-blocking mode only).
+	 */
+	std::deque<AllocatedArray<uint8_t>> jitter_buffer;
+
+	/**
+	 * The total size of #jitter_buffer in bytes.
+	 */
+	size_t jitter_buffer_size = 0;
+
+	/**
+	 * Non-blocking mode only: has the connection been
+	 * established?  Until then, PCM data is discarded.
+	 */
+	bool connected;
+
+	/**
+	 * The earliest time for the next connection attempt
+	 * (non-blocking mode only).
+	 */
+	std::chrono::steady_clock::time_point reconnect_time;
+
+	/**
+	 * The pacing clock for non-blocking mode: Delay() lets the
+	 * output thread submit PCM data at the rate it is played.
+	 */
+	std::chrono::steady_clock::time_point clock_start;
+	std::uintmax_t clock_size;
+
+	/* statistics for GetAttributes() */
+	std::atomic<size_t> buffer_bytes{0};
+	std::atomic<std::uintmax_t> dropped_bytes{0};
+	std::atomic<unsigned> n_reconnects{0};
+
 	uint8_t buffer[32768];
 
 	explicit ShoutOutput(const ConfigBlock &block);
@@ -65,8 +146,46 @@ struct ShoutOutput final : AudioOutput {
 	void Cancel() noexcept override;
 	bool Pause() override;
 
+	const std::map<std::string, std::string> GetAttributes() const noexcept override;
+
 private:
 	void WritePage();
+
+	/**
+	 * Submit PCM data to the encoder (non-blocking mode).
+	 */
+	void NonBlockingWrite(const void *chunk, size_t size);
+
+	/**
+	 * Move all data from the encoder to #jitter_buffer, dropping
+	 * the oldest chunks if it grows beyond the limit.
+	 */
+	void EncoderToJitterBuffer();
+
+	void ClearJitterBuffer() noexcept;
+
+	/**
+	 * Try to establish the connection without blocking.
+	 *
+	 * Throws if reopening the encoder fails.
+	 *
+	 * @return true if the connection is established
+	 */
+	bool NonBlockingConnect();
+
+	/**
+	 * Pass as much of #jitter_buffer to libshout as it can send
+	 * without blocking.
+	 */
+	void Flush();
+
+	/**
+	 * Close the connection after an error and schedule a
+	 * reconnect.
+	 */
+	void ConnectionLost() noexcept;
+
+	void AdvanceClock(size_t size) noexcept;
 };
 
 static int shout_init_count;
@@ -97,7 +216,10 @@ ShoutSetAudioInfo(shout_t *shout_conn, const AudioFormat &audio_format)
 ShoutOutput::ShoutOutput(const ConfigBlock &block)
 	:AudioOutput(FLAG_PAUSE|FLAG_NEED_FULLY_DEFINED_AUDIO_FORMAT),
 	 shout_conn(shout_new()),
-	 prepared_encoder(CreateConfiguredEncoder(block, true))
+	 prepared_encoder(CreateConfiguredEncoder(block, true)),
+	 nonblocking(block.GetBlockValue("nonblocking", false)),
+	 jitter_buffer_limit(block.GetPositiveValue("jitter_buffer_size",
+						    DEFAULT_JITTER_BUFFER_SIZE))
 {
 	const char *host = require_block_string(block, "host");
 	const char *mount = require_block_string(block, "mount");
@@ -178,6 +300,10 @@ ShoutOutput::ShoutOutput(const ConfigBlock &block)
 	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS)
 		throw std::runtime_error(shout_get_error(shout_conn));
 
+	if (nonblocking &&
+	    shout_set_nonblocking(shout_conn, 1) != SHOUTERR_SUCCESS)
+		throw std::runtime_error(shout_get_error(shout_conn));
+
 	/* optional paramters */
 	timeout = block.GetBlockValue("timeout", DEFAULT_CONN_TIMEOUT);
 
@@ -250,6 +376,16 @@ EncoderToShout(shout_t *shout_conn, Encoder &encoder,
 	       unsigned char *buffer, size_t buffer_size)
 {
 	while (true) {
+		auto r = encoder.Peek();
+		if (!r.empty()) {
+			int err = shout_send(shout_conn,
+					     (const unsigned char *)r.data,
+					     r.size);
+			HandleShoutError(shout_conn, err);
+			encoder.Consume(r.size);
+			continue;
+		}
+
 		size_t nbytes = encoder.Read(buffer, buffer_size);
 		if (nbytes == 0)
 			return;
@@ -259,26 +395,242 @@ EncoderToShout(shout_t *shout_conn, Encoder &encoder,
 	}
 }
 
+/**
+ * Did shout_send() succeed?  In non-blocking mode, SHOUTERR_BUSY
+ * means the data was queued by libshout.
+ */
+static constexpr bool
+IsShoutSendSuccess(int err) noexcept
+{
+	return err == SHOUTERR_SUCCESS || err == SHOUTERR_BUSY;
+}
+
 void
 ShoutOutput::WritePage()
 {
+	if (nonblocking) {
+		if (encoder == nullptr)
+			return;
+
+		EncoderToJitterBuffer();
+		Flush();
+		return;
+	}
+
 	assert(encoder != nullptr);
 
 	EncoderToShout(shout_conn, *encoder, buffer, sizeof(buffer));
 }
 
+void
+ShoutOutput::EncoderToJitterBuffer()
+{
+	assert(encoder != nullptr);
+
+	while (true) {
+		ConstBuffer<uint8_t> src;
+
+		auto r = encoder->Peek();
+		if (r.empty()) {
+			size_t nbytes = encoder->Read(buffer, sizeof(buffer));
+			if (nbytes == 0)
+				break;
+
+			src = {buffer, nbytes};
+		} else
+			src = ConstBuffer<uint8_t>::FromVoid(r);
+
+		AllocatedArray<uint8_t> chunk(src.size);
+		std::copy_n(src.data, src.size, chunk.begin());
+		jitter_buffer.emplace_back(std::move(chunk));
+		jitter_buffer_size += src.size;
+
+		if (!r.empty())
+			encoder->Consume(r.size);
+	}
+
+	/* the server cannot keep up: drop the oldest chunks (but
+	   never the newest one) */
+	while (jitter_buffer_size > jitter_buffer_limit &&
+	       jitter_buffer.size() > 1) {
+		const size_t size = jitter_buffer.front().size();
+		jitter_buffer.pop_front();
+		jitter_buffer_size -= size;
+		dropped_bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	buffer_bytes.store(jitter_buffer_size, std::memory_order_relaxed);
+}
+
+void
+ShoutOutput::ClearJitterBuffer() noexcept
+{
+	dropped_bytes.fetch_add(jitter_buffer_size,
+				std::memory_order_relaxed);
+	jitter_buffer.clear();
+	jitter_buffer_size = 0;
+	buffer_bytes.store(0, std::memory_order_relaxed);
+}
+
+bool
+ShoutOutput::NonBlockingConnect()
+{
+	assert(nonblocking);
+	assert(!connected);
+
+	const auto now = std::chrono::steady_clock::now();
+
+	switch (int err = shout_get_connected(shout_conn)) {
+	case SHOUTERR_CONNECTED:
+		break;
+
+	case SHOUTERR_BUSY:
+		/* still connecting */
+		return false;
+
+	case SHOUTERR_UNCONNECTED:
+		if (now < reconnect_time)
+			return false;
+
+		reconnect_time = now + SHOUT_RECONNECT_INTERVAL;
+		n_reconnects.fetch_add(1, std::memory_order_relaxed);
+
+		err = shout_open(shout_conn);
+		if (err == SHOUTERR_BUSY)
+			return false;
+
+		if (err != SHOUTERR_SUCCESS && err != SHOUTERR_CONNECTED) {
+			FormatWarning(shout_output_domain,
+				      "problem opening connection to shout server %s:%i: %s",
+				      shout_get_host(shout_conn),
+				      shout_get_port(shout_conn),
+				      shout_get_error(shout_conn));
+			return false;
+		}
+
+		break;
+
+	default:
+		/* the connection attempt has failed */
+		FormatWarning(shout_output_domain,
+			      "problem opening connection to shout server %s:%i: %s",
+			      shout_get_host(shout_conn),
+			      shout_get_port(shout_conn),
+			      shout_get_error(shout_conn));
+		shout_close(shout_conn);
+		reconnect_time = now + SHOUT_RECONNECT_INTERVAL;
+		return false;
+	}
+
+	connected = true;
+
+	if (encoder == nullptr) {
+		/* this is a reconnect: start a new stream */
+		auto format = audio_format;
+		encoder = prepared_encoder->Open(format);
+		EncoderToJitterBuffer();
+	}
+
+	return true;
+}
+
+void
+ShoutOutput::Flush()
+{
+	assert(nonblocking);
+
+	if (!connected && !NonBlockingConnect())
+		return;
+
+	/* a zero-length shout_send() submits the data queued inside
+	   libshout */
+	if (!IsShoutSendSuccess(shout_send(shout_conn, nullptr, 0))) {
+		ConnectionLost();
+		return;
+	}
+
+	while (!jitter_buffer.empty() && shout_queuelen(shout_conn) == 0) {
+		const auto &chunk = jitter_buffer.front();
+		int err = shout_send(shout_conn, &chunk.front(), chunk.size());
+		jitter_buffer_size -= chunk.size();
+		jitter_buffer.pop_front();
+
+		if (!IsShoutSendSuccess(err)) {
+			ConnectionLost();
+			return;
+		}
+	}
+
+	buffer_bytes.store(jitter_buffer_size, std::memory_order_relaxed);
+}
+
+void
+ShoutOutput::ConnectionLost() noexcept
+{
+	FormatWarning(shout_output_domain,
+		      "Lost shout connection to %s:%i: %s",
+		      shout_get_host(shout_conn),
+		      shout_get_port(shout_conn),
+		      shout_get_error(shout_conn));
+
+	shout_close(shout_conn);
+	connected = false;
+	reconnect_time = std::chrono::steady_clock::now() +
+		SHOUT_RECONNECT_INTERVAL;
+
+	ClearJitterBuffer();
+
+	delete encoder;
+	encoder = nullptr;
+}
+
+void
+ShoutOutput::AdvanceClock(size_t size) noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+	const auto due = clock_start +
+		audio_format.SizeToTime<std::chrono::steady_clock::duration>(clock_size);
+	if (now > due + SHOUT_MAX_CLOCK_LAG) {
+		clock_start = now;
+		clock_size = 0;
+	}
+
+	clock_size += size;
+}
+
+void
+ShoutOutput::NonBlockingWrite(const void *chunk, size_t size)
+{
+	AdvanceClock(size);
+
+	if (!connected)
+		/* try to (re)connect */
+		Flush();
+
+	/* if not connected, the PCM data is discarded, but the
+	   pacing clock keeps running */
+	if (connected) {
+		encoder->Write(chunk, size);
+		WritePage();
+	}
+}
+
 void
 ShoutOutput::Close() noexcept
 {
 	try {
-		encoder->End();
-		WritePage();
+		if (encoder != nullptr && (!nonblocking || connected)) {
+			encoder->End();
+			WritePage();
+		}
 	} catch (...) {
 		/* ignore */
 	}
 
 	delete encoder;
 
+	ClearJitterBuffer();
+
 	if (shout_get_connected(shout_conn) != SHOUTERR_UNCONNECTED &&
 	    shout_close(shout_conn) != SHOUTERR_SUCCESS) {
 		FormatWarning(shout_output_domain,
@@ -301,6 +653,11 @@ ShoutOpen(shout_t *shout_conn)
 	case SHOUTERR_CONNECTED:
 		break;
 
+	case SHOUTERR_BUSY:
+		/* non-blocking mode: the connection will be
+		   established later */
+		break;
+
 	default:
 		throw FormatRuntimeError("problem opening connection to shout server %s:%i: %s",
 					 shout_get_host(shout_conn),
@@ -310,13 +667,22 @@ ShoutOpen(shout_t *shout_conn)
 }
 
 void
-ShoutOutput::Open(AudioFormat &audio_format)
+ShoutOutput::Open(AudioFormat &_audio_format)
 {
-	encoder = prepared_encoder->Open(audio_format);
+	encoder = prepared_encoder->Open(_audio_format);
+	audio_format = _audio_format;
 
 	try {
 		ShoutSetAudioInfo(shout_conn, audio_format);
 		ShoutOpen(shout_conn);
+
+		if (nonblocking) {
+			connected = false;
+			reconnect_time = std::chrono::steady_clock::time_point::min();
+			clock_start = std::chrono::steady_clock::now();
+			clock_size = 0;
+		}
+
 		WritePage();
 	} catch (...) {
 		delete encoder;
@@ -327,6 +693,15 @@ ShoutOutput::Open(AudioFormat &audio_format)
 std::chrono::steady_clock::duration
 ShoutOutput::Delay() const noexcept
 {
+	if (nonblocking) {
+		const auto due = clock_start +
+			audio_format.SizeToTime<std::chrono::steady_clock::duration>(clock_size);
+		const auto now = std::chrono::steady_clock::now();
+		return due > now
+			? due - now
+			: std::chrono::steady_clock::duration::zero();
+	}
+
 	int delay = shout_delay(shout_conn);
 	if (delay < 0)
 		delay = 0;
@@ -337,6 +712,11 @@ ShoutOutput::Delay() const noexcept
 size_t
 ShoutOutput::Play(const void *chunk, size_t size)
 {
+	if (nonblocking) {
+		NonBlockingWrite(chunk, size);
+		return size;
+	}
+
 	encoder->Write(chunk, size);
 	WritePage();
 	return size;
@@ -347,6 +727,11 @@ ShoutOutput::Pause()
 {
 	static char silence[1020];
 
+	if (nonblocking) {
+		NonBlockingWrite(silence, sizeof(silence));
+		return true;
+	}
+
 	encoder->Write(silence, sizeof(silence));
 	WritePage();
 
@@ -367,6 +752,10 @@ shout_tag_to_metadata(const Tag &tag, char *dest, size_t size)
 void
 ShoutOutput::SendTag(const Tag &tag)
 {
+	if (encoder == nullptr)
+		/* non-blocking mode: not connected; the tag is lost */
+		return;
+
 	if (encoder->ImplementsTag()) {
 		/* encoder plugin supports stream tags */
 
@@ -392,6 +781,24 @@ ShoutOutput::SendTag(const Tag &tag)
 	WritePage();
 }
 
+const std::map<std::string, std::string>
+ShoutOutput::GetAttributes() const noexcept
+{
+	if (!nonblocking)
+		return {};
+
+	return {
+		std::make_pair("buffer_bytes",
+			       std::to_string(buffer_bytes.load(std::memory_order_relaxed))),
+		std::make_pair("buffer_limit",
+			       std::to_string(jitter_buffer_limit)),
+		std::make_pair("dropped_bytes",
+			       std::to_string(dropped_bytes.load(std::memory_order_relaxed))),
+		std::make_pair("reconnects",
+			       std::to_string(n_reconnects.load(std::memory_order_relaxed))),
+	};
+}
+
 const struct AudioOutputPlugin shout_output_plugin = {
 	"shout",
 	nullptr,
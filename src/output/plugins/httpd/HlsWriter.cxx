@@ -0,0 +1,193 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "HlsWriter.hxx"
+#include "AudioFormat.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringFormat.hxx"
+#include "util/Compiler.h"
+#include "Log.hxx"
+
+#include <math.h>
+
+HlsWriter::HlsWriter(AllocatedPath &&_directory,
+		     std::chrono::seconds _segment_duration,
+		     unsigned _list_size) noexcept
+	:directory(std::move(_directory)),
+	 segment_duration(_segment_duration),
+	 list_size(_list_size)
+{
+}
+
+HlsWriter::~HlsWriter() noexcept = default;
+
+gcc_pure
+static const char *
+MimeTypeToSuffix(const char *mime_type) noexcept
+{
+	if (mime_type == nullptr)
+		return "bin";
+
+	if (StringStartsWith(mime_type, "audio/mpeg"))
+		return "mp3";
+
+	if (StringStartsWith(mime_type, "audio/aac"))
+		return "aac";
+
+	if (StringStartsWith(mime_type, "audio/ogg"))
+		return "ogg";
+
+	if (StringStartsWith(mime_type, "audio/flac"))
+		return "flac";
+
+	if (StringStartsWith(mime_type, "audio/wav"))
+		return "wav";
+
+	return "bin";
+}
+
+void
+HlsWriter::Open(const AudioFormat &audio_format,
+		const char *mime_type) noexcept
+{
+	suffix = MimeTypeToSuffix(mime_type);
+	input_per_second = audio_format.TimeToSize(std::chrono::seconds(1));
+	header.reset();
+
+	/* the new stream does not continue the segments written
+	   before */
+	discontinuity = !segments.empty();
+}
+
+void
+HlsWriter::Close() noexcept
+{
+	try {
+		if (file)
+			FinishSegment();
+
+		if (!segments.empty())
+			WritePlaylist(true);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to finish HLS playlist");
+		file.reset();
+	}
+
+	header.reset();
+}
+
+AllocatedPath
+HlsWriter::GetSegmentPath(unsigned sequence) const noexcept
+{
+	const auto name = StringFormat<64>("segment-%u.%s",
+					   sequence, suffix);
+	return AllocatedPath::Build(directory,
+				    AllocatedPath::FromUTF8(name.c_str()));
+}
+
+inline void
+HlsWriter::StartSegment()
+{
+	file.reset(new FileOutputStream(GetSegmentPath(next_sequence)));
+	input = 0;
+
+	if (header != nullptr)
+		file->Write(header->GetData(), header->GetSize());
+}
+
+void
+HlsWriter::FinishSegment()
+{
+	file->Commit();
+	file.reset();
+
+	segments.push_back({next_sequence++,
+			    double(input) / input_per_second,
+			    discontinuity});
+	discontinuity = false;
+
+	while (segments.size() > list_size) {
+		/* keep the segment file for another playlist length,
+		   because clients which have just loaded the previous
+		   playlist may still request it */
+		const unsigned old = segments.front().sequence;
+		segments.pop_front();
+
+		if (old >= list_size) {
+			try {
+				RemoveFile(GetSegmentPath(old - list_size));
+			} catch (...) {
+				/* ignore - it may have been deleted
+				   already */
+			}
+		}
+	}
+
+	WritePlaylist(false);
+}
+
+void
+HlsWriter::Add(const Page &page, size_t page_input)
+{
+	if (!file)
+		StartSegment();
+
+	file->Write(page.GetData(), page.GetSize());
+	input += page_input;
+
+	if (input >= segment_duration.count() * input_per_second)
+		FinishSegment();
+}
+
+void
+HlsWriter::WritePlaylist(bool end)
+{
+	double max_duration = 0;
+	for (const auto &i : segments)
+		if (i.duration > max_duration)
+			max_duration = i.duration;
+
+	FileOutputStream fos(AllocatedPath::Build(directory,
+						  PATH_LITERAL("stream.m3u8")));
+	BufferedOutputStream os(fos);
+
+	os.Write("#EXTM3U\n"
+		 "#EXT-X-VERSION:3\n");
+	os.Format("#EXT-X-TARGETDURATION:%u\n", unsigned(ceil(max_duration)));
+	os.Format("#EXT-X-MEDIA-SEQUENCE:%u\n", segments.front().sequence);
+
+	for (const auto &i : segments) {
+		if (i.discontinuity)
+			os.Write("#EXT-X-DISCONTINUITY\n");
+
+		os.Format("#EXTINF:%.3f,\nsegment-%u.%s\n",
+			  i.duration, i.sequence, suffix);
+	}
+
+	if (end)
+		os.Write("#EXT-X-ENDLIST\n");
+
+	os.Flush();
+	fos.Commit();
+}
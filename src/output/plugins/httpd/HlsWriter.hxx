@@ -0,0 +1,158 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_HLS_WRITER_HXX
+#define MPD_HLS_WRITER_HXX
+
+#include "Page.hxx"
+#include "fs/AllocatedPath.hxx"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+
+#include <stddef.h>
+
+struct AudioFormat;
+class FileOutputStream;
+
+/**
+ * Cuts the encoder output of #HttpdOutput into segments of a fixed
+ * duration and writes them into a directory, together with a
+ * rolling HTTP Live Streaming playlist.  The directory is supposed
+ * to be served by a regular web server (or a CDN), which takes care
+ * of the fan-out to a large number of listeners.
+ *
+ * Each segment begins with the encoder's header page, so it can be
+ * decoded on its own.
+ */
+class HlsWriter {
+	const AllocatedPath directory;
+
+	const std::chrono::seconds segment_duration;
+
+	/**
+	 * The number of segments listed in the playlist.
+	 */
+	const unsigned list_size;
+
+	/**
+	 * The file name suffix of segment files.
+	 */
+	const char *suffix;
+
+	/**
+	 * The number of PCM bytes per second.
+	 */
+	size_t input_per_second;
+
+	struct Segment {
+		unsigned sequence;
+
+		double duration;
+
+		/**
+		 * Does this segment follow a gap, e.g. because the
+		 * output was closed and reopened?
+		 */
+		bool discontinuity;
+	};
+
+	/**
+	 * The segments currently listed in the playlist.
+	 */
+	std::deque<Segment> segments;
+
+	/**
+	 * The sequence number of the next segment.
+	 */
+	unsigned next_sequence = 0;
+
+	PagePtr header;
+
+	/**
+	 * The segment file currently being written, or nullptr if no
+	 * page has been added since the last segment was finished.
+	 */
+	std::unique_ptr<FileOutputStream> file;
+
+	/**
+	 * The number of PCM bytes which have been encoded into
+	 * #file.
+	 */
+	size_t input;
+
+	/**
+	 * Shall the next segment be marked as discontinuity?
+	 */
+	bool discontinuity = false;
+
+public:
+	HlsWriter(AllocatedPath &&_directory,
+		  std::chrono::seconds _segment_duration,
+		  unsigned _list_size) noexcept;
+
+	~HlsWriter() noexcept;
+
+	HlsWriter(const HlsWriter &) = delete;
+	HlsWriter &operator=(const HlsWriter &) = delete;
+
+	/**
+	 * Prepare for a new stream.
+	 *
+	 * @param mime_type the MIME type produced by the encoder; it
+	 * determines the segment file name suffix
+	 */
+	void Open(const AudioFormat &audio_format,
+		  const char *mime_type) noexcept;
+
+	/**
+	 * Finish the current segment and mark the playlist as
+	 * complete.  Errors are logged.
+	 */
+	void Close() noexcept;
+
+	/**
+	 * Set the page which starts every new segment.
+	 */
+	void SetHeader(const PagePtr &_header) noexcept {
+		header = _header;
+	}
+
+	/**
+	 * Append an encoded page to the current segment, and finish
+	 * the segment when it has reached the configured duration.
+	 *
+	 * Throws on I/O error.
+	 *
+	 * @param page_input the number of PCM bytes which were
+	 * encoded to produce this page
+	 */
+	void Add(const Page &page, size_t page_input);
+
+private:
+	AllocatedPath GetSegmentPath(unsigned sequence) const noexcept;
+
+	void StartSegment();
+	void FinishSegment();
+	void WritePlaylist(bool end);
+};
+
+#endif
@@ -27,10 +27,16 @@
 #include "net/UniqueSocketDescriptor.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 HttpdClient::~HttpdClient() noexcept
 {
 	if (IsDefined())
@@ -161,11 +167,12 @@ HttpdClient::SendResponse() noexcept
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput &_httpd, UniqueSocketDescriptor _fd,
+HttpdClient::HttpdClient(HttpdOutput &_httpd, HttpdWorker &_worker,
+			 UniqueSocketDescriptor _fd,
 			 EventLoop &_loop,
 			 bool _metadata_supported)
 	:BufferedSocket(_fd.Release(), _loop),
-	 httpd(_httpd),
+	 httpd(_httpd), worker(_worker),
 	 metadata_supported(_metadata_supported)
 {
 }
@@ -182,7 +189,7 @@ HttpdClient::ClearQueue() noexcept
 		queue_size -= page->GetSize();
 #endif
 
-		pages.pop();
+		pages.pop_front();
 	}
 
 	assert(queue_size == 0);
@@ -200,32 +207,151 @@ HttpdClient::CancelQueue() noexcept
 		CancelWrite();
 }
 
-ssize_t
-HttpdClient::TryWritePage(const Page &page, size_t position) noexcept
+/**
+ * One buffer of a batch written by HttpdClient::TryWrite().
+ */
+struct HttpdClient::Segment {
+	enum class Type : uint8_t {
+		/**
+		 * Stream data from a #Page.
+		 */
+		DATA,
+
+		/**
+		 * The pending Icy-Metadata block.
+		 */
+		METADATA,
+
+		/**
+		 * An empty Icy-Metadata block (one null byte).
+		 */
+		EMPTY_METADATA,
+	} type;
+
+	const uint8_t *data;
+	size_t size;
+};
+
+size_t
+HttpdClient::CollectSegments(Segment *v, size_t max) const noexcept
 {
-	assert(position < page.GetSize());
+	static constexpr uint8_t empty_metadata = 0;
+
+	bool metadata_pending = !metadata_sent;
+	size_t fill = metadata_fill;
+	size_t n = 0;
+
+	const Page *page = current_page.get();
+	size_t position = current_position;
+	auto next = pages.begin();
 
-	return GetSocket().Write(page.GetData() + position,
-				 page.GetSize() - position);
+	while (n < max) {
+		if (position >= page->GetSize()) {
+			if (next == pages.end())
+				break;
+
+			page = next->get();
+			++next;
+			position = 0;
+			continue;
+		}
+
+		if (metadata_requested && fill >= metaint) {
+			/* insert a metadata block; the first one
+			   carries the pending metadata, all others are
+			   empty */
+			if (metadata_pending) {
+				v[n++] = {Segment::Type::METADATA,
+					  metadata->GetData() + metadata_current_position,
+					  metadata->GetSize() - metadata_current_position};
+				metadata_pending = false;
+			} else
+				v[n++] = {Segment::Type::EMPTY_METADATA,
+					  &empty_metadata, 1};
+
+			fill = 0;
+			continue;
+		}
+
+		size_t size = page->GetSize() - position;
+		if (metadata_requested && size > metaint - fill)
+			size = metaint - fill;
+
+		v[n++] = {Segment::Type::DATA, page->GetData() + position, size};
+		position += size;
+		fill += size;
+	}
+
+	return n;
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page,
-			   size_t position, ssize_t n) noexcept
+HttpdClient::WriteSegments(const Segment *v, size_t n) noexcept
 {
-	return n >= 0
-		? GetSocket().Write(page.GetData() + position, n)
-		: TryWritePage(page, position);
+	assert(n > 0);
+
+#ifdef _WIN32
+	(void)n;
+	return GetSocket().Write(v[0].data, v[0].size);
+#else
+	struct iovec iov[MAX_SEGMENTS];
+	assert(n <= MAX_SEGMENTS);
+
+	for (size_t i = 0; i < n; ++i) {
+		iov[i].iov_base = const_cast<uint8_t *>(v[i].data);
+		iov[i].iov_len = v[i].size;
+	}
+
+	return GetSocket().Write(iov, n);
+#endif
 }
 
-ssize_t
-HttpdClient::GetBytesTillMetaData() const noexcept
+void
+HttpdClient::ConsumeSegments(const Segment *v, size_t n,
+			     size_t nbytes) noexcept
 {
-	if (metadata_requested &&
-	    current_page->GetSize() - current_position > metaint - metadata_fill)
-		return metaint - metadata_fill;
+	for (size_t i = 0; i < n && nbytes > 0; ++i) {
+		const auto &segment = v[i];
+		const size_t consumed = std::min(nbytes, segment.size);
+		nbytes -= consumed;
+
+		switch (segment.type) {
+		case Segment::Type::DATA:
+			while (current_position >= current_page->GetSize()) {
+				/* this segment belongs to the next
+				   page */
+				assert(!pages.empty());
+				current_page = std::move(pages.front());
+				pages.pop_front();
+				current_position = 0;
+
+				assert(queue_size >= current_page->GetSize());
+				queue_size -= current_page->GetSize();
+			}
+
+			current_position += consumed;
+			assert(current_position <= current_page->GetSize());
+
+			if (metadata_requested)
+				metadata_fill += consumed;
+			break;
+
+		case Segment::Type::METADATA:
+			metadata_current_position += consumed;
+
+			if (metadata->GetSize() - metadata_current_position == 0) {
+				metadata_fill = 0;
+				metadata_current_position = 0;
+				metadata_sent = true;
+			}
+			break;
 
-	return -1;
+		case Segment::Type::EMPTY_METADATA:
+			metadata_fill = 0;
+			metadata_current_position = 0;
+			break;
+		}
+	}
 }
 
 inline bool
@@ -244,99 +370,47 @@ HttpdClient::TryWrite() noexcept
 			return true;
 		}
 
-		current_page = pages.front();
-		pages.pop();
+		current_page = std::move(pages.front());
+		pages.pop_front();
 		current_position = 0;
 
 		assert(queue_size >= current_page->GetSize());
 		queue_size -= current_page->GetSize();
 	}
 
-	const ssize_t bytes_to_write = GetBytesTillMetaData();
-	if (bytes_to_write == 0) {
-		if (!metadata_sent) {
-			ssize_t nbytes = TryWritePage(*metadata,
-						      metadata_current_position);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
+	/* send as many queued pages (and the metadata blocks between
+	   them) as possible with one system call */
 
-			metadata_current_position += nbytes;
+	Segment segments[MAX_SEGMENTS];
+	const size_t n_segments = CollectSegments(segments, MAX_SEGMENTS);
+	assert(n_segments > 0);
 
-			if (metadata->GetSize() - metadata_current_position == 0) {
-				metadata_fill = 0;
-				metadata_current_position = 0;
-				metadata_sent = true;
-			}
-		} else {
-			char empty_data = 0;
-
-			ssize_t nbytes = GetSocket().Write(&empty_data, 1);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
-
-			metadata_fill = 0;
-			metadata_current_position = 0;
-		}
-	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
-		if (nbytes < 0) {
-			auto e = GetSocketError();
-			if (IsSocketErrorAgain(e))
-				return true;
-
-			if (!IsSocketErrorClosed(e)) {
-				SocketErrorMessage msg(e);
-				FormatWarning(httpd_output_domain,
-					      "failed to write to client: %s",
-					      (const char *)msg);
-			}
+	const ssize_t nbytes = WriteSegments(segments, n_segments);
+	if (nbytes < 0) {
+		auto e = GetSocketError();
+		if (IsSocketErrorAgain(e))
+			return true;
 
-			Close();
-			return false;
+		if (!IsSocketErrorClosed(e)) {
+			SocketErrorMessage msg(e);
+			FormatWarning(httpd_output_domain,
+				      "failed to write to client: %s",
+				      (const char *)msg);
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->GetSize());
+		Close();
+		return false;
+	}
 
-		if (metadata_requested)
-			metadata_fill += nbytes;
+	ConsumeSegments(segments, n_segments, nbytes);
 
-		if (current_position >= current_page->GetSize()) {
-			current_page.reset();
+	if (current_position >= current_page->GetSize()) {
+		current_page.reset();
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (pages.empty())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
@@ -356,7 +430,7 @@ HttpdClient::PushPage(PagePtr page) noexcept
 	}
 
 	queue_size += page->GetSize();
-	pages.emplace(std::move(page));
+	pages.emplace_back(std::move(page));
 
 	ScheduleWrite();
 }
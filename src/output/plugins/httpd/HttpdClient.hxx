@@ -27,13 +27,14 @@
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
-#include <queue>
 #include <list>
 
 #include <stddef.h>
+#include <stdint.h>
 
 class UniqueSocketDescriptor;
 class HttpdOutput;
+class HttpdWorker;
 
 class HttpdClient final
 	: BufferedSocket,
@@ -43,6 +44,11 @@ class HttpdClient final
 	 */
 	HttpdOutput &httpd;
 
+	/**
+	 * The worker whose #EventLoop this client runs in.
+	 */
+	HttpdWorker &worker;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -60,7 +66,7 @@ class HttpdClient final
 	/**
 	 * A queue of #Page objects to be sent to the client.
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	std::list<PagePtr> pages;
 
 	/**
 	 * The sum of all page sizes in #pages.
@@ -128,9 +134,11 @@ class HttpdClient final
 public:
 	/**
 	 * @param httpd the HTTP output device
+	 * @param worker the worker whose #EventLoop shall be used
 	 * @param _fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput &httpd, UniqueSocketDescriptor _fd,
+	HttpdClient(HttpdOutput &httpd, HttpdWorker &worker,
+		    UniqueSocketDescriptor _fd,
 		    EventLoop &_loop,
 		    bool _metadata_supported);
 
@@ -147,6 +155,10 @@ public:
 
 	void LockClose() noexcept;
 
+	HttpdWorker &GetWorker() noexcept {
+		return worker;
+	}
+
 	/**
 	 * Clears the page queue.
 	 */
@@ -167,13 +179,6 @@ public:
 	 */
 	bool SendResponse() noexcept;
 
-	gcc_pure
-	ssize_t GetBytesTillMetaData() const noexcept;
-
-	ssize_t TryWritePage(const Page &page, size_t position) noexcept;
-	ssize_t TryWritePageN(const Page &page,
-			      size_t position, ssize_t n) noexcept;
-
 	bool TryWrite() noexcept;
 
 	/**
@@ -189,6 +194,31 @@ public:
 private:
 	void ClearQueue() noexcept;
 
+	/**
+	 * The maximum number of buffers passed to one sendmsg() call.
+	 */
+	static constexpr size_t MAX_SEGMENTS = 64;
+
+	struct Segment;
+
+	/**
+	 * Collect buffers from #current_page, #pages and the
+	 * Icy-Metadata blocks to be inserted between them.
+	 *
+	 * @return the number of segments
+	 */
+	gcc_pure
+	size_t CollectSegments(Segment *v, size_t max) const noexcept;
+
+	ssize_t WriteSegments(const Segment *v, size_t n) noexcept;
+
+	/**
+	 * Update the state after the given number of bytes of the
+	 * segments was sent.
+	 */
+	void ConsumeSegments(const Segment *v, size_t n,
+			     size_t nbytes) noexcept;
+
 protected:
 	/* virtual methods from class SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
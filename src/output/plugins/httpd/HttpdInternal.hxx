@@ -26,18 +26,19 @@
 #define MPD_OUTPUT_HTTPD_INTERNAL_H
 
 #include "HttpdClient.hxx"
+#include "HttpdWorker.hxx"
+#include "PagePool.hxx"
+#include "HlsWriter.hxx"
 #include "output/Interface.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "event/ServerSocket.hxx"
-#include "event/DeferEvent.hxx"
 #include "util/Cast.hxx"
 #include "util/Compiler.h"
 
-#include <boost/intrusive/list.hpp>
-
-#include <queue>
+#include <chrono>
+#include <deque>
 #include <list>
 #include <memory>
 
@@ -50,6 +51,8 @@ class Encoder;
 struct Tag;
 
 class HttpdOutput final : AudioOutput, ServerSocket {
+	friend class HttpdWorker;
+
 	/**
 	 * True if the audio output is open and accepts client
 	 * connections.
@@ -86,7 +89,7 @@ public:
 
 	/**
 	 * This condition gets signalled when an item is removed from
-	 * #pages.
+	 * HttpdWorker::pages.
 	 */
 	Cond cond;
 
@@ -107,15 +110,66 @@ private:
 	 */
 	PagePtr metadata;
 
+	struct BurstPage {
+		PagePtr page;
+
+		/**
+		 * The number of PCM bytes which were fed into the
+		 * encoder to produce this page.
+		 */
+		size_t input;
+
+		BurstPage(const PagePtr &_page, size_t _input) noexcept
+			:page(_page), input(_input) {}
+	};
+
+	/**
+	 * The most recent pages, which are sent to new clients right
+	 * after the #header, so their buffer fills up quickly.  This
+	 * is empty unless "burst_seconds" is configured.
+	 */
+	std::deque<BurstPage> burst;
+
+	/**
+	 * The sum of all BurstPage::input values in #burst.
+	 */
+	size_t burst_input = 0;
+
+	/**
+	 * The sum of all #Page sizes in #burst.
+	 */
+	size_t burst_size = 0;
+
+	/**
+	 * The configured "burst_seconds" setting.
+	 */
+	std::chrono::seconds burst_duration;
+
+	/**
+	 * The #burst_duration converted to PCM bytes of the current
+	 * audio format.  Initialized by Open().
+	 */
+	size_t burst_max_input;
+
+	/**
+	 * PCM bytes which were fed into the encoder since the last
+	 * page was read from it.
+	 */
+	size_t pending_input = 0;
+
 	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
+	 * Writes HTTP Live Streaming segments if "hls_directory" is
+	 * configured.
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	std::unique_ptr<HlsWriter> hls;
 
-	DeferEvent defer_broadcast;
+	/**
+	 * The workers which serve the clients; each of them has its
+	 * own page queue, which passes pages from the OutputThread to
+	 * the worker's #EventLoop.  Only one worker using our own
+	 * #EventLoop unless "worker_threads" is configured.
+	 */
+	std::list<HttpdWorker> workers;
 
  public:
 	/**
@@ -133,17 +187,16 @@ private:
 
 private:
 	/**
-	 * A linked list containing all clients which are currently
-	 * connected.
+	 * The number of clients which are currently connected to all
+	 * workers.
 	 */
-	boost::intrusive::list<HttpdClient,
-			       boost::intrusive::constant_time_size<true>> clients;
+	unsigned n_clients = 0;
 
 	/**
-	 * A temporary buffer for the httpd_output_read_page()
-	 * function.
+	 * Recycled pages which ReadPage() lets the encoder write
+	 * into.
 	 */
-	char buffer[32768];
+	PagePool page_pool;
 
 	/**
 	 * The maximum and current number of clients connected
@@ -196,7 +249,7 @@ public:
 	 */
 	gcc_pure
 	bool HasClients() const noexcept {
-		return !clients.empty();
+		return n_clients > 0;
 	}
 
 	/**
@@ -208,16 +261,15 @@ public:
 		return HasClients();
 	}
 
-	void AddClient(UniqueSocketDescriptor fd) noexcept;
-
 	/**
-	 * Removes a client from the httpd_output.clients linked list.
+	 * Removes a client from its worker's client list.
 	 */
 	void RemoveClient(HttpdClient &client) noexcept;
 
 	/**
-	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
+	 * Sends the encoder header and the #burst pages to the
+	 * client.  This is called right after the response headers
+	 * have been sent.
 	 */
 	void SendHeader(HttpdClient &client) const noexcept;
 
@@ -251,14 +303,38 @@ public:
 
 	size_t Play(const void *chunk, size_t size) override;
 
-	void CancelAllClients() noexcept;
-
 	void Cancel() noexcept override;
 	bool Pause() override;
 
 private:
-	/* DeferEvent callback */
-	void OnDeferredBroadcast() noexcept;
+	/**
+	 * Are there pages which have not yet been passed to the
+	 * clients?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	bool HasPendingPages() const noexcept;
+
+	/**
+	 * Append a page to #burst and discard old pages which
+	 * exceed the configured duration.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void AddBurstPage(const PagePtr &page, size_t input) noexcept;
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void ClearBurst() noexcept;
+
+	/**
+	 * Choose the worker with the fewest clients.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	HttpdWorker &GetIdleWorker() noexcept;
 
 	void OnAccept(UniqueSocketDescriptor fd,
 		      SocketAddress address, int uid) noexcept override;
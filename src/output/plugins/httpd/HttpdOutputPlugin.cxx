@@ -30,11 +30,14 @@
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "event/Call.hxx"
+#include "event/Thread.hxx"
 #include "util/Domain.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "Log.hxx"
 #include "config/Net.hxx"
 
+#include <iterator>
+
 #include <assert.h>
 
 #include <string.h>
@@ -47,7 +50,7 @@ HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
 	 ServerSocket(_loop),
 	 prepared_encoder(CreateConfiguredEncoder(block)),
-	 defer_broadcast(_loop, BIND_THIS_METHOD(OnDeferredBroadcast))
+	 page_pool(32768, 64)
 {
 	/* read configuration */
 	name = block.GetBlockValue("name", "Set name in config");
@@ -56,6 +59,24 @@ HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 
 	clients_max = block.GetBlockValue("max_clients", 0u);
 
+	burst_duration = std::chrono::seconds(block.GetBlockValue("burst_seconds",
+								  0u));
+
+	auto hls_directory = block.GetPath("hls_directory");
+	if (!hls_directory.IsNull()) {
+		const std::chrono::seconds segment_duration(block.GetPositiveValue("hls_segment_seconds", 6u));
+		hls.reset(new HlsWriter(std::move(hls_directory),
+					segment_duration,
+					block.GetPositiveValue("hls_list_size", 5u)));
+	}
+
+	const unsigned n_workers = block.GetBlockValue("worker_threads", 0u);
+	if (n_workers == 0)
+		workers.emplace_back(*this, _loop);
+	else
+		for (unsigned i = 0; i < n_workers; ++i)
+			workers.emplace_back(*this);
+
 	/* set up bind_to_address */
 
 	ServerSocketAddGeneric(*this, block.GetBlockValue("bind_to_address"), block.GetBlockValue("port", 8000u));
@@ -71,6 +92,9 @@ HttpdOutput::Bind()
 {
 	open = false;
 
+	for (auto &worker : workers)
+		worker.Start();
+
 	BlockingCall(GetEventLoop(), [this](){
 			ServerSocket::Open();
 		});
@@ -86,29 +110,99 @@ HttpdOutput::Unbind() noexcept
 		});
 }
 
-/**
- * Creates a new #HttpdClient object and adds it into the
- * HttpdOutput.clients linked list.
- */
-inline void
-HttpdOutput::AddClient(UniqueSocketDescriptor fd) noexcept
+HttpdWorker::HttpdWorker(HttpdOutput &_httpd, EventLoop &_loop) noexcept
+	:httpd(_httpd),
+	 defer(_loop, BIND_THIS_METHOD(OnDeferred))
 {
-	auto *client = new HttpdClient(*this, std::move(fd), GetEventLoop(),
-				       !encoder->ImplementsTag());
-	clients.push_front(*client);
+}
 
-	/* pass metadata to client */
-	if (metadata != nullptr)
-		clients.front().PushMetaData(metadata);
+HttpdWorker::HttpdWorker(HttpdOutput &_httpd)
+	:httpd(_httpd),
+	 thread(new EventThread(true)),
+	 defer(thread->GetEventLoop(), BIND_THIS_METHOD(OnDeferred))
+{
 }
 
+HttpdWorker::~HttpdWorker() noexcept = default;
+
 void
-HttpdOutput::OnDeferredBroadcast() noexcept
+HttpdWorker::Start()
 {
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
+	if (thread && !thread->GetEventLoop().IsAlive())
+		thread->Start();
+}
 
-	const std::lock_guard<Mutex> protect(mutex);
+void
+HttpdWorker::RemoveClient(HttpdClient &client) noexcept
+{
+	assert(!clients.empty());
+	assert(httpd.n_clients > 0);
+
+	clients.erase_and_dispose(clients.iterator_to(client),
+				  DeleteDisposer());
+	--httpd.n_clients;
+}
+
+void
+HttpdWorker::Cancel() noexcept
+{
+	const std::lock_guard<Mutex> protect(httpd.mutex);
+
+	while (!pages.empty())
+		pages.pop();
+
+	for (auto &client : clients)
+		client.CancelQueue();
+
+	httpd.cond.broadcast();
+}
+
+void
+HttpdWorker::Close() noexcept
+{
+	defer.Cancel();
+
+	const std::lock_guard<Mutex> protect(httpd.mutex);
+
+	assert(httpd.n_clients >= GetLoad());
+	httpd.n_clients -= GetLoad();
+
+	pending_sockets.clear();
+	clients.clear_and_dispose(DeleteDisposer());
+
+	while (!pages.empty())
+		pages.pop();
+
+	httpd.cond.broadcast();
+}
+
+void
+HttpdWorker::OnDeferred() noexcept
+{
+	/* this method runs in the worker's EventLoop; it creates
+	   HttpdClient objects for new connections and broadcasts
+	   pages from our queue to all clients */
+
+	const std::lock_guard<Mutex> protect(httpd.mutex);
+
+	while (!pending_sockets.empty()) {
+		auto fd = std::move(pending_sockets.front());
+		pending_sockets.pop_front();
+
+		if (!httpd.open) {
+			--httpd.n_clients;
+			continue;
+		}
+
+		auto *client = new HttpdClient(httpd, *this, std::move(fd),
+					       GetEventLoop(),
+					       !httpd.encoder->ImplementsTag());
+		clients.push_front(*client);
+
+		/* pass metadata to client */
+		if (httpd.metadata != nullptr)
+			client->PushMetaData(httpd.metadata);
+	}
 
 	while (!pages.empty()) {
 		PagePtr page = std::move(pages.front());
@@ -120,7 +214,30 @@ HttpdOutput::OnDeferredBroadcast() noexcept
 
 	/* wake up the client that may be waiting for the queue to be
 	   flushed */
-	cond.broadcast();
+	httpd.cond.broadcast();
+}
+
+bool
+HttpdOutput::HasPendingPages() const noexcept
+{
+	for (const auto &worker : workers)
+		if (!worker.pages.empty())
+			return true;
+
+	return false;
+}
+
+HttpdWorker &
+HttpdOutput::GetIdleWorker() noexcept
+{
+	assert(!workers.empty());
+
+	auto *best = &workers.front();
+	for (auto &worker : workers)
+		if (worker.GetLoad() < best->GetLoad())
+			best = &worker;
+
+	return *best;
 }
 
 void
@@ -133,8 +250,10 @@ HttpdOutput::OnAccept(UniqueSocketDescriptor fd,
 	const std::lock_guard<Mutex> protect(mutex);
 
 	/* can we allow additional client */
-	if (open && (clients_max == 0 || clients.size() < clients_max))
-		AddClient(std::move(fd));
+	if (open && (clients_max == 0 || n_clients < clients_max)) {
+		++n_clients;
+		GetIdleWorker().AddSocket(std::move(fd));
+	}
 }
 
 PagePtr
@@ -153,22 +272,30 @@ HttpdOutput::ReadPage()
 		unflushed_input = 0;
 	}
 
+	/* let the encoder write directly into a recycled page; if
+	   nothing was read, the page simply remains free in the
+	   pool */
+	PagePtr page = page_pool.Get();
+	uint8_t *const buffer = page->GetWriteBuffer();
+	const size_t capacity = page->GetCapacity();
+
 	size_t size = 0;
 	do {
 		size_t nbytes = encoder->Read(buffer + size,
-					      sizeof(buffer) - size);
+					      capacity - size);
 		if (nbytes == 0)
 			break;
 
 		unflushed_input = 0;
 
 		size += nbytes;
-	} while (size < sizeof(buffer));
+	} while (size < capacity);
 
 	if (size == 0)
 		return nullptr;
 
-	return std::make_shared<Page>(buffer, size);
+	page->SetSize(size);
+	return page;
 }
 
 inline void
@@ -188,7 +315,7 @@ void
 HttpdOutput::Open(AudioFormat &audio_format)
 {
 	assert(!open);
-	assert(clients.empty());
+	assert(!HasClients());
 
 	const std::lock_guard<Mutex> protect(mutex);
 
@@ -198,6 +325,13 @@ HttpdOutput::Open(AudioFormat &audio_format)
 
 	timer = new Timer(audio_format);
 
+	burst_max_input = audio_format.TimeToSize(burst_duration);
+
+	if (hls) {
+		hls->Open(audio_format, content_type);
+		hls->SetHeader(header);
+	}
+
 	open = true;
 	pause = false;
 }
@@ -210,32 +344,88 @@ HttpdOutput::Close() noexcept
 	delete timer;
 
 	BlockingCall(GetEventLoop(), [this](){
-			defer_broadcast.Cancel();
-
+			/* refuse new clients */
 			const std::lock_guard<Mutex> protect(mutex);
 			open = false;
-			clients.clear_and_dispose(DeleteDisposer());
 		});
 
+	for (auto &worker : workers)
+		BlockingCall(worker.GetEventLoop(), [&worker](){
+				worker.Close();
+			});
+
 	header.reset();
 
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		ClearBurst();
+	}
+
+	if (hls)
+		hls->Close();
+
 	delete encoder;
+
+	/* all clients are gone; release the memory of the recycled
+	   pages */
+	page_pool.Shrink();
 }
 
 void
 HttpdOutput::RemoveClient(HttpdClient &client) noexcept
 {
-	assert(!clients.empty());
-
-	clients.erase_and_dispose(clients.iterator_to(client),
-				  DeleteDisposer());
+	client.GetWorker().RemoveClient(client);
 }
 
 void
 HttpdOutput::SendHeader(HttpdClient &client) const noexcept
 {
+	const std::lock_guard<Mutex> protect(mutex);
+
 	if (header != nullptr)
 		client.PushPage(header);
+
+	/* the newest burst pages may still be in the worker's queue;
+	   the client will receive those from there */
+	const size_t queued = client.GetWorker().pages.size();
+	if (burst.size() > queued)
+		for (auto i = burst.begin(),
+			     end = std::prev(burst.end(), queued);
+		     i != end; ++i)
+			client.PushPage(i->page);
+}
+
+/**
+ * Never burst more than this many bytes of encoded data, which must
+ * be well below the limit for slow clients in HttpdClient::PushPage().
+ */
+static constexpr size_t MAX_BURST_SIZE = 128 * 1024;
+
+void
+HttpdOutput::AddBurstPage(const PagePtr &page, size_t input) noexcept
+{
+	if (burst_max_input == 0)
+		return;
+
+	burst.emplace_back(page, input);
+	burst_input += input;
+	burst_size += page->GetSize();
+
+	while (burst.size() > 1 &&
+	       (burst_input - burst.front().input >= burst_max_input ||
+		burst_size > MAX_BURST_SIZE)) {
+		burst_input -= burst.front().input;
+		burst_size -= burst.front().page->GetSize();
+		burst.pop_front();
+	}
+}
+
+void
+HttpdOutput::ClearBurst() noexcept
+{
+	burst.clear();
+	burst_input = 0;
+	burst_size = 0;
 }
 
 std::chrono::steady_clock::duration
@@ -264,12 +454,9 @@ HttpdOutput::BroadcastPage(PagePtr page) noexcept
 {
 	assert(page != nullptr);
 
-	{
-		const std::lock_guard<Mutex> lock(mutex);
-		pages.emplace(std::move(page));
-	}
-
-	defer_broadcast.Schedule();
+	const std::lock_guard<Mutex> lock(mutex);
+	for (auto &worker : workers)
+		worker.PushPage(page);
 }
 
 void
@@ -278,21 +465,25 @@ HttpdOutput::BroadcastFromEncoder()
 	/* synchronize with the IOThread */
 	{
 		const std::lock_guard<Mutex> lock(mutex);
-		while (!pages.empty())
+		while (HasPendingPages())
 			cond.wait(mutex);
 	}
 
-	bool empty = true;
-
 	PagePtr page;
 	while ((page = ReadPage()) != nullptr) {
-		const std::lock_guard<Mutex> lock(mutex);
-		pages.emplace(std::move(page));
-		empty = false;
-	}
+		const size_t input = pending_input;
+		pending_input = 0;
+
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			AddBurstPage(page, input);
+			for (auto &worker : workers)
+				worker.PushPage(page);
+		}
 
-	if (!empty)
-		defer_broadcast.Schedule();
+		if (hls)
+			hls->Add(*page, input);
+	}
 }
 
 inline void
@@ -301,6 +492,7 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size)
 	encoder->Write(chunk, size);
 
 	unflushed_input += size;
+	pending_input += size;
 
 	BroadcastFromEncoder();
 }
@@ -310,8 +502,14 @@ HttpdOutput::Play(const void *chunk, size_t size)
 {
 	pause = false;
 
-	if (LockHasClients())
+	if (hls || LockHasClients())
 		EncodeAndPlay(chunk, size);
+	else if (!burst.empty()) {
+		/* nobody listens, and the encoder is not fed; the
+		   burst pages are stale now */
+		const std::lock_guard<Mutex> protect(mutex);
+		ClearBurst();
+	}
 
 	if (!timer->IsStarted())
 		timer->Start();
@@ -366,7 +564,23 @@ HttpdOutput::SendTag(const Tag &tag)
 		auto page = ReadPage();
 		if (page != nullptr) {
 			header = page;
+
+			/* the old pages belong to the previous stream
+			   and must not follow the new header */
+			{
+				const std::lock_guard<Mutex> protect(mutex);
+				ClearBurst();
+			}
+
 			BroadcastPage(page);
+
+			if (hls) {
+				/* the new stream starts in the middle of
+				   the current segment, and it begins every
+				   following one */
+				hls->Add(*page, 0);
+				hls->SetHeader(page);
+			}
 		}
 	} else {
 		/* use Icy-Metadata */
@@ -379,34 +593,25 @@ HttpdOutput::SendTag(const Tag &tag)
 		metadata = icy_server_metadata_page(tag, &types[0]);
 		if (metadata != nullptr) {
 			const std::lock_guard<Mutex> protect(mutex);
-			for (auto &client : clients)
-				client.PushMetaData(metadata);
+			for (auto &worker : workers)
+				for (auto &client : worker.clients)
+					client.PushMetaData(metadata);
 		}
 	}
 }
 
-inline void
-HttpdOutput::CancelAllClients() noexcept
-{
-	const std::lock_guard<Mutex> protect(mutex);
-
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
-	}
-
-	for (auto &client : clients)
-		client.CancelQueue();
-
-	cond.broadcast();
-}
-
 void
 HttpdOutput::Cancel() noexcept
 {
-	BlockingCall(GetEventLoop(), [this](){
-			CancelAllClients();
-		});
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		ClearBurst();
+	}
+
+	for (auto &worker : workers)
+		BlockingCall(worker.GetEventLoop(), [&worker](){
+				worker.Cancel();
+			});
 }
 
 const struct AudioOutputPlugin httpd_output_plugin = {
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_WORKER_HXX
+#define MPD_OUTPUT_HTTPD_WORKER_HXX
+
+#include "HttpdClient.hxx"
+#include "Page.hxx"
+#include "event/DeferEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <queue>
+#include <list>
+#include <memory>
+
+class EventLoop;
+class EventThread;
+class HttpdOutput;
+
+/**
+ * A group of #HttpdClient objects which are served by one
+ * #EventLoop: either the #HttpdOutput's own one or a dedicated
+ * #EventThread (setting "worker_threads").
+ *
+ * All attributes are protected by HttpdOutput::mutex.
+ */
+class HttpdWorker final {
+	friend class HttpdOutput;
+
+	HttpdOutput &httpd;
+
+	/**
+	 * The thread running this worker's #EventLoop, or nullptr if
+	 * it uses the #HttpdOutput's #EventLoop.
+	 */
+	const std::unique_ptr<EventThread> thread;
+
+	/**
+	 * Moves #pending_sockets and #pages into this worker's
+	 * #EventLoop.
+	 */
+	DeferEvent defer;
+
+	/**
+	 * Sockets accepted by HttpdOutput::OnAccept(), for which an
+	 * #HttpdClient will be created in this worker's #EventLoop.
+	 */
+	std::list<UniqueSocketDescriptor> pending_sockets;
+
+	/**
+	 * The page queue, i.e. pages from the encoder to be
+	 * broadcasted to this worker's clients.  Removing signals
+	 * HttpdOutput::cond.
+	 */
+	std::queue<PagePtr, std::list<PagePtr>> pages;
+
+	boost::intrusive::list<HttpdClient,
+			       boost::intrusive::constant_time_size<true>> clients;
+
+public:
+	/**
+	 * Construct a worker which uses an existing #EventLoop.
+	 */
+	HttpdWorker(HttpdOutput &_httpd, EventLoop &_loop) noexcept;
+
+	/**
+	 * Construct a worker with its own #EventThread.
+	 */
+	explicit HttpdWorker(HttpdOutput &_httpd);
+
+	~HttpdWorker() noexcept;
+
+	HttpdWorker(const HttpdWorker &) = delete;
+	HttpdWorker &operator=(const HttpdWorker &) = delete;
+
+	EventLoop &GetEventLoop() noexcept {
+		return defer.GetEventLoop();
+	}
+
+	/**
+	 * Start the #EventThread (if there is one and it is not
+	 * already running).
+	 */
+	void Start();
+
+	/**
+	 * The number of clients served (or about to be served) by
+	 * this worker.
+	 */
+	gcc_pure
+	size_t GetLoad() const noexcept {
+		return clients.size() + pending_sockets.size();
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void AddSocket(UniqueSocketDescriptor fd) noexcept {
+		pending_sockets.emplace_back(std::move(fd));
+		defer.Schedule();
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void PushPage(const PagePtr &page) noexcept {
+		pages.emplace(page);
+		defer.Schedule();
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void RemoveClient(HttpdClient &client) noexcept;
+
+	/**
+	 * Clears the page queues.  Must be called in this worker's
+	 * #EventLoop.
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * Disconnect all clients.  Must be called in this worker's
+	 * #EventLoop.
+	 */
+	void Close() noexcept;
+
+private:
+	/* DeferEvent callback */
+	void OnDeferred() noexcept;
+};
+
+#endif
@@ -21,8 +21,8 @@
 
 #include <string.h>
 
-Page::Page(const void *data, size_t size) noexcept
-	:buffer(size)
+Page::Page(const void *data, size_t _size) noexcept
+	:buffer(_size), size(_size)
 {
-	memcpy(&buffer.front(), data, size);
+	memcpy(&buffer.front(), data, _size);
 }
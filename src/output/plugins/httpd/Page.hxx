@@ -24,6 +24,7 @@
 
 #include <memory>
 
+#include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -35,17 +36,46 @@
 class Page {
 	AllocatedArray<uint8_t> buffer;
 
+	/**
+	 * The number of bytes in #buffer which are used.  This may be
+	 * less than the allocated capacity if this #Page was obtained
+	 * from a #PagePool.
+	 */
+	size_t size;
+
 public:
-	explicit Page(size_t _size) noexcept:buffer(_size) {}
+	explicit Page(size_t _size) noexcept:buffer(_size), size(_size) {}
 	explicit Page(AllocatedArray<uint8_t> &&_buffer) noexcept
-		:buffer(std::move(_buffer)) {}
+		:buffer(std::move(_buffer)), size(buffer.size()) {}
 
-	Page(const void *data, size_t size) noexcept;
+	Page(const void *data, size_t _size) noexcept;
 
-	size_t GetSize() const noexcept {
+	size_t GetCapacity() const noexcept {
 		return buffer.size();
 	}
 
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Obtain a writable pointer to the whole allocated buffer.
+	 * This may only be used while nobody else holds a reference
+	 * to this #Page.
+	 */
+	uint8_t *GetWriteBuffer() noexcept {
+		return &buffer.front();
+	}
+
+	/**
+	 * Declare how many bytes of the buffer are used.
+	 */
+	void SetSize(size_t _size) noexcept {
+		assert(_size <= buffer.size());
+
+		size = _size;
+	}
+
 	const uint8_t *GetData() const noexcept {
 		return &buffer.front();
 	}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "PagePool.hxx"
+
+#include <algorithm>
+#include <atomic>
+
+/**
+ * Is this #Page referenced only by the #PagePool?
+ */
+static bool
+IsFree(const PagePtr &page) noexcept
+{
+	if (page.use_count() != 1)
+		return false;
+
+	/* synchronize with the (release) decrement performed by the
+	   thread which dropped the last foreign reference, so its
+	   reads from the buffer happen before we overwrite it */
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return true;
+}
+
+PagePtr
+PagePool::Get() noexcept
+{
+	const size_t n = pages.size();
+	for (size_t i = 0; i < n; ++i) {
+		const size_t j = (next + i) % n;
+		auto &page = pages[j];
+		if (IsFree(page)) {
+			next = (j + 1) % n;
+			page->SetSize(page->GetCapacity());
+			return page;
+		}
+	}
+
+	auto page = std::make_shared<Page>(page_size);
+	if (n < max_pages)
+		pages.push_back(page);
+
+	return page;
+}
+
+void
+PagePool::Shrink() noexcept
+{
+	pages.erase(std::remove_if(pages.begin(), pages.end(), IsFree),
+		    pages.end());
+	next = 0;
+}
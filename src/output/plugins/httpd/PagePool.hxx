@@ -0,0 +1,87 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PAGE_POOL_HXX
+#define MPD_PAGE_POOL_HXX
+
+#include "Page.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * A set of recycled #Page instances with a fixed capacity.  A #Page
+ * is free again as soon as all other holders (i.e. the clients) have
+ * released their references; the pool then hands it out again,
+ * without allocating a new buffer or a new std::shared_ptr control
+ * block.
+ *
+ * This class is not thread-safe; it may only be used by one thread,
+ * but other threads may release their #PagePtr instances at any
+ * time.
+ */
+class PagePool {
+	/**
+	 * The capacity of each #Page.
+	 */
+	const size_t page_size;
+
+	/**
+	 * The maximum number of pages managed by this pool.  If all
+	 * of them are in use, Get() allocates an unpooled #Page.
+	 */
+	const size_t max_pages;
+
+	std::vector<PagePtr> pages;
+
+	/**
+	 * The index in #pages where the next Get() call starts
+	 * looking for a free #Page.  Since pages are released
+	 * roughly in the order they were handed out, this is usually
+	 * the oldest one.
+	 */
+	size_t next = 0;
+
+public:
+	PagePool(size_t _page_size, size_t _max_pages) noexcept
+		:page_size(_page_size), max_pages(_max_pages) {}
+
+	PagePool(const PagePool &) = delete;
+	PagePool &operator=(const PagePool &) = delete;
+
+	size_t GetPageSize() const noexcept {
+		return page_size;
+	}
+
+	/**
+	 * Obtain a #Page which is exclusively owned by the caller
+	 * (and this pool).  Its contents are undefined and its size
+	 * is the full capacity.
+	 */
+	PagePtr Get() noexcept;
+
+	/**
+	 * Free all pages which are not referenced by anybody else.
+	 */
+	void Shrink() noexcept;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "BitReverse.hxx"
+#include "DsdSimd.hxx"
+#include "util/bit_reverse.h"
+
+/**
+ * Pick the bit reversal kernel for this CPU.
+ */
+static auto
+GetBitReverseKernel() noexcept
+	-> size_t (*)(uint8_t *, const uint8_t *, size_t) noexcept
+{
+#ifdef PCM_SIMD_AVX2
+	if (PcmHaveAvx2())
+		return pcm_bit_reverse_avx2;
+#endif
+
+#ifdef PCM_SIMD_SSE2
+	return pcm_bit_reverse_sse2;
+#elif defined(PCM_SIMD_NEON_RBIT)
+	return pcm_bit_reverse_neon;
+#else
+	return nullptr;
+#endif
+}
+
+void
+PcmBitReverse(uint8_t *dest, const uint8_t *src, size_t size) noexcept
+{
+	static const auto kernel = GetBitReverseKernel();
+
+	size_t i = kernel != nullptr
+		? kernel(dest, src, size)
+		: 0;
+
+	for (; i < size; ++i)
+		dest[i] = bit_reverse(src[i]);
+}
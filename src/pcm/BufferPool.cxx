@@ -0,0 +1,175 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "BufferPool.hxx"
+
+#include <array>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * The number of size classes; larger blocks bypass the pool.
+ */
+static constexpr unsigned N_CLASSES = 14;
+
+/**
+ * The maximum number of idle blocks kept per size class.
+ */
+static constexpr unsigned MAX_IDLE_PER_CLASS = 4;
+
+/**
+ * Returns the size class of the given size, or #N_CLASSES if it is
+ * too large for the pool.
+ */
+gcc_const
+static unsigned
+SizeToClass(size_t size) noexcept
+{
+	unsigned c = 0;
+	while (c < N_CLASSES && (PCM_BUFFER_POOL_MIN_SIZE << c) < size)
+		++c;
+	return c;
+}
+
+namespace {
+
+class ThreadPool {
+	struct SizeClass {
+		/** a LIFO stack; the most recently used block is on top */
+		std::array<void *, MAX_IDLE_PER_CLASS> blocks;
+		unsigned n_blocks = 0;
+	};
+
+	std::array<SizeClass, N_CLASSES> classes;
+
+public:
+	~ThreadPool() noexcept;
+
+	void *Allocate(unsigned c) noexcept {
+		auto &sc = classes[c];
+		if (sc.n_blocks == 0)
+			return nullptr;
+
+		return sc.blocks[--sc.n_blocks];
+	}
+
+	bool Release(unsigned c, void *p) noexcept {
+		auto &sc = classes[c];
+		if (sc.n_blocks >= sc.blocks.size())
+			return false;
+
+		sc.blocks[sc.n_blocks++] = p;
+		return true;
+	}
+
+	void Trim() noexcept {
+		for (auto &sc : classes) {
+			while (sc.n_blocks > 0)
+				delete[] (uint8_t *)sc.blocks[--sc.n_blocks];
+		}
+	}
+
+	gcc_pure
+	size_t GetIdleSize() const noexcept {
+		size_t result = 0;
+		for (unsigned c = 0; c < N_CLASSES; ++c)
+			result += classes[c].n_blocks *
+				(PCM_BUFFER_POOL_MIN_SIZE << c);
+		return result;
+	}
+};
+
+}
+
+/**
+ * Set when the current thread is exiting and its pool has been
+ * destroyed already; from then on, blocks are freed directly.
+ */
+static thread_local bool thread_pool_destroyed;
+
+static thread_local ThreadPool thread_pool;
+
+ThreadPool::~ThreadPool() noexcept
+{
+	Trim();
+	thread_pool_destroyed = true;
+}
+
+size_t
+pcm_buffer_pool_round(size_t size) noexcept
+{
+	if (size <= PCM_BUFFER_POOL_MIN_SIZE)
+		return PCM_BUFFER_POOL_MIN_SIZE;
+
+	const unsigned c = SizeToClass(size);
+	if (c >= N_CLASSES)
+		/* too large for the pool: round to the smallest
+		   class's granularity only */
+		return ((size - 1) | (PCM_BUFFER_POOL_MIN_SIZE - 1)) + 1;
+
+	return PCM_BUFFER_POOL_MIN_SIZE << c;
+}
+
+void *
+pcm_buffer_pool_allocate(size_t size) noexcept
+{
+	assert(size == pcm_buffer_pool_round(size));
+
+	const unsigned c = SizeToClass(size);
+	if (c < N_CLASSES) {
+		void *p = !thread_pool_destroyed
+			? thread_pool.Allocate(c)
+			: nullptr;
+		if (p != nullptr)
+			return p;
+	}
+
+	return new uint8_t[size];
+}
+
+void
+pcm_buffer_pool_release(void *p, size_t size) noexcept
+{
+	assert(p != nullptr);
+	assert(size == pcm_buffer_pool_round(size));
+
+	const unsigned c = SizeToClass(size);
+	if (c < N_CLASSES && !thread_pool_destroyed &&
+	    thread_pool.Release(c, p))
+		return;
+
+	delete[] (uint8_t *)p;
+}
+
+void
+pcm_buffer_pool_trim() noexcept
+{
+	if (!thread_pool_destroyed)
+		thread_pool.Trim();
+}
+
+size_t
+pcm_buffer_pool_idle_size() noexcept
+{
+	return !thread_pool_destroyed
+		? thread_pool.GetIdleSize()
+		: 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef PCM_BUFFER_POOL_HXX
+#define PCM_BUFFER_POOL_HXX
+
+#include "util/Compiler.h"
+
+#include <stddef.h>
+
+/*
+ * A per-thread pool of PCM scratch buffers, sorted into power-of-two
+ * size classes.  #PcmBuffer objects borrow their storage from here
+ * and return it when they are cleared or shrunk, so idle conversion
+ * stages do not pin memory, and a block released by one stage is
+ * reused (while still cache-hot) by the next one in the same thread.
+ *
+ * Blocks may be released from a different thread than the one which
+ * allocated them; they are then added to the releasing thread's
+ * pool.
+ */
+
+/**
+ * The smallest size class.
+ */
+static constexpr size_t PCM_BUFFER_POOL_MIN_SIZE = 8192;
+
+/**
+ * Round the given size up to its size class.
+ */
+gcc_const
+size_t
+pcm_buffer_pool_round(size_t size) noexcept;
+
+/**
+ * Obtain a block from the current thread's pool, or allocate a new
+ * one.
+ *
+ * @param size the block size; must be the result of
+ * pcm_buffer_pool_round()
+ */
+gcc_malloc gcc_returns_nonnull
+void *
+pcm_buffer_pool_allocate(size_t size) noexcept;
+
+/**
+ * Return a block obtained by pcm_buffer_pool_allocate() to the
+ * current thread's pool.  If the pool is full, the block is freed.
+ */
+void
+pcm_buffer_pool_release(void *p, size_t size) noexcept;
+
+/**
+ * Free all idle blocks of the current thread's pool.
+ */
+void
+pcm_buffer_pool_trim() noexcept;
+
+/**
+ * Returns the number of bytes held idle in the current thread's
+ * pool.
+ */
+gcc_pure
+size_t
+pcm_buffer_pool_idle_size() noexcept;
+
+#endif
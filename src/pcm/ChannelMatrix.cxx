@@ -0,0 +1,345 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "ChannelMatrix.hxx"
+#include "PcmBuffer.hxx"
+#include "Silence.hxx"
+#include "Traits.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+PcmChannelMatrix
+PcmChannelMatrix::Convert(unsigned src_channels,
+			  unsigned dest_channels) noexcept
+{
+	assert(src_channels > 0 && src_channels <= MAX_CHANNELS);
+	assert(dest_channels > 0 && dest_channels <= MAX_CHANNELS);
+
+	PcmChannelMatrix m;
+	m.src_channels = src_channels;
+	m.dest_channels = dest_channels;
+	m.sources.fill(0);
+
+	const uint8_t all = (1u << src_channels) - 1;
+
+	if (src_channels == 1 && dest_channels == 2) {
+		m.sources[0] = m.sources[1] = 0x1;
+	} else if (src_channels == 2 && dest_channels > 2) {
+		/* copy left/right to front-left/front-right, which is
+		   the first two channels in all multi-channel
+		   configurations; all other channels are silent */
+		m.sources[0] = 0x1;
+		m.sources[1] = 0x2;
+	} else {
+		/* TODO: this is actually only mono ... */
+		std::fill_n(m.sources.begin(), dest_channels, all);
+	}
+
+	return m;
+}
+
+PcmChannelMatrix
+PcmChannelMatrix::Route(unsigned src_channels, unsigned dest_channels,
+			const int8_t *sources) noexcept
+{
+	assert(src_channels > 0 && src_channels <= MAX_CHANNELS);
+	assert(dest_channels > 0 && dest_channels <= MAX_CHANNELS);
+
+	PcmChannelMatrix m;
+	m.src_channels = src_channels;
+	m.dest_channels = dest_channels;
+	m.sources.fill(0);
+
+	for (unsigned c = 0; c < dest_channels; ++c)
+		if (sources[c] >= 0 && unsigned(sources[c]) < src_channels)
+			m.sources[c] = 1u << sources[c];
+
+	return m;
+}
+
+bool
+PcmChannelMatrix::IsRoute() const noexcept
+{
+	for (unsigned c = 0; c < dest_channels; ++c)
+		if ((sources[c] & (sources[c] - 1)) != 0)
+			return false;
+
+	return true;
+}
+
+static bool
+CanMix(SampleFormat format) noexcept
+{
+	switch (format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+void
+PcmChannelMixer::Open(SampleFormat _format, const PcmChannelMatrix &matrix)
+{
+	assert(_format != SampleFormat::UNDEFINED);
+
+	route = matrix.IsRoute();
+	if (!route && !CanMix(_format))
+		throw FormatRuntimeError("PCM channel conversion for %s is not implemented",
+					 sample_format_to_string(_format));
+
+	format = _format;
+	src_channels = matrix.src_channels;
+	dest_channels = matrix.dest_channels;
+	sample_size = sample_format_size(format);
+
+	for (unsigned c = 0; c < dest_channels; ++c) {
+		auto &row = rows[c];
+		row.n = 0;
+		for (unsigned i = 0; i < src_channels; ++i)
+			if (matrix.sources[c] & (1u << i))
+				row.sources[row.n++] = i;
+
+		row.repeat = c > 0 && matrix.sources[c] == matrix.sources[c - 1];
+	}
+
+	kernel = nullptr;
+	if (!route)
+		return;
+
+	/* compile the route to a byte shuffle */
+
+	PcmSilence({silence, sample_size}, format);
+
+	shuffle.src_frame_size = src_channels * sample_size;
+	shuffle.dest_frame_size = dest_channels * sample_size;
+	std::fill_n(shuffle.bytes, sizeof(shuffle.bytes), 0x80);
+	std::fill_n(shuffle.silence, sizeof(shuffle.silence), 0);
+	std::fill_n(shuffle.lanes, 8, 0);
+	std::fill_n(shuffle.lane_mask, 8, 0);
+
+	for (unsigned c = 0; c < dest_channels; ++c) {
+		const auto &row = rows[c];
+		map[c] = row.n > 0 ? row.sources[0] : -1;
+
+		for (unsigned b = 0; b < sample_size; ++b) {
+			const size_t i = c * sample_size + b;
+			if (row.n > 0)
+				shuffle.bytes[i] = row.sources[0] * sample_size + b;
+			else
+				shuffle.silence[i] = silence[b];
+		}
+
+		if (row.n > 0) {
+			shuffle.lanes[c] = row.sources[0];
+			shuffle.lane_mask[c] = 0xffffffff;
+		}
+	}
+
+	const size_t max_frame_size = std::max(shuffle.src_frame_size,
+					       shuffle.dest_frame_size);
+
+#ifdef PCM_SIMD_AVX2
+	if (PcmHaveAvx2()) {
+		if (max_frame_size <= 16)
+			kernel = pcm_route_shuffle_avx2;
+		else if (max_frame_size <= 32 && sample_size == 4)
+			kernel = pcm_route_permute_avx2;
+	}
+#elif defined(PCM_SIMD_NEON_TBL)
+	if (max_frame_size <= 16)
+		kernel = pcm_route_shuffle_neon;
+	else if (max_frame_size <= 32)
+		kernel = pcm_route_permute_neon;
+#else
+	(void)max_frame_size;
+#endif
+}
+
+/**
+ * Copy one input sample to each output sample (or silence).
+ */
+template<typename T>
+static void
+RouteFrames(T *dest, const T *src, size_t n_frames,
+	    unsigned dest_channels, unsigned src_channels,
+	    const int8_t *map, T silence) noexcept
+{
+	for (size_t i = 0; i != n_frames; ++i) {
+		for (unsigned c = 0; c < dest_channels; ++c)
+			dest[c] = map[c] >= 0 ? src[map[c]] : silence;
+
+		src += src_channels;
+		dest += dest_channels;
+	}
+}
+
+template<typename T>
+static void
+RouteFrames(void *dest, const void *src, size_t n_frames,
+	    unsigned dest_channels, unsigned src_channels,
+	    const int8_t *map, const void *silence) noexcept
+{
+	T s;
+	memcpy(&s, silence, sizeof(s));
+
+	RouteFrames<T>((T *)dest, (const T *)src, n_frames,
+		       dest_channels, src_channels, map, s);
+}
+
+/**
+ * Calculate each output sample as the average of its input
+ * samples.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>, typename Row>
+static void
+MixFrames(typename Traits::pointer_type dest,
+	  typename Traits::const_pointer_type src, size_t n_frames,
+	  unsigned dest_channels, unsigned src_channels,
+	  const Row *rows) noexcept
+{
+	for (size_t i = 0; i != n_frames; ++i) {
+		for (unsigned c = 0; c < dest_channels; ++c) {
+			const auto &row = rows[c];
+			if (row.repeat) {
+				dest[c] = dest[c - 1];
+				continue;
+			}
+
+			if (row.n == 0) {
+				dest[c] = 0;
+				continue;
+			}
+
+			typename Traits::sum_type sum = src[row.sources[0]];
+			for (unsigned j = 1; j < row.n; ++j)
+				sum += src[row.sources[j]];
+
+			dest[c] = typename Traits::value_type(sum / int(row.n));
+		}
+
+		src += src_channels;
+		dest += dest_channels;
+	}
+}
+
+ConstBuffer<void>
+PcmChannelMixer::Apply(PcmBuffer &buffer,
+		       ConstBuffer<void> src) const noexcept
+{
+	const size_t src_frame_size = src_channels * sample_size;
+	const size_t dest_frame_size = dest_channels * sample_size;
+	assert(src.size % src_frame_size == 0);
+
+	const size_t n_frames = src.size / src_frame_size;
+	const size_t dest_size = n_frames * dest_frame_size;
+	uint8_t *const dest = (uint8_t *)buffer.Get(dest_size);
+
+	if (!route) {
+		switch (format) {
+		case SampleFormat::S16:
+			MixFrames<SampleFormat::S16>((int16_t *)dest,
+						     (const int16_t *)src.data,
+						     n_frames,
+						     dest_channels, src_channels,
+						     &rows.front());
+			break;
+
+		case SampleFormat::S24_P32:
+			MixFrames<SampleFormat::S24_P32>((int32_t *)dest,
+							 (const int32_t *)src.data,
+							 n_frames,
+							 dest_channels, src_channels,
+							 &rows.front());
+			break;
+
+		case SampleFormat::S32:
+			MixFrames<SampleFormat::S32>((int32_t *)dest,
+						     (const int32_t *)src.data,
+						     n_frames,
+						     dest_channels, src_channels,
+						     &rows.front());
+			break;
+
+		case SampleFormat::FLOAT:
+			MixFrames<SampleFormat::FLOAT>((float *)dest,
+						       (const float *)src.data,
+						       n_frames,
+						       dest_channels, src_channels,
+						       &rows.front());
+			break;
+
+		default:
+			assert(false);
+			gcc_unreachable();
+		}
+
+		return { dest, dest_size };
+	}
+
+	size_t done = 0;
+	if (kernel != nullptr)
+		done = kernel(dest, (const uint8_t *)src.data,
+			      n_frames, shuffle);
+
+	/* the remaining frames (or all of them if there is no
+	   kernel) */
+
+	uint8_t *const tail_dest = dest + done * dest_frame_size;
+	const uint8_t *const tail_src = (const uint8_t *)src.data +
+		done * src_frame_size;
+	const size_t n_tail = n_frames - done;
+
+	switch (sample_size) {
+	case 1:
+		RouteFrames<uint8_t>(tail_dest, tail_src, n_tail,
+				     dest_channels, src_channels,
+				     &map.front(), silence);
+		break;
+
+	case 2:
+		RouteFrames<uint16_t>(tail_dest, tail_src, n_tail,
+				      dest_channels, src_channels,
+				      &map.front(), silence);
+		break;
+
+	case 4:
+		RouteFrames<uint32_t>(tail_dest, tail_src, n_tail,
+				      dest_channels, src_channels,
+				      &map.front(), silence);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+
+	return { dest, dest_size };
+}
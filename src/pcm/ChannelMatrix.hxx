@@ -0,0 +1,156 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_CHANNEL_MATRIX_HXX
+#define MPD_PCM_CHANNEL_MATRIX_HXX
+
+#include "SampleFormat.hxx"
+#include "RouteSimd.hxx"
+#include "AudioFormat.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+
+#include <stdint.h>
+#include <stddef.h>
+
+class PcmBuffer;
+template<typename T> struct ConstBuffer;
+
+/**
+ * Describes how each output channel is calculated from the input
+ * channels: as the average of a set of input channels, or silence.
+ */
+struct PcmChannelMatrix {
+	unsigned src_channels, dest_channels;
+
+	/**
+	 * For each output channel: a bit mask of the input channels
+	 * it is mixed from.  Zero means silence.
+	 */
+	std::array<uint8_t, MAX_CHANNELS> sources;
+
+	static_assert(MAX_CHANNELS <= 8, "Bit mask too small");
+
+	/**
+	 * The matrix used by pcm_convert_channels_16() and friends:
+	 * mono is duplicated, stereo is copied to the front channels
+	 * of multi-channel layouts, and everything else is mixed
+	 * down to mono.
+	 */
+	gcc_const
+	static PcmChannelMatrix Convert(unsigned src_channels,
+					unsigned dest_channels) noexcept;
+
+	/**
+	 * Copy one input channel to each output channel.
+	 *
+	 * @param sources for each output channel: the input channel
+	 * or -1 for silence; input channels which don't exist are
+	 * silence, too
+	 */
+	gcc_pure
+	static PcmChannelMatrix Route(unsigned src_channels,
+				      unsigned dest_channels,
+				      const int8_t *sources) noexcept;
+
+	/**
+	 * Is each output channel a copy of at most one input
+	 * channel?
+	 */
+	gcc_pure
+	bool IsRoute() const noexcept;
+};
+
+/**
+ * Applies a #PcmChannelMatrix to PCM data.  Open() compiles the
+ * matrix for one sample format: routes (see
+ * PcmChannelMatrix::IsRoute()) are implemented as byte shuffles
+ * with vectorized kernels, other matrices with a scalar loop over
+ * precalculated source lists.
+ */
+class PcmChannelMixer {
+	SampleFormat format;
+	unsigned src_channels, dest_channels;
+	size_t sample_size;
+
+	/**
+	 * For each output channel: the number of input channels
+	 * which are mixed into it and their indices.
+	 */
+	struct Row {
+		unsigned n;
+		std::array<uint8_t, MAX_CHANNELS> sources;
+
+		/**
+		 * Does this row have the same sources as the
+		 * previous one?  Then its value is copied.
+		 */
+		bool repeat;
+	};
+
+	std::array<Row, MAX_CHANNELS> rows;
+
+	bool route;
+
+	/**
+	 * For each output channel of a route: the input channel or
+	 * -1 for silence.
+	 */
+	std::array<int8_t, MAX_CHANNELS> map;
+
+	/**
+	 * One silent sample.
+	 */
+	uint8_t silence[4];
+
+	/**
+	 * The route as a byte shuffle on one frame.
+	 */
+	PcmRouteShuffle shuffle;
+
+	/**
+	 * The vectorized route kernel for this CPU and this layout;
+	 * nullptr if there is none.
+	 */
+	size_t (*kernel)(uint8_t *dest, const uint8_t *src, size_t n_frames,
+			 const PcmRouteShuffle &shuffle) noexcept;
+
+public:
+	/**
+	 * Throws std::runtime_error if the sample format is not
+	 * supported.  Routes work with all sample formats, but
+	 * mixing requires S16, S24_P32, S32 or FLOAT.
+	 */
+	void Open(SampleFormat format, const PcmChannelMatrix &matrix);
+
+	/**
+	 * Convert a block of PCM data.
+	 *
+	 * @param buffer the destination buffer
+	 * @param src the input buffer; its size must be a multiple of
+	 * the input frame size
+	 * @return the destination buffer
+	 */
+	ConstBuffer<void> Apply(PcmBuffer &buffer,
+				ConstBuffer<void> src) const noexcept;
+};
+
+#endif
@@ -18,9 +18,7 @@
  */
 
 #include "ChannelsConverter.hxx"
-#include "PcmChannels.hxx"
 #include "util/ConstBuffer.hxx"
-#include "util/RuntimeError.hxx"
 
 #include <assert.h>
 
@@ -30,21 +28,9 @@ PcmChannelsConverter::Open(SampleFormat _format,
 {
 	assert(_format != SampleFormat::UNDEFINED);
 
-	switch (_format) {
-	case SampleFormat::S16:
-	case SampleFormat::S24_P32:
-	case SampleFormat::S32:
-	case SampleFormat::FLOAT:
-		break;
-
-	default:
-		throw FormatRuntimeError("PCM channel conversion for %s is not implemented",
-					 sample_format_to_string(_format));
-	}
-
+	mixer.Open(_format,
+		   PcmChannelMatrix::Convert(_src_channels, _dest_channels));
 	format = _format;
-	src_channels = _src_channels;
-	dest_channels = _dest_channels;
 }
 
 void
@@ -58,34 +44,7 @@ PcmChannelsConverter::Close() noexcept
 ConstBuffer<void>
 PcmChannelsConverter::Convert(ConstBuffer<void> src) noexcept
 {
-	switch (format) {
-	case SampleFormat::UNDEFINED:
-	case SampleFormat::S8:
-	case SampleFormat::DSD:
-		assert(false);
-		gcc_unreachable();
-
-	case SampleFormat::S16:
-		return pcm_convert_channels_16(buffer, dest_channels,
-					       src_channels,
-					       ConstBuffer<int16_t>::FromVoid(src)).ToVoid();
-
-	case SampleFormat::S24_P32:
-		return pcm_convert_channels_24(buffer, dest_channels,
-					       src_channels,
-					       ConstBuffer<int32_t>::FromVoid(src)).ToVoid();
-
-	case SampleFormat::S32:
-		return pcm_convert_channels_32(buffer, dest_channels,
-					       src_channels,
-					       ConstBuffer<int32_t>::FromVoid(src)).ToVoid();
-
-	case SampleFormat::FLOAT:
-		return pcm_convert_channels_float(buffer, dest_channels,
-						  src_channels,
-						  ConstBuffer<float>::FromVoid(src)).ToVoid();
-	}
+	assert(format != SampleFormat::UNDEFINED);
 
-	assert(false);
-	gcc_unreachable();
+	return mixer.Apply(buffer, src);
 }
@@ -21,6 +21,7 @@
 #define MPD_PCM_CHANNELS_CONVERTER_HXX
 
 #include "SampleFormat.hxx"
+#include "ChannelMatrix.hxx"
 #include "PcmBuffer.hxx"
 
 #ifndef NDEBUG
@@ -34,7 +35,8 @@ template<typename T> struct ConstBuffer;
  */
 class PcmChannelsConverter {
 	SampleFormat format;
-	unsigned src_channels, dest_channels;
+
+	PcmChannelMixer mixer;
 
 	PcmBuffer buffer;
 
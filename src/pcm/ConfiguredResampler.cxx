@@ -35,6 +35,9 @@
 #include "SoxrResampler.hxx"
 #endif
 
+#include <forward_list>
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
@@ -50,7 +53,36 @@ enum class SelectedResampler {
 #endif
 };
 
-static SelectedResampler selected_resampler = SelectedResampler::FALLBACK;
+struct PcmResamplerProfile {
+	/**
+	 * The profile name; empty for the default profile.
+	 */
+	const std::string name;
+
+	SelectedResampler plugin;
+
+#ifdef ENABLE_LIBSAMPLERATE
+	int lsr_converter;
+#endif
+
+#ifdef ENABLE_SOXR
+	SoxrResamplerSettings soxr;
+#endif
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	PcmResamplerProfile(const char *_name, const ConfigBlock &block);
+};
+
+static std::forward_list<PcmResamplerProfile> resampler_profiles;
+
+/**
+ * The profile used by all resamplers which don't select one
+ * explicitly; nullptr before pcm_resampler_global_init(), which means
+ * the internal resampler is used.
+ */
+static const PcmResamplerProfile *default_resampler_profile;
 
 static const ConfigBlock *
 MakeResamplerDefaultConfig(ConfigBlock &block) noexcept
@@ -112,12 +144,28 @@ MigrateResamplerConfig(const ConfigParam *param, ConfigBlock &buffer) noexcept
 		: MigrateResamplerConfig(*param, buffer);
 }
 
+/**
+ * Find the "resampler" block without a "name", i.e. the default
+ * profile; if there is none, a block is synthesized from the old
+ * "samplerate_converter" setting.
+ */
 static const ConfigBlock *
 GetResamplerConfig(const ConfigData &config, ConfigBlock &buffer)
 {
+	const ConfigBlock *block = nullptr;
+	for (const auto &i : config.GetBlockList(ConfigBlockOption::RESAMPLER)) {
+		if (i.GetBlockParam("name") != nullptr)
+			continue;
+
+		if (block != nullptr)
+			throw FormatRuntimeError("Duplicate unnamed 'resampler' in line %d",
+						 i.line);
+
+		block = &i;
+	}
+
 	const auto *old_param =
 		config.GetParam(ConfigOption::SAMPLERATE_CONVERTER);
-	const auto *block = config.GetBlock(ConfigBlockOption::RESAMPLER);
 	if (block == nullptr)
 		return MigrateResamplerConfig(old_param, buffer);
 
@@ -129,28 +177,26 @@ GetResamplerConfig(const ConfigData &config, ConfigBlock &buffer)
 	return block;
 }
 
-void
-pcm_resampler_global_init(const ConfigData &config)
+PcmResamplerProfile::PcmResamplerProfile(const char *_name,
+					 const ConfigBlock &block)
+	:name(_name)
 {
-	ConfigBlock buffer;
-	const auto *block = GetResamplerConfig(config, buffer);
-
-	const char *plugin_name = block->GetBlockValue("plugin");
+	const char *plugin_name = block.GetBlockValue("plugin");
 	if (plugin_name == nullptr)
 		throw FormatRuntimeError("'plugin' missing in line %d",
-					 block->line);
+					 block.line);
 
 	if (strcmp(plugin_name, "internal") == 0) {
-		selected_resampler = SelectedResampler::FALLBACK;
+		plugin = SelectedResampler::FALLBACK;
 #ifdef ENABLE_SOXR
 	} else if (strcmp(plugin_name, "soxr") == 0) {
-		selected_resampler = SelectedResampler::SOXR;
-		pcm_resample_soxr_global_init(*block);
+		plugin = SelectedResampler::SOXR;
+		soxr = pcm_resample_soxr_parse(block);
 #endif
 #ifdef ENABLE_LIBSAMPLERATE
 	} else if (strcmp(plugin_name, "libsamplerate") == 0) {
-		selected_resampler = SelectedResampler::LIBSAMPLERATE;
-		pcm_resample_lsr_global_init(*block);
+		plugin = SelectedResampler::LIBSAMPLERATE;
+		lsr_converter = pcm_resample_lsr_parse(block);
 #endif
 	} else {
 		throw FormatRuntimeError("No such resampler plugin: %s",
@@ -158,21 +204,83 @@ pcm_resampler_global_init(const ConfigData &config)
 	}
 }
 
+gcc_pure
+static const PcmResamplerProfile *
+FindResamplerProfile(const char *name) noexcept
+{
+	for (const auto &i : resampler_profiles)
+		if (i.name == name)
+			return &i;
+
+	return nullptr;
+}
+
+void
+pcm_resampler_global_init(const ConfigData &config)
+{
+	resampler_profiles.clear();
+	default_resampler_profile = nullptr;
+
+	ConfigBlock buffer;
+	const auto *block = GetResamplerConfig(config, buffer);
+	resampler_profiles.emplace_front("", *block);
+	default_resampler_profile = &resampler_profiles.front();
+
+	for (const auto &i : config.GetBlockList(ConfigBlockOption::RESAMPLER)) {
+		const char *name = i.GetBlockValue("name");
+		if (name == nullptr)
+			continue;
+
+		if (*name == 0)
+			throw FormatRuntimeError("Empty resampler name in line %d",
+						 i.line);
+
+		if (FindResamplerProfile(name) != nullptr)
+			throw FormatRuntimeError("Duplicate resampler '%s' in line %d",
+						 name, i.line);
+
+		i.SetUsed();
+		resampler_profiles.emplace_front(name, i);
+	}
+}
+
+const PcmResamplerProfile &
+pcm_resampler_find(const char *name)
+{
+	const auto *profile = FindResamplerProfile(name);
+	if (profile == nullptr || profile->name.empty())
+		throw FormatRuntimeError("No such resampler: %s", name);
+
+	return *profile;
+}
+
+const char *
+pcm_resampler_get_name(const PcmResamplerProfile &profile) noexcept
+{
+	return profile.name.c_str();
+}
+
 PcmResampler *
-pcm_resampler_create()
+pcm_resampler_create(const PcmResamplerProfile *profile)
 {
-	switch (selected_resampler) {
+	if (profile == nullptr)
+		profile = default_resampler_profile;
+
+	if (profile == nullptr)
+		return new FallbackPcmResampler();
+
+	switch (profile->plugin) {
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
 #ifdef ENABLE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
-		return new LibsampleratePcmResampler();
+		return new LibsampleratePcmResampler(profile->lsr_converter);
 #endif
 
 #ifdef ENABLE_SOXR
 	case SelectedResampler::SOXR:
-		return new SoxrPcmResampler();
+		return new SoxrPcmResampler(profile->soxr);
 #endif
 	}
 
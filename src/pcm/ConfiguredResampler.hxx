@@ -20,17 +20,45 @@
 #ifndef MPD_CONFIGURED_RESAMPLER_HXX
 #define MPD_CONFIGURED_RESAMPLER_HXX
 
+#include "util/Compiler.h"
+
 struct ConfigData;
 class PcmResampler;
 
+/**
+ * A resampler plugin with its settings, parsed from a "resampler"
+ * block.  The block without a "name" is the default profile; named
+ * profiles can be selected by audio outputs.
+ */
+struct PcmResamplerProfile;
+
 void
 pcm_resampler_global_init(const ConfigData &config);
 
+/**
+ * Look up a resampler profile by its name.
+ *
+ * Throws std::runtime_error if there is no such profile.
+ */
+const PcmResamplerProfile &
+pcm_resampler_find(const char *name);
+
+/**
+ * Returns the name of the specified resampler profile (an empty
+ * string for the default profile).
+ */
+gcc_pure
+const char *
+pcm_resampler_get_name(const PcmResamplerProfile &profile) noexcept;
+
 /**
  * Create a #PcmResampler instance from the implementation class
  * configured in mpd.conf.
+ *
+ * @param profile the profile to use; nullptr selects the default
+ * profile
  */
 PcmResampler *
-pcm_resampler_create();
+pcm_resampler_create(const PcmResamplerProfile *profile=nullptr);
 
 #endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_DITHER_TYPE_HXX
+#define MPD_PCM_DITHER_TYPE_HXX
+
+#include "util/Compiler.h"
+
+#include <stdint.h>
+
+/**
+ * The algorithm used by #PcmDither to discard the least significant
+ * bits of a sample.
+ */
+enum class PcmDitherType : uint8_t {
+	/**
+	 * Round to the nearest value; no noise is added.
+	 */
+	NONE,
+
+	/**
+	 * Add triangular (high-pass) noise before rounding.
+	 */
+	TPDF,
+
+	/**
+	 * Like #TPDF, and feed the quantization error back into the
+	 * following samples (noise shaping).  This is the default.
+	 */
+	SHAPED,
+};
+
+/**
+ * The #PcmDitherType configured in mpd.conf; new #PcmDither
+ * instances use it.
+ */
+extern PcmDitherType pcm_dither_type;
+
+/**
+ * Parse a #PcmDitherType name ("none", "tpdf" or "shaped").
+ *
+ * Throws std::invalid_argument on error.
+ */
+PcmDitherType
+ParsePcmDitherType(const char *s);
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "Dsd16.hxx"
+#include "DsdPack.hxx"
 #include "PcmBuffer.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -41,7 +42,7 @@ Dsd8To16Sample(const uint8_t *src, unsigned channels) noexcept
 
 ConstBuffer<uint16_t>
 Dsd8To16(PcmBuffer &buffer, unsigned channels,
-	 ConstBuffer<uint8_t> _src) noexcept
+	 ConstBuffer<uint8_t> _src, const PcmDsdPack *pack) noexcept
 {
 	const size_t in_frames = _src.size / channels;
 	const size_t out_frames = in_frames / 2;
@@ -51,7 +52,14 @@ Dsd8To16(PcmBuffer &buffer, unsigned channels,
 	uint16_t *const dest0 = buffer.GetT<uint16_t>(out_samples);
 	uint16_t *dest = dest0;
 
-	for (size_t i = 0; i < out_frames; ++i) {
+	size_t i = 0;
+	if (pack != nullptr) {
+		i = pack->Apply(dest, src, out_frames);
+		src += i * 2 * channels;
+		dest += i * channels;
+	}
+
+	for (; i < out_frames; ++i) {
 		for (size_t c = 0; c < channels; ++c)
 			*dest++ = Dsd8To16Sample(src++, channels);
 
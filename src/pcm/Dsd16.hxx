@@ -24,12 +24,17 @@
 
 template<typename T> struct ConstBuffer;
 class PcmBuffer;
+class PcmDsdPack;
 
 /**
  * Convert DSD_U8 to DSD_U16 (native endian, oldest bits in MSB).
+ *
+ * @param pack an optional vectorized conversion for this channel
+ * count
  */
 ConstBuffer<uint16_t>
 Dsd8To16(PcmBuffer &buffer, unsigned channels,
-	 ConstBuffer<uint8_t> src) noexcept;
+	 ConstBuffer<uint8_t> src,
+	 const PcmDsdPack *pack=nullptr) noexcept;
 
 #endif
@@ -18,6 +18,7 @@
  */
 
 #include "Dsd32.hxx"
+#include "DsdPack.hxx"
 #include "PcmBuffer.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -43,7 +44,7 @@ Dsd8To32Sample(const uint8_t *src, unsigned channels) noexcept
 
 ConstBuffer<uint32_t>
 Dsd8To32(PcmBuffer &buffer, unsigned channels,
-	 ConstBuffer<uint8_t> _src) noexcept
+	 ConstBuffer<uint8_t> _src, const PcmDsdPack *pack) noexcept
 {
 	const size_t in_frames = _src.size / channels;
 	const size_t out_frames = in_frames / 4;
@@ -53,7 +54,14 @@ Dsd8To32(PcmBuffer &buffer, unsigned channels,
 	uint32_t *const dest0 = buffer.GetT<uint32_t>(out_samples);
 	uint32_t *dest = dest0;
 
-	for (size_t i = 0; i < out_frames; ++i) {
+	size_t i = 0;
+	if (pack != nullptr) {
+		i = pack->Apply(dest, src, out_frames);
+		src += i * 4 * channels;
+		dest += i * channels;
+	}
+
+	for (; i < out_frames; ++i) {
 		for (size_t c = 0; c < channels; ++c)
 			*dest++ = Dsd8To32Sample(src++, channels);
 
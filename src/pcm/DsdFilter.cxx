@@ -0,0 +1,301 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "DsdFilter.hxx"
+#include "Simd.hxx"
+
+#ifdef PCM_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The second half of the 96-tap symmetric lowpass filter of the
+ * dsd2pcm library (flat up to 48 kHz at DSD64, meant to be followed
+ * by a resampler).
+ */
+static constexpr double dsd2pcm_htaps[] = {
+	0.09950731974056658,
+	0.09562845727714668,
+	0.08819647126516944,
+	0.07782552527068175,
+	0.06534876523171299,
+	0.05172629311427257,
+	0.0379429484910187,
+	0.02490921351762261,
+	0.0133774746265897,
+	0.003883043418804416,
+	-0.003284703416210726,
+	-0.008080250212687497,
+	-0.01067241812471033,
+	-0.01139427235000863,
+	-0.0106813877974587,
+	-0.009007905078766049,
+	-0.006828859761015335,
+	-0.004535184322001496,
+	-0.002425035959059578,
+	-0.0006922187080790708,
+	0.0005700762133516592,
+	0.001353838005269448,
+	0.001713709169690937,
+	0.001742046839472948,
+	0.001545601648013235,
+	0.001226696225277855,
+	0.0008704322683580222,
+	0.0005381636200535649,
+	0.000266446345425276,
+	7.002968738383528e-05,
+	-5.279407053811266e-05,
+	-0.0001140625650874684,
+	-0.0001304796361231895,
+	-0.0001189970287491285,
+	-9.396247155265073e-05,
+	-6.577634378272832e-05,
+	-4.07492895872535e-05,
+	-2.17407957554587e-05,
+	-9.163058931391722e-06,
+	-2.017460145032201e-06,
+	1.249721855219005e-06,
+	2.166655190537392e-06,
+	1.930520892991082e-06,
+	1.319400334374195e-06,
+	7.410039764949091e-07,
+	3.423230509967409e-07,
+	1.244182214744588e-07,
+	3.130441005359396e-08,
+};
+
+static constexpr unsigned DSD2PCM_HTAPS =
+	sizeof(dsd2pcm_htaps) / sizeof(dsd2pcm_htaps[0]);
+
+/**
+ * The window size (in bytes) for the dsd2pcm filter: 96 taps, padded
+ * to a multiple of #DsdFilter::WINDOW_ALIGN.
+ */
+static constexpr unsigned DSD2PCM_WINDOW =
+	(DSD2PCM_HTAPS * 2 / 8 + DsdFilter::WINDOW_ALIGN - 1)
+	/ DsdFilter::WINDOW_ALIGN * DsdFilter::WINDOW_ALIGN;
+
+/**
+ * The length of the generated filters (factor>1), in output sample
+ * periods.
+ */
+static constexpr unsigned KAISER_PERIODS = 24;
+
+/**
+ * Kaiser window parameter for a stopband attenuation of about 90 dB.
+ */
+static constexpr double KAISER_BETA = 9;
+
+/**
+ * The cutoff frequency of the generated filters relative to the
+ * output sample rate: the passband ends at 1/4, the stopband begins
+ * at the output Nyquist frequency.
+ */
+static constexpr double KAISER_CUTOFF = 0.375;
+
+/**
+ * Modified Bessel function of the first kind, order zero.
+ */
+static double
+BesselI0(double x) noexcept
+{
+	double sum = 1, term = 1;
+	for (unsigned k = 1; term > sum * 1e-12; ++k) {
+		const double t = x / (2 * k);
+		term *= t * t;
+		sum += term;
+	}
+
+	return sum;
+}
+
+/**
+ * Fill the last #DSD2PCM_HTAPS*2 elements of the given array with
+ * the dsd2pcm filter; the rest is zero.
+ */
+static void
+GenerateDsd2Pcm(double *h, unsigned n) noexcept
+{
+	assert(n >= DSD2PCM_HTAPS * 2);
+
+	std::fill_n(h, n, 0.);
+	h += n - DSD2PCM_HTAPS * 2;
+
+	for (unsigned i = 0; i < DSD2PCM_HTAPS; ++i)
+		h[DSD2PCM_HTAPS - 1 - i] = h[DSD2PCM_HTAPS + i] =
+			dsd2pcm_htaps[i];
+}
+
+/**
+ * Generate a Kaiser-windowed sinc lowpass filter for the given
+ * decimation factor (input bytes per output sample) with unity DC
+ * gain.
+ */
+static void
+GenerateKaiser(double *h, unsigned n, unsigned factor) noexcept
+{
+	/* the cutoff frequency relative to the DSD bit rate */
+	const double fc = KAISER_CUTOFF / (8 * factor);
+	const double center = (n - 1) / 2.;
+	const double i0_beta = BesselI0(KAISER_BETA);
+
+	double sum = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		const double x = i - center;
+		const double r = x / center;
+		const double window =
+			BesselI0(KAISER_BETA * sqrt(1 - r * r)) / i0_beta;
+		const double sinc = x == 0
+			? 2 * fc
+			: sin(2 * M_PI * fc * x) / (M_PI * x);
+
+		h[i] = sinc * window;
+		sum += h[i];
+	}
+
+	for (unsigned i = 0; i < n; ++i)
+		h[i] /= sum;
+}
+
+void
+DsdFilter::Generate(unsigned _factor) noexcept
+{
+	assert(_factor >= 1);
+	assert(_factor <= MAX_FACTOR);
+
+	if (_factor == factor)
+		return;
+
+	factor = _factor;
+	window = factor == 1
+		? DSD2PCM_WINDOW
+		: factor * KAISER_PERIODS;
+
+	assert(window % WINDOW_ALIGN == 0);
+
+	const unsigned n_taps = window * 8;
+	AllocatedArray<double> h(n_taps);
+	if (factor == 1)
+		GenerateDsd2Pcm(h.begin(), n_taps);
+	else
+		GenerateKaiser(h.begin(), n_taps, factor);
+
+	/* each table entry is the filter response of one byte; the
+	   most significant bit is the oldest one */
+	tables.ResizeDiscard(window * TABLE_SIZE);
+	for (unsigned i = 0; i < window; ++i) {
+		const double *c = &h[i * 8];
+		for (unsigned e = 0; e < TABLE_SIZE; ++e) {
+			double acc = 0;
+			for (unsigned m = 0; m < 8; ++m)
+				acc += (e & (0x80 >> m)) ? c[m] : -c[m];
+			tables[i * TABLE_SIZE + e] = float(acc);
+		}
+	}
+}
+
+static void
+ApplyGeneric(const float *tables, unsigned window, unsigned factor,
+	     float *dest, size_t dest_stride,
+	     const uint8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n; ++i, src += factor, dest += dest_stride) {
+		const float *t = tables;
+		float a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+		for (unsigned j = 0; j < window; j += 4) {
+			a0 += t[src[j]];
+			a1 += t[DsdFilter::TABLE_SIZE + src[j + 1]];
+			a2 += t[2 * DsdFilter::TABLE_SIZE + src[j + 2]];
+			a3 += t[3 * DsdFilter::TABLE_SIZE + src[j + 3]];
+			t += 4 * DsdFilter::TABLE_SIZE;
+		}
+
+		*dest = (a0 + a1) + (a2 + a3);
+	}
+}
+
+#ifdef PCM_SIMD_AVX2
+
+/**
+ * Look up eight window bytes with one gather instruction.
+ */
+__attribute__((target("avx2")))
+static void
+ApplyAvx2(const float *tables, unsigned window, unsigned factor,
+	  float *dest, size_t dest_stride,
+	  const uint8_t *src, size_t n) noexcept
+{
+	static_assert(DsdFilter::WINDOW_ALIGN == 8, "Wrong block size");
+
+	const __m256i offsets =
+		_mm256_setr_epi32(0, DsdFilter::TABLE_SIZE,
+				  2 * DsdFilter::TABLE_SIZE,
+				  3 * DsdFilter::TABLE_SIZE,
+				  4 * DsdFilter::TABLE_SIZE,
+				  5 * DsdFilter::TABLE_SIZE,
+				  6 * DsdFilter::TABLE_SIZE,
+				  7 * DsdFilter::TABLE_SIZE);
+
+	for (size_t i = 0; i < n; ++i, src += factor, dest += dest_stride) {
+		const float *t = tables;
+		__m256 acc = _mm256_setzero_ps();
+		for (unsigned j = 0; j < window; j += 8) {
+			const __m128i b =
+				_mm_loadl_epi64((const __m128i *)(src + j));
+			const __m256i index =
+				_mm256_add_epi32(_mm256_cvtepu8_epi32(b),
+						 offsets);
+			acc = _mm256_add_ps(acc,
+					    _mm256_i32gather_ps(t, index, 4));
+			t += 8 * DsdFilter::TABLE_SIZE;
+		}
+
+		/* horizontal sum */
+		__m128 s = _mm_add_ps(_mm256_castps256_ps128(acc),
+				      _mm256_extractf128_ps(acc, 1));
+		s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+		*dest = _mm_cvtss_f32(s);
+	}
+}
+
+#endif
+
+void
+DsdFilter::Apply(float *dest, size_t dest_stride,
+		 const uint8_t *src, size_t n) const noexcept
+{
+	assert(IsDefined());
+
+#ifdef PCM_SIMD_AVX2
+	if (PcmHaveAvx2()) {
+		ApplyAvx2(tables.begin(), window, factor,
+			  dest, dest_stride, src, n);
+		return;
+	}
+#endif
+
+	ApplyGeneric(tables.begin(), window, factor,
+		     dest, dest_stride, src, n);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_DSD_FILTER_HXX
+#define MPD_PCM_DSD_FILTER_HXX
+
+#include "util/AllocatedArray.hxx"
+#include "util/Compiler.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A decimating FIR lowpass filter for 1 bit DSD, evaluated with
+ * lookup tables: each input byte (8 DSD bits) selects a precomputed
+ * partial sum of 8 filter coefficients, so one output sample costs
+ * one table lookup per byte in the filter window.
+ *
+ * The "factor" is the number of input bytes per output sample.  With
+ * factor 1, this is the 96-tap filter of the dsd2pcm library (which
+ * is meant to be followed by a resampler); with larger factors, a
+ * Kaiser-windowed filter which attenuates everything above the output
+ * Nyquist frequency is generated, allowing decimation straight to the
+ * output sample rate.
+ */
+class DsdFilter {
+	/**
+	 * #TABLE_SIZE floats per byte in the window; the oldest byte
+	 * comes first.
+	 */
+	AllocatedArray<float> tables;
+
+	unsigned factor = 0;
+
+	/**
+	 * The number of bytes in the filter window; always a multiple of
+	 * #WINDOW_ALIGN.
+	 */
+	unsigned window = 0;
+
+public:
+	static constexpr unsigned TABLE_SIZE = 256;
+	static constexpr unsigned WINDOW_ALIGN = 8;
+
+	/**
+	 * The largest supported decimation factor.
+	 */
+	static constexpr unsigned MAX_FACTOR = 32;
+
+	/**
+	 * Has Generate() been called?
+	 */
+	bool IsDefined() const noexcept {
+		return factor != 0;
+	}
+
+	unsigned GetFactor() const noexcept {
+		return factor;
+	}
+
+	unsigned GetWindow() const noexcept {
+		return window;
+	}
+
+	/**
+	 * Calculate the lookup tables for the given decimation factor
+	 * (1 to #MAX_FACTOR).
+	 */
+	void Generate(unsigned factor) noexcept;
+
+	/**
+	 * Calculate output samples of one channel.
+	 *
+	 * @param dest the destination buffer; sample i is written to
+	 * dest[i * dest_stride]
+	 * @param src planar bytes of one channel, starting with the
+	 * window of the first output sample; the window of sample i
+	 * begins at src[i * GetFactor()]
+	 * @param n the number of output samples
+	 */
+	void Apply(float *dest, size_t dest_stride,
+		   const uint8_t *src, size_t n) const noexcept;
+};
+
+#endif
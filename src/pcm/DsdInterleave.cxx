@@ -0,0 +1,88 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "DsdInterleave.hxx"
+#include "BitReverse.hxx"
+#include "DsdSimd.hxx"
+#include "util/bit_reverse.h"
+
+#include <string.h>
+
+static void
+InterleaveDsdChannel(uint8_t *gcc_restrict dest,
+		     const uint8_t *gcc_restrict src,
+		     size_t n_frames, size_t channels,
+		     bool reverse) noexcept
+{
+	if (reverse) {
+		for (size_t i = 0; i != n_frames; ++i, dest += channels)
+			*dest = bit_reverse(src[i]);
+	} else {
+		for (size_t i = 0; i != n_frames; ++i, dest += channels)
+			*dest = src[i];
+	}
+}
+
+static void
+InterleaveDsdStereo(uint8_t *gcc_restrict dest,
+		    const uint8_t *gcc_restrict left,
+		    const uint8_t *gcc_restrict right,
+		    size_t n_frames, bool reverse) noexcept
+{
+#ifdef PCM_SIMD_SSE2
+	const size_t done =
+		pcm_interleave_dsd_stereo_sse2(dest, left, right,
+					       n_frames, reverse);
+#elif defined(PCM_SIMD_NEON)
+	const size_t done =
+		pcm_interleave_dsd_stereo_neon(dest, left, right,
+					       n_frames, reverse);
+#else
+	const size_t done = 0;
+#endif
+
+	dest += 2 * done;
+	n_frames -= done;
+
+	InterleaveDsdChannel(dest, left + done, n_frames, 2, reverse);
+	InterleaveDsdChannel(dest + 1, right + done, n_frames, 2, reverse);
+}
+
+void
+PcmInterleaveDsd(uint8_t *gcc_restrict dest,
+		 ConstBuffer<const uint8_t *> src,
+		 size_t n_frames, bool reverse) noexcept
+{
+	switch (src.size) {
+	case 1:
+		if (reverse)
+			PcmBitReverse(dest, src[0], n_frames);
+		else
+			memcpy(dest, src[0], n_frames);
+		return;
+
+	case 2:
+		InterleaveDsdStereo(dest, src[0], src[1], n_frames, reverse);
+		return;
+	}
+
+	for (const auto *s : src)
+		InterleaveDsdChannel(dest++, s, n_frames, src.size, reverse);
+}
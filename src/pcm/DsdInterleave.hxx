@@ -0,0 +1,40 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_DSD_INTERLEAVE_HXX
+#define MPD_PCM_DSD_INTERLEAVE_HXX
+
+#include "util/Compiler.h"
+#include "util/ConstBuffer.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Interleave planar DSD samples (one byte per channel and frame)
+ * from #src to #dest.  If #reverse is true, the bit order of each
+ * byte is reversed (see PcmBitReverse()) in the same pass.
+ */
+void
+PcmInterleaveDsd(uint8_t *gcc_restrict dest,
+		 ConstBuffer<const uint8_t *> src,
+		 size_t n_frames, bool reverse) noexcept;
+
+#endif
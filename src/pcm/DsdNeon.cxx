@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * DSD bit reversal and interleaving kernels for ARM NEON.
+ */
+
+#include "DsdSimd.hxx"
+
+#ifdef PCM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef PCM_SIMD_NEON_RBIT
+
+size_t
+pcm_bit_reverse_neon(uint8_t *dest, const uint8_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_u8(dest, vrbitq_u8(vld1q_u8(src)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+template<bool bit_reverse>
+static size_t
+InterleaveDsdStereoNeon(uint8_t *dest,
+			const uint8_t *left, const uint8_t *right,
+			size_t n_frames) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const size_t n_blocks = n_frames / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, left += BLOCK_SIZE, right += BLOCK_SIZE,
+		     dest += 2 * BLOCK_SIZE) {
+		uint8x16x2_t x;
+		x.val[0] = vld1q_u8(left);
+		x.val[1] = vld1q_u8(right);
+
+#ifdef PCM_SIMD_NEON_RBIT
+		if (bit_reverse) {
+			x.val[0] = vrbitq_u8(x.val[0]);
+			x.val[1] = vrbitq_u8(x.val[1]);
+		}
+#endif
+
+		vst2q_u8(dest, x);
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_interleave_dsd_stereo_neon(uint8_t *dest,
+			       const uint8_t *left, const uint8_t *right,
+			       size_t n_frames, bool bit_reverse) noexcept
+{
+	if (!bit_reverse)
+		return InterleaveDsdStereoNeon<false>(dest, left, right,
+						      n_frames);
+
+#ifdef PCM_SIMD_NEON_RBIT
+	return InterleaveDsdStereoNeon<true>(dest, left, right, n_frames);
+#else
+	/* no vector bit reversal on 32 bit ARM; let the caller do
+	   it */
+	return 0;
+#endif
+}
+
+#endif
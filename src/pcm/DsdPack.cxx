@@ -0,0 +1,126 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "DsdPack.hxx"
+#include "system/ByteOrder.hxx"
+
+#include <string.h>
+
+static constexpr uint8_t SILENT = 0x80;
+
+/**
+ * Pick the #PcmRouteShuffle kernel for this CPU.
+ */
+static auto
+GetShuffleKernel() noexcept
+	-> size_t (*)(uint8_t *, const uint8_t *, size_t,
+		      const PcmRouteShuffle &) noexcept
+{
+#ifdef PCM_SIMD_AVX2
+	if (PcmHaveAvx2())
+		return pcm_route_shuffle_avx2;
+#endif
+
+#ifdef PCM_SIMD_NEON_TBL
+	return pcm_route_shuffle_neon;
+#else
+	return nullptr;
+#endif
+}
+
+void
+PcmDsdPack::Open(Mode mode, unsigned channels) noexcept
+{
+	kernel = nullptr;
+
+	if (IsBigEndian())
+		/* the shuffles below assume little-endian output
+		   samples */
+		return;
+
+	/* the number of source and destination bytes per unit */
+	const size_t src_unit = (mode == Mode::U16 ? 2 : 4) * channels;
+	const size_t dest_unit = mode == Mode::DOP
+		? 8 * channels
+		: src_unit;
+
+	/* the shuffle kernels work on 16 bytes */
+	constexpr size_t WIDTH = 16;
+	if (dest_unit > WIDTH)
+		return;
+
+	group = WIDTH / dest_unit;
+
+	memset(shuffle.bytes, SILENT, sizeof(shuffle.bytes));
+	memset(shuffle.silence, 0, sizeof(shuffle.silence));
+	memset(shuffle.lanes, 0, sizeof(shuffle.lanes));
+	memset(shuffle.lane_mask, 0, sizeof(shuffle.lane_mask));
+	shuffle.src_frame_size = group * src_unit;
+	shuffle.dest_frame_size = group * dest_unit;
+
+	for (size_t g = 0; g < group; ++g) {
+		uint8_t *const b = shuffle.bytes + g * dest_unit;
+		uint8_t *const s = shuffle.silence + g * dest_unit;
+		const unsigned base = g * src_unit;
+
+		for (unsigned c = 0; c < channels; ++c) {
+			switch (mode) {
+			case Mode::U16:
+				/* the oldest byte is the most
+				   significant one */
+				b[2 * c] = base + channels + c;
+				b[2 * c + 1] = base + c;
+				break;
+
+			case Mode::U32:
+				for (unsigned i = 0; i < 4; ++i)
+					b[4 * c + i] = base + (3 - i) * channels + c;
+				break;
+
+			case Mode::DOP:
+				/* two 24 bit samples with 16 DSD
+				   bits and the alternating
+				   marker */
+				for (unsigned f = 0; f < 2; ++f) {
+					uint8_t *const fb = b + f * 4 * channels + 4 * c;
+					uint8_t *const fs = s + f * 4 * channels + 4 * c;
+					fb[0] = base + (2 * f + 1) * channels + c;
+					fb[1] = base + 2 * f * channels + c;
+					fs[2] = f == 0 ? 0x05 : 0xfa;
+					fs[3] = 0xff;
+				}
+
+				break;
+			}
+		}
+	}
+
+	kernel = GetShuffleKernel();
+}
+
+size_t
+PcmDsdPack::Apply(void *dest, const uint8_t *src,
+		  size_t n_units) const noexcept
+{
+	if (kernel == nullptr)
+		return 0;
+
+	return kernel((uint8_t *)dest, src, n_units / group, shuffle) * group;
+}
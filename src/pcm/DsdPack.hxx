@@ -0,0 +1,79 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_DSD_PACK_HXX
+#define MPD_PCM_DSD_PACK_HXX
+
+#include "RouteSimd.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A vectorized conversion from DSD_U8 to DSD_U16, DSD_U32 or DoP,
+ * compiled for one channel count by PcmExport::Open().  It is a
+ * fixed byte shuffle (plus the DoP markers), so it reuses the
+ * #PcmRouteShuffle kernels.
+ */
+class PcmDsdPack {
+	size_t (*kernel)(uint8_t *dest, const uint8_t *src, size_t n_frames,
+			 const PcmRouteShuffle &shuffle) noexcept = nullptr;
+
+	PcmRouteShuffle shuffle;
+
+	/**
+	 * The number of units (see Apply()) in one shuffled frame.
+	 */
+	size_t group;
+
+public:
+	enum class Mode {
+		U16,
+		U32,
+		DOP,
+	};
+
+	/**
+	 * Compile the shuffle.  If this CPU or this channel count is
+	 * not supported, the object stays disabled.
+	 */
+	void Open(Mode mode, unsigned channels) noexcept;
+
+	void Close() noexcept {
+		kernel = nullptr;
+	}
+
+	bool IsDefined() const noexcept {
+		return kernel != nullptr;
+	}
+
+	/**
+	 * Convert as many units as possible; a unit is one output
+	 * frame for DSD_U16 and DSD_U32, and a pair of output frames
+	 * for DoP.
+	 *
+	 * @return the number of units converted; the caller is
+	 * responsible for the remaining ones
+	 */
+	size_t Apply(void *dest, const uint8_t *src,
+		     size_t n_units) const noexcept;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_DSD_SIMD_HXX
+#define MPD_PCM_DSD_SIMD_HXX
+
+#include "Simd.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorized bit reversal kernels (see PcmBitReverse()).  Each one
+ * processes a multiple of its block size and returns the number of
+ * bytes it has written.
+ */
+
+#ifdef PCM_SIMD_AVX2
+size_t
+pcm_bit_reverse_avx2(uint8_t *dest, const uint8_t *src, size_t n) noexcept;
+#endif
+
+#ifdef PCM_SIMD_SSE2
+size_t
+pcm_bit_reverse_sse2(uint8_t *dest, const uint8_t *src, size_t n) noexcept;
+#endif
+
+#if defined(PCM_SIMD_NEON) && defined(__aarch64__)
+/* RBIT on vectors exists only on AArch64 */
+#define PCM_SIMD_NEON_RBIT
+
+size_t
+pcm_bit_reverse_neon(uint8_t *dest, const uint8_t *src, size_t n) noexcept;
+#endif
+
+/*
+ * Vectorized stereo DSD interleaving kernels (see
+ * PcmInterleaveDsd()) with optional bit reversal.  They return the
+ * number of frames they have written.
+ */
+
+#ifdef PCM_SIMD_SSE2
+size_t
+pcm_interleave_dsd_stereo_sse2(uint8_t *dest,
+			       const uint8_t *left, const uint8_t *right,
+			       size_t n_frames, bool bit_reverse) noexcept;
+#endif
+
+#ifdef PCM_SIMD_NEON
+size_t
+pcm_interleave_dsd_stereo_neon(uint8_t *dest,
+			       const uint8_t *left, const uint8_t *right,
+			       size_t n_frames, bool bit_reverse) noexcept;
+#endif
+
+#endif
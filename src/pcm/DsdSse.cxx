@@ -0,0 +1,154 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * DSD bit reversal and interleaving kernels for x86 (SSE2 and
+ * AVX2).
+ */
+
+#include "DsdSimd.hxx"
+
+#if defined(PCM_SIMD_SSE2) || defined(PCM_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+#ifdef PCM_SIMD_SSE2
+
+/**
+ * Swap two groups of bits within each byte.  The 16 bit shifts
+ * don't leak across bytes because of the masks.
+ */
+template<int bits>
+static inline __m128i
+SwapBitsSse2(__m128i x, __m128i mask) noexcept
+{
+	return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, bits), mask),
+			    _mm_slli_epi16(_mm_and_si128(x, mask), bits));
+}
+
+/**
+ * Reverse the bit order of each of the 16 bytes.
+ */
+static inline __m128i
+BitReverseSse2(__m128i x) noexcept
+{
+	x = SwapBitsSse2<1>(x, _mm_set1_epi8(0x55));
+	x = SwapBitsSse2<2>(x, _mm_set1_epi8(0x33));
+	return SwapBitsSse2<4>(x, _mm_set1_epi8(0x0f));
+}
+
+size_t
+pcm_bit_reverse_sse2(uint8_t *dest, const uint8_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest, BitReverseSse2(x));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+template<bool bit_reverse>
+static size_t
+InterleaveDsdStereoSse2(uint8_t *dest,
+			const uint8_t *left, const uint8_t *right,
+			size_t n_frames) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const size_t n_blocks = n_frames / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, left += BLOCK_SIZE, right += BLOCK_SIZE,
+		     dest += 2 * BLOCK_SIZE) {
+		__m128i l = _mm_loadu_si128((const __m128i *)left);
+		__m128i r = _mm_loadu_si128((const __m128i *)right);
+
+		if (bit_reverse) {
+			l = BitReverseSse2(l);
+			r = BitReverseSse2(r);
+		}
+
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_unpacklo_epi8(l, r));
+		_mm_storeu_si128((__m128i *)(dest + BLOCK_SIZE),
+				 _mm_unpackhi_epi8(l, r));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_interleave_dsd_stereo_sse2(uint8_t *dest,
+			       const uint8_t *left, const uint8_t *right,
+			       size_t n_frames, bool bit_reverse) noexcept
+{
+	return bit_reverse
+		? InterleaveDsdStereoSse2<true>(dest, left, right, n_frames)
+		: InterleaveDsdStereoSse2<false>(dest, left, right, n_frames);
+}
+
+#endif
+
+#ifdef PCM_SIMD_AVX2
+
+#ifndef AVX2_TARGET
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+AVX2_TARGET
+size_t
+pcm_bit_reverse_avx2(uint8_t *dest, const uint8_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 32;
+
+	/* look up each nibble: the reversed low nibble becomes the
+	   high nibble and vice versa */
+	const __m256i rev_high =
+		_mm256_setr_epi8(0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+				 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+				 0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+				 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0);
+	const __m256i rev_low =
+		_mm256_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+				 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+				 0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+				 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i lo = _mm256_and_si256(x, nibble);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4),
+						    nibble);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_or_si256(_mm256_shuffle_epi8(rev_high, lo),
+						    _mm256_shuffle_epi8(rev_low, hi)));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
@@ -18,15 +18,63 @@
  */
 
 #include "FallbackResampler.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 
+/**
+ * Determine the number of half-band stages which convert between the
+ * two sample rates.
+ *
+ * @param decimate_r receives whether the sample rate is reduced
+ * @return the number of stages, or 0 if the ratio is not supported
+ */
+static unsigned
+CountHalfbandStages(unsigned src_rate, unsigned dest_rate,
+		    bool &decimate_r) noexcept
+{
+	for (unsigned n = 1; n <= 3; ++n) {
+		if (dest_rate == src_rate << n) {
+			decimate_r = false;
+			return n;
+		}
+
+		if (n <= 2 && src_rate == dest_rate << n) {
+			decimate_r = true;
+			return n;
+		}
+	}
+
+	return 0;
+}
+
 AudioFormat
 FallbackPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
 {
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
+	bool decimate;
+	n_halfband = CountHalfbandStages(af.sample_rate, new_sample_rate,
+					 decimate);
+	if (n_halfband > 0) {
+		/* the half-band filters work with floating point
+		   samples */
+		af.format = SampleFormat::FLOAT;
+
+		for (unsigned i = 0; i < n_halfband; ++i)
+			halfband[i].Open(af.channels, decimate);
+
+		format = af;
+		out_rate = new_sample_rate;
+
+		AudioFormat result = af;
+		result.sample_rate = new_sample_rate;
+		return result;
+	}
+
 	switch (af.format) {
 	case SampleFormat::UNDEFINED:
 		assert(false);
@@ -60,6 +108,13 @@ FallbackPcmResampler::Close() noexcept
 {
 }
 
+void
+FallbackPcmResampler::Reset() noexcept
+{
+	for (unsigned i = 0; i < n_halfband; ++i)
+		halfband[i].Reset();
+}
+
 template<typename T>
 static ConstBuffer<T>
 pcm_resample_fallback(PcmBuffer &buffer,
@@ -95,6 +150,16 @@ pcm_resample_fallback(PcmBuffer &buffer,
 			dest_buffer[dest_pos++] = src[src_pos + 1];
 		}
 		break;
+	default:
+		for (unsigned dest_frame = 0; dest_frame < dest_frames;
+		     ++dest_frame) {
+			unsigned src_frame = dest_frame * src_rate / dest_rate;
+
+			std::copy_n(src.data + src_frame * channels, channels,
+				    dest_buffer + dest_pos);
+			dest_pos += channels;
+		}
+		break;
 	}
 
 	return { dest_buffer, dest_samples };
@@ -116,6 +181,13 @@ pcm_resample_fallback_void(PcmBuffer &buffer,
 ConstBuffer<void>
 FallbackPcmResampler::Resample(ConstBuffer<void> src)
 {
+	if (n_halfband > 0) {
+		auto f = ConstBuffer<float>::FromVoid(src);
+		for (unsigned i = 0; i < n_halfband; ++i)
+			f = halfband[i].Process(f);
+		return f.ToVoid();
+	}
+
 	switch (format.format) {
 	case SampleFormat::UNDEFINED:
 	case SampleFormat::S8:
@@ -22,22 +22,38 @@
 
 #include "Resampler.hxx"
 #include "PcmBuffer.hxx"
+#include "Halfband.hxx"
 #include "AudioFormat.hxx"
 #include "util/Compiler.h"
 
 /**
  * A naive resampler that is used when no external library was found
  * (or when the user explicitly asks for bad quality).
+ *
+ * Conversions by a factor of 2, 4, 8, 1/2 or 1/4 use a cascade of
+ * half-band filters (on floating point samples) instead of
+ * nearest-neighbour interpolation.
  */
 class FallbackPcmResampler final : public PcmResampler {
+	static constexpr unsigned MAX_HALFBAND_STAGES = 3;
+
 	AudioFormat format;
 	unsigned out_rate;
 
+	/**
+	 * The number of #halfband stages in use; 0 if the generic
+	 * nearest-neighbour code is used.
+	 */
+	unsigned n_halfband;
+
+	PcmHalfband halfband[MAX_HALFBAND_STAGES];
+
 	PcmBuffer buffer;
 
 public:
 	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
 	void Close() noexcept override;
+	void Reset() noexcept override;
 	ConstBuffer<void> Resample(ConstBuffer<void> src) override;
 };
 
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Sample format conversion kernels for ARM NEON.
+ */
+
+#include "FormatSimd.hxx"
+
+#ifdef PCM_SIMD_NEON
+
+#include "system/ByteOrder.hxx"
+
+#include <arm_neon.h>
+
+/* the factors used by FloatToIntegerSampleConvert and
+   IntegerToFloatSampleConvert */
+static constexpr float FACTOR_16 = 1 << 15;
+static constexpr float FACTOR_24 = 1 << 23;
+static constexpr float FACTOR_32 = 1u << 31;
+
+static constexpr float MAX_24 = (1 << 23) - 1;
+
+size_t
+pcm_convert_16_to_float_neon(float *dest, const int16_t *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const float32x4_t factor = vdupq_n_f32(1 / FACTOR_16);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const int16x8_t x = vld1q_s16(src);
+		const int32x4_t lo = vmovl_s16(vget_low_s16(x));
+		const int32x4_t hi = vmovl_s16(vget_high_s16(x));
+		vst1q_f32(dest, vmulq_f32(vcvtq_f32_s32(lo), factor));
+		vst1q_f32(dest + 4, vmulq_f32(vcvtq_f32_s32(hi), factor));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+static inline size_t
+ConvertInt32ToFloatNeon(float *dest, const int32_t *src, size_t n,
+			float _factor) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const float32x4_t factor = vdupq_n_f32(_factor);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_f32(dest, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src)),
+					  factor));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_24_to_float_neon(float *dest, const int32_t *src,
+			     size_t n) noexcept
+{
+	return ConvertInt32ToFloatNeon(dest, src, n, 1 / FACTOR_24);
+}
+
+size_t
+pcm_convert_32_to_float_neon(float *dest, const int32_t *src,
+			     size_t n) noexcept
+{
+	return ConvertInt32ToFloatNeon(dest, src, n, 1 / FACTOR_32);
+}
+
+size_t
+pcm_convert_float_to_16_neon(int16_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const float32x4_t factor = vdupq_n_f32(FACTOR_16);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		/* vcvtq_s32_f32() truncates and saturates, and
+		   vqmovn_s32() saturates again */
+		const int32x4_t a =
+			vcvtq_s32_f32(vmulq_f32(vld1q_f32(src), factor));
+		const int32x4_t b =
+			vcvtq_s32_f32(vmulq_f32(vld1q_f32(src + 4), factor));
+		vst1q_s16(dest, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_float_to_24_neon(int32_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const float32x4_t factor = vdupq_n_f32(FACTOR_24);
+	const float32x4_t min = vdupq_n_f32(-FACTOR_24);
+	const float32x4_t max = vdupq_n_f32(MAX_24);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		float32x4_t x = vmulq_f32(vld1q_f32(src), factor);
+		x = vminq_f32(vmaxq_f32(x, min), max);
+		vst1q_s32(dest, vcvtq_s32_f32(x));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_float_to_32_neon(int32_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const float32x4_t factor = vdupq_n_f32(FACTOR_32);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_s32(dest, vcvtq_s32_f32(vmulq_f32(vld1q_f32(src),
+							factor)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_16_to_24_neon(int32_t *dest, const int16_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const int16x8_t x = vld1q_s16(src);
+		vst1q_s32(dest, vshll_n_s16(vget_low_s16(x), 8));
+		vst1q_s32(dest + 4, vshll_n_s16(vget_high_s16(x), 8));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_16_to_32_neon(int32_t *dest, const int16_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const int16x8_t x = vld1q_s16(src);
+		vst1q_s32(dest, vshll_n_s16(vget_low_s16(x), 16));
+		vst1q_s32(dest + 4, vshll_n_s16(vget_high_s16(x), 16));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_24_to_32_neon(int32_t *dest, const int32_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_s32(dest, vshlq_n_s32(vld1q_s32(src), 8));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_32_to_24_neon(int32_t *dest, const int32_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_s32(dest, vshrq_n_s32(vld1q_s32(src), 8));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_byteswap_16_neon(uint16_t *dest, const uint16_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_u8((uint8_t *)dest,
+			 vrev16q_u8(vld1q_u8((const uint8_t *)src)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_byteswap_32_neon(uint32_t *dest, const uint32_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		vst1q_u8((uint8_t *)dest,
+			 vrev32q_u8(vld1q_u8((const uint8_t *)src)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_pack_24_neon(uint8_t *dest, const int32_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	if (IsBigEndian())
+		/* the de-interleaving below assumes little-endian
+		   samples */
+		return 0;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE * 3) {
+		/* split the samples into 4 byte planes, and store
+		   only the lower 3 of them */
+		const uint8x16x4_t x = vld4q_u8((const uint8_t *)src);
+		uint8x16x3_t y;
+		y.val[0] = x.val[0];
+		y.val[1] = x.val[1];
+		y.val[2] = x.val[2];
+		vst3q_u8(dest, y);
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_unpack_24_neon(int32_t *dest, const uint8_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	if (IsBigEndian())
+		return 0;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE * 3, dest += BLOCK_SIZE) {
+		const uint8x16x3_t x = vld3q_u8(src);
+
+		/* the most significant byte extends the sign */
+		uint8x16x4_t y;
+		y.val[0] = x.val[0];
+		y.val[1] = x.val[1];
+		y.val[2] = x.val[2];
+		y.val[3] = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(x.val[2]),
+							  7));
+		vst4q_u8((uint8_t *)dest, y);
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
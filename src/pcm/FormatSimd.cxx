@@ -0,0 +1,64 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "FormatSimd.hxx"
+
+#define PCM_FORMAT_KERNELS(suffix, pack, unpack) { \
+	pcm_convert_16_to_float_ ## suffix, \
+	pcm_convert_24_to_float_ ## suffix, \
+	pcm_convert_32_to_float_ ## suffix, \
+	pcm_convert_float_to_16_ ## suffix, \
+	pcm_convert_float_to_24_ ## suffix, \
+	pcm_convert_float_to_32_ ## suffix, \
+	pcm_convert_16_to_24_ ## suffix, \
+	pcm_convert_16_to_32_ ## suffix, \
+	pcm_convert_24_to_32_ ## suffix, \
+	pcm_convert_32_to_24_ ## suffix, \
+	pcm_byteswap_16_ ## suffix, \
+	pcm_byteswap_32_ ## suffix, \
+	pack, \
+	unpack, \
+}
+
+const PcmFormatKernels &
+GetPcmFormatKernels() noexcept
+{
+#ifdef PCM_SIMD_AVX2
+	static constexpr PcmFormatKernels avx2 =
+		PCM_FORMAT_KERNELS(avx2, pcm_pack_24_avx2, pcm_unpack_24_avx2);
+	if (PcmHaveAvx2())
+		return avx2;
+#endif
+
+#ifdef PCM_SIMD_SSE2
+	static constexpr PcmFormatKernels sse2 =
+		PCM_FORMAT_KERNELS(sse2, nullptr, nullptr);
+	return sse2;
+#elif defined(PCM_SIMD_NEON)
+	static constexpr PcmFormatKernels neon =
+		PCM_FORMAT_KERNELS(neon, pcm_pack_24_neon, pcm_unpack_24_neon);
+	return neon;
+#else
+	static constexpr PcmFormatKernels none{};
+	return none;
+#endif
+}
+
+#undef PCM_FORMAT_KERNELS
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_FORMAT_SIMD_HXX
+#define MPD_PCM_FORMAT_SIMD_HXX
+
+#include "Simd.hxx"
+#include "util/Compiler.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorized sample format conversion kernels.  Each one processes
+ * a multiple of its block size and returns the number of samples it
+ * has written; the caller is responsible for the remaining samples.
+ * Their results are identical to the portable implementations in
+ * PcmFormat.cxx, PcmPack.cxx and util/ByteReverse.cxx.
+ */
+
+#define PCM_FORMAT_SIMD_DECLARE(suffix) \
+	size_t \
+	pcm_convert_16_to_float_ ## suffix(float *dest, const int16_t *src, \
+					   size_t n) noexcept; \
+	size_t \
+	pcm_convert_24_to_float_ ## suffix(float *dest, const int32_t *src, \
+					   size_t n) noexcept; \
+	size_t \
+	pcm_convert_32_to_float_ ## suffix(float *dest, const int32_t *src, \
+					   size_t n) noexcept; \
+	size_t \
+	pcm_convert_float_to_16_ ## suffix(int16_t *dest, const float *src, \
+					   size_t n) noexcept; \
+	size_t \
+	pcm_convert_float_to_24_ ## suffix(int32_t *dest, const float *src, \
+					   size_t n) noexcept; \
+	size_t \
+	pcm_convert_float_to_32_ ## suffix(int32_t *dest, const float *src, \
+					   size_t n) noexcept; \
+	size_t \
+	pcm_convert_16_to_24_ ## suffix(int32_t *dest, const int16_t *src, \
+					size_t n) noexcept; \
+	size_t \
+	pcm_convert_16_to_32_ ## suffix(int32_t *dest, const int16_t *src, \
+					size_t n) noexcept; \
+	size_t \
+	pcm_convert_24_to_32_ ## suffix(int32_t *dest, const int32_t *src, \
+					size_t n) noexcept; \
+	size_t \
+	pcm_convert_32_to_24_ ## suffix(int32_t *dest, const int32_t *src, \
+					size_t n) noexcept; \
+	size_t \
+	pcm_byteswap_16_ ## suffix(uint16_t *dest, const uint16_t *src, \
+				   size_t n) noexcept; \
+	size_t \
+	pcm_byteswap_32_ ## suffix(uint32_t *dest, const uint32_t *src, \
+				   size_t n) noexcept;
+
+/*
+ * Packing 24 bit samples needs byte shuffles, which SSE2 doesn't
+ * have.
+ */
+
+#define PCM_PACK_SIMD_DECLARE(suffix) \
+	size_t \
+	pcm_pack_24_ ## suffix(uint8_t *dest, const int32_t *src, \
+			       size_t n) noexcept; \
+	size_t \
+	pcm_unpack_24_ ## suffix(int32_t *dest, const uint8_t *src, \
+				 size_t n) noexcept;
+
+#ifdef PCM_SIMD_AVX2
+PCM_FORMAT_SIMD_DECLARE(avx2)
+PCM_PACK_SIMD_DECLARE(avx2)
+#endif
+
+#ifdef PCM_SIMD_SSE2
+PCM_FORMAT_SIMD_DECLARE(sse2)
+#endif
+
+#ifdef PCM_SIMD_NEON
+PCM_FORMAT_SIMD_DECLARE(neon)
+PCM_PACK_SIMD_DECLARE(neon)
+#endif
+
+#undef PCM_FORMAT_SIMD_DECLARE
+#undef PCM_PACK_SIMD_DECLARE
+
+/**
+ * The sample format conversion kernels for this CPU.  A nullptr
+ * function pointer means that there is no kernel for this
+ * conversion.
+ */
+struct PcmFormatKernels {
+	size_t (*convert_16_to_float)(float *dest, const int16_t *src,
+				      size_t n) noexcept;
+	size_t (*convert_24_to_float)(float *dest, const int32_t *src,
+				      size_t n) noexcept;
+	size_t (*convert_32_to_float)(float *dest, const int32_t *src,
+				      size_t n) noexcept;
+	size_t (*convert_float_to_16)(int16_t *dest, const float *src,
+				      size_t n) noexcept;
+	size_t (*convert_float_to_24)(int32_t *dest, const float *src,
+				      size_t n) noexcept;
+	size_t (*convert_float_to_32)(int32_t *dest, const float *src,
+				      size_t n) noexcept;
+	size_t (*convert_16_to_24)(int32_t *dest, const int16_t *src,
+				   size_t n) noexcept;
+	size_t (*convert_16_to_32)(int32_t *dest, const int16_t *src,
+				   size_t n) noexcept;
+	size_t (*convert_24_to_32)(int32_t *dest, const int32_t *src,
+				   size_t n) noexcept;
+	size_t (*convert_32_to_24)(int32_t *dest, const int32_t *src,
+				   size_t n) noexcept;
+	size_t (*byteswap_16)(uint16_t *dest, const uint16_t *src,
+			      size_t n) noexcept;
+	size_t (*byteswap_32)(uint32_t *dest, const uint32_t *src,
+			      size_t n) noexcept;
+	size_t (*pack_24)(uint8_t *dest, const int32_t *src,
+			  size_t n) noexcept;
+	size_t (*unpack_24)(int32_t *dest, const uint8_t *src,
+			    size_t n) noexcept;
+};
+
+/**
+ * @return the kernels for this CPU; all of them are nullptr if
+ * there are no vectorized kernels
+ */
+gcc_pure
+const PcmFormatKernels &
+GetPcmFormatKernels() noexcept;
+
+#endif
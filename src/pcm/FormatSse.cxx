@@ -0,0 +1,604 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Sample format conversion kernels for x86 (SSE2 and AVX2).
+ */
+
+#include "FormatSimd.hxx"
+
+#if defined(PCM_SIMD_SSE2) || defined(PCM_SIMD_AVX2)
+
+#include <immintrin.h>
+
+/* the factors used by FloatToIntegerSampleConvert and
+   IntegerToFloatSampleConvert */
+static constexpr float FACTOR_16 = 1 << 15;
+static constexpr float FACTOR_24 = 1 << 23;
+static constexpr float FACTOR_32 = 1u << 31;
+
+static constexpr float MAX_24 = (1 << 23) - 1;
+
+#endif
+
+#ifdef PCM_SIMD_SSE2
+
+size_t
+pcm_convert_16_to_float_sse2(float *dest, const int16_t *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m128 factor = _mm_set1_ps(1 / FACTOR_16);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* sign-extend to 32 bit */
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_cvtepi32_ps(lo), factor));
+		_mm_storeu_ps(dest + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), factor));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+static inline size_t
+ConvertInt32ToFloatSse2(float *dest, const int32_t *src, size_t n,
+			float _factor) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const __m128 factor = _mm_set1_ps(_factor);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_cvtepi32_ps(x), factor));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_24_to_float_sse2(float *dest, const int32_t *src,
+			     size_t n) noexcept
+{
+	return ConvertInt32ToFloatSse2(dest, src, n, 1 / FACTOR_24);
+}
+
+size_t
+pcm_convert_32_to_float_sse2(float *dest, const int32_t *src,
+			     size_t n) noexcept
+{
+	return ConvertInt32ToFloatSse2(dest, src, n, 1 / FACTOR_32);
+}
+
+size_t
+pcm_convert_float_to_16_sse2(int16_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m128 factor = _mm_set1_ps(FACTOR_16);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		/* truncate like the portable code, and saturate
+		   while packing */
+		const __m128i a =
+			_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src), factor));
+		const __m128i b =
+			_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + 4), factor));
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(a, b));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_float_to_24_sse2(int32_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const __m128 factor = _mm_set1_ps(FACTOR_24);
+	const __m128 min = _mm_set1_ps(-FACTOR_24);
+	const __m128 max = _mm_set1_ps(MAX_24);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		/* clamping before the truncation gives the same
+		   result as clamping after it */
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(src), factor);
+		x = _mm_min_ps(_mm_max_ps(x, min), max);
+		_mm_storeu_si128((__m128i *)dest, _mm_cvttps_epi32(x));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_float_to_32_sse2(int32_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const __m128 factor = _mm_set1_ps(FACTOR_32);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128 x = _mm_mul_ps(_mm_loadu_ps(src), factor);
+
+		/* out-of-range values are converted to INT32_MIN;
+		   flip that to INT32_MAX for positive overflows */
+		const __m128i overflow =
+			_mm_castps_si128(_mm_cmpge_ps(x, factor));
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_xor_si128(_mm_cvttps_epi32(x), overflow));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_16_to_24_sse2(int32_t *dest, const int16_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m128i zero = _mm_setzero_si128();
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* the sample in the upper half, shifted right
+		   arithmetically */
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_srai_epi32(_mm_unpacklo_epi16(zero, x), 8));
+		_mm_storeu_si128((__m128i *)(dest + 4),
+				 _mm_srai_epi32(_mm_unpackhi_epi16(zero, x), 8));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_16_to_32_sse2(int32_t *dest, const int16_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m128i zero = _mm_setzero_si128();
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi16(zero, x));
+		_mm_storeu_si128((__m128i *)(dest + 4),
+				 _mm_unpackhi_epi16(zero, x));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_24_to_32_sse2(int32_t *dest, const int32_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_slli_epi32(_mm_loadu_si128((const __m128i *)src),
+						8));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_convert_32_to_24_sse2(int32_t *dest, const int32_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_srai_epi32(_mm_loadu_si128((const __m128i *)src),
+						8));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+static inline __m128i
+ByteSwap16Sse2(__m128i x) noexcept
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+size_t
+pcm_byteswap_16_sse2(uint16_t *dest, const uint16_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		_mm_storeu_si128((__m128i *)dest,
+				 ByteSwap16Sse2(_mm_loadu_si128((const __m128i *)src)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_byteswap_32_sse2(uint32_t *dest, const uint32_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		__m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* swap the 16 bit halves, then the bytes within
+		   them */
+		x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+		x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i *)dest, ByteSwap16Sse2(x));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
+
+#ifdef PCM_SIMD_AVX2
+
+#ifndef AVX2_TARGET
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+AVX2_TARGET
+size_t
+pcm_convert_16_to_float_avx2(float *dest, const int16_t *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256 factor = _mm256_set1_ps(1 / FACTOR_16);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+		_mm256_storeu_ps(dest, _mm256_mul_ps(_mm256_cvtepi32_ps(x),
+						     factor));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+static inline size_t
+ConvertInt32ToFloatAvx2(float *dest, const int32_t *src, size_t n,
+			float _factor) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256 factor = _mm256_set1_ps(_factor);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		_mm256_storeu_ps(dest, _mm256_mul_ps(_mm256_cvtepi32_ps(x),
+						     factor));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_24_to_float_avx2(float *dest, const int32_t *src,
+			     size_t n) noexcept
+{
+	return ConvertInt32ToFloatAvx2(dest, src, n, 1 / FACTOR_24);
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_32_to_float_avx2(float *dest, const int32_t *src,
+			     size_t n) noexcept
+{
+	return ConvertInt32ToFloatAvx2(dest, src, n, 1 / FACTOR_32);
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_float_to_16_avx2(int16_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const __m256 factor = _mm256_set1_ps(FACTOR_16);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i a =
+			_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src),
+							  factor));
+		const __m256i b =
+			_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 8),
+							  factor));
+
+		/* the pack operates on each 128 bit half separately;
+		   restore the order of the 64 bit quarters */
+		const __m256i c = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+							   _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)dest, c);
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_float_to_24_avx2(int32_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256 factor = _mm256_set1_ps(FACTOR_24);
+	const __m256 min = _mm256_set1_ps(-FACTOR_24);
+	const __m256 max = _mm256_set1_ps(MAX_24);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(src), factor);
+		x = _mm256_min_ps(_mm256_max_ps(x, min), max);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_cvttps_epi32(x));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_float_to_32_avx2(int32_t *dest, const float *src,
+			     size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256 factor = _mm256_set1_ps(FACTOR_32);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src), factor);
+		const __m256i overflow =
+			_mm256_castps_si256(_mm256_cmp_ps(x, factor, _CMP_GE_OQ));
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_xor_si256(_mm256_cvttps_epi32(x),
+						     overflow));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_16_to_24_avx2(int32_t *dest, const int16_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+		_mm256_storeu_si256((__m256i *)dest, _mm256_slli_epi32(x, 8));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_16_to_32_avx2(int32_t *dest, const int16_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+		_mm256_storeu_si256((__m256i *)dest, _mm256_slli_epi32(x, 16));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_24_to_32_avx2(int32_t *dest, const int32_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)src),
+						      8));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_convert_32_to_24_avx2(int32_t *dest, const int32_t *src,
+			  size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)src),
+						      8));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+static inline size_t
+ByteShuffleAvx2(uint8_t *dest, const uint8_t *src, size_t n_bytes,
+		__m256i control) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 32;
+
+	const size_t n_blocks = n_bytes / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE)
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)src),
+							control));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_byteswap_16_avx2(uint16_t *dest, const uint16_t *src, size_t n) noexcept
+{
+	const __m256i control =
+		_mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+				 9, 8, 11, 10, 13, 12, 15, 14,
+				 1, 0, 3, 2, 5, 4, 7, 6,
+				 9, 8, 11, 10, 13, 12, 15, 14);
+
+	return ByteShuffleAvx2((uint8_t *)dest, (const uint8_t *)src,
+			       n * 2, control) / 2;
+}
+
+AVX2_TARGET
+size_t
+pcm_byteswap_32_avx2(uint32_t *dest, const uint32_t *src, size_t n) noexcept
+{
+	const __m256i control =
+		_mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+				 11, 10, 9, 8, 15, 14, 13, 12,
+				 3, 2, 1, 0, 7, 6, 5, 4,
+				 11, 10, 9, 8, 15, 14, 13, 12);
+
+	return ByteShuffleAvx2((uint8_t *)dest, (const uint8_t *)src,
+			       n * 4, control) / 4;
+}
+
+AVX2_TARGET
+size_t
+pcm_pack_24_avx2(uint8_t *dest, const int32_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	/* each block yields 24 bytes, but the store writes 32 */
+	const size_t n_blocks = n >= BLOCK_SIZE + 3
+		? (n - 3) / BLOCK_SIZE
+		: 0;
+
+	/* drop the most significant byte of each sample (in each
+	   128 bit half), then move the 12 bytes of the upper half
+	   next to the lower one */
+	const __m256i control =
+		_mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+				 10, 12, 13, 14, -1, -1, -1, -1,
+				 0, 1, 2, 4, 5, 6, 8, 9,
+				 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE * 3) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i y = _mm256_shuffle_epi8(x, control);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_permutevar8x32_epi32(y, permute));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_unpack_24_avx2(int32_t *dest, const uint8_t *src, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	/* each block consumes 24 bytes, but the load reads 32 */
+	const size_t n_blocks = n >= BLOCK_SIZE + 3
+		? (n - 3) / BLOCK_SIZE
+		: 0;
+
+	/* move the upper 12 bytes to the upper 128 bit half, then
+	   expand each sample to 32 bit in the most significant
+	   bytes, and shift the sign down */
+	const __m256i permute = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i control =
+		_mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+				 -1, 6, 7, 8, -1, 9, 10, 11,
+				 -1, 0, 1, 2, -1, 3, 4, 5,
+				 -1, 6, 7, 8, -1, 9, 10, 11);
+
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE * 3, dest += BLOCK_SIZE) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i y =
+			_mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(x, permute),
+					    control);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_srai_epi32(y, 8));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
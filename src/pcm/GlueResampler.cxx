@@ -23,36 +23,47 @@
 
 #include <assert.h>
 
-GluePcmResampler::GluePcmResampler()
-	:resampler(pcm_resampler_create()) {}
+GluePcmResampler::GluePcmResampler() noexcept = default;
 
 GluePcmResampler::~GluePcmResampler() noexcept
 {
-	delete resampler;
+	assert(!resampler);
 }
 
 void
-GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate)
+GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate,
+		       const PcmResamplerProfile *profile)
 {
 	assert(src_format.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
+	assert(!resampler);
+
+	std::unique_ptr<PcmResampler> r(pcm_resampler_create(profile));
 
 	AudioFormat requested_format = src_format;
-	AudioFormat dest_format = resampler->Open(requested_format,
-						  new_sample_rate);
+	AudioFormat dest_format = r->Open(requested_format,
+					  new_sample_rate);
 	assert(dest_format.IsValid());
 
 	assert(requested_format.channels == src_format.channels);
 	assert(dest_format.channels == src_format.channels);
 	assert(dest_format.sample_rate == new_sample_rate);
 
-	if (requested_format.format != src_format.format)
-		format_converter.Open(src_format.format,
-				      requested_format.format);
+	if (requested_format.format != src_format.format) {
+		try {
+			format_converter.Open(src_format.format,
+					      requested_format.format);
+		} catch (...) {
+			r->Close();
+			throw;
+		}
+	}
 
 	src_sample_format = src_format.format;
 	requested_sample_format = requested_format.format;
 	output_sample_format = dest_format.format;
+
+	resampler = std::move(r);
 }
 
 void
@@ -62,6 +73,7 @@ GluePcmResampler::Close() noexcept
 		format_converter.Close();
 
 	resampler->Close();
+	resampler.reset();
 }
 
 void
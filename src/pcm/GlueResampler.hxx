@@ -23,7 +23,10 @@
 #include "AudioFormat.hxx"
 #include "FormatConverter.hxx"
 
+#include <memory>
+
 class PcmResampler;
+struct PcmResamplerProfile;
 template<typename T> struct ConstBuffer;
 
 /**
@@ -32,7 +35,11 @@ template<typename T> struct ConstBuffer;
  * #PcmResampler instance.
  */
 class GluePcmResampler {
-	PcmResampler *const resampler;
+	/**
+	 * The resampler; it is created by Open() from the selected
+	 * profile and destroyed by Close().
+	 */
+	std::unique_ptr<PcmResampler> resampler;
 
 	SampleFormat src_sample_format, requested_sample_format;
 	SampleFormat output_sample_format;
@@ -44,10 +51,15 @@ class GluePcmResampler {
 	PcmFormatConverter format_converter;
 
 public:
-	GluePcmResampler();
+	GluePcmResampler() noexcept;
 	~GluePcmResampler() noexcept;
 
-	void Open(AudioFormat src_format, unsigned new_sample_rate);
+	/**
+	 * @param profile the resampler profile; nullptr selects the
+	 * default profile
+	 */
+	void Open(AudioFormat src_format, unsigned new_sample_rate,
+		  const PcmResamplerProfile *profile=nullptr);
 	void Close() noexcept;
 
 	SampleFormat GetOutputSampleFormat() const noexcept {
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Halfband.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <algorithm>
+
+#include <assert.h>
+
+/**
+ * The odd taps of a half-band interpolation filter (windowed sinc,
+ * Kaiser window with beta=7): coefficient k weighs the two input
+ * samples (2k+1)/2 input frames away from the output sample.  Their
+ * sum is 0.5.  Above 18 kHz at 44.1 kHz, the passband deviates by
+ * less than 0.003 dB, and images are attenuated by at least 73 dB.
+ */
+static constexpr float halfband_coefficients[PcmHalfband::N_COEFFICIENTS] = {
+	6.346717141e-01f, -2.062587127e-01f, 1.176014159e-01f, -7.775917602e-02f,
+	5.448850626e-02f, -3.904182310e-02f, 2.807218188e-02f, -2.001375377e-02f,
+	1.401859986e-02f, -9.567520672e-03f, 6.306507405e-03f, -3.971919066e-03f,
+	2.354726788e-03f, -1.283257439e-03f, 6.149598762e-04f, -2.324492996e-04f,
+};
+
+void
+PcmHalfband::Open(unsigned _channels, bool _decimate) noexcept
+{
+	assert(audio_valid_channel_count(_channels));
+
+	channels = _channels;
+	decimate = _decimate;
+
+	Reset();
+}
+
+void
+PcmHalfband::Reset() noexcept
+{
+	/* start with silence, so the first output frame can be
+	   calculated from a full window */
+	n_history = GetReachLeft();
+	std::fill_n(history, n_history * channels, 0.0f);
+}
+
+/**
+ * Calculate the samples between the frames w and w+channels.
+ */
+template<unsigned channels>
+static inline void
+Interpolate(float *gcc_restrict dest, const float *w) noexcept
+{
+	float sum[channels] = {};
+	for (unsigned k = 0; k < PcmHalfband::N_COEFFICIENTS; ++k) {
+		const float *a = w - int(k * channels);
+		const float *b = w + (k + 1) * channels;
+		for (unsigned c = 0; c < channels; ++c)
+			sum[c] += halfband_coefficients[k] * (a[c] + b[c]);
+	}
+
+	std::copy_n(sum, channels, dest);
+}
+
+/**
+ * Calculate the low-pass filtered values of the frame w.
+ */
+template<unsigned channels>
+static inline void
+Decimate(float *gcc_restrict dest, const float *w) noexcept
+{
+	float sum[channels];
+	std::copy_n(w, channels, sum);
+	for (unsigned k = 0; k < PcmHalfband::N_COEFFICIENTS; ++k) {
+		const unsigned distance = (2 * k + 1) * channels;
+		const float *a = w - int(distance);
+		const float *b = w + distance;
+		for (unsigned c = 0; c < channels; ++c)
+			sum[c] += halfband_coefficients[k] * (a[c] + b[c]);
+	}
+
+	for (unsigned c = 0; c < channels; ++c)
+		dest[c] = 0.5f * sum[c];
+}
+
+/**
+ * Filter all frames from the given center (work index) while the
+ * window fits into the work buffer.
+ *
+ * @return the center of the first frame which was not processed
+ */
+template<unsigned channels>
+static size_t
+HalfbandLoop(float *&dest, const float *work, size_t n_frames,
+	     size_t center, unsigned reach_right, bool decimate) noexcept
+{
+	if (decimate) {
+		for (; center + reach_right < n_frames; center += 2) {
+			Decimate<channels>(dest, work + center * channels);
+			dest += channels;
+		}
+	} else {
+		for (; center + reach_right < n_frames; ++center) {
+			const float *w = work + center * channels;
+			dest = std::copy_n(w, channels, dest);
+			Interpolate<channels>(dest, w);
+			dest += channels;
+		}
+	}
+
+	return center;
+}
+
+ConstBuffer<float>
+PcmHalfband::Process(ConstBuffer<float> src) noexcept
+{
+	assert(src.size % channels == 0);
+
+	const unsigned reach_left = GetReachLeft();
+	const unsigned reach_right = GetReachRight();
+
+	/* concatenate the history and the new input */
+
+	const size_t n_frames = n_history + src.size / channels;
+	float *const work = work_buffer.GetT<float>(n_frames * channels);
+	std::copy_n(history, n_history * channels, work);
+	std::copy_n(src.data, src.size, work + n_history * channels);
+
+	const size_t max_output = decimate
+		? n_frames / 2 + 1
+		: n_frames * 2;
+	float *const output = output_buffer.GetT<float>(max_output * channels);
+	float *dest = output;
+
+	/* instantiate the filter loop for each channel count, so
+	   the compiler can keep all channels in registers */
+
+	size_t center = reach_left;
+	switch (channels) {
+#define HALFBAND_CASE(n) \
+	case n: \
+		center = HalfbandLoop<n>(dest, work, n_frames, center, \
+					 reach_right, decimate); \
+		break;
+
+	HALFBAND_CASE(1)
+	HALFBAND_CASE(2)
+	HALFBAND_CASE(3)
+	HALFBAND_CASE(4)
+	HALFBAND_CASE(5)
+	HALFBAND_CASE(6)
+	HALFBAND_CASE(7)
+	HALFBAND_CASE(8)
+#undef HALFBAND_CASE
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+
+	/* keep the frames which are still needed for the next
+	   output frame */
+
+	const size_t keep_from = center - reach_left;
+	n_history = n_frames - keep_from;
+	assert(n_history <= MAX_HISTORY);
+	std::copy_n(work + keep_from * channels, n_history * channels,
+		    history);
+
+	assert(dest <= output + max_output * channels);
+	return {output, size_t(dest - output)};
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_HALFBAND_HXX
+#define MPD_PCM_HALFBAND_HXX
+
+#include "PcmBuffer.hxx"
+#include "AudioFormat.hxx"
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * A half-band FIR filter which doubles or halves the sample rate of
+ * interleaved floating point samples.  Every other coefficient of a
+ * half-band filter is zero, therefore each output sample costs only
+ * #N_COEFFICIENTS multiplications.  Cascading several instances
+ * converts between sample rates with a ratio of 4 or 8.
+ *
+ * The filter keeps the tail of each block, so consecutive blocks
+ * are filtered without discontinuities.
+ */
+class PcmHalfband {
+public:
+	/**
+	 * The number of distinct non-zero coefficients besides the
+	 * center tap; the filter has 4*N_COEFFICIENTS-1 taps.
+	 */
+	static constexpr unsigned N_COEFFICIENTS = 16;
+
+private:
+	/**
+	 * The maximum number of frames kept in #history.
+	 */
+	static constexpr unsigned MAX_HISTORY = 4 * N_COEFFICIENTS - 2;
+
+	unsigned channels;
+
+	/**
+	 * Halve the sample rate instead of doubling it?
+	 */
+	bool decimate;
+
+	/**
+	 * The number of frames in #history.
+	 */
+	unsigned n_history;
+
+	/**
+	 * The input frames which have not been consumed completely
+	 * by the previous Process() call.
+	 */
+	float history[MAX_HISTORY * MAX_CHANNELS];
+
+	PcmBuffer work_buffer, output_buffer;
+
+public:
+	void Open(unsigned _channels, bool _decimate) noexcept;
+
+	/**
+	 * Forget the previous input.
+	 */
+	void Reset() noexcept;
+
+	/**
+	 * Filter a block of interleaved frames.  The last few input
+	 * frames are held back until the following block provides
+	 * the samples after them.  The returned buffer is valid
+	 * until the next call.
+	 */
+	ConstBuffer<float> Process(ConstBuffer<float> src) noexcept;
+
+private:
+	unsigned GetReachLeft() const noexcept {
+		return decimate ? 2 * N_COEFFICIENTS - 1 : N_COEFFICIENTS - 1;
+	}
+
+	unsigned GetReachRight() const noexcept {
+		return decimate ? 2 * N_COEFFICIENTS - 1 : N_COEFFICIENTS;
+	}
+};
+
+#endif
@@ -30,15 +30,15 @@
 
 static constexpr Domain libsamplerate_domain("libsamplerate");
 
-static int lsr_converter = SRC_SINC_FASTEST;
-
 static bool
-lsr_parse_converter(const char *s)
+lsr_parse_converter(const char *s, int &lsr_converter)
 {
 	assert(s != nullptr);
 
-	if (*s == 0)
+	if (*s == 0) {
+		lsr_converter = SRC_SINC_FASTEST;
 		return true;
+	}
 
 	char *endptr;
 	long l = strtol(s, &endptr, 10);
@@ -62,17 +62,20 @@ lsr_parse_converter(const char *s)
 	return false;
 }
 
-void
-pcm_resample_lsr_global_init(const ConfigBlock &block)
+int
+pcm_resample_lsr_parse(const ConfigBlock &block)
 {
 	const char *converter = block.GetBlockValue("type", "2");
-	if (!lsr_parse_converter(converter))
+	int lsr_converter;
+	if (!lsr_parse_converter(converter, lsr_converter))
 		throw FormatRuntimeError("unknown samplerate converter '%s'",
 					 converter);
 
 	FormatDebug(libsamplerate_domain,
 		    "libsamplerate converter '%s'",
 		    src_get_name(lsr_converter));
+
+	return lsr_converter;
 }
 
 AudioFormat
@@ -89,7 +92,7 @@ LibsampleratePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
 	af.format = SampleFormat::FLOAT;
 
 	int src_error;
-	state = src_new(lsr_converter, channels, &src_error);
+	state = src_new(converter, channels, &src_error);
 	if (!state)
 		throw FormatRuntimeError("libsamplerate initialization has failed: %s",
 					 src_strerror(src_error));
@@ -33,6 +33,8 @@ struct ConfigBlock;
  * A resampler using libsamplerate.
  */
 class LibsampleratePcmResampler final : public PcmResampler {
+	const int converter;
+
 	unsigned src_rate, dest_rate;
 	unsigned channels;
 
@@ -42,6 +44,9 @@ class LibsampleratePcmResampler final : public PcmResampler {
 	PcmBuffer buffer;
 
 public:
+	explicit LibsampleratePcmResampler(int _converter=SRC_SINC_FASTEST) noexcept
+		:converter(_converter) {}
+
 	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
 	void Close() noexcept override;
 	void Reset() noexcept override;
@@ -51,7 +56,14 @@ private:
 	ConstBuffer<float> Resample2(ConstBuffer<float> src);
 };
 
-void
-pcm_resample_lsr_global_init(const ConfigBlock &block);
+/**
+ * Parse the libsamplerate settings of a "resampler" block.
+ *
+ * Throws std::runtime_error on error.
+ *
+ * @return the libsamplerate converter type
+ */
+int
+pcm_resample_lsr_parse(const ConfigBlock &block);
 
 #endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "LoudnessMeter.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The absolute gating threshold [LUFS].
+ */
+static constexpr double ABSOLUTE_THRESHOLD = -70;
+
+/**
+ * The relative gating threshold [LU].
+ */
+static constexpr double RELATIVE_THRESHOLD = -10;
+
+static double
+ToLoudness(double mean_square) noexcept
+{
+	return -0.691 + 10 * log10(mean_square);
+}
+
+static double
+FromLoudness(double loudness) noexcept
+{
+	return pow(10, (loudness + 0.691) / 10);
+}
+
+void
+LoudnessMeter::Open(unsigned sample_rate, unsigned n_channels)
+{
+	assert(sample_rate > 0);
+	assert(n_channels > 0);
+
+	/* the K-weighting filter coefficients for arbitrary sample
+	   rates, derived from the 48 kHz coefficients specified in
+	   ITU-R BS.1770 */
+
+	{
+		const double f0 = 1681.974450955533;
+		const double G = 3.999843853973347;
+		const double Q = 0.7071752369554196;
+
+		const double K = tan(M_PI * f0 / sample_rate);
+		const double Vh = pow(10, G / 20);
+		const double Vb = pow(Vh, 0.4996667741545416);
+		const double a0 = 1 + K / Q + K * K;
+
+		shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		shelf.b1 = 2 * (K * K - Vh) / a0;
+		shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		shelf.a1 = 2 * (K * K - 1) / a0;
+		shelf.a2 = (1 - K / Q + K * K) / a0;
+	}
+
+	{
+		const double f0 = 38.13547087602444;
+		const double Q = 0.5003270373238773;
+
+		const double K = tan(M_PI * f0 / sample_rate);
+		const double a0 = 1 + K / Q + K * K;
+
+		highpass.b0 = 1;
+		highpass.b1 = -2;
+		highpass.b2 = 1;
+		highpass.a1 = 2 * (K * K - 1) / a0;
+		highpass.a2 = (1 - K / Q + K * K) / a0;
+	}
+
+	channels.assign(n_channels, ChannelState{{0, 0, 0, 0}, 1.0});
+	if (n_channels >= 6) {
+		/* 5.1 order: the LFE channel is not measured, the
+		   surround channels are weighted +1.5 dB */
+		channels[3].weight = 0;
+		channels[4].weight = channels[5].weight = 1.41;
+	}
+
+	step_frames = (sample_rate + 5) / 10;
+	step_position = 0;
+	step_sum = 0;
+	n_steps = 0;
+
+	blocks.clear();
+	peak = 0;
+}
+
+void
+LoudnessMeter::Feed(ConstBuffer<float> src) noexcept
+{
+	assert(!channels.empty());
+	assert(src.size % channels.size() == 0);
+
+	const double threshold = FromLoudness(ABSOLUTE_THRESHOLD);
+
+	const float *p = src.data;
+	for (size_t n = src.size / channels.size(); n > 0; --n) {
+		for (auto &c : channels) {
+			const float x = *p++;
+			const float a = fabsf(x);
+			if (a > peak)
+				peak = a;
+
+			double y = shelf.Apply(x, c.z[0], c.z[1]);
+			y = highpass.Apply(y, c.z[2], c.z[3]);
+			step_sum += c.weight * y * y;
+		}
+
+		if (++step_position < step_frames)
+			continue;
+
+		/* one 100 ms step is complete; gating blocks of 400 ms
+		   overlap by 75% */
+
+		steps[n_steps++ % 4] = step_sum / step_frames;
+		step_position = 0;
+		step_sum = 0;
+
+		if (n_steps >= 4) {
+			const double block = (steps[0] + steps[1] +
+					      steps[2] + steps[3]) / 4;
+			if (block > threshold)
+				blocks.push_back(block);
+		}
+	}
+}
+
+double
+LoudnessMeter::Integrate(const std::vector<double> &blocks) noexcept
+{
+	if (blocks.empty())
+		return NAN;
+
+	double sum = 0;
+	for (double i : blocks)
+		sum += i;
+
+	const double relative_threshold =
+		FromLoudness(ToLoudness(sum / blocks.size())
+			     + RELATIVE_THRESHOLD);
+
+	sum = 0;
+	size_t n = 0;
+	for (double i : blocks) {
+		if (i > relative_threshold) {
+			sum += i;
+			++n;
+		}
+	}
+
+	if (n == 0)
+		return NAN;
+
+	return ToLoudness(sum / n);
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_LOUDNESS_METER_HXX
+#define MPD_PCM_LOUDNESS_METER_HXX
+
+#include "util/Compiler.h"
+
+#include <vector>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Measures the integrated loudness of a stream according to EBU
+ * R128 / ITU-R BS.1770: the samples are K-weighted, and the mean
+ * square is calculated for overlapping gating blocks of 400 ms.
+ */
+class LoudnessMeter {
+	/**
+	 * A biquad IIR filter section (direct form II transposed).
+	 */
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+
+		double Apply(double x, double &z1, double &z2) const noexcept {
+			const double y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			return y;
+		}
+	};
+
+	/**
+	 * The two stages of the K-weighting filter: a high shelf
+	 * modelling the head, and a high pass.
+	 */
+	Biquad shelf, highpass;
+
+	struct ChannelState {
+		double z[4];
+		double weight;
+	};
+
+	std::vector<ChannelState> channels;
+
+	/**
+	 * The number of frames in one 100 ms step.
+	 */
+	unsigned step_frames;
+
+	/**
+	 * The number of frames in the current step.
+	 */
+	unsigned step_position;
+
+	/**
+	 * The weighted sum of squares of the current step.
+	 */
+	double step_sum;
+
+	/**
+	 * The mean squares of the last four steps; one gating block
+	 * consists of four steps.
+	 */
+	double steps[4];
+	unsigned n_steps;
+
+	/**
+	 * The mean square of all gating blocks above the absolute
+	 * threshold (-70 LUFS).
+	 */
+	std::vector<double> blocks;
+
+	float peak;
+
+public:
+	/**
+	 * @param sample_rate the sample rate of the input
+	 * @param n_channels the number of (interleaved) channels; with
+	 * 6 or more, channel 3 is LFE (ignored) and channels 4 and 5
+	 * are surround channels
+	 */
+	void Open(unsigned sample_rate, unsigned n_channels);
+
+	/**
+	 * Analyze more samples.
+	 *
+	 * @param src interleaved floating point samples (-1.0 ..
+	 * 1.0); the size must be a multiple of the number of channels
+	 */
+	void Feed(ConstBuffer<float> src) noexcept;
+
+	/**
+	 * The highest absolute sample value seen so far.
+	 */
+	float GetPeak() const noexcept {
+		return peak;
+	}
+
+	/**
+	 * The mean squares of all gating blocks above the absolute
+	 * threshold; pass the concatenation of several meters to
+	 * Integrate() to calculate the loudness of an album.
+	 */
+	const std::vector<double> &GetBlocks() const noexcept {
+		return blocks;
+	}
+
+	/**
+	 * The integrated loudness in LUFS; NaN if there was no
+	 * audible gating block.
+	 */
+	gcc_pure
+	double GetLoudness() const noexcept {
+		return Integrate(blocks);
+	}
+
+	/**
+	 * Calculate the gated integrated loudness of the given
+	 * blocks in LUFS; NaN if there are none.
+	 */
+	gcc_pure
+	static double Integrate(const std::vector<double> &blocks) noexcept;
+};
+
+#endif
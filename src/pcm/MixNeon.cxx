@@ -0,0 +1,135 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * pcm_mix() kernels for ARM NEON.
+ */
+
+#include "MixSimd.hxx"
+
+#ifdef PCM_SIMD_NEON
+
+#include "NeonDither.hxx"
+#include "Traits.hxx"
+
+size_t
+pcm_add_vol_16_neon(PcmDitherLanes &lanes,
+		    int16_t *a, const int16_t *b, size_t n,
+		    int vol1, int vol2) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	NeonDither dither(lanes);
+	const int16_t v1 = vol1, v2 = vol2;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		const int16x8_t x = vld1q_s16(a);
+		const int16x8_t y = vld1q_s16(b);
+
+		const int32x4_t lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(x), v1),
+						 vget_low_s16(y), v2);
+		const int32x4_t hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(x), v1),
+						 vget_high_s16(y), v2);
+
+		const int32x4_t c = dither.Dither(lo);
+		const int32x4_t d = dither.Dither(hi);
+		vst1q_s16(a, vcombine_s16(vqmovn_s32(c), vqmovn_s32(d)));
+	}
+
+	dither.Store(lanes);
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_vol_float_neon(float *a, const float *b, size_t n,
+		       float vol1, float vol2) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		vst1q_f32(a, vaddq_f32(vmulq_n_f32(vld1q_f32(a), vol1),
+				       vmulq_n_f32(vld1q_f32(b), vol2)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_16_neon(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		vst1q_s16(a, vqaddq_s16(vld1q_s16(a), vld1q_s16(b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_24_neon(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const int32x4_t max = vdupq_n_s32(Traits::MAX);
+	const int32x4_t min = vdupq_n_s32(Traits::MIN);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		/* 24 bit samples cannot overflow the 32 bit sum */
+		const int32x4_t sum = vaddq_s32(vld1q_s32(a), vld1q_s32(b));
+		vst1q_s32(a, vmaxq_s32(vminq_s32(sum, max), min));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_32_neon(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		vst1q_s32(a, vqaddq_s32(vld1q_s32(a), vld1q_s32(b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_float_neon(float *a, const float *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		vst1q_f32(a, vaddq_f32(vld1q_f32(a), vld1q_f32(b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
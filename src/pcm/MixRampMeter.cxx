@@ -0,0 +1,157 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "MixRampMeter.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+/**
+ * The lowest level in the profile [dBFS]; all quieter windows
+ * (including digital silence) are clamped to it.
+ */
+static constexpr double MIN_LEVEL = -120;
+
+/**
+ * The levels listed in the profile [dBFS], in addition to the
+ * highest level of the song.
+ */
+static constexpr double LEVEL_STEP = 3;
+static constexpr double LOWEST_LEVEL = -42;
+
+void
+MixRampMeter::Open(unsigned _sample_rate, unsigned _n_channels)
+{
+	assert(_sample_rate > 0);
+	assert(_n_channels > 0);
+
+	n_channels = _n_channels;
+	sample_rate = _sample_rate;
+	window_frames = std::max(_sample_rate / 10, 1u);
+	window_duration = window_frames / sample_rate;
+	window_position = 0;
+	window_sum = 0;
+	n_frames = 0;
+	levels.clear();
+}
+
+void
+MixRampMeter::Feed(ConstBuffer<float> src) noexcept
+{
+	assert(src.size % n_channels == 0);
+
+	for (size_t i = 0; i < src.size; i += n_channels) {
+		for (unsigned c = 0; c < n_channels; ++c) {
+			const double x = src.data[i + c];
+			window_sum += x * x;
+		}
+
+		if (++window_position == window_frames) {
+			const double mean_square = window_sum /
+				(double(window_frames) * n_channels);
+			const double level = mean_square > 0
+				? 10 * log10(mean_square)
+				: MIN_LEVEL;
+			levels.push_back(std::max(level, MIN_LEVEL));
+
+			window_position = 0;
+			window_sum = 0;
+		}
+	}
+
+	n_frames += src.size / n_channels;
+}
+
+static void
+AppendPair(std::string &dest, double level, double seconds) noexcept
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.2f %.2f",
+		 level, std::max(seconds, 0.));
+
+	if (!dest.empty())
+		dest.push_back(';');
+	dest.append(buffer);
+}
+
+/**
+ * Generate the profile.
+ *
+ * @param f a function returning the time at which the given
+ * window index is reached
+ * @param find a function returning the index of the window which
+ * determines the given level, beginning the search at the index
+ * found for the previous (lower) level
+ */
+template<typename F, typename Find>
+static std::string
+MakeProfile(const std::vector<float> &levels, F &&f, Find &&find) noexcept
+{
+	std::string result;
+	if (levels.empty())
+		return result;
+
+	const double max_level =
+		*std::max_element(levels.begin(), levels.end());
+
+	for (double level = LOWEST_LEVEL; level < max_level;
+	     level += LEVEL_STEP)
+		AppendPair(result, level, f(find(level)));
+
+	AppendPair(result, max_level, f(find(max_level)));
+	return result;
+}
+
+std::string
+MixRampMeter::GetStart() const noexcept
+{
+	size_t i = 0;
+
+	return MakeProfile(levels,
+			   [this](size_t index){
+				   return index * window_duration;
+			   },
+			   [this, &i](double level){
+				   while (levels[i] < level)
+					   ++i;
+				   return i;
+			   });
+}
+
+std::string
+MixRampMeter::GetEnd() const noexcept
+{
+	size_t i = levels.size() - 1;
+
+	return MakeProfile(levels,
+			   [this](size_t index){
+				   return n_frames / sample_rate -
+					   (index + 1) * window_duration;
+			   },
+			   [this, &i](double level){
+				   while (levels[i] < level)
+					   --i;
+				   return i;
+			   });
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_MIX_RAMP_METER_HXX
+#define MPD_PCM_MIX_RAMP_METER_HXX
+
+#include "util/Compiler.h"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Measures the volume profile of a song for MixRamp: the RMS level
+ * of consecutive 100 ms windows.  The result is formatted like the
+ * MIXRAMP_START and MIXRAMP_END tags, i.e. a list of "dB seconds"
+ * pairs with increasing dB values.
+ */
+class MixRampMeter {
+	unsigned n_channels;
+
+	/**
+	 * The number of frames in one window.
+	 */
+	unsigned window_frames;
+
+	/**
+	 * The number of frames in the current window.
+	 */
+	unsigned window_position;
+
+	/**
+	 * The sum of squares of the current window.
+	 */
+	double window_sum;
+
+	/**
+	 * The duration of one window [s].
+	 */
+	double window_duration;
+
+	/**
+	 * The total number of frames.
+	 */
+	uint64_t n_frames;
+
+	double sample_rate;
+
+	/**
+	 * The RMS level of each complete window [dBFS].
+	 */
+	std::vector<float> levels;
+
+public:
+	/**
+	 * @param sample_rate the sample rate of the input
+	 * @param n_channels the number of (interleaved) channels
+	 */
+	void Open(unsigned sample_rate, unsigned n_channels);
+
+	/**
+	 * Analyze more samples.
+	 *
+	 * @param src interleaved floating point samples (-1.0 ..
+	 * 1.0); the size must be a multiple of the number of channels
+	 */
+	void Feed(ConstBuffer<float> src) noexcept;
+
+	/**
+	 * The time from the beginning of the song until each level
+	 * is reached for the first time (MIXRAMP_START).  Empty if
+	 * the song is shorter than one window.
+	 */
+	gcc_pure
+	std::string GetStart() const noexcept;
+
+	/**
+	 * The time from the last window reaching each level until
+	 * the end of the song (MIXRAMP_END).  Empty if the song is
+	 * shorter than one window.
+	 */
+	gcc_pure
+	std::string GetEnd() const noexcept;
+};
+
+#endif
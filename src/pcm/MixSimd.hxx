@@ -0,0 +1,75 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_MIX_SIMD_HXX
+#define MPD_PCM_MIX_SIMD_HXX
+
+#include "Simd.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct PcmDitherLanes;
+
+/*
+ * Vectorized kernels for pcm_mix().  Each one processes a multiple
+ * of its block size and returns the number of samples it has
+ * written; the caller is responsible for the remaining samples.
+ *
+ * The "add_vol" kernels calculate a*vol1+b*vol2 (with the volumes
+ * in the range [0..#PCM_VOLUME_1]); the "add" kernels add the two
+ * buffers and clamp the result.
+ */
+
+#define PCM_MIX_SIMD_DECLARE(suffix) \
+	size_t \
+	pcm_add_vol_16_ ## suffix(PcmDitherLanes &lanes, \
+				  int16_t *a, const int16_t *b, size_t n, \
+				  int vol1, int vol2) noexcept; \
+	size_t \
+	pcm_add_vol_float_ ## suffix(float *a, const float *b, size_t n, \
+				     float vol1, float vol2) noexcept; \
+	size_t \
+	pcm_add_16_ ## suffix(int16_t *a, const int16_t *b, \
+			      size_t n) noexcept; \
+	size_t \
+	pcm_add_24_ ## suffix(int32_t *a, const int32_t *b, \
+			      size_t n) noexcept; \
+	size_t \
+	pcm_add_32_ ## suffix(int32_t *a, const int32_t *b, \
+			      size_t n) noexcept; \
+	size_t \
+	pcm_add_float_ ## suffix(float *a, const float *b, \
+				 size_t n) noexcept;
+
+#ifdef PCM_SIMD_AVX2
+PCM_MIX_SIMD_DECLARE(avx2)
+#endif
+
+#ifdef PCM_SIMD_SSE2
+PCM_MIX_SIMD_DECLARE(sse2)
+#endif
+
+#ifdef PCM_SIMD_NEON
+PCM_MIX_SIMD_DECLARE(neon)
+#endif
+
+#undef PCM_MIX_SIMD_DECLARE
+
+#endif
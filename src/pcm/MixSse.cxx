@@ -0,0 +1,296 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * pcm_mix() kernels for x86 (SSE2 and AVX2).
+ */
+
+#include "MixSimd.hxx"
+#include "SseDither.hxx"
+#include "Traits.hxx"
+
+#ifdef PCM_SIMD_SSE2
+
+size_t
+pcm_add_vol_16_sse2(PcmDitherLanes &lanes,
+		    int16_t *a, const int16_t *b, size_t n,
+		    int vol1, int vol2) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	SseDither dither(lanes);
+
+	/* pairs of (vol1, vol2) for _mm_madd_epi16() */
+	const __m128i v = _mm_set1_epi32((vol2 << 16) | (vol1 & 0xffff));
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)a);
+		const __m128i y = _mm_loadu_si128((const __m128i *)b);
+
+		const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, y), v);
+		const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, y), v);
+
+		const __m128i c = dither.Dither(lo);
+		const __m128i d = dither.Dither(hi);
+		_mm_storeu_si128((__m128i *)a, _mm_packs_epi32(c, d));
+	}
+
+	dither.Store(lanes);
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_vol_float_sse2(float *a, const float *b, size_t n,
+		       float vol1, float vol2) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const __m128 v1 = _mm_set1_ps(vol1), v2 = _mm_set1_ps(vol2);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		_mm_storeu_ps(a, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a), v1),
+					    _mm_mul_ps(_mm_loadu_ps(b), v2)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_16_sse2(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		_mm_storeu_si128((__m128i *)a,
+				 _mm_adds_epi16(_mm_loadu_si128((const __m128i *)a),
+						_mm_loadu_si128((const __m128i *)b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_24_sse2(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const __m128i max = _mm_set1_epi32(Traits::MAX);
+	const __m128i min = _mm_set1_epi32(Traits::MIN);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		/* 24 bit samples cannot overflow the 32 bit sum */
+		__m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i *)a),
+					    _mm_loadu_si128((const __m128i *)b));
+		sum = SseDither::Select(_mm_cmpgt_epi32(sum, max), max, sum);
+		sum = SseDither::Select(_mm_cmplt_epi32(sum, min), min, sum);
+		_mm_storeu_si128((__m128i *)a, sum);
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_32_sse2(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const __m128i max = _mm_set1_epi32(INT32_MAX);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)a);
+		const __m128i y = _mm_loadu_si128((const __m128i *)b);
+		const __m128i sum = _mm_add_epi32(x, y);
+
+		/* saturate: the sum has overflowed if both operands
+		   have the same sign, but the sum's sign differs;
+		   the result is then INT32_MAX for positive operands
+		   and INT32_MIN for negative ones */
+		const __m128i overflow =
+			_mm_srai_epi32(_mm_andnot_si128(_mm_xor_si128(x, y),
+							_mm_xor_si128(x, sum)),
+				       31);
+		const __m128i saturated =
+			_mm_xor_si128(_mm_srai_epi32(x, 31), max);
+		_mm_storeu_si128((__m128i *)a,
+				 SseDither::Select(overflow, saturated, sum));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_add_float_sse2(float *a, const float *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 4;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		_mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a),
+					    _mm_loadu_ps(b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
+
+#ifdef PCM_SIMD_AVX2
+
+AVX2_TARGET
+size_t
+pcm_add_vol_16_avx2(PcmDitherLanes &lanes,
+		    int16_t *a, const int16_t *b, size_t n,
+		    int vol1, int vol2) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	Avx2Dither dither(lanes);
+	const __m256i v = _mm256_set1_epi32((vol2 << 16) | (vol1 & 0xffff));
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)a);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)b);
+
+		/* unpack and pack operate on each 128 bit half
+		   separately, which cancels out */
+		const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(x, y), v);
+		const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(x, y), v);
+
+		const __m256i c = dither.Dither(lo);
+		const __m256i d = dither.Dither(hi);
+		_mm256_storeu_si256((__m256i *)a, _mm256_packs_epi32(c, d));
+	}
+
+	dither.Store(lanes);
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_add_vol_float_avx2(float *a, const float *b, size_t n,
+		       float vol1, float vol2) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256 v1 = _mm256_set1_ps(vol1), v2 = _mm256_set1_ps(vol2);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a), v1),
+						  _mm256_mul_ps(_mm256_loadu_ps(b), v2)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_add_16_avx2(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		_mm256_storeu_si256((__m256i *)a,
+				    _mm256_adds_epi16(_mm256_loadu_si256((const __m256i *)a),
+						      _mm256_loadu_si256((const __m256i *)b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_add_24_avx2(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256i max = _mm256_set1_epi32(Traits::MAX);
+	const __m256i min = _mm256_set1_epi32(Traits::MIN);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		__m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)a),
+					       _mm256_loadu_si256((const __m256i *)b));
+		sum = _mm256_max_epi32(_mm256_min_epi32(sum, max), min);
+		_mm256_storeu_si256((__m256i *)a, sum);
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_add_32_avx2(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m256i max = _mm256_set1_epi32(INT32_MAX);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)a);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)b);
+		const __m256i sum = _mm256_add_epi32(x, y);
+
+		/* see pcm_add_32_sse2() */
+		const __m256i overflow =
+			_mm256_srai_epi32(_mm256_andnot_si256(_mm256_xor_si256(x, y),
+							      _mm256_xor_si256(x, sum)),
+					  31);
+		const __m256i saturated =
+			_mm256_xor_si256(_mm256_srai_epi32(x, 31), max);
+		_mm256_storeu_si256((__m256i *)a,
+				    _mm256_blendv_epi8(sum, saturated,
+						       overflow));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_add_float_avx2(float *a, const float *b, size_t n) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, a += BLOCK_SIZE, b += BLOCK_SIZE)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_loadu_ps(a),
+						  _mm256_loadu_ps(b)));
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
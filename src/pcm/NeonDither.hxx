@@ -0,0 +1,109 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_NEON_DITHER_HXX
+#define MPD_PCM_NEON_DITHER_HXX
+
+#include "PcmDither.hxx"
+#include "Volume.hxx"
+
+#include <arm_neon.h>
+
+/* the constants of PcmDither::DitherShift<int32_t, 26, 16>(),
+   i.e. 16 bit samples multiplied with a #PCM_VOLUME_BITS fixed-point
+   volume, and of pcm_prng() */
+static constexpr unsigned SIMD_DITHER_SCALE_BITS = PCM_VOLUME_BITS;
+static constexpr int32_t SIMD_DITHER_ROUND = 1 << (SIMD_DITHER_SCALE_BITS - 1);
+static constexpr int32_t SIMD_DITHER_MASK = (1 << SIMD_DITHER_SCALE_BITS) - 1;
+static constexpr int32_t SIMD_DITHER_MAX = (1 << (16 + PCM_VOLUME_BITS - 1)) - 1;
+static constexpr int32_t SIMD_DITHER_MIN = -SIMD_DITHER_MAX - 1;
+static constexpr uint32_t SIMD_PRNG_MUL = 0x0019660d;
+static constexpr uint32_t SIMD_PRNG_ADD = 0x3c6ef35f;
+
+/**
+ * The state of four dither lanes in NEON registers.
+ */
+struct NeonDither {
+	int32x4_t e0, e1, e2;
+	uint32x4_t random;
+
+	/* see PcmDitherLanes::shape_mask */
+	const int32x4_t shape_mask, noise_mask;
+
+	explicit NeonDither(const PcmDitherLanes &lanes) noexcept
+		:e0(vld1q_s32(lanes.error0)),
+		 e1(vld1q_s32(lanes.error1)),
+		 e2(vld1q_s32(lanes.error2)),
+		 random(vreinterpretq_u32_s32(vld1q_s32(lanes.random))),
+		 shape_mask(vdupq_n_s32(lanes.shape_mask)),
+		 noise_mask(vdupq_n_s32(lanes.noise_mask)) {}
+
+	void Store(PcmDitherLanes &lanes) const noexcept {
+		vst1q_s32(lanes.error0, e0);
+		vst1q_s32(lanes.error1, e1);
+		vst1q_s32(lanes.error2, e2);
+		vst1q_s32(lanes.random, vreinterpretq_s32_u32(random));
+	}
+
+	/**
+	 * The vectorized equivalent of PcmDither::Dither().
+	 */
+	int32x4_t Dither(int32x4_t sample) noexcept {
+		const int32x4_t mask = vdupq_n_s32(SIMD_DITHER_MASK);
+		const int32x4_t max = vdupq_n_s32(SIMD_DITHER_MAX);
+		const int32x4_t min = vdupq_n_s32(SIMD_DITHER_MIN);
+
+		sample = vaddq_s32(sample,
+				   vandq_s32(vaddq_s32(vsubq_s32(e0, e1), e2),
+					     shape_mask));
+
+		e2 = e1;
+		/* signed division by 2, rounding towards zero */
+		e1 = vshrq_n_s32(vaddq_s32(e0,
+					   vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(e0), 31))),
+				 1);
+
+		int32x4_t output = vaddq_s32(sample, vdupq_n_s32(SIMD_DITHER_ROUND));
+
+		const uint32x4_t rnd = vmlaq_n_u32(vdupq_n_u32(SIMD_PRNG_ADD),
+						   random, SIMD_PRNG_MUL);
+		output = vaddq_s32(output,
+				   vandq_s32(vsubq_s32(vandq_s32(vreinterpretq_s32_u32(rnd), mask),
+						       vandq_s32(vreinterpretq_s32_u32(random), mask)),
+					     noise_mask));
+		random = rnd;
+
+		/* clip */
+		const uint32x4_t over = vcgtq_s32(output, max);
+		output = vminq_s32(output, max);
+		sample = vbslq_s32(over, vminq_s32(sample, max), sample);
+
+		const uint32x4_t under = vcltq_s32(output, min);
+		output = vmaxq_s32(output, min);
+		sample = vbslq_s32(under, vmaxq_s32(sample, min), sample);
+
+		output = vbicq_s32(output, mask);
+		e0 = vsubq_s32(sample, output);
+
+		return vshrq_n_s32(output, SIMD_DITHER_SCALE_BITS);
+	}
+};
+
+
+#endif
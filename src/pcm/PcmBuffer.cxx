@@ -18,6 +18,25 @@
  */
 
 #include "PcmBuffer.hxx"
+#include "BufferPool.hxx"
+
+/**
+ * After this number of consecutive Get() calls which needed less
+ * than a quarter of the capacity, the buffer is shrunk.
+ */
+static constexpr unsigned SHRINK_AFTER = 64;
+
+void
+PcmBuffer::Clear() noexcept
+{
+	if (buffer != nullptr) {
+		pcm_buffer_pool_release(buffer, capacity);
+		buffer = nullptr;
+		capacity = 0;
+	}
+
+	n_small = 0;
+}
 
 void *
 PcmBuffer::Get(size_t new_size) noexcept
@@ -27,5 +46,23 @@ PcmBuffer::Get(size_t new_size) noexcept
 		   assumed to be an error condition */
 		new_size = 1;
 
-	return buffer.Get(new_size);
+	if (gcc_unlikely(new_size > capacity)) {
+		/* too small: grow */
+		Clear();
+	} else if (new_size <= capacity / 4 &&
+		   capacity > PCM_BUFFER_POOL_MIN_SIZE) {
+		if (gcc_likely(++n_small < SHRINK_AFTER))
+			return buffer;
+
+		/* the capacity has been oversized for a while:
+		   give the large block back to the pool */
+		Clear();
+	} else {
+		n_small = 0;
+		return buffer;
+	}
+
+	capacity = pcm_buffer_pool_round(new_size);
+	buffer = pcm_buffer_pool_allocate(capacity);
+	return buffer;
 }
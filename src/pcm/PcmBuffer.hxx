@@ -20,24 +20,62 @@
 #ifndef PCM_BUFFER_HXX
 #define PCM_BUFFER_HXX
 
-#include "util/ReusableArray.hxx"
 #include "util/Compiler.h"
 
+#include <utility>
+
+#include <stddef.h>
 #include <stdint.h>
 
 /**
  * Manager for a temporary buffer which grows as needed.  We could
  * allocate a new buffer every time pcm_convert() is called, but that
  * would put too much stress on the allocator.
+ *
+ * The storage is borrowed from the per-thread pool (see
+ * BufferPool.hxx) and returned there by Clear().  If the requested
+ * sizes stay much smaller than the capacity for a while (e.g. after
+ * a sample rate change), the buffer is exchanged for a smaller one.
  */
 class PcmBuffer {
-	ReusableArray<uint8_t, 8192> buffer;
+	void *buffer = nullptr;
+	size_t capacity = 0;
+
+	/**
+	 * The number of consecutive Get() calls which needed less
+	 * than a quarter of the #capacity.
+	 */
+	unsigned n_small = 0;
 
 public:
-	void Clear() noexcept {
-		buffer.Clear();
+	PcmBuffer() = default;
+
+	PcmBuffer(PcmBuffer &&src) noexcept
+		:buffer(std::exchange(src.buffer, nullptr)),
+		 capacity(std::exchange(src.capacity, 0)),
+		 n_small(std::exchange(src.n_small, 0)) {}
+
+	PcmBuffer &operator=(PcmBuffer &&src) noexcept {
+		std::swap(buffer, src.buffer);
+		std::swap(capacity, src.capacity);
+		std::swap(n_small, src.n_small);
+		return *this;
 	}
 
+	~PcmBuffer() noexcept {
+		Clear();
+	}
+
+	size_t GetCapacity() const noexcept {
+		return capacity;
+	}
+
+	/**
+	 * Return the storage to the pool.  This invalidates the
+	 * buffer returned by Get().
+	 */
+	void Clear() noexcept;
+
 	/**
 	 * Get the buffer, and guarantee a minimum size.  This buffer becomes
 	 * invalid with the next Get() call.
@@ -18,139 +18,12 @@
  */
 
 #include "PcmChannels.hxx"
-#include "PcmBuffer.hxx"
-#include "Silence.hxx"
+#include "ChannelMatrix.hxx"
 #include "Traits.hxx"
-#include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
-#include "util/WritableBuffer.hxx"
-
-#include <array>
-#include <algorithm>
 
 #include <assert.h>
 
-template<typename D, typename S>
-static void
-MonoToStereo(D dest, S src, S end) noexcept
-{
-	while (src != end) {
-		const auto value = *src++;
-
-		*dest++ = value;
-		*dest++ = value;
-	}
-
-}
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::value_type
-StereoToMono(typename Traits::value_type _a,
-	     typename Traits::value_type _b) noexcept
-{
-	typename Traits::sum_type a(_a);
-	typename Traits::sum_type b(_b);
-
-	return typename Traits::value_type((a + b) / 2);
-}
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-StereoToMono(typename Traits::pointer_type dest,
-	     typename Traits::const_pointer_type src,
-	     typename Traits::const_pointer_type end) noexcept
-{
-	while (src != end) {
-		const auto a = *src++;
-		const auto b = *src++;
-
-		*dest++ = StereoToMono<F, Traits>(a, b);
-	}
-
-	return dest;
-}
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-NToStereo(typename Traits::pointer_type dest,
-	  unsigned src_channels,
-	  typename Traits::const_pointer_type src,
-	  typename Traits::const_pointer_type end) noexcept
-{
-	assert((end - src) % src_channels == 0);
-
-	while (src != end) {
-		typename Traits::sum_type sum = *src++;
-		for (unsigned c = 1; c < src_channels; ++c)
-			sum += *src++;
-
-		typename Traits::value_type value(sum / int(src_channels));
-
-		/* TODO: this is actually only mono ... */
-		*dest++ = value;
-		*dest++ = value;
-	}
-
-	return dest;
-}
-
-/**
- * Convert stereo to N channels (where N > 2).  Left and right map to
- * the first two channels (front left and front right), and the
- * remaining (surround) channels are filled with silence.
- */
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-StereoToN(typename Traits::pointer_type dest,
-	  unsigned dest_channels,
-	  typename Traits::const_pointer_type src,
-	  typename Traits::const_pointer_type end) noexcept
-{
-	assert(dest_channels > 2);
-	assert((end - src) % 2 == 0);
-
-	std::array<typename Traits::value_type, MAX_CHANNELS - 2> silence;
-	PcmSilence({&silence.front(), sizeof(silence)}, F);
-
-	while (src != end) {
-		/* copy left/right to front-left/front-right, which is
-		   the first two channels in all multi-channel
-		   configurations **/
-		*dest++ = *src++;
-		*dest++ = *src++;
-
-		/* all other channels are silent */
-		dest = std::copy_n(silence.begin(), dest_channels - 2, dest);
-	}
-
-	return dest;
-}
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-NToM(typename Traits::pointer_type dest,
-     unsigned dest_channels,
-     unsigned src_channels,
-     typename Traits::const_pointer_type src,
-     typename Traits::const_pointer_type end) noexcept
-{
-	assert((end - src) % src_channels == 0);
-
-	while (src != end) {
-		typename Traits::sum_type sum = *src++;
-		for (unsigned c = 1; c < src_channels; ++c)
-			sum += *src++;
-
-		typename Traits::value_type value(sum / int(src_channels));
-
-		/* TODO: this is actually only mono ... */
-		for (unsigned c = 0; c < dest_channels; ++c)
-			*dest++ = value;
-	}
-
-	return dest;
-}
-
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static ConstBuffer<typename Traits::value_type>
 ConvertChannels(PcmBuffer &buffer,
@@ -160,23 +33,13 @@ ConvertChannels(PcmBuffer &buffer,
 {
 	assert(src.size % src_channels == 0);
 
-	const size_t dest_size = src.size / src_channels * dest_channels;
-	auto dest = buffer.GetT<typename Traits::value_type>(dest_size);
-
-	if (src_channels == 1 && dest_channels == 2)
-		MonoToStereo(dest, src.begin(), src.end());
-	else if (src_channels == 2 && dest_channels == 1)
-		StereoToMono<F>(dest, src.begin(), src.end());
-	else if (dest_channels == 2)
-		NToStereo<F>(dest, src_channels, src.begin(), src.end());
-	else if (src_channels == 2 && dest_channels > 2)
-		StereoToN<F, Traits>(dest, dest_channels,
-				     src.begin(), src.end());
-	else
-		NToM<F>(dest, dest_channels,
-			src_channels, src.begin(), src.end());
+	/* these formats can always be mixed, so Open() doesn't
+	   throw */
+	PcmChannelMixer mixer;
+	mixer.Open(F, PcmChannelMatrix::Convert(src_channels, dest_channels));
 
-	return { dest, dest_size };
+	const auto dest = mixer.Apply(buffer, src.ToVoid());
+	return ConstBuffer<typename Traits::value_type>::FromVoid(dest);
 }
 
 ConstBuffer<int16_t>
@@ -19,14 +19,35 @@
 
 #include "PcmConvert.hxx"
 #include "ConfiguredResampler.hxx"
+#include "DitherType.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "config/Param.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
 
 #include <assert.h>
 
+static void
+pcm_dither_global_init(const ConfigData &config)
+{
+	const auto *param = config.GetParam(ConfigOption::DITHER);
+	if (param == nullptr)
+		return;
+
+	try {
+		pcm_dither_type = ParsePcmDitherType(param->value.c_str());
+	} catch (...) {
+		std::throw_with_nested(FormatRuntimeError("Failed to parse line %i",
+							  param->line));
+	}
+}
+
 void
 pcm_convert_global_init(const ConfigData &config)
 {
 	pcm_resampler_global_init(config);
+	pcm_dither_global_init(config);
 }
 
 PcmConvert::PcmConvert() noexcept
@@ -44,7 +65,8 @@ PcmConvert::~PcmConvert() noexcept
 }
 
 void
-PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format)
+PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format,
+		 const PcmResamplerProfile *resampler_profile)
 {
 	assert(!src_format.IsValid());
 	assert(!dest_format.IsValid());
@@ -52,12 +74,24 @@ PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format)
 	assert(_dest_format.IsValid());
 
 	AudioFormat format = _src_format;
-	if (format.format == SampleFormat::DSD)
+	if (format.format == SampleFormat::DSD) {
+#ifdef ENABLE_DSD
+		/* let the DSD filter do as much of the sample rate
+		   conversion as possible */
+		const unsigned factor =
+			PcmDsd::ChooseFactor(format.sample_rate,
+					     _dest_format.sample_rate);
+		dsd.SetFactor(factor);
+		format.sample_rate /= factor;
+#endif
+
 		format.format = SampleFormat::FLOAT;
+	}
 
 	enable_resampler = format.sample_rate != _dest_format.sample_rate;
 	if (enable_resampler) {
-		resampler.Open(format, _dest_format.sample_rate);
+		resampler.Open(format, _dest_format.sample_rate,
+			       resampler_profile);
 
 		format.format = resampler.GetOutputSampleFormat();
 		format.sample_rate = _dest_format.sample_rate;
@@ -132,11 +166,7 @@ PcmConvert::Convert(ConstBuffer<void> buffer)
 #ifdef ENABLE_DSD
 	if (src_format.format == SampleFormat::DSD) {
 		auto s = ConstBuffer<uint8_t>::FromVoid(buffer);
-		auto d = dsd.ToFloat(src_format.channels, s);
-		if (d.IsNull())
-			throw std::runtime_error("DSD to PCM conversion failed");
-
-		buffer = d.ToVoid();
+		buffer = dsd.ToFloat(src_format.channels, s).ToVoid();
 	}
 #endif
 
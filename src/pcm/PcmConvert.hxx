@@ -32,6 +32,7 @@
 
 template<typename T> struct ConstBuffer;
 struct ConfigData;
+struct PcmResamplerProfile;
 
 /**
  * This object is statically allocated (within another struct), and
@@ -59,8 +60,12 @@ public:
 	 * Prepare the object.  Call Close() when done.
 	 *
 	 * Throws std::runtime_error on error.
+	 *
+	 * @param resampler_profile the resampler profile (see
+	 * pcm_resampler_find()); nullptr selects the default profile
 	 */
-	void Open(AudioFormat _src_format, AudioFormat _dest_format);
+	void Open(AudioFormat _src_format, AudioFormat _dest_format,
+		  const PcmResamplerProfile *resampler_profile=nullptr);
 
 	/**
 	 * Close the object after it was prepared with Open().  After
@@ -28,18 +28,22 @@ PcmDither::Dither(T sample) noexcept
 	constexpr T round = 1 << (scale_bits - 1);
 	constexpr T mask = (1 << scale_bits) - 1;
 
-	sample += error[0] - error[1] + error[2];
+	if (type == PcmDitherType::SHAPED) {
+		sample += error[0] - error[1] + error[2];
 
-	error[2] = error[1];
-	error[1] = error[0] / 2;
+		error[2] = error[1];
+		error[1] = error[0] / 2;
+	}
 
 	/* round */
 	T output = sample + round;
 
-	const T rnd = pcm_prng(random);
-	output += (rnd & mask) - (random & mask);
+	if (type != PcmDitherType::NONE) {
+		const T rnd = pcm_prng(random);
+		output += (rnd & mask) - (random & mask);
 
-	random = rnd;
+		random = rnd;
+	}
 
 	/* clip */
 	if (output > MAX) {
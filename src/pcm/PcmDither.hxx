@@ -20,17 +20,74 @@
 #ifndef MPD_PCM_DITHER_HXX
 #define MPD_PCM_DITHER_HXX
 
+#include "DitherType.hxx"
+
 #include <stdint.h>
 
 enum class SampleFormat : uint8_t;
 
+/**
+ * Dithering state for the vectorized kernels (see Simd.hxx).  The
+ * scalar #PcmDither is one long dependency chain (noise shaping
+ * feeds the error of each sample into the next one), so each SIMD
+ * lane gets its own noise shaping filter and PRNG instead; the
+ * kernels process every lane exactly like
+ * PcmDither::DitherShift() does.
+ */
+struct PcmDitherLanes {
+	static constexpr unsigned MAX_LANES = 8;
+
+	int32_t error0[MAX_LANES], error1[MAX_LANES], error2[MAX_LANES];
+	int32_t random[MAX_LANES];
+
+	/**
+	 * The #PcmDitherType as bit masks which the kernels apply
+	 * (branch-free) to the error feedback and to the noise: all
+	 * bits set enables the stage, zero disables it.
+	 */
+	int32_t shape_mask = -1, noise_mask = -1;
+
+	/* each lane starts with a different PRNG state (the first
+	   outputs of pcm_prng()), or all of them would generate the
+	   same noise */
+	constexpr PcmDitherLanes() noexcept
+		:error0(), error1(), error2(),
+		 random{0x3c6ef35f, 0x47502932, int32_t(0xd1ccf6e9),
+			int32_t(0xaaf95334), 0x6252e503, int32_t(0x9f2ec686),
+			0x57fe6c2d, int32_t(0xa3d95fa8)} {}
+
+	void SetType(PcmDitherType type) noexcept {
+		shape_mask = type == PcmDitherType::SHAPED ? -1 : 0;
+		noise_mask = type != PcmDitherType::NONE ? -1 : 0;
+	}
+};
+
 class PcmDither {
 	int32_t error[3];
 	int32_t random;
 
+	PcmDitherType type;
+
+	PcmDitherLanes lanes;
+
 public:
-	constexpr PcmDither() noexcept
-		:error{0, 0, 0}, random(0) {}
+	explicit PcmDither(PcmDitherType _type=pcm_dither_type) noexcept
+		:error{0, 0, 0}, random(0) {
+		SetType(_type);
+	}
+
+	PcmDitherType GetType() const noexcept {
+		return type;
+	}
+
+	void SetType(PcmDitherType _type) noexcept {
+		type = _type;
+		lanes.SetType(_type);
+	}
+
+	PcmDitherLanes &GetLanes() noexcept {
+		return lanes;
+	}
 
 	/**
 	 * Shift the given sample by #SBITS-#DBITS to the right, and
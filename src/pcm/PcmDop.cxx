@@ -18,6 +18,7 @@
  */
 
 #include "PcmDop.hxx"
+#include "DsdPack.hxx"
 #include "PcmBuffer.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
@@ -40,7 +41,7 @@ pcm_two_dsd_to_dop_marker2(uint8_t a, uint8_t b) noexcept
 
 ConstBuffer<uint32_t>
 pcm_dsd_to_dop(PcmBuffer &buffer, unsigned channels,
-	       ConstBuffer<uint8_t> _src) noexcept
+	       ConstBuffer<uint8_t> _src, const PcmDsdPack *pack) noexcept
 {
 	assert(audio_valid_channel_count(channels));
 	assert(_src.size % channels == 0);
@@ -58,7 +59,15 @@ pcm_dsd_to_dop(PcmBuffer &buffer, unsigned channels,
 		*dest = dest0;
 
 	auto src = _src.data;
-	for (size_t i = num_dop_quads; i > 0; --i) {
+
+	size_t done = 0;
+	if (pack != nullptr) {
+		done = pack->Apply(dest, src, num_dop_quads);
+		src += done * 4 * channels;
+		dest += done * 2 * channels;
+	}
+
+	for (size_t i = num_dop_quads - done; i > 0; --i) {
 		for (unsigned c = channels; c > 0; --c) {
 			/* each 24 bit sample has 16 DSD sample bits
 			   plus the magic 0x05 marker */
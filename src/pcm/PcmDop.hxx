@@ -23,15 +23,20 @@
 #include <stdint.h>
 
 class PcmBuffer;
+class PcmDsdPack;
 template<typename T> struct ConstBuffer;
 
 /**
  * Pack DSD 1 bit samples into (padded) 24 bit PCM samples for
  * playback over USB, according to the DoP standard:
  * http://dsd-guide.com/dop-open-standard
+ *
+ * @param pack an optional vectorized conversion for this channel
+ * count
  */
 ConstBuffer<uint32_t>
 pcm_dsd_to_dop(PcmBuffer &buffer, unsigned channels,
-	       ConstBuffer<uint8_t> src) noexcept;
+	       ConstBuffer<uint8_t> src,
+	       const PcmDsdPack *pack=nullptr) noexcept;
 
 #endif
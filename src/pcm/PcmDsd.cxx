@@ -18,29 +18,72 @@
  */
 
 #include "PcmDsd.hxx"
-#include "dsd2pcm/dsd2pcm.h"
+#include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
-PcmDsd::PcmDsd() noexcept
+/**
+ * Decimating below this rate would require a steep filter with a
+ * long window; leave that to the resampler.
+ */
+static constexpr unsigned MIN_DIRECT_RATE = 88200;
+
+/**
+ * The initial filter state.  0x69 = 01101001; this pattern "on
+ * repeat" makes a low energy 352.8 kHz tone and a high energy 1.0584
+ * MHz tone (at DSD64) which is filtered out completely, i.e. silence.
+ */
+static constexpr uint8_t DSD_SILENCE_PATTERN = 0x69;
+
+unsigned
+PcmDsd::ChooseFactor(unsigned src_rate, unsigned dest_rate) noexcept
 {
-	dsd2pcm.fill(nullptr);
+	unsigned result = 1;
+
+	for (unsigned f = 2; f <= DsdFilter::MAX_FACTOR; ++f) {
+		if (src_rate % f != 0)
+			continue;
+
+		const unsigned rate = src_rate / f;
+		if (rate < dest_rate || rate < MIN_DIRECT_RATE)
+			break;
+
+		result = f;
+	}
+
+	return result;
 }
 
-PcmDsd::~PcmDsd() noexcept
+void
+PcmDsd::SetFactor(unsigned _factor) noexcept
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_destroy(i);
+	assert(_factor >= 1);
+	assert(_factor <= DsdFilter::MAX_FACTOR);
+
+	factor = _factor;
+	history_channels = 0;
 }
 
 void
 PcmDsd::Reset() noexcept
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_reset(i);
+	if (history_channels > 0)
+		Init(history_channels);
+}
+
+void
+PcmDsd::Init(unsigned channels) noexcept
+{
+	filter.Generate(factor);
+
+	history.GrowDiscard(channels * GetHistorySize());
+	std::fill_n(history.begin(), channels * GetHistorySize(),
+		    DSD_SILENCE_PATTERN);
+	history_channels = channels;
+	phase = factor;
 }
 
 ConstBuffer<float>
@@ -49,24 +92,50 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src) noexcept
 	assert(!src.IsNull());
 	assert(!src.empty());
 	assert(src.size % channels == 0);
-	assert(channels <= dsd2pcm.max_size());
+	assert(channels <= MAX_CHANNELS);
 
-	const unsigned num_samples = src.size;
-	const unsigned num_frames = src.size / channels;
+	if (channels != history_channels)
+		Init(channels);
 
-	float *dest = buffer.GetT<float>(num_samples);
+	const size_t num_frames = src.size / channels;
+	const size_t history_size = GetHistorySize();
+	const size_t planar_size = history_size + num_frames;
 
-	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
-		}
+	/* deinterleave, prepending the history of each channel */
+	uint8_t *planar = planar_buffer.GetT<uint8_t>(channels * planar_size);
+	for (unsigned c = 0; c < channels; ++c)
+		std::copy_n(history.begin() + c * history_size, history_size,
+			    planar + c * planar_size);
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
-	}
+	for (size_t i = 0; i < num_frames; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			planar[c * planar_size + history_size + i] =
+				*src.data++;
+
+	const size_t num_out = num_frames >= phase
+		? (num_frames - phase) / factor + 1
+		: 0;
+
+	float *dest = buffer.GetT<float>(num_out * channels);
+
+	if (num_out > 0) {
+		/* the window of the first output sample ends with
+		   input byte number "phase" */
+		for (unsigned c = 0; c < channels; ++c)
+			filter.Apply(dest + c, channels,
+				     planar + c * planar_size + phase - 1,
+				     num_out);
+
+		const size_t remaining =
+			num_frames - phase - (num_out - 1) * factor;
+		phase = factor - remaining;
+	} else
+		phase -= num_frames;
+
+	for (unsigned c = 0; c < channels; ++c)
+		std::copy_n(planar + (c + 1) * planar_size - history_size,
+			    history_size,
+			    history.begin() + c * history_size);
 
-	return { dest, num_samples };
+	return { dest, num_out * channels };
 }
@@ -21,30 +21,75 @@
 #define MPD_PCM_DSD_HXX
 
 #include "PcmBuffer.hxx"
-#include "AudioFormat.hxx"
-
-#include <array>
+#include "DsdFilter.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/Compiler.h"
 
 #include <stdint.h>
 
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD to floating point PCM with a #DsdFilter.  The input is
+ * deinterleaved once, and each output frame is computed over all
+ * channels before advancing to the next one.
  */
 class PcmDsd {
-	PcmBuffer buffer;
+	PcmBuffer buffer, planar_buffer;
+
+	DsdFilter filter;
+
+	/**
+	 * The last GetHistorySize() bytes of each channel, one after
+	 * another.
+	 */
+	AllocatedArray<uint8_t> history;
+
+	unsigned factor = 1;
 
-	std::array<struct dsd2pcm_ctx_s *, MAX_CHANNELS> dsd2pcm;
+	/**
+	 * The number of channels in #history; 0 if the filter state
+	 * has not been initialized yet.
+	 */
+	unsigned history_channels = 0;
+
+	/**
+	 * The number of bytes per channel which must be consumed
+	 * before the next output sample (1 to #factor).
+	 */
+	unsigned phase;
 
 public:
-	PcmDsd() noexcept;
-	~PcmDsd() noexcept;
+	/**
+	 * Choose a decimation factor for converting DSD at the given
+	 * rate (bytes per second and channel) to PCM at the given
+	 * rate.  The result is the largest factor which does not go
+	 * below the destination rate (or below 88.2 kHz, which would
+	 * require an impractically steep filter); if the destination
+	 * rate is not reached exactly, a resampler is still needed.
+	 */
+	gcc_const
+	static unsigned ChooseFactor(unsigned src_rate,
+				     unsigned dest_rate) noexcept;
+
+	/**
+	 * Set the number of input bytes per channel for each output
+	 * sample, i.e. the output sample rate is the DSD rate divided
+	 * by the factor.  The default is 1.  Resets the filter state.
+	 */
+	void SetFactor(unsigned _factor) noexcept;
 
 	void Reset() noexcept;
 
 	ConstBuffer<float> ToFloat(unsigned channels,
 				   ConstBuffer<uint8_t> src) noexcept;
+
+private:
+	unsigned GetHistorySize() const noexcept {
+		return filter.GetWindow() - 1;
+	}
+
+	void Init(unsigned channels) noexcept;
 };
 
 #endif
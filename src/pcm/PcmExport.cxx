@@ -21,7 +21,8 @@
 #include "AudioFormat.hxx"
 #include "Order.hxx"
 #include "PcmPack.hxx"
-#include "util/ByteReverse.hxx"
+#include "ReverseEndian.hxx"
+#include "FormatSimd.hxx"
 #include "util/ConstBuffer.hxx"
 
 #ifdef ENABLE_DSD
@@ -65,6 +66,15 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		/* after the conversion to DoP, the DSD
 		   samples are stuffed inside fake 24 bit samples */
 		sample_format = SampleFormat::S24_P32;
+
+	if (dsd_u16)
+		dsd_pack.Open(PcmDsdPack::Mode::U16, channels);
+	else if (dsd_u32)
+		dsd_pack.Open(PcmDsdPack::Mode::U32, channels);
+	else if (dop)
+		dsd_pack.Open(PcmDsdPack::Mode::DOP, channels);
+	else
+		dsd_pack.Close();
 #endif
 
 	shift8 = params.shift8 && sample_format == SampleFormat::S24_P32;
@@ -159,17 +169,20 @@ PcmExport::Export(ConstBuffer<void> data) noexcept
 #ifdef ENABLE_DSD
 	if (dsd_u16)
 		data = Dsd8To16(dop_buffer, channels,
-				ConstBuffer<uint8_t>::FromVoid(data))
+				ConstBuffer<uint8_t>::FromVoid(data),
+				GetDsdPack())
 			.ToVoid();
 
 	if (dsd_u32)
 		data = Dsd8To32(dop_buffer, channels,
-				ConstBuffer<uint8_t>::FromVoid(data))
+				ConstBuffer<uint8_t>::FromVoid(data),
+				GetDsdPack())
 			.ToVoid();
 
 	if (dop)
 		data = pcm_dsd_to_dop(dop_buffer, channels,
-				      ConstBuffer<uint8_t>::FromVoid(data))
+				      ConstBuffer<uint8_t>::FromVoid(data),
+				      GetDsdPack())
 			.ToVoid();
 #endif
 
@@ -187,11 +200,16 @@ PcmExport::Export(ConstBuffer<void> data) noexcept
 	} else if (shift8) {
 		const auto src = ConstBuffer<int32_t>::FromVoid(data);
 
-		uint32_t *dest = (uint32_t *)pack_buffer.Get(data.size);
+		int32_t *dest = (int32_t *)pack_buffer.Get(data.size);
 		data.data = dest;
 
-		for (auto i : src)
-			*dest++ = i << 8;
+		const auto kernel = GetPcmFormatKernels().convert_24_to_32;
+		const size_t done = kernel != nullptr
+			? kernel(dest, src.data, src.size)
+			: 0;
+
+		for (size_t i = done; i != src.size; ++i)
+			dest[i] = uint32_t(src[i]) << 8;
 	}
 
 	if (reverse_endian > 0) {
@@ -203,7 +221,7 @@ PcmExport::Export(ConstBuffer<void> data) noexcept
 		assert(dest != nullptr);
 		data.data = dest;
 
-		reverse_bytes(dest, src.begin(), src.end(), reverse_endian);
+		PcmReverseEndian(dest, src, reverse_endian);
 	}
 
 	return data;
@@ -24,6 +24,10 @@
 #include "PcmBuffer.hxx"
 #include "config.h"
 
+#ifdef ENABLE_DSD
+#include "DsdPack.hxx"
+#endif
+
 template<typename T> struct ConstBuffer;
 struct AudioFormat;
 
@@ -96,6 +100,12 @@ class PcmExport {
 	 * SampleFormat::S24_P32.
 	 */
 	bool dop;
+
+	/**
+	 * The vectorized DSD_U16/DSD_U32/DoP conversion for
+	 * #channels, compiled by Open().
+	 */
+	PcmDsdPack dsd_pack;
 #endif
 
 	/**
@@ -184,6 +194,13 @@ public:
 	 */
 	gcc_pure
 	size_t CalcSourceSize(size_t dest_size) const noexcept;
+
+private:
+#ifdef ENABLE_DSD
+	const PcmDsdPack *GetDsdPack() const noexcept {
+		return dsd_pack.IsDefined() ? &dsd_pack : nullptr;
+	}
+#endif
 };
 
 #endif
@@ -22,6 +22,7 @@
 #include "Clamp.hxx"
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
+#include "FormatSimd.hxx"
 #include "ShiftConvert.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -75,63 +76,30 @@ struct Convert32To16 {
 };
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
-struct PortableFloatToInteger
+struct FloatToInteger
 	: PerSampleConvert<FloatToIntegerSampleConvert<F, Traits>> {};
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-struct FloatToInteger : PortableFloatToInteger<F, Traits> {};
-
 /**
- * A template class that attempts to use the "optimized" algorithm for
- * large portions of the buffer, and calls the "portable" algorithm"
- * for the rest when the last block is not full.
+ * Convert a buffer with the given #PcmFormatKernels function (if
+ * available) and then the remaining samples with the portable
+ * implementation.
  */
-template<typename Optimized, typename Portable>
-class GlueOptimizedConvert : Optimized, Portable {
-public:
-	typedef typename Portable::SrcTraits SrcTraits;
-	typedef typename Portable::DstTraits DstTraits;
-
-	void Convert(typename DstTraits::pointer_type out,
-		     typename SrcTraits::const_pointer_type in,
-		     size_t n) const {
-		Optimized::Convert(out, in, n);
-
-		/* use the "portable" algorithm for the trailing
-		   samples */
-		size_t remaining = n % Optimized::BLOCK_SIZE;
-		size_t done = n - remaining;
-		Portable::Convert(out + done, in + done, remaining);
-	}
-};
-
-#ifdef __ARM_NEON__
-#include "Neon.hxx"
-
-template<>
-struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
-	: GlueOptimizedConvert<NeonFloatTo16,
-			       PortableFloatToInteger<SampleFormat::S16>> {};
-
-#endif
-
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
-		ConstBuffer<typename C::SrcTraits::value_type> src)
+		ConstBuffer<typename C::SrcTraits::value_type> src,
+		size_t (*kernel)(typename C::DstTraits::pointer_type dest,
+				 typename C::SrcTraits::const_pointer_type src,
+				 size_t n) noexcept=nullptr)
 {
 	auto dest = buffer.GetT<typename C::DstTraits::value_type>(src.size);
-	convert.Convert(dest, src.data, src.size);
+	const size_t done = kernel != nullptr
+		? kernel(dest, src.data, src.size)
+		: 0;
+	convert.Convert(dest + done, src.data + done, src.size - done);
 	return { dest, src.size };
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static ConstBuffer<typename Traits::value_type>
-AllocateFromFloat(PcmBuffer &buffer, ConstBuffer<float> src)
-{
-	return AllocateConvert(buffer, FloatToInteger<F, Traits>(), src);
-}
-
 static ConstBuffer<int16_t>
 pcm_allocate_8_to_16(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -155,7 +123,8 @@ pcm_allocate_32_to_16(PcmBuffer &buffer, PcmDither &dither,
 static ConstBuffer<int16_t>
 pcm_allocate_float_to_16(PcmBuffer &buffer, ConstBuffer<float> src)
 {
-	return AllocateFromFloat<SampleFormat::S16>(buffer, src);
+	return AllocateConvert(buffer, FloatToInteger<SampleFormat::S16>(), src,
+			       GetPcmFormatKernels().convert_float_to_16);
 }
 
 ConstBuffer<int16_t>
@@ -207,7 +176,8 @@ pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 static ConstBuffer<int32_t>
 pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 {
-	return AllocateConvert(buffer, Convert16To24(), src);
+	return AllocateConvert(buffer, Convert16To24(), src,
+			       GetPcmFormatKernels().convert_16_to_24);
 }
 
 struct Convert32To24
@@ -217,13 +187,15 @@ struct Convert32To24
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert32To24(), src);
+	return AllocateConvert(buffer, Convert32To24(), src,
+			       GetPcmFormatKernels().convert_32_to_24);
 }
 
 static ConstBuffer<int32_t>
 pcm_allocate_float_to_24(PcmBuffer &buffer, ConstBuffer<float> src)
 {
-	return AllocateFromFloat<SampleFormat::S24_P32>(buffer, src);
+	return AllocateConvert(buffer, FloatToInteger<SampleFormat::S24_P32>(),
+			       src, GetPcmFormatKernels().convert_float_to_24);
 }
 
 ConstBuffer<int32_t>
@@ -279,19 +251,22 @@ pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 static ConstBuffer<int32_t>
 pcm_allocate_16_to_32(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 {
-	return AllocateConvert(buffer, Convert16To32(), src);
+	return AllocateConvert(buffer, Convert16To32(), src,
+			       GetPcmFormatKernels().convert_16_to_32);
 }
 
 static ConstBuffer<int32_t>
 pcm_allocate_24p32_to_32(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert24To32(), src);
+	return AllocateConvert(buffer, Convert24To32(), src,
+			       GetPcmFormatKernels().convert_24_to_32);
 }
 
 static ConstBuffer<int32_t>
 pcm_allocate_float_to_32(PcmBuffer &buffer, ConstBuffer<float> src)
 {
-	return AllocateFromFloat<SampleFormat::S32>(buffer, src);
+	return AllocateConvert(buffer, FloatToInteger<SampleFormat::S32>(), src,
+			       GetPcmFormatKernels().convert_float_to_32);
 }
 
 ConstBuffer<int32_t>
@@ -347,19 +322,22 @@ pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 static ConstBuffer<float>
 pcm_allocate_16_to_float(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 {
-	return AllocateConvert(buffer, Convert16ToFloat(), src);
+	return AllocateConvert(buffer, Convert16ToFloat(), src,
+			       GetPcmFormatKernels().convert_16_to_float);
 }
 
 static ConstBuffer<float>
 pcm_allocate_24p32_to_float(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert24ToFloat(), src);
+	return AllocateConvert(buffer, Convert24ToFloat(), src,
+			       GetPcmFormatKernels().convert_24_to_float);
 }
 
 static ConstBuffer<float>
 pcm_allocate_32_to_float(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert32ToFloat(), src);
+	return AllocateConvert(buffer, Convert32ToFloat(), src,
+			       GetPcmFormatKernels().convert_32_to_float);
 }
 
 ConstBuffer<float>
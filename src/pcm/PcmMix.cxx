@@ -21,6 +21,7 @@
 #include "Volume.hxx"
 #include "Clamp.hxx"
 #include "Traits.hxx"
+#include "MixSimd.hxx"
 #include "util/Clamp.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
@@ -29,6 +30,60 @@
 
 #include <assert.h>
 
+namespace {
+
+/**
+ * The vectorized kernels for this CPU (see MixSimd.hxx).
+ */
+struct PcmMixKernels {
+	size_t (*add_vol_16)(PcmDitherLanes &lanes,
+			     int16_t *a, const int16_t *b, size_t n,
+			     int vol1, int vol2) noexcept;
+	size_t (*add_vol_float)(float *a, const float *b, size_t n,
+				float vol1, float vol2) noexcept;
+	size_t (*add_16)(int16_t *a, const int16_t *b, size_t n) noexcept;
+	size_t (*add_24)(int32_t *a, const int32_t *b, size_t n) noexcept;
+	size_t (*add_32)(int32_t *a, const int32_t *b, size_t n) noexcept;
+	size_t (*add_float)(float *a, const float *b, size_t n) noexcept;
+};
+
+} // namespace
+
+#define PCM_MIX_KERNELS(suffix) { \
+	pcm_add_vol_16_ ## suffix, \
+	pcm_add_vol_float_ ## suffix, \
+	pcm_add_16_ ## suffix, \
+	pcm_add_24_ ## suffix, \
+	pcm_add_32_ ## suffix, \
+	pcm_add_float_ ## suffix, \
+}
+
+/**
+ * @return the kernels for this CPU or nullptr if there are none
+ */
+gcc_pure
+static const PcmMixKernels *
+GetMixKernels() noexcept
+{
+#ifdef PCM_SIMD_AVX2
+	static constexpr PcmMixKernels avx2 = PCM_MIX_KERNELS(avx2);
+	if (PcmHaveAvx2())
+		return &avx2;
+#endif
+
+#ifdef PCM_SIMD_SSE2
+	static constexpr PcmMixKernels sse2 = PCM_MIX_KERNELS(sse2);
+	return &sse2;
+#elif defined(PCM_SIMD_NEON)
+	static constexpr PcmMixKernels neon = PCM_MIX_KERNELS(neon);
+	return &neon;
+#else
+	return nullptr;
+#endif
+}
+
+#undef PCM_MIX_KERNELS
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static typename Traits::value_type
 PcmAddVolume(PcmDither &dither,
@@ -72,9 +127,19 @@ PcmAddVolumeVoid(PcmDither &dither,
 }
 
 static void
-pcm_add_vol_float(float *buffer1, const float *buffer2,
+pcm_add_vol_float(const PcmMixKernels *kernels,
+		  float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2) noexcept
 {
+	if (kernels != nullptr) {
+		const size_t done = kernels->add_vol_float(buffer1, buffer2,
+							   num_samples,
+							   volume1, volume2);
+		buffer1 += done;
+		buffer2 += done;
+		num_samples -= done;
+	}
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -90,6 +155,8 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	    int vol1, int vol2,
 	    SampleFormat format) noexcept
 {
+	const PcmMixKernels *const kernels = GetMixKernels();
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
 	case SampleFormat::DSD:
@@ -103,6 +170,18 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
+		if (kernels != nullptr) {
+			const size_t done =
+				kernels->add_vol_16(dither.GetLanes(),
+						    (int16_t *)buffer1,
+						    (const int16_t *)buffer2,
+						    size / sizeof(int16_t),
+						    vol1, vol2);
+			buffer1 = (int16_t *)buffer1 + done;
+			buffer2 = (const int16_t *)buffer2 + done;
+			size -= done * sizeof(int16_t);
+		}
+
 		PcmAddVolumeVoid<SampleFormat::S16>(dither,
 						    buffer1, buffer2, size,
 						    vol1, vol2);
@@ -121,7 +200,8 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_vol_float((float *)buffer1, (const float *)buffer2,
+		pcm_add_vol_float(kernels,
+				  (float *)buffer1, (const float *)buffer2,
 				  size / 4,
 				  pcm_volume_to_float(vol1),
 				  pcm_volume_to_float(vol2));
@@ -153,20 +233,43 @@ PcmAdd(typename Traits::pointer_type a,
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
-PcmAddVoid(void *a, const void *b, size_t size) noexcept
+PcmAddVoid(void *a, const void *b, size_t size,
+	   size_t (*kernel)(typename Traits::pointer_type a,
+			    typename Traits::const_pointer_type b,
+			    size_t n) noexcept=nullptr) noexcept
 {
 	constexpr size_t sample_size = Traits::SAMPLE_SIZE;
 	assert(size % sample_size == 0);
 
-	PcmAdd<F, Traits>(typename Traits::pointer_type(a),
-			  typename Traits::const_pointer_type(b),
-			  size / sample_size);
+	auto a2 = typename Traits::pointer_type(a);
+	auto b2 = typename Traits::const_pointer_type(b);
+	size_t n = size / sample_size;
+
+	if (kernel != nullptr) {
+		/* vectorized loop, followed by the portable one for
+		   the trailing samples */
+		const size_t done = kernel(a2, b2, n);
+		a2 += done;
+		b2 += done;
+		n -= done;
+	}
+
+	PcmAdd<F, Traits>(a2, b2, n);
 }
 
 static void
-pcm_add_float(float *buffer1, const float *buffer2,
+pcm_add_float(const PcmMixKernels *kernels,
+	      float *buffer1, const float *buffer2,
 	      unsigned num_samples) noexcept
 {
+	if (kernels != nullptr) {
+		const size_t done = kernels->add_float(buffer1, buffer2,
+						       num_samples);
+		buffer1 += done;
+		buffer2 += done;
+		num_samples -= done;
+	}
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -179,6 +282,8 @@ static bool
 pcm_add(void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format) noexcept
 {
+	const PcmMixKernels *const kernels = GetMixKernels();
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
 	case SampleFormat::DSD:
@@ -190,19 +295,28 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size,
+					      kernels != nullptr
+					      ? kernels->add_16
+					      : nullptr);
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size,
+						  kernels != nullptr
+						  ? kernels->add_24
+						  : nullptr);
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
+		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size,
+					      kernels != nullptr
+					      ? kernels->add_32
+					      : nullptr);
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_float((float *)buffer1, (const float *)buffer2,
+		pcm_add_float(kernels, (float *)buffer1, (const float *)buffer2,
 			      size / 4);
 		return true;
 	}
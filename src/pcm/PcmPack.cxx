@@ -18,6 +18,7 @@
  */
 
 #include "PcmPack.hxx"
+#include "FormatSimd.hxx"
 #include "system/ByteOrder.hxx"
 
 static void
@@ -36,8 +37,12 @@ pack_sample(uint8_t *dest, const int32_t *src0) noexcept
 void
 pcm_pack_24(uint8_t *dest, const int32_t *src, const int32_t *src_end) noexcept
 {
-	/* duplicate loop to help the compiler's optimizer (constant
-	   parameter to the pack_sample() inline function) */
+	const auto kernel = GetPcmFormatKernels().pack_24;
+	if (kernel != nullptr) {
+		const size_t done = kernel(dest, src, src_end - src);
+		src += done;
+		dest += done * 3;
+	}
 
 	while (src < src_end) {
 		pack_sample(dest, src++);
@@ -90,6 +95,13 @@ void
 pcm_unpack_24(int32_t *dest,
 	      const uint8_t *src, const uint8_t *src_end) noexcept
 {
+	const auto kernel = GetPcmFormatKernels().unpack_24;
+	if (kernel != nullptr) {
+		const size_t done = kernel(dest, src, (src_end - src) / 3);
+		src += done * 3;
+		dest += done;
+	}
+
 	while (src < src_end) {
 		*dest++ = ReadS24(src);
 		src += 3;
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "ReverseEndian.hxx"
+#include "FormatSimd.hxx"
+#include "util/ByteReverse.hxx"
+
+#include <assert.h>
+
+void
+PcmReverseEndian(uint8_t *dest, ConstBuffer<uint8_t> src,
+		 size_t sample_size) noexcept
+{
+	assert(sample_size > 0);
+	assert(src.size % sample_size == 0);
+
+	const auto &kernels = GetPcmFormatKernels();
+	size_t done = 0;
+	if (sample_size == 2 && kernels.byteswap_16 != nullptr)
+		done = 2 * kernels.byteswap_16((uint16_t *)dest,
+					       (const uint16_t *)src.data,
+					       src.size / 2);
+	else if (sample_size == 4 && kernels.byteswap_32 != nullptr)
+		done = 4 * kernels.byteswap_32((uint32_t *)dest,
+					       (const uint32_t *)src.data,
+					       src.size / 4);
+
+	reverse_bytes(dest + done, src.begin() + done, src.end(),
+		      sample_size);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_REVERSE_ENDIAN_HXX
+#define MPD_PCM_REVERSE_ENDIAN_HXX
+
+#include "util/ConstBuffer.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Reverse the byte order of each sample, using the vectorized
+ * kernels where available.  This function can be used for in-place
+ * operation, except with 3 byte samples.
+ *
+ * @param dest the destination buffer, at least as large as #src
+ * @param src the source data; its size must be a multiple of
+ * #sample_size
+ * @param sample_size the size of each sample in bytes
+ */
+void
+PcmReverseEndian(uint8_t *dest, ConstBuffer<uint8_t> src,
+		 size_t sample_size) noexcept;
+
+#endif
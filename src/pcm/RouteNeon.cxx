@@ -0,0 +1,91 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Channel route kernels for ARM NEON (AArch64 only, because they
+ * need the TBL instruction with 128 bit tables).
+ */
+
+#include "RouteSimd.hxx"
+
+#ifdef PCM_SIMD_NEON_TBL
+
+#include <algorithm>
+
+#include <arm_neon.h>
+
+size_t
+pcm_route_shuffle_neon(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept
+{
+	constexpr size_t WIDTH = 16;
+
+	const size_t src_frame_size = shuffle.src_frame_size;
+	const size_t dest_frame_size = shuffle.dest_frame_size;
+	const size_t n = std::min(PcmRouteSafeFrames(n_frames, src_frame_size,
+						     WIDTH),
+				  PcmRouteSafeFrames(n_frames, dest_frame_size,
+						     WIDTH));
+
+	/* out-of-range indices (0x80) select zero */
+	const uint8x16_t control = vld1q_u8(shuffle.bytes);
+	const uint8x16_t silence = vld1q_u8(shuffle.silence);
+
+	for (size_t i = 0; i != n;
+	     ++i, src += src_frame_size, dest += dest_frame_size) {
+		/* the bytes beyond the end of this frame are
+		   overwritten by the next one */
+		const uint8x16_t x = vld1q_u8(src);
+		vst1q_u8(dest, vorrq_u8(vqtbl1q_u8(x, control), silence));
+	}
+
+	return n;
+}
+
+size_t
+pcm_route_permute_neon(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept
+{
+	constexpr size_t WIDTH = 32;
+
+	const size_t src_frame_size = shuffle.src_frame_size;
+	const size_t dest_frame_size = shuffle.dest_frame_size;
+	const size_t n = std::min(PcmRouteSafeFrames(n_frames, src_frame_size,
+						     WIDTH),
+				  PcmRouteSafeFrames(n_frames, dest_frame_size,
+						     WIDTH));
+
+	const uint8x16_t control0 = vld1q_u8(shuffle.bytes);
+	const uint8x16_t control1 = vld1q_u8(shuffle.bytes + 16);
+	const uint8x16_t silence0 = vld1q_u8(shuffle.silence);
+	const uint8x16_t silence1 = vld1q_u8(shuffle.silence + 16);
+
+	for (size_t i = 0; i != n;
+	     ++i, src += src_frame_size, dest += dest_frame_size) {
+		const uint8x16x2_t x = {{ vld1q_u8(src), vld1q_u8(src + 16) }};
+		vst1q_u8(dest, vorrq_u8(vqtbl2q_u8(x, control0), silence0));
+		vst1q_u8(dest + 16,
+			 vorrq_u8(vqtbl2q_u8(x, control1), silence1));
+	}
+
+	return n;
+}
+
+#endif
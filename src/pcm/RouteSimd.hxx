@@ -0,0 +1,110 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_ROUTE_SIMD_HXX
+#define MPD_PCM_ROUTE_SIMD_HXX
+
+#include "Simd.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A channel route (see #PcmChannelMixer) as a byte shuffle on one
+ * frame of up to 32 bytes.
+ */
+struct PcmRouteShuffle {
+	size_t src_frame_size, dest_frame_size;
+
+	/**
+	 * For each destination byte: the source byte within the
+	 * frame, or 0x80 for silence.
+	 */
+	uint8_t bytes[32];
+
+	/**
+	 * The silence pattern for silent destination bytes, zero
+	 * elsewhere.
+	 */
+	uint8_t silence[32];
+
+	/**
+	 * #bytes as 32 bit lanes (the source sample index), for
+	 * formats with 4 byte samples.
+	 */
+	uint32_t lanes[8];
+
+	/**
+	 * All bits set for each lane which is not silent.
+	 */
+	uint32_t lane_mask[8];
+};
+
+/*
+ * Vectorized route kernels.  Each one converts as many frames as it
+ * can without reading or writing beyond the end of the buffers and
+ * returns the number of frames it has written; the caller is
+ * responsible for the remaining frames.
+ *
+ * The "shuffle" kernels work with frames of up to 16 bytes, and the
+ * "permute" kernels with frames of up to 32 bytes (on x86, only with
+ * 4 byte samples).
+ */
+
+/**
+ * How many of the given frames can be accessed with loads and stores
+ * of the given width (in bytes) at the start of each frame, without
+ * going beyond the end of the buffer?
+ */
+static constexpr size_t
+PcmRouteSafeFrames(size_t n_frames, size_t frame_size,
+		   size_t width) noexcept
+{
+	return n_frames * frame_size >= width
+		? (n_frames * frame_size - width) / frame_size + 1
+		: 0;
+}
+
+#ifdef PCM_SIMD_AVX2
+
+size_t
+pcm_route_shuffle_avx2(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept;
+
+size_t
+pcm_route_permute_avx2(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept;
+
+#endif
+
+#if defined(PCM_SIMD_NEON) && defined(__aarch64__)
+#define PCM_SIMD_NEON_TBL
+
+size_t
+pcm_route_shuffle_neon(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept;
+
+size_t
+pcm_route_permute_neon(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept;
+
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Channel route kernels for x86 (AVX2).
+ */
+
+#include "RouteSimd.hxx"
+
+#ifdef PCM_SIMD_AVX2
+
+#include <algorithm>
+
+#include <immintrin.h>
+
+#ifndef AVX2_TARGET
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+AVX2_TARGET
+size_t
+pcm_route_shuffle_avx2(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept
+{
+	constexpr size_t WIDTH = 16;
+
+	const size_t src_frame_size = shuffle.src_frame_size;
+	const size_t dest_frame_size = shuffle.dest_frame_size;
+	const size_t n = std::min(PcmRouteSafeFrames(n_frames, src_frame_size,
+						     WIDTH),
+				  PcmRouteSafeFrames(n_frames, dest_frame_size,
+						     WIDTH));
+
+	const __m128i control = _mm_loadu_si128((const __m128i *)shuffle.bytes);
+	const __m128i silence = _mm_loadu_si128((const __m128i *)shuffle.silence);
+
+	for (size_t i = 0; i != n;
+	     ++i, src += src_frame_size, dest += dest_frame_size) {
+		/* the bytes beyond the end of this frame are
+		   overwritten by the next one */
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_or_si128(_mm_shuffle_epi8(x, control),
+					      silence));
+	}
+
+	return n;
+}
+
+AVX2_TARGET
+size_t
+pcm_route_permute_avx2(uint8_t *dest, const uint8_t *src, size_t n_frames,
+		       const PcmRouteShuffle &shuffle) noexcept
+{
+	constexpr size_t WIDTH = 32;
+
+	const size_t src_frame_size = shuffle.src_frame_size;
+	const size_t dest_frame_size = shuffle.dest_frame_size;
+	const size_t n = std::min(PcmRouteSafeFrames(n_frames, src_frame_size,
+						     WIDTH),
+				  PcmRouteSafeFrames(n_frames, dest_frame_size,
+						     WIDTH));
+
+	const __m256i lanes = _mm256_loadu_si256((const __m256i *)shuffle.lanes);
+	const __m256i mask = _mm256_loadu_si256((const __m256i *)shuffle.lane_mask);
+	const __m256i silence = _mm256_loadu_si256((const __m256i *)shuffle.silence);
+
+	for (size_t i = 0; i != n;
+	     ++i, src += src_frame_size, dest += dest_frame_size) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i y = _mm256_permutevar8x32_epi32(x, lanes);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_or_si256(_mm256_and_si256(y, mask),
+						    silence));
+	}
+
+	return n;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SIMD_HXX
+#define MPD_PCM_SIMD_HXX
+
+/*
+ * Which vectorized PCM kernels are available in this build.  SSE2
+ * and NEON are selected at compile time (they are part of the
+ * x86-64 and AArch64 base instruction sets); AVX2 kernels are
+ * compiled with a "target" attribute and must only be called after
+ * PcmHaveAvx2() has returned true.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PCM_SIMD_AVX2
+#endif
+
+#ifdef __SSE2__
+#define PCM_SIMD_SSE2
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PCM_SIMD_NEON
+#endif
+
+#ifdef PCM_SIMD_AVX2
+
+/**
+ * Does this CPU support AVX2?  The result is determined only once.
+ */
+static inline bool
+PcmHaveAvx2() noexcept
+{
+	static const bool value = [](){
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	}();
+	return value;
+}
+
+#endif
+
+#endif
@@ -24,23 +24,19 @@
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
-#include <soxr.h>
-
 #include <assert.h>
 #include <string.h>
 
 static constexpr Domain soxr_domain("soxr");
 
-static constexpr unsigned long SOXR_DEFAULT_RECIPE = SOXR_HQ;
+static constexpr unsigned long SOXR_DEFAULT_RECIPE =
+	SoxrResamplerSettings().recipe;
 
 /**
  * Special value for "invalid argument".
  */
 static constexpr unsigned long SOXR_INVALID_RECIPE = -1;
 
-static soxr_quality_spec_t soxr_quality;
-static soxr_runtime_spec_t soxr_runtime;
-
 static constexpr struct {
 	unsigned long recipe;
 	const char *name;
@@ -79,8 +75,8 @@ soxr_parse_quality(const char *quality) noexcept
 	return SOXR_INVALID_RECIPE;
 }
 
-void
-pcm_resample_soxr_global_init(const ConfigBlock &block)
+SoxrResamplerSettings
+pcm_resample_soxr_parse(const ConfigBlock &block)
 {
 	const char *quality_string = block.GetBlockValue("quality");
 	unsigned long recipe = soxr_parse_quality(quality_string);
@@ -91,14 +87,14 @@ pcm_resample_soxr_global_init(const ConfigBlock &block)
 					 quality_string, block.line);
 	}
 
-	soxr_quality = soxr_quality_spec(recipe, 0);
-
 	FormatDebug(soxr_domain,
 		    "soxr converter '%s'",
 		    soxr_quality_name(recipe));
 
-	const unsigned n_threads = block.GetBlockValue("threads", 1);
-	soxr_runtime = soxr_runtime_spec(n_threads);
+	SoxrResamplerSettings settings;
+	settings.recipe = recipe;
+	settings.n_threads = block.GetBlockValue("threads", 1u);
+	return settings;
 }
 
 AudioFormat
@@ -110,7 +106,7 @@ SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
 	soxr_error_t e;
 	soxr = soxr_create(af.sample_rate, new_sample_rate,
 			   af.channels, &e,
-			   nullptr, &soxr_quality, &soxr_runtime);
+			   nullptr, &quality, &runtime);
 	if (soxr == nullptr)
 		throw FormatRuntimeError("soxr initialization has failed: %s",
 					 e);
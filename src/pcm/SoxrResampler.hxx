@@ -24,13 +24,30 @@
 #include "PcmBuffer.hxx"
 #include "util/Compiler.h"
 
+#include <soxr.h>
+
 struct AudioFormat;
 struct ConfigBlock;
 
+/**
+ * The soxr settings of a "resampler" block.
+ */
+struct SoxrResamplerSettings {
+	unsigned long recipe = SOXR_HQ;
+
+	/**
+	 * The number of libsoxr threads; 0 means "automatic".
+	 */
+	unsigned n_threads = 1;
+};
+
 /**
  * A resampler using soxr.
  */
 class SoxrPcmResampler final : public PcmResampler {
+	const soxr_quality_spec_t quality;
+	const soxr_runtime_spec_t runtime;
+
 	struct soxr *soxr;
 
 	unsigned channels;
@@ -39,6 +56,10 @@ class SoxrPcmResampler final : public PcmResampler {
 	PcmBuffer buffer;
 
 public:
+	explicit SoxrPcmResampler(const SoxrResamplerSettings &settings={}) noexcept
+		:quality(soxr_quality_spec(settings.recipe, 0)),
+		 runtime(soxr_runtime_spec(settings.n_threads)) {}
+
 	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
 	void Close() noexcept override;
 	void Reset() noexcept override;
@@ -46,7 +67,12 @@ public:
 	ConstBuffer<void> Flush() override;
 };
 
-void
-pcm_resample_soxr_global_init(const ConfigBlock &block);
+/**
+ * Parse the soxr settings of a "resampler" block.
+ *
+ * Throws std::runtime_error on error.
+ */
+SoxrResamplerSettings
+pcm_resample_soxr_parse(const ConfigBlock &block);
 
 #endif
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SSE_DITHER_HXX
+#define MPD_PCM_SSE_DITHER_HXX
+
+#include "Simd.hxx"
+#include "PcmDither.hxx"
+#include "Volume.hxx"
+
+#ifdef PCM_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(PCM_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+/* the constants of PcmDither::DitherShift<int32_t, 26, 16>(),
+   i.e. 16 bit samples multiplied with a #PCM_VOLUME_BITS fixed-point
+   volume, and of pcm_prng() */
+static constexpr unsigned SIMD_DITHER_SCALE_BITS = PCM_VOLUME_BITS;
+static constexpr int32_t SIMD_DITHER_ROUND = 1 << (SIMD_DITHER_SCALE_BITS - 1);
+static constexpr int32_t SIMD_DITHER_MASK = (1 << SIMD_DITHER_SCALE_BITS) - 1;
+static constexpr int32_t SIMD_DITHER_MAX = (1 << (16 + PCM_VOLUME_BITS - 1)) - 1;
+static constexpr int32_t SIMD_DITHER_MIN = -SIMD_DITHER_MAX - 1;
+static constexpr int32_t SIMD_PRNG_MUL = 0x0019660d;
+static constexpr int32_t SIMD_PRNG_ADD = 0x3c6ef35f;
+
+#ifdef PCM_SIMD_SSE2
+
+/**
+ * The state of four dither lanes in SSE2 registers.
+ */
+struct SseDither {
+	__m128i e0, e1, e2, random;
+
+	/* see PcmDitherLanes::shape_mask */
+	const __m128i shape_mask, noise_mask;
+
+	explicit SseDither(const PcmDitherLanes &lanes) noexcept
+		:e0(_mm_loadu_si128((const __m128i *)lanes.error0)),
+		 e1(_mm_loadu_si128((const __m128i *)lanes.error1)),
+		 e2(_mm_loadu_si128((const __m128i *)lanes.error2)),
+		 random(_mm_loadu_si128((const __m128i *)lanes.random)),
+		 shape_mask(_mm_set1_epi32(lanes.shape_mask)),
+		 noise_mask(_mm_set1_epi32(lanes.noise_mask)) {}
+
+	void Store(PcmDitherLanes &lanes) const noexcept {
+		_mm_storeu_si128((__m128i *)lanes.error0, e0);
+		_mm_storeu_si128((__m128i *)lanes.error1, e1);
+		_mm_storeu_si128((__m128i *)lanes.error2, e2);
+		_mm_storeu_si128((__m128i *)lanes.random, random);
+	}
+
+	/**
+	 * 32 bit multiplication (SSE2 has only _mm_mul_epu32(),
+	 * which multiplies the even elements).
+	 */
+	static __m128i MulLo32(__m128i a, __m128i b) noexcept {
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+					    _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+					  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	static __m128i Select(__m128i mask, __m128i a, __m128i b) noexcept {
+		return _mm_or_si128(_mm_and_si128(mask, a),
+				    _mm_andnot_si128(mask, b));
+	}
+
+	/**
+	 * The vectorized equivalent of PcmDither::Dither().
+	 */
+	__m128i Dither(__m128i sample) noexcept {
+		const __m128i mask = _mm_set1_epi32(SIMD_DITHER_MASK);
+		const __m128i max = _mm_set1_epi32(SIMD_DITHER_MAX);
+		const __m128i min = _mm_set1_epi32(SIMD_DITHER_MIN);
+
+		sample = _mm_add_epi32(sample,
+				       _mm_and_si128(_mm_add_epi32(_mm_sub_epi32(e0, e1),
+								   e2),
+						     shape_mask));
+
+		e2 = e1;
+		/* signed division by 2, rounding towards zero */
+		e1 = _mm_srai_epi32(_mm_add_epi32(e0,
+						  _mm_srli_epi32(e0, 31)),
+				    1);
+
+		__m128i output = _mm_add_epi32(sample,
+					       _mm_set1_epi32(SIMD_DITHER_ROUND));
+
+		const __m128i rnd = _mm_add_epi32(MulLo32(random,
+							  _mm_set1_epi32(SIMD_PRNG_MUL)),
+						  _mm_set1_epi32(SIMD_PRNG_ADD));
+		output = _mm_add_epi32(output,
+				       _mm_and_si128(_mm_sub_epi32(_mm_and_si128(rnd, mask),
+								   _mm_and_si128(random, mask)),
+						     noise_mask));
+		random = rnd;
+
+		/* clip */
+		const __m128i over = _mm_cmpgt_epi32(output, max);
+		output = Select(over, max, output);
+		sample = Select(_mm_and_si128(over,
+					      _mm_cmpgt_epi32(sample, max)),
+				max, sample);
+
+		const __m128i under = _mm_cmplt_epi32(output, min);
+		output = Select(under, min, output);
+		sample = Select(_mm_and_si128(under,
+					      _mm_cmplt_epi32(sample, min)),
+				min, sample);
+
+		output = _mm_andnot_si128(mask, output);
+		e0 = _mm_sub_epi32(sample, output);
+
+		return _mm_srai_epi32(output, SIMD_DITHER_SCALE_BITS);
+	}
+};
+
+#endif
+
+#ifdef PCM_SIMD_AVX2
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/**
+ * The state of eight dither lanes in AVX2 registers.  See
+ * #SseDither for documentation.
+ */
+struct Avx2Dither {
+	__m256i e0, e1, e2, random;
+
+	const __m256i shape_mask, noise_mask;
+
+	AVX2_TARGET
+	explicit Avx2Dither(const PcmDitherLanes &lanes) noexcept
+		:e0(_mm256_loadu_si256((const __m256i *)lanes.error0)),
+		 e1(_mm256_loadu_si256((const __m256i *)lanes.error1)),
+		 e2(_mm256_loadu_si256((const __m256i *)lanes.error2)),
+		 random(_mm256_loadu_si256((const __m256i *)lanes.random)),
+		 shape_mask(_mm256_set1_epi32(lanes.shape_mask)),
+		 noise_mask(_mm256_set1_epi32(lanes.noise_mask)) {}
+
+	AVX2_TARGET
+	void Store(PcmDitherLanes &lanes) const noexcept {
+		_mm256_storeu_si256((__m256i *)lanes.error0, e0);
+		_mm256_storeu_si256((__m256i *)lanes.error1, e1);
+		_mm256_storeu_si256((__m256i *)lanes.error2, e2);
+		_mm256_storeu_si256((__m256i *)lanes.random, random);
+	}
+
+	AVX2_TARGET
+	__m256i Dither(__m256i sample) noexcept {
+		const __m256i mask = _mm256_set1_epi32(SIMD_DITHER_MASK);
+		const __m256i max = _mm256_set1_epi32(SIMD_DITHER_MAX);
+		const __m256i min = _mm256_set1_epi32(SIMD_DITHER_MIN);
+
+		sample = _mm256_add_epi32(sample,
+					  _mm256_and_si256(_mm256_add_epi32(_mm256_sub_epi32(e0, e1),
+									    e2),
+							   shape_mask));
+
+		e2 = e1;
+		e1 = _mm256_srai_epi32(_mm256_add_epi32(e0,
+							_mm256_srli_epi32(e0, 31)),
+				       1);
+
+		__m256i output = _mm256_add_epi32(sample,
+						  _mm256_set1_epi32(SIMD_DITHER_ROUND));
+
+		const __m256i rnd =
+			_mm256_add_epi32(_mm256_mullo_epi32(random,
+							    _mm256_set1_epi32(SIMD_PRNG_MUL)),
+					 _mm256_set1_epi32(SIMD_PRNG_ADD));
+		output = _mm256_add_epi32(output,
+					  _mm256_and_si256(_mm256_sub_epi32(_mm256_and_si256(rnd, mask),
+									    _mm256_and_si256(random, mask)),
+							   noise_mask));
+		random = rnd;
+
+		/* clip */
+		const __m256i over = _mm256_cmpgt_epi32(output, max);
+		output = _mm256_min_epi32(output, max);
+		sample = _mm256_blendv_epi8(sample,
+					    _mm256_min_epi32(sample, max),
+					    over);
+
+		const __m256i under = _mm256_cmpgt_epi32(min, output);
+		output = _mm256_max_epi32(output, min);
+		sample = _mm256_blendv_epi8(sample,
+					    _mm256_max_epi32(sample, min),
+					    under);
+
+		output = _mm256_andnot_si256(mask, output);
+		e0 = _mm256_sub_epi32(sample, output);
+
+		return _mm256_srai_epi32(output, SIMD_DITHER_SCALE_BITS);
+	}
+};
+
+#endif
+
+#endif
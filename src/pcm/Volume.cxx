@@ -20,6 +20,10 @@
 #include "Volume.hxx"
 #include "Silence.hxx"
 #include "Traits.hxx"
+#include "VolumeSimd.hxx"
+#include "Simd.hxx"
+#include "Clamp.hxx"
+#include "FloatConvert.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/WritableBuffer.hxx"
 #include "util/RuntimeError.hxx"
@@ -30,6 +34,57 @@
 #include <stdint.h>
 #include <string.h>
 
+/**
+ * Run the best vectorized kernel available on this CPU.
+ *
+ * @return the number of samples which were processed
+ */
+static size_t
+pcm_volume_change_16_simd(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept
+{
+#ifdef PCM_SIMD_AVX2
+	if (PcmHaveAvx2())
+		return pcm_volume_change_16_avx2(lanes, dest, src, n, volume);
+#endif
+
+#ifdef PCM_SIMD_SSE2
+	return pcm_volume_change_16_sse2(lanes, dest, src, n, volume);
+#elif defined(PCM_SIMD_NEON)
+	return pcm_volume_change_16_neon(lanes, dest, src, n, volume);
+#else
+	(void)lanes;
+	(void)dest;
+	(void)src;
+	(void)n;
+	(void)volume;
+	return 0;
+#endif
+}
+
+static size_t
+pcm_volume_change_float_simd(float *dest, const float *src, size_t n,
+			     float volume) noexcept
+{
+#ifdef PCM_SIMD_AVX2
+	if (PcmHaveAvx2())
+		return pcm_volume_change_float_avx2(dest, src, n, volume);
+#endif
+
+#ifdef PCM_SIMD_SSE2
+	return pcm_volume_change_float_sse(dest, src, n, volume);
+#elif defined(PCM_SIMD_NEON)
+	return pcm_volume_change_float_neon(dest, src, n, volume);
+#else
+	(void)dest;
+	(void)src;
+	(void)n;
+	(void)volume;
+	return 0;
+#endif
+}
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static inline typename Traits::value_type
 pcm_volume_sample(PcmDither &dither,
@@ -55,6 +110,54 @@ pcm_volume_change(PcmDither &dither,
 		dest[i] = pcm_volume_sample<F, Traits>(dither, src[i], volume);
 }
 
+/**
+ * Fade linearly from one volume level to another over the given
+ * number of frames.  The level is calculated in 16.16 fixed point,
+ * which avoids a division per frame.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_volume_ramp(PcmDither &dither,
+		typename Traits::pointer_type dest,
+		typename Traits::const_pointer_type src,
+		size_t n_frames, unsigned channels,
+		int from, int to) noexcept
+{
+	const int64_t step = n_frames > 0
+		? (int64_t(to - from) << 16) / int64_t(n_frames)
+		: 0;
+	int64_t level = int64_t(from) << 16;
+
+	for (size_t i = 0; i != n_frames; ++i) {
+		level += step;
+		const int volume = i + 1 == n_frames
+			? to
+			: int(level >> 16);
+
+		for (unsigned c = 0; c != channels; ++c)
+			*dest++ = pcm_volume_sample<F, Traits>(dither, *src++,
+							       volume);
+	}
+}
+
+static void
+pcm_volume_ramp_float(float *dest, const float *src,
+		      size_t n_frames, unsigned channels,
+		      float from, float to) noexcept
+{
+	const float step = n_frames > 0
+		? (to - from) / n_frames
+		: 0;
+	float volume = from;
+
+	for (size_t i = 0; i != n_frames; ++i) {
+		volume += step;
+
+		for (unsigned c = 0; c != channels; ++c)
+			*dest++ = *src++ * volume;
+	}
+}
+
 static void
 pcm_volume_change_8(PcmDither &dither,
 		    int8_t *dest, const int8_t *src, size_t n,
@@ -68,7 +171,15 @@ pcm_volume_change_16(PcmDither &dither,
 		     int16_t *dest, const int16_t *src, size_t n,
 		     int volume) noexcept
 {
-	pcm_volume_change<SampleFormat::S16>(dither, dest, src, n, volume);
+	/* the vectorized kernels multiply with a 16 bit volume */
+	const size_t done = volume <= INT16_MAX
+		? pcm_volume_change_16_simd(dither.GetLanes(),
+					    dest, src, n, volume)
+		: 0;
+
+	/* use the portable algorithm for the trailing samples */
+	pcm_volume_change<SampleFormat::S16>(dither, dest + done, src + done,
+					     n - done, volume);
 }
 
 static void
@@ -92,13 +203,17 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume) noexcept
 {
-	for (size_t i = 0; i != n; ++i)
+	const size_t done = pcm_volume_change_float_simd(dest, src, n, volume);
+
+	for (size_t i = done; i != n; ++i)
 		dest[i] = src[i] * volume;
 }
 
 void
-PcmVolume::Open(SampleFormat _format)
+PcmVolume::Open(SampleFormat _format, unsigned _channels)
 {
+	assert(_channels > 0);
+
 	assert(format == SampleFormat::UNDEFINED);
 
 	switch (_format) {
@@ -119,20 +234,77 @@ PcmVolume::Open(SampleFormat _format)
 	}
 
 	format = _format;
+	channels = _channels;
+	ramp_from = volume;
 }
 
-ConstBuffer<void>
-PcmVolume::Apply(ConstBuffer<void> src) noexcept
+inline bool
+PcmVolume::ApplyRamp(void *data, ConstBuffer<void> src) noexcept
 {
-	if (volume == PCM_VOLUME_1)
-		return src;
+	const int from = ramp_from, to = volume;
+	ramp_from = to;
 
-	void *data = buffer.Get(src.size);
+	const size_t n_frames = src.size / sample_format_size(format)
+		/ channels;
+
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+		assert(false);
+		gcc_unreachable();
+
+	case SampleFormat::S8:
+		pcm_volume_ramp<SampleFormat::S8>(dither, (int8_t *)data,
+						  (const int8_t *)src.data,
+						  n_frames, channels,
+						  from, to);
+		break;
+
+	case SampleFormat::S16:
+		pcm_volume_ramp<SampleFormat::S16>(dither, (int16_t *)data,
+						   (const int16_t *)src.data,
+						   n_frames, channels,
+						   from, to);
+		break;
+
+	case SampleFormat::S24_P32:
+		pcm_volume_ramp<SampleFormat::S24_P32>(dither, (int32_t *)data,
+						       (const int32_t *)src.data,
+						       n_frames, channels,
+						       from, to);
+		break;
+
+	case SampleFormat::S32:
+		pcm_volume_ramp<SampleFormat::S32>(dither, (int32_t *)data,
+						   (const int32_t *)src.data,
+						   n_frames, channels,
+						   from, to);
+		break;
+
+	case SampleFormat::FLOAT:
+		pcm_volume_ramp_float((float *)data, (const float *)src.data,
+				      n_frames, channels,
+				      pcm_volume_to_float(from),
+				      pcm_volume_to_float(to));
+		break;
+
+	case SampleFormat::DSD:
+		// TODO: implement this; currently, it's a no-op
+		return false;
+	}
+
+	return true;
+}
+
+bool
+PcmVolume::ApplyTo(void *data, ConstBuffer<void> src) noexcept
+{
+	if (IsRamping())
+		return ApplyRamp(data, src);
 
 	if (volume == 0) {
 		/* optimized special case: 0% volume = memset(0) */
 		PcmSilence({data, src.size}, format);
-		return { data, src.size };
+		return true;
 	}
 
 	switch (format) {
@@ -177,8 +349,150 @@ PcmVolume::Apply(ConstBuffer<void> src) noexcept
 
 	case SampleFormat::DSD:
 		// TODO: implement this; currently, it's a no-op
-		return src;
+		return false;
 	}
 
+	return true;
+}
+
+ConstBuffer<void>
+PcmVolume::Apply(ConstBuffer<void> src) noexcept
+{
+	if (IsNoOp())
+		/* the common case costs nothing */
+		return src;
+
+	void *data = buffer.Get(src.size);
+	if (!ApplyTo(data, src))
+		return src;
+
 	return { data, src.size };
 }
+
+void
+PcmVolume::ApplyInPlace(WritableBuffer<void> data) noexcept
+{
+	if (IsNoOp())
+		return;
+
+	/* all kernels process the samples in order, reading each one
+	   before writing it, so the source may be the destination */
+	ApplyTo(data.data, {data.data, data.size});
+}
+
+template<int K, bool L=(K >= 0)>
+struct ShiftBits {
+	static constexpr int64_t Apply(int64_t x) noexcept {
+		return x << K;
+	}
+};
+
+template<int K>
+struct ShiftBits<K, false> {
+	static constexpr int64_t Apply(int64_t x) noexcept {
+		return x >> -K;
+	}
+};
+
+/**
+ * Multiply with the volume and widen to the destination format at
+ * the same time.  The destination has enough bits that no dithering
+ * is necessary.
+ */
+template<SampleFormat SF, SampleFormat DF,
+	 class ST=SampleTraits<SF>, class DT=SampleTraits<DF>>
+static ConstBuffer<void>
+pcm_volume_widen(PcmBuffer &buffer, ConstBuffer<void> _src,
+		 int volume) noexcept
+{
+	static_assert(DT::BITS > ST::BITS, "Not a widening conversion");
+	typedef ShiftBits<int(DT::BITS) - int(ST::BITS) - int(PCM_VOLUME_BITS)> Shift;
+
+	const auto src = ConstBuffer<typename ST::value_type>::FromVoid(_src);
+	auto *dest = buffer.GetT<typename DT::value_type>(src.size);
+
+	for (size_t i = 0; i != src.size; ++i) {
+		int64_t sample = Shift::Apply(int64_t(src[i]) * volume);
+		if (sample > DT::MAX)
+			sample = DT::MAX;
+		else if (sample < DT::MIN)
+			sample = DT::MIN;
+		dest[i] = sample;
+	}
+
+	return {dest, src.size * sizeof(*dest)};
+}
+
+template<SampleFormat SF, class ST=SampleTraits<SF>>
+static ConstBuffer<void>
+pcm_volume_to_float(PcmBuffer &buffer, ConstBuffer<void> _src,
+		    int volume) noexcept
+{
+	const auto src = ConstBuffer<typename ST::value_type>::FromVoid(_src);
+	float *dest = buffer.GetT<float>(src.size);
+
+	/* the volume and the integer-to-float factor are combined
+	   into one multiplication */
+	const float factor = pcm_volume_to_float(volume) *
+		IntegerToFloatSampleConvert<SF, ST>::factor;
+
+	for (size_t i = 0; i != src.size; ++i)
+		dest[i] = float(src[i]) * factor;
+
+	return {dest, src.size * sizeof(*dest)};
+}
+
+ConstBuffer<void>
+pcm_volume_convert(PcmBuffer &buffer,
+		   SampleFormat src_format, SampleFormat dest_format,
+		   ConstBuffer<void> src, unsigned volume) noexcept
+{
+	switch (dest_format) {
+	case SampleFormat::FLOAT:
+		switch (src_format) {
+		case SampleFormat::S8:
+			return pcm_volume_to_float<SampleFormat::S8>(buffer, src,
+								     volume);
+
+		case SampleFormat::S16:
+			return pcm_volume_to_float<SampleFormat::S16>(buffer, src,
+								      volume);
+
+		case SampleFormat::S24_P32:
+			return pcm_volume_to_float<SampleFormat::S24_P32>(buffer, src,
+									  volume);
+
+		case SampleFormat::S32:
+			return pcm_volume_to_float<SampleFormat::S32>(buffer, src,
+								      volume);
+
+		default:
+			break;
+		}
+
+		break;
+
+	case SampleFormat::S24_P32:
+		if (src_format == SampleFormat::S16)
+			return pcm_volume_widen<SampleFormat::S16,
+						SampleFormat::S24_P32>(buffer, src,
+								       volume);
+		break;
+
+	case SampleFormat::S32:
+		if (src_format == SampleFormat::S16)
+			return pcm_volume_widen<SampleFormat::S16,
+						SampleFormat::S32>(buffer, src,
+								   volume);
+		else if (src_format == SampleFormat::S24_P32)
+			return pcm_volume_widen<SampleFormat::S24_P32,
+						SampleFormat::S32>(buffer, src,
+								   volume);
+		break;
+
+	default:
+		break;
+	}
+
+	return nullptr;
+}
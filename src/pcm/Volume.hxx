@@ -29,6 +29,7 @@
 #endif
 
 template<typename T> struct ConstBuffer;
+template<typename T> struct WritableBuffer;
 
 /**
  * Number of fractional bits for a fixed-point volume value.
@@ -63,14 +64,23 @@ pcm_volume_to_float(int volume) noexcept
 class PcmVolume {
 	SampleFormat format;
 
+	unsigned channels;
+
 	unsigned volume;
 
+	/**
+	 * The volume level at the end of the last Apply() call.  If
+	 * this differs from #volume, then the next Apply() call fades
+	 * linearly from this level to #volume.
+	 */
+	unsigned ramp_from;
+
 	PcmBuffer buffer;
 	PcmDither dither;
 
 public:
 	PcmVolume() noexcept
-		:volume(PCM_VOLUME_1) {
+		:volume(PCM_VOLUME_1), ramp_from(PCM_VOLUME_1) {
 #ifndef NDEBUG
 		format = SampleFormat::UNDEFINED;
 #endif
@@ -80,12 +90,35 @@ public:
 		return volume;
 	}
 
+	/**
+	 * Will the next Apply() call fade from one level to another?
+	 */
+	bool IsRamping() const noexcept {
+		return ramp_from != volume;
+	}
+
+	/**
+	 * Would Apply() return its input unmodified?
+	 */
+	bool IsNoOp() const noexcept {
+		return volume == PCM_VOLUME_1 && !IsRamping();
+	}
+
 	/**
 	 * @param _volume the volume level in the range
 	 * [0..#PCM_VOLUME_1]; may be bigger than #PCM_VOLUME_1, but
 	 * then it will most likely clip a lot
 	 */
 	void SetVolume(unsigned _volume) noexcept {
+		volume = ramp_from = _volume;
+	}
+
+	/**
+	 * Like SetVolume(), but the next Apply() call fades linearly
+	 * from the current level to the new one instead of switching
+	 * abruptly, which avoids audible clicks.
+	 */
+	void RampVolume(unsigned _volume) noexcept {
 		volume = _volume;
 	}
 
@@ -95,8 +128,11 @@ public:
 	 * Throws std::runtime_error on error.
 	 *
 	 * @param format the sample format
+	 * @param channels the number of channels; used by
+	 * RampVolume() to apply the same level to all samples of a
+	 * frame
 	 */
-	void Open(SampleFormat format);
+	void Open(SampleFormat format, unsigned channels=1);
 
 	/**
 	 * Closes the object.  After that, you may call Open() again.
@@ -111,8 +147,39 @@ public:
 	/**
 	 * Apply the volume level.
 	 */
-	gcc_pure
 	ConstBuffer<void> Apply(ConstBuffer<void> src) noexcept;
+
+	/**
+	 * Apply the volume level, modifying the buffer in place.
+	 */
+	void ApplyInPlace(WritableBuffer<void> data) noexcept;
+
+private:
+	/**
+	 * Apply the volume level, writing to #dest (which may be
+	 * equal to src.data).
+	 *
+	 * @return false if nothing has been written because this
+	 * sample format is not supported
+	 */
+	bool ApplyTo(void *dest, ConstBuffer<void> src) noexcept;
+
+	bool ApplyRamp(void *dest, ConstBuffer<void> src) noexcept;
 };
 
+/**
+ * Apply a constant volume level while converting to a wider sample
+ * format, in one pass over the data.  This is used to fuse a volume
+ * stage with the following format conversion.
+ *
+ * @param volume the volume level (#PCM_VOLUME_1 = 100%)
+ * @return the converted buffer (allocated in #buffer), or nullptr
+ * if this combination of formats is not implemented
+ */
+gcc_pure
+ConstBuffer<void>
+pcm_volume_convert(PcmBuffer &buffer,
+		   SampleFormat src_format, SampleFormat dest_format,
+		   ConstBuffer<void> src, unsigned volume) noexcept;
+
 #endif
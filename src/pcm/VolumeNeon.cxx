@@ -0,0 +1,70 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Software volume kernels for ARM NEON.
+ */
+
+#include "VolumeSimd.hxx"
+
+#ifdef PCM_SIMD_NEON
+
+#include "NeonDither.hxx"
+
+size_t
+pcm_volume_change_16_neon(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	NeonDither dither(lanes);
+	const int16_t v = volume;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const int16x8_t s = vld1q_s16(src);
+
+		const int32x4_t a = dither.Dither(vmull_n_s16(vget_low_s16(s), v));
+		const int32x4_t b = dither.Dither(vmull_n_s16(vget_high_s16(s), v));
+		vst1q_s16(dest, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+
+	dither.Store(lanes);
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_volume_change_float_neon(float *dest, const float *src, size_t n,
+			     float volume) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		vst1q_f32(dest, vmulq_n_f32(vld1q_f32(src), volume));
+		vst1q_f32(dest + 4, vmulq_n_f32(vld1q_f32(src + 4), volume));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
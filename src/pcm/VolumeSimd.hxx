@@ -0,0 +1,77 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_VOLUME_SIMD_HXX
+#define MPD_PCM_VOLUME_SIMD_HXX
+
+#include "Simd.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct PcmDitherLanes;
+
+/*
+ * Vectorized software volume kernels.  Each one processes a multiple
+ * of its block size and returns the number of samples it has
+ * written; the caller is responsible for the remaining samples.  The
+ * 16 bit kernels require a volume which fits into a signed 16 bit
+ * integer.
+ */
+
+#ifdef PCM_SIMD_AVX2
+
+size_t
+pcm_volume_change_16_avx2(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept;
+
+size_t
+pcm_volume_change_float_avx2(float *dest, const float *src, size_t n,
+			     float volume) noexcept;
+
+#endif
+
+#ifdef PCM_SIMD_SSE2
+
+size_t
+pcm_volume_change_16_sse2(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept;
+
+size_t
+pcm_volume_change_float_sse(float *dest, const float *src, size_t n,
+			    float volume) noexcept;
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+size_t
+pcm_volume_change_16_neon(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept;
+
+size_t
+pcm_volume_change_float_neon(float *dest, const float *src, size_t n,
+			     float volume) noexcept;
+
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Software volume kernels for x86 (SSE2 and AVX2).
+ */
+
+#include "VolumeSimd.hxx"
+#include "SseDither.hxx"
+
+#ifdef PCM_SIMD_SSE2
+
+size_t
+pcm_volume_change_16_sse2(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	SseDither dither(lanes);
+	const __m128i v = _mm_set1_epi16(volume);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)src);
+
+		/* 16x16=32 bit multiplication */
+		const __m128i lo16 = _mm_mullo_epi16(s, v);
+		const __m128i hi16 = _mm_mulhi_epi16(s, v);
+		const __m128i lo = _mm_unpacklo_epi16(lo16, hi16);
+		const __m128i hi = _mm_unpackhi_epi16(lo16, hi16);
+
+		const __m128i a = dither.Dither(lo);
+		const __m128i b = dither.Dither(hi);
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(a, b));
+	}
+
+	dither.Store(lanes);
+	return n_blocks * BLOCK_SIZE;
+}
+
+size_t
+pcm_volume_change_float_sse(float *dest, const float *src, size_t n,
+			    float volume) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 8;
+
+	const __m128 v = _mm_set1_ps(volume);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_loadu_ps(src), v));
+		_mm_storeu_ps(dest + 4, _mm_mul_ps(_mm_loadu_ps(src + 4), v));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
+
+#ifdef PCM_SIMD_AVX2
+
+AVX2_TARGET
+size_t
+pcm_volume_change_16_avx2(PcmDitherLanes &lanes,
+			  int16_t *dest, const int16_t *src, size_t n,
+			  int volume) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	Avx2Dither dither(lanes);
+	const __m256i v = _mm256_set1_epi16(volume);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		const __m256i s = _mm256_loadu_si256((const __m256i *)src);
+
+		/* unpack and pack operate on each 128 bit half
+		   separately, which cancels out */
+		const __m256i lo16 = _mm256_mullo_epi16(s, v);
+		const __m256i hi16 = _mm256_mulhi_epi16(s, v);
+		const __m256i lo = _mm256_unpacklo_epi16(lo16, hi16);
+		const __m256i hi = _mm256_unpackhi_epi16(lo16, hi16);
+
+		const __m256i a = dither.Dither(lo);
+		const __m256i b = dither.Dither(hi);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_packs_epi32(a, b));
+	}
+
+	dither.Store(lanes);
+	return n_blocks * BLOCK_SIZE;
+}
+
+AVX2_TARGET
+size_t
+pcm_volume_change_float_avx2(float *dest, const float *src, size_t n,
+			     float volume) noexcept
+{
+	constexpr size_t BLOCK_SIZE = 16;
+
+	const __m256 v = _mm256_set1_ps(volume);
+
+	const size_t n_blocks = n / BLOCK_SIZE;
+	for (size_t i = 0; i != n_blocks;
+	     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+		_mm256_storeu_ps(dest, _mm256_mul_ps(_mm256_loadu_ps(src), v));
+		_mm256_storeu_ps(dest + 8,
+				 _mm256_mul_ps(_mm256_loadu_ps(src + 8), v));
+	}
+
+	return n_blocks * BLOCK_SIZE;
+}
+
+#endif
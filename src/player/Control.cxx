@@ -21,6 +21,7 @@
 #include "Outputs.hxx"
 #include "Idle.hxx"
 #include "song/DetachedSong.hxx"
+#include "tag/Tag.hxx"
 
 #include <algorithm>
 
@@ -29,20 +30,26 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     PlayerOutputs &_outputs,
 			     unsigned _buffer_chunks,
+			     size_t _chunk_size,
+			     const MusicBufferConfig &_buffer_config,
+			     bool _warm_decoder, bool _low_latency,
+			     bool _gapless_convert,
+			     std::chrono::steady_clock::duration _stream_tag_interval,
 			     AudioFormat _configured_audio_format,
 			     const ReplayGainConfig &_replay_gain_config) noexcept
 	:listener(_listener), outputs(_outputs),
-	 buffer_chunks(_buffer_chunks),
+	 buffer_chunks(_buffer_chunks), chunk_size(_chunk_size),
+	 buffer_config(_buffer_config),
+	 warm_decoder(_warm_decoder), low_latency(_low_latency),
+	 gapless_convert(_gapless_convert),
+	 stream_tag_interval(_stream_tag_interval),
 	 configured_audio_format(_configured_audio_format),
 	 thread(BIND_THIS_METHOD(RunThread)),
 	 replay_gain_config(_replay_gain_config)
 {
 }
 
-PlayerControl::~PlayerControl() noexcept
-{
-	assert(!occupied);
-}
+PlayerControl::~PlayerControl() noexcept = default;
 
 bool
 PlayerControl::WaitOutputConsumed(unsigned threshold) noexcept
@@ -60,7 +67,7 @@ void
 PlayerControl::Play(std::unique_ptr<DetachedSong> song)
 {
 	if (!thread.IsDefined())
-		thread.Start();
+		StartThread();
 
 	assert(song != nullptr);
 
@@ -73,6 +80,15 @@ PlayerControl::Play(std::unique_ptr<DetachedSong> song)
 		PauseLocked();
 }
 
+void
+PlayerControl::StartThread()
+{
+	assert(!thread.IsDefined());
+
+	thread.Start();
+	suspended = false;
+}
+
 void
 PlayerControl::LockCancel() noexcept
 {
@@ -94,6 +110,34 @@ PlayerControl::LockStop() noexcept
 	idle_add(IDLE_PLAYER);
 }
 
+void
+PlayerControl::LockSuspendIdle() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		if (state != PlayerState::STOP) {
+			was_idle = false;
+			return;
+		}
+
+		if (!was_idle) {
+			/* give it another period */
+			was_idle = true;
+			return;
+		}
+
+		SynchronousCommand(PlayerCommand::SUSPEND);
+	}
+
+	thread.Join();
+	suspended = true;
+	was_idle = false;
+}
+
 void
 PlayerControl::LockUpdateAudio() noexcept
 {
@@ -106,8 +150,16 @@ PlayerControl::LockUpdateAudio() noexcept
 void
 PlayerControl::Kill() noexcept
 {
-	if (!thread.IsDefined())
+	if (!thread.IsDefined()) {
+		if (suspended) {
+			/* the player thread has exited already, but
+			   the outputs may still be open */
+			outputs.Close();
+			suspended = false;
+		}
+
 		return;
+	}
 
 	LockSynchronousCommand(PlayerCommand::EXIT);
 	thread.Join();
@@ -162,27 +214,62 @@ PlayerControl::LockSetBorderPause(bool _border_pause) noexcept
 	border_pause = _border_pause;
 }
 
-PlayerStatus
-PlayerControl::LockGetStatus() noexcept
+void
+PlayerControl::PublishStatus() noexcept
 {
-	PlayerStatus status;
+	PlayerStatusSnapshot s;
+	s.state = state;
+	s.has_error = error_type != PlayerError::NONE;
+	s.underruns = underruns;
 
-	const std::lock_guard<Mutex> protect(mutex);
-	if (!occupied && thread.IsDefined())
-		SynchronousCommand(PlayerCommand::REFRESH);
+	if (state != PlayerState::STOP) {
+		s.bit_rate = bit_rate;
+		s.audio_format = audio_format;
+		s.total_time = total_time;
+		s.elapsed_time = elapsed_time;
+	}
 
-	status.state = state;
+	status_snapshot.Store(s);
+}
 
-	if (state != PlayerState::STOP) {
-		status.bit_rate = bit_rate;
-		status.audio_format = audio_format;
-		status.total_time = total_time;
-		status.elapsed_time = elapsed_time;
+PlayerStatus
+PlayerControl::GetStatus() const noexcept
+{
+	const auto s = status_snapshot.Load();
+
+	PlayerStatus status;
+	status.state = s.state;
+	status.bit_rate = s.bit_rate;
+	status.audio_format = s.audio_format;
+	status.total_time = s.total_time;
+	status.elapsed_time = s.elapsed_time;
+	status.underruns = s.underruns;
+
+	if (s.has_error) {
+		const std::lock_guard<Mutex> protect(mutex);
+		if (error_type != PlayerError::NONE)
+			status.error = error;
 	}
 
 	return status;
 }
 
+PlayerLatency
+PlayerControl::LockGetLatency() const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return {decode_latency, pipe_latency, underruns};
+}
+
+MusicBufferStats
+PlayerControl::LockGetBufferStats() const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return running_buffer != nullptr
+		? running_buffer->GetStats()
+		: MusicBufferStats();
+}
+
 void
 PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 {
@@ -191,6 +278,7 @@ PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 
 	error_type = type;
 	error = std::move(_error);
+	PublishStatus();
 }
 
 void
@@ -212,6 +300,10 @@ void
 PlayerControl::ClearTaggedSong() noexcept
 {
 	tagged_song.reset();
+
+	/* the postponed stream tag belongs to the old song */
+	pending_stream_tag.reset();
+	last_stream_tag_time = std::chrono::steady_clock::time_point::min();
 }
 
 std::unique_ptr<DetachedSong>
@@ -263,6 +355,7 @@ PlayerControl::SeekLocked(std::unique_ptr<DetachedSong> song, SongTime t)
 	assert(next_song == nullptr);
 
 	ClearError();
+	was_idle = false;
 	next_song = std::move(song);
 	seek_time = t;
 	SynchronousCommand(PlayerCommand::SEEK);
@@ -286,7 +379,7 @@ void
 PlayerControl::LockSeek(std::unique_ptr<DetachedSong> song, SongTime t)
 {
 	if (!thread.IsDefined())
-		thread.Start();
+		StartThread();
 
 	assert(song != nullptr);
 
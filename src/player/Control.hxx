@@ -30,7 +30,11 @@
 #include "ReplayGainConfig.hxx"
 #include "ReplayGainMode.hxx"
 #include "MusicChunkPtr.hxx"
+#include "MusicBuffer.hxx"
+#include "LatencyHistogram.hxx"
+#include "thread/SeqLock.hxx"
 
+#include <chrono>
 #include <exception>
 #include <memory>
 
@@ -81,10 +85,11 @@ enum class PlayerCommand : uint8_t {
 	CANCEL,
 
 	/**
-	 * Refresh status information in the #PlayerControl struct,
-	 * e.g. elapsed_time.
+	 * Like #EXIT, but leave the outputs alone.  Sent by
+	 * PlayerControl::LockSuspendIdle() while the player is
+	 * stopped; the thread will be restarted on demand.
 	 */
-	REFRESH,
+	SUSPEND,
 };
 
 enum class PlayerError : uint8_t {
@@ -107,6 +112,51 @@ struct PlayerStatus {
 	AudioFormat audio_format;
 	SignedSongTime total_time;
 	SongTime elapsed_time;
+
+	/**
+	 * The number of times the decoder has not provided data in
+	 * time (see PlayerControl::underruns).
+	 */
+	unsigned underruns;
+
+	/**
+	 * The last error (see PlayerControl::error), or nullptr.
+	 */
+	std::exception_ptr error;
+};
+
+/**
+ * The part of #PlayerStatus which is published by
+ * PlayerControl::PublishStatus() for lock-free readers.
+ */
+struct PlayerStatusSnapshot {
+	PlayerState state = PlayerState::STOP;
+	bool has_error = false;
+	uint16_t bit_rate = 0;
+	AudioFormat audio_format = AudioFormat::Undefined();
+	SignedSongTime total_time = SignedSongTime::Negative();
+	SongTime elapsed_time = SongTime::zero();
+	unsigned underruns = 0;
+};
+
+/**
+ * Latency telemetry of the decoder and player stages of the
+ * pipeline.
+ */
+struct PlayerLatency {
+	/**
+	 * From the allocation of a #MusicChunk by the decoder until
+	 * it was pushed into the #MusicPipe.
+	 */
+	LatencyHistogram decode;
+
+	/**
+	 * From the #MusicPipe until the player thread handed the
+	 * chunk to the audio outputs.
+	 */
+	LatencyHistogram pipe;
+
+	unsigned underruns;
 };
 
 class PlayerControl final : public AudioOutputClient {
@@ -118,6 +168,56 @@ class PlayerControl final : public AudioOutputClient {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The size of each #MusicChunk in bytes (the
+	 * "audio_chunk_size" setting).
+	 */
+	const size_t chunk_size;
+
+	const MusicBufferConfig buffer_config;
+
+	/**
+	 * Launch a second decoder thread which pre-decodes the
+	 * beginning of the queued song (the "warm_decoder" setting)?
+	 */
+	const bool warm_decoder;
+
+	/**
+	 * Start playback with a small buffer and let it grow after
+	 * underruns (the "low_latency" setting)?
+	 */
+	const bool low_latency;
+
+	/**
+	 * Convert each song to the audio format of the song playing
+	 * before it, so the outputs need not be reopened (the
+	 * "gapless_convert" setting)?
+	 */
+	const bool gapless_convert;
+
+	/**
+	 * The minimum interval between two stream tag updates which
+	 * are propagated to the playlist and to the clients (the
+	 * "stream_tag_interval" setting).  More frequent updates are
+	 * coalesced.
+	 */
+	const std::chrono::steady_clock::duration stream_tag_interval;
+
+	/**
+	 * A stream tag which arrived less than #stream_tag_interval
+	 * after the previous one.  PlayChunk() applies it when the
+	 * interval has elapsed, unless it was superseded.  Only used
+	 * by the player thread.
+	 */
+	std::unique_ptr<Tag> pending_stream_tag;
+
+	/**
+	 * When was the last stream tag applied?  Only used by the
+	 * player thread.
+	 */
+	std::chrono::steady_clock::time_point last_stream_tag_time =
+		std::chrono::steady_clock::time_point::min();
+
 	/**
 	 * The "audio_output_format" setting.
 	 */
@@ -128,6 +228,21 @@ class PlayerControl final : public AudioOutputClient {
 	 */
 	Thread thread;
 
+	/**
+	 * Has the player thread exited because it was idle (see
+	 * LockSuspendIdle())?  Then the outputs may still be open
+	 * (e.g. "always_on"), and Kill() needs to close them.  Only
+	 * used by the main thread.
+	 */
+	bool suspended = false;
+
+	/**
+	 * Was the player stopped at the last LockSuspendIdle() call,
+	 * with no playback started since then?  Only used by the
+	 * main thread.
+	 */
+	bool was_idle = false;
+
 	/**
 	 * This lock protects #command, #state, #error, #tagged_song.
 	 */
@@ -194,35 +309,19 @@ class PlayerControl final : public AudioOutputClient {
 	 */
 	bool border_pause = false;
 
-	/**
-	 * If this flag is set, then the player thread is currently
-	 * occupied and will not be able to respond quickly to
-	 * commands (e.g. waiting for the decoder thread to finish
-	 * seeking).  This is used to skip #PlayerCommand::REFRESH to
-	 * avoid blocking the main thread.
-	 */
-	bool occupied = false;
-
-	struct ScopeOccupied {
-		PlayerControl &pc;
-
-		explicit ScopeOccupied(PlayerControl &_pc) noexcept:pc(_pc) {
-			assert(!pc.occupied);
-			pc.occupied = true;
-		}
-
-		~ScopeOccupied() noexcept {
-			assert(pc.occupied);
-			pc.occupied = false;
-		}
-	};
-
 	AudioFormat audio_format;
 	uint16_t bit_rate;
 
 	SignedSongTime total_time;
 	SongTime elapsed_time;
 
+	/**
+	 * A copy of #state, #bit_rate, #elapsed_time etc. for
+	 * GetStatus(), which may be read without locking #mutex.  It
+	 * is updated by PublishStatus().
+	 */
+	SeqLock<PlayerStatusSnapshot> status_snapshot;
+
 	SongTime seek_time;
 
 	CrossFadeSettings cross_fade;
@@ -231,10 +330,31 @@ class PlayerControl final : public AudioOutputClient {
 
 	FloatDuration total_play_time = FloatDuration::zero();
 
+	/**
+	 * Latency histograms of played chunks.  Protected by #mutex.
+	 */
+	LatencyHistogram decode_latency, pipe_latency;
+
+	/**
+	 * The number of times all audio outputs have run out of data
+	 * while the decoder was still busy.  Protected by #mutex.
+	 */
+	unsigned underruns = 0;
+
+	/**
+	 * The #MusicBuffer owned by the player thread while it is
+	 * running.  Protected by #mutex.
+	 */
+	const MusicBuffer *running_buffer = nullptr;
+
 public:
 	PlayerControl(PlayerListener &_listener,
 		      PlayerOutputs &_outputs,
-		      unsigned buffer_chunks,
+		      unsigned buffer_chunks, size_t _chunk_size,
+		      const MusicBufferConfig &_buffer_config,
+		      bool _warm_decoder, bool _low_latency,
+		      bool _gapless_convert,
+		      std::chrono::steady_clock::duration _stream_tag_interval,
 		      AudioFormat _configured_audio_format,
 		      const ReplayGainConfig &_replay_gain_config) noexcept;
 	~PlayerControl() noexcept;
@@ -282,6 +402,15 @@ public:
 
 	void LockStop() noexcept;
 
+	/**
+	 * To be called periodically by the main thread.  If the
+	 * player has been stopped since the previous call, the
+	 * player thread and its decoder threads exit (the outputs
+	 * remain as they are).  They are restarted by the next
+	 * Play() or LockSeek() call.
+	 */
+	void LockSuspendIdle() noexcept;
+
 	/**
 	 * see PlayerCommand::CANCEL
 	 */
@@ -323,8 +452,14 @@ public:
 	 */
 	std::unique_ptr<DetachedSong> LockReadTaggedSong() noexcept;
 
+	/**
+	 * Obtain the current status.  This does not lock #mutex
+	 * (unless there is an error), so polling clients do not
+	 * contend with the player thread.  The elapsed time is
+	 * updated by the player thread after each chunk.
+	 */
 	gcc_pure
-	PlayerStatus LockGetStatus() noexcept;
+	PlayerStatus GetStatus() const noexcept;
 
 	PlayerState GetState() const noexcept {
 		return state;
@@ -341,6 +476,16 @@ public:
 		return {state, next_song != nullptr};
 	}
 
+	gcc_pure
+	PlayerLatency LockGetLatency() const noexcept;
+
+	/**
+	 * Returns information about the memory of the #MusicBuffer;
+	 * all zero if the player thread is not running.
+	 */
+	gcc_pure
+	MusicBufferStats LockGetBufferStats() const noexcept;
+
 	auto GetTotalPlayTime() const noexcept {
 		return total_play_time;
 	}
@@ -408,6 +553,7 @@ private:
 		assert(command != PlayerCommand::NONE);
 
 		command = PlayerCommand::NONE;
+		PublishStatus();
 		ClientSignal();
 	}
 
@@ -476,6 +622,7 @@ private:
 	void ClearError() noexcept {
 		error_type = PlayerError::NONE;
 		error = std::exception_ptr();
+		PublishStatus();
 	}
 
 	bool ApplyBorderPause() noexcept {
@@ -502,6 +649,7 @@ private:
 		/* pause: the user may resume playback as soon as an
 		   audio output becomes available */
 		state = PlayerState::PAUSE;
+		PublishStatus();
 	}
 
 	void LockSetOutputError(std::exception_ptr &&_error) noexcept {
@@ -553,6 +701,19 @@ private:
 		ClientSignal();
 	}
 
+	/**
+	 * Copy the status attributes to #status_snapshot.
+	 *
+	 * Caller must lock the object.
+	 */
+	void PublishStatus() noexcept;
+
+	/**
+	 * Copy a stream tag to the current song and notify the main
+	 * thread.  Tags which equal the current one are ignored, and
+	 * updates which follow the previous one too quickly are
+	 * postponed (see #stream_tag_interval).
+	 */
 	void LockUpdateSongTag(DetachedSong &song,
 			       const Tag &new_tag) noexcept;
 
@@ -578,6 +739,11 @@ private:
 		LockUpdateAudio();
 	}
 
+	/**
+	 * Throws on error.
+	 */
+	void StartThread();
+
 	void RunThread() noexcept;
 };
 
@@ -19,7 +19,6 @@
 
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
-#include "MusicChunk.hxx"
 #include "AudioFormat.hxx"
 #include "util/NumberParser.hxx"
 #include "util/Domain.hxx"
@@ -93,6 +92,7 @@ CrossFadeSettings::Calculate(SignedSongTime total_time,
 			     const char *mixramp_start, const char *mixramp_prev_end,
 			     const AudioFormat af,
 			     const AudioFormat old_format,
+			     size_t chunk_length,
 			     unsigned max_chunks) const noexcept
 {
 	unsigned int chunks = 0;
@@ -108,7 +108,7 @@ CrossFadeSettings::Calculate(SignedSongTime total_time,
 	assert(af.IsValid());
 
 	const auto chunk_duration =
-		af.SizeToTime<FloatDuration>(sizeof(MusicChunk::data));
+		af.SizeToTime<FloatDuration>(chunk_length);
 
 	if (mixramp_delay <= FloatDuration::zero() ||
 	    !mixramp_start || !mixramp_prev_end) {
@@ -45,11 +45,15 @@
 #include "song/DetachedSong.hxx"
 #include "CrossFade.hxx"
 #include "tag/Tag.hxx"
+#include "tag/Item.hxx"
 #include "Idle.hxx"
+#include "ThreadConfig.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
 #include "Log.hxx"
+#include "util/Trace.hxx"
 
+#include <algorithm>
 #include <exception>
 #include <memory>
 
@@ -61,15 +65,50 @@ static constexpr Domain player_domain("player");
  * Start playback as soon as enough data for this duration has been
  * pushed to the decoder pipe.
  */
-static constexpr auto buffer_before_play_duration = std::chrono::seconds(1);
+static constexpr std::chrono::steady_clock::duration default_buffer_before_play = std::chrono::seconds(1);
+
+/**
+ * The initial buffer_before_play duration in "low_latency" mode.  It
+ * is doubled after each underrun, up to #default_buffer_before_play.
+ */
+static constexpr std::chrono::steady_clock::duration low_latency_buffer_before_play = std::chrono::milliseconds(100);
+
+/**
+ * The size of the #MusicBuffer used by the warm decoder.  It holds a
+ * little more than #default_buffer_before_play of high-resolution
+ * stereo audio, so playback can begin right away when the player
+ * switches to the warmed-up song.
+ */
+static constexpr size_t warm_buffer_size = 512 * 1024;
 
 class Player {
 	PlayerControl &pc;
 
-	DecoderControl &dc;
+	/**
+	 * The decoder which feeds the current song (and, at the end
+	 * of the song, the next one).  This pointer is exchanged with
+	 * #warm_dc when a warmed-up decoder takes over.
+	 */
+	DecoderControl *dc;
 
 	MusicBuffer &buffer;
 
+	/**
+	 * The optional second decoder (setting "warm_decoder") which
+	 * pre-decodes the beginning of the queued song into a spare
+	 * #MusicPipe while #dc is still busy with the current one.
+	 * If the player switches to that song, this decoder takes
+	 * over, and playback starts without the decoder startup
+	 * latency.  This is nullptr if the feature is disabled.
+	 */
+	DecoderControl *warm_dc;
+
+	/**
+	 * A small #MusicBuffer used by #warm_dc; its size limits how
+	 * much of the queued song gets decoded ahead of time.
+	 */
+	MusicBuffer *warm_buffer;
+
 	std::shared_ptr<MusicPipe> pipe;
 
 	/**
@@ -91,6 +130,13 @@ class Player {
 	 */
 	unsigned buffer_before_play;
 
+	/**
+	 * The amount of audio which is buffered before playback
+	 * starts.  In "low_latency" mode, this starts small and grows
+	 * after each underrun.
+	 */
+	std::chrono::steady_clock::duration buffer_before_play_duration;
+
 	/**
 	 * If the decoder pipe gets consumed below this threshold,
 	 * it's time to wake up the decoder.
@@ -118,6 +164,13 @@ class Player {
 	 */
 	bool decoder_woken = false;
 
+	/**
+	 * Has the current underrun already been counted in
+	 * PlayerControl::underruns?  Cleared by the next chunk
+	 * being played.
+	 */
+	bool underrun = false;
+
 	/**
 	 * is the player paused?
 	 */
@@ -196,8 +249,13 @@ class Player {
 
 public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
-	       MusicBuffer &_buffer) noexcept
-		:pc(_pc), dc(_dc), buffer(_buffer),
+	       MusicBuffer &_buffer,
+	       DecoderControl *_warm_dc, MusicBuffer *_warm_buffer) noexcept
+		:pc(_pc), dc(&_dc), buffer(_buffer),
+		 warm_dc(_warm_dc), warm_buffer(_warm_buffer),
+		 buffer_before_play_duration(pc.low_latency
+					     ? low_latency_buffer_before_play
+					     : default_buffer_before_play),
 		 decoder_wakeup_threshold(buffer.GetSize() * 3 / 4)
 	{
 	}
@@ -217,6 +275,18 @@ private:
 		pipe = std::forward<P>(_pipe);
 	}
 
+	/**
+	 * The audio format the next song shall be converted to (see
+	 * PlayerControl::gapless_convert), or an undefined one to
+	 * keep the decoder's format.
+	 */
+	gcc_pure
+	AudioFormat GetForceAudioFormat() const noexcept {
+		return pc.gapless_convert
+			? play_audio_format
+			: AudioFormat::Undefined();
+	}
+
 	/**
 	 * Start the decoder.
 	 *
@@ -224,6 +294,21 @@ private:
 	 */
 	void StartDecoder(std::shared_ptr<MusicPipe> pipe) noexcept;
 
+	/**
+	 * Calculate #buffer_before_play from
+	 * #buffer_before_play_duration and #play_audio_format.
+	 */
+	void UpdateBufferBeforePlay() noexcept;
+
+	/**
+	 * An underrun has occurred in "low_latency" mode: double
+	 * #buffer_before_play_duration (up to the default), so the
+	 * next rebuffering leaves more headroom.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void GrowBufferBeforePlay() noexcept;
+
 	/**
 	 * The decoder has acknowledged the "START" command (see
 	 * ActivateDecoder()).  This function checks if the decoder
@@ -254,7 +339,7 @@ private:
 	bool IsDecoderAtCurrentSong() const noexcept {
 		assert(pipe != nullptr);
 
-		return dc.pipe == pipe;
+		return dc->pipe == pipe;
 	}
 
 	/**
@@ -264,7 +349,7 @@ private:
 	 */
 	gcc_pure
 	bool IsDecoderAtNextSong() const noexcept {
-		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
+		return dc->pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
 	/**
@@ -299,6 +384,39 @@ private:
 	 */
 	bool ForwardDecoderError() noexcept;
 
+	/**
+	 * Is the warm decoder busy with the given song (from the
+	 * beginning)?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	bool IsWarmDecoderAt(const DetachedSong &_song) const noexcept;
+
+	/**
+	 * Start the warm decoder on the queued song if it is idle
+	 * and #dc is busy with the current song.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void MaybeStartWarmDecoder() noexcept;
+
+	/**
+	 * Stop the warm decoder and discard its pipe.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StopWarmDecoder() noexcept;
+
+	/**
+	 * Let the warm decoder take over: it becomes #dc, and the
+	 * previous (idle) #dc becomes the new warm decoder.  The
+	 * caller is responsible for assigning the pipe.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void PromoteWarmDecoder() noexcept;
+
 	/**
 	 * After the decoder has been started asynchronously, activate
 	 * it for playback.  That is, make the currently decoded song
@@ -332,6 +450,19 @@ private:
 	 */
 	bool PlayNextChunk() noexcept;
 
+	/**
+	 * Copy the current elapsed time to #PlayerControl and publish
+	 * a new status snapshot for lock-free readers.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void PublishStatus() noexcept {
+		pc.elapsed_time = !pc.outputs.GetElapsedTime().IsNegative()
+			? SongTime(pc.outputs.GetElapsedTime())
+			: elapsed_time;
+		pc.PublishStatus();
+	}
+
 	unsigned UnlockCheckOutputs() noexcept {
 		const ScopeUnlock unlock(pc.mutex);
 		return pc.outputs.CheckPipe();
@@ -369,27 +500,25 @@ Player::StartDecoder(std::shared_ptr<MusicPipe> _pipe) noexcept
 	assert(pc.next_song != nullptr);
 
 	/* copy ReplayGain parameters to the decoder */
-	dc.replay_gain_mode = pc.replay_gain_mode;
+	dc->replay_gain_mode = pc.replay_gain_mode;
 
 	SongTime start_time = pc.next_song->GetStartTime() + pc.seek_time;
 
-	dc.Start(std::make_unique<DetachedSong>(*pc.next_song),
+	dc->Start(std::make_unique<DetachedSong>(*pc.next_song),
 		 start_time, pc.next_song->GetEndTime(),
-		 buffer, std::move(_pipe));
+		 buffer, std::move(_pipe), GetForceAudioFormat());
 }
 
 void
 Player::StopDecoder() noexcept
 {
-	const PlayerControl::ScopeOccupied occupied(pc);
-
-	dc.Stop();
+	dc->Stop();
 
-	if (dc.pipe != nullptr) {
+	if (dc->pipe != nullptr) {
 		/* clear and free the decoder pipe */
 
-		dc.pipe->Clear();
-		dc.pipe.reset();
+		dc->pipe->Clear();
+		dc->pipe.reset();
 
 		/* just in case we've been cross-fading: cancel it
 		   now, because we just deleted the new song's decoder
@@ -398,11 +527,73 @@ Player::StopDecoder() noexcept
 	}
 }
 
+bool
+Player::IsWarmDecoderAt(const DetachedSong &_song) const noexcept
+{
+	return warm_dc != nullptr && warm_dc->pipe != nullptr &&
+		pc.seek_time == SongTime::zero() &&
+		warm_dc->IsCurrentSong(_song);
+}
+
+void
+Player::MaybeStartWarmDecoder() noexcept
+{
+	if (warm_dc == nullptr || warm_dc->pipe != nullptr ||
+	    !queued || decoder_starting || dc->IsIdle() ||
+	    !IsDecoderAtCurrentSong() ||
+	    /* the previous warm decoder may still be allocating
+	       from the warm buffer */
+	    dc->HasPendingBuffer())
+		return;
+
+	assert(pc.next_song != nullptr);
+
+	warm_dc->replay_gain_mode = pc.replay_gain_mode;
+	warm_dc->Start(std::make_unique<DetachedSong>(*pc.next_song),
+		       pc.next_song->GetStartTime(),
+		       pc.next_song->GetEndTime(),
+		       *warm_buffer, std::make_shared<MusicPipe>(),
+		       GetForceAudioFormat());
+}
+
+void
+Player::StopWarmDecoder() noexcept
+{
+	if (warm_dc == nullptr)
+		return;
+
+	warm_dc->Stop();
+
+	if (warm_dc->pipe != nullptr) {
+		warm_dc->pipe->Clear();
+		warm_dc->pipe.reset();
+	}
+}
+
+void
+Player::PromoteWarmDecoder() noexcept
+{
+	assert(warm_dc != nullptr);
+	assert(warm_dc->pipe != nullptr);
+	assert(dc->IsIdle());
+
+	std::swap(dc, warm_dc);
+
+	/* the old decoder's pipe belongs to the player now (or has
+	   already been cleared by StopDecoder()) */
+	warm_dc->pipe.reset();
+
+	/* from now on, the new decoder shall use the large buffer;
+	   chunks allocated from the warm buffer will be returned
+	   there */
+	dc->SetBuffer(buffer);
+}
+
 bool
 Player::ForwardDecoderError() noexcept
 {
 	try {
-		dc.CheckRethrowError();
+		dc->CheckRethrowError();
 	} catch (...) {
 		pc.SetError(PlayerError::DECODER, std::current_exception());
 		return false;
@@ -500,6 +691,33 @@ Player::OpenOutput() noexcept
 	return true;
 }
 
+void
+Player::UpdateBufferBeforePlay() noexcept
+{
+	const size_t buffer_before_play_size =
+		play_audio_format.TimeToSize(buffer_before_play_duration);
+	const size_t chunk_length =
+		buffer.GetChunkLength(play_audio_format);
+	buffer_before_play =
+		(buffer_before_play_size + chunk_length - 1)
+		/ chunk_length;
+}
+
+void
+Player::GrowBufferBeforePlay() noexcept
+{
+	if (buffer_before_play_duration >= default_buffer_before_play)
+		return;
+
+	buffer_before_play_duration = std::min(buffer_before_play_duration * 2,
+					       default_buffer_before_play);
+	FormatDebug(player_domain, "underrun: buffer_before_play=%ums",
+		    unsigned(std::chrono::duration_cast<std::chrono::milliseconds>(buffer_before_play_duration).count()));
+
+	if (play_audio_format.IsDefined())
+		UpdateBufferBeforePlay();
+}
+
 bool
 Player::CheckDecoderStartup() noexcept
 {
@@ -508,7 +726,7 @@ Player::CheckDecoderStartup() noexcept
 	if (!ForwardDecoderError()) {
 		/* the decoder failed */
 		return false;
-	} else if (!dc.IsStarting()) {
+	} else if (!dc->IsStarting()) {
 		/* the decoder is ready and ok */
 
 		if (output_open &&
@@ -517,17 +735,13 @@ Player::CheckDecoderStartup() noexcept
 			   all chunks yet - wait for that */
 			return true;
 
-		pc.total_time = real_song_duration(*dc.song,
-						   dc.total_time);
-		pc.audio_format = dc.in_audio_format;
-		play_audio_format = dc.out_audio_format;
+		pc.total_time = real_song_duration(*dc->song,
+						   dc->total_time);
+		pc.audio_format = dc->in_audio_format;
+		play_audio_format = dc->out_audio_format;
 		decoder_starting = false;
 
-		const size_t buffer_before_play_size =
-			play_audio_format.TimeToSize(buffer_before_play_duration);
-		buffer_before_play =
-			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
-			/ sizeof(MusicChunk::data);
+		UpdateBufferBeforePlay();
 
 		idle_add(IDLE_PLAYER);
 
@@ -554,7 +768,7 @@ Player::CheckDecoderStartup() noexcept
 			FormatError(player_domain,
 				    "problems opening audio device "
 				    "while playing \"%s\"",
-				    dc.song->GetURI());
+				    dc->song->GetURI());
 			return true;
 		}
 
@@ -562,7 +776,7 @@ Player::CheckDecoderStartup() noexcept
 	} else {
 		/* the decoder is not yet ready; wait
 		   some more */
-		dc.WaitForDecoder();
+		dc->WaitForDecoder();
 
 		return true;
 	}
@@ -581,9 +795,7 @@ Player::SeekDecoder(SongTime seek_time) noexcept
 	}
 
 	try {
-		const PlayerControl::ScopeOccupied occupied(pc);
-
-		dc.Seek(song->GetStartTime() + seek_time);
+		dc->Seek(song->GetStartTime() + seek_time);
 	} catch (...) {
 		/* decoder failure */
 		pc.SetError(PlayerError::DECODER, std::current_exception());
@@ -608,7 +820,26 @@ Player::SeekDecoder() noexcept
 
 	idle_add(IDLE_PLAYER);
 
-	if (!dc.IsSeekableCurrentSong(*pc.next_song)) {
+	if (!dc->IsCurrentSong(*pc.next_song) &&
+	    IsWarmDecoderAt(*pc.next_song)) {
+		/* the warm decoder has already begun decoding this
+		   song - stop the current decoder and switch to the
+		   warm one */
+
+		StopDecoder();
+		pipe->Clear();
+
+		PromoteWarmDecoder();
+		ReplacePipe(dc->pipe);
+		ActivateDecoder();
+
+		pc.seeking = true;
+		pc.CommandFinished();
+
+		assert(xfade_state == CrossFadeState::UNKNOWN);
+
+		return true;
+	} else if (!dc->IsSeekableCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
 
@@ -632,7 +863,7 @@ Player::SeekDecoder() noexcept
 		if (!IsDecoderAtCurrentSong()) {
 			/* the decoder is already decoding the "next" song,
 			   but it is the same song file; exchange the pipe */
-			ReplacePipe(dc.pipe);
+			ReplacePipe(dc->pipe);
 		}
 
 		pc.next_song.reset();
@@ -676,6 +907,7 @@ Player::ProcessCommand() noexcept
 
 	case PlayerCommand::STOP:
 	case PlayerCommand::EXIT:
+	case PlayerCommand::SUSPEND:
 	case PlayerCommand::CLOSE_AUDIO:
 		return false;
 
@@ -696,8 +928,24 @@ Player::ProcessCommand() noexcept
 		queued = true;
 		pc.CommandFinished();
 
-		if (dc.IsIdle())
+		if (warm_dc != nullptr && warm_dc->pipe != nullptr &&
+		    !IsWarmDecoderAt(*pc.next_song))
+			/* the warm decoder has been prepared for a
+			   different song */
+			StopWarmDecoder();
+
+		if (dc->IsIdle())
 			StartDecoder(std::make_shared<MusicPipe>());
+		else if (warm_dc != nullptr)
+			/* the decoder is still busy with the current
+			   song; let the warm decoder begin with the
+			   next one */
+			MaybeStartWarmDecoder();
+		else
+			/* the decoder is still busy with the current
+			   song; open the next song's stream now so it
+			   can fill its buffer in the meantime */
+			dc->Prefetch(*pc.next_song);
 
 		break;
 
@@ -734,23 +982,41 @@ Player::ProcessCommand() noexcept
 			   stop it and reset the position */
 			StopDecoder();
 
+		/* the warm decoder may already be decoding the
+		   canceled song */
+		StopWarmDecoder();
+
+		dc->CancelPrefetch();
 		pc.next_song.reset();
 		queued = false;
 		pc.CommandFinished();
 		break;
+	}
 
-	case PlayerCommand::REFRESH:
-		if (output_open && !paused) {
-			const ScopeUnlock unlock(pc.mutex);
-			pc.outputs.CheckPipe();
-		}
+	return true;
+}
 
-		pc.elapsed_time = !pc.outputs.GetElapsedTime().IsNegative()
-			? SongTime(pc.outputs.GetElapsedTime())
-			: elapsed_time;
+/**
+ * Do both tags have the same items (in the same order) and the same
+ * duration?
+ */
+gcc_pure
+static bool
+IsSameTag(const Tag &a, const Tag &b) noexcept
+{
+	if (a.duration != b.duration || a.has_playlist != b.has_playlist ||
+	    a.num_items != b.num_items)
+		return false;
 
-		pc.CommandFinished();
-		break;
+	if (a.items == b.items)
+		/* shared array */
+		return true;
+
+	for (unsigned i = 0; i < a.num_items; ++i) {
+		const TagItem &x = *a.items[i], &y = *b.items[i];
+		if (&x != &y &&
+		    (x.type != y.type || strcmp(x.value, y.value) != 0))
+			return false;
 	}
 
 	return true;
@@ -765,6 +1031,24 @@ PlayerControl::LockUpdateSongTag(DetachedSong &song,
 		   streams may change tags dynamically */
 		return;
 
+	if (IsSameTag(song.GetTag(), new_tag)) {
+		/* nothing has changed (and a postponed tag has been
+		   superseded) */
+		pending_stream_tag.reset();
+		return;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now < last_stream_tag_time + stream_tag_interval) {
+		/* too soon after the previous update: postpone this
+		   one, replacing an older postponed tag */
+		pending_stream_tag = std::make_unique<Tag>(new_tag);
+		return;
+	}
+
+	pending_stream_tag.reset();
+	last_stream_tag_time = now;
+
 	song.SetTag(new_tag);
 
 	LockSetTaggedSong(song);
@@ -786,6 +1070,11 @@ PlayerControl::PlayChunk(DetachedSong &song, MusicChunkPtr chunk,
 
 	if (chunk->tag != nullptr)
 		LockUpdateSongTag(song, *chunk->tag);
+	else if (pending_stream_tag != nullptr &&
+		 std::chrono::steady_clock::now() >= last_stream_tag_time + stream_tag_interval) {
+		const auto tag = std::move(pending_stream_tag);
+		LockUpdateSongTag(song, *tag);
+	}
 
 	if (chunk->IsEmpty())
 		return;
@@ -806,6 +1095,8 @@ PlayerControl::PlayChunk(DetachedSong &song, MusicChunkPtr chunk,
 inline bool
 Player::PlayNextChunk() noexcept
 {
+	const TraceSpan trace_span("player/play_next_chunk");
+
 	if (!pc.LockWaitOutputConsumed(64))
 		/* the output pipe is still large enough, don't send
 		   another chunk */
@@ -831,7 +1122,7 @@ Player::PlayNextChunk() noexcept
 		unsigned cross_fade_position = pipe->GetSize();
 		assert(cross_fade_position <= cross_fade_chunks);
 
-		auto other_chunk = dc.pipe->Shift();
+		auto other_chunk = dc->pipe->Shift();
 		if (other_chunk != nullptr) {
 			chunk = pipe->Shift();
 			assert(chunk != nullptr);
@@ -867,14 +1158,14 @@ Player::PlayNextChunk() noexcept
 
 			const std::lock_guard<Mutex> lock(pc.mutex);
 
-			if (dc.IsIdle()) {
+			if (dc->IsIdle()) {
 				/* the decoder isn't running, abort
 				   cross fading */
 				xfade_state = CrossFadeState::DISABLED;
 			} else {
 				/* wait for the decoder */
-				dc.Signal();
-				dc.WaitForDecoder();
+				dc->Signal();
+				dc->WaitForDecoder();
 
 				return true;
 			}
@@ -896,6 +1187,10 @@ Player::PlayNextChunk() noexcept
 
 	/* play the current chunk */
 
+	chunk->play_time = std::chrono::steady_clock::now();
+	const auto decode_latency = chunk->pipe_time - chunk->decode_time;
+	const auto pipe_latency = chunk->play_time - chunk->pipe_time;
+
 	try {
 		pc.PlayChunk(*song, std::move(chunk),
 			     play_audio_format);
@@ -917,13 +1212,17 @@ Player::PlayNextChunk() noexcept
 
 	const std::lock_guard<Mutex> lock(pc.mutex);
 
+	pc.decode_latency.Add(decode_latency);
+	pc.pipe_latency.Add(pipe_latency);
+	underrun = false;
+
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
 	   larger block at a time */
-	if (!dc.IsIdle() && dc.pipe->GetSize() <= decoder_wakeup_threshold) {
+	if (!dc->IsIdle() && dc->pipe->GetSize() <= decoder_wakeup_threshold) {
 		if (!decoder_woken) {
 			decoder_woken = true;
-			dc.Signal();
+			dc->Signal();
 		}
 	} else
 		decoder_woken = false;
@@ -939,7 +1238,7 @@ Player::SongBorder() noexcept
 
 		FormatDefault(player_domain, "played \"%s\"", song->GetURI());
 
-		ReplacePipe(dc.pipe);
+		ReplacePipe(dc->pipe);
 
 		pc.outputs.SongBorder();
 	}
@@ -970,6 +1269,8 @@ Player::Run() noexcept
 	pc.CommandFinished();
 
 	while (ProcessCommand()) {
+		PublishStatus();
+
 		if (decoder_starting) {
 			/* wait until the decoder is initialized completely */
 
@@ -985,10 +1286,10 @@ Player::Run() noexcept
 			   prevent stuttering on slow machines */
 
 			if (pipe->GetSize() < buffer_before_play &&
-			    !dc.IsIdle() && !buffer.IsFull()) {
+			    !dc->IsIdle() && !buffer.IsFull()) {
 				/* not enough decoded buffer space yet */
 
-				dc.WaitForDecoder();
+				dc->WaitForDecoder();
 				continue;
 			} else {
 				/* buffering is complete */
@@ -996,32 +1297,40 @@ Player::Run() noexcept
 			}
 		}
 
-		if (dc.IsIdle() && queued && dc.pipe == pipe) {
+		if (dc->IsIdle() && queued && dc->pipe == pipe) {
 			/* the decoder has finished the current song;
 			   make it decode the next song */
 
-			assert(dc.pipe == nullptr || dc.pipe == pipe);
+			assert(dc->pipe == nullptr || dc->pipe == pipe);
 
-			StartDecoder(std::make_shared<MusicPipe>());
+			if (IsWarmDecoderAt(*pc.next_song))
+				/* ... unless the warm decoder is
+				   already doing that */
+				PromoteWarmDecoder();
+			else
+				StartDecoder(std::make_shared<MusicPipe>());
 		}
 
+		MaybeStartWarmDecoder();
+
 		if (/* no cross-fading if MPD is going to pause at the
 		       end of the current song */
 		    !pc.border_pause &&
 		    IsDecoderAtNextSong() &&
 		    xfade_state == CrossFadeState::UNKNOWN &&
-		    !dc.IsStarting()) {
+		    !dc->IsStarting()) {
 			/* enable cross fading in this song?  if yes,
 			   calculate how many chunks will be required
 			   for it */
 			cross_fade_chunks =
-				pc.cross_fade.Calculate(dc.total_time,
-							dc.replay_gain_db,
-							dc.replay_gain_prev_db,
-							dc.GetMixRampStart(),
-							dc.GetMixRampPreviousEnd(),
-							dc.out_audio_format,
+				pc.cross_fade.Calculate(dc->total_time,
+							dc->replay_gain_db,
+							dc->replay_gain_prev_db,
+							dc->GetMixRampStart(),
+							dc->GetMixRampPreviousEnd(),
+							dc->out_audio_format,
 							play_audio_format,
+							buffer.GetChunkLength(dc->out_audio_format),
 							buffer.GetSize() -
 							buffer_before_play);
 			if (cross_fade_chunks > 0)
@@ -1050,14 +1359,14 @@ Player::Run() noexcept
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
 			// TODO: eliminate this kludge
-			dc.Signal();
+			dc->Signal();
 
-			dc.WaitForDecoder();
+			dc->WaitForDecoder();
 		} else if (IsDecoderAtNextSong()) {
 			/* at the beginning of a new song */
 
 			SongBorder();
-		} else if (dc.IsIdle()) {
+		} else if (dc->IsIdle()) {
 			/* check the size of the pipe again, because
 			   the decoder thread may have added something
 			   since we last checked */
@@ -1073,18 +1382,28 @@ Player::Run() noexcept
 			   new PCM data in time: wait for the
 			   decoder */
 
+			if (!underrun) {
+				underrun = true;
+				++pc.underruns;
+				idle_add(IDLE_PLAYER);
+
+				if (pc.low_latency)
+					GrowBufferBeforePlay();
+			}
+
 			/* wake up the decoder (just in case it's
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
 			// TODO: eliminate this kludge
-			dc.Signal();
+			dc->Signal();
 
-			dc.WaitForDecoder();
+			dc->WaitForDecoder();
 		}
 	}
 
 	CancelPendingSeek();
 	StopDecoder();
+	StopWarmDecoder();
 
 	pipe.reset();
 
@@ -1102,14 +1421,18 @@ Player::Run() noexcept
 		pc.next_song.reset();
 	}
 
+	dc->CancelPrefetch();
+
 	pc.state = PlayerState::STOP;
+	pc.PublishStatus();
 }
 
 static void
 do_play(PlayerControl &pc, DecoderControl &dc,
-	MusicBuffer &buffer) noexcept
+	MusicBuffer &buffer,
+	DecoderControl *warm_dc, MusicBuffer *warm_buffer) noexcept
 {
-	Player player(pc, dc, buffer);
+	Player player(pc, dc, buffer, warm_dc, warm_buffer);
 	player.Run();
 }
 
@@ -1117,16 +1440,41 @@ void
 PlayerControl::RunThread() noexcept
 try {
 	SetThreadName("player");
+	player_thread_config.Apply("player");
 
 	DecoderControl dc(mutex, cond,
 			  configured_audio_format,
 			  replay_gain_config);
 	dc.StartThread();
 
-	MusicBuffer buffer(buffer_chunks);
+	MusicBuffer buffer(buffer_chunks, chunk_size, buffer_config);
+
+	if (buffer_config.huge_pages == HugePageMode::EXPLICIT &&
+	    buffer.GetHugePageMode() != HugePageMode::EXPLICIT)
+		LogWarning(player_domain,
+			   "Not enough huge pages for the audio buffer, using normal pages");
+
+	if (buffer_config.lock && !buffer.IsLocked())
+		LogWarning(player_domain,
+			   "Failed to lock the audio buffer into memory; check RLIMIT_MEMLOCK");
+
+	std::unique_ptr<DecoderControl> warm_dc;
+	std::unique_ptr<MusicBuffer> warm_buffer;
+	if (warm_decoder) {
+		warm_dc = std::make_unique<DecoderControl>(mutex, cond,
+							   configured_audio_format,
+							   replay_gain_config);
+		warm_dc->StartThread();
+
+		warm_buffer = std::make_unique<MusicBuffer>(std::max<size_t>(warm_buffer_size / chunk_size, 4),
+							    chunk_size,
+							    buffer_config);
+	}
 
 	const std::lock_guard<Mutex> lock(mutex);
 
+	running_buffer = &buffer;
+
 	while (1) {
 		switch (command) {
 		case PlayerCommand::SEEK:
@@ -1135,7 +1483,8 @@ try {
 
 			{
 				const ScopeUnlock unlock(mutex);
-				do_play(*this, dc, buffer);
+				do_play(*this, dc, buffer,
+					warm_dc.get(), warm_buffer.get());
 				listener.OnPlayerSync();
 			}
 
@@ -1147,6 +1496,12 @@ try {
 				outputs.Cancel();
 			}
 
+			/* give the memory of unused chunks back to
+			   the kernel */
+			buffer.DiscardMemory();
+			if (warm_buffer)
+				warm_buffer->DiscardMemory();
+
 			/* fall through */
 
 		case PlayerCommand::PAUSE:
@@ -1164,6 +1519,9 @@ try {
 			CommandFinished();
 
 			assert(buffer.IsEmptyUnsafe());
+			buffer.DiscardMemory();
+			if (warm_buffer)
+				warm_buffer->DiscardMemory();
 
 			break;
 
@@ -1180,20 +1538,32 @@ try {
 			{
 				const ScopeUnlock unlock(mutex);
 				dc.Quit();
+				if (warm_dc)
+					warm_dc->Quit();
 				outputs.Close();
 			}
 
+			running_buffer = nullptr;
+
 			CommandFinished();
 			return;
 
-		case PlayerCommand::CANCEL:
-			next_song.reset();
+		case PlayerCommand::SUSPEND:
+			{
+				const ScopeUnlock unlock(mutex);
+				dc.Quit();
+				if (warm_dc)
+					warm_dc->Quit();
+			}
+
+			running_buffer = nullptr;
 
 			CommandFinished();
-			break;
+			return;
+
+		case PlayerCommand::CANCEL:
+			next_song.reset();
 
-		case PlayerCommand::REFRESH:
-			/* no-op when not playing */
 			CommandFinished();
 			break;
 
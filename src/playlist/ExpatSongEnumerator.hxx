@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EXPAT_SONG_ENUMERATOR_HXX
+#define MPD_EXPAT_SONG_ENUMERATOR_HXX
+
+#include "SongEnumerator.hxx"
+#include "song/DetachedSong.hxx"
+#include "input/InputStream.hxx"
+#include "input/Ptr.hxx"
+#include "lib/expat/ExpatParser.hxx"
+
+#include <list>
+#include <memory>
+
+/**
+ * A #SongEnumerator which parses an XML playlist incrementally: each
+ * NextSong() call feeds the input stream to the parser only until the
+ * next song has been found.  This way, the first song is available
+ * before the whole (possibly huge) document has been received, and
+ * the memory usage does not grow with the size of the document.
+ *
+ * @param T the parser state; it is passed to the expat callbacks as
+ * "user data" and must have an attribute "songs" (a std::list) to
+ * which the callbacks append all songs they find
+ */
+template<typename T>
+class ExpatSongEnumerator final : public SongEnumerator {
+	InputStreamPtr is;
+
+	T state;
+
+	ExpatParser expat;
+
+	/**
+	 * Has the end of the input stream been reached?
+	 */
+	bool finished = false;
+
+public:
+	ExpatSongEnumerator(InputStreamPtr &&_is,
+			    XML_StartElementHandler start,
+			    XML_EndElementHandler end,
+			    XML_CharacterDataHandler char_data)
+		:is(std::move(_is)), expat(&state) {
+		expat.SetElementHandler(start, end);
+		expat.SetCharacterDataHandler(char_data);
+	}
+
+	std::unique_ptr<DetachedSong> NextSong() override {
+		while (state.songs.empty()) {
+			if (finished)
+				return nullptr;
+
+			Feed();
+		}
+
+		auto song = std::make_unique<DetachedSong>(std::move(state.songs.front()));
+		state.songs.pop_front();
+		return song;
+	}
+
+private:
+	/**
+	 * Pass the next chunk of the input stream to the parser.
+	 *
+	 * Throws on error.
+	 */
+	void Feed() {
+		char buffer[4096];
+		size_t nbytes = is->LockRead(buffer, sizeof(buffer));
+		if (nbytes == 0) {
+			finished = true;
+			expat.CompleteParse();
+			is.reset();
+			return;
+		}
+
+		expat.Parse(buffer, nbytes);
+	}
+};
+
+#endif
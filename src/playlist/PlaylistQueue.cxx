@@ -33,6 +33,7 @@
 #endif
 
 #include <memory>
+#include <vector>
 
 void
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
@@ -44,21 +45,34 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
+	std::vector<DetachedSong> songs;
+	std::vector<bool> valid;
+
+	/* skip songs before the start index */
+	unsigned i = 0;
+	for (; i < start_index && i < end_index; ++i)
+		if (e.NextSong() == nullptr)
+			return;
+
 	std::unique_ptr<DetachedSong> song;
-	for (unsigned i = 0;
-	     i < end_index && (song = e.NextSong()) != nullptr;
-	     ++i) {
-		if (i < start_index) {
-			/* skip songs before the start index */
-			continue;
-		}
+	while (i < end_index) {
+		/* translate the songs in batches, to look them up in
+		   the database all at once */
+		songs.clear();
+		for (; i < end_index &&
+			     songs.size() < PLAYLIST_TRANSLATE_BATCH &&
+			     (song = e.NextSong()) != nullptr; ++i)
+			songs.emplace_back(std::move(*song));
+
+		if (songs.empty())
+			break;
 
-		if (!playlist_check_translate_song(*song, base_uri.c_str(),
-						   loader)) {
-			continue;
-		}
+		playlist_check_translate_songs(songs, valid,
+					       base_uri.c_str(), loader);
 
-		dest.AppendSong(pc, std::move(*song));
+		for (std::size_t j = 0; j < songs.size(); ++j)
+			if (valid[j])
+				dest.AppendSong(pc, std::move(songs[j]));
 	}
 }
 
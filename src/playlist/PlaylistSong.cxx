@@ -25,6 +25,8 @@
 #include "util/UriUtil.hxx"
 #include "song/DetachedSong.hxx"
 
+#include <memory>
+
 #include <string.h>
 
 static void
@@ -39,24 +41,35 @@ merge_song_metadata(DetachedSong &add, const DetachedSong &base) noexcept
 	add.SetLastModified(base.GetLastModified());
 }
 
-static bool
-playlist_check_load_song(DetachedSong &song, const SongLoader &loader) noexcept
-try {
-	DetachedSong tmp = loader.LoadSong(song.GetURI());
-
+/**
+ * Apply the database information (or the information loaded from the
+ * file) to the song from the playlist.
+ */
+static void
+playlist_merge_loaded_song(DetachedSong &song, const DetachedSong &tmp) noexcept
+{
 	song.SetURI(tmp.GetURI());
 	if (!song.HasRealURI() && tmp.HasRealURI())
 		song.SetRealURI(tmp.GetRealURI());
 
 	merge_song_metadata(song, tmp);
+}
+
+static bool
+playlist_check_load_song(DetachedSong &song, const SongLoader &loader) noexcept
+try {
+	DetachedSong tmp = loader.LoadSong(song.GetURI());
+	playlist_merge_loaded_song(song, tmp);
 	return true;
 } catch (...) {
 	return false;
 }
 
-bool
-playlist_check_translate_song(DetachedSong &song, const char *base_uri,
-			      const SongLoader &loader) noexcept
+/**
+ * Make the song's URI absolute with the given base URI.
+ */
+static void
+playlist_apply_base_uri(DetachedSong &song, const char *base_uri) noexcept
 {
 	if (base_uri != nullptr && strcmp(base_uri, ".") == 0)
 		/* PathTraitsUTF8::GetParent() returns "." when there
@@ -69,6 +82,44 @@ playlist_check_translate_song(DetachedSong &song, const char *base_uri,
 	if (base_uri != nullptr && !uri_has_scheme(uri) &&
 	    !PathTraitsUTF8::IsAbsolute(uri))
 		song.SetURI(PathTraitsUTF8::Build(base_uri, uri));
+}
 
+bool
+playlist_check_translate_song(DetachedSong &song, const char *base_uri,
+			      const SongLoader &loader) noexcept
+{
+	playlist_apply_base_uri(song, base_uri);
 	return playlist_check_load_song(song, loader);
 }
+
+void
+playlist_check_translate_songs(std::vector<DetachedSong> &songs,
+			       std::vector<bool> &valid_r,
+			       const char *base_uri,
+			       const SongLoader &loader)
+{
+	std::vector<const char *> uris;
+	uris.reserve(songs.size());
+
+	for (auto &song : songs) {
+		playlist_apply_base_uri(song, base_uri);
+		uris.push_back(song.GetURI());
+	}
+
+	/* the songs must not be modified while the loader still
+	   holds pointers to their URIs, so collect the results
+	   first */
+	std::vector<std::unique_ptr<DetachedSong>> loaded(songs.size());
+	loader.LoadSongs({uris.data(), uris.size()},
+			 [&loaded](std::size_t i, DetachedSong &&tmp){
+				 loaded[i] = std::make_unique<DetachedSong>(std::move(tmp));
+			 });
+
+	valid_r.assign(songs.size(), false);
+	for (std::size_t i = 0; i < songs.size(); ++i) {
+		if (loaded[i]) {
+			playlist_merge_loaded_song(songs[i], *loaded[i]);
+			valid_r[i] = true;
+		}
+	}
+}
@@ -20,9 +20,17 @@
 #ifndef MPD_PLAYLIST_SONG_HXX
 #define MPD_PLAYLIST_SONG_HXX
 
+#include <vector>
+
 class SongLoader;
 class DetachedSong;
 
+/**
+ * How many songs are collected from a #SongEnumerator for one
+ * playlist_check_translate_songs() call.
+ */
+static constexpr unsigned PLAYLIST_TRANSLATE_BATCH = 1024;
+
 /**
  * Verifies the song, returns false if it is unsafe.  Translate the
  * song to a song within the database, if it is a local file.
@@ -33,4 +41,18 @@ bool
 playlist_check_translate_song(DetachedSong &song, const char *base_uri,
 			      const SongLoader &loader) noexcept;
 
+/**
+ * Like playlist_check_translate_song(), but translate many songs at
+ * once, looking up all database songs in one batch (see
+ * SongLoader::LoadSongs()).
+ *
+ * @param valid_r receives the playlist_check_translate_song() return
+ * value for each song
+ */
+void
+playlist_check_translate_songs(std::vector<DetachedSong> &songs,
+			       std::vector<bool> &valid_r,
+			       const char *base_uri,
+			       const SongLoader &loader);
+
 #endif
@@ -39,16 +39,33 @@ playlist_provider_print(Response &r,
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
-	std::unique_ptr<DetachedSong> song;
-	while ((song = e.NextSong()) != nullptr) {
-		if (playlist_check_translate_song(*song, base_uri.c_str(),
-						  loader) &&
-		    detail)
-			song_print_info(r, *song);
-		else
-			/* fallback if no detail was requested or no
-			   detail was available */
-			song_print_uri(r, *song);
+	std::vector<DetachedSong> songs;
+	std::vector<bool> valid;
+
+	while (true) {
+		/* translate the songs in batches, to look them up in
+		   the database all at once */
+		songs.clear();
+
+		std::unique_ptr<DetachedSong> song;
+		while (songs.size() < PLAYLIST_TRANSLATE_BATCH &&
+		       (song = e.NextSong()) != nullptr)
+			songs.emplace_back(std::move(*song));
+
+		if (songs.empty())
+			break;
+
+		playlist_check_translate_songs(songs, valid,
+					       base_uri.c_str(), loader);
+
+		for (std::size_t i = 0; i < songs.size(); ++i) {
+			if (valid[i] && detail)
+				song_print_info(r, songs[i]);
+			else
+				/* fallback if no detail was requested
+				   or no detail was available */
+				song_print_uri(r, songs[i]);
+		}
 	}
 }
 
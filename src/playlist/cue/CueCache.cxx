@@ -0,0 +1,80 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "CueCache.hxx"
+
+#include <algorithm>
+
+CueCache cue_cache;
+
+std::shared_ptr<const CueCache::TrackList>
+CueCache::Get(const char *uri, const char *version, uint64_t size) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(uri);
+	if (i == map.end())
+		return nullptr;
+
+	if (i->second.version != version || i->second.size != size) {
+		/* modified since it was parsed */
+		map.erase(i);
+		return nullptr;
+	}
+
+	i->second.last_used = ++counter;
+	return i->second.tracks;
+}
+
+void
+CueCache::Put(const char *uri, const char *version, uint64_t size,
+	      std::shared_ptr<const TrackList> tracks) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto &item = map[uri];
+	item.version = version;
+	item.size = size;
+	item.tracks = std::move(tracks);
+	item.last_used = ++counter;
+
+	if (map.size() > MAX_ITEMS)
+		Evict();
+}
+
+void
+CueCache::Evict() noexcept
+{
+	auto i = std::min_element(map.begin(), map.end(),
+				  [](const decltype(map)::value_type &a,
+				     const decltype(map)::value_type &b){
+					  return a.second.last_used < b.second.last_used;
+				  });
+	map.erase(i);
+}
+
+std::unique_ptr<DetachedSong>
+CueTrackEnumerator::NextSong()
+{
+	if (next >= tracks->size())
+		return nullptr;
+
+	return std::make_unique<DetachedSong>((*tracks)[next++]);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CUE_CACHE_HXX
+#define MPD_CUE_CACHE_HXX
+
+#include "playlist/SongEnumerator.hxx"
+#include "song/DetachedSong.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * An in-memory cache of parsed CUE sheets (stand-alone ".cue" files
+ * and embedded "CUESHEET" tags), shared by the database update,
+ * "lsinfo" and playback, so looking up one track of a CUE sheet
+ * does not need to parse the whole sheet again.
+ *
+ * An entry is identified by the URI of the file, and is only valid
+ * as long as the file's version (e.g. the modification time) and
+ * size match.
+ *
+ * All methods are thread-safe.
+ */
+class CueCache {
+public:
+	/**
+	 * The tracks generated by the #CueParser, in order.  An
+	 * empty list means the file has no CUE sheet.
+	 */
+	typedef std::vector<DetachedSong> TrackList;
+
+private:
+	/**
+	 * The maximum number of files in the cache.  When it is
+	 * exceeded, the least recently used entry is discarded.
+	 */
+	static constexpr size_t MAX_ITEMS = 256;
+
+	struct Item {
+		std::string version;
+
+		uint64_t size;
+
+		std::shared_ptr<const TrackList> tracks;
+
+		/**
+		 * The value of #counter when this item was last used.
+		 */
+		unsigned long last_used;
+	};
+
+	Mutex mutex;
+
+	std::unordered_map<std::string, Item> map;
+
+	unsigned long counter = 0;
+
+public:
+	CueCache() = default;
+
+	CueCache(const CueCache &) = delete;
+	CueCache &operator=(const CueCache &) = delete;
+
+	/**
+	 * Look up the tracks of a file.
+	 *
+	 * @return the tracks or nullptr if the file is not in the
+	 * cache (or has been modified)
+	 */
+	std::shared_ptr<const TrackList> Get(const char *uri,
+					     const char *version,
+					     uint64_t size) noexcept;
+
+	/**
+	 * Add the tracks of a file to the cache.
+	 */
+	void Put(const char *uri, const char *version, uint64_t size,
+		 std::shared_ptr<const TrackList> tracks) noexcept;
+
+private:
+	void Evict() noexcept;
+};
+
+/**
+ * The global #CueCache instance.
+ */
+extern CueCache cue_cache;
+
+/**
+ * Enumerates the tracks of a (cached) #CueCache::TrackList.
+ */
+class CueTrackEnumerator final : public SongEnumerator {
+	const std::shared_ptr<const CueCache::TrackList> tracks;
+
+	size_t next = 0;
+
+public:
+	explicit CueTrackEnumerator(std::shared_ptr<const CueCache::TrackList> _tracks) noexcept
+		:tracks(std::move(_tracks)) {}
+
+	std::unique_ptr<DetachedSong> NextSong() override;
+};
+
+#endif
@@ -21,7 +21,12 @@
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "input/TextInputStream.hxx"
+#include "input/InputStream.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <string>
 
 class CuePlaylist final : public SongEnumerator {
 	TextInputStream tis;
@@ -38,7 +43,28 @@ class CuePlaylist final : public SongEnumerator {
 static std::unique_ptr<SongEnumerator>
 cue_playlist_open_stream(InputStreamPtr &&is)
 {
-	return std::make_unique<CuePlaylist>(std::move(is));
+	if (!is->HasVersion() || !is->KnownSize())
+		/* can't tell whether a cached copy is still valid */
+		return std::make_unique<CuePlaylist>(std::move(is));
+
+	const std::string uri = is->GetURI();
+	const std::string version = is->GetVersion();
+	const auto size = is->GetSize();
+
+	auto tracks = cue_cache.Get(uri.c_str(), version.c_str(), size);
+	if (tracks == nullptr) {
+		/* parse the whole sheet and remember it */
+		CuePlaylist playlist(std::move(is));
+
+		auto list = std::make_shared<CueCache::TrackList>();
+		while (auto song = playlist.NextSong())
+			list->emplace_back(std::move(*song));
+
+		cue_cache.Put(uri.c_str(), version.c_str(), size, list);
+		tracks = std::move(list);
+	}
+
+	return std::make_unique<CueTrackEnumerator>(std::move(tracks));
 }
 
 std::unique_ptr<DetachedSong>
@@ -27,48 +27,18 @@
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Generic.hxx"
 #include "song/DetachedSong.hxx"
 #include "TagFile.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
-#include "util/ASCII.hxx"
+#include "fs/FileInfo.hxx"
 
-#include <string.h>
-
-class EmbeddedCuePlaylist final : public SongEnumerator {
-public:
-	/**
-	 * This is an override for the CUE's "FILE".  An embedded CUE
-	 * sheet must always point to the song file it is contained
-	 * in.
-	 */
-	std::string filename;
-
-	/**
-	 * The value of the file's "CUESHEET" tag.
-	 */
-	std::string cuesheet;
-
-	/**
-	 * The offset of the next line within "cuesheet".
-	 */
-	char *next;
-
-	CueParser *parser;
-
-public:
-	EmbeddedCuePlaylist()
-		:parser(nullptr) {
-	}
-
-	virtual ~EmbeddedCuePlaylist() {
-		delete parser;
-	}
+#include <string>
 
-	virtual std::unique_ptr<DetachedSong> NextSong() override;
-};
+#include <string.h>
 
 class ExtractCuesheetTagHandler final : public NullTagHandler {
 public:
@@ -76,57 +46,37 @@ public:
 
 	ExtractCuesheetTagHandler() noexcept:NullTagHandler(WANT_PAIR) {}
 
-	void OnPair(const char *key, const char *value) noexcept override;
+	void OnPair(StringView key, StringView value) noexcept override;
 };
 
 void
-ExtractCuesheetTagHandler::OnPair(const char *name, const char *value) noexcept
+ExtractCuesheetTagHandler::OnPair(StringView name, StringView value) noexcept
 {
-	if (cuesheet.empty() &&
-	    StringEqualsCaseASCII(name, "cuesheet"))
-		cuesheet = value;
+	if (cuesheet.empty() && name.EqualsIgnoreCase("cuesheet"))
+		cuesheet.assign(value.data, value.size);
 }
 
-static std::unique_ptr<SongEnumerator>
-embcue_playlist_open_uri(const char *uri,
-			 gcc_unused Mutex &mutex)
+/**
+ * Parse the value of a "CUESHEET" tag.
+ *
+ * @param filename an override for the CUE's "FILE"; an embedded CUE
+ * sheet must always point to the song file it is contained in
+ */
+static CueCache::TrackList
+ParseEmbeddedCue(std::string &cuesheet, const char *filename)
 {
-	if (!PathTraitsUTF8::IsAbsolute(uri))
-		/* only local files supported */
-		return nullptr;
-
-	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
-
-	ExtractCuesheetTagHandler extract_cuesheet;
-	ScanFileTagsNoGeneric(path_fs, extract_cuesheet);
-	if (extract_cuesheet.cuesheet.empty())
-		ScanGenericTags(path_fs, extract_cuesheet);
-
-	if (extract_cuesheet.cuesheet.empty())
-		/* no "CUESHEET" tag found */
-		return nullptr;
-
-	auto playlist = std::make_unique<EmbeddedCuePlaylist>();
+	CueCache::TrackList tracks;
+	CueParser parser;
 
-	playlist->filename = PathTraitsUTF8::GetBase(uri);
-
-	playlist->cuesheet = std::move(extract_cuesheet.cuesheet);
-
-	playlist->next = &playlist->cuesheet[0];
-	playlist->parser = new CueParser();
-
-	return playlist;
-}
-
-std::unique_ptr<DetachedSong>
-EmbeddedCuePlaylist::NextSong()
-{
-	auto song = parser->Get();
-	if (song != nullptr) {
-		song->SetURI(filename);
-		return song;
-	}
+	auto flush = [&](){
+		std::unique_ptr<DetachedSong> song;
+		while ((song = parser.Get()) != nullptr) {
+			song->SetURI(filename);
+			tracks.emplace_back(std::move(*song));
+		}
+	};
 
+	char *next = &cuesheet[0];
 	while (*next != 0) {
 		const char *line = next;
 		char *eol = strpbrk(next, "\r\n");
@@ -139,19 +89,60 @@ EmbeddedCuePlaylist::NextSong()
 			   end of the buffer */
 			next += strlen(line);
 
-		parser->Feed(line);
-		song = parser->Get();
-		if (song != nullptr) {
-			song->SetURI(filename);
-			return song;
-		}
+		parser.Feed(line);
+		flush();
+	}
+
+	parser.Finish();
+	flush();
+	return tracks;
+}
+
+static std::unique_ptr<SongEnumerator>
+embcue_playlist_open_uri(const char *uri,
+			 gcc_unused Mutex &mutex)
+{
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		/* only local files supported */
+		return nullptr;
+
+	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
+
+	/* the file's modification time validates the cached copy;
+	   a hit saves opening the song file */
+	FileInfo info;
+	const bool cacheable = GetFileInfo(path_fs, info);
+	const std::string version = cacheable
+		? std::to_string(std::chrono::system_clock::to_time_t(info.GetModificationTime()))
+		: std::string();
+
+	auto tracks = cacheable
+		? cue_cache.Get(uri, version.c_str(), info.GetSize())
+		: nullptr;
+	if (tracks == nullptr) {
+		ExtractCuesheetTagHandler extract_cuesheet;
+		ScanFileTagsNoGeneric(path_fs, extract_cuesheet);
+		if (extract_cuesheet.cuesheet.empty())
+			ScanGenericTags(path_fs, extract_cuesheet);
+
+		/* an empty list (no "CUESHEET" tag) is cached, too */
+		auto list = extract_cuesheet.cuesheet.empty()
+			? std::make_shared<CueCache::TrackList>()
+			: std::make_shared<CueCache::TrackList>(ParseEmbeddedCue(extract_cuesheet.cuesheet,
+										 PathTraitsUTF8::GetBase(uri)));
+
+		if (cacheable)
+			cue_cache.Put(uri, version.c_str(), info.GetSize(),
+				      list);
+
+		tracks = std::move(list);
 	}
 
-	parser->Finish();
-	song = parser->Get();
-	if (song != nullptr)
-		song->SetURI(filename);
-	return song;
+	if (tracks->empty())
+		/* no "CUESHEET" tag found */
+		return nullptr;
+
+	return std::make_unique<CueTrackEnumerator>(std::move(tracks));
 }
 
 static const char *const embcue_playlist_suffixes[] = {
@@ -19,7 +19,7 @@
 
 #include "XspfPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "song/DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Builder.hxx"
@@ -27,6 +27,8 @@
 #include "lib/expat/ExpatParser.hxx"
 #include "Log.hxx"
 
+#include <list>
+
 #include <string.h>
 
 /**
@@ -34,10 +36,10 @@
  */
 struct XspfParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * Songs which have been parsed, but not yet consumed by the
+	 * #ExpatSongEnumerator.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> songs;
 
 	/**
 	 * The current position in the XML file.
@@ -140,8 +142,8 @@ xspf_end_element(void *user_data, const XML_Char *element_name)
 	case XspfParser::TRACK:
 		if (strcmp(element_name, "track") == 0) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->songs.emplace_back(std::move(parser->location),
+							   parser->tag_builder.Commit());
 
 			parser->state = XspfParser::TRACKLIST;
 		} else
@@ -189,17 +191,10 @@ xspf_char_data(void *user_data, const XML_Char *s, int len)
 static std::unique_ptr<SongEnumerator>
 xspf_open_stream(InputStreamPtr &&is)
 {
-	XspfParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(xspf_start_element, xspf_end_element);
-		expat.SetCharacterDataHandler(xspf_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<ExpatSongEnumerator<XspfParser>>(std::move(is),
+								xspf_start_element,
+								xspf_end_element,
+								xspf_char_data);
 }
 
 static const char *const xspf_suffixes[] = {
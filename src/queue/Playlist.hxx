@@ -67,6 +67,13 @@ struct playlist {
 	 */
 	bool bulk_modified;
 
+	/**
+	 * The number of songs appended in random mode during bulk
+	 * edit mode.  Shuffling them into the remaining songs is
+	 * postponed until CommitBulk().
+	 */
+	unsigned bulk_shuffle;
+
 	/**
 	 * Number of errors since playback was started.  If this
 	 * number exceeds the length of the playlist, MPD gives up,
@@ -96,7 +103,7 @@ struct playlist {
 		:queue(max_length),
 		 listener(_listener),
 		 playing(false),
-		 bulk_edit(false),
+		 bulk_edit(false), bulk_shuffle(0),
 		 current(-1), queued(-1) {
 	}
 
@@ -176,6 +183,27 @@ protected:
 	 */
 	void QueueSongOrder(PlayerControl &pc, unsigned order);
 
+	/**
+	 * The first order number which may be reordered in random
+	 * mode, i.e. the one after the queued (or current) song.
+	 */
+	gcc_pure
+	unsigned GetShuffleStart() const noexcept {
+		return queued >= 0
+			? unsigned(queued + 1)
+			: unsigned(current + 1);
+	}
+
+	/**
+	 * Shuffle the last (newest) songs of the order list into the
+	 * songs after GetShuffleStart(), one by one, like
+	 * AppendSong() does outside of bulk edit mode (random mode
+	 * only).  The order of the other songs is not reshuffled.
+	 *
+	 * @param n the number of new songs
+	 */
+	void ShuffleAppended(unsigned n) noexcept;
+
 	/**
 	 * Called when the player thread has started playing the
 	 * "queued" song, i.e. it has switched from one song to the
@@ -269,7 +269,7 @@ playlist::SeekCurrent(PlayerControl &pc,
 		throw PlaylistError::NotPlaying();
 
 	if (relative) {
-		const auto status = pc.LockGetStatus();
+		const auto status = pc.GetStatus();
 
 		if (status.state != PlayerState::PLAY &&
 		    status.state != PlayerState::PAUSE)
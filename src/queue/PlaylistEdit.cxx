@@ -66,6 +66,7 @@ playlist::BeginBulk()
 
 	bulk_edit = true;
 	bulk_modified = false;
+	bulk_shuffle = 0;
 }
 
 void
@@ -77,6 +78,12 @@ playlist::CommitBulk(PlayerControl &pc)
 	if (!bulk_modified)
 		return;
 
+	if (bulk_shuffle > 0 && queue.random)
+		/* shuffle the new songs into the list of remaining
+		   songs to play; this is equivalent to shuffling each
+		   of them in AppendSong() */
+		ShuffleAppended(bulk_shuffle);
+
 	if (queued < 0)
 		/* if no song was queued, UpdateQueuedSong() is being
 		   ignored in "bulk" edit mode; now that we have
@@ -88,6 +95,21 @@ playlist::CommitBulk(PlayerControl &pc)
 	OnModified();
 }
 
+void
+playlist::ShuffleAppended(unsigned n) noexcept
+{
+	const unsigned length = queue.GetLength();
+
+	/* songs may have been deleted after they were appended */
+	if (n > length)
+		n = length;
+
+	const unsigned start = GetShuffleStart();
+	for (unsigned end = length - n + 1; end <= length; ++end)
+		if (start < end)
+			queue.ShuffleOrderLastWithPriority(start, end);
+}
+
 unsigned
 playlist::AppendSong(PlayerControl &pc, DetachedSong &&song)
 {
@@ -102,16 +124,18 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song)
 	id = queue.Append(std::move(song), 0);
 
 	if (queue.random) {
-		/* shuffle the new song into the list of remaining
-		   songs to play */
-
-		unsigned start;
-		if (queued >= 0)
-			start = queued + 1;
-		else
-			start = current + 1;
-		if (start < queue.GetLength())
-			queue.ShuffleOrderLastWithPriority(start, queue.GetLength());
+		if (bulk_edit)
+			/* postponed until CommitBulk() */
+			++bulk_shuffle;
+		else {
+			/* shuffle the new song into the list of
+			   remaining songs to play */
+
+			const unsigned start = GetShuffleStart();
+			if (start < queue.GetLength())
+				queue.ShuffleOrderLastWithPriority(start,
+								   queue.GetLength());
+		}
 	}
 
 	UpdateQueuedSong(pc, queued_song);
@@ -285,11 +309,78 @@ playlist::DeleteRange(PlayerControl &pc, unsigned start, unsigned end)
 	if (start >= end)
 		return;
 
+	if (end - start == 1) {
+		DeletePosition(pc, start);
+		return;
+	}
+
 	const DetachedSong *queued_song = GetQueuedSong();
 
-	do {
-		DeleteInternal(pc, --end, &queued_song);
-	} while (end != start);
+	/* find the song which will be "current" after the range has
+	   been removed; its position is remembered because the order
+	   numbers are renumbered by Queue::DeleteRange() */
+
+	int next_position = -1;
+	bool play_next = false;
+
+	if (current >= 0) {
+		const unsigned current_position =
+			queue.OrderToPosition(current);
+
+		if (current_position < start || current_position >= end) {
+			next_position = current_position;
+		} else if (playing) {
+			/* the current song is going to be deleted: see
+			   which song is going to be played instead */
+
+			const bool paused = pc.GetState() == PlayerState::PAUSE;
+
+			int next_order = current;
+			for (unsigned i = start; i < end; ++i) {
+				next_order = queue.GetNextOrder(next_order);
+				if (next_order < 0)
+					break;
+
+				const unsigned p = queue.OrderToPosition(next_order);
+				if (p < start || p >= end) {
+					next_position = p;
+					break;
+				}
+			}
+
+			if (next_position >= 0 && !paused)
+				play_next = true;
+			else {
+				/* stop the player */
+
+				pc.LockStop();
+				playing = false;
+			}
+
+			queued_song = nullptr;
+		}
+	}
+
+	/* now do it: remove the songs */
+
+	queue.DeleteRange(start, end);
+
+	/* update the "current" and "queued" variables */
+
+	if (next_position >= (int)end)
+		next_position -= end - start;
+
+	current = next_position >= 0
+		? (int)queue.PositionToOrder(next_position)
+		: -1;
+
+	if (play_next)
+		/* play the song after the deleted ones */
+		try {
+			PlayOrder(pc, current);
+		} catch (...) {
+			/* TODO: log error? */
+		}
 
 	UpdateQueuedSong(pc, queued_song);
 	OnModified();
@@ -316,9 +407,10 @@ playlist::StaleSong(PlayerControl &pc, const char *uri)
 		? GetCurrentPosition()
 		: -1;
 
-	for (int i = queue.GetLength() - 1; i >= 0; --i)
-		if (i != current_position && queue.Get(i).IsURI(uri))
-			DeletePosition(pc, i);
+	const auto positions = queue.FindURI(uri);
+	for (auto i = positions.rbegin(); i != positions.rend(); ++i)
+		if (int(*i) != current_position)
+			DeletePosition(pc, *i);
 }
 
 void
@@ -28,6 +28,9 @@
 #include "SingleMode.hxx"
 #include "StateFileConfig.hxx"
 #include "queue/QueueSave.hxx"
+#include "queue/Listener.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "song/DetachedSong.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "player/Control.hxx"
@@ -37,6 +40,7 @@
 #include "util/NumberParser.hxx"
 #include "Log.hxx"
 
+#include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -61,7 +65,7 @@ void
 playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 		    PlayerControl &pc)
 {
-	const auto player_status = pc.LockGetStatus();
+	const auto player_status = pc.GetStatus();
 
 	os.Write(PLAYLIST_STATE_FILE_STATE);
 
@@ -100,9 +104,11 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
 }
 
+PlaylistStateRestore::PlaylistStateRestore() noexcept = default;
+PlaylistStateRestore::~PlaylistStateRestore() noexcept = default;
+
 static void
-playlist_state_load(TextFile &file, const SongLoader &song_loader,
-		    struct playlist &playlist)
+playlist_state_read_queue(TextFile &file, PlaylistStateRestore &restore)
 {
 	const char *line = file.ReadLine();
 	if (line == nullptr) {
@@ -111,7 +117,10 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 	}
 
 	while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
-		queue_load_song(file, song_loader, line, playlist.queue);
+		uint8_t priority;
+		auto song = queue_read_song(file, line, priority);
+		if (song)
+			restore.entries.push_back({std::move(song), priority});
 
 		line = file.ReadLine();
 		if (line == nullptr) {
@@ -121,36 +130,28 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 			break;
 		}
 	}
-
-	playlist.queue.IncrementVersion();
 }
 
 bool
-playlist_state_restore(const StateFileConfig &config,
-		       const char *line, TextFile &file,
-		       const SongLoader &song_loader,
-		       struct playlist &playlist, PlayerControl &pc)
+playlist_state_read(const char *line, TextFile &file,
+		    struct playlist &playlist, PlayerControl &pc,
+		    PlaylistStateRestore &restore)
 {
-	int current = -1;
-	SongTime seek_time = SongTime::zero();
-	bool random_mode = false;
-
 	line = StringAfterPrefix(line, PLAYLIST_STATE_FILE_STATE);
 	if (line == nullptr)
 		return false;
 
-	PlayerState state;
 	if (strcmp(line, PLAYLIST_STATE_FILE_STATE_PLAY) == 0)
-		state = PlayerState::PLAY;
+		restore.state = PlayerState::PLAY;
 	else if (strcmp(line, PLAYLIST_STATE_FILE_STATE_PAUSE) == 0)
-		state = PlayerState::PAUSE;
+		restore.state = PlayerState::PAUSE;
 	else
-		state = PlayerState::STOP;
+		restore.state = PlayerState::STOP;
 
 	while ((line = file.ReadLine()) != nullptr) {
 		const char *p;
 		if ((p = StringAfterPrefix(line, PLAYLIST_STATE_FILE_TIME))) {
-			seek_time = SongTime::FromS(ParseDouble(p));
+			restore.seek_time = SongTime::FromS(ParseDouble(p));
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_STATE_FILE_REPEAT))) {
 			playlist.SetRepeat(pc, StringIsEqual(p, "1"));
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_STATE_FILE_SINGLE))) {
@@ -167,16 +168,78 @@ playlist_state_restore(const StateFileConfig &config,
 			if (IsDigitASCII(*p))
 				pc.SetMixRampDelay(FloatDuration(ParseFloat(p)));
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_STATE_FILE_RANDOM))) {
-			random_mode = StringIsEqual(p, "1");
+			restore.random_mode = StringIsEqual(p, "1");
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_STATE_FILE_CURRENT))) {
-			current = atoi(p);
+			restore.current = atoi(p);
 		} else if (StringStartsWith(line,
 					    PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) {
-			playlist_state_load(file, song_loader, playlist);
+			playlist_state_read_queue(file, restore);
 		}
 	}
 
-	playlist.SetRandom(pc, random_mode);
+	restore.version = playlist.queue.version;
+	return true;
+}
+
+bool
+playlist_state_load_some(PlaylistStateRestore &restore,
+			 const SongLoader &song_loader,
+			 struct playlist &playlist, unsigned max)
+{
+	if (restore.IsDone())
+		return true;
+
+	if (playlist.queue.version != restore.version) {
+		/* a client has edited the queue meanwhile; its
+		   edits win over the (now stale) saved queue */
+		LogWarning(playlist_domain,
+			   "Queue was modified during startup, not restoring the rest");
+		restore.aborted = true;
+		restore.entries.clear();
+		return true;
+	}
+
+	auto &queue = playlist.queue;
+	const size_t old_length = queue.GetLength();
+
+	for (; max > 0 && restore.next < restore.entries.size(); --max) {
+		auto &entry = restore.entries[restore.next++];
+		if (queue.IsFull())
+			continue;
+
+		auto song = std::move(entry.song);
+		if (playlist_check_translate_song(*song, nullptr, song_loader))
+			queue.Append(std::move(*song), entry.priority);
+	}
+
+	if (queue.GetLength() != old_length) {
+		queue.IncrementVersion();
+		playlist.listener.OnQueueModified();
+	}
+
+	restore.version = queue.version;
+
+	if (restore.next < restore.entries.size())
+		return false;
+
+	restore.entries.clear();
+	return true;
+}
+
+void
+playlist_state_finish(const StateFileConfig &config,
+		      PlaylistStateRestore &restore,
+		      struct playlist &playlist, PlayerControl &pc)
+{
+	assert(restore.IsDone());
+
+	if (restore.aborted)
+		return;
+
+	int current = restore.current;
+	PlayerState state = restore.state;
+
+	playlist.SetRandom(pc, restore.random_mode);
 
 	if (!playlist.queue.IsEmpty()) {
 		if (!playlist.queue.IsValidPosition(current))
@@ -196,7 +259,7 @@ playlist_state_restore(const StateFileConfig &config,
 
 		if (state == PlayerState::STOP /* && config_option */)
 			playlist.current = current;
-		else if (seek_time.count() == 0) {
+		else if (restore.seek_time.count() == 0) {
 			try {
 				playlist.PlayPosition(pc, current);
 			} catch (...) {
@@ -205,7 +268,7 @@ playlist_state_restore(const StateFileConfig &config,
 		} else {
 			try {
 				playlist.SeekSongPosition(pc, current,
-							  seek_time);
+							  restore.seek_time);
 			} catch (...) {
 				/* TODO: log error? */
 			}
@@ -214,15 +277,13 @@ playlist_state_restore(const StateFileConfig &config,
 		if (state == PlayerState::PAUSE)
 			pc.LockPause();
 	}
-
-	return true;
 }
 
 unsigned
 playlist_state_get_hash(const playlist &playlist,
 			PlayerControl &pc)
 {
-	const auto player_status = pc.LockGetStatus();
+	const auto player_status = pc.GetStatus();
 
 	return playlist.queue.version ^
 		(player_status.state != PlayerState::STOP
@@ -25,9 +25,18 @@
 #ifndef MPD_PLAYLIST_STATE_HXX
 #define MPD_PLAYLIST_STATE_HXX
 
+#include "Chrono.hxx"
+
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
 struct StateFileConfig;
 struct playlist;
 class PlayerControl;
+class DetachedSong;
+enum class PlayerState : uint8_t;
 class TextFile;
 class BufferedOutputStream;
 class SongLoader;
@@ -36,11 +45,86 @@ void
 playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
 		    PlayerControl &pc);
 
+/**
+ * The queue and playback state parsed from the state file.  The
+ * queue can be resolved with the database incrementally with
+ * playlist_state_load_some() (so a huge queue does not delay MPD's
+ * startup), and the playback state is applied by
+ * playlist_state_finish() after that.
+ */
+struct PlaylistStateRestore {
+	struct Entry {
+		std::unique_ptr<DetachedSong> song;
+		uint8_t priority;
+	};
+
+	std::vector<Entry> entries;
+
+	/**
+	 * The index of the next entry to be loaded.
+	 */
+	std::size_t next = 0;
+
+	/**
+	 * The queue version after the last
+	 * playlist_state_load_some() call.  If it differs, then a
+	 * client has edited the queue meanwhile.
+	 */
+	uint32_t version = 0;
+
+	SongTime seek_time = SongTime::zero();
+
+	int current = -1;
+
+	PlayerState state{};
+
+	bool random_mode = false;
+
+	/**
+	 * Was restoring aborted because a client has edited the
+	 * queue?
+	 */
+	bool aborted = false;
+
+	PlaylistStateRestore() noexcept;
+	~PlaylistStateRestore() noexcept;
+
+	bool IsDone() const noexcept {
+		return aborted || next >= entries.size();
+	}
+};
+
+/**
+ * Parse the playlist section of the state file.  The playback
+ * options are applied immediately, but the queue is only collected
+ * in #restore.
+ *
+ * @return false if the line is not the beginning of the playlist
+ * section
+ */
+bool
+playlist_state_read(const char *line, TextFile &file,
+		    playlist &playlist, PlayerControl &pc,
+		    PlaylistStateRestore &restore);
+
+/**
+ * Resolve up to #max queue entries and append them to the queue.
+ *
+ * @return true if the queue has been restored completely (or if
+ * restoring was aborted)
+ */
 bool
-playlist_state_restore(const StateFileConfig &config,
-		       const char *line, TextFile &file,
-		       const SongLoader &song_loader,
-		       playlist &playlist, PlayerControl &pc);
+playlist_state_load_some(PlaylistStateRestore &restore,
+			 const SongLoader &song_loader,
+			 playlist &playlist, unsigned max);
+
+/**
+ * Apply the playback state after the queue has been restored.
+ */
+void
+playlist_state_finish(const StateFileConfig &config,
+		      PlaylistStateRestore &restore,
+		      playlist &playlist, PlayerControl &pc);
 
 /**
  * Generates a hash number for the current state of the playlist and
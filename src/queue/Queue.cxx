@@ -24,16 +24,64 @@ Queue::Queue(unsigned _max_length) noexcept
 	:max_length(_max_length),
 	 items(new Item[max_length]),
 	 order(new unsigned[max_length]),
+	 position_order(new unsigned[max_length]),
 	 id_table(max_length * HASH_MULT)
 {
 }
 
+size_t
+Queue::GetMemoryUsage() const noexcept
+{
+	size_t result = size_t(max_length) *
+		(sizeof(*items) + sizeof(*order) + sizeof(*position_order) +
+		 HASH_MULT * sizeof(int));
+
+	for (unsigned i = 0; i < length; ++i)
+		result += items[i].song->GetMemoryUsage();
+
+	/* the URI index: roughly one node per song plus the bucket
+	   array */
+	for (const auto &i : uri_index)
+		result += sizeof(i) + 2 * sizeof(void *) + i.first.capacity();
+	result += uri_index.bucket_count() * sizeof(void *);
+
+	return result;
+}
+
+std::vector<unsigned>
+Queue::FindURI(const std::string &uri) const noexcept
+{
+	std::vector<unsigned> result;
+
+	const auto r = uri_index.equal_range(uri);
+	for (auto i = r.first; i != r.second; ++i)
+		result.push_back(IdToPosition(i->second));
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+void
+Queue::EraseURI(const DetachedSong &song, unsigned id) noexcept
+{
+	const auto r = uri_index.equal_range(song.GetURI());
+	for (auto i = r.first; i != r.second; ++i) {
+		if (i->second == id) {
+			uri_index.erase(i);
+			return;
+		}
+	}
+
+	assert(false);
+}
+
 Queue::~Queue() noexcept
 {
 	Clear();
 
 	delete[] items;
 	delete[] order;
+	delete[] position_order;
 }
 
 int
@@ -65,6 +113,9 @@ Queue::IncrementVersion() noexcept
 			items[i].version = 0;
 
 		version = 1;
+
+		/* the journal can't describe items with version 0 */
+		journal.Disable();
 	}
 }
 
@@ -88,10 +139,11 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
 	item.id = id;
-	item.version = version;
+	uri_index.emplace(item.song->GetURI(), id);
 	item.priority = priority;
+	MarkModified(position);
 
-	order[position] = position;
+	order[position] = position_order[position] = position;
 
 	return id;
 }
@@ -104,8 +156,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	MarkModified(position1);
+	MarkModified(position2);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -130,7 +182,7 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 
 	id_table.Move(tmp.id, to);
 	items[to] = tmp;
-	items[to].version = version;
+	MarkModified(to);
 
 	/* now deal with order */
 
@@ -144,6 +196,8 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 			else if (from == order[i])
 				order[i] = to;
 		}
+
+		UpdatePositionOrder(0, length);
 	}
 }
 
@@ -170,7 +224,7 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 	{
 		id_table.Move(tmp[i - start].id, to + i - start);
 		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
+		MarkModified(to + i - start);
 	}
 
 	if (random) {
@@ -186,6 +240,8 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 			else if (start <= order[i] && order[i] < end)
 				order[i] += to - start;
 		}
+
+		UpdatePositionOrder(0, length);
 	}
 }
 
@@ -206,6 +262,12 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order) noexcept
 	}
 
 	order[to_order] = from_position;
+
+	if (from_order < to_order)
+		UpdatePositionOrder(from_order, to_order + 1);
+	else
+		UpdatePositionOrder(to_order, from_order + 1);
+
 	return to_order;
 }
 
@@ -232,9 +294,11 @@ Queue::DeletePosition(unsigned position) noexcept
 {
 	assert(position < length);
 
+	const unsigned id = PositionToId(position);
+
+	EraseURI(*items[position].song, id);
 	delete items[position].song;
 
-	const unsigned id = PositionToId(position);
 	const unsigned _order = PositionToOrder(position);
 
 	--length;
@@ -258,6 +322,48 @@ Queue::DeletePosition(unsigned position) noexcept
 	for (unsigned i = 0; i < length; i++)
 		if (order[i] > position)
 			--order[i];
+
+	UpdatePositionOrder(0, length);
+}
+
+void
+Queue::DeleteRange(unsigned start, unsigned end) noexcept
+{
+	assert(start <= end);
+	assert(end <= length);
+
+	const unsigned n = end - start;
+
+	/* release the songs and their ids */
+
+	for (unsigned i = start; i < end; i++) {
+		EraseURI(*items[i].song, items[i].id);
+		delete items[i].song;
+		id_table.Erase(items[i].id);
+	}
+
+	/* move the following songs */
+
+	for (unsigned i = end; i < length; i++)
+		MoveItemTo(i, i - n);
+
+	/* remove the entries from the order array and readjust the
+	   remaining ones */
+
+	unsigned dest = 0;
+	for (unsigned i = 0; i < length; i++) {
+		const unsigned position = order[i];
+		if (position < start)
+			order[dest++] = position;
+		else if (position >= end)
+			order[dest++] = position - n;
+	}
+
+	assert(dest == length - n);
+
+	length -= n;
+
+	UpdatePositionOrder(0, length);
 }
 
 void
@@ -271,7 +377,9 @@ Queue::Clear() noexcept
 		id_table.Erase(item->id);
 	}
 
+	uri_index.clear();
 	length = 0;
+	journal.Reset();
 }
 
 static void
@@ -302,6 +410,7 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 
 	rand.AutoCreate();
 	std::shuffle(order + start, order + end, rand);
+	UpdatePositionOrder(start, end);
 }
 
 /**
@@ -318,7 +427,8 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end) noexcept
 	if (start == end)
 		return;
 
-	/* first group the range by priority */
+	/* first group the range by priority; ShuffleOrderRange()
+	   below updates #position_order for each group */
 	queue_sort_order_by_priority(this, start, end);
 
 	/* now shuffle each priority group */
@@ -438,8 +548,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	MarkModified(position);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
@@ -495,6 +605,15 @@ Queue::SetPriorityRange(unsigned start_position, unsigned end_position,
 	assert(end_position <= length);
 
 	bool modified = false;
+
+	if (!random) {
+		/* no reordering, so there is no need to look up the
+		   order of each song */
+		for (unsigned i = start_position; i < end_position; ++i)
+			modified |= SetPriority(i, priority, -1);
+		return modified;
+	}
+
 	int after_position = after_order >= 0
 		? (int)OrderToPosition(after_order)
 		: -1;
@@ -22,10 +22,14 @@
 
 #include "util/Compiler.h"
 #include "IdTable.hxx"
+#include "QueueJournal.hxx"
 #include "SingleMode.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -85,9 +89,24 @@ struct Queue {
 	/** map order numbers to positions */
 	unsigned *const order;
 
+	/**
+	 * The inverse of #order: map positions to order numbers.
+	 * Every modification of #order must update it.
+	 */
+	unsigned *const position_order;
+
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/**
+	 * Map song URIs to song ids; a URI which is in the queue more
+	 * than once has one entry for each.
+	 */
+	std::unordered_multimap<std::string, unsigned> uri_index;
+
+	/** which positions were modified in recent versions? */
+	QueueJournal journal;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat = false;
@@ -121,6 +140,13 @@ struct Queue {
 		return length;
 	}
 
+	/**
+	 * Returns an estimate of the memory occupied by the queue and
+	 * its songs.
+	 */
+	gcc_pure
+	size_t GetMemoryUsage() const noexcept;
+
 	/**
 	 * Determine if the queue is empty, i.e. there are no songs.
 	 */
@@ -155,6 +181,21 @@ struct Queue {
 		return id_table.IdToPosition(id);
 	}
 
+	/**
+	 * Is a song with the given URI in the queue?
+	 */
+	gcc_pure
+	bool ContainsURI(const std::string &uri) const noexcept {
+		return uri_index.find(uri) != uri_index.end();
+	}
+
+	/**
+	 * Returns the positions of all songs with the given URI,
+	 * sorted.
+	 */
+	gcc_pure
+	std::vector<unsigned> FindURI(const std::string &uri) const noexcept;
+
 	int PositionToId(unsigned position) const noexcept {
 		assert(position < length);
 
@@ -171,13 +212,9 @@ struct Queue {
 	gcc_pure
 	unsigned PositionToOrder(unsigned position) const noexcept {
 		assert(position < length);
+		assert(order[position_order[position]] == position);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return position_order[position];
 	}
 
 	gcc_pure
@@ -249,7 +286,7 @@ struct Queue {
 	void ModifyAtPosition(unsigned position) noexcept {
 		assert(position < length);
 
-		items[position].version = version;
+		MarkModified(position);
 	}
 
 	/**
@@ -281,6 +318,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) noexcept {
 		std::swap(order[order1], order[order2]);
+		position_order[order[order1]] = order1;
+		position_order[order[order2]] = order2;
 	}
 
 	/**
@@ -323,6 +362,16 @@ struct Queue {
 	 */
 	void DeletePosition(unsigned position) noexcept;
 
+	/**
+	 * Deletes a range of songs from the queue.  Unlike calling
+	 * DeletePosition() for each of them, this moves the remaining
+	 * items only once, i.e. it is O(n) instead of O(n*m).
+	 *
+	 * @param start the position of the first song to delete
+	 * @param end the position after the last song to delete
+	 */
+	void DeleteRange(unsigned start, unsigned end) noexcept;
+
 	/**
 	 * Removes all songs from the playlist.
 	 */
@@ -333,7 +382,7 @@ struct Queue {
 	 */
 	void RestoreOrder() noexcept {
 		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+			order[i] = position_order[i] = i;
 	}
 
 	/**
@@ -378,11 +427,34 @@ struct Queue {
 			      uint8_t priority, int after_order) noexcept;
 
 private:
+	/**
+	 * Stamp the item with the current version and record it in
+	 * the #journal.
+	 */
+	void MarkModified(unsigned position) noexcept {
+		items[position].version = version;
+		journal.Add(version, position, position + 1);
+	}
+
+	/**
+	 * Remove the #uri_index entry of the given song.
+	 */
+	void EraseURI(const DetachedSong &song, unsigned id) noexcept;
+
+	/**
+	 * Update #position_order after the given range of #order has
+	 * been modified.
+	 */
+	void UpdatePositionOrder(unsigned start, unsigned end) noexcept {
+		for (unsigned i = start; i < end; ++i)
+			position_order[order[i]] = i;
+	}
+
 	void MoveItemTo(unsigned from, unsigned to) noexcept {
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		MarkModified(to);
 		id_table.Move(from_id, to);
 	}
 
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "QueueJournal.hxx"
+
+#include <algorithm>
+
+bool
+QueueJournal::Collect(uint32_t since, uint32_t current,
+		      unsigned start, unsigned end,
+		      RangeList &dest) const noexcept
+{
+	if (oldest == 0 || since < oldest || since > current)
+		return false;
+
+	dest.clear();
+
+	for (unsigned i = 0; i < n; ++i) {
+		const auto &e = entries[(head + i) % CAPACITY];
+		if (e.version < since)
+			continue;
+
+		const unsigned s = std::max(e.start, start);
+		const unsigned t = std::min(e.end, end);
+		if (s < t)
+			dest.emplace_back(s, t);
+	}
+
+	if (dest.empty())
+		return true;
+
+	/* sort and merge overlapping ranges */
+
+	std::sort(dest.begin(), dest.end());
+
+	auto out = dest.begin();
+	for (auto i = std::next(dest.begin()); i != dest.end(); ++i) {
+		if (i->first <= out->second)
+			out->second = std::max(out->second, i->second);
+		else
+			*++out = *i;
+	}
+
+	dest.erase(std::next(out), dest.end());
+	return true;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_JOURNAL_HXX
+#define MPD_QUEUE_JOURNAL_HXX
+
+#include "util/Compiler.h"
+
+#include <array>
+#include <vector>
+#include <utility>
+
+#include <stdint.h>
+
+/**
+ * A bounded log of position ranges which were modified in the queue,
+ * tagged with the queue version.  It allows "plchanges" to visit only
+ * the songs which may have changed instead of scanning the whole
+ * queue.
+ *
+ * A song's position changes only when it is marked as modified, so
+ * every song which is newer than a given version lies in one of the
+ * ranges recorded at or after that version.  The ranges are only
+ * candidates; the caller still has to check the song's version.
+ */
+class QueueJournal {
+	static constexpr unsigned CAPACITY = 256;
+
+	struct Entry {
+		uint32_t version;
+
+		unsigned start, end;
+	};
+
+	std::array<Entry, CAPACITY> entries;
+
+	/**
+	 * The index of the oldest entry in the #entries ring buffer.
+	 */
+	unsigned head = 0;
+
+	/**
+	 * The number of valid entries in the ring buffer.
+	 */
+	unsigned n = 0;
+
+	/**
+	 * The oldest version which is completely covered by this
+	 * journal.  0 means the journal is disabled, because the
+	 * version numbers have wrapped around.
+	 */
+	uint32_t oldest = 1;
+
+public:
+	typedef std::vector<std::pair<unsigned, unsigned>> RangeList;
+
+	/**
+	 * Forget everything.  Call this after the queue has been
+	 * cleared: no song can be older than the journal then.
+	 */
+	void Reset() noexcept {
+		head = n = 0;
+		oldest = 1;
+	}
+
+	/**
+	 * Stop recording until the next Reset().  This is used after
+	 * the queue version has wrapped around.
+	 */
+	void Disable() noexcept {
+		head = n = 0;
+		oldest = 0;
+	}
+
+	/**
+	 * Record that the songs in the specified position range have
+	 * been marked with the specified version.  Adjacent ranges of
+	 * the same version are merged.
+	 */
+	void Add(uint32_t version, unsigned start, unsigned end) noexcept {
+		if (oldest == 0)
+			return;
+
+		if (n > 0) {
+			auto &last = entries[(head + n - 1) % CAPACITY];
+			if (last.version == version &&
+			    start <= last.end && end >= last.start) {
+				if (start < last.start)
+					last.start = start;
+				if (end > last.end)
+					last.end = end;
+				return;
+			}
+		}
+
+		if (n == CAPACITY) {
+			/* evict the oldest entry; clients which have
+			   not seen its version need a full scan */
+			oldest = entries[head].version + 1;
+			head = (head + 1) % CAPACITY;
+			--n;
+		}
+
+		entries[(head + n) % CAPACITY] = {version, start, end};
+		++n;
+	}
+
+	/**
+	 * Collect the (sorted, disjoint) position ranges which may
+	 * contain songs modified since the specified version, clipped
+	 * to [start, end).
+	 *
+	 * @param current the current queue version
+	 * @return false if the journal does not reach back to the
+	 * specified version; the caller must scan the whole range then
+	 */
+	bool Collect(uint32_t since, uint32_t current,
+		     unsigned start, unsigned end,
+		     RangeList &dest) const noexcept;
+};
+
+#endif
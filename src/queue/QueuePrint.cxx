@@ -24,6 +24,7 @@
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "client/Response.hxx"
+#include "util/ConstBuffer.hxx"
 
 /**
  * Send detailed information about a range of songs in the queue to a
@@ -70,10 +71,16 @@ queue_print_uris(Response &r, const Queue &queue,
 	}
 }
 
-void
-queue_print_changes_info(Response &r, const Queue &queue,
-			 uint32_t version,
-			 unsigned start, unsigned end)
+/**
+ * Invoke the given function for each position in [start, end) which
+ * is newer than the specified version, in ascending order.  The
+ * queue's journal is used to skip unmodified songs; only if the
+ * version is too old for it, the whole range is scanned.
+ */
+template<typename F>
+static void
+queue_visit_changes(const Queue &queue, uint32_t version,
+		    unsigned start, unsigned end, F &&f)
 {
 	assert(start <= end);
 
@@ -83,9 +90,26 @@ queue_print_changes_info(Response &r, const Queue &queue,
 	if (end > queue.GetLength())
 		end = queue.GetLength();
 
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
-			queue_print_song_info(r, queue, i);
+	QueueJournal::RangeList ranges;
+	if (!queue.journal.Collect(version, queue.version,
+				   start, end, ranges))
+		ranges.assign(1, std::make_pair(start, end));
+
+	for (const auto &range : ranges)
+		for (unsigned i = range.first; i < range.second; i++)
+			if (queue.IsNewerAtPosition(i, version))
+				f(i);
+}
+
+void
+queue_print_changes_info(Response &r, const Queue &queue,
+			 uint32_t version,
+			 unsigned start, unsigned end)
+{
+	queue_visit_changes(queue, version, start, end,
+			    [&r, &queue](unsigned i){
+				    queue_print_song_info(r, queue, i);
+			    });
 }
 
 void
@@ -93,24 +117,32 @@ queue_print_changes_position(Response &r, const Queue &queue,
 			     uint32_t version,
 			     unsigned start, unsigned end)
 {
-	assert(start <= end);
-
-	if (start >= queue.GetLength())
-		return;
-
-	if (end > queue.GetLength())
-		end = queue.GetLength();
-
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
-			r.Format("cpos: %i\nId: %i\n",
-				 i, queue.PositionToId(i));
+	queue_visit_changes(queue, version, start, end,
+			    [&r, &queue](unsigned i){
+				    r.Format("cpos: %i\nId: %i\n",
+					     i, queue.PositionToId(i));
+			    });
 }
 
 void
 queue_find(Response &r, const Queue &queue,
 	   const SongFilter &filter)
 {
+	const char *uri = filter.GetExactURI();
+	if (uri != nullptr) {
+		/* only the songs with this URI can match: look them
+		   up in the index instead of scanning the whole
+		   queue */
+		for (unsigned i : queue.FindURI(uri)) {
+			const LightSong song{queue.Get(i)};
+
+			if (filter.Match(song))
+				queue_print_song_info(r, queue, i);
+		}
+
+		return;
+	}
+
 	for (unsigned i = 0; i < queue.GetLength(); i++) {
 		const LightSong song{queue.Get(i)};
 
@@ -118,3 +150,14 @@ queue_find(Response &r, const Queue &queue,
 			queue_print_song_info(r, queue, i);
 	}
 }
+
+void
+queue_print_contains(Response &r, const Queue &queue,
+		     ConstBuffer<const char *> uris)
+{
+	for (const char *uri : uris) {
+		for (unsigned i : queue.FindURI(uri))
+			r.Format("file: %s\nPos: %u\nId: %i\n",
+				 uri, i, queue.PositionToId(i));
+	}
+}
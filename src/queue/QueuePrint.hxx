@@ -30,6 +30,7 @@
 struct Queue;
 class SongFilter;
 class Response;
+template<typename T> struct ConstBuffer;
 
 void
 queue_print_info(Response &r, const Queue &queue,
@@ -53,4 +54,12 @@ void
 queue_find(Response &response, const Queue &queue,
 	   const SongFilter &filter);
 
+/**
+ * Print the position and id of each song in the queue whose URI is
+ * one of the given ones.
+ */
+void
+queue_print_contains(Response &r, const Queue &queue,
+		     ConstBuffer<const char *> uris);
+
 #endif
@@ -73,13 +73,9 @@ queue_save(BufferedOutputStream &os, const Queue &queue)
 	}
 }
 
-void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue)
+std::unique_ptr<DetachedSong>
+queue_read_song(TextFile &file, const char *line, uint8_t &priority_r)
 {
-	if (queue.IsFull())
-		return;
-
 	uint8_t priority = 0;
 	const char *p;
 	if ((p = StringAfterPrefix(line, PRIO_LABEL))) {
@@ -87,7 +83,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 
 		line = file.ReadLine();
 		if (line == nullptr)
-			return;
+			return nullptr;
 	}
 
 	std::unique_ptr<DetachedSong> song;
@@ -99,7 +95,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 			song = song_load(file, uri);
 		} catch (...) {
 			LogError(std::current_exception());
-			return;
+			return nullptr;
 		}
 	} else {
 		char *endptr;
@@ -107,7 +103,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		if (ret < 0 || *endptr != ':' || endptr[1] == 0) {
 			LogError(playlist_domain,
 				 "Malformed playlist line in state file");
-			return;
+			return nullptr;
 		}
 
 		const char *uri = endptr + 1;
@@ -115,6 +111,22 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		song = std::make_unique<DetachedSong>(uri);
 	}
 
+	priority_r = priority;
+	return song;
+}
+
+void
+queue_load_song(TextFile &file, const SongLoader &loader,
+		const char *line, Queue &queue)
+{
+	if (queue.IsFull())
+		return;
+
+	uint8_t priority;
+	auto song = queue_read_song(file, line, priority);
+	if (!song)
+		return;
+
 	if (!playlist_check_translate_song(*song, nullptr, loader))
 		return;
 
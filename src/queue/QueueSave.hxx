@@ -25,7 +25,12 @@
 #ifndef MPD_QUEUE_SAVE_HXX
 #define MPD_QUEUE_SAVE_HXX
 
+#include <memory>
+
+#include <stdint.h>
+
 struct Queue;
+class DetachedSong;
 class BufferedOutputStream;
 class TextFile;
 class SongLoader;
@@ -33,6 +38,15 @@ class SongLoader;
 void
 queue_save(BufferedOutputStream &os, const Queue &queue);
 
+/**
+ * Parses one song from the state file, but does not resolve it with
+ * the database yet (see playlist_check_translate_song()).
+ *
+ * @return the song or nullptr on error (which has been logged)
+ */
+std::unique_ptr<DetachedSong>
+queue_read_song(TextFile &file, const char *line, uint8_t &priority_r);
+
 /**
  * Loads one song from the state file and appends it to the queue.
  */
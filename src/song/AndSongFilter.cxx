@@ -60,3 +60,22 @@ AndSongFilter::Match(const LightSong &song) const noexcept
 
 	return true;
 }
+
+unsigned
+AndSongFilter::GetCost() const noexcept
+{
+	unsigned cost = 0;
+	for (const auto &i : items)
+		cost += i->GetCost();
+	return cost;
+}
+
+bool
+AndSongFilter::IsVolatile() const noexcept
+{
+	for (const auto &i : items)
+		if (i->IsVolatile())
+			return true;
+
+	return false;
+}
@@ -53,6 +53,8 @@ public:
 	ISongFilterPtr Clone() const noexcept override;
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
+	unsigned GetCost() const noexcept override;
+	bool IsVolatile() const noexcept override;
 };
 
 #endif
@@ -43,6 +43,11 @@ public:
 
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
+
+	unsigned GetCost() const noexcept override {
+		/* LightSong::GetURI() allocates a string */
+		return 4;
+	}
 };
 
 #endif
@@ -19,38 +19,87 @@
 
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
+#include "song/UriPrefix.hxx"
 #include "util/UriUtil.hxx"
 #include "fs/Traits.hxx"
 
 DetachedSong::DetachedSong(const LightSong &other)
 	:uri(other.GetURI()),
-	 real_uri(other.real_uri != nullptr ? other.real_uri : ""),
 	 tag(other.tag),
 	 mtime(other.mtime),
 	 start_time(other.start_time),
-	 end_time(other.end_time) {}
+	 end_time(other.end_time),
+	 replay_gain(other.replay_gain)
+{
+	if (other.real_uri != nullptr)
+		SetRealURI(other.real_uri);
+
+	if (other.mix_ramp != nullptr && other.mix_ramp->IsDefined())
+		mix_ramp = std::make_shared<const MixRampInfo>(*other.mix_ramp);
+}
 
 DetachedSong::operator LightSong() const noexcept
 {
 	LightSong result(uri.c_str(), tag);
 	result.directory = nullptr;
-	result.real_uri = real_uri.empty() ? nullptr : real_uri.c_str();
+	/* a shared prefix cannot be expressed as a plain pointer;
+	   LightSong users needing the real URI must use the
+	   #DetachedSong */
+	result.real_uri = real_uri != nullptr && !real_uri_is_prefix
+		? real_uri->c_str()
+		: nullptr;
 	result.mtime = mtime;
 	result.start_time = start_time;
 	result.end_time = end_time;
+	result.replay_gain = replay_gain;
+	result.mix_ramp = mix_ramp.get();
 	return result;
 }
 
+std::string
+DetachedSong::GetRealURI() const
+{
+	if (real_uri == nullptr)
+		return uri;
+
+	if (real_uri_is_prefix)
+		return *real_uri + uri;
+
+	return *real_uri;
+}
+
+void
+DetachedSong::SetRealURI(std::string &&_uri)
+{
+	if (!uri.empty() && _uri.length() > uri.length() &&
+	    _uri.compare(_uri.length() - uri.length(), uri.length(),
+			 uri) == 0) {
+		_uri.resize(_uri.length() - uri.length());
+		real_uri = InternUriPrefix(std::move(_uri));
+		real_uri_is_prefix = true;
+	} else {
+		real_uri = std::make_shared<const std::string>(std::move(_uri));
+		real_uri_is_prefix = false;
+	}
+}
+
+const MixRampInfo &
+DetachedSong::GetMixRamp() const noexcept
+{
+	static const MixRampInfo undefined;
+	return mix_ramp != nullptr ? *mix_ramp : undefined;
+}
+
 bool
 DetachedSong::IsRemote() const noexcept
 {
-	return uri_has_scheme(GetRealURI());
+	return uri_has_scheme(GetRealURIStart());
 }
 
 bool
 DetachedSong::IsAbsoluteFile() const noexcept
 {
-	return PathTraitsUTF8::IsAbsolute(GetRealURI());
+	return PathTraitsUTF8::IsAbsolute(GetRealURIStart());
 }
 
 bool
@@ -21,10 +21,14 @@
 #define MPD_DETACHED_SONG_HXX
 
 #include "tag/Tag.hxx"
+#include "tag/Mask.hxx"
 #include "Chrono.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
 #include "util/Compiler.h"
 
 #include <chrono>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -51,16 +55,21 @@ class DetachedSong {
 
 	/**
 	 * The "real" URI, the one to be used for opening the
-	 * resource.  If this attribute is empty, then #uri shall be
+	 * resource.  If this attribute is nullptr, then #uri shall be
 	 * used.
 	 *
-	 * This attribute is used for songs from the database which
-	 * have a relative URI.
+	 * If #real_uri_is_prefix is set, then the real URI is this
+	 * string followed by #uri.  This is the common case for
+	 * songs from the database which have a relative URI: the
+	 * prefix is the storage's base URI, shared by all songs (see
+	 * InternUriPrefix()).
 	 */
-	std::string real_uri;
+	std::shared_ptr<const std::string> real_uri;
 
 	Tag tag;
 
+	bool real_uri_is_prefix = false;
+
 	/**
 	 * The time stamp of the last file modification.  A negative
 	 * value means that this is unknown/unavailable.
@@ -79,6 +88,33 @@ class DetachedSong {
 	 */
 	SongTime end_time = SongTime::zero();
 
+	/**
+	 * ReplayGain values measured while updating the database;
+	 * used if the file has no ReplayGain tags.
+	 */
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
+	/**
+	 * The MixRamp profile measured while updating the database;
+	 * used if the file has no MixRamp tags.  This is nullptr if
+	 * there is no profile, which is the common case.
+	 */
+	std::shared_ptr<const MixRampInfo> mix_ramp;
+
+	struct InfoCache {
+		std::string value;
+		TagMask mask;
+		bool binary;
+	};
+
+	/**
+	 * A cache for song_print_info(): the rendered protocol block
+	 * of this song for the tag mask InfoCache::mask, in the
+	 * binary encoding if InfoCache::binary is set.  It is
+	 * cleared by all methods which modify the song.
+	 */
+	mutable std::shared_ptr<const InfoCache> info_cache;
+
 public:
 	explicit DetachedSong(const char *_uri)
 		:uri(_uri) {}
@@ -120,6 +156,14 @@ public:
 
 	template<typename T>
 	void SetURI(T &&_uri) {
+		InvalidateInfoCache();
+
+		if (real_uri_is_prefix) {
+			/* the real URI depends on the old #uri */
+			real_uri = std::make_shared<const std::string>(GetRealURI());
+			real_uri_is_prefix = false;
+		}
+
 		uri = std::forward<T>(_uri);
 	}
 
@@ -129,7 +173,7 @@ public:
 	 */
 	gcc_pure
 	bool HasRealURI() const noexcept {
-		return !real_uri.empty();
+		return real_uri != nullptr;
 	}
 
 	/**
@@ -137,13 +181,30 @@ public:
 	 * GetURI().
 	 */
 	gcc_pure
-	const char *GetRealURI() const noexcept {
-		return (HasRealURI() ? real_uri : uri).c_str();
-	}
+	std::string GetRealURI() const;
 
-	template<typename T>
-	void SetRealURI(T &&_uri) {
-		real_uri = std::forward<T>(_uri);
+	/**
+	 * Set the "real" URI.  If it ends with #uri, only the prefix
+	 * is stored, shared with all other songs using the same
+	 * prefix.
+	 */
+	void SetRealURI(std::string &&_uri);
+
+	/**
+	 * Returns an estimate of the memory occupied by this object
+	 * (not including the tag values, which live in the tag
+	 * pool, and shared objects).
+	 */
+	gcc_pure
+	size_t GetMemoryUsage() const noexcept {
+		size_t result = sizeof(*this) + uri.capacity() +
+			tag.num_items * sizeof(*tag.items);
+		if (real_uri != nullptr && !real_uri_is_prefix)
+			result += sizeof(*real_uri) + real_uri->capacity();
+		if (info_cache != nullptr)
+			result += sizeof(*info_cache) +
+				info_cache->value.capacity();
+		return result;
 	}
 
 	/**
@@ -181,18 +242,23 @@ public:
 	}
 
 	Tag &WritableTag() noexcept {
+		InvalidateInfoCache();
 		return tag;
 	}
 
 	void SetTag(const Tag &_tag) {
+		InvalidateInfoCache();
 		tag = Tag(_tag);
 	}
 
 	void SetTag(Tag &&_tag) {
+		InvalidateInfoCache();
 		tag = std::move(_tag);
 	}
 
 	void MoveTagFrom(DetachedSong &&other) {
+		InvalidateInfoCache();
+		other.InvalidateInfoCache();
 		tag = std::move(other.tag);
 	}
 
@@ -201,6 +267,8 @@ public:
 	 * array.
 	 */
 	void MoveTagItemsFrom(DetachedSong &&other) {
+		InvalidateInfoCache();
+		other.InvalidateInfoCache();
 		tag.MoveItemsFrom(std::move(other.tag));
 	}
 
@@ -209,6 +277,7 @@ public:
 	}
 
 	void SetLastModified(std::chrono::system_clock::time_point _value) {
+		InvalidateInfoCache();
 		mtime = _value;
 	}
 
@@ -217,6 +286,7 @@ public:
 	}
 
 	void SetStartTime(SongTime _value) {
+		InvalidateInfoCache();
 		start_time = _value;
 	}
 
@@ -225,12 +295,31 @@ public:
 	}
 
 	void SetEndTime(SongTime _value) {
+		InvalidateInfoCache();
 		end_time = _value;
 	}
 
 	gcc_pure
 	SignedSongTime GetDuration() const noexcept;
 
+	const ReplayGainInfo &GetReplayGain() const noexcept {
+		return replay_gain;
+	}
+
+	void SetReplayGain(const ReplayGainInfo &_value) noexcept {
+		replay_gain = _value;
+	}
+
+	gcc_pure
+	const MixRampInfo &GetMixRamp() const noexcept;
+
+	void SetMixRamp(MixRampInfo &&_value) {
+		if (_value.IsDefined())
+			mix_ramp = std::make_shared<const MixRampInfo>(std::move(_value));
+		else
+			mix_ramp.reset();
+	}
+
 	/**
 	 * Update the #tag and #mtime.
 	 *
@@ -242,6 +331,40 @@ public:
 	 * Load #tag and #mtime from a local file.
 	 */
 	bool LoadFile(Path path) noexcept;
+
+	/**
+	 * @return the cached song_print_info() block for the given
+	 * tag mask or nullptr if there is none
+	 */
+	gcc_pure
+	const std::string *GetInfoCache(TagMask mask,
+					bool binary) const noexcept {
+		return info_cache != nullptr && mask == info_cache->mask &&
+			binary == info_cache->binary
+			? &info_cache->value
+			: nullptr;
+	}
+
+	const std::string &SetInfoCache(TagMask mask, bool binary,
+					std::string &&value) const {
+		info_cache = std::make_shared<const InfoCache>(InfoCache{std::move(value), mask, binary});
+		return info_cache->value;
+	}
+
+private:
+	void InvalidateInfoCache() noexcept {
+		info_cache.reset();
+	}
+
+	/**
+	 * Returns the beginning of the real URI: either the whole
+	 * real URI or its prefix.  This is enough to determine
+	 * whether it is remote or absolute.
+	 */
+	gcc_pure
+	const char *GetRealURIStart() const noexcept {
+		return (real_uri != nullptr ? *real_uri : uri).c_str();
+	}
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include "TagSongFilter.hxx"
 #include "ModifiedSinceSongFilter.hxx"
 #include "AudioFormatSongFilter.hxx"
+#include "StickerSongFilter.hxx"
 #include "LightSong.hxx"
 #include "AudioParser.hxx"
 #include "tag/ParseName.hxx"
@@ -42,10 +43,15 @@
 #include "util/UriUtil.hxx"
 #include "lib/icu/CaseFold.hxx"
 
+#ifdef HAVE_PCRE
+#include "lib/pcre/RegexCache.hxx"
+#endif
+
 #include <exception>
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define LOCATE_TAG_FILE_KEY     "file"
 #define LOCATE_TAG_FILE_KEY_OLD "filename"
@@ -59,6 +65,7 @@ enum {
 
 	LOCATE_TAG_MODIFIED_SINCE,
 	LOCATE_TAG_AUDIO_FORMAT,
+	LOCATE_TAG_STICKER,
 	LOCATE_TAG_FILE_TYPE,
 	LOCATE_TAG_ANY_TYPE,
 };
@@ -86,6 +93,9 @@ locate_parse_type(const char *str) noexcept
 	if (StringEqualsCaseASCII(str, "AudioFormat"))
 		return LOCATE_TAG_AUDIO_FORMAT;
 
+	if (strcmp(str, "sticker") == 0)
+		return LOCATE_TAG_STICKER;
+
 	return tag_name_parse_i(str);
 }
 
@@ -228,9 +238,8 @@ ParseStringFilter(const char *&s, bool fold_case)
 		s = StripLeft(s + 2);
 		auto value = ExpectQuoted(s);
 		StringFilter f(std::move(value), fold_case, false, negated);
-		f.SetRegex(std::make_shared<UniqueRegex>(f.GetValue().c_str(),
-							 false, false,
-							 fold_case));
+		f.SetRegex(GetCachedRegex(f.GetValue().c_str(),
+					  false, false, fold_case));
 		return f;
 	}
 #endif
@@ -247,6 +256,36 @@ ParseStringFilter(const char *&s, bool fold_case)
 			    fold_case, false, negated);
 }
 
+/**
+ * Parse the operator and the second operand of a "sticker"
+ * expression; nothing (i.e. the closing parenthesis) means the
+ * sticker only needs to exist.
+ *
+ * Throws on error.
+ */
+static StickerOperator
+ParseStickerOperator(const char *&s, std::string &value)
+{
+	StickerOperator op;
+	if (*s == ')')
+		return StickerOperator::EXISTS;
+	else if (s[0] == '=' && s[1] == '=') {
+		op = StickerOperator::EQUALS;
+		s += 2;
+	} else if (*s == '<') {
+		op = StickerOperator::LESS_THAN;
+		++s;
+	} else if (*s == '>') {
+		op = StickerOperator::GREATER_THAN;
+		++s;
+	} else
+		throw std::runtime_error("'==', '<' or '>' expected");
+
+	s = StripLeft(s);
+	value = ExpectQuoted(s);
+	return op;
+}
+
 ISongFilterPtr
 SongFilter::ParseExpression(const char *&s, bool fold_case)
 {
@@ -309,6 +348,16 @@ SongFilter::ParseExpression(const char *&s, bool fold_case)
 		s = StripLeft(s + 1);
 
 		return std::make_unique<BaseSongFilter>(std::move(value));
+	} else if (type == LOCATE_TAG_STICKER) {
+		auto name = ExpectQuoted(s);
+		std::string value;
+		const auto op = ParseStickerOperator(s, value);
+		if (*s != ')')
+			throw std::runtime_error("')' expected");
+		s = StripLeft(s + 1);
+
+		return std::make_unique<StickerSongFilter>(std::move(name), op,
+							   std::move(value));
 	} else if (type == LOCATE_TAG_AUDIO_FORMAT) {
 		bool mask;
 		if (s[0] == '=' && s[1] == '=')
@@ -366,6 +415,9 @@ SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 		and_filter.AddItem(std::make_unique<ModifiedSinceSongFilter>(ParseTimeStamp(value)));
 		break;
 
+	case LOCATE_TAG_STICKER:
+		throw std::runtime_error("Sticker filters require an expression");
+
 	case LOCATE_TAG_FILE_TYPE:
 		/* for compatibility with MPD 0.20 and older,
 		   "fold_case" also switches on "substring" */
@@ -457,16 +509,50 @@ SongFilter::HasOtherThanBase() const noexcept
 	return false;
 }
 
+const char *
+SongFilter::GetExactURI() const noexcept
+{
+	for (const auto &i : and_filter.GetItems()) {
+		const auto *f = dynamic_cast<const UriSongFilter *>(i.get());
+		if (f != nullptr && f->IsExact())
+			return f->GetValue().c_str();
+	}
+
+	return nullptr;
+}
+
 const char *
 SongFilter::GetBase() const noexcept
 {
+	/* all of them must match, so the longest one is the most
+	   specific; if they contradict each other, nothing matches
+	   anyway */
+	const char *result = nullptr;
+	size_t result_length = 0;
+
 	for (const auto &i : and_filter.GetItems()) {
 		const auto *f = dynamic_cast<const BaseSongFilter *>(i.get());
-		if (f != nullptr)
-			return f->GetValue();
+		if (f != nullptr) {
+			const size_t length = strlen(f->GetValue());
+			if (result == nullptr || length > result_length) {
+				result = f->GetValue();
+				result_length = length;
+			}
+		}
 	}
 
-	return nullptr;
+	return result;
+}
+
+SongFilter
+SongFilter::Copy() const noexcept
+{
+	SongFilter result;
+
+	for (const auto &i : and_filter.GetItems())
+		result.and_filter.AddItem(i->Clone());
+
+	return result;
 }
 
 SongFilter
@@ -56,6 +56,20 @@ public:
 	 */
 	std::string ToExpression() const noexcept;
 
+	/**
+	 * Returns a copy of this filter, e.g. to be evaluated after
+	 * this object has been destroyed.
+	 */
+	ISongFilterPtr Clone() const noexcept {
+		return and_filter.Clone();
+	}
+
+	/**
+	 * Returns a deep copy of this object, e.g. to be evaluated
+	 * in another thread after the original has been destroyed.
+	 */
+	SongFilter Copy() const noexcept;
+
 private:
 	static ISongFilterPtr ParseExpression(const char *&s, bool fold_case=false);
 
@@ -88,6 +102,14 @@ public:
 	gcc_pure
 	bool HasFoldCase() const noexcept;
 
+	/**
+	 * See ISongFilter::IsVolatile().
+	 */
+	gcc_pure
+	bool IsVolatile() const noexcept {
+		return and_filter.IsVolatile();
+	}
+
 	/**
 	 * Does this filter contain constraints other than "base"?
 	 */
@@ -101,6 +123,14 @@ public:
 	gcc_pure
 	const char *GetBase() const noexcept;
 
+	/**
+	 * Returns the URI if this filter contains a case-sensitive
+	 * exact "file" constraint, i.e. it can only match songs with
+	 * this URI; nullptr otherwise.
+	 */
+	gcc_pure
+	const char *GetExactURI() const noexcept;
+
 	/**
 	 * Create a copy of the filter with the given prefix stripped
 	 * from all #LOCATE_TAG_BASE_TYPE items.  This is used to
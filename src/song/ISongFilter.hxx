@@ -43,6 +43,25 @@ public:
 
 	gcc_pure
 	virtual bool Match(const LightSong &song) const noexcept = 0;
+
+	/**
+	 * Estimate the relative cost of a Match() call, taking into
+	 * account that a filter which rarely matches saves the
+	 * evaluation of its siblings.  OptimizeSongFilter() uses this
+	 * to evaluate the cheapest filters first.
+	 */
+	gcc_pure
+	virtual unsigned GetCost() const noexcept = 0;
+
+	/**
+	 * Does the result of Match() depend on state outside of the
+	 * song, e.g. the sticker database?  Then its results must not
+	 * be cached.
+	 */
+	gcc_pure
+	virtual bool IsVolatile() const noexcept {
+		return false;
+	}
 };
 
 #endif
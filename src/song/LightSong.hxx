@@ -22,12 +22,14 @@
 
 #include "Chrono.hxx"
 #include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 
 #include <string>
 #include <chrono>
 
 struct Tag;
+class MixRampInfo;
 
 /**
  * A reference to a song file.  Unlike the other "Song" classes in the
@@ -85,6 +87,18 @@ struct LightSong {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * ReplayGain values measured while updating the database,
+	 * for files which have no ReplayGain tags.
+	 */
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
+	/**
+	 * The MixRamp profile measured while updating the database,
+	 * for files which have no MixRamp tags.  May be nullptr.
+	 */
+	const MixRampInfo *mix_ramp = nullptr;
+
 	LightSong(const char *_uri, const Tag &_tag) noexcept
 		:uri(_uri), tag(_tag) {}
 
@@ -37,6 +37,10 @@ public:
 
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
+
+	unsigned GetCost() const noexcept override {
+		return 1;
+	}
 };
 
 #endif
@@ -47,6 +47,14 @@ public:
 	bool Match(const LightSong &song) const noexcept override {
 		return !child->Match(song);
 	}
+
+	unsigned GetCost() const noexcept override {
+		return child->GetCost();
+	}
+
+	bool IsVolatile() const noexcept override {
+		return child->IsVolatile();
+	}
 };
 
 #endif
@@ -37,6 +37,12 @@ OptimizeSongFilter(AndSongFilter &af) noexcept
 			++i;
 		}
 	}
+
+	/* evaluate the cheapest filters first; std::list::sort() is
+	   stable, so filters with equal costs keep their order */
+	af.items.sort([](const ISongFilterPtr &a, const ISongFilterPtr &b){
+			return a->GetCost() < b->GetCost();
+		});
 }
 
 ISongFilterPtr
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "StickerSongFilter.hxx"
+#include "Escape.hxx"
+#include "LightSong.hxx"
+
+#include <stdexcept>
+
+StickerSongFilter::Finder StickerSongFilter::finder;
+
+StickerSongFilter::StickerSongFilter(std::string &&_name,
+				     StickerOperator _op,
+				     std::string &&_value)
+	:name(std::move(_name)), value(std::move(_value)), op(_op)
+{
+	if (finder == nullptr)
+		throw std::runtime_error("sticker database is disabled");
+
+	uris = std::make_shared<const UriSet>(finder(name.c_str(), op,
+						     value.c_str()));
+}
+
+std::string
+StickerSongFilter::ToExpression() const noexcept
+{
+	std::string result = "(sticker \"" + EscapeFilterString(name) + "\"";
+
+	switch (op) {
+	case StickerOperator::EXISTS:
+		return result + ")";
+
+	case StickerOperator::EQUALS:
+		result += " == \"";
+		break;
+
+	case StickerOperator::LESS_THAN:
+		result += " < \"";
+		break;
+
+	case StickerOperator::GREATER_THAN:
+		result += " > \"";
+		break;
+	}
+
+	return result + EscapeFilterString(value) + "\")";
+}
+
+bool
+StickerSongFilter::Match(const LightSong &song) const noexcept
+{
+	try {
+		return uris->find(song.GetURI()) != uris->end();
+	} catch (...) {
+		return false;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STICKER_SONG_FILTER_HXX
+#define MPD_STICKER_SONG_FILTER_HXX
+
+#include "ISongFilter.hxx"
+#include "sticker/Match.hxx"
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+/**
+ * Matches songs which have a sticker with the given name (and a
+ * matching value).  The URIs of all those songs are looked up in the
+ * sticker database once, when the filter is constructed, so Match()
+ * is just a hash lookup.
+ */
+class StickerSongFilter final : public ISongFilter {
+public:
+	typedef std::unordered_set<std::string> UriSet;
+
+	/**
+	 * Look up the URIs of all songs with the given sticker.  The
+	 * sticker database installs this function in #finder,
+	 * because this library does not depend on it.
+	 *
+	 * Throws on error.
+	 */
+	typedef UriSet (*Finder)(const char *name, StickerOperator op,
+				 const char *value);
+
+	/**
+	 * nullptr if the sticker database is disabled.
+	 */
+	static Finder finder;
+
+private:
+	std::string name, value;
+
+	StickerOperator op;
+
+	/**
+	 * Shared by all clones.
+	 */
+	std::shared_ptr<const UriSet> uris;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	StickerSongFilter(std::string &&_name, StickerOperator _op,
+			  std::string &&_value);
+
+	/* virtual methods from ISongFilter */
+	ISongFilterPtr Clone() const noexcept override {
+		return std::make_unique<StickerSongFilter>(*this);
+	}
+
+	std::string ToExpression() const noexcept override;
+	bool Match(const LightSong &song) const noexcept override;
+
+	unsigned GetCost() const noexcept override {
+		return 1;
+	}
+
+	bool IsVolatile() const noexcept override {
+		return true;
+	}
+};
+
+#endif
@@ -18,6 +18,8 @@
  */
 
 #include "StringFilter.hxx"
+#include "tag/Item.hxx"
+#include "tag/Pool.hxx"
 #include "util/StringCompare.hxx"
 
 #include <assert.h>
@@ -46,8 +48,45 @@ StringFilter::MatchWithoutNegation(const char *s) const noexcept
 	}
 }
 
+unsigned
+StringFilter::GetCost() const noexcept
+{
+	unsigned cost;
+
+	if (IsRegex())
+		cost = 32;
+	else if (substring)
+		cost = 2;
+	else
+		/* exact matches are cheap and usually very selective */
+		cost = 1;
+
+	if (fold_case)
+		cost += 2;
+
+	if (negated)
+		/* negated filters match most songs, so they rarely
+		   save the evaluation of other filters */
+		cost += 4;
+
+	return cost;
+}
+
 bool
 StringFilter::Match(const char *s) const noexcept
 {
 	return MatchWithoutNegation(s) != negated;
 }
+
+bool
+StringFilter::Match(const TagItem &item) const noexcept
+{
+	if (!fold_case || IsRegex())
+		return Match(item.value);
+
+	const char *folded = tag_pool_get_folded(item);
+	const bool result = substring
+		? fold_case.IsInFolded(folded)
+		: fold_case.EqualsFolded(folded);
+	return result != negated;
+}
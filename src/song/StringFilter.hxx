@@ -31,6 +31,8 @@
 #include <string>
 #include <memory>
 
+struct TagItem;
+
 class StringFilter {
 	std::string value;
 
@@ -86,6 +88,10 @@ public:
 		return fold_case;
 	}
 
+	bool IsSubstring() const noexcept {
+		return substring;
+	}
+
 	bool IsNegated() const noexcept {
 		return negated;
 	}
@@ -102,9 +108,24 @@ public:
 			   : (negated ? "!=" : "=="));
 	}
 
+	/**
+	 * Estimate the relative cost of Match(); see
+	 * ISongFilter::GetCost().
+	 */
+	gcc_pure
+	unsigned GetCost() const noexcept;
+
 	gcc_pure
 	bool Match(const char *s) const noexcept;
 
+	/**
+	 * Like Match(const char *), but uses the case-folded value
+	 * cached in the tag pool.  The #TagItem must have been
+	 * obtained from the tag pool.
+	 */
+	gcc_pure
+	bool Match(const TagItem &item) const noexcept;
+
 private:
 	gcc_pure
 	bool MatchWithoutNegation(const char *s) const noexcept;
@@ -38,7 +38,7 @@ bool
 TagSongFilter::MatchNN(const TagItem &item) const noexcept
 {
 	return (type == TAG_NUM_OF_ITEM_TYPES || item.type == type) &&
-		filter.Match(item.value);
+		filter.Match(item);
 }
 
 bool
@@ -63,7 +63,7 @@ TagSongFilter::MatchNN(const Tag &tag) const noexcept
 
 			     for (const auto &item : tag) {
 				     if (item.type == tag2 &&
-					 filter.Match(item.value)) {
+					 filter.Match(item)) {
 					     result = true;
 					     break;
 				     }
@@ -86,6 +86,14 @@ TagSongFilter::MatchNN(const Tag &tag) const noexcept
 	return false;
 }
 
+unsigned
+TagSongFilter::GetCost() const noexcept
+{
+	/* "any" compares each tag item, the others only those of
+	   one type */
+	return (type == TAG_NUM_OF_ITEM_TYPES ? 8 : 2) * filter.GetCost();
+}
+
 bool
 TagSongFilter::Match(const LightSong &song) const noexcept
 {
@@ -52,6 +52,14 @@ public:
 		return filter.GetFoldCase();
 	}
 
+	bool IsSubstring() const noexcept {
+		return filter.IsSubstring();
+	}
+
+	bool IsRegex() const noexcept {
+		return filter.IsRegex();
+	}
+
 	bool IsNegated() const noexcept {
 		return filter.IsNegated();
 	}
@@ -66,6 +74,7 @@ public:
 
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
+	unsigned GetCost() const noexcept override;
 
 private:
 	bool MatchNN(const Tag &tag) const noexcept;
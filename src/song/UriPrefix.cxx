@@ -0,0 +1,58 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "UriPrefix.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+
+static Mutex uri_prefix_mutex;
+
+/**
+ * Weak references to all prefixes which are currently in use.  This
+ * is usually a very small map (one entry per storage), so expired
+ * entries are purged whenever a new one is inserted.
+ */
+static std::map<std::string, std::weak_ptr<const std::string>> uri_prefixes;
+
+std::shared_ptr<const std::string>
+InternUriPrefix(std::string &&prefix)
+{
+	const std::lock_guard<Mutex> protect(uri_prefix_mutex);
+
+	auto i = uri_prefixes.find(prefix);
+	if (i != uri_prefixes.end()) {
+		auto result = i->second.lock();
+		if (result)
+			return result;
+	} else {
+		for (auto j = uri_prefixes.begin(); j != uri_prefixes.end();)
+			if (j->second.expired())
+				j = uri_prefixes.erase(j);
+			else
+				++j;
+
+		i = uri_prefixes.emplace(prefix,
+					 std::weak_ptr<const std::string>()).first;
+	}
+
+	auto result = std::make_shared<const std::string>(std::move(prefix));
+	i->second = result;
+	return result;
+}
@@ -42,6 +42,15 @@ public:
 		return filter.IsNegated();
 	}
 
+	/**
+	 * Does this filter match only songs with exactly the URI
+	 * returned by GetValue()?
+	 */
+	bool IsExact() const noexcept {
+		return !filter.GetFoldCase() && !filter.IsSubstring() &&
+			!filter.IsRegex() && !filter.IsNegated();
+	}
+
 	void ToggleNegated() noexcept {
 		filter.ToggleNegated();
 	}
@@ -52,6 +61,11 @@ public:
 
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
+
+	unsigned GetCost() const noexcept override {
+		/* LightSong::GetURI() allocates a string */
+		return 4 + filter.GetCost();
+	}
 };
 
 #endif
@@ -22,6 +22,8 @@
 #include "song/LightSong.hxx"
 #include "db/Interface.hxx"
 #include "util/Alloc.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
 #include "util/ScopeExit.hxx"
 
 #include <string.h>
@@ -34,6 +36,34 @@ sticker_song_get_value(const LightSong &song, const char *name)
 	return sticker_load_value("song", uri.c_str(), name);
 }
 
+void
+sticker_song_get_values(ConstBuffer<const char *> uris, const char *name,
+			void (*func)(const char *uri, const char *value,
+				     void *user_data),
+			void *user_data)
+{
+	sticker_load_values("song", name, uris, func, user_data);
+}
+
+static void
+sticker_song_find_uris_cb(const char *uri, gcc_unused const char *value,
+			  void *user_data)
+{
+	auto &uris = *(std::unordered_set<std::string> *)user_data;
+	uris.emplace(uri);
+}
+
+std::unordered_set<std::string>
+sticker_song_find_uris(const char *name, StickerOperator op,
+		       const char *value)
+{
+	std::unordered_set<std::string> uris;
+	sticker_find("song", nullptr, name, op,
+		     op == StickerOperator::EXISTS ? nullptr : value,
+		     sticker_song_find_uris_cb, &uris);
+	return uris;
+}
+
 void
 sticker_song_set_value(const LightSong &song,
 		       const char *name, const char *value)
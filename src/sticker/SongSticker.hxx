@@ -23,10 +23,12 @@
 #include "Match.hxx"
 
 #include <string>
+#include <unordered_set>
 
 struct LightSong;
 struct Sticker;
 class Database;
+template<typename T> struct ConstBuffer;
 
 /**
  * Returns one value from a song's sticker record.
@@ -36,6 +38,32 @@ class Database;
 std::string
 sticker_song_get_value(const LightSong &song, const char *name);
 
+/**
+ * Loads one sticker value of many songs at once.
+ *
+ * Throws #SqliteError on error.
+ *
+ * @param uris the song URIs (see LightSong::GetURI())
+ * @param func invoked for each song which has this sticker value
+ * (in no particular order)
+ */
+void
+sticker_song_get_values(ConstBuffer<const char *> uris, const char *name,
+			void (*func)(const char *uri, const char *value,
+				     void *user_data),
+			void *user_data);
+
+/**
+ * Returns the URIs of all songs which have a sticker with the given
+ * name and a matching value.  This implements
+ * StickerSongFilter::Finder.
+ *
+ * Throws #SqliteError on error.
+ */
+std::unordered_set<std::string>
+sticker_song_find_uris(const char *name, StickerOperator op,
+		       const char *value);
+
 /**
  * Sets a sticker value in the specified song.  Overwrites existing
  * values.
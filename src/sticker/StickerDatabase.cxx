@@ -21,12 +21,18 @@
 #include "lib/sqlite/Util.hxx"
 #include "fs/Path.hxx"
 #include "Idle.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Macros.hxx"
 #include "util/StringCompare.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
 
 #include <string>
+#include <list>
 #include <map>
+#include <set>
+#include <unordered_map>
 
 #include <assert.h>
 
@@ -45,8 +51,20 @@ enum sticker_sql {
 	STICKER_SQL_FIND_VALUE,
 	STICKER_SQL_FIND_LT,
 	STICKER_SQL_FIND_GT,
+	STICKER_SQL_GET_BATCH,
 };
 
+/**
+ * The number of URIs queried by one #STICKER_SQL_GET_BATCH
+ * statement.  Unused parameters are bound to NULL.
+ */
+static constexpr unsigned STICKER_BATCH_SIZE = 32;
+
+#define STICKER_BATCH_PARAMS_8 "?,?,?,?,?,?,?,?"
+#define STICKER_BATCH_PARAMS \
+	STICKER_BATCH_PARAMS_8 "," STICKER_BATCH_PARAMS_8 "," \
+	STICKER_BATCH_PARAMS_8 "," STICKER_BATCH_PARAMS_8
+
 static const char *const sticker_sql[] = {
 	//[STICKER_SQL_GET] =
 	"SELECT value FROM sticker WHERE type=? AND uri=? AND name=?",
@@ -71,6 +89,10 @@ static const char *const sticker_sql[] = {
 
 	//[STICKER_SQL_FIND_GT] =
 	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value>?",
+
+	//[STICKER_SQL_GET_BATCH] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri IN ("
+	STICKER_BATCH_PARAMS ")",
 };
 
 static const char sticker_sql_create[] =
@@ -82,11 +104,105 @@ static const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name_value ON sticker(type, name, value);"
 	"";
 
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[ARRAY_SIZE(sticker_sql)];
 
+/**
+ * Protects the prepared statements and #sticker_cache.  Most callers
+ * are in the main thread, but the update thread stores fingerprints
+ * (see db/update/Fingerprint.cxx).
+ */
+static Mutex sticker_mutex;
+
+/**
+ * A cache for sticker_load_value() and sticker_load_values().
+ * Clients look up the same stickers (e.g. the rating of each song in
+ * the queue) over and over.  Misses are cached as empty values,
+ * because sticker_load_value() does not distinguish them either.
+ *
+ * This class is not thread-safe; it is protected by #sticker_mutex.
+ */
+class StickerValueCache {
+	typedef std::list<std::pair<const std::string, std::string>> List;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List list;
+
+	std::unordered_map<std::string, List::iterator> map;
+
+	static constexpr size_t MAX_ITEMS = 4096;
+
+public:
+	static std::string MakeKey(const char *type, const char *uri,
+				   const char *name) noexcept {
+		std::string key(type);
+		key.push_back('\0');
+		key += uri;
+		key.push_back('\0');
+		key += name;
+		return key;
+	}
+
+	/**
+	 * @return the cached value or nullptr if there is no such
+	 * entry; the pointer is valid until the cache is modified
+	 */
+	const std::string *Get(const std::string &key) noexcept {
+		auto i = map.find(key);
+		if (i == map.end())
+			return nullptr;
+
+		/* move to the front of the LRU list */
+		list.splice(list.begin(), list, i->second);
+		return &i->second->second;
+	}
+
+	void Put(const std::string &key, const char *value) noexcept {
+		auto i = map.find(key);
+		if (i != map.end()) {
+			i->second->second = value;
+			list.splice(list.begin(), list, i->second);
+			return;
+		}
+
+		if (list.size() >= MAX_ITEMS) {
+			map.erase(list.back().first);
+			list.pop_back();
+		}
+
+		list.emplace_front(key, value);
+		map.emplace(key, list.begin());
+	}
+
+	/**
+	 * Discard all entries of the given object.
+	 */
+	void Remove(const char *type, const char *uri) noexcept {
+		const std::string prefix = MakeKey(type, uri, "");
+
+		for (auto i = list.begin(); i != list.end();) {
+			if (i->first.compare(0, prefix.length(), prefix) == 0) {
+				map.erase(i->first);
+				i = list.erase(i);
+			} else
+				++i;
+		}
+	}
+
+	void Clear() noexcept {
+		map.clear();
+		list.clear();
+	}
+};
+
+static StickerValueCache sticker_cache;
+
 static sqlite3_stmt *
 sticker_prepare(const char *sql)
 {
@@ -99,10 +215,25 @@ sticker_prepare(const char *sql)
 	return stmt;
 }
 
+static const char *const sticker_synchronous_levels[] = {
+	"off",
+	"normal",
+	"full",
+	"extra",
+};
+
 void
-sticker_global_init(Path path)
+sticker_global_init(Path path, const char *synchronous)
 {
 	assert(!path.IsNull());
+	assert(synchronous != nullptr);
+
+	unsigned level = 0;
+	while (!StringIsEqualIgnoreCase(sticker_synchronous_levels[level],
+					 synchronous))
+		if (++level >= ARRAY_SIZE(sticker_synchronous_levels))
+			throw FormatRuntimeError("Invalid sticker synchronous level: %s",
+						 synchronous);
 
 	int ret;
 
@@ -116,6 +247,19 @@ sticker_global_init(Path path)
 				   utf8 + "'").c_str());
 	}
 
+	/* with a write-ahead log, readers do not block the writer,
+	   and "normal" synchronization is safe */
+
+	const std::string pragmas =
+		std::string("PRAGMA journal_mode=WAL;"
+			    "PRAGMA synchronous=") +
+		sticker_synchronous_levels[level] + ";";
+	ret = sqlite3_exec(sticker_db, pragmas.c_str(),
+			   nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		throw SqliteError(sticker_db, ret,
+				  "Failed to configure the sticker database");
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create,
@@ -147,6 +291,7 @@ sticker_global_finish()
 	}
 
 	sqlite3_close(sticker_db);
+	sticker_cache.Clear();
 }
 
 bool
@@ -168,6 +313,13 @@ sticker_load_value(const char *type, const char *uri, const char *name)
 	if (StringIsEmpty(name))
 		return std::string();
 
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
+	const auto key = StickerValueCache::MakeKey(type, uri, name);
+	const std::string *cached = sticker_cache.Get(key);
+	if (cached != nullptr)
+		return *cached;
+
 	BindAll(stmt, type, uri, name);
 
 	AtScopeExit(stmt) {
@@ -179,9 +331,96 @@ sticker_load_value(const char *type, const char *uri, const char *name)
 	if (ExecuteRow(stmt))
 		value = (const char*)sqlite3_column_text(stmt, 0);
 
+	sticker_cache.Put(key, value.c_str());
 	return value;
 }
 
+/**
+ * Query one chunk of sticker_load_values() with
+ * #STICKER_SQL_GET_BATCH.
+ */
+static void
+sticker_load_batch(const char *type, const char *name,
+		   ConstBuffer<const char *> uris,
+		   void (*func)(const char *uri, const char *value,
+				void *user_data),
+		   void *user_data)
+{
+	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_GET_BATCH];
+
+	assert(!uris.empty());
+	assert(uris.size <= STICKER_BATCH_SIZE);
+
+	AtScopeExit(stmt) {
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+	};
+
+	Bind(stmt, 1, type);
+	Bind(stmt, 2, name);
+	for (unsigned i = 0; i < uris.size; ++i)
+		Bind(stmt, 3 + i, uris[i]);
+
+	std::set<std::string> found;
+
+	ExecuteForEach(stmt, [stmt, type, name, func, user_data, &found](){
+			const char *uri = (const char *)sqlite3_column_text(stmt, 0);
+			const char *value = (const char *)sqlite3_column_text(stmt, 1);
+			sticker_cache.Put(StickerValueCache::MakeKey(type, uri, name),
+					  value);
+			found.emplace(uri);
+			func(uri, value, user_data);
+		});
+
+	for (const char *uri : uris)
+		if (found.find(uri) == found.end())
+			sticker_cache.Put(StickerValueCache::MakeKey(type, uri, name),
+					  "");
+}
+
+void
+sticker_load_values(const char *type, const char *name,
+		    ConstBuffer<const char *> uris,
+		    void (*func)(const char *uri, const char *value,
+				 void *user_data),
+		    void *user_data)
+{
+	assert(sticker_enabled());
+	assert(type != nullptr);
+	assert(name != nullptr);
+	assert(func != nullptr);
+
+	if (StringIsEmpty(name))
+		return;
+
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
+	const char *misses[STICKER_BATCH_SIZE];
+	unsigned n_misses = 0;
+
+	for (const char *uri : uris) {
+		const std::string *cached =
+			sticker_cache.Get(StickerValueCache::MakeKey(type, uri,
+								     name));
+		if (cached != nullptr) {
+			if (!cached->empty())
+				func(uri, cached->c_str(), user_data);
+			continue;
+		}
+
+		misses[n_misses++] = uri;
+		if (n_misses == STICKER_BATCH_SIZE) {
+			sticker_load_batch(type, name, {misses, n_misses},
+					   func, user_data);
+			n_misses = 0;
+		}
+	}
+
+	if (n_misses > 0)
+		sticker_load_batch(type, name, {misses, n_misses},
+				   func, user_data);
+}
+
 static void
 sticker_list_values(std::map<std::string, std::string> &table,
 		    const char *type, const char *uri)
@@ -272,8 +511,12 @@ sticker_store_value(const char *type, const char *uri,
 	if (StringIsEmpty(name))
 		return;
 
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
 	if (!sticker_update_value(type, uri, name, value))
 		sticker_insert_value(type, uri, name, value);
+
+	sticker_cache.Put(StickerValueCache::MakeKey(type, uri, name), value);
 }
 
 bool
@@ -285,6 +528,10 @@ sticker_delete(const char *type, const char *uri)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
+	sticker_cache.Remove(type, uri);
+
 	BindAll(stmt, type, uri);
 
 	AtScopeExit(stmt) {
@@ -307,6 +554,10 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
+	sticker_cache.Put(StickerValueCache::MakeKey(type, uri, name), "");
+
 	BindAll(stmt, type, uri, name);
 
 	AtScopeExit(stmt) {
@@ -351,6 +602,8 @@ sticker_load(const char *type, const char *uri)
 {
 	Sticker s;
 
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
 	sticker_list_values(s.table, type, uri);
 
 	if (s.table.empty())
@@ -405,6 +658,8 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 	assert(func != nullptr);
 	assert(sticker_enabled());
 
+	const std::lock_guard<Mutex> protect(sticker_mutex);
+
 	sqlite3_stmt *const stmt = BindFind(type, base_uri, name, op, value);
 	assert(stmt != nullptr);
 
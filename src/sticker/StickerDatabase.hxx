@@ -49,14 +49,18 @@
 
 class Path;
 struct Sticker;
+template<typename T> struct ConstBuffer;
 
 /**
  * Opens the sticker database.
  *
  * Throws std::runtime_error on error.
+ *
+ * @param synchronous the SQLite "synchronous" level ("off",
+ * "normal", "full" or "extra")
  */
 void
-sticker_global_init(Path path);
+sticker_global_init(Path path, const char *synchronous="normal");
 
 /**
  * Close the sticker database.
@@ -80,6 +84,23 @@ sticker_enabled() noexcept;
 std::string
 sticker_load_value(const char *type, const char *uri, const char *name);
 
+/**
+ * Loads one value of many objects, with far fewer SQL queries than
+ * calling sticker_load_value() for each of them.
+ *
+ * Throws #SqliteError on error.
+ *
+ * @param uris the URIs of the objects
+ * @param func invoked for each object which has this sticker value
+ * (in no particular order)
+ */
+void
+sticker_load_values(const char *type, const char *name,
+		    ConstBuffer<const char *> uris,
+		    void (*func)(const char *uri, const char *value,
+				 void *user_data),
+		    void *user_data);
+
 /**
  * Sets a sticker value in the specified object.  Overwrites existing
  * values.
@@ -22,6 +22,7 @@
 #include "fs/AllocatedPath.hxx"
 #include "util/StringCompare.hxx"
 
+#include <algorithm>
 #include <set>
 #include <stdexcept>
 
@@ -32,17 +33,26 @@
  * instance and the virtual directory entries.
  */
 class CompositeDirectoryReader final : public StorageDirectoryReader {
+	/**
+	 * The #CompositeStorage::Routes snapshot which was used to
+	 * open #other; this keeps its #Storage alive even if it gets
+	 * unmounted while the directory is being read (e.g. by
+	 * "listfiles" in another thread).
+	 */
+	std::shared_ptr<const void> routes;
+
 	std::unique_ptr<StorageDirectoryReader> other;
 
 	std::set<std::string> names;
 	std::set<std::string>::const_iterator current, next;
 
 public:
-	template<typename O, typename M>
-	CompositeDirectoryReader(O &&_other, const M &map)
-		:other(std::forward<O>(_other)) {
-		for (const auto &i : map)
-			names.insert(i.first);
+	template<typename O, typename N>
+	CompositeDirectoryReader(std::shared_ptr<const void> &&_routes,
+				 O &&_other, const N &_names)
+		:routes(std::move(_routes)),
+		 other(std::forward<O>(_other)),
+		 names(_names.begin(), _names.end()) {
 		next = names.begin();
 	}
 
@@ -96,22 +106,6 @@ NextSegment(const char *&uri_r)
 	}
 }
 
-const CompositeStorage::Directory *
-CompositeStorage::Directory::Find(const char *uri) const noexcept
-{
-	const Directory *directory = this;
-	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
-			return nullptr;
-
-		directory = &i->second;
-	}
-
-	return directory;
-}
-
 CompositeStorage::Directory &
 CompositeStorage::Directory::Make(const char *uri)
 {
@@ -179,25 +173,99 @@ CompositeStorage::Directory::MapToRelativeUTF8(std::string &buffer,
 	return false;
 }
 
+CompositeStorage::Routes::FindResult
+CompositeStorage::Routes::Find(const char *uri) const noexcept
+{
+	for (const auto &i : routes) {
+		if (i.uri.empty())
+			return {i.storage.get(), uri};
+
+		const char *rest = StringAfterPrefix(uri, i.uri.c_str());
+		if (rest == nullptr)
+			continue;
+
+		if (*rest == 0)
+			return {i.storage.get(), rest};
+
+		if (*rest == '/')
+			return {i.storage.get(), rest + 1};
+	}
+
+	return {nullptr, uri};
+}
+
+const std::vector<std::string> *
+CompositeStorage::Routes::FindDirectory(const char *uri) const noexcept
+{
+	auto i = directories.find(uri);
+	if (i == directories.end())
+		return nullptr;
+
+	return &i->second;
+}
+
 CompositeStorage::CompositeStorage() noexcept
 {
+	UpdateRoutes();
 }
 
 CompositeStorage::~CompositeStorage()
 {
 }
 
+void
+CompositeStorage::CollectRoutes(Routes &r, std::string &uri,
+				const Directory &directory)
+{
+	if (directory.storage)
+		r.routes.push_back({uri, directory.storage});
+
+	auto &names = r.directories[uri];
+	names.reserve(directory.children.size());
+	for (const auto &i : directory.children)
+		names.push_back(i.first);
+
+	const size_t uri_length = uri.length();
+
+	for (const auto &i : directory.children) {
+		uri.resize(uri_length);
+		if (uri_length > 0)
+			uri.push_back('/');
+		uri.append(i.first);
+
+		CollectRoutes(r, uri, i.second);
+	}
+
+	uri.resize(uri_length);
+}
+
+void
+CompositeStorage::UpdateRoutes()
+{
+	auto r = std::make_shared<Routes>();
+
+	std::string uri;
+	CollectRoutes(*r, uri, root);
+
+	std::stable_sort(r->routes.begin(), r->routes.end(),
+			 [](const Routes::Route &a, const Routes::Route &b){
+				 return a.uri.length() > b.uri.length();
+			 });
+
+	std::atomic_store(&routes, std::shared_ptr<const Routes>(std::move(r)));
+}
+
 Storage *
 CompositeStorage::GetMount(const char *uri) noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const auto r = LoadRoutes();
 
-	auto result = FindStorage(uri);
+	auto result = r->Find(uri);
 	if (*result.uri != 0)
 		/* not a mount point */
 		return nullptr;
 
-	return result.directory->storage.get();
+	return result.storage;
 }
 
 void
@@ -207,6 +275,8 @@ CompositeStorage::Mount(const char *uri, std::unique_ptr<Storage> storage)
 
 	Directory &directory = root.Make(uri);
 	directory.storage = std::move(storage);
+
+	UpdateRoutes();
 }
 
 bool
@@ -214,48 +284,30 @@ CompositeStorage::Unmount(const char *uri)
 {
 	const std::lock_guard<Mutex> protect(mutex);
 
-	return root.Unmount(uri);
-}
-
-CompositeStorage::FindResult
-CompositeStorage::FindStorage(const char *uri) const noexcept
-{
-	FindResult result{&root, uri};
-
-	const Directory *directory = &root;
-	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
-
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
-			break;
-
-		directory = &i->second;
-		if (directory->storage != nullptr)
-			result = FindResult{directory, uri};
-	}
+	if (!root.Unmount(uri))
+		return false;
 
-	return result;
+	UpdateRoutes();
+	return true;
 }
 
 StorageFileInfo
 CompositeStorage::GetInfo(const char *uri, bool follow)
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const auto r = LoadRoutes();
 
 	std::exception_ptr error;
 
-	auto f = FindStorage(uri);
-	if (f.directory->storage != nullptr) {
+	auto f = r->Find(uri);
+	if (f.storage != nullptr) {
 		try {
-			return f.directory->storage->GetInfo(f.uri, follow);
+			return f.storage->GetInfo(f.uri, follow);
 		} catch (...) {
 			error = std::current_exception();
 		}
 	}
 
-	const Directory *directory = f.directory->Find(f.uri);
-	if (directory != nullptr)
+	if (r->FindDirectory(uri) != nullptr)
 		return StorageFileInfo(StorageFileInfo::Type::DIRECTORY);
 
 	if (error)
@@ -267,52 +319,66 @@ CompositeStorage::GetInfo(const char *uri, bool follow)
 std::unique_ptr<StorageDirectoryReader>
 CompositeStorage::OpenDirectory(const char *uri)
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const auto r = LoadRoutes();
 
-	auto f = FindStorage(uri);
-	const Directory *directory = f.directory->Find(f.uri);
-	if (directory == nullptr || directory->children.empty()) {
+	auto f = r->Find(uri);
+	const auto *directory = r->FindDirectory(uri);
+	if (directory == nullptr || directory->empty()) {
 		/* no virtual directories here */
 
-		if (f.directory->storage == nullptr)
+		if (f.storage == nullptr)
 			throw std::runtime_error("No such directory");
 
-		return f.directory->storage->OpenDirectory(f.uri);
+		auto other = f.storage->OpenDirectory(f.uri);
+		return std::make_unique<CompositeDirectoryReader>(r, std::move(other),
+								  std::set<std::string>());
 	}
 
 	std::unique_ptr<StorageDirectoryReader> other;
 
-	try {
-		other = f.directory->storage->OpenDirectory(f.uri);
-	} catch (...) {
+	if (f.storage != nullptr) {
+		try {
+			other = f.storage->OpenDirectory(f.uri);
+		} catch (...) {
+		}
 	}
 
-	return std::make_unique<CompositeDirectoryReader>(std::move(other),
-							  directory->children);
+	return std::make_unique<CompositeDirectoryReader>(r, std::move(other),
+							  *directory);
+}
+
+void
+CompositeStorage::PrefetchDirectory(const char *uri) noexcept
+{
+	const auto r = LoadRoutes();
+
+	auto f = r->Find(uri);
+	if (f.storage != nullptr)
+		f.storage->PrefetchDirectory(f.uri);
 }
 
 std::string
 CompositeStorage::MapUTF8(const char *uri) const noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const auto r = LoadRoutes();
 
-	auto f = FindStorage(uri);
-	if (f.directory->storage == nullptr)
+	auto f = r->Find(uri);
+	if (f.storage == nullptr)
 		return std::string();
 
-	return f.directory->storage->MapUTF8(f.uri);
+	return f.storage->MapUTF8(f.uri);
 }
 
 AllocatedPath
 CompositeStorage::MapFS(const char *uri) const noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const auto r = LoadRoutes();
 
-	auto f = FindStorage(uri);
-	if (f.directory->storage == nullptr)
+	auto f = r->Find(uri);
+	if (f.storage == nullptr)
 		return nullptr;
 
-	return f.directory->storage->MapFS(f.uri);
+	return f.storage->MapFS(f.uri);
 }
 
 const char *
@@ -27,6 +27,8 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 /**
  * A #Storage implementation that combines multiple other #Storage
@@ -47,7 +49,7 @@ class CompositeStorage final : public Storage {
 		 * Other Directory instances may have one, and child
 		 * mounts will be "mixed" in.
 		 */
-		std::unique_ptr<Storage> storage;
+		std::shared_ptr<Storage> storage;
 
 		std::map<std::string, Directory> children;
 
@@ -56,9 +58,6 @@ class CompositeStorage final : public Storage {
 			return storage == nullptr && children.empty();
 		}
 
-		gcc_pure
-		const Directory *Find(const char *uri) const noexcept;
-
 		Directory &Make(const char *uri);
 
 		bool Unmount() noexcept;
@@ -69,20 +68,71 @@ class CompositeStorage final : public Storage {
 				       const char *uri) const noexcept;
 	};
 
-	struct FindResult {
-		const Directory *directory;
-		const char *uri;
+	/**
+	 * An immutable snapshot of the virtual #Directory tree, which
+	 * routes URIs to a #Storage without locking #mutex.  It is
+	 * rebuilt by Mount() and Unmount() and replaced atomically;
+	 * readers hold a reference while calling the #Storage, which
+	 * keeps unmounted storages alive until they are done.
+	 */
+	struct Routes {
+		struct Route {
+			/**
+			 * The mount point; empty for the root.
+			 */
+			std::string uri;
+
+			std::shared_ptr<Storage> storage;
+		};
+
+		/**
+		 * All mount points, sorted by decreasing URI length,
+		 * so the first match is the longest.
+		 */
+		std::vector<Route> routes;
+
+		/**
+		 * Maps the URI of each virtual directory (including
+		 * the root and all mount points) to the names of its
+		 * child directories.
+		 */
+		std::unordered_map<std::string, std::vector<std::string>> directories;
+
+		struct FindResult {
+			Storage *storage;
+			const char *uri;
+		};
+
+		/**
+		 * Find the mount point with the longest matching
+		 * prefix.  FindResult::uri contains the remaining
+		 * part of the URI.
+		 */
+		gcc_pure
+		FindResult Find(const char *uri) const noexcept;
+
+		/**
+		 * @return the virtual directory with the given URI or
+		 * nullptr if there is none
+		 */
+		gcc_pure
+		const std::vector<std::string> *FindDirectory(const char *uri) const noexcept;
 	};
 
 	/**
-	 * Protects the virtual #Directory tree.
-	 *
-	 * TODO: use readers-writer lock
+	 * Protects the virtual #Directory tree and serializes
+	 * Mount()/Unmount().
 	 */
 	mutable Mutex mutex;
 
 	Directory root;
 
+	/**
+	 * The current #Routes snapshot; use std::atomic_load() and
+	 * std::atomic_store().
+	 */
+	std::shared_ptr<const Routes> routes;
+
 	mutable std::string relative_buffer;
 
 public:
@@ -120,6 +170,8 @@ public:
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(const char *uri) override;
 
+	void PrefetchDirectory(const char *uri) noexcept override;
+
 	std::string MapUTF8(const char *uri) const noexcept override;
 
 	AllocatedPath MapFS(const char *uri) const noexcept override;
@@ -146,16 +198,18 @@ private:
 		}
 	}
 
+	std::shared_ptr<const Routes> LoadRoutes() const noexcept {
+		return std::atomic_load(&routes);
+	}
+
 	/**
-	 * Follow the given URI path, and find the outermost directory
-	 * which is a #Storage mount point.  If there are no mounts,
-	 * it returns the root directory (with a nullptr "storage"
-	 * attribute, of course).  FindResult::uri contains the
-	 * remaining unused part of the URI (may be empty if all of
-	 * the URI was used).
+	 * Rebuild #routes from the #Directory tree.  The caller must
+	 * lock #mutex.
 	 */
-	gcc_pure
-	FindResult FindStorage(const char *uri) const noexcept;
+	void UpdateRoutes();
+
+	static void CollectRoutes(Routes &r, std::string &uri,
+				  const Directory &directory);
 
 	const char *MapToRelativeUTF8(const Directory &directory,
 				      const char *uri) const;
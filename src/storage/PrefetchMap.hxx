@@ -0,0 +1,116 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STORAGE_PREFETCH_MAP_HXX
+#define MPD_STORAGE_PREFETCH_MAP_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * Helper for Storage::PrefetchDirectory() implementations: a bounded
+ * container for operations (of type T) which were started in advance,
+ * keyed by URI.  Operations which have not been picked up within
+ * #TTL are handed back to the caller as "stale", so a storage that
+ * was not walked as announced does not return outdated listings.
+ *
+ * This class is thread-safe.
+ */
+template<typename T>
+class StoragePrefetchMap {
+	static constexpr std::size_t MAX_SIZE = 32;
+
+	using clock = std::chrono::steady_clock;
+
+	static constexpr clock::duration TTL = std::chrono::seconds(60);
+
+	struct Item {
+		clock::time_point time;
+		std::unique_ptr<T> operation;
+	};
+
+	Mutex mutex;
+
+	std::map<std::string, Item> map;
+
+public:
+	using List = std::list<std::unique_ptr<T>>;
+
+	/**
+	 * Is there room for another operation, and has the given URI
+	 * not been prefetched yet?
+	 */
+	bool CanAdd(const std::string &uri) noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return map.size() < MAX_SIZE && map.find(uri) == map.end();
+	}
+
+	void Add(std::string &&uri, std::unique_ptr<T> &&operation) noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		map.emplace(std::move(uri),
+			    Item{clock::now(), std::move(operation)});
+	}
+
+	/**
+	 * Remove the operation for the given URI and return it (or
+	 * nullptr).  Stale operations are moved to the given list.
+	 */
+	std::unique_ptr<T> Take(const std::string &uri, List &stale) noexcept {
+		std::unique_ptr<T> result;
+
+		const std::lock_guard<Mutex> protect(mutex);
+
+		const auto now = clock::now();
+		for (auto i = map.begin(); i != map.end();) {
+			if (i->first == uri) {
+				result = std::move(i->second.operation);
+				i = map.erase(i);
+			} else if (now - i->second.time >= TTL) {
+				stale.emplace_back(std::move(i->second.operation));
+				i = map.erase(i);
+			} else
+				++i;
+		}
+
+		return result;
+	}
+
+	/**
+	 * Remove all operations.
+	 */
+	List Clear() noexcept {
+		List result;
+
+		const std::lock_guard<Mutex> protect(mutex);
+		for (auto &i : map)
+			result.emplace_back(std::move(i.second.operation));
+		map.clear();
+		return result;
+	}
+};
+
+template<typename T>
+constexpr std::chrono::steady_clock::duration StoragePrefetchMap<T>::TTL;
+
+#endif
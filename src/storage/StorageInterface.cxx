@@ -21,6 +21,11 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 
+void
+Storage::PrefetchDirectory(gcc_unused const char *uri_utf8) noexcept
+{
+}
+
 AllocatedPath
 Storage::MapFS(gcc_unused const char *uri_utf8) const noexcept
 {
@@ -58,6 +58,15 @@ public:
 	 */
 	virtual std::unique_ptr<StorageDirectoryReader> OpenDirectory(const char *uri_utf8) = 0;
 
+	/**
+	 * A hint that OpenDirectory() will soon be called with the
+	 * given URI.  Remote storages may start requesting the
+	 * listing in the background, so a caller can keep several
+	 * requests in flight by announcing all directories it is
+	 * going to open.  The default implementation does nothing.
+	 */
+	virtual void PrefetchDirectory(const char *uri_utf8) noexcept;
+
 	/**
 	 * Map the given relative URI to an absolute URI.
 	 */
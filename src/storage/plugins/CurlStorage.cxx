@@ -22,6 +22,7 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/MemoryDirectoryReader.hxx"
+#include "storage/PrefetchMap.hxx"
 #include "lib/curl/Init.hxx"
 #include "lib/curl/Global.hxx"
 #include "lib/curl/Slist.hxx"
@@ -49,24 +50,46 @@
 
 #include <assert.h>
 
+class HttpListDirectoryOperation;
+
 class CurlStorage final : public Storage {
 	const std::string base;
 
 	CurlInit curl;
 
+	/**
+	 * PROPFIND requests started by PrefetchDirectory(), to be
+	 * picked up by OpenDirectory().  They are multiplexed over one
+	 * HTTP/2 connection (if the server supports it).  The key is
+	 * the collection URI.
+	 */
+	StoragePrefetchMap<HttpListDirectoryOperation> prefetch;
+
 public:
 	CurlStorage(EventLoop &_loop, const char *_base)
 		:base(_base),
 		 curl(_loop) {}
 
+	~CurlStorage() noexcept override;
+
 	/* virtual methods from class Storage */
 	StorageFileInfo GetInfo(const char *uri_utf8, bool follow) override;
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(const char *uri_utf8) override;
 
+	void PrefetchDirectory(const char *uri_utf8) noexcept override;
+
 	std::string MapUTF8(const char *uri_utf8) const noexcept override;
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const noexcept override;
+
+private:
+	std::string MapCollection(const char *uri_utf8) const noexcept;
+
+	/**
+	 * Cancel and free the given (maybe still running) operations.
+	 */
+	void Discard(StoragePrefetchMap<HttpListDirectoryOperation>::List &&operations) noexcept;
 };
 
 std::string
@@ -132,6 +155,17 @@ public:
 			std::rethrow_exception(postponed_error);
 	}
 
+	/**
+	 * Abort the request if it is still running.  After that, this
+	 * object may be destroyed without calling Wait().
+	 *
+	 * This method must be called in the event loop thread.
+	 */
+	void Cancel() noexcept {
+		defer_start.Cancel();
+		request.Stop();
+	}
+
 protected:
 	void SetDone() {
 		assert(!done);
@@ -285,6 +319,7 @@ public:
 	}
 
 	using BlockingHttpRequest::Wait;
+	using BlockingHttpRequest::Cancel;
 
 protected:
 	virtual void OnDavResponse(DavResponse &&r) = 0;
@@ -483,16 +518,12 @@ public:
 		:PropfindOperation(curl, uri, 1),
 		 base_path(UriPathOrSlash(uri)) {}
 
-	std::unique_ptr<StorageDirectoryReader> Perform() {
-		Wait();
-		return ToReader();
-	}
-
-private:
 	std::unique_ptr<StorageDirectoryReader> ToReader() {
 		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 	}
 
+private:
+
 	/**
 	 * Convert a "href" attribute (which may be an absolute URI)
 	 * to the base file name.
@@ -543,8 +574,8 @@ protected:
 	}
 };
 
-std::unique_ptr<StorageDirectoryReader>
-CurlStorage::OpenDirectory(const char *uri_utf8)
+inline std::string
+CurlStorage::MapCollection(const char *uri_utf8) const noexcept
 {
 	// TODO: escape the given URI
 
@@ -555,7 +586,60 @@ CurlStorage::OpenDirectory(const char *uri_utf8)
 	if (uri.back() != '/')
 		uri.push_back('/');
 
-	return HttpListDirectoryOperation(*curl, uri.c_str()).Perform();
+	return uri;
+}
+
+std::unique_ptr<StorageDirectoryReader>
+CurlStorage::OpenDirectory(const char *uri_utf8)
+{
+	const std::string uri = MapCollection(uri_utf8);
+
+	StoragePrefetchMap<HttpListDirectoryOperation>::List stale;
+	auto operation = prefetch.Take(uri, stale);
+	Discard(std::move(stale));
+
+	if (operation) {
+		operation->Wait();
+		return operation->ToReader();
+	}
+
+	HttpListDirectoryOperation operation2(*curl, uri.c_str());
+	operation2.Wait();
+	return operation2.ToReader();
+}
+
+void
+CurlStorage::PrefetchDirectory(const char *uri_utf8) noexcept
+{
+	std::string uri = MapCollection(uri_utf8);
+	if (!prefetch.CanAdd(uri))
+		return;
+
+	try {
+		auto operation = std::make_unique<HttpListDirectoryOperation>(*curl, uri.c_str());
+		prefetch.Add(std::move(uri), std::move(operation));
+	} catch (...) {
+		/* not fatal; OpenDirectory() will retry */
+	}
+}
+
+CurlStorage::~CurlStorage() noexcept
+{
+	Discard(prefetch.Clear());
+}
+
+void
+CurlStorage::Discard(StoragePrefetchMap<HttpListDirectoryOperation>::List &&operations) noexcept
+{
+	if (operations.empty())
+		return;
+
+	BlockingCall(curl->GetEventLoop(), [&operations](){
+			for (auto &i : operations)
+				i->Cancel();
+		});
+
+	operations.clear();
 }
 
 static std::unique_ptr<Storage>
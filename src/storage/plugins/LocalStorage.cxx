@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "LocalStorage.hxx"
 #include "storage/StoragePlugin.hxx"
 #include "storage/StorageInterface.hxx"
@@ -26,8 +27,24 @@
 #include "fs/DirectoryReader.hxx"
 #include "util/StringCompare.hxx"
 
+#ifdef HAVE_IO_URING_STATX
+#include "system/IoUring.hxx"
+#include <memory>
+#endif
+
 #include <string>
 
+#ifndef _WIN32
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+#ifdef _WIN32
+
 class LocalDirectoryReader final : public StorageDirectoryReader {
 	AllocatedPath base_fs;
 
@@ -44,6 +61,75 @@ public:
 	StorageFileInfo GetInfo(bool follow) override;
 };
 
+#else
+
+/**
+ * Reads the whole directory on the first Read() call, so the
+ * attributes of all entries can be obtained in one batch (with
+ * io_uring if available), relative to the directory file descriptor
+ * instead of walking the full path for each entry.
+ */
+class LocalDirectoryReader final : public StorageDirectoryReader {
+	struct Entry {
+		PathTraitsFS::string name_fs;
+		std::string name_utf8;
+
+		/**
+		 * The "d_type" from the directory entry.
+		 */
+		unsigned char type;
+
+		/**
+		 * The status of #info: 0 if it is valid, a negative
+		 * errno value if obtaining it has failed, and
+		 * #UNKNOWN if it has not been obtained yet.
+		 */
+		int status = UNKNOWN;
+
+		static constexpr int UNKNOWN = 1;
+
+		StorageFileInfo info;
+
+		Entry(const char *_name_fs, std::string &&_name_utf8,
+		      unsigned char _type) noexcept
+			:name_fs(_name_fs), name_utf8(std::move(_name_utf8)),
+			 type(_type) {}
+	};
+
+	AllocatedPath base_fs;
+
+	DirectoryReader reader;
+
+	std::vector<Entry> entries;
+
+	/**
+	 * The index of the entry returned by the next Read() call.
+	 */
+	std::size_t next = 0;
+
+	bool loaded = false;
+
+public:
+	LocalDirectoryReader(AllocatedPath &&_base_fs)
+		:base_fs(std::move(_base_fs)), reader(base_fs) {}
+
+	/* virtual methods from class StorageDirectoryReader */
+	const char *Read() noexcept override;
+	StorageFileInfo GetInfo(bool follow) override;
+
+private:
+	void Load() noexcept;
+
+	[[noreturn]]
+	void ThrowError(const Entry &e, int error) const;
+
+#ifdef HAVE_IO_URING_STATX
+	void StatBatch() noexcept;
+#endif
+};
+
+#endif
+
 class LocalStorage final : public Storage {
 	const AllocatedPath base_fs;
 	const std::string base_utf8;
@@ -94,6 +180,76 @@ Stat(Path path, bool follow)
 	return info;
 }
 
+#ifndef _WIN32
+
+static constexpr StorageFileInfo::Type
+ModeToType(unsigned mode) noexcept
+{
+	return S_ISREG(mode)
+		? StorageFileInfo::Type::REGULAR
+		: (S_ISDIR(mode)
+		   ? StorageFileInfo::Type::DIRECTORY
+		   : StorageFileInfo::Type::OTHER);
+}
+
+#ifdef HAVE_STATX
+
+/**
+ * The attributes needed by #StorageFileInfo; omitting the others
+ * saves work on some file systems.
+ */
+static constexpr unsigned STATX_STORAGE_MASK =
+	STATX_TYPE|STATX_MODE|STATX_SIZE|STATX_MTIME|STATX_INO;
+
+static StorageFileInfo
+ToStorageFileInfo(const struct statx &stx) noexcept
+{
+	StorageFileInfo info;
+	info.type = ModeToType(stx.stx_mode);
+	info.size = stx.stx_size;
+	info.mtime = std::chrono::system_clock::from_time_t(stx.stx_mtime.tv_sec);
+	info.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	info.inode = stx.stx_ino;
+	return info;
+}
+
+#endif
+
+/**
+ * Obtain the attributes of a directory entry, relative to the
+ * directory file descriptor.
+ *
+ * @return 0 on success, a negative errno value on error
+ */
+static int
+StatAt(int directory_fd, const char *name, bool follow,
+       StorageFileInfo &info) noexcept
+{
+	const int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+
+#ifdef HAVE_STATX
+	struct statx stx;
+	if (statx(directory_fd, name, flags, STATX_STORAGE_MASK, &stx) < 0)
+		return -errno;
+
+	info = ToStorageFileInfo(stx);
+#else
+	struct stat st;
+	if (fstatat(directory_fd, name, &st, flags) < 0)
+		return -errno;
+
+	info.type = ModeToType(st.st_mode);
+	info.size = st.st_size;
+	info.mtime = std::chrono::system_clock::from_time_t(st.st_mtime);
+	info.device = st.st_dev;
+	info.inode = st.st_ino;
+#endif
+
+	return 0;
+}
+
+#endif
+
 std::string
 LocalStorage::MapUTF8(const char *uri_utf8) const noexcept
 {
@@ -153,6 +309,8 @@ SkipNameFS(PathTraitsFS::const_pointer_type name_fs) noexcept
 		 (name_fs[1] == '.' && name_fs[2] == 0));
 }
 
+#ifdef _WIN32
+
 const char *
 LocalDirectoryReader::Read() noexcept
 {
@@ -177,6 +335,230 @@ LocalDirectoryReader::GetInfo(bool follow)
 	return Stat(base_fs / reader.GetEntry(), follow);
 }
 
+#else
+
+/**
+ * Can this "d_type" value only be a file which the database ignores?
+ * Entries of this type don't need to be stat()ed at all.
+ */
+static constexpr bool
+IsSpecialType(unsigned char type) noexcept
+{
+	return type != DT_UNKNOWN && type != DT_REG &&
+		type != DT_DIR && type != DT_LNK;
+}
+
+#ifdef HAVE_IO_URING_STATX
+
+/**
+ * The batch size of LocalDirectoryReader::StatBatch().
+ */
+static constexpr unsigned STAT_BATCH_SIZE = 64;
+
+/**
+ * Don't bother with io_uring in directories smaller than this.
+ */
+static constexpr std::size_t MIN_STAT_BATCH = 8;
+
+/**
+ * The #IoUring instance used by StatBatch() in this thread.
+ */
+static thread_local struct {
+	std::unique_ptr<IoUring> ring;
+
+	/**
+	 * Was io_uring or IORING_OP_STATX found to be unavailable?
+	 * Then StatBatch() is disabled in this thread.
+	 */
+	bool unavailable = false;
+
+	IoUring *Get() noexcept {
+		if (!ring && !unavailable) {
+			try {
+				ring = std::make_unique<IoUring>(STAT_BATCH_SIZE);
+			} catch (...) {
+				unavailable = true;
+			}
+		}
+
+		return ring.get();
+	}
+
+	void Disable() noexcept {
+		/* this also discards stale completions */
+		ring.reset();
+		unavailable = true;
+	}
+} stat_ring;
+
+#endif
+
+inline void
+LocalDirectoryReader::Load() noexcept
+{
+	loaded = true;
+
+	while (reader.ReadEntry()) {
+		const Path name_fs = reader.GetEntry();
+		if (SkipNameFS(name_fs.c_str()))
+			continue;
+
+		try {
+			entries.emplace_back(name_fs.c_str(),
+					     name_fs.ToUTF8Throw(),
+					     reader.GetEntryType());
+		} catch (...) {
+			continue;
+		}
+
+		auto &e = entries.back();
+		if (IsSpecialType(e.type)) {
+			/* sockets, FIFOs and devices are ignored
+			   anyway */
+			e.info.type = StorageFileInfo::Type::OTHER;
+			e.info.size = 0;
+			e.info.mtime = {};
+			e.info.device = e.info.inode = 0;
+			e.status = 0;
+		}
+	}
+
+#ifdef HAVE_IO_URING_STATX
+	if (entries.size() >= MIN_STAT_BATCH)
+		StatBatch();
+#endif
+}
+
+#ifdef HAVE_IO_URING_STATX
+
+inline void
+LocalDirectoryReader::StatBatch() noexcept
+{
+	IoUring *ring = stat_ring.Get();
+	if (ring == nullptr)
+		return;
+
+	const int directory_fd = reader.GetFD();
+
+	struct statx buffers[STAT_BATCH_SIZE];
+	Entry *batch[STAT_BATCH_SIZE];
+
+	auto i = entries.begin();
+	while (i != entries.end()) {
+		unsigned n = 0;
+		for (; i != entries.end() && n < STAT_BATCH_SIZE; ++i) {
+			if (i->status != Entry::UNKNOWN)
+				continue;
+
+			auto *sqe = ring->GetSqe();
+			if (sqe == nullptr)
+				break;
+
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = directory_fd;
+			sqe->addr = (uint64_t)i->name_fs.c_str();
+			sqe->len = STATX_STORAGE_MASK;
+			sqe->off = (uint64_t)&buffers[n];
+			sqe->user_data = n;
+
+			batch[n++] = &*i;
+		}
+
+		if (n == 0)
+			break;
+
+		if (ring->Enter(n, IORING_ENTER_GETEVENTS) < 0) {
+			/* leave the rest to GetInfo() */
+			stat_ring.Disable();
+			return;
+		}
+
+		bool rejected = false;
+		for (unsigned j = 0; j < n; ++j) {
+			const struct io_uring_cqe *cqe;
+			while ((cqe = ring->PeekCqe()) == nullptr) {
+				if (ring->Enter(1, IORING_ENTER_GETEVENTS) < 0) {
+					stat_ring.Disable();
+					return;
+				}
+			}
+
+			const unsigned k = cqe->user_data;
+			const int res = cqe->res;
+			ring->SeenCqe();
+
+			if (k >= n)
+				continue;
+
+			if (res == 0) {
+				batch[k]->info = ToStorageFileInfo(buffers[k]);
+				batch[k]->status = 0;
+			} else if (res == -EINVAL || res == -EOPNOTSUPP)
+				/* the kernel doesn't support
+				   IORING_OP_STATX; leave this entry
+				   to GetInfo() */
+				rejected = true;
+			else
+				batch[k]->status = res;
+		}
+
+		if (rejected) {
+			stat_ring.Disable();
+			return;
+		}
+	}
+}
+
+#endif
+
+const char *
+LocalDirectoryReader::Read() noexcept
+{
+	if (!loaded)
+		Load();
+
+	if (next >= entries.size())
+		return nullptr;
+
+	return entries[next++].name_utf8.c_str();
+}
+
+void
+LocalDirectoryReader::ThrowError(const Entry &e, int error) const
+{
+	throw FormatErrno(error, "Failed to access %s",
+			  (base_fs / Path::FromFS(e.name_fs.c_str())).ToUTF8().c_str());
+}
+
+StorageFileInfo
+LocalDirectoryReader::GetInfo(bool follow)
+{
+	assert(next > 0);
+
+	auto &e = entries[next - 1];
+
+	if (!follow) {
+		StorageFileInfo info;
+		const int status = StatAt(reader.GetFD(), e.name_fs.c_str(),
+					  false, info);
+		if (status < 0)
+			ThrowError(e, -status);
+		return info;
+	}
+
+	/* the batch follows symlinks (like stat()) */
+	if (e.status == Entry::UNKNOWN)
+		e.status = StatAt(reader.GetFD(), e.name_fs.c_str(),
+				  true, e.info);
+
+	if (e.status < 0)
+		ThrowError(e, -e.status);
+
+	return e.info;
+}
+
+#endif
+
 std::unique_ptr<Storage>
 CreateLocalStorage(Path base_fs)
 {
@@ -22,6 +22,7 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/MemoryDirectoryReader.hxx"
+#include "storage/PrefetchMap.hxx"
 #include "lib/nfs/Blocking.hxx"
 #include "lib/nfs/Base.hxx"
 #include "lib/nfs/Lease.hxx"
@@ -48,6 +49,8 @@ extern "C" {
 #include <sys/stat.h>
 #include <fcntl.h>
 
+class NfsListDirectoryOperation;
+
 class NfsStorage final
 	: public Storage, NfsLease {
 
@@ -59,6 +62,12 @@ class NfsStorage final
 
 	const std::string server, export_name;
 
+	/**
+	 * Directory listings started by PrefetchDirectory(), to be
+	 * picked up by OpenDirectory().  The key is the NFS path.
+	 */
+	StoragePrefetchMap<NfsListDirectoryOperation> prefetch;
+
 	NfsConnection *connection;
 
 	DeferEvent defer_connect;
@@ -80,16 +89,15 @@ public:
 		nfs_init(_loop);
 	}
 
-	~NfsStorage() {
-		BlockingCall(GetEventLoop(), [this](){ Disconnect(); });
-		nfs_finish();
-	}
+	~NfsStorage();
 
 	/* virtual methods from class Storage */
 	StorageFileInfo GetInfo(const char *uri_utf8, bool follow) override;
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(const char *uri_utf8) override;
 
+	void PrefetchDirectory(const char *uri_utf8) noexcept override;
+
 	std::string MapUTF8(const char *uri_utf8) const noexcept override;
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const noexcept override;
@@ -133,6 +141,12 @@ private:
 		return defer_connect.GetEventLoop();
 	}
 
+	/**
+	 * Wait for the given (already started) operations to
+	 * complete and free them.
+	 */
+	static void Discard(StoragePrefetchMap<NfsListDirectoryOperation>::List &&operations) noexcept;
+
 	void SetState(State _state) noexcept {
 		assert(GetEventLoop().IsInside());
 
@@ -336,14 +350,14 @@ Copy(StorageFileInfo &info, const struct nfsdirent &ent)
 }
 
 class NfsListDirectoryOperation final : public BlockingNfsOperation {
-	const char *const path;
+	const std::string path;
 
 	MemoryStorageDirectoryReader::List entries;
 
 public:
 	NfsListDirectoryOperation(NfsConnection &_connection,
-				  const char *_path)
-		:BlockingNfsOperation(_connection), path(_path) {}
+				  std::string &&_path)
+		:BlockingNfsOperation(_connection), path(std::move(_path)) {}
 
 	std::unique_ptr<StorageDirectoryReader> ToReader() {
 		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
@@ -351,7 +365,7 @@ public:
 
 protected:
 	void Start() override {
-		connection.OpenDirectory(path, *this);
+		connection.OpenDirectory(path.c_str(), *this);
 	}
 
 	void HandleResult(gcc_unused unsigned status,
@@ -397,16 +411,75 @@ NfsListDirectoryOperation::CollectEntries(struct nfsdir *dir)
 std::unique_ptr<StorageDirectoryReader>
 NfsStorage::OpenDirectory(const char *uri_utf8)
 {
-	const std::string path = UriToNfsPath(uri_utf8);
+	std::string path = UriToNfsPath(uri_utf8);
+
+	StoragePrefetchMap<NfsListDirectoryOperation>::List stale;
+	auto prefetched = prefetch.Take(path, stale);
+	Discard(std::move(stale));
+
+	if (prefetched) {
+		prefetched->Finish();
+		return prefetched->ToReader();
+	}
 
 	WaitConnected();
 
-	NfsListDirectoryOperation operation(*connection, path.c_str());
+	NfsListDirectoryOperation operation(*connection, std::move(path));
 	operation.Run();
 
 	return operation.ToReader();
 }
 
+void
+NfsStorage::PrefetchDirectory(const char *uri_utf8) noexcept
+{
+	{
+		/* only if the connection is already established;
+		   the first OpenDirectory() call will take care of
+		   that */
+		const std::lock_guard<Mutex> protect(mutex);
+		if (state != State::READY)
+			return;
+	}
+
+	try {
+		std::string path = UriToNfsPath(uri_utf8);
+		if (!prefetch.CanAdd(path))
+			return;
+
+		auto operation = std::make_unique<NfsListDirectoryOperation>(*connection,
+									     std::string(path));
+		operation->Begin();
+		prefetch.Add(std::move(path), std::move(operation));
+	} catch (...) {
+		/* not fatal; OpenDirectory() will retry */
+	}
+}
+
+NfsStorage::~NfsStorage()
+{
+	/* the prefetch operations hold a lease on the connection;
+	   they must be finished before disconnecting */
+	Discard(prefetch.Clear());
+
+	BlockingCall(GetEventLoop(), [this](){ Disconnect(); });
+	nfs_finish();
+}
+
+void
+NfsStorage::Discard(StoragePrefetchMap<NfsListDirectoryOperation>::List &&operations) noexcept
+{
+	for (auto &i : operations) {
+		try {
+			i->Finish();
+		} catch (...) {
+			/* ignore errors of operations nobody wants */
+		}
+	}
+
+	operations.clear();
+}
+
 static std::unique_ptr<Storage>
 CreateNfsStorageURI(EventLoop &event_loop, const char *base)
 {
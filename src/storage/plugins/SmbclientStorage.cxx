@@ -22,25 +22,35 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "fs/Traits.hxx"
 #include "thread/Mutex.hxx"
 #include "system/Error.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringCompare.hxx"
-#include "util/ScopeExit.hxx"
 
 #include <libsmbclient.h>
 
+class SmbclientStorage;
+
 class SmbclientDirectoryReader final : public StorageDirectoryReader {
+	SmbclientStorage &storage;
+
 	const std::string base;
-	const unsigned handle;
+	SMBCFILE *const handle;
 
-	const char *name;
+	/**
+	 * A copy of the current entry's name; the #smbc_dirent
+	 * buffer belongs to the context and may be overwritten by
+	 * another directory reader.
+	 */
+	std::string name;
 
 public:
-	SmbclientDirectoryReader(std::string &&_base, unsigned _handle)
-		:base(std::move(_base)), handle(_handle) {}
+	SmbclientDirectoryReader(SmbclientStorage &_storage,
+				 std::string &&_base, SMBCFILE &_handle)
+		:storage(_storage),
+		 base(std::move(_base)), handle(&_handle) {}
 
 	virtual ~SmbclientDirectoryReader();
 
@@ -50,19 +60,22 @@ public:
 };
 
 class SmbclientStorage final : public Storage {
+	friend class SmbclientDirectoryReader;
+
 	const std::string base;
 
-	SMBCCTX *const ctx;
+	/**
+	 * Protects #ctx, which may be used by several update threads.
+	 * Other storages and all #SmbclientInputStream instances
+	 * have their own contexts and are not blocked by this one.
+	 */
+	Mutex mutex;
 
-public:
-	SmbclientStorage(const char *_base, SMBCCTX *_ctx)
-		:base(_base), ctx(_ctx) {}
+	SmbclientContext ctx;
 
-	virtual ~SmbclientStorage() {
-		smbclient_mutex.lock();
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
-	}
+public:
+	SmbclientStorage(const char *_base, SmbclientContext &&_ctx)
+		:base(_base), ctx(std::move(_ctx)) {}
 
 	/* virtual methods from class Storage */
 	StorageFileInfo GetInfo(const char *uri_utf8, bool follow) override;
@@ -92,13 +105,13 @@ SmbclientStorage::MapToRelativeUTF8(const char *uri_utf8) const noexcept
 }
 
 static StorageFileInfo
-GetInfo(const char *path)
+GetInfo(SmbclientContext &ctx, Mutex &mutex, const char *path)
 {
 	struct stat st;
 
 	{
-		const std::lock_guard<Mutex> protect(smbclient_mutex);
-		if (smbc_stat(path, &st) != 0)
+		const std::lock_guard<Mutex> protect(mutex);
+		if (ctx.Stat(path, st) != 0)
 			throw MakeErrno("Failed to access file");
 	}
 
@@ -121,7 +134,7 @@ StorageFileInfo
 SmbclientStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow)
 {
 	const std::string mapped = MapUTF8(uri_utf8);
-	return ::GetInfo(mapped.c_str());
+	return ::GetInfo(ctx, mutex, mapped.c_str());
 }
 
 std::unique_ptr<StorageDirectoryReader>
@@ -129,17 +142,18 @@ SmbclientStorage::OpenDirectory(const char *uri_utf8)
 {
 	std::string mapped = MapUTF8(uri_utf8);
 
-	int handle;
+	SMBCFILE *handle;
 
 	{
-		const std::lock_guard<Mutex> protect(smbclient_mutex);
-		handle = smbc_opendir(mapped.c_str());
-		if (handle < 0)
+		const std::lock_guard<Mutex> protect(mutex);
+		handle = ctx.OpenDirectory(mapped.c_str());
+		if (handle == nullptr)
 			throw MakeErrno("Failed to open directory");
 	}
 
-	return std::make_unique<SmbclientDirectoryReader>(std::move(mapped.c_str()),
-							  handle);
+	return std::make_unique<SmbclientDirectoryReader>(*this,
+							  std::move(mapped),
+							  *handle);
 }
 
 gcc_pure
@@ -153,21 +167,21 @@ SkipNameFS(const char *name) noexcept
 
 SmbclientDirectoryReader::~SmbclientDirectoryReader()
 {
-	smbclient_mutex.lock();
-	smbc_close(handle);
-	smbclient_mutex.unlock();
+	const std::lock_guard<Mutex> protect(storage.mutex);
+	storage.ctx.CloseDirectory(*handle);
 }
 
 const char *
 SmbclientDirectoryReader::Read() noexcept
 {
-	const std::lock_guard<Mutex> protect(smbclient_mutex);
-
-	struct smbc_dirent *e;
-	while ((e = smbc_readdir(handle)) != nullptr) {
-		name = e->name;
-		if (!SkipNameFS(name))
-			return name;
+	const std::lock_guard<Mutex> protect(storage.mutex);
+
+	const struct smbc_dirent *e;
+	while ((e = storage.ctx.ReadDirectory(*handle)) != nullptr) {
+		if (!SkipNameFS(e->name)) {
+			name = e->name;
+			return name.c_str();
+		}
 	}
 
 	return nullptr;
@@ -176,8 +190,9 @@ SmbclientDirectoryReader::Read() noexcept
 StorageFileInfo
 SmbclientDirectoryReader::GetInfo(gcc_unused bool follow)
 {
-	const std::string path = PathTraitsUTF8::Build(base.c_str(), name);
-	return ::GetInfo(path.c_str());
+	const std::string path = PathTraitsUTF8::Build(base.c_str(),
+						       name.c_str());
+	return ::GetInfo(storage.ctx, storage.mutex, path.c_str());
 }
 
 static std::unique_ptr<Storage>
@@ -188,18 +203,8 @@ CreateSmbclientStorageURI(gcc_unused EventLoop &event_loop, const char *base)
 
 	SmbclientInit();
 
-	const std::lock_guard<Mutex> protect(smbclient_mutex);
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr)
-		throw MakeErrno("smbc_new_context() failed");
-
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		AtScopeExit(ctx) { smbc_free_context(ctx, 1); };
-		throw MakeErrno("smbc_new_context() failed");
-	}
-
-	return std::make_unique<SmbclientStorage>(base, ctx2);
+	return std::make_unique<SmbclientStorage>(base,
+						  SmbclientContext::New());
 }
 
 const StoragePlugin smbclient_storage_plugin = {
@@ -21,6 +21,11 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef _WIN32
 
 gcc_const
 static unsigned
@@ -46,3 +51,32 @@ GetProcessUptimeS()
 }
 
 #endif
+
+std::chrono::steady_clock::duration
+GetThreadCPUTime() noexcept
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time,
+			    &kernel_time, &user_time))
+		return std::chrono::steady_clock::duration::zero();
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel_time.dwLowDateTime;
+	k.HighPart = kernel_time.dwHighDateTime;
+	u.LowPart = user_time.dwLowDateTime;
+	u.HighPart = user_time.dwHighDateTime;
+
+	/* FILETIME counts in units of 100 nanoseconds */
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds((k.QuadPart + u.QuadPart) * 100));
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return std::chrono::steady_clock::duration::zero();
+
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(ts.tv_sec) +
+									    std::chrono::nanoseconds(ts.tv_nsec));
+#else
+	return std::chrono::steady_clock::duration::zero();
+#endif
+}
@@ -22,6 +22,8 @@
 
 #include "util/Compiler.h"
 
+#include <chrono>
+
 #ifdef _WIN32
 
 /**
@@ -33,4 +35,11 @@ GetProcessUptimeS();
 
 #endif
 
+/**
+ * Returns the CPU time consumed by the calling thread so far, or
+ * zero if the platform does not support measuring it.
+ */
+std::chrono::steady_clock::duration
+GetThreadCPUTime() noexcept;
+
 #endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2013-2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "IoUring.hxx"
+#include "Error.hxx"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+
+static void *
+MapRing(int fd, size_t size, off_t offset)
+{
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_POPULATE, fd, offset);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map io_uring");
+
+	return p;
+}
+
+template<typename T>
+static T *
+RingPointer(void *ring, unsigned offset) noexcept
+{
+	return (T *)((char *)ring + offset);
+}
+
+IoUring::IoUring(unsigned entries)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	fd = UniqueFileDescriptor(int(syscall(__NR_io_uring_setup,
+					      entries, &params)));
+	if (!fd.IsDefined())
+		throw MakeErrno("io_uring_setup() failed");
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_ring_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+	sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	sq_ring = MapRing(fd.Get(), sq_ring_size, IORING_OFF_SQ_RING);
+
+	try {
+		cq_ring = MapRing(fd.Get(), cq_ring_size, IORING_OFF_CQ_RING);
+	} catch (...) {
+		munmap(sq_ring, sq_ring_size);
+		throw;
+	}
+
+	try {
+		sqes = (struct io_uring_sqe *)
+			MapRing(fd.Get(), sqes_size, IORING_OFF_SQES);
+	} catch (...) {
+		munmap(cq_ring, cq_ring_size);
+		munmap(sq_ring, sq_ring_size);
+		throw;
+	}
+
+	sq_head = RingPointer<unsigned>(sq_ring, params.sq_off.head);
+	sq_tail = RingPointer<unsigned>(sq_ring, params.sq_off.tail);
+	sq_array = RingPointer<unsigned>(sq_ring, params.sq_off.array);
+	sq_mask = *RingPointer<unsigned>(sq_ring, params.sq_off.ring_mask);
+	sq_entries = params.sq_entries;
+	sqe_tail = *sq_tail;
+
+	cq_head = RingPointer<unsigned>(cq_ring, params.cq_off.head);
+	cq_tail = RingPointer<unsigned>(cq_ring, params.cq_off.tail);
+	cq_mask = *RingPointer<unsigned>(cq_ring, params.cq_off.ring_mask);
+	cqes = RingPointer<struct io_uring_cqe>(cq_ring, params.cq_off.cqes);
+}
+
+IoUring::~IoUring() noexcept
+{
+	munmap(sqes, sqes_size);
+	munmap(cq_ring, cq_ring_size);
+	munmap(sq_ring, sq_ring_size);
+}
+
+struct io_uring_sqe *
+IoUring::GetSqe() noexcept
+{
+	const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (sqe_tail - head >= sq_entries)
+		return nullptr;
+
+	const unsigned index = sqe_tail & sq_mask;
+	sq_array[index] = index;
+	++sqe_tail;
+
+	struct io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+int
+IoUring::Enter(unsigned min_complete, unsigned flags,
+	       const void *arg, size_t arg_size) noexcept
+{
+	const unsigned to_submit = sqe_tail - *sq_tail;
+	__atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+	return syscall(__NR_io_uring_enter, fd.Get(), to_submit,
+		       min_complete, flags, arg, arg_size);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2013-2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IO_URING_HXX
+#define IO_URING_HXX
+
+#include "UniqueFileDescriptor.hxx"
+#include "util/Compiler.h"
+
+#include <linux/io_uring.h>
+
+#include <stddef.h>
+
+/**
+ * A class that wraps a Linux io_uring instance, using the system
+ * calls directly (without liburing).
+ */
+class IoUring {
+	UniqueFileDescriptor fd;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size;
+
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_head, *sq_tail, *sq_array;
+	unsigned sq_mask, sq_entries;
+
+	unsigned *cq_head, *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/**
+	 * Our copy of the submission queue tail; entries up to here
+	 * have been prepared, but not yet published to the kernel by
+	 * Enter().
+	 */
+	unsigned sqe_tail;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit IoUring(unsigned entries);
+
+	~IoUring() noexcept;
+
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+
+	/**
+	 * Obtain a cleared submission queue entry.
+	 *
+	 * @return nullptr if the submission queue is full
+	 */
+	struct io_uring_sqe *GetSqe() noexcept;
+
+	/**
+	 * Submit all prepared submission queue entries and wait for
+	 * completions.
+	 *
+	 * @param min_complete wait until at least this number of
+	 * completions is available
+	 * @param arg an optional argument (see io_uring_enter(2))
+	 * @return the number of submitted entries or -1 on error
+	 */
+	int Enter(unsigned min_complete, unsigned flags,
+		  const void *arg=nullptr, size_t arg_size=0) noexcept;
+
+	/**
+	 * @return the oldest completion queue entry or nullptr if
+	 * there is none
+	 */
+	gcc_pure
+	const struct io_uring_cqe *PeekCqe() const noexcept {
+		const unsigned head = *cq_head;
+		if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+			return nullptr;
+
+		return &cqes[head & cq_mask];
+	}
+
+	/**
+	 * Release the entry returned by PeekCqe().
+	 */
+	void SeenCqe() noexcept {
+		__atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+	}
+};
+
+#endif
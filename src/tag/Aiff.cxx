@@ -38,8 +38,8 @@ struct aiff_chunk_header {
 	uint32_t size;
 };
 
-size_t
-aiff_seek_id3(InputStream &is)
+bool
+aiff_read_header(InputStream &is)
 {
 	/* seek to the beginning and read the AIFF header */
 
@@ -48,11 +48,21 @@ aiff_seek_id3(InputStream &is)
 	aiff_header header;
 	is.ReadFull(&header, sizeof(header));
 	if (memcmp(header.id, "FORM", 4) != 0 ||
-	    (is.KnownSize() && FromBE32(header.size) > is.GetSize()) ||
-	    (memcmp(header.format, "AIFF", 4) != 0 &&
-	     memcmp(header.format, "AIFC", 4) != 0))
+	    (is.KnownSize() && FromBE32(header.size) > is.GetSize()))
 		throw std::runtime_error("Not an AIFF file");
 
+	if (memcmp(header.format, "AIFC", 4) == 0)
+		return true;
+
+	if (memcmp(header.format, "AIFF", 4) != 0)
+		throw std::runtime_error("Not an AIFF file");
+
+	return false;
+}
+
+size_t
+aiff_seek_chunk(InputStream &is, const char *id)
+{
 	while (true) {
 		/* read the chunk header */
 
@@ -65,7 +75,7 @@ aiff_seek_id3(InputStream &is)
 			   underflow when casting to off_t */
 			throw std::runtime_error("AIFF chunk is too large");
 
-		if (memcmp(chunk.id, "ID3 ", 4) == 0)
+		if (memcmp(chunk.id, id, 4) == 0)
 			/* found it! */
 			return size;
 
@@ -76,3 +86,10 @@ aiff_seek_id3(InputStream &is)
 		is.Skip(size);
 	}
 }
+
+size_t
+aiff_seek_id3(InputStream &is)
+{
+	aiff_read_header(is);
+	return aiff_seek_chunk(is, "ID3 ");
+}
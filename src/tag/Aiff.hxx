@@ -29,6 +29,33 @@
 
 class InputStream;
 
+/**
+ * Rewinds the #InputStream and reads the AIFF (or AIFF-C) header.
+ *
+ * Throws std::runtime_error on error.
+ *
+ * @param is a locked #InputStream
+ * @return true if this is an AIFF-C file
+ */
+bool
+aiff_read_header(InputStream &is);
+
+/**
+ * Skips chunks until one with the given id is found.  Call
+ * aiff_read_header() first; this function can be called again to
+ * find more chunks after the current one has been read or skipped
+ * completely.
+ *
+ * Throws std::runtime_error on error (e.g. if there is no such
+ * chunk).
+ *
+ * @param is a locked #InputStream
+ * @param id the four-character chunk id
+ * @return the size of the chunk, whose contents can now be read
+ */
+size_t
+aiff_seek_chunk(InputStream &is, const char *id);
+
 /**
  * Seeks the AIFF file to the ID3 chunk.
  *
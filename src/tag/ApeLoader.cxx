@@ -22,6 +22,7 @@
 #include "input/InputStream.hxx"
 #include "util/StringView.hxx"
 
+#include <algorithm>
 #include <memory>
 
 #include <stdint.h>
@@ -37,6 +38,119 @@ struct ApeFooter {
 	unsigned char reserved[8];
 };
 
+/**
+ * Item flags ("type of information") announcing binary data.
+ */
+static constexpr unsigned long APE_ITEM_BINARY = 0x1 << 1;
+static constexpr unsigned long APE_ITEM_TYPE_MASK = 0x3 << 1;
+
+/**
+ * Refuse to load text items larger than this.
+ */
+static constexpr size_t APE_MAX_ITEM_SIZE = 1024 * 1024;
+
+/**
+ * The maximum length of an item key, including the null terminator.
+ */
+static constexpr size_t APE_MAX_KEY_SIZE = 256;
+
+/**
+ * A read buffer which walks the items of an APE tag without loading
+ * the whole tag (which may contain large pictures) into memory.
+ * Binary items can be skipped by seeking over them.
+ */
+class ApeTagReader {
+	static constexpr size_t DEFAULT_CAPACITY = 8192;
+
+	InputStream &is;
+
+	/**
+	 * The number of tag bytes which have not yet been read into
+	 * the buffer.
+	 */
+	size_t remaining;
+
+	size_t capacity;
+	std::unique_ptr<char[]> buffer;
+
+	size_t head = 0, tail = 0;
+
+public:
+	ApeTagReader(InputStream &_is, size_t _remaining) noexcept
+		:is(_is), remaining(_remaining),
+		 capacity(std::min(DEFAULT_CAPACITY, remaining)),
+		 buffer(new char[capacity]) {}
+
+	/**
+	 * @return the number of tag bytes which have not yet been
+	 * consumed
+	 */
+	size_t GetRemaining() const noexcept {
+		return tail - head + remaining;
+	}
+
+	/**
+	 * Ensure that at least the given number of bytes is
+	 * available in the buffer.  This invalidates pointers
+	 * returned by previous calls.
+	 *
+	 * Throws on I/O error.
+	 *
+	 * @return a pointer to the beginning of the available data
+	 * or nullptr if the tag ends too early
+	 */
+	const char *Need(size_t n) {
+		const size_t available = tail - head;
+		if (available >= n)
+			return &buffer[head];
+
+		if (n > available + remaining)
+			return nullptr;
+
+		if (n > capacity) {
+			std::unique_ptr<char[]> new_buffer(new char[n]);
+			std::copy_n(&buffer[head], available, new_buffer.get());
+			buffer = std::move(new_buffer);
+			capacity = n;
+		} else if (head > 0)
+			memmove(&buffer[0], &buffer[head], available);
+
+		head = 0;
+		tail = available;
+
+		const size_t nbytes = std::min(capacity - tail, remaining);
+		is.ReadFull(&buffer[tail], nbytes);
+		tail += nbytes;
+		remaining -= nbytes;
+
+		return &buffer[0];
+	}
+
+	/**
+	 * Skip the given number of bytes; data which has not yet
+	 * been read is skipped by seeking.
+	 *
+	 * Throws on I/O error.
+	 */
+	void Skip(size_t n) {
+		assert(n <= GetRemaining());
+
+		const size_t available = tail - head;
+		if (n <= available) {
+			head += n;
+			return;
+		}
+
+		n -= available;
+		head = tail = 0;
+
+		if (n > 0) {
+			is.Seek(is.GetOffset() + n);
+			remaining -= n;
+		}
+	}
+};
+
 bool
 tag_ape_scan(InputStream &is, ApeTagCallback callback)
 try {
@@ -57,48 +171,59 @@ try {
 	/* find beginning of ape tag */
 	size_t remaining = FromLE32(footer.length);
 	if (remaining <= sizeof(footer) + 10 ||
-	    /* refuse to load more than one megabyte of tag data */
-	    remaining > 1024 * 1024)
+	    remaining > is.GetSize())
 		return false;
 
 	is.Seek(is.GetSize() - remaining);
 
-	/* read tag into buffer */
 	remaining -= sizeof(footer);
 	assert(remaining > 10);
 
-	std::unique_ptr<char[]> buffer(new char[remaining]);
-	is.ReadFull(buffer.get(), remaining);
+	ApeTagReader reader(is, remaining);
 
 	/* read tags */
 	unsigned n = FromLE32(footer.count);
-	const char *p = buffer.get();
-	while (n-- && remaining > 10) {
+	while (n-- && reader.GetRemaining() > 10) {
+		const char *p = reader.Need(8);
+		if (p == nullptr)
+			break;
+
 		size_t size = FromLE32(*(const uint32_t *)p);
-		p += 4;
-		remaining -= 4;
-		unsigned long flags = FromLE32(*(const uint32_t *)p);
-		p += 4;
-		remaining -= 4;
+		unsigned long flags = FromLE32(*(const uint32_t *)(p + 4));
+		reader.Skip(8);
 
 		/* get the key */
-		const char *key = p;
-		const char *key_end = (const char *)memchr(p, '\0', remaining);
+		const size_t key_window = std::min(APE_MAX_KEY_SIZE,
+						   reader.GetRemaining());
+		p = reader.Need(key_window);
+		if (p == nullptr)
+			break;
+
+		const char *key_end = (const char *)memchr(p, '\0',
+							   key_window);
 		if (key_end == nullptr)
 			break;
 
-		p = key_end + 1;
-		remaining -= p - key;
+		const size_t key_size = key_end + 1 - p;
 
 		/* get the value */
-		if (remaining < size)
+		if (reader.GetRemaining() - key_size < size)
 			break;
 
-		if (!callback(flags, key, {p, size}))
+		if ((flags & APE_ITEM_TYPE_MASK) == APE_ITEM_BINARY ||
+		    size > APE_MAX_ITEM_SIZE) {
+			/* skip binary items (e.g. cover art) without
+			   reading them */
+			reader.Skip(key_size + size);
+			continue;
+		}
+
+		p = reader.Need(key_size + size);
+		if (p == nullptr ||
+		    !callback(flags, p, {p + key_size, size}))
 			break;
 
-		p += size;
-		remaining -= size;
+		reader.Skip(key_size + size);
 	}
 
 	return true;
@@ -29,7 +29,9 @@ typedef std::function<bool(unsigned long flags, const char *key,
 			   StringView value)> ApeTagCallback;
 
 /**
- * Scans the APE tag values from a file.
+ * Scans the APE tag values from a file.  Binary items (e.g. cover
+ * art) are skipped without reading them.  The value passed to the
+ * callback points into a read buffer and is not null-terminated.
  *
  * @return false if the file could not be opened or if no APE tag is
  * present
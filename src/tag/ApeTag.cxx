@@ -24,8 +24,6 @@
 #include "Handler.hxx"
 #include "util/StringView.hxx"
 
-#include <string>
-
 #include <string.h>
 
 static constexpr struct tag_table ape_tags[] = {
@@ -59,15 +57,13 @@ ForEachValue(const char *value, const char *end, C &&callback)
 			break;
 
 		if (n > value)
-			callback(value);
+			callback(StringView(value, n));
 
 		value = n + 1;
 	}
 
-	if (value < end) {
-		const std::string value2(value, end);
-		callback(value2.c_str());
-	}
+	if (value < end)
+		callback(StringView(value, end));
 }
 
 /**
@@ -86,7 +82,7 @@ tag_ape_import_item(unsigned long flags,
 	const auto end = value.end();
 
 	if (handler.WantPair())
-		ForEachValue(begin, end, [&handler, key](const char *_value) {
+		ForEachValue(begin, end, [&handler, key](StringView _value) {
 				handler.OnPair(key, _value);
 			});
 
@@ -94,7 +90,7 @@ tag_ape_import_item(unsigned long flags,
 	if (type == TAG_NUM_OF_ITEM_TYPES)
 		return false;
 
-	ForEachValue(begin, end, [&handler, type](const char *_value) {
+	ForEachValue(begin, end, [&handler, type](StringView _value) {
 			handler.OnTag(type, _value);
 		});
 
@@ -35,8 +35,6 @@ TagBuilder::TagBuilder(const Tag &other) noexcept
 {
 	items.reserve(other.num_items);
 
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
-
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
 }
@@ -46,13 +44,16 @@ TagBuilder::TagBuilder(Tag &&other) noexcept
 {
 	/* move all TagItem pointers from the Tag object; we don't
 	   need to contact the tag pool, because all we do is move
-	   references */
+	   references (unless the array is shared with other Tag
+	   objects) */
+	other.UnshareItems();
 	items.reserve(other.num_items);
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
+	if (other.items != nullptr)
+		Tag::FreeItems(other.items);
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
 }
 
@@ -65,7 +66,6 @@ TagBuilder::operator=(const TagBuilder &other) noexcept
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
 	for (auto i : items)
 		tag_pool_dup_item(i);
 
@@ -90,14 +90,17 @@ TagBuilder::operator=(Tag &&other) noexcept
 
 	/* move all TagItem pointers from the Tag object; we don't
 	   need to contact the tag pool, because all we do is move
-	   references */
+	   references (unless the array is shared with other Tag
+	   objects) */
+	other.UnshareItems();
 	items.clear();
 	items.reserve(other.num_items);
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
+	if (other.items != nullptr)
+		Tag::FreeItems(other.items);
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
 
 	return *this;
@@ -124,10 +127,12 @@ TagBuilder::Commit(Tag &tag) noexcept
 	   vector::clear() call is important to detach them from this
 	   object */
 	const unsigned n_items = items.size();
-	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
-	items.clear();
+	if (n_items > 0) {
+		tag.num_items = n_items;
+		tag.items = Tag::AllocateItems(n_items);
+		std::copy_n(items.begin(), n_items, tag.items);
+		items.clear();
+	}
 
 	/* now ensure that this object is fresh (will not delete any
 	   items because we've already moved them out) */
@@ -177,7 +182,6 @@ TagBuilder::Complement(const Tag &other) noexcept
 
 	items.reserve(items.size() + other.num_items);
 
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!present[item->type])
@@ -188,14 +192,7 @@ TagBuilder::Complement(const Tag &other) noexcept
 void
 TagBuilder::AddItemUnchecked(TagType type, StringView value) noexcept
 {
-	TagItem *i;
-
-	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		i = tag_pool_get_item(type, value);
-	}
-
-	items.push_back(i);
+	items.push_back(tag_pool_get_item(type, value));
 }
 
 inline void
@@ -241,11 +238,8 @@ TagBuilder::AddEmptyItem(TagType type) noexcept
 void
 TagBuilder::RemoveAll() noexcept
 {
-	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		for (auto i : items)
-			tag_pool_put_item(i);
-	}
+	for (auto i : items)
+		tag_pool_put_item(i);
 
 	items.clear();
 }
@@ -20,11 +20,9 @@
 #include "Handler.hxx"
 #include "Builder.hxx"
 #include "AudioFormat.hxx"
-#include "util/ASCII.hxx"
+#include "util/CharUtil.hxx"
 #include "util/StringFormat.hxx"
 
-#include <stdlib.h>
-
 void
 NullTagHandler::OnAudioFormat(gcc_unused AudioFormat af) noexcept
 {
@@ -37,22 +35,28 @@ AddTagHandler::OnDuration(SongTime duration) noexcept
 }
 
 void
-AddTagHandler::OnTag(TagType type, const char *value) noexcept
+AddTagHandler::OnTag(TagType type, StringView value) noexcept
 {
 	if (type == TAG_TRACK || type == TAG_DISC) {
 		/* filter out this extra data and leading zeroes */
-		char *end;
-		unsigned n = strtoul(value, &end, 10);
-		if (value != end)
-			tag.AddItem(type, StringFormat<21>("%u", n));
+		value.StripLeft();
+		if (value.empty() || !IsDigitASCII(value.front()))
+			return;
+
+		unsigned n = 0;
+		for (; !value.empty() && IsDigitASCII(value.front());
+		     value.pop_front())
+			n = n * 10 + unsigned(value.front() - '0');
+
+		tag.AddItem(type, StringFormat<21>("%u", n));
 	} else
 		tag.AddItem(type, value);
 }
 
 void
-FullTagHandler::OnPair(const char *name, gcc_unused const char *value) noexcept
+FullTagHandler::OnPair(StringView name, gcc_unused StringView value) noexcept
 {
-	if (StringEqualsCaseASCII(name, "cuesheet"))
+	if (name.EqualsIgnoreCase("cuesheet"))
 		tag.SetHasPlaylist(true);
 }
 
@@ -22,6 +22,8 @@
 
 #include "Type.h"
 #include "Chrono.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
 #include "util/Compiler.h"
 
 struct AudioFormat;
@@ -38,6 +40,7 @@ public:
 	static constexpr unsigned WANT_TAG = 0x2;
 	static constexpr unsigned WANT_PAIR = 0x4;
 	static constexpr unsigned WANT_AUDIO_FORMAT = 0x8;
+	static constexpr unsigned WANT_PICTURE = 0x10;
 
 	explicit TagHandler(unsigned _want_mask) noexcept
 		:want_mask(_want_mask) {}
@@ -61,6 +64,10 @@ public:
 		return want_mask & WANT_AUDIO_FORMAT;
 	}
 
+	bool WantPicture() const noexcept {
+		return want_mask & WANT_PICTURE;
+	}
+
 	/**
 	 * Declare the duration of a song.  Do not call
 	 * this when the duration could not be determined, because
@@ -71,16 +78,20 @@ public:
 	/**
 	 * A tag has been read.
 	 *
-	 * @param the value of the tag; the pointer will become
-	 * invalid after returning
+	 * @param the value of the tag; it is not necessarily
+	 * null-terminated, and the pointer will become invalid after
+	 * returning
 	 */
-	virtual void OnTag(TagType type, const char *value) noexcept = 0;
+	virtual void OnTag(TagType type, StringView value) noexcept = 0;
 
 	/**
 	 * A name-value pair has been read.  It is the codec specific
 	 * representation of tags.
+	 *
+	 * Both strings are not necessarily null-terminated, and the
+	 * pointers will become invalid after returning.
 	 */
-	virtual void OnPair(const char *key, const char *value) noexcept = 0;
+	virtual void OnPair(StringView key, StringView value) noexcept = 0;
 
 	/**
 	 * Declare the audio format of a song.
@@ -98,6 +109,19 @@ public:
 	 * too expensive.
 	 */
 	virtual void OnAudioFormat(AudioFormat af) noexcept = 0;
+
+	/**
+	 * An embedded picture (e.g. the album cover) has been read.
+	 * Scanners call this only if WantPicture() is true, and
+	 * possibly more than once.
+	 *
+	 * @param mime_type an optional MIME type string (may be
+	 * nullptr)
+	 * @param buffer the image data; the pointer will become
+	 * invalid after returning
+	 */
+	virtual void OnPicture(const char *mime_type,
+			       ConstBuffer<void> buffer) noexcept = 0;
 };
 
 class NullTagHandler : public TagHandler {
@@ -107,10 +131,12 @@ public:
 
 	void OnDuration(gcc_unused SongTime duration) noexcept override {}
 	void OnTag(gcc_unused TagType type,
-		   gcc_unused const char *value) noexcept override {}
-	void OnPair(gcc_unused const char *key,
-		    gcc_unused const char *value) noexcept override {}
+		   gcc_unused StringView value) noexcept override {}
+	void OnPair(gcc_unused StringView key,
+		    gcc_unused StringView value) noexcept override {}
 	void OnAudioFormat(AudioFormat af) noexcept override;
+	void OnPicture(gcc_unused const char *mime_type,
+		       gcc_unused ConstBuffer<void> buffer) noexcept override {}
 };
 
 /**
@@ -130,7 +156,7 @@ public:
 		:AddTagHandler(0, _builder) {}
 
 	void OnDuration(SongTime duration) noexcept override;
-	void OnTag(TagType type, const char *value) noexcept override;
+	void OnTag(TagType type, StringView value) noexcept override;
 };
 
 /**
@@ -154,7 +180,7 @@ public:
 				AudioFormat *_audio_format=nullptr) noexcept
 		:FullTagHandler(0, _builder, _audio_format) {}
 
-	void OnPair(const char *key, const char *value) noexcept override;
+	void OnPair(StringView key, StringView value) noexcept override;
 	void OnAudioFormat(AudioFormat af) noexcept override;
 };
 
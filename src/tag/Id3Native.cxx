@@ -0,0 +1,703 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Id3Native.hxx"
+#include "Handler.hxx"
+#include "Table.hxx"
+#include "Id3MusicBrainz.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringStrip.hxx"
+#include "util/Macros.hxx"
+
+#include <id3tag.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	/* flags in the tag header */
+	ID3V2_FLAG_UNSYNCHRONISATION = 0x80,
+	ID3V2_FLAG_EXTENDED_HEADER = 0x40,
+
+	/* frame format flags (ID3v2.3.0 section 3.3.1) */
+	ID3V23_FRAME_COMPRESSION = 0x80,
+	ID3V23_FRAME_ENCRYPTION = 0x40,
+	ID3V23_FRAME_GROUPING = 0x20,
+
+	/* frame format flags (ID3v2.4.0 section 4.1.2) */
+	ID3V24_FRAME_GROUPING = 0x40,
+	ID3V24_FRAME_COMPRESSION = 0x08,
+	ID3V24_FRAME_ENCRYPTION = 0x04,
+	ID3V24_FRAME_UNSYNCHRONISATION = 0x02,
+	ID3V24_FRAME_DATA_LENGTH = 0x01,
+};
+
+enum {
+	ID3_ENCODING_LATIN1 = 0,
+	ID3_ENCODING_UTF16 = 1,
+	ID3_ENCODING_UTF16BE = 2,
+	ID3_ENCODING_UTF8 = 3,
+};
+
+static constexpr size_t ID3V2_FRAME_HEADER_SIZE = 10;
+
+/**
+ * The text frames imported by this parser, in the order used by
+ * scan_id3_tag().  "COMM" is not a text frame, but it is listed here
+ * to preserve that order.
+ */
+static constexpr struct {
+	char id[5];
+	TagType type;
+} id3v2_text_frames[] = {
+	{ "TPE1", TAG_ARTIST },
+	{ "TPE2", TAG_ALBUM_ARTIST },
+	{ "TSOP", TAG_ARTIST_SORT },
+	{ "TSOA", TAG_ALBUM_SORT },
+	{ "TSO2", TAG_ALBUM_ARTIST_SORT },
+	{ "TIT2", TAG_TITLE },
+	{ "TALB", TAG_ALBUM },
+	{ "TRCK", TAG_TRACK },
+	{ "TDRC", TAG_DATE },
+	{ "TDOR", TAG_ORIGINAL_DATE },
+	{ "TCON", TAG_GENRE },
+	{ "TCOM", TAG_COMPOSER },
+	{ "TPE3", TAG_PERFORMER },
+	{ "TPE4", TAG_PERFORMER },
+	{ "COMM", TAG_COMMENT },
+	{ "TPOS", TAG_DISC },
+	{ "TPUB", TAG_LABEL },
+};
+
+static constexpr uint32_t
+ReadBE32(const uint8_t *p) noexcept
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+		(uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static constexpr bool
+IsSyncsafe32(const uint8_t *p) noexcept
+{
+	return ((p[0] | p[1] | p[2] | p[3]) & 0x80) == 0;
+}
+
+static constexpr uint32_t
+ReadSyncsafe32(const uint8_t *p) noexcept
+{
+	return (uint32_t(p[0]) << 21) | (uint32_t(p[1]) << 14) |
+		(uint32_t(p[2]) << 7) | uint32_t(p[3]);
+}
+
+static constexpr bool
+IsValidFrameIdChar(uint8_t ch) noexcept
+{
+	return (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+}
+
+gcc_pure
+static bool
+IsValidFrameId(const uint8_t *p) noexcept
+{
+	return IsValidFrameIdChar(p[0]) && IsValidFrameIdChar(p[1]) &&
+		IsValidFrameIdChar(p[2]) && IsValidFrameIdChar(p[3]);
+}
+
+size_t
+id3v2_native_query(const uint8_t *header) noexcept
+{
+	if (memcmp(header, "ID3", 3) != 0)
+		return 0;
+
+	/* ID3v2.2 uses 3 character frame ids; leave it to
+	   libid3tag */
+	const unsigned version = header[3];
+	if ((version != 3 && version != 4) || header[4] == 0xff)
+		return 0;
+
+	if (header[5] & ID3V2_FLAG_UNSYNCHRONISATION)
+		return 0;
+
+	if (!IsSyncsafe32(header + 6))
+		return 0;
+
+	return ID3V2_HEADER_SIZE + ReadSyncsafe32(header + 6);
+}
+
+namespace {
+
+struct Id3v2Frame {
+	const uint8_t *id;
+
+	uint8_t format_flags;
+
+	ConstBuffer<uint8_t> data;
+
+	bool IsId(const char *other) const noexcept {
+		return memcmp(id, other, 4) == 0;
+	}
+};
+
+class Id3v2Frames {
+	const unsigned version;
+
+	const uint8_t *const begin, *const end;
+
+public:
+	Id3v2Frames(unsigned _version,
+		    const uint8_t *_begin, const uint8_t *_end) noexcept
+		:version(_version), begin(_begin), end(_end) {}
+
+	/**
+	 * Does the frame have the given id?  The ID3v2.3 names of
+	 * the date frames are translated to their ID3v2.4
+	 * counterparts, just like libid3tag does.
+	 */
+	gcc_pure
+	bool Match(const Id3v2Frame &frame, const char *id) const noexcept {
+		if (version == 3) {
+			if (strcmp(id, "TDRC") == 0)
+				return frame.IsId("TYER");
+			if (strcmp(id, "TDOR") == 0)
+				return frame.IsId("TORY");
+		}
+
+		return frame.IsId(id);
+	}
+
+	/**
+	 * Determine the payload of the frame, i.e. skip the extra
+	 * bytes announced by the format flags.
+	 *
+	 * @return false if this frame cannot be parsed by this class
+	 */
+	bool GetPayload(const Id3v2Frame &frame,
+			ConstBuffer<uint8_t> &payload) const noexcept {
+		payload = frame.data;
+
+		size_t skip = 0;
+		if (version == 3) {
+			if (frame.format_flags & (ID3V23_FRAME_COMPRESSION|
+						  ID3V23_FRAME_ENCRYPTION))
+				return false;
+
+			if (frame.format_flags & ID3V23_FRAME_GROUPING)
+				++skip;
+		} else {
+			if (frame.format_flags & (ID3V24_FRAME_COMPRESSION|
+						  ID3V24_FRAME_ENCRYPTION|
+						  ID3V24_FRAME_UNSYNCHRONISATION))
+				return false;
+
+			if (frame.format_flags & ID3V24_FRAME_GROUPING)
+				++skip;
+			if (frame.format_flags & ID3V24_FRAME_DATA_LENGTH)
+				skip += 4;
+		}
+
+		if (skip > payload.size)
+			return false;
+
+		payload.skip_front(skip);
+		return true;
+	}
+
+	/**
+	 * Invoke the given function for each frame.
+	 *
+	 * @return false if the tag is malformed
+	 */
+	template<typename F>
+	bool ForEach(F &&f) const noexcept {
+		const uint8_t *p = begin;
+		while (size_t(end - p) >= ID3V2_FRAME_HEADER_SIZE) {
+			if (p[0] == 0)
+				/* padding */
+				break;
+
+			if (!IsValidFrameId(p))
+				return false;
+
+			size_t size;
+			if (version == 4) {
+				if (!IsSyncsafe32(p + 4))
+					return false;
+				size = ReadSyncsafe32(p + 4);
+			} else
+				size = ReadBE32(p + 4);
+
+			const uint8_t *id = p;
+			const uint8_t format_flags = p[9];
+			p += ID3V2_FRAME_HEADER_SIZE;
+
+			if (size > size_t(end - p))
+				return false;
+
+			f(Id3v2Frame{id, format_flags, {p, size}});
+			p += size;
+		}
+
+		return true;
+	}
+
+	template<typename F>
+	void ForEach(const char *id, F &&f) const noexcept {
+		ForEach([this, id, &f](const Id3v2Frame &frame){
+				ConstBuffer<uint8_t> payload;
+				if (Match(frame, id) &&
+				    GetPayload(frame, payload))
+					f(payload);
+			});
+	}
+
+	/**
+	 * Check whether this class is able to parse all frames it is
+	 * going to import.
+	 */
+	gcc_pure
+	bool Validate(bool want_picture) const noexcept {
+		bool valid = true;
+		const bool well_formed = ForEach([this, want_picture, &valid](const Id3v2Frame &frame){
+				if (frame.IsId("SEEK")) {
+					/* following SEEK frames is
+					   implemented only by
+					   tag_id3_load() */
+					valid = false;
+					return;
+				}
+
+				ConstBuffer<uint8_t> payload;
+				if (IsKnown(frame, want_picture) &&
+				    !GetPayload(frame, payload))
+					valid = false;
+			});
+
+		return well_formed && valid;
+	}
+
+private:
+	gcc_pure
+	bool IsKnown(const Id3v2Frame &frame,
+		     bool want_picture) const noexcept {
+		for (const auto &i : id3v2_text_frames)
+			if (Match(frame, i.id))
+				return true;
+
+		return frame.IsId("TXXX") || frame.IsId("UFID") ||
+			(want_picture && frame.IsId("APIC"));
+	}
+};
+
+}
+
+static void
+AppendUTF8(std::string &dest, unsigned ch) noexcept
+{
+	if (ch < 0x80) {
+		dest.push_back(char(ch));
+	} else if (ch < 0x800) {
+		dest.push_back(char(0xc0 | (ch >> 6)));
+		dest.push_back(char(0x80 | (ch & 0x3f)));
+	} else if (ch < 0x10000) {
+		dest.push_back(char(0xe0 | (ch >> 12)));
+		dest.push_back(char(0x80 | ((ch >> 6) & 0x3f)));
+		dest.push_back(char(0x80 | (ch & 0x3f)));
+	} else {
+		dest.push_back(char(0xf0 | (ch >> 18)));
+		dest.push_back(char(0x80 | ((ch >> 12) & 0x3f)));
+		dest.push_back(char(0x80 | ((ch >> 6) & 0x3f)));
+		dest.push_back(char(0x80 | (ch & 0x3f)));
+	}
+}
+
+static const uint8_t *
+DecodeUTF16(const uint8_t *p, const uint8_t *end, bool big_endian,
+	    std::string &dest) noexcept
+{
+	if (end - p >= 2) {
+		/* byte order mark */
+		if (p[0] == 0xfe && p[1] == 0xff) {
+			big_endian = true;
+			p += 2;
+		} else if (p[0] == 0xff && p[1] == 0xfe) {
+			big_endian = false;
+			p += 2;
+		}
+	}
+
+	const auto read = [big_endian](const uint8_t *q){
+		return big_endian
+			? (unsigned(q[0]) << 8) | q[1]
+			: (unsigned(q[1]) << 8) | q[0];
+	};
+
+	while (end - p >= 2) {
+		unsigned ch = read(p);
+		p += 2;
+
+		if (ch == 0)
+			return p;
+
+		if (ch >= 0xd800 && ch < 0xdc00) {
+			/* high surrogate */
+			if (end - p < 2)
+				break;
+
+			const unsigned low = read(p);
+			if (low < 0xdc00 || low >= 0xe000) {
+				AppendUTF8(dest, 0xfffd);
+				continue;
+			}
+
+			p += 2;
+			ch = 0x10000 + ((ch - 0xd800) << 10) + (low - 0xdc00);
+		} else if (ch >= 0xdc00 && ch < 0xe000)
+			/* stray low surrogate */
+			ch = 0xfffd;
+
+		AppendUTF8(dest, ch);
+	}
+
+	/* no terminator: the string ends with the buffer; a trailing
+	   odd byte is ignored */
+	return end;
+}
+
+/**
+ * Decode one null-terminated string and convert it to UTF-8.
+ *
+ * @return a pointer to the end of the string (after the terminator),
+ * or nullptr if the encoding is not known
+ */
+static const uint8_t *
+DecodeString(uint8_t encoding, const uint8_t *p, const uint8_t *end,
+	     std::string &dest) noexcept
+{
+	dest.clear();
+
+	switch (encoding) {
+	case ID3_ENCODING_LATIN1:
+		for (; p != end && *p != 0; ++p)
+			AppendUTF8(dest, *p);
+		return p == end ? p : p + 1;
+
+	case ID3_ENCODING_UTF16:
+	case ID3_ENCODING_UTF16BE:
+		return DecodeUTF16(p, end, true, dest);
+
+	case ID3_ENCODING_UTF8:
+		{
+			const auto *z = (const uint8_t *)
+				memchr(p, 0, end - p);
+			const uint8_t *string_end = z != nullptr ? z : end;
+			dest.append((const char *)p, string_end - p);
+			return z != nullptr ? z + 1 : end;
+		}
+
+	default:
+		return nullptr;
+	}
+}
+
+static void
+ImportGenreReference(unsigned long number, TagHandler &handler) noexcept
+{
+	const id3_ucs4_t *ucs4 = id3_genre_index(number);
+	if (ucs4 == nullptr)
+		return;
+
+	id3_utf8_t *utf8 = id3_ucs4_utf8duplicate(ucs4);
+	if (utf8 == nullptr)
+		return;
+
+	handler.OnTag(TAG_GENRE, (const char *)utf8);
+	free(utf8);
+}
+
+/**
+ * Resolve numeric genre references; ID3v2.4 uses plain numbers,
+ * ID3v2.3 the "(17)" syntax, optionally followed by a refinement
+ * which is preferred over the references.
+ */
+static void
+ImportGenre(const char *value, TagHandler &handler) noexcept
+{
+	char *endptr;
+	if (*value >= '0' && *value <= '9') {
+		const unsigned long number = strtoul(value, &endptr, 10);
+		if (*endptr == 0) {
+			ImportGenreReference(number, handler);
+			return;
+		}
+	}
+
+	const char *p = value;
+	unsigned long references[8];
+	unsigned n_references = 0;
+	while (*p == '(' && p[1] != '(') {
+		const char *close = strchr(p, ')');
+		if (close == nullptr)
+			break;
+
+		if (strncmp(p, "(RX)", 4) == 0 || strncmp(p, "(CR)", 4) == 0) {
+			/* "Remix" and "Cover" are not in the genre
+			   table */
+			p = close + 1;
+			continue;
+		}
+
+		const unsigned long number = strtoul(p + 1, &endptr, 10);
+		if (endptr == p + 1 || endptr != close)
+			break;
+
+		if (n_references < ARRAY_SIZE(references))
+			references[n_references++] = number;
+		p = close + 1;
+	}
+
+	if (*p == '(' && p[1] == '(')
+		/* escaped parenthesis */
+		++p;
+
+	if (*p != 0)
+		handler.OnTag(TAG_GENRE, p);
+	else
+		for (unsigned i = 0; i < n_references; ++i)
+			ImportGenreReference(references[i], handler);
+}
+
+static void
+ImportValue(TagType type, std::string &value, TagHandler &handler) noexcept
+{
+	const char *p = Strip(&value[0]);
+	if (*p == 0)
+		return;
+
+	if (type == TAG_GENRE)
+		ImportGenre(p, handler);
+	else
+		handler.OnTag(type, p);
+}
+
+/**
+ * Import a "Text information frame" (ID3v2.4.0 section 4.2).
+ */
+static void
+ImportTextFrame(ConstBuffer<uint8_t> payload, TagType type,
+		std::string &buffer, TagHandler &handler) noexcept
+{
+	if (payload.empty())
+		return;
+
+	const uint8_t encoding = payload.front();
+	const uint8_t *p = payload.data + 1, *const end = payload.end();
+	while (p != nullptr && p != end) {
+		p = DecodeString(encoding, p, end, buffer);
+		if (p == nullptr)
+			break;
+
+		ImportValue(type, buffer, handler);
+	}
+}
+
+/**
+ * Import a "Comment frame" (ID3v2.4.0 section 4.10): skip the
+ * language and the short content description, import the text.
+ */
+static void
+ImportCommentFrame(ConstBuffer<uint8_t> payload, std::string &buffer,
+		   TagHandler &handler) noexcept
+{
+	if (payload.size < 4)
+		return;
+
+	const uint8_t encoding = payload.front();
+	const uint8_t *const end = payload.end();
+	const uint8_t *p = DecodeString(encoding, payload.data + 4, end,
+					buffer);
+	if (p == nullptr)
+		return;
+
+	DecodeString(encoding, p, end, buffer);
+	ImportValue(TAG_COMMENT, buffer, handler);
+}
+
+/**
+ * Import all known MusicBrainz tags from TXXX frames.
+ */
+static void
+ImportUserText(ConstBuffer<uint8_t> payload, std::string &buffer,
+	       TagHandler &handler) noexcept
+{
+	if (payload.empty())
+		return;
+
+	const uint8_t encoding = payload.front();
+	const uint8_t *const end = payload.end();
+	const uint8_t *p = DecodeString(encoding, payload.data + 1, end,
+					buffer);
+	if (p == nullptr)
+		return;
+
+	const std::string name = buffer;
+	DecodeString(encoding, p, end, buffer);
+
+	handler.OnPair(name.c_str(), buffer.c_str());
+
+	const TagType type = tag_table_lookup(musicbrainz_txxx_tags,
+					      name.c_str());
+	if (type != TAG_NUM_OF_ITEM_TYPES)
+		handler.OnTag(type, buffer.c_str());
+}
+
+/**
+ * Imports the MusicBrainz TrackId from the UFID tag.
+ */
+static void
+ImportUfid(ConstBuffer<uint8_t> payload, TagHandler &handler) noexcept
+{
+	static constexpr char owner[] = "http://musicbrainz.org";
+	if (payload.size <= sizeof(owner) ||
+	    memcmp(payload.data, owner, sizeof(owner)) != 0)
+		return;
+
+	payload.skip_front(sizeof(owner));
+	const std::string value((const char *)payload.data, payload.size);
+	handler.OnTag(TAG_MUSICBRAINZ_TRACKID, value.c_str());
+}
+
+/**
+ * Handle the APIC ("attached picture") frames: prefer the front
+ * cover, or else the first picture.
+ */
+static void
+ImportPicture(const Id3v2Frames &frames, TagHandler &handler) noexcept
+{
+	ConstBuffer<uint8_t> best = nullptr;
+	bool found_front_cover = false;
+
+	frames.ForEach("APIC", [&](ConstBuffer<uint8_t> payload){
+			if (found_front_cover || payload.size < 4)
+				return;
+
+			/* skip encoding and MIME type to find the
+			   picture type */
+			const auto *z = (const uint8_t *)
+				memchr(payload.data + 1, 0, payload.size - 1);
+			if (z == nullptr || z + 1 == payload.end())
+				return;
+
+			if (best.IsNull())
+				best = payload;
+
+			if (z[1] == 3 /* front cover */) {
+				best = payload;
+				found_front_cover = true;
+			}
+		});
+
+	if (best.IsNull())
+		return;
+
+	const uint8_t encoding = best.front();
+	const char *mime_type = (const char *)best.data + 1;
+	if (strcmp(mime_type, "-->") == 0)
+		/* this is a URL, not image data */
+		return;
+
+	std::string description;
+	const uint8_t *data = DecodeString(encoding,
+					   (const uint8_t *)mime_type
+					   + strlen(mime_type) + 2,
+					   best.end(), description);
+	if (data == nullptr || data == best.end())
+		return;
+
+	handler.OnPicture(mime_type, {data, size_t(best.end() - data)});
+}
+
+bool
+id3v2_native_scan(ConstBuffer<uint8_t> tag, TagHandler &handler) noexcept
+{
+	if (tag.size < ID3V2_HEADER_SIZE)
+		return false;
+
+	const size_t size = id3v2_native_query(tag.data);
+	if (size == 0 || size > tag.size)
+		return false;
+
+	const unsigned version = tag.data[3];
+	const uint8_t *p = tag.data + ID3V2_HEADER_SIZE;
+	const uint8_t *const end = tag.data + size;
+
+	if (tag.data[5] & ID3V2_FLAG_EXTENDED_HEADER) {
+		if (end - p < 4)
+			return false;
+
+		size_t extended_size;
+		if (version == 4) {
+			/* ID3v2.4: the size includes the size field */
+			if (!IsSyncsafe32(p))
+				return false;
+			extended_size = ReadSyncsafe32(p);
+		} else
+			extended_size = 4 + ReadBE32(p);
+
+		if (extended_size < 4 || extended_size > size_t(end - p))
+			return false;
+
+		p += extended_size;
+	}
+
+	const Id3v2Frames frames(version, p, end);
+	if (!frames.Validate(handler.WantPicture()))
+		return false;
+
+	/* this buffer is reused for all strings to avoid repeated
+	   allocations */
+	std::string buffer;
+
+	for (const auto &i : id3v2_text_frames) {
+		if (i.type == TAG_COMMENT)
+			frames.ForEach(i.id, [&](ConstBuffer<uint8_t> payload){
+					ImportCommentFrame(payload, buffer,
+							   handler);
+				});
+		else
+			frames.ForEach(i.id, [&](ConstBuffer<uint8_t> payload){
+					ImportTextFrame(payload, i.type,
+							buffer, handler);
+				});
+	}
+
+	frames.ForEach("TXXX", [&](ConstBuffer<uint8_t> payload){
+			ImportUserText(payload, buffer, handler);
+		});
+
+	frames.ForEach("UFID", [&](ConstBuffer<uint8_t> payload){
+			ImportUfid(payload, handler);
+		});
+
+	if (handler.WantPicture())
+		ImportPicture(frames, handler);
+
+	return true;
+}
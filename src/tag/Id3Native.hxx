@@ -0,0 +1,65 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_ID3_NATIVE_HXX
+#define MPD_TAG_ID3_NATIVE_HXX
+
+#include "util/Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+class TagHandler;
+
+/**
+ * The size of an ID3v2 tag header.
+ */
+static constexpr size_t ID3V2_HEADER_SIZE = 10;
+
+/**
+ * Check whether the given buffer starts with an ID3v2 tag header
+ * which can be handled by id3v2_native_scan().
+ *
+ * @param header a buffer of #ID3V2_HEADER_SIZE bytes
+ * @return the total size of the tag (including the header), or 0 if
+ * there is no tag or if it needs to be parsed by libid3tag
+ */
+gcc_pure
+size_t
+id3v2_native_query(const uint8_t *header) noexcept;
+
+/**
+ * A lightweight ID3v2.3/ID3v2.4 parser which looks only at the frames
+ * MPD knows about and converts their strings directly to UTF-8,
+ * instead of letting libid3tag decode the whole tag.  Pictures are
+ * only evaluated if TagHandler::WantPicture() returns true.
+ *
+ * Nothing is passed to the #TagHandler if the tag uses a feature
+ * this parser does not implement (unsynchronisation, compression,
+ * encryption, SEEK frames) or if it is malformed; the caller should
+ * then fall back to libid3tag.
+ *
+ * @param tag the complete tag, including the header
+ * @return true if the tag has been parsed
+ */
+bool
+id3v2_native_scan(ConstBuffer<uint8_t> tag, TagHandler &handler) noexcept;
+
+#endif
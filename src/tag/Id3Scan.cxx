@@ -19,6 +19,7 @@
 
 #include "Id3Scan.hxx"
 #include "Id3Load.hxx"
+#include "Id3Native.hxx"
 #include "Handler.hxx"
 #include "Table.hxx"
 #include "Builder.hxx"
@@ -27,10 +28,15 @@
 #include "util/Alloc.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/StringStrip.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
 #include "Log.hxx"
 
 #include <id3tag.h>
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <exception>
 
@@ -286,6 +292,60 @@ tag_id3_import_ufid(const struct id3_tag *id3_tag,
 	}
 }
 
+/**
+ * Handle an APIC ("attached picture") frame: prefer the front cover,
+ * or else the first picture.
+ */
+static void
+tag_id3_handle_apic(const struct id3_tag *id3_tag,
+		    TagHandler &handler) noexcept
+{
+	if (!handler.WantPicture())
+		return;
+
+	const id3_frame *best = nullptr;
+	for (unsigned i = 0;; ++i) {
+		const id3_frame *frame = id3_tag_findframe(id3_tag, "APIC", i);
+		if (frame == nullptr)
+			break;
+
+		if (best == nullptr)
+			best = frame;
+
+		const id3_field *type_field = id3_frame_field(frame, 2);
+		if (type_field != nullptr &&
+		    id3_field_getint(type_field) == 3 /* front cover */) {
+			best = frame;
+			break;
+		}
+	}
+
+	if (best == nullptr)
+		return;
+
+	const id3_field *mime_type_field = id3_frame_field(best, 1);
+	if (mime_type_field == nullptr)
+		return;
+
+	const char *mime_type =
+		(const char *)id3_field_getlatin1(mime_type_field);
+	if (mime_type != nullptr && strcmp(mime_type, "-->") == 0)
+		/* this is a URL, not image data */
+		return;
+
+	const id3_field *data_field = id3_frame_field(best, 4);
+	if (data_field == nullptr ||
+	    data_field->type != ID3_FIELD_TYPE_BINARYDATA)
+		return;
+
+	id3_length_t size;
+	const id3_byte_t *data = id3_field_getbinarydata(data_field, &size);
+	if (data == nullptr || size == 0)
+		return;
+
+	handler.OnPicture(mime_type, {data, size});
+}
+
 void
 scan_id3_tag(const struct id3_tag *tag, TagHandler &handler) noexcept
 {
@@ -326,6 +386,7 @@ scan_id3_tag(const struct id3_tag *tag, TagHandler &handler) noexcept
 
 	tag_id3_import_musicbrainz(tag, handler);
 	tag_id3_import_ufid(tag, handler);
+	tag_id3_handle_apic(tag, handler);
 }
 
 Tag
@@ -337,12 +398,49 @@ tag_id3_import(const struct id3_tag *tag) noexcept
 	return tag_builder.Commit();
 }
 
+/**
+ * Attempt to parse an ID3v2 tag at the current stream position with
+ * id3v2_native_scan(), which is a lot cheaper than letting libid3tag
+ * decode all frames.
+ *
+ * Throws on I/O error.
+ *
+ * @return true if the tag has been parsed, false if the caller should
+ * fall back to libid3tag
+ */
+static bool
+tag_id3_native_scan(InputStream &is, TagHandler &handler)
+{
+	const std::lock_guard<Mutex> protect(is.mutex);
+
+	uint8_t header[ID3V2_HEADER_SIZE];
+	is.ReadFull(header, sizeof(header));
+
+	const size_t size = id3v2_native_query(header);
+	if (size == 0)
+		return false;
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+	uint8_t *end = std::copy_n(header, sizeof(header), buffer.get());
+	is.ReadFull(end, size - sizeof(header));
+
+	return id3v2_native_scan({buffer.get(), size}, handler);
+}
+
 bool
 tag_id3_scan(InputStream &is, TagHandler &handler) noexcept
 {
+	try {
+		if (tag_id3_native_scan(is, handler))
+			return true;
+	} catch (...) {
+		/* let tag_id3_load() deal with it */
+	}
+
 	UniqueId3Tag tag;
 
 	try {
+		is.LockRewind();
 		tag = tag_id3_load(is);
 		if (!tag)
 			return false;
@@ -45,6 +45,14 @@ public:
 		return ~None();
 	}
 
+	constexpr bool operator==(TagMask other) const {
+		return value == other.value;
+	}
+
+	constexpr bool operator!=(TagMask other) const {
+		return value != other.value;
+	}
+
 	constexpr TagMask operator~() const {
 		return TagMask(~value);
 	}
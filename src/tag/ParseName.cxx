@@ -19,6 +19,7 @@
 
 #include "ParseName.hxx"
 #include "util/ASCII.hxx"
+#include "util/StringView.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -52,3 +53,16 @@ tag_name_parse_i(const char *name) noexcept
 
 	return TAG_NUM_OF_ITEM_TYPES;
 }
+
+TagType
+tag_name_parse_i(StringView name) noexcept
+{
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		assert(tag_item_names[i] != nullptr);
+
+		if (name.EqualsIgnoreCase(tag_item_names[i]))
+			return (TagType)i;
+	}
+
+	return TAG_NUM_OF_ITEM_TYPES;
+}
@@ -23,6 +23,8 @@
 #include "Type.h"
 #include "util/Compiler.h"
 
+struct StringView;
+
 /**
  * Parse the string, and convert it into a #TagType.  Returns
  * #TAG_NUM_OF_ITEM_TYPES if the string could not be recognized.
@@ -41,4 +43,8 @@ gcc_pure
 TagType
 tag_name_parse_i(const char *name) noexcept;
 
+gcc_pure
+TagType
+tag_name_parse_i(StringView name) noexcept;
+
 #endif
@@ -19,10 +19,15 @@
 
 #include "Pool.hxx"
 #include "Item.hxx"
+#include "lib/icu/CaseFold.hxx"
+#include "lib/icu/Collate.hxx"
+#include "thread/Mutex.hxx"
+#include "util/AllocatedString.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 #include "util/StringView.hxx"
 
+#include <atomic>
 #include <limits>
 
 #include <assert.h>
@@ -30,64 +35,200 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-Mutex tag_pool_lock;
+/**
+ * The number of independently locked shards; must be a power of two.
+ */
+static constexpr size_t NUM_SHARDS = 16;
+
+/**
+ * The initial number of hash buckets per shard; must be a power of
+ * two.  The table doubles whenever it holds more than
+ * #MAX_LOAD items per bucket on average.
+ */
+static constexpr size_t INITIAL_BUCKETS = 256;
 
-static constexpr size_t NUM_SLOTS = 4093;
+static constexpr size_t MAX_LOAD = 2;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
-	uint8_t ref = 1;
+
+	/**
+	 * The reference counter.  Incrementing an existing
+	 * reference and dropping a reference which is not the last
+	 * one do not need the shard lock.
+	 */
+	std::atomic<uint32_t> ref{1};
+
+	const unsigned hash;
+
+#ifdef HAVE_ICU_CASE_FOLD
+	/**
+	 * The case-folded value, allocated by
+	 * tag_pool_get_folded() on demand.
+	 */
+	std::atomic<char *> folded{nullptr};
+#endif
+
+	/**
+	 * The IcuCollateKey() of the value, allocated by
+	 * tag_pool_get_collate_key() on demand.
+	 */
+	std::atomic<char *> collate_key{nullptr};
+
 	TagItem item;
 
-	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
+	static constexpr uint32_t MAX_REF = std::numeric_limits<uint32_t>::max();
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(TagPoolSlot *_next, unsigned _hash, TagType type,
 		    StringView value) noexcept
-		:next(_next) {
+		:next(_next), hash(_hash) {
 		item.type = type;
 		memcpy(item.value, value.data, value.size);
 		item.value[value.size] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
-				   StringView value) noexcept;
+	~TagPoolSlot() noexcept {
+#ifdef HAVE_ICU_CASE_FOLD
+		delete[] folded.load(std::memory_order_relaxed);
+#endif
+		delete[] collate_key.load(std::memory_order_relaxed);
+	}
+
+	TagPoolSlot(const TagPoolSlot &) = delete;
+	TagPoolSlot &operator=(const TagPoolSlot &) = delete;
+
+	static TagPoolSlot *Create(TagPoolSlot *_next, unsigned _hash,
+				   TagType type, StringView value) noexcept;
 };
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
-		    StringView value) noexcept
+TagPoolSlot::Create(TagPoolSlot *_next, unsigned _hash,
+		    TagType type, StringView value) noexcept
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       value.size + 1,
-				       _next, type,
+				       _next, _hash, type,
 				       value);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+struct TagPoolShard {
+	Mutex mutex;
 
-static inline unsigned
-calc_hash(TagType type, StringView p) noexcept
+	/**
+	 * The hash buckets; allocated on the first insertion and
+	 * never freed, because #TagItem references may be released
+	 * during static destruction.
+	 */
+	TagPoolSlot **buckets = nullptr;
+
+	size_t n_buckets = 0;
+
+	size_t n_items = 0;
+
+	/**
+	 * The approximate memory occupied by all slots in this shard
+	 * (not including the cached folded strings and collation
+	 * keys).
+	 */
+	size_t n_bytes = 0;
+
+	/**
+	 * The number of times the #mutex was already locked by
+	 * another thread.
+	 */
+	std::atomic<uint64_t> n_contended{0};
+
+	void Lock() noexcept {
+		if (!mutex.try_lock()) {
+			n_contended.fetch_add(1, std::memory_order_relaxed);
+			mutex.lock();
+		}
+	}
+
+	void Unlock() noexcept {
+		mutex.unlock();
+	}
+
+	TagPoolSlot **GetBucket(unsigned hash) noexcept {
+		assert(n_buckets > 0);
+
+		return &buckets[(hash / NUM_SHARDS) & (n_buckets - 1)];
+	}
+
+	void Grow() noexcept;
+};
+
+class ScopeLockShard {
+	TagPoolShard &shard;
+
+public:
+	explicit ScopeLockShard(TagPoolShard &_shard) noexcept
+		:shard(_shard) {
+		shard.Lock();
+	}
+
+	~ScopeLockShard() noexcept {
+		shard.Unlock();
+	}
+
+	ScopeLockShard(const ScopeLockShard &) = delete;
+	ScopeLockShard &operator=(const ScopeLockShard &) = delete;
+};
+
+static TagPoolShard shards[NUM_SHARDS];
+
+void
+TagPoolShard::Grow() noexcept
 {
-	unsigned hash = 5381;
+	const size_t new_n_buckets = n_buckets > 0
+		? n_buckets * 2
+		: INITIAL_BUCKETS;
+	TagPoolSlot **new_buckets = new TagPoolSlot *[new_n_buckets]();
 
-	for (auto ch : p)
-		hash = (hash << 5) + hash + ch;
+	for (size_t i = 0; i < n_buckets; ++i) {
+		for (TagPoolSlot *slot = buckets[i], *next; slot != nullptr;
+		     slot = next) {
+			next = slot->next;
 
-	return hash ^ type;
+			auto &head = new_buckets[(slot->hash / NUM_SHARDS) &
+						 (new_n_buckets - 1)];
+			slot->next = head;
+			head = slot;
+		}
+	}
+
+	delete[] buckets;
+	buckets = new_buckets;
+	n_buckets = new_n_buckets;
+}
+
+static inline unsigned
+mix_hash(unsigned hash) noexcept
+{
+	/* spread the bits of the djb hash, because both the shard
+	   and the bucket are selected by masking */
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bu;
+	hash ^= hash >> 16;
+	return hash;
 }
 
 static inline unsigned
-calc_hash(TagType type, const char *p) noexcept
+calc_hash(TagType type, StringView p) noexcept
 {
 	unsigned hash = 5381;
 
-	assert(p != nullptr);
+	for (auto ch : p)
+		hash = (hash << 5) + hash + ch;
 
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+	return mix_hash(hash ^ type);
+}
 
-	return hash ^ type;
+static inline TagPoolShard &
+get_shard(unsigned hash) noexcept
+{
+	return shards[hash & (NUM_SHARDS - 1)];
 }
 
 static inline constexpr TagPoolSlot *
@@ -96,34 +237,53 @@ tag_item_to_slot(TagItem *item) noexcept
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, StringView value) noexcept
+static inline constexpr const TagPoolSlot *
+tag_item_to_slot(const TagItem *item) noexcept
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value) noexcept
+/**
+ * Increment the reference counter unless it is already at
+ * #TagPoolSlot::MAX_REF.
+ */
+static bool
+try_ref(TagPoolSlot &slot) noexcept
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	uint32_t ref = slot.ref.load(std::memory_order_relaxed);
+	do {
+		assert(ref > 0);
+
+		if (ref >= TagPoolSlot::MAX_REF)
+			return false;
+	} while (!slot.ref.compare_exchange_weak(ref, ref + 1,
+						 std::memory_order_relaxed));
+
+	return true;
 }
 
 TagItem *
 tag_pool_get_item(TagType type, StringView value) noexcept
 {
-	auto slot_p = tag_value_slot_p(type, value);
+	const unsigned hash = calc_hash(type, value);
+	auto &shard = get_shard(hash);
+	const ScopeLockShard protect(shard);
+
+	if (shard.n_items >= shard.n_buckets * MAX_LOAD)
+		shard.Grow();
+
+	auto slot_p = shard.GetBucket(hash);
 	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
+		if (slot->hash == hash && slot->item.type == type &&
 		    value.Equals(slot->item.value) &&
-		    slot->ref < TagPoolSlot::MAX_REF) {
-			assert(slot->ref > 0);
-			++slot->ref;
+		    try_ref(*slot))
 			return &slot->item;
-		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value);
+	auto slot = TagPoolSlot::Create(*slot_p, hash, type, value);
 	*slot_p = slot;
+	++shard.n_items;
+	shard.n_bytes += sizeof(*slot) + value.size;
 	return &slot->item;
 }
 
@@ -132,37 +292,111 @@ tag_pool_dup_item(TagItem *item) noexcept
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	assert(slot->ref > 0);
-
-	if (slot->ref < TagPoolSlot::MAX_REF) {
-		++slot->ref;
+	if (try_ref(*slot))
 		return item;
-	} else {
-		/* the reference counter overflows above MAX_REF;
-		   obtain a reference to a different TagPoolSlot which
-		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
-	}
+
+	/* the reference counter overflows above MAX_REF; obtain a
+	   reference to a different TagPoolSlot which isn't yet
+	   "full" */
+	return tag_pool_get_item(item->type, item->value);
 }
 
 void
 tag_pool_put_item(TagItem *item) noexcept
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
+	/* fast path: this is not the last reference, so the slot
+	   stays in the table and no lock is needed */
+	uint32_t ref = slot->ref.load(std::memory_order_relaxed);
+	while (ref > 1)
+		if (slot->ref.compare_exchange_weak(ref, ref - 1,
+						    std::memory_order_release,
+						    std::memory_order_relaxed))
+			return;
 
-	if (slot->ref > 0)
+	/* this may be the last reference; under the shard lock,
+	   nobody else can obtain a new one */
+	auto &shard = get_shard(slot->hash);
+	const ScopeLockShard protect(shard);
+
+	assert(slot->ref.load() > 0);
+	if (slot->ref.fetch_sub(1, std::memory_order_acq_rel) > 1)
 		return;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
+	TagPoolSlot **slot_p;
+	for (slot_p = shard.GetBucket(slot->hash);
 	     *slot_p != slot;
 	     slot_p = &(*slot_p)->next) {
 		assert(*slot_p != nullptr);
 	}
 
 	*slot_p = slot->next;
+	--shard.n_items;
+	shard.n_bytes -= sizeof(*slot) + strlen(slot->item.value);
 	DeleteVarSize(slot);
 }
+
+/**
+ * Return the string cached in the given slot attribute, calculating
+ * it with the given function if it does not exist yet.
+ *
+ * The pointer is only ever changed from nullptr to a value which
+ * stays until the slot is deleted, so it can be published without
+ * the shard lock.
+ */
+template<typename F>
+static const char *
+GetCachedString(std::atomic<char *> &cache, const char *value, F &&f) noexcept
+{
+	char *p = cache.load(std::memory_order_acquire);
+	if (p != nullptr)
+		return p;
+
+	char *new_value = f(value).Steal();
+	if (!cache.compare_exchange_strong(p, new_value,
+					   std::memory_order_acq_rel,
+					   std::memory_order_acquire)) {
+		/* another thread was faster */
+		delete[] new_value;
+		return p;
+	}
+
+	return new_value;
+}
+
+const char *
+tag_pool_get_folded(const TagItem &item) noexcept
+{
+#ifdef HAVE_ICU_CASE_FOLD
+	auto &slot = const_cast<TagPoolSlot &>(*tag_item_to_slot(&item));
+	return GetCachedString(slot.folded, item.value, IcuCaseFold);
+#else
+	return item.value;
+#endif
+}
+
+const char *
+tag_pool_get_collate_key(const TagItem &item) noexcept
+{
+	auto &slot = const_cast<TagPoolSlot &>(*tag_item_to_slot(&item));
+	return GetCachedString(slot.collate_key, item.value, IcuCollateKey);
+}
+
+TagPoolStats
+tag_pool_get_stats() noexcept
+{
+	TagPoolStats stats;
+
+	for (auto &shard : shards) {
+		const ScopeLockShard protect(shard);
+		stats.n_items += shard.n_items;
+		stats.n_buckets += shard.n_buckets;
+		stats.n_bytes += shard.n_bytes +
+			shard.n_buckets * sizeof(*shard.buckets);
+		stats.n_contended +=
+			shard.n_contended.load(std::memory_order_relaxed);
+	}
+
+	return stats;
+}
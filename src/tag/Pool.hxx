@@ -21,13 +21,20 @@
 #define MPD_TAG_POOL_HXX
 
 #include "Type.h"
-#include "thread/Mutex.hxx"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
+#include <stdint.h>
 
 struct TagItem;
 struct StringView;
 
+/*
+ * The tag pool interns #TagItem objects with reference counting.  All
+ * functions are thread-safe; the table is split into shards with a
+ * lock each, and only obtaining a new item and releasing the last
+ * reference need that lock.
+ */
+
 TagItem *
 tag_pool_get_item(TagType type, StringView value) noexcept;
 
@@ -37,4 +44,40 @@ tag_pool_dup_item(TagItem *item) noexcept;
 void
 tag_pool_put_item(TagItem *item) noexcept;
 
+/**
+ * Returns the case-folded value of a pooled #TagItem (see
+ * IcuCompare::EqualsFolded(), IcuCompare::IsInFolded()).  It is
+ * calculated by the first call and shared by all references to the
+ * item; the pointer is valid as long as the item is.  Without ICU,
+ * this returns the original value.
+ */
+const char *
+tag_pool_get_folded(const TagItem &item) noexcept;
+
+/**
+ * Returns the IcuCollateKey() of a pooled #TagItem's value; comparing
+ * two of these with strcmp() is equivalent to IcuCollate(), but much
+ * cheaper.  Like tag_pool_get_folded(), it is calculated by the first
+ * call and valid as long as the item is.
+ */
+const char *
+tag_pool_get_collate_key(const TagItem &item) noexcept;
+
+struct TagPoolStats {
+	/** the number of distinct items in the pool */
+	size_t n_items = 0;
+
+	/** the total number of hash buckets */
+	size_t n_buckets = 0;
+
+	/** the approximate memory occupied by items and buckets */
+	size_t n_bytes = 0;
+
+	/** how often had a thread to wait for a shard lock? */
+	uint64_t n_contended = 0;
+};
+
+TagPoolStats
+tag_pool_get_stats() noexcept;
+
 #endif
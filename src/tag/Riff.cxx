@@ -38,8 +38,8 @@ struct riff_chunk_header {
 	uint32_t size;
 };
 
-size_t
-riff_seek_id3(InputStream &is)
+void
+riff_read_header(InputStream &is, const char *format)
 {
 	/* seek to the beginning and read the RIFF header */
 
@@ -48,9 +48,20 @@ riff_seek_id3(InputStream &is)
 	riff_header header;
 	is.ReadFull(&header, sizeof(header));
 	if (memcmp(header.id, "RIFF", 4) != 0 ||
-	    (is.KnownSize() && FromLE32(header.size) > is.GetSize()))
+	    (is.KnownSize() && FromLE32(header.size) > is.GetSize()) ||
+	    (format != nullptr && memcmp(header.format, format, 4) != 0))
 		throw std::runtime_error("Not a RIFF file");
+}
 
+/**
+ * Skips chunks until one matching the given predicate is found.
+ *
+ * @return the size of the chunk
+ */
+template<typename P>
+static size_t
+SeekChunk(InputStream &is, P &&predicate)
+{
 	while (true) {
 		/* read the chunk header */
 
@@ -63,8 +74,7 @@ riff_seek_id3(InputStream &is)
 			   underflow when casting to off_t */
 			throw std::runtime_error("RIFF chunk is too large");
 
-		if (memcmp(chunk.id, "id3 ", 4) == 0 ||
-		    memcmp(chunk.id, "ID3 ", 4) == 0)
+		if (predicate(chunk.id))
 			/* found it! */
 			return size;
 
@@ -75,3 +85,22 @@ riff_seek_id3(InputStream &is)
 		is.Skip(size);
 	}
 }
+
+size_t
+riff_seek_chunk(InputStream &is, const char *id)
+{
+	return SeekChunk(is, [id](const char *chunk_id){
+			return memcmp(chunk_id, id, 4) == 0;
+		});
+}
+
+size_t
+riff_seek_id3(InputStream &is)
+{
+	riff_read_header(is);
+
+	return SeekChunk(is, [](const char *id){
+			return memcmp(id, "id3 ", 4) == 0 ||
+				memcmp(id, "ID3 ", 4) == 0;
+		});
+}
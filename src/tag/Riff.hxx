@@ -29,6 +29,34 @@
 
 class InputStream;
 
+/**
+ * Rewinds the #InputStream and reads the RIFF header.
+ *
+ * Throws std::runtime_error on error.
+ *
+ * @param is a locked #InputStream
+ * @param format the expected form type (e.g. "WAVE"); nullptr
+ * accepts any
+ */
+void
+riff_read_header(InputStream &is, const char *format=nullptr);
+
+/**
+ * Skips chunks until one with the given id is found.  Call
+ * riff_read_header() first; this function can be called again to
+ * find more chunks after the current one has been read or skipped
+ * completely.
+ *
+ * Throws std::runtime_error on error (e.g. if there is no such
+ * chunk).
+ *
+ * @param is a locked #InputStream
+ * @param id the four-character chunk id
+ * @return the size of the chunk, whose contents can now be read
+ */
+size_t
+riff_seek_chunk(InputStream &is, const char *id);
+
 /**
  * Seeks the RIFF file to the ID3 chunk.
  *
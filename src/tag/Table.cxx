@@ -19,6 +19,7 @@
 
 #include "Table.hxx"
 #include "util/ASCII.hxx"
+#include "util/StringView.hxx"
 
 #include <string.h>
 
@@ -52,6 +53,16 @@ tag_table_lookup_i(const struct tag_table *table, const char *name) noexcept
 	return TAG_NUM_OF_ITEM_TYPES;
 }
 
+TagType
+tag_table_lookup_i(const struct tag_table *table, StringView name) noexcept
+{
+	for (; table->name != nullptr; ++table)
+		if (name.EqualsIgnoreCase(table->name))
+			return table->type;
+
+	return TAG_NUM_OF_ITEM_TYPES;
+}
+
 const char *
 tag_table_lookup(const tag_table *table, TagType type) noexcept
 {
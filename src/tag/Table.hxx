@@ -23,6 +23,8 @@
 #include "Type.h"
 #include "util/Compiler.h"
 
+struct StringView;
+
 struct tag_table {
 	const char *name;
 
@@ -47,6 +49,10 @@ gcc_pure
 TagType
 tag_table_lookup_i(const tag_table *table, const char *name) noexcept;
 
+gcc_pure
+TagType
+tag_table_lookup_i(const tag_table *table, StringView name) noexcept;
+
 /**
  * Looks up a #TagType in a tag translation table and returns its
  * string representation.  Returns nullptr if the specified type was
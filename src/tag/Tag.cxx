@@ -21,37 +21,111 @@
 #include "Pool.hxx"
 #include "Builder.hxx"
 
+#include <atomic>
+#include <new>
+
 #include <assert.h>
 
+/**
+ * The header which precedes each #Tag::items array.
+ */
+struct alignas(TagItem *) TagItemArrayHeader {
+	std::atomic_uint ref;
+
+	explicit TagItemArrayHeader(unsigned _ref) noexcept:ref(_ref) {}
+
+	static TagItemArrayHeader &Of(TagItem **items) noexcept {
+		return *((TagItemArrayHeader *)(void *)items - 1);
+	}
+
+	TagItem **GetItems() noexcept {
+		return (TagItem **)(void *)(this + 1);
+	}
+};
+
+TagItem **
+Tag::AllocateItems(unsigned n) noexcept
+{
+	assert(n > 0);
+
+	void *p = ::operator new(sizeof(TagItemArrayHeader) +
+				 n * sizeof(TagItem *));
+	return (new(p) TagItemArrayHeader(1))->GetItems();
+}
+
+void
+Tag::FreeItems(TagItem **items) noexcept
+{
+	assert(items != nullptr);
+
+	auto &header = TagItemArrayHeader::Of(items);
+	assert(header.ref.load() == 1);
+
+	header.~TagItemArrayHeader();
+	::operator delete(&header);
+}
+
+void
+Tag::UnshareItems() noexcept
+{
+	if (items == nullptr)
+		return;
+
+	auto &header = TagItemArrayHeader::Of(items);
+	if (header.ref.load(std::memory_order_acquire) == 1)
+		return;
+
+	TagItem **copy = AllocateItems(num_items);
+
+	for (unsigned i = 0; i < num_items; i++)
+		copy[i] = tag_pool_dup_item(items[i]);
+
+	if (header.ref.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		/* the other owners have gone away meanwhile; drop
+		   the references we just duplicated */
+		FreeItemsAndRefs(items, num_items);
+
+	items = copy;
+}
+
 void
 Tag::Clear() noexcept
 {
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		for (unsigned i = 0; i < num_items; ++i)
-			tag_pool_put_item(items[i]);
+	if (items != nullptr) {
+		auto &header = TagItemArrayHeader::Of(items);
+		if (header.ref.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			/* this was the last reference */
+			FreeItemsAndRefs(items, num_items);
+
+		items = nullptr;
 	}
 
-	delete[] items;
-	items = nullptr;
 	num_items = 0;
 }
 
+void
+Tag::FreeItemsAndRefs(TagItem **items, unsigned num_items) noexcept
+{
+	for (unsigned i = 0; i < num_items; ++i)
+		tag_pool_put_item(items[i]);
+
+	auto &header = TagItemArrayHeader::Of(items);
+	header.~TagItemArrayHeader();
+	::operator delete(&header);
+}
+
 Tag::Tag(const Tag &other) noexcept
 	:duration(other.duration), has_playlist(other.has_playlist),
 	 num_items(other.num_items),
-	 items(nullptr)
+	 items(other.items)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
-
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-	}
+	if (items != nullptr)
+		/* share the items array */
+		TagItemArrayHeader::Of(items).ref.fetch_add(1,
+							    std::memory_order_relaxed);
 }
 
 std::unique_ptr<Tag>
@@ -31,6 +31,10 @@
 /**
  * The meta information about a song file.  It is a MPD specific
  * subset of tags (e.g. from ID3, vorbis comments, ...).
+ *
+ * The #items array is reference counted and shared between copies,
+ * which makes copying a #Tag cheap.  It must never be modified
+ * in-place; use #TagBuilder to edit a tag.
  */
 struct Tag {
 	/**
@@ -48,7 +52,10 @@ struct Tag {
 	/** the total number of tag items in the #items array */
 	unsigned short num_items = 0;
 
-	/** an array of tag items */
+	/**
+	 * A reference counted array of tag items (allocated with
+	 * AllocateItems()), or nullptr if there are no items.
+	 */
 	TagItem **items = nullptr;
 
 	/**
@@ -90,6 +97,38 @@ struct Tag {
 		std::swap(num_items, other.num_items);
 	}
 
+	/**
+	 * Allocate a new #items array with a reference counter of 1.
+	 * The #TagItem pointers are uninitialized.
+	 *
+	 * @param n the number of items; must not be zero
+	 */
+	static TagItem **AllocateItems(unsigned n) noexcept;
+
+	/**
+	 * Free an #items array without releasing the #TagItem
+	 * references.  The reference counter must be 1.
+	 */
+	static void FreeItems(TagItem **items) noexcept;
+
+	/**
+	 * Ensure that this object is the only owner of its #items
+	 * array, by copying it if it is shared with other #Tag
+	 * objects.  After that, its #TagItem references may be moved
+	 * elsewhere.
+	 */
+	void UnshareItems() noexcept;
+
+private:
+	/**
+	 * Release the #TagItem references and free the #items array
+	 * (after its reference counter has dropped to zero).
+	 */
+	static void FreeItemsAndRefs(TagItem **items,
+				     unsigned num_items) noexcept;
+
+public:
+
 	/**
 	 * Returns true if the tag contains no items.  This ignores
 	 * the "duration" attribute.
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2009-2019 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_BACKGROUND_TASK_HXX
+#define THREAD_BACKGROUND_TASK_HXX
+
+#include "Thread.hxx"
+
+#include <exception>
+#include <functional>
+
+/**
+ * Runs one function in a new thread, to overlap a slow
+ * initialization step with others.  An exception thrown by the
+ * function is rethrown by Wait().
+ */
+class BackgroundTask {
+public:
+	typedef std::function<void()> Function;
+
+private:
+	/**
+	 * The name passed to SetThreadName().
+	 */
+	const char *const name;
+
+	const Function f;
+
+	std::exception_ptr error;
+
+	Thread thread;
+
+public:
+	/**
+	 * Start the thread.
+	 *
+	 * Throws on error.
+	 */
+	BackgroundTask(const char *_name, Function _f);
+
+	~BackgroundTask() noexcept {
+		Join();
+	}
+
+	BackgroundTask(const BackgroundTask &) = delete;
+	BackgroundTask &operator=(const BackgroundTask &) = delete;
+
+	/**
+	 * Wait for the function to finish, ignoring its result.
+	 */
+	void Join() noexcept {
+		if (thread.IsDefined())
+			thread.Join();
+	}
+
+	/**
+	 * Wait for the function to finish and rethrow its exception
+	 * (if any).
+	 */
+	void Wait();
+
+private:
+	void Run() noexcept;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2009-2019 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef THREAD_SEQ_LOCK_HXX
+#define THREAD_SEQ_LOCK_HXX
+
+#include <atomic>
+#include <type_traits>
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * A sequence lock: it publishes a small trivially copyable value,
+ * and readers obtain a consistent copy without ever blocking the
+ * writer.  A reader which overlaps with a write retries.
+ *
+ * The value is stored in relaxed atomic words, so the concurrent
+ * copy does not invoke undefined behavior.
+ *
+ * There may only be one writer at a time; serializing writers is
+ * the caller's responsibility (e.g. with a mutex).
+ */
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "T must be trivially copyable");
+
+	typedef uintptr_t Word;
+
+	static constexpr size_t N = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+	/**
+	 * An odd value means a write is in progress.
+	 */
+	std::atomic<unsigned> sequence{0};
+
+	std::atomic<Word> words[N];
+
+public:
+	explicit SeqLock(const T &value=T()) noexcept {
+		for (auto &i : words)
+			i.store(0, std::memory_order_relaxed);
+		Store(value);
+	}
+
+	SeqLock(const SeqLock &) = delete;
+	SeqLock &operator=(const SeqLock &) = delete;
+
+	void Store(const T &value) noexcept {
+		Word buffer[N] = {};
+		memcpy(buffer, &value, sizeof(value));
+
+		const unsigned s = sequence.load(std::memory_order_relaxed);
+		sequence.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < N; ++i)
+			words[i].store(buffer[i], std::memory_order_relaxed);
+
+		sequence.store(s + 2, std::memory_order_release);
+	}
+
+	T Load() const noexcept {
+		Word buffer[N];
+		unsigned before, after;
+
+		do {
+			before = sequence.load(std::memory_order_acquire);
+
+			for (size_t i = 0; i < N; ++i)
+				buffer[i] = words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) != 0 || before != after);
+
+		T value;
+		memcpy(&value, buffer, sizeof(value));
+		return value;
+	}
+};
+
+#endif
@@ -97,11 +97,11 @@ SetThreadIdlePriority() noexcept
 };
 
 void
-SetThreadRealtime()
+SetThreadRealtime(int priority)
 {
 #ifdef __linux__
 	struct sched_param sched_param;
-	sched_param.sched_priority = 50;
+	sched_param.sched_priority = priority;
 
 	int policy = SCHED_FIFO;
 #ifdef SCHED_RESET_ON_FORK
@@ -110,5 +110,29 @@ SetThreadRealtime()
 
 	if (linux_sched_setscheduler(0, policy, &sched_param) < 0)
 		throw MakeErrno("sched_setscheduler failed");
+#else
+	(void)priority;
 #endif	// __linux__
 };
+
+void
+SetThreadAffinity(uint64_t cpu_mask)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (unsigned i = 0; i < 64; ++i)
+		if (cpu_mask & (uint64_t(1) << i))
+			CPU_SET(i, &set);
+
+	/* pid 0 means the calling thread */
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		throw MakeErrno("sched_setaffinity failed");
+#elif defined(_WIN32)
+	if (SetThreadAffinityMask(GetCurrentThread(),
+				  DWORD_PTR(cpu_mask)) == 0)
+		throw MakeLastError("SetThreadAffinityMask() failed");
+#else
+	(void)cpu_mask;
+#endif
+}
@@ -30,6 +30,8 @@
 #ifndef THREAD_UTIL_HXX
 #define THREAD_UTIL_HXX
 
+#include <stdint.h>
+
 /**
  * Lower the current thread's priority to "idle" (very low).
  */
@@ -40,8 +42,21 @@ SetThreadIdlePriority() noexcept;
  * Raise the current thread's priority to "real-time" (very high).
  *
  * Throws std::system_error on error.
+ *
+ * @param priority the SCHED_FIFO priority (1..99)
+ */
+void
+SetThreadRealtime(int priority=50);
+
+/**
+ * Restrict the current thread to a set of CPUs.
+ *
+ * Throws std::system_error on error.
+ *
+ * @param cpu_mask a bit mask of allowed CPUs (bit N = CPU N); must
+ * not be zero
  */
 void
-SetThreadRealtime();
+SetThreadAffinity(uint64_t cpu_mask);
 
 #endif
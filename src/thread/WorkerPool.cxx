@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2009-2019 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "WorkerPool.hxx"
+#include "Name.hxx"
+
+#include <assert.h>
+
+WorkerPool::WorkerPool(const char *_name, unsigned n_threads)
+	:name(_name)
+{
+	assert(n_threads > 0);
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i) {
+			threads.emplace_front(BIND_THIS_METHOD(Run));
+
+			try {
+				threads.front().Start();
+			} catch (...) {
+				threads.pop_front();
+				throw;
+			}
+		}
+	} catch (...) {
+		Stop();
+		throw;
+	}
+}
+
+WorkerPool::~WorkerPool() noexcept
+{
+	Stop();
+}
+
+void
+WorkerPool::Stop() noexcept
+{
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		quit = true;
+		wake_cond.broadcast();
+	}
+
+	for (auto &thread : threads)
+		thread.Join();
+
+	threads.clear();
+}
+
+void
+WorkerPool::Push(Group *group, Job &&job) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	assert(!quit);
+
+	if (group != nullptr)
+		++group->pending;
+
+	queue.push_back({std::move(job), group});
+	wake_cond.signal();
+}
+
+void
+WorkerPool::Wait(Group &group) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	while (group.pending > 0)
+		done_cond.wait(mutex);
+}
+
+void
+WorkerPool::Run() noexcept
+{
+	SetThreadName(name);
+
+	const std::lock_guard<Mutex> lock(mutex);
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			wake_cond.wait(mutex);
+			continue;
+		}
+
+		Item item = std::move(queue.front());
+		queue.pop_front();
+
+		{
+			const ScopeUnlock unlock(mutex);
+			item.job();
+		}
+
+		if (item.group != nullptr) {
+			assert(item.group->pending > 0);
+
+			if (--item.group->pending == 0)
+				done_cond.broadcast();
+		}
+	}
+}
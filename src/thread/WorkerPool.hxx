@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2009-2019 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_WORKER_POOL_HXX
+#define THREAD_WORKER_POOL_HXX
+
+#include "Thread.hxx"
+#include "Mutex.hxx"
+#include "Cond.hxx"
+
+#include <forward_list>
+#include <deque>
+#include <functional>
+
+/**
+ * A fixed number of worker threads which execute jobs from a FIFO
+ * queue.  Jobs may be submitted from any thread.
+ */
+class WorkerPool {
+public:
+	typedef std::function<void()> Job;
+
+	/**
+	 * A set of jobs whose completion can be awaited with
+	 * WorkerPool::Wait().
+	 */
+	class Group {
+		friend class WorkerPool;
+
+		/**
+		 * The number of jobs in this group which have not yet
+		 * finished.  Protected by WorkerPool::mutex.
+		 */
+		unsigned pending = 0;
+
+	public:
+		Group() = default;
+		Group(const Group &) = delete;
+		Group &operator=(const Group &) = delete;
+	};
+
+private:
+	/**
+	 * The name passed to SetThreadName().
+	 */
+	const char *const name;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job is enqueued or when the pool shall
+	 * quit.
+	 */
+	Cond wake_cond;
+
+	/**
+	 * Broadcast when a job of a #Group finishes.
+	 */
+	Cond done_cond;
+
+	struct Item {
+		Job job;
+		Group *group;
+	};
+
+	std::deque<Item> queue;
+
+	std::forward_list<Thread> threads;
+
+	bool quit = false;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param _name the name of the worker threads (for debugging)
+	 * @param n_threads the number of worker threads; must be
+	 * positive
+	 */
+	WorkerPool(const char *_name, unsigned n_threads);
+
+	/**
+	 * Finishes all pending jobs and joins the worker threads.
+	 */
+	~WorkerPool() noexcept;
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/**
+	 * Submit a job.  The job must not throw.
+	 */
+	void Push(Job job) noexcept {
+		Push(nullptr, std::move(job));
+	}
+
+	/**
+	 * Submit a job which belongs to the given #Group.
+	 */
+	void Push(Group &group, Job job) noexcept {
+		Push(&group, std::move(job));
+	}
+
+	/**
+	 * Wait until all jobs of the given #Group have finished.
+	 */
+	void Wait(Group &group) noexcept;
+
+private:
+	void Push(Group *group, Job &&job) noexcept;
+
+	void Stop() noexcept;
+
+	void Run() noexcept;
+};
+
+#endif
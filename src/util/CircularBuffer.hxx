@@ -65,7 +65,7 @@ protected:
 	 */
 	size_type tail;
 
-	const size_type capacity;
+	size_type capacity;
 	const pointer_type data;
 
 public:
@@ -90,6 +90,28 @@ public:
 		return capacity;
 	}
 
+	/**
+	 * Change the capacity of this buffer.  The caller must make
+	 * sure that the memory given to the constructor is large
+	 * enough.  This is only possible if the data currently stored
+	 * does not wrap around and fits into the new capacity.
+	 *
+	 * @return true on success, false if the capacity was not
+	 * changed
+	 */
+	bool SetCapacity(size_type new_capacity) {
+		assert(new_capacity > 0);
+
+		if (head == tail)
+			/* empty: rewind */
+			head = tail = 0;
+		else if (tail < head || tail >= new_capacity)
+			return false;
+
+		capacity = new_capacity;
+		return true;
+	}
+
 	constexpr bool empty() const {
 		return head == tail;
 	}
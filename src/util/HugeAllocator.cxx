@@ -29,15 +29,32 @@
 
 #include "HugeAllocator.hxx"
 
+#include <algorithm>
 #include <new>
 
 #ifdef __linux__
 #include <sys/mman.h>
 #include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 #else
 #include <stdlib.h>
 #endif
 
+/**
+ * Write to one byte of each page, to make the kernel allocate
+ * physical memory for the range.  The contents of the allocation are
+ * undefined anyway, so we can write anything.
+ */
+static void
+TouchPages(void *p, size_t size, size_t page_size) noexcept
+{
+	auto *q = (volatile uint8_t *)p;
+	for (size_t i = 0; i < size; i += page_size)
+		q[i] = 0;
+}
+
 #ifdef __linux__
 
 /**
@@ -55,9 +72,69 @@ AlignToPageSize(size_t size) noexcept
 	return (size + ps - 1) / ps * ps;
 }
 
+#ifdef MAP_HUGETLB
+
+/**
+ * Determine the default huge page size from /proc/meminfo.
+ */
+gcc_const
+static size_t
+GetHugePageSize() noexcept
+{
+	static const size_t huge_page_size = [](){
+		size_t result = 2 * 1024 * 1024;
+
+		FILE *file = fopen("/proc/meminfo", "re");
+		if (file == nullptr)
+			return result;
+
+		char line[256];
+		unsigned long kb;
+		while (fgets(line, sizeof(line), file) != nullptr)
+			if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+				result = size_t(kb) * 1024;
+				break;
+			}
+
+		fclose(file);
+		return result;
+	}();
+
+	return huge_page_size;
+}
+
+static WritableBuffer<void>
+HugeAllocateExplicit(size_t size)
+{
+	const size_t hps = GetHugePageSize();
+	size = (size + hps - 1) / hps * hps;
+
+	/* no MAP_NORESERVE: reserve the huge pages now, or else a
+	   page fault may raise SIGBUS later when the pool is
+	   exhausted */
+	constexpr int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB;
+	void *p = mmap(nullptr, size,
+		       PROT_READ|PROT_WRITE, flags,
+		       -1, 0);
+	if (p == (void *)-1)
+		throw std::bad_alloc();
+
+	return {p, size};
+}
+
+#endif
+
 WritableBuffer<void>
-HugeAllocate(size_t size)
+HugeAllocate(size_t size, HugePageMode mode)
 {
+	if (mode == HugePageMode::EXPLICIT) {
+#ifdef MAP_HUGETLB
+		return HugeAllocateExplicit(size);
+#else
+		throw std::bad_alloc();
+#endif
+	}
+
 	size = AlignToPageSize(size);
 
 	constexpr int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE;
@@ -70,7 +147,9 @@ HugeAllocate(size_t size)
 #ifdef MADV_HUGEPAGE
 	/* allow the Linux kernel to use "Huge Pages", which reduces page
 	   table overhead for this big chunk of data */
-	madvise(p, size, MADV_HUGEPAGE);
+	madvise(p, size, mode == HugePageMode::TRANSPARENT
+		? MADV_HUGEPAGE
+		: MADV_NOHUGEPAGE);
 #endif
 
 	return {p, size};
@@ -99,6 +178,102 @@ HugeDiscard(void *p, size_t size) noexcept
 #endif
 }
 
+bool
+HugeLock(void *p, size_t size) noexcept
+{
+	return mlock(p, AlignToPageSize(size)) == 0;
+}
+
+#ifndef MADV_POPULATE_WRITE
+/* since Linux 5.14 */
+#define MADV_POPULATE_WRITE 23
+#endif
+
+void
+HugePrefault(void *p, size_t size) noexcept
+{
+	size = AlignToPageSize(size);
+
+	/* let the kernel populate the whole range at once; older
+	   kernels reject the advice with EINVAL */
+	if (madvise(p, size, MADV_POPULATE_WRITE) == 0)
+		return;
+
+	TouchPages(p, size, AlignToPageSize(1));
+}
+
+/**
+ * Parse a "Name:   123 kB" line from /proc/self/smaps.
+ */
+static bool
+ParseSmapsField(const char *line, const char *name,
+		unsigned long &kb_r) noexcept
+{
+	const size_t length = strlen(name);
+	return strncmp(line, name, length) == 0 && line[length] == ':' &&
+		sscanf(line + length + 1, "%lu", &kb_r) == 1;
+}
+
+static constexpr size_t
+Scale(unsigned long kb, double share) noexcept
+{
+	return size_t(kb * 1024. * share);
+}
+
+HugeUsage
+HugeGetUsage(const void *p, size_t size) noexcept
+{
+	HugeUsage usage;
+
+	FILE *file = fopen("/proc/self/smaps", "re");
+	if (file == nullptr)
+		return usage;
+
+	const uintptr_t begin = (uintptr_t)p, end = begin + size;
+
+	/* the kernel may have merged our mapping with an adjacent
+	   one; in that case, the numbers of the merged mapping are
+	   scaled to our share of it */
+	double share = 0;
+
+	char line[512];
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		uintmax_t vma_begin, vma_end;
+		unsigned long kb;
+
+		if (sscanf(line, "%" SCNxMAX "-%" SCNxMAX " ",
+			   &vma_begin, &vma_end) == 2) {
+			/* the header line of a new mapping */
+			const uintmax_t overlap_begin = std::max<uintmax_t>(vma_begin, begin);
+			const uintmax_t overlap_end = std::min<uintmax_t>(vma_end, end);
+			share = overlap_end > overlap_begin
+				? double(overlap_end - overlap_begin) / (vma_end - vma_begin)
+				: 0;
+			continue;
+		}
+
+		if (share <= 0)
+			continue;
+
+		if (ParseSmapsField(line, "Rss", kb))
+			usage.resident += Scale(kb, share);
+		else if (ParseSmapsField(line, "AnonHugePages", kb))
+			/* transparent huge pages (included in
+			   "Rss") */
+			usage.huge += Scale(kb, share);
+		else if (ParseSmapsField(line, "Private_Hugetlb", kb) ||
+			 ParseSmapsField(line, "Shared_Hugetlb", kb)) {
+			/* hugetlbfs pages (not included in "Rss") */
+			usage.resident += Scale(kb, share);
+			usage.huge += Scale(kb, share);
+		} else if (ParseSmapsField(line, "Locked", kb))
+			usage.locked += Scale(kb, share);
+	}
+
+	fclose(file);
+	return usage;
+}
+
 #elif defined(_WIN32)
 
 WritableBuffer<void>
@@ -115,4 +290,18 @@ HugeAllocate(size_t size)
 	return {p, size};
 }
 
+void
+HugePrefault(void *p, size_t size) noexcept
+{
+	TouchPages(p, size, 4096);
+}
+
+#else
+
+void
+HugePrefault(void *p, size_t size) noexcept
+{
+	TouchPages(p, size, 4096);
+}
+
 #endif
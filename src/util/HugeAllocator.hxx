@@ -36,6 +36,49 @@
 #include <utility>
 
 #include <stddef.h>
+#include <stdint.h>
+
+/**
+ * How huge pages shall be used by HugeAllocate().
+ */
+enum class HugePageMode : uint8_t {
+	/**
+	 * Only normal pages.
+	 */
+	NONE,
+
+	/**
+	 * Ask the kernel to use transparent huge pages if available.
+	 */
+	TRANSPARENT,
+
+	/**
+	 * Allocate from the reserved huge page pool (hugetlbfs);
+	 * fails if the pool is too small.
+	 */
+	EXPLICIT,
+};
+
+/**
+ * Information about the physical memory backing an allocation; see
+ * HugeGetUsage().
+ */
+struct HugeUsage {
+	/**
+	 * The number of bytes currently present in physical memory.
+	 */
+	size_t resident = 0;
+
+	/**
+	 * The number of bytes backed by huge pages.
+	 */
+	size_t huge = 0;
+
+	/**
+	 * The number of bytes locked into memory.
+	 */
+	size_t locked = 0;
+};
 
 #ifdef __linux__
 
@@ -51,15 +94,39 @@
  * allocation overhead
  */
 WritableBuffer<void>
-HugeAllocate(size_t size);
+HugeAllocate(size_t size, HugePageMode mode=HugePageMode::TRANSPARENT);
 
 /**
  * @param p an allocation returned by HugeAllocate()
- * @param size the allocation's size as passed to HugeAllocate()
+ * @param size the allocation's size as returned by HugeAllocate()
  */
 void
 HugeFree(void *p, size_t size) noexcept;
 
+/**
+ * Lock the allocation into physical memory, so it is never paged out.
+ *
+ * @return false on error (with errno set), e.g. if RLIMIT_MEMLOCK
+ * is too small
+ */
+bool
+HugeLock(void *p, size_t size) noexcept;
+
+/**
+ * Fault in all pages of the allocation now, instead of on first
+ * access.
+ */
+void
+HugePrefault(void *p, size_t size) noexcept;
+
+/**
+ * Determine how much of the allocation is backed by physical memory
+ * and huge pages.  This reads /proc/self/smaps, which is slow.
+ */
+gcc_pure
+HugeUsage
+HugeGetUsage(const void *p, size_t size) noexcept;
+
 /**
  * Control whether this allocation is copied to newly forked child
  * processes.  Disabling that makes forking a little bit cheaper.
@@ -82,7 +149,7 @@ HugeDiscard(void *p, size_t size) noexcept;
 #include <windows.h>
 
 WritableBuffer<void>
-HugeAllocate(size_t size);
+HugeAllocate(size_t size, HugePageMode mode=HugePageMode::TRANSPARENT);
 
 static inline void
 HugeFree(void *p, gcc_unused size_t size) noexcept
@@ -90,6 +157,21 @@ HugeFree(void *p, gcc_unused size_t size) noexcept
 	VirtualFree(p, 0, MEM_RELEASE);
 }
 
+static inline bool
+HugeLock(void *p, size_t size) noexcept
+{
+	return VirtualLock(p, size);
+}
+
+void
+HugePrefault(void *p, size_t size) noexcept;
+
+static inline HugeUsage
+HugeGetUsage(const void *, size_t) noexcept
+{
+	return {};
+}
+
 static inline void
 HugeForkCow(void *, size_t, bool) noexcept
 {
@@ -105,10 +187,8 @@ HugeDiscard(void *p, size_t size) noexcept
 
 /* not Linux: fall back to standard C calls */
 
-#include <stdint.h>
-
 static inline WritableBuffer<void>
-HugeAllocate(size_t size)
+HugeAllocate(size_t size, HugePageMode=HugePageMode::TRANSPARENT)
 {
 	return {new uint8_t[size], size};
 }
@@ -120,6 +200,21 @@ HugeFree(void *_p, size_t) noexcept
 	delete[] p;
 }
 
+static inline bool
+HugeLock(void *, size_t) noexcept
+{
+	return false;
+}
+
+void
+HugePrefault(void *p, size_t size) noexcept;
+
+static inline HugeUsage
+HugeGetUsage(const void *, size_t) noexcept
+{
+	return {};
+}
+
 static inline void
 HugeForkCow(void *, size_t, bool) noexcept
 {
@@ -150,8 +245,10 @@ public:
 
 	constexpr HugeArray() = default;
 
-	explicit HugeArray(size_type _size)
-		:buffer(Buffer::FromVoidFloor(HugeAllocate(sizeof(value_type) * _size))) {}
+	explicit HugeArray(size_type _size,
+			   HugePageMode mode=HugePageMode::TRANSPARENT)
+		:buffer(Buffer::FromVoidFloor(HugeAllocate(sizeof(value_type) * _size,
+							   mode))) {}
 
 	constexpr HugeArray(HugeArray &&other)
 		:buffer(std::exchange(other.buffer, nullptr)) {}
@@ -178,6 +275,22 @@ public:
 		HugeDiscard(v.data, v.size);
 	}
 
+	bool Lock() noexcept {
+		auto v = buffer.ToVoid();
+		return HugeLock(v.data, v.size);
+	}
+
+	void Prefault() noexcept {
+		auto v = buffer.ToVoid();
+		HugePrefault(v.data, v.size);
+	}
+
+	gcc_pure
+	HugeUsage GetUsage() const noexcept {
+		auto v = buffer.ToVoid();
+		return HugeGetUsage(v.data, v.size);
+	}
+
 	constexpr bool operator==(std::nullptr_t) const {
 		return buffer == nullptr;
 	}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PERFECT_HASH_HXX
+#define PERFECT_HASH_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A perfect hash table for a constant set of null-terminated
+ * strings, generated at compile time: it maps each key to its index
+ * in the source array without collisions, so a lookup hashes the
+ * string once and then compares it with at most one key.
+ *
+ * The table stores only indices; the caller looks up the candidate
+ * in its own array and verifies that it actually matches.
+ *
+ * @param N the number of keys
+ * @param S the number of slots; must be a power of two and much
+ * larger than #N (see PerfectHashSize()), or the compiler will not
+ * find a seed
+ */
+template<size_t N, size_t S>
+class PerfectHashTable {
+	static_assert(N < 255, "Too many keys");
+	static_assert(S >= N && (S & (S - 1)) == 0,
+		      "Size must be a power of two");
+
+	uint32_t seed = 0;
+
+	/**
+	 * The index of the key plus one, or 0 if this slot is empty.
+	 */
+	uint8_t slots[S] = {};
+
+public:
+	/**
+	 * @param get_key a function object with a constexpr call
+	 * operator which returns the key of an array item
+	 */
+	template<typename T, typename F>
+	constexpr PerfectHashTable(const T (&items)[N], F get_key) {
+		while (!TryBuild(items, get_key))
+			++seed;
+	}
+
+	/**
+	 * Seeded FNV-1a with a final mix, so the low bits depend on
+	 * all characters.
+	 */
+	gcc_pure gcc_nonnull_all
+	static constexpr uint32_t Hash(const char *s,
+				       uint32_t seed) noexcept {
+		uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+		for (; *s != 0; ++s)
+			hash = (hash ^ (unsigned char)*s) * 16777619u;
+		return hash ^ (hash >> 15);
+	}
+
+	/**
+	 * Find the only key which may be equal to the given string.
+	 *
+	 * @return the index of the candidate, or #N if the string is
+	 * certainly not a key
+	 */
+	gcc_pure gcc_nonnull_all
+	constexpr size_t Find(const char *s) const noexcept {
+		const unsigned i = slots[Hash(s, seed) & (S - 1)];
+		return i > 0 ? i - 1 : N;
+	}
+
+private:
+	template<typename T, typename F>
+	constexpr bool TryBuild(const T (&items)[N], F get_key) noexcept {
+		for (auto &i : slots)
+			i = 0;
+
+		for (size_t i = 0; i < N; ++i) {
+			auto &slot = slots[Hash(get_key(items[i]), seed) & (S - 1)];
+			if (slot != 0)
+				return false;
+
+			slot = i + 1;
+		}
+
+		return true;
+	}
+};
+
+/**
+ * Choose the number of slots of a #PerfectHashTable with the given
+ * number of keys: eight times as many, rounded up to a power of two,
+ * which keeps the compile-time seed search short.
+ */
+constexpr size_t
+PerfectHashSize(size_t n) noexcept
+{
+	size_t size = 1;
+	while (size < n * 8)
+		size <<= 1;
+	return size;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SegmentBuffer.hxx"
+#include "WritableBuffer.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+SegmentPool::~SegmentPool() noexcept
+{
+	assert(n_busy == 0);
+
+	DiscardIdle();
+}
+
+void
+SegmentPool::DiscardIdle() noexcept
+{
+	while (idle != nullptr) {
+		void *next = *(void **)idle;
+		delete[] (uint8_t *)idle;
+		idle = next;
+	}
+
+	n_idle = 0;
+}
+
+void *
+SegmentPool::Allocate()
+{
+	void *p;
+
+	if (idle != nullptr) {
+		p = idle;
+		idle = *(void **)p;
+		--n_idle;
+	} else
+		p = new uint8_t[segment_size];
+
+	++n_busy;
+	return p;
+}
+
+void
+SegmentPool::Release(void *p) noexcept
+{
+	assert(p != nullptr);
+	assert(n_busy > 0);
+
+	--n_busy;
+
+	if (n_idle >= max_idle) {
+		delete[] (uint8_t *)p;
+		return;
+	}
+
+	*(void **)p = idle;
+	idle = p;
+	++n_idle;
+}
+
+SegmentBuffer::~SegmentBuffer() noexcept
+{
+	while (head != nullptr) {
+		Segment *next = head->next;
+		pool.Release(head);
+		head = next;
+	}
+}
+
+WritableBuffer<void>
+SegmentBuffer::Read() const noexcept
+{
+	if (head == nullptr)
+		return nullptr;
+
+	return {head->GetData() + head->start, head->end - head->start};
+}
+
+void
+SegmentBuffer::Consume(size_t length) noexcept
+{
+	assert(head != nullptr);
+	assert(length <= head->end - head->start);
+	assert(length <= size);
+
+	head->start += length;
+	size -= length;
+
+	if (head->start < head->end)
+		return;
+
+	/* this segment is empty; give it back to the pool right
+	   away */
+	Segment *next = head->next;
+	pool.Release(head);
+	head = next;
+	if (head == nullptr)
+		tail = nullptr;
+}
+
+bool
+SegmentBuffer::Append(const void *data, size_t length)
+{
+	if (length > max_size - size)
+		return false;
+
+	const size_t capacity = GetCapacity();
+
+	while (length > 0) {
+		if (tail == nullptr || tail->end == capacity) {
+			auto *s = (Segment *)pool.Allocate();
+			s->next = nullptr;
+			s->start = s->end = 0;
+
+			if (tail == nullptr)
+				head = s;
+			else
+				tail->next = s;
+			tail = s;
+		}
+
+		const size_t nbytes = std::min(length, capacity - tail->end);
+		memcpy(tail->GetData() + tail->end, data, nbytes);
+		tail->end += nbytes;
+		size += nbytes;
+
+		data = (const uint8_t *)data + nbytes;
+		length -= nbytes;
+	}
+
+	return true;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SEGMENT_BUFFER_HXX
+#define MPD_SEGMENT_BUFFER_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+template<typename T> struct WritableBuffer;
+
+/**
+ * A pool of fixed-size memory segments shared by many
+ * #SegmentBuffer instances.  It keeps a bounded number of idle
+ * segments for reuse and accounts all memory handed out, so the
+ * owner can apply backpressure when the total exceeds a limit.
+ *
+ * This class is not thread-safe.
+ */
+class SegmentPool {
+	const size_t segment_size;
+	const size_t max_idle;
+
+	/**
+	 * A LIFO list of idle segments; the first bytes of each
+	 * segment point to the next one.
+	 */
+	void *idle = nullptr;
+	size_t n_idle = 0;
+
+	/**
+	 * The number of segments owned by #SegmentBuffer instances.
+	 */
+	size_t n_busy = 0;
+
+	/**
+	 * The soft limit for the memory in #n_busy (in bytes); 0
+	 * means unlimited.
+	 */
+	size_t limit = 0;
+
+public:
+	SegmentPool(size_t _segment_size, size_t _max_idle) noexcept
+		:segment_size(_segment_size), max_idle(_max_idle) {}
+
+	~SegmentPool() noexcept;
+
+	SegmentPool(const SegmentPool &) = delete;
+	SegmentPool &operator=(const SegmentPool &) = delete;
+
+	size_t GetSegmentSize() const noexcept {
+		return segment_size;
+	}
+
+	size_t GetLimit() const noexcept {
+		return limit;
+	}
+
+	void SetLimit(size_t _limit) noexcept {
+		limit = _limit;
+	}
+
+	/**
+	 * Returns the number of bytes owned by #SegmentBuffer
+	 * instances.
+	 */
+	size_t GetBusySize() const noexcept {
+		return n_busy * segment_size;
+	}
+
+	/**
+	 * Returns the number of bytes held idle for reuse.
+	 */
+	size_t GetIdleSize() const noexcept {
+		return n_idle * segment_size;
+	}
+
+	/**
+	 * Has the memory owned by #SegmentBuffer instances exceeded
+	 * the limit?  This is not enforced by the pool; it is a
+	 * hint for the callers to stop generating more data.
+	 */
+	bool IsOverLimit() const noexcept {
+		return limit > 0 && GetBusySize() > limit;
+	}
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	gcc_malloc gcc_returns_nonnull
+	void *Allocate();
+
+	void Release(void *p) noexcept;
+
+	/**
+	 * Free all idle segments.
+	 */
+	void DiscardIdle() noexcept;
+};
+
+/**
+ * A FIFO buffer which borrows its memory from a #SegmentPool, one
+ * segment at a time, and returns each segment as soon as it has been
+ * consumed.  An empty buffer owns no memory at all.
+ */
+class SegmentBuffer {
+	struct Segment {
+		Segment *next;
+
+		/**
+		 * The range of data in this segment, relative to
+		 * GetData().
+		 */
+		size_t start, end;
+
+		uint8_t *GetData() noexcept {
+			return (uint8_t *)(this + 1);
+		}
+	};
+
+	SegmentPool &pool;
+
+	/**
+	 * The maximum number of bytes in this buffer.
+	 */
+	const size_t max_size;
+
+	Segment *head = nullptr, *tail = nullptr;
+
+	/**
+	 * The number of bytes in this buffer.
+	 */
+	size_t size = 0;
+
+public:
+	SegmentBuffer(SegmentPool &_pool, size_t _max_size) noexcept
+		:pool(_pool), max_size(_max_size) {}
+
+	~SegmentBuffer() noexcept;
+
+	SegmentBuffer(const SegmentBuffer &) = delete;
+	SegmentBuffer &operator=(const SegmentBuffer &) = delete;
+
+	bool empty() const noexcept {
+		return head == nullptr;
+	}
+
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Returns the data at the beginning of the buffer (only the
+	 * first segment).
+	 */
+	gcc_pure
+	WritableBuffer<void> Read() const noexcept;
+
+	void Consume(size_t length) noexcept;
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 *
+	 * @return false if the buffer would grow beyond its maximum
+	 * size (nothing is appended in this case)
+	 */
+	bool Append(const void *data, size_t length);
+
+private:
+	size_t GetCapacity() const noexcept {
+		return pool.GetSegmentSize() - sizeof(Segment);
+	}
+};
+
+#endif
@@ -81,6 +81,17 @@ public:
 	 */
 	void Commit(size_type start_offset, size_type end_offset) noexcept;
 
+	/**
+	 * Invoke the given function for each "defined" range, passing
+	 * its start and end offset.
+	 */
+	template<typename F>
+	void VisitDefined(F &&f) const {
+		for (const auto &i : map)
+			if (i.first < i.second)
+				f(i.first, i.second);
+	}
+
 private:
 	size_type GetEndOffset() const noexcept {
 		return std::prev(map.end())->second;
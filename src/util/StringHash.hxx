@@ -0,0 +1,88 @@
+/*
+ * Copyright 2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STRING_HASH_HXX
+#define STRING_HASH_HXX
+
+#include "StringAPI.hxx"
+#include "ASCII.hxx"
+#include "CharUtil.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A hash function object for null-terminated strings (FNV-1a), to be
+ * used with std::unordered_map and friends when the keys are plain
+ * C string pointers.
+ */
+struct StringHash {
+	gcc_pure gcc_nonnull_all
+	size_t operator()(const char *s) const noexcept {
+		size_t hash = 2166136261u;
+		for (; *s != 0; ++s)
+			hash = (hash ^ (unsigned char)*s) * 16777619u;
+		return hash;
+	}
+};
+
+/**
+ * The equality predicate matching #StringHash.
+ */
+struct StringEqual {
+	gcc_pure gcc_nonnull_all
+	bool operator()(const char *a, const char *b) const noexcept {
+		return StringIsEqual(a, b);
+	}
+};
+
+/**
+ * Like #StringHash, but ignores the case of ASCII letters.
+ */
+struct StringHashCaseASCII {
+	gcc_pure gcc_nonnull_all
+	size_t operator()(const char *s) const noexcept {
+		size_t hash = 2166136261u;
+		for (; *s != 0; ++s)
+			hash = (hash ^ (unsigned char)ToLowerASCII(*s)) * 16777619u;
+		return hash;
+	}
+};
+
+/**
+ * The equality predicate matching #StringHashCaseASCII.
+ */
+struct StringEqualCaseASCII {
+	gcc_pure gcc_nonnull_all
+	bool operator()(const char *a, const char *b) const noexcept {
+		return StringEqualsCaseASCII(a, b);
+	}
+};
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Trace.hxx"
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <algorithm>
+
+std::atomic_bool trace_enabled{false};
+
+/**
+ * The number of spans kept in the ring buffer; older spans are
+ * overwritten.
+ */
+static constexpr size_t N_TRACE_EVENTS = 32768;
+
+/**
+ * The maximum number of threads whose names are remembered.
+ */
+static constexpr unsigned MAX_TRACE_THREADS = 256;
+
+/**
+ * One slot in the ring buffer.  This is a very simple "seqlock":
+ * the writer clears #sequence, fills the other attributes and then
+ * publishes the index; TraceGetSnapshot() discards slots whose
+ * #sequence has changed while it read them.
+ */
+struct TraceEvent {
+	/**
+	 * The index of the event plus one; 0 while it is being
+	 * written.
+	 */
+	std::atomic<uint64_t> sequence;
+
+	std::atomic<const char *> name;
+
+	std::atomic_uint thread;
+
+	/**
+	 * The start and the duration in microseconds
+	 * (steady_clock).
+	 */
+	std::atomic<int64_t> start, duration;
+};
+
+/**
+ * This array lives in zero-initialized memory, so it does not
+ * occupy RAM until tracing is enabled for the first time.
+ */
+static TraceEvent trace_events[N_TRACE_EVENTS];
+
+/**
+ * The index of the next event to be written.
+ */
+static std::atomic<uint64_t> trace_next{0};
+
+/**
+ * The index of the first event recorded after the last
+ * TraceStart().
+ */
+static std::atomic<uint64_t> trace_begin{0};
+
+/**
+ * The time of the last TraceStart() in microseconds.
+ */
+static std::atomic<int64_t> trace_origin{0};
+
+struct TraceThreadName {
+	/**
+	 * Has #name been filled?
+	 */
+	std::atomic_bool valid;
+
+	char name[17];
+};
+
+static TraceThreadName trace_thread_names[MAX_TRACE_THREADS];
+
+static std::atomic_uint trace_last_thread{0};
+
+/**
+ * A small number identifying the current thread; 0 means it has
+ * not been assigned yet.
+ */
+static thread_local unsigned trace_thread;
+
+static int64_t
+ToMicroseconds(std::chrono::steady_clock::time_point t) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+/**
+ * Assign an id to the current thread and remember its name.  This
+ * is only done once for each thread.
+ */
+static unsigned
+RegisterTraceThread() noexcept
+{
+	const unsigned id = ++trace_last_thread;
+	if (id > MAX_TRACE_THREADS)
+		return id;
+
+	auto &t = trace_thread_names[id - 1];
+#if defined(__linux__) && defined(PR_GET_NAME)
+	if (prctl(PR_GET_NAME, (unsigned long)t.name, 0, 0, 0) != 0)
+		t.name[0] = 0;
+#endif
+	t.valid.store(true, std::memory_order_release);
+
+	return id;
+}
+
+void
+TraceRecord(const char *name,
+	    std::chrono::steady_clock::time_point start,
+	    std::chrono::steady_clock::time_point end) noexcept
+{
+	if (trace_thread == 0)
+		trace_thread = RegisterTraceThread();
+
+	const uint64_t i = trace_next.fetch_add(1, std::memory_order_relaxed);
+	auto &e = trace_events[i % N_TRACE_EVENTS];
+
+	e.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	e.name.store(name, std::memory_order_relaxed);
+	e.thread.store(trace_thread, std::memory_order_relaxed);
+	e.start.store(ToMicroseconds(start), std::memory_order_relaxed);
+	e.duration.store(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+			 std::memory_order_relaxed);
+
+	e.sequence.store(i + 1, std::memory_order_release);
+}
+
+void
+TraceStart() noexcept
+{
+	trace_origin.store(ToMicroseconds(std::chrono::steady_clock::now()),
+			   std::memory_order_relaxed);
+	trace_begin.store(trace_next.load(std::memory_order_relaxed),
+			  std::memory_order_relaxed);
+	trace_enabled.store(true, std::memory_order_relaxed);
+}
+
+void
+TraceStop() noexcept
+{
+	trace_enabled.store(false, std::memory_order_relaxed);
+}
+
+TraceSnapshot
+TraceGetSnapshot()
+{
+	TraceSnapshot s;
+
+	const unsigned n_threads =
+		std::min(trace_last_thread.load(), MAX_TRACE_THREADS);
+	for (unsigned id = 1; id <= n_threads; ++id) {
+		const auto &t = trace_thread_names[id - 1];
+		if (t.valid.load(std::memory_order_acquire))
+			s.threads.push_back({id, t.name});
+	}
+
+	const int64_t origin = trace_origin.load(std::memory_order_relaxed);
+	const uint64_t end = trace_next.load(std::memory_order_relaxed);
+	uint64_t i = trace_begin.load(std::memory_order_relaxed);
+	if (end - i > N_TRACE_EVENTS)
+		i = end - N_TRACE_EVENTS;
+
+	s.events.reserve(end - i);
+
+	for (; i < end; ++i) {
+		const auto &e = trace_events[i % N_TRACE_EVENTS];
+
+		if (e.sequence.load(std::memory_order_acquire) != i + 1)
+			/* not yet finished, or already overwritten */
+			continue;
+
+		TraceSnapshot::Event dest;
+		dest.name = e.name.load(std::memory_order_relaxed);
+		dest.thread = e.thread.load(std::memory_order_relaxed);
+		dest.start = e.start.load(std::memory_order_relaxed) - origin;
+		dest.duration = e.duration.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (e.sequence.load(std::memory_order_relaxed) != i + 1)
+			/* overwritten while we were reading it */
+			continue;
+
+		s.events.push_back(dest);
+	}
+
+	return s;
+}
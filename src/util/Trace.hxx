@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TRACE_HXX
+#define MPD_TRACE_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+/*
+ * Lightweight tracing of interesting code paths (client commands,
+ * database visits, decoder, player and output threads).  Spans are
+ * recorded only between TraceStart() and TraceStop(); otherwise, a
+ * #TraceSpan costs one relaxed atomic load.
+ */
+
+extern std::atomic_bool trace_enabled;
+
+gcc_pure
+static inline bool
+IsTraceEnabled() noexcept
+{
+	return trace_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Record a completed span.  This is thread-safe and lock-free.
+ *
+ * @param name a string literal which describes the span
+ */
+void
+TraceRecord(const char *name,
+	    std::chrono::steady_clock::time_point start,
+	    std::chrono::steady_clock::time_point end) noexcept;
+
+/**
+ * Measures the lifetime of this object and records it as a span if
+ * tracing is enabled.
+ */
+class TraceSpan {
+	const char *const name;
+
+	std::chrono::steady_clock::time_point start;
+
+public:
+	/**
+	 * @param _name a string literal
+	 */
+	explicit TraceSpan(const char *_name) noexcept
+		:name(_name)
+	{
+		if (gcc_unlikely(IsTraceEnabled()))
+			start = std::chrono::steady_clock::now();
+	}
+
+	~TraceSpan() noexcept {
+		if (gcc_unlikely(start != std::chrono::steady_clock::time_point()))
+			TraceRecord(name, start,
+				    std::chrono::steady_clock::now());
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+/**
+ * Discard all recorded spans and start recording.
+ */
+void
+TraceStart() noexcept;
+
+/**
+ * Stop recording.  The spans recorded so far are kept until the
+ * next TraceStart().
+ */
+void
+TraceStop() noexcept;
+
+/**
+ * A copy of the recorded spans, obtained with TraceGetSnapshot().
+ */
+struct TraceSnapshot {
+	struct Event {
+		const char *name;
+
+		/**
+		 * The thread id assigned by the tracer.
+		 */
+		unsigned thread;
+
+		/**
+		 * The start relative to TraceStart() and the duration
+		 * in microseconds.
+		 */
+		int64_t start, duration;
+	};
+
+	struct Thread {
+		unsigned id;
+		std::string name;
+	};
+
+	std::vector<Event> events;
+	std::vector<Thread> threads;
+};
+
+/**
+ * Copy the spans recorded since the last TraceStart() (at most the
+ * ring buffer size; older ones have been overwritten).  This may be
+ * called while tracing is enabled.
+ */
+TraceSnapshot
+TraceGetSnapshot();
+
+#endif
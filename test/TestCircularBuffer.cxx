@@ -148,3 +148,41 @@ TEST(CircularBuffer, Basic)
 	EXPECT_EQ(&data[3], buffer.Write().data);
 	EXPECT_EQ(size_t(5), buffer.Write().size);
 }
+
+TEST(CircularBuffer, SetCapacity)
+{
+	static size_t N = 8;
+	int data[N];
+	CircularBuffer<int> buffer(data, 4);
+
+	EXPECT_EQ(size_t(4), buffer.GetCapacity());
+	EXPECT_EQ(size_t(3), buffer.GetSpace());
+
+	/* grow while the data does not wrap */
+	buffer.Append(2);
+	EXPECT_TRUE(buffer.SetCapacity(N));
+	EXPECT_EQ(N, buffer.GetCapacity());
+	EXPECT_EQ(size_t(2), buffer.GetSize());
+	EXPECT_EQ(N - 3, buffer.GetSpace());
+
+	/* shrinking below the tail fails */
+	buffer.Consume(1);
+	EXPECT_FALSE(buffer.SetCapacity(2));
+	EXPECT_TRUE(buffer.SetCapacity(3));
+	EXPECT_EQ(size_t(3), buffer.GetCapacity());
+	EXPECT_EQ(size_t(1), buffer.GetSize());
+	EXPECT_EQ(&data[1], buffer.Read().data);
+
+	/* wrap around; now the capacity cannot be changed */
+	buffer.Append(1);
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_FALSE(buffer.SetCapacity(N));
+
+	/* an empty buffer is rewound */
+	buffer.Consume(1);
+	buffer.Consume(1);
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_TRUE(buffer.SetCapacity(N));
+	EXPECT_EQ(&data[0], buffer.Write().data);
+	EXPECT_EQ(N - 1, buffer.Write().size);
+}
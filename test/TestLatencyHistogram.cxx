@@ -0,0 +1,62 @@
+/*
+ * Unit tests for src/LatencyHistogram.hxx
+ */
+
+#include "LatencyHistogram.hxx"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono;
+
+TEST(LatencyHistogram, Empty)
+{
+	const LatencyHistogram h;
+	EXPECT_EQ(h.GetCount(), 0u);
+	EXPECT_EQ(h.GetAverage(), LatencyHistogram::Duration::zero());
+	EXPECT_EQ(h.GetMax(), LatencyHistogram::Duration::zero());
+	EXPECT_EQ(h.GetQuantile(0.5), LatencyHistogram::Duration::zero());
+}
+
+TEST(LatencyHistogram, Quantile)
+{
+	LatencyHistogram h;
+	for (unsigned i = 0; i < 99; ++i)
+		h.Add(microseconds(3));
+	h.Add(milliseconds(100));
+
+	EXPECT_EQ(h.GetCount(), 100u);
+	EXPECT_EQ(h.GetMax(), milliseconds(100));
+
+	/* the upper bound of the bucket [2..4) */
+	EXPECT_EQ(h.GetQuantile(0.5), microseconds(4));
+
+	/* never more than the maximum */
+	EXPECT_EQ(h.GetQuantile(0.99), milliseconds(100));
+	EXPECT_EQ(h.GetQuantile(1), milliseconds(100));
+}
+
+TEST(LatencyHistogram, Overflow)
+{
+	LatencyHistogram h;
+	h.Add(seconds(100));
+	h.Add(-seconds(1));
+
+	EXPECT_EQ(h.GetCount(), 2u);
+	EXPECT_EQ(h.GetMax(), seconds(100));
+	EXPECT_EQ(h.GetAverage(), seconds(50));
+	EXPECT_EQ(h.GetQuantile(1), seconds(100));
+}
+
+TEST(LatencyHistogram, Merge)
+{
+	LatencyHistogram a, b;
+	a.Add(microseconds(3));
+	b.Add(milliseconds(10));
+	b.Add(milliseconds(20));
+
+	a.Merge(b);
+	EXPECT_EQ(a.GetCount(), 3u);
+	EXPECT_EQ(a.GetMax(), milliseconds(20));
+	EXPECT_EQ(a.GetSum(), microseconds(30003));
+	EXPECT_EQ(a.GetBucket(1), 1u);
+}
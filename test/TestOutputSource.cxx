@@ -0,0 +1,302 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "output/Source.hxx"
+#include "filter/Filter.hxx"
+#include "filter/Prepared.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+struct FilterStats {
+	unsigned n_filtered = 0, n_flushed = 0;
+};
+
+/**
+ * A filter which appends its id and the number of chunks it has
+ * seen since the last Reset() to each chunk, and whose Flush()
+ * returns a tail once.
+ */
+class FakeFilter final : public Filter {
+	FilterStats &stats;
+
+	const char id;
+
+	char counter = 0;
+
+	bool flushed = false;
+
+	std::string buffer;
+
+public:
+	FakeFilter(AudioFormat _audio_format, FilterStats &_stats,
+		   char _id) noexcept
+		:Filter(_audio_format), stats(_stats), id(_id) {}
+
+	void Reset() noexcept override {
+		counter = 0;
+		flushed = false;
+	}
+
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override {
+		++stats.n_filtered;
+		flushed = false;
+
+		buffer.assign((const char *)src.data, src.size);
+		buffer.push_back(id);
+		buffer.push_back('0' + ++counter);
+		return {buffer.data(), buffer.size()};
+	}
+
+	ConstBuffer<void> Flush() override {
+		if (flushed)
+			return nullptr;
+
+		++stats.n_flushed;
+		flushed = true;
+
+		buffer = "T";
+		buffer.push_back(id);
+		buffer.push_back('0' + counter);
+		return {buffer.data(), buffer.size()};
+	}
+};
+
+class FakePreparedFilter final : public PreparedFilter {
+	FilterStats &stats;
+
+	char next_id = 'a';
+
+public:
+	explicit FakePreparedFilter(FilterStats &_stats) noexcept
+		:stats(_stats) {}
+
+	std::unique_ptr<Filter> Open(AudioFormat &af) override {
+		return std::make_unique<FakeFilter>(af, stats, next_id++);
+	}
+};
+
+static std::string
+ToString(ConstBuffer<void> b)
+{
+	return b.IsNull()
+		? std::string("(null)")
+		: std::string((const char *)b.data, b.size);
+}
+
+class OutputSourceShareTest : public ::testing::Test {
+protected:
+	const AudioFormat audio_format{44100, SampleFormat::S16, 2};
+
+	MusicBuffer buffer{16, CHUNK_SIZE};
+	MusicPipe pipe, other_pipe;
+
+	Mutex mutex;
+
+	FilterStats stats;
+	FakePreparedFilter prepared{stats};
+
+	/**
+	 * Append a chunk with the given data (one frame).
+	 */
+	void Push(MusicPipe &p, const char *data) {
+		auto chunk = buffer.Allocate();
+		ASSERT_NE(chunk, nullptr);
+
+		chunk->length = strlen(data);
+		memcpy(chunk->data, data, chunk->length);
+		chunk->replay_gain_serial = 0;
+		chunk->mix_ratio = 0;
+#ifndef NDEBUG
+		chunk->audio_format = audio_format;
+#endif
+		p.Push(std::move(chunk));
+	}
+
+	void Push(const char *data) {
+		Push(pipe, data);
+	}
+
+	void Open(AudioOutputSource &source, const MusicPipe &p) {
+		const auto out_audio_format =
+			source.Open(audio_format, p, nullptr, nullptr,
+				    prepared);
+		source.Share("test", out_audio_format);
+	}
+
+	void Open(AudioOutputSource &source) {
+		Open(source, pipe);
+	}
+
+	/**
+	 * Play the next chunk, and return its filtered data.
+	 */
+	std::string Play(AudioOutputSource &source) {
+		const std::lock_guard<Mutex> protect(mutex);
+		if (!source.Fill(mutex))
+			return "(empty)";
+
+		const auto data = source.PeekData();
+		std::string result((const char *)data.data, data.size);
+		source.ConsumeData(data.size);
+		return result;
+	}
+};
+
+TEST_F(OutputSourceShareTest, Join)
+{
+	AudioOutputSource a, b, c;
+	Open(a);
+	Open(b);
+
+	Push("abcd");
+	Push("efgh");
+
+	EXPECT_EQ(Play(a), "abcda1");
+	EXPECT_EQ(Play(b), "abcda1");
+	EXPECT_EQ(Play(b), "efgha2");
+	EXPECT_EQ(Play(a), "efgha2");
+
+	/* a late source finds its position in the history */
+	Open(c);
+	EXPECT_EQ(Play(c), "abcda1");
+	EXPECT_EQ(Play(c), "efgha2");
+
+	/* only the owner's filter has run */
+	EXPECT_EQ(stats.n_filtered, 2u);
+
+	a.Close();
+	b.Close();
+	c.Close();
+}
+
+TEST_F(OutputSourceShareTest, OwnerLeaves)
+{
+	AudioOutputSource a, b;
+	Open(a);
+	Open(b);
+
+	Push("abcd");
+	Push("efgh");
+	Push("ijkl");
+
+	EXPECT_EQ(Play(a), "abcda1");
+	EXPECT_EQ(Play(b), "abcda1");
+
+	/* the owner leaves mid-stream; the other one takes over
+	   with its own (reset) filter */
+	a.Close();
+
+	EXPECT_EQ(Play(b), "efghb1");
+	EXPECT_EQ(Play(b), "ijklb2");
+	EXPECT_EQ(stats.n_filtered, 3u);
+
+	b.Close();
+}
+
+TEST_F(OutputSourceShareTest, Handover)
+{
+	AudioOutputSource a, b, c;
+	Open(a);
+	Open(b);
+	Open(c);
+
+	Push("abcd");
+	Push("efgh");
+	Push("ijkl");
+
+	EXPECT_EQ(Play(a), "abcda1");
+	EXPECT_EQ(Play(a), "efgha2");
+	EXPECT_EQ(Play(b), "abcda1");
+	EXPECT_EQ(Play(c), "abcda1");
+
+	/* the owner leaves while the others lag behind; the
+	   history which was produced by its filter is gone, and the
+	   new owner's filter starts over */
+	a.Close();
+
+	EXPECT_EQ(Play(b), "efghb1");
+	EXPECT_EQ(Play(c), "efghb1");
+	EXPECT_EQ(Play(c), "ijklb2");
+	EXPECT_EQ(Play(b), "ijklb2");
+	EXPECT_EQ(stats.n_filtered, 4u);
+
+	b.Close();
+	c.Close();
+}
+
+TEST_F(OutputSourceShareTest, Flush)
+{
+	AudioOutputSource a, b;
+	Open(a);
+	Open(b);
+
+	Push("abcd");
+
+	EXPECT_EQ(Play(a), "abcda1");
+	EXPECT_EQ(Play(b), "abcda1");
+
+	/* the owner's filter is drained once, and all synced
+	   sources get the same tail */
+	EXPECT_EQ(ToString(a.Flush()), "Ta1");
+	EXPECT_EQ(ToString(a.Flush()), "(null)");
+	EXPECT_EQ(ToString(b.Flush()), "Ta1");
+	EXPECT_EQ(ToString(b.Flush()), "(null)");
+	EXPECT_EQ(stats.n_flushed, 1u);
+
+	/* the stream continues after the flush */
+	Push("efgh");
+	EXPECT_EQ(Play(b), "efgha2");
+	EXPECT_EQ(Play(a), "efgha2");
+
+	a.Close();
+	b.Close();
+}
+
+TEST_F(OutputSourceShareTest, Detach)
+{
+	AudioOutputSource a, b;
+	Open(a);
+	Open(b, other_pipe);
+
+	Push("abcd");
+	Push(other_pipe, "wxyz");
+
+	EXPECT_EQ(Play(a), "abcda1");
+
+	/* different input: the source falls back to its own
+	   filter */
+	EXPECT_EQ(Play(b), "wxyzb1");
+
+	Push("efgh");
+	EXPECT_EQ(Play(a), "efgha2");
+	EXPECT_EQ(stats.n_filtered, 3u);
+
+	a.Close();
+	b.Close();
+}
@@ -0,0 +1,167 @@
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+Tag::Tag(const Tag &) noexcept {}
+void Tag::Clear() noexcept {}
+
+/**
+ * Verify that the journal yields exactly the positions which a full
+ * scan would find.
+ */
+static void
+CheckChanges(const Queue &queue, uint32_t since)
+{
+	std::vector<bool> expected(queue.GetLength());
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		expected[i] = queue.IsNewerAtPosition(i, since);
+
+	QueueJournal::RangeList ranges;
+	if (!queue.journal.Collect(since, queue.version,
+				   0, queue.GetLength(), ranges))
+		return;
+
+	std::vector<bool> actual(queue.GetLength());
+	unsigned last = 0;
+	for (const auto &range : ranges) {
+		EXPECT_LE(last, range.first);
+		EXPECT_LT(range.first, range.second);
+		last = range.second;
+
+		for (unsigned i = range.first; i < range.second; ++i)
+			actual[i] = queue.IsNewerAtPosition(i, since);
+	}
+
+	EXPECT_EQ(expected, actual);
+}
+
+static void
+Append(Queue &queue, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		queue.Append(DetachedSong(std::to_string(i)), 0);
+}
+
+TEST(QueueJournal, Basic)
+{
+	Queue queue(64);
+	Append(queue, 32);
+	queue.IncrementVersion();
+
+	const uint32_t v = queue.version;
+
+	queue.ModifyAtPosition(7);
+	queue.IncrementVersion();
+
+	QueueJournal::RangeList ranges;
+	ASSERT_TRUE(queue.journal.Collect(v, queue.version,
+					  0, queue.GetLength(), ranges));
+	ASSERT_EQ(1u, ranges.size());
+	EXPECT_EQ(7u, ranges.front().first);
+	EXPECT_EQ(8u, ranges.front().second);
+
+	/* deleting a song moves (and thus modifies) all songs
+	   after it */
+	queue.DeletePosition(20);
+	queue.IncrementVersion();
+
+	ASSERT_TRUE(queue.journal.Collect(v, queue.version,
+					  0, queue.GetLength(), ranges));
+	ASSERT_EQ(2u, ranges.size());
+	EXPECT_EQ(20u, ranges.back().first);
+	EXPECT_EQ(31u, ranges.back().second);
+
+	/* versions older than the queue are not covered */
+	EXPECT_FALSE(queue.journal.Collect(0, queue.version,
+					   0, queue.GetLength(), ranges));
+	EXPECT_FALSE(queue.journal.Collect(queue.version + 1, queue.version,
+					   0, queue.GetLength(), ranges));
+}
+
+TEST(QueueJournal, Random)
+{
+	Queue queue(256);
+	Append(queue, 128);
+	queue.IncrementVersion();
+
+	const uint32_t first = queue.version;
+	srand(42);
+
+	for (unsigned step = 0; step < 500; ++step) {
+		const unsigned length = queue.GetLength();
+
+		switch (rand() % 5) {
+		case 0:
+			queue.ModifyAtPosition(rand() % length);
+			break;
+
+		case 1:
+			queue.SwapPositions(rand() % length, rand() % length);
+			break;
+
+		case 2:
+			queue.MovePostion(rand() % length, rand() % length);
+			break;
+
+		case 3:
+			if (length > 16) {
+				const unsigned start = rand() % (length - 4);
+				queue.DeleteRange(start, start + 4);
+			}
+			break;
+
+		case 4:
+			if (!queue.IsFull())
+				Append(queue, 1);
+			break;
+		}
+
+		queue.IncrementVersion();
+
+		const uint32_t oldest = queue.version > first + 16
+			? queue.version - 16
+			: first;
+		for (uint32_t since = oldest; since <= queue.version; ++since)
+			CheckChanges(queue, since);
+	}
+}
+
+TEST(QueueJournal, Overflow)
+{
+	Queue queue(1024);
+	Append(queue, 1024);
+	queue.IncrementVersion();
+
+	const uint32_t v = queue.version;
+
+	/* non-adjacent modifications can't be merged */
+	for (unsigned i = 0; i < 1024; i += 2)
+		queue.ModifyAtPosition(i);
+	queue.IncrementVersion();
+
+	QueueJournal::RangeList ranges;
+	EXPECT_FALSE(queue.journal.Collect(v, queue.version,
+					   0, queue.GetLength(), ranges));
+
+	/* newer versions are still covered */
+	const uint32_t v2 = queue.version;
+	queue.ModifyAtPosition(3);
+	queue.IncrementVersion();
+	EXPECT_TRUE(queue.journal.Collect(v2, queue.version,
+					  0, queue.GetLength(), ranges));
+	CheckChanges(queue, v2);
+
+	/* clearing the queue resets the journal */
+	queue.Clear();
+	Append(queue, 4);
+	queue.IncrementVersion();
+	EXPECT_TRUE(queue.journal.Collect(v, queue.version,
+					  0, queue.GetLength(), ranges));
+	CheckChanges(queue, v);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+Tag::Tag(const Tag &) noexcept {}
+void Tag::Clear() noexcept {}
+
+static std::vector<unsigned>
+Positions(std::initializer_list<unsigned> l)
+{
+	return std::vector<unsigned>(l);
+}
+
+TEST(QueueUriIndex, Basic)
+{
+	Queue queue(16);
+	queue.Append(DetachedSong("a"), 0);
+	queue.Append(DetachedSong("b"), 0);
+	queue.Append(DetachedSong("a"), 0);
+	queue.Append(DetachedSong("c"), 0);
+
+	EXPECT_TRUE(queue.ContainsURI("a"));
+	EXPECT_TRUE(queue.ContainsURI("c"));
+	EXPECT_FALSE(queue.ContainsURI("d"));
+	EXPECT_EQ(queue.FindURI("a"), Positions({0, 2}));
+	EXPECT_EQ(queue.FindURI("b"), Positions({1}));
+	EXPECT_TRUE(queue.FindURI("d").empty());
+
+	/* positions follow moves and deletions */
+
+	queue.MovePostion(2, 0);
+	EXPECT_EQ(queue.FindURI("a"), Positions({0, 1}));
+	EXPECT_EQ(queue.FindURI("b"), Positions({2}));
+
+	queue.DeletePosition(0);
+	EXPECT_EQ(queue.FindURI("a"), Positions({0}));
+	EXPECT_EQ(queue.FindURI("b"), Positions({1}));
+	EXPECT_EQ(queue.FindURI("c"), Positions({2}));
+
+	queue.DeleteRange(0, 2);
+	EXPECT_FALSE(queue.ContainsURI("a"));
+	EXPECT_FALSE(queue.ContainsURI("b"));
+	EXPECT_EQ(queue.FindURI("c"), Positions({0}));
+
+	queue.Clear();
+	EXPECT_FALSE(queue.ContainsURI("c"));
+}
+
+TEST(QueueUriIndex, Shuffle)
+{
+	Queue queue(64);
+	for (unsigned i = 0; i < 32; ++i)
+		queue.Append(DetachedSong(std::to_string(i % 8)), 0);
+
+	queue.ShuffleRange(0, 32);
+
+	for (unsigned i = 0; i < 8; ++i) {
+		const auto uri = std::to_string(i);
+		const auto positions = queue.FindURI(uri);
+		EXPECT_EQ(positions.size(), 4u);
+
+		for (unsigned p : positions)
+			EXPECT_STREQ(queue.Get(p).GetURI(), uri.c_str());
+	}
+}
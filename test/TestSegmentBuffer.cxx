@@ -0,0 +1,104 @@
+/*
+ * Unit tests for class SegmentBuffer.
+ */
+
+#include "util/SegmentBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+static std::string
+ReadAll(SegmentBuffer &buffer)
+{
+	std::string result;
+
+	while (!buffer.empty()) {
+		const auto r = buffer.Read();
+		result.append((const char *)r.data, r.size);
+		buffer.Consume(r.size);
+	}
+
+	return result;
+}
+
+TEST(SegmentBuffer, Basic)
+{
+	SegmentPool pool(256, 4);
+	SegmentBuffer buffer(pool, 4096);
+
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_TRUE(buffer.Read().empty());
+	EXPECT_EQ(pool.GetBusySize(), 0u);
+
+	std::string expected;
+	for (unsigned i = 0; i < 100; ++i) {
+		const std::string line = "line " + std::to_string(i) + "\n";
+		EXPECT_TRUE(buffer.Append(line.data(), line.size()));
+		expected += line;
+	}
+
+	EXPECT_FALSE(buffer.empty());
+	EXPECT_EQ(buffer.GetSize(), expected.size());
+	EXPECT_GT(pool.GetBusySize(), expected.size());
+
+	/* the segments are returned as soon as they are consumed */
+	EXPECT_EQ(ReadAll(buffer), expected);
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_EQ(buffer.GetSize(), 0u);
+	EXPECT_EQ(pool.GetBusySize(), 0u);
+	EXPECT_EQ(pool.GetIdleSize(), 4u * 256u);
+}
+
+TEST(SegmentBuffer, PartialConsume)
+{
+	SegmentPool pool(64, 1);
+	SegmentBuffer buffer(pool, 1024);
+
+	const std::string data(300, 'x');
+	EXPECT_TRUE(buffer.Append(data.data(), data.size()));
+
+	auto r = buffer.Read();
+	ASSERT_FALSE(r.empty());
+	buffer.Consume(1);
+	EXPECT_EQ(buffer.GetSize(), data.size() - 1);
+	EXPECT_EQ(buffer.Read().size, r.size - 1);
+
+	EXPECT_EQ(ReadAll(buffer), data.substr(1));
+	EXPECT_EQ(pool.GetBusySize(), 0u);
+	EXPECT_EQ(pool.GetIdleSize(), 64u);
+}
+
+TEST(SegmentBuffer, MaxSize)
+{
+	SegmentPool pool(64, 4);
+	SegmentBuffer buffer(pool, 100);
+
+	const std::string data(60, 'x');
+	EXPECT_TRUE(buffer.Append(data.data(), data.size()));
+
+	/* too large: nothing is appended */
+	EXPECT_FALSE(buffer.Append(data.data(), data.size()));
+	EXPECT_EQ(buffer.GetSize(), data.size());
+
+	EXPECT_TRUE(buffer.Append(data.data(), 40));
+	EXPECT_EQ(buffer.GetSize(), 100u);
+}
+
+TEST(SegmentPool, Limit)
+{
+	SegmentPool pool(64, 4);
+	EXPECT_FALSE(pool.IsOverLimit());
+
+	pool.SetLimit(100);
+
+	{
+		SegmentBuffer buffer(pool, 1024);
+		const std::string data(200, 'x');
+		EXPECT_TRUE(buffer.Append(data.data(), data.size()));
+		EXPECT_TRUE(pool.IsOverLimit());
+	}
+
+	EXPECT_FALSE(pool.IsOverLimit());
+}
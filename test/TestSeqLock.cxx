@@ -0,0 +1,59 @@
+/*
+ * Unit tests for class SeqLock.
+ */
+
+#include "thread/SeqLock.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+struct Pair {
+	unsigned a, b;
+	uint16_t c;
+};
+
+}
+
+TEST(SeqLock, Basic)
+{
+	SeqLock<Pair> lock(Pair{1, 2, 3});
+
+	auto value = lock.Load();
+	EXPECT_EQ(1u, value.a);
+	EXPECT_EQ(2u, value.b);
+	EXPECT_EQ(3u, value.c);
+
+	lock.Store(Pair{4, 5, 6});
+	value = lock.Load();
+	EXPECT_EQ(4u, value.a);
+	EXPECT_EQ(5u, value.b);
+	EXPECT_EQ(6u, value.c);
+}
+
+TEST(SeqLock, Concurrent)
+{
+	SeqLock<Pair> lock(Pair{0, ~0u, 0});
+	std::atomic<bool> done{false};
+
+	std::thread writer([&lock, &done](){
+		for (unsigned i = 1; i <= 100000; ++i)
+			lock.Store(Pair{i, ~i, uint16_t(i)});
+		done = true;
+	});
+
+	/* a reader must never see a torn value */
+	while (!done) {
+		const auto value = lock.Load();
+		ASSERT_EQ(value.a, ~value.b);
+		ASSERT_EQ(uint16_t(value.a), value.c);
+	}
+
+	writer.join();
+
+	const auto value = lock.Load();
+	EXPECT_EQ(100000u, value.a);
+}
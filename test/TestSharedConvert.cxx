@@ -0,0 +1,158 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "filter/plugins/SharedConvert.hxx"
+#include "pcm/ConfiguredResampler.hxx"
+#include "pcm/Resampler.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+/**
+ * A fake resampler which delays its input by #DELAY bytes; these
+ * are returned by Flush().
+ */
+class DelayResampler final : public PcmResampler {
+	static constexpr size_t DELAY = 8;
+
+	std::string pending, output;
+
+	bool flushed;
+
+public:
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override {
+		Reset();
+		return AudioFormat(new_sample_rate, af.format, af.channels);
+	}
+
+	void Close() noexcept override {}
+
+	void Reset() noexcept override {
+		pending.assign(DELAY, '_');
+		flushed = false;
+	}
+
+	ConstBuffer<void> Resample(ConstBuffer<void> src) override {
+		flushed = false;
+		output = pending;
+		output.append((const char *)src.data, src.size);
+		pending = output.substr(output.size() - DELAY);
+		output.resize(output.size() - DELAY);
+		return {output.data(), output.size()};
+	}
+
+	ConstBuffer<void> Flush() override {
+		if (flushed)
+			return nullptr;
+
+		flushed = true;
+		output = pending;
+		return {output.data(), output.size()};
+	}
+};
+
+/* these replace the ones from ConfiguredResampler.cxx */
+
+void
+pcm_resampler_global_init(const ConfigData &)
+{
+}
+
+PcmResampler *
+pcm_resampler_create(const PcmResamplerProfile *)
+{
+	return new DelayResampler();
+}
+
+static std::string
+ToString(ConstBuffer<void> b)
+{
+	return b.IsNull()
+		? std::string("(null)")
+		: std::string((const char *)b.data, b.size);
+}
+
+static constexpr AudioFormat src_format(44100, SampleFormat::S16, 2);
+static constexpr AudioFormat dest_format(48000, SampleFormat::S16, 2);
+
+static std::string
+Convert(SharedPcmConvert &c, const char *data)
+{
+	return ToString(c.Convert({data, strlen(data)}));
+}
+
+TEST(SharedPcmConvert, Share)
+{
+	SharedPcmConvert a, b;
+	a.Open(src_format, dest_format);
+	b.Open(src_format, dest_format);
+
+	EXPECT_EQ(Convert(a, "abcdefghijklmnop"), "________abcdefgh");
+	EXPECT_EQ(Convert(b, "abcdefghijklmnop"), "________abcdefgh");
+	EXPECT_EQ(Convert(b, "ABCDEFGH"), "ijklmnop");
+	EXPECT_EQ(Convert(a, "ABCDEFGH"), "ijklmnop");
+
+	a.Close();
+	b.Close();
+}
+
+TEST(SharedPcmConvert, Flush)
+{
+	SharedPcmConvert a, b;
+	a.Open(src_format, dest_format);
+	b.Open(src_format, dest_format);
+
+	EXPECT_EQ(Convert(a, "abcdefghijklmnop"), "________abcdefgh");
+	EXPECT_EQ(Convert(b, "abcdefghijklmnop"), "________abcdefgh");
+
+	/* the other instance is still synced; the tail is
+	   reconstructed by the private converter */
+	EXPECT_EQ(ToString(a.Flush()), "ijklmnop");
+	EXPECT_EQ(ToString(a.Flush()), "(null)");
+
+	/* the last one drains the shared converter */
+	EXPECT_EQ(ToString(b.Flush()), "ijklmnop");
+	EXPECT_EQ(ToString(b.Flush()), "(null)");
+
+	a.Close();
+	b.Close();
+}
+
+TEST(SharedPcmConvert, FlushLagging)
+{
+	SharedPcmConvert a, b;
+	a.Open(src_format, dest_format);
+	b.Open(src_format, dest_format);
+
+	EXPECT_EQ(Convert(a, "abcdefghijklmnop"), "________abcdefgh");
+	EXPECT_EQ(Convert(a, "ABCDEFGH"), "ijklmnop");
+	EXPECT_EQ(Convert(b, "abcdefghijklmnop"), "________abcdefgh");
+
+	/* the shared converter is already ahead of b */
+	EXPECT_EQ(ToString(b.Flush()), "ijklmnop");
+	EXPECT_EQ(ToString(a.Flush()), "ABCDEFGH");
+
+	a.Close();
+	b.Close();
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include <string.h>
+
+/**
+ * An encoder which copies its input, framed by a header ("<") and
+ * a trailer (">").  If it implements tags, its streams are
+ * considered chainable.
+ */
+class FakeEncoder final : public Encoder {
+	std::string buffer;
+
+public:
+	explicit FakeEncoder(bool _implements_tag) noexcept
+		:Encoder(_implements_tag), buffer("<") {}
+
+	void End() override {
+		buffer.push_back('>');
+	}
+
+	void Write(const void *data, size_t length) override {
+		buffer.append((const char *)data, length);
+	}
+
+	size_t Read(void *dest, size_t length) override {
+		const size_t nbytes = std::min(length, buffer.size());
+		memcpy(dest, buffer.data(), nbytes);
+		buffer.erase(0, nbytes);
+		return nbytes;
+	}
+};
+
+class FakePreparedEncoder final : public PreparedEncoder {
+	unsigned &n_opened;
+
+	const bool chainable;
+
+public:
+	FakePreparedEncoder(unsigned &_n_opened, bool _chainable) noexcept
+		:n_opened(_n_opened), chainable(_chainable) {}
+
+	Encoder *Open(AudioFormat &) override {
+		++n_opened;
+		return new FakeEncoder(chainable);
+	}
+};
+
+static std::string
+ReadAll(Encoder &encoder)
+{
+	std::string result;
+	char buffer[3];
+
+	size_t nbytes;
+	while ((nbytes = encoder.Read(buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+
+	return result;
+}
+
+static void
+Write(Encoder &encoder, const char *s)
+{
+	encoder.Write(s, strlen(s));
+}
+
+class SharedEncoderTest : public ::testing::Test {
+protected:
+	unsigned n_opened = 0;
+
+	std::unique_ptr<PreparedEncoder> prepared;
+
+	AudioFormat audio_format{44100, SampleFormat::S16, 2};
+
+	void SetUp() override {
+		Prepare(true);
+	}
+
+	void Prepare(bool chainable) {
+		prepared.reset(shared_encoder_new("test",
+						  new FakePreparedEncoder(n_opened,
+									  chainable)));
+	}
+
+	Encoder *Open() {
+		return prepared->Open(audio_format);
+	}
+};
+
+TEST_F(SharedEncoderTest, Share)
+{
+	std::unique_ptr<Encoder> a(Open()), b(Open());
+
+	Write(*a, "ab");
+	Write(*b, "ab");
+	Write(*a, "cd");
+	Write(*b, "cd");
+
+	EXPECT_EQ(ReadAll(*a), "<abcd");
+	EXPECT_EQ(ReadAll(*b), "<abcd");
+	EXPECT_EQ(n_opened, 1u);
+}
+
+TEST_F(SharedEncoderTest, EndWhileOthersSynced)
+{
+	std::unique_ptr<Encoder> a(Open()), b(Open());
+
+	Write(*a, "ab");
+	Write(*b, "ab");
+
+	/* the ending instance gets the trailer */
+	a->End();
+	EXPECT_EQ(ReadAll(*a), "<ab>");
+	a.reset();
+
+	/* the other one continues with a new stream */
+	Write(*b, "cd");
+	EXPECT_EQ(ReadAll(*b), "<ab><cd");
+	EXPECT_EQ(n_opened, 2u);
+}
+
+TEST_F(SharedEncoderTest, EndLagging)
+{
+	std::unique_ptr<Encoder> a(Open()), b(Open());
+
+	Write(*a, "ab");
+	Write(*a, "cd");
+	Write(*b, "ab");
+
+	/* the lagging instance catches up before the trailer */
+	b->End();
+	EXPECT_EQ(ReadAll(*b), "<abcd>");
+	b.reset();
+
+	Write(*a, "ef");
+	EXPECT_EQ(ReadAll(*a), "<abcd><ef");
+}
+
+TEST_F(SharedEncoderTest, EndAll)
+{
+	std::unique_ptr<Encoder> a(Open()), b(Open());
+
+	Write(*a, "ab");
+	Write(*b, "ab");
+	a->End();
+	b->End();
+
+	EXPECT_EQ(ReadAll(*a), "<ab>");
+	EXPECT_EQ(ReadAll(*b), "<ab>");
+	EXPECT_EQ(n_opened, 1u);
+}
+
+TEST_F(SharedEncoderTest, NotChainable)
+{
+	Prepare(false);
+
+	std::unique_ptr<Encoder> a(Open()), b(Open());
+
+	Write(*a, "ab");
+	Write(*b, "ab");
+	a->End();
+	Write(*b, "cd");
+
+	/* each instance has its own stream, without a trailer and a
+	   new header in the middle */
+	EXPECT_EQ(ReadAll(*a), "<ab>");
+	EXPECT_EQ(ReadAll(*b), "<abcd");
+}
@@ -0,0 +1,518 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of decoder plugins.  Each
+ * file is decoded repeatedly by each enabled plugin which supports
+ * its suffix (or only by the one specified with "--plugin"), and the
+ * decoded PCM data is discarded.  After that, a number of seeks to
+ * evenly distributed positions are performed.
+ *
+ * Each line of its output describes one file/plugin combination,
+ * with tab-separated columns: file, plugin, audio format, seconds of
+ * audio, real-time factor, input MB/s, output MB/s, malloc() calls
+ * per run (only with glibc, otherwise "-"), number of seeks, seek
+ * errors, median and maximum seek latency (in microseconds, from the
+ * seek command until the first chunk of data at the new position).
+ */
+
+#include "ConfigGlue.hxx"
+#include "LatencyHistogram.hxx"
+#include "event/Thread.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
+#include "tag/Tag.hxx"
+#include "AudioFormat.hxx"
+#include "MixRampInfo.hxx"
+#include "util/OptionDef.hxx"
+#include "util/OptionParser.hxx"
+#include "util/PrintException.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/UriUtil.hxx"
+#include "Log.hxx"
+#include "LogBackend.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef __GLIBC__
+
+/*
+ * Count all malloc() calls (including those in the codec libraries)
+ * by interposing glibc's allocator.
+ */
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+}
+
+static std::atomic<uint64_t> n_allocations;
+
+void *
+malloc(size_t size) noexcept
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size) noexcept
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *p, size_t size) noexcept
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+
+#define HAVE_ALLOCATION_COUNTER
+
+#endif
+
+static uint64_t
+GetAllocationCount() noexcept
+{
+#ifdef HAVE_ALLOCATION_COUNTER
+	return n_allocations.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+struct CommandLine {
+	const char *plugin = nullptr;
+
+	std::vector<const char *> files;
+
+	Path config_path = nullptr;
+
+	unsigned repeat = 3;
+
+	unsigned seeks = 10;
+
+	bool verbose = false;
+};
+
+enum Option {
+	OPTION_CONFIG,
+	OPTION_PLUGIN,
+	OPTION_REPEAT,
+	OPTION_SEEKS,
+	OPTION_VERBOSE,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"config", 0, true, "Load a MPD configuration file"},
+	{"plugin", 0, true, "Use only this decoder plugin"},
+	{"repeat", 0, true, "Decode each file this many times (default 3)"},
+	{"seeks", 0, true, "Number of seeks per file (default 10)"},
+	{"verbose", 'v', false, "Verbose logging"},
+};
+
+static unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0)
+		throw std::runtime_error("Not a number");
+
+	return value;
+}
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_CONFIG:
+			c.config_path = Path::FromFS(o.value);
+			break;
+
+		case OPTION_PLUGIN:
+			c.plugin = o.value;
+			break;
+
+		case OPTION_REPEAT:
+			c.repeat = ParseUnsigned(o.value);
+			if (c.repeat == 0)
+				throw std::runtime_error("Invalid repeat count");
+			break;
+
+		case OPTION_SEEKS:
+			c.seeks = ParseUnsigned(o.value);
+			break;
+
+		case OPTION_VERBOSE:
+			c.verbose = true;
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.empty())
+		throw std::runtime_error("Usage: bench_decoder [--verbose] [--config=FILE] [--plugin=NAME] [--repeat=N] [--seeks=N] FILE...");
+
+	c.files.assign(args.begin(), args.end());
+	return c;
+}
+
+class GlobalInit {
+	const ConfigData config;
+	EventThread io_thread;
+	const ScopeInputPluginsInit input_plugins_init;
+	const ScopeDecoderPluginsInit decoder_plugins_init;
+
+public:
+	explicit GlobalInit(Path config_path)
+		:config(AutoLoadConfigFile(config_path)),
+		 input_plugins_init(config, io_thread.GetEventLoop()),
+		 decoder_plugins_init(config)
+	{
+		io_thread.Start();
+	}
+};
+
+/**
+ * A #DecoderClient implementation which counts and discards the
+ * decoded data.  If a list of seek positions is given, it seeks to
+ * each of them (after having received at least one chunk at the
+ * previous position) and then stops the decoder.
+ */
+class BenchDecoderClient final : public DecoderClient {
+	const std::vector<SongTime> seek_targets;
+	size_t next_seek = 0;
+
+	DecoderCommand command = DecoderCommand::NONE;
+
+	SongTime seek_time;
+
+	Clock::time_point seek_start;
+
+	/**
+	 * Has a seek finished, and we're waiting for the first chunk
+	 * of data?
+	 */
+	bool awaiting_data = false;
+
+public:
+	Mutex mutex;
+
+	AudioFormat audio_format = AudioFormat::Undefined();
+	bool initialized = false, seekable = false;
+	SignedSongTime duration = SignedSongTime::Negative();
+
+	uint64_t n_bytes = 0;
+
+	LatencyHistogram seek_latency;
+	unsigned seek_errors = 0;
+
+	BenchDecoderClient() = default;
+
+	explicit BenchDecoderClient(std::vector<SongTime> &&_seek_targets) noexcept
+		:seek_targets(std::move(_seek_targets)) {}
+
+	double GetAudioSeconds() const noexcept {
+		return initialized
+			? double(n_bytes) / (audio_format.GetFrameSize() *
+					    audio_format.sample_rate)
+			: 0;
+	}
+
+private:
+	void StartNextSeek() noexcept {
+		if (seek_targets.empty())
+			return;
+
+		if (!seekable || next_seek >= seek_targets.size()) {
+			command = DecoderCommand::STOP;
+			return;
+		}
+
+		seek_time = seek_targets[next_seek++];
+		seek_start = Clock::now();
+		command = DecoderCommand::SEEK;
+	}
+
+public:
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat _audio_format,
+		   bool _seekable, SignedSongTime _duration) override {
+		audio_format = _audio_format;
+		seekable = _seekable;
+		duration = _duration;
+		initialized = true;
+	}
+
+	DecoderCommand GetCommand() noexcept override {
+		return command;
+	}
+
+	void CommandFinished() override {
+		if (command == DecoderCommand::SEEK)
+			awaiting_data = true;
+
+		command = DecoderCommand::NONE;
+	}
+
+	SongTime GetSeekTime() noexcept override {
+		return seek_time;
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return seek_time.ToScale<uint64_t>(audio_format.sample_rate);
+	}
+
+	void SeekError() override {
+		++seek_errors;
+		command = DecoderCommand::NONE;
+		StartNextSeek();
+	}
+
+	InputStreamPtr OpenUri(const char *uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is, void *buffer, size_t length) override {
+		try {
+			return is.LockRead(buffer, length);
+		} catch (...) {
+			return 0;
+		}
+	}
+
+	void SubmitTimestamp(FloatDuration) override {
+	}
+
+	DecoderCommand SubmitData(InputStream *,
+				  const void *, size_t length,
+				  uint16_t) override {
+		n_bytes += length;
+
+		if (awaiting_data) {
+			awaiting_data = false;
+			seek_latency.Add(Clock::now() - seek_start);
+		}
+
+		if (command == DecoderCommand::NONE)
+			StartNextSeek();
+
+		return command;
+	}
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) override {
+		return command;
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *) override {
+	}
+
+	void SubmitMixRamp(MixRampInfo &&) override {
+	}
+};
+
+static void
+Decode(const DecoderPlugin &plugin, const char *uri,
+       BenchDecoderClient &client)
+{
+	if (plugin.file_decode != nullptr) {
+		plugin.FileDecode(client, Path::FromFS(uri));
+	} else {
+		auto is = InputStream::OpenReady(uri, client.mutex);
+		plugin.StreamDecode(client, *is);
+	}
+}
+
+static double
+ToSeconds(Clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::duration<double>>(d).count();
+}
+
+static long long
+ToMicroseconds(Clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+static void
+PrintHeader() noexcept
+{
+	printf("# file\tplugin\tformat\taudio_s\trtf\tin_MB/s\tout_MB/s\tmallocs\tseeks\tseek_errors\tseek_p50_us\tseek_max_us\n");
+}
+
+static void
+Bench(const DecoderPlugin &plugin, const char *uri,
+      uint64_t file_size, const CommandLine &c)
+{
+	AudioFormat audio_format = AudioFormat::Undefined();
+	SignedSongTime duration = SignedSongTime::Negative();
+	double audio_seconds = 0;
+	uint64_t n_bytes = 0;
+	uint64_t total_allocations = 0;
+	Clock::duration elapsed = Clock::duration::zero();
+
+	for (unsigned i = 0; i < c.repeat; ++i) {
+		BenchDecoderClient client;
+
+		const uint64_t allocations_before = GetAllocationCount();
+		const auto start = Clock::now();
+		Decode(plugin, uri, client);
+		elapsed += Clock::now() - start;
+		total_allocations += GetAllocationCount() - allocations_before;
+
+		if (!client.initialized) {
+			fprintf(stderr, "%s: decoding with %s failed\n",
+				uri, plugin.name);
+			return;
+		}
+
+		audio_format = client.audio_format;
+		duration = client.duration;
+		audio_seconds += client.GetAudioSeconds();
+		n_bytes += client.n_bytes;
+	}
+
+	LatencyHistogram seek_latency;
+	unsigned seek_errors = 0;
+
+	if (c.seeks > 0 && duration.IsPositive()) {
+		std::vector<SongTime> targets;
+		targets.reserve(c.seeks);
+
+		/* alternate between the second and the first half, so
+		   each seek goes to a distant position */
+		for (unsigned i = 0; i < c.seeks; ++i) {
+			const unsigned j = i % 2 == 0
+				? c.seeks / 2 + i / 2
+				: i / 2;
+			const uint64_t ms = uint64_t(duration.ToMS())
+				* (2 * j + 1) / (2 * c.seeks);
+			targets.push_back(SongTime::FromMS(ms));
+		}
+
+		BenchDecoderClient client(std::move(targets));
+		Decode(plugin, uri, client);
+		seek_latency = client.seek_latency;
+		seek_errors = client.seek_errors;
+	}
+
+	const double seconds = ToSeconds(elapsed);
+
+	printf("%s\t%s\t%s\t%.1f\t%.1f\t%.2f\t%.2f\t",
+	       uri, plugin.name, ToString(audio_format).c_str(),
+	       audio_seconds / c.repeat,
+	       audio_seconds / seconds,
+	       double(file_size) * c.repeat / seconds / (1024 * 1024),
+	       double(n_bytes) / seconds / (1024 * 1024));
+
+#ifdef HAVE_ALLOCATION_COUNTER
+	printf("%llu\t", (unsigned long long)(total_allocations / c.repeat));
+#else
+	(void)total_allocations;
+	printf("-\t");
+#endif
+
+	printf("%llu\t%u\t%lld\t%lld\n",
+	       (unsigned long long)seek_latency.GetCount(), seek_errors,
+	       ToMicroseconds(seek_latency.GetQuantile(0.5)),
+	       ToMicroseconds(seek_latency.GetMax()));
+	fflush(stdout);
+}
+
+static bool
+IsUsable(const DecoderPlugin &plugin) noexcept
+{
+	return plugin.file_decode != nullptr || plugin.stream_decode != nullptr;
+}
+
+int main(int argc, char **argv)
+try {
+	const auto c = ParseCommandLine(argc, argv);
+
+	SetLogThreshold(c.verbose ? LogLevel::DEBUG : LogLevel::WARNING);
+	const GlobalInit init(c.config_path);
+
+	const DecoderPlugin *only_plugin = nullptr;
+	if (c.plugin != nullptr) {
+		only_plugin = decoder_plugin_from_name(c.plugin);
+		if (only_plugin == nullptr || !IsUsable(*only_plugin)) {
+			fprintf(stderr, "No such decoder: %s\n", c.plugin);
+			return EXIT_FAILURE;
+		}
+	}
+
+	PrintHeader();
+
+	for (const char *uri : c.files) {
+		const uint64_t file_size = FileInfo(Path::FromFS(uri)).GetSize();
+
+		if (only_plugin != nullptr) {
+			Bench(*only_plugin, uri, file_size, c);
+			continue;
+		}
+
+		const char *suffix = uri_get_suffix(uri);
+		if (suffix == nullptr) {
+			fprintf(stderr, "%s: no file name suffix\n", uri);
+			continue;
+		}
+
+		bool found = false;
+		for (unsigned i : decoder_plugins_by_suffix(suffix)) {
+			const DecoderPlugin &plugin = *decoder_plugins[i];
+			if (!decoder_plugin_prepare(i) || !IsUsable(plugin))
+				continue;
+
+			found = true;
+			Bench(plugin, uri, file_size, c);
+		}
+
+		if (!found)
+			fprintf(stderr, "%s: no decoder plugin\n", uri);
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,514 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of MPD's PCM library.  Each
+ * line of its output describes one benchmark, with tab-separated
+ * columns: name, input format, output format, and input samples
+ * (not frames) per second.
+ */
+
+#include "config.h"
+#include "AudioFormat.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/ChannelsConverter.hxx"
+#include "pcm/FallbackResampler.hxx"
+#include "config/Block.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/PrintException.hxx"
+
+#ifdef ENABLE_DSD
+#include "pcm/PcmDsd.hxx"
+#endif
+
+#ifdef ENABLE_LIBSAMPLERATE
+#include "pcm/LibsamplerateResampler.hxx"
+#endif
+
+#ifdef ENABLE_SOXR
+#include "pcm/SoxrResampler.hxx"
+#endif
+
+#include <chrono>
+#include <memory>
+#include <random>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * The number of frames passed to each call.
+ */
+static constexpr size_t N_FRAMES = 4096;
+
+static constexpr unsigned SAMPLE_RATE = 44100;
+
+static std::chrono::steady_clock::duration min_duration =
+	std::chrono::milliseconds(200);
+
+static constexpr SampleFormat integer_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+};
+
+static constexpr SampleFormat all_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+/**
+ * Pretend to use the given pointer, to prevent the compiler from
+ * optimizing away calls to (gcc_pure) functions whose result is not
+ * used otherwise.
+ */
+static inline void
+DoNotOptimize(const void *p) noexcept
+{
+	asm volatile("" : : "g"(p) : "memory");
+}
+
+/**
+ * A buffer of random (but valid) samples.
+ */
+class InputBuffer {
+	std::unique_ptr<uint8_t[]> data;
+	size_t size;
+
+public:
+	explicit InputBuffer(AudioFormat af, size_t n_frames=N_FRAMES)
+		:data(new uint8_t[n_frames * af.GetFrameSize()]),
+		 size(n_frames * af.GetFrameSize()) {
+		std::minstd_rand engine;
+
+		switch (af.format) {
+		case SampleFormat::S24_P32:
+			for (auto *p = (int32_t *)data.get(), *end = p + size / 4;
+			     p != end; ++p)
+				*p = int32_t(engine() << 8) >> 8;
+			break;
+
+		case SampleFormat::FLOAT:
+			{
+				std::uniform_real_distribution<float> dis(-1.0, 1.0);
+				for (auto *p = (float *)data.get(), *end = p + size / 4;
+				     p != end; ++p)
+					*p = dis(engine);
+			}
+			break;
+
+		default:
+			for (size_t i = 0; i < size; ++i)
+				data[i] = engine();
+			break;
+		}
+	}
+
+	void *GetWritable() noexcept {
+		return data.get();
+	}
+
+	ConstBuffer<void> Get() const noexcept {
+		return {data.get(), size};
+	}
+};
+
+static void
+PrintHeader() noexcept
+{
+	printf("# benchmark\tinput\toutput\tsamples/s\n");
+}
+
+/**
+ * Call the given function repeatedly for at least #min_duration and
+ * print the throughput.  The function returns a pointer to its
+ * output.
+ *
+ * @param n_samples the number of input samples consumed by each
+ * call
+ */
+template<typename F>
+static void
+Run(const char *name, AudioFormat in, AudioFormat out,
+    size_t n_samples, F &&f)
+{
+	using std::chrono::steady_clock;
+
+	/* warm up (fill buffers, initialize lookup tables) */
+	DoNotOptimize(f());
+
+	unsigned long n_calls = 0;
+	const auto start = steady_clock::now();
+	steady_clock::duration elapsed;
+
+	do {
+		DoNotOptimize(f());
+		++n_calls;
+		elapsed = steady_clock::now() - start;
+	} while (elapsed < min_duration);
+
+	const double seconds =
+		std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+
+	printf("%s\t%s\t%s\t%.0f\n", name,
+	       ToString(in).c_str(), ToString(out).c_str(),
+	       double(n_calls) * n_samples / seconds);
+	fflush(stdout);
+}
+
+static void
+BenchVolume()
+{
+	for (const auto format : all_formats) {
+		const AudioFormat af(SAMPLE_RATE, format, 2);
+		const InputBuffer input(af);
+
+		PcmVolume pv;
+		pv.Open(format);
+		pv.SetVolume(PCM_VOLUME_1 * 7 / 10);
+
+		Run("volume", af, af, N_FRAMES * af.channels, [&](){
+				return pv.Apply(input.Get()).data;
+			});
+
+		pv.Close();
+	}
+}
+
+static void
+BenchMix()
+{
+	for (const auto format : all_formats) {
+		const AudioFormat af(SAMPLE_RATE, format, 2);
+		const InputBuffer b(af);
+		InputBuffer dest(af);
+		PcmDither dither;
+
+		/* cross-fade */
+		Run("mix", af, af, N_FRAMES * af.channels, [&](){
+				if (!pcm_mix(dither,
+					     dest.GetWritable(),
+					     b.Get().data, b.Get().size,
+					     format, 0.5))
+					abort();
+				return dest.GetWritable();
+			});
+
+		/* MixRamp */
+		Run("mix_add", af, af, N_FRAMES * af.channels, [&](){
+				if (!pcm_mix(dither,
+					     dest.GetWritable(),
+					     b.Get().data, b.Get().size,
+					     format, -1))
+					abort();
+				return dest.GetWritable();
+			});
+	}
+}
+
+static void
+BenchConvert(AudioFormat in, AudioFormat out)
+{
+	const InputBuffer input(in);
+
+	PcmConvert convert;
+	convert.Open(in, out);
+
+	Run("convert", in, out, N_FRAMES * in.channels, [&](){
+			return convert.Convert(input.Get()).data;
+		});
+
+	convert.Close();
+}
+
+static void
+BenchConvert()
+{
+	for (const auto src_format : all_formats) {
+		for (const auto dest_format : all_formats) {
+			/* there is no conversion to S8 */
+			if (src_format == dest_format ||
+			    dest_format == SampleFormat::S8)
+				continue;
+
+			BenchConvert(AudioFormat(SAMPLE_RATE, src_format, 2),
+				     AudioFormat(SAMPLE_RATE, dest_format, 2));
+		}
+	}
+}
+
+static void
+BenchChannels()
+{
+	static constexpr struct {
+		unsigned src, dest;
+	} channels[] = {
+		{ 1, 2 },
+		{ 2, 1 },
+		{ 2, 6 },
+		{ 6, 2 },
+		{ 8, 2 },
+	};
+
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+	};
+
+	for (const auto format : formats) {
+		for (const auto &c : channels) {
+			const AudioFormat in(SAMPLE_RATE, format, c.src);
+			const AudioFormat out(SAMPLE_RATE, format, c.dest);
+			const InputBuffer input(in);
+
+			PcmChannelsConverter converter;
+			converter.Open(format, c.src, c.dest);
+
+			Run("channels", in, out, N_FRAMES * in.channels, [&](){
+					return converter.Convert(input.Get()).data;
+				});
+
+			converter.Close();
+		}
+	}
+}
+
+static void
+BenchExport(const char *name, AudioFormat af, PcmExport::Params params)
+{
+	const InputBuffer input(af);
+
+	PcmExport e;
+	e.Open(af.format, af.channels, params);
+
+	AudioFormat out = af;
+	out.sample_rate = params.CalcOutputSampleRate(af.sample_rate);
+	if (params.shift8 || params.pack24)
+		out.format = SampleFormat::S32;
+
+	Run(name, af, out, N_FRAMES * af.channels, [&](){
+			return e.Export(input.Get()).data;
+		});
+}
+
+static void
+BenchExport()
+{
+	for (const auto format : integer_formats) {
+		if (format == SampleFormat::S8)
+			continue;
+
+		PcmExport::Params params;
+		params.reverse_endian = true;
+		BenchExport("export_reverse_endian",
+			    AudioFormat(SAMPLE_RATE, format, 2), params);
+	}
+
+	{
+		PcmExport::Params params;
+		params.alsa_channel_order = true;
+		BenchExport("export_alsa_channel_order",
+			    AudioFormat(SAMPLE_RATE, SampleFormat::S16, 6),
+			    params);
+	}
+
+	{
+		PcmExport::Params params;
+		params.shift8 = true;
+		BenchExport("export_shift8",
+			    AudioFormat(SAMPLE_RATE, SampleFormat::S24_P32, 2),
+			    params);
+	}
+
+	{
+		PcmExport::Params params;
+		params.pack24 = true;
+		BenchExport("export_pack24",
+			    AudioFormat(SAMPLE_RATE, SampleFormat::S24_P32, 2),
+			    params);
+	}
+
+#ifdef ENABLE_DSD
+	{
+		PcmExport::Params params;
+		params.dop = true;
+		BenchExport("export_dop",
+			    AudioFormat(352800, SampleFormat::DSD, 2),
+			    params);
+	}
+
+	{
+		PcmExport::Params params;
+		params.dsd_u32 = true;
+		BenchExport("export_dsd_u32",
+			    AudioFormat(352800, SampleFormat::DSD, 2),
+			    params);
+	}
+#endif
+}
+
+#ifdef ENABLE_DSD
+
+static void
+BenchDsd()
+{
+	/* DSD64 at the dsd2pcm rate, DSD256 to 352.8 kHz and to
+	   88.2 kHz */
+	static constexpr struct {
+		unsigned rate, factor;
+	} configs[] = {
+		{ 352800, 1 },
+		{ 1411200, 4 },
+		{ 1411200, 16 },
+	};
+
+	for (const unsigned channels : {2u, 6u}) {
+		for (const auto &config : configs) {
+			const AudioFormat in(config.rate, SampleFormat::DSD,
+					     channels);
+			const AudioFormat out(config.rate / config.factor,
+					      SampleFormat::FLOAT, channels);
+			const InputBuffer input(in);
+			const auto src =
+				ConstBuffer<uint8_t>::FromVoid(input.Get());
+
+			PcmDsd dsd;
+			dsd.SetFactor(config.factor);
+
+			Run("dsd", in, out, N_FRAMES * in.channels, [&](){
+					return dsd.ToFloat(channels, src).data;
+				});
+		}
+	}
+}
+
+#endif
+
+static void
+BenchResampler(const char *name, PcmResampler &resampler)
+{
+	for (const unsigned channels : {2u, 6u}) {
+		for (const auto format : all_formats) {
+			AudioFormat in(SAMPLE_RATE, format, channels);
+			const AudioFormat out = resampler.Open(in, 48000);
+
+			/* the resampler may have chosen a different
+			   input sample format; skip duplicates */
+			if (in.format != format) {
+				resampler.Close();
+				continue;
+			}
+
+			const InputBuffer input(in);
+			Run(name, in, out, N_FRAMES * in.channels, [&](){
+					return resampler.Resample(input.Get()).data;
+				});
+
+			resampler.Close();
+		}
+	}
+}
+
+static void
+BenchResamplers()
+{
+	{
+		FallbackPcmResampler resampler;
+		BenchResampler("resample_fallback", resampler);
+	}
+
+#ifdef ENABLE_LIBSAMPLERATE
+	static constexpr struct {
+		const char *name;
+		int converter;
+	} lsr_converters[] = {
+		{ "resample_libsamplerate_best", SRC_SINC_BEST_QUALITY },
+		{ "resample_libsamplerate_medium", SRC_SINC_MEDIUM_QUALITY },
+		{ "resample_libsamplerate", SRC_SINC_FASTEST },
+		{ "resample_libsamplerate_linear", SRC_LINEAR },
+	};
+
+	for (const auto &i : lsr_converters) {
+		LibsampleratePcmResampler resampler(i.converter);
+		BenchResampler(i.name, resampler);
+	}
+#endif
+
+#ifdef ENABLE_SOXR
+	static constexpr struct {
+		const char *name;
+		const char *quality;
+	} soxr_qualities[] = {
+		{ "resample_soxr_very_high", "very high" },
+		{ "resample_soxr", "high" },
+		{ "resample_soxr_medium", "medium" },
+		{ "resample_soxr_low", "low" },
+		{ "resample_soxr_quick", "quick" },
+	};
+
+	for (const auto &i : soxr_qualities) {
+		ConfigBlock block;
+		block.AddBlockParam("quality", i.quality);
+		SoxrPcmResampler resampler(pcm_resample_soxr_parse(block));
+		BenchResampler(i.name, resampler);
+	}
+#endif
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_pcm [MILLISECONDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc == 2)
+		min_duration = std::chrono::milliseconds(strtoul(argv[1],
+								 nullptr, 10));
+
+	PrintHeader();
+	BenchVolume();
+	BenchMix();
+	BenchConvert();
+	BenchChannels();
+	BenchExport();
+#ifdef ENABLE_DSD
+	BenchDsd();
+#endif
+	BenchResamplers();
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program compares the cost of a #PerfectHashTable lookup with
+ * a binary search in a sorted array, using the names of the MPD
+ * protocol commands as keys.  It prints one line per method, with
+ * tab-separated columns: method and nanoseconds per lookup.
+ */
+
+#include "util/PerfectHash.hxx"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A sorted snapshot of the MPD command names, used as a realistic key
+ * set.  It does not need to follow src/command/AllCommands.cxx,
+ * whose table is checked at compile time.
+ */
+static constexpr const char *command_names[] = {
+	"add", "addid", "addtagid", "albumart", "binarylimit",
+	"channels", "clear", "clearerror", "cleartagid", "close",
+	"commands", "compress", "config", "consume", "count", "crossfade",
+	"currentsong", "decoders", "decoderstats", "delete",
+	"deleteid", "disableoutput", "enableoutput", "find", "findadd",
+	"idle", "kill", "list", "listall", "listallinfo", "listfiles",
+	"listmounts", "listneighbors", "listpartitions",
+	"listplaylist", "listplaylistinfo", "listplaylists", "load",
+	"lsinfo", "mixrampdb", "mixrampdelay", "mount", "move",
+	"moveid", "newpartition", "next", "notcommands", "outputs",
+	"outputset", "outputstats", "partition", "password", "pause",
+	"ping", "play", "playid", "playlist", "playlistadd",
+	"playlistclear", "playlistdelete", "playlistfind",
+	"playlistid", "playlistinfo", "playlistmove", "playlistsearch",
+	"plchanges", "plchangesposid", "previous", "prio", "prioid",
+	"random", "rangeid", "readcomments", "readmessages",
+	"readpicture", "rename", "repeat", "replay_gain_mode",
+	"replay_gain_status", "rescan", "rm", "save", "search",
+	"searchadd", "searchaddpl", "seek", "seekcur", "seekid",
+	"sendmessage", "setvol", "shuffle", "single", "songformat",
+	"stats", "status", "sticker", "stop", "subscribe", "swap",
+	"swapid", "tagtypes", "toggleoutput", "unmount", "unsubscribe",
+	"update", "urlhandlers", "volume",
+};
+
+static constexpr size_t num_command_names =
+	sizeof(command_names) / sizeof(command_names[0]);
+
+struct StringKey {
+	constexpr const char *operator()(const char *s) const noexcept {
+		return s;
+	}
+};
+
+static constexpr PerfectHashTable<num_command_names,
+				  PerfectHashSize(num_command_names)>
+	command_name_hash(command_names, StringKey());
+
+static size_t
+LookupPerfectHash(const char *name) noexcept
+{
+	const size_t i = command_name_hash.Find(name);
+	return i < num_command_names && strcmp(name, command_names[i]) == 0
+		? i
+		: num_command_names;
+}
+
+static size_t
+LookupBinarySearch(const char *name) noexcept
+{
+	size_t a = 0, b = num_command_names;
+
+	while (a < b) {
+		const size_t i = (a + b) / 2;
+		const int cmp = strcmp(name, command_names[i]);
+		if (cmp == 0)
+			return i;
+		else if (cmp < 0)
+			b = i;
+		else
+			a = i + 1;
+	}
+
+	return num_command_names;
+}
+
+int
+main(int, char **)
+{
+	using std::chrono::steady_clock;
+
+	static constexpr unsigned N_ROUNDS = 20000;
+
+	static constexpr struct {
+		const char *name;
+		size_t (*lookup)(const char *name) noexcept;
+	} methods[] = {
+		{ "binary search", LookupBinarySearch },
+		{ "perfect hash", LookupPerfectHash },
+	};
+
+	for (const auto &m : methods) {
+		size_t sum = 0;
+		const auto start = steady_clock::now();
+
+		for (unsigned round = 0; round < N_ROUNDS; ++round)
+			for (const char *name : command_names)
+				sum += m.lookup(name);
+
+		const auto elapsed = steady_clock::now() - start;
+		const double ns =
+			std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(elapsed).count();
+
+		if (sum != size_t(N_ROUNDS) * num_command_names *
+		    (num_command_names - 1) / 2) {
+			fprintf(stderr, "%s: wrong result\n", m.name);
+			return EXIT_FAILURE;
+		}
+
+		printf("%s\t%.1f\n", m.name,
+		       ns / (double(N_ROUNDS) * num_command_names));
+	}
+
+	return EXIT_SUCCESS;
+}
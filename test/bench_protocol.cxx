@@ -0,0 +1,587 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput and latency of MPD's client
+ * protocol.
+ *
+ * "bench_protocol generate" writes a synthetic database file which
+ * can be loaded by the "simple" database plugin (configure it as
+ * "db_file" or with a "database" block pointing to this file).
+ *
+ * "bench_protocol run" connects a number of simulated clients to a
+ * running MPD, lets each of them issue a random mix of commands for
+ * the given duration and then prints one line per command, with
+ * tab-separated columns: command, requests, errors, requests per
+ * second, average, median and 99th percentile latency and maximum
+ * latency (all latencies in microseconds).
+ */
+
+#include "config.h"
+#include "LatencyHistogram.hxx"
+#include "tag/Type.h"
+#include "net/Resolver.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/SocketError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "thread/Mutex.hxx"
+#include "util/PrintException.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringCompare.hxx"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Describes the layout of the synthetic database; the "run" command
+ * needs it to generate valid "find" and "add" arguments.
+ */
+struct Layout {
+	unsigned n_artists, n_albums;
+};
+
+static constexpr const char *genres[] = {
+	"Rock", "Pop", "Jazz", "Classical", "Electronic",
+	"Hip-Hop", "Folk", "Metal", "Blues", "Soundtrack",
+};
+
+static constexpr unsigned N_GENRES = sizeof(genres) / sizeof(genres[0]);
+
+static unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || value == 0)
+		throw FormatRuntimeError("Not a positive number: %s", s);
+
+	return value;
+}
+
+/**
+ * Write a database in the text format parsed by db_load_internal().
+ * The songs are distributed evenly over all albums; the album
+ * number determines the genre and the date, so "list" and "find" on
+ * these tags return results of varying sizes.
+ */
+static void
+GenerateDatabase(const char *path, unsigned n_songs, const Layout &layout)
+{
+	FILE *file = fopen(path, "w");
+	if (file == nullptr)
+		throw FormatRuntimeError("Failed to create %s: %s",
+					 path, strerror(errno));
+
+	fprintf(file, "info_begin\n"
+		"format: 4\n"
+		"mpd_version: " VERSION "\n"
+		"fs_charset: UTF-8\n");
+
+	/* list all tags, so the file matches any
+	   "metadata_to_use" setting */
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		fprintf(file, "tag: %s\n", tag_item_names[i]);
+
+	fprintf(file, "info_end\n");
+
+	const unsigned n_albums = layout.n_artists * layout.n_albums;
+	const unsigned tracks_per_album = (n_songs + n_albums - 1) / n_albums;
+	const long mtime = 1500000000;
+
+	std::mt19937 random(42);
+	std::uniform_int_distribution<unsigned> duration(90, 600);
+
+	unsigned n = 0;
+	for (unsigned artist = 0; artist < layout.n_artists; ++artist) {
+		fprintf(file, "directory: Artist %u\n"
+			"mtime: %ld\n"
+			"begin: Artist %u\n",
+			artist, mtime, artist);
+
+		for (unsigned album = 0; album < layout.n_albums; ++album) {
+			const unsigned album_id = artist * layout.n_albums + album;
+
+			fprintf(file, "directory: Album %u\n"
+				"mtime: %ld\n"
+				"begin: Artist %u/Album %u\n",
+				album, mtime, artist, album);
+
+			for (unsigned track = 1;
+			     track <= tracks_per_album && n < n_songs;
+			     ++track, ++n)
+				fprintf(file, "song_begin: %02u.flac\n"
+					"Time: %u.000000\n"
+					"Artist: Artist %u\n"
+					"AlbumArtist: Artist %u\n"
+					"Album: Album %u\n"
+					"Title: Title %u\n"
+					"Track: %u\n"
+					"Genre: %s\n"
+					"Date: %u\n"
+					"Format: 44100:16:2\n"
+					"mtime: %ld\n"
+					"song_end\n",
+					track, duration(random),
+					artist, artist, album_id, n, track,
+					genres[album_id % N_GENRES],
+					1960 + album_id % 60,
+					mtime);
+
+			fprintf(file, "end: Artist %u/Album %u\n",
+				artist, album);
+		}
+
+		fprintf(file, "end: Artist %u\n", artist);
+	}
+
+	if (fclose(file) != 0)
+		throw FormatRuntimeError("Failed to write %s: %s",
+					 path, strerror(errno));
+}
+
+/**
+ * A blocking connection to MPD.
+ */
+class Connection {
+	UniqueSocketDescriptor fd;
+
+	/**
+	 * Received data which has not been consumed yet.
+	 */
+	std::string input;
+
+	/**
+	 * The position within #input where scanning for a complete
+	 * line shall continue.
+	 */
+	size_t position = 0;
+
+public:
+	explicit Connection(const char *address) {
+#ifdef HAVE_UN
+		if (*address == '/') {
+			AllocatedSocketAddress local;
+			local.SetLocal(address);
+			Connect(local, AF_LOCAL, 0);
+		} else
+#endif
+		{
+			const auto list = Resolve(address, 6600, 0, SOCK_STREAM);
+			const auto &ai = list.front();
+			Connect(ai, ai.GetFamily(), ai.GetProtocol());
+		}
+
+		const char *line = ReadLine();
+		if (!StringStartsWith(line, "OK MPD "))
+			throw FormatRuntimeError("Unexpected greeting: %s",
+						 line);
+		Consume();
+	}
+
+	void Send(const std::string &command) {
+		const char *p = command.data();
+		size_t length = command.length();
+
+		while (length > 0) {
+			ssize_t nbytes = fd.Write(p, length);
+			if (nbytes <= 0)
+				throw MakeSocketError("Failed to send");
+
+			p += nbytes;
+			length -= nbytes;
+		}
+	}
+
+	/**
+	 * Read the response to one command.
+	 *
+	 * @return true on "OK", false on "ACK"
+	 */
+	bool ReadResponse() {
+		while (true) {
+			const char *line = ReadLine();
+			if (strcmp(line, "OK") == 0) {
+				Consume();
+				return true;
+			}
+
+			if (StringStartsWith(line, "ACK ")) {
+				Consume();
+				return false;
+			}
+		}
+	}
+
+private:
+	void Connect(SocketAddress address, int family, int protocol) {
+		if (!fd.Create(family, SOCK_STREAM, protocol))
+			throw MakeSocketError("Failed to create socket");
+
+		if (!fd.Connect(address))
+			throw MakeSocketError("Failed to connect");
+	}
+
+	/**
+	 * Returns the next line (without the newline character); it
+	 * remains valid until the next call.
+	 */
+	const char *ReadLine() {
+		while (true) {
+			const size_t newline = input.find('\n', position);
+			if (newline != input.npos) {
+				input[newline] = 0;
+				const char *line = input.data() + position;
+				position = newline + 1;
+				return line;
+			}
+
+			/* discard the lines which have been consumed
+			   already */
+			input.erase(0, position);
+			position = 0;
+
+			/* SocketDescriptor::Read() doesn't block */
+			if (fd.WaitReadable(-1) < 0)
+				throw MakeSocketError("Failed to poll");
+
+			char buffer[16384];
+			ssize_t nbytes = fd.Read(buffer, sizeof(buffer));
+			if (nbytes < 0)
+				throw MakeSocketError("Failed to receive");
+			if (nbytes == 0)
+				throw std::runtime_error("Connection closed by MPD");
+
+			input.append(buffer, nbytes);
+		}
+	}
+
+	void Consume() noexcept {
+		input.erase(0, position);
+		position = 0;
+	}
+};
+
+enum class Command : unsigned {
+	IDLE,
+	STATUS,
+	FIND,
+	LIST,
+	PLAYLISTINFO,
+	ADD,
+	MAX
+};
+
+static constexpr const char *command_names[] = {
+	"idle",
+	"status",
+	"find",
+	"list",
+	"playlistinfo",
+	"add",
+};
+
+static constexpr unsigned N_COMMANDS = unsigned(Command::MAX);
+
+static_assert(sizeof(command_names) / sizeof(command_names[0]) == N_COMMANDS,
+	      "Wrong command_names size");
+
+using Mix = std::array<unsigned, N_COMMANDS>;
+
+/**
+ * Parse a command mix in the form "status:10,find:2,...".
+ */
+static Mix
+ParseMix(const char *s)
+{
+	Mix mix{};
+
+	while (*s != 0) {
+		const char *colon = strchr(s, ':');
+		if (colon == nullptr)
+			throw FormatRuntimeError("Malformed mix: %s", s);
+
+		unsigned i = 0;
+		while (i < N_COMMANDS &&
+		       (strlen(command_names[i]) != size_t(colon - s) ||
+			strncmp(command_names[i], s, colon - s) != 0))
+			++i;
+
+		if (i == N_COMMANDS)
+			throw FormatRuntimeError("Unknown command in mix: %s", s);
+
+		char *endptr;
+		mix[i] = strtoul(colon + 1, &endptr, 10);
+		if (*endptr == ',')
+			++endptr;
+		else if (*endptr != 0)
+			throw FormatRuntimeError("Malformed mix: %s", s);
+
+		s = endptr;
+	}
+
+	unsigned total = 0;
+	for (auto i : mix)
+		total += i;
+
+	if (total == 0)
+		throw std::runtime_error("Empty command mix");
+
+	return mix;
+}
+
+/**
+ * Build the request for the given command, including the trailing
+ * newline.
+ */
+template<typename R>
+static std::string
+MakeRequest(Command command, const Layout &layout, R &random)
+{
+	std::uniform_int_distribution<unsigned> artist(0, layout.n_artists - 1);
+	std::uniform_int_distribution<unsigned> album(0, layout.n_albums - 1);
+	char buffer[256];
+
+	switch (command) {
+	case Command::IDLE:
+		/* enter and leave idle mode, which measures the
+		   overhead of registering an idle client */
+		return "idle\nnoidle\n";
+
+	case Command::STATUS:
+		return "status\n";
+
+	case Command::FIND:
+		snprintf(buffer, sizeof(buffer),
+			 "find \"(Artist == \\\"Artist %u\\\")\"\n",
+			 artist(random));
+		return buffer;
+
+	case Command::LIST:
+		switch (random() % 3) {
+		case 0:
+			return "list artist\n";
+
+		case 1:
+			return "list album group albumartist\n";
+
+		default:
+			snprintf(buffer, sizeof(buffer),
+				 "list album \"(Genre == \\\"%s\\\")\"\n",
+				 genres[random() % N_GENRES]);
+			return buffer;
+		}
+
+	case Command::PLAYLISTINFO:
+		return "playlistinfo\n";
+
+	case Command::ADD:
+		snprintf(buffer, sizeof(buffer),
+			 "add \"Artist %u/Album %u\"\n",
+			 artist(random), album(random));
+		return buffer;
+
+	case Command::MAX:
+		break;
+	}
+
+	gcc_unreachable();
+}
+
+struct Statistics {
+	std::array<LatencyHistogram, N_COMMANDS> latency;
+	std::array<uint64_t, N_COMMANDS> errors{};
+
+	void Merge(const Statistics &other) noexcept {
+		for (unsigned i = 0; i < N_COMMANDS; ++i) {
+			latency[i].Merge(other.latency[i]);
+			errors[i] += other.errors[i];
+		}
+	}
+};
+
+struct Benchmark {
+	const char *address;
+	Layout layout;
+	Mix mix;
+
+	std::atomic_bool stop{false};
+
+	Mutex mutex;
+	Statistics total;
+	std::exception_ptr error;
+
+	void RunClient(unsigned seed) noexcept;
+};
+
+void
+Benchmark::RunClient(unsigned seed) noexcept
+try {
+	Connection c(address);
+
+	std::mt19937 random(seed);
+	std::discrete_distribution<unsigned> pick(mix.begin(), mix.end());
+	Statistics stats;
+
+	while (!stop.load(std::memory_order_relaxed)) {
+		const auto command = Command(pick(random));
+		const auto request = MakeRequest(command, layout, random);
+
+		const auto start = Clock::now();
+		c.Send(request);
+		const bool success = c.ReadResponse();
+		const auto duration = Clock::now() - start;
+
+		stats.latency[unsigned(command)].Add(duration);
+		if (!success)
+			++stats.errors[unsigned(command)];
+	}
+
+	const std::lock_guard<Mutex> lock(mutex);
+	total.Merge(stats);
+} catch (...) {
+	const std::lock_guard<Mutex> lock(mutex);
+	if (!error)
+		error = std::current_exception();
+	stop = true;
+}
+
+static long long
+ToMicroseconds(Clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+static void
+PrintStatistics(const char *name, const LatencyHistogram &h,
+		uint64_t errors, double seconds) noexcept
+{
+	printf("%s\t%llu\t%llu\t%.1f\t%lld\t%lld\t%lld\t%lld\n",
+	       name, (unsigned long long)h.GetCount(),
+	       (unsigned long long)errors, h.GetCount() / seconds,
+	       ToMicroseconds(h.GetAverage()),
+	       ToMicroseconds(h.GetQuantile(0.5)),
+	       ToMicroseconds(h.GetQuantile(0.99)),
+	       ToMicroseconds(h.GetMax()));
+}
+
+static void
+RunBenchmark(Benchmark &b, unsigned n_clients, unsigned seconds)
+{
+	/* start with an empty queue, so "playlistinfo" results
+	   depend only on the "add" requests of this run */
+	{
+		Connection c(b.address);
+		c.Send("clear\n");
+		if (!c.ReadResponse())
+			throw std::runtime_error("\"clear\" failed");
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(n_clients);
+
+	const auto start = Clock::now();
+	for (unsigned i = 0; i < n_clients; ++i)
+		threads.emplace_back(&Benchmark::RunClient, &b, i);
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	b.stop = true;
+
+	for (auto &t : threads)
+		t.join();
+
+	const double elapsed =
+		std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (b.error)
+		std::rethrow_exception(b.error);
+
+	LatencyHistogram all;
+	uint64_t all_errors = 0;
+
+	for (unsigned i = 0; i < N_COMMANDS; ++i) {
+		const auto &h = b.total.latency[i];
+		if (h.GetCount() == 0)
+			continue;
+
+		PrintStatistics(command_names[i], h, b.total.errors[i],
+				elapsed);
+		all.Merge(h);
+		all_errors += b.total.errors[i];
+	}
+
+	PrintStatistics("total", all, all_errors, elapsed);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr, "Usage:\n"
+		"  bench_protocol generate PATH SONGS ARTISTS ALBUMS\n"
+		"  bench_protocol run ADDRESS ARTISTS ALBUMS CLIENTS SECONDS [MIX]\n"
+		"\n"
+		"ARTISTS is the number of artists, ALBUMS the number of albums\n"
+		"per artist.  ADDRESS is HOST[:PORT] or the path of a local\n"
+		"socket.  MIX is a comma-separated list of COMMAND:WEIGHT;\n"
+		"commands: idle, status, find, list, playlistinfo, add.\n");
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc == 6 && strcmp(argv[1], "generate") == 0) {
+		const Layout layout{ParseUnsigned(argv[4]),
+				ParseUnsigned(argv[5])};
+		GenerateDatabase(argv[2], ParseUnsigned(argv[3]), layout);
+		return EXIT_SUCCESS;
+	}
+
+	if ((argc == 7 || argc == 8) && strcmp(argv[1], "run") == 0) {
+		Benchmark b;
+		b.address = argv[2];
+		b.layout = {ParseUnsigned(argv[3]), ParseUnsigned(argv[4])};
+		b.mix = ParseMix(argc == 8
+				 ? argv[7]
+				 : "idle:2,status:10,find:2,list:1,playlistinfo:1,add:1");
+
+		RunBenchmark(b, ParseUnsigned(argv[5]),
+			     ParseUnsigned(argv[6]));
+		return EXIT_SUCCESS;
+	}
+
+	Usage();
+	return EXIT_FAILURE;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
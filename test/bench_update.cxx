@@ -0,0 +1,508 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the performance of the database update
+ * (#UpdateWalk) on a synthetic in-memory #Storage and with a stub tag
+ * scanner, so neither disk nor decoder plugins influence the
+ * results.
+ *
+ * It performs three runs on the same database: "full" (empty
+ * database), "nochange" (nothing has been modified) and "rescan"
+ * (like "update --rescan", i.e. all tags are scanned again).  Each
+ * line of its output describes one run, with tab-separated columns:
+ * name, seconds, directories opened, files listed, tag scans,
+ * directories per second, files per second, median, 99th percentile
+ * and maximum time a reader had to wait for the database lock (in
+ * microseconds) and peak RSS (in kB).
+ */
+
+#include "config.h"
+#include "LatencyHistogram.hxx"
+#include "db/update/Walk.hxx"
+#include "db/update/ExcludeList.hxx"
+#include "db/update/TagScanCache.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "decoder/DecoderList.hxx"
+#include "playlist/PlaylistRegistry.hxx"
+#include "storage/StorageInterface.hxx"
+#include "storage/FileInfo.hxx"
+#include "config/Data.hxx"
+#include "event/Thread.hxx"
+#include "tag/Builder.hxx"
+#include "TagStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Log.hxx"
+#include "util/PrintException.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringCompare.hxx"
+
+#if defined(ENABLE_CHROMAPRINT) && defined(ENABLE_SQLITE)
+#include "sticker/StickerDatabase.hxx"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr const char *SONG_SUFFIX = "flac";
+
+/*
+ * stubs
+ *
+ * These replace the decoder plugin list and the tag scanners; only
+ * files with the suffix #SONG_SUFFIX are considered songs.
+ */
+
+const struct DecoderPlugin *const decoder_plugins[] = { nullptr };
+bool decoder_plugins_enabled[1];
+
+bool
+decoder_plugin_prepare(unsigned) noexcept
+{
+	return false;
+}
+
+ConstBuffer<unsigned>
+decoder_plugins_by_suffix(const char *) noexcept
+{
+	return nullptr;
+}
+
+ConstBuffer<unsigned>
+decoder_plugins_by_mime_type(const char *) noexcept
+{
+	return nullptr;
+}
+
+bool
+decoder_plugins_supports_suffix(const char *suffix) noexcept
+{
+	return strcmp(suffix, SONG_SUFFIX) == 0;
+}
+
+bool
+playlist_suffix_supported(const char *) noexcept
+{
+	return false;
+}
+
+#if defined(ENABLE_CHROMAPRINT) && defined(ENABLE_SQLITE)
+
+/* the fingerprint scan needs the sticker database, which this
+   benchmark doesn't have */
+
+bool
+sticker_enabled() noexcept
+{
+	return false;
+}
+
+void
+UpdateWalk::ScanFingerprints(Directory &) noexcept
+{
+}
+
+#endif
+
+void
+Log(const Domain &, LogLevel, const char *) noexcept
+{
+}
+
+/**
+ * The simulated duration of one tag scan.
+ */
+static std::chrono::microseconds scan_latency;
+
+static std::atomic<unsigned> n_scans;
+
+bool
+tag_stream_scan(InputStream &, TagHandler &) noexcept
+{
+	return false;
+}
+
+bool
+tag_stream_scan(const char *, TagHandler &) noexcept
+{
+	return false;
+}
+
+bool
+tag_stream_scan(InputStream &, TagBuilder &, AudioFormat *) noexcept
+{
+	return false;
+}
+
+/**
+ * Derive tags from the URI "fake://dA/dB/NN.flac": the first path
+ * segment is the artist, the parent directory the album.
+ */
+bool
+tag_stream_scan(const char *uri, TagBuilder &builder,
+		AudioFormat *) noexcept
+{
+	++n_scans;
+
+	if (scan_latency.count() > 0)
+		std::this_thread::sleep_for(scan_latency);
+
+	const char *path = StringAfterPrefix(uri, "fake://");
+	if (path == nullptr)
+		return false;
+
+	const char *slash = strchr(path, '/');
+	const char *last_slash = strrchr(path, '/');
+	if (slash == nullptr)
+		return false;
+
+	builder.AddItem(TAG_ARTIST, {path, size_t(slash - path)});
+	builder.AddItem(TAG_ALBUM, {path, size_t(last_slash - path)});
+	builder.AddItem(TAG_TITLE, last_slash + 1);
+	builder.SetDuration(SignedSongTime::FromS(240));
+	return true;
+}
+
+/**
+ * A balanced directory tree: each directory above #depth has
+ * #fanout subdirectories named "dN", and each directory at #depth
+ * contains #files songs named "NN.flac".
+ */
+class FakeStorage final : public Storage {
+	const unsigned depth, fanout, files;
+
+	/**
+	 * The simulated duration of each GetInfo() and
+	 * OpenDirectory() call.
+	 */
+	const std::chrono::microseconds latency;
+
+	const std::chrono::system_clock::time_point mtime =
+		std::chrono::system_clock::from_time_t(1500000000);
+
+public:
+	std::atomic<unsigned> n_directories{0}, n_files{0};
+
+	FakeStorage(unsigned _depth, unsigned _fanout, unsigned _files,
+		    std::chrono::microseconds _latency) noexcept
+		:depth(_depth), fanout(_fanout), files(_files),
+		 latency(_latency) {}
+
+	/**
+	 * @return the depth of the directory or -1 if the URI does
+	 * not refer to a directory
+	 */
+	int ParseDirectory(const char *uri) const noexcept {
+		int level = 0;
+
+		while (*uri != 0) {
+			if (uri[0] != 'd')
+				return -1;
+
+			char *endptr;
+			const unsigned long i = strtoul(uri + 1, &endptr, 10);
+			if (endptr == uri + 1 || i >= fanout ||
+			    unsigned(++level) > depth)
+				return -1;
+
+			if (*endptr == '/')
+				++endptr;
+			else if (*endptr != 0)
+				return -1;
+
+			uri = endptr;
+		}
+
+		return level;
+	}
+
+	StorageFileInfo MakeInfo(StorageFileInfo::Type type,
+				 uint64_t inode) const noexcept {
+		StorageFileInfo info(type);
+		info.size = 4096;
+		info.mtime = mtime;
+		info.device = 1;
+		info.inode = inode;
+		return info;
+	}
+
+	void Delay() const noexcept {
+		if (latency.count() > 0)
+			std::this_thread::sleep_for(latency);
+	}
+
+	/* virtual methods from class Storage */
+	StorageFileInfo GetInfo(const char *uri_utf8, bool follow) override;
+
+	std::unique_ptr<StorageDirectoryReader> OpenDirectory(const char *uri_utf8) override;
+
+	std::string MapUTF8(const char *uri_utf8) const noexcept override {
+		return std::string("fake://") + uri_utf8;
+	}
+
+	const char *MapToRelativeUTF8(const char *uri_utf8) const noexcept override {
+		return StringAfterPrefix(uri_utf8, "fake://");
+	}
+};
+
+class FakeDirectoryReader final : public StorageDirectoryReader {
+	FakeStorage &storage;
+
+	const std::string uri;
+
+	/**
+	 * Does this directory contain songs (instead of
+	 * subdirectories)?
+	 */
+	const bool leaf;
+
+	const unsigned n;
+
+	unsigned i = 0;
+
+	char name[32];
+
+public:
+	FakeDirectoryReader(FakeStorage &_storage, const char *_uri,
+			    bool _leaf, unsigned _n) noexcept
+		:storage(_storage), uri(_uri), leaf(_leaf), n(_n) {}
+
+	/* virtual methods from class StorageDirectoryReader */
+	const char *Read() noexcept override {
+		if (i >= n)
+			return nullptr;
+
+		if (leaf)
+			snprintf(name, sizeof(name), "%02u.%s", i, SONG_SUFFIX);
+		else
+			snprintf(name, sizeof(name), "d%u", i);
+
+		++i;
+		return name;
+	}
+
+	StorageFileInfo GetInfo(bool) override {
+		/* the inode only needs to be unique among the
+		   ancestors (for symlink loop detection) */
+		const uint64_t inode = std::hash<std::string>()(uri + '/' + name);
+
+		if (leaf) {
+			++storage.n_files;
+			return storage.MakeInfo(StorageFileInfo::Type::REGULAR,
+						inode);
+		} else
+			return storage.MakeInfo(StorageFileInfo::Type::DIRECTORY,
+						inode);
+	}
+};
+
+StorageFileInfo
+FakeStorage::GetInfo(const char *uri_utf8, bool)
+{
+	Delay();
+
+	const uint64_t inode = std::hash<std::string>()(uri_utf8);
+
+	if (ParseDirectory(uri_utf8) >= 0)
+		return MakeInfo(StorageFileInfo::Type::DIRECTORY, inode);
+
+	/* is it a song in a leaf directory? */
+	const char *slash = strrchr(uri_utf8, '/');
+	if (slash != nullptr &&
+	    ParseDirectory(std::string(uri_utf8, slash).c_str()) == int(depth)) {
+		char *endptr;
+		const unsigned long i = strtoul(slash + 1, &endptr, 10);
+		if (endptr > slash + 1 && i < files && *endptr == '.' &&
+		    strcmp(endptr + 1, SONG_SUFFIX) == 0)
+			return MakeInfo(StorageFileInfo::Type::REGULAR, inode);
+	}
+
+	throw FormatRuntimeError("No such file: %s", uri_utf8);
+}
+
+std::unique_ptr<StorageDirectoryReader>
+FakeStorage::OpenDirectory(const char *uri_utf8)
+{
+	Delay();
+
+	const int level = ParseDirectory(uri_utf8);
+	if (level < 0)
+		throw FormatRuntimeError("No such directory: %s", uri_utf8);
+
+	++n_directories;
+
+	const bool leaf = unsigned(level) == depth;
+	return std::make_unique<FakeDirectoryReader>(*this, uri_utf8, leaf,
+						     leaf ? files : fanout);
+}
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	/* virtual methods from class DatabaseListener */
+	void OnDatabaseModified() noexcept override {}
+	void OnDatabaseSongRemoved(const char *) noexcept override {}
+};
+
+/**
+ * Measures how long a reader has to wait for the database lock
+ * while the update is running.
+ */
+class LockProbe {
+	std::atomic_bool stop{false};
+	LatencyHistogram latency;
+	std::thread thread;
+
+public:
+	LockProbe():thread([this](){ Run(); }) {}
+
+	LatencyHistogram Finish() noexcept {
+		stop = true;
+		thread.join();
+		return latency;
+	}
+
+private:
+	void Run() noexcept {
+		while (!stop.load(std::memory_order_relaxed)) {
+			const auto start = Clock::now();
+			db_lock_shared();
+			latency.Add(Clock::now() - start);
+			db_unlock_shared();
+
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+};
+
+static long long
+ToMicroseconds(Clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+static void
+RunWalk(const char *name, UpdateWalk &walk, FakeStorage &storage,
+	Directory &root, bool discard)
+{
+	storage.n_directories = 0;
+	storage.n_files = 0;
+	n_scans = 0;
+
+	LockProbe probe;
+
+	const auto start = Clock::now();
+	walk.Walk(root, "", discard);
+	const double seconds =
+		std::chrono::duration<double>(Clock::now() - start).count();
+
+	const auto lock_wait = probe.Finish();
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	const unsigned n_directories = storage.n_directories;
+	const unsigned n_files = storage.n_files;
+
+	printf("%s\t%.3f\t%u\t%u\t%u\t%.0f\t%.0f\t%lld\t%lld\t%lld\t%ld\n",
+	       name, seconds, n_directories, n_files, n_scans.load(),
+	       n_directories / seconds, n_files / seconds,
+	       ToMicroseconds(lock_wait.GetQuantile(0.5)),
+	       ToMicroseconds(lock_wait.GetQuantile(0.99)),
+	       ToMicroseconds(lock_wait.GetMax()),
+	       usage.ru_maxrss);
+	fflush(stdout);
+}
+
+static unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0)
+		throw FormatRuntimeError("Not a number: %s", s);
+
+	return value;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 4 || argc > 8) {
+		fprintf(stderr, "Usage: bench_update DEPTH FANOUT FILES"
+			" [LATENCY_US [SCAN_LATENCY_US [THREADS [TAG_CACHE]]]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned depth = ParseUnsigned(argv[1]);
+	const unsigned fanout = ParseUnsigned(argv[2]);
+	const unsigned files = ParseUnsigned(argv[3]);
+	const std::chrono::microseconds latency(argc > 4
+						? ParseUnsigned(argv[4])
+						: 0);
+	scan_latency = std::chrono::microseconds(argc > 5
+						 ? ParseUnsigned(argv[5])
+						 : 0);
+
+	const ConfigData config;
+	UpdateConfig update_config(config);
+	if (argc > 6)
+		update_config.threads = ParseUnsigned(argv[6]);
+
+	std::unique_ptr<TagScanCache> tag_cache;
+	if (argc > 7) {
+		tag_cache = std::make_unique<TagScanCache>(AllocatedPath::FromFS(argv[7]));
+		tag_cache->Load();
+	}
+
+	EventThread io_thread;
+	io_thread.Start();
+
+	FakeStorage storage(depth, fanout, files, latency);
+	NullDatabaseListener listener;
+	ExcludeCache exclude_cache;
+
+	UpdateWalk walk(update_config, io_thread.GetEventLoop(), listener,
+			storage, tag_cache.get(), exclude_cache);
+
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	RunWalk("full", walk, storage, *root, false);
+	RunWalk("nochange", walk, storage, *root, false);
+	RunWalk("rescan", walk, storage, *root, true);
+
+	if (tag_cache != nullptr)
+		tag_cache->Save(false);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
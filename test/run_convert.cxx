@@ -21,43 +21,159 @@
  * This program is a command line interface to MPD's PCM conversion
  * library (pcm_convert.c).
  *
+ * With "--bench", the output is discarded, and the CPU time spent
+ * converting is reported instead; this can be used to estimate how
+ * many streams of that kind one CPU core can handle.
+ *
  */
 
+#include "ConfigGlue.hxx"
 #include "AudioParser.hxx"
 #include "AudioFormat.hxx"
 #include "pcm/PcmConvert.hxx"
+#include "pcm/ConfiguredResampler.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StaticFifoBuffer.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/OptionDef.hxx"
+#include "util/OptionParser.hxx"
 #include "util/PrintException.hxx"
 
+#include <stdexcept>
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
+struct CommandLine {
+	AudioFormat in_audio_format, out_audio_format;
+
+	Path config_path = nullptr;
+
+	const char *resampler = nullptr;
+
+	bool bench = false;
+};
+
+enum Option {
+	OPTION_CONFIG,
+	OPTION_RESAMPLER,
+	OPTION_BENCH,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"config", 0, true, "Load a MPD configuration file"},
+	{"resampler", 0, true, "Use the named resampler from the configuration file"},
+	{"bench", 0, false, "Discard the output and report the CPU usage"},
+};
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_CONFIG:
+			c.config_path = Path::FromFS(o.value);
+			break;
+
+		case OPTION_RESAMPLER:
+			c.resampler = o.value;
+			break;
+
+		case OPTION_BENCH:
+			c.bench = true;
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.size != 2)
+		throw std::runtime_error("Usage: run_convert [--config=FILE] [--resampler=NAME] [--bench] IN_FORMAT OUT_FORMAT <IN >OUT");
+
+	c.in_audio_format = ParseAudioFormat(args[0], false);
+	const auto out_audio_format_mask = ParseAudioFormat(args[1], false);
+	c.out_audio_format = c.in_audio_format.WithMask(out_audio_format_mask);
+	return c;
+}
+
+/**
+ * Accumulates the processor time spent in the converter.
+ */
+class CpuStopwatch {
+	clock_t total = 0, start;
+
+public:
+	void Start() noexcept {
+		start = clock();
+	}
+
+	void Stop() noexcept {
+		total += clock() - start;
+	}
+
+	double GetSeconds() const noexcept {
+		return double(total) / CLOCKS_PER_SEC;
+	}
+};
+
+static void
+Output(const CommandLine &c, ConstBuffer<void> output) noexcept
+{
+	if (c.bench)
+		return;
+
+	gcc_unused ssize_t ignored = write(1, output.data, output.size);
+}
+
+static void
+PrintBench(const CommandLine &c, uint64_t n_frames,
+	   const CpuStopwatch &cpu) noexcept
+{
+	const double duration = double(n_frames) / c.in_audio_format.sample_rate;
+	const double cpu_seconds = cpu.GetSeconds();
+
+	fprintf(stderr, "%s -> %s: audio=%.3fs cpu=%.3fs",
+		ToString(c.in_audio_format).c_str(),
+		ToString(c.out_audio_format).c_str(),
+		duration, cpu_seconds);
+
+	if (duration > 0 && cpu_seconds > 0)
+		fprintf(stderr, " load=%.2f%% streams_per_core=%.1f",
+			100 * cpu_seconds / duration,
+			duration / cpu_seconds);
+
+	fputc('\n', stderr);
+}
+
 int
 main(int argc, char **argv)
 try {
-	if (argc != 3) {
-		fprintf(stderr,
-			"Usage: run_convert IN_FORMAT OUT_FORMAT <IN >OUT\n");
-		return 1;
-	}
+	const auto c = ParseCommandLine(argc, argv);
 
-	const auto in_audio_format = ParseAudioFormat(argv[1], false);
-	const auto out_audio_format_mask = ParseAudioFormat(argv[2], false);
+	const auto config = AutoLoadConfigFile(c.config_path);
+	pcm_convert_global_init(config);
 
-	const auto out_audio_format =
-		in_audio_format.WithMask(out_audio_format_mask);
+	const PcmResamplerProfile *resampler_profile = c.resampler != nullptr
+		? &pcm_resampler_find(c.resampler)
+		: nullptr;
 
-	const size_t in_frame_size = in_audio_format.GetFrameSize();
+	const size_t in_frame_size = c.in_audio_format.GetFrameSize();
 
 	PcmConvert state;
-	state.Open(in_audio_format, out_audio_format);
+	state.Open(c.in_audio_format, c.out_audio_format,
+		   resampler_profile);
 
 	StaticFifoBuffer<uint8_t, 4096> buffer;
 
+	CpuStopwatch cpu;
+	uint64_t n_frames = 0;
+
 	while (true) {
 		{
 			const auto dest = buffer.Write();
@@ -78,24 +194,31 @@ try {
 			continue;
 
 		buffer.Consume(src.size);
+		n_frames += src.size / in_frame_size;
 
+		cpu.Start();
 		auto output = state.Convert({src.data, src.size});
+		cpu.Stop();
 
-		gcc_unused ssize_t ignored = write(1, output.data,
-						   output.size);
+		Output(c, output);
 	}
 
 	while (true) {
+		cpu.Start();
 		auto output = state.Flush();
+		cpu.Stop();
+
 		if (output.IsNull())
 			break;
 
-		gcc_unused ssize_t ignored = write(1, output.data,
-						   output.size);
+		Output(c, output);
 	}
 
 	state.Close();
 
+	if (c.bench)
+		PrintBench(c, n_frames, cpu);
+
 	return EXIT_SUCCESS;
 } catch (...) {
 	PrintException(std::current_exception());
@@ -54,8 +54,27 @@ try {
 	compressor = Compressor_new(0);
 
 	while ((nbytes = read(0, buffer, sizeof(buffer))) > 0) {
-		Compressor_Process_int16(compressor,
-					 (int16_t *)buffer, nbytes / 2);
+		switch (audio_format.format) {
+		case SampleFormat::S24_P32:
+			Compressor_Process_int24(compressor,
+						 (int32_t *)buffer, nbytes / 4);
+			break;
+
+		case SampleFormat::S32:
+			Compressor_Process_int32(compressor,
+						 (int32_t *)buffer, nbytes / 4);
+			break;
+
+		case SampleFormat::FLOAT:
+			Compressor_Process_float(compressor,
+						 (float *)buffer, nbytes / 4);
+			break;
+
+		default:
+			Compressor_Process_int16(compressor,
+						 (int16_t *)buffer, nbytes / 2);
+			break;
+		}
 
 		gcc_unused ssize_t ignored = write(1, buffer, nbytes);
 	}
@@ -16,9 +16,13 @@
 static std::unique_ptr<Tag>
 icy_parse_tag(const char *p)
 {
-	char *q = strdup(p);
+	/* copy without the null terminator, so reading past the
+	   end is detected by AddressSanitizer/valgrind */
+	const size_t length = strlen(p);
+	char *q = (char *)malloc(length);
+	memcpy(q, p, length);
 	AtScopeExit(q) { free(q); };
-	return icy_parse_tag(q, q + strlen(q));
+	return icy_parse_tag(q, q + length);
 }
 
 static void
@@ -59,4 +63,49 @@ TEST(IcyMetadataParserTest, Basic)
 	TestIcyParserTitle("a='b;c';StreamTitle='foo;bar'", "foo;bar");
 	TestIcyParserTitle("a='b'c';StreamTitle='foo'bar'", "foo'bar");
 	TestIcyParserTitle("StreamTitle='fo'o'b'ar';a='b'c'd'", "fo'o'b'ar");
+	TestIcyParserEmpty("StreamTitle=");
+	TestIcyParserTitle("StreamTitle='foo';a=", "foo");
+}
+
+static std::string
+MakeIcyBlock(const char *data, const char *meta)
+{
+	std::string result(data);
+	const size_t meta_length = strlen(meta);
+	const size_t n = (meta_length + 15) / 16;
+	result.push_back(char(n));
+	result.append(meta);
+	result.append(n * 16 - meta_length, '\0');
+	return result;
+}
+
+TEST(IcyMetadataParserTest, Stream)
+{
+	IcyMetaDataParser parser;
+	parser.Start(4);
+
+	std::string s = MakeIcyBlock("abcd", "StreamTitle='foo';");
+	s += MakeIcyBlock("efgh", "StreamTitle='foo';");
+	s += MakeIcyBlock("ijkl", "StreamTitle='bar';");
+
+	size_t n = parser.ParseInPlace(&s[0], 4 + 1 + 32);
+	EXPECT_EQ(size_t(4), n);
+	EXPECT_EQ(std::string("abcd"), s.substr(0, 4));
+	auto tag = parser.ReadTag();
+	ASSERT_NE(nullptr, tag);
+	CompareTagTitle(*tag, "foo");
+
+	/* an unchanged block does not produce a new tag */
+	char *p = &s[4 + 1 + 32];
+	n = parser.ParseInPlace(p, 4 + 1 + 32);
+	EXPECT_EQ(size_t(4), n);
+	EXPECT_EQ(std::string("efgh"), std::string(p, 4));
+	EXPECT_EQ(nullptr, parser.ReadTag());
+
+	p += 4 + 1 + 32;
+	n = parser.ParseInPlace(p, 4 + 1 + 32);
+	EXPECT_EQ(size_t(4), n);
+	tag = parser.ReadTag();
+	ASSERT_NE(nullptr, tag);
+	CompareTagTitle(*tag, "bar");
 }
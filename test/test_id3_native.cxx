@@ -0,0 +1,304 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "tag/Id3Native.hxx"
+#include "tag/Handler.hxx"
+#include "tag/Type.h"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+template<size_t n>
+static std::string
+S(const char (&s)[n])
+{
+	return std::string(s, n - 1);
+}
+
+static void
+AppendSize(std::string &dest, unsigned version, size_t size)
+{
+	if (version == 4) {
+		dest.push_back(char((size >> 21) & 0x7f));
+		dest.push_back(char((size >> 14) & 0x7f));
+		dest.push_back(char((size >> 7) & 0x7f));
+		dest.push_back(char(size & 0x7f));
+	} else {
+		dest.push_back(char(size >> 24));
+		dest.push_back(char(size >> 16));
+		dest.push_back(char(size >> 8));
+		dest.push_back(char(size));
+	}
+}
+
+static std::string
+MakeFrame(unsigned version, const char *id, const std::string &payload)
+{
+	std::string frame(id, 4);
+	AppendSize(frame, version, payload.size());
+	frame.append(2, 0);
+	frame += payload;
+	return frame;
+}
+
+static std::string
+MakeTag(unsigned version, const std::string &body, uint8_t flags=0)
+{
+	std::string tag("ID3");
+	tag.push_back(char(version));
+	tag.push_back(0);
+	tag.push_back(char(flags));
+	AppendSize(tag, 4, body.size());
+	tag += body;
+	return tag;
+}
+
+class RecordTagHandler final : public NullTagHandler {
+public:
+	std::vector<std::pair<TagType, std::string>> tags;
+
+	RecordTagHandler() noexcept
+		:NullTagHandler(WANT_TAG) {}
+
+	void OnTag(TagType type, StringView value) noexcept override {
+		tags.emplace_back(type, std::string(value.data, value.size));
+	}
+
+	std::string Get(TagType type) const {
+		std::string result;
+		for (const auto &i : tags) {
+			if (i.first != type)
+				continue;
+
+			if (!result.empty())
+				result.push_back('|');
+			result += i.second;
+		}
+
+		return result;
+	}
+};
+
+static bool
+Scan(const std::string &tag, RecordTagHandler &handler)
+{
+	return id3v2_native_scan({(const uint8_t *)tag.data(), tag.size()},
+				 handler);
+}
+
+TEST(Id3Native, Query)
+{
+	std::string tag = MakeTag(4, MakeFrame(4, "TIT2", S("\3Foo")));
+	EXPECT_EQ(id3v2_native_query((const uint8_t *)tag.data()),
+		  tag.size());
+
+	/* ID3v2.2 is left to libid3tag */
+	tag[3] = 2;
+	EXPECT_EQ(id3v2_native_query((const uint8_t *)tag.data()), 0u);
+	tag[3] = 4;
+
+	/* so is unsynchronisation */
+	tag[5] = char(0x80);
+	EXPECT_EQ(id3v2_native_query((const uint8_t *)tag.data()), 0u);
+	tag[5] = 0;
+
+	/* bogus syncsafe size */
+	tag[9] = char(0x80);
+	EXPECT_EQ(id3v2_native_query((const uint8_t *)tag.data()), 0u);
+}
+
+TEST(Id3Native, Text)
+{
+	RecordTagHandler handler;
+	ASSERT_TRUE(Scan(MakeTag(4,
+				 MakeFrame(4, "TIT2", S("\0Caf\xe9")) +
+				 MakeFrame(4, "TPE1", S("\3A\0B")) +
+				 MakeFrame(4, "TALB", S("\2\0X\0Y\0\0")) +
+				 MakeFrame(4, "TCOM", S("\1\xff\xfeZ\0\0\0"))),
+			 handler));
+
+	EXPECT_EQ(handler.Get(TAG_TITLE), "Caf\xc3\xa9");
+	EXPECT_EQ(handler.Get(TAG_ARTIST), "A|B");
+	EXPECT_EQ(handler.Get(TAG_ALBUM), "XY");
+	EXPECT_EQ(handler.Get(TAG_COMPOSER), "Z");
+}
+
+TEST(Id3Native, UTF16)
+{
+	RecordTagHandler handler;
+
+	/* a surrogate pair (U+1F600) */
+	ASSERT_TRUE(Scan(MakeTag(4,
+				 MakeFrame(4, "TIT2",
+					   S("\1\xfe\xff\xd8\x3d\xde\x00"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_TITLE), "\xf0\x9f\x98\x80");
+}
+
+TEST(Id3Native, UTF16OddLength)
+{
+	RecordTagHandler handler;
+
+	/* a trailing odd byte after the terminator, and one without
+	   a terminator; this used to loop forever */
+	ASSERT_TRUE(Scan(MakeTag(4,
+				 MakeFrame(4, "TIT2",
+					   S("\1\xff\xfe" "A\0\0\0" "B")) +
+				 MakeFrame(4, "TPE1",
+					   S("\1\xff\xfe" "C\0D"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_TITLE), "A");
+	EXPECT_EQ(handler.Get(TAG_ARTIST), "C");
+
+	/* a truncated surrogate pair */
+	RecordTagHandler handler2;
+	ASSERT_TRUE(Scan(MakeTag(4,
+				 MakeFrame(4, "TIT2",
+					   S("\1\xfe\xff\0E\xd8\x3d\xde"))),
+			 handler2));
+	EXPECT_EQ(handler2.Get(TAG_TITLE), "E");
+}
+
+TEST(Id3Native, Truncated)
+{
+	const std::string tag =
+		MakeTag(4, MakeFrame(4, "TIT2", S("\3Foo")));
+
+	/* the buffer is smaller than the tag */
+	RecordTagHandler handler;
+	EXPECT_FALSE(Scan(tag.substr(0, tag.size() - 1), handler));
+	EXPECT_FALSE(Scan(tag.substr(0, 5), handler));
+
+	/* the frame is larger than the tag */
+	std::string frame = MakeFrame(4, "TIT2", S("\3Foo"));
+	frame[7] = 0x7f;
+	EXPECT_FALSE(Scan(MakeTag(4, frame), handler));
+
+	/* a frame header which doesn't fit is ignored */
+	EXPECT_TRUE(Scan(MakeTag(4, MakeFrame(4, "TIT2", S("\3Foo")) +
+				 S("TPE1\0")),
+			 handler));
+
+	/* empty payloads */
+	EXPECT_TRUE(Scan(MakeTag(4, MakeFrame(4, "TIT2", "") +
+				 MakeFrame(4, "COMM", S("\3en")) +
+				 MakeFrame(4, "TXXX", "")),
+			 handler));
+
+	EXPECT_EQ(handler.Get(TAG_TITLE), "Foo");
+	EXPECT_EQ(handler.Get(TAG_COMMENT), "");
+}
+
+TEST(Id3Native, BogusSize)
+{
+	RecordTagHandler handler;
+
+	/* ID3v2.4 frame sizes must be syncsafe */
+	std::string frame = MakeFrame(4, "TIT2", S("\3Foo"));
+	frame[6] = char(0x80);
+	EXPECT_FALSE(Scan(MakeTag(4, frame), handler));
+
+	/* but not in ID3v2.3 */
+	EXPECT_TRUE(Scan(MakeTag(3, MakeFrame(3, "TIT2",
+					       S("\3Foo") +
+					       std::string(200, 'x'))),
+			 handler));
+
+	/* an invalid frame id */
+	EXPECT_FALSE(Scan(MakeTag(4, MakeFrame(4, "tit2", S("\3Foo"))),
+			  handler));
+
+	EXPECT_EQ(handler.Get(TAG_TITLE),
+		  "Foo" + std::string(200, 'x'));
+}
+
+TEST(Id3Native, ExtendedHeader)
+{
+	const std::string frames = MakeFrame(4, "TIT2", S("\3Foo"));
+
+	/* ID3v2.4: the size includes the size field */
+	RecordTagHandler handler;
+	ASSERT_TRUE(Scan(MakeTag(4, S("\0\0\0\6\1\0") + frames, 0x40),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_TITLE), "Foo");
+
+	/* ID3v2.3: it doesn't */
+	RecordTagHandler handler2;
+	ASSERT_TRUE(Scan(MakeTag(3, S("\0\0\0\6\0\0\0\0\0\0") +
+				 MakeFrame(3, "TIT2", S("\3Bar")), 0x40),
+			 handler2));
+	EXPECT_EQ(handler2.Get(TAG_TITLE), "Bar");
+
+	/* an extended header which is larger than the tag */
+	EXPECT_FALSE(Scan(MakeTag(4, S("\0\0\1\0\1\0") + frames, 0x40),
+			  handler));
+	EXPECT_FALSE(Scan(MakeTag(3, S("\xff\xff\xff\xff") + frames, 0x40),
+			  handler));
+
+	/* too small, or not syncsafe */
+	EXPECT_FALSE(Scan(MakeTag(4, S("\0\0\0\2") + frames, 0x40),
+			  handler));
+	EXPECT_FALSE(Scan(MakeTag(4, S("\0\0\0\x86\1\0") + frames, 0x40),
+			  handler));
+	EXPECT_FALSE(Scan(MakeTag(4, S("\0\0"), 0x40), handler));
+}
+
+TEST(Id3Native, Genre)
+{
+	RecordTagHandler handler;
+	ASSERT_TRUE(Scan(MakeTag(3, MakeFrame(3, "TCON", S("\0(17)"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_GENRE), "Rock");
+
+	/* several references */
+	handler.tags.clear();
+	ASSERT_TRUE(Scan(MakeTag(3, MakeFrame(3, "TCON", S("\0(0)(RX)(17)"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_GENRE), "Blues|Rock");
+
+	/* the refinement is preferred */
+	handler.tags.clear();
+	ASSERT_TRUE(Scan(MakeTag(3, MakeFrame(3, "TCON",
+					      S("\0(17)Krautrock"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_GENRE), "Krautrock");
+
+	/* an escaped parenthesis */
+	handler.tags.clear();
+	ASSERT_TRUE(Scan(MakeTag(3, MakeFrame(3, "TCON", S("\0((foo)"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_GENRE), "(foo)");
+
+	/* malformed references are taken literally */
+	handler.tags.clear();
+	ASSERT_TRUE(Scan(MakeTag(3, MakeFrame(3, "TCON", S("\0(17"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_GENRE), "(17");
+
+	/* ID3v2.4 uses plain numbers */
+	handler.tags.clear();
+	ASSERT_TRUE(Scan(MakeTag(4, MakeFrame(4, "TCON", S("\3" "17\0Pop"))),
+			 handler));
+	EXPECT_EQ(handler.Get(TAG_GENRE), "Rock|Pop");
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/BufferPool.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(PcmBuffer, Pool)
+{
+	pcm_buffer_pool_trim();
+	EXPECT_EQ(pcm_buffer_pool_idle_size(), 0u);
+
+	void *p;
+
+	{
+		PcmBuffer a;
+		p = a.Get(100000);
+		EXPECT_EQ(a.GetCapacity(), 131072u);
+		a.Clear();
+		EXPECT_EQ(a.GetCapacity(), 0u);
+		EXPECT_EQ(pcm_buffer_pool_idle_size(), 131072u);
+	}
+
+	/* a block released by one buffer is reused by the next one
+	   in the same size class */
+	PcmBuffer b;
+	EXPECT_EQ(b.Get(70000), p);
+	EXPECT_EQ(pcm_buffer_pool_idle_size(), 0u);
+
+	/* the destructor returns the block */
+	{
+		PcmBuffer c;
+		c.Get(1);
+		EXPECT_EQ(c.GetCapacity(), PCM_BUFFER_POOL_MIN_SIZE);
+	}
+
+	EXPECT_EQ(pcm_buffer_pool_idle_size(), PCM_BUFFER_POOL_MIN_SIZE);
+
+	b.Clear();
+	pcm_buffer_pool_trim();
+	EXPECT_EQ(pcm_buffer_pool_idle_size(), 0u);
+}
+
+TEST(PcmBuffer, Shrink)
+{
+	PcmBuffer buffer;
+	buffer.Get(1 << 20);
+	EXPECT_EQ(buffer.GetCapacity(), size_t(1 << 20));
+
+	/* occasional small requests keep the buffer */
+	for (unsigned i = 0; i < 10; ++i)
+		buffer.Get(1000);
+	buffer.Get(1 << 20);
+	EXPECT_EQ(buffer.GetCapacity(), size_t(1 << 20));
+
+	/* but if the size stays small, the buffer shrinks */
+	for (unsigned i = 0; i < 100; ++i)
+		buffer.Get(1000);
+	EXPECT_EQ(buffer.GetCapacity(), PCM_BUFFER_POOL_MIN_SIZE);
+
+	buffer.Clear();
+	pcm_buffer_pool_trim();
+}
@@ -19,6 +19,7 @@
 
 #include "test_pcm_util.hxx"
 #include "pcm/PcmChannels.hxx"
+#include "pcm/ChannelMatrix.hxx"
 #include "pcm/PcmBuffer.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -107,3 +108,79 @@ TEST(PcmTest, Channels32)
 		EXPECT_EQ(silence, dest[i * 6 + 5]);
 	}
 }
+
+/**
+ * Check PcmChannelMixer with a route against a plain reference
+ * implementation.
+ */
+template<typename T>
+static void
+CheckRoute(SampleFormat format, unsigned src_channels,
+	   unsigned dest_channels, const int8_t *sources, T silence)
+{
+	/* an odd number of frames to test the kernels' tails */
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<T, N * MAX_CHANNELS>();
+
+	PcmChannelMixer mixer;
+	mixer.Open(format, PcmChannelMatrix::Route(src_channels,
+						   dest_channels,
+						   sources));
+
+	PcmBuffer buffer;
+	const auto dest = ConstBuffer<T>::FromVoid(mixer.Apply(buffer,
+								 ConstBuffer<T>(src, N * src_channels).ToVoid()));
+	ASSERT_EQ(N * dest_channels, dest.size);
+
+	for (size_t i = 0; i < N; ++i) {
+		for (unsigned c = 0; c < dest_channels; ++c) {
+			const T expected = sources[c] >= 0 &&
+				unsigned(sources[c]) < src_channels
+				? src[i * src_channels + sources[c]]
+				: silence;
+			EXPECT_EQ(expected, dest[i * dest_channels + c]);
+		}
+	}
+}
+
+TEST(PcmTest, ChannelsRoute)
+{
+	static constexpr int8_t swap[] = { 1, 0 };
+	static constexpr int8_t upmix[] = { 0, 1, -1, -1, 0, 1, 7, -1 };
+	static constexpr int8_t reorder[] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+
+	CheckRoute<int16_t>(SampleFormat::S16, 2, 2, swap, 0);
+	CheckRoute<int16_t>(SampleFormat::S16, 2, 8, upmix, 0);
+	CheckRoute<int16_t>(SampleFormat::S16, 8, 8, reorder, 0);
+
+	CheckRoute<int32_t>(SampleFormat::S32, 2, 2, swap, 0);
+	CheckRoute<int32_t>(SampleFormat::S32, 2, 8, upmix, 0);
+	CheckRoute<int32_t>(SampleFormat::S24_P32, 8, 8, reorder, 0);
+	CheckRoute<int32_t>(SampleFormat::S32, 8, 2, reorder, 0);
+
+	CheckRoute<uint8_t>(SampleFormat::DSD, 2, 8, upmix, 0x69);
+	CheckRoute<int8_t>(SampleFormat::S8, 8, 8, reorder, 0);
+}
+
+TEST(PcmTest, ChannelsMix)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<float, N * 6>(RandomFloat());
+
+	PcmChannelMixer mixer;
+	mixer.Open(SampleFormat::FLOAT, PcmChannelMatrix::Convert(6, 2));
+
+	PcmBuffer buffer;
+	const auto dest = ConstBuffer<float>::FromVoid(mixer.Apply(buffer,
+								     ConstBuffer<float>(src, N * 6).ToVoid()));
+	ASSERT_EQ(N * 2, dest.size);
+
+	for (size_t i = 0; i < N; ++i) {
+		float sum = 0;
+		for (unsigned c = 0; c < 6; ++c)
+			sum += src[i * 6 + c];
+
+		EXPECT_FLOAT_EQ(sum / 6, dest[i * 2]);
+		EXPECT_FLOAT_EQ(sum / 6, dest[i * 2 + 1]);
+	}
+}
@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 TEST(PcmTest, Dither24)
 {
 	constexpr unsigned N = 509;
@@ -51,3 +53,36 @@ TEST(PcmTest, Dither32)
 		EXPECT_LT(dest[i], (src[i] >> 16) + 8);
 	}
 }
+
+TEST(PcmTest, DitherNone)
+{
+	constexpr unsigned N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	int16_t dest[N];
+	PcmDither dither(PcmDitherType::NONE);
+	dither.Dither24To16(dest, src.begin(), src.end());
+
+	/* plain rounding */
+	for (unsigned i = 0; i < N; ++i) {
+		const int32_t expected = std::min((src[i] + 0x80) >> 8, 0x7fff);
+		EXPECT_EQ(dest[i], expected);
+	}
+}
+
+TEST(PcmTest, DitherTPDF)
+{
+	constexpr unsigned N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	int16_t dest[N];
+	PcmDither dither(PcmDitherType::TPDF);
+	dither.Dither24To16(dest, src.begin(), src.end());
+
+	/* without error feedback, rounding and noise move each
+	   sample by less than two output steps */
+	for (unsigned i = 0; i < N; ++i) {
+		EXPECT_GE(dest[i], (src[i] >> 8) - 1);
+		EXPECT_LE(dest[i], (src[i] >> 8) + 2);
+	}
+}
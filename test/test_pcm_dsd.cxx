@@ -0,0 +1,177 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+
+static constexpr unsigned N_CHANNELS = 2;
+
+/**
+ * The number of output samples which may differ: dsd2pcm's initial
+ * state is its silence pattern without bit reversal, while #PcmDsd
+ * starts with the proper silence.
+ */
+static constexpr size_t N_WARMUP = 12;
+
+/**
+ * Generate interleaved stereo DSD with a first-order sigma-delta
+ * modulator: a sine wave with the given period (in bits) on the left
+ * channel, and its inverse on the right channel.
+ */
+static std::vector<uint8_t>
+GenerateSine(size_t n_frames, double period)
+{
+	std::vector<uint8_t> result(n_frames * N_CHANNELS);
+	std::array<double, N_CHANNELS> error{};
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < N_CHANNELS; ++c) {
+			uint8_t byte = 0;
+
+			for (unsigned bit = 0; bit < 8; ++bit) {
+				const double x = 0.5 * sin(2 * M_PI *
+							   (i * 8 + bit) /
+							   period);
+				const double target = c == 0 ? x : -x;
+				const bool one = target >= error[c];
+				error[c] += (one ? 1. : -1.) - target;
+				byte = (byte << 1) | one;
+			}
+
+			result[i * N_CHANNELS + c] = byte;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * Generate interleaved DSD from a simple linear congruential
+ * generator.
+ */
+static std::vector<uint8_t>
+GenerateNoise(size_t n_frames)
+{
+	std::vector<uint8_t> result(n_frames * N_CHANNELS);
+
+	uint32_t state = 1;
+	for (auto &i : result) {
+		state = state * 1103515245u + 12345u;
+		i = state >> 24;
+	}
+
+	return result;
+}
+
+static std::vector<uint8_t>
+GenerateConstant(size_t n_frames, uint8_t value)
+{
+	return std::vector<uint8_t>(n_frames * N_CHANNELS, value);
+}
+
+/**
+ * Convert with the reference implementation, the dsd2pcm library.
+ */
+static std::vector<float>
+ConvertReference(const std::vector<uint8_t> &src)
+{
+	const size_t n_frames = src.size() / N_CHANNELS;
+	std::vector<float> result(src.size());
+
+	for (unsigned c = 0; c < N_CHANNELS; ++c) {
+		dsd2pcm_ctx *ctx = dsd2pcm_init();
+		dsd2pcm_translate(ctx, n_frames,
+				  src.data() + c, N_CHANNELS,
+				  false, result.data() + c, N_CHANNELS);
+		dsd2pcm_destroy(ctx);
+	}
+
+	return result;
+}
+
+/**
+ * Convert with #PcmDsd, feeding the input in chunks of varying size
+ * to exercise the history between two calls.
+ */
+static std::vector<float>
+ConvertPcmDsd(const std::vector<uint8_t> &src)
+{
+	static constexpr size_t chunk_frames[] = { 1, 7, 100, 13, 333, 2 };
+
+	PcmDsd dsd;
+	std::vector<float> result;
+
+	size_t position = 0;
+	for (unsigned i = 0; position < src.size(); ++i) {
+		const size_t n = std::min(chunk_frames[i % 6] * N_CHANNELS,
+					  src.size() - position);
+
+		const auto dest = dsd.ToFloat(N_CHANNELS,
+					      {src.data() + position, n});
+		result.insert(result.end(), dest.begin(), dest.end());
+		position += n;
+	}
+
+	return result;
+}
+
+static void
+CompareWithReference(const std::vector<uint8_t> &src)
+{
+	const auto expected = ConvertReference(src);
+	const auto actual = ConvertPcmDsd(src);
+
+	ASSERT_EQ(expected.size(), actual.size());
+
+	for (size_t i = N_WARMUP * N_CHANNELS; i < expected.size(); ++i)
+		ASSERT_NEAR(expected[i], actual[i], 1e-5) << "sample " << i;
+}
+
+TEST(PcmDsdTest, Silence)
+{
+	CompareWithReference(GenerateConstant(1000, 0x69));
+}
+
+TEST(PcmDsdTest, Constant)
+{
+	CompareWithReference(GenerateConstant(1000, 0x00));
+	CompareWithReference(GenerateConstant(1000, 0xff));
+	CompareWithReference(GenerateConstant(1000, 0x55));
+}
+
+TEST(PcmDsdTest, Sine)
+{
+	CompareWithReference(GenerateSine(4000, 2822.4));
+	CompareWithReference(GenerateSine(4000, 100));
+}
+
+TEST(PcmDsdTest, Noise)
+{
+	CompareWithReference(GenerateNoise(4000));
+}
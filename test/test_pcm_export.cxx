@@ -23,6 +23,15 @@
 #include "system/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
 
+#ifdef ENABLE_DSD
+#include "pcm/Dsd16.hxx"
+#include "pcm/Dsd32.hxx"
+#include "pcm/PcmDop.hxx"
+#include "pcm/BitReverse.hxx"
+#include "util/bit_reverse.h"
+#include "test_pcm_util.hxx"
+#endif
+
 #include <gtest/gtest.h>
 
 #include <string.h>
@@ -212,6 +221,60 @@ TEST(PcmTest, ExportDop)
 	EXPECT_TRUE(memcmp(dest.data, expected, dest.size) == 0);
 }
 
+/**
+ * Compare the (possibly vectorized) PcmExport DSD conversions with
+ * the portable implementations, with various channel counts and a
+ * buffer size which leaves a tail.
+ */
+TEST(PcmTest, ExportDsdLong)
+{
+	constexpr size_t N = 1021 * 8;
+	const auto src = TestDataBuffer<uint8_t, N>();
+
+	for (unsigned channels : {1, 2, 3, 4, 6, 8}) {
+		const ConstBuffer<uint8_t> s(src.begin(),
+					     N / channels * channels);
+		PcmBuffer buffer;
+
+		PcmExport::Params params;
+		params.dsd_u16 = true;
+		PcmExport e;
+		e.Open(SampleFormat::DSD, channels, params);
+		auto dest = e.Export(s.ToVoid());
+		auto expected = Dsd8To16(buffer, channels, s).ToVoid();
+		EXPECT_EQ(expected.size, dest.size);
+		EXPECT_TRUE(memcmp(dest.data, expected.data, dest.size) == 0);
+
+		params = {};
+		params.dsd_u32 = true;
+		e.Open(SampleFormat::DSD, channels, params);
+		dest = e.Export(s.ToVoid());
+		expected = Dsd8To32(buffer, channels, s).ToVoid();
+		EXPECT_EQ(expected.size, dest.size);
+		EXPECT_TRUE(memcmp(dest.data, expected.data, dest.size) == 0);
+
+		params = {};
+		params.dop = true;
+		e.Open(SampleFormat::DSD, channels, params);
+		dest = e.Export(s.ToVoid());
+		expected = pcm_dsd_to_dop(buffer, channels, s).ToVoid();
+		EXPECT_EQ(expected.size, dest.size);
+		EXPECT_TRUE(memcmp(dest.data, expected.data, dest.size) == 0);
+	}
+}
+
+TEST(PcmTest, BitReverse)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<uint8_t, N>();
+
+	uint8_t dest[N];
+	PcmBitReverse(dest, src.begin(), N);
+
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_EQ(bit_reverse(src[i]), dest[i]);
+}
+
 #endif
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "pcm/LoudnessMeter.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Generate a 1 kHz sine wave with the given peak level [dBFS] on
+ * all channels.
+ */
+static std::vector<float>
+Sine(unsigned sample_rate, unsigned channels, double seconds, double dbfs)
+{
+	const double amplitude = pow(10, dbfs / 20);
+	const size_t n_frames = sample_rate * seconds;
+
+	std::vector<float> result;
+	result.reserve(n_frames * channels);
+	for (size_t i = 0; i < n_frames; ++i) {
+		const float x = amplitude * sin(2 * M_PI * 1000 * i / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			result.push_back(x);
+	}
+
+	return result;
+}
+
+TEST(PcmTest, LoudnessSine)
+{
+	/* EBU Tech 3341: a stereo 1 kHz sine at -23 dBFS measures
+	   -23 LUFS */
+	for (unsigned sample_rate : {44100u, 48000u}) {
+		const auto src = Sine(sample_rate, 2, 20, -23);
+
+		LoudnessMeter meter;
+		meter.Open(sample_rate, 2);
+		meter.Feed({src.data(), src.size()});
+
+		EXPECT_NEAR(meter.GetLoudness(), -23, 0.1);
+		EXPECT_NEAR(meter.GetPeak(), pow(10, -23. / 20), 0.001);
+	}
+}
+
+TEST(PcmTest, LoudnessGating)
+{
+	LoudnessMeter meter;
+	meter.Open(48000, 2);
+
+	/* silence is below the absolute threshold */
+	const std::vector<float> silence(48000 * 2 * 5);
+	meter.Feed({silence.data(), silence.size()});
+	EXPECT_TRUE(meter.GetBlocks().empty());
+	EXPECT_TRUE(isnan(meter.GetLoudness()));
+
+	/* a quiet passage 30 LU below is excluded by the relative
+	   threshold */
+	const auto loud = Sine(48000, 2, 10, -20);
+	const auto quiet = Sine(48000, 2, 10, -50);
+	meter.Feed({loud.data(), loud.size()});
+	meter.Feed({quiet.data(), quiet.size()});
+	EXPECT_NEAR(meter.GetLoudness(), -20, 0.2);
+}
+
+TEST(PcmTest, LoudnessAlbum)
+{
+	LoudnessMeter a, b;
+	a.Open(48000, 2);
+	b.Open(48000, 2);
+
+	const auto x = Sine(48000, 2, 10, -20);
+	const auto y = Sine(48000, 2, 10, -26);
+	a.Feed({x.data(), x.size()});
+	b.Feed({y.data(), y.size()});
+
+	auto blocks = a.GetBlocks();
+	blocks.insert(blocks.end(),
+		      b.GetBlocks().begin(), b.GetBlocks().end());
+
+	/* the energy mean of -20 and -26 LUFS */
+	const double expected = 10 * log10((pow(10, -2.) + pow(10, -2.6)) / 2);
+	EXPECT_NEAR(LoudnessMeter::Integrate(blocks), expected, 0.2);
+}
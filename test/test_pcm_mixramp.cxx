@@ -0,0 +1,80 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "pcm/MixRampMeter.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Generate a constant signal with the given level [dBFS].
+ */
+static std::vector<float>
+Constant(unsigned sample_rate, double seconds, double dbfs)
+{
+	return std::vector<float>(size_t(sample_rate * seconds),
+				  pow(10, dbfs / 20));
+}
+
+TEST(PcmTest, MixRampSilence)
+{
+	MixRampMeter meter;
+	meter.Open(44100, 1);
+	EXPECT_TRUE(meter.GetStart().empty());
+	EXPECT_TRUE(meter.GetEnd().empty());
+
+	const std::vector<float> silence(44100);
+	meter.Feed({silence.data(), silence.size()});
+	EXPECT_EQ(meter.GetStart(), "-120.00 0.00");
+	EXPECT_EQ(meter.GetEnd(), "-120.00 0.00");
+}
+
+TEST(PcmTest, MixRampProfile)
+{
+	MixRampMeter meter;
+	meter.Open(48000, 1);
+
+	/* 1 s silence, 1 s at -30 dB, 2 s at -5 dB, 0.5 s at -30
+	   dB, 1 s silence */
+	const std::vector<float> silence(48000);
+	const auto quiet = Constant(48000, 1, -30);
+	const auto loud = Constant(48000, 2, -5);
+	const auto fade = Constant(48000, 0.5, -30);
+	meter.Feed({silence.data(), silence.size()});
+	meter.Feed({quiet.data(), quiet.size()});
+	meter.Feed({loud.data(), loud.size()});
+	meter.Feed({fade.data(), fade.size()});
+	meter.Feed({silence.data(), silence.size()});
+
+	EXPECT_EQ(meter.GetStart(),
+		  "-42.00 1.00;-39.00 1.00;-36.00 1.00;-33.00 1.00;"
+		  "-30.00 1.00;-27.00 2.00;-24.00 2.00;-21.00 2.00;"
+		  "-18.00 2.00;-15.00 2.00;-12.00 2.00;-9.00 2.00;"
+		  "-6.00 2.00;-5.00 2.00");
+	EXPECT_EQ(meter.GetEnd(),
+		  "-42.00 1.00;-39.00 1.00;-36.00 1.00;-33.00 1.00;"
+		  "-30.00 1.00;-27.00 1.50;-24.00 1.50;-21.00 1.50;"
+		  "-18.00 1.50;-15.00 1.50;-12.00 1.50;-9.00 1.50;"
+		  "-6.00 1.50;-5.00 1.50");
+}
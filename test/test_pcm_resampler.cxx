@@ -0,0 +1,161 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/FallbackResampler.hxx"
+#include "pcm/Halfband.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Generate an interleaved sine wave with the same phase in all
+ * channels.
+ */
+static std::vector<float>
+Sine(unsigned sample_rate, unsigned channels, unsigned n_frames,
+     double frequency)
+{
+	std::vector<float> v;
+	v.reserve(n_frames * channels);
+	for (unsigned i = 0; i < n_frames; ++i) {
+		const float value = 0.5 * sin(2 * M_PI * frequency *
+					      i / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			v.push_back(value);
+	}
+
+	return v;
+}
+
+static std::vector<float>
+Resample(PcmResampler &resampler, const std::vector<float> &src,
+	 size_t block_size)
+{
+	std::vector<float> dest;
+	for (size_t i = 0; i < src.size(); i += block_size) {
+		const size_t n = std::min(block_size, src.size() - i);
+		const auto b = ConstBuffer<float>::FromVoid(resampler.Resample(ConstBuffer<float>(&src[i], n).ToVoid()));
+		dest.insert(dest.end(), b.begin(), b.end());
+	}
+
+	return dest;
+}
+
+TEST(PcmTest, FallbackResamplerHalfbandFormat)
+{
+	FallbackPcmResampler resampler;
+
+	AudioFormat af(44100, SampleFormat::S16, 2);
+	auto out = resampler.Open(af, 176400);
+	EXPECT_EQ(af.format, SampleFormat::FLOAT);
+	EXPECT_EQ(out, AudioFormat(176400, SampleFormat::FLOAT, 2));
+	resampler.Close();
+
+	/* other ratios keep the sample format */
+	af = AudioFormat(44100, SampleFormat::S16, 2);
+	out = resampler.Open(af, 48000);
+	EXPECT_EQ(af.format, SampleFormat::S16);
+	EXPECT_EQ(out, AudioFormat(48000, SampleFormat::S16, 2));
+	resampler.Close();
+}
+
+TEST(PcmTest, FallbackResamplerUpsample)
+{
+	constexpr unsigned channels = 2;
+	constexpr unsigned n_frames = 4410;
+
+	for (const unsigned factor : {2u, 4u, 8u}) {
+		FallbackPcmResampler resampler;
+		AudioFormat af(44100, SampleFormat::FLOAT, channels);
+		resampler.Open(af, 44100 * factor);
+
+		const auto src = Sine(44100, channels, n_frames, 1000);
+		const auto dest = Resample(resampler, src, 333 * channels);
+		resampler.Close();
+
+		const size_t dest_frames = dest.size() / channels;
+		EXPECT_GT(dest_frames,
+			  (n_frames - 4 * PcmHalfband::N_COEFFICIENTS) * factor);
+		EXPECT_LE(dest_frames, n_frames * factor);
+
+		/* the filter starts with silence, so skip the
+		   beginning */
+		const auto expected = Sine(44100 * factor, channels,
+					   dest_frames, 1000);
+		for (size_t i = 2 * PcmHalfband::N_COEFFICIENTS * factor * channels;
+		     i < dest.size(); ++i)
+			ASSERT_NEAR(dest[i], expected[i], 0.001) << factor;
+	}
+}
+
+TEST(PcmTest, FallbackResamplerDownsample)
+{
+	constexpr unsigned channels = 3;
+	constexpr unsigned n_frames = 19200;
+
+	for (const unsigned factor : {2u, 4u}) {
+		FallbackPcmResampler resampler;
+		AudioFormat af(192000, SampleFormat::FLOAT, channels);
+		resampler.Open(af, 192000 / factor);
+
+		const auto src = Sine(192000, channels, n_frames, 1000);
+		const auto dest = Resample(resampler, src, 1001 * channels);
+		resampler.Close();
+
+		const size_t dest_frames = dest.size() / channels;
+		EXPECT_GT(dest_frames,
+			  n_frames / factor - 4 * PcmHalfband::N_COEFFICIENTS);
+		EXPECT_LE(dest_frames, n_frames / factor);
+
+		/* the filter starts with silence, so skip the
+		   beginning */
+		const auto expected = Sine(192000 / factor, channels,
+					   dest_frames, 1000);
+		for (size_t i = 2 * PcmHalfband::N_COEFFICIENTS * channels;
+		     i < dest.size(); ++i)
+			ASSERT_NEAR(dest[i], expected[i], 0.001) << factor;
+	}
+}
+
+TEST(PcmTest, FallbackResamplerBlocks)
+{
+	/* the result must not depend on how the input is split */
+
+	constexpr unsigned channels = 2;
+	const auto src = Sine(48000, channels, 4800, 440);
+
+	FallbackPcmResampler a, b;
+	AudioFormat af(48000, SampleFormat::FLOAT, channels);
+	a.Open(af, 96000);
+	af = AudioFormat(48000, SampleFormat::FLOAT, channels);
+	b.Open(af, 96000);
+
+	const auto whole = Resample(a, src, src.size());
+	const auto split = Resample(b, src, 7 * channels);
+	a.Close();
+	b.Close();
+
+	ASSERT_EQ(whole.size(), split.size());
+	for (size_t i = 0; i < whole.size(); ++i)
+		ASSERT_FLOAT_EQ(whole[i], split[i]);
+}
@@ -20,6 +20,7 @@
 #include "pcm/Volume.hxx"
 #include "pcm/Traits.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "test_pcm_util.hxx"
 
 #include <gtest/gtest.h>
@@ -67,6 +68,58 @@ TestVolume(G g=G())
 	pv.Close();
 }
 
+template<SampleFormat F, class Traits=SampleTraits<F>,
+	 typename G=RandomInt<typename Traits::value_type>>
+static void
+TestVolumeRamp(G g=G())
+{
+	typedef typename Traits::value_type value_type;
+
+	constexpr unsigned CHANNELS = 2;
+
+	PcmVolume pv;
+	pv.Open(F, CHANNELS);
+
+	constexpr size_t N = 512;
+	const auto _src = TestDataBuffer<value_type, N>(g);
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	/* fade from 100% to 0% */
+	pv.RampVolume(0);
+	auto dest = pv.Apply(src);
+	EXPECT_EQ(src.size, dest.size);
+
+	auto _dest = ConstBuffer<value_type>::FromVoid(dest);
+
+	/* the first frame is still almost at full volume */
+	constexpr size_t N_FRAMES = N / CHANNELS;
+	for (unsigned c = 0; c < CHANNELS; ++c) {
+		const auto expected = _src[c] - _src[c] / value_type(N_FRAMES);
+		EXPECT_GE(_dest[c], expected - 4);
+		EXPECT_LE(_dest[c], expected + 4);
+	}
+
+	/* the last frame is silent (except for dither noise) */
+	for (unsigned c = 0; c < CHANNELS; ++c) {
+		EXPECT_GE(_dest[N - CHANNELS + c], -4);
+		EXPECT_LE(_dest[N - CHANNELS + c], 4);
+	}
+
+	/* the ramp is finished; now this is just silence */
+	dest = pv.Apply(src);
+	EXPECT_EQ(src.size, dest.size);
+	_dest = ConstBuffer<value_type>::FromVoid(dest);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(_dest[i], 0);
+
+	/* SetVolume() switches immediately */
+	pv.SetVolume(PCM_VOLUME_1);
+	dest = pv.Apply(src);
+	EXPECT_EQ(dest.data, src.data);
+
+	pv.Close();
+}
+
 TEST(PcmTest, Volume8)
 {
 	TestVolume<SampleFormat::S8>();
@@ -87,6 +140,16 @@ TEST(PcmTest, Volume32)
 	TestVolume<SampleFormat::S32>();
 }
 
+TEST(PcmTest, VolumeRamp16)
+{
+	TestVolumeRamp<SampleFormat::S16>();
+}
+
+TEST(PcmTest, VolumeRamp32)
+{
+	TestVolumeRamp<SampleFormat::S32>();
+}
+
 TEST(PcmTest, VolumeFloat)
 {
 	PcmVolume pv;
@@ -117,3 +180,66 @@ TEST(PcmTest, VolumeFloat)
 
 	pv.Close();
 }
+
+TEST(PcmTest, VolumeConvert)
+{
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	PcmBuffer buffer;
+
+	auto dest = pcm_volume_convert(buffer, SampleFormat::S16,
+				       SampleFormat::S32,
+				       src, PCM_VOLUME_1 / 2);
+	EXPECT_EQ(src.size * 2, dest.size);
+
+	const auto _dest32 = ConstBuffer<int32_t>::FromVoid(dest);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(_dest32[i], int32_t(_src[i]) << 15);
+
+	dest = pcm_volume_convert(buffer, SampleFormat::S16,
+				  SampleFormat::FLOAT,
+				  src, PCM_VOLUME_1 / 2);
+	EXPECT_EQ(src.size * 2, dest.size);
+
+	const auto _destf = ConstBuffer<float>::FromVoid(dest);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_NEAR(_destf[i], _src[i] / 65536., 0.0001);
+
+	/* narrowing is not implemented */
+	EXPECT_TRUE(pcm_volume_convert(buffer, SampleFormat::S32,
+				       SampleFormat::S16,
+				       src, PCM_VOLUME_1 / 2).IsNull());
+}
+
+TEST(PcmTest, VolumeInPlace)
+{
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	PcmVolume a, b;
+	a.Open(SampleFormat::S16);
+	b.Open(SampleFormat::S16);
+
+	a.SetVolume(PCM_VOLUME_1 / 3);
+	b.SetVolume(PCM_VOLUME_1 / 3);
+
+	const auto dest = a.Apply(src);
+
+	int16_t data[N];
+	std::copy_n(_src.begin(), N, data);
+	b.ApplyInPlace({data, sizeof(data)});
+
+	EXPECT_EQ(0, memcmp(dest.data, data, sizeof(data)));
+
+	/* 100% is a no-op */
+	std::copy_n(_src.begin(), N, data);
+	b.SetVolume(PCM_VOLUME_1);
+	b.ApplyInPlace({data, sizeof(data)});
+	EXPECT_EQ(0, memcmp(_src.begin(), data, sizeof(data)));
+
+	a.Close();
+	b.Close();
+}
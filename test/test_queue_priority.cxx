@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 Tag::Tag(const Tag &) noexcept {}
 void Tag::Clear() noexcept {}
 
@@ -163,3 +165,84 @@ TEST(QueuePriority, Priority)
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(6u, a_order);
 }
+
+TEST(QueuePriority, DeleteRange)
+{
+	Queue queue(32);
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong(std::to_string(i)), 0);
+
+	const unsigned id5 = queue.PositionToId(5);
+	const unsigned id12 = queue.PositionToId(12);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+
+	queue.DeleteRange(6, 12);
+	EXPECT_EQ(10u, queue.GetLength());
+
+	/* the songs after the range have moved down */
+	EXPECT_STREQ("5", queue.Get(5).GetURI());
+	EXPECT_STREQ("12", queue.Get(6).GetURI());
+	EXPECT_EQ(5, queue.IdToPosition(id5));
+	EXPECT_EQ(6, queue.IdToPosition(id12));
+
+	/* the order array is still a permutation */
+	for (unsigned i = 0; i < queue.GetLength(); ++i) {
+		EXPECT_LT(queue.OrderToPosition(i), queue.GetLength());
+		EXPECT_EQ(i, queue.OrderToPosition(queue.PositionToOrder(i)));
+	}
+}
+
+static void
+CheckOrderInverse(const Queue &queue)
+{
+	for (unsigned i = 0; i < queue.GetLength(); ++i) {
+		EXPECT_EQ(i, queue.PositionToOrder(queue.OrderToPosition(i)));
+		EXPECT_EQ(i, queue.OrderToPosition(queue.PositionToOrder(i)));
+	}
+}
+
+TEST(QueuePriority, PositionToOrder)
+{
+	Queue queue(64);
+
+	for (unsigned i = 0; i < 32; ++i)
+		queue.Append(DetachedSong(std::to_string(i)), 0);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+	CheckOrderInverse(queue);
+
+	queue.SetPriorityRange(3, 9, 20, 0);
+	CheckOrderInverse(queue);
+
+	queue.SetPriority(20, 50, 2);
+	CheckOrderInverse(queue);
+
+	queue.MoveOrder(30, 1);
+	CheckOrderInverse(queue);
+
+	queue.SwapOrders(4, 17);
+	CheckOrderInverse(queue);
+
+	queue.MovePostion(5, 25);
+	CheckOrderInverse(queue);
+
+	queue.MoveRange(10, 14, 2);
+	CheckOrderInverse(queue);
+
+	queue.DeletePosition(7);
+	CheckOrderInverse(queue);
+
+	queue.DeleteRange(0, 3);
+	CheckOrderInverse(queue);
+
+	queue.Append(DetachedSong("new"), 0);
+	queue.ShuffleOrderLastWithPriority(1, queue.GetLength());
+	CheckOrderInverse(queue);
+
+	queue.RestoreOrder();
+	CheckOrderInverse(queue);
+}